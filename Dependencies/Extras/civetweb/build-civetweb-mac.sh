@@ -18,7 +18,14 @@ fi
 cd $REPO_DIR
 
 export MACOSX_DEPLOYMENT_TARGET=10.9
-make lib WITH_CPP=1 WITH_WEBSOCKET=1
+
+# CIVETWEB_DEFLATE=1 builds with zlib, so that websocket messages are compressed with permessage-deflate for the clients that support it. Link with -lz
+if [ "$CIVETWEB_DEFLATE" == "1" ]
+then
+  make lib WITH_CPP=1 WITH_WEBSOCKET=1 WITH_ZLIB=1 WITH_EXPERIMENTAL=1
+else
+  make lib WITH_CPP=1 WITH_WEBSOCKET=1
+fi
 
 if [ ! -d "$INSTALL_DIR/lib" ];
 then
@@ -102,6 +102,13 @@ void* mnvgCommandQueue(NVGcontext* ctx);
 // Creates an image id from a `id<MTLTexture>` object pointer.
 int mnvgCreateImageFromHandle(NVGcontext* ctx, void* textureId, int imageFlags);
 
+// Creates an image from the first mip level of a compressed texture, identified
+// by its GL internal format as in a KTX file. Returns 0 if the format is not
+// supported by the device, BC3/BC7 on macOS or ETC2/ASTC 4x4 on Apple GPUs.
+int mnvgCreateImageCompressed(NVGcontext* ctx, unsigned int glInternalFormat,
+                              int width, int height, const void* data,
+                              int dataSize, int imageFlags);
+
 // Returns a pointer to the corresponded `id<MTLDevice>` object.
 void* mnvgDevice(NVGcontext* ctx);
 
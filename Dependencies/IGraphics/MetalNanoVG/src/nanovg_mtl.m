@@ -545,9 +545,92 @@ int mnvgCreateImageFromHandle(NVGcontext* ctx, void* textureId, int imageFlags)
   tex->tex = (__bridge id<MTLTexture>)textureId;
   tex->flags = imageFlags;
 
+  MTLSamplerDescriptor* samplerDescriptor = [MTLSamplerDescriptor new];
+  if (imageFlags & NVG_IMAGE_NEAREST) {
+    samplerDescriptor.minFilter = MTLSamplerMinMagFilterNearest;
+    samplerDescriptor.magFilter = MTLSamplerMinMagFilterNearest;
+  } else {
+    samplerDescriptor.minFilter = MTLSamplerMinMagFilterLinear;
+    samplerDescriptor.magFilter = MTLSamplerMinMagFilterLinear;
+  }
+  tex->sampler = [mtl.metalLayer.device
+      newSamplerStateWithDescriptor:samplerDescriptor];
+
   return tex->id;
 }
 
+int mnvgCreateImageCompressed(NVGcontext* ctx, unsigned int glInternalFormat,
+                              int width, int height, const void* data,
+                              int dataSize, int imageFlags) {
+#if TARGET_OS_SIMULATOR
+  return 0;
+#else
+  MNVGcontext* mtl = (__bridge MNVGcontext*)nvgInternalParams(ctx)->userPtr;
+  id<MTLDevice> device = mtl.metalLayer.device;
+  MTLPixelFormat pixelFormat = MTLPixelFormatInvalid;
+  BOOL supported = NO;
+
+  // Block compressed formats are supported on macOS, ASTC and ETC2 on Apple GPUs.
+  BOOL supportsBC = TARGET_OS_OSX;
+  BOOL supportsASTC = TARGET_OS_IOS;
+#if TARGET_OS_OSX
+  if (@available(macOS 11.0, *)) {
+    supportsBC = device.supportsBCTextureCompression;
+  }
+  if (@available(macOS 10.15, *)) {
+    supportsASTC = [device supportsFamily:MTLGPUFamilyApple2];
+  }
+#endif
+
+  switch (glInternalFormat) {
+#if TARGET_OS_OSX
+    case 0x83F3:  // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+      pixelFormat = MTLPixelFormatBC3_RGBA;
+      supported = supportsBC;
+      break;
+    case 0x8E8C:  // GL_COMPRESSED_RGBA_BPTC_UNORM
+      pixelFormat = MTLPixelFormatBC7_RGBAUnorm;
+      supported = supportsBC;
+      break;
+#endif
+    case 0x9278:  // GL_COMPRESSED_RGBA8_ETC2_EAC
+      pixelFormat = MTLPixelFormatEAC_RGBA8;
+      supported = supportsASTC;
+      break;
+    case 0x93B0:  // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+      pixelFormat = MTLPixelFormatASTC_4x4_LDR;
+      supported = supportsASTC;
+      break;
+    default:
+      break;
+  }
+
+  // All the supported formats are 4x4 blocks of 16 bytes.
+  const NSUInteger bytesPerRow = ((width + 3) / 4) * 16;
+
+  if (!supported || (NSUInteger)dataSize < bytesPerRow * ((height + 3) / 4))
+    return 0;
+
+  MTLTextureDescriptor* textureDescriptor = [MTLTextureDescriptor
+      texture2DDescriptorWithPixelFormat:pixelFormat
+      width:width
+      height:height
+      mipmapped:NO];
+  textureDescriptor.usage = MTLTextureUsageShaderRead;
+  id<MTLTexture> texture = [device newTextureWithDescriptor:textureDescriptor];
+
+  if (texture == nil) return 0;
+
+  [texture replaceRegion:MTLRegionMake2D(0, 0, width, height)
+             mipmapLevel:0
+               withBytes:data
+             bytesPerRow:bytesPerRow];
+
+  // The image keeps the texture alive, unless NVG_IMAGE_NODELETE is passed.
+  return mnvgCreateImageFromHandle(ctx, (__bridge void*)texture, imageFlags);
+#endif  // TARGET_OS_SIMULATOR
+}
+
 void* mnvgDevice(NVGcontext* ctx) {
   MNVGcontext* mtl = (__bridge MNVGcontext*)nvgInternalParams(ctx)->userPtr;
   return (__bridge void*)mtl.metalLayer.device;
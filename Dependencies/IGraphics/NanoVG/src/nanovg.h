@@ -591,6 +591,10 @@ void nvgFontFace(NVGcontext* ctx, const char* font);
 // Draws text string at specified location. If end is specified only the sub-string up to the end is drawn.
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end);
 
+// Rasterizes the glyphs of a string into the font atlas at the current text style and transform, without drawing them.
+// Used to prewarm the atlas, so that drawing the glyphs later doesn't need to rasterize them. If end is specified only the sub-string up to the end is used.
+void nvgPrewarmText(NVGcontext* ctx, const char* string, const char* end);
+
 // Draws multi-line text string at specified location wrapped at the specified width. If end is specified only the sub-string up to the end is drawn.
 // White space is stripped at the beginning of the rows, the text is split at word boundaries or when new-line characters are encountered.
 // Words longer than the max width are slit at nearest character (i.e. no hyphenation).
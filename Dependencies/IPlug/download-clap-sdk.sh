@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+
+# 1st argument = tag name
+
+TAG="1.2.2"
+if [ "$1" != "" ]; then
+  TAG=$1
+fi
+
+rm -f -r CLAP_SDK
+git clone https://github.com/free-audio/clap.git --branch $TAG --single-branch --depth=1 CLAP_SDK
+cd CLAP_SDK
+rm -f -r .git*
+git checkout README.md
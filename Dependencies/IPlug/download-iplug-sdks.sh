@@ -1,4 +1,5 @@
 #!/usr/bin/env bash
 
 ./download-vst3-sdk.sh
+./download-clap-sdk.sh
 ./download-wam-sdk.sh
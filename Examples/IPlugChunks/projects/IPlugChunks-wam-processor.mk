@@ -1,6 +1,6 @@
 include ../config/IPlugChunks-web.mk
 
-TARGET = ../build-web/scripts/IPlugChunks-wam.js
+TARGET = ../build-web/scripts/IPlugChunks-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
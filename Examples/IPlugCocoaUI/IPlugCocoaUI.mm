@@ -46,6 +46,7 @@ void* IPlugCocoaUI::OpenWindow(void* pParent)
   [platformParent addSubview:vc.view];
 #endif
   OnUIOpen();
+  OnEditorOpenChanged(true);
 
   return vc.view;
 }
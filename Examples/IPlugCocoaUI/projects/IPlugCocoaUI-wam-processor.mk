@@ -1,6 +1,6 @@
 include ../config/IPlugCocoaUI-web.mk
 
-TARGET = ../build-web/scripts/IPlugCocoaUI-wam.js
+TARGET = ../build-web/scripts/IPlugCocoaUI-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
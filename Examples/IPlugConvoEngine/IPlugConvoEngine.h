@@ -9,14 +9,8 @@
   #define WDL_FFT_REALSIZE 8
 #endif
 
-#include "convoengine.h"
-
-#if defined USE_WDL_RESAMPLER
-  #include "resample.h"
-#elif defined USE_R8BRAIN
-  #include "CDSPResampler.h"
-  using namespace r8b;
-#endif
+#include "ConvolutionEngine.h"
+#include "ConvolutionImpulseLoader.h"
 
 const int kNumPresets = 1;
 
@@ -38,28 +32,11 @@ public:
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void OnReset() override;
 private:
-  // Returns destination length
-  inline int ResampleLength(int srcLength, double srcRate, double destRate) const
-  {
-    return int(destRate / srcRate * (double)srcLength + 0.5);
-  }
-
-  template <class I, class O> void Resample(const I* pSrc, int srcLength, double srcRate, O* pDst, int dstLength, double dstRate);
-  
   static const float mIR[512];
-
-  WDL_ImpulseBuffer mImpulse;
-//  WDL_ConvolutionEngine_Div mEngine; // < low latency version
-  WDL_ConvolutionEngine mEngine;
-  
+  static constexpr double mIRSampleRate = 44100.;
   static constexpr int mBlockLength = 64;
 
-  #if defined USE_WDL_RESAMPLER
-  WDL_Resampler mResampler;
-  #elif defined USE_R8BRAIN
-  std::unique_ptr<CDSPResampler16IR> mResampler;
-  #endif
-
-  double mSampleRate = 0.0;
+  ConvolutionEngine mEngine;
+  ConvolutionImpulseLoader mImpulseLoader {mEngine}; // resamples the IR on a worker thread when the sample rate changes
 #endif
 };
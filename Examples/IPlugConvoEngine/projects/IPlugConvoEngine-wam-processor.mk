@@ -1,6 +1,6 @@
 include ../config/IPlugConvoEngine-web.mk
 
-TARGET = ../build-web/scripts/IPlugConvoEngine-wam.js
+TARGET = ../build-web/scripts/IPlugConvoEngine-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
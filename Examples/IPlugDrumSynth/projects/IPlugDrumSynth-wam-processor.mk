@@ -1,6 +1,6 @@
 include ../config/IPlugDrumSynth-web.mk
 
-TARGET = ../build-web/scripts/IPlugDrumSynth-wam.js
+TARGET = ../build-web/scripts/IPlugDrumSynth-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
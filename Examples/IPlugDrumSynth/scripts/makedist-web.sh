@@ -111,12 +111,22 @@ if [ "$WEBSOCKET_MODE" -eq "0" ]; then
     exit 1
   fi
 
+  # the same module built with WebAssembly SIMD128, which the -awn.js script loads instead if the browser supports it
+  emmake make --makefile $PROJECT_NAME-wam-processor.mk WAM_SIMD=1
+
+  if [ $? -ne "0" ]; then
+    echo IPlugWAM SIMD WASM compilation failed
+    exit 1
+  fi
+
   cd $PROJECT_ROOT/build-web/scripts
 
-  # prefix the -wam.js script with scope
-  echo "AudioWorkletGlobalScope.WAM = AudioWorkletGlobalScope.WAM || {}; AudioWorkletGlobalScope.WAM.$PROJECT_NAME = { ENVIRONMENT: 'WEB' };" > $PROJECT_NAME-wam.tmp.js;
-  cat $PROJECT_NAME-wam.js >> $PROJECT_NAME-wam.tmp.js
-  mv $PROJECT_NAME-wam.tmp.js $PROJECT_NAME-wam.js
+  # prefix the -wam.js scripts with scope
+  for WAM_SCRIPT in $PROJECT_NAME-wam $PROJECT_NAME-wam-simd; do
+    echo "AudioWorkletGlobalScope.WAM = AudioWorkletGlobalScope.WAM || {}; AudioWorkletGlobalScope.WAM.$PROJECT_NAME = { ENVIRONMENT: 'WEB' };" > $WAM_SCRIPT.tmp.js;
+    cat $WAM_SCRIPT.js >> $WAM_SCRIPT.tmp.js
+    mv $WAM_SCRIPT.tmp.js $WAM_SCRIPT.js
+  done
   
   # copy in WAM SDK and AudioWorklet polyfill scripts
   cp $IPLUG2_ROOT/Dependencies/IPlug/WAM_SDK/wamsdk/*.js .
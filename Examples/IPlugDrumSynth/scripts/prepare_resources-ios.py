@@ -17,6 +17,7 @@ IPLUG2_ROOT = "../../.."
 sys.path.insert(0, os.path.join(os.getcwd(), IPLUG2_ROOT + '/Scripts'))
 
 from parse_config import parse_config, parse_xcconfig
+from compress_textures import compress_textures
 
 def main():
   if(len(sys.argv) == 2):
@@ -30,6 +31,8 @@ def main():
          for img in imgs:
            print("copying " + img + " to " + dst)
            shutil.copy(projectpath + "/resources/img/" + img, dst)
+
+         compress_textures(projectpath + "/resources/img/", dst, "astc")
      
        if os.path.exists(projectpath + "/resources/fonts/"):
          fonts = os.listdir(projectpath + "/resources/fonts/")
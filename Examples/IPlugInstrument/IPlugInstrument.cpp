@@ -132,6 +132,12 @@ handle:
   SendMidiMsg(msg);
 }
 
+void IPlugInstrument::ProcessUMP(const IMidiUMP& msg)
+{
+  // MIDI 2.0 messages and per-note expression go straight to the synth at full resolution
+  mDSP.ProcessUMP(msg);
+}
+
 void IPlugInstrument::OnParamChange(int paramIdx)
 {
   mDSP.SetParam(paramIdx, GetParam(paramIdx)->Value());
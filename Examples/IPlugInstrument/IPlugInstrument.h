@@ -49,6 +49,7 @@ public:
 public:
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void ProcessMidiMsg(const IMidiMsg& msg) override;
+  void ProcessUMP(const IMidiUMP& msg) override;
   void OnReset() override;
   void OnParamChange(int paramIdx) override;
   void OnParamChangeUI(int paramIdx, EParamSource source) override;
@@ -30,15 +30,21 @@ public:
 //      DBGMSG("new Voice: %i control inputs.\n", static_cast<int>(mInputs.size()));
     }
 
+    // the voices of a unison group share the envelope of the group's leader, see ProcessShared()
+    const Voice& Leader() const { return *static_cast<const Voice*>(GetUnisonLeader()); }
+
     bool GetBusy() const override
     {
-      return mAMPEnv.GetBusy();
+      return Leader().mAMPEnv.GetBusy();
     }
 
     void Trigger(double level, bool isRetrigger) override
     {
       mOSC.Reset();
-      
+
+      if(!IsUnisonLeader())
+        return;
+
       if(isRetrigger)
         mAMPEnv.Retrigger(level);
       else
@@ -47,7 +53,28 @@ public:
     
     void Release() override
     {
-      mAMPEnv.Release();
+      if(IsUnisonLeader())
+        mAMPEnv.Release();
+    }
+
+    void Kill() override
+    {
+      if(IsUnisonLeader())
+        mAMPEnv.Kill(false);
+    }
+
+    double GetLevel() const override
+    {
+      return Leader().mAMPEnv.GetPrevOutput();
+    }
+
+    // computed once per unison group, the other voices of the group read mEnvBuffer from the leader
+    void ProcessShared(T** inputs, int nInputs, int startIdx, int nFrames) override
+    {
+      for(auto i = startIdx; i < startIdx + nFrames; i++)
+      {
+        mEnvBuffer.Get()[i] = mAMPEnv.Process(inputs[kModSustainSmoother][i]);
+      }
     }
 
     void ProcessSamplesAccumulating(T** inputs, T** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
@@ -63,12 +90,14 @@ public:
       // convert from "1v/oct" pitch space to frequency in Hertz
       double osc1Freq = 440. * pow(2., pitch + pitchBend + inputs[kModLFO][0]);
       
+      const T* pEnv = Leader().mEnvBuffer.Get();
+
       // make sound output for each output channel
       for(auto i = startIdx; i < startIdx + nFrames; i++)
       {
         float noise = mTimbreBuffer.Get()[i] * Rand();
         // an MPE synth can use pressure here in addition to gain
-        outputs[0][i] += (mOSC.Process(osc1Freq) + noise) * mAMPEnv.Process(inputs[kModSustainSmoother][i]) * mGain;
+        outputs[0][i] += (mOSC.Process(osc1Freq) + noise) * pEnv[i] * mGain;
         outputs[1][i] = outputs[0][i];
       }
     }
@@ -79,6 +108,7 @@ public:
       mAMPEnv.SetSampleRate(sampleRate);
       
       mTimbreBuffer.Resize(blockSize);
+      mEnvBuffer.Resize(blockSize);
     }
 
     void SetProgramNumber(int pgm) override
@@ -98,6 +128,7 @@ public:
 
   private:
     WDL_TypedBuf<float> mTimbreBuffer;
+    WDL_TypedBuf<T> mEnvBuffer;
 
     // noise generator for test
     uint32_t mRandSeed = 0;
@@ -125,6 +156,7 @@ public:
     // some MidiSynth API examples:
     // mSynth.SetKeyToPitchFn([](int k){return (k - 69.)/24.;}); // quarter-tone scale
     // mSynth.SetNoteGlideTime(0.5); // portamento
+    // mSynth.SetUnison(4, 0.2f); // four voices per note, spread over a fifth of a semitone
   }
 
   void ProcessBlock(T** inputs, T** outputs, int nOutputs, int nFrames, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
@@ -166,6 +198,11 @@ public:
     mSynth.AddMidiMsgToQueue(msg);
   }
 
+  void ProcessUMP(const IMidiUMP& msg)
+  {
+    mSynth.AddUMPToQueue(msg);
+  }
+
   void SetParam(int paramIdx, double value)
   {
     using EEnvStage = ADSREnvelope<sample>::EStage;
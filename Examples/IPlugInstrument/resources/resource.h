@@ -31,6 +31,8 @@
 #define ID_SHOW_DRAWN                   40026
 #define ID_SHOW_FPS                     40027
 #define ID_SHOW_BOUNDS                  40028
+#define IDC_TXT_AUDIO_LATENCY           40029
+#define IDC_TXT_AUDIO_PERFORMANCE       40030
 
 // Next default values for new objects
 //
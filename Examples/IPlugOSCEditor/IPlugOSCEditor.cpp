@@ -22,6 +22,14 @@ IPlugOSCEditor::IPlugOSCEditor(const InstanceInfo& info)
   OSCReceiver::SetLogFunc(logFunc);
   OSCSender::SetLogFunc(logFunc);
 
+  mOSCDispatcher.Bind("/gain", [&](OscMessageRead& msg) {
+    IGraphics* pGraphics = GetUI();
+    auto* pValue = msg.PopFloatArg(true);
+
+    if (pValue && pGraphics)
+      pGraphics->GetControlWithTag(kCtrlTagGain)->SetValueFromDelegate(*pValue);
+  });
+
 #if IPLUG_EDITOR // http://bit.ly/2S64BDd
   mMakeGraphicsFunc = [&]() {
     return MakeGraphics(*this, PLUG_WIDTH, PLUG_HEIGHT, PLUG_FPS, GetScaleForScreen(PLUG_WIDTH, PLUG_HEIGHT));
@@ -88,14 +96,7 @@ void IPlugOSCEditor::OnOSCMessage(OscMessageRead& msg)
 
   IGraphics* pGraphics = GetUI();
 
-  if(strcmp(msg.GetMessage(), "/gain") == 0)
-  {
-    auto* pValue = msg.PopFloatArg(true);
-    if (pValue) {
-      if(pGraphics)
-        pGraphics->GetControlWithTag(kCtrlTagGain)->SetValueFromDelegate(*pValue);
-    }
-  }
+  mOSCDispatcher.Dispatch(msg);
 
   WDL_String oscStr;
 
@@ -2,6 +2,7 @@
 
 #include "IPlug_include_in_plug_hdr.h"
 #include "IPlugOSC.h"
+#include "IPlugOSCDispatcher.h"
 
 const int kNumPresets = 1;
 
@@ -31,4 +32,7 @@ public:
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   
   void OnOSCMessage(OscMessageRead& msg) override;
+
+private:
+  OSCDispatcher mOSCDispatcher;
 };
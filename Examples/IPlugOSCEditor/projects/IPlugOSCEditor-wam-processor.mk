@@ -1,6 +1,6 @@
 include ../config/IPlugOSCEditor-web.mk
 
-TARGET = ../build-web/scripts/IPlugOSCEditor-wam.js
+TARGET = ../build-web/scripts/IPlugOSCEditor-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
@@ -19,6 +19,7 @@ IPLUG2_ROOT = "../../.."
 sys.path.insert(0, os.path.join(os.getcwd(), IPLUG2_ROOT + '/Scripts'))
 
 from parse_config import parse_config, parse_xcconfig
+from compress_textures import compress_textures
 
 def main():
   config = parse_config(projectpath)
@@ -46,6 +47,8 @@ def main():
       print("copying " + img + " to " + dst)
       shutil.copy(projectpath + "/resources/img/" + img, dst)
 
+    compress_textures(projectpath + "/resources/img/", dst, "bc7")
+
   if os.path.exists(projectpath + "/resources/fonts/"):
     fonts = os.listdir(projectpath + "/resources/fonts/")
     for font in fonts:
@@ -79,25 +79,21 @@ void IPlugSideChain::OnActivate(bool enable)
   mSendUpdate = true;
 }
 
+void IPlugSideChain::OnBusConnectionChanged(ERoute direction, int busIdx, bool connected)
+{
+  for (int i=0; i < 4; i++)
+    mInputChansConnected[i] = IsChannelConnected(ERoute::kInput, i);
+  
+  for (int i=0; i < 2; i++)
+    mOutputChansConnected[i] = IsChannelConnected(ERoute::kOutput, i);
+  
+  mSendUpdate = true;
+}
+
 void IPlugSideChain::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
   const double gain = GetParam(kGain)->DBToAmp();
   const int nChans = NOutChansConnected();
-  for (int i=0; i < 4; i++) {
-    bool connected = IsChannelConnected(ERoute::kInput, i);
-    if(connected != mInputChansConnected[i]) {
-      mInputChansConnected[i] = connected;
-      mSendUpdate = true;
-    }
-  }
-  
-  for (int i=0; i < 2; i++) {
-    bool connected = IsChannelConnected(ERoute::kOutput, i);
-    if(connected != mOutputChansConnected[i]) {
-      mOutputChansConnected[i] = connected;
-      mSendUpdate = true;
-    }
-  }
   
   for (int s = 0; s < nFrames; s++) {
     for (int c = 0; c < nChans; c++) {
@@ -36,6 +36,7 @@ public:
   void OnIdle() override;
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   void OnActivate(bool enable) override;
+  void OnBusConnectionChanged(ERoute direction, int busIdx, bool connected) override;
   void OnReset() override;
   void GetBusName(ERoute direction, int busIdx, int nBuses, WDL_String& str) const override;
 
@@ -1,6 +1,6 @@
 include ../config/IPlugSideChain-web.mk
 
-TARGET = ../build-web/scripts/IPlugSideChain-wam.js
+TARGET = ../build-web/scripts/IPlugSideChain-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
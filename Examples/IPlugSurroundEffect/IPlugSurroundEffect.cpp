@@ -83,16 +83,24 @@ void IPlugSurroundEffect::OnIdle()
   mOutputPeakSender.TransmitData(*this);
 }
 
+void IPlugSurroundEffect::OnReset()
+{
+  mBlocks.Resize(NOutChansConnected(), GetBlockSize());
+  mGain.Resize(NOutChansConnected());
+  mGain.SetSampleRate(GetSampleRate());
+  mGain.SetAllGains(GetParam(kGain)->Value() / 100.);
+  mGain.Reset();
+}
+
 void IPlugSurroundEffect::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
-  const double gain = GetParam(kGain)->Value() / 100.;
-  const int nChans = NOutChansConnected();
-  
-  for (int s = 0; s < nFrames; s++) {
-    for (int c = 0; c < nChans; c++) {
-      outputs[c][s] = inputs[c][s] * gain;
-    }
-  }
+  const int nChans = std::min(NOutChansConnected(), mBlocks.NChans());
+
+  // the channels are processed eight at a time, see ChannelBlocks.h
+  mGain.SetAllGains(GetParam(kGain)->Value() / 100.);
+  mBlocks.Pack(inputs, nChans, nFrames);
+  mGain.ProcessBlock(mBlocks, nFrames);
+  mBlocks.Unpack(outputs, nChans, nFrames);
 
   mInputPeakSender.ProcessBlock(inputs, nFrames, kCtrlTagInputMeter);
   mOutputPeakSender.ProcessBlock(outputs, nFrames, kCtrlTagOutputMeter);
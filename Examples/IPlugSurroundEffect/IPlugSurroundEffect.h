@@ -2,6 +2,7 @@
 
 #include "IPlug_include_in_plug_hdr.h"
 #include "ISender.h"
+#include "ChannelBlocks.h"
 
 const int kNumPresets = 1;
 
@@ -28,8 +29,11 @@ public:
 
 #if IPLUG_DSP // http://bit.ly/2S64BDd
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
+  void OnReset() override;
   void OnIdle() override;
   
+  ChannelBlockBuffer mBlocks;
+  ChannelBlockGain mGain;
   IPeakAvgSender<12> mInputPeakSender;
   IPeakAvgSender<12> mOutputPeakSender;
 #endif
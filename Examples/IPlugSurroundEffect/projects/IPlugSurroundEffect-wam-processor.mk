@@ -1,6 +1,6 @@
 include ../config/IPlugSurroundEffect-web.mk
 
-TARGET = ../build-web/scripts/IPlugSurroundEffect-wam.js
+TARGET = ../build-web/scripts/IPlugSurroundEffect-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
@@ -32,6 +32,7 @@ void* IPlugSwiftUI::OpenWindow(void* pParent)
   [platformParent addSubview:vc.view];
   
   OnUIOpen();
+  OnEditorOpenChanged(true);
   
   return vc.view;
 }
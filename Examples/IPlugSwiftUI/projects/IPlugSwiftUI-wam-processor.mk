@@ -1,6 +1,6 @@
 include ../config/IPlugSwiftUI-web.mk
 
-TARGET = ../build-web/scripts/IPlugSwiftUI-wam.js
+TARGET = ../build-web/scripts/IPlugSwiftUI-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
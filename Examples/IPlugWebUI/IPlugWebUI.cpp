@@ -16,6 +16,9 @@ IPlugWebUI::IPlugWebUI(const InstanceInfo& info)
     
     EnableScroll(false);
   };
+
+  // keep the page loaded while the editor is closed, so that it opens at once
+  SetPoolKey(GetBundleID());
   
   MakePreset("One", -70.);
   MakePreset("Two", -30.);
@@ -538,12 +538,17 @@ IVKnobControl::IVKnobControl(const IRECT& bounds, IActionFunction aF, const char
 
 void IVKnobControl::Draw(IGraphics& g)
 {
-  DrawBackground(g, mRECT);
-  DrawLabel(g);
+  DrawStaticLayer(g);
   DrawWidget(g);
   DrawValue(g, mValueMouseOver);
 }
 
+void IVKnobControl::DrawStatic(IGraphics& g)
+{
+  DrawBackground(g, mRECT);
+  DrawLabel(g);
+}
+
 IRECT IVKnobControl::GetKnobDragBounds()
 {
   IRECT r;
@@ -700,12 +705,17 @@ IVSliderControl::IVSliderControl(const IRECT& bounds, IActionFunction aF, const
 
 void IVSliderControl::Draw(IGraphics& g)
 {
-  DrawBackground(g, mRECT);
-  DrawLabel(g);
+  DrawStaticLayer(g);
   DrawWidget(g);
   DrawValue(g, mValueMouseOver);
 }
 
+void IVSliderControl::DrawStatic(IGraphics& g)
+{
+  DrawBackground(g, mRECT);
+  DrawLabel(g);
+}
+
 void IVSliderControl::DrawTrack(IGraphics& g, const IRECT& filledArea)
 {
   const float extra = mHandleInsideTrack ? mHandleSize : 0.f;
@@ -1117,6 +1127,12 @@ void IVPlotControl::OnResize()
   SetDirty(false);
 }
 
+void IVPlotControl::OnMemoryWarning()
+{
+  mLayer = nullptr;
+  IControl::OnMemoryWarning();
+}
+
 void IVPlotControl::AddPlotFunc(const IColor& color, const IPlotFunc& func)
 {
   mPlots.push_back({color, func});
@@ -1556,6 +1572,95 @@ void IBSliderControl::OnResize()
   SetDirty(false);
 }
 
+IBStreamedKnobControl::IBStreamedKnobControl(const IRECT& bounds, const char* frameNameFormat, int nFrames, int paramIdx, int nAheadFrames, EDirection direction, double gearing)
+: IKnobControlBase(bounds, paramIdx, direction, gearing)
+, mFrameNameFormat(frameNameFormat)
+, mAheadFrames(std::max(nAheadFrames, 0))
+, mFrames(std::max(nFrames, 1))
+{
+}
+
+IBStreamedKnobControl::~IBStreamedKnobControl()
+{
+  ReleaseFrames();
+}
+
+void IBStreamedKnobControl::Draw(IGraphics& g)
+{
+  const int nFrames = static_cast<int>(mFrames.size());
+  const int frame = Clip(static_cast<int>(0.5 + GetValue() * static_cast<double>(nFrames - 1)), 0, nFrames - 1);
+  
+  UpdateFrames(g, frame);
+  
+  // the nearest frame that is loaded stands in for the current one while it is decoding
+  for (int offset = 0; offset <= mAheadFrames; offset++)
+  {
+    for (int i : {frame - offset, frame + offset})
+    {
+      if (i >= 0 && i < nFrames && mFrames[i] && mFrames[i]->IsLoaded())
+      {
+        const IBitmap bitmap(mFrames[i].get(), 1, false);
+        g.DrawBitmap(bitmap, mRECT.GetCentredInside(IRECT(0, 0, bitmap)), 1, &mBlend);
+        return;
+      }
+    }
+  }
+}
+
+void IBStreamedKnobControl::OnRescale()
+{
+  ReleaseFrames();
+  SetDirty(false);
+}
+
+void IBStreamedKnobControl::UpdateFrames(IGraphics& g, int frame)
+{
+  const int nFrames = static_cast<int>(mFrames.size());
+  const int start = std::max(frame - mAheadFrames, 0);
+  const int end = std::min(frame + mAheadFrames, nFrames - 1);
+  bool standInLoaded = false;
+  
+  for (int i = start; i <= end; i++)
+    standInLoaded |= mFrames[i] && mFrames[i]->IsLoaded();
+  
+  for (int i = 0; i < nFrames; i++)
+  {
+    std::unique_ptr<APIBitmap>& pFrame = mFrames[i];
+    
+    if (i >= start && i <= end)
+    {
+      if (!pFrame)
+      {
+        WDL_String name;
+        name.SetFormatted(mFrameNameFormat.GetLength() + 32, mFrameNameFormat.Get(), i);
+        
+        // the current frame is loaded now if there is nothing to draw in its place
+        const bool background = i != frame || standInLoaded;
+        pFrame = g.LoadUncachedAPIBitmap(name.Get(), background);
+        
+        assert((background || pFrame) && "Bitmap not found");
+      }
+    }
+    else if (pFrame && pFrame->IsLoaded()) // frames that are decoding are deleted once they have been finished
+    {
+      pFrame.reset();
+    }
+  }
+}
+
+void IBStreamedKnobControl::ReleaseFrames()
+{
+  IGraphics* pGraphics = GetUI();
+  
+  for (auto& pFrame : mFrames)
+  {
+    if (pFrame && !pFrame->IsLoaded() && pGraphics)
+      pGraphics->FinishBitmapDecoding();
+    
+    pFrame.reset();
+  }
+}
+
 void IBKnobRotaterControl::Draw(IGraphics& g)
 {
   const double angle = -130.0 + GetValue() * 260.0;
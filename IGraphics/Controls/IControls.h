@@ -21,6 +21,9 @@
 #include "IVKeyboardControl.h"
 #include "IVMeterControl.h"
 #include "IVScopeControl.h"
+#include "IVSpectrumControl.h"
+#include "IVSpectrogramControl.h"
+#include "IVTabbedPagesControl.h"
 #include "IVMultiSliderControl.h"
 #include "IRTTextControl.h"
 #include "IVDisplayControl.h"
@@ -233,6 +236,7 @@ public:
   virtual ~IVKnobControl() {}
 
   void Draw(IGraphics& g) override;
+  void DrawStatic(IGraphics& g) override;
   virtual void DrawWidget(IGraphics& g) override;
   virtual void DrawIndicatorTrack(IGraphics& g, float angle, float cx, float cy, float radius);
   virtual void DrawPointer(IGraphics& g, float angle, float cx, float cy, float radius);
@@ -275,6 +279,7 @@ public:
 
   virtual ~IVSliderControl() {}
   void Draw(IGraphics& g) override;
+  void DrawStatic(IGraphics& g) override;
   virtual void DrawWidget(IGraphics& g) override;
   virtual void DrawTrack(IGraphics& g, const IRECT& filledArea);
   virtual void DrawHandle(IGraphics& g, const IRECT& bounds);
@@ -380,6 +385,7 @@ public:
   
   void Draw(IGraphics& g) override;
   void OnResize() override;
+  void OnMemoryWarning() override;
   
   /** add a new function to the plot
    * @param color The function color
@@ -629,6 +635,37 @@ public:
   void OnRescale() override { mBitmap = GetUI()->GetScaledBitmap(mBitmap); }
 };
 
+/** A bitmap knob/dial control for filmstrips with a lot of frames, e.g. photoreal knobs, which are stored as a bitmap per frame rather than as one bitmap.
+ * Only the frames around the current value are kept loaded. Those either side of it are decoded ahead on a background thread, and the others are deleted,
+ * so the memory used scales with the number of controls rather than with the number of frames. While a frame is decoding, the nearest loaded frame is drawn */
+class IBStreamedKnobControl : public IKnobControlBase
+{
+public:
+  /** @param bounds The control's bounds, the frames are centred inside it
+   * @param frameNameFormat A printf format for the file or resource names of the frames, which are numbered from 0, e.g. "knob_%03d.png"
+   * @param nFrames The number of frames
+   * @param paramIdx The parameter index to link this control to
+   * @param nAheadFrames The number of frames either side of the current one that are kept loaded
+   * @param direction The direction of the mouse movement that controls adjusting the knob
+   * @param gearing The gearing of the mouse movement */
+  IBStreamedKnobControl(const IRECT& bounds, const char* frameNameFormat, int nFrames, int paramIdx, int nAheadFrames = 4, EDirection direction = EDirection::Vertical, double gearing = DEFAULT_GEARING);
+
+  virtual ~IBStreamedKnobControl();
+  void Draw(IGraphics& g) override;
+  void OnRescale() override;
+
+private:
+  /** Load the frames around a frame that are not loaded, and delete the loaded frames outside them */
+  void UpdateFrames(IGraphics& g, int frame);
+
+  /** Delete all the frames, e.g. so that they are loaded again at a new scale */
+  void ReleaseFrames();
+
+  WDL_String mFrameNameFormat;
+  int mAheadFrames;
+  std::vector<std::unique_ptr<APIBitmap>> mFrames;
+};
+
 /** A bitmap knob/dial control that rotates an image */
 class IBKnobRotaterControl : public IBKnobControl
 {
@@ -727,6 +764,7 @@ END_IPLUG_NAMESPACE
 
 #include "IVPresetManagerControl.h"
 #include "IVNumberBoxControl.h"
+#include "IVListControl.h"
 
 /**@}*/
 
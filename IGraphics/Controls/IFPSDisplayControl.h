@@ -16,28 +16,64 @@
  * @copydoc IFPSDisplayControl
  */
 
+#include <algorithm>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined __GNUG__
+  #include <cxxabi.h>
+#endif
+
 #include "IControl.h"
+#include "IPlugRealtimeCheck.h"
+#include "IPlugMemoryAccounting.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
 /** Performance display meter, based on code from NanoVG
  *  This is a special control that lives outside the main IGraphics control stack.
+ *  Clicking it cycles through the styles. The kProfile style breaks each frame down into the phases timed by IGraphics, and lists the controls that take longest to draw
  * @ingroup SpecialControls */
 class IFPSDisplayControl : public IControl
                          , public IVectorBase
 {
 private:
   static constexpr int MAXBUF = 100;
+  static constexpr int kProfileFrames = 30; // the number of frames that each profile is averaged over
+  static constexpr int kNumTopControls = 5;
+  static constexpr float kProfileLineHeight = 12.f;
+#if defined IPLUG_MEMORY_ACCOUNTING
+  static constexpr int kNumMemoryLines = static_cast<int>(EMemorySubsystem::kNumSubsystems) + 1;
+#else
+  static constexpr int kNumMemoryLines = 0;
+#endif
 public:
+  static constexpr int kMsgTagProcessingLoad = 0;
+
   enum EStyle
   {
     kFPS,
     kMS,
     kPercentage,
+    kProfile,
     kNumStyles
   };
 
+  /** The phases of a frame that are timed with the kProfile style */
+  enum EFramePhase
+  {
+    kAnimate, // animations and the display tick function, in IGraphics::IsDirty()
+    kCollectDirty, // asking the controls if they are dirty and recording display lists, in IGraphics::IsDirty()
+    kPrepare, // the backend's BeginFrame(), the control grid and pending rasterization, in IGraphics::Draw()
+    kOptimizeRects, // IRECTList::Optimize() or Coalesce()
+    kDrawControls, // IGraphics::DrawControl(), for every control
+    kFlush, // the backend's EndFrame(), which flushes and presents
+    kNumFramePhases
+  };
+
   IFPSDisplayControl(const IRECT& bounds, EStyle style = EStyle::kFPS, const char* label = "Frame Time")
   : IControl(bounds)
   , IVectorBase(DEFAULT_STYLE)
@@ -45,6 +81,7 @@ public:
   , mNameLabel(label)
   {
     AttachIControl(this, label);
+    SetPollDirty(true);
 
     SetColor(kBG, COLOR_WHITE);
 
@@ -57,6 +94,19 @@ public:
 
     if(mStyle == kNumStyles)
       mStyle = kFPS;
+
+    // the profile needs more room, which is given back when the style changes again
+    if (mStyle == kProfile)
+    {
+      mCompactRECT = mRECT;
+      SetTargetAndDrawRECTs(mRECT.GetFromTop(mRECT.H() + (kNumFramePhases + kNumTopControls + kNumMemoryLines + 2) * kProfileLineHeight));
+      ResetProfile();
+    }
+    else if (mStyle == kFPS)
+    {
+      SetTargetAndDrawRECTs(mCompactRECT);
+      GetUI()->SetAllControlsDirty();
+    }
   }
 
   bool IsDirty() override
@@ -70,8 +120,95 @@ public:
     mBuffer[mReadPos] = frameTime;
   }
 
+  /** @return \c true if IGraphics should time the phases of each frame and the drawing of each control */
+  bool IsProfiling() const { return mStyle == kProfile; }
+
+  /** Called by IGraphics with the time spent in a phase of the current frame
+   * @param phase The phase
+   * @param seconds The time spent in it */
+  void AddPhaseTime(EFramePhase phase, double seconds)
+  {
+    mPhaseTimes[phase] += seconds;
+  }
+
+  /** Called by IGraphics::DrawControl() with the time spent drawing a control, which is added to the kDrawControls phase
+   * @param pControl The control
+   * @param seconds The time spent drawing it */
+  void AddControlTime(IControl* pControl, double seconds)
+  {
+    mPhaseTimes[kDrawControls] += seconds;
+    mControlTimes[pControl] += seconds;
+  }
+
+  /** Called by IGraphics at the end of each frame. Every kProfileFrames frames, the times are averaged into the profile that is displayed */
+  void EndProfiledFrame(IGraphics& g)
+  {
+    if (++mNProfiledFrames < kProfileFrames)
+      return;
+
+    for (int i = 0; i < kNumFramePhases; i++)
+      mPhaseAverages[i] = static_cast<float>(mPhaseTimes[i] * 1000. / mNProfiledFrames);
+
+    // controls are only kept by pointer, so removed controls, and the special controls, are left out
+    mSortedControlTimes.clear();
+
+    for (auto& controlTime : mControlTimes)
+    {
+      if (g.GetControlIdx(controlTime.first) > -1)
+        mSortedControlTimes.push_back(controlTime);
+    }
+
+    const int nTop = std::min(kNumTopControls, static_cast<int>(mSortedControlTimes.size()));
+    std::partial_sort(mSortedControlTimes.begin(), mSortedControlTimes.begin() + nTop, mSortedControlTimes.end(), [](const std::pair<IControl*, double>& a, const std::pair<IControl*, double>& b) {
+      return a.second > b.second;
+    });
+
+    for (int i = 0; i < kNumTopControls; i++)
+    {
+      if (i < nTop)
+      {
+        IControl* pControl = mSortedControlTimes[i].first;
+        WDL_String className;
+        GetControlClassName(pControl, className);
+        mTopControlNames[i].SetFormatted(128, "#%d %s", g.GetControlIdx(pControl), className.Get());
+        mTopControlAverages[i] = static_cast<float>(mSortedControlTimes[i].second * 1000. / mNProfiledFrames);
+      }
+      else
+      {
+        mTopControlNames[i].Set("");
+        mTopControlAverages[i] = 0.f;
+      }
+    }
+
+    std::fill(mPhaseTimes, mPhaseTimes + kNumFramePhases, 0.);
+    mControlTimes.clear();
+    mNProfiledFrames = 0;
+  }
+
+  /** Receives ProcessingLoad statistics sent from the plug-in with SendControlMsgFromDelegate() and kMsgTagProcessingLoad, see IPlugProcessor::GetProcessingLoad()
+   * With the kPercentage style the control then shows the audio processing load */
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (msgTag == kMsgTagProcessingLoad && dataSize == sizeof(ProcessingLoad))
+    {
+      const ProcessingLoad* pLoad = static_cast<const ProcessingLoad*>(pData);
+
+      if (mStyle == kPercentage)
+        Update(static_cast<float>(pLoad->percent));
+      else
+        Update(static_cast<float>(pLoad->meanUs / 1e6));
+    }
+  }
+
   void Draw(IGraphics& g) override
   {
+    if (mStyle == kProfile)
+    {
+      DrawProfile(g);
+      DrawRealtimeViolations(g, mRECT.GetPadded(-2).GetFromTop(mCompactRECT.H() - 4.f));
+      return;
+    }
+
     float avg = 0.f;
     for (int i = 0; i < MAXBUF; i++)
       avg += mBuffer[i];
@@ -154,8 +291,124 @@ public:
       str.SetFormatted(32, "%.2f ms", avg * 1000.0f);
       g.DrawText(mTopLabelText, str.Get(), padded);
     }
+
+    DrawRealtimeViolations(g, padded);
   }
+
 private:
+  void ResetProfile()
+  {
+    std::fill(mPhaseTimes, mPhaseTimes + kNumFramePhases, 0.);
+    std::fill(mPhaseAverages, mPhaseAverages + kNumFramePhases, 0.f);
+    std::fill(mTopControlAverages, mTopControlAverages + kNumTopControls, 0.f);
+
+    for (auto& name : mTopControlNames)
+      name.Set("");
+
+    mControlTimes.clear();
+    mNProfiledFrames = 0;
+  }
+
+  /** Draws the average time of each phase as a bar, relative to the frame interval, followed by the controls that take longest to draw */
+  void DrawProfile(IGraphics& g)
+  {
+    static const char* sPhaseNames[kNumFramePhases] = { "Animate", "Dirty", "Prepare", "Optimize", "Controls", "Flush" };
+
+    g.FillRect(GetColor(kBG), mRECT);
+    g.DrawRect(COLOR_BLACK, mRECT);
+
+    const IRECT padded = mRECT.GetPadded(-2);
+    const float frameMs = 1000.f / static_cast<float>(g.FPS() > 0 ? g.FPS() : DEFAULT_FPS);
+    float total = 0.f;
+
+    for (auto average : mPhaseAverages)
+      total += average;
+
+    WDL_String str;
+    IRECT line = padded.GetFromTop(kProfileLineHeight);
+    str.SetFormatted(64, "Frame %.2f ms of %.1f", total, frameMs);
+    g.DrawText(mProfileText, str.Get(), line);
+
+    for (int i = 0; i < kNumFramePhases; i++)
+    {
+      line.Translate(0.f, kProfileLineHeight);
+      const IRECT bar = line.GetReducedFromLeft(60.f).GetPadded(0.f, -2.f, 0.f, -2.f);
+      g.FillRect(GetColor(kFG), bar.GetFromLeft(bar.W() * Clip(mPhaseAverages[i] / frameMs, 0.f, 1.f)));
+      str.SetFormatted(64, "%s %.3f", sPhaseNames[i], mPhaseAverages[i]);
+      g.DrawText(mProfileText, str.Get(), line);
+    }
+
+    line.Translate(0.f, kProfileLineHeight);
+    g.DrawText(mProfileText, "Slowest controls (ms)", line);
+
+    for (int i = 0; i < kNumTopControls && mTopControlNames[i].GetLength(); i++)
+    {
+      str.SetFormatted(128, "%.3f %s", mTopControlAverages[i], mTopControlNames[i].Get());
+      g.DrawText(mProfileText, str.Get(), line.GetTranslated(0.f, (i + 1) * kProfileLineHeight));
+    }
+
+#if defined IPLUG_MEMORY_ACCOUNTING
+    // the memory of this instance and of the whole process, see IPlugMemoryAccounting.h
+    const MemoryUsage instanceUsage = GetDelegate()->GetMemoryUsage();
+    const MemoryUsage processUsage = GetProcessMemoryUsage();
+    line.Translate(0.f, (kNumTopControls + 1) * kProfileLineHeight);
+    str.SetFormatted(128, "Memory (KB) %lld / %lld", static_cast<long long>(instanceUsage.Total() / 1024), static_cast<long long>(processUsage.Total() / 1024));
+    g.DrawText(mProfileText, str.Get(), line);
+
+    for (int i = 0; i < static_cast<int>(EMemorySubsystem::kNumSubsystems); i++)
+    {
+      const EMemorySubsystem subsystem = static_cast<EMemorySubsystem>(i);
+      line.Translate(0.f, kProfileLineHeight);
+      str.SetFormatted(128, "%s %lld / %lld", MemorySubsystemStr(subsystem), static_cast<long long>(instanceUsage.Get(subsystem) / 1024), static_cast<long long>(processUsage.Get(subsystem) / 1024));
+      g.DrawText(mProfileText, str.Get(), line);
+    }
+#endif
+  }
+
+  /** With IPLUG_REALTIME_CHECKS defined, violations on the audio thread are summarized, see IPlugRealtimeCheck.h */
+  void DrawRealtimeViolations(IGraphics& g, const IRECT& padded)
+  {
+    const RealtimeViolationSummary violations = GetRealtimeViolationSummary();
+
+    if (violations.Total() > 0)
+    {
+      WDL_String str;
+      g.DrawRect(COLOR_RED, mRECT, nullptr, 2.f);
+      str.SetFormatted(128, "RT: %lld alloc %lld free %lld lock %lld I/O",
+                       static_cast<long long>(violations.counts[static_cast<int>(ERealtimeViolation::kAllocation)]),
+                       static_cast<long long>(violations.counts[static_cast<int>(ERealtimeViolation::kDeallocation)]),
+                       static_cast<long long>(violations.counts[static_cast<int>(ERealtimeViolation::kLock)]),
+                       static_cast<long long>(violations.counts[static_cast<int>(ERealtimeViolation::kFileIO)]));
+      g.DrawText(mViolationsText, str.Get(), padded.GetFromTop(padded.H() * 0.5f).GetFromBottom(14.f));
+
+      if (violations.lastDescription)
+        g.DrawText(mViolationsText, violations.lastDescription, padded.GetFromBottom(padded.H() * 0.5f).GetFromTop(14.f));
+    }
+  }
+
+  /** Gets the unqualified class name of a control, e.g. IVKnobControl */
+  static void GetControlClassName(const IControl* pControl, WDL_String& str)
+  {
+    const char* name = typeid(*pControl).name();
+#if defined __GNUG__
+    int status = 0;
+    char* pDemangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    str.Set(status == 0 ? pDemangled : name);
+    free(pDemangled);
+#else
+    str.Set(name); // e.g. "class iplug::igraphics::IVKnobControl"
+#endif
+    const char* pStart = str.Get();
+
+    for (const char* p = str.Get(); *p && *p != '<'; p++)
+    {
+      if (*p == ' ' || (*p == ':' && p[1] == ':'))
+        pStart = p + (*p == ' ' ? 1 : 2);
+    }
+
+    str.Set(WDL_String(pStart).Get());
+  }
+
   int mStyle;
   WDL_String mNameLabel;
   float mBuffer[MAXBUF] = {};
@@ -166,6 +419,17 @@ private:
   IText mAPILabelText = IText(14, GetColor(kFR), DEFAULT_FONT, EAlign::Near, EVAlign::Top);
   IText mTopLabelText = IText(18, GetColor(kFR), DEFAULT_FONT, EAlign::Far, EVAlign::Top);
   IText mBottomLabelText = IText(15, GetColor(kFR), DEFAULT_FONT, EAlign::Far, EVAlign::Bottom);
+  IText mViolationsText = IText(12, COLOR_RED, DEFAULT_FONT, EAlign::Center, EVAlign::Middle);
+  IText mProfileText = IText(11, GetColor(kFR), DEFAULT_FONT, EAlign::Near, EVAlign::Middle);
+
+  IRECT mCompactRECT;
+  double mPhaseTimes[kNumFramePhases] = {};
+  float mPhaseAverages[kNumFramePhases] = {};
+  std::unordered_map<IControl*, double> mControlTimes;
+  std::vector<std::pair<IControl*, double>> mSortedControlTimes;
+  WDL_String mTopControlNames[kNumTopControls];
+  float mTopControlAverages[kNumTopControls] = {};
+  int mNProfiledFrames = 0;
 };
 
 END_IGRAPHICS_NAMESPACE
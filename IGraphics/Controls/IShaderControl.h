@@ -10,22 +10,26 @@
 
 #pragma once
 
-#ifndef IGRAPHICS_SKIA
-#error This IControl only works with the Skia graphics backend
-#endif
-
 /**
  * @file
  * @copydoc IShaderControl
  */
 
+#include <chrono>
+
 #include "IControl.h"
-#include "SkRuntimeEffect.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
-/** This control allows you to draw to the UI via a shader written using the Skia shading language, which is similar to GLSL */
+/** This control allows you to draw to the UI via a fragment shader, compiled by the drawing backend with IGraphics::CreateShader().
+ * The shader is written in the backend's language, and defines a function called main that takes the coordinates in points from the top left of the control and returns a premultiplied color:
+ * - Skia (SkSL): \c half4 \c main(float2 fragCoord), with the inputs declared as uniforms in order, e.g. \c uniform \c float \c uTime; \c uniform \c float2 \c uDim; or as \c uniform \c float \c uInputs[16];
+ * - NanoVG with OpenGL (GLSL): \c vec4 \c main(vec2 fragCoord), with the inputs declared as \c uniform \c float \c uInputs[16];
+ * - NanoVG with Metal (MSL): \c float4 \c main(float2 fragCoord, \c constant \c float* \c uInputs)
+ *
+ * The inputs are the uniforms in EUniform order, followed by kMaxUserUniforms that can be set with SetUserUniform(), or from the delegate with a kSetUniformsMessage
+ * whose data is the floats from the first user uniform. Since the GPU does the work, effects such as glows, animated backgrounds or gradients don't need many paths */
 class IShaderControl : public IControl
 {
 public:
@@ -40,33 +44,16 @@ public:
     kR,
     kNumUniforms
   };
-  
+
+  static constexpr int kMaxUserUniforms = 9;
+  static constexpr int kSetUniformsMessage = 0;
+
   IShaderControl(const IRECT& bounds, const char* shaderStr = nullptr)
   : IControl(bounds)
+  , mStartTime(std::chrono::steady_clock::now())
   {
-    mText.mAlign = EAlign::Near;
-    mText.mVAlign = EVAlign::Top;
-        
-//    mTimer = std::unique_ptr<Timer>(Timer::Create([&](Timer& t) {
-//
-//      SetDirty(false);
-//    }, 20));
-        
-//    SetActionFunction([&](IControl* pCaller) {
-//      SetAnimation([&](IControl* pCaller) {
-//        float p = pCaller->GetAnimationProgress();
-//        mUniforms[kTime] = p;
-//
-//        if (p > 1.) {
-//          pCaller->OnEndAnimation();
-//        }
-//
-//      }, 10000);
-//    });
-
-    WDL_String err;
-    
     SetShaderStr(shaderStr ? shaderStr :
+#if defined IGRAPHICS_SKIA
     R"(
       uniform float uTime;
       uniform float2 uDim;
@@ -77,20 +64,54 @@ public:
        float2 pos = uMouse.xy/uDim.xy;
        return half4(pos.x, pos.y, 1, 1);
       }
-    )", err);
-    
-    if(err.GetLength())
-      DBGMSG("%s\n", err.Get());
+    )"
+#elif defined IGRAPHICS_METAL
+    R"(
+      float4 main(float2 fragCoord, constant float* uInputs) {
+        float2 pos = float2(uInputs[3], uInputs[4]) / float2(uInputs[1], uInputs[2]);
+        return float4(pos.x, pos.y, 1, 1);
+      }
+    )"
+#else
+    R"(
+      uniform float uInputs[16];
+
+      vec4 main(vec2 fragCoord) {
+        vec2 pos = vec2(uInputs[3], uInputs[4]) / vec2(uInputs[1], uInputs[2]);
+        return vec4(pos.x, pos.y, 1.0, 1.0);
+      }
+    )"
+#endif
+    );
+
+    SetPollDirty(mAnimated);
   }
 
   void Draw(IGraphics& g) override
   {
-    if(mRTEffect)
-      DrawShader(g, GetShaderBounds());
-    
-//    WDL_String str;
-//    str.SetFormatted(32, "%i:%i", (int) mUniforms[kX], (int) mUniforms[kY]);
-//    g.DrawText(mText, str.Get(), mRECT);
+    // the shader is compiled here, where the backend's context is current
+    if (mCompileShader)
+    {
+      mCompileShader = false;
+      mError.Set("");
+      mShader = g.CreateShader(mShaderStr.Get(), mError);
+
+      if (mError.GetLength())
+        DBGMSG("%s\n", mError.Get());
+    }
+
+    if (mShader)
+    {
+      if (mAnimated)
+        mUniforms[kTime] = std::chrono::duration<float>(std::chrono::steady_clock::now() - mStartTime).count();
+
+      g.DrawShader(*mShader, GetShaderBounds(), mUniforms.data(), static_cast<int>(mUniforms.size()), &mBlend);
+    }
+  }
+
+  bool IsDirty() override
+  {
+    return mAnimated || IControl::IsDirty();
   }
 
   void OnMouseDown(float x, float y, const IMouseMod& mod) override
@@ -103,7 +124,7 @@ public:
     mUniforms[kR] = (float) mod.R ? 1.f : 0.f;
     SetDirty(true);
   }
-  
+
   void OnMouseUp(float x, float y, const IMouseMod &mod) override
   {
     IRECT shaderBounds = GetShaderBounds();
@@ -114,7 +135,7 @@ public:
     mUniforms[kR] = 0.f;
     SetDirty(false);
   }
-  
+
   void OnMouseDrag(float x, float y, float dX, float dY, const IMouseMod &mod) override
   {
     IRECT shaderBounds = GetShaderBounds();
@@ -122,35 +143,67 @@ public:
     mUniforms[kY] = Clip(0.f, y - shaderBounds.T, shaderBounds.H());
     SetDirty(false);
   }
-  
+
   void OnResize() override
   {
     mUniforms[kWidth] = GetShaderBounds().W();
     mUniforms[kHeight] = GetShaderBounds().H();
     SetDirty(false);
   }
-  
-  bool SetShaderStr(const char* str, WDL_String& error)
+
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
   {
-    mShaderStr = SkString(str);
-    
-    auto [effect, errorText] = SkRuntimeEffect::MakeForShader(mShaderStr);
-    
-    if (!effect)
+    if (msgTag == kSetUniformsMessage)
     {
-      error.Set(errorText.c_str());
-      return false;
+      const int nValues = std::min(dataSize / static_cast<int>(sizeof(float)), kMaxUserUniforms);
+      memcpy(mUniforms.data() + kNumUniforms, pData, nValues * sizeof(float));
+      SetDirty(false);
     }
+  }
 
-    mRTEffect = effect;
-    
-    auto inputs = SkData::MakeWithoutCopy(mUniforms.data(), mRTEffect->uniformSize());
-    auto shader = mRTEffect->makeShader(std::move(inputs), nullptr, 0, nullptr, false);
-    mPaint.setShader(std::move(shader));
+  /** Set the source of the shader, which is compiled when the control is next drawn. Compile errors are then reported by GetShaderError()
+   * @param str The source, in the language of the drawing backend */
+  void SetShaderStr(const char* str)
+  {
+    mShaderStr.Set(str);
+    mShader = nullptr;
+    mCompileShader = true;
+    SetDirty(false);
+  }
 
+  /** Deprecated, since the shader is now compiled when the control is next drawn, use SetShaderStr(const char*) and GetShaderError() instead
+   * @param str The source, in the language of the drawing backend
+   * @param error Cleared, any compile errors are reported later by GetShaderError()
+   * @return \c true, since the source is not compiled until the control is drawn */
+  [[deprecated("use SetShaderStr(const char*) and GetShaderError()")]]
+  bool SetShaderStr(const char* str, WDL_String& error)
+  {
+    SetShaderStr(str);
+    error.Set("");
     return true;
   }
-  
+
+  /** @return The compiler's messages if the shader could not be compiled, or an empty string */
+  const char* GetShaderError() const { return mError.Get(); }
+
+  /** Set an input of the shader, e.g. a parameter value or a level
+   * @param idx The index of the user uniform, from 0 to kMaxUserUniforms - 1
+   * @param value The value */
+  void SetUserUniform(int idx, float value)
+  {
+    assert(idx >= 0 && idx < kMaxUserUniforms);
+    mUniforms[kNumUniforms + idx] = value;
+    SetDirty(false);
+  }
+
+  /** @param animated \c true to redraw the control every frame, with the time in seconds as the kTime uniform */
+  void SetAnimated(bool animated)
+  {
+    mAnimated = animated;
+    SetPollDirty(animated);
+    SetDirty(false);
+  }
+
 private:
   /* Override this method to only draw the shader in a sub region of the control's mRECT */
   virtual IRECT GetShaderBounds() const
@@ -158,20 +211,13 @@ private:
     return mRECT;
   }
 
-  void DrawShader(IGraphics& g, const IRECT& r)
-  {
-    SkCanvas* canvas = static_cast<SkCanvas*>(g.GetDrawContext());
-    canvas->save();
-    canvas->translate(r.L, r.T);
-    canvas->drawRect({ 0, 0, r.W(), r.H() }, mPaint);
-    canvas->restore();
-  }
-
-//  std::unique_ptr<Timer> mTimer;
-  SkPaint mPaint;
-  SkString mShaderStr;
-  sk_sp<SkRuntimeEffect> mRTEffect;
-  std::array<float, kNumUniforms> mUniforms {0.f};
+  WDL_String mShaderStr;
+  WDL_String mError;
+  IShaderPtr mShader;
+  bool mCompileShader = false;
+  bool mAnimated = false;
+  std::chrono::steady_clock::time_point mStartTime;
+  std::array<float, kNumUniforms + kMaxUserUniforms> mUniforms {0.f};
 };
 
 END_IGRAPHICS_NAMESPACE
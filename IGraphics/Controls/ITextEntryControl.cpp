@@ -102,41 +102,71 @@ void ITextEntryControl::Draw(IGraphics& g)
 {
   g.FillRect(mText.mTextEntryBGColor, mRECT);
 
-  StbTexteditRow row;
-  Layout(&row, this, 0);
+  FillCharWidthCache();
 
   const bool hasSelection = mEditState.select_start != mEditState.select_end;
-  if (hasSelection)
+  const int selectStart = std::min(mEditState.select_start, mEditState.select_end);
+  const int selectEnd = std::max(mEditState.select_start, mEditState.select_end);
+  const int nLines = static_cast<int>(mLineStarts.size());
+
+  // only the lines that intersect the bounds are drawn, so the cost doesn't grow with the length of the text
+  int firstLine = 0, lastLine = 0;
+
+  if (mMultiLine)
   {
-    float selectionStart = row.x0, selectionEnd = row.x0;
-    const int start = std::min(mEditState.select_start, mEditState.select_end);
-    const int end = std::max(mEditState.select_start, mEditState.select_end);
-    for (int i = 0; i < mCharWidths.GetSize() && i < end; ++i)
+    firstLine = std::max(static_cast<int>(mScroll / GetLineHeight()), 0);
+    lastLine = std::min(static_cast<int>((mScroll + mRECT.H()) / GetLineHeight()), nLines - 1);
+    g.PathClipRegion(mRECT);
+  }
+
+  const IText lineText = mMultiLine ? mText.WithVAlign(EVAlign::Middle) : mText;
+  const IBlend selectionBlend(EBlend::Default, 0.2f);
+
+  for (int line = firstLine; line <= lastLine; line++)
+  {
+    const int lineStart = mLineStarts[line];
+    const int lineEnd = GetLineEnd(line);
+    const IRECT lineBounds = GetLineBounds(line);
+
+    if (hasSelection && selectStart < lineEnd && selectEnd > lineStart)
     {
-      if (i < start)
-        selectionStart += mCharWidths.Get()[i];
+      const float selectionStart = GetCharX(std::max(selectStart, lineStart));
+      float selectionEnd = GetCharX(std::min(selectEnd, lineEnd));
+
+      // show that a selected new line is part of the selection
+      if (selectEnd > lineEnd)
+        selectionEnd += mText.mSize * 0.25f;
+
+      const IRECT selectionRect = IRECT(selectionStart, lineBounds.T, selectionEnd, lineBounds.B).GetVPadded(-mText.mSize*0.1f);
+      g.FillRect(mText.mTextEntryFGColor, selectionRect, &selectionBlend);
+    }
 
-      selectionEnd += mCharWidths.Get()[i];
+    if (mMultiLine)
+    {
+      const int nChars = lineEnd - lineStart;
+      g.DrawText(lineText, StringConvert{}.to_bytes(mEditString.data() + lineStart, mEditString.data() + lineStart + nChars).c_str(), lineBounds);
     }
-    IRECT selectionRect(selectionStart, mRECT.T + row.ymin, selectionEnd, mRECT.T + row.ymax);
-    selectionRect = selectionRect.GetVPadded(-mText.mSize*0.1f);
-    IBlend blend(EBlend::Default, 0.2f);
-    g.FillRect(mText.mTextEntryFGColor, selectionRect, &blend);
   }
 
-  g.DrawText(mText, StringConvert{}.to_bytes(mEditString).c_str(), mRECT);
-  
+  if (!mMultiLine)
+    g.DrawText(mText, StringConvert{}.to_bytes(mEditString).c_str(), mRECT);
+
   if (mDrawCursor && !hasSelection)
   {
-    float cursorPos = row.x0;
-    for (int i = 0; i < mCharWidths.GetSize() && i < mEditState.cursor; ++i)
+    const int line = GetLineForChar(mEditState.cursor);
+
+    if (line >= firstLine && line <= lastLine)
     {
-      cursorPos += mCharWidths.Get()[i];
+      const float cursorPos = GetCharX(mEditState.cursor);
+      const IRECT lineBounds = GetLineBounds(line);
+      IRECT cursorRect(roundf(cursorPos-1), lineBounds.T, roundf(cursorPos), lineBounds.B);
+      cursorRect = cursorRect.GetVPadded(-mText.mSize*0.1f);
+      g.FillRect(mText.mTextEntryFGColor, cursorRect);
     }
-    IRECT cursorRect(roundf(cursorPos-1), mRECT.T + row.ymin, roundf(cursorPos), mRECT.T + row.ymax);
-    cursorRect = cursorRect.GetVPadded(-mText.mSize*0.1f);
-    g.FillRect(mText.mTextEntryFGColor, cursorRect);
   }
+
+  if (mMultiLine)
+    g.PathClipRegion();
 }
 
 template<typename Proc>
@@ -165,7 +195,7 @@ void ITextEntryControl::OnMouseDown(float x, float y, const IMouseMod& mod)
   if(mod.L)
   {
     CallSTB ([&]() {
-      stb_textedit_click(this, &mEditState, x, y);
+      stb_textedit_click(this, &mEditState, x, y - mRECT.T + mScroll);
     });
   }
   
@@ -191,7 +221,7 @@ void ITextEntryControl::OnMouseDrag(float x, float y, float dX, float dY, const
   if (mod.L)
   {
     CallSTB([&]() {
-      stb_textedit_drag(this, &mEditState, x, y);
+      stb_textedit_drag(this, &mEditState, x, y - mRECT.T + mScroll);
     });
   }
 }
@@ -201,12 +231,18 @@ void ITextEntryControl::OnMouseDblClick(float x, float y, const IMouseMod& mod)
   SelectAll();
 }
 
+void ITextEntryControl::OnMouseWheel(float x, float y, const IMouseMod& mod, float d)
+{
+  if (mMultiLine)
+    SetScroll(mScroll - d * GetLineHeight() * 3.f);
+}
+
 void ITextEntryControl::OnMouseUp(float x, float y, const IMouseMod& mod)
 {
   if (mod.L)
   {
     CallSTB([&]() {
-      stb_textedit_drag(this, &mEditState, x, y);
+      stb_textedit_drag(this, &mEditState, x, y - mRECT.T + mScroll);
     });
 
     SetDirty(true);
@@ -271,7 +307,17 @@ bool ITextEntryControl::OnKeyDown(float x, float y, const IKeyPress& key)
     case kVK_NEXT: stbKey = STB_TEXTEDIT_K_PGDOWN; break;
     case kVK_HOME: stbKey = STB_TEXTEDIT_K_LINESTART; break;
     case kVK_END: stbKey = STB_TEXTEDIT_K_LINEEND; break;
-    case kVK_RETURN: CommitEdit(); break;
+    case kVK_RETURN:
+    {
+      if (mMultiLine && !key.C)
+      {
+        stbKey = STB_TEXTEDIT_NEWLINE;
+        break;
+      }
+
+      CommitEdit();
+      break;
+    }
     case kVK_ESCAPE: DismissEdit(); break;
     default:
     {
@@ -382,8 +428,7 @@ void ITextEntryControl::SelectAll()
 int ITextEntryControl::DeleteChars(ITextEntryControl* _this, size_t pos, size_t num)
 {
   _this->mEditString.erase(pos, num);
-  _this->SetStr(StringConvert{}.to_bytes(_this->mEditString).c_str());
-  _this->OnTextChange();
+  _this->OnCharsDeleted(static_cast<int>(pos), static_cast<int>(num));
   return true; // TODO: Error checking
 }
 
@@ -391,8 +436,7 @@ int ITextEntryControl::DeleteChars(ITextEntryControl* _this, size_t pos, size_t
 int ITextEntryControl::InsertChars(ITextEntryControl* _this, size_t pos, const char16_t* text, size_t num)
 {
   _this->mEditString.insert(pos, text, num);
-  _this->SetStr(StringConvert{}.to_bytes(_this->mEditString).c_str());
-  _this->OnTextChange();
+  _this->OnCharsInserted(static_cast<int>(pos), static_cast<int>(num));
   return true;
 }
 
@@ -411,40 +455,26 @@ int ITextEntryControl::GetLength(ITextEntryControl* _this)
 //static
 void ITextEntryControl::Layout(StbTexteditRow* row, ITextEntryControl* _this, int start_i)
 {
-  assert (start_i == 0);
-
   _this->FillCharWidthCache();
-  float textWidth = 0.;
-  
-  for (int i = 0; i < _this->mCharWidths.GetSize(); i++)
-  {
-    textWidth += _this->mCharWidths.Get()[i];
-  }
-  
-  row->num_chars = GetLength(_this);
-  row->baseline_y_delta = 1.25;
 
-  switch (_this->GetText().mAlign)
+  const int line = _this->GetLineForChar(start_i);
+  const float textWidth = _this->mLineWidths[line];
+
+  // a row includes its new line character
+  row->num_chars = (line + 1 < static_cast<int>(_this->mLineStarts.size()) ? _this->mLineStarts[line + 1] : GetLength(_this)) - start_i;
+  row->x0 = _this->GetLineX(line);
+  row->x1 = row->x0 + textWidth;
+
+  if (_this->mMultiLine)
   {
-    case EAlign::Near:
-    {
-      row->x0 = _this->GetRECT().L;
-      row->x1 = row->x0 + textWidth;
-      break;
-    }
-    case EAlign::Center:
-    {
-      row->x0 = _this->GetRECT().MW() - (textWidth * 0.5f);
-      row->x1 = row->x0 + textWidth;
-      break;
-    }
-    case EAlign::Far:
-    {
-      row->x0 = _this->GetRECT().R - textWidth;
-      row->x1 = row->x0 + textWidth;
-    }
+    row->ymin = 0.f;
+    row->ymax = _this->GetLineHeight();
+    row->baseline_y_delta = _this->GetLineHeight();
+    return;
   }
 
+  row->baseline_y_delta = 1.25;
+
   switch (_this->GetText().mVAlign)
   {
     case EVAlign::Top:
@@ -471,39 +501,189 @@ void ITextEntryControl::Layout(StbTexteditRow* row, ITextEntryControl* _this, in
 float ITextEntryControl::GetCharWidth(ITextEntryControl* _this, int n, int i)
 {
   _this->FillCharWidthCache();
-  return _this->mCharWidths.Get()[i]; // TODO: n not used?
+  return _this->mCharWidths[n + i];
 }
 
 void ITextEntryControl::OnStateChanged()
 {
+  ScrollToCursor();
   SetDirty(false);
 }
 
-void ITextEntryControl::OnTextChange()
+void ITextEntryControl::FillCharWidthCache()
 {
-  mCharWidths.Resize(0, false);
-  FillCharWidthCache();
+  // only calculate when the text has been replaced, edits update the widths around them
+  if (mLayoutValid)
+    return;
+
+  const int len = static_cast<int>(mEditString.size());
+  mCharWidths.resize(len);
+  for (int i = 0; i < len; ++i)
+  {
+    mCharWidths[i] = GetCharAdvance(mEditString[i], i == 0 ? 0 : mEditString[i - 1]);
+  }
+
+  UpdateLines();
+  mLayoutValid = true;
 }
 
-void ITextEntryControl::FillCharWidthCache()
+void ITextEntryControl::OnCharsInserted(int pos, int num)
 {
-  // only calculate when empty
-  if (mCharWidths.GetSize())
+  if (!mLayoutValid)
     return;
 
   const int len = static_cast<int>(mEditString.size());
-  mCharWidths.Resize(len, false);
+  mCharWidths.insert(mCharWidths.begin() + pos, num, 0.f);
+
+  // the character after the insertion is measured again, since its advance depends on the character before it
+  for (int i = pos; i < std::min(pos + num + 1, len); ++i)
+  {
+    mCharWidths[i] = GetCharAdvance(mEditString[i], i == 0 ? 0 : mEditString[i - 1]);
+  }
+
+  UpdateLines();
+}
+
+void ITextEntryControl::OnCharsDeleted(int pos, int num)
+{
+  if (!mLayoutValid)
+    return;
+
+  mCharWidths.erase(mCharWidths.begin() + pos, mCharWidths.begin() + pos + num);
+
+  if (pos < static_cast<int>(mEditString.size()))
+    mCharWidths[pos] = GetCharAdvance(mEditString[pos], pos == 0 ? 0 : mEditString[pos - 1]);
+
+  UpdateLines();
+}
+
+void ITextEntryControl::UpdateLines()
+{
+  // this only sums the cached widths, no text is measured
+  const int len = static_cast<int>(mEditString.size());
+  mLineStarts.assign(1, 0);
+  mLineWidths.assign(1, 0.f);
+
   for (int i = 0; i < len; ++i)
   {
-    mCharWidths.Get()[i] = MeasureCharWidth(mEditString[i], i == 0 ? 0 : mEditString[i - 1]);
+    mLineWidths.back() += mCharWidths[i];
+
+    if (mMultiLine && mEditString[i] == '\n')
+    {
+      mLineStarts.push_back(i + 1);
+      mLineWidths.push_back(0.f);
+    }
+  }
+}
+
+int ITextEntryControl::GetLineForChar(int charIdx) const
+{
+  const auto it = std::upper_bound(mLineStarts.begin(), mLineStarts.end(), charIdx);
+  return std::max(static_cast<int>(it - mLineStarts.begin()) - 1, 0);
+}
+
+int ITextEntryControl::GetLineEnd(int line) const
+{
+  // the end of the visible characters, before the new line
+  if (line + 1 < static_cast<int>(mLineStarts.size()))
+    return mLineStarts[line + 1] - 1;
+
+  return static_cast<int>(mEditString.size());
+}
+
+float ITextEntryControl::GetLineX(int line) const
+{
+  const float textWidth = mLineWidths[line];
+
+  switch (mText.mAlign)
+  {
+    case EAlign::Near: return mRECT.L;
+    case EAlign::Center: return mRECT.MW() - (textWidth * 0.5f);
+    case EAlign::Far: return mRECT.R - textWidth;
+  }
+
+  return mRECT.L;
+}
+
+float ITextEntryControl::GetCharX(int charIdx) const
+{
+  const int line = GetLineForChar(charIdx);
+  float x = GetLineX(line);
+
+  for (int i = mLineStarts[line]; i < charIdx && i < static_cast<int>(mCharWidths.size()); ++i)
+  {
+    x += mCharWidths[i];
+  }
+
+  return x;
+}
+
+IRECT ITextEntryControl::GetLineBounds(int line) const
+{
+  if (!mMultiLine)
+  {
+    StbTexteditRow row;
+    Layout(&row, const_cast<ITextEntryControl*>(this), 0);
+    return IRECT(mRECT.L, mRECT.T + row.ymin, mRECT.R, mRECT.T + row.ymax);
+  }
+
+  const float top = mRECT.T + line * GetLineHeight() - mScroll;
+  return IRECT(mRECT.L, top, mRECT.R, top + GetLineHeight());
+}
+
+void ITextEntryControl::SetScroll(float scroll)
+{
+  const float maxScroll = std::max(mLineStarts.size() * GetLineHeight() - mRECT.H(), 0.f);
+  scroll = Clip(scroll, 0.f, maxScroll);
+
+  if (scroll != mScroll)
+  {
+    mScroll = scroll;
+    SetDirty(false);
   }
 }
 
+void ITextEntryControl::ScrollToCursor()
+{
+  if (!mMultiLine)
+    return;
+
+  FillCharWidthCache();
+
+  const float top = GetLineForChar(mEditState.cursor) * GetLineHeight();
+  const float bottom = top + GetLineHeight();
+
+  if (top < mScroll)
+    SetScroll(top);
+  else if (bottom > mScroll + mRECT.H())
+    SetScroll(bottom - mRECT.H());
+}
+
 void ITextEntryControl::CalcCursorSizes()
 {
   //TODO: cache cursor size and location?
 }
 
+float ITextEntryControl::GetCharAdvance(char16_t c, char16_t pc)
+{
+  if (c == '\n')
+    return 0.f;
+
+  // the text at the start of a line isn't kerned with the previous line
+  if (pc == '\n')
+    pc = 0;
+
+  const uint32_t key = (static_cast<uint32_t>(pc) << 16) | c;
+  const auto it = mAdvanceCache.find(key);
+
+  if (it != mAdvanceCache.end())
+    return it->second;
+
+  const float width = MeasureCharWidth(c, pc);
+  mAdvanceCache[key] = width;
+  return width;
+}
+
 // the width of character 'c' should include the kerning between it and the next character,
 // so that when adding up character widths in the cache we can get to the beginning of the visible glyph,
 // which is important for cursor placement to look correct.
@@ -532,10 +712,14 @@ void ITextEntryControl::CreateTextEntry(int paramIdx, const IText& text, const I
   SetTargetAndDrawRECTs(bounds);
   SetText(text);
   mText.mFGColor = mText.mTextEntryFGColor;
+  mAdvanceCache.clear();
+  mMultiLine = mAllowMultiLine && bounds.H() >= GetLineHeight() * 2.f;
+  stb_textedit_initialize_state(&mEditState, !mMultiLine);
+  mScroll = 0.f;
   SetStr(str);
   SelectAll();
   mEditState.cursor = 0;
-  OnTextChange();
+  FillCharWidthCache();
   SetDirty(true);
   mEditing = true;
 }
@@ -558,6 +742,6 @@ void ITextEntryControl::CommitEdit()
 
 void ITextEntryControl::SetStr(const char* str)
 {
-  mCharWidths.Resize(0, false);
+  mLayoutValid = false;
   mEditString = StringConvert{}.from_bytes(std::string(str));
 }
@@ -47,6 +47,7 @@ public:
   void OnMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod) override;
   void OnMouseUp(float x, float y, const IMouseMod& mod) override;
   void OnMouseDblClick(float x, float y, const IMouseMod& mod) override;
+  void OnMouseWheel(float x, float y, const IMouseMod& mod, float d) override;
   void OnEndAnimation() override;
   
   static int DeleteChars(ITextEntryControl* _this, size_t pos, size_t num);
@@ -62,6 +63,14 @@ public:
 
   void CreateTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str);
 
+  /** Allow text entries that are at least two lines tall to be edited as multiple lines of text, e.g. for a code editor.
+   * In a multi-line entry Return inserts a new line and Ctrl/Cmd + Return commits the edit. Only the visible lines are drawn
+   * @param allow \c true to allow multi-line text entries */
+  void SetAllowMultiLine(bool allow) { mAllowMultiLine = allow; }
+
+  /** @return \c true if the current text entry is multi-line */
+  bool IsMultiLine() const { return mMultiLine; }
+
 private:
     
   void SetStr(const char* str);
@@ -69,10 +78,21 @@ private:
   template<typename Proc>
   bool CallSTB(Proc proc);
   void OnStateChanged();
-  void OnTextChange();
   void FillCharWidthCache();
+  void OnCharsInserted(int pos, int num);
+  void OnCharsDeleted(int pos, int num);
+  void UpdateLines();
   void CalcCursorSizes();
   float MeasureCharWidth(char16_t c, char16_t nc);
+  float GetCharAdvance(char16_t c, char16_t pc);
+  int GetLineForChar(int charIdx) const;
+  int GetLineEnd(int line) const;
+  float GetLineX(int line) const;
+  float GetCharX(int charIdx) const;
+  float GetLineHeight() const { return mText.mSize * 1.25f; }
+  IRECT GetLineBounds(int line) const;
+  void SetScroll(float scroll);
+  void ScrollToCursor();
   void CopySelection();
   void Paste();
   void Cut();
@@ -84,9 +104,16 @@ private:
   bool mCursorIsSet = false;
   bool mCursorSizesValid = false;
   bool mNotifyTextChange = false;
+  bool mLayoutValid = false;
+  bool mAllowMultiLine = false;
+  bool mMultiLine = false;
+  float mScroll = 0.f;
 
   STB_TexteditState mEditState;
-  WDL_TypedBuf<float> mCharWidths;
+  std::vector<float> mCharWidths; // the advance of each character, measured again only around an edit
+  std::vector<int> mLineStarts; // the index of the first character of each line
+  std::vector<float> mLineWidths;
+  std::unordered_map<uint32_t, float> mAdvanceCache; // keyed by a character and the one before it
   std::u16string mEditString;
 };
 
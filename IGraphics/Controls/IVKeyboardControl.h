@@ -184,6 +184,12 @@ public:
     }
   }
 
+  void OnMemoryWarning() override
+  {
+    mLayer = nullptr;
+    IControl::OnMemoryWarning();
+  }
+
   void OnResize() override
   {
     float r = mRECT.W() / mTargetRECT.W();
@@ -217,8 +223,6 @@ public:
         break;
       default: break;
     }
-
-    SetDirty(false);
   }
 
   void DrawKey(IGraphics& g, const IRECT& bounds, const IColor& color)
@@ -231,7 +235,11 @@ public:
       g.FillRect(color, bounds/*, &blend*/);
   }
 
-  void Draw(IGraphics& g) override
+  /** Draw a range of keys, followed by the frame
+   * @param first The index of the first key
+   * @param last The index of the last key
+   * @param withState Draw the pressed and highlighted keys, rather than the keyboard at rest */
+  void DrawKeys(IGraphics& g, int first, int last, bool withState)
   {
     IColor shadowColor = IColor(60, 0, 0, 0);
 
@@ -239,16 +247,16 @@ public:
     float BKWidth = GetBKWidth();
 
     // first draw white keys
-    for (int i = 0; i < NKeys(); ++i)
+    for (int i = first; i <= last; ++i)
     {
       if (!IsBlackKey(i))
       {
         float kL = *GetKeyXPos(i);
         IRECT keyBounds = IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
 
-        DrawKey(g, keyBounds, i == mHighlight ? mHK_COLOR : mWK_COLOR);
+        DrawKey(g, keyBounds, withState && i == mHighlight ? mHK_COLOR : mWK_COLOR);
 
-        if (GetKeyIsPressed(i))
+        if (withState && GetKeyIsPressed(i))
         {
           // draw played white key
           DrawKey(g, keyBounds, mPK_COLOR);
@@ -275,19 +283,19 @@ public:
     }
 
     // then blacks
-    for (int i = 0; i < NKeys(); ++i)
+    for (int i = first; i <= last; ++i)
     {
       if (IsBlackKey(i))
       {
         float kL = *GetKeyXPos(i);
         IRECT keyBounds = IRECT(kL, mRECT.T, kL + BKWidth, BKBottom);
         // first draw underlying shadows
-        if (mDrawShadows && !GetKeyIsPressed(i) && i < NKeys() - 1)
+        if (mDrawShadows && !(withState && GetKeyIsPressed(i)) && i < NKeys() - 1)
         {
           IRECT shadowBounds = keyBounds;
           float w = shadowBounds.W();
           shadowBounds.L += 0.6f * w;
-          if (GetKeyIsPressed(i + 1))
+          if (withState && GetKeyIsPressed(i + 1))
           {
             // if white to the right is pressed, shadow is longer
             w *= 1.3f;
@@ -296,9 +304,9 @@ public:
           shadowBounds.R = shadowBounds.L + w;
           DrawKey(g, shadowBounds, shadowColor);
         }
-        DrawKey(g, keyBounds, (i == mHighlight ? mHK_COLOR : mBK_COLOR.WithContrast(IsDisabled() ? GRAYED_ALPHA : 0.f)));
+        DrawKey(g, keyBounds, (withState && i == mHighlight ? mHK_COLOR : mBK_COLOR.WithContrast(IsDisabled() ? GRAYED_ALPHA : 0.f)));
 
-        if (GetKeyIsPressed(i))
+        if (withState && GetKeyIsPressed(i))
         {
           // draw pressed black key
           IColor cBP = mPK_COLOR;
@@ -321,6 +329,31 @@ public:
 
     if (mDrawFrame)
       g.DrawRect(mFR_COLOR, mRECT, &mBlend, mFrameThickness);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    // the keyboard with no keys pressed is cached, and the pressed and highlighted keys are drawn over it
+    if (!g.CheckLayer(mLayer))
+    {
+      g.StartLayer(this, mRECT);
+      DrawKeys(g, 0, NKeys() - 1, false);
+      mLayer = g.EndLayer();
+    }
+
+    g.DrawLayer(mLayer, &mBlend);
+
+    for (int i = 0; i < NKeys(); ++i)
+    {
+      if (GetKeyIsPressed(i) || i == mHighlight)
+      {
+        // the neighbouring keys overlap the key and its shadows, so they are drawn again within its bounds
+        g.PathClipRegion(GetKeyDrawBounds(i));
+        DrawKeys(g, std::max(i - 2, 0), std::min(i + 2, NKeys() - 1), true);
+      }
+    }
+
+    g.PathClipRegion();
 
     if (mShowNoteAndVel)
     {
@@ -390,20 +423,42 @@ public:
 
   void SetKeyIsPressed(int key, bool pressed)
   {
+    if (key < 0 || key >= NKeys() || GetKeyIsPressed(key) == pressed)
+      return;
+
     mPressedKeys.Get()[key] = pressed;
-    SetDirty(false);
+    SetDirtyRECT(GetKeyDrawBounds(key));
   }
   
   void SetKeyHighlight(int key)
   {
+    if (key == mHighlight)
+      return;
+
+    if (mHighlight > -1 && mHighlight < NKeys())
+      SetDirtyRECT(GetKeyDrawBounds(mHighlight));
+
     mHighlight = key;
-    SetDirty(false);
+
+    if (mHighlight > -1 && mHighlight < NKeys())
+      SetDirtyRECT(GetKeyDrawBounds(mHighlight));
   }
 
   void ClearNotesFromMidi()
   {
+    for (int i = 0; i < NKeys(); ++i)
+    {
+      if (GetKeyIsPressed(i))
+        SetDirtyRECT(GetKeyDrawBounds(i));
+    }
+
     memset(mPressedKeys.Get(), 0, mPressedKeys.GetSize() * sizeof(bool));
-    SetDirty(false);
+  }
+
+  void SetDisabled(bool disable) override
+  {
+    InvalidateLayer();
+    IControl::SetDisabled(disable);
   }
 
   void SetBlackToWhiteRatios(float widthRatio, float heightRatio = 0.6)
@@ -428,6 +483,7 @@ public:
       }
     }
 
+    InvalidateLayer();
     SetDirty(false);
   }
 
@@ -441,6 +497,7 @@ public:
 
     if (keepAspectRatio)
       SetWidth(mRECT.W() * r);
+    InvalidateLayer();
     SetDirty(false);
   }
 
@@ -462,6 +519,7 @@ public:
     if (keepAspectRatio)
       SetHeight(mRECT.H() * r);
 
+    InvalidateLayer();
     SetDirty(false);
   }
 
@@ -499,6 +557,7 @@ public:
       mBKAlpha = Clip(mBKAlpha, 15.f, 255.f);
     }
 
+    InvalidateLayer();
     SetDirty(false);
   }
 
@@ -594,6 +653,7 @@ private:
     }
 
     mTargetRECT = mRECT;
+    InvalidateLayer();
     SetDirty(false);
   }
 
@@ -687,6 +747,30 @@ private:
     return w;
   }
 
+  /** @return The area that changes when a key is pressed or highlighted, which includes the shadows it casts and that are cast on it */
+  IRECT GetKeyDrawBounds(int i)
+  {
+    const float kL = *GetKeyXPos(i);
+    IRECT bounds;
+
+    if (IsBlackKey(i))
+    {
+      const float BKWidth = GetBKWidth();
+      const float BKHeight = mRECT.H() * mBKHeightRatio;
+      bounds = IRECT(kL, mRECT.T, kL + 1.9f * BKWidth, mRECT.T + 1.05f * BKHeight);
+    }
+    else
+      bounds = IRECT(kL, mRECT.T, kL + mWKWidth, mRECT.B);
+
+    return bounds.GetPadded(mFrameThickness);
+  }
+
+  void InvalidateLayer()
+  {
+    if (mLayer)
+      mLayer->Invalidate();
+  }
+
   void TriggerMidiMsgFromKeyPress(int key, int velocity)
   {
     IMidiMsg msg;
@@ -726,6 +810,7 @@ protected:
   WDL_TypedBuf<bool> mPressedKeys;
   WDL_TypedBuf<float> mKeyXPos;
   int mHighlight = -1;
+  ILayerPtr mLayer;
 };
 
 /** Vectorial "wheel" control for pitchbender/modwheel
@@ -763,6 +848,12 @@ public:
     });
   }
   
+  void OnMemoryWarning() override
+  {
+    mLayer = nullptr;
+    ISliderControlBase::OnMemoryWarning();
+  }
+
   void Draw(IGraphics& g) override
   {
     IRECT handleBounds = mRECT.GetPadded(-10.f);
@@ -0,0 +1,267 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup IControls
+ * @copydoc IVListControl
+ */
+
+#include "IControl.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A vectorial scrolling list for a large number of items, e.g. a sample or preset browser with thousands of entries.
+ * The items are not stored by the control, they are got from a data source function as their rows are drawn, and only the visible rows
+ * are drawn. Rows have a fixed height, so finding the row under the mouse is a division rather than a search
+ * @ingroup IControls */
+class IVListControl : public IControl
+                    , public IVectorBase
+{
+public:
+  /** Called to get the text of an item as its row is drawn */
+  using ItemTextFunc = std::function<void(int itemIdx, WDL_String& str)>;
+
+  /** Called to draw a row in place of the default text, e.g. to add an icon */
+  using ItemDrawFunc = std::function<void(IGraphics& g, const IRECT& bounds, int itemIdx, bool selected)>;
+
+  /** Constructs an IVListControl
+   * @param bounds The control's bounds
+   * @param textFunc The data source, called for the visible rows
+   * @param nItems The number of items
+   * @param label The label for the list
+   * @param style The styling of this vector control \see IVStyle
+   * @param rowHeight The height of each row */
+  IVListControl(const IRECT& bounds, ItemTextFunc textFunc, int nItems = 0, const char* label = "", const IVStyle& style = DEFAULT_STYLE, float rowHeight = 20.f)
+  : IControl(bounds)
+  , IVectorBase(style)
+  , mTextFunc(textFunc)
+  , mNItems(nItems)
+  , mRowHeight(rowHeight)
+  {
+    assert(rowHeight > 0.f);
+    mText = style.valueText.WithAlign(EAlign::Near);
+    AttachIControl(this, label);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackground(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if (mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, &mBlend, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    const IRECT listBounds = GetListBounds();
+    const int firstRow = std::max(static_cast<int>(mScroll / mRowHeight), 0);
+    const int lastRow = std::min(static_cast<int>((mScroll + listBounds.H()) / mRowHeight), mNItems - 1);
+
+    g.PathClipRegion(listBounds);
+
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+      const IRECT rowBounds = GetRowBounds(row);
+      const bool selected = row == mSelectedRow;
+
+      if (selected)
+        g.FillRect(GetColor(kPR), rowBounds, &mBlend);
+      else if (row == mMouseOverRow)
+        g.FillRect(GetColor(kHL), rowBounds, &mBlend);
+
+      if (mDrawFunc)
+      {
+        mDrawFunc(g, rowBounds, row, selected);
+      }
+      else
+      {
+        mTextFunc(row, mItemText);
+        g.DrawText(mText, mItemText.Get(), rowBounds.GetHPadded(-mStyle.frameThickness - 2.f), &mBlend);
+      }
+    }
+
+    g.PathClipRegion();
+    DrawScrollBar(g);
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetScroll(mScroll);
+    SetDirty(false);
+  }
+
+  void OnMouseDown(float x, float y, const IMouseMod& mod) override
+  {
+    mDragStartY = y;
+    mDragStartScroll = mScroll;
+
+    const int row = GetRowAt(x, y);
+
+    if (row > -1)
+      SelectRow(row);
+  }
+
+  void OnMouseDrag(float x, float y, float dX, float dY, const IMouseMod& mod) override
+  {
+    SetScroll(mDragStartScroll - (y - mDragStartY));
+  }
+
+  void OnMouseWheel(float x, float y, const IMouseMod& mod, float d) override
+  {
+    SetScroll(mScroll - d * mRowHeight * 3.f);
+    OnMouseOver(x, y, mod);
+  }
+
+  void OnMouseOver(float x, float y, const IMouseMod& mod) override
+  {
+    const int row = GetRowAt(x, y);
+
+    if (row != mMouseOverRow)
+    {
+      mMouseOverRow = row;
+      SetDirty(false);
+    }
+
+    IControl::OnMouseOver(x, y, mod);
+  }
+
+  void OnMouseOut() override
+  {
+    mMouseOverRow = -1;
+    IControl::OnMouseOut();
+  }
+
+  /** Set the number of items, e.g. when the data source has changed. The selection is kept if it is still an item */
+  void SetNItems(int nItems)
+  {
+    mNItems = std::max(nItems, 0);
+
+    if (mSelectedRow >= mNItems)
+      mSelectedRow = -1;
+
+    mMouseOverRow = -1;
+    SetScroll(mScroll);
+    SetDirty(false);
+  }
+
+  /** @return The number of items */
+  int GetNItems() const { return mNItems; }
+
+  /** Select an item, scroll to it, and call the action function
+   * @param row The index of the item, or -1 to select nothing */
+  void SelectRow(int row)
+  {
+    mSelectedRow = Clip(row, -1, mNItems - 1);
+
+    if (mSelectedRow > -1)
+      ScrollToRow(mSelectedRow);
+
+    SetDirty(true);
+  }
+
+  /** @return The index of the selected item, or -1 if nothing is selected */
+  int GetSelectedRow() const { return mSelectedRow; }
+
+  /** Scroll the least distance so that a row is visible
+   * @param row The index of the item */
+  void ScrollToRow(int row)
+  {
+    const float top = row * mRowHeight;
+    const float bottom = top + mRowHeight;
+    const float height = GetListBounds().H();
+
+    if (top < mScroll)
+      SetScroll(top);
+    else if (bottom > mScroll + height)
+      SetScroll(bottom - height);
+  }
+
+  /** @return The index of the item at a point, or -1 if there isn't one */
+  int GetRowAt(float x, float y) const
+  {
+    const IRECT listBounds = GetListBounds();
+
+    if (!listBounds.Contains(x, y))
+      return -1;
+
+    const int row = static_cast<int>((y - listBounds.T + mScroll) / mRowHeight);
+    return row < mNItems ? row : -1;
+  }
+
+  /** Draw the rows with a function rather than as text from the data source
+   * @param func The function, or nullptr to draw text */
+  void SetItemDrawFunc(ItemDrawFunc func) { mDrawFunc = func; SetDirty(false); }
+
+private:
+  /** @return The area the rows are drawn in, which leaves room for the scroll bar */
+  IRECT GetListBounds() const
+  {
+    return mWidgetBounds.GetReducedFromRight(kScrollBarWidth);
+  }
+
+  IRECT GetRowBounds(int row) const
+  {
+    const IRECT listBounds = GetListBounds();
+    const float top = listBounds.T + row * mRowHeight - mScroll;
+    return IRECT(listBounds.L, top, listBounds.R, top + mRowHeight);
+  }
+
+  float GetMaxScroll() const
+  {
+    return std::max(mNItems * mRowHeight - GetListBounds().H(), 0.f);
+  }
+
+  void SetScroll(float scroll)
+  {
+    scroll = Clip(scroll, 0.f, GetMaxScroll());
+
+    if (scroll != mScroll)
+    {
+      mScroll = scroll;
+      SetDirty(false);
+    }
+  }
+
+  void DrawScrollBar(IGraphics& g)
+  {
+    const float contentHeight = mNItems * mRowHeight;
+    const IRECT track = mWidgetBounds.GetFromRight(kScrollBarWidth);
+
+    if (contentHeight <= track.H())
+      return;
+
+    const float handleHeight = std::max(track.H() * track.H() / contentHeight, kScrollBarWidth);
+    const float handleTop = track.T + (track.H() - handleHeight) * (mScroll / GetMaxScroll());
+    g.FillRoundRect(GetColor(kX1), IRECT(track.L + 1.f, handleTop, track.R - 1.f, handleTop + handleHeight), (kScrollBarWidth - 2.f) * 0.5f, &mBlend);
+  }
+
+  static constexpr float kScrollBarWidth = 8.f;
+
+  ItemTextFunc mTextFunc;
+  ItemDrawFunc mDrawFunc = nullptr;
+  WDL_String mItemText;
+  int mNItems;
+  float mRowHeight;
+  float mScroll = 0.f;
+  int mSelectedRow = -1;
+  int mMouseOverRow = -1;
+  float mDragStartY = 0.f;
+  float mDragStartScroll = 0.f;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -41,6 +41,7 @@ public:
   , mHighRangeDB(highRangeDB)
   , mMarkers(markers)
   {
+    mRedrawChangedTracksOnly = true;
   }
   
   void SetResponse(EResponse response)
@@ -66,7 +67,7 @@ public:
   
   void DrawPeak(IGraphics& g, const IRECT& r, int chIdx, bool aboveBaseValue) override
   {
-    g.FillRect(IVTrackControlBase::GetColor(kX1), r, &mBlend);
+    FillTrackRect(g, IVTrackControlBase::GetColor(kX1), r, kTrackFillPeak);
   }
   
   void DrawMarkers(IGraphics& g)
@@ -118,20 +119,30 @@ public:
         {
           auto ampValue = AmpToDB(static_cast<double>(d.vals[c]));
           auto linearPos = (ampValue + lowPointAbs)/rangeDB;
-          SetValue(Clip(linearPos, 0., 1.), c);
+          SetTrackValue(Clip(linearPos, 0., 1.), c);
         }
       }
       else
       {
         for (auto c = d.chanOffset; c < (d.chanOffset + d.nChans); c++)
         {
-          SetValue(Clip(static_cast<double>(d.vals[c]), 0., 1.), c);
+          SetTrackValue(Clip(static_cast<double>(d.vals[c]), 0., 1.), c);
         }
       }
-
-      SetDirty(false);
     }
   }
+  
+protected:
+  /** Set the value of a track, and only redraw the track if the value has changed */
+  void SetTrackValue(double value, int trackIdx)
+  {
+    if (value != GetValue(trackIdx))
+    {
+      SetValue(value, trackIdx);
+      SetTrackDirty(trackIdx);
+    }
+  }
+
 protected:
   float mHighRangeDB;
   float mLowRangeDB;
@@ -155,7 +166,6 @@ public:
   
   void DrawPeak(IGraphics& g, const IRECT& r, int chIdx, bool aboveBaseValue) override
   {
-    IBlend blend = IVTrackControlBase::GetBlend();
     float trackPos = mPeakValues[chIdx];
     EVColor colorIdx = kX1;
     
@@ -184,7 +194,7 @@ public:
       peakRect.T = r.T;
       peakRect.B = r.B;
     }
-    g.FillRect(IVTrackControlBase::GetColor(colorIdx), peakRect, &blend);
+    IVTrackControlBase::FillTrackRect(g, IVTrackControlBase::GetColor(colorIdx), peakRect, IVTrackControlBase::kTrackFillPeak);
   }
 
   void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
@@ -210,16 +220,21 @@ public:
         double linearPeakPos = (peakValue + lowPointAbs)/rangeDB;
         double linearAvgPos = (avgValue + lowPointAbs)/rangeDB;
 
-        IVTrackControlBase::SetValue(Clip(linearAvgPos, 0., 1.), c);
-        mPeakValues[c] = static_cast<float>(linearPeakPos);
+        const float peakPos = static_cast<float>(linearPeakPos);
+        
+        if (peakPos != mPeakValues[c])
+        {
+          mPeakValues[c] = peakPos;
+          IVTrackControlBase::SetTrackDirty(c);
+        }
+        
+        IVMeterControl<MAXNC>::SetTrackValue(Clip(linearAvgPos, 0., 1.), c);
       }
-
-      IVTrackControlBase::SetDirty(false);
     }
   }
   
 protected:
-  std::array<float, MAXNC> mPeakValues;
+  std::array<float, MAXNC> mPeakValues {};
 };
 
 const static IColor LED1 = {255, 36, 157, 16};
@@ -300,33 +315,44 @@ public:
     const float valPos = (dir == EDirection::Vertical) ? r.B - (val * r.H()) : r.R - ((1.f-val) * r.W()); // threshold position for testing segment
     
     int segIdx = 0; // keep track of how many segments have been drawn
+    mSegRects.clear();
+    mSegColors.clear();
 
     for (auto ledRange : mLEDRanges)
     {
       for (auto i = 0; i < ledRange.nSegs; i++)
       {
         IRECT segRect;
+        bool lit;
+        
         if (dir == EDirection::Vertical)
         {
           segRect = r.GetGridCell(segIdx + i, totalNSegs, 1, dir, 1);
-        
-          if (segRect.MH() > valPos)
-            g.FillRect(ledRange.color, segRect.GetPadded(-1.f));
+          lit = segRect.MH() > valPos;
         }
         else
         {
           segRect = r.GetGridCell(totalNSegs - 1 - (segIdx + i), 1, totalNSegs, dir, 1);
+          lit = segRect.MW() < valPos;
+        }
         
-          if (segRect.MW() < valPos)
-            g.FillRect(ledRange.color, segRect.GetPadded(-1.f));
+        if (lit)
+        {
+          mSegRects.push_back(segRect.GetPadded(-1.f));
+          mSegColors.push_back(ledRange.color);
         }
       }
       segIdx += ledRange.nSegs;
     }
+    
+    // the segments of each range are filled together
+    g.FillRects(mSegRects.data(), mSegColors.data(), static_cast<int>(mSegRects.size()));
   }
 
 private:
   std::vector<LEDRange> mLEDRanges;
+  std::vector<IRECT> mSegRects; // reused by DrawTrackBackground()
+  std::vector<IColor> mSegColors;
 };
 
 END_IGRAPHICS_NAMESPACE
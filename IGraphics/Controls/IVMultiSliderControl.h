@@ -41,6 +41,7 @@ public:
   {
     mDrawTrackFrame = false;
     mTrackPadding = 1.f;
+    mRedrawChangedTracksOnly = true;
   }
 
   /** Constructs a vector multi slider control that is linked to sequential parameters
@@ -55,6 +56,7 @@ public:
   {
     mDrawTrackFrame = false;
     mTrackPadding = 1.f;
+    mRedrawChangedTracksOnly = true;
   }
   
   /** Constructs a vector multi slider control that is linked to a list of parameters that need not be sequential
@@ -69,6 +71,7 @@ public:
   {
     mDrawTrackFrame = false;
     mTrackPadding = 1.f;
+    mRedrawChangedTracksOnly = true;
   }
   
   void Draw(IGraphics& g) override
@@ -149,6 +152,12 @@ public:
       SetValue(Clip(value, 0., 1.), sliderTest);
       OnNewValue(sliderTest, GetValue(sliderTest));
 
+      int firstChanged = sliderTest;
+      int lastChanged = sliderTest;
+
+      if (mMouseOverTrack != sliderTest)
+        SetTrackDirty(mMouseOverTrack);
+
       mSliderHit = sliderTest;
       mMouseOverTrack = mSliderHit;
       
@@ -175,16 +184,21 @@ public:
             SetValue(iplug::Lerp(GetValue(lowBounds), GetValue(highBounds), frac), i);
             OnNewValue(i, GetValue(i));
           }
+          
+          firstChanged = lowBounds;
+          lastChanged = highBounds;
         }
       }
       mPrevSliderHit = mSliderHit;
+      
+      // only the sliders that changed are sent to the delegate and redrawn
+      for (auto i = firstChanged; i <= lastChanged; i++)
+        SetTrackDirty(i, true);
     }
     else
     {
       mSliderHit = -1;
     }
-
-    SetDirty(true); // will send all param vals to delegate
   }
 
   void OnMouseDown(float x, float y, const IMouseMod& mod) override
@@ -207,7 +221,7 @@ public:
           {
             SetValue(0., ch);
             OnNewValue(ch, 0.);
-            SetDirty(true);
+            SetTrackDirty(ch, true);
             return;
           }
         }
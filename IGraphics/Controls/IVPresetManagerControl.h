@@ -166,7 +166,7 @@ public:
   {
     mIgnoreMouse = true;
     AddPath(presetPath, "");
-    SetupMenu();
+    SetupMenuAsync();
   }
   
   void Draw(IGraphics& g) override { /* NO-OP */ }
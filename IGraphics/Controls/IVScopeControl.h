@@ -60,7 +60,8 @@ public:
     for (int c=0; c<mBuf.nChans; c++)
     {
       // drawdata expects normalized values and buffer contains unnormalized, so draw in the top half
-      g.DrawData(GetColor(kFG), r.FracRectVertical(0.5, true), mBuf.vals[c].data(), mBufferSize, nullptr, &mBlend, mTrackSize);
+      // buffers larger than the width are drawn as their min/max envelope, so the cost doesn't grow with MAXBUF
+      g.DrawDataEnvelope(GetColor(kFG), r.FracRectVertical(0.5, true), mBuf.vals[c].data(), mBufferSize, &mBlend, mTrackSize);
     }
   }
   
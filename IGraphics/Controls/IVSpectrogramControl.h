@@ -0,0 +1,218 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVSpectrogramControl
+ */
+
+#include "IControl.h"
+#include "ISender.h"
+#include "IPlugStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Vectorial multi-channel capable spectrogram (waterfall) control, that scrolls the spectra calculated by an ISpectrumSender from right to left, with time along the x axis and frequency along the y axis.
+ * The history is a ring of columns in a texture made with IGraphics::CreatePixelLayer(). Each new spectrum is written into one column and uploaded on its own,
+ * and the display is scrolled by offsetting where the texture is drawn, so a frame costs one column upload and two textured rectangles however long the history is.
+ * Where more than one channel is sent, the loudest channel is shown
+ * @ingroup IControls */
+template <int MAXNC = 1, int MAXBINS = 256>
+class IVSpectrogramControl : public IControl
+                           , public IVectorBase
+{
+public:
+  /** Constructs an IVSpectrogramControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle
+   * @param nColumns The number of spectra in the history, which is the width of the texture in pixels
+   * @param lowRangeDB The level shown with the first color of the color map
+   * @param highRangeDB The level shown with the last color of the color map */
+  IVSpectrogramControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE, int nColumns = 256, float lowRangeDB = -90.f, float highRangeDB = 0.f)
+  : IControl(bounds)
+  , IVectorBase(style)
+  , mNColumns(nColumns)
+  , mLowRangeDB(lowRangeDB)
+  , mHighRangeDB(highRangeDB)
+  {
+    assert(nColumns > 1);
+    AttachIControl(this, label);
+    SetColorMap({COLOR_BLACK, IColor(255, 40, 0, 120), IColor(255, 220, 40, 40), IColor(255, 255, 200, 0), COLOR_WHITE});
+    ResizePixels();
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackground(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if (mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, &mBlend, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    if (!g.CheckLayer(mLayer))
+    {
+      mLayer = g.CreatePixelLayer(this, mNColumns, mNBins, mPixels.data());
+      mNPendingColumns = 0;
+    }
+    else if (mNPendingColumns)
+    {
+      // the new columns, in at most two runs if they wrap around the end of the ring
+      const int start = (mWriteColumn - mNPendingColumns + mNColumns) % mNColumns;
+      const int firstRun = std::min(mNPendingColumns, mNColumns - start);
+
+      g.UpdatePixelLayer(mLayer, mPixels.data(), start, 0, firstRun, mNBins);
+
+      if (firstRun < mNPendingColumns)
+        g.UpdatePixelLayer(mLayer, mPixels.data(), 0, 0, mNPendingColumns - firstRun, mNBins);
+
+      mNPendingColumns = 0;
+    }
+
+    // the oldest column is the next one to be written, so the texture is drawn twice, offset so that it starts at the left edge
+    const IRECT r = mWidgetBounds.GetPadded(-mPadding);
+    const float offset = r.W() * mWriteColumn / mNColumns;
+
+    g.PathClipRegion(r);
+    g.DrawFittedLayer(mLayer, r.GetTranslated(-offset, 0.f), &mBlend);
+    g.DrawFittedLayer(mLayer, r.GetTranslated(r.W() - offset, 0.f), &mBlend);
+    g.PathClipRegion();
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+  /** The texture is created again from the pixels, which are kept */
+  void OnMemoryWarning() override
+  {
+    mLayer = nullptr;
+    IControl::OnMemoryWarning();
+  }
+
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (!IsDisabled() && msgTag == ISender<>::kUpdateMessage)
+    {
+      IByteStream stream(pData, dataSize);
+
+      int pos = 0;
+      pos = stream.Get(&mBuf, pos);
+
+      const float rangeDB = mHighRangeDB - mLowRangeDB;
+      const int maxColor = static_cast<int>(mColorMap.size()) - 1;
+
+      // the highest frequency is the top row
+      for (auto b = 0; b < mNBins; b++)
+      {
+        float level = mLowRangeDB;
+
+        for (auto c = mBuf.chanOffset; c < (mBuf.chanOffset + mBuf.nChans); c++)
+          level = std::max(level, mBuf.vals[c][b]);
+
+        const int colorIdx = static_cast<int>(Clip((level - mLowRangeDB) / rangeDB, 0.f, 1.f) * maxColor);
+        SetPixel(mWriteColumn, mNBins - 1 - b, mColorMap[colorIdx]);
+      }
+
+      mWriteColumn = (mWriteColumn + 1) % mNColumns;
+      mNPendingColumns = std::min(mNPendingColumns + 1, mNColumns);
+      SetDirty(false);
+    }
+  }
+
+  /** @param nBins The number of bins the ISpectrumSender sends, see ISpectrumSender::SetNBins(). This is the height of the texture in pixels, and clears the history */
+  void SetNBins(int nBins)
+  {
+    assert(nBins > 1 && nBins <= MAXBINS);
+    mNBins = nBins;
+    ResizePixels();
+  }
+
+  /** @param lowRangeDB The level shown with the first color of the color map
+   * @param highRangeDB The level shown with the last color of the color map */
+  void SetRange(float lowRangeDB, float highRangeDB)
+  {
+    assert(highRangeDB > lowRangeDB);
+    mLowRangeDB = lowRangeDB;
+    mHighRangeDB = highRangeDB;
+  }
+
+  /** Set the colors that levels are shown with, from the low to the high end of the range. Spectra already in the history keep their colors
+   * @param colors At least two colors, which are spaced evenly across the range */
+  void SetColorMap(const std::initializer_list<IColor>& colors)
+  {
+    assert(colors.size() > 1);
+    const std::vector<IColor> stops(colors);
+    const int nSegments = static_cast<int>(stops.size()) - 1;
+
+    for (auto i = 0; i < kColorMapSize; i++)
+    {
+      const float pos = static_cast<float>(i) / (kColorMapSize - 1) * nSegments;
+      const int segment = std::min(static_cast<int>(pos), nSegments - 1);
+      mColorMap[i] = IColor::LinearInterpolateBetween(stops[segment], stops[segment + 1], pos - segment);
+    }
+  }
+
+  /** Clear the history, e.g. when playback stops */
+  void Clear()
+  {
+    ResizePixels();
+    SetDirty(false);
+  }
+
+private:
+  void ResizePixels()
+  {
+    mPixels.assign(mNColumns * mNBins * 4, 0);
+
+    for (auto i = 0; i < mNColumns * mNBins; i++)
+      SetPixel(i % mNColumns, i / mNColumns, mColorMap[0]);
+
+    mWriteColumn = 0;
+    mNPendingColumns = 0;
+    mLayer = nullptr;
+  }
+
+  void SetPixel(int x, int y, const IColor& color)
+  {
+    uint8_t* pPixel = mPixels.data() + (y * mNColumns + x) * 4;
+    pPixel[0] = static_cast<uint8_t>(color.R);
+    pPixel[1] = static_cast<uint8_t>(color.G);
+    pPixel[2] = static_cast<uint8_t>(color.B);
+    pPixel[3] = static_cast<uint8_t>(color.A);
+  }
+
+  static constexpr int kColorMapSize = 256;
+
+  ISenderData<MAXNC, std::array<float, MAXBINS>> mBuf;
+  std::array<IColor, kColorMapSize> mColorMap;
+  std::vector<uint8_t> mPixels; // the RGBA pixels of the texture, kept to upload the new columns from
+  ILayerPtr mLayer;
+  float mPadding = 2.f;
+  int mNColumns;
+  float mLowRangeDB;
+  float mHighRangeDB;
+  int mNBins = MAXBINS;
+  int mWriteColumn = 0;
+  int mNPendingColumns = 0;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -0,0 +1,140 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVSpectrumControl
+ */
+
+#include "IControl.h"
+#include "ISender.h"
+#include "IPlugStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Vectorial multi-channel capable spectrum analyzer control, that draws the logarithmically spaced bins calculated by an ISpectrumSender
+ * The spectrum rises immediately and falls at the release rate, so that the display doesn't flicker
+ * @ingroup IControls */
+template <int MAXNC = 1, int MAXBINS = 256>
+class IVSpectrumControl : public IControl
+                        , public IVectorBase
+{
+public:
+  /** Constructs an IVSpectrumControl
+   * @param bounds The rectangular area that the control occupies
+   * @param label A CString to label the control
+   * @param style, /see IVStyle
+   * @param lowRangeDB The level at the bottom of the control
+   * @param highRangeDB The level at the top of the control */
+  IVSpectrumControl(const IRECT& bounds, const char* label = "", const IVStyle& style = DEFAULT_STYLE, float lowRangeDB = -90.f, float highRangeDB = 0.f)
+  : IControl(bounds)
+  , IVectorBase(style)
+  , mLowRangeDB(lowRangeDB)
+  , mHighRangeDB(highRangeDB)
+  {
+    AttachIControl(this, label);
+
+    for (auto& points : mPoints)
+      points.fill(0.f);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackground(g, mRECT);
+    DrawWidget(g);
+    DrawLabel(g);
+
+    if (mStyle.drawFrame)
+      g.DrawRect(GetColor(kFR), mWidgetBounds, &mBlend, mStyle.frameThickness);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    IRECT r = mWidgetBounds.GetPadded(-mPadding);
+
+    for (int c = mChanOffset; c < (mChanOffset + mNChans); c++)
+    {
+      g.DrawData(GetColor(c == mChanOffset ? kFG : kX1), r, mPoints[c].data(), mNBins, nullptr, &mBlend, mStyle.frameThickness);
+    }
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+    SetDirty(false);
+  }
+
+  void OnMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
+  {
+    if (!IsDisabled() && msgTag == ISender<>::kUpdateMessage)
+    {
+      IByteStream stream(pData, dataSize);
+
+      int pos = 0;
+      pos = stream.Get(&mBuf, pos);
+
+      mNChans = mBuf.nChans;
+      mChanOffset = mBuf.chanOffset;
+      const float rangeDB = mHighRangeDB - mLowRangeDB;
+
+      for (auto c = mChanOffset; c < (mChanOffset + mNChans); c++)
+      {
+        for (auto b = 0; b < mNBins; b++)
+        {
+          const float target = Clip((mBuf.vals[c][b] - mLowRangeDB) / rangeDB, 0.f, 1.f);
+          float& point = mPoints[c][b];
+          point = target > point ? target : point + (target - point) * mRelease;
+        }
+      }
+
+      SetDirty(false);
+    }
+  }
+
+  /** @param nBins The number of bins the ISpectrumSender sends, see ISpectrumSender::SetNBins() */
+  void SetNBins(int nBins)
+  {
+    assert(nBins > 1 && nBins <= MAXBINS);
+    mNBins = nBins;
+  }
+
+  /** @param lowRangeDB The level at the bottom of the control
+   * @param highRangeDB The level at the top of the control */
+  void SetRange(float lowRangeDB, float highRangeDB)
+  {
+    assert(highRangeDB > lowRangeDB);
+    mLowRangeDB = lowRangeDB;
+    mHighRangeDB = highRangeDB;
+  }
+
+  /** @param release How quickly the spectrum falls, the fraction of the distance to the new value covered by each update, from 0 to 1 (immediate) */
+  void SetRelease(float release)
+  {
+    mRelease = Clip(release, 0.f, 1.f);
+  }
+
+private:
+  ISenderData<MAXNC, std::array<float, MAXBINS>> mBuf;
+  std::array<std::array<float, MAXBINS>, MAXNC> mPoints;
+  float mPadding = 2.f;
+  float mLowRangeDB;
+  float mHighRangeDB;
+  float mRelease = 0.3f;
+  int mNBins = MAXBINS;
+  int mNChans = 0;
+  int mChanOffset = 0;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
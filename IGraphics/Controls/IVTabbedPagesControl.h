@@ -0,0 +1,380 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @ingroup Controls
+ * @copydoc IVTabbedPagesControl
+ */
+
+#include "IControl.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A page of an IVTabbedPagesControl, which is a container for the controls that are shown when its tab is selected.
+ * Add the controls in the AttachFunc, with bounds inside the ones it is passed, and lay them out again in the ResizeFunc if the control can be resized */
+class IVTabPage : public IContainerBase
+{
+public:
+  /** Constructs a tab page
+   * @param attachFunc Called to add the child controls, see IContainerBase::AddChildControl()
+   * @param resizeFunc Called to lay out the child controls when the page is resized
+   * @param cached Set \c true for a page that changes rarely while it isn't shown, see SetCached() */
+  IVTabPage(AttachFunc attachFunc, ResizeFunc resizeFunc = nullptr, bool cached = true)
+  : IContainerBase(IRECT(), attachFunc, resizeFunc)
+  , mCached(cached)
+  {
+  }
+
+  /** @param cached Set \c true to keep a snapshot of the page when it is switched away from, so that switching back only redraws it if a control on it changed in the meantime.
+   * Otherwise the snapshot is released after the transition, which saves the memory of a layer the size of the page */
+  void SetCached(bool cached) { mCached = cached; if (!cached) mSnapshot = nullptr; }
+
+  /** @return \c true if the page keeps its snapshot, see SetCached() */
+  bool GetCached() const { return mCached; }
+
+  void OnMemoryWarning() override
+  {
+    mSnapshot = nullptr;
+    mSnapshotValid = false;
+    IContainerBase::OnMemoryWarning();
+  }
+
+protected:
+  friend class IVTabbedPagesControl;
+
+  /** @return \c true if a control on the page was marked dirty since the snapshot was drawn */
+  bool SnapshotIsStale(IGraphics& g) const
+  {
+    return !mSnapshotValid || !g.CheckLayer(mSnapshot) || AnyChildDirty(const_cast<IVTabPage*>(this));
+  }
+
+  /** Draw the child controls into the snapshot layer, whether or not they are hidden, and set them clean */
+  void DrawSnapshot(IGraphics& g)
+  {
+    g.StartLayer(this, mRECT, true);
+    g.PathClipRegion(mRECT);
+    DrawChildren(g, this);
+    mSnapshot = g.EndLayer();
+    mSnapshotValid = true;
+  }
+
+  static bool AnyChildDirty(IContainerBase* pContainer)
+  {
+    for (auto i = 0; i < pContainer->NChildren(); i++)
+    {
+      IControl* pChild = pContainer->GetChild(i);
+      IContainerBase* pChildContainer = pChild->As<IContainerBase>();
+
+      if (pChild->IsDirty() || (pChildContainer && AnyChildDirty(pChildContainer)))
+        return true;
+    }
+
+    return false;
+  }
+
+  static void DrawChildren(IGraphics& g, IContainerBase* pContainer)
+  {
+    pContainer->ForAllChildrenFunc([&g](int childIdx, IControl* pChild) {
+      pChild->Draw(g);
+      pChild->SetClean();
+
+      if (IContainerBase* pChildContainer = pChild->As<IContainerBase>())
+        DrawChildren(g, pChildContainer);
+    });
+  }
+
+  static void SetChildrenClean(IContainerBase* pContainer)
+  {
+    pContainer->ForAllChildrenFunc([](int childIdx, IControl* pChild) {
+      pChild->SetClean();
+
+      if (IContainerBase* pChildContainer = pChild->As<IContainerBase>())
+        SetChildrenClean(pChildContainer);
+    });
+  }
+
+  ILayerPtr mSnapshot;
+  bool mSnapshotValid = false; // false while the page is shown, since its controls are then drawn and set clean by the draw loop
+  bool mCached;
+};
+
+/** A vector container with a bar of tabs that each show a page of controls, an IVTabPage.
+ * The controls of the pages that aren't shown are hidden and suspended (see IControl::SetSuspended()), so they aren't animated or asked if they are dirty at each display refresh,
+ * and a page is redrawn with a single invalidation when it is shown again, however many of its controls changed in the meantime.
+ * When the selected page changes, the old and new pages slide across from snapshots of them, drawn into layers, so that the controls aren't drawn during the transition.
+ * A snapshot of a cached page is kept after it is switched away from, and only drawn again if one of its controls changes, see IVTabPage::SetCached()
+ * @ingroup IControls */
+class IVTabbedPagesControl : public IContainerBase
+                           , public IVectorBase
+{
+public:
+  using PageList = std::initializer_list<std::pair<const char*, IVTabPage*>>;
+
+  /** Constructs an IVTabbedPagesControl
+   * @param bounds The control's bounds, which include the tab bar
+   * @param pages The label of each tab and its page. The control owns the pages
+   * @param label The IVControl label CString
+   * @param style The styling of this vector control \see IVStyle
+   * @param tabBarHeight The height of the bar of tabs, at the top of the control
+   * @param transitionDuration The duration of the transition between pages in milliseconds, or 0 to switch pages at once */
+  IVTabbedPagesControl(const IRECT& bounds, const PageList& pages, const char* label = "", const IVStyle& style = DEFAULT_STYLE, float tabBarHeight = 20.f, int transitionDuration = 200)
+  : IContainerBase(bounds)
+  , IVectorBase(style)
+  , mTabBarHeight(tabBarHeight)
+  , mTransitionDuration(transitionDuration)
+  {
+    AttachIControl(this, label);
+
+    for (auto& page : pages)
+    {
+      mTabLabels.Add(new WDL_String(page.first));
+      mPages.Add(page.second);
+    }
+  }
+
+  ~IVTabbedPagesControl()
+  {
+    mTabLabels.Empty(true);
+  }
+
+  void Draw(IGraphics& g) override
+  {
+    DrawBackground(g, mRECT);
+    DrawLabel(g);
+    DrawWidget(g);
+  }
+
+  void DrawWidget(IGraphics& g) override
+  {
+    for (auto i = 0; i < NPages(); i++)
+    {
+      const IRECT r = mTabBounds.Get()[i];
+      DrawPressableShape(g, mShape, r, i == mSelectedPage, i == mMouseOverTab, IsDisabled());
+      g.DrawText(mStyle.valueText, mTabLabels.Get(i)->Get(), r, &mBlend);
+    }
+
+    const bool inTransition = mPreviousPage > -1;
+
+    if (mPendingSnapshot > -1 || inTransition)
+    {
+      // the old page is drawn as it was last shown, the new page is only drawn again if it changed
+      if (mPendingSnapshot > -1)
+      {
+        mPages.Get(mPendingSnapshot)->DrawSnapshot(g);
+        mPendingSnapshot = -1;
+      }
+
+      if (inTransition && mPages.Get(mSelectedPage)->SnapshotIsStale(g))
+        mPages.Get(mSelectedPage)->DrawSnapshot(g);
+    }
+
+    if (inTransition)
+    {
+      const IRECT pageBounds = GetPageBounds();
+      const float progress = static_cast<float>(std::min(GetAnimationProgress(), 1.));
+      const float dir = mSelectedPage > mPreviousPage ? 1.f : -1.f;
+      const float offset = dir * pageBounds.W() * progress;
+
+      g.PathClipRegion(pageBounds);
+      g.DrawFittedLayer(mPages.Get(mPreviousPage)->mSnapshot, pageBounds.GetTranslated(-offset, 0.f), &mBlend);
+      g.DrawFittedLayer(mPages.Get(mSelectedPage)->mSnapshot, pageBounds.GetTranslated(dir * pageBounds.W() - offset, 0.f), &mBlend);
+      g.PathClipRegion();
+    }
+  }
+
+  void OnAttached() override
+  {
+    for (auto i = 0; i < NPages(); i++)
+    {
+      IVTabPage* pPage = mPages.Get(i);
+      pPage->SetTargetAndDrawRECTs(GetPageBounds());
+      AddChildControl(pPage);
+
+      if (i != mSelectedPage)
+        SuspendPage(i);
+    }
+
+    OnResize();
+  }
+
+  void OnResize() override
+  {
+    SetTargetRECT(MakeRects(mRECT));
+
+    const IRECT tabBar = mWidgetBounds.GetFromTop(mTabBarHeight);
+    mTabBounds.Resize(NPages());
+
+    for (auto i = 0; i < NPages(); i++)
+      mTabBounds.Get()[i] = tabBar.SubRectHorizontal(NPages(), i);
+
+    for (auto i = 0; i < NPages(); i++)
+    {
+      IVTabPage* pPage = mPages.Get(i);
+      pPage->SetTargetAndDrawRECTs(GetPageBounds());
+      pPage->OnResize();
+      pPage->mSnapshotValid = false;
+    }
+
+    SetDirty(false);
+  }
+
+  void OnMouseDown(float x, float y, const IMouseMod& mod) override
+  {
+    const int tab = GetTabForPoint(x, y);
+
+    if (tab > -1)
+      SelectPage(tab);
+  }
+
+  void OnMouseOver(float x, float y, const IMouseMod& mod) override
+  {
+    const int tab = GetTabForPoint(x, y);
+
+    if (tab != mMouseOverTab)
+    {
+      mMouseOverTab = tab;
+      SetDirty(false);
+    }
+
+    IControl::OnMouseOver(x, y, mod);
+  }
+
+  void OnMouseOut() override
+  {
+    mMouseOverTab = -1;
+    IControl::OnMouseOut();
+    SetDirty(false);
+  }
+
+  bool IsHit(float x, float y) const override
+  {
+    return GetTabForPoint(x, y) > -1;
+  }
+
+  void OnEndAnimation() override
+  {
+    mPreviousPage = -1;
+    RestorePage(mSelectedPage);
+    IControl::OnEndAnimation();
+  }
+
+  /** Show a page, hiding and suspending the one that was shown
+   * @param pageIdx The index of the page
+   * @param animate Set \c false to switch at once, rather than with the transition */
+  void SelectPage(int pageIdx, bool animate = true)
+  {
+    assert(pageIdx >= 0 && pageIdx < NPages());
+
+    if (pageIdx == mSelectedPage)
+      return;
+
+    // a transition that is under way ends where it is
+    if (mPreviousPage > -1)
+    {
+      mPreviousPage = -1;
+      IControl::OnEndAnimation();
+      RestorePage(mSelectedPage);
+    }
+
+    const int oldPage = mSelectedPage;
+    SuspendPage(oldPage);
+    mSelectedPage = pageIdx;
+
+    // the snapshot of the old page is drawn in the next frame, where there is a draw context
+    if (mPages.Get(oldPage)->GetCached() || (animate && mTransitionDuration > 0))
+      mPendingSnapshot = oldPage;
+
+    if (animate && mTransitionDuration > 0 && GetUI())
+    {
+      mPreviousPage = oldPage;
+      SetAnimation([](IControl* pCaller) {
+        if (pCaller->GetAnimationProgress() > 1.)
+          pCaller->OnEndAnimation();
+        else
+          pCaller->SetDirty(false);
+      }, mTransitionDuration);
+    }
+    else
+      RestorePage(pageIdx);
+
+    if (GetActionFunction())
+      GetActionFunction()(this);
+  }
+
+  /** @return The index of the page that is shown, or that is being switched to */
+  int GetSelectedPage() const { return mSelectedPage; }
+
+  /** @return The number of pages */
+  int NPages() const { return mPages.GetSize(); }
+
+  /** @param pageIdx The index of the page
+   * @return The page, e.g. to get its controls */
+  IVTabPage* GetPage(int pageIdx) { return mPages.Get(pageIdx); }
+
+  /** @param duration The duration of the transition between pages in milliseconds, or 0 to switch pages at once */
+  void SetTransitionDuration(int duration) { mTransitionDuration = duration; }
+
+protected:
+  IRECT GetPageBounds() const
+  {
+    return mWidgetBounds.GetReducedFromTop(mTabBarHeight);
+  }
+
+  int GetTabForPoint(float x, float y) const
+  {
+    for (auto i = 0; i < NPages(); i++)
+    {
+      if (mTabBounds.Get()[i].Contains(x, y))
+        return i;
+    }
+
+    return -1;
+  }
+
+  void SuspendPage(int pageIdx)
+  {
+    IVTabPage* pPage = mPages.Get(pageIdx);
+    pPage->SetSuspended(true);
+    pPage->Hide(true);
+  }
+
+  /** Show a page, setting its controls clean first, so that the changes made while it was suspended are drawn with a single invalidation of the page */
+  void RestorePage(int pageIdx)
+  {
+    IVTabPage* pPage = mPages.Get(pageIdx);
+
+    if (!pPage->GetCached())
+      pPage->mSnapshot = nullptr;
+
+    pPage->mSnapshotValid = false;
+    pPage->Hide(false);
+    pPage->SetClean();
+    IVTabPage::SetChildrenClean(pPage);
+    pPage->SetSuspended(false);
+    SetDirty(false);
+  }
+
+  WDL_PtrList<IVTabPage> mPages; // the same controls as mChildren, which the graphics context owns once attached
+  WDL_PtrList<WDL_String> mTabLabels;
+  WDL_TypedBuf<IRECT> mTabBounds;
+  float mTabBarHeight;
+  int mTransitionDuration;
+  int mSelectedPage = 0;
+  int mPreviousPage = -1; // the page that is being switched away from, during a transition
+  int mPendingSnapshot = -1; // the page to draw a snapshot of in the next frame
+  int mMouseOverTab = -1;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
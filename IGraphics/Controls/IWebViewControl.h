@@ -32,6 +32,8 @@ using OnMessageFunc = std::function<void(IWebViewControl* pWebView, const char*
  * The platform native webviews run in a separate process and communicate via IPC.
  * On Windows the ICoreWebView2 is used, which requires Edge Chromium to be installed: https://docs.microsoft.com/en-us/microsoft-edge/webview2
  * On macOS and iOS WkWebView is used
+ * To reuse the web view with its page loaded the next time the editor opens, call IWebView::SetPoolKey() before the control is attached, and hold an IWebViewPool::Ref
+ * in the plug-in, so that the pool outlives the control
  * @ingroup IControls */
 class IWebViewControl : public IControl, public IWebView
 {
@@ -68,31 +68,32 @@ public:
   
   void DoLayout()
   {
-    mItemRects.clear();
-    
-    for (int i=0; i<7; i++)
+    // the flex box and its items are kept, so a resize only lays out again what the new bounds affect
+    if (mItems.empty())
     {
-      mItemRects.push_back(IRECT());
+      for (int i=0; i<7; i++)
+      {
+        mItems.push_back(mFlexBox.AddItem(100.f, 100.f, YGAlign(mAlign)));
+      }
     }
-    
-    IFlexBox f;
-    f.Init(mRECT, YGFlexDirection(mDirection), YGJustify(mJustify), YGWrap(mWrap));
 
-    YGNodeRef r;
-    
-    for (int i=0; i<7; i++)
+    mFlexBox.Init(mRECT, YGFlexDirection(mDirection), YGJustify(mJustify), YGWrap(mWrap));
+
+    for (auto item : mItems)
     {
-      r = f.AddItem(100.f, 100.f, YGAlign(mAlign));
+      YGNodeStyleSetAlignSelf(item, YGAlign(mAlign));
     }
 
-    f.CalcLayout();
+    mFlexBox.CalcLayout();
+
+    mItemRects.clear();
 
     for (int i=0; i<7; i++)
     {
-      mItemRects[i] = mRECT.Inset(f.GetItemBounds(i));
+      mItemRects.push_back(mRECT.Inset(mFlexBox.GetItemBounds(i)));
     }
 
-    mRootRect = mRECT.Inset(f.GetRootBounds());
+    mRootRect = mRECT.Inset(mFlexBox.GetRootBounds());
     mSettingsStr.SetFormatted(256, "%s, %s, %s, %s", alignStrs.begin()[mAlign], dirStrs.begin()[mDirection], justifyStrs.begin()[mJustify], wrapStrs.begin()[mWrap]);
   }
 
@@ -130,4 +131,6 @@ private:
   int mJustify = YGJustifyFlexStart;
   int mWrap = YGWrapNoWrap;
   std::vector<IRECT> mItemRects;
+  IFlexBox mFlexBox;
+  std::vector<YGNodeRef> mItems;
 };
@@ -28,6 +28,7 @@ public:
    : IControl(bounds)
   {
     SetWantsMultiTouch(true);
+    SetPollDirty(true);
   }
   
   void Draw(IGraphics& g) override
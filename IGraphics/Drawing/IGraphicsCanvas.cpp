@@ -94,6 +94,29 @@ IGraphicsCanvas::IGraphicsCanvas(IGEditorDelegate& dlg, int w, int h, int fps, f
 {
   StaticStorage<Font>::Accessor storage(sFontCache);
   storage.Retain();
+  
+  // Decodes the commands encoded by AddCommand(), the numbers must match ECanvasCommand
+  EM_ASM({
+    if (Module.iplugCanvasReplay)
+      return;
+    
+    Module.iplugCanvasReplay = function(ctx, ptr, size) {
+      var c = HEAPF32.subarray(ptr >> 2, (ptr >> 2) + size);
+      
+      for (var i = 0; i < size;) {
+        switch (c[i++]) {
+          case 0: ctx.beginPath(); break;
+          case 1: ctx.closePath(); break;
+          case 2: ctx.moveTo(c[i], c[i + 1]); i += 2; break;
+          case 3: ctx.lineTo(c[i], c[i + 1]); i += 2; break;
+          case 4: ctx.arc(c[i], c[i + 1], c[i + 2], c[i + 3], c[i + 4], c[i + 5] != 0); i += 6; break;
+          case 5: ctx.bezierCurveTo(c[i], c[i + 1], c[i + 2], c[i + 3], c[i + 4], c[i + 5]); i += 6; break;
+          case 6: ctx.quadraticCurveTo(c[i], c[i + 1], c[i + 2], c[i + 3]); i += 4; break;
+          case 7: ctx.setTransform(c[i], c[i + 1], c[i + 2], c[i + 3], c[i + 4], c[i + 5]); i += 6; break;
+        }
+      }
+    };
+  });
 }
 
 IGraphicsCanvas::~IGraphicsCanvas()
@@ -123,37 +146,66 @@ void IGraphicsCanvas::DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int
 
 void IGraphicsCanvas::PathClear()
 {
-  GetContext().call<void>("beginPath");
+  AddCommand(kBeginPath, {});
 }
 
 void IGraphicsCanvas::PathClose()
 {
-  GetContext().call<void>("closePath");
+  AddCommand(kClosePath, {});
 }
 
 void IGraphicsCanvas::PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding)
 {
-  GetContext().call<void>("arc", cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f), winding == EWinding::CCW);
+  AddCommand(kArc, {cx, cy, r, DegToRad(a1 - 90.f), DegToRad(a2 - 90.f), winding == EWinding::CCW ? 1.f : 0.f});
 }
 
 void IGraphicsCanvas::PathMoveTo(float x, float y)
 {
-  GetContext().call<void>("moveTo", x, y);
+  AddCommand(kMoveTo, {x, y});
 }
 
 void IGraphicsCanvas::PathLineTo(float x, float y)
 {
-  GetContext().call<void>("lineTo", x, y);
+  AddCommand(kLineTo, {x, y});
 }
 
 void IGraphicsCanvas::PathCubicBezierTo(float c1x, float c1y, float c2x, float c2y, float x2, float y2)
 {
-  GetContext().call<void>("bezierCurveTo", c1x, c1y, c2x, c2y, x2, y2);
+  AddCommand(kBezierCurveTo, {c1x, c1y, c2x, c2y, x2, y2});
 }
 
 void IGraphicsCanvas::PathQuadraticBezierTo(float cx, float cy, float x2, float y2)
 {
-  GetContext().call<void>("quadraticCurveTo", cx, cy, x2, y2);
+  AddCommand(kQuadraticCurveTo, {cx, cy, x2, y2});
+}
+
+void IGraphicsCanvas::AddCommand(ECanvasCommand command, std::initializer_list<float> args)
+{
+  const int pos = mCommands.GetSize();
+  
+  if (!pos)
+    mCommandContext = GetTargetContext();
+  
+  float* pCommand = mCommands.ResizeOK(pos + 1 + static_cast<int>(args.size()), false);
+  
+  if (!pCommand)
+    return;
+  
+  pCommand += pos;
+  *pCommand++ = static_cast<float>(command);
+  
+  for (float arg : args)
+    *pCommand++ = arg;
+}
+
+void IGraphicsCanvas::FlushCommands() const
+{
+  if (!mCommands.GetSize())
+    return;
+  
+  val::module_property("iplugCanvasReplay")(mCommandContext, reinterpret_cast<uintptr_t>(mCommands.Get()), mCommands.GetSize());
+  mCommands.Resize(0, false);
+  mCommandContext = val::undefined();
 }
 
 void IGraphicsCanvas::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
@@ -332,7 +384,8 @@ void IGraphicsCanvas::PathTransformSetMatrix(const IMatrix& m)
   const double scale = GetBackingPixelScale();
   IMatrix t = IMatrix().Scale(scale, scale).Translate(XTranslate(), YTranslate()).Transform(m);
 
-  GetContext().call<void>("setTransform", t.mXX, t.mYX, t.mXY, t.mYY, t.mTX, t.mTY);
+  AddCommand(kSetTransform, {static_cast<float>(t.mXX), static_cast<float>(t.mYX), static_cast<float>(t.mXY),
+                             static_cast<float>(t.mYY), static_cast<float>(t.mTX), static_cast<float>(t.mTY)});
 }
 
 void IGraphicsCanvas::SetClipRegion(const IRECT& r)
@@ -534,6 +587,25 @@ void IGraphicsCanvas::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData&
   }
 }
 
+void IGraphicsCanvas::UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height)
+{
+  const APIBitmap* pBitmap = layer->GetAPIBitmap();
+  const int rowBytes = pBitmap->GetWidth() * 4;
+  val context = pBitmap->GetBitmap()->call<val>("getContext", std::string("2d"));
+  val imageData = context.call<val>("createImageData", width, height);
+  val pixelData = imageData["data"];
+  
+  for (auto row = 0; row < height; row++)
+  {
+    const uint8_t* in = pData + (y + row) * rowBytes + x * 4;
+    
+    for (auto i = 0; i < width * 4; i++)
+      pixelData.set(row * width * 4 + i, in[i]);
+  }
+  
+  context.call<void>("putImageData", imageData, x, y);
+}
+
 void IGraphicsCanvas::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -42,6 +42,8 @@ public:
   void DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend) override;
 
   void DrawResize() override {};
+  void EndFrame() override { FlushCommands(); }
+  void UpdateLayer() override { FlushCommands(); }
 
   void PathClear() override;
   void PathClose() override;
@@ -71,20 +73,48 @@ protected:
   bool FlippedBitmap() const override { return false; }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  void UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
     
 private:
+  /** The commands that are encoded in mCommands, which must match the JavaScript replay function installed by the constructor */
+  enum ECanvasCommand
+  {
+    kBeginPath,
+    kClosePath,
+    kMoveTo,
+    kLineTo,
+    kArc,
+    kBezierCurveTo,
+    kQuadraticCurveTo,
+    kSetTransform
+  };
+
   void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
-    
-  val GetContext() const
+
+  val GetTargetContext() const
   {
     val canvas = mLayers.empty() ? val::global("document").call<val>("getElementById", std::string("canvas")) : *(mLayers.top()->GetAPIBitmap()->GetBitmap());
       
     return canvas.call<val>("getContext", std::string("2d"));
   }
+
+  /** @return The context of the current canvas or layer, after replaying the commands that have been encoded */
+  val GetContext() const
+  {
+    FlushCommands();
+    return GetTargetContext();
+  }
+
+  /** Encode a path or transform command, rather than calling the context through embind for each one.
+   * The commands are replayed by a single call when the context is next needed, or at the end of the frame */
+  void AddCommand(ECanvasCommand command, std::initializer_list<float> args);
+
+  /** Replay the encoded commands into the context they were recorded for */
+  void FlushCommands() const;
     
   void GetFontMetrics(const char* font, const char* style, double& ascenderRatio, double& EMRatio);
   bool CompareFontMetrics(const char* style, const char* font1, const char* font2);
@@ -100,6 +130,8 @@ private:
   void SetCanvasBlendMode(val& context, const IBlend* pBlend);
     
   std::vector<val> mLoadingFonts;
+  mutable WDL_TypedBuf<float> mCommands;
+  mutable val mCommandContext = val::undefined(); // the context the commands in mCommands are for
 
   static StaticStorage<Font> sFontCache;
 };
@@ -42,7 +42,13 @@
       #error Define either IGRAPHICS_GL2 or IGRAPHICS_GL3 when using IGRAPHICS_GL and IGRAPHICS_NANOVG with OS_WIN
     #endif
   #elif defined OS_LINUX
-    #error NOT IMPLEMENTED
+    #if defined IGRAPHICS_GL2
+      #define NANOVG_GL2_IMPLEMENTATION
+    #elif defined IGRAPHICS_GL3
+      #define NANOVG_GL3_IMPLEMENTATION
+    #else
+      #error Define either IGRAPHICS_GL2 or IGRAPHICS_GL3 when using IGRAPHICS_GL and IGRAPHICS_NANOVG with OS_LINUX
+    #endif
   #elif defined OS_WEB
     #if defined IGRAPHICS_GLES2
       #define NANOVG_GLES2_IMPLEMENTATION
@@ -56,16 +62,17 @@
   #include "nanovg_gl_utils.h"
 #elif defined IGRAPHICS_METAL
   #include "nanovg_mtl.h"
-  #if defined OS_MAC
-    //even though this is a .cpp we are in an objc(pp) compilation unit
-    #import <Metal/Metal.h>
-  #endif
+  //even though this is a .cpp we are in an objc(pp) compilation unit, it is included by IGraphicsMac.mm and IGraphicsIOS.mm
+  #import <Metal/Metal.h>
 #else
   #error you must define either IGRAPHICS_GL2, IGRAPHICS_GLES2 etc or IGRAPHICS_METAL when using IGRAPHICS_NANOVG
 #endif
 
 #include <string>
 #include <map>
+#include <vector>
+
+#include "stb_image.h"
 
 using namespace iplug;
 using namespace igraphics;
@@ -78,15 +85,111 @@ public:
   Bitmap(NVGcontext* pContext, const char* path, double sourceScale, int nvgImageID, bool shared = false);
   Bitmap(IGraphicsNanoVG* pGraphics, NVGcontext* pContext, int width, int height, float scale, float drawScale);
   Bitmap(NVGcontext* pContext, int width, int height, const uint8_t* pData, float scale, float drawScale);
+  Bitmap(NVGcontext* pContext, std::vector<int>&& pages, int width, int height, int pageSize, bool verticalPages, double sourceScale);
+  /** A bitmap that is being decoded in the background, which has no image until SetImage() is called */
+  Bitmap(NVGcontext* pContext, int width, int height, double sourceScale);
+  void SetImage(int nvgImageID) { SetBitmap(nvgImageID, GetWidth(), GetHeight(), GetScale(), GetDrawScale()); SetLoaded(true); }
   virtual ~Bitmap();
   NVGframebuffer* GetFBO() const { return mFBO; }
+  
+  /** @return The number of images the bitmap is split into, which is more than one for bitmaps larger than the maximum texture size */
+  int NPages() const { return mPages.empty() ? 1 : static_cast<int>(mPages.size()); }
+  
+  /** @return The image of a page */
+  int GetPage(int page) const { return mPages.empty() ? GetBitmap() : mPages[page]; }
+  
+  /** @return The area of the bitmap covered by a page, in pixels */
+  IRECT GetPageRect(int page) const
+  {
+    if (mPages.empty())
+      return IRECT(0.f, 0.f, (float) GetWidth(), (float) GetHeight());
+    
+    const float start = (float) (page * mPageSize);
+    
+    if (mVerticalPages)
+      return IRECT(0.f, start, (float) GetWidth(), std::min(start + mPageSize, (float) GetHeight()));
+    else
+      return IRECT(start, 0.f, std::min(start + mPageSize, (float) GetWidth()), (float) GetHeight());
+  }
+#ifdef IGRAPHICS_METAL
+  /** Record that the texture is registered with the given key in the textures shared between contexts, see ReleaseSharedTexture() */
+  void SetSharedTextureKey(const std::string& key) { mSharedTextureKey = key; }
+#endif
 private:
   IGraphicsNanoVG *mGraphics = nullptr;
   NVGcontext* mVG;
   NVGframebuffer* mFBO = nullptr;
   bool mSharedTexture = false;
+  std::vector<int> mPages; // the images of a bitmap that is split into pages, in order along its longer side
+  int mPageSize = 0;
+  bool mVerticalPages = true;
+#ifdef IGRAPHICS_METAL
+  std::string mSharedTextureKey;
+#endif
 };
 
+#ifdef IGRAPHICS_METAL
+// Textures of the bitmaps loaded from files, resources or memory, which are shared by the NanoVG contexts of all instances
+// on the same MTLDevice, so that each bitmap is resident once however many editors are open
+struct SharedTexture
+{
+  void* pTexture = nullptr; // id<MTLTexture>, which is kept alive by the contexts that use it rather than by this list
+  int refCount = 0;
+};
+
+static std::map<std::string, SharedTexture> sSharedTextures;
+static WDL_Mutex sSharedTexturesMutex;
+
+static std::string SharedTextureKey(NVGcontext* pContext, const char* name, int scale)
+{
+  char prefix[64];
+  snprintf(prefix, sizeof(prefix), "%p@%i:", mnvgDevice(pContext), scale);
+  return std::string(prefix) + name;
+}
+
+/** @return An image in pContext for a texture already loaded by another context, or 0 */
+static int AcquireSharedTexture(NVGcontext* pContext, const std::string& key)
+{
+  WDL_MutexLock lock(&sSharedTexturesMutex);
+  auto it = sSharedTextures.find(key);
+  
+  if (it == sSharedTextures.end())
+    return 0;
+  
+  const int idx = mnvgCreateImageFromHandle(pContext, it->second.pTexture, 0);
+  
+  if (idx)
+    it->second.refCount++;
+  
+  return idx;
+}
+
+/** Make the texture of an image that has just been loaded available to other contexts
+ * @return \c true if it was added, \c false if another context added a texture with the same key in the meantime */
+static bool AddSharedTexture(NVGcontext* pContext, const std::string& key, int idx)
+{
+  WDL_MutexLock lock(&sSharedTexturesMutex);
+  SharedTexture& texture = sSharedTextures[key];
+  
+  if (texture.refCount)
+    return false;
+  
+  texture.pTexture = mnvgImageHandle(pContext, idx);
+  texture.refCount = 1;
+  return true;
+}
+
+/** Called when a context deletes its image of a shared texture */
+static void ReleaseSharedTexture(const std::string& key)
+{
+  WDL_MutexLock lock(&sSharedTexturesMutex);
+  auto it = sSharedTextures.find(key);
+  
+  if (it != sSharedTextures.end() && --it->second.refCount == 0)
+    sSharedTextures.erase(it);
+}
+#endif
+
 IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, const char* path, double sourceScale, int nvgImageID, bool shared)
 {
   assert(nvgImageID > 0);
@@ -128,6 +231,24 @@ IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, int width, int height, con
   SetBitmap(idx, width, height, scale, drawScale);
 }
 
+IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, std::vector<int>&& pages, int width, int height, int pageSize, bool verticalPages, double sourceScale)
+: mVG(pContext)
+, mPages(std::move(pages))
+, mPageSize(pageSize)
+, mVerticalPages(verticalPages)
+{
+  assert(mPages.size() && mPages[0] > 0);
+  
+  SetBitmap(mPages[0], width, height, sourceScale, 1.f);
+}
+
+IGraphicsNanoVG::Bitmap::Bitmap(NVGcontext* pContext, int width, int height, double sourceScale)
+: mVG(pContext)
+{
+  SetBitmap(0, width, height, sourceScale, 1.f);
+  SetLoaded(false);
+}
+
 IGraphicsNanoVG::Bitmap::~Bitmap()
 {
   if(!mSharedTexture)
@@ -136,7 +257,15 @@ IGraphicsNanoVG::Bitmap::~Bitmap()
       mGraphics->DeleteFBO(mFBO);
     else
       nvgDeleteImage(mVG, GetBitmap());
+    
+    for (size_t i = 1; i < mPages.size(); i++)
+      nvgDeleteImage(mVG, mPages[i]);
   }
+  
+#ifdef IGRAPHICS_METAL
+  if (!mSharedTextureKey.empty())
+    ReleaseSharedTexture(mSharedTextureKey);
+#endif
 }
 
 // Fonts
@@ -154,6 +283,116 @@ static void nvgReadPixels(NVGcontext* pContext, int image, int x, int y, int wid
 #endif
 }
 
+// Precompressed textures
+// The formats of the KTX files that can be uploaded, identified by their GL internal format. All of them are 4x4 blocks of 16 bytes
+enum EKTXFormat : uint32_t
+{
+  kKTXFormatBC3 = 0x83F3, // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+  kKTXFormatBC7 = 0x8E8C, // GL_COMPRESSED_RGBA_BPTC_UNORM
+  kKTXFormatETC2 = 0x9278, // GL_COMPRESSED_RGBA8_ETC2_EAC
+  kKTXFormatASTC4x4 = 0x93B0 // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+};
+
+// The first mip level of a KTX (version 1) file, which points into the file's data
+struct KTXImage
+{
+  uint32_t format = 0;
+  int width = 0;
+  int height = 0;
+  const uint8_t* pData = nullptr;
+  int dataSize = 0;
+};
+
+static bool ReadKTXImage(const void* pFileData, int fileSize, KTXImage& image)
+{
+  static const uint8_t kIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+  static constexpr int kHeaderSize = 64;
+  
+  const uint8_t* pFile = static_cast<const uint8_t*>(pFileData);
+  
+  if (!pFile || fileSize < kHeaderSize + 4 || memcmp(pFile, kIdentifier, sizeof(kIdentifier)))
+    return false;
+  
+  // endianness, glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat, pixelWidth, pixelHeight, pixelDepth,
+  // numberOfArrayElements, numberOfFaces, numberOfMipmapLevels, bytesOfKeyValueData
+  uint32_t header[13];
+  memcpy(header, pFile + sizeof(kIdentifier), sizeof(header));
+  
+  // written with the same endianness, compressed (glType is 0), 2D, not an array or a cube map
+  if (header[0] != 0x04030201 || header[1] != 0 || header[8] != 0 || header[9] != 0 || header[10] != 1)
+    return false;
+  
+  switch (header[4])
+  {
+    case kKTXFormatBC3: case kKTXFormatBC7: case kKTXFormatETC2: case kKTXFormatASTC4x4: break;
+    default: return false;
+  }
+  
+  const uint32_t keyValueSize = header[12];
+  
+  if (keyValueSize > static_cast<uint32_t>(fileSize - kHeaderSize - 4))
+    return false;
+  
+  uint32_t imageSize = 0;
+  const int imageOffset = kHeaderSize + keyValueSize + 4;
+  memcpy(&imageSize, pFile + imageOffset - 4, 4);
+  
+  const uint32_t width = header[6];
+  const uint32_t height = header[7];
+  
+  if (!width || !height || imageSize != ((width + 3) / 4) * ((height + 3) / 4) * 16 || imageSize > static_cast<uint32_t>(fileSize - imageOffset))
+    return false;
+  
+  image.format = header[4];
+  image.width = static_cast<int>(width);
+  image.height = static_cast<int>(height);
+  image.pData = pFile + imageOffset;
+  image.dataSize = static_cast<int>(imageSize);
+  
+  return true;
+}
+
+#ifdef IGRAPHICS_GL
+// Upload a compressed image to a texture that is owned by the NanoVG image, returns 0 if the format isn't supported by the driver
+static int CreateCompressedImageGL(NVGcontext* pContext, const KTXImage& image)
+{
+  while (glGetError() != GL_NO_ERROR) {}
+  
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glCompressedTexImage2D(GL_TEXTURE_2D, 0, image.format, image.width, image.height, 0, image.dataSize, image.pData);
+  
+  const bool uploaded = glGetError() == GL_NO_ERROR;
+  
+  if (uploaded)
+  {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  
+  glBindTexture(GL_TEXTURE_2D, 0);
+  
+  if (!uploaded)
+  {
+    glDeleteTextures(1, &texture);
+    return 0;
+  }
+  
+  #if defined IGRAPHICS_GL2
+    return nvglCreateImageFromHandleGL2(pContext, texture, image.width, image.height, 0);
+  #elif defined IGRAPHICS_GL3
+    return nvglCreateImageFromHandleGL3(pContext, texture, image.width, image.height, 0);
+  #elif defined IGRAPHICS_GLES2
+    return nvglCreateImageFromHandleGLES2(pContext, texture, image.width, image.height, 0);
+  #elif defined IGRAPHICS_GLES3
+    return nvglCreateImageFromHandleGLES3(pContext, texture, image.width, image.height, 0);
+  #endif
+}
+#endif
+
 #pragma mark - Utilities
 
 BEGIN_IPLUG_NAMESPACE
@@ -267,7 +506,7 @@ bool IGraphicsNanoVG::BitmapExtSupported(const char* ext)
 {
   char extLower[32];
   ToLower(extLower, ext);
-  return (strstr(extLower, "png") != nullptr) || (strstr(extLower, "jpg") != nullptr) || (strstr(extLower, "jpeg") != nullptr);
+  return (strstr(extLower, "png") != nullptr) || (strstr(extLower, "jpg") != nullptr) || (strstr(extLower, "jpeg") != nullptr) || (strstr(extLower, "ktx") != nullptr);
 }
 
 IBitmap IGraphicsNanoVG::LoadBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale)
@@ -329,8 +568,23 @@ APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* fileNameOrResID, int scale
     int size = 0;
     pResData = LoadWinResource(fileNameOrResID, ext, size, GetWinModuleHandle());
 
+    // a precompressed texture is a resource of type KTX, named as the bitmap with .ktx appended
+    WDL_String ktxResID(fileNameOrResID);
+    
+    if (strcmp(ext, "ktx") && ktxResID.GetLength() > 2 && ktxResID.Get()[0] == '"')
+      ktxResID.Insert(".ktx", ktxResID.GetLength() - 1);
+    
+    int ktxSize = 0;
+    const void* pKTXData = LoadWinResource(ktxResID.Get(), "ktx", ktxSize, GetWinModuleHandle());
+    
+    if (APIBitmap* pCompressedBitmap = LoadCompressedAPIBitmap(fileNameOrResID, pKTXData, ktxSize, scale))
+      return pCompressedBitmap;
+    
     if (pResData)
     {
+      if (APIBitmap* pPagedBitmap = LoadPagedAPIBitmap(nullptr, pResData, size, scale))
+        return pPagedBitmap;
+      
       ActivateGLContext(); // no-op on non WIN/GL
       idx = nvgCreateImageMem(mVG, nvgImageFlags, (unsigned char*) pResData, size);
       DeactivateGLContext(); // no-op on non WIN/GL
@@ -340,9 +594,67 @@ APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* fileNameOrResID, int scale
 #endif
   if (location == EResourceLocation::kAbsolutePath)
   {
+#ifdef IGRAPHICS_METAL
+    const std::string key = SharedTextureKey(mVG, fileNameOrResID, scale);
+    
+    if ((idx = AcquireSharedTexture(mVG, key)))
+    {
+      Bitmap* pBitmap = new Bitmap(mVG, fileNameOrResID, scale, idx);
+      pBitmap->SetSharedTextureKey(key);
+      return pBitmap;
+    }
+#endif
+    
+    // a precompressed texture is used in place of the bitmap if there is one next to it, with .ktx appended to its name
+    WDL_String ktxPath(fileNameOrResID);
+    
+    if (strcmp(ext, "ktx"))
+      ktxPath.Append(".ktx");
+    
+    const IPlugMappedResource ktxData(ktxPath.Get()); // mapped, so the texture is uploaded without copying the file first
+    
+    if (ktxData.IsValid())
+    {
+      if (APIBitmap* pCompressedBitmap = LoadCompressedAPIBitmap(fileNameOrResID, ktxData.Get(), static_cast<int>(ktxData.GetSize()), scale))
+      {
+#ifdef IGRAPHICS_METAL
+        if (AddSharedTexture(mVG, key, pCompressedBitmap->GetBitmap()))
+          static_cast<Bitmap*>(pCompressedBitmap)->SetSharedTextureKey(key);
+#endif
+        return pCompressedBitmap;
+      }
+    }
+    
+    // KTX files requested by name fall back to the bitmap they were made from
+    WDL_String fallbackPath;
+    
+    if (!strcmp(ext, "ktx"))
+    {
+      fallbackPath.Set(fileNameOrResID, ktxPath.GetLength() - 4);
+      fileNameOrResID = fallbackPath.Get();
+    }
+    
+    if (APIBitmap* pPagedBitmap = LoadPagedAPIBitmap(fileNameOrResID, nullptr, 0, scale))
+      return pPagedBitmap;
+    
+    if (GetAsyncBitmapDecoding())
+    {
+      if (APIBitmap* pAsyncBitmap = LoadAPIBitmapAsync(fileNameOrResID, scale))
+        return pAsyncBitmap;
+    }
+    
     ActivateGLContext(); // no-op on non WIN/GL
     idx = nvgCreateImage(mVG, fileNameOrResID, nvgImageFlags);
     DeactivateGLContext(); // no-op on non WIN/GL
+    
+#ifdef IGRAPHICS_METAL
+    if (idx && AddSharedTexture(mVG, key, idx))
+    {
+      Bitmap* pBitmap = new Bitmap(mVG, fileNameOrResID, scale, idx);
+      pBitmap->SetSharedTextureKey(key);
+      return pBitmap;
+    }
+#endif
   }
 
   return new Bitmap(mVG, fileNameOrResID, scale, idx, location == EResourceLocation::kPreloadedTexture);
@@ -353,16 +665,37 @@ APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* name, const void* pData, i
   StaticStorage<APIBitmap>::Accessor storage(mBitmapCache);
   APIBitmap* pBitmap = storage.Find(name, scale);
 
+  if (!pBitmap && (pBitmap = LoadPagedAPIBitmap(nullptr, pData, dataSize, scale)))
+    storage.Add(pBitmap, name, scale);
+  
   if (!pBitmap)
   {
     int idx = 0;
     int nvgImageFlags = 0;
 
+#ifdef IGRAPHICS_METAL
+    const std::string key = SharedTextureKey(mVG, name, scale);
+    bool sharedTexture = (idx = AcquireSharedTexture(mVG, key));
+    
+    if (!sharedTexture)
+    {
+      idx = nvgCreateImageMem(mVG, nvgImageFlags, (unsigned char*)pData, dataSize);
+      sharedTexture = idx && AddSharedTexture(mVG, key, idx);
+    }
+    
+    Bitmap* pNewBitmap = new Bitmap(mVG, name, scale, idx, false);
+    
+    if (sharedTexture)
+      pNewBitmap->SetSharedTextureKey(key);
+    
+    pBitmap = pNewBitmap;
+#else
     ActivateGLContext();
     idx = idx = nvgCreateImageMem(mVG, nvgImageFlags, (unsigned char*)pData, dataSize);
     DeactivateGLContext();
 
     pBitmap = new Bitmap(mVG, name, scale, idx, false);
+#endif
 
     storage.Add(pBitmap, name, scale);
   }
@@ -370,6 +703,150 @@ APIBitmap* IGraphicsNanoVG::LoadAPIBitmap(const char* name, const void* pData, i
   return pBitmap;
 }
 
+APIBitmap* IGraphicsNanoVG::LoadCompressedAPIBitmap(const char* name, const void* pData, int dataSize, int scale)
+{
+  KTXImage image;
+  
+  if (!ReadKTXImage(pData, dataSize, image) || image.width > mMaxTextureSize || image.height > mMaxTextureSize)
+    return nullptr;
+  
+#if defined IGRAPHICS_METAL
+  const int idx = mnvgCreateImageCompressed(mVG, image.format, image.width, image.height, image.pData, image.dataSize, 0);
+#else
+  ActivateGLContext(); // no-op on non WIN/GL
+  const int idx = CreateCompressedImageGL(mVG, image);
+  DeactivateGLContext(); // no-op on non WIN/GL
+#endif
+  
+  return idx ? new Bitmap(mVG, name, scale, idx) : nullptr;
+}
+
+APIBitmap* IGraphicsNanoVG::LoadAPIBitmapAsync(const char* path, int scale)
+{
+  int w = 0, h = 0, n = 0;
+  
+  if (!stbi_info(path, &w, &h, &n))
+    return nullptr;
+  
+  Bitmap* pBitmap = new Bitmap(mVG, w, h, scale);
+  DecodeAPIBitmapAsync(pBitmap, path);
+  return pBitmap;
+}
+
+void IGraphicsNanoVG::RetryAPIBitmapDecode(APIBitmap* pBitmap, const char* path)
+{
+  DecodeAPIBitmapAsync(static_cast<Bitmap*>(pBitmap), path);
+}
+
+void IGraphicsNanoVG::DecodeAPIBitmapAsync(Bitmap* pBitmap, const char* path)
+{
+  // as nvgCreateImage(), these are global so they are set here rather than on the decoding thread
+  stbi_set_unpremultiply_on_load(1);
+  stbi_convert_iphone_png_to_rgb(1);
+  
+#ifdef IGRAPHICS_METAL
+  std::string key = SharedTextureKey(mVG, path, static_cast<int>(pBitmap->GetScale()));
+#endif
+  
+  DecodeBitmapAsync(pBitmap, [this, pBitmap, path = std::string(path)
+#ifdef IGRAPHICS_METAL
+                     , key
+#endif
+                     ]() -> std::function<bool()> {
+    int w = 0, h = 0, n = 0;
+    stbi_uc* pImage = stbi_load(path.c_str(), &w, &h, &n, 4);
+    
+    // called on the UI thread by the next BeginFrame() or by OnViewDestroyed(), before the bitmap and the context are deleted
+    return [this, pBitmap, pImage, w, h
+#ifdef IGRAPHICS_METAL
+            , key
+#endif
+            ]() {
+      if (!pImage)
+        return false;
+      
+      ActivateGLContext(); // no-op on non WIN/GL
+      const int idx = nvgCreateImageRGBA(mVG, w, h, 0, pImage);
+      DeactivateGLContext(); // no-op on non WIN/GL
+      stbi_image_free(pImage);
+      
+      if (!idx)
+        return false;
+      
+      pBitmap->SetImage(idx);
+      
+#ifdef IGRAPHICS_METAL
+      if (AddSharedTexture(mVG, key, idx))
+        pBitmap->SetSharedTextureKey(key);
+#endif
+      return true;
+    };
+  });
+}
+
+APIBitmap* IGraphicsNanoVG::LoadPagedAPIBitmap(const char* path, const void* pData, int dataSize, int scale)
+{
+  int w = 0, h = 0, n = 0;
+  
+  if (!(path ? stbi_info(path, &w, &h, &n) : stbi_info_from_memory((const stbi_uc*) pData, dataSize, &w, &h, &n)))
+    return nullptr;
+  
+  // e.g. a filmstrip at 2x or 3x, which fits along its shorter side
+  const bool vertical = h >= w;
+  
+  if ((w <= mMaxTextureSize && h <= mMaxTextureSize) || (vertical ? w : h) > mMaxTextureSize)
+    return nullptr;
+  
+  // as nvgCreateImage()
+  stbi_set_unpremultiply_on_load(1);
+  stbi_convert_iphone_png_to_rgb(1);
+  stbi_uc* pImage = path ? stbi_load(path, &w, &h, &n, 4) : stbi_load_from_memory((const stbi_uc*) pData, dataSize, &w, &h, &n, 4);
+  
+  if (!pImage)
+    return nullptr;
+  
+  std::vector<int> pages;
+  WDL_TypedBuf<stbi_uc> pageData;
+  const int length = vertical ? h : w;
+  
+  ActivateGLContext(); // no-op on non WIN/GL
+  
+  for (int start = 0; start < length; start += mMaxTextureSize)
+  {
+    const int size = std::min(mMaxTextureSize, length - start);
+    int idx = 0;
+    
+    if (vertical)
+      idx = nvgCreateImageRGBA(mVG, w, size, 0, pImage + static_cast<size_t>(start) * w * 4);
+    else if (pageData.ResizeOK(size * h * 4, false))
+    {
+      for (int y = 0; y < h; y++)
+        memcpy(pageData.Get() + static_cast<size_t>(y) * size * 4, pImage + (static_cast<size_t>(y) * w + start) * 4, size * 4);
+      
+      idx = nvgCreateImageRGBA(mVG, size, h, 0, pageData.Get());
+    }
+    
+    if (!idx)
+    {
+      for (int page : pages)
+        nvgDeleteImage(mVG, page);
+      
+      pages.clear();
+      break;
+    }
+    
+    pages.push_back(idx);
+  }
+  
+  DeactivateGLContext(); // no-op on non WIN/GL
+  stbi_image_free(pImage);
+  
+  if (pages.empty())
+    return nullptr;
+  
+  return new Bitmap(mVG, std::move(pages), w, h, mMaxTextureSize, vertical, scale);
+}
+
 APIBitmap* IGraphicsNanoVG::CreateAPIBitmap(int width, int height, float scale, double drawScale, bool cacheable)
 {
   if (mInDraw)
@@ -388,6 +865,299 @@ APIBitmap* IGraphicsNanoVG::CreateAPIBitmap(int width, int height, float scale,
   return pAPIBitmap;
 }
 
+APIBitmap* IGraphicsNanoVG::CreatePixelAPIBitmap(int width, int height, float scale, double drawScale)
+{
+  // a plain texture rather than a framebuffer, which is flipped vertically on GL
+  return new Bitmap(mVG, width, height, nullptr, scale, static_cast<float>(drawScale));
+}
+
+void IGraphicsNanoVG::UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height)
+{
+  // nvgUpdateImage() uploads the whole image, the backend can upload a region of it
+  const NVGparams* pParams = nvgInternalParams(mVG);
+  pParams->renderUpdateTexture(pParams->userPtr, layer->GetAPIBitmap()->GetBitmap(), x, y, width, height, pData);
+}
+
+#pragma mark - Shaders
+
+// The user's shader defines a function called main() that returns a premultiplied color, like an SkSL shader. It is renamed so that the
+// entry point can call it with the coordinates in points from the top left of the shader's bounds
+class IGraphicsNanoVG::Shader : public APIShader
+{
+public:
+  ~Shader();
+  
+  ILayerPtr mLayer; // the shader draws to a layer, which is then drawn by NanoVG
+#if defined IGRAPHICS_GL
+  GLuint mProgram = 0;
+  GLuint mVertexBuffer = 0;
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  GLuint mVertexArray = 0;
+#endif
+  GLint mInputsLocation = -1;
+  GLint mResolutionLocation = -1;
+  GLint mPixelScaleLocation = -1;
+#elif defined IGRAPHICS_METAL
+  void* mLibrary = nullptr; // id<MTLLibrary>
+  void* mPipeline = nullptr; // id<MTLRenderPipelineState>, made for the pixel format of the layer when first drawn
+#endif
+};
+
+#if defined IGRAPHICS_GL
+
+#if defined IGRAPHICS_GL2
+static const char* kShaderHeader = "#version 110\n#define IPLUG_IN attribute\n";
+#elif defined IGRAPHICS_GL3
+static const char* kShaderHeader = "#version 150\n#define IPLUG_IN in\nout vec4 iplug_FragColor;\n";
+#elif defined IGRAPHICS_GLES2
+static const char* kShaderHeader = "#version 100\nprecision highp float;\n#define IPLUG_IN attribute\n";
+#elif defined IGRAPHICS_GLES3
+static const char* kShaderHeader = "#version 300 es\nprecision highp float;\n#define IPLUG_IN in\nout vec4 iplug_FragColor;\n";
+#endif
+
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+#define IPLUG_FRAG_COLOR "iplug_FragColor"
+#else
+#define IPLUG_FRAG_COLOR "gl_FragColor"
+#endif
+
+static const char* kVertexShader = R"(
+IPLUG_IN vec2 aPos;
+void main() { gl_Position = vec4(aPos, 0.0, 1.0); }
+)";
+
+static const char* kFragmentShaderMain = R"(
+#undef main
+uniform vec2 iplug_Resolution;
+uniform float iplug_PixelScale;
+void main() { )" IPLUG_FRAG_COLOR R"( = iplug_shader_main(vec2(gl_FragCoord.x, iplug_Resolution.y - gl_FragCoord.y) / iplug_PixelScale); }
+)";
+
+static GLuint CompileGLShader(GLenum type, const std::string& source, WDL_String& error)
+{
+  GLuint shader = glCreateShader(type);
+  const char* pSource = source.c_str();
+  glShaderSource(shader, 1, &pSource, nullptr);
+  glCompileShader(shader);
+  
+  GLint status = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  
+  if (status != GL_TRUE)
+  {
+    char log[1024] = {};
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    error.Set(log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  
+  return shader;
+}
+
+IGraphicsNanoVG::Shader::~Shader()
+{
+  glDeleteProgram(mProgram);
+  glDeleteBuffers(1, &mVertexBuffer);
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  glDeleteVertexArrays(1, &mVertexArray);
+#endif
+}
+
+IShaderPtr IGraphicsNanoVG::CreateShader(const char* source, WDL_String& error)
+{
+  GLuint vertexShader = CompileGLShader(GL_VERTEX_SHADER, std::string(kShaderHeader) + kVertexShader, error);
+  
+  if (!vertexShader)
+    return nullptr;
+  
+  GLuint fragmentShader = CompileGLShader(GL_FRAGMENT_SHADER, std::string(kShaderHeader) + "#define main iplug_shader_main\n#line 1\n" + source + kFragmentShaderMain, error);
+  
+  if (!fragmentShader)
+  {
+    glDeleteShader(vertexShader);
+    return nullptr;
+  }
+  
+  std::unique_ptr<Shader> pShader(new Shader);
+  pShader->mProgram = glCreateProgram();
+  glAttachShader(pShader->mProgram, vertexShader);
+  glAttachShader(pShader->mProgram, fragmentShader);
+  glBindAttribLocation(pShader->mProgram, 0, "aPos");
+  glLinkProgram(pShader->mProgram);
+  glDeleteShader(vertexShader);
+  glDeleteShader(fragmentShader);
+  
+  GLint status = 0;
+  glGetProgramiv(pShader->mProgram, GL_LINK_STATUS, &status);
+  
+  if (status != GL_TRUE)
+  {
+    char log[1024] = {};
+    glGetProgramInfoLog(pShader->mProgram, sizeof(log), nullptr, log);
+    error.Set(log);
+    return nullptr;
+  }
+  
+  pShader->mInputsLocation = glGetUniformLocation(pShader->mProgram, "uInputs");
+  pShader->mResolutionLocation = glGetUniformLocation(pShader->mProgram, "iplug_Resolution");
+  pShader->mPixelScaleLocation = glGetUniformLocation(pShader->mProgram, "iplug_PixelScale");
+  
+  // a quad covering the layer, drawn as a triangle strip
+  const float vertices[] = { -1.f, -1.f, 1.f, -1.f, -1.f, 1.f, 1.f, 1.f };
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  glGenVertexArrays(1, &pShader->mVertexArray);
+#endif
+  glGenBuffers(1, &pShader->mVertexBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, pShader->mVertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  
+  return IShaderPtr(pShader.release());
+}
+
+#elif defined IGRAPHICS_METAL
+
+static const char* kShaderHeader = "#include <metal_stdlib>\nusing namespace metal;\n#define main iplug_shader_main\n";
+
+static const char* kShaderMain = R"(
+#undef main
+struct IPlugVertexOut { float4 position [[position]]; };
+
+vertex IPlugVertexOut iplug_vertex(uint vid [[vertex_id]])
+{
+  // a triangle that covers the layer
+  IPlugVertexOut out;
+  float2 pos = float2((vid << 1) & 2, vid & 2);
+  out.position = float4(pos * 2.0 - 1.0, 0.0, 1.0);
+  return out;
+}
+
+fragment float4 iplug_fragment(IPlugVertexOut in [[stage_in]], constant float* uInputs [[buffer(0)]], constant float& pixelScale [[buffer(1)]])
+{
+  return iplug_shader_main(in.position.xy / pixelScale, uInputs);
+}
+)";
+
+IGraphicsNanoVG::Shader::~Shader()
+{
+  if (mLibrary)
+    CFRelease(mLibrary);
+  
+  if (mPipeline)
+    CFRelease(mPipeline);
+}
+
+IShaderPtr IGraphicsNanoVG::CreateShader(const char* source, WDL_String& error)
+{
+  id<MTLDevice> device = (__bridge id<MTLDevice>) mnvgDevice(mVG);
+  NSString* pSource = [NSString stringWithUTF8String:(std::string(kShaderHeader) + source + kShaderMain).c_str()];
+  NSError* pError = nil;
+  id<MTLLibrary> library = [device newLibraryWithSource:pSource options:nil error:&pError];
+  
+  if (!library)
+  {
+    error.Set(pError ? pError.localizedDescription.UTF8String : "The shader could not be compiled");
+    return nullptr;
+  }
+  
+  std::unique_ptr<Shader> pShader(new Shader);
+  pShader->mLibrary = (__bridge_retained void*) library;
+  return IShaderPtr(pShader.release());
+}
+
+#endif
+
+void IGraphicsNanoVG::DrawShader(APIShader& shader, const IRECT& bounds, const float* pInputs, int nInputs, const IBlend* pBlend)
+{
+  Shader& nvgShader = static_cast<Shader&>(shader);
+  
+  if (!CheckLayer(nvgShader.mLayer) || nvgShader.mLayer->Bounds() != bounds.GetPixelAligned(GetBackingPixelScale()))
+  {
+    StartLayer(nullptr, bounds);
+    nvgShader.mLayer = EndLayer();
+  }
+  
+  const APIBitmap* pBitmap = nvgShader.mLayer->GetAPIBitmap();
+  const float pixelScale = pBitmap->GetScale() * pBitmap->GetDrawScale();
+  
+  // binding the layer flushes what NanoVG has drawn so far, so that the shader is drawn in order
+  PushLayer(nvgShader.mLayer.get());
+  
+#if defined IGRAPHICS_GL
+  glDisable(GL_BLEND);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glUseProgram(nvgShader.mProgram);
+  
+  if (nvgShader.mInputsLocation >= 0 && nInputs > 0)
+    glUniform1fv(nvgShader.mInputsLocation, nInputs, pInputs);
+  
+  glUniform2f(nvgShader.mResolutionLocation, static_cast<float>(pBitmap->GetWidth()), static_cast<float>(pBitmap->GetHeight()));
+  glUniform1f(nvgShader.mPixelScaleLocation, pixelScale);
+  
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  glBindVertexArray(nvgShader.mVertexArray);
+#endif
+  glBindBuffer(GL_ARRAY_BUFFER, nvgShader.mVertexBuffer);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  
+  // NanoVG sets the rest of its state when it next draws
+  glDisableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  glBindVertexArray(0);
+#endif
+  glUseProgram(0);
+#elif defined IGRAPHICS_METAL
+  id<MTLTexture> texture = (__bridge id<MTLTexture>) mnvgImageHandle(mVG, pBitmap->GetBitmap());
+  
+  if (!nvgShader.mPipeline)
+  {
+    id<MTLDevice> device = (__bridge id<MTLDevice>) mnvgDevice(mVG);
+    id<MTLLibrary> library = (__bridge id<MTLLibrary>) nvgShader.mLibrary;
+    MTLRenderPipelineDescriptor* pDescriptor = [MTLRenderPipelineDescriptor new];
+    pDescriptor.vertexFunction = [library newFunctionWithName:@"iplug_vertex"];
+    pDescriptor.fragmentFunction = [library newFunctionWithName:@"iplug_fragment"];
+    pDescriptor.colorAttachments[0].pixelFormat = texture.pixelFormat;
+    NSError* pError = nil;
+    id<MTLRenderPipelineState> pipeline = [device newRenderPipelineStateWithDescriptor:pDescriptor error:&pError];
+    
+    if (!pipeline)
+    {
+      DBGMSG("%s\n", pError ? pError.localizedDescription.UTF8String : "The shader pipeline could not be made");
+      PopLayer();
+      return;
+    }
+    
+    nvgShader.mPipeline = (__bridge_retained void*) pipeline;
+  }
+  
+  // the command buffer is committed to NanoVG's queue before the frames that draw the layer
+  id<MTLCommandQueue> queue = (__bridge id<MTLCommandQueue>) mnvgCommandQueue(mVG);
+  MTLRenderPassDescriptor* pPass = [MTLRenderPassDescriptor renderPassDescriptor];
+  pPass.colorAttachments[0].texture = texture;
+  pPass.colorAttachments[0].loadAction = MTLLoadActionDontCare;
+  pPass.colorAttachments[0].storeAction = MTLStoreActionStore;
+  
+  const float noInputs = 0.f;
+  id<MTLCommandBuffer> commandBuffer = [queue commandBuffer];
+  id<MTLRenderCommandEncoder> encoder = [commandBuffer renderCommandEncoderWithDescriptor:pPass];
+  [encoder setRenderPipelineState:(__bridge id<MTLRenderPipelineState>) nvgShader.mPipeline];
+  [encoder setFragmentBytes:(nInputs > 0 ? pInputs : &noInputs) length:std::max(nInputs, 1) * sizeof(float) atIndex:0];
+  [encoder setFragmentBytes:&pixelScale length:sizeof(float) atIndex:1];
+  [encoder drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+  [encoder endEncoding];
+  [commandBuffer commit];
+#endif
+  
+  PopLayer();
+  DrawLayer(nvgShader.mLayer, pBlend);
+}
+
 void IGraphicsNanoVG::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data)
 {
   const APIBitmap* pBitmap = layer->GetAPIBitmap();
@@ -453,6 +1223,7 @@ void IGraphicsNanoVG::OnViewInitialized(void* pContext)
   mVG = nvgCreateContext(pContext, NVG_ANTIALIAS | NVG_TRIPLE_BUFFER); //TODO: NVG_STENCIL_STROKES currently has issues
 #else
   mVG = nvgCreateContext(NVG_ANTIALIAS /*| NVG_STENCIL_STROKES*/);
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &mMaxTextureSize);
 #endif
 
   if (mVG == nullptr)
@@ -461,6 +1232,9 @@ void IGraphicsNanoVG::OnViewInitialized(void* pContext)
 
 void IGraphicsNanoVG::OnViewDestroyed()
 {
+  // the bitmaps still decoding are uploaded while the context exists, before they are deleted with the cache
+  FinishBitmapDecoding();
+  
   // need to remove all the controls to free framebuffers, before deleting context
   RemoveAllControls();
 
@@ -499,8 +1273,11 @@ void IGraphicsNanoVG::BeginFrame()
 
 #ifdef IGRAPHICS_GL
     glViewport(0, 0, WindowWidth() * GetScreenScale(), WindowHeight() * GetScreenScale());
-    glClearColor(0.f, 0.f, 0.f, 0.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    if (!CanBlitMainFrameBuffer()) // otherwise the whole window is overwritten by the blit in EndFrame()
+    {
+      glClearColor(0.f, 0.f, 0.f, 0.f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
   #if defined OS_MAC
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &mInitialFBO); // stash apple fbo
   #endif
@@ -510,9 +1287,38 @@ void IGraphicsNanoVG::BeginFrame()
   nvgBeginFrame(mVG, WindowWidth(), WindowHeight(), GetScreenScale());
 }
 
+bool IGraphicsNanoVG::CanBlitMainFrameBuffer() const
+{
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  return mXTranslation == 0.f && mYTranslation == 0.f;
+#else
+  return false;
+#endif
+}
+
 void IGraphicsNanoVG::EndFrame()
 {
   nvgEndFrame(mVG); // end main frame buffer update
+
+#if defined IGRAPHICS_GL3 || defined IGRAPHICS_GLES3
+  if (CanBlitMainFrameBuffer())
+  {
+    // The main frame buffer keeps the previous frame, so only the dirty regions have been drawn into it.
+    // The window's buffer isn't preserved between swaps, so it is copied in full, but as a plain blit rather than a cleared, textured quad
+    const int w = static_cast<int>(WindowWidth() * GetScreenScale());
+    const int h = static_cast<int>(WindowHeight() * GetScreenScale());
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mMainFrameBuffer->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mInitialFBO);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, mInitialFBO);
+
+    mInDraw = false;
+    ClearFBOStack();
+    return;
+  }
+#endif
+
   nvgBindFramebuffer(nullptr);
   nvgBeginFrame(mVG, WindowWidth(), WindowHeight(), GetScreenScale());
   
@@ -542,6 +1348,17 @@ void IGraphicsNanoVG::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int s
   APIBitmap* pAPIBitmap = bitmap.GetAPIBitmap();
   
   assert(pAPIBitmap);
+  
+  if (!pAPIBitmap->IsLoaded())
+    return;
+  
+  const Bitmap* pBitmap = static_cast<const Bitmap*>(pAPIBitmap);
+  
+  if (pBitmap->NPages() > 1)
+  {
+    DrawBitmapPages(pBitmap, dest, srcX, srcY, pBlend);
+    return;
+  }
     
   // First generate a scaled image paint
   NVGpaint imgPaint;
@@ -640,9 +1457,22 @@ void IGraphicsNanoVG::PrepareAndMeasureText(const IText& text, const char* str,
   }
   
   nvgTextAlign(mVG, align);
+  
+  // the bounds are snapped to device pixels, so they depend on the position and the scale as well as the text
+  float xform[6];
+  nvgCurrentTransform(mVG, xform);
+  const uint64_t key = TextLayoutKey(text, str, {(float) x, (float) y, (float) align, GetScreenScale(), xform[0], xform[1], xform[2], xform[3]});
+  
+  if (const IRECT* pBounds = mTextLayoutCache.Find(key))
+  {
+    r = *pBounds;
+    return;
+  }
+  
   nvgTextBounds(mVG, x, y, str, NULL, fbounds);
   
   r = IRECT(fbounds[0], fbounds[1], fbounds[2], fbounds[3]);
+  mTextLayoutCache.Add(key, IRECT(r));
 }
 
 float IGraphicsNanoVG::DoMeasureText(const IText& text, const char* str, IRECT& bounds) const
@@ -670,6 +1500,22 @@ void IGraphicsNanoVG::DoDrawText(const IText& text, const char* str, const IRECT
   PathTransformRestore();
 }
 
+void IGraphicsNanoVG::DoPrewarmGlyphs(const IText& text, const char* glyphs)
+{
+  if (nvgFindFont(mVG, text.mFont) == -1)
+    return;
+  
+  // the atlas is keyed by the size in device pixels, so the glyphs are rasterized at the scale the controls are drawn at
+  nvgSave(mVG);
+  nvgResetTransform(mVG);
+  nvgScale(mVG, GetDrawScale(), GetDrawScale());
+  nvgFontBlur(mVG, 0);
+  nvgFontSize(mVG, text.mSize);
+  nvgFontFace(mVG, text.mFont);
+  nvgPrewarmText(mVG, glyphs, NULL);
+  nvgRestore(mVG);
+}
+
 void IGraphicsNanoVG::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
 {
   // First set options
@@ -752,7 +1598,8 @@ bool IGraphicsNanoVG::LoadAPIFont(const char* fontID, const PlatformFontPtr& fon
 
   if (data->IsValid() && nvgCreateFontFaceMem(mVG, fontID, data->Get(), data->GetSize(), data->GetFaceIdx(), 0) != -1)
   {
-    storage.Add(data.release(), fontID);
+    const size_t bytes = data->GetSize();
+    storage.Add(data.release(), fontID, 1., bytes);
     return true;
   }
 
@@ -806,6 +1653,43 @@ void IGraphicsNanoVG::SetClipRegion(const IRECT& r)
   nvgScissor(mVG, r.L, r.T, r.W(), r.H());
 }
 
+void IGraphicsNanoVG::DrawBitmapPages(const Bitmap* pBitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
+{
+  const float scale = 1.f / (pBitmap->GetScale() * pBitmap->GetDrawScale());
+  
+  NanoVGSetBlendMode(mVG, pBlend);
+  
+  // draw the part of dest covered by each page, e.g. a filmstrip frame can straddle two pages
+  for (int i = 0; i < pBitmap->NPages(); i++)
+  {
+    const IRECT pageRect = pBitmap->GetPageRect(i);
+    const float x = dest.L - srcX + pageRect.L * scale;
+    const float y = dest.T - srcY + pageRect.T * scale;
+    const IRECT pageDest = IRECT(x, y, x + pageRect.W() * scale, y + pageRect.H() * scale).Intersect(dest);
+    
+    if (pageDest.Empty())
+      continue;
+    
+    NVGpaint imgPaint;
+    nvgTransformScale(imgPaint.xform, scale, scale);
+    imgPaint.xform[4] = x;
+    imgPaint.xform[5] = y;
+    imgPaint.extent[0] = pageRect.W();
+    imgPaint.extent[1] = pageRect.H();
+    imgPaint.image = pBitmap->GetPage(i);
+    imgPaint.radius = imgPaint.feather = 0.f;
+    imgPaint.innerColor = imgPaint.outerColor = nvgRGBAf(1, 1, 1, BlendWeight(pBlend));
+    
+    nvgBeginPath(mVG);
+    nvgRect(mVG, pageDest.L, pageDest.T, pageDest.W(), pageDest.H());
+    nvgFillPaint(mVG, imgPaint);
+    nvgFill(mVG);
+  }
+  
+  nvgGlobalCompositeOperation(mVG, NVG_SOURCE_OVER);
+  nvgBeginPath(mVG); // Clears the bitmap rect from the path state
+}
+
 void IGraphicsNanoVG::DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen)
 {
   const float xd = x1 - x2;
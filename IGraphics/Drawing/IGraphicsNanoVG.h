@@ -20,6 +20,11 @@
 // Thanks to Olli Wang/MOUI for much of this macro magic  https://github.com/ollix/moui
 
 #if defined IGRAPHICS_GL
+  #if defined OS_LINUX // the GL headers aren't included before this on Linux, e.g. by IGraphicsNanoVG.cpp
+    #define GL_GLEXT_PROTOTYPES
+    #include <GL/gl.h>
+    #include <GL/glext.h>
+  #endif
   #define NANOVG_FBO_VALID 1
   #include "nanovg_gl_utils.h"
 #elif defined IGRAPHICS_METAL
@@ -82,6 +87,7 @@ class IGraphicsNanoVG : public IGraphics
 {
 private:
   class Bitmap;
+  class Shader;
   
 public:
   IGraphicsNanoVG(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
@@ -122,11 +128,16 @@ public:
   bool BitmapExtSupported(const char* ext) override;
 
   void DeleteFBO(NVGframebuffer* pBuffer);
+
+  IShaderPtr CreateShader(const char* source, WDL_String& error) override;
+  void DrawShader(APIShader& shader, const IRECT& bounds, const float* pInputs, int nInputs, const IBlend* pBlend) override;
   
 protected:
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* LoadAPIBitmap(const char* name, const void* pData, int dataSize, int scale) override;
+  void RetryAPIBitmapDecode(APIBitmap* pBitmap, const char* path) override;
   APIBitmap* CreateAPIBitmap(int width, int height, float scale, double drawScale, bool cacheable = false) override;
+  APIBitmap* CreatePixelAPIBitmap(int width, int height, float scale, double drawScale) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
 
@@ -142,10 +153,12 @@ protected:
   }
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  void UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
 
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
+  void DoPrewarmGlyphs(const IText& text, const char* glyphs) override;
 
 private:
   void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
@@ -153,14 +166,39 @@ private:
   void SetClipRegion(const IRECT& r) override;
   void UpdateLayer() override;
   void ClearFBOStack();
+
+  /** Load a bitmap from a precompressed texture in a KTX file, e.g. BC7 on desktop or ASTC on iOS, which is uploaded without decoding
+   * @param name The path or resource ID of the bitmap it replaces
+   * @param pData The contents of the KTX file
+   * @return The bitmap, or nullptr if the data isn't a supported KTX file or the GPU doesn't support its format, in which case the bitmap itself should be loaded */
+  APIBitmap* LoadCompressedAPIBitmap(const char* name, const void* pData, int dataSize, int scale);
+  
+  /** Load a bitmap from a file that is decoded in the background, see IGraphics::SetAsyncBitmapDecoding()
+   * @return The bitmap, which has no image until it has been decoded, or nullptr if the file can't be read */
+  APIBitmap* LoadAPIBitmapAsync(const char* path, int scale);
+
+  /** Decode a bitmap from a file in the background, into a bitmap that has no image yet */
+  void DecodeAPIBitmapAsync(Bitmap* pBitmap, const char* path);
+  
+  /** Load a bitmap that is larger than the maximum texture size, e.g. a long filmstrip at a high scale, as several images along its longer side
+   * @param path The path of the file, or nullptr to load from pData
+   * @return The bitmap, or nullptr if it fits in one texture, or can't be split because it is too large in both directions */
+  APIBitmap* LoadPagedAPIBitmap(const char* path, const void* pData, int dataSize, int scale);
+  
+  void DrawBitmapPages(const Bitmap* pBitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend);
+
+  /** @return \c true if EndFrame() can copy the main frame buffer to the window with glBlitFramebuffer, which needs GL3/GLES3 and no translation */
+  bool CanBlitMainFrameBuffer() const;
   
   bool mInDraw = false;
   WDL_Mutex mFBOMutex;
   std::stack<NVGframebuffer*> mFBOStack; // A stack of FBOs that requires freeing at the end of the frame
   StaticStorage<APIBitmap> mBitmapCache; //not actually static (doesn't require retaining or releasing)
   NVGcontext* mVG = nullptr;
+  mutable ILRUCache<IRECT> mTextLayoutCache {TEXT_LAYOUT_CACHE_SIZE}; // the bounds measured by PrepareAndMeasureText()
   NVGframebuffer* mMainFrameBuffer = nullptr;
   int mInitialFBO = 0;
+  int mMaxTextureSize = 8192; // larger bitmaps are split into pages, on GL this is queried from the driver
 };
 
 END_IGRAPHICS_NAMESPACE
@@ -8,11 +8,13 @@
 #include "SkDashPathEffect.h"
 #include "SkGradientShader.h"
 #include "SkMaskFilter.h"
+#include "SkImageFilters.h"
 #include "SkFont.h"
 #include "SkFontMetrics.h"
 #include "SkTypeface.h"
 #include "SkVertices.h"
 #include "SkSwizzle.h"
+#include "SkRuntimeEffect.h"
 #pragma warning( pop )
 
 #if defined OS_MAC || defined OS_IOS
@@ -50,13 +52,79 @@ extern std::map<std::string, MTLTexturePtr> gTextureMap;
 
 #pragma mark - Private Classes and Structs
 
+#ifdef IGRAPHICS_METAL
+/** The instances in the process share a Skia context and command queue for each Metal device, so that images, layers and glyph atlases
+ * are uploaded to one resource cache rather than once per instance */
+struct SharedMetalContext
+{
+  id<MTLDevice> device = nil;
+  id<MTLCommandQueue> commandQueue = nil;
+  sk_sp<GrDirectContext> grContext;
+  int refCount = 0;
+};
+
+static WDL_Mutex sSharedMetalContextsMutex;
+static std::vector<SharedMetalContext> sSharedMetalContexts;
+
+static SharedMetalContext RetainSharedMetalContext(id<MTLDevice> device)
+{
+  WDL_MutexLock lock(&sSharedMetalContextsMutex);
+  
+  for (auto& shared : sSharedMetalContexts)
+  {
+    if (shared.device == device)
+    {
+      shared.refCount++;
+      return shared;
+    }
+  }
+  
+  SharedMetalContext shared;
+  shared.device = device;
+  shared.commandQueue = [device newCommandQueue];
+  GrMtlBackendContext backendContext = {};
+  backendContext.fDevice.retain((__bridge GrMTLHandle) device);
+  backendContext.fQueue.retain((__bridge GrMTLHandle) shared.commandQueue);
+  shared.grContext = GrDirectContext::MakeMetal(backendContext);
+  shared.refCount = 1;
+  sSharedMetalContexts.push_back(shared);
+  
+  return shared;
+}
+
+static void ReleaseSharedMetalContext(id<MTLDevice> device)
+{
+  WDL_MutexLock lock(&sSharedMetalContextsMutex);
+  
+  for (auto it = sSharedMetalContexts.begin(); it != sSharedMetalContexts.end(); it++)
+  {
+    if (it->device == device)
+    {
+      // N.B. the resources of other instances are still in use, so the cache isn't purged, this instance's are dropped by its budget
+      if (--it->refCount == 0)
+      {
+        it->grContext = nullptr; // before its queue
+        [it->commandQueue release];
+        sSharedMetalContexts.erase(it);
+      }
+      
+      return;
+    }
+  }
+}
+#endif
+
 class IGraphicsSkia::Bitmap : public APIBitmap
 {
 public:
   Bitmap(sk_sp<SkSurface> surface, int width, int height, float scale, float drawScale);
-  Bitmap(const char* path, double sourceScale);
+  /** @param decode Pass \c false to keep the image lazy, so that it can be decoded later with SetImage() */
+  Bitmap(const char* path, double sourceScale, bool decode = true);
   Bitmap(const void* pData, int size, double sourceScale);
   Bitmap(sk_sp<SkImage>, double sourceScale);
+  
+  sk_sp<SkImage> GetImage() const { return mDrawable.mImage; }
+  void SetImage(sk_sp<SkImage> image) { mDrawable.mImage = image; SetLoaded(true); }
 
 private:
   SkiaDrawable mDrawable;
@@ -70,7 +138,7 @@ IGraphicsSkia::Bitmap::Bitmap(sk_sp<SkSurface> surface, int width, int height, f
   SetBitmap(&mDrawable, width, height, scale, drawScale);
 }
 
-IGraphicsSkia::Bitmap::Bitmap(const char* path, double sourceScale)
+IGraphicsSkia::Bitmap::Bitmap(const char* path, double sourceScale, bool decode)
 {
   sk_sp<SkData> data = SkData::MakeFromFileName(path);
   
@@ -79,13 +147,15 @@ IGraphicsSkia::Bitmap::Bitmap(const char* path, double sourceScale)
   auto image = SkImage::MakeFromEncoded(data);
   
 #ifdef IGRAPHICS_CPU
-  image = image->makeRasterImage();
+  if (decode)
+    image = image->makeRasterImage();
 #endif
   
   mDrawable.mImage = image;
   
   mDrawable.mIsSurface = false;
   SetBitmap(&mDrawable, mDrawable.mImage->width(), mDrawable.mImage->height(), sourceScale, 1.f);
+  SetLoaded(decode);
 }
 
 IGraphicsSkia::Bitmap::Bitmap(const void* pData, int size, double sourceScale)
@@ -315,9 +385,38 @@ APIBitmap* IGraphicsSkia::LoadAPIBitmap(const char* fileNameOrResID, int scale,
   }
   else
 #endif
+  if (GetAsyncBitmapDecoding())
+  {
+    Bitmap* pBitmap = new Bitmap(fileNameOrResID, scale, false);
+    DecodeAPIBitmapAsync(pBitmap, pBitmap->GetImage());
+    return pBitmap;
+  }
+  
   return new Bitmap(fileNameOrResID, scale);
 }
 
+void IGraphicsSkia::RetryAPIBitmapDecode(APIBitmap* pBitmap, const char* path)
+{
+  DecodeAPIBitmapAsync(static_cast<Bitmap*>(pBitmap), SkImage::MakeFromEncoded(SkData::MakeFromFileName(path)));
+}
+
+void IGraphicsSkia::DecodeAPIBitmapAsync(Bitmap* pBitmap, sk_sp<SkImage> lazyImage)
+{
+  // the finish function only swaps the image, it doesn't need the context, as the bitmap may be shared with other instances
+  DecodeBitmapAsync(pBitmap, [pBitmap, lazyImage]() -> std::function<bool()> {
+    sk_sp<SkImage> image = lazyImage ? lazyImage->makeRasterImage() : nullptr;
+    
+    return [pBitmap, lazyImage, image]() {
+      if (!lazyImage)
+        return false;
+      
+      // if it couldn't be decoded now, the lazy image is decoded when it is drawn
+      pBitmap->SetImage(image ? image : lazyImage);
+      return true;
+    };
+  });
+}
+
 APIBitmap* IGraphicsSkia::LoadAPIBitmap(const char* name, const void* pData, int dataSize, int scale)
 {
   return new Bitmap(pData, dataSize, scale);
@@ -331,13 +430,10 @@ void IGraphicsSkia::OnViewInitialized(void* pContext)
 #elif defined IGRAPHICS_METAL
   CAMetalLayer* pMTLLayer = (CAMetalLayer*) pContext;
   id<MTLDevice> device = pMTLLayer.device;
-  id<MTLCommandQueue> commandQueue = [device newCommandQueue];
-  GrMtlBackendContext backendContext = {};
-  backendContext.fDevice.retain((__bridge GrMTLHandle) device);
-  backendContext.fQueue.retain((__bridge GrMTLHandle) commandQueue);
-  mGrContext = GrDirectContext::MakeMetal(backendContext);
+  SharedMetalContext shared = RetainSharedMetalContext(device);
+  mGrContext = shared.grContext;
   mMTLDevice = (void*) device;
-  mMTLCommandQueue = (void*) commandQueue;
+  mMTLCommandQueue = (void*) shared.commandQueue;
   mMTLLayer = pContext;
 #endif
 
@@ -346,6 +442,17 @@ void IGraphicsSkia::OnViewInitialized(void* pContext)
 
 void IGraphicsSkia::OnViewDestroyed()
 {
+  FinishBitmapDecoding();
+  
+#ifndef IGRAPHICS_CPU
+  // finish any reads for GetLayerBitmapDataAsync(), so their callbacks don't outlive the context, their completions are then discarded with the controls
+  if (mGrContext)
+  {
+    mGrContext->flushAndSubmit(true);
+    mGrContext->checkAsyncWorkCompletion();
+  }
+#endif
+  
   RemoveAllControls();
 
 #if defined IGRAPHICS_GL
@@ -353,7 +460,13 @@ void IGraphicsSkia::OnViewDestroyed()
   mScreenSurface = nullptr;
   mGrContext = nullptr;
 #elif defined IGRAPHICS_METAL
-  [(id<MTLCommandQueue>) mMTLCommandQueue release];
+  mSurface = nullptr;
+  mScreenSurface = nullptr;
+  mGrContext = nullptr;
+  
+  if (mMTLDevice)
+    ReleaseSharedMetalContext((id<MTLDevice>) mMTLDevice);
+  
   mMTLCommandQueue = nullptr;
   mMTLLayer = nullptr;
   mMTLDevice = nullptr;
@@ -402,6 +515,12 @@ void IGraphicsSkia::DrawResize()
 
 void IGraphicsSkia::BeginFrame()
 {
+#ifndef IGRAPHICS_CPU
+  // deliver the reads for GetLayerBitmapDataAsync() that the GPU has finished
+  if (mGrContext)
+    mGrContext->checkAsyncWorkCompletion();
+#endif
+  
 #if defined IGRAPHICS_GL
   if (mGrContext.get())
   {
@@ -472,7 +591,7 @@ void IGraphicsSkia::EndFrame()
     StretchDIBits(hdc, 0, 0, w, h, 0, 0, w, h, bmpInfo->bmiColors, bmpInfo, DIB_RGB_COLORS, SRCCOPY);
     ReleaseDC(hWnd, hdc);
     EndPaint(hWnd, &ps);
-  #else
+  #elif !defined IGRAPHICS_HEADLESS // IGraphicsHeadless reads the surface itself
     #error NOT IMPLEMENTED
   #endif
 #else // GPU
@@ -492,6 +611,9 @@ void IGraphicsSkia::EndFrame()
 
 void IGraphicsSkia::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
+  if (!bitmap.IsLoaded())
+    return;
+  
   SkPaint p;
   
   p.setAntiAlias(true);
@@ -581,7 +703,8 @@ bool IGraphicsSkia::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
     
     if (typeface)
     {
-      storage.Add(new Font(std::move(data), typeface), fontID);
+      const size_t bytes = data->GetSize();
+      storage.Add(new Font(std::move(data), typeface), fontID, 1., bytes);
       return true;
     }
   }
@@ -589,30 +712,50 @@ bool IGraphicsSkia::LoadAPIFont(const char* fontID, const PlatformFontPtr& font)
   return false;
 }
 
-void IGraphicsSkia::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y, SkFont& font) const
+static SkFont SkiaFont(const sk_sp<SkTypeface>& typeface, float size)
 {
-  SkFontMetrics metrics;
-  SkPaint paint;
-  //SkRect bounds;
-  
-  StaticStorage<Font>::Accessor storage(sFontCache);
-  Font* pFont = storage.Find(text.mFont);
-  
-  assert(pFont && "No font found - did you forget to load it?");
-
-  font.setTypeface(pFont->mTypeface);
+  SkFont font;
+  font.setEdging(SkFont::Edging::kSubpixelAntiAlias);
+  font.setTypeface(typeface);
   font.setHinting(SkFontHinting::kSlight);
   font.setForceAutoHinting(false);
   font.setSubpixel(true);
-  font.setSize(text.mSize * pFont->mData->GetHeightEMRatio());
+  font.setSize(size);
+  return font;
+}
+
+const IGraphicsSkia::TextLayout& IGraphicsSkia::PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const
+{
+  const uint64_t key = TextLayoutKey(text, str, {});
+  const TextLayout* pLayout = mTextLayoutCache.Find(key);
   
-  // Draw / measure
-  const double textWidth = font.measureText(str, strlen(str), SkTextEncoding::kUTF8, nullptr/* &bounds*/);
-  font.getMetrics(&metrics);
+  if (!pLayout)
+  {
+    SkFontMetrics metrics;
+    TextLayout layout;
+    
+    StaticStorage<Font>::Accessor storage(sFontCache);
+    Font* pFont = storage.Find(text.mFont);
+    
+    assert(pFont && "No font found - did you forget to load it?");
+
+    const SkFont font = SkiaFont(pFont->mTypeface, text.mSize * pFont->mData->GetHeightEMRatio());
+    
+    // Measure and shape
+    const size_t length = strlen(str);
+    layout.width = font.measureText(str, length, SkTextEncoding::kUTF8, nullptr);
+    font.getMetrics(&metrics);
+    layout.ascender = metrics.fAscent;
+    layout.descender = metrics.fDescent;
+    layout.blob = SkTextBlob::MakeFromText(str, length, font, SkTextEncoding::kUTF8);
+    
+    pLayout = &mTextLayoutCache.Add(key, std::move(layout));
+  }
   
+  const double textWidth = pLayout->width;
   const double textHeight = text.mSize;
-  const double ascender = metrics.fAscent;
-  const double descender = metrics.fDescent;
+  const double ascender = pLayout->ascender;
+  const double descender = pLayout->descender;
   
   switch (text.mAlign)
   {
@@ -629,16 +772,15 @@ void IGraphicsSkia::PrepareAndMeasureText(const IText& text, const char* str, IR
   }
   
   r = IRECT((float) x, (float) y + ascender, (float) (x + textWidth), (float) (y + ascender + textHeight));
+  
+  return *pLayout;
 }
 
 float IGraphicsSkia::DoMeasureText(const IText& text, const char* str, IRECT& bounds) const
 {
-  SkFont font;
-  font.setEdging(SkFont::Edging::kSubpixelAntiAlias);
-
   IRECT r = bounds;
   double x, y;
-  PrepareAndMeasureText(text, str, bounds, x, y, font);
+  PrepareAndMeasureText(text, str, bounds, x, y);
   DoMeasureTextRotation(text, r, bounds);
   return bounds.W();
 }
@@ -646,21 +788,88 @@ float IGraphicsSkia::DoMeasureText(const IText& text, const char* str, IRECT& bo
 void IGraphicsSkia::DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend)
 {
   IRECT measured = bounds;
-  
-  SkFont font;
-  font.setEdging(SkFont::Edging::kSubpixelAntiAlias);
-
   double x, y;
 
-  PrepareAndMeasureText(text, str, measured, x, y, font);
+  const TextLayout& layout = PrepareAndMeasureText(text, str, measured, x, y);
+  
+  if (!layout.blob)
+    return;
+  
   PathTransformSave();
   DoTextRotation(text, bounds, measured);
   SkPaint paint;
   paint.setColor(SkiaColor(text.mFGColor, pBlend));
-  mCanvas->drawSimpleText(str, strlen(str), SkTextEncoding::kUTF8, x, y, font, paint);
+  mCanvas->drawTextBlob(layout.blob, x, y, paint);
   PathTransformRestore();
 }
 
+void IGraphicsSkia::DoPrewarmGlyphs(const IText& text, const char* glyphs)
+{
+  SkFont font;
+  
+  {
+    StaticStorage<Font>::Accessor storage(sFontCache);
+    Font* pFont = storage.Find(text.mFont);
+    
+    if (!pFont)
+      return;
+    
+    font = SkiaFont(pFont->mTypeface, text.mSize * pFont->mData->GetHeightEMRatio());
+  }
+  
+  // Glyph images are cached by the process wide strike cache the first time they are drawn at a size, which drawing them offscreen does for all the instances
+  const size_t length = strlen(glyphs);
+  const float scale = GetDrawScale() * GetScreenScale();
+  const float width = font.measureText(glyphs, length, SkTextEncoding::kUTF8, nullptr);
+  SkFontMetrics metrics;
+  font.getMetrics(&metrics);
+  
+  const int w = static_cast<int>(std::ceil(width * scale)) + 1;
+  const int h = static_cast<int>(std::ceil((metrics.fDescent - metrics.fAscent) * scale)) + 1;
+  sk_sp<SkTextBlob> blob = SkTextBlob::MakeFromText(glyphs, length, font, SkTextEncoding::kUTF8);
+  const SkSurfaceProps props = mSurface ? mSurface->props() : SkSurfaceProps();
+  sk_sp<SkSurface> surface = blob ? SkSurface::MakeRaster(SkImageInfo::MakeN32Premul(w, h), &props) : nullptr;
+  
+  if (!surface)
+    return;
+  
+  SkCanvas* pCanvas = surface->getCanvas();
+  pCanvas->scale(scale, scale);
+  pCanvas->drawTextBlob(blob, 0.f, -metrics.fAscent, SkPaint());
+}
+
+bool IGraphicsSkia::PathReuse(uint64_t key)
+{
+  auto it = mPathCache.find(key);
+  
+  if (it == mPathCache.end())
+    return false;
+  
+  // A copy shares the path data, so the GPU backend can reuse the geometry it made for it last time
+  if (mMainPath.isEmpty() && mMatrix.isIdentity())
+    mMainPath = it->second;
+  else
+    mMainPath.addPath(it->second, mMatrix, SkPath::kAppend_AddPathMode);
+  
+  return true;
+}
+
+void IGraphicsSkia::PathCache(uint64_t key)
+{
+  if (mPathCache.size() >= kMaxCachedPaths)
+    mPathCache.clear();
+  
+  SkPath& path = mPathCache[key];
+  SkMatrix invMatrix;
+  
+  if (!mMatrix.isIdentity() && mMatrix.invert(&invMatrix))
+    mMainPath.transform(invMatrix, &path);
+  else
+    path = mMainPath;
+  
+  path.setIsVolatile(false);
+}
+
 void IGraphicsSkia::PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options, const IBlend* pBlend)
 {
   SkPaint paint = SkiaPaint(pattern, pBlend);
@@ -874,6 +1083,46 @@ APIBitmap* IGraphicsSkia::CreateAPIBitmap(int width, int height, float scale, do
   return new Bitmap(std::move(surface), width, height, scale, drawScale);
 }
 
+class IGraphicsSkia::Shader : public APIShader
+{
+public:
+  Shader(sk_sp<SkRuntimeEffect> effect) : mEffect(std::move(effect)) {}
+  
+  sk_sp<SkRuntimeEffect> mEffect;
+};
+
+IShaderPtr IGraphicsSkia::CreateShader(const char* source, WDL_String& error)
+{
+  auto [effect, errorText] = SkRuntimeEffect::MakeForShader(SkString(source));
+  
+  if (!effect)
+  {
+    error.Set(errorText.c_str());
+    return nullptr;
+  }
+  
+  return IShaderPtr(new Shader(std::move(effect)));
+}
+
+void IGraphicsSkia::DrawShader(APIShader& shader, const IRECT& bounds, const float* pInputs, int nInputs, const IBlend* pBlend)
+{
+  const sk_sp<SkRuntimeEffect>& effect = static_cast<Shader&>(shader).mEffect;
+  
+  // uniforms that aren't given an input are zero
+  sk_sp<SkData> uniforms = SkData::MakeZeroInitialized(effect->uniformSize());
+  memcpy(uniforms->writable_data(), pInputs, std::min(effect->uniformSize(), nInputs * sizeof(float)));
+  
+  SkPaint paint;
+  paint.setShader(effect->makeShader(std::move(uniforms), nullptr, 0, nullptr, false));
+  paint.setBlendMode(SkiaBlendMode(pBlend));
+  paint.setAlphaf(BlendWeight(pBlend));
+  
+  mCanvas->save();
+  mCanvas->translate(bounds.L, bounds.T);
+  mCanvas->drawRect(SkRect::MakeWH(bounds.W(), bounds.H()), paint);
+  mCanvas->restore();
+}
+
 void IGraphicsSkia::UpdateLayer()
 {
   mCanvas = mLayers.empty() ? mSurface->getCanvas() : mLayers.top()->GetAPIBitmap()->GetBitmap()->mSurface->getCanvas();
@@ -900,6 +1149,61 @@ void IGraphicsSkia::GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& da
   }
 }
 
+void IGraphicsSkia::UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height)
+{
+  SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
+  const size_t rowBytes = pDrawable->mSurface->width() * 4;
+  SkImageInfo info = SkImageInfo::Make(width, height, kRGBA_8888_SkColorType, kUnpremul_SkAlphaType);
+  SkPixmap pixMap(info, pData + y * rowBytes + x * 4, rowBytes);
+  pDrawable->mSurface->writePixels(pixMap, x, y);
+}
+
+void IGraphicsSkia::GetLayerBitmapDataAsync(const ILayerPtr& layer, ILayerBitmapDataFunc completion)
+{
+#ifdef IGRAPHICS_CPU
+  IGraphics::GetLayerBitmapDataAsync(layer, std::move(completion));
+#else
+  struct Readback
+  {
+    IGraphicsSkia* pGraphics;
+    ILayerBitmapDataFunc completion;
+    int height;
+    size_t rowBytes;
+  };
+  
+  SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
+  const int width = pDrawable->mSurface->width();
+  const int height = pDrawable->mSurface->height();
+  SkImageInfo info = SkImageInfo::MakeN32Premul(width, height);
+  Readback* pReadback = new Readback {this, std::move(completion), height, CalcRowBytes(width)};
+  
+  auto callback = [](SkSurface::ReadPixelsContext context, std::unique_ptr<const SkSurface::AsyncReadResult> result) {
+    std::unique_ptr<Readback> pReadback(static_cast<Readback*>(context));
+    std::unique_ptr<RawBitmapData> pData(new RawBitmapData);
+    
+    if (result && result->count() == 1)
+    {
+      const int size = pReadback->height * static_cast<int>(pReadback->rowBytes);
+      pData->Resize(size);
+      
+      if (pData->GetSize() >= size)
+      {
+        const uint8_t* pSrc = static_cast<const uint8_t*>(result->data(0));
+        const size_t srcRowBytes = result->rowBytes(0);
+        
+        for (int y = 0; y < pReadback->height; y++)
+          memcpy(pData->Get() + y * pReadback->rowBytes, pSrc + y * srcRowBytes, std::min(srcRowBytes, pReadback->rowBytes));
+      }
+    }
+    
+    pReadback->pGraphics->QueueLayerBitmapData(std::move(pData), std::move(pReadback->completion));
+  };
+  
+  // the read is ordered after the drawing submitted so far, and delivered by checkAsyncWorkCompletion() in a later BeginFrame()
+  pDrawable->mSurface->asyncRescaleAndReadPixels(info, SkIRect::MakeWH(width, height), SkSurface::RescaleGamma::kSrc, SkSurface::RescaleMode::kNearest, callback, pReadback);
+#endif
+}
+
 void IGraphicsSkia::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow)
 {
   SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
@@ -943,6 +1247,47 @@ void IGraphicsSkia::ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const
   }
 }
 
+bool IGraphicsSkia::ApplyNativeLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
+{
+  SkiaDrawable* pDrawable = layer->GetAPIBitmap()->GetBitmap();
+  double scale = layer->GetAPIBitmap()->GetDrawScale() * layer->GetAPIBitmap()->GetScale();
+  
+  SkCanvas* pCanvas = pDrawable->mSurface->getCanvas();
+  sk_sp<SkImage> foreground = pDrawable->mSurface->makeImageSnapshot();
+
+  // The CPU blur kernel is exp(-4.5 * x^2 / size^2), which is a gaussian with a sigma of size / 3
+  const float blurSize = std::max(1.f, static_cast<float>(shadow.mBlurSize * scale) + 1.f);
+  const SkScalar sigma = blurSize / 3.f;
+  
+  SkPaint blurPaint;
+  blurPaint.setImageFilter(SkImageFilters::Blur(sigma, sigma, nullptr));
+  
+  SkMatrix m;
+  m.reset();
+  
+  pCanvas->clear(SK_ColorTRANSPARENT);
+  pCanvas->setMatrix(m);
+  pCanvas->drawImage(foreground.get(), shadow.mXOffset * scale, shadow.mYOffset * scale, SkSamplingOptions(), &blurPaint);
+  
+  // Colour the blurred alpha with the pattern
+  IBlend blend(EBlend::Default, shadow.mOpacity);
+  m = SkMatrix::Scale(scale, scale);
+  pCanvas->setMatrix(m);
+  pCanvas->translate(-layer->Bounds().L, -layer->Bounds().T);
+  SkPaint p = SkiaPaint(shadow.mPattern, &blend);
+  p.setBlendMode(SkBlendMode::kSrcIn);
+  pCanvas->drawPaint(p);
+  
+  if (shadow.mDrawForeground)
+  {
+    m.reset();
+    pCanvas->setMatrix(m);
+    pCanvas->drawImage(foreground.get(), 0.0, 0.0);
+  }
+  
+  return true;
+}
+
 void IGraphicsSkia::DrawFastDropShadow(const IRECT& innerBounds, const IRECT& outerBounds, float xyDrop, float roundness, float blur, IBlend* pBlend)
 {
   SkRect r = SkiaRect(innerBounds.GetTranslated(xyDrop, xyDrop));
@@ -18,6 +18,7 @@
 #include "SkPath.h"
 #include "SkCanvas.h"
 #include "SkImage.h"
+#include "SkTextBlob.h"
 #include "GrDirectContext.h"
 #pragma warning( pop )
 
@@ -45,6 +46,7 @@ class IGraphicsSkia : public IGraphics
 {
 private:
   class Bitmap;
+  class Shader;
   struct Font;
 public:
   IGraphicsSkia(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
@@ -61,6 +63,8 @@ public:
   void DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend) override;
 
   void PathClear() override { mMainPath.reset(); }
+  bool PathReuse(uint64_t key) override;
+  void PathCache(uint64_t key) override;
   void PathClose() override { mMainPath.close(); }
   void PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding) override;
 
@@ -119,30 +123,56 @@ public:
   APIBitmap* CreateAPIBitmap(int width, int height, float scale, double drawScale, bool cacheable = false) override;
 
   void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) override;
+  void UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height) override;
+  void GetLayerBitmapDataAsync(const ILayerPtr& layer, ILayerBitmapDataFunc completion) override;
   void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) override;
+  bool ApplyNativeLayerDropShadow(ILayerPtr& layer, const IShadow& shadow) override;
 
   void UpdateLayer() override;
+
+  IShaderPtr CreateShader(const char* source, WDL_String& error) override;
+  void DrawShader(APIShader& shader, const IRECT& bounds, const float* pInputs, int nInputs, const IBlend* pBlend) override;
     
 protected:
     
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
   void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
+  void DoPrewarmGlyphs(const IText& text, const char* glyphs) override;
 
   bool LoadAPIFont(const char* fontID, const PlatformFontPtr& font) override;
 
   APIBitmap* LoadAPIBitmap(const char* fileNameOrResID, int scale, EResourceLocation location, const char* ext) override;
   APIBitmap* LoadAPIBitmap(const char* name, const void* pData, int dataSize, int scale) override;
+  void RetryAPIBitmapDecode(APIBitmap* pBitmap, const char* path) override;
 private:  
-  void PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y, SkFont& font) const;
+  /** Decode a lazy image in the background, see IGraphics::SetAsyncBitmapDecoding()
+   * @param pBitmap The bitmap to set the decoded image of
+   * @param lazyImage The image, which is null if the file couldn't be read */
+  void DecodeAPIBitmapAsync(Bitmap* pBitmap, sk_sp<SkImage> lazyImage);
+
+  /** A string shaped with a font and size, which is kept between frames so that static labels aren't measured and shaped on every redraw */
+  struct TextLayout
+  {
+    sk_sp<SkTextBlob> blob; // the glyph run at the origin, null for an empty string
+    double width = 0.0;
+    double ascender = 0.0;
+    double descender = 0.0;
+  };
+
+  const TextLayout& PrepareAndMeasureText(const IText& text, const char* str, IRECT& r, double& x, double & y) const;
 
   void PathTransformSetMatrix(const IMatrix& m) override;
   void SetClipRegion(const IRECT& r) override;
     
   void RenderPath(SkPaint& paint);
     
+  static constexpr int kMaxCachedPaths = 1024; // the cache is emptied when it is full
+
   sk_sp<SkSurface> mSurface;
   SkCanvas* mCanvas = nullptr;
   SkPath mMainPath;
+  std::unordered_map<uint64_t, SkPath> mPathCache; // paths stored by PathCache(), without the transform
+  mutable ILRUCache<TextLayout> mTextLayoutCache {TEXT_LAYOUT_CACHE_SIZE};
   SkMatrix mMatrix;
   SkMatrix mClipMatrix;
   SkMatrix mFinalMatrix;
@@ -157,10 +187,10 @@ private:
 #endif
   
 #ifdef IGRAPHICS_METAL
-  void* mMTLDevice;
-  void* mMTLCommandQueue;
-  void* mMTLDrawable;
-  void* mMTLLayer;
+  void* mMTLDevice = nullptr;
+  void* mMTLCommandQueue = nullptr; // shared by the instances using the same device, like mGrContext
+  void* mMTLDrawable = nullptr;
+  void* mMTLLayer = nullptr;
 #endif
 
   static StaticStorage<Font> sFontCache;
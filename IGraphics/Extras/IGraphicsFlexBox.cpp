@@ -9,6 +9,7 @@
 */
 
 #include "IGraphicsFlexBox.h"
+#include "IControl.h"
 
 using namespace iplug;
 using namespace igraphics;
@@ -27,6 +28,7 @@ IFlexBox::~IFlexBox()
 
 void IFlexBox::Init(const IRECT& r, YGFlexDirection direction, YGJustify justify, YGWrap wrap, float padding, float margin)
 {
+  mBounds = r;
   YGNodeStyleSetWidth(mRootNodeRef, r.W());
   YGNodeStyleSetHeight(mRootNodeRef, r.H());
   YGNodeStyleSetFlexDirection(mRootNodeRef, direction);
@@ -36,9 +38,53 @@ void IFlexBox::Init(const IRECT& r, YGFlexDirection direction, YGJustify justify
   YGNodeStyleSetMargin(mRootNodeRef, YGEdgeAll, margin);
 }
 
-void IFlexBox::CalcLayout(YGDirection direction)
+bool IFlexBox::CalcLayout(YGDirection direction)
 {
   YGNodeCalculateLayout(mRootNodeRef, YGUndefined, YGUndefined, direction);
+  return YGNodeGetHasNewLayout(mRootNodeRef);
+}
+
+int IFlexBox::ApplyLayout()
+{
+  IGraphics* pGraphics = nullptr;
+  const int nMoved = ApplyLayout(mRootNodeRef, mBounds.L, mBounds.T, pGraphics);
+
+  if (pGraphics)
+    pGraphics->SetAllControlsDirty();
+
+  return nMoved;
+}
+
+int IFlexBox::ApplyLayout(YGNodeRef node, float x, float y, IGraphics*& pGraphics)
+{
+  // Yoga doesn't visit the children of a node whose layout it took from its cache, so they can be skipped too
+  if (!YGNodeGetHasNewLayout(node))
+    return 0;
+
+  YGNodeSetHasNewLayout(node, false);
+
+  int nMoved = 0;
+  x += YGNodeLayoutGetLeft(node);
+  y += YGNodeLayoutGetTop(node);
+
+  if (IControl* pControl = static_cast<IControl*>(YGNodeGetContext(node)))
+  {
+    const IRECT bounds(x, y, x + YGNodeLayoutGetWidth(node), y + YGNodeLayoutGetHeight(node));
+
+    if (bounds != pControl->GetRECT() || bounds != pControl->GetTargetRECT())
+    {
+      pControl->SetTargetAndDrawRECTs(bounds);
+      pGraphics = pControl->GetUI();
+      nMoved++;
+    }
+  }
+
+  const uint32_t nChildren = YGNodeGetChildCount(node);
+
+  for (uint32_t i = 0; i < nChildren; i++)
+    nMoved += ApplyLayout(YGNodeGetChild(node, i), x, y, pGraphics);
+
+  return nMoved;
 }
 
 YGNodeRef IFlexBox::AddItem(float width, float height, YGAlign alignSelf, float grow, float shrink, float margin)
@@ -71,6 +117,13 @@ YGNodeRef IFlexBox::AddItem(float width, float height, YGAlign alignSelf, float
   return child;
 }
 
+YGNodeRef IFlexBox::AddItem(IControl* pControl, float width, float height, YGAlign alignSelf, float grow, float shrink, float margin)
+{
+  YGNodeRef child = AddItem(width, height, alignSelf, grow, shrink, margin);
+  YGNodeSetContext(child, pControl);
+  return child;
+}
+
 void IFlexBox::AddItem(YGNodeRef child)
 {
   YGNodeInsertChild(mRootNodeRef, child, mNodeCounter++);
@@ -16,8 +16,13 @@
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
+class IControl;
+
 /** IFlexBox is a basic C++ helper for Yoga https://yogalayout.com. 
- * For advanced use, probably best just to use Yoga directly */
+ * For advanced use, probably best just to use Yoga directly
+ *
+ * The node tree can be kept for the lifetime of a layout, e.g. as a member of the control or plug-in that owns it, rather than built again on each resize.
+ * Yoga only lays out again the nodes whose style or available space has changed since the last CalcLayout(), and ApplyLayout() only moves the controls of those nodes. */
 class IFlexBox
 {
 public:
@@ -25,7 +30,7 @@ public:
   
   ~IFlexBox();
   
-  /** Initialize the IFlexBox flex container
+  /** Initialize the IFlexBox flex container. Call it again with the new bounds when they change, e.g. from OnResize(), the items are kept
    * @param r The IRECT bounds for the flex container
    * @param direction https://yogalayout.com/docs/flex-direction
    * @param justify https://yogalayout.com/docs/justify-content
@@ -44,13 +49,24 @@ public:
    * @return YGNodeRef The newly added YGNodeRef for the item (owned by this class) */
   YGNodeRef AddItem(float width, float height, YGAlign alignSelf = YGAlignAuto, float grow = 0.f, float shrink = 1.f, float margin = 0.f);
   
-  /** Add a flex item manually
+  /** Add a flex item for a control, whose bounds are set by ApplyLayout(). See AddItem() above for the other parameters
+   * @param pControl The control to lay out, which must outlive the IFlexBox or its layouts
+   * @return YGNodeRef The newly added YGNodeRef for the item (owned by this class) */
+  YGNodeRef AddItem(IControl* pControl, float width, float height, YGAlign alignSelf = YGAlignAuto, float grow = 0.f, float shrink = 1.f, float margin = 0.f);
+
+  /** Add a flex item manually. It can have children of its own, the nodes in the tree whose context is an IControl* are laid out by ApplyLayout(), see YGNodeSetContext()
    * @param item A new YGNodeRef to add (owndership transferred) */
   void AddItem(YGNodeRef item);
   
-  /** Calculate the layout, call after add all items
-   * @param direction https://yogalayout.com/docs/layout-direction */
-  void CalcLayout(YGDirection direction = YGDirectionLTR);
+  /** Calculate the layout, call after add all items. Only the nodes that have been made dirty since the last call are calculated again
+   * @param direction https://yogalayout.com/docs/layout-direction
+   * @return \c true if any node has a new layout, that ApplyLayout() hasn't applied yet */
+  bool CalcLayout(YGDirection direction = YGDirectionLTR);
+
+  /** Set the target and draw RECTs of the controls of the items that have a new layout, in the coordinates of the IRECT passed to Init().
+   * The controls are moved in one batch and the UI is marked dirty once, rather than each control invalidating its old and new bounds
+   * @return The number of controls that were moved or resized */
+  int ApplyLayout();
   
   /** Get an IRECT of the root node bounds */
   IRECT GetRootBounds() const;
@@ -59,7 +75,10 @@ public:
   IRECT GetItemBounds(int nodeIndex) const;
   
 private:
+  int ApplyLayout(YGNodeRef node, float x, float y, IGraphics*& pGraphics);
+
   int mNodeCounter = 0;
+  IRECT mBounds;
   YGConfigRef mConfigRef;
   YGNodeRef mRootNodeRef;
 };
@@ -10,6 +10,8 @@
 
 #include <cmath>
 #include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
 #define WDL_NO_SUPPORT_UTF8
 #include "dirscan.h"
 
@@ -203,23 +205,29 @@ void IControl::SetDirty(bool triggerAction, int valIdx)
   ForValIdx(valIdx, setValue);
   
   mDirty = true;
+  mDirtyRECTs.Clear();
+  mDisplayListValid = false;
+  TrackDirty();
   
   if (triggerAction)
+    TriggerAction(valIdx);
+}
+
+void IControl::TriggerAction(int valIdx)
+{
+  auto paramUpdate = [this](int v)
   {
-    auto paramUpdate = [this](int v)
+    if (GetParamIdx(v) > kNoParameter)
     {
-      if (GetParamIdx(v) > kNoParameter)
-      {
-        GetDelegate()->SendParameterValueFromUI(GetParamIdx(v), GetValue(v)); //TODO: take tuple
-        GetUI()->UpdatePeers(this, v);
-      }
-    };
-      
-    ForValIdx(valIdx, paramUpdate);
+      GetDelegate()->SendParameterValueFromUI(GetParamIdx(v), GetValue(v)); //TODO: take tuple
+      GetUI()->UpdatePeers(this, v);
+    }
+  };
     
-    if (mActionFunc)
-      mActionFunc(this);
-  }
+  ForValIdx(valIdx, paramUpdate);
+  
+  if (mActionFunc)
+    mActionFunc(this);
 }
 
 void IControl::Animate()
@@ -228,6 +236,40 @@ void IControl::Animate()
     mAnimationFunc(this);
 }
 
+void IControl::SetDirtyRECT(const IRECT& bounds, bool triggerAction, int valIdx)
+{
+  valIdx = (NVals() == 1) ? 0 : valIdx;
+
+  auto setValue = [this](int v) { SetValue(Clip(GetValue(v), 0.0, 1.0), v); };
+  ForValIdx(valIdx, setValue);
+
+  // if the whole control is already dirty there is nothing to add
+  if (!mDirty || mDirtyRECTs.Size())
+  {
+    mDirtyRECTs.Add(bounds.Intersect(mRECT));
+    mDirty = true;
+    mDisplayListValid = false;
+    TrackDirty();
+  }
+
+  if (triggerAction)
+    TriggerAction(valIdx);
+}
+
+void IControl::SetPollDirty(bool poll)
+{
+  mPollDirty = poll;
+
+  if (mGraphics)
+    mGraphics->SetControlPolled(this, poll);
+}
+
+void IControl::SetSuspended(bool suspend)
+{
+  mSuspended = suspend;
+  TrackDirty();
+}
+
 bool IControl::IsDirty()
 {
   if (GetAnimationFunction())
@@ -246,9 +288,28 @@ void IControl::SetDisabled(bool disable)
 {
   mBlend.mWeight = (disable ? GRAYED_ALPHA : 1.0f);
   mDisabled = disable;
+  InvalidateStaticLayer();
   SetDirty(false);
 }
 
+void IControl::DrawStaticLayer(IGraphics& g)
+{
+  if (!mUseStaticLayer)
+  {
+    DrawStatic(g);
+    return;
+  }
+
+  if (!g.CheckLayer(mStaticLayer))
+  {
+    g.StartLayer(this, mRECT);
+    DrawStatic(g);
+    mStaticLayer = g.EndLayer();
+  }
+
+  g.DrawLayer(mStaticLayer);
+}
+
 void IControl::OnMouseDown(float x, float y, const IMouseMod& mod)
 {
   if (mod.R)
@@ -1007,6 +1068,7 @@ bool ISliderControlBase::IsFineControl(const IMouseMod& mod, bool wheel) const
 
 IDirBrowseControlBase::~IDirBrowseControlBase()
 {
+  mScanner.Stop();
   ClearPathList();
 }
 
@@ -1040,29 +1102,138 @@ void IDirBrowseControlBase::CollectSortedItems(IPopupMenu* pMenu)
 
 void IDirBrowseControlBase::SetupMenu()
 {
+  mScanner.Wait();
+
   mFiles.Empty(true);
   mItems.Empty(false);
   
   mMainMenu.Clear();
   mSelectedIndex = -1;
 
+  std::vector<std::pair<std::string, std::string>> paths;
+
+  for (int p = 0; p < mPaths.GetSize(); p++)
+    paths.emplace_back(mPaths.Get(p)->Get(), mPathLabels.Get(p)->Get());
+
+  ScanPaths(paths, mMainMenu, mFiles);
+  CollectSortedItems(&mMainMenu);
+}
+
+void IDirBrowseControlBase::SetupMenuAsync()
+{
+  SetPollDirty(true);
+  StartScan(false);
+}
+
+void IDirBrowseControlBase::StartScan(bool onlyIfChanged)
+{
+  std::vector<std::pair<std::string, std::string>> paths;
+
+  for (int p = 0; p < mPaths.GetSize(); p++)
+    paths.emplace_back(mPaths.Get(p)->Get(), mPathLabels.Get(p)->Get());
+
+  mLastScanTime = GetTimestamp();
+  mScansInFlight++;
+
+  mScanner.Push([this, paths, onlyIfChanged]() {
+    std::unique_ptr<ScanResult> pResult(new ScanResult);
+
+    if (ScanPaths(paths, pResult->menu, pResult->files) || !onlyIfChanged)
+    {
+      std::lock_guard<std::mutex> lock(mScanResultMutex);
+      mScanResult = std::move(pResult);
+    }
+
+    mScansInFlight--;
+  });
+}
+
+bool IDirBrowseControlBase::ScanPaths(const std::vector<std::pair<std::string, std::string>>& paths, IPopupMenu& menu, WDL_PtrList<WDL_String>& files)
+{
+  if (!mScanIndexLoaded)
+  {
+    LoadScanIndex();
+    mScanIndexLoaded = true;
+  }
+
+  bool changed = false;
   int idx = 0;
 
-  if (mPaths.GetSize() == 1)
+  if (paths.size() == 1)
   {
-    ScanDirectory(mPaths.Get(0)->Get(), mMainMenu);
+    changed |= ScanDirectory(paths[0].first.c_str(), menu, files);
   }
   else
   {
-    for (int p = 0; p<mPaths.GetSize(); p++)
+    for (const auto& path : paths)
     {
       IPopupMenu* pNewMenu = new IPopupMenu();
-      mMainMenu.AddItem(mPathLabels.Get(p)->Get(), idx++, pNewMenu);
-      ScanDirectory(mPaths.Get(p)->Get(), *pNewMenu);
+      menu.AddItem(path.second.c_str(), idx++, pNewMenu);
+      changed |= ScanDirectory(path.first.c_str(), *pNewMenu, files);
     }
   }
-  
+
+  if (changed)
+    SaveScanIndex();
+
+  return changed;
+}
+
+void IDirBrowseControlBase::ApplyScanResult(ScanResult& result)
+{
+  WDL_String selectedFile;
+  GetSelectedFile(selectedFile);
+
+  mItems.Empty(false);
+  mMainMenu.Clear();
+  mMainMenu.TakeItems(result.menu);
+
+  mFiles.Empty(true);
+
+  for (int i = 0; i < result.files.GetSize(); i++)
+    mFiles.Add(result.files.Get(i));
+
+  result.files.Empty(false);
+
   CollectSortedItems(&mMainMenu);
+  SetSelectedFile(selectedFile.Get());
+  OnMenuScanned();
+  SetDirty(false);
+}
+
+bool IDirBrowseControlBase::IsDirty()
+{
+  std::unique_ptr<ScanResult> pResult;
+
+  // The menu items can't be replaced while the menu is open
+  if (!GetUI() || GetUI()->GetControlInPopupMenu() != this)
+  {
+    std::lock_guard<std::mutex> lock(mScanResultMutex);
+    pResult = std::move(mScanResult);
+  }
+
+  if (pResult)
+    ApplyScanResult(*pResult);
+
+  if (mWatchInterval > 0.0 && !IsScanning() && (GetTimestamp() - mLastScanTime) > mWatchInterval)
+    StartScan(true);
+
+  return IContainerBase::IsDirty();
+}
+
+void IDirBrowseControlBase::SetScanIndexPath(const char* path)
+{
+  mScanner.Wait();
+  mScanIndexPath = path;
+  mScanIndexLoaded = false;
+}
+
+void IDirBrowseControlBase::SetWatchInterval(double seconds)
+{
+  mWatchInterval = seconds;
+
+  if (seconds > 0.0)
+    SetPollDirty(true);
 }
 
 void IDirBrowseControlBase::ClearPathList()
@@ -1117,8 +1288,36 @@ void IDirBrowseControlBase::CheckSelectedItem()
   }
 }
 
-void IDirBrowseControlBase::ScanDirectory(const char* path, IPopupMenu& menuToAddTo)
+/** @return The modification time of a directory, or -1 if it can't be read */
+static int64_t GetDirectoryModTime(const char* path)
+{
+#ifdef OS_WIN
+  struct _stat64 info;
+  
+  if (_stat64(path, &info) != 0)
+    return -1;
+#else
+  struct stat info;
+  
+  if (stat(path, &info) != 0)
+    return -1;
+#endif
+
+  return static_cast<int64_t>(info.st_mtime);
+}
+
+const IDirBrowseControlBase::DirListing& IDirBrowseControlBase::ListDirectory(const char* path, bool& changed)
 {
+  const int64_t modTime = GetDirectoryModTime(path);
+  DirListing& listing = mScanIndex[path];
+
+  if (modTime > -1 && modTime == listing.modTime)
+    return listing;
+
+  listing.modTime = modTime;
+  listing.entries.clear();
+  changed = true;
+
   WDL_DirScan d;
 
   if (!d.First(path))
@@ -1126,57 +1325,144 @@ void IDirBrowseControlBase::ScanDirectory(const char* path, IPopupMenu& menuToAd
     do
     {
       const char* f = d.GetCurrentFN();
+      
       if (f && f[0] != '.')
-      {
-        if (mScanRecursively && d.GetCurrentIsDirectory())
-        {
-          WDL_String subdir;
-          d.GetCurrentFullFN(&subdir);
-          IPopupMenu* pNewMenu = new IPopupMenu();
-          menuToAddTo.AddItem(d.GetCurrentFN(), pNewMenu, -2);
-          ScanDirectory(subdir.Get(), *pNewMenu);
-        }
-        else
-        {
-          // Find the last occurrence of str2 in str1.
-          // Return a pointer to the first character of the match.
-          // Return a pointer to the start of str1 if str2 is empty.
-          // Return a nullptr if str2 isn't found in str1.
-          auto strrstr = [](const char* str1, const char* str2) -> const char* {
-            if (*str2 == '\0')
-              return str1;
-
-            const char* result = nullptr;
-
-            while (*str1 != '\0') {
-              if (std::strncmp(str1, str2, std::strlen(str2)) == 0)
-                result = str1;
-
-              str1++;
-            }
-
-            return result;
-          };
-
-          const char* a = strrstr(f, mExtension.Get());
-          if (a && a > f && strlen(a) == strlen(mExtension.Get()))
-          {
-            WDL_String menuEntry {f};
-            
-            if (!mShowFileExtensions)
-              menuEntry.Set(f, (int) (a - f) - 1);
-            
-            IPopupMenu::Item* pItem = new IPopupMenu::Item(menuEntry.Get(), IPopupMenu::Item::kNoFlags, mFiles.GetSize());
-            menuToAddTo.AddItem(pItem, -2 /* sort alphabetically */);
-            WDL_String* pFullPath = new WDL_String("");
-            d.GetCurrentFullFN(pFullPath);
-            mFiles.Add(pFullPath);
-          }
+        listing.entries.emplace_back(f, d.GetCurrentIsDirectory() != 0);
+    } while (!d.Next());
+  }
+
+  return listing;
+}
+
+void IDirBrowseControlBase::LoadScanIndex()
+{
+  mScanIndex.clear();
+
+  if (mScanIndexPath.empty())
+    return;
+
+  FILE* fp = fopen(mScanIndexPath.c_str(), "rb");
+
+  if (!fp)
+    return;
+
+  // Each directory is a line "modTime nEntries path", followed by a line "isDir name" for each entry
+  char line[4096];
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    long long modTime = -1;
+    int nEntries = 0;
+    int pathStart = 0;
+
+    if (sscanf(line, "%lld %d %n", &modTime, &nEntries, &pathStart) < 2 || nEntries < 0)
+      break;
+
+    std::string dirPath(line + pathStart);
+    
+    while (!dirPath.empty() && (dirPath.back() == '\n' || dirPath.back() == '\r'))
+      dirPath.pop_back();
+
+    DirListing& listing = mScanIndex[dirPath];
+    listing.modTime = modTime;
+
+    for (int i = 0; i < nEntries && fgets(line, sizeof(line), fp); i++)
+    {
+      std::string name(line + std::min<size_t>(2, strlen(line)));
+      
+      while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+        name.pop_back();
+
+      listing.entries.emplace_back(name, line[0] == '1');
+    }
+  }
+
+  fclose(fp);
+}
+
+void IDirBrowseControlBase::SaveScanIndex() const
+{
+  if (mScanIndexPath.empty())
+    return;
+
+  FILE* fp = fopen(mScanIndexPath.c_str(), "wb");
+
+  if (!fp)
+    return;
+
+  for (const auto& dir : mScanIndex)
+  {
+    if (dir.second.modTime < 0)
+      continue;
+
+    fprintf(fp, "%lld %d %s\n", static_cast<long long>(dir.second.modTime), static_cast<int>(dir.second.entries.size()), dir.first.c_str());
+
+    for (const auto& entry : dir.second.entries)
+      fprintf(fp, "%d %s\n", entry.second ? 1 : 0, entry.first.c_str());
+  }
+
+  fclose(fp);
+}
+
+bool IDirBrowseControlBase::ScanDirectory(const char* path, IPopupMenu& menuToAddTo, WDL_PtrList<WDL_String>& files)
+{
+  bool changed = false;
+
+  // Copy the entries, as scanning a subdirectory can add to the index
+  const std::vector<std::pair<std::string, bool>> entries = ListDirectory(path, changed).entries;
+
+  for (const auto& entry : entries)
+  {
+    const char* f = entry.first.c_str();
+    WDL_String fullPath(path);
+    fullPath.Append(WDL_DIRCHAR_STR);
+    fullPath.Append(f);
+
+    if (mScanRecursively && entry.second)
+    {
+      IPopupMenu* pNewMenu = new IPopupMenu();
+      menuToAddTo.AddItem(f, pNewMenu, -2);
+      changed |= ScanDirectory(fullPath.Get(), *pNewMenu, files);
+    }
+    else
+    {
+      // Find the last occurrence of str2 in str1.
+      // Return a pointer to the first character of the match.
+      // Return a pointer to the start of str1 if str2 is empty.
+      // Return a nullptr if str2 isn't found in str1.
+      auto strrstr = [](const char* str1, const char* str2) -> const char* {
+        if (*str2 == '\0')
+          return str1;
+
+        const char* result = nullptr;
+
+        while (*str1 != '\0') {
+          if (std::strncmp(str1, str2, std::strlen(str2)) == 0)
+            result = str1;
+
+          str1++;
         }
+
+        return result;
+      };
+
+      const char* a = strrstr(f, mExtension.Get());
+      if (a && a > f && strlen(a) == strlen(mExtension.Get()))
+      {
+        WDL_String menuEntry {f};
+        
+        if (!mShowFileExtensions)
+          menuEntry.Set(f, (int) (a - f) - 1);
+        
+        IPopupMenu::Item* pItem = new IPopupMenu::Item(menuEntry.Get(), IPopupMenu::Item::kNoFlags, files.GetSize());
+        menuToAddTo.AddItem(pItem, -2 /* sort alphabetically */);
+        files.Add(new WDL_String(fullPath));
       }
-    } while (!d.Next());
+    }
   }
 
   if (!mShowEmptySubmenus)
     menuToAddTo.RemoveEmptySubmenus();
+
+  return changed;
 }
@@ -19,6 +19,10 @@
 #include <cstdlib>
 #include <vector>
 #include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
 
 #if defined VST3_API || defined VST3C_API
 #undef stricmp
@@ -33,6 +37,7 @@
 #include "ptrlist.h"
 
 #include "IGraphics.h"
+#include "IGraphicsDisplayList.h"
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -78,7 +83,11 @@ public:
   void operator=(const IControl&) = delete;
   
   /** Destructor. Clean up any resources that your control owns. */
-  virtual ~IControl() {}
+  virtual ~IControl()
+  {
+    if (mGraphics)
+      mGraphics->ForgetControl(this);
+  }
 
   /** Implement this method to respond to a mouse down event on this control. 
    * @param x The X coordinate of the mouse event
@@ -146,6 +155,10 @@ public:
   /** Implement to do something when graphics is scaled globally (e.g. moves to different DPI screen) */
   virtual void OnRescale() {}
 
+  /** Called when the OS is low on memory, see IGraphics::OnMemoryWarning(). Release what Draw() creates again when it needs it, such as layers.
+   * The base implementation releases the static layer, so call it from overrides */
+  virtual void OnMemoryWarning() { mStaticLayer = nullptr; }
+
   /** Called when IControl is constructed or resized using SetRect(). NOTE: if you call SetDirty() in this method, you should call SetDirty(false) to avoid triggering parameter changes */
   virtual void OnResize() {}
   
@@ -184,6 +197,16 @@ public:
    * @param g The graphics context to which this control belongs. */
   virtual void Draw(IGraphics& g) = 0;
 
+  /** Implement this to draw the parts of the control that don't change with its value or mouse state, e.g. a background or a label, and call DrawStaticLayer() from Draw() to draw them.
+   * If the control uses a static layer they are drawn into it, see SetUseStaticLayer()
+   * @param g The graphics context to which this control belongs. */
+  virtual void DrawStatic(IGraphics& g) {}
+
+  /** Implement this to record the commands that draw the control into a display list, if it uses one, see SetUseDisplayList().
+   * It may be called on a worker thread at the same time as other controls are recorded, so it must only read the state of this control, and must not call the graphics context
+   * @param list The display list, which is empty */
+  virtual void Record(IDisplayList& list) {}
+
   /** Implement this to customise how a colored highlight is drawn on the control in ProTools (AAX format only), when a control is linked to a parameter that is automated.
    * @param g The graphics context to which this control belongs. */
   virtual void DrawPTHighlight(IGraphics& g);
@@ -289,11 +312,38 @@ public:
 
   /** Set the Blend for this control. This can be used differently by different controls, or not at all.
    *  By default it is used to change the opacity of controls when they are disabled */
-  void SetBlend(const IBlend& blend) { mBlend = blend; }
+  void SetBlend(const IBlend& blend) { mBlend = blend; InvalidateStaticLayer(); }
 
   /** Get the Blend for this control */
   IBlend GetBlend() const { return mBlend; }
 
+  /** Opt in to caching the parts of the control drawn by DrawStatic() in a layer, so that they are only redrawn when they change rather than at every frame.
+   * The layer is redrawn when the control is resized, the UI is rescaled or InvalidateStaticLayer() is called. Controls that support this call DrawStaticLayer() from Draw()
+   * @param enable \c true to cache the static parts of the control */
+  void SetUseStaticLayer(bool enable) { mUseStaticLayer = enable; mStaticLayer = nullptr; SetDirty(false); }
+
+  /** @return \c true if the static parts of the control are cached in a layer, see SetUseStaticLayer() */
+  bool GetUseStaticLayer() const { return mUseStaticLayer; }
+
+  /** Make the next call to DrawStaticLayer() redraw the cached layer. Call this when something drawn by DrawStatic() changes, e.g. a color or a label */
+  void InvalidateStaticLayer() { if (mStaticLayer) mStaticLayer->Invalidate(); }
+
+  /** Opt in to drawing the control from a display list recorded by Record(). The list is kept between frames and only recorded again when the control is dirty,
+   * on the graphics context's worker threads if it has any, see IGraphics::SetDisplayListThreads(). Controls that support this call DrawDisplayList() from Draw()
+   * @param enable \c true to draw the control from a display list */
+  void SetUseDisplayList(bool enable) { mUseDisplayList = enable; mDisplayListValid = false; SetDirty(false); }
+
+  /** @return \c true if the control is drawn from a display list, see SetUseDisplayList() */
+  bool GetUseDisplayList() const { return mUseDisplayList; }
+
+  /** Record the control's display list with Record(), called by the graphics context before drawing, possibly on a worker thread */
+  void RecordDisplayList()
+  {
+    mDisplayList.Clear();
+    Record(mDisplayList);
+    mDisplayListValid = true;
+  }
+
   /** Get the max number of characters that are allowed in text entry 
    * @return int The max number of characters allowed in text entry */
   int GetTextEntryLength() const { return mTextEntryLength; }
@@ -308,7 +358,7 @@ public:
 
   /** Set the rectangular draw area for this control, within the graphics context
    * @param bounds The control's bounds */
-  void SetRECT(const IRECT& bounds) { mRECT = bounds; mMouseIsOver = false; OnResize(); }
+  void SetRECT(const IRECT& bounds) { mRECT = bounds; mMouseIsOver = false; InvalidateControlGrid(); OnResize(); }
   
   /** Get the rectangular mouse tracking target area, within the graphics context for this control
    * @return The control's target bounds within the graphics context */
@@ -316,11 +366,11 @@ public:
 
   /** Set the rectangular mouse tracking target area, within the graphics context for this control
    * @param bounds The control's new target bounds within the graphics context */
-  void SetTargetRECT(const IRECT& bounds) { mTargetRECT = bounds; mMouseIsOver = false; }
+  void SetTargetRECT(const IRECT& bounds) { mTargetRECT = bounds; mMouseIsOver = false; InvalidateControlGrid(); }
   
   /** Set BOTH the draw rect and the target area, within the graphics context for this control
    * @param bounds The control's new draw and target bounds within the graphics context */
-  void SetTargetAndDrawRECTs(const IRECT& bounds) { mRECT = mTargetRECT = bounds; mMouseIsOver = false; OnResize(); }
+  void SetTargetAndDrawRECTs(const IRECT& bounds) { mRECT = mTargetRECT = bounds; mMouseIsOver = false; InvalidateControlGrid(); OnResize(); }
 
   /** Set the position of the control, preserving the width and height. This may need to be overriden if you maintain custom positioning data in your control
    * @param x the new x coordinate of the top left corner of the control
@@ -396,16 +446,42 @@ public:
    * NOTE: it is easy to forget that this method always sets the control dirty, the argument refers to whether a consecutive action should be performed */
   virtual void SetDirty(bool triggerAction = true, int valIdx = kNoValIdx);
 
+  /** Mark a part of the control as dirty, so that only that area is redrawn on the next display refresh, e.g. a key of a keyboard.
+   * Draw() is still called, clipped to the areas. A call to SetDirty() before the next refresh redraws the whole control
+   * @param bounds The area to redraw
+   * @param triggerAction As with SetDirty(), notify the delegate of the value at valIdx and trigger the ActionFunction
+   * @param valIdx The value that changed */
+  void SetDirtyRECT(const IRECT& bounds, bool triggerAction = false, int valIdx = kNoValIdx);
+
+  /** @return The areas marked with SetDirtyRECT() since the control was last drawn, empty if the whole control should be redrawn */
+  const IRECTList& GetDirtyRECTs() const { return mDirtyRECTs; }
+
   /* Set the control clean, i.e. Called by IGraphics draw loop after control has been drawn */
-  virtual void SetClean() { mDirty = false; }
+  virtual void SetClean() { mDirty = false; mDirtyRECTs.Clear(); }
 
   /* Called at each display refresh by the IGraphics draw loop, triggers the control's AnimationFunc if it is set */
   void Animate();
 
-  /** Called at each display refresh by the IGraphics draw loop, after IControl::Animate(), to determine if the control is marked as dirty. 
+  /** Called at each display refresh by the IGraphics draw loop, after IControl::Animate(), to determine if the control is marked as dirty.
+   * Only controls that have been marked dirty with SetDirty(), or are animating, are asked. If you override this method to report changes that are not made
+   * with SetDirty(), call SetPollDirty(true) so that it is called at every display refresh
    * @return \c true if the control is marked dirty. */
   virtual bool IsDirty();
 
+  /** @param poll Set \c true if IsDirty() should be called at every display refresh, for controls that override it */
+  void SetPollDirty(bool poll);
+
+  /** @return \c true if IsDirty() is called at every display refresh */
+  bool GetPollDirty() const { return mPollDirty; }
+
+  /** Suspend the control, e.g. while it is on a page that isn't shown. A suspended control isn't animated or asked if it is dirty at each display refresh,
+   * and a change marked with SetDirty() is kept until it is resumed, when it is drawn, unless the control is set clean first so that its owner can redraw a whole page at once
+   * @param suspend \c true to suspend the control, \c false to resume it */
+  virtual void SetSuspended(bool suspend);
+
+  /** @return \c true if the control is suspended, see SetSuspended() */
+  bool IsSuspended() const { return mSuspended; }
+
   /** Disable/enable default prompt for user input
    * @param disable Set true to disable prompt */
   void DisablePrompt(bool disable) { mDisablePrompt = disable; }
@@ -449,6 +525,12 @@ public:
   {
     mDelegate = &dlg;
     mGraphics = dlg.GetUI();
+    TrackDirty();
+    TrackAnimation();
+
+    if (mPollDirty)
+      SetPollDirty(true);
+
     OnInit();
     OnResize();
     OnRescale();
@@ -485,12 +567,26 @@ public:
   
   /** Set the animation function
    * @param func A std::function conforming to IAnimationFunction */
-  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func;}
+  void SetAnimation(IAnimationFunction func) { mAnimationFunc = func; TrackAnimation(); }
   
   /** Set the animation function and starts it
    * @param func A std::function conforming to IAnimationFunction
    * @param duration Duration in milliseconds for the animation */
-  void SetAnimation(IAnimationFunction func, int duration) { mAnimationFunc = func; StartAnimation(duration); }
+  void SetAnimation(IAnimationFunction func, int duration) { mAnimationFunc = func; TrackAnimation(); StartAnimation(duration); }
+
+  /** Animate a value that the control draws with, e.g. the brightness of a highlight when the mouse is over it, towards a target.
+   * Unlike SetAnimation(), there is no function to call at each display refresh: the values of all controls are advanced together by the graphics context,
+   * which marks the control dirty until the value reaches the target. Calling this again before then retargets the animation from where the value is
+   * @param value A member of the control, which must outlive the animation
+   * @param target The value to move to
+   * @param curve How the value moves, see IAnimationCurve */
+  void AnimateValue(float& value, float target, const IAnimationCurve& curve = IAnimationCurve())
+  {
+    if (mGraphics)
+      mGraphics->AnimateValue(this, value, target, curve);
+    else
+      value = target;
+  }
 
   /** Get the control's animation function, if it exists */
   IAnimationFunction GetAnimationFunction() { return mAnimationFunc; }
@@ -531,6 +627,20 @@ protected:
         func(v, args...);
     }
   }
+
+  /** Call this from Draw() to draw DrawStatic(), from the cached layer if the control uses one, see SetUseStaticLayer()
+   * @param g The graphics context to which this control belongs. */
+  void DrawStaticLayer(IGraphics& g);
+
+  /** Call this from Draw() to replay the display list of a control that uses one, see SetUseDisplayList(). The list is recorded first if it is out of date
+   * @param g The graphics context to which this control belongs. */
+  void DrawDisplayList(IGraphics& g)
+  {
+    if (!mDisplayListValid)
+      RecordDisplayList();
+
+    mDisplayList.Replay(g);
+  }
   
   IRECT mRECT;
   IRECT mTargetRECT;
@@ -542,6 +652,7 @@ protected:
   IBlend mBlend;
   int mTextEntryLength = DEFAULT_TEXT_ENTRY_LEN;
   bool mDirty = true;
+  IRECTList mDirtyRECTs; // when only parts of the control are dirty, see SetDirtyRECT()
   bool mHide = false;
   bool mDisabled = false;
   bool mDisablePrompt = true;
@@ -558,6 +669,11 @@ protected:
 
   IColor mPTHighlightColor = COLOR_RED;
   bool mPTisHighlighted = false;
+  bool mUseStaticLayer = false;
+  ILayerPtr mStaticLayer;
+  bool mUseDisplayList = false;
+  bool mDisplayListValid = false;
+  IDisplayList mDisplayList;
   
   void SetNVals(int nVals)
   {
@@ -574,9 +690,37 @@ protected:
 #endif
   
 private:
+  /** Tell the graphics context that the bounds of this control have changed, see IGraphics::InvalidateControlGrid() */
+  void InvalidateControlGrid() { if (mGraphics) mGraphics->InvalidateControlGrid(); }
+
+  /** Notify the delegate of the values at valIdx and call the action function, see SetDirty() */
+  void TriggerAction(int valIdx);
+
+  /** If the control is dirty, add it to the graphics context's list of controls to check at the next display refresh */
+  void TrackDirty()
+  {
+    if (mDirty && !mInDirtyList && !mSuspended && mGraphics)
+    {
+      mInDirtyList = true;
+      mGraphics->AddDirtyControl(this);
+    }
+  }
+
+  /** If the control has an animation function, add it to the graphics context's list of controls to animate at each display refresh */
+  void TrackAnimation()
+  {
+    if (mAnimationFunc && mGraphics)
+      mGraphics->AddAnimatingControl(this);
+  }
+
+  friend class IGraphics;
+
   IContainerBase* mParent = nullptr;
   IGEditorDelegate* mDelegate = nullptr;
   IGraphics* mGraphics = nullptr;
+  bool mInDirtyList = false; // in IGraphics::mDirtyControls, which is emptied by IGraphics::SetAllControlsClean()
+  bool mPollDirty = false;
+  bool mSuspended = false;
   IActionFunction mActionFunc = nullptr;
   IActionFunction mAnimationEndActionFunc = nullptr;
   IAnimationFunction mAnimationFunc = nullptr;
@@ -675,6 +819,15 @@ public:
     
     IControl::Hide(hide);
   }
+
+  void SetSuspended(bool suspend) override
+  {
+    ForAllChildrenFunc([suspend](int childIdx, IControl* pChild) {
+      pChild->SetSuspended(suspend);
+    });
+
+    IControl::SetSuspended(suspend);
+  }
   
   IControl* AddChildControl(IControl* pControl, int ctrlTag = kNoTag, const char* group = "")
   {
@@ -780,7 +933,7 @@ public:
   void SetColor(EVColor colorIdx, const IColor& color)
   {
     mStyle.colorSpec.mColors[static_cast<int>(colorIdx)] = color;
-    mControl->SetDirty(false);
+    SetStyleDirty();
   }
 
   /** Set the colors of this IVControl
@@ -788,6 +941,7 @@ public:
   void SetColors(const IVColorSpec& spec)
   {
     mStyle.colorSpec = spec;
+    SetStyleDirty();
   }
 
   /** Get value of a specific EVColor in the IVControl */ 
@@ -796,21 +950,21 @@ public:
     return mStyle.colorSpec.GetColor(color);
   }
   
-  void SetLabelStr(const char* label) { mLabelStr.Set(label); mControl->SetDirty(false); }
+  void SetLabelStr(const char* label) { mLabelStr.Set(label); SetStyleDirty(); }
   void SetValueStr(const char* value) { mValueStr.Set(value); mControl->SetDirty(false); }
-  void SetWidgetFrac(float frac) { mStyle.widgetFrac = Clip(frac, 0.f, 1.f);  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetAngle(float angle) { mStyle.angle = Clip(angle, 0.f, 360.f);  mControl->SetDirty(false); }
-  void SetShowLabel(bool show) { mStyle.showLabel = show;  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetShowValue(bool show) { mStyle.showValue = show;  mControl->OnResize(); mControl->SetDirty(false); }
-  void SetRoundness(float roundness) { mStyle.roundness = Clip(roundness, 0.f, 1.f); mControl->SetDirty(false); }
-  void SetDrawFrame(bool draw) { mStyle.drawFrame = draw; mControl->SetDirty(false); }
-  void SetDrawShadows(bool draw) { mStyle.drawShadows = draw; mControl->SetDirty(false); }
-  void SetEmboss(bool draw) { mStyle.emboss = draw; mControl->SetDirty(false); }
-  void SetShadowOffset(float offset) { mStyle.shadowOffset = offset; mControl->SetDirty(false); }
-  void SetFrameThickness(float thickness) { mStyle.frameThickness = thickness; mControl->SetDirty(false); }
+  void SetWidgetFrac(float frac) { mStyle.widgetFrac = Clip(frac, 0.f, 1.f);  mControl->OnResize(); SetStyleDirty(); }
+  void SetAngle(float angle) { mStyle.angle = Clip(angle, 0.f, 360.f);  SetStyleDirty(); }
+  void SetShowLabel(bool show) { mStyle.showLabel = show;  mControl->OnResize(); SetStyleDirty(); }
+  void SetShowValue(bool show) { mStyle.showValue = show;  mControl->OnResize(); SetStyleDirty(); }
+  void SetRoundness(float roundness) { mStyle.roundness = Clip(roundness, 0.f, 1.f); SetStyleDirty(); }
+  void SetDrawFrame(bool draw) { mStyle.drawFrame = draw; SetStyleDirty(); }
+  void SetDrawShadows(bool draw) { mStyle.drawShadows = draw; SetStyleDirty(); }
+  void SetEmboss(bool draw) { mStyle.emboss = draw; SetStyleDirty(); }
+  void SetShadowOffset(float offset) { mStyle.shadowOffset = offset; SetStyleDirty(); }
+  void SetFrameThickness(float thickness) { mStyle.frameThickness = thickness; SetStyleDirty(); }
   void SetSplashRadius(float radius) { mSplashRadius = radius * mMaxSplashRadius; }
   void SetSplashPoint(float x, float y) { mSplashPoint.x = x; mSplashPoint.y = y; }
-  void SetShape(EVShape shape) { mShape = shape; mControl->SetDirty(false); }
+  void SetShape(EVShape shape) { mShape = shape; SetStyleDirty(); }
 
   /** Set the Style of this IVControl
    * @param style */
@@ -820,6 +974,16 @@ public:
     SetColors(style.colorSpec);
   }
 
+  /** Redraw the control after its style has changed, including its static layer if it uses one, see IControl::SetUseStaticLayer() */
+  void SetStyleDirty()
+  {
+    if (mControl)
+    {
+      mControl->InvalidateStaticLayer();
+      mControl->SetDirty(false);
+    }
+  }
+
   /** Get the style of this IVControl
    * @return IVStyle */
   IVStyle GetStyle() const { return mStyle; }
@@ -1476,14 +1640,29 @@ public:
   
   void OnMouseOver(float x, float y, const IMouseMod& mod) override
   {
-    mMouseOverTrack = GetValIdxForPos(x, y);
-    SetDirty(false);
+    const int track = GetValIdxForPos(x, y);
+
+    if (!mRedrawChangedTracksOnly)
+    {
+      mMouseOverTrack = track;
+      SetDirty(false);
+    }
+    else if (track != mMouseOverTrack)
+    {
+      SetTrackDirty(mMouseOverTrack);
+      mMouseOverTrack = track;
+      SetTrackDirty(mMouseOverTrack);
+    }
   }
 
   void OnMouseOut() override
   {
+    if (mRedrawChangedTracksOnly)
+      SetTrackDirty(mMouseOverTrack);
+    else
+      SetDirty(false);
+
     mMouseOverTrack = -1;
-    SetDirty(false);
   }
   
   virtual void OnResize() override
@@ -1513,9 +1692,55 @@ public:
   {
     const int nVals = NVals();
     
+    if (!mRedrawChangedTracksOnly)
+    {
+      for (int ch = 0; ch < nVals; ch++)
+      {
+        DrawTrack(g, mTrackBounds.Get()[ch], ch);
+      }
+      
+      return;
+    }
+    
+    // only the tracks in the area being drawn are drawn, with their fills batched by FillTrackRect()
+    const IRECT drawRegion = g.GetDrawRegion();
+    mTracksDrawn.clear();
+    mTrackFills.clear();
+    mBatchTrackFills = true;
+    
     for (int ch = 0; ch < nVals; ch++)
     {
-      DrawTrack(g, mTrackBounds.Get()[ch], ch);
+      if (GetTrackDirtyBounds(ch).Intersects(drawRegion))
+      {
+        DrawTrack(g, mTrackBounds.Get()[ch], ch);
+        mTracksDrawn.push_back(ch);
+      }
+    }
+    
+    mBatchTrackFills = false;
+    
+    // the tracks don't overlap, so drawing each part of all the tracks in turn looks the same as drawing each track in turn
+    std::stable_sort(mTrackFills.begin(), mTrackFills.end(), [](const TrackFill& a, const TrackFill& b) { return a.part < b.part; });
+    auto handlesStart = std::find_if(mTrackFills.begin(), mTrackFills.end(), [](const TrackFill& fill) { return fill.part > kTrackFillBackground; });
+    
+    DrawTrackFills(g, mTrackFills.begin(), handlesStart);
+
+    if (HasTrackNames())
+    {
+      for (auto ch : mTracksDrawn)
+        DrawTrackName(g, mTrackBounds.Get()[ch], ch);
+    }
+    
+    DrawTrackFills(g, handlesStart, mTrackFills.end());
+    
+    if (mStyle.drawFrame && mDrawTrackFrame && mTracksDrawn.size())
+    {
+      g.PathClear();
+      
+      for (auto ch : mTracksDrawn)
+        g.PathRect(mTrackBounds.Get()[ch]);
+      
+      g.PathStroke(GetColor(kFR), mStyle.frameThickness, IStrokeOptions(), &mBlend);
     }
   }
   
@@ -1589,10 +1814,40 @@ public:
 
   void SetHighlightedTrack(int highlightIdx)
   {
+    if (mRedrawChangedTracksOnly)
+    {
+      SetTrackDirty(mHighlightedTrack);
+      SetTrackDirty(highlightIdx);
+    }
+    else
+      SetDirty(false);
+    
     mHighlightedTrack = highlightIdx;
+  }
+  
+  /** Redraw only the tracks that change rather than the whole control, and batch the fills of the tracks, e.g. for meters with many channels.
+   * This requires that each track is drawn within its bounds, and that overrides of DrawTrackBackground(), DrawTrackHandle() and DrawPeak() fill with FillTrackRect()
+   * @param enable \c true to redraw only the tracks that change */
+  void SetRedrawChangedTracksOnly(bool enable)
+  {
+    mRedrawChangedTracksOnly = enable;
     SetDirty(false);
   }
   
+  /** Mark a track as dirty. If SetRedrawChangedTracksOnly() is enabled only the track is redrawn, otherwise the whole control
+   * @param trackIdx The index of the track, does nothing if it is out of range
+   * @param triggerAction As with SetDirty(), notify the delegate of the track's value and trigger the ActionFunction */
+  void SetTrackDirty(int trackIdx, bool triggerAction = false)
+  {
+    if (trackIdx < 0 || trackIdx >= NVals())
+      return;
+    
+    if (mRedrawChangedTracksOnly)
+      SetDirtyRECT(GetTrackDirtyBounds(trackIdx), triggerAction, trackIdx);
+    else
+      SetDirty(triggerAction, trackIdx);
+  }
+  
   void SetZeroValueStepHasBounds(bool val)
   {
     mZeroValueStepHasBounds = val;
@@ -1638,7 +1893,7 @@ protected:
   {
     DrawTrackBackground(g, r, chIdx);
     
-    if(HasTrackNames())
+    if(HasTrackNames() && !mBatchTrackFills)
       DrawTrackName(g, r, chIdx);
     
     const float trackPos = static_cast<float>(GetValue(chIdx));
@@ -1721,13 +1976,14 @@ protected:
       DrawPeak(g, peakRect, chIdx, trackPos > mBaseValue);
     }
 
-    if(mStyle.drawFrame && mDrawTrackFrame)
+    if(mStyle.drawFrame && mDrawTrackFrame && !mBatchTrackFills)
       g.DrawRect(GetColor(kFR), r, &mBlend, mStyle.frameThickness);
   }
 
   virtual void DrawTrackBackground(IGraphics& g, const IRECT& r, int chIdx)
   {
-    g.FillRect(chIdx == mHighlightedTrack ? this->GetColor(kHL) : COLOR_TRANSPARENT, r);
+    if (chIdx == mHighlightedTrack)
+      FillTrackRect(g, this->GetColor(kHL), r, kTrackFillBackground);
   }
   
   virtual void DrawTrackName(IGraphics& g, const IRECT& r, int chIdx)
@@ -1742,15 +1998,46 @@ protected:
    * @param aboveBaseValue true if the handle channel value is above the base value */
   virtual void DrawTrackHandle(IGraphics& g, const IRECT& r, int chIdx, bool aboveBaseValue)
   {
-    g.FillRect(chIdx == mHighlightedTrack ? GetColor(kX1) : GetColor(kFG), r, &mBlend);
+    FillTrackRect(g, chIdx == mHighlightedTrack ? GetColor(kX1) : GetColor(kFG), r, kTrackFillHandle);
 
     if(chIdx == mMouseOverTrack)
-      g.FillRect(GetColor(kHL), r, &mBlend);
+      FillTrackRect(g, GetColor(kHL), r, kTrackFillHandleHighlight);
   }
   
   virtual void DrawPeak(IGraphics& g, const IRECT& r, int chIdx, bool aboveBaseValue)
   {
-    g.FillRect(GetColor(kFR), r, &mBlend);
+    FillTrackRect(g, GetColor(kFR), r, kTrackFillPeak);
+  }
+
+  /** The parts of a track, in the order they are drawn */
+  enum ETrackFill
+  {
+    kTrackFillBackground = 0,
+    kTrackFillHandle,
+    kTrackFillHandleHighlight,
+    kTrackFillPeak
+  };
+
+  /** Fill a rectangle of a track. While the tracks are drawn with SetRedrawChangedTracksOnly() the fill is batched with those of the other tracks, otherwise it is filled straight away
+   * @param g The IGraphics context
+   * @param color The fill color
+   * @param r The rectangle
+   * @param part The part of the track, the batched fills are drawn in this order */
+  void FillTrackRect(IGraphics& g, const IColor& color, const IRECT& r, ETrackFill part)
+  {
+    if (color.A == 0)
+      return;
+    
+    if (mBatchTrackFills)
+      mTrackFills.push_back({part, r, color});
+    else
+      g.FillRect(color, r, &mBlend);
+  }
+  
+  /** @return The area that changes when a track changes, which allows for the frame and the peak */
+  IRECT GetTrackDirtyBounds(int trackIdx) const
+  {
+    return mTrackBounds.Get()[trackIdx].GetPadded(mTrackPadding + mPeakSize + mStyle.frameThickness);
   }
     
   int GetStepIdxForPos(float x, float y) const
@@ -1803,6 +2090,35 @@ protected:
     return mStepBounds.GetSize() > 0;
   }
 
+private:
+  struct TrackFill
+  {
+    ETrackFill part;
+    IRECT rect;
+    IColor color;
+  };
+
+  template <typename Iter>
+  void DrawTrackFills(IGraphics& g, Iter begin, Iter end)
+  {
+    mBatchRects.clear();
+    mBatchColors.clear();
+    
+    for (auto it = begin; it != end; ++it)
+    {
+      mBatchRects.push_back(it->rect);
+      mBatchColors.push_back(it->color);
+    }
+    
+    g.FillRects(mBatchRects.data(), mBatchColors.data(), static_cast<int>(mBatchRects.size()), &mBlend);
+  }
+  
+  std::vector<TrackFill> mTrackFills; // reused by DrawWidget()
+  std::vector<int> mTracksDrawn;
+  std::vector<IRECT> mBatchRects;
+  std::vector<IColor> mBatchColors;
+  bool mBatchTrackFills = false;
+
 protected:
   EDirection mDirection = EDirection::Vertical;
   WDL_TypedBuf<IRECT> mTrackBounds;
@@ -1816,6 +2132,7 @@ protected:
   double mBaseValue = 0.; // 0-1 value to represent the mid-point, i.e. for displaying bipolar data
   bool mDrawTrackFrame = true;
   bool mZeroValueStepHasBounds = true; // If this is true, there is a separate step for zero, when mNSteps > 0
+  bool mRedrawChangedTracksOnly = false; // see SetRedrawChangedTracksOnly()
 };
 
 /** A base class for buttons/momentary switches - cannot be linked to parameters.
@@ -1889,6 +2206,28 @@ public:
 
   /** Call after adding one or more paths, to populate the menu */
   void SetupMenu();
+
+  /** Call after adding one or more paths, to populate the menu from a scan on a background thread, so that e.g. a preset folder on a network drive
+   * doesn't block the UI. The menu is replaced at a later display refresh, when OnMenuScanned() is called. Directories that have not been modified
+   * since they were last scanned are listed from an index rather than scanned again, see SetScanIndexPath() */
+  void SetupMenuAsync();
+
+  /** @return \c true while a scan started by SetupMenuAsync() is running */
+  bool IsScanning() const { return mScansInFlight > 0; }
+
+  /** Keep the index of the scanned directories in a file, so that the first scan after the UI is opened again only lists the directories that have changed
+   * @param path The full path of the index file, e.g. in the plug-in's settings folder, or an empty string to only keep the index in memory */
+  void SetScanIndexPath(const char* path);
+
+  /** Check the directories for changes in the background at an interval, and replace the menu when any have changed. A directory that has not changed costs
+   * reading its modification time, rather than a scan
+   * @param seconds The interval, or 0 to stop checking */
+  void SetWatchInterval(double seconds);
+
+  /** Called when a scan started by SetupMenuAsync() has replaced the menu, the selected file is kept if it is still there */
+  virtual void OnMenuScanned() {}
+
+  bool IsDirty() override;
   
   /** Set the selected file based on a file path. Does nothing if the file has not been added */
   void SetSelectedFile(const char* filePath);
@@ -1900,9 +2239,46 @@ public:
   void CheckSelectedItem();
 
 private:
-  void ScanDirectory(const char* path, IPopupMenu& menuToAddTo);
+  /** The entries of a directory, and its modification time when they were listed */
+  struct DirListing
+  {
+    int64_t modTime = -1;
+    std::vector<std::pair<std::string, bool>> entries; // the name, and whether it's a directory
+  };
+
+  /** The menu and files of a scan on the background thread */
+  struct ScanResult
+  {
+    ~ScanResult() { files.Empty(true); }
+
+    IPopupMenu menu;
+    WDL_PtrList<WDL_String> files;
+  };
+
+  /** Start a scan of the paths on the background thread
+   * @param onlyIfChanged Only replace the menu if a directory has changed since the last scan */
+  void StartScan(bool onlyIfChanged);
+  /** Populate a menu with the files in the paths (path, label), returns \c true if any directory had changed since the last scan */
+  bool ScanPaths(const std::vector<std::pair<std::string, std::string>>& paths, IPopupMenu& menu, WDL_PtrList<WDL_String>& files);
+  void ApplyScanResult(ScanResult& result);
+  bool ScanDirectory(const char* path, IPopupMenu& menuToAddTo, WDL_PtrList<WDL_String>& files);
+  /** List a directory from the index if it has not been modified, otherwise scan it, sets changed if it was scanned */
+  const DirListing& ListDirectory(const char* path, bool& changed);
+  void LoadScanIndex();
+  void SaveScanIndex() const;
   void CollectSortedItems(IPopupMenu* pMenu);
   
+  std::unordered_map<std::string, DirListing> mScanIndex; // only used by the thread that is scanning
+  std::string mScanIndexPath;
+  bool mScanIndexLoaded = false;
+  std::mutex mScanResultMutex;
+  std::unique_ptr<ScanResult> mScanResult;
+  std::atomic<int> mScansInFlight {0};
+  double mWatchInterval = 0.0;
+  double mLastScanTime = 0.0;
+  IPlugTaskQueue mScanner {1};
+  
+
 protected:
   const bool mScanRecursively;
   const bool mShowFileExtensions;
@@ -2009,6 +2385,12 @@ public:
     SetAnimation(DefaultAnimationFunc, mAnimationDuration);
   }
   
+  void OnMemoryWarning() override
+  {
+    mLayer = nullptr;
+    IControl::OnMemoryWarning();
+  }
+
   void OnMouseUp(float x, float y, const IMouseMod& mod) override
   {
     mMouseInfo.x = x;
@@ -2101,6 +2483,12 @@ public:
   {
     mSVG = svg;
   }
+
+  void OnMemoryWarning() override
+  {
+    mLayer = nullptr;
+    IControl::OnMemoryWarning();
+  }
   
 private:
   bool mUseLayer;
@@ -10,6 +10,10 @@
 
 #include "IGraphics.h"
 
+#ifdef SVG_USE_SKIA
+#include "IGraphicsSkia.h"
+#endif
+
 #define NANOSVG_IMPLEMENTATION
 #pragma warning(disable:4244) // float conversion
 #include "nanosvg.h"
@@ -26,7 +30,9 @@ using VST3_API_BASE = iplug::IPlugVST3Controller;
 #endif
 
 #include "IPlugParameter.h"
+#include "Easing.h"
 #include "IPlugPluginBase.h"
+#include "IPlugTraceZones.h"
 
 #include "IControl.h"
 #include "IControls.h"
@@ -65,16 +71,44 @@ IGraphics::~IGraphics()
     
   mCursorHidden = false;
   RemoveAllControls();
+  
+  // the backends finish their bitmaps before their context is destroyed, any left only need the shared bitmap cache
+  FinishBitmapDecoding();
     
-  StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache);
+  // entries that no other instance uses can then be evicted, see SetResourceCacheBudget()
+  StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache, this);
   bitmapStorage.Release();
-  StaticStorage<SVGHolder>::Accessor svgStorage(sSVGCache);
+  StaticStorage<SVGHolder>::Accessor svgStorage(sSVGCache, this);
   svgStorage.Release();
 }
 
+void IGraphics::SetResourceCacheBudget(size_t bitmapBytes, size_t svgBytes)
+{
+  StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache);
+  bitmapStorage.SetBudget(bitmapBytes);
+  StaticStorage<SVGHolder>::Accessor svgStorage(sSVGCache);
+  svgStorage.SetBudget(svgBytes);
+}
+
+StaticStorageStats IGraphics::GetBitmapCacheStats()
+{
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  return storage.GetStats();
+}
+
+StaticStorageStats IGraphics::GetSVGCacheStats()
+{
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  return storage.GetStats();
+}
+
 void IGraphics::SetScreenScale(float scale)
 {
+  // bitmaps reloaded at the new scale are counted for the instance, see IPlugMemoryAccounting.h
+  IPlugMemoryAccount::ScopedCurrent memoryAccount(GetDelegate()->GetMemoryAccount());
   mScreenScale = scale;
+  mSVGRasterCache.Clear();
+  ClearSVGIconAtlas();
   int windowWidth = WindowWidth() * GetPlatformWindowScale();
   int windowHeight = WindowHeight() * GetPlatformWindowScale();
   
@@ -97,9 +131,18 @@ void IGraphics::Resize(int w, int h, float scale, bool needsPlatformResize)
   //DBGMSG("resize %i, resize %i, scale %f\n", w, h, scale);
   ReleaseMouseCapture();
 
+  // while the preview of a drag resize is drawn, the controls only see the final size, see EnableResizePreview()
+  const bool deferUpdate = mResizingInProcess && mResizePreview;
+
   mDrawScale = scale;
   mWidth = w;
   mHeight = h;
+
+  if (!deferUpdate)
+  {
+    mSVGRasterCache.Clear();
+    ClearSVGIconAtlas();
+  }
   
   if (mCornerResizer)
     mCornerResizer->OnRescale();
@@ -108,11 +151,16 @@ void IGraphics::Resize(int w, int h, float scale, bool needsPlatformResize)
   int windowHeight = WindowHeight() * GetPlatformWindowScale();
     
   PlatformResize(GetDelegate()->EditorResizeFromUI(windowWidth, windowHeight, needsPlatformResize));
-  ForAllControls(&IControl::OnResize);
+
+  if (deferUpdate)
+    mResizePending = true;
+  else
+    ForAllControls(&IControl::OnResize);
+
   SetAllControlsDirty();
   DrawResize();
   
-  if(mLayoutOnResize)
+  if(mLayoutOnResize && !deferUpdate)
     GetDelegate()->LayoutUI(this);
 }
 
@@ -131,6 +179,7 @@ void IGraphics::RemoveControlWithTag(int ctrlTag)
 {
   mControls.DeletePtr(GetControlWithTag(ctrlTag), true);
   mCtrlTags.erase(ctrlTag);
+  InvalidateControlGrid();
   SetAllControlsDirty();
 }
 
@@ -159,6 +208,7 @@ void IGraphics::RemoveControls(int fromIdx)
     mControls.Delete(idx--, true);
   }
   
+  InvalidateControlGrid();
   SetAllControlsDirty();
 }
 
@@ -186,6 +236,7 @@ void IGraphics::RemoveControl(IControl* pControl)
   
   mControls.DeletePtr(pControl, true);
   
+  InvalidateControlGrid();
   SetAllControlsDirty();
 }
 
@@ -194,6 +245,16 @@ void IGraphics::RemoveAllControls()
   ReleaseMouseCapture();
   ClearMouseOver();
 
+  // empty these first, so that the controls don't have to be found in them as they are destroyed
+  mDirtyControls.Empty();
+  mAnimatingControls.Empty();
+  mPolledControls.Empty();
+  mValueAnimations.clear();
+  mPendingLayerBitmapData.clear();
+  mSVGRasterCache.Clear(); // the layers must be deleted while the backend's context exists
+  ClearSVGIconAtlas();
+  mPendingSVGRasters.clear();
+
   mPopupControl = nullptr;
   mTextEntryControl = nullptr;
   mCornerResizer = nullptr;
@@ -207,6 +268,7 @@ void IGraphics::RemoveAllControls()
   
   mCtrlTags.clear();
   mControls.Empty(true);
+  InvalidateControlGrid();
 }
 
 void IGraphics::SetControlPosition(IControl* pControl, float x, float y)
@@ -280,6 +342,7 @@ void IGraphics::AttachBackground(const char* fileName)
   IControl* pBG = new IBitmapControl(0, 0, LoadBitmap(fileName, 1, false), kNoParameter, EBlend::Default);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  InvalidateControlGrid();
 }
 
 void IGraphics::AttachSVGBackground(const char* fileName)
@@ -287,6 +350,7 @@ void IGraphics::AttachSVGBackground(const char* fileName)
   IControl* pBG = new ISVGControl(GetBounds(), LoadSVG(fileName), true);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  InvalidateControlGrid();
 }
 
 void IGraphics::AttachPanelBackground(const IPattern& color)
@@ -294,6 +358,7 @@ void IGraphics::AttachPanelBackground(const IPattern& color)
   IControl* pBG = new IPanelControl(GetBounds(), color);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  InvalidateControlGrid();
 }
 
 IControl* IGraphics::AttachControl(IControl* pControl, int ctrlTag, const char* group)
@@ -310,6 +375,7 @@ IControl* IGraphics::AttachControl(IControl* pControl, int ctrlTag, const char*
   pControl->SetDelegate(*GetDelegate());
   pControl->SetGroup(group);
   mControls.Add(pControl);
+  InvalidateControlGrid();
     
   pControl->OnAttached();
   return pControl;
@@ -521,7 +587,11 @@ void IGraphics::ForStandardControlsFunc(std::function<void(IControl* pControl)>
 void IGraphics::ForAllControlsFunc(std::function<void(IControl* pControl)> func)
 {
   ForStandardControlsFunc(func);
-  
+  ForSpecialControlsFunc(func);
+}
+
+void IGraphics::ForSpecialControlsFunc(std::function<void(IControl* pControl)> func)
+{
   if (mPerfDisplay)
     func(mPerfDisplay.get());
   
@@ -567,7 +637,154 @@ void IGraphics::SetAllControlsDirty()
 
 void IGraphics::SetAllControlsClean()
 {
-  ForAllControls(&IControl::SetClean);
+  // every control with mDirty set is in mDirtyControls, see IControl::TrackDirty()
+  for (auto i = 0; i < mDirtyControls.GetSize(); i++)
+  {
+    IControl* pControl = mDirtyControls.Get(i);
+    pControl->mInDirtyList = false;
+
+    // a control suspended since it was marked stays dirty, see IControl::SetSuspended()
+    if (!pControl->IsSuspended())
+      pControl->SetClean();
+  }
+
+  mDirtyControls.Empty();
+
+  for (auto i = 0; i < mAnimatingControls.GetSize(); i++)
+  {
+    if (!mAnimatingControls.Get(i)->IsSuspended())
+      mAnimatingControls.Get(i)->SetClean();
+  }
+
+  for (auto i = 0; i < mPolledControls.GetSize(); i++)
+  {
+    if (!mPolledControls.Get(i)->IsSuspended())
+      mPolledControls.Get(i)->SetClean();
+  }
+}
+
+void IGraphics::AddAnimatingControl(IControl* pControl)
+{
+  if (mAnimatingControls.Find(pControl) < 0)
+    mAnimatingControls.Add(pControl);
+}
+
+void IGraphics::SetControlPolled(IControl* pControl, bool poll)
+{
+  const int idx = mPolledControls.Find(pControl);
+
+  if (poll && idx < 0)
+    mPolledControls.Add(pControl);
+  else if (!poll && idx >= 0)
+    mPolledControls.Delete(idx);
+}
+
+void IGraphics::ForgetControl(IControl* pControl)
+{
+  if (pControl->mInDirtyList)
+    mDirtyControls.DeletePtr(pControl);
+
+  mAnimatingControls.DeletePtr(pControl);
+
+  if (pControl->mPollDirty)
+    mPolledControls.DeletePtr(pControl);
+
+  if (mValueAnimations.size())
+  {
+    mValueAnimations.erase(std::remove_if(mValueAnimations.begin(), mValueAnimations.end(), [pControl](const ValueAnimation& animation) {
+      return animation.pControl == pControl;
+    }), mValueAnimations.end());
+  }
+}
+
+void IGraphics::AnimateValue(IControl* pControl, float& value, float target, const IAnimationCurve& curve)
+{
+  for (auto& animation : mValueAnimations)
+  {
+    if (animation.pValue == &value)
+    {
+      // a spring keeps its velocity, a curve starts again from where the value is
+      animation.start = value;
+      animation.target = target;
+      animation.elapsed = 0.f;
+      animation.curve = curve;
+      return;
+    }
+  }
+
+  if (value != target)
+    mValueAnimations.push_back({pControl, &value, value, target, 0.f, 0.f, curve});
+}
+
+void IGraphics::AdvanceValueAnimations(double elapsed)
+{
+  static constexpr float kMaxSpringStep = 0.004f; // seconds, so the integration is stable with stiff springs at low frame rates
+  static constexpr float kSpringRestThreshold = 1e-3f; // the fraction of the distance moved, below which a spring stops
+
+  auto ease = [](EAnimationCurve type, float x) {
+    switch (type)
+    {
+      case EAnimationCurve::QuadraticIn: return EaseQuadraticIn(x);
+      case EAnimationCurve::QuadraticOut: return EaseQuadraticOut(x);
+      case EAnimationCurve::QuadraticInOut: return EaseQuadraticInOut(x);
+      case EAnimationCurve::CubicIn: return EaseCubicIn(x);
+      case EAnimationCurve::CubicOut: return EaseCubicOut(x);
+      case EAnimationCurve::CubicInOut: return EaseCubicInOut(x);
+      case EAnimationCurve::SineInOut: return EaseSineInOut(x);
+      case EAnimationCurve::BackOut: return EaseBackOut(x);
+      default: return x;
+    }
+  };
+
+  const float dt = static_cast<float>(elapsed);
+
+  for (size_t i = 0; i < mValueAnimations.size();)
+  {
+    ValueAnimation& animation = mValueAnimations[i];
+
+    if (animation.pControl->IsSuspended())
+    {
+      i++;
+      continue;
+    }
+
+    bool finished;
+
+    if (animation.curve.mType == EAnimationCurve::Spring)
+    {
+      const int nSteps = std::max(1, static_cast<int>(std::ceil(dt / kMaxSpringStep)));
+      const float h = dt / nSteps;
+      float value = *animation.pValue;
+
+      for (auto s = 0; s < nSteps; s++)
+      {
+        const float acceleration = animation.curve.mStiffness * (animation.target - value) - animation.curve.mDamping * animation.velocity;
+        animation.velocity += acceleration * h;
+        value += animation.velocity * h;
+      }
+
+      const float threshold = kSpringRestThreshold * std::max(std::abs(animation.target - animation.start), 1e-3f);
+      finished = std::abs(animation.target - value) < threshold && std::abs(animation.velocity) * h < threshold;
+      *animation.pValue = finished ? animation.target : value;
+    }
+    else
+    {
+      animation.elapsed += dt * 1000.f;
+      const float progress = animation.curve.mDuration > 0.f ? std::min(animation.elapsed / animation.curve.mDuration, 1.f) : 1.f;
+      finished = progress >= 1.f;
+      *animation.pValue = finished ? animation.target : animation.start + (animation.target - animation.start) * ease(animation.curve.mType, progress);
+    }
+
+    animation.pControl->SetDirty(false);
+
+    if (finished)
+    {
+      animation = mValueAnimations.back();
+      mValueAnimations.pop_back();
+    }
+    else
+      i++;
+  }
 }
 
 void IGraphics::AssignParamNameToolTips()
@@ -803,32 +1020,123 @@ void IGraphics::PathRadialLine(float cx, float cy, float angle, float rMin, floa
   PathLine(data[0][0], data[0][1], data[1][0], data[1][1]);
 }
 
+void IGraphics::SetOccluded(bool occluded)
+{
+  if (occluded == mOccluded)
+    return;
+
+  mOccluded = occluded;
+
+  // the first frame after being occluded gets the normal interval
+  mPrevFrameTimestamp = 0.;
+
+  if (!occluded)
+    SetAllControlsDirty();
+}
+
 bool IGraphics::IsDirty(IRECTList& rects)
 {
+  TRACE_ZONE("IsDirty");
+
+  if (mOccluded)
+    return false;
+
+  const double timestamp = GetTimestamp();
+  const double defaultInterval = 1.0 / (mFPS > 0 ? mFPS : DEFAULT_FPS);
+  mFrameInterval = mPrevFrameTimestamp > 0. ? std::min(timestamp - mPrevFrameTimestamp, MAX_FRAME_INTERVAL) : defaultInterval;
+  mPrevFrameTimestamp = timestamp;
+
+  if (mBitmapsDecoded.exchange(false))
+    OnBitmapsDecoded();
+
+  if (mPendingLayerBitmapData.size())
+  {
+    // a completion may read another layer, which is queued for the next frame
+    std::vector<PendingLayerBitmapData> pending;
+    pending.swap(mPendingLayerBitmapData);
+
+    for (auto& readback : pending)
+      readback.completion(*readback.pData);
+  }
+
+  const bool profiling = mPerfDisplay && mPerfDisplay->IsProfiling();
+  double phaseStart = profiling ? GetTimestamp() : 0.;
+
   if (mDisplayTickFunc)
     mDisplayTickFunc();
 
-  ForAllControlsFunc([](IControl* pControl) { pControl->Animate(); } );
+  // N.B. an animation can end, or start another, while the list is being iterated
+  for (auto i = 0; i < mAnimatingControls.GetSize(); i++)
+  {
+    if (!mAnimatingControls.Get(i)->IsSuspended())
+      mAnimatingControls.Get(i)->Animate();
+  }
+
+  for (auto i = mAnimatingControls.GetSize() - 1; i >= 0; i--)
+  {
+    if (!mAnimatingControls.Get(i)->GetAnimationFunction())
+      mAnimatingControls.Delete(i);
+  }
+
+  // the values are advanced together, and only their controls are marked dirty
+  if (mValueAnimations.size())
+    AdvanceValueAnimations(mFrameInterval);
+
+  if (profiling)
+  {
+    const double timestamp = GetTimestamp();
+    mPerfDisplay->AddPhaseTime(IFPSDisplayControl::kAnimate, timestamp - phaseStart);
+    phaseStart = timestamp;
+  }
 
   bool dirty = false;
     
-  auto func = [&dirty, &rects](IControl* pControl) {
-    if (pControl->IsDirty())
+  auto func = [this, &dirty, &rects](IControl* pControl) {
+    if (!pControl->IsSuspended() && pControl->IsDirty())
     {
-      // N.B padding outlines for single line outlines
-      auto rectToAdd = pControl->GetRECT().GetPadded(0.75);
+      if (pControl->GetUseDisplayList())
+        mDisplayListsToRecord.push_back(pControl);
+
+      auto addRect = [&rects, pControl](const IRECT& bounds) {
+        // N.B padding outlines for single line outlines
+        auto rectToAdd = bounds.GetPadded(0.75);
+        
+        if (pControl->GetParent())
+        {
+          rectToAdd.Clank(pControl->GetParent()->GetRECT().GetPadded(0.75));
+        }
+        
+        rects.Add(rectToAdd);
+      };
+      
+      const IRECTList& dirtyRECTs = pControl->GetDirtyRECTs();
       
-      if (pControl->GetParent())
+      if (dirtyRECTs.Size() && !pControl->GetAnimationFunction())
       {
-        rectToAdd.Clank(pControl->GetParent()->GetRECT().GetPadded(0.75));
+        for (auto r = 0; r < dirtyRECTs.Size(); r++)
+          addRect(dirtyRECTs.Get(r));
       }
+      else
+        addRect(pControl->GetRECT());
       
-      rects.Add(rectToAdd);
       dirty = true;
     }
   };
-    
-  ForAllControlsFunc(func);
+
+  // only the controls that may be dirty are asked, rather than every control
+  for (auto i = 0; i < mDirtyControls.GetSize(); i++)
+    func(mDirtyControls.Get(i));
+
+  for (auto i = 0; i < mAnimatingControls.GetSize(); i++)
+    func(mAnimatingControls.Get(i));
+
+  for (auto i = 0; i < mPolledControls.GetSize(); i++)
+    func(mPolledControls.Get(i));
+
+  RecordDisplayLists();
+
+  if (profiling)
+    mPerfDisplay->AddPhaseTime(IFPSDisplayControl::kCollectDirty, GetTimestamp() - phaseStart);
 
 #ifdef USE_IDLE_CALLS
   if (dirty)
@@ -845,8 +1153,35 @@ bool IGraphics::IsDirty(IRECTList& rects)
   return dirty;
 }
 
+void IGraphics::SetDisplayListThreads(int nThreads)
+{
+  if (nThreads != 0)
+    mDisplayListWorkers.Start(nThreads, 1.0 / (FPS() > 0 ? FPS() : DEFAULT_FPS), false);
+  else
+    mDisplayListWorkers.Stop();
+}
+
+void IGraphics::RecordDisplayLists()
+{
+  auto& controls = mDisplayListsToRecord;
+
+  if (controls.empty())
+    return;
+
+  // a control can be in more than one of the lists in IsDirty(), and must only be recorded once
+  std::sort(controls.begin(), controls.end());
+  controls.erase(std::unique(controls.begin(), controls.end()), controls.end());
+
+  auto recordFunc = [&controls](int i) { controls[i]->RecordDisplayList(); };
+  mDisplayListWorkers.Run(static_cast<int>(controls.size()), recordFunc);
+
+  controls.clear();
+}
+
 void IGraphics::BeginFrame()
 {
+  FinishDecodedBitmaps();
+  
   if(mPerfDisplay)
   {
     const double timestamp = GetTimestamp();
@@ -856,32 +1191,113 @@ void IGraphics::BeginFrame()
   }
 }
 
+void IGraphics::DecodeBitmapAsync(APIBitmap* pBitmap, BitmapDecodeFunc decode)
+{
+  pBitmap->SetLoaded(false);
+  pBitmap->SetDecodeFailed(false);
+
+  mBitmapDecoder.Push([this, pBitmap, decode = std::move(decode)]() {
+    std::function<bool()> finish = decode();
+    WDL_MutexLock lock(&mDecodedBitmapsMutex);
+    mDecodedBitmaps.emplace_back(pBitmap, std::move(finish));
+  });
+}
+
+void IGraphics::FinishBitmapDecoding()
+{
+  mBitmapDecoder.Wait();
+  FinishDecodedBitmaps();
+}
+
+void IGraphics::FinishDecodedBitmaps()
+{
+  std::vector<std::pair<APIBitmap*, std::function<bool()>>> decoded;
+  
+  {
+    WDL_MutexLock lock(&mDecodedBitmapsMutex);
+    decoded.swap(mDecodedBitmaps);
+  }
+  
+  if (decoded.empty())
+    return;
+  
+  // a bitmap that failed is decoded again by the next LoadBitmap() that finds it
+  for (auto& [pBitmap, finish] : decoded)
+    pBitmap->SetDecodeFailed(!finish());
+  
+  {
+    // the bitmaps are shared through the cache, so the other instances that use them are redrawn by their next IsDirty(). Owners are removed under the same lock before they are deleted
+    StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+    
+    for (auto& decodedBitmap : decoded)
+    {
+      storage.ForEachOwner(decodedBitmap.first, [](const void* pOwner) {
+        static_cast<IGraphics*>(const_cast<void*>(pOwner))->mBitmapsDecoded.store(true);
+      });
+    }
+  }
+  
+  // the bitmaps drew nothing until now
+  mBitmapsDecoded.store(false);
+  OnBitmapsDecoded();
+}
+
+void IGraphics::OnBitmapsDecoded()
+{
+  if (mBitmapVariantsPending)
+  {
+    // swap the variants standing in for those that were loading, see GetScaledBitmap()
+    mBitmapVariantsPending = false;
+    
+    ForAllControlsFunc([](IControl* pControl) {
+      if (dynamic_cast<IBitmapBase*>(pControl))
+        pControl->OnRescale();
+    });
+  }
+  
+  SetAllControlsDirty();
+}
+
 // Draw a control in a region if it needs to be drawn
-void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale)
+void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale, const IRECT* pVisibleBounds)
 {
   if (pControl && (!pControl->IsHidden() || pControl == GetControl(0)))
   {
-    // N.B. Padding allows single line outlines on controls
-    IRECT controlBounds = pControl->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
-    IRECT clipBounds = bounds.Intersect(controlBounds);
+    IRECT clipBounds;
 
-    if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
-      return;
-    
-    IControl* pParent = pControl->GetParent();
-    
-    while (pParent)
+    if (pVisibleBounds)
     {
-      IRECT parentBounds = pParent->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
+      clipBounds = bounds.Intersect(*pVisibleBounds);
 
-      if(!clipBounds.Intersects(parentBounds))
+      if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
         return;
+    }
+    else
+    {
+      // N.B. Padding allows single line outlines on controls
+      IRECT controlBounds = pControl->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
+      clipBounds = bounds.Intersect(controlBounds);
 
-      clipBounds.Clank(parentBounds);
+      if (clipBounds.W() <= 0.0 || clipBounds.H() <= 0)
+        return;
+      
+      IControl* pParent = pControl->GetParent();
       
-      pParent = pParent->GetParent();
+      while (pParent)
+      {
+        IRECT parentBounds = pParent->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
+
+        if(!clipBounds.Intersects(parentBounds))
+          return;
+
+        clipBounds.Clank(parentBounds);
+        
+        pParent = pParent->GetParent();
+      }
     }
     
+    const double drawStart = mProfilingFrame ? GetTimestamp() : 0.;
+
     PrepareRegion(clipBounds);
     pControl->Draw(*this);
 #ifdef AAX_API
@@ -897,12 +1313,33 @@ void IGraphics::DrawControl(IControl* pControl, const IRECT& bounds, float scale
 #endif
     
     CompleteRegion(clipBounds);
+
+    if (mProfilingFrame)
+      mPerfDisplay->AddControlTime(pControl, GetTimestamp() - drawStart);
   }
 }
 
 void IGraphics::Draw(const IRECT& bounds, float scale)
 {
-  ForAllControlsFunc([this, bounds, scale](IControl* pControl) { DrawControl(pControl, bounds, scale); });
+  auto drawFunc = [this, bounds, scale](IControl* pControl) { DrawControl(pControl, bounds, scale); };
+
+  if (mControlGrid.valid)
+  {
+    GetControlsInRect(bounds, mControlGrid.controlIdxs);
+
+    for (auto idx : mControlGrid.controlIdxs)
+    {
+      const IRECT& visibleBounds = mControlGrid.controlVisibleBounds[idx];
+
+      // skip controls scrolled or clipped out of their ancestors without walking the parent chain
+      if (!visibleBounds.Empty())
+        DrawControl(GetControl(idx), bounds, scale, &visibleBounds);
+    }
+
+    ForSpecialControlsFunc(drawFunc);
+  }
+  else
+    ForAllControlsFunc(drawFunc);
 
 #ifndef NDEBUG
   if (mShowAreaDrawn)
@@ -918,14 +1355,60 @@ void IGraphics::Draw(const IRECT& bounds, float scale)
 
 void IGraphics::Draw(IRECTList& rects)
 {
+  TRACE_ZONE("Draw");
+
   if (!rects.Size())
     return;
   
   float scale = GetBackingPixelScale();
-    
+
+  // layers and bitmaps created while drawing are counted for the instance, see IPlugMemoryAccounting.h
+  IPlugMemoryAccount::ScopedCurrent memoryAccount(GetDelegate()->GetMemoryAccount());
+
+  // the editor has opened when its first frame has been drawn
+  IPlugStartupTimeline& startupTimeline = GetDelegate()->GetStartupTimeline();
+  IPlugStartupTimeline::ScopedPhase firstFramePhase(startupTimeline, IPlugStartupTimeline::kFirstFrame);
+
+  // with the kProfile style, the performance display times each phase of the frame
+  mProfilingFrame = mPerfDisplay && mPerfDisplay->IsProfiling();
+  double phaseStart = mProfilingFrame ? GetTimestamp() : 0.;
+
+  auto endPhase = [this, &phaseStart](IFPSDisplayControl::EFramePhase phase) {
+    if (mProfilingFrame)
+    {
+      const double timestamp = GetTimestamp();
+      mPerfDisplay->AddPhaseTime(phase, timestamp - phaseStart);
+      phaseStart = timestamp;
+    }
+  };
+
   BeginFrame();
-    
-  if (mStrict)
+  UpdateControlGrid();
+  RasterizePendingSVGs();
+  RebuildSVGIconAtlas();
+  RasterizePendingGlyphs();
+  endPhase(IFPSDisplayControl::kPrepare);
+
+  if (mResizePreview && !mResizingInProcess)
+    mResizePreview = nullptr;
+
+  if (mResizePreviewEnabled && mResizingInProcess)
+  {
+    // the first frame of a drag resize is kept and scaled to the new size until the drag ends, see EnableResizePreview()
+    const IRECT bounds = GetBounds();
+
+    if (!mResizePreview)
+    {
+      StartLayer(nullptr, bounds);
+      Draw(bounds, scale);
+      mResizePreview = EndLayer();
+    }
+
+    PrepareRegion(bounds);
+    DrawFittedLayer(mResizePreview, bounds, nullptr);
+    CompleteRegion(bounds);
+  }
+  else if (mStrict)
   {
     IRECT r = rects.Bounds();
     r.PixelAlign(scale);
@@ -934,13 +1417,160 @@ void IGraphics::Draw(IRECTList& rects)
   else
   {
     rects.PixelAlign(scale);
-    rects.Optimize();
+
+    if (rects.Size() > mMaxDirtyRects)
+      rects.Coalesce(mMaxDirtyRects, mDirtyRectCost);
+    else
+      rects.Optimize();
+
+    endPhase(IFPSDisplayControl::kOptimizeRects);
 
     for (auto i = 0; i < rects.Size(); i++)
       Draw(rects.Get(i), scale);
   }
-  
+
+  // the controls' time was added by DrawControl()
+  if (mProfilingFrame)
+    phaseStart = GetTimestamp();
+
   EndFrame();
+
+  if (mProfilingFrame)
+  {
+    endPhase(IFPSDisplayControl::kFlush);
+    mPerfDisplay->EndProfiledFrame(*this);
+    mProfilingFrame = false;
+  }
+
+  firstFramePhase.End();
+  startupTimeline.EndEditorOpen();
+}
+
+void IGraphics::UpdateControlGrid()
+{
+  ControlGrid& grid = mControlGrid;
+  const int nControls = NControls();
+
+  grid.valid = false;
+
+  if (nControls < ControlGrid::kMinControls)
+    return;
+
+  const float scale = GetBackingPixelScale();
+  bool changed = static_cast<int>(grid.controlBounds.size()) != nControls || grid.scale != scale;
+
+  // a control's visible bounds depend on its ancestors, which are also in mControls, so moving one rebuilds the grid
+  for (auto c = 0; !changed && c < nControls; c++)
+  {
+    const IControl* pControl = GetControl(c);
+    changed = !(pControl->GetRECT() == grid.controlBounds[c]) || !(pControl->GetTargetRECT() == grid.controlTargetBounds[c])
+           || pControl->GetParent() != grid.controlParents[c];
+  }
+
+  if (changed)
+  {
+    grid.controlBounds.resize(nControls);
+    grid.controlTargetBounds.resize(nControls);
+    grid.controlParents.resize(nControls);
+    grid.controlVisibleBounds.resize(nControls);
+    grid.scale = scale;
+    grid.bounds = IRECT();
+
+    for (auto c = 0; c < nControls; c++)
+    {
+      IControl* pControl = GetControl(c);
+      grid.controlBounds[c] = pControl->GetRECT();
+      grid.controlTargetBounds[c] = pControl->GetTargetRECT();
+      grid.controlParents[c] = pControl->GetParent();
+      const IRECT controlBounds = grid.controlBounds[c].Union(grid.controlTargetBounds[c]);
+      grid.bounds = c ? grid.bounds.Union(controlBounds) : controlBounds;
+
+      // clip to the ancestors in the same way as DrawControl()
+      IRECT visibleBounds = grid.controlBounds[c].GetPadded(0.75).GetPixelAligned(scale);
+
+      for (IControl* pParent = pControl->GetParent(); pParent && !visibleBounds.Empty(); pParent = pParent->GetParent())
+      {
+        const IRECT parentBounds = pParent->GetRECT().GetPadded(0.75).GetPixelAligned(scale);
+
+        if (visibleBounds.Intersects(parentBounds))
+          visibleBounds.Clank(parentBounds);
+        else
+          visibleBounds = IRECT();
+      }
+
+      grid.controlVisibleBounds[c] = visibleBounds;
+    }
+
+    grid.bounds.Pad(2.f);
+    grid.nCols = Clip(static_cast<int>(std::ceil(grid.bounds.W() / ControlGrid::kCellSize)), 1, ControlGrid::kMaxCellsPerSide);
+    grid.nRows = Clip(static_cast<int>(std::ceil(grid.bounds.H() / ControlGrid::kCellSize)), 1, ControlGrid::kMaxCellsPerSide);
+    grid.cells.resize(grid.nCols * grid.nRows);
+
+    for (auto& cell : grid.cells)
+      cell.clear();
+
+    const float cellW = grid.bounds.W() / grid.nCols;
+    const float cellH = grid.bounds.H() / grid.nRows;
+
+    for (auto c = 0; c < nControls; c++)
+    {
+      const IRECT r = grid.controlBounds[c].Union(grid.controlTargetBounds[c]).GetPadded(2.f); // allow for the padding and pixel alignment in DrawControl()
+      const int col0 = Clip(static_cast<int>((r.L - grid.bounds.L) / cellW), 0, grid.nCols - 1);
+      const int col1 = Clip(static_cast<int>((r.R - grid.bounds.L) / cellW), 0, grid.nCols - 1);
+      const int row0 = Clip(static_cast<int>((r.T - grid.bounds.T) / cellH), 0, grid.nRows - 1);
+      const int row1 = Clip(static_cast<int>((r.B - grid.bounds.T) / cellH), 0, grid.nRows - 1);
+
+      for (auto row = row0; row <= row1; row++)
+        for (auto col = col0; col <= col1; col++)
+          grid.cells[row * grid.nCols + col].push_back(c);
+    }
+  }
+
+  grid.valid = true;
+}
+
+int IGraphics::GetControlGridCell(float x, float y) const
+{
+  const ControlGrid& grid = mControlGrid;
+
+  if (!grid.bounds.Contains(x, y))
+    return -1;
+
+  const int col = Clip(static_cast<int>((x - grid.bounds.L) / grid.bounds.W() * grid.nCols), 0, grid.nCols - 1);
+  const int row = Clip(static_cast<int>((y - grid.bounds.T) / grid.bounds.H() * grid.nRows), 0, grid.nRows - 1);
+  return row * grid.nCols + col;
+}
+
+void IGraphics::GetControlsInRect(const IRECT& bounds, std::vector<int>& controlIdxs) const
+{
+  const ControlGrid& grid = mControlGrid;
+  controlIdxs.clear();
+
+  if (!bounds.Intersects(grid.bounds))
+    return;
+
+  const float cellW = grid.bounds.W() / grid.nCols;
+  const float cellH = grid.bounds.H() / grid.nRows;
+  const int col0 = Clip(static_cast<int>((bounds.L - grid.bounds.L) / cellW), 0, grid.nCols - 1);
+  const int col1 = Clip(static_cast<int>((bounds.R - grid.bounds.L) / cellW), 0, grid.nCols - 1);
+  const int row0 = Clip(static_cast<int>((bounds.T - grid.bounds.T) / cellH), 0, grid.nRows - 1);
+  const int row1 = Clip(static_cast<int>((bounds.B - grid.bounds.T) / cellH), 0, grid.nRows - 1);
+
+  for (auto row = row0; row <= row1; row++)
+  {
+    for (auto col = col0; col <= col1; col++)
+    {
+      const auto& cell = grid.cells[row * grid.nCols + col];
+      controlIdxs.insert(controlIdxs.end(), cell.begin(), cell.end());
+    }
+  }
+
+  // a control spanning several cells is listed in each, and controls must be drawn in order
+  if (row1 > row0 || col1 > col0)
+  {
+    std::sort(controlIdxs.begin(), controlIdxs.end());
+    controlIdxs.erase(std::unique(controlIdxs.begin(), controlIdxs.end()), controlIdxs.end());
+  }
 }
 
 void IGraphics::SetStrictDrawing(bool strict)
@@ -1261,8 +1891,48 @@ int IGraphics::GetMouseControlIdx(float x, float y, bool mouseOver)
 {
   if (!mouseOver || mEnableMouseOver)
   {
+    auto isHit = [this, x, y, mouseOver](IControl* pControl) {
+      if (!pControl->IsHidden() && !pControl->GetIgnoreMouse())
+      {
+        if ((!pControl->IsDisabled() || (mouseOver ? pControl->GetMouseOverWhenDisabled() : pControl->GetMouseEventsWhenDisabled())))
+          return pControl->IsHit(x, y);
+      }
+
+      return false;
+    };
+
+    const int firstControl = mouseOver ? 1 : 0;
+
+#ifndef NDEBUG
+    if (!mLiveEdit)
+#endif
+    {
+      if (!mControlGrid.valid)
+        UpdateControlGrid();
+
+      // only the controls in the cell under the mouse can be hit, N.B. this assumes IsHit() is only true within a control's draw or target bounds
+      if (mControlGrid.valid)
+      {
+        const int cell = GetControlGridCell(x, y);
+
+        if (cell < 0)
+          return -1;
+
+        const auto& controlIdxs = mControlGrid.cells[cell];
+
+        // Search from front to back
+        for (auto i = static_cast<int>(controlIdxs.size()) - 1; i >= 0 && controlIdxs[i] >= firstControl; --i)
+        {
+          if (isHit(GetControl(controlIdxs[i])))
+            return controlIdxs[i];
+        }
+
+        return -1;
+      }
+    }
+
     // Search from front to back
-    for (auto c = NControls() - 1; c >= (mouseOver ? 1 : 0); --c)
+    for (auto c = NControls() - 1; c >= firstControl; --c)
     {
       IControl* pControl = GetControl(c);
 
@@ -1270,15 +1940,9 @@ int IGraphics::GetMouseControlIdx(float x, float y, bool mouseOver)
       if(!mLiveEdit)
       {
 #endif
-        if (!pControl->IsHidden() && !pControl->GetIgnoreMouse())
+        if (isHit(pControl))
         {
-          if ((!pControl->IsDisabled() || (mouseOver ? pControl->GetMouseOverWhenDisabled() : pControl->GetMouseEventsWhenDisabled())))
-          {
-            if (pControl->IsHit(x, y))
-            {
-              return c;
-            }
-          }
+          return c;
         }
 #ifndef NDEBUG
       }
@@ -1465,11 +2129,41 @@ void IGraphics::OnAppearanceChanged(EUIAppearance appearance)
     mAppearanceChangedFunc(appearance);
 }
 
+void IGraphics::OnMemoryWarning()
+{
+  // the GPU resources are deleted with the drawing context current
+  ActivateGLContext();
+
+  ForAllControls(&IControl::OnMemoryWarning);
+  mSVGRasterCache.Clear();
+  ClearSVGIconAtlas();
+
+  if (!mResizingInProcess)
+    mResizePreview = nullptr;
+
+  StaticStorage<APIBitmap>::Accessor bitmapStorage(sBitmapCache);
+  bitmapStorage.Purge();
+  StaticStorage<SVGHolder>::Accessor svgStorage(sSVGCache);
+  svgStorage.Purge();
+
+  DeactivateGLContext();
+  SetAllControlsDirty();
+}
+
 IBitmap IGraphics::GetScaledBitmap(IBitmap& src)
 {
   //TODO: bug with # frames!
 //  return LoadBitmap(src.GetResourceName().Get(), src.N(), src.GetFramesAreHorizontal(), (GetRoundedScreenScale() == 1 && GetDrawScale() > 1.) ? 2 : 0 /* ??? */);
-  return LoadBitmap(src.GetResourceName().Get(), src.N(), src.GetFramesAreHorizontal(), GetRoundedScreenScale());
+  IBitmap bitmap = LoadBitmap(src.GetResourceName().Get(), src.N(), src.GetFramesAreHorizontal(), GetRoundedScreenScale());
+  
+  // While the variant for the new scale is decoded in the background, the variant that is loaded is drawn in its place, resampled when it is drawn
+  if (!bitmap.IsLoaded() && src.IsLoaded())
+  {
+    mBitmapVariantsPending = true;
+    return src;
+  }
+  
+  return bitmap;
 }
 
 void IGraphics::EnableTooltips(bool enable)
@@ -1505,28 +2199,30 @@ void IGraphics::EnableLiveEdit(bool enable)
 #ifdef SVG_USE_SKIA
 ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 {
-  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache, this);
   SVGHolder* pHolder = storage.Find(fileName);
   
   if(!pHolder)
   {
-    WDL_TypedBuf<uint8_t> svgData = LoadResource(fileName, "svg");
-    if (svgData.GetSize() == 0)
+    IPlugMappedResource svgData = MapResource(fileName, "svg");
+    if (!svgData.IsValid())
     {
       return ISVG(nullptr);
     }
     else
     {
-      return LoadSVG(fileName, svgData.Get(), svgData.GetSize(), units, dpi);
+      return LoadSVG(fileName, svgData.Get(), static_cast<int>(svgData.GetSize()), units, dpi);
     }
   }
   
-  return ISVG(pHolder->mSVGDom);
+  return ISVG(pHolder->mSVGDom, pHolder->mPicture);
 }
 
 ISVG IGraphics::LoadSVG(const char* name, const void* pData, int dataSize, const char* units, float dpi)
 {
-  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache, this);
   SVGHolder* pHolder = storage.Find(name);
 
   if (!pHolder)
@@ -1558,28 +2254,29 @@ ISVG IGraphics::LoadSVG(const char* name, const void* pData, int dataSize, const
     }
 
     pHolder = new SVGHolder(svgDOM);
-    storage.Add(pHolder, name);
+    storage.Add(pHolder, name, 1., pHolder->GetBytes());
   }
 
-  return ISVG(pHolder->mSVGDom);
+  return ISVG(pHolder->mSVGDom, pHolder->mPicture);
 }
 
 #else
 ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 {
-  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache, this);
   SVGHolder* pHolder = storage.Find(fileName);
 
   if(!pHolder)
   {
-    WDL_TypedBuf<uint8_t> svgData = LoadResource(fileName, "svg");
-    if (svgData.GetSize() == 0)
+    IPlugMappedResource svgData = MapResource(fileName, "svg");
+    if (!svgData.IsValid())
     {
       return ISVG(nullptr);
     }
     else
     {
-      return LoadSVG(fileName, svgData.Get(), svgData.GetSize(), units, dpi);
+      return LoadSVG(fileName, svgData.Get(), static_cast<int>(svgData.GetSize()), units, dpi);
     }
   }
 
@@ -1588,14 +2285,15 @@ ISVG IGraphics::LoadSVG(const char* fileName, const char* units, float dpi)
 
 ISVG IGraphics::LoadSVG(const char* name, const void* pData, int dataSize, const char* units, float dpi)
 {
-  StaticStorage<SVGHolder>::Accessor storage(sSVGCache);
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
+  StaticStorage<SVGHolder>::Accessor storage(sSVGCache, this);
   SVGHolder* pHolder = storage.Find(name);
 
   if (!pHolder)
   {
     NSVGimage* pImage = nullptr;
 
-    // Because we're taking a const void* pData, but NanoSVG takes a void*, 
+    // NanoSVG writes to the text while it parses it, and needs it null terminated, so it parses a copy rather than the mapped resource
     WDL_String svgStr;
     svgStr.Set((const char*)pData, dataSize);
     pImage = nsvgParse(svgStr.Get(), units, dpi);
@@ -1605,7 +2303,7 @@ ISVG IGraphics::LoadSVG(const char* name, const void* pData, int dataSize, const
     
     pHolder = new SVGHolder(pImage);
 
-    storage.Add(pHolder, name);
+    storage.Add(pHolder, name, 1., pHolder->GetBytes());
   }
 
   return ISVG(pHolder->mImage);
@@ -1615,65 +2313,56 @@ ISVG IGraphics::LoadSVG(const char* name, const void* pData, int dataSize, const
 WDL_TypedBuf<uint8_t> IGraphics::LoadResource(const char* fileNameOrResID, const char* fileType)
 {
   WDL_TypedBuf<uint8_t> result;
+  IPlugMappedResource resource = MapResource(fileNameOrResID, fileType);
 
+  if (resource.IsValid())
+    result.Set(resource.Get(), static_cast<int>(resource.GetSize()));
+
+  return result;
+}
+
+IPlugMappedResource IGraphics::MapResource(const char* fileNameOrResID, const char* fileType)
+{
   WDL_String path;
   EResourceLocation resourceFound = LocateResource(fileNameOrResID, fileType, path, GetBundleID(), GetWinModuleHandle(), GetSharedResourcesSubPath());
 
-  if (resourceFound == EResourceLocation::kNotFound)
-    return result;
-
-#ifdef OS_WIN    
+#ifdef OS_WIN
   if (resourceFound == EResourceLocation::kWinBinary)
   {
     int size = 0;
     const void* pResData = LoadWinResource(path.Get(), fileType, size, GetWinModuleHandle());
-    result.Resize(size);
-    result.Set((const uint8_t*)pResData, size);
+    return IPlugMappedResource(pResData, size); // resources stay loaded for the lifetime of the module
   }
 #endif
   if (resourceFound == EResourceLocation::kAbsolutePath)
-  {
-    FILE* fd = fopen(path.Get(), "rb");
-    if (!fd)
-      return result;
-    
-    // First we determine the file size
-    if (fseek(fd, 0, SEEK_END))
-    {
-      fclose(fd);
-      return result;
-    }
-    long size = ftell(fd);
+    return IPlugMappedResource(path.Get());
 
-    // Now reset to the start of the file so we can actually read it.
-    if (fseek(fd, 0, SEEK_SET))
-    {
-      fclose(fd);
-      return result;
-    }
-
-    result.Resize((int)size);
-    size_t bytesRead = fread(result.Get(), 1, (size_t)size, fd);
-    if (bytesRead != (size_t)size)
-    {
-      fclose(fd);
-      result.Resize(0, true);
-      return result;
-    }
-    fclose(fd);
-  }
-
-  return result;
+  return IPlugMappedResource();
 }
 
 IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHorizontal, int targetScale)
 {
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
   if (targetScale == 0)
     targetScale = GetRoundedScreenScale();
 
-  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache, this);
   APIBitmap* pAPIBitmap = storage.Find(name, targetScale);
 
+  const char* ext = name + strlen(name) - 1;
+  while (ext >= name && *ext != '.') --ext;
+  ++ext;
+
+  // If decoding the cached bitmap in the background failed, decode it again
+  if (pAPIBitmap && pAPIBitmap->DecodeFailed())
+  {
+    WDL_String fullPath;
+    int sourceScale = 0;
+
+    if (SearchImageResource(name, ext, fullPath, targetScale, sourceScale) != EResourceLocation::kNotFound && sourceScale == targetScale)
+      RetryAPIBitmapDecode(pAPIBitmap, fullPath.Get());
+  }
+
   // If the bitmap is not already cached at the targetScale
   if (!pAPIBitmap)
   {
@@ -1681,10 +2370,6 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
     std::unique_ptr<APIBitmap> loadedBitmap;
     int sourceScale = 0;
     
-    const char* ext = name + strlen(name) - 1;
-    while (ext >= name && *ext != '.') --ext;
-    ++ext;
-    
     bool bitmapTypeSupported = BitmapExtSupported(ext);
     
     if (!bitmapTypeSupported)
@@ -1717,6 +2402,9 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
     // Scale or retain if needed (N.B. - scaling retains in the cache)
     if (pAPIBitmap->GetScale() != targetScale)
     {
+      if (!pAPIBitmap->IsLoaded())
+        FinishBitmapDecoding(); // scaling draws the bitmap
+      
       return ScaleBitmap(IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name), name, targetScale);
     }
     else if (loadedBitmap)
@@ -1730,10 +2418,11 @@ IBitmap IGraphics::LoadBitmap(const char* name, int nStates, bool framesAreHoriz
 
 IBitmap IGraphics::LoadBitmap(const char *name, const void *pData, int dataSize, int nStates, bool framesAreHorizontal, int targetScale)
 {
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
   if (targetScale == 0)
     targetScale = GetRoundedScreenScale();
 
-  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache, this);
   APIBitmap* pAPIBitmap = storage.Find(name, targetScale);
 
   // If the bitmap is not already cached at the targetScale
@@ -1768,6 +2457,9 @@ IBitmap IGraphics::LoadBitmap(const char *name, const void *pData, int dataSize,
     // Scale or retain if needed (N.B. - scaling retains in the cache)
     if (pAPIBitmap->GetScale() != targetScale)
     {
+      if (!pAPIBitmap->IsLoaded())
+        FinishBitmapDecoding(); // scaling draws the bitmap
+      
       return ScaleBitmap(IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name), name, targetScale);
     }
     else if (loadedBitmap)
@@ -1779,16 +2471,45 @@ IBitmap IGraphics::LoadBitmap(const char *name, const void *pData, int dataSize,
   return IBitmap(pAPIBitmap, nStates, framesAreHorizontal, name);
 }
 
+std::unique_ptr<APIBitmap> IGraphics::LoadUncachedAPIBitmap(const char* name, bool background, int targetScale)
+{
+  if (targetScale == 0)
+    targetScale = GetRoundedScreenScale();
+  
+  const char* ext = name + strlen(name) - 1;
+  while (ext >= name && *ext != '.') --ext;
+  ++ext;
+  
+  if (!BitmapExtSupported(ext))
+    return nullptr;
+  
+  WDL_String fullPath;
+  int sourceScale = 0;
+  EResourceLocation resourceLocation = SearchImageResource(name, ext, fullPath, targetScale, sourceScale);
+  
+  if (resourceLocation == EResourceLocation::kNotFound)
+    return nullptr;
+  
+  // the backends decode in the background when this is set
+  const bool asyncBitmapDecoding = mAsyncBitmapDecoding;
+  mAsyncBitmapDecoding = background;
+  std::unique_ptr<APIBitmap> bitmap(LoadAPIBitmap(fullPath.Get(), sourceScale, resourceLocation, ext));
+  mAsyncBitmapDecoding = asyncBitmapDecoding;
+  
+  return bitmap;
+}
+
 void IGraphics::ReleaseBitmap(const IBitmap &bitmap)
 {
-  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache, this);
   storage.Remove(bitmap.GetAPIBitmap());
 }
 
 void IGraphics::RetainBitmap(const IBitmap& bitmap, const char* cacheName)
 {
-  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
-  storage.Add(bitmap.GetAPIBitmap(), cacheName, bitmap.GetScale());
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache, this);
+  const APIBitmap* pAPIBitmap = bitmap.GetAPIBitmap();
+  storage.Add(bitmap.GetAPIBitmap(), cacheName, bitmap.GetScale(), static_cast<size_t>(pAPIBitmap->GetWidth()) * pAPIBitmap->GetHeight() * 4);
 }
 
 IBitmap IGraphics::ScaleBitmap(const IBitmap& inBitmap, const char* name, int scale)
@@ -1845,7 +2566,7 @@ EResourceLocation IGraphics::SearchImageResource(const char* name, const char* t
 
 APIBitmap* IGraphics::SearchBitmapInCache(const char* name, int targetScale, int& sourceScale)
 {
-  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache);
+  StaticStorage<APIBitmap>::Accessor storage(sBitmapCache, this);
     
   for (sourceScale = targetScale; sourceScale > 0; SearchNextScale(sourceScale, targetScale))
   {
@@ -1913,6 +2634,19 @@ void IGraphics::CreatePopupMenu(IControl& control, IPopupMenu& menu, const IRECT
 void IGraphics::EndDragResize()
 {
   mResizingInProcess = false;
+
+  // the preview itself is released by the next Draw(), where the drawing context is current
+  if (mResizePending)
+  {
+    mResizePending = false;
+    mSVGRasterCache.Clear();
+    ClearSVGIconAtlas();
+    ForAllControls(&IControl::OnResize);
+    SetAllControlsDirty();
+
+    if (mLayoutOnResize)
+      GetDelegate()->LayoutUI(this);
+  }
   
   if (GetResizerMode() == EUIResizerMode::Scale)
   {
@@ -1990,6 +2724,20 @@ bool IGraphics::CheckLayer(const ILayerPtr& layer)
   return pBitmap && !layer->mInvalid && pBitmap->GetDrawScale() == GetDrawScale() && pBitmap->GetScale() == GetScreenScale();
 }
 
+ILayerPtr IGraphics::CreatePixelLayer(IControl* pControl, int width, int height, const uint8_t* pData)
+{
+  assert(width > 0 && height > 0);
+  
+  const float scale = GetScreenScale();
+  const double drawScale = GetDrawScale();
+  const float pixelsPerPoint = static_cast<float>(scale * drawScale);
+  const IRECT bounds(0.f, 0.f, width / pixelsPerPoint, height / pixelsPerPoint);
+  
+  ILayerPtr layer(new ILayer(CreatePixelAPIBitmap(width, height, scale, drawScale), bounds, pControl, pControl ? pControl->GetRECT() : IRECT()));
+  UpdatePixelLayer(layer, pData, 0, 0, width, height);
+  return layer;
+}
+
 void IGraphics::DrawLayer(const ILayerPtr& layer, const IBlend* pBlend)
 {
   PathTransformSave();
@@ -2020,71 +2768,52 @@ void IGraphics::DrawRotatedLayer(const ILayerPtr& layer, double angle)
   PathTransformRestore();
 }
 
+void IGraphics::GetLayerBitmapDataAsync(const ILayerPtr& layer, ILayerBitmapDataFunc completion)
+{
+  std::unique_ptr<RawBitmapData> pData(new RawBitmapData);
+  GetLayerBitmapData(layer, *pData);
+  QueueLayerBitmapData(std::move(pData), std::move(completion));
+}
+
+void IGraphics::QueueLayerBitmapData(std::unique_ptr<RawBitmapData> pData, ILayerBitmapDataFunc completion)
+{
+  mPendingLayerBitmapData.push_back({std::move(pData), std::move(completion)});
+}
+
 void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
 {
-  auto GaussianBlurSwap = [](uint8_t* out, uint8_t* in, uint8_t* kernel, int width, int height,
-                             int outStride, int inStride, int kernelSize, uint32_t norm)
+  if (ApplyNativeLayerDropShadow(layer, shadow))
+    return;
+
+  // Blur one row of a single channel plane into a column of out. The row is zero padded by kernelSize - 1 on each side,
+  // so that the inner loop has no edge cases and can be vectorised, and the result is the same as omitting the samples outside the row
+  auto GaussianBlurRow = [](uint8_t* out, const uint8_t* paddedIn, uint32_t* accum, const uint32_t* kernel, int width,
+                            int outStride, int kernelSize, uint32_t norm)
   {
-    int repeats = 0;
-    int fullKernelSize = kernelSize * 2 + 1;
-    uint32_t last = 0;
+    const uint8_t* in = paddedIn + kernelSize - 1;
 
-    auto RepeatCheck = [&](int idx)
-    {
-      repeats = last == in[idx * 4] ? std::min(repeats + 1, fullKernelSize) : 1;
-      last = in[idx * 4];
-        
-      return repeats == fullKernelSize;
-    };
-      
-    for (int i = 0; i < height; i++, in += inStride)
+    for (int j = 0; j < width; j++)
+      accum[j] = kernel[0] * in[j];
+
+    for (int k = 1; k < kernelSize; k++)
     {
-      for (int j = 0; j < kernelSize - 1; j++)
-      {
-        uint32_t accum = in[j * 4] * kernel[0];
-        for (int k = 1; k < j + 1; k++)
-          accum += kernel[k] * in[(j - k) * 4];
-        for (int k = 1; k < kernelSize; k++)
-          accum += kernel[k] * in[(j + k) * 4];
-        out[j * outStride + (i * 4)] = static_cast<uint8_t>(std::min(static_cast<uint32_t>(255), accum / norm));
-      }
-      for (int j = 0; j < kernelSize * 2 - 2; j++)
-        RepeatCheck(j);
-      for (int j = kernelSize - 1; j < (width - kernelSize) + 1; j++)
-      {
-        if (RepeatCheck(j + kernelSize - 1))
-        {
-            out[j * outStride + (i * 4)] = static_cast<uint8_t>(last);
-            continue;
-        }
-          
-        uint32_t accum = in[j * 4] * kernel[0];
-        for (int k = 1; k < kernelSize; k++)
-          accum += kernel[k] * (in[(j - k) * 4] + in[(j + k) * 4]);
-        out[j * outStride + (i * 4)] = static_cast<uint8_t>(std::min(static_cast<uint32_t>(255), accum / norm));
-      }
-      for (int j = (width - kernelSize) + 1; j < width; j++)
-      {
-        uint32_t accum = in[j * 4] * kernel[0];
-        for (int k = 1; k < kernelSize; k++)
-          accum += kernel[k] * in[(j - k) * 4];
-        for (int k = 1; k < width - j; k++)
-          accum += kernel[k] * in[(j + k) * 4];
-        out[j * outStride + (i * 4)] = static_cast<uint8_t>(std::min(static_cast<uint32_t>(255), accum / norm));
-      }
+      const uint32_t weight = kernel[k];
+
+      for (int j = 0; j < width; j++)
+        accum[j] += weight * (in[j - k] + in[j + k]);
     }
+
+    for (int j = 0; j < width; j++)
+      out[j * outStride] = static_cast<uint8_t>(std::min(static_cast<uint32_t>(255), accum[j] / norm));
   };
-  
-  RawBitmapData temp1;
-  RawBitmapData temp2;
-  RawBitmapData kernel;
+
+  RawBitmapData data;
     
   // Get bitmap in 32-bit form
-  GetLayerBitmapData(layer, temp1);
+  GetLayerBitmapData(layer, data);
     
-  if (!temp1.GetSize())
+  if (!data.GetSize())
       return;
-  temp2.Resize(temp1.GetSize());
     
   // Form kernel (reference blurSize from zero (which will be no blur))
   bool flipped = FlippedBitmap();
@@ -2094,35 +2823,75 @@ void IGraphics::ApplyLayerDropShadow(ILayerPtr& layer, const IShadow& shadow)
   int iSize = static_cast<int>(ceil(blurSize));
   int width = layer->GetAPIBitmap()->GetWidth();
   int height = layer->GetAPIBitmap()->GetHeight();
-  int stride1 = temp1.GetSize() / width;
-  int stride2 = flipped ? -temp1.GetSize() / height : temp1.GetSize() / height;
-  int stride3 = flipped ? -stride2 : stride2;
+  int rowBytes = data.GetSize() / height;
 
+  WDL_TypedBuf<uint32_t> kernel;
   kernel.Resize(iSize);
         
   for (int i = 0; i < iSize; i++)
-    kernel.Get()[i] = static_cast<uint8_t>(std::round(255.f * std::expf(-(i * i) * blurConst)));
+    kernel.Get()[i] = static_cast<uint8_t>(std::round(255.f * std::exp(-(i * i) * blurConst)));
   
   // Kernel normalisation
-  int normFactor = kernel.Get()[0];
+  uint32_t normFactor = kernel.Get()[0];
     
   for (int i = 1; i < iSize; i++)
     normFactor += kernel.Get()[i] + kernel.Get()[i];
-  
-  // Do blur
-  uint8_t* asRows = temp1.Get() + AlphaChannel();
-  uint8_t* inRows = flipped ? asRows + stride3 * (height - 1) : asRows;
-  uint8_t* asCols = temp2.Get() + AlphaChannel();
-  
-  GaussianBlurSwap(asCols, inRows, kernel.Get(), width, height, stride1, stride2, iSize, normFactor);
-  GaussianBlurSwap(asRows, asCols, kernel.Get(), height, width, stride3, stride1, iSize, normFactor);
+
+  // The alpha channel is blurred as contiguous planes, each pass blurring the rows of one plane into the columns of the other
+  const int padding = iSize - 1;
+  const int maxLength = std::max(width, height);
+  WDL_TypedBuf<uint8_t> rows;
+  WDL_TypedBuf<uint8_t> cols;
+  WDL_TypedBuf<uint8_t> paddedRow;
+  WDL_TypedBuf<uint32_t> accum;
+  rows.Resize(width * height);
+  cols.Resize(width * height);
+  paddedRow.Resize(maxLength + 2 * padding);
+  accum.Resize(maxLength);
+
+  // N.B. a flipped bitmap is read from the bottom up, and the mask is written from the top down
+  for (int i = 0; i < height; i++)
+  {
+    const uint8_t* pAlpha = data.Get() + (flipped ? height - 1 - i : i) * rowBytes + AlphaChannel();
+    uint8_t* pRow = rows.Get() + i * width;
+
+    for (int j = 0; j < width; j++)
+      pRow[j] = pAlpha[j * 4];
+  }
+
+  // Do blur, clearing the padding before each pass as the rows are a different length
+  memset(paddedRow.Get(), 0, paddedRow.GetSize());
+
+  for (int i = 0; i < height; i++)
+  {
+    memcpy(paddedRow.Get() + padding, rows.Get() + i * width, width);
+    GaussianBlurRow(cols.Get() + i, paddedRow.Get(), accum.Get(), kernel.Get(), width, height, iSize, normFactor);
+  }
+
+  memset(paddedRow.Get(), 0, paddedRow.GetSize());
+
+  for (int i = 0; i < width; i++)
+  {
+    memcpy(paddedRow.Get() + padding, cols.Get() + i * height, height);
+    GaussianBlurRow(rows.Get() + i, paddedRow.Get(), accum.Get(), kernel.Get(), height, width, iSize, normFactor);
+  }
+
+  for (int i = 0; i < height; i++)
+  {
+    uint8_t* pAlpha = data.Get() + i * rowBytes + AlphaChannel();
+    const uint8_t* pRow = rows.Get() + i * width;
+
+    for (int j = 0; j < width; j++)
+      pAlpha[j * 4] = pRow[j];
+  }
   
   // Apply alphas to the pattern and recombine/replace the image
-  ApplyShadowMask(layer, temp1, shadow);
+  ApplyShadowMask(layer, data, shadow);
 }
 
 bool IGraphics::LoadFont(const char* fontID, const char* fileNameOrResID)
 {
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
   PlatformFontPtr font = LoadPlatformFont(fontID, fileNameOrResID);
   
   if (font)
@@ -2140,6 +2909,7 @@ bool IGraphics::LoadFont(const char* fontID, const char* fileNameOrResID)
 
 bool IGraphics::LoadFont(const char* fontID, void* pData, int dataSize)
 {
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
   PlatformFontPtr font = LoadPlatformFont(fontID, pData, dataSize);
 
   if (font)
@@ -2157,6 +2927,7 @@ bool IGraphics::LoadFont(const char* fontID, void* pData, int dataSize)
 
 bool IGraphics::LoadFont(const char* fontID, const char* fontName, ETextStyle style)
 {
+  IPlugStartupTimeline::ScopedPhase loadPhase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLoadResources);
   PlatformFontPtr font = LoadPlatformFont(fontID, fontName, style);
   
   if (font)
@@ -2424,6 +3195,94 @@ void IGraphics::DrawData(const IColor& color, const IRECT& bounds, float* normYP
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
+void IGraphics::DrawDataEnvelope(const IColor& color, const IRECT& bounds, const float* normYPoints, int nPoints, const IBlend* pBlend, float thickness)
+{
+  const int nColumns = std::max(1, static_cast<int>(std::ceil(bounds.W() * GetBackingPixelScale())));
+  
+  // sparse points are drawn as a line, which is what the envelope would look like
+  if (nPoints <= nColumns * 2)
+  {
+    DrawData(color, bounds, const_cast<float*>(normYPoints), nPoints, nullptr, pBlend, thickness);
+    return;
+  }
+  
+  mEnvelopeData.Resize(nColumns * 2, false);
+  float* pMins = mEnvelopeData.Get();
+  float* pMaxs = pMins + nColumns;
+  
+  for (auto c = 0; c < nColumns; c++)
+  {
+    // each column includes the last point of the one before, so that the envelope is continuous
+    const int start = std::max(static_cast<int>(static_cast<int64_t>(c) * nPoints / nColumns) - 1, 0);
+    const int end = static_cast<int>(static_cast<int64_t>(c + 1) * nPoints / nColumns);
+    const auto range = std::minmax_element(normYPoints + start, normYPoints + end);
+    pMins[c] = *range.first;
+    pMaxs[c] = *range.second;
+  }
+  
+  DrawMinMaxData(color, bounds, pMins, pMaxs, nColumns, pBlend, thickness);
+}
+
+void IGraphics::DrawMinMaxData(const IColor& color, const IRECT& bounds, const float* normYMins, const float* normYMaxs, int nColumns, const IBlend* pBlend, float thickness)
+{
+  if (nColumns <= 0)
+    return;
+  
+  const float columnWidth = bounds.W() / static_cast<float>(nColumns);
+  
+  // the top and bottom of a column, at least the thickness apart
+  auto GetEdges = [&](int c, float& top, float& bottom) {
+    top = bounds.B - (bounds.H() * normYMaxs[c]);
+    bottom = bounds.B - (bounds.H() * normYMins[c]);
+    
+    if (bottom - top < thickness)
+    {
+      const float mid = (top + bottom) * 0.5f;
+      top = mid - thickness * 0.5f;
+      bottom = mid + thickness * 0.5f;
+    }
+  };
+  
+  float top, bottom;
+  
+  PathClear();
+  GetEdges(0, top, bottom);
+  PathMoveTo(bounds.L, top);
+  
+  for (auto c = 0; c < nColumns; c++)
+  {
+    GetEdges(c, top, bottom);
+    PathLineTo(bounds.L + columnWidth * (c + 0.5f), top);
+  }
+  
+  PathLineTo(bounds.R, top);
+  
+  for (auto c = nColumns - 1; c >= 0; c--)
+  {
+    GetEdges(c, top, bottom);
+    PathLineTo(bounds.L + columnWidth * (c + 0.5f), bottom);
+  }
+  
+  GetEdges(0, top, bottom);
+  PathLineTo(bounds.L, bottom);
+  PathClose();
+  PathFill(color, IFillOptions(), pBlend);
+}
+
+void IGraphics::DrawPolyline(const IColor& color, const float* pX, const float* pY, int n, const IBlend* pBlend, float thickness)
+{
+  if (n < 2)
+    return;
+
+  PathClear();
+  PathMoveTo(pX[0], pY[0]);
+
+  for (auto i = 1; i < n; i++)
+    PathLineTo(pX[i], pY[i]);
+
+  PathStroke(color, thickness, IStrokeOptions(), pBlend);
+}
+
 void IGraphics::DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen)
 {
   PathClear();
@@ -2435,6 +3294,31 @@ void IGraphics::DrawDottedLine(const IColor& color, float x1, float y1, float x2
   PathStroke(color, thickness, options, pBlend);
 }
 
+// The shape IDs of the paths that IGraphics caches, see IGraphics::PathCacheKey()
+enum EPathCacheShape : uint32_t
+{
+  kPathCacheRoundRect = 0x80000000,
+  kPathCacheRoundRectCorners,
+  kPathCacheArc,
+  kPathCachePie,
+  kPathCacheCircle,
+  kPathCacheEllipse,
+  kPathCacheRotatedEllipse
+};
+
+/** Build the current path with func, unless the backend has cached it */
+template <typename Func>
+static void PathWithCache(IGraphics& g, uint32_t shapeID, std::initializer_list<float> params, Func&& func)
+{
+  const uint64_t key = IGraphics::PathCacheKey(shapeID, params);
+
+  if (!g.PathReuse(key))
+  {
+    func();
+    g.PathCache(key);
+  }
+}
+
 void IGraphics::DrawTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend, float thickness)
 {
   PathClear();
@@ -2452,14 +3336,14 @@ void IGraphics::DrawRect(const IColor& color, const IRECT& bounds, const IBlend*
 void IGraphics::DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathRoundRect(bounds, cornerRadius);
+  PathWithCache(*this, kPathCacheRoundRect, {bounds.L, bounds.T, bounds.R, bounds.B, cornerRadius}, [&]() { PathRoundRect(bounds, cornerRadius); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
 void IGraphics::DrawRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathRoundRect(bounds, cRTL, cRTR, cRBR, cRBL);
+  PathWithCache(*this, kPathCacheRoundRectCorners, {bounds.L, bounds.T, bounds.R, bounds.B, cRTL, cRTR, cRBR, cRBL}, [&]() { PathRoundRect(bounds, cRTL, cRTR, cRBR, cRBL); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
@@ -2473,14 +3357,14 @@ void IGraphics::DrawConvexPolygon(const IColor& color, float* x, float* y, int n
 void IGraphics::DrawArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathArc(cx, cy, r, a1, a2);
+  PathWithCache(*this, kPathCacheArc, {cx, cy, r, a1, a2}, [&]() { PathArc(cx, cy, r, a1, a2); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
 void IGraphics::DrawCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathCircle(cx, cy, r);
+  PathWithCache(*this, kPathCacheCircle, {cx, cy, r}, [&]() { PathCircle(cx, cy, r); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
@@ -2496,14 +3380,14 @@ void IGraphics::DrawDottedRect(const IColor& color, const IRECT& bounds, const I
 void IGraphics::DrawEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathEllipse(bounds);
+  PathWithCache(*this, kPathCacheEllipse, {bounds.L, bounds.T, bounds.R, bounds.B}, [&]() { PathEllipse(bounds); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
 void IGraphics::DrawEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend, float thickness)
 {
   PathClear();
-  PathEllipse(x, y, r1, r2, angle);
+  PathWithCache(*this, kPathCacheRotatedEllipse, {x, y, r1, r2, angle}, [&]() { PathEllipse(x, y, r1, r2, angle); });
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
@@ -2531,14 +3415,14 @@ void IGraphics::FillRectWithPattern(const IPattern& pattern, const IRECT& bounds
 void IGraphics::FillRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius, const IBlend* pBlend)
 {
   PathClear();
-  PathRoundRect(bounds, cornerRadius);
+  PathWithCache(*this, kPathCacheRoundRect, {bounds.L, bounds.T, bounds.R, bounds.B, cornerRadius}, [&]() { PathRoundRect(bounds, cornerRadius); });
   PathFill(color, IFillOptions(), pBlend);
 }
 
 void IGraphics::FillRoundRect(const IColor& color, const IRECT& bounds, float cRTL, float cRTR, float cRBR, float cRBL, const IBlend* pBlend)
 {
   PathClear();
-  PathRoundRect(bounds, cRTL, cRTR, cRBR, cRBL);
+  PathWithCache(*this, kPathCacheRoundRectCorners, {bounds.L, bounds.T, bounds.R, bounds.B, cRTL, cRTR, cRBR, cRBL}, [&]() { PathRoundRect(bounds, cRTL, cRTR, cRBR, cRBL); });
   PathFill(color, IFillOptions(), pBlend);
 }
 
@@ -2552,30 +3436,60 @@ void IGraphics::FillConvexPolygon(const IColor& color, float* x, float* y, int n
 void IGraphics::FillArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend)
 {
   PathClear();
-  PathMoveTo(cx, cy);
-  PathArc(cx, cy, r, a1, a2);
-  PathClose();
+  PathWithCache(*this, kPathCachePie, {cx, cy, r, a1, a2}, [&]() {
+    PathMoveTo(cx, cy);
+    PathArc(cx, cy, r, a1, a2);
+    PathClose();
+  });
   PathFill(color, IFillOptions(), pBlend);
 }
 
 void IGraphics::FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend)
 {
   PathClear();
-  PathCircle(cx, cy, r);
+  PathWithCache(*this, kPathCacheCircle, {cx, cy, r}, [&]() { PathCircle(cx, cy, r); });
   PathFill(color, IFillOptions(), pBlend);
 }
 
+void IGraphics::FillRects(const IRECT* pRects, const IColor* pColors, int n, const IBlend* pBlend)
+{
+  for (auto i = 0; i < n;)
+  {
+    const IColor& color = pColors[i];
+    PathClear();
+
+    for (; i < n && pColors[i] == color; i++)
+      PathRect(pRects[i]);
+
+    PathFill(color, IFillOptions(), pBlend);
+  }
+}
+
+void IGraphics::FillCircles(const float* pCX, const float* pCY, const float* pR, const IColor* pColors, int n, const IBlend* pBlend)
+{
+  for (auto i = 0; i < n;)
+  {
+    const IColor& color = pColors[i];
+    PathClear();
+
+    for (; i < n && pColors[i] == color; i++)
+      PathCircle(pCX[i], pCY[i], pR[i]);
+
+    PathFill(color, IFillOptions(), pBlend);
+  }
+}
+
 void IGraphics::FillEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend)
 {
   PathClear();
-  PathEllipse(bounds);
+  PathWithCache(*this, kPathCacheEllipse, {bounds.L, bounds.T, bounds.R, bounds.B}, [&]() { PathEllipse(bounds); });
   PathFill(color, IFillOptions(), pBlend);
 }
 
 void IGraphics::FillEllipse(const IColor& color, float x, float y, float r1, float r2, float angle, const IBlend* pBlend)
 {
   PathClear();
-  PathEllipse(x, y, r1, r2, angle);
+  PathWithCache(*this, kPathCacheRotatedEllipse, {x, y, r1, r2, angle}, [&]() { PathEllipse(x, y, r1, r2, angle); });
   PathFill(color, IFillOptions(), pBlend);
 }
 
@@ -2717,6 +3631,11 @@ void IGraphics::PathTransformMatrix(const IMatrix& matrix)
   PathTransformSetMatrix(mTransform);
 }
 
+IRECT IGraphics::GetDrawRegion() const
+{
+  return mLayers.empty() ? mClipRECT : mLayers.top()->Bounds();
+}
+
 void IGraphics::PathClipRegion(const IRECT r)
 {
   IRECT drawArea = mLayers.empty() ? mClipRECT : mLayers.top()->Bounds();
@@ -2737,6 +3656,117 @@ void IGraphics::DrawFittedBitmap(const IBitmap& bitmap, const IRECT& bounds, con
 }
 
 void IGraphics::DrawSVG(const ISVG& svg, const IRECT& dest, const IBlend* pBlend)
+{
+  const bool rasterize = mSVGRasterCacheEnabled && dest.W() > 0.f && dest.H() > 0.f
+                      && mTransform.mXX == 1.0 && mTransform.mYX == 0.0 && mTransform.mXY == 0.0 && mTransform.mYY == 1.0;
+  
+  if (rasterize)
+  {
+    const uint64_t key = SVGRasterKey(svg, dest.W(), dest.H());
+    
+    if (ILayerPtr* pLayer = mSVGRasterCache.Find(key))
+    {
+      DrawBitmap((*pLayer)->GetBitmap(), dest, 0, 0, pBlend);
+      return;
+    }
+    
+    QueueSVGRaster(svg, dest.W(), dest.H(), key);
+  }
+  
+  DrawFittedSVG(svg, dest, pBlend);
+}
+
+void IGraphics::DrawSVGIcon(const ISVG& svg, const IRECT& dest, const IBlend* pBlend)
+{
+  const bool fromAtlas = svg.IsValid() && dest.W() > 0.f && dest.H() > 0.f
+                      && mTransform.mXX == 1.0 && mTransform.mYX == 0.0 && mTransform.mXY == 0.0 && mTransform.mYY == 1.0;
+  
+  if (fromAtlas)
+  {
+    const uint64_t key = SVGRasterKey(svg, dest.W(), dest.H());
+    auto it = std::find_if(mSVGIcons.begin(), mSVGIcons.end(), [key](const SVGIcon& icon) { return icon.key == key; });
+    
+    if (it == mSVGIcons.end())
+    {
+      mSVGIcons.push_back({svg, dest.W(), dest.H(), key});
+      mSVGIconAtlasInvalid = true;
+    }
+    else if (it->packed && mSVGIconAtlas)
+    {
+      DrawBitmap(mSVGIconAtlas->GetBitmap(), dest, it->x, it->y, pBlend);
+      return;
+    }
+  }
+  
+  DrawFittedSVG(svg, dest, pBlend);
+}
+
+void IGraphics::RebuildSVGIconAtlas()
+{
+  if (!mSVGIconAtlasInvalid)
+    return;
+  
+  mSVGIconAtlasInvalid = false;
+  
+  // pack the icons into rows, tallest first, so that the rows waste little space
+  std::vector<SVGIcon*> icons;
+  
+  for (auto& icon : mSVGIcons)
+    icons.push_back(&icon);
+  
+  std::stable_sort(icons.begin(), icons.end(), [](const SVGIcon* a, const SVGIcon* b) { return a->height > b->height; });
+  
+  int x = 0, y = 0, rowHeight = 0;
+  
+  for (auto* pIcon : icons)
+  {
+    const int w = static_cast<int>(std::ceil(pIcon->width)) + SVG_ICON_ATLAS_PADDING;
+    const int h = static_cast<int>(std::ceil(pIcon->height)) + SVG_ICON_ATLAS_PADDING;
+    
+    if (x + w > SVG_ICON_ATLAS_SIZE)
+    {
+      x = 0;
+      y += rowHeight;
+      rowHeight = 0;
+    }
+    
+    pIcon->packed = w <= SVG_ICON_ATLAS_SIZE && y + h <= SVG_ICON_ATLAS_SIZE;
+    
+    if (pIcon->packed)
+    {
+      pIcon->x = x;
+      pIcon->y = y;
+      x += w;
+      rowHeight = std::max(rowHeight, h);
+    }
+  }
+  
+  const int height = std::min(y + rowHeight, SVG_ICON_ATLAS_SIZE);
+  
+  mSVGIconAtlas = nullptr;
+  
+  if (!height)
+    return;
+  
+  StartLayer(nullptr, IRECT(0.f, 0.f, static_cast<float>(SVG_ICON_ATLAS_SIZE), static_cast<float>(height)));
+  
+  for (const auto& icon : mSVGIcons)
+  {
+    if (icon.packed)
+      DrawFittedSVG(icon.svg, IRECT(static_cast<float>(icon.x), static_cast<float>(icon.y), icon.x + icon.width, icon.y + icon.height), nullptr);
+  }
+  
+  mSVGIconAtlas = EndLayer();
+}
+
+void IGraphics::ClearSVGIconAtlas()
+{
+  mSVGIcons.clear();
+  mSVGIconAtlas = nullptr;
+  mSVGIconAtlasInvalid = false;
+}
+
+void IGraphics::DrawFittedSVG(const ISVG& svg, const IRECT& dest, const IBlend* pBlend)
 {
   float xScale = dest.W() / svg.W();
   float yScale = dest.H() / svg.H();
@@ -2749,6 +3779,114 @@ void IGraphics::DrawSVG(const ISVG& svg, const IRECT& dest, const IBlend* pBlend
   PathTransformRestore();
 }
 
+void IGraphics::SetSVGRasterCache(bool enable)
+{
+  mSVGRasterCacheEnabled = enable;
+  
+  if (!enable)
+  {
+    mSVGRasterCache.Clear();
+    mPendingSVGRasters.clear();
+  }
+}
+
+void IGraphics::PrewarmSVG(const ISVG& svg, const IRECT& bounds)
+{
+  if (!mSVGRasterCacheEnabled || !svg.IsValid() || bounds.W() <= 0.f || bounds.H() <= 0.f)
+    return;
+  
+  const uint64_t key = SVGRasterKey(svg, bounds.W(), bounds.H());
+  
+  if (!mSVGRasterCache.Find(key))
+    QueueSVGRaster(svg, bounds.W(), bounds.H(), key);
+}
+
+uint64_t IGraphics::SVGRasterKey(const ISVG& svg, float width, float height) const
+{
+#ifdef SVG_USE_SKIA
+  const void* pImage = svg.mSVGDom.get();
+#else
+  const void* pImage = svg.mImage;
+#endif
+  
+  const float params[] = { width, height, GetDrawScale(), GetScreenScale() };
+  
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  
+  auto Add = [&hash](const void* pData, size_t size) {
+    for (size_t i = 0; i < size; i++)
+      hash = (hash ^ static_cast<const uint8_t*>(pData)[i]) * 1099511628211ull;
+  };
+  
+  Add(&pImage, sizeof(pImage));
+  Add(params, sizeof(params));
+  
+  return hash;
+}
+
+void IGraphics::QueueSVGRaster(const ISVG& svg, float width, float height, uint64_t key)
+{
+  for (const auto& pending : mPendingSVGRasters)
+  {
+    if (pending.key == key)
+      return;
+  }
+  
+  mPendingSVGRasters.push_back({svg, width, height, key});
+}
+
+void IGraphics::RasterizePendingSVGs()
+{
+  for (const auto& pending : mPendingSVGRasters)
+  {
+    const IRECT bounds(0.f, 0.f, pending.width, pending.height);
+    
+    StartLayer(nullptr, bounds);
+    DrawFittedSVG(pending.svg, bounds, nullptr);
+    mSVGRasterCache.Add(pending.key, EndLayer());
+  }
+  
+  mPendingSVGRasters.clear();
+}
+
+void IGraphics::PrewarmGlyphs(const IText& text, const char* glyphs)
+{
+  std::string str;
+  
+  if (glyphs)
+  {
+    str = glyphs;
+  }
+  else
+  {
+    for (char c = ' '; c <= '~'; c++)
+      str.push_back(c);
+  }
+  
+  if (str.empty())
+    return;
+  
+  for (auto& pending : mPendingGlyphs)
+  {
+    if (!strcmp(pending.first.mFont, text.mFont) && pending.first.mSize == text.mSize)
+    {
+      pending.second.append(str);
+      return;
+    }
+  }
+  
+  mPendingGlyphs.emplace_back(text, std::move(str));
+}
+
+void IGraphics::RasterizePendingGlyphs()
+{
+  for (const auto& pending : mPendingGlyphs)
+    DoPrewarmGlyphs(pending.first, pending.second.c_str());
+  
+  mPendingGlyphs.clear();
+}
+
 void IGraphics::DrawRotatedSVG(const ISVG& svg, float destCtrX, float destCtrY, float width, float height, double angle, const IBlend* pBlend)
 {
   PathTransformSave();
@@ -2803,7 +3941,24 @@ void IGraphics::DoDrawSVG(const ISVG& svg, const IBlend* pBlend)
 {
 #ifdef SVG_USE_SKIA
   SkCanvas* canvas = static_cast<SkCanvas*>(GetDrawContext());
-  svg.mSVGDom->render(canvas); //TODO: blend
+  
+  // the SVG is drawn into a layer that is composited with the blend, as the shapes in it have their own paints
+  if (pBlend)
+  {
+    SkPaint paint;
+    paint.setAlphaf(BlendWeight(pBlend));
+    paint.setBlendMode(SkiaBlendMode(pBlend));
+    canvas->saveLayer(nullptr, &paint);
+  }
+  
+  // replaying the recording skips walking the DOM and setting up each draw
+  if (svg.mPicture)
+    canvas->drawPicture(svg.mPicture);
+  else
+    svg.mSVGDom->render(canvas);
+  
+  if (pBlend)
+    canvas->restore();
 #else
   NSVGimage* pImage = svg.mImage;
   
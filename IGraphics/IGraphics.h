@@ -43,6 +43,8 @@
 #include "IPlugConstants.h"
 #include "IPlugLogger.h"
 #include "IPlugPaths.h"
+#include "IPlugWorkerPool.h"
+#include "IPlugTaskQueue.h"
 
 #include "IGraphicsConstants.h"
 #include "IGraphicsStructs.h"
@@ -53,8 +55,17 @@
 
 #include <stack>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <unordered_map>
+#include <initializer_list>
+
+#ifdef IGRAPHICS_RENDER_THREAD
+/** Lock the controls of an IGraphics context for the rest of the scope, when the UI is drawn on its own thread, see IGraphics::GetRenderMutex() */
+#define IGRAPHICS_RENDER_LOCK(pGraphics) std::lock_guard<std::recursive_mutex> renderLock((pGraphics)->GetRenderMutex())
+#else
+#define IGRAPHICS_RENDER_LOCK(pGraphics)
+#endif
 
 #ifdef FillRect
 #undef FillRect
@@ -154,6 +165,15 @@ public:
    * @param thickness Optional line thickness */
   virtual void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend = 0, float thickness = 1.f);
 
+  /** Draw a line through a series of points, stroked as a single path
+   * @param color The color to draw the line with
+   * @param pX The X coordinates of the points
+   * @param pY The Y coordinates of the points
+   * @param n The number of points
+   * @param pBlend Optional blend method
+   * @param thickness Optional line thickness */
+  virtual void DrawPolyline(const IColor& color, const float* pX, const float* pY, int n, const IBlend* pBlend = 0, float thickness = 1.f);
+
   /** Draw a dotted line to the graphics context
    * @param color The color to draw the shape with
    * @param x1 The X coordinate of the start of the line
@@ -300,6 +320,23 @@ public:
    * @param pBlend Optional blend method */
   virtual void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend = 0);
 
+  /** Fill many rectangles, e.g. the segments of a meter, as a batch. Each run of rectangles with the same color is filled as one path, or the backend may draw the whole batch with a single draw call.
+   * N.B. overlapping rectangles in a run are only filled once, so they don't build up when the color or blend is transparent
+   * @param pRects The rectangles
+   * @param pColors The color of each rectangle
+   * @param n The number of rectangles
+   * @param pBlend Optional blend method */
+  virtual void FillRects(const IRECT* pRects, const IColor* pColors, int n, const IBlend* pBlend = 0);
+
+  /** Fill many circles, e.g. LEDs or the points of a scatter plot, as a batch. Each run of circles with the same color is filled as one path
+   * @param pCX The X coordinates of the centres of the circles
+   * @param pCY The Y coordinates of the centres of the circles
+   * @param pR The radii of the circles
+   * @param pColors The color of each circle
+   * @param n The number of circles
+   * @param pBlend Optional blend method */
+  virtual void FillCircles(const float* pCX, const float* pCY, const float* pR, const IColor* pColors, int n, const IBlend* pBlend = 0);
+
   /** Fill an ellipse within a rectangular region of the graphics context
    * @param color The color to fill the shape with
    * @param bounds The rectangular region to fill the shape in
@@ -384,6 +421,7 @@ public:
 
   /** Get a version of the input bitmap from the cache that corresponds to the current screen scale
    * For example, when IControl::OnRescale() is called bitmap-based IControls can load in 
+   * With SetAsyncBitmapDecoding(), the input bitmap is returned while the version for the current scale is decoded, and the bitmap controls are rescaled again once it has been
    * @param inBitmap The source bitmap to find a scaled version of
    * @return IBitmap The scaled bitmap */
   IBitmap GetScaledBitmap(IBitmap& inBitmap);
@@ -489,6 +527,26 @@ public:
    * @param thickness Optional line thickness
    * @param pFillColor Optional color for the fill area */
   virtual void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints = nullptr, const IBlend* pBlend = 0, float thickness = 1.f, const IColor* pFillColor = nullptr);
+
+  /** Draw a collection of normalized points as the envelope of their min and max in each pixel column, so that the cost scales with the width
+   * of the bounds rather than with the number of points. Points that are no denser than the pixels are drawn as a line, as with DrawData()
+   * @param color The color to draw the envelope with
+   * @param bounds The rectangular region to draw the envelope in
+   * @param normYPoints Ptr to float array - the normalized Y positions of the points, which are spread evenly across the bounds
+   * @param nPoints The number of points
+   * @param pBlend Optional blend method
+   * @param thickness Optional line thickness, which is also the minimum height of the envelope */
+  void DrawDataEnvelope(const IColor& color, const IRECT& bounds, const float* normYPoints, int nPoints, const IBlend* pBlend = 0, float thickness = 1.f);
+
+  /** Draw a filled envelope between the normalized min and max of each of a number of columns, e.g. from IPeakPyramid::GetColumns() for a waveform overview
+   * @param color The color to fill the envelope with
+   * @param bounds The rectangular region to draw the envelope in
+   * @param normYMins Ptr to float array - the normalized minimum of each column
+   * @param normYMaxs Ptr to float array - the normalized maximum of each column
+   * @param nColumns The number of columns, which are spread evenly across the bounds
+   * @param pBlend Optional blend method
+   * @param thickness Optional minimum height of the envelope, so that flat sections are drawn as a line */
+  void DrawMinMaxData(const IColor& color, const IRECT& bounds, const float* normYMins, const float* normYMaxs, int nColumns, const IBlend* pBlend = 0, float thickness = 1.f);
   
   /** Load a font to be used by the graphics context
    * @param fontID A CString that will be used to reference the font
@@ -557,13 +615,78 @@ public:
    * @param layer The layer to get the data from
    * @param data The pixel data extracted from the layer */
   virtual void GetLayerBitmapData(const ILayerPtr& layer, RawBitmapData& data) = 0;
+
+  /** Get the contents of a layer as Raw RGBA bitmap data, without waiting for the GPU to finish drawing it.
+   * The completion is called on the UI thread at the start of a later frame, with the data in the same layout as GetLayerBitmapData(), or empty if it could not be read.
+   * Backends that can't read asynchronously read the layer straight away, but the completion is still called later.
+   * The completion is discarded if the controls are removed first, e.g. when the UI is closed
+   * NOTE: you should only call this within IControl::Draw()
+   * @param layer The layer to get the data from. Its contents are captured now, so it can be redrawn or released before the completion is called
+   * @param completion A function taking the pixel data extracted from the layer */
+  virtual void GetLayerBitmapDataAsync(const ILayerPtr& layer, ILayerBitmapDataFunc completion);
+
+  /** Create a layer from pixels rather than by drawing, e.g. a texture that is updated a region at a time with UpdatePixelLayer().
+   * The layer is sized in pixels at the current scale, draw it with DrawFittedLayer(). As with other layers, CheckLayer() returns false when it must be created again
+   * @param pControl The control that the layer belongs to
+   * @param width The width in pixels
+   * @param height The height in pixels
+   * @param pData width * height RGBA pixels, 8 bits per channel, not premultiplied, from the top row
+   * @return ILayerPtr The new layer */
+  ILayerPtr CreatePixelLayer(IControl* pControl, int width, int height, const uint8_t* pData);
+
+  /** Upload a region of a layer made by CreatePixelLayer(), without uploading or drawing the rest of it, e.g. one new column of a scrolling display
+   * @param layer The layer to update
+   * @param pData The pixels of the whole layer, in the layout passed to CreatePixelLayer(), of which only the region is read
+   * @param x The left of the region in pixels
+   * @param y The top of the region in pixels
+   * @param width The width of the region in pixels
+   * @param height The height of the region in pixels */
+  virtual void UpdatePixelLayer(const ILayerPtr& layer, const uint8_t* pData, int x, int y, int width, int height) = 0;
+
+  /** Compile a fragment shader to fill rectangles with DrawShader(), e.g. for glows, animated backgrounds or gradients that would otherwise take many paths.
+   * The shader is written in the language of the drawing backend: SkSL with Skia, GLSL with NanoVG on OpenGL and MSL with NanoVG on Metal. See IShaderControl for the form it takes.
+   * NOTE: you should only call this within IControl::Draw(), where the backend's context is current
+   * @param source The source of the shader
+   * @param error Set to the compiler's messages if the shader can't be compiled
+   * @return IShaderPtr The shader, or nullptr if it can't be compiled or the backend doesn't support shaders */
+  virtual IShaderPtr CreateShader(const char* source, WDL_String& error) { error.Set("Shaders are not supported by this drawing backend"); return nullptr; }
+
+  /** Fill a rectangle with a shader made by CreateShader(). The shader's coordinates are in points from the top left of the rectangle
+   * @param shader The shader
+   * @param bounds The rectangle to fill
+   * @param pInputs The float uniforms of the shader. With Skia these are the uniforms in the order they are declared, with GLSL the elements of \c uniform \c float \c uInputs[] and with MSL the \c uInputs argument
+   * @param nInputs The number of inputs
+   * @param pBlend Optional blend method */
+  virtual void DrawShader(APIShader& shader, const IRECT& bounds, const float* pInputs, int nInputs, const IBlend* pBlend = nullptr) {}
   
 protected:
+  /** Queue the data read for GetLayerBitmapDataAsync(), so that the completion is called at the start of the next frame
+   * @param pData The pixel data
+   * @param completion The completion passed to GetLayerBitmapDataAsync() */
+  void QueueLayerBitmapData(std::unique_ptr<RawBitmapData> pData, ILayerBitmapDataFunc completion);
+
+  /** A function that decodes a bitmap on a background thread, and returns a function that finishes it on the UI thread, e.g. by uploading the pixels to a texture and calling APIBitmap::SetLoaded().
+   * The finish function returns \c false if the bitmap couldn't be decoded */
+  using BitmapDecodeFunc = std::function<std::function<bool()>()>;
+
+  /** Used by the drawing backends to decode a bitmap in the background, see SetAsyncBitmapDecoding(). The function that finishes it is called by BeginFrame(),
+   * after which every IGraphics that uses the bitmap is redrawn
+   * @param pBitmap The bitmap that is decoded, which draws nothing until then
+   * @param decode The function to call on a background thread */
+  void DecodeBitmapAsync(APIBitmap* pBitmap, BitmapDecodeFunc decode);
+
   /** Implemented by a graphics backend to apply a calculated shadow mask to a layer, according to the shadow settings specified
    * @param layer The layer to apply the shadow to
    * @param mask The mask of the shadow as raw bitmap data
    * @param shadow The shadow specification */
   virtual void ApplyShadowMask(ILayerPtr& layer, RawBitmapData& mask, const IShadow& shadow) = 0;
+
+  /** Implemented by a graphics backend that can blur a shadow without reading the layer back, e.g. on the GPU.
+   * Otherwise ApplyLayerDropShadow() blurs the layer's alpha on the CPU and calls ApplyShadowMask()
+   * @param layer The layer to apply the shadow to
+   * @param shadow The shadow specification
+   * @return \c true if the shadow has been applied */
+  virtual bool ApplyNativeLayerDropShadow(ILayerPtr& layer, const IShadow& shadow) { return false; }
   
   /** Implemented by a graphics backend to prepare for drawing to the layer at the top of the stack */
   virtual void UpdateLayer() {}
@@ -744,9 +867,74 @@ public:
   /** Clip the current path to a particular region
    * @param r The rectangular region to clip */
   void PathClipRegion(const IRECT r = IRECT());
+
+  /** Append a path stored with PathCache() to the current path, with the current transform. Backends that can keep a path between frames, e.g. Skia, use this to
+   * avoid rebuilding shapes that are drawn every frame with the same parameters, and to let the GPU reuse their geometry. Other backends always return \c false
+   * @code
+   * g.PathClear();
+   * const uint64_t key = IGraphics::PathCacheKey(kMyShape, {bounds.L, bounds.T, bounds.R, bounds.B, angle});
+   * if (!g.PathReuse(key)) { ...build the path...; g.PathCache(key); }
+   * g.PathFill(color);
+   * @endcode
+   * @param key The key of the path, see PathCacheKey()
+   * @return \c true if the path was in the cache, otherwise build it and call PathCache() with the same key */
+  virtual bool PathReuse(uint64_t key) { return false; }
+
+  /** Store the current path, which should have been built after PathClear(), so that PathReuse() can add it again. The path is stored without the current transform
+   * @param key The key of the path, see PathCacheKey() */
+  virtual void PathCache(uint64_t key) {}
+
+  /** @return A key for PathReuse() and PathCache(), hashed from an ID for the kind of shape and the parameters that define it
+   * @param shapeID An ID for the kind of shape. IDs with the top bit set are used by IGraphics
+   * @param params The parameters that define the shape, e.g. its bounds and corner radius */
+  static uint64_t PathCacheKey(uint32_t shapeID, std::initializer_list<float> params)
+  {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+
+    auto Add = [&hash](uint32_t bits) {
+      for (auto i = 0; i < 4; i++, bits >>= 8)
+        hash = (hash ^ (bits & 0xFF)) * 1099511628211ull;
+    };
+
+    Add(shapeID);
+
+    for (float param : params)
+    {
+      uint32_t bits;
+      memcpy(&bits, &param, sizeof(bits));
+      Add(bits);
+    }
+
+    return hash;
+  }
   
   virtual void PathTransformSetMatrix(const IMatrix& matrix) = 0;
 
+  /** @return A key for a backend's cache of text layouts, see ILRUCache, hashed from the font, size and string of the text
+   * @param text The text style, of which only the font and size are used
+   * @param str The string
+   * @param params Anything else the layout depends on, e.g. the alignment or the draw scale */
+  static uint64_t TextLayoutKey(const IText& text, const char* str, std::initializer_list<float> params)
+  {
+    // FNV-1a, over each string up to and including its terminator, so the strings can't run into each other
+    uint64_t hash = 14695981039346656037ull;
+
+    auto Add = [&hash](const void* pData, size_t size) {
+      for (size_t i = 0; i < size; i++)
+        hash = (hash ^ static_cast<const uint8_t*>(pData)[i]) * 1099511628211ull;
+    };
+
+    Add(text.mFont, strlen(text.mFont) + 1);
+    Add(str, strlen(str) + 1);
+    Add(&text.mSize, sizeof(text.mSize));
+
+    for (float param : params)
+      Add(&param, sizeof(param));
+
+    return hash;
+  }
+
   void DoTextRotation(const IText& text, const IRECT& bounds, const IRECT& rect)
   {
     if (!text.mAngle)
@@ -764,6 +952,27 @@ private:
   IPattern GetSVGPattern(const NSVGpaint& paint, float opacity);
 
   void DoDrawSVG(const ISVG& svg, const IBlend* pBlend = nullptr);
+
+  /** Draw an SVG as vectors, fitted to the bounds, bypassing the raster cache */
+  void DrawFittedSVG(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend);
+
+  /** @return The key of an SVG drawn at a size in the raster cache, which includes the current scales */
+  uint64_t SVGRasterKey(const ISVG& svg, float width, float height) const;
+
+  /** Queue an SVG to be rasterized at the start of the next frame, unless it already is */
+  void QueueSVGRaster(const ISVG& svg, float width, float height, uint64_t key);
+
+  /** Rasterize the SVGs queued by DrawSVG() and PrewarmSVG() into the cache, called at the start of each frame before the controls are drawn */
+  void RasterizePendingSVGs();
+
+  /** Pack the icons drawn with DrawSVGIcon() and rasterize them into the atlas, if one was drawn at a new size. Called at the start of each frame before the controls are drawn */
+  void RebuildSVGIconAtlas();
+
+  /** Delete the icon atlas, e.g. when the scale changes */
+  void ClearSVGIconAtlas();
+
+  /** Rasterize the glyphs queued by PrewarmGlyphs(), called at the start of each frame before the controls are drawn */
+  void RasterizePendingGlyphs();
   
   /** Prepare a particular area of the display for drawing, normally resulting in clipping of the region.
    * @param bounds The rectangular region to prepare  */
@@ -836,6 +1045,16 @@ public:
   /** @return /c true if the platform window/view is open */
   virtual bool WindowIsOpen() { return GetWindow(); }
 
+  /** Get the file descriptors that the host's run loop should watch while the window is open, on platforms where the OS doesn't deliver the UI's events itself, e.g. the X11 connection on Linux
+   * @param pFDs An array that will be filled with the file descriptors
+   * @param maxFDs The size of the array
+   * @return The number of file descriptors, 0 if the platform doesn't need any */
+  virtual int GetPollFDs(int* pFDs, int maxFDs) { return 0; }
+
+  /** Called by the host's run loop on the main thread when a file descriptor from GetPollFDs() is readable
+   * @param fd The file descriptor */
+  virtual void OnPollFD(int fd) {}
+
   /** Get text from the clipboard
    * @param str A WDL_String that will be filled with the text that is currently on the clipboard
    * @return /c true on success */
@@ -1048,6 +1267,14 @@ public:
   /* Enables layout on resize. This means IGEditorDelegate:LayoutUI() will be called when the GUI is resized */
   void SetLayoutOnResize(bool layoutOnResize);
 
+  /** Enables the resize preview. While the corner resizer is dragged, the first frame drawn is kept as a layer, which is scaled to the new size for the rest of the drag.
+   * The controls' OnResize(), LayoutUI() and the clearing of the SVG caches are deferred until the drag ends, when they happen once at the final size, as do the bitmap reloads of EUIResizerMode::Scale
+   * @param enable Set \c true to show the preview while drag resizing */
+  void EnableResizePreview(bool enable) { mResizePreviewEnabled = enable; }
+
+  /** @return \c true if the resize preview is enabled, see EnableResizePreview() */
+  bool ResizePreviewEnabled() const { return mResizePreviewEnabled; }
+
   /** Gets the width of the graphics context
    * @return A whole number representing the width of the graphics context in pixels on a 1:1 screen */
   int Width() const { return mWidth; }
@@ -1065,9 +1292,20 @@ public:
   int WindowHeight() const { return static_cast<int>(static_cast<float>(mHeight) * mDrawScale); }
 
   /** Gets the drawing frame rate
-   * @return A whole number representing the desired frame rate at which the graphics context is redrawn. NOTE: the actual frame rate might be different */
+   * @return A whole number representing the desired frame rate at which the graphics context is redrawn, or DISPLAY_REFRESH_FPS to redraw at the refresh rate of the display. NOTE: the actual frame rate might be different */
   int FPS() const { return mFPS; }
 
+  /** @return The time in seconds since the previous frame, limited to MAX_FRAME_INTERVAL. Controls that move by an amount each frame should scale it by this, so that their speed doesn't depend on the frame rate */
+  double GetFrameInterval() const { return mFrameInterval; }
+
+  /** Called by the platform classes when the window is minimised, hidden or covered by other windows. While occluded IsDirty() returns \c false without animating or asking any controls, so nothing is drawn.
+   * Animations are time based, so they are in the right place when the UI is visible again
+   * @param occluded \c true if the UI can't be seen */
+  void SetOccluded(bool occluded);
+
+  /** @return \c true if the UI can't be seen, see SetOccluded() */
+  bool IsOccluded() const { return mOccluded; }
+
   /** Gets the graphics context scaling factor.
    * @return The scaling applied to the graphics context */
   float GetDrawScale() const { return mDrawScale; }
@@ -1147,6 +1385,25 @@ public:
   /** @param enable Set \c true if you wish to show the rectangular region that is drawn on each frame, in order to debug redraw problems */
   inline void ShowAreaDrawn(bool enable) { mShowAreaDrawn = enable; if(!enable) SetAllControlsDirty(); }
   
+  /** Set how many regions are drawn when a lot of controls are dirty. Below the limit, the dirty rects are merged without drawing any extra area.
+   * Above it, they are merged into at most maxRects bounding rects, which draws some area that isn't dirty but saves the cost of each region. Use ShowAreaDrawn() to see the result
+   * @param maxRects The maximum number of regions to draw in a frame
+   * @param rectCost The fixed cost of drawing a region, as an area in points */
+  void SetMaxDirtyRects(int maxRects, float rectCost = DEFAULT_DIRTY_RECT_COST) { mMaxDirtyRects = maxRects; mDirtyRectCost = rectCost; }
+
+  /** Set the number of worker threads used to record the display lists of controls that use them, see IControl::SetUseDisplayList().
+   * The lists of dirty controls are recorded in parallel before the frame is drawn, then replayed on the drawing thread. With no worker threads (the default) they are recorded on the drawing thread
+   * @param nThreads The number of worker threads in addition to the drawing thread, -1 for one less than the number of hardware threads, or 0 for none */
+  void SetDisplayListThreads(int nThreads);
+
+#ifdef IGRAPHICS_RENDER_THREAD
+  /** When IGRAPHICS_RENDER_THREAD is defined, frames are drawn on a render thread driven by the display (CVDisplayLink on macOS, the VBlank thread on Windows) rather than on the main thread.
+   * The render thread holds this mutex while it draws a frame and skips the frame if it can't take it. Anything else that touches the controls must hold it, see IGRAPHICS_RENDER_LOCK.
+   * The platform classes queue input events that arrive while a frame is being drawn, and handle them on the main thread once it has finished
+   * @return The mutex that protects the controls */
+  std::recursive_mutex& GetRenderMutex() { return mRenderMutex; }
+#endif
+
   /**@return \c true if showning the area drawn on each frame */
   bool ShowAreaDrawnEnabled() const { return mShowAreaDrawn; }
   
@@ -1207,8 +1464,9 @@ private:
   /** \todo
    * @param pControl \todo
    * @param bounds \todo
-   * @param scale \todo */
-  void DrawControl(IControl* pControl, const IRECT& bounds, float scale);
+   * @param scale \todo
+   * @param pVisibleBounds The pixel aligned draw bounds of the control already clipped to its ancestors, from the control grid. If nullptr they are worked out by walking the parent chain */
+  void DrawControl(IControl* pControl, const IRECT& bounds, float scale, const IRECT* pVisibleBounds = nullptr);
   
   /** Shows a pop up/contextual menu in relation to a rectangular region of the graphics context
    * @param control A reference to the IControl creating this pop-up menu. If it exists IControl::OnPopupMenuSelection() will be called on successful selection
@@ -1381,6 +1639,13 @@ public:
   
   /** @return Pointer to the special pop-up menu control, if one has been attached */
   IPopupMenuControl* GetPopupMenuControl() { return mPopupControl.get(); }
+
+  /** @return Pointer to the control that a pop-up menu is open for, if there is one */
+  IControl* GetControlInPopupMenu() const { return mInPopupMenu; }
+
+  /** @return The area that is being drawn, drawing outside it has no effect, so a control can skip the parts of itself that are outside it
+   * e.g. when only part of the control is dirty, see IControl::SetDirtyRECT() */
+  IRECT GetDrawRegion() const;
   
   /** @return Pointer to the special text entry control, if one has been attached */
   ITextEntryControl* GetTextEntryControl() { return mTextEntryControl.get(); }
@@ -1431,7 +1696,7 @@ public:
   /** Calls SetDirty() on every control */
   void SetAllControlsDirty();
   
-  /** Calls SetClean() on every control */
+  /** Calls SetClean() on every control that has been marked dirty, is animating or is polled, see IControl::SetPollDirty() */
   void SetAllControlsClean();
     
   /** Reposition a control, redrawing the interface correctly
@@ -1450,6 +1715,9 @@ public:
    * @param idx The index of the control
    * @param r The new bounds for the control's target and draw rect */
   void SetControlBounds(IControl* pControl, const IRECT& r);
+
+  /** Called when the controls are attached or removed, and by IControl when its bounds change, so that the grid of control bounds used for drawing and hit testing is rebuilt before it is next used */
+  void InvalidateControlGrid() { mControlGrid.valid = false; }
   
 private:
   /** Get the index of the control at x and y coordinates on mouse event
@@ -1532,6 +1800,10 @@ public:
   /** Called by the platform class if the view changes to dark/light mode
    * @param appearance Light/Dark mode */
   void OnAppearanceChanged(EUIAppearance appearance);
+
+  /** Called via IGEditorDelegate::OnMemoryWarning() when the OS is low on memory. Releases what can be created again when it is next drawn:
+   * the controls' layers, see IControl::OnMemoryWarning(), the SVG raster cache and icon atlas, and the cached bitmaps and SVGs that no open UI uses */
+  void OnMemoryWarning();
   
   /** Get the UI Appearance (Light/Dark mode)
    * @return Light/Dark mode */
@@ -1618,6 +1890,71 @@ public:
    * @return An IBitmap representing the image */
   virtual IBitmap LoadBitmap(const char *name, const void* pData, int dataSize, int nStates = 1, bool framesAreHorizontal = false, int targetScale = 0);
 
+  /** Load a bitmap that is not added to the cache, and which belongs to the caller, e.g. a frame of an IBStreamedKnobControl.
+   * The bitmap is loaded at the nearest scale that there is a resource for, and is resampled when it is drawn at another scale
+   * @param name The name of the file or resource, e.g. "knob_001.png"
+   * @param background \c true to decode the bitmap on a background thread, as SetAsyncBitmapDecoding() does, whether or not that is enabled
+   * @param targetScale Set \c to a number > 0 to explicity load e.g. an @2x.png
+   * @return The bitmap, or nullptr if it was not found. It must not be deleted until IsLoaded() is \c true, see FinishBitmapDecoding() */
+  std::unique_ptr<APIBitmap> LoadUncachedAPIBitmap(const char* name, bool background, int targetScale = 0);
+
+  /** Decode bitmaps that are loaded from files on background threads, so that e.g. a skin-heavy UI opens without waiting for every PNG.
+   * LoadBitmap() then returns straight away with an IBitmap of the right size, which draws nothing until it has been decoded and uploaded at the start of a later frame,
+   * when all the controls are redrawn. See IBitmap::IsLoaded(). Bitmaps loaded from memory and bitmaps that must be rescaled are still decoded synchronously.
+   * When the screen scale changes, e.g. as the window is moved to a display with a different DPI, bitmap controls keep drawing the variant they have,
+   * resampled, until the variant for the new scale (e.g. the @2x.png) has been decoded, see GetScaledBitmap()
+   * @param enable \c true to decode in the background, the default is \c false */
+  void SetAsyncBitmapDecoding(bool enable) { mAsyncBitmapDecoding = enable; }
+
+  /** @return \c true if bitmaps are decoded in the background, see SetAsyncBitmapDecoding() */
+  bool GetAsyncBitmapDecoding() const { return mAsyncBitmapDecoding; }
+
+  /** Wait for the bitmaps that are being decoded and finish them now, e.g. before the drawing context is destroyed, or before a bitmap is rescaled */
+  void FinishBitmapDecoding();
+
+  /** Draw SVGs from bitmaps rasterized at the size and scale they are drawn at, so that e.g. an SVG skinned UI draws as fast as a bitmap skin.
+   * An SVG drawn at a new size is drawn as vectors, and rasterized at the start of the next frame, see PrewarmSVG(). Only SVGs drawn without
+   * rotation or scaling in the path transform use the cache, which is cleared when the UI is resized or its scale changes
+   * @param enable \c true to use the cache, the default is \c false */
+  void SetSVGRasterCache(bool enable);
+
+  /** @return \c true if SVGs are drawn from the raster cache, see SetSVGRasterCache() */
+  bool GetSVGRasterCache() const { return mSVGRasterCacheEnabled; }
+
+  /** Draw a small SVG, e.g. an icon, from an atlas that all the icons are rasterized into at the sizes and scale they are drawn at.
+   * The icons stay crisp at any scale, and are drawn as bitmaps from a single texture rather than as paths. The atlas is rebuilt at the start
+   * of the next frame when an icon is drawn at a new size, and when the UI is resized or its scale changes, until then the icon is drawn as vectors.
+   * Icons drawn with rotation or scaling in the path transform, or that don't fit in the atlas, are always drawn as vectors
+   * @param svg The SVG
+   * @param bounds The bounds to fit the SVG in
+   * @param pBlend Optional blend method */
+  void DrawSVGIcon(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend = 0);
+
+  /** Rasterize an SVG at the size it will be drawn, e.g. in the layout function, so that it is drawn from a bitmap from the first frame. See SetSVGRasterCache()
+   * @param svg The SVG
+   * @param bounds The bounds it will be drawn in with DrawSVG(), of which only the size is used */
+  void PrewarmSVG(const ISVG& svg, const IRECT& bounds);
+
+  /** Rasterize glyphs into the drawing backend's glyph cache at the start of the next frame, e.g. in the layout function, so that a UI with a lot of text
+   * doesn't stutter the first time it is drawn. With NanoVG the glyphs are added to the font atlas of this context. With Skia they are added to its glyph cache,
+   * which is shared by all the instances in the process, so glyphs prewarmed by one editor are ready for the others
+   * @param text The font and size the glyphs will be drawn with
+   * @param glyphs A UTF-8 string of the glyphs, or nullptr for the printable ASCII characters, which include the digits and the usual units */
+  void PrewarmGlyphs(const IText& text, const char* glyphs = nullptr);
+
+  /** Set the memory budgets of the bitmaps and SVGs that are cached for all the instances in the process. When a cache is over budget,
+   * the least recently used entries that no open instance has loaded are deleted, e.g. those of editors that have been closed, rather than
+   * being kept until the last instance is closed
+   * @param bitmapBytes The budget of the bitmap cache, counting 4 bytes per pixel, or 0 for no limit which is the default
+   * @param svgBytes The budget of the SVG cache, or 0 for no limit which is the default */
+  static void SetResourceCacheBudget(size_t bitmapBytes, size_t svgBytes);
+
+  /** @return The number of entries, memory and hit rate of the bitmap cache shared by all instances, see SetResourceCacheBudget() */
+  static StaticStorageStats GetBitmapCacheStats();
+
+  /** @return The number of entries, memory and hit rate of the SVG cache shared by all instances, see SetResourceCacheBudget() */
+  static StaticStorageStats GetSVGCacheStats();
+
   /** Load an SVG from disk or from windows resource
    * @param fileNameOrResID A CString absolute path or resource ID
    * @return An ISVG representing the image */
@@ -1638,6 +1975,13 @@ public:
    * @return A WDL_TypedBuf containing the data, or with a length of 0 if the resource was not found */
   virtual WDL_TypedBuf<uint8_t> LoadResource(const char* fileNameOrResID, const char* fileType);
 
+  /** Locate a resource in the file system, the bundle, or a Windows resource, and give access to its data without copying it.
+   * Files are memory mapped and Windows resources are read in place from the module. Decoders that modify their input still copy it, e.g. LoadSVG() with NanoSVG
+   * @param fileNameOrResID CString file name or resource ID
+   * @param fileType Type of the file (e.g "png", "svg", "ttf")
+   * @return The resource, which is not valid if it was not found */
+  IPlugMappedResource MapResource(const char* fileNameOrResID, const char* fileType);
+
   /** Registers a gesture recognizer with the graphics context
    * @param type The type of gesture recognizer */
   virtual void AttachGestureRecognizer(EGestureType type);
@@ -1668,6 +2012,11 @@ protected:
    * @return APIBitmap* Drawing API bitmap abstraction */
   virtual APIBitmap* LoadAPIBitmap(const char* name, const void* pData, int dataSize, int scale) = 0;
 
+  /** Drawing API method to decode a bitmap from a file again, after decoding it in the background failed, see APIBitmap::DecodeFailed()
+   * @param pBitmap The bitmap returned by LoadAPIBitmap()
+   * @param path The absolute path of the file */
+  virtual void RetryAPIBitmapDecode(APIBitmap* pBitmap, const char* path) {}
+
   /** Creates a new API bitmap, either in memory or as a GPU texture
    * @param width The desired width
    * @param height The desired height
@@ -1677,6 +2026,14 @@ protected:
    * @return APIBitmap* The new API Bitmap */
   virtual APIBitmap* CreateAPIBitmap(int width, int height, float scale, double drawScale, bool cacheable = false) = 0;
 
+  /** Creates a new API bitmap for CreatePixelLayer(), whose pixels are then written with UpdatePixelLayer(). By default this is a bitmap that can be drawn to, as for other layers
+   * @param width The desired width
+   * @param height The desired height
+   * @param scale The scale in relation to 1:1 pixels
+   * @param drawScale \todo
+   * @return APIBitmap* The new API Bitmap */
+  virtual APIBitmap* CreatePixelAPIBitmap(int width, int height, float scale, double drawScale) { return CreateAPIBitmap(width, height, scale, drawScale); }
+
   /** Drawing API method to load a font from a PlatformFontPtr, called internally
    * @param fontID A CString that will be used to reference the font
    * @param font Valid PlatformFontPtr, loaded via LoadPlatformFont
@@ -1722,6 +2079,11 @@ protected:
    * @param pBlend \todo */
   virtual void DoDrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend = nullptr) = 0;
 
+  /** Rasterize glyphs into the backend's glyph cache without drawing them, see PrewarmGlyphs(). Backends without a glyph cache do nothing
+   * @param text The font and size the glyphs will be drawn with
+   * @param glyphs A UTF-8 string of the glyphs */
+  virtual void DoPrewarmGlyphs(const IText& text, const char* glyphs) {}
+
   /** \todo
    * @param text \todo
    * @param bounds \todo
@@ -1748,8 +2110,84 @@ private:
     mMouseOver = nullptr;
     mMouseOverIdx = -1;
   }
-  
+
+  /** Calls func for the controls that are not in mControls, e.g. the corner resizer and text entry, in drawing order */
+  void ForSpecialControlsFunc(std::function<void(IControl* pControl)> func);
+
+  /** Rebuild the control grid if controls have been added, removed or have moved since it was built. Called once per frame before drawing, and before hit testing if the grid has been invalidated */
+  void UpdateControlGrid();
+
+  /** Get the indices of the controls in mControls whose bounds may overlap a rectangle, in ascending order, from the control grid
+   * @param bounds The rectangle
+   * @param controlIdxs Filled with the indices of the controls */
+  void GetControlsInRect(const IRECT& bounds, std::vector<int>& controlIdxs) const;
+
+  /** @return The index of the cell of the control grid that contains a point, or -1 if it is outside the grid */
+  int GetControlGridCell(float x, float y) const;
+
+  /** Record the display lists of the dirty controls that use them, in parallel if there are worker threads, see SetDisplayListThreads() */
+  void RecordDisplayLists();
+
+  /** Called by IControl::SetDirty(), the first time the control is marked dirty since the last SetAllControlsClean() */
+  void AddDirtyControl(IControl* pControl) { mDirtyControls.Add(pControl); }
+
+  /** Called by IControl::SetAnimation(), the control is animated at each display refresh until its animation function is cleared */
+  void AddAnimatingControl(IControl* pControl);
+
+  /** Called by IControl::SetPollDirty() */
+  void SetControlPolled(IControl* pControl, bool poll);
+
+  /** Called by IControl::AnimateValue(), start animating a value of a control, or retarget the animation of that value if it is already running */
+  void AnimateValue(IControl* pControl, float& value, float target, const IAnimationCurve& curve);
+
+  /** Advance all the animated values by the frame interval, and mark the controls that own them dirty
+   * @param elapsed The time since the previous frame in seconds */
+  void AdvanceValueAnimations(double elapsed);
+
+  /** Called by the IControl destructor, to remove it from the lists of dirty, animating and polled controls */
+  void ForgetControl(IControl* pControl);
+
+  /** A uniform grid of the bounds of the controls, so that Draw() only visits the controls that overlap each dirty rectangle, and GetMouseControlIdx() only tests the controls under the mouse, rather than all of them */
+  struct ControlGrid
+  {
+    static constexpr float kCellSize = 64.f;
+    static constexpr int kMaxCellsPerSide = 64;
+    static constexpr int kMinControls = 32; // with fewer controls it is quicker to test them all
+
+    std::vector<IRECT> controlBounds; // the draw bounds of each control when the grid was built
+    std::vector<IRECT> controlTargetBounds; // the target bounds of each control when the grid was built
+    std::vector<IControl*> controlParents; // the parent of each control when the grid was built
+    std::vector<IRECT> controlVisibleBounds; // the pixel aligned draw bounds of each control clipped to its ancestors, empty if it is outside one of them
+    std::vector<std::vector<int>> cells; // the indices of the controls overlapping each cell with either of their bounds, in ascending order
+    std::vector<int> controlIdxs; // reused by Draw()
+    IRECT bounds;
+    int nCols = 0;
+    int nRows = 0;
+    float scale = 0.f; // the backing pixel scale used for controlVisibleBounds
+    bool valid = false; // false if there are too few controls, or a control may have moved since UpdateControlGrid()
+  };
+
+  // declared before the controls, so that they can be removed from these lists when they are destroyed
+  WDL_PtrList<IControl> mDirtyControls; // the controls marked dirty since the last SetAllControlsClean(), so that an idle UI doesn't poll every control
+  WDL_PtrList<IControl> mAnimatingControls; // the controls with animation functions
+  WDL_PtrList<IControl> mPolledControls; // the controls whose IsDirty() is called at every display refresh, see IControl::SetPollDirty()
+
+  /** A value of a control that is animated by AdvanceValueAnimations() */
+  struct ValueAnimation
+  {
+    IControl* pControl;
+    float* pValue;
+    float start;
+    float target;
+    float velocity; // of a spring, in units per second
+    float elapsed; // of an eased curve, in milliseconds
+    IAnimationCurve curve;
+  };
+
+  std::vector<ValueAnimation> mValueAnimations; // only the running animations, finished ones are swapped out
+
   WDL_PtrList<IControl> mControls;
+  ControlGrid mControlGrid;
   std::unordered_map<int, IControl*> mCtrlTags;
 
   // Order (front-to-back) ToolTip / PopUp / TextEntry / LiveEdit / Corner / PerfDisplay
@@ -1795,13 +2233,79 @@ private:
   bool mEnableTooltips = false;
   bool mShowControlBounds = false;
   bool mShowAreaDrawn = false;
+  int mMaxDirtyRects = DEFAULT_MAX_DIRTY_RECTS;
+  bool mOccluded = false;
+  double mPrevFrameTimestamp = 0.;
+  double mFrameInterval = 0.;
+  std::vector<IControl*> mDisplayListsToRecord;
+  IPlugWorkerPool mDisplayListWorkers;
+#ifdef IGRAPHICS_RENDER_THREAD
+  std::recursive_mutex mRenderMutex;
+#endif
+  float mDirtyRectCost = DEFAULT_DIRTY_RECT_COST;
   bool mResizingInProcess = false;
   bool mLayoutOnResize = false;
+  bool mResizePreviewEnabled = false;
+  bool mResizePending = false; // the preview has stood in for a resize that the controls haven't been told about
+  ILayerPtr mResizePreview; // the frame scaled while drag resizing, see EnableResizePreview()
   bool mEnableMultiTouch = false;
   EUIResizerMode mGUISizeMode = EUIResizerMode::Scale;
   double mPrevTimestamp = 0.;
+  bool mProfilingFrame = false; // the performance display is timing the current frame, see IFPSDisplayControl::kProfile
   IKeyHandlerFunc mKeyHandlerFunc = nullptr;
   IDisplayTickFunc mDisplayTickFunc = nullptr;
+
+  struct PendingLayerBitmapData
+  {
+    std::unique_ptr<RawBitmapData> pData;
+    ILayerBitmapDataFunc completion;
+  };
+
+  std::vector<PendingLayerBitmapData> mPendingLayerBitmapData; // completions of GetLayerBitmapDataAsync() to call at the start of the next frame
+
+  struct PendingSVGRaster
+  {
+    ISVG svg;
+    float width;
+    float height;
+    uint64_t key;
+  };
+
+  bool mSVGRasterCacheEnabled = false;
+  ILRUCache<ILayerPtr> mSVGRasterCache {SVG_RASTER_CACHE_SIZE}; // layers holding SVGs rasterized at a size and scale, see SVGRasterKey()
+  std::vector<PendingSVGRaster> mPendingSVGRasters;
+
+  struct SVGIcon
+  {
+    ISVG svg;
+    float width;
+    float height;
+    uint64_t key;
+    int x = 0; // the position in the atlas
+    int y = 0;
+    bool packed = false;
+  };
+
+  std::vector<SVGIcon> mSVGIcons; // the icons and sizes drawn with DrawSVGIcon()
+  ILayerPtr mSVGIconAtlas;
+  bool mSVGIconAtlasInvalid = false;
+
+  WDL_TypedBuf<float> mEnvelopeData; // the column mins and maxs of DrawDataEnvelope()
+
+  std::vector<std::pair<IText, std::string>> mPendingGlyphs; // glyphs to rasterize at the start of the next frame, see PrewarmGlyphs()
+
+  /** Call the functions that finish the bitmaps that have been decoded, and tell the instances that use them to redraw */
+  void FinishDecodedBitmaps();
+
+  /** Redraw the controls, once bitmaps that were being decoded have finished */
+  void OnBitmapsDecoded();
+
+  bool mAsyncBitmapDecoding = false;
+  bool mBitmapVariantsPending = false; // GetScaledBitmap() returned a variant standing in for one that is being decoded
+  std::atomic<bool> mBitmapsDecoded {false}; // a bitmap this instance uses has been decoded, possibly by another instance, checked by IsDirty()
+  WDL_Mutex mDecodedBitmapsMutex;
+  std::vector<std::pair<APIBitmap*, std::function<bool()>>> mDecodedBitmaps; // the bitmaps and the functions returned by their decoders, to call on the UI thread
+  IPlugTaskQueue mBitmapDecoder {2}; // declared last, so that its threads are stopped first
   IUIAppearanceChangedFunc mAppearanceChangedFunc = nullptr;
   
 protected:
@@ -1814,6 +2318,7 @@ protected:
   float mXTranslation = 0.f;
   float mYTranslation = 0.f;
   
+  friend class IControl;
   friend class IGraphicsLiveEdit;
   friend class ICornerResizerControl;
   friend class ITextEntryControl;
@@ -17,12 +17,33 @@ BEGIN_IGRAPHICS_NAMESPACE
 
 static constexpr int DEFAULT_FPS = 60;
 
+// Pass as the fps argument of IGraphics to draw at the refresh rate of the display, e.g. 120Hz on ProMotion displays
+static constexpr int DISPLAY_REFRESH_FPS = 0;
+
+// The longest frame interval reported by IGraphics::GetFrameInterval(), so that nothing jumps when the UI becomes visible again
+static constexpr double MAX_FRAME_INTERVAL = 0.1;
+
 // If not dirty for this many timer ticks, we call OnGUIIDle.
 // Only looked at if USE_IDLE_CALLS is defined.
 static constexpr int IDLE_TICKS = 20;
 
 static constexpr int DEFAULT_ANIMATION_DURATION = 100;
 
+// Above this many dirty rects in a frame, they are merged into this many with IRECTList::Coalesce(), see IGraphics::SetMaxDirtyRects()
+static constexpr int DEFAULT_MAX_DIRTY_RECTS = 16;
+// The fixed cost of drawing a dirty rect, as an area in points, used to decide when merging rects is worth the overdraw
+static constexpr float DEFAULT_DIRTY_RECT_COST = 4096.f;
+
+// The number of text layouts each IGraphics keeps between frames, see ILRUCache
+static constexpr int TEXT_LAYOUT_CACHE_SIZE = 512;
+
+// The number of rasterized SVGs each IGraphics keeps, see IGraphics::SetSVGRasterCache()
+static constexpr int SVG_RASTER_CACHE_SIZE = 64;
+
+// The width and maximum height of the atlas SVG icons are packed into, in points, and the gap between the icons, see IGraphics::DrawSVGIcon()
+static constexpr int SVG_ICON_ATLAS_SIZE = 1024;
+static constexpr int SVG_ICON_ATLAS_PADDING = 2;
+
 #ifndef CONTROL_BOUNDS_COLOR
 #define CONTROL_BOUNDS_COLOR COLOR_GREEN
 #endif
@@ -142,6 +163,9 @@ static const char* kVColorStrs[kNumVColors] =
 /** \todo */
 enum class EVShape { Rectangle, Ellipse, Triangle, EndsRounded, AllRounded };
 
+/** The curve of a value animated with IControl::AnimateValue(), see IAnimationCurve. The eased curves are those of Easing.h, Spring is a damped spring that has no fixed duration */
+enum class EAnimationCurve { Linear, QuadraticIn, QuadraticOut, QuadraticInOut, CubicIn, CubicOut, CubicInOut, SineInOut, BackOut, Spring };
+
 /** \todo */
 enum class EWinding { CW, CCW };
 
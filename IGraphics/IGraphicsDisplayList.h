@@ -0,0 +1,207 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IDisplayList
+ */
+
+#include <cstring>
+#include <vector>
+
+#include "IGraphics.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** A list of drawing commands that is recorded once and replayed into an IGraphics context, used by controls that draw with a display list, see IControl::SetUseDisplayList().
+ * Its methods mirror a subset of the IGraphics drawing API, including the path API. Recording only stores the commands and their arguments and never touches the graphics context,
+ * so lists can be recorded on worker threads, see IGraphics::SetDisplayListThreads(), then replayed by the drawing backend on the thread that draws. Clear() keeps the memory, so that recording
+ * the same control again doesn't allocate */
+class IDisplayList
+{
+public:
+  IDisplayList() = default;
+  IDisplayList(const IDisplayList&) = delete;
+  IDisplayList& operator=(const IDisplayList&) = delete;
+
+  /** Remove all the commands, keeping the memory for the next recording */
+  void Clear()
+  {
+    mCommands.clear();
+    mTexts.clear();
+    mStrings.clear();
+    mBitmaps.clear();
+    mSVGs.clear();
+    mPatterns.clear();
+    mStrokeOptions.clear();
+    mFillOptions.clear();
+  }
+
+  /** @return The number of commands in the list */
+  int Size() const { return static_cast<int>(mCommands.size()); }
+
+  void FillRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0) { Add(ECommand::FillRect, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B}); }
+  void DrawRect(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawRect, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B, thickness}); }
+  void FillRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius = 5.f, const IBlend* pBlend = 0) { Add(ECommand::FillRoundRect, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B, cornerRadius}); }
+  void DrawRoundRect(const IColor& color, const IRECT& bounds, float cornerRadius = 5.f, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawRoundRect, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B, cornerRadius, thickness}); }
+  void FillEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0) { Add(ECommand::FillEllipse, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B}); }
+  void DrawEllipse(const IColor& color, const IRECT& bounds, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawEllipse, color, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B, thickness}); }
+  void FillCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend = 0) { Add(ECommand::FillCircle, color, pBlend, {cx, cy, r}); }
+  void DrawCircle(const IColor& color, float cx, float cy, float r, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawCircle, color, pBlend, {cx, cy, r, thickness}); }
+  void FillArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend = 0) { Add(ECommand::FillArc, color, pBlend, {cx, cy, r, a1, a2}); }
+  void DrawArc(const IColor& color, float cx, float cy, float r, float a1, float a2, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawArc, color, pBlend, {cx, cy, r, a1, a2, thickness}); }
+  void FillTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend = 0) { Add(ECommand::FillTriangle, color, pBlend, {x1, y1, x2, y2, x3, y3}); }
+  void DrawTriangle(const IColor& color, float x1, float y1, float x2, float y2, float x3, float y3, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawTriangle, color, pBlend, {x1, y1, x2, y2, x3, y3, thickness}); }
+  void DrawLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawLine, color, pBlend, {x1, y1, x2, y2, thickness}); }
+  void DrawRadialLine(const IColor& color, float cx, float cy, float angle, float rMin, float rMax, const IBlend* pBlend = 0, float thickness = 1.f) { Add(ECommand::DrawRadialLine, color, pBlend, {cx, cy, angle, rMin, rMax, thickness}); }
+
+  void DrawText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Command& command = Add(ECommand::DrawText, COLOR_TRANSPARENT, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B});
+    command.resourceIdx = static_cast<int>(mTexts.size());
+    command.stringOffset = static_cast<int>(mStrings.size());
+    mTexts.push_back(text);
+    mStrings.insert(mStrings.end(), str, str + strlen(str) + 1);
+  }
+
+  void DrawBitmap(const IBitmap& bitmap, const IRECT& bounds, int srcX, int srcY, const IBlend* pBlend = 0)
+  {
+    Command& command = Add(ECommand::DrawBitmap, COLOR_TRANSPARENT, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B, static_cast<float>(srcX), static_cast<float>(srcY)});
+    command.resourceIdx = static_cast<int>(mBitmaps.size());
+    mBitmaps.push_back(bitmap);
+  }
+
+  void DrawSVG(const ISVG& svg, const IRECT& bounds, const IBlend* pBlend = 0)
+  {
+    Command& command = Add(ECommand::DrawSVG, COLOR_TRANSPARENT, pBlend, {bounds.L, bounds.T, bounds.R, bounds.B});
+    command.resourceIdx = static_cast<int>(mSVGs.size());
+    mSVGs.push_back(svg);
+  }
+
+  void PathClear() { Add(ECommand::PathClear, COLOR_TRANSPARENT, nullptr, {}); }
+  void PathClose() { Add(ECommand::PathClose, COLOR_TRANSPARENT, nullptr, {}); }
+  void PathMoveTo(float x, float y) { Add(ECommand::PathMoveTo, COLOR_TRANSPARENT, nullptr, {x, y}); }
+  void PathLineTo(float x, float y) { Add(ECommand::PathLineTo, COLOR_TRANSPARENT, nullptr, {x, y}); }
+  void PathCubicBezierTo(float c1x, float c1y, float c2x, float c2y, float x2, float y2) { Add(ECommand::PathCubicBezierTo, COLOR_TRANSPARENT, nullptr, {c1x, c1y, c2x, c2y, x2, y2}); }
+  void PathArc(float cx, float cy, float r, float a1, float a2, EWinding winding = EWinding::CW) { Add(ECommand::PathArc, COLOR_TRANSPARENT, nullptr, {cx, cy, r, a1, a2, winding == EWinding::CW ? 1.f : 0.f}); }
+
+  void PathStroke(const IPattern& pattern, float thickness, const IStrokeOptions& options = IStrokeOptions(), const IBlend* pBlend = 0)
+  {
+    Command& command = Add(ECommand::PathStroke, COLOR_TRANSPARENT, pBlend, {thickness});
+    command.resourceIdx = static_cast<int>(mPatterns.size());
+    command.stringOffset = static_cast<int>(mStrokeOptions.size());
+    mPatterns.push_back(pattern);
+    mStrokeOptions.push_back(options);
+  }
+
+  void PathFill(const IPattern& pattern, const IFillOptions& options = IFillOptions(), const IBlend* pBlend = 0)
+  {
+    Command& command = Add(ECommand::PathFill, COLOR_TRANSPARENT, pBlend, {});
+    command.resourceIdx = static_cast<int>(mPatterns.size());
+    command.stringOffset = static_cast<int>(mFillOptions.size());
+    mPatterns.push_back(pattern);
+    mFillOptions.push_back(options);
+  }
+
+  /** Draw the commands into a graphics context, call this on the thread that draws e.g. from IControl::Draw()
+   * @param g The graphics context */
+  void Replay(IGraphics& g) const
+  {
+    for (const Command& c : mCommands)
+    {
+      const float* a = c.args;
+      const IBlend* pBlend = c.hasBlend ? &c.blend : nullptr;
+
+      switch (c.type)
+      {
+        case ECommand::FillRect:          g.FillRect(c.color, IRECT(a[0], a[1], a[2], a[3]), pBlend); break;
+        case ECommand::DrawRect:          g.DrawRect(c.color, IRECT(a[0], a[1], a[2], a[3]), pBlend, a[4]); break;
+        case ECommand::FillRoundRect:     g.FillRoundRect(c.color, IRECT(a[0], a[1], a[2], a[3]), a[4], pBlend); break;
+        case ECommand::DrawRoundRect:     g.DrawRoundRect(c.color, IRECT(a[0], a[1], a[2], a[3]), a[4], pBlend, a[5]); break;
+        case ECommand::FillEllipse:       g.FillEllipse(c.color, IRECT(a[0], a[1], a[2], a[3]), pBlend); break;
+        case ECommand::DrawEllipse:       g.DrawEllipse(c.color, IRECT(a[0], a[1], a[2], a[3]), pBlend, a[4]); break;
+        case ECommand::FillCircle:        g.FillCircle(c.color, a[0], a[1], a[2], pBlend); break;
+        case ECommand::DrawCircle:        g.DrawCircle(c.color, a[0], a[1], a[2], pBlend, a[3]); break;
+        case ECommand::FillArc:           g.FillArc(c.color, a[0], a[1], a[2], a[3], a[4], pBlend); break;
+        case ECommand::DrawArc:           g.DrawArc(c.color, a[0], a[1], a[2], a[3], a[4], pBlend, a[5]); break;
+        case ECommand::FillTriangle:      g.FillTriangle(c.color, a[0], a[1], a[2], a[3], a[4], a[5], pBlend); break;
+        case ECommand::DrawTriangle:      g.DrawTriangle(c.color, a[0], a[1], a[2], a[3], a[4], a[5], pBlend, a[6]); break;
+        case ECommand::DrawLine:          g.DrawLine(c.color, a[0], a[1], a[2], a[3], pBlend, a[4]); break;
+        case ECommand::DrawRadialLine:    g.DrawRadialLine(c.color, a[0], a[1], a[2], a[3], a[4], pBlend, a[5]); break;
+        case ECommand::DrawText:          g.DrawText(mTexts[c.resourceIdx], mStrings.data() + c.stringOffset, IRECT(a[0], a[1], a[2], a[3]), pBlend); break;
+        case ECommand::DrawBitmap:        g.DrawBitmap(mBitmaps[c.resourceIdx], IRECT(a[0], a[1], a[2], a[3]), static_cast<int>(a[4]), static_cast<int>(a[5]), pBlend); break;
+        case ECommand::DrawSVG:           g.DrawSVG(mSVGs[c.resourceIdx], IRECT(a[0], a[1], a[2], a[3]), pBlend); break;
+        case ECommand::PathClear:         g.PathClear(); break;
+        case ECommand::PathClose:         g.PathClose(); break;
+        case ECommand::PathMoveTo:        g.PathMoveTo(a[0], a[1]); break;
+        case ECommand::PathLineTo:        g.PathLineTo(a[0], a[1]); break;
+        case ECommand::PathCubicBezierTo: g.PathCubicBezierTo(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+        case ECommand::PathArc:           g.PathArc(a[0], a[1], a[2], a[3], a[4], a[5] > 0.f ? EWinding::CW : EWinding::CCW); break;
+        case ECommand::PathStroke:        g.PathStroke(mPatterns[c.resourceIdx], a[0], mStrokeOptions[c.stringOffset], pBlend); break;
+        case ECommand::PathFill:          g.PathFill(mPatterns[c.resourceIdx], mFillOptions[c.stringOffset], pBlend); break;
+      }
+    }
+  }
+
+private:
+  enum class ECommand
+  {
+    FillRect, DrawRect, FillRoundRect, DrawRoundRect, FillEllipse, DrawEllipse, FillCircle, DrawCircle, FillArc, DrawArc,
+    FillTriangle, DrawTriangle, DrawLine, DrawRadialLine, DrawText, DrawBitmap, DrawSVG,
+    PathClear, PathClose, PathMoveTo, PathLineTo, PathCubicBezierTo, PathArc, PathStroke, PathFill
+  };
+
+  static constexpr int kMaxArgs = 7;
+
+  struct Command
+  {
+    ECommand type;
+    IColor color;
+    IBlend blend;
+    bool hasBlend;
+    float args[kMaxArgs];
+    int resourceIdx; // the index of the text, bitmap, svg or pattern
+    int stringOffset; // the offset of the string, or the index of the stroke or fill options
+  };
+
+  Command& Add(ECommand type, const IColor& color, const IBlend* pBlend, std::initializer_list<float> args)
+  {
+    assert(args.size() <= kMaxArgs);
+
+    mCommands.emplace_back();
+    Command& command = mCommands.back();
+    command.type = type;
+    command.color = color;
+    command.hasBlend = pBlend != nullptr;
+
+    if (pBlend)
+      command.blend = *pBlend;
+
+    std::copy(args.begin(), args.end(), command.args);
+    command.resourceIdx = 0;
+    command.stringOffset = 0;
+    return command;
+  }
+
+  std::vector<Command> mCommands;
+  std::vector<IText> mTexts;
+  std::vector<char> mStrings;
+  std::vector<IBitmap> mBitmaps;
+  std::vector<ISVG> mSVGs;
+  std::vector<IPattern> mPatterns;
+  std::vector<IStrokeOptions> mStrokeOptions;
+  std::vector<IFillOptions> mFillOptions;
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
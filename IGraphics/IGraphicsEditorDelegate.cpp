@@ -26,15 +26,24 @@ IGEditorDelegate::~IGEditorDelegate()
 
 void* IGEditorDelegate::OpenWindow(void* pParent)
 {
+  // timed until the first frame has been drawn, see IPlugStartupTimeline
+  GetStartupTimeline().BeginEditorOpen();
+  // the graphics context and the bitmaps loaded by the layout are counted for this instance, see IPlugMemoryAccounting.h
+  IPlugMemoryAccount::ScopedCurrent memoryAccount(GetMemoryAccount());
+
   if(!mGraphics)
   {
+    IPlugStartupTimeline::ScopedPhase phase(GetStartupTimeline(), IPlugStartupTimeline::kCreateGraphics);
     mGraphics = std::unique_ptr<IGraphics>(CreateGraphics());
     if (mLastWidth && mLastHeight && mLastScale)
       GetUI()->Resize(mLastWidth, mLastHeight, mLastScale);
   }
   
   if(mGraphics)
+  {
+    OnEditorOpenChanged(true);
     return mGraphics->OpenWindow(pParent);
+  }
   else
     return nullptr;
 }
@@ -59,10 +68,33 @@ void IGEditorDelegate::CloseWindow()
   }
 }
 
+int IGEditorDelegate::GetEditorPollFDs(int* pFDs, int maxFDs)
+{
+  return mGraphics ? mGraphics->GetPollFDs(pFDs, maxFDs) : 0;
+}
+
+void IGEditorDelegate::OnEditorPollFD(int fd)
+{
+  if (mGraphics)
+    mGraphics->OnPollFD(fd);
+}
+
 void IGEditorDelegate::SetScreenScale(float scale)
 {
   if (GetUI())
+  {
+    IGRAPHICS_RENDER_LOCK(mGraphics);
     mGraphics->SetScreenScale(scale);
+  }
+}
+
+void IGEditorDelegate::OnMemoryWarning()
+{
+  if (GetUI())
+  {
+    IGRAPHICS_RENDER_LOCK(mGraphics);
+    mGraphics->OnMemoryWarning();
+  }
 }
 
 void IGEditorDelegate::SendControlValueFromDelegate(int ctrlTag, double normalizedValue)
@@ -70,6 +102,7 @@ void IGEditorDelegate::SendControlValueFromDelegate(int ctrlTag, double normaliz
   if(!mGraphics)
     return;
 
+  IGRAPHICS_RENDER_LOCK(mGraphics);
   IControl* pControl = mGraphics->GetControlWithTag(ctrlTag);
   
   assert(pControl);
@@ -85,6 +118,7 @@ void IGEditorDelegate::SendControlMsgFromDelegate(int ctrlTag, int msgTag, int d
   if(!mGraphics)
     return;
   
+  IGRAPHICS_RENDER_LOCK(mGraphics);
   IControl* pControl = mGraphics->GetControlWithTag(ctrlTag);
   
   assert(pControl);
@@ -99,6 +133,8 @@ void IGEditorDelegate::SendParameterValueFromDelegate(int paramIdx, double value
 {
   if(mGraphics)
   {
+    IGRAPHICS_RENDER_LOCK(mGraphics);
+
     if (!normalized)
       value = GetParam(paramIdx)->ToNormalized(value);
 
@@ -127,6 +163,8 @@ void IGEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
 {
   if(mGraphics)
   {
+    IGRAPHICS_RENDER_LOCK(mGraphics);
+
     for (auto c = 0; c < mGraphics->NControls(); c++) // TODO: could keep a map
     {
       IControl* pControl = mGraphics->GetControl(c);
@@ -40,7 +40,10 @@ public:
   //IEditorDelegate
   void* OpenWindow(void* pHandle) final;
   void CloseWindow() final;
+  int GetEditorPollFDs(int* pFDs, int maxFDs) override;
+  void OnEditorPollFD(int fd) override;
   void SetScreenScale(float scale) final;
+  void OnMemoryWarning() override;
   
   bool OnKeyDown(const IKeyPress& key) override;
   bool OnKeyUp(const IKeyPress& key) override;
@@ -37,6 +37,7 @@ public:
   , mGridSize(10)
   {
     mTargetRECT = mRECT;
+    SetPollDirty(true);
   }
   
   ~IGraphicsLiveEdit()
@@ -188,6 +188,16 @@ public:
     return AddItem(pItem, index);
   }
   
+  /** Move the items of another menu to the end of this one, e.g. from a menu that was built on another thread
+   * @param other The menu to take the items from, which is left empty */
+  void TakeItems(IPopupMenu& other)
+  {
+    for (int i = 0; i < other.NItems(); i++)
+      mMenuItems.Add(other.mMenuItems.Get(i));
+    
+    other.mMenuItems.Empty(false);
+  }
+  
   void RemoveEmptySubmenus()
   {
     int n = mMenuItems.GetSize();
@@ -15,9 +15,13 @@
  * @{
  */
 
+#include <algorithm>
 #include <codecvt>
 #include <string>
 #include <memory>
+#include <functional>
+#include <type_traits>
+#include <vector>
 
 #include "mutex.h"
 #include "wdlstring.h"
@@ -25,6 +29,9 @@
 #include "ptrlist.h"
 #include "heapbuf.h"
 
+#include "IPlugMappedResource.h"
+#include "IPlugMemoryAccounting.h"
+
 #if defined IGRAPHICS_SKIA && !defined IGRAPHICS_NO_SKIA_SVG
 #define SVG_USE_SKIA
 #endif
@@ -35,6 +42,8 @@
   #pragma warning( disable : 5030 )
   #include "SkSVGDOM.h"
   #include "include/core/SkCanvas.h"
+  #include "include/core/SkPicture.h"
+  #include "include/core/SkPictureRecorder.h"
   #include "include/core/SkStream.h"
   #include "src/xml/SkDOM.h"
   #pragma warning( pop )
@@ -75,6 +84,8 @@
   #define FONT_DESCRIPTOR_TYPE HFONT
 #elif defined OS_WEB
   #define FONT_DESCRIPTOR_TYPE std::pair<WDL_String, WDL_String>*
+#elif defined OS_LINUX
+  #define FONT_DESCRIPTOR_TYPE const char* // the path of the font file, found with fontconfig for system fonts
 #else 
   // NO_IGRAPHICS
 #endif
@@ -84,6 +95,7 @@ BEGIN_IGRAPHICS_NAMESPACE
 using BitmapData = BITMAP_DATA_TYPE;
 using FontDescriptor = FONT_DESCRIPTOR_TYPE;
 using RawBitmapData = WDL_TypedBuf<uint8_t>;
+using ILayerBitmapDataFunc = std::function<void(const RawBitmapData& data)>;
 
 /** A base class interface for a bitmap abstraction around the different drawing back end bitmap representations.
  * In most cases it does own the bitmap data, the exception being with NanoVG, where the image is loaded onto the GPU as a texture,
@@ -104,7 +116,9 @@ public:
   , mHeight(h)
   , mScale(scale)
   , mDrawScale(drawScale)
-  {}
+  {
+    mMemoryCharge.Set(static_cast<size_t>(w) * h * 4);
+  }
 
   APIBitmap()
   : mBitmap(0)
@@ -132,6 +146,7 @@ public:
     mHeight = h;
     mScale = scale;
     mDrawScale = drawScale;
+    mMemoryCharge.Set(static_cast<size_t>(w) * h * 4);
   }
 
   /** @return BitmapData Get the Bitmap data linked to this APIBitmap */
@@ -148,6 +163,21 @@ public:
   
   /** @return the draw scale of the bitmap */
   float GetDrawScale() const { return mDrawScale; }
+  
+  /** @return \c false while the bitmap is being decoded in the background, see IGraphics::SetAsyncBitmapDecoding(). Its size is known, but drawing it draws nothing */
+  bool IsLoaded() const { return mLoaded; }
+  
+  /** Called by the drawing backends on the UI thread when a bitmap starts or finishes decoding in the background */
+  void SetLoaded(bool loaded) { mLoaded = loaded; }
+
+  /** @return \c true if decoding the bitmap in the background failed, in which case the next IGraphics::LoadBitmap() that finds it decodes it again */
+  bool DecodeFailed() const { return mDecodeFailed; }
+
+  /** Called by IGraphics on the UI thread when a bitmap has finished decoding in the background */
+  void SetDecodeFailed(bool failed) { mDecodeFailed = failed; }
+
+  /** Count the memory of the bitmap for another subsystem, called by ILayer. See IPlugMemoryAccounting.h */
+  void SetMemorySubsystem(EMemorySubsystem subsystem) { mMemoryCharge.SetSubsystem(subsystem); }
 
 private:
   BitmapData mBitmap; // for most drawing APIs BitmapData is a pointer. For Nanovg it is an integer index
@@ -155,8 +185,24 @@ private:
   int mHeight;
   float mScale;
   float mDrawScale;
+  bool mLoaded = true;
+  bool mDecodeFailed = false;
+  IPlugMemoryCharge mMemoryCharge {EMemorySubsystem::kBitmaps}; // 4 bytes per pixel
+};
+
+/** A base class for a fragment shader compiled by a drawing backend, see IGraphics::CreateShader() */
+class APIShader
+{
+public:
+  APIShader() {}
+  virtual ~APIShader() {}
+
+  APIShader(const APIShader&) = delete;
+  APIShader& operator=(const APIShader&) = delete;
 };
 
+using IShaderPtr = std::unique_ptr<APIShader>;
+
 /** Used to retrieve font info directly from a raw memory buffer. */
 class IFontInfo
 {
@@ -391,20 +437,35 @@ public:
     Resize(size);
   }
   
+  /** Read the font data in place without copying it, e.g. from a memory mapped file or a Windows resource
+   * @param resource The resource, which is shared with the PlatformFont it came from */
+  IFontData(std::shared_ptr<const IPlugMappedResource> resource, int faceIdx)
+  : IFontInfo(resource->Get(), static_cast<uint32_t>(resource->GetSize()), faceIdx)
+  , mFaceIdx(faceIdx)
+  , mResource(std::move(resource))
+  {
+  }
+  
   void SetFaceIdx(int faceIdx)
   {
     mFaceIdx = faceIdx;
-    static_cast<IFontData&>(*this) = IFontData(Get(), GetSize(), mFaceIdx);
+    
+    if (mResource)
+      static_cast<IFontInfo&>(*this) = IFontInfo(Get(), GetSize(), mFaceIdx);
+    else
+      static_cast<IFontData&>(*this) = IFontData(Get(), GetSize(), mFaceIdx);
   }
   
   bool IsValid() const { return GetSize() && mFaceIdx >= 0 && IFontInfo::IsValid(); }
   
-  unsigned char* Get() { return WDL_TypedBuf<unsigned char>::Get(); }
-  int GetSize() const { return WDL_TypedBuf<unsigned char>::GetSize(); }
+  /** @return The font data. Data that is read in place is read only, but the drawing backends take a non const pointer */
+  unsigned char* Get() { return mResource ? const_cast<unsigned char*>(mResource->Get()) : WDL_TypedBuf<unsigned char>::Get(); }
+  int GetSize() const { return mResource ? static_cast<int>(mResource->GetSize()) : WDL_TypedBuf<unsigned char>::GetSize(); }
   int GetFaceIdx() const { return mFaceIdx; }
   
 private:
   int mFaceIdx;
+  std::shared_ptr<const IPlugMappedResource> mResource;
 };
 
 /** IFontDataPtr is a managed pointer for transferring the ownership of font data */
@@ -449,20 +510,30 @@ using PlatformFontPtr = std::unique_ptr<PlatformFont>;
 #ifdef SVG_USE_SKIA
 struct SVGHolder
 {
+  /** @param svgDom The SVG, which must have its container size set. It is recorded into an SkPicture, so drawing it doesn't walk the DOM each time */
   SVGHolder(sk_sp<SkSVGDOM> svgDom)
   : mSVGDom(svgDom)
   {
+    SkPictureRecorder recorder;
+    const SkSize size = mSVGDom->containerSize();
+    mSVGDom->render(recorder.beginRecording(SkRect::MakeWH(size.width(), size.height())));
+    mPicture = recorder.finishRecordingAsPicture();
   }
   
   ~SVGHolder()
   {
+    mPicture = nullptr;
     mSVGDom = nullptr;
   }
   
   SVGHolder(const SVGHolder&) = delete;
   SVGHolder& operator=(const SVGHolder&) = delete;
   
+  /** @return An estimate of the memory used by the SVG, for the budget of the SVG cache. The DOM isn't counted */
+  size_t GetBytes() const { return sizeof(*this) + (mPicture ? mPicture->approximateBytesUsed() : 0); }
+  
   sk_sp<SkSVGDOM> mSVGDom;
+  sk_sp<SkPicture> mPicture;
 };
 #else
 /** Used internally to manage SVG data*/
@@ -484,11 +555,43 @@ struct SVGHolder
   SVGHolder(const SVGHolder&) = delete;
   SVGHolder& operator=(const SVGHolder&) = delete;
   
+  /** @return An estimate of the memory used by the parsed SVG, for the budget of the SVG cache */
+  size_t GetBytes() const
+  {
+    size_t bytes = sizeof(*this) + sizeof(NSVGimage);
+    
+    for (NSVGshape* pShape = mImage ? mImage->shapes : nullptr; pShape; pShape = pShape->next)
+    {
+      bytes += sizeof(NSVGshape);
+      
+      for (NSVGpath* pPath = pShape->paths; pPath; pPath = pPath->next)
+        bytes += sizeof(NSVGpath) + pPath->npts * 2 * sizeof(float);
+    }
+    
+    return bytes;
+  }
+  
   NSVGimage* mImage = nullptr;
 };
 #endif
 
-/** Used internally to store data statically, making sure memory is not wasted when there are multiple plug-in instances loaded */
+/** The counters of a StaticStorage, see StaticStorage::Accessor::GetStats() */
+struct StaticStorageStats
+{
+  int count = 0; // the number of entries
+  size_t bytes = 0; // the memory of the entries, as given to StaticStorage::Accessor::Add()
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  
+  /** @return The fraction of look ups that found an entry */
+  double HitRate() const { return (hits + misses) ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.; }
+};
+
+/** Used internally to store data statically, making sure memory is not wasted when there are multiple plug-in instances loaded.
+ * An accessor can be created with an owner, e.g. an IGraphics instance, which is recorded against the entries it finds or adds until it calls Release().
+ * With a memory budget, see SetBudget(), entries that no remaining owner uses are evicted, least recently used first, while the storage is over budget.
+ * Entries that were only ever used without an owner are never evicted, and everything is deleted when the last Retain() is released */
 template <class T>
 class StaticStorage
 {
@@ -497,20 +600,27 @@ public:
   class Accessor : private WDL_MutexLock
   {
   public:
-    Accessor(StaticStorage& storage) 
+    /** @param pOwner An optional owner of the entries found or added through this accessor, which must pass the same owner when it calls Release() */
+    Accessor(StaticStorage& storage, const void* pOwner = nullptr)
     : WDL_MutexLock(&storage.mMutex)
-    , mStorage(storage) 
+    , mStorage(storage)
+    , mOwner(pOwner)
     {}
     
-    T* Find(const char* str, double scale = 1.)               { return mStorage.Find(str, scale); }
-    void Add(T* pData, const char* str, double scale = 1.)    { return mStorage.Add(pData, str, scale); }
-    void Remove(T* pData)                                     { return mStorage.Remove(pData); }
-    void Clear()                                              { return mStorage.Clear(); }
-    void Retain()                                             { return mStorage.Retain(); }
-    void Release()                                            { return mStorage.Release(); }
+    T* Find(const char* str, double scale = 1.)                               { return mStorage.Find(str, scale, mOwner); }
+    void Add(T* pData, const char* str, double scale = 1., size_t bytes = 0)  { return mStorage.Add(pData, str, scale, bytes, mOwner); }
+    void Remove(T* pData)                                                     { return mStorage.Remove(pData); }
+    void Clear()                                                              { return mStorage.Clear(); }
+    void Retain()                                                             { return mStorage.Retain(); }
+    void Release()                                                            { return mStorage.Release(mOwner); }
+    void SetBudget(size_t bytes)                                              { return mStorage.SetBudget(bytes); }
+    void Purge()                                                              { return mStorage.Purge(); }
+    StaticStorageStats GetStats() const                                       { return mStorage.GetStats(); }
+    template <class Func> void ForEachOwner(const T* pData, Func&& func)      { return mStorage.ForEachOwner(pData, func); }
       
   private:
     StaticStorage& mStorage;
+    const void* mOwner;
   };
   
   StaticStorage() {}
@@ -532,6 +642,10 @@ private:
     WDL_String name;
     double scale;
     std::unique_ptr<T> data;
+    size_t bytes = 0;
+    uint64_t lastUse = 0;
+    bool owned = false; // it has had an owner, so it can be evicted when it has none
+    std::vector<const void*> owners;
   };
   
   /** \todo 
@@ -547,7 +661,7 @@ private:
    * @param str \todo
    * @param scale \todo
    * @return T* \todo */
-  T* Find(const char* str, double scale = 1.)
+  T* Find(const char* str, double scale = 1., const void* pOwner = nullptr)
   {
     WDL_String cacheName(str);
     cacheName.AppendFormatted((int) strlen(str) + 6, "-%.1fx", scale);
@@ -561,16 +675,23 @@ private:
 
       // Use the hash id for a quick search and then confirm with the scale and identifier to ensure uniqueness
       if (pKey->hashID == hashID && scale == pKey->scale && !strcmp(str, pKey->name.Get()))
+      {
+        mStats.hits++;
+        Use(pKey, pOwner);
         return pKey->data.get();
+      }
     }
+    
+    mStats.misses++;
     return nullptr;
   }
 
   /** \todo 
    * @param pData \todo
    * @param str \todo
-   * @param scale \todo scale where 2x = retina, omit if not needed */
-  void Add(T* pData, const char* str, double scale = 1.)
+   * @param scale \todo scale where 2x = retina, omit if not needed
+   * @param bytes The memory used by the data, which counts towards the budget */
+  void Add(T* pData, const char* str, double scale = 1., size_t bytes = 0, const void* pOwner = nullptr)
   {
     DataKey* pKey = mDatas.Add(new DataKey);
 
@@ -581,6 +702,12 @@ private:
     pKey->data = std::unique_ptr<T>(pData);
     pKey->scale = scale;
     pKey->name.Set(str);
+    pKey->bytes = bytes;
+    mStats.bytes += bytes;
+    UpdateMemoryCharge();
+    Use(pKey, pOwner);
+    
+    Trim();
 
     //DBGMSG("adding %s to the static storage at %.1fx the original scale\n", str, scale);
   }
@@ -592,7 +719,7 @@ private:
     {
       if (mDatas.Get(i)->data.get() == pData)
       {
-        mDatas.Delete(i, true);
+        Delete(i);
         break;
       }
     }
@@ -602,6 +729,8 @@ private:
   void Clear()
   {
     mDatas.Empty(true);
+    mStats.bytes = 0;
+    UpdateMemoryCharge();
   };
 
   /** \todo  */
@@ -610,16 +739,134 @@ private:
     mCount++;
   }
   
-  /** \todo  */
-  void Release()
+  /** Release a reference to the storage, which deletes everything when it is the last one
+   * @param pOwner The owner that was given to the accessors, whose entries may then be evicted */
+  void Release(const void* pOwner = nullptr)
   {
     if (--mCount == 0)
+    {
       Clear();
+      return;
+    }
+    
+    if (pOwner)
+    {
+      for (int i = 0; i < mDatas.GetSize(); ++i)
+      {
+        auto& owners = mDatas.Get(i)->owners;
+        owners.erase(std::remove(owners.begin(), owners.end(), pOwner), owners.end());
+      }
+      
+      Trim();
+    }
+  }
+  
+  /** @param bytes The memory at which entries without owners are evicted, or 0 to keep everything */
+  void SetBudget(size_t bytes)
+  {
+    mBudget = bytes;
+    Trim();
+  }
+  
+  /** Evict every entry that has had owners and has none now, whatever the budget, e.g. when the OS is low on memory. They are loaded again when next used */
+  void Purge()
+  {
+    for (int i = mDatas.GetSize() - 1; i >= 0; --i)
+    {
+      const DataKey* pKey = mDatas.Get(i);
+
+      if (pKey->owned && pKey->owners.empty())
+      {
+        Delete(i);
+        mStats.evictions++;
+      }
+    }
+  }
+
+  /** Call a function with each owner that uses an entry
+   * @param pData The entry
+   * @param func A function taking a const void* owner */
+  template <class Func>
+  void ForEachOwner(const T* pData, Func&& func)
+  {
+    for (int i = 0; i < mDatas.GetSize(); ++i)
+    {
+      const DataKey* pKey = mDatas.Get(i);
+
+      if (pKey->data.get() == pData)
+      {
+        for (const void* pOwner : pKey->owners)
+          func(pOwner);
+
+        return;
+      }
+    }
+  }
+
+  StaticStorageStats GetStats() const
+  {
+    StaticStorageStats stats = mStats;
+    stats.count = mDatas.GetSize();
+    return stats;
+  }
+  
+  void Use(DataKey* pKey, const void* pOwner)
+  {
+    pKey->lastUse = ++mUseCounter;
+    
+    if (pOwner)
+    {
+      pKey->owned = true;
+      
+      if (std::find(pKey->owners.begin(), pKey->owners.end(), pOwner) == pKey->owners.end())
+        pKey->owners.push_back(pOwner);
+    }
+  }
+  
+  void Delete(int idx)
+  {
+    mStats.bytes -= mDatas.Get(idx)->bytes;
+    mDatas.Delete(idx, true);
+    UpdateMemoryCharge();
+  }
+
+  /** APIBitmaps count their own memory, see IPlugMemoryAccounting.h */
+  void UpdateMemoryCharge()
+  {
+    if (!std::is_base_of<APIBitmap, T>::value)
+      mMemoryCharge.Set(mStats.bytes);
+  }
+  
+  /** Evict the least recently used entries that have no owners until the storage is within budget */
+  void Trim()
+  {
+    while (mBudget && mStats.bytes > mBudget)
+    {
+      int lru = -1;
+      
+      for (int i = 0; i < mDatas.GetSize(); ++i)
+      {
+        const DataKey* pKey = mDatas.Get(i);
+        
+        if (pKey->owned && pKey->owners.empty() && (lru < 0 || pKey->lastUse < mDatas.Get(lru)->lastUse))
+          lru = i;
+      }
+      
+      if (lru < 0)
+        break;
+      
+      Delete(lru);
+      mStats.evictions++;
+    }
   }
     
   int mCount = 0;
   WDL_Mutex mMutex;
   WDL_PtrList<DataKey> mDatas;
+  size_t mBudget = 0;
+  uint64_t mUseCounter = 0;
+  StaticStorageStats mStats;
+  IPlugMemoryCharge mMemoryCharge {EMemorySubsystem::kStaticStorage, false}; // shared by all instances
 };
 
 /** Encapsulate an xy point in one struct */
@@ -19,6 +19,7 @@
 #include <functional>
 #include <chrono>
 #include <numeric>
+#include <algorithm>
 
 #include "IPlugUtilities.h"
 #include "IPlugLogger.h"
@@ -142,6 +143,9 @@ public:
   
   /** @return \true if the bitmap has valid data */
   inline bool IsValid() const { return mAPIBitmap != nullptr; }
+  
+  /** @return \c true if the bitmap is valid and has finished decoding, see IGraphics::SetAsyncBitmapDecoding() */
+  inline bool IsLoaded() const { return mAPIBitmap && mAPIBitmap->IsLoaded(); }
 
 private:
   /** Pointer to the API specific bitmap */
@@ -164,8 +168,9 @@ private:
 #ifdef SVG_USE_SKIA
 struct ISVG
 {
-  ISVG(sk_sp<SkSVGDOM> svgDom)
+  ISVG(sk_sp<SkSVGDOM> svgDom, sk_sp<SkPicture> picture = nullptr)
   : mSVGDom(svgDom)
+  , mPicture(picture)
   {
   }
   
@@ -187,6 +192,7 @@ struct ISVG
   inline bool IsValid() const { return mSVGDom != nullptr; }
   
   sk_sp<SkSVGDOM> mSVGDom;
+  sk_sp<SkPicture> mPicture; // the SVG recorded at load time, which is replayed instead of rendering the DOM
 };
 #else
 struct ISVG
@@ -229,8 +235,8 @@ struct IColor
    * @param b Blue value (valid range 0-255) */
   IColor(int a = 255, int r = 0, int g = 0, int b = 0) : A(a), R(r), G(g), B(b) {}
 
-  bool operator==(const IColor& rhs) { return (rhs.A == A && rhs.R == R && rhs.G == G && rhs.B == B); }
-  bool operator!=(const IColor& rhs) { return !operator==(rhs); }
+  bool operator==(const IColor& rhs) const { return (rhs.A == A && rhs.R == R && rhs.G == G && rhs.B == B); }
+  bool operator!=(const IColor& rhs) const { return !operator==(rhs); }
   
   /** Set the color parts 
    * @param a Alpha value (valid range 0-255)
@@ -461,7 +467,7 @@ struct IColor
     };
 
     IColor col;
-    h = std::fmodf(h, 1.0f);
+    h = std::fmod(h, 1.0f);
     if (h < 0.0f) h += 1.0f;
     s = Clip(s, 0.0f, 1.0f);
     l = Clip(l, 0.0f, 1.0f);
@@ -570,6 +576,36 @@ const IBlend BLEND_01 = IBlend(EBlend::Default, 0.01f);
 const IBlend BLEND_DST_IN = IBlend(EBlend::DstIn, 1.f);
 const IBlend BLEND_DST_OVER = IBlend(EBlend::DstOver, 1.f);
 
+/** How a value animated with IControl::AnimateValue() moves to its target */
+struct IAnimationCurve
+{
+  EAnimationCurve mType;
+  float mDuration; // in milliseconds, not used by a spring
+  float mStiffness; // of a spring, in 1/s^2
+  float mDamping; // of a spring, in 1/s
+
+  /** Creates a new IAnimationCurve
+   * @param type The shape of the curve
+   * @param durationMs The duration of an eased curve in milliseconds */
+  IAnimationCurve(EAnimationCurve type = EAnimationCurve::QuadraticOut, float durationMs = 150.f)
+  : mType(type)
+  , mDuration(durationMs)
+  , mStiffness(300.f)
+  , mDamping(30.f)
+  {}
+
+  /** A spring, which keeps its velocity if the target changes before it comes to rest, e.g. when the mouse leaves a control it entered a moment ago
+   * @param stiffness How strongly the value is pulled to the target
+   * @param damping How quickly the motion dies down. Springs are critically damped when damping = 2 * sqrt(stiffness), and overshoot with less damping */
+  static IAnimationCurve Spring(float stiffness = 300.f, float damping = 30.f)
+  {
+    IAnimationCurve curve(EAnimationCurve::Spring, 0.f);
+    curve.mStiffness = stiffness;
+    curve.mDamping = damping;
+    return curve;
+  }
+};
+
 /** Used to manage fill behaviour */
 struct IFillOptions
 {
@@ -1937,8 +1973,119 @@ public:
       }
     }
   }
+
+  /** Merge the rectangles into at most maxRects disjoint bounding rectangles. Unlike Optimize(), which is O(n^2) and keeps the exact area,
+   * this draws some area that isn't dirty in exchange for fewer regions, which is cheaper when there are many small rects e.g. hundreds of meters.
+   * The rects are swept from top to bottom and each one is merged into the existing output rect that adds the least overdraw, if that is less than rectCost.
+   * @param maxRects The maximum number of rects to leave in the list
+   * @param rectCost The cost of drawing one more rect, as an area in the same units as the rects */
+  void Coalesce(int maxRects, float rectCost)
+  {
+    const int n = Size();
+
+    if (n < 2)
+      return;
+
+    maxRects = std::max(maxRects, 1);
+
+    IRECT* pRects = mRects.Get();
+
+    std::sort(pRects, pRects + n, [](const IRECT& a, const IRECT& b) {
+      return a.T < b.T || (a.T == b.T && a.L < b.L);
+    });
+
+    // the output is written to the front of the buffer, which the sweep has already passed
+    int nOut = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+      const IRECT r = pRects[i];
+
+      if (r.Empty())
+        continue;
+
+      int best = -1;
+      float bestCost = rectCost;
+
+      for (int j = 0; j < nOut; j++)
+      {
+        const float cost = MergeCost(pRects[j], r);
+
+        if (cost < bestCost)
+        {
+          best = j;
+          bestCost = cost;
+        }
+      }
+
+      if (best > -1)
+        pRects[best] = pRects[best].Union(r);
+      else
+        pRects[nOut++] = r;
+
+      // keeps the search above bounded
+      if (nOut >= 2 * maxRects)
+        nOut = Reduce(pRects, nOut, maxRects);
+    }
+
+    mRects.Resize(Reduce(pRects, nOut, maxRects));
+  }
   
 private:
+  /** @return The area that drawing the union of a and b draws, in addition to drawing them separately. It is negative if they overlap enough */
+  static float MergeCost(const IRECT& a, const IRECT& b)
+  {
+    return a.Union(b).Area() - a.Area() - b.Area();
+  }
+
+  /** @return \c true if a and b share some area, rather than just an edge */
+  static bool Overlaps(const IRECT& a, const IRECT& b)
+  {
+    return a.L < b.R && b.L < a.R && a.T < b.B && b.T < a.B;
+  }
+
+  /** Merge the cheapest pairs of rects until there are at most maxRects, and then merge any that overlap, so that no area is drawn twice
+   * @return The new number of rects */
+  static int Reduce(IRECT* pRects, int n, int maxRects)
+  {
+    for (;;)
+    {
+      int bestI = -1;
+      int bestJ = -1;
+      bool overlap = false;
+      float bestCost = 0.f;
+
+      for (int i = 0; i < n && !overlap; i++)
+      {
+        for (int j = i + 1; j < n; j++)
+        {
+          if (Overlaps(pRects[i], pRects[j]))
+          {
+            bestI = i;
+            bestJ = j;
+            overlap = true;
+            break;
+          }
+
+          const float cost = MergeCost(pRects[i], pRects[j]);
+
+          if (bestI < 0 || cost < bestCost)
+          {
+            bestI = i;
+            bestJ = j;
+            bestCost = cost;
+          }
+        }
+      }
+
+      if (bestI < 0 || (!overlap && n <= maxRects))
+        return n;
+
+      pRects[bestI] = pRects[bestI].Union(pRects[bestJ]);
+      pRects[bestJ] = pRects[--n];
+    }
+  }
+
   /** \todo 
    * @param r \todo
    * @param i \todo
@@ -2336,7 +2483,10 @@ public:
   , mControlRECT(controlRect)
   , mRECT(layerRect)
   , mInvalid(false)
-  {}
+  {
+    if (mBitmap)
+      mBitmap->SetMemorySubsystem(EMemorySubsystem::kLayers);
+  }
 
   ILayer(const ILayer&) = delete;
   ILayer operator=(const ILayer&) = delete;
@@ -12,7 +12,13 @@
 #include "IPlugConstants.h"
 #include "IGraphicsConstants.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
@@ -31,6 +37,181 @@ static double GetTimestamp()
   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
+/** A cache of values keyed by a 64 bit hash, which discards the least recently used value when it is full, e.g. the text layouts of the drawing backends */
+template <typename T>
+class ILRUCache
+{
+public:
+  /** @param capacity The maximum number of values */
+  ILRUCache(int capacity)
+  : mCapacity(capacity)
+  {
+  }
+
+  /** @return The value for key, which becomes the most recently used, or nullptr if it is not in the cache */
+  T* Find(uint64_t key)
+  {
+    auto it = mMap.find(key);
+
+    if (it == mMap.end())
+      return nullptr;
+
+    mList.splice(mList.begin(), mList, it->second);
+    return &it->second->second;
+  }
+
+  /** Add or replace the value for key, discarding the least recently used value if the cache is full
+   * @return The value in the cache */
+  T& Add(uint64_t key, T&& value)
+  {
+    auto it = mMap.find(key);
+
+    if (it != mMap.end())
+    {
+      mList.splice(mList.begin(), mList, it->second);
+      it->second->second = std::move(value);
+      return it->second->second;
+    }
+
+    if (static_cast<int>(mList.size()) >= mCapacity)
+    {
+      mMap.erase(mList.back().first);
+      mList.pop_back();
+    }
+
+    mList.emplace_front(key, std::move(value));
+    mMap[key] = mList.begin();
+    return mList.front().second;
+  }
+
+  /** Remove all values, e.g. when the fonts or the draw scale change */
+  void Clear()
+  {
+    mMap.clear();
+    mList.clear();
+  }
+
+private:
+  using Entry = std::pair<uint64_t, T>;
+
+  int mCapacity;
+  std::list<Entry> mList; // most recently used first
+  std::unordered_map<uint64_t, typename std::list<Entry>::iterator> mMap;
+};
+
+/** A multi-resolution min/max summary of a long buffer, e.g. a recording, so that a waveform overview can be drawn at any zoom by reading a few values
+ * per pixel column rather than every sample. Each level holds the min and max of blocks twice the size of those of the level below, see IGraphics::DrawMinMaxData() */
+class IPeakPyramid
+{
+public:
+  /** The number of points summarized by each value of the finest level */
+  static constexpr int kBlockSize = 16;
+
+  /** Summarize a buffer, which must be passed again to GetColumns()
+   * @param pData The points
+   * @param nPoints The number of points */
+  void Build(const float* pData, int nPoints)
+  {
+    mLevels.clear();
+    mNPoints = nPoints;
+    
+    for (int blockSize = kBlockSize; nPoints / blockSize >= 2; blockSize *= 2)
+    {
+      const int nBlocks = nPoints / blockSize;
+      Level level { std::vector<float>(nBlocks), std::vector<float>(nBlocks), blockSize };
+      
+      for (int b = 0; b < nBlocks; b++)
+      {
+        if (mLevels.empty())
+        {
+          const auto range = std::minmax_element(pData + b * blockSize, pData + (b + 1) * blockSize);
+          level.mins[b] = *range.first;
+          level.maxs[b] = *range.second;
+        }
+        else
+        {
+          const Level& finer = mLevels.back();
+          level.mins[b] = std::min(finer.mins[2 * b], finer.mins[2 * b + 1]);
+          level.maxs[b] = std::max(finer.maxs[2 * b], finer.maxs[2 * b + 1]);
+        }
+      }
+      
+      mLevels.push_back(std::move(level));
+    }
+  }
+
+  /** Get the min and max of the points in each of a number of columns spanning a range
+   * @param pData The points that were passed to Build()
+   * @param start The first point of the range
+   * @param end One past the last point of the range
+   * @param nColumns The number of columns, e.g. the width of the waveform in pixels
+   * @param pMins The minimum of each column
+   * @param pMaxs The maximum of each column */
+  void GetColumns(const float* pData, int start, int end, int nColumns, float* pMins, float* pMaxs) const
+  {
+    start = std::max(start, 0);
+    end = std::min(end, mNPoints);
+    const int nPoints = end - start;
+    
+    for (int c = 0; c < nColumns; c++)
+    {
+      const int s = start + static_cast<int>(static_cast<int64_t>(c) * nPoints / nColumns);
+      const int e = start + static_cast<int>(static_cast<int64_t>(c + 1) * nPoints / nColumns);
+      
+      if (nPoints <= 0)
+      {
+        pMins[c] = pMaxs[c] = 0.f;
+        continue;
+      }
+      
+      // a column narrower than a point shows the point it is in
+      pMins[c] = pMaxs[c] = pData[s];
+      Accumulate(pData, s, std::max(e, s + 1), pMins[c], pMaxs[c]);
+    }
+  }
+  
+private:
+  /** Find the min and max of a range, from the coarsest blocks that fit in it, and finer blocks and points at its ends */
+  void Accumulate(const float* pData, int start, int end, float& min, float& max) const
+  {
+    for (int l = static_cast<int>(mLevels.size()) - 1; l >= 0; l--)
+    {
+      const Level& level = mLevels[l];
+      const int first = (start + level.blockSize - 1) / level.blockSize;
+      const int last = end / level.blockSize;
+      
+      if (last > first)
+      {
+        for (int b = first; b < last; b++)
+        {
+          min = std::min(min, level.mins[b]);
+          max = std::max(max, level.maxs[b]);
+        }
+        
+        Accumulate(pData, start, first * level.blockSize, min, max);
+        Accumulate(pData, last * level.blockSize, end, min, max);
+        return;
+      }
+    }
+    
+    for (int i = start; i < end; i++)
+    {
+      min = std::min(min, pData[i]);
+      max = std::max(max, pData[i]);
+    }
+  }
+  
+  struct Level
+  {
+    std::vector<float> mins;
+    std::vector<float> maxs;
+    int blockSize;
+  };
+  
+  std::vector<Level> mLevels;
+  int mNPoints = 0;
+};
+
 template <typename T>
 inline T DegToRad(T degrees)
 {
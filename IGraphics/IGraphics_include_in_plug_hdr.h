@@ -42,6 +42,10 @@
     #elif defined IGRAPHICS_GL3
       #include <OpenGL/gl3.h>
     #endif
+  #elif defined OS_LINUX
+    #define GL_GLEXT_PROTOTYPES
+    #include <GL/gl.h>
+    #include <GL/glext.h>
   #else
     #include <OpenGL/gl.h>
   #endif
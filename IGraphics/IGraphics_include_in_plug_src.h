@@ -64,6 +64,15 @@
 
     return pGraphics;
   }
+  #elif defined OS_LINUX
+  IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
+  {
+    IGraphicsLinux* pGraphics = new IGraphicsLinux(dlg, w, h, fps, scale);
+    pGraphics->SetBundleID(BUNDLE_ID);
+    pGraphics->SetSharedResourcesSubPath(SHARED_RESOURCES_SUBPATH);
+
+    return pGraphics;
+  }
   #elif defined OS_WEB
   IGraphics* MakeGraphics(IGEditorDelegate& dlg, int w, int h, int fps = 0, float scale = 1.)
   {
@@ -39,11 +39,29 @@
       #elif defined IGRAPHICS_GL3
         #include <OpenGL/gl3.h>
       #endif
+    #elif defined OS_LINUX
+      #define GL_GLEXT_PROTOTYPES
+      #include <GL/gl.h>
+      #include <GL/glext.h>
     #else
       #include <OpenGL/gl.h>
     #endif
   #endif
 
+  #if defined IGRAPHICS_RENDER_THREAD
+    #if !defined IGRAPHICS_GL || !(defined OS_MAC || defined OS_WIN)
+      #error IGRAPHICS_RENDER_THREAD requires IGRAPHICS_GL2 or IGRAPHICS_GL3 on macOS or Windows
+    #endif
+    #if defined OS_MAC && !defined IGRAPHICS_CVDISPLAYLINK
+      #define IGRAPHICS_CVDISPLAYLINK
+    #endif
+  #endif
+
+  // on macOS redraws are paced by a display link on the window's screen, define IGRAPHICS_NSTIMER to use a timer at FPS() instead
+  #if defined OS_MAC && !defined IGRAPHICS_NSTIMER && !defined IGRAPHICS_CVDISPLAYLINK
+    #define IGRAPHICS_CVDISPLAYLINK
+  #endif
+
   #if defined IGRAPHICS_NANOVG
     #include "IGraphicsNanoVG.h"
     #define IGRAPHICS_DRAW_CLASS_TYPE IGraphicsNanoVG
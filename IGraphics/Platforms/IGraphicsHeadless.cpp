@@ -0,0 +1,392 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "IGraphicsHeadless.h"
+#include "IPlugMappedResource.h"
+#include "IPlugPaths.h"
+
+#if defined OS_MAC
+#include "IGraphicsCoreText.h"
+#endif
+
+#include "SkImageEncoder.h"
+#include "SkStream.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+#pragma mark - Private Classes and Structs
+
+// Fonts
+
+#if !defined OS_MAC
+class IGraphicsHeadless::FileFont : public PlatformFont
+{
+public:
+  FileFont(const char* fontPath)
+  : PlatformFont(false), mPath(fontPath)
+  {}
+
+  IFontDataPtr GetFontData() override
+  {
+    auto resource = std::make_shared<const IPlugMappedResource>(mPath.Get());
+
+    if (!resource->IsValid())
+      return IFontDataPtr(new IFontData());
+
+    return IFontDataPtr(new IFontData(std::move(resource), 0));
+  }
+
+private:
+  WDL_String mPath;
+};
+
+class IGraphicsHeadless::MemoryFont : public PlatformFont
+{
+public:
+  MemoryFont(const void* pData, int dataSize)
+  : PlatformFont(false)
+  {
+    mData.Set((const uint8_t*)pData, dataSize);
+  }
+
+  IFontDataPtr GetFontData() override
+  {
+    return IFontDataPtr(new IFontData(mData.Get(), mData.GetSize(), 0));
+  }
+
+private:
+  WDL_TypedBuf<uint8_t> mData;
+};
+#endif
+
+#if defined OS_MAC
+static StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
+#endif
+
+#pragma mark - IGraphicsHeadless
+
+IGraphicsHeadless::IGraphicsHeadless(IGEditorDelegate& dlg, int w, int h, int fps, float scale, float screenScale)
+: IGRAPHICS_DRAW_CLASS(dlg, w, h, fps, scale)
+, mInitialScreenScale(screenScale)
+{
+#if defined OS_MAC
+  StaticStorage<CoreTextFontDescriptor>::Accessor storage(sFontDescriptorCache);
+  storage.Retain();
+#endif
+}
+
+IGraphicsHeadless::~IGraphicsHeadless()
+{
+  CloseWindow();
+
+#if defined OS_MAC
+  StaticStorage<CoreTextFontDescriptor>::Accessor storage(sFontDescriptorCache);
+  storage.Release();
+#endif
+}
+
+void* IGraphicsHeadless::OpenWindow(void* pParent)
+{
+  if (mWindowOpen)
+    return nullptr;
+
+  mWindowOpen = true;
+  OnViewInitialized(nullptr);
+  SetScreenScale(mInitialScreenScale); // creates the surface
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
+
+  // there are no platform menus or text fields to show, so they are drawn by IGraphics and streamed with the rest of the UI
+  if (!GetPopupMenuControl())
+    AttachPopupMenuControl();
+
+  if (!GetTextEntryControl())
+    AttachTextEntryControl();
+
+  SetAllControlsDirty();
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
+
+  mTimer = std::unique_ptr<Timer>(Timer::Create([this](Timer&) { Tick(); }, static_cast<uint32_t>(1000 / std::max(FPS(), 1))));
+
+  return nullptr;
+}
+
+void IGraphicsHeadless::CloseWindow()
+{
+  if (!mWindowOpen)
+    return;
+
+  mTimer = nullptr;
+  mWindowOpen = false;
+  OnViewDestroyed();
+}
+
+void IGraphicsHeadless::DrawResize()
+{
+  IGRAPHICS_DRAW_CLASS::DrawResize();
+
+  const int w = static_cast<int>(std::ceil(static_cast<float>(WindowWidth()) * GetScreenScale()));
+  const int h = static_cast<int>(std::ceil(static_cast<float>(WindowHeight()) * GetScreenScale()));
+
+  if (w == mFrameWidth && h == mFrameHeight)
+    return;
+
+  mFrameWidth = w;
+  mFrameHeight = h;
+  mLastFrame.assign(static_cast<size_t>(w) * h, 0);
+  mTiles.clear();
+  mTiles.resize(NTilesX() * NTilesY());
+  mFullFrame = true;
+
+  if (mFrameSizeFunc)
+    mFrameSizeFunc(w, h);
+}
+
+void IGraphicsHeadless::Tick()
+{
+  if (mBeforeDrawFunc)
+    mBeforeDrawFunc();
+
+  IRECTList rects;
+
+  if (mFullFrame && mTileFunc)
+    SetAllControlsDirty();
+
+  if (IsDirty(rects))
+  {
+    SetAllControlsClean();
+    Draw(rects);
+    UpdateTiles(rects);
+  }
+
+  if (mAfterDrawFunc)
+    mAfterDrawFunc();
+}
+
+void IGraphicsHeadless::SetTileFunc(TileFunc func, int tileSize, ETileFormat format, int quality)
+{
+  mTileFunc = func;
+  mTileSize = std::max(tileSize, 8);
+  mTileFormat = format;
+  mTileQuality = Clip(quality, 0, 100);
+  mTiles.clear();
+  mTiles.resize(NTilesX() * NTilesY());
+  mFullFrame = true;
+}
+
+void IGraphicsHeadless::ForEachTile(const TileFunc& func) const
+{
+  for (int i = 0; i < static_cast<int>(mTiles.size()); i++)
+  {
+    if (!mTiles[i])
+      continue;
+
+    int x, y, w, h;
+    GetTileRect(i, x, y, w, h);
+    func(i, x, y, w, h, mTiles[i]->data(), static_cast<int>(mTiles[i]->size()));
+  }
+}
+
+void IGraphicsHeadless::GetTileRect(int tileIdx, int& x, int& y, int& w, int& h) const
+{
+  x = (tileIdx % NTilesX()) * mTileSize;
+  y = (tileIdx / NTilesX()) * mTileSize;
+  w = std::min(mTileSize, mFrameWidth - x);
+  h = std::min(mTileSize, mFrameHeight - y);
+}
+
+void IGraphicsHeadless::UpdateTiles(const IRECTList& rects)
+{
+  if (!mTileFunc || !mFrameWidth || !mFrameHeight)
+    return;
+
+  const int nTilesX = NTilesX();
+  const int nTilesY = NTilesY();
+  const float scale = GetBackingPixelScale();
+  std::vector<bool> touched(nTilesX * nTilesY, mFullFrame);
+
+  if (!mFullFrame)
+  {
+    for (int i = 0; i < rects.Size(); i++)
+    {
+      const IRECT r = rects.Get(i).GetScaled(scale);
+      const int left = Clip(static_cast<int>(std::floor(r.L)) / mTileSize, 0, nTilesX - 1);
+      const int top = Clip(static_cast<int>(std::floor(r.T)) / mTileSize, 0, nTilesY - 1);
+      const int right = Clip(static_cast<int>(std::ceil(r.R) - 1) / mTileSize, 0, nTilesX - 1);
+      const int bottom = Clip(static_cast<int>(std::ceil(r.B) - 1) / mTileSize, 0, nTilesY - 1);
+
+      for (int ty = top; ty <= bottom; ty++)
+      {
+        for (int tx = left; tx <= right; tx++)
+          touched[ty * nTilesX + tx] = true;
+      }
+    }
+  }
+
+  for (int i = 0; i < nTilesX * nTilesY; i++)
+  {
+    if (!touched[i])
+      continue;
+
+    int x, y, w, h;
+    GetTileRect(i, x, y, w, h);
+
+    // a control redrawn with the same pixels, e.g. a meter that hasn't moved, doesn't send anything
+    if (!CompareAndCopyTile(x, y, w, h) && !mFullFrame && mTiles[i])
+      continue;
+
+    sk_sp<SkData> data = EncodeTile(x, y, w, h);
+
+    if (!data)
+      continue;
+
+    mTiles[i] = data;
+    mTileFunc(i, x, y, w, h, data->data(), static_cast<int>(data->size()));
+  }
+
+  mFullFrame = false;
+}
+
+bool IGraphicsHeadless::CompareAndCopyTile(int x, int y, int w, int h)
+{
+  SkPixmap pixmap;
+
+  if (!static_cast<SkCanvas*>(GetDrawContext())->peekPixels(&pixmap))
+    return false;
+
+  bool changed = false;
+
+  for (int row = y; row < y + h; row++)
+  {
+    const uint32_t* pSrc = pixmap.addr32(x, row);
+    uint32_t* pDst = mLastFrame.data() + static_cast<size_t>(row) * mFrameWidth + x;
+
+    if (memcmp(pSrc, pDst, w * sizeof(uint32_t)))
+    {
+      memcpy(pDst, pSrc, w * sizeof(uint32_t));
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+sk_sp<SkData> IGraphicsHeadless::EncodeTile(int x, int y, int w, int h)
+{
+  SkPixmap pixmap, tile;
+
+  if (!static_cast<SkCanvas*>(GetDrawContext())->peekPixels(&pixmap) || !pixmap.extractSubset(&tile, SkIRect::MakeXYWH(x, y, w, h)))
+    return nullptr;
+
+  SkEncodedImageFormat format = SkEncodedImageFormat::kPNG;
+
+  if (mTileFormat == ETileFormat::kJPEG)
+    format = SkEncodedImageFormat::kJPEG;
+  else if (mTileFormat == ETileFormat::kWEBP)
+    format = SkEncodedImageFormat::kWEBP;
+
+  SkDynamicMemoryWStream stream;
+
+  if (!SkEncodeImage(&stream, tile, format, mTileQuality))
+    return nullptr;
+
+  return stream.detachAsData();
+}
+
+EMsgBoxResult IGraphicsHeadless::ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHandlerFunc completionHandler)
+{
+  DBGMSG("IGraphicsHeadless: message box not shown: %s\n", str);
+
+  if (completionHandler)
+    completionHandler(kCANCEL);
+
+  return kCANCEL;
+}
+
+void IGraphicsHeadless::PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext, IFileDialogCompletionHandlerFunc completionHandler)
+{
+  fileName.Set("");
+
+  if (completionHandler)
+    completionHandler(fileName, path);
+}
+
+void IGraphicsHeadless::PromptForDirectory(WDL_String& path, IFileDialogCompletionHandlerFunc completionHandler)
+{
+  path.Set("");
+
+  if (completionHandler)
+  {
+    WDL_String fileName;
+    completionHandler(fileName, path);
+  }
+}
+
+#pragma mark - Fonts
+
+PlatformFontPtr IGraphicsHeadless::LoadPlatformFont(const char* fontID, const char* fileNameOrResID)
+{
+#if defined OS_MAC
+  return CoreTextHelpers::LoadPlatformFont(fontID, fileNameOrResID, GetBundleID(), GetSharedResourcesSubPath());
+#else
+  WDL_String fullPath;
+  const EResourceLocation fontLocation = LocateResource(fileNameOrResID, "ttf", fullPath, GetBundleID(), GetWinModuleHandle(), GetSharedResourcesSubPath());
+
+  if (fontLocation == kNotFound)
+    return nullptr;
+
+#if defined OS_WIN
+  if (fontLocation == kWinBinary)
+  {
+    int resSize = 0;
+    const void* pFontMem = LoadWinResource(fullPath.Get(), "ttf", resSize, GetWinModuleHandle());
+    return pFontMem ? LoadPlatformFont(fontID, const_cast<void*>(pFontMem), resSize) : nullptr;
+  }
+#endif
+
+  return PlatformFontPtr(new FileFont(fullPath.Get()));
+#endif
+}
+
+PlatformFontPtr IGraphicsHeadless::LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style)
+{
+#if defined OS_MAC
+  return CoreTextHelpers::LoadPlatformFont(fontID, fontName, style);
+#else
+  DBGMSG("IGraphicsHeadless: system font %s not available, load it from a file\n", fontName);
+  return nullptr;
+#endif
+}
+
+PlatformFontPtr IGraphicsHeadless::LoadPlatformFont(const char* fontID, void* pData, int dataSize)
+{
+#if defined OS_MAC
+  return CoreTextHelpers::LoadPlatformFont(fontID, pData, dataSize);
+#else
+  return PlatformFontPtr(new MemoryFont(pData, dataSize));
+#endif
+}
+
+void IGraphicsHeadless::CachePlatformFont(const char* fontID, const PlatformFontPtr& font)
+{
+#if defined OS_MAC
+  CoreTextHelpers::CachePlatformFont(fontID, font, sFontDescriptorCache);
+#endif
+}
@@ -0,0 +1,169 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugTimer.h"
+
+#include "IGraphics_select.h"
+
+#if !defined IGRAPHICS_SKIA || !defined IGRAPHICS_CPU
+  #error IGraphicsHeadless requires IGRAPHICS_SKIA and IGRAPHICS_CPU
+#endif
+
+#include "SkData.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** IGraphics platform class that renders without a window, into a Skia raster surface, e.g. to stream the UI to a remote client with IGraphicsStreamServer.
+ *
+ * The frame is split into square tiles. After each frame the tiles under the dirty rects are compared with the last frame, and only the ones whose pixels have changed
+ * are encoded, and passed to the TileFunc. The last encoded image of each tile is kept, so a client that connects later can be sent the whole frame with ForEachTile()
+ * without encoding it again. Nothing is drawn by the OS, so the popup menu and text entry controls are attached when the window is opened, and the platform dialogs
+ * are not available. Only fonts loaded from files, resources or memory are supported, except on macOS where CoreText finds system fonts too.
+ *
+ * The delegate creates it in place of MakeGraphics(), and opens it with OpenWindow(nullptr). Define IGRAPHICS_HEADLESS, so that IGraphicsSkia doesn't present the frame itself.
+ * @ingroup PlatformClasses */
+class IGraphicsHeadless final : public IGRAPHICS_DRAW_CLASS
+{
+  class FileFont;
+  class MemoryFont;
+public:
+  /** The image format of the tiles */
+  enum class ETileFormat { kPNG, kJPEG, kWEBP };
+
+  /** Called on the main thread for each encoded tile
+   * @param tileIdx The index of the tile, row by row
+   * @param x The left of the tile in pixels of the frame
+   * @param y The top of the tile in pixels of the frame
+   * @param pData The encoded image, which is only valid during the call, see ForEachTile() */
+  using TileFunc = std::function<void(int tileIdx, int x, int y, int w, int h, const void* pData, int size)>;
+
+  /** Called on the main thread when the size of the frame in pixels changes. All the tiles are sent again after it */
+  using FrameSizeFunc = std::function<void(int width, int height)>;
+
+  /** @param screenScale The scale of the frame relative to the UI, e.g. 2 to stream to high DPI clients */
+  IGraphicsHeadless(IGEditorDelegate& dlg, int w, int h, int fps, float scale, float screenScale = 1.f);
+  ~IGraphicsHeadless();
+
+  const char* GetPlatformAPIStr() override { return "Headless"; }
+
+  void DrawResize() override;
+  void EndFrame() override {} // the frame is read by Tick(), once it has been drawn
+
+  void HideMouseCursor(bool hide, bool lock) override {}
+  void MoveMouseCursor(float x, float y) override {}
+  void GetMouseLocation(float& x, float&y) const override { x = mMouseX; y = mMouseY; }
+
+  void ForceEndUserEdit() override {}
+  void* OpenWindow(void* pParent) override;
+  void CloseWindow() override;
+  void* GetWindow() override { return nullptr; }
+  bool WindowIsOpen() override { return mWindowOpen; }
+  bool GetTextFromClipboard(WDL_String& str) override { str.Set(mClipboardText.Get()); return true; }
+  bool SetTextInClipboard(const char* str) override { mClipboardText.Set(str); return true; }
+  void UpdateTooltips() override {}
+  EMsgBoxResult ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHandlerFunc completionHandler) override;
+
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext, IFileDialogCompletionHandlerFunc completionHandler) override;
+  void PromptForDirectory(WDL_String& path, IFileDialogCompletionHandlerFunc completionHandler) override;
+  bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override { return false; }
+  bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override { return false; }
+
+  const char* GetBundleID() override { return mBundleID.Get(); }
+  void SetBundleID(const char* bundleID) { mBundleID.Set(bundleID); }
+  void SetWinModuleHandle(void* pInstance) override { mHInstance = pInstance; }
+  void* GetWinModuleHandle() override { return mHInstance; }
+
+  //IGraphicsHeadless
+  /** Draw the dirty controls and encode the tiles that have changed. Called by a timer at the frame rate while the window is open */
+  void Tick();
+
+  /** @param beforeDraw Called at the start of each Tick(), e.g. to apply the input received from the clients
+   * @param afterDraw Called at the end of each Tick(), once the tiles have been encoded, e.g. to send them */
+  void SetTickFuncs(std::function<void()> beforeDraw, std::function<void()> afterDraw)
+  {
+    mBeforeDrawFunc = beforeDraw;
+    mAfterDrawFunc = afterDraw;
+  }
+
+  /** Set how the tiles are encoded, and the function they are passed to. This starts again with a full frame
+   * @param tileSize The width and height of the tiles in pixels. Smaller tiles send less of the frame for small changes, but compress less well
+   * @param quality The quality of kJPEG and kWEBP tiles, from 0 to 100. kWEBP requires Skia to be built with its WebP encoder */
+  void SetTileFunc(TileFunc func, int tileSize = 64, ETileFormat format = ETileFormat::kPNG, int quality = 90);
+
+  void SetFrameSizeFunc(FrameSizeFunc func) { mFrameSizeFunc = func; }
+
+  /** Call a function for the last encoded image of each tile, e.g. to send the whole frame to a client that has just connected */
+  void ForEachTile(const TileFunc& func) const;
+
+  /** Record the mouse position given to the On* mouse functions, which GetMouseLocation() returns */
+  void SetMouseLocation(float x, float y) { mMouseX = x; mMouseY = y; }
+
+  int GetFrameWidth() const { return mFrameWidth; }
+  int GetFrameHeight() const { return mFrameHeight; }
+  int GetTileSize() const { return mTileSize; }
+  ETileFormat GetTileFormat() const { return mTileFormat; }
+
+protected:
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT bounds, bool& isAsync) override { return nullptr; }
+  void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override {}
+
+private:
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, void* pData, int dataSize) override;
+  void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override;
+
+  /** Compare the tiles under the rects that were drawn with the last frame, and encode the ones that have changed */
+  void UpdateTiles(const IRECTList& rects);
+
+  /** @return \c true if the tile's pixels differ from the last frame's, which are updated */
+  bool CompareAndCopyTile(int x, int y, int w, int h);
+
+  sk_sp<SkData> EncodeTile(int x, int y, int w, int h);
+
+  void GetTileRect(int tileIdx, int& x, int& y, int& w, int& h) const;
+
+  int NTilesX() const { return (mFrameWidth + mTileSize - 1) / mTileSize; }
+  int NTilesY() const { return (mFrameHeight + mTileSize - 1) / mTileSize; }
+
+  std::unique_ptr<Timer> mTimer;
+  bool mWindowOpen = false;
+  float mInitialScreenScale;
+
+  WDL_String mClipboardText;
+  WDL_String mBundleID;
+  void* mHInstance = nullptr;
+  float mMouseX = 0.f;
+  float mMouseY = 0.f;
+
+  std::function<void()> mBeforeDrawFunc;
+  std::function<void()> mAfterDrawFunc;
+  TileFunc mTileFunc;
+  FrameSizeFunc mFrameSizeFunc;
+  int mTileSize = 64;
+  ETileFormat mTileFormat = ETileFormat::kPNG;
+  int mTileQuality = 90;
+
+  int mFrameWidth = 0;
+  int mFrameHeight = 0;
+  std::vector<uint32_t> mLastFrame; // the pixels of the tiles as they were last encoded
+  std::vector<sk_sp<SkData>> mTiles; // the last encoded image of each tile
+  bool mFullFrame = true; // encode every tile on the next Tick(), e.g. after a resize
+};
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
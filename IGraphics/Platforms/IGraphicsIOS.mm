@@ -52,11 +52,13 @@ StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
 
 std::map<std::string, MTLTexturePtr> gTextureMap;
 NSArray<id<MTLTexture>>* gTextures;
+static int sInstanceCount = 0; // the preloaded textures are released with the last instance, and loaded again with the next
 
 IGraphicsIOS::IGraphicsIOS(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
 : IGRAPHICS_DRAW_CLASS(dlg, w, h, fps, scale)
 {
- 
+  sInstanceCount++;
+
 #if defined IGRAPHICS_METAL && !defined IGRAPHICS_SKIA
   if(!gTextureMap.size())
   {
@@ -93,6 +95,14 @@ IGraphicsIOS::IGraphicsIOS(IGEditorDelegate& dlg, int w, int h, int fps, float s
 IGraphicsIOS::~IGraphicsIOS()
 {
   CloseWindow();
+
+  // with no UI open, e.g. an AUv3 whose view has disappeared, the textures would only count against the extension's memory limit
+  if (--sInstanceCount == 0 && gTextures)
+  {
+    gTextureMap.clear();
+    [gTextures release];
+    gTextures = nil;
+  }
 }
 
 void* IGraphicsIOS::OpenWindow(void* pParent)
@@ -106,8 +116,14 @@ void* IGraphicsIOS::OpenWindow(void* pParent)
   
   SetScreenScale([UIScreen mainScreen].scale);
   
-  GetDelegate()->LayoutUI(this);
-  GetDelegate()->OnUIOpen();
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
   
   [view setMultipleTouchEnabled:MultiTouchEnabled()];
 
@@ -8,4 +8,1377 @@
  ==============================================================================
 */
 
-/\todo
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "IGraphicsLinux.h"
+#include "IPlugMappedResource.h"
+#include "IPlugPaths.h"
+#include "wdlutf8.h"
+
+// the X headers define macros such as None and Bool, so they are included after the IGraphics headers
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xresource.h>
+#include <X11/Xutil.h>
+#include <X11/cursorfont.h>
+#include <X11/keysym.h>
+#include <GL/glx.h>
+#include <GL/glxext.h>
+#include <fontconfig/fontconfig.h>
+
+using namespace iplug;
+using namespace igraphics;
+
+#pragma mark - Private Classes and Structs
+
+// Fonts
+
+class IGraphicsLinux::FileFont : public PlatformFont
+{
+public:
+  FileFont(const char* fontPath, bool system = false, int faceIdx = 0)
+  : PlatformFont(system), mPath(fontPath), mFaceIdx(faceIdx)
+  {}
+
+  FontDescriptor GetDescriptor() override { return mPath.Get(); }
+
+  IFontDataPtr GetFontData() override
+  {
+    auto resource = std::make_shared<const IPlugMappedResource>(mPath.Get());
+
+    if (!resource->IsValid())
+      return IFontDataPtr(new IFontData());
+
+    return IFontDataPtr(new IFontData(std::move(resource), mFaceIdx));
+  }
+
+private:
+  WDL_String mPath;
+  int mFaceIdx;
+};
+
+class IGraphicsLinux::MemoryFont : public PlatformFont
+{
+public:
+  MemoryFont(const void* pData, int dataSize)
+  : PlatformFont(false)
+  {
+    mData.Set((const uint8_t*)pData, dataSize);
+  }
+
+  IFontDataPtr GetFontData() override
+  {
+    return IFontDataPtr(new IFontData(mData.Get(), mData.GetSize(), 0));
+  }
+
+private:
+  WDL_TypedBuf<uint8_t> mData;
+};
+
+#pragma mark - Utilities
+
+static constexpr int kDoubleClickTimeMs = 400;
+static constexpr float kDoubleClickDistance = 4.f;
+
+static bool HasGLXExtension(Display* pDisplay, const char* extension)
+{
+  const char* extensions = glXQueryExtensionsString(pDisplay, DefaultScreen(pDisplay));
+
+  if (!extensions)
+    return false;
+
+  const size_t len = strlen(extension);
+
+  for (const char* p = strstr(extensions, extension); p; p = strstr(p + len, extension))
+  {
+    if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+      return true;
+  }
+
+  return false;
+}
+
+static GLXFBConfig ChooseFBConfig(Display* pDisplay)
+{
+  const int attribs[] = {
+    GLX_X_RENDERABLE, True,
+    GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+    GLX_RENDER_TYPE, GLX_RGBA_BIT,
+    GLX_RED_SIZE, 8,
+    GLX_GREEN_SIZE, 8,
+    GLX_BLUE_SIZE, 8,
+    GLX_ALPHA_SIZE, 8,
+    GLX_STENCIL_SIZE, 8,
+    GLX_DOUBLEBUFFER, True,
+    None
+  };
+
+  int nConfigs = 0;
+  GLXFBConfig* pConfigs = glXChooseFBConfig(pDisplay, DefaultScreen(pDisplay), attribs, &nConfigs);
+
+  if (!pConfigs)
+    return nullptr;
+
+  GLXFBConfig config = nConfigs > 0 ? pConfigs[0] : nullptr;
+  XFree(pConfigs);
+  return config;
+}
+
+/** @return The scale of the screen from the Xft.dpi resource, which desktop environments set for high DPI screens */
+static float GetScreenScaleForDisplay(Display* pDisplay)
+{
+  float scale = 1.f;
+  const char* resources = XResourceManagerString(pDisplay);
+
+  if (resources)
+  {
+    XrmInitialize();
+    XrmDatabase db = XrmGetStringDatabase(resources);
+    char* type = nullptr;
+    XrmValue value;
+
+    if (db && XrmGetResource(db, "Xft.dpi", "Xft.Dpi", &type, &value) && value.addr)
+    {
+      const float dpi = static_cast<float>(atof(value.addr));
+
+      if (dpi > 0.f)
+        scale = dpi / 96.f;
+    }
+
+    if (db)
+      XrmDestroyDatabase(db);
+  }
+
+  return scale;
+}
+
+static int GetVKFromKeySym(KeySym keySym)
+{
+  if (keySym >= XK_a && keySym <= XK_z) return kVK_A + static_cast<int>(keySym - XK_a);
+  if (keySym >= XK_A && keySym <= XK_Z) return kVK_A + static_cast<int>(keySym - XK_A);
+  if (keySym >= XK_0 && keySym <= XK_9) return kVK_0 + static_cast<int>(keySym - XK_0);
+  if (keySym >= XK_KP_0 && keySym <= XK_KP_9) return kVK_NUMPAD0 + static_cast<int>(keySym - XK_KP_0);
+  if (keySym >= XK_F1 && keySym <= XK_F24) return kVK_F1 + static_cast<int>(keySym - XK_F1);
+
+  switch (keySym)
+  {
+    case XK_BackSpace:    return kVK_BACK;
+    case XK_Tab:          return kVK_TAB;
+    case XK_Clear:        return kVK_CLEAR;
+    case XK_Return:
+    case XK_KP_Enter:     return kVK_RETURN;
+    case XK_Shift_L:
+    case XK_Shift_R:      return kVK_SHIFT;
+    case XK_Control_L:
+    case XK_Control_R:    return kVK_CONTROL;
+    case XK_Alt_L:
+    case XK_Alt_R:        return kVK_MENU;
+    case XK_Pause:        return kVK_PAUSE;
+    case XK_Caps_Lock:    return kVK_CAPITAL;
+    case XK_Escape:       return kVK_ESCAPE;
+    case XK_space:        return kVK_SPACE;
+    case XK_Page_Up:
+    case XK_KP_Page_Up:   return kVK_PRIOR;
+    case XK_Page_Down:
+    case XK_KP_Page_Down: return kVK_NEXT;
+    case XK_End:
+    case XK_KP_End:       return kVK_END;
+    case XK_Home:
+    case XK_KP_Home:      return kVK_HOME;
+    case XK_Left:
+    case XK_KP_Left:      return kVK_LEFT;
+    case XK_Up:
+    case XK_KP_Up:        return kVK_UP;
+    case XK_Right:
+    case XK_KP_Right:     return kVK_RIGHT;
+    case XK_Down:
+    case XK_KP_Down:      return kVK_DOWN;
+    case XK_Select:       return kVK_SELECT;
+    case XK_Print:        return kVK_SNAPSHOT;
+    case XK_Insert:
+    case XK_KP_Insert:    return kVK_INSERT;
+    case XK_Delete:
+    case XK_KP_Delete:    return kVK_DELETE;
+    case XK_Help:         return kVK_HELP;
+    case XK_Super_L:      return kVK_LWIN;
+    case XK_KP_Multiply:  return kVK_MULTIPLY;
+    case XK_KP_Add:       return kVK_ADD;
+    case XK_KP_Separator: return kVK_SEPARATOR;
+    case XK_KP_Subtract:  return kVK_SUBTRACT;
+    case XK_KP_Decimal:   return kVK_DECIMAL;
+    case XK_KP_Divide:    return kVK_DIVIDE;
+    case XK_Num_Lock:     return kVK_NUMLOCK;
+    case XK_Scroll_Lock:  return kVK_SCROLL;
+    default:              return kVK_NONE;
+  }
+}
+
+/** Latin-1 keysyms have the same values as their code points, and the other characters have keysyms of 0x01000000 plus their code point */
+static void GetUTF8FromKeySym(KeySym keySym, char* utf8, int len)
+{
+  int codePoint = 0;
+
+  if ((keySym >= 0x20 && keySym <= 0x7e) || (keySym >= 0xa0 && keySym <= 0xff))
+    codePoint = static_cast<int>(keySym);
+  else if ((keySym & 0xff000000) == 0x01000000)
+    codePoint = static_cast<int>(keySym & 0x00ffffff);
+
+  if (codePoint)
+    WDL_MakeUTFChar(utf8, codePoint, len);
+  else
+    utf8[0] = '\0';
+}
+
+static void AppendShellQuoted(WDL_String& cmd, const char* str)
+{
+  cmd.Append("'");
+
+  for (const char* p = str; *p; p++)
+  {
+    if (*p == '\'')
+      cmd.Append("'\\''");
+    else
+      cmd.Append(p, 1);
+  }
+
+  cmd.Append("' ");
+}
+
+/** Run a command with the shell, e.g. a zenity dialog, and wait for it to finish
+ * @param output Filled with the first line the command prints, without the newline
+ * @return The exit status of the command, or -1 if it couldn't be run */
+static int RunCommand(const char* cmd, WDL_String& output)
+{
+  output.Set("");
+  FILE* pPipe = popen(cmd, "r");
+
+  if (!pPipe)
+    return -1;
+
+  char buf[4096];
+
+  if (fgets(buf, sizeof(buf), pPipe))
+  {
+    buf[strcspn(buf, "\n")] = '\0';
+    output.Set(buf);
+  }
+
+  const int status = pclose(pPipe);
+  return (status != -1 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+}
+
+#pragma mark - IGraphicsLinux
+
+IGraphicsLinux::IGraphicsLinux(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
+: IGRAPHICS_DRAW_CLASS(dlg, w, h, fps, scale)
+{
+}
+
+IGraphicsLinux::~IGraphicsLinux()
+{
+  CloseWindow();
+}
+
+void* IGraphicsLinux::OpenWindow(void* pParent)
+{
+  if (mWindow)
+    CloseWindow();
+
+  mDisplay = XOpenDisplay(nullptr);
+
+  if (!mDisplay)
+  {
+    DBGMSG("IGraphicsLinux: could not open the X display\n");
+    return nullptr;
+  }
+
+  mParentWindow = pParent ? reinterpret_cast<uintptr_t>(pParent) : RootWindow(mDisplay, DefaultScreen(mDisplay));
+  mFBConfig = ChooseFBConfig(mDisplay);
+  XVisualInfo* pVisual = mFBConfig ? glXGetVisualFromFBConfig(mDisplay, mFBConfig) : nullptr;
+
+  if (!pVisual)
+  {
+    DBGMSG("IGraphicsLinux: no suitable GLX framebuffer configuration\n");
+    XCloseDisplay(mDisplay);
+    mDisplay = nullptr;
+    return nullptr;
+  }
+
+  const float screenScale = GetScreenScaleForDisplay(mDisplay);
+  const unsigned int w = static_cast<unsigned int>(std::ceil(WindowWidth() * screenScale));
+  const unsigned int h = static_cast<unsigned int>(std::ceil(WindowHeight() * screenScale));
+
+  mColormap = XCreateColormap(mDisplay, mParentWindow, pVisual->visual, AllocNone);
+
+  XSetWindowAttributes attrs = {};
+  attrs.colormap = mColormap;
+  attrs.border_pixel = 0;
+  attrs.event_mask = ExposureMask | StructureNotifyMask | PointerMotionMask | ButtonPressMask | ButtonReleaseMask
+                   | KeyPressMask | KeyReleaseMask | EnterWindowMask | LeaveWindowMask | FocusChangeMask;
+
+  mWindow = XCreateWindow(mDisplay, mParentWindow, 0, 0, w, h, 0, pVisual->depth, InputOutput, pVisual->visual,
+                          CWColormap | CWBorderPixel | CWEventMask, &attrs);
+  XFree(pVisual);
+
+  if (!CreateGLContext())
+  {
+    DBGMSG("IGraphicsLinux: could not create the OpenGL context\n");
+    CloseWindow();
+    return nullptr;
+  }
+
+  XMapWindow(mDisplay, mWindow);
+  XFlush(mDisplay);
+
+  ActivateGLContext();
+  OnViewInitialized(nullptr);
+  SetScreenScale(screenScale); // resizes draw context
+  DeactivateGLContext();
+
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
+
+  // there are no platform menus or text fields, so they are drawn by IGraphics
+  if (!GetPopupMenuControl())
+    AttachPopupMenuControl();
+
+  if (!GetTextEntryControl())
+    AttachTextEntryControl();
+
+  SetAllControlsDirty();
+
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
+
+  StartVBlankThread();
+
+  return reinterpret_cast<void*>(mWindow);
+}
+
+void IGraphicsLinux::CloseWindow()
+{
+  if (!mDisplay)
+    return;
+
+  StopVBlankThread();
+
+  if (mGLContext)
+  {
+    ActivateGLContext();
+    OnViewDestroyed();
+    DeactivateGLContext();
+    DestroyGLContext();
+  }
+
+  for (auto& cursor : mCursors)
+  {
+    if (cursor)
+      XFreeCursor(mDisplay, cursor);
+
+    cursor = 0;
+  }
+
+  if (mBlankCursor)
+  {
+    XFreeCursor(mDisplay, mBlankCursor);
+    mBlankCursor = 0;
+  }
+
+  if (mWindow)
+  {
+    XDestroyWindow(mDisplay, mWindow);
+    mWindow = 0;
+  }
+
+  if (mColormap)
+  {
+    XFreeColormap(mDisplay, mColormap);
+    mColormap = 0;
+  }
+
+  XCloseDisplay(mDisplay);
+  mDisplay = nullptr;
+  mFBConfig = nullptr;
+  mMotionPending = false;
+}
+
+void IGraphicsLinux::PlatformResize(bool parentHasResized)
+{
+  if (!mWindow)
+    return;
+
+  const unsigned int w = static_cast<unsigned int>(std::ceil(WindowWidth() * GetScreenScale()));
+  const unsigned int h = static_cast<unsigned int>(std::ceil(WindowHeight() * GetScreenScale()));
+
+  XResizeWindow(mDisplay, mWindow, w, h);
+  XFlush(mDisplay);
+}
+
+void IGraphicsLinux::DrawResize()
+{
+  ActivateGLContext();
+  IGRAPHICS_DRAW_CLASS::DrawResize();
+  DeactivateGLContext();
+}
+
+#pragma mark - OpenGL
+
+bool IGraphicsLinux::CreateGLContext()
+{
+#ifdef IGRAPHICS_GL3
+  // a core profile context needs glXCreateContextAttribsARB, otherwise fall back to a legacy context, which is enough on Mesa's compatibility profile
+  auto glXCreateContextAttribsARB = (PFNGLXCREATECONTEXTATTRIBSARBPROC) glXGetProcAddressARB((const GLubyte*) "glXCreateContextAttribsARB");
+
+  if (glXCreateContextAttribsARB && HasGLXExtension(mDisplay, "GLX_ARB_create_context_profile"))
+  {
+    const int attribList[] = {
+      GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+      GLX_CONTEXT_MINOR_VERSION_ARB, 2,
+      GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+      None
+    };
+
+    mGLContext = glXCreateContextAttribsARB(mDisplay, mFBConfig, nullptr, True, attribList);
+  }
+#endif
+
+  if (!mGLContext)
+    mGLContext = glXCreateNewContext(mDisplay, mFBConfig, GLX_RGBA_TYPE, nullptr, True);
+
+  return mGLContext;
+}
+
+void IGraphicsLinux::DestroyGLContext()
+{
+  glXDestroyContext(mDisplay, mGLContext);
+  mGLContext = nullptr;
+}
+
+void IGraphicsLinux::ActivateGLContext()
+{
+  mStartDisplay = glXGetCurrentDisplay();
+  mStartGLContext = glXGetCurrentContext();
+  mStartDrawable = glXGetCurrentDrawable();
+  glXMakeCurrent(mDisplay, mWindow, mGLContext);
+}
+
+void IGraphicsLinux::DeactivateGLContext()
+{
+  if (mStartDisplay && mStartGLContext)
+    glXMakeCurrent(mStartDisplay, mStartDrawable, mStartGLContext); // return current ctxt to start
+  else
+    glXMakeCurrent(mDisplay, None, nullptr);
+}
+
+#pragma mark - VBlank
+
+void IGraphicsLinux::StartVBlankThread()
+{
+  if (pipe(mWakePipe))
+  {
+    mWakePipe[0] = mWakePipe[1] = -1;
+    return;
+  }
+
+  for (int fd : mWakePipe)
+  {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+
+#if defined IGRAPHICS_DISABLE_VSYNC
+  mVSYNCEnabled = false;
+#else
+  mVSYNCEnabled = HasGLXExtension(mDisplay, "GLX_OML_sync_control") || HasGLXExtension(mDisplay, "GLX_SGI_video_sync");
+#endif
+
+  mVBlankShutdown = false;
+  mVBlankCount = 0;
+  mVBlankPending = false;
+  mVBlankSkipUntil = 0;
+  mVBlankThread = std::thread(&IGraphicsLinux::VBlankRun, this);
+}
+
+void IGraphicsLinux::StopVBlankThread()
+{
+  if (mVBlankThread.joinable())
+  {
+    mVBlankShutdown = true;
+    mVBlankThread.join();
+  }
+
+  for (int& fd : mWakePipe)
+  {
+    if (fd >= 0)
+      close(fd);
+
+    fd = -1;
+  }
+}
+
+void IGraphicsLinux::VBlankRun()
+{
+  const auto interval = std::chrono::microseconds(1000000 / std::max(FPS(), 1));
+
+  // the thread has its own connection, since Xlib connections can't be shared between threads without XInitThreads()
+  Display* pDisplay = mVSYNCEnabled ? XOpenDisplay(nullptr) : nullptr;
+  GLXContext context = nullptr;
+
+  auto glXGetSyncValuesOML = (PFNGLXGETSYNCVALUESOMLPROC) glXGetProcAddressARB((const GLubyte*) "glXGetSyncValuesOML");
+  auto glXWaitForMscOML = (PFNGLXWAITFORMSCOMLPROC) glXGetProcAddressARB((const GLubyte*) "glXWaitForMscOML");
+  auto glXGetVideoSyncSGI = (PFNGLXGETVIDEOSYNCSGIPROC) glXGetProcAddressARB((const GLubyte*) "glXGetVideoSyncSGI");
+  auto glXWaitVideoSyncSGI = (PFNGLXWAITVIDEOSYNCSGIPROC) glXGetProcAddressARB((const GLubyte*) "glXWaitVideoSyncSGI");
+
+  const bool useOML = pDisplay && glXGetSyncValuesOML && glXWaitForMscOML && HasGLXExtension(pDisplay, "GLX_OML_sync_control");
+  bool useSGI = false;
+
+  if (pDisplay && !useOML && glXGetVideoSyncSGI && glXWaitVideoSyncSGI && HasGLXExtension(pDisplay, "GLX_SGI_video_sync"))
+  {
+    // SGI video sync waits on the current context, so the thread makes its own current on the window
+    GLXFBConfig config = ChooseFBConfig(pDisplay);
+
+    if (config)
+      context = glXCreateNewContext(pDisplay, config, GLX_RGBA_TYPE, nullptr, True);
+
+    useSGI = context && glXMakeCurrent(pDisplay, mWindow, context);
+  }
+
+  while (!mVBlankShutdown)
+  {
+    if (useOML)
+    {
+      int64_t ust, msc, sbc;
+
+      if (glXGetSyncValuesOML(pDisplay, mWindow, &ust, &msc, &sbc) && glXWaitForMscOML(pDisplay, mWindow, msc + 1, 0, 0, &ust, &msc, &sbc))
+      {
+        VBlankNotify();
+        continue;
+      }
+    }
+    else if (useSGI)
+    {
+      unsigned int count;
+
+      if (!glXGetVideoSyncSGI(&count) && !glXWaitVideoSyncSGI(2, (count + 1) % 2, &count))
+      {
+        VBlankNotify();
+        continue;
+      }
+    }
+
+    // no vsync, or waiting for it failed, e.g. while the window isn't mapped
+    std::this_thread::sleep_for(interval);
+    VBlankNotify();
+  }
+
+  if (context)
+  {
+    glXMakeCurrent(pDisplay, None, nullptr);
+    glXDestroyContext(pDisplay, context);
+  }
+
+  if (pDisplay)
+    XCloseDisplay(pDisplay);
+}
+
+void IGraphicsLinux::VBlankNotify()
+{
+  const int count = ++mVBlankCount;
+
+  // only one notification is queued, so that the pipe doesn't fill up if the main thread is busy
+  if (!mVBlankPending.exchange(true))
+  {
+    if (write(mWakePipe[1], &count, sizeof(count)) != sizeof(count))
+      mVBlankPending = false;
+  }
+}
+
+int IGraphicsLinux::GetPollFDs(int* pFDs, int maxFDs)
+{
+  int nFDs = 0;
+
+  if (mDisplay && nFDs < maxFDs)
+    pFDs[nFDs++] = ConnectionNumber(mDisplay);
+
+  if (mWakePipe[0] >= 0 && nFDs < maxFDs)
+    pFDs[nFDs++] = mWakePipe[0];
+
+  return nFDs;
+}
+
+void IGraphicsLinux::OnPollFD(int fd)
+{
+  if (!mDisplay)
+    return;
+
+  if (fd == mWakePipe[0])
+  {
+    int count = 0;
+    int vBlankCount = -1;
+
+    while (read(mWakePipe[0], &count, sizeof(count)) == sizeof(count))
+      vBlankCount = count;
+
+    mVBlankPending = false;
+    ProcessEvents();
+    FlushMouseMotion();
+
+    if (vBlankCount >= 0)
+      OnDisplayTimer(vBlankCount);
+  }
+  else
+  {
+    ProcessEvents();
+  }
+}
+
+void IGraphicsLinux::OnDisplayTimer(int vBlankCount)
+{
+  // Check the message vblank with the current one to see if we are way behind. If so, then throw these away.
+  const int msgCount = vBlankCount;
+  int curCount = mVBlankCount;
+
+  if (mVSYNCEnabled)
+  {
+    // skip until the actual vblank is at a certain number.
+    if (mVBlankSkipUntil != 0 && mVBlankSkipUntil > curCount)
+      return;
+
+    mVBlankSkipUntil = 0;
+
+    if (msgCount != curCount)
+      return; // we are late, just skip it until we can get a message soon after the vblank event.
+  }
+
+  if (mExposed)
+  {
+    SetAllControlsDirty();
+    mExposed = false;
+  }
+
+  IRECTList rects;
+
+  if (IsDirty(rects))
+  {
+    SetAllControlsClean();
+    ActivateGLContext();
+    Draw(rects);
+    glXSwapBuffers(mDisplay, mWindow);
+    DeactivateGLContext();
+
+    if (mVSYNCEnabled)
+    {
+      // Check and see if we are still in this frame.
+      curCount = mVBlankCount;
+
+      if (msgCount != curCount)
+        mVBlankSkipUntil = curCount + 1; // we are late, skip the next vblank to give us a breather.
+    }
+  }
+}
+
+#pragma mark - Events
+
+IMouseInfo IGraphicsLinux::GetMouseInfo(int x, int y, unsigned int state)
+{
+  IMouseInfo info;
+  const float scale = GetTotalScale();
+  info.x = mCursorX = x / scale;
+  info.y = mCursorY = y / scale;
+  info.ms = IMouseMod(state & Button1Mask, state & Button3Mask, state & ShiftMask, state & ControlMask, state & Mod1Mask);
+  return info;
+}
+
+void IGraphicsLinux::ProcessEvents()
+{
+  while (XPending(mDisplay))
+  {
+    XEvent event;
+    XNextEvent(mDisplay, &event);
+
+    if (event.type == MotionNotify)
+    {
+      // only the last position before the next frame is handled
+      mMotionPending = true;
+      mMotionX = event.xmotion.x;
+      mMotionY = event.xmotion.y;
+      mMotionState = event.xmotion.state;
+      continue;
+    }
+
+    // the other events are handled in order, after the motion that came before them
+    FlushMouseMotion();
+    HandleEvent(&event);
+  }
+}
+
+void IGraphicsLinux::FlushMouseMotion()
+{
+  if (!mMotionPending)
+    return;
+
+  mMotionPending = false;
+
+  if (!(mMotionState & (Button1Mask | Button3Mask)))
+  {
+    IMouseInfo info = GetMouseInfo(mMotionX, mMotionY, mMotionState);
+    OnMouseOver(info.x, info.y, info.ms);
+  }
+  else if (!IsInPlatformTextEntry())
+  {
+    const float oldX = mCursorX;
+    const float oldY = mCursorY;
+
+    IMouseInfo info = GetMouseInfo(mMotionX, mMotionY, mMotionState);
+
+    info.dX = info.x - oldX;
+    info.dY = info.y - oldY;
+
+    if (info.dX || info.dY)
+    {
+      std::vector<IMouseInfo> list{ info };
+      OnMouseDrag(list);
+
+      if (mCursorHidden && mCursorLock)
+      {
+        const float x = mHiddenCursorX;
+        const float y = mHiddenCursorY;
+
+        MoveMouseCursor(x, y);
+        mHiddenCursorX = x;
+        mHiddenCursorY = y;
+      }
+    }
+  }
+}
+
+void IGraphicsLinux::HandleEvent(void* pEvent)
+{
+  XEvent& event = *static_cast<XEvent*>(pEvent);
+
+  switch (event.type)
+  {
+    case Expose:
+    {
+      if (event.xexpose.count == 0)
+        mExposed = true;
+
+      break;
+    }
+    case MapNotify:
+      SetOccluded(false);
+      break;
+    case UnmapNotify:
+      SetOccluded(true);
+      break;
+    case ButtonPress:
+    {
+      const XButtonEvent& button = event.xbutton;
+
+      // buttons 4 to 7 are the vertical and horizontal scroll wheel
+      if (button.button == Button4 || button.button == Button5)
+      {
+        IMouseInfo info = GetMouseInfo(button.x, button.y, button.state);
+        OnMouseWheel(info.x, info.y, info.ms, button.button == Button4 ? 1.f : -1.f);
+        break;
+      }
+
+      if (button.button != Button1 && button.button != Button3)
+        break;
+
+      XSetInputFocus(mDisplay, mWindow, RevertToParent, button.time); // gets the keyboard focus when the user clicks in the window
+
+      // the state of the event is from before the press, so add the button that was pressed
+      const unsigned int state = button.state | (button.button == Button1 ? Button1Mask : Button3Mask);
+      IMouseInfo info = GetMouseInfo(button.x, button.y, state);
+
+      const bool isDoubleClick = static_cast<int>(button.button) == mLastClickButton && button.time - mLastClickTime < kDoubleClickTimeMs
+                              && std::fabs(info.x - mLastClickX) < kDoubleClickDistance && std::fabs(info.y - mLastClickY) < kDoubleClickDistance;
+
+      if (isDoubleClick)
+      {
+        mLastClickButton = 0; // a third click starts again
+        OnMouseDblClick(info.x, info.y, info.ms);
+      }
+      else
+      {
+        mLastClickButton = button.button;
+        mLastClickTime = button.time;
+        mLastClickX = info.x;
+        mLastClickY = info.y;
+
+        std::vector<IMouseInfo> list{ info };
+        OnMouseDown(list);
+      }
+      break;
+    }
+    case ButtonRelease:
+    {
+      const XButtonEvent& button = event.xbutton;
+
+      if (button.button != Button1 && button.button != Button3)
+        break;
+
+      IMouseInfo info = GetMouseInfo(button.x, button.y, button.state);
+      std::vector<IMouseInfo> list{ info };
+      OnMouseUp(list);
+      break;
+    }
+    case LeaveNotify:
+    {
+      // the pointer is grabbed while a button is down, so leaving the window during a drag doesn't end it
+      if (event.xcrossing.mode == NotifyNormal && !(event.xcrossing.state & (Button1Mask | Button3Mask)))
+        OnMouseOut();
+
+      break;
+    }
+    case KeyPress:
+    case KeyRelease:
+    {
+      XKeyEvent& key = event.xkey;
+
+      // a key that repeats sends a release and a press with the same time, which is skipped so that it is a repeated key down
+      if (event.type == KeyRelease && XEventsQueued(mDisplay, QueuedAfterReading))
+      {
+        XEvent next;
+        XPeekEvent(mDisplay, &next);
+
+        if (next.type == KeyPress && next.xkey.time == key.time && next.xkey.keycode == key.keycode)
+          break;
+      }
+
+      KeySym keySym = NoSymbol;
+      char latin1[8];
+      XLookupString(&key, latin1, sizeof(latin1), &keySym, nullptr);
+
+      char utf8[8];
+      GetUTF8FromKeySym(keySym, utf8, sizeof(utf8));
+
+      IKeyPress keyPress { utf8, GetVKFromKeySym(XLookupKeysym(&key, 0)),
+                           static_cast<bool>(key.state & ShiftMask),
+                           static_cast<bool>(key.state & ControlMask),
+                           static_cast<bool>(key.state & Mod1Mask) };
+
+      const float scale = GetTotalScale();
+
+      if (event.type == KeyPress)
+        OnKeyDown(key.x / scale, key.y / scale, keyPress);
+      else
+        OnKeyUp(key.x / scale, key.y / scale, keyPress);
+
+      break;
+    }
+    case SelectionRequest:
+      HandleSelectionRequest(&event);
+      break;
+    case SelectionClear:
+      mClipboardText.Set("");
+      break;
+    default:
+      break;
+  }
+}
+
+#pragma mark - Mouse cursor
+
+void IGraphicsLinux::HideMouseCursor(bool hide, bool lock)
+{
+  if (mCursorHidden == hide || !mWindow)
+    return;
+
+  if (hide)
+  {
+    mHiddenCursorX = mCursorX;
+    mHiddenCursorY = mCursorY;
+
+    if (!mBlankCursor)
+    {
+      const char data = 0;
+      XColor black = {};
+      Pixmap pixmap = XCreateBitmapFromData(mDisplay, mWindow, &data, 1, 1);
+      mBlankCursor = XCreatePixmapCursor(mDisplay, pixmap, pixmap, &black, &black, 0, 0);
+      XFreePixmap(mDisplay, pixmap);
+    }
+
+    XDefineCursor(mDisplay, mWindow, mBlankCursor);
+    mCursorHidden = true;
+    mCursorLock = lock && !mTabletInput;
+  }
+  else
+  {
+    if (mCursorLock)
+      MoveMouseCursor(mHiddenCursorX, mHiddenCursorY);
+
+    mCursorHidden = false;
+    mCursorLock = false;
+    OnSetCursor();
+  }
+
+  XFlush(mDisplay);
+}
+
+void IGraphicsLinux::MoveMouseCursor(float x, float y)
+{
+  if (mTabletInput || !mWindow)
+    return;
+
+  const float scale = GetTotalScale();
+
+  XWarpPointer(mDisplay, None, mWindow, 0, 0, 0, 0, static_cast<int>(std::round(x * scale)), static_cast<int>(std::round(y * scale)));
+  XFlush(mDisplay);
+
+  mHiddenCursorX = mCursorX = x;
+  mHiddenCursorY = mCursorY = y;
+}
+
+ECursor IGraphicsLinux::SetMouseCursor(ECursor cursorType)
+{
+  if (mWindow && !mCursorHidden)
+  {
+    unsigned int shape;
+
+    switch (cursorType)
+    {
+      case ECursor::ARROW:            shape = XC_left_ptr;            break;
+      case ECursor::IBEAM:            shape = XC_xterm;               break;
+      case ECursor::WAIT:             shape = XC_watch;               break;
+      case ECursor::CROSS:            shape = XC_crosshair;           break;
+      case ECursor::UPARROW:          shape = XC_sb_up_arrow;         break;
+      case ECursor::SIZENWSE:         shape = XC_bottom_right_corner; break;
+      case ECursor::SIZENESW:         shape = XC_bottom_left_corner;  break;
+      case ECursor::SIZEWE:           shape = XC_sb_h_double_arrow;   break;
+      case ECursor::SIZENS:           shape = XC_sb_v_double_arrow;   break;
+      case ECursor::SIZEALL:          shape = XC_fleur;               break;
+      case ECursor::INO:              shape = XC_X_cursor;            break;
+      case ECursor::HAND:             shape = XC_hand2;               break;
+      case ECursor::APPSTARTING:      shape = XC_watch;               break;
+      case ECursor::HELP:             shape = XC_question_arrow;      break;
+      default:                        shape = XC_left_ptr;
+    }
+
+    Cursor& cursor = mCursors[static_cast<int>(cursorType)];
+
+    if (!cursor)
+      cursor = XCreateFontCursor(mDisplay, shape);
+
+    XDefineCursor(mDisplay, mWindow, cursor);
+    XFlush(mDisplay);
+  }
+
+  return IGraphics::SetMouseCursor(cursorType);
+}
+
+void IGraphicsLinux::GetMouseLocation(float& x, float&y) const
+{
+  x = y = 0.f;
+
+  if (!mWindow)
+    return;
+
+  Window root, child;
+  int rootX, rootY, winX, winY;
+  unsigned int mask;
+
+  if (XQueryPointer(mDisplay, mWindow, &root, &child, &rootX, &rootY, &winX, &winY, &mask))
+  {
+    const float scale = GetTotalScale();
+    x = winX / scale;
+    y = winY / scale;
+  }
+}
+
+#pragma mark - Clipboard
+
+bool IGraphicsLinux::SetTextInClipboard(const char* str)
+{
+  if (!mWindow)
+    return false;
+
+  mClipboardText.Set(str);
+  const Atom clipboard = XInternAtom(mDisplay, "CLIPBOARD", False);
+  XSetSelectionOwner(mDisplay, clipboard, mWindow, CurrentTime);
+  XFlush(mDisplay);
+
+  return XGetSelectionOwner(mDisplay, clipboard) == mWindow;
+}
+
+bool IGraphicsLinux::GetTextFromClipboard(WDL_String& str)
+{
+  str.Set("");
+
+  if (!mWindow)
+    return false;
+
+  const Atom clipboard = XInternAtom(mDisplay, "CLIPBOARD", False);
+  const Window owner = XGetSelectionOwner(mDisplay, clipboard);
+
+  if (owner == None)
+    return false;
+
+  if (owner == mWindow)
+  {
+    str.Set(mClipboardText.Get());
+    return true;
+  }
+
+  const Atom utf8String = XInternAtom(mDisplay, "UTF8_STRING", False);
+  const Atom property = XInternAtom(mDisplay, "IPLUG_CLIPBOARD", False);
+  XConvertSelection(mDisplay, clipboard, utf8String, property, mWindow, CurrentTime);
+  XFlush(mDisplay);
+
+  // wait a short while for the owner to reply, handling the other events as they arrive
+  const auto timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+
+  while (std::chrono::steady_clock::now() < timeout)
+  {
+    XEvent event;
+
+    if (XCheckTypedWindowEvent(mDisplay, mWindow, SelectionNotify, &event))
+    {
+      if (event.xselection.property == None)
+        return false;
+
+      Atom type;
+      int format;
+      unsigned long nItems, bytesAfter;
+      unsigned char* pData = nullptr;
+
+      if (XGetWindowProperty(mDisplay, mWindow, property, 0, 1 << 20, True, AnyPropertyType, &type, &format, &nItems, &bytesAfter, &pData) == Success && pData)
+      {
+        str.Set(reinterpret_cast<const char*>(pData), static_cast<int>(nItems));
+        XFree(pData);
+        return true;
+      }
+
+      return false;
+    }
+
+    pollfd pfd { ConnectionNumber(mDisplay), POLLIN, 0 };
+    poll(&pfd, 1, 10);
+  }
+
+  return false;
+}
+
+void IGraphicsLinux::HandleSelectionRequest(void* pEvent)
+{
+  const XSelectionRequestEvent& request = static_cast<XEvent*>(pEvent)->xselectionrequest;
+  const Atom utf8String = XInternAtom(mDisplay, "UTF8_STRING", False);
+  const Atom targets = XInternAtom(mDisplay, "TARGETS", False);
+
+  XSelectionEvent reply = {};
+  reply.type = SelectionNotify;
+  reply.display = request.display;
+  reply.requestor = request.requestor;
+  reply.selection = request.selection;
+  reply.target = request.target;
+  reply.time = request.time;
+  reply.property = None;
+
+  if (request.target == targets)
+  {
+    const Atom supported[] = { targets, utf8String, XA_STRING };
+    XChangeProperty(mDisplay, request.requestor, request.property, XA_ATOM, 32, PropModeReplace,
+                    reinterpret_cast<const unsigned char*>(supported), 3);
+    reply.property = request.property;
+  }
+  else if (request.target == utf8String || request.target == XA_STRING)
+  {
+    XChangeProperty(mDisplay, request.requestor, request.property, request.target, 8, PropModeReplace,
+                    reinterpret_cast<const unsigned char*>(mClipboardText.Get()), mClipboardText.GetLength());
+    reply.property = request.property;
+  }
+
+  XSendEvent(mDisplay, request.requestor, False, 0, reinterpret_cast<XEvent*>(&reply));
+  XFlush(mDisplay);
+}
+
+#pragma mark - Dialogs
+
+EMsgBoxResult IGraphicsLinux::ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHandlerFunc completionHandler)
+{
+  ReleaseMouseCapture();
+
+  // zenity can only show one or two buttons, so the three button boxes are shown as two buttons and cancel is the extra button
+  WDL_String cmd("zenity ");
+
+  switch (type)
+  {
+    case kMB_OK:          cmd.Append("--info "); break;
+    case kMB_OKCANCEL:    cmd.Append("--question --ok-label=OK --cancel-label=Cancel "); break;
+    case kMB_YESNOCANCEL: cmd.Append("--question --ok-label=Yes --cancel-label=No --extra-button=Cancel "); break;
+    case kMB_YESNO:       cmd.Append("--question --ok-label=Yes --cancel-label=No "); break;
+    case kMB_RETRYCANCEL: cmd.Append("--question --ok-label=Retry --cancel-label=Cancel "); break;
+    default:              cmd.Append("--info "); break;
+  }
+
+  cmd.Append("--title=");
+  AppendShellQuoted(cmd, caption ? caption : "");
+  cmd.Append("--text=");
+  AppendShellQuoted(cmd, str ? str : "");
+  cmd.Append("2>/dev/null");
+
+  WDL_String output;
+  const int status = RunCommand(cmd.Get(), output);
+  EMsgBoxResult result = kCANCEL;
+
+  if (status == 0)
+  {
+    switch (type)
+    {
+      case kMB_YESNOCANCEL:
+      case kMB_YESNO:       result = kYES; break;
+      case kMB_RETRYCANCEL: result = kRETRY; break;
+      default:              result = kOK; break;
+    }
+  }
+  else if (status == 1 && output.GetLength() == 0 && (type == kMB_YESNOCANCEL || type == kMB_YESNO))
+  {
+    result = kNO; // the extra button prints its label and exits with 1 too
+  }
+  else if (status < 0)
+  {
+    DBGMSG("IGraphicsLinux: message box not shown, zenity is not available: %s\n", str);
+  }
+
+  if (completionHandler)
+    completionHandler(result);
+
+  return result;
+}
+
+void IGraphicsLinux::PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext, IFileDialogCompletionHandlerFunc completionHandler)
+{
+  ReleaseMouseCapture();
+
+  WDL_String cmd("zenity --file-selection ");
+
+  if (action == EFileAction::Save)
+    cmd.Append("--save --confirm-overwrite ");
+
+  if (path.GetLength() || fileName.GetLength())
+  {
+    WDL_String start(path.Get());
+
+    if (start.GetLength() && start.Get()[start.GetLength() - 1] != '/')
+      start.Append("/");
+
+    start.Append(fileName.Get());
+    cmd.Append("--filename=");
+    AppendShellQuoted(cmd, start.Get());
+  }
+
+  if (CStringHasContents(ext))
+  {
+    // ext is a space separated list of extensions without the dots
+    WDL_String filter;
+    WDL_String exts(ext);
+
+    for (char* pExt = strtok(exts.Get(), " "); pExt; pExt = strtok(nullptr, " "))
+      filter.AppendFormatted(64, "*.%s ", pExt);
+
+    cmd.Append("--file-filter=");
+    AppendShellQuoted(cmd, filter.Get());
+  }
+
+  cmd.Append("2>/dev/null");
+
+  WDL_String output;
+
+  if (RunCommand(cmd.Get(), output) == 0 && output.GetLength())
+  {
+    fileName.Set(output.Get());
+    path.Set(output.Get());
+    path.remove_filepart(true);
+  }
+  else
+  {
+    fileName.Set("");
+  }
+
+  if (completionHandler)
+    completionHandler(fileName, path);
+}
+
+void IGraphicsLinux::PromptForDirectory(WDL_String& dir, IFileDialogCompletionHandlerFunc completionHandler)
+{
+  ReleaseMouseCapture();
+
+  WDL_String cmd("zenity --file-selection --directory ");
+
+  if (dir.GetLength())
+  {
+    WDL_String start(dir.Get());
+
+    if (start.Get()[start.GetLength() - 1] != '/')
+      start.Append("/");
+
+    cmd.Append("--filename=");
+    AppendShellQuoted(cmd, start.Get());
+  }
+
+  cmd.Append("2>/dev/null");
+
+  WDL_String output;
+
+  if (RunCommand(cmd.Get(), output) == 0 && output.GetLength())
+    dir.Set(output.Get());
+  else
+    dir.Set("");
+
+  if (completionHandler)
+  {
+    WDL_String fileName;
+    completionHandler(fileName, dir);
+  }
+}
+
+bool IGraphicsLinux::PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func)
+{
+  ReleaseMouseCapture();
+
+  WDL_String cmd("zenity --color-selection ");
+  cmd.AppendFormatted(64, "--color='rgb(%d,%d,%d)' ", color.R, color.G, color.B);
+
+  if (CStringHasContents(str))
+  {
+    cmd.Append("--title=");
+    AppendShellQuoted(cmd, str);
+  }
+
+  cmd.Append("2>/dev/null");
+
+  WDL_String output;
+  int r, g, b;
+
+  if (RunCommand(cmd.Get(), output) != 0 || (sscanf(output.Get(), "rgb(%d,%d,%d)", &r, &g, &b) != 3 && sscanf(output.Get(), "rgba(%d,%d,%d", &r, &g, &b) != 3))
+    return false;
+
+  color.R = Clip(r, 0, 255);
+  color.G = Clip(g, 0, 255);
+  color.B = Clip(b, 0, 255);
+
+  if (func)
+    func(color);
+
+  return true;
+}
+
+bool IGraphicsLinux::OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure)
+{
+  if (confirmMsg && ShowMessageBox(confirmMsg, msgWindowTitle, kMB_YESNO, nullptr) != kYES)
+    return false;
+
+  WDL_String cmd("xdg-open ");
+  AppendShellQuoted(cmd, url);
+  cmd.Append(">/dev/null 2>&1 &");
+
+  if (system(cmd.Get()) == 0)
+    return true;
+
+  if (errMsgOnFailure)
+    ShowMessageBox(errMsgOnFailure, msgWindowTitle, kMB_OK, nullptr);
+
+  return false;
+}
+
+bool IGraphicsLinux::RevealPathInExplorerOrFinder(WDL_String& path, bool select)
+{
+  if (!path.GetLength())
+    return false;
+
+  // the file managers have no common way to select a file, so its folder is opened
+  WDL_String dir(path.Get());
+
+  if (select)
+    dir.remove_filepart();
+
+  WDL_String cmd("xdg-open ");
+  AppendShellQuoted(cmd, dir.Get());
+  cmd.Append(">/dev/null 2>&1 &");
+
+  return system(cmd.Get()) == 0;
+}
+
+#pragma mark - Fonts
+
+PlatformFontPtr IGraphicsLinux::LoadPlatformFont(const char* fontID, const char* fileNameOrResID)
+{
+  WDL_String fullPath;
+  const EResourceLocation fontLocation = LocateResource(fileNameOrResID, "ttf", fullPath, GetBundleID(), GetWinModuleHandle(), GetSharedResourcesSubPath());
+
+  if (fontLocation == kNotFound)
+    return nullptr;
+
+  return PlatformFontPtr(new FileFont(fullPath.Get()));
+}
+
+PlatformFontPtr IGraphicsLinux::LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style)
+{
+  if (!FcInit())
+    return nullptr;
+
+  FcPattern* pPattern = FcNameParse(reinterpret_cast<const FcChar8*>(fontName));
+
+  if (!pPattern)
+    return nullptr;
+
+  FcPatternAddInteger(pPattern, FC_WEIGHT, style == ETextStyle::Bold ? FC_WEIGHT_BOLD : FC_WEIGHT_REGULAR);
+  FcPatternAddInteger(pPattern, FC_SLANT, style == ETextStyle::Italic ? FC_SLANT_ITALIC : FC_SLANT_ROMAN);
+  FcConfigSubstitute(nullptr, pPattern, FcMatchPattern);
+  FcDefaultSubstitute(pPattern);
+
+  FcResult result;
+  FcPattern* pMatch = FcFontMatch(nullptr, pPattern, &result);
+  PlatformFontPtr font;
+
+  if (pMatch)
+  {
+    FcChar8* pFile = nullptr;
+    int faceIdx = 0;
+    FcPatternGetInteger(pMatch, FC_INDEX, 0, &faceIdx); // the face in a collection
+
+    if (FcPatternGetString(pMatch, FC_FILE, 0, &pFile) == FcResultMatch)
+      font = PlatformFontPtr(new FileFont(reinterpret_cast<const char*>(pFile), true, faceIdx));
+
+    FcPatternDestroy(pMatch);
+  }
+
+  FcPatternDestroy(pPattern);
+  return font;
+}
+
+PlatformFontPtr IGraphicsLinux::LoadPlatformFont(const char* fontID, void* pData, int dataSize)
+{
+  return PlatformFontPtr(new MemoryFont(pData, dataSize));
+}
+
+// the X headers' macros clash with the names used by the drawing backend
+#undef None
+#undef Bool
+#undef Status
+#undef True
+#undef False
+#undef Always
+#undef Success
+
+#ifndef NO_IGRAPHICS
+#if defined IGRAPHICS_NANOVG
+  #include "IGraphicsNanoVG.cpp"
+  #include "nanovg.c"
+#else
+  #error IGraphicsLinux requires IGRAPHICS_NANOVG
+#endif
+#endif
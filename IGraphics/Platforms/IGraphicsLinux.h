@@ -10,49 +10,143 @@
 
 #pragma once
 
+#include <atomic>
+#include <thread>
+
+#include "IPlugPlatform.h"
+
 #include "IGraphics_select.h"
 
+#if !defined IGRAPHICS_NANOVG || !(defined IGRAPHICS_GL2 || defined IGRAPHICS_GL3)
+  #error IGraphicsLinux requires IGRAPHICS_NANOVG with IGRAPHICS_GL2 or IGRAPHICS_GL3
+#endif
+
+// Xlib and GLX types, so that their macros don't leak into the plug-in's code
+struct _XDisplay;
+struct __GLXcontextRec;
+struct __GLXFBConfigRec;
+
 BEGIN_IPLUG_NAMESPACE
 BEGIN_IGRAPHICS_NAMESPACE
 
-/** IGraphics platform class for linux
-*   @ingroup PlatformClasses
-*/
+/** IGraphics platform class for Linux, which draws with OpenGL into an X11 window, embedded in the window of the host
+ *
+ * OpenWindow() takes the X11 window id of the parent, e.g. from VST3's kPlatformTypeX11EmbedWindowID. The UI has its own connection to the X server.
+ * X11 doesn't call the UI itself, so the host's run loop must watch the file descriptors from GetPollFDs() and call OnPollFD() on the main thread when one is readable.
+ * Like the vblank thread of IGraphicsWin, a thread waits for the display's vertical blank with GLX_OML_sync_control, or GLX_SGI_video_sync, and wakes the main thread,
+ * which then handles the X events and draws at most one frame. The mouse motion events that arrive between two frames are coalesced into one.
+ * Without either extension, or with IGRAPHICS_DISABLE_VSYNC defined, the thread wakes the main thread at the frame rate instead.
+ * @ingroup PlatformClasses */
 class IGraphicsLinux final : public IGRAPHICS_DRAW_CLASS
 {
+  class FileFont;
+  class MemoryFont;
 public:
   IGraphicsLinux(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
-  virtual ~IGraphicsLinux);
+  ~IGraphicsLinux();
 
-  void* OpenWindow(void* pWindow) override;
+  void* OpenWindow(void* pParent) override;
   void CloseWindow() override;
-  bool WindowIsOpen() override;
+  void* GetWindow() override { return reinterpret_cast<void*>(mWindow); }
+  bool WindowIsOpen() override { return mWindow; }
   void PlatformResize(bool parentHasResized) override;
+  void DrawResize() override; // overriden here to deal with GL graphics context capture
+
+  int GetPollFDs(int* pFDs, int maxFDs) override;
+  void OnPollFD(int fd) override;
 
-  void HideMouseCursor() override;
-  void ShowMouseCursor() override;
+  void HideMouseCursor(bool hide, bool lock) override;
+  void MoveMouseCursor(float x, float y) override;
+  ECursor SetMouseCursor(ECursor cursorType) override;
+  void GetMouseLocation(float& x, float&y) const override;
 
   EMsgBoxResult ShowMessageBox(const char* str, const char* caption, EMsgBoxType type, IMsgBoxCompletionHandlerFunc completionHandler) override;
-  void ForceEndUserEdit() override;
+  void ForceEndUserEdit() override {}
 
-  const char* GetPlatformAPIStr() override;
+  const char* GetPlatformAPIStr() override { return "X11"; }
 
-  void UpdateTooltips() override;
+  void UpdateTooltips() override {}
 
   bool RevealPathInExplorerOrFinder(WDL_String& path, bool select) override;
-  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action,  const char* ext, IColorPickerHandlerFunc func) override;
-  bool PromptForColor(IColor& color, const char* str) override;
+  void PromptForFile(WDL_String& fileName, WDL_String& path, EFileAction action, const char* ext, IFileDialogCompletionHandlerFunc completionHandler) override;
+  void PromptForDirectory(WDL_String& dir, IFileDialogCompletionHandlerFunc completionHandler) override;
+  bool PromptForColor(IColor& color, const char* str, IColorPickerHandlerFunc func) override;
 
   bool OpenURL(const char* url, const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure) override;
 
-  static int GetUserOSVersion();
   bool GetTextFromClipboard(WDL_String& str) override;
-  bool SetTextInClipboard(const char* str) override { return false; } // TODO
+  bool SetTextInClipboard(const char* str) override;
+
+  const char* GetBundleID() override { return mBundleID.Get(); }
+  void SetBundleID(const char* bundleID) { mBundleID.Set(bundleID); }
 
 protected:
-  IPopupMenu* CreatePlatformPopupMenu(const IPopupMenu& menu, IRECT& bounds) override;
-  void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override;
-}
+  IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT bounds, bool& isAsync) override { return nullptr; }
+  void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override {}
+
+private:
+  /** Called on the main thread for each vblank the thread has seen, or at the frame rate without vsync
+   * @param vBlankCount allows redraws to be paced by the vblank, see IGraphicsWin::OnDisplayTimer() */
+  void OnDisplayTimer(int vBlankCount);
+
+  /** Handle the X events that have arrived, coalescing mouse motion */
+  void ProcessEvents();
+  void HandleEvent(void* pEvent);
+  void FlushMouseMotion();
+  void HandleSelectionRequest(void* pEvent);
+
+  IMouseInfo GetMouseInfo(int x, int y, unsigned int state);
+
+  bool CreateGLContext();
+  void DestroyGLContext();
+  void ActivateGLContext() override;
+  void DeactivateGLContext() override;
+
+  void StartVBlankThread();
+  void StopVBlankThread();
+  void VBlankRun();
+  void VBlankNotify();
+
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fileNameOrResID) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, const char* fontName, ETextStyle style) override;
+  PlatformFontPtr LoadPlatformFont(const char* fontID, void* pData, int dataSize) override;
+  void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
+
+  _XDisplay* mDisplay = nullptr;
+  unsigned long mWindow = 0;
+  unsigned long mParentWindow = 0;
+  unsigned long mColormap = 0;
+  __GLXFBConfigRec* mFBConfig = nullptr;
+  __GLXcontextRec* mGLContext = nullptr;
+  _XDisplay* mStartDisplay = nullptr; // the context that was current before ActivateGLContext()
+  __GLXcontextRec* mStartGLContext = nullptr;
+  unsigned long mStartDrawable = 0;
+
+  std::thread mVBlankThread;
+  std::atomic<bool> mVBlankShutdown {false}; // flag to indicate that the vsync thread should shutdown
+  std::atomic<int> mVBlankCount {0}; // running count of vblank events since the window was opened
+  std::atomic<bool> mVBlankPending {false}; // a notification has been written to the pipe and not read yet
+  int mVBlankSkipUntil = 0; // skip vblanks if the last frame took too long, to keep the main thread clear when overloaded
+  bool mVSYNCEnabled = false;
+  int mWakePipe[2] = { -1, -1 }; // written by the vblank thread, watched by the host's run loop
+
+  bool mMotionPending = false; // the last motion event, which is handled once the other events have been, or at the frame
+  int mMotionX = 0;
+  int mMotionY = 0;
+  unsigned int mMotionState = 0;
+  unsigned long mLastClickTime = 0; // to detect double clicks, which X11 doesn't
+  int mLastClickButton = 0;
+  float mLastClickX = 0.f;
+  float mLastClickY = 0.f;
+  float mHiddenCursorX = 0.f;
+  float mHiddenCursorY = 0.f;
+  bool mExposed = false;
+
+  unsigned long mCursors[16] = {}; // X cursors for each ECursor, created when first used
+  unsigned long mBlankCursor = 0;
+  WDL_String mClipboardText; // the text offered while we own the CLIPBOARD selection
+  WDL_String mBundleID;
+};
 
 END_IGRAPHICS_NAMESPACE
 END_IPLUG_NAMESPACE
@@ -99,9 +99,15 @@ void* IGraphicsMac::OpenWindow(void* pParent)
     
   OnViewInitialized([pView layer]);
   SetScreenScale([[NSScreen mainScreen] backingScaleFactor]);
-  GetDelegate()->LayoutUI(this);
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
   UpdateTooltips();
-  GetDelegate()->OnUIOpen();
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
   
   if (pParent)
   {
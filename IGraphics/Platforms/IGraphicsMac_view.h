@@ -117,6 +117,8 @@ using namespace igraphics;
 {
   CVDisplayLinkRef mDisplayLink;
   dispatch_source_t mDisplaySource;
+  CFTimeInterval mRefreshPeriod; // of the display link's screen, in seconds
+  CFTimeInterval mLastFrameTime; // see isFrameDue
   NSTimer* mTimer;
   
   NSTrackingArea* mTrackingArea;
@@ -126,6 +128,10 @@ using namespace igraphics;
   bool mMouseOutDuringDrag;
   IRECTList mDirtyRects;
   IColorPickerHandlerFunc mColorPickerFunc;
+#ifdef IGRAPHICS_RENDER_THREAD
+  NSMutableArray* mDeferredEvents; // events that arrived while a frame was being drawn, with their selectors
+  BOOL mProcessingDeferredEvents;
+#endif
 @public
   IGraphicsMac* mGraphics; // OBJC instance variables have to be pointers
 }
@@ -138,7 +144,17 @@ using namespace igraphics;
 - (void) drawRect: (NSRect) bounds;
 - (void) render;
 - (void) killTimer;
+#ifdef IGRAPHICS_RENDER_THREAD
+- (void) onDisplayLink;
+- (void) renderOnDisplayLinkThread;
+- (BOOL) lockOrDeferEvent: (NSEvent*) pEvent : (SEL) selector : (std::unique_lock<std::recursive_mutex>&) lock;
+- (void) processDeferredEvents;
+#endif
 - (void) onTimer: (NSTimer*) pTimer;
+- (void) windowOcclusionChanged: (NSNotification*) pNotification;
+- (void) windowScreenChanged: (NSNotification*) pNotification;
+- (void) updateDisplayLink;
+- (BOOL) isFrameDue;
 - (void) viewDidChangeEffectiveAppearance;
 //mouse
 - (void) getMouseXY: (NSEvent*) pEvent : (float&) x : (float&) y;
@@ -375,6 +375,16 @@ static int MacKeyEventToVK(NSEvent* pEvent, int& flag)
 
 extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
 
+#ifdef IGRAPHICS_RENDER_THREAD
+// While a frame is being drawn on the render thread, the event is queued rather than waiting for it, otherwise the controls stay locked until it has been handled
+#define IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent) \
+  std::unique_lock<std::recursive_mutex> renderLock; \
+  if (mGraphics && ![self lockOrDeferEvent: pEvent : _cmd : renderLock]) \
+    return
+#else
+#define IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent)
+#endif
+
 @implementation IGRAPHICS_VIEW
 
 - (id) initWithIGraphics: (IGraphicsMac*) pGraphics
@@ -386,6 +396,10 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   self = [super initWithFrame:r];
   
   mMouseOutDuringDrag = false;
+#ifdef IGRAPHICS_RENDER_THREAD
+  mDeferredEvents = [[NSMutableArray alloc] init];
+  mProcessingDeferredEvents = NO;
+#endif
 
   self.wantsLayer = YES;
   self.layer.opaque = YES;
@@ -397,6 +411,15 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
   self.layer = [CAMetalLayer new];
   [(CAMetalLayer*)[self layer] setPixelFormat:MTLPixelFormatBGRA8Unorm];
   ((CAMetalLayer*) self.layer).device = MTLCreateSystemDefaultDevice();
+
+  if (@available(macOS 10.13.2, *))
+  {
+    // triple buffered and presented at the vblank, so a frame drawn just after the display link fires is shown at the next refresh without waiting for a drawable
+    CAMetalLayer* pMetalLayer = (CAMetalLayer*) self.layer;
+    pMetalLayer.maximumDrawableCount = 3;
+    pMetalLayer.displaySyncEnabled = YES;
+    pMetalLayer.presentsWithTransaction = NO;
+  }
   
   #elif defined IGRAPHICS_GL
   NSOpenGLPixelFormatAttribute profile = NSOpenGLProfileVersionLegacy;
@@ -450,23 +473,168 @@ extern StaticStorage<CoreTextFontDescriptor> sFontDescriptorCache;
 
 static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeStamp* now, const CVTimeStamp* outputTime, CVOptionFlags flagsIn, CVOptionFlags* flagsOut, void* displayLinkContext)
 {
+#ifdef IGRAPHICS_RENDER_THREAD
+  [(IGRAPHICS_VIEW*) displayLinkContext onDisplayLink];
+#else
   dispatch_source_t source = (dispatch_source_t) displayLinkContext;
   dispatch_source_merge_data(source, 1);
+#endif
   
   return kCVReturnSuccess;
 }
 
+#ifdef IGRAPHICS_RENDER_THREAD
+- (void) onDisplayLink
+{
+  @autoreleasepool
+  {
+    [self renderOnDisplayLinkThread];
+  }
+
+  // the main thread handles the events that arrived while drawing
+  dispatch_source_merge_data(mDisplaySource, 1);
+}
+
+- (void) renderOnDisplayLinkThread
+{
+  if (![self isFrameDue])
+    return;
+
+  // if the main thread is using the controls, skip this frame rather than holding up the display link
+  std::unique_lock<std::recursive_mutex> renderLock(mGraphics->GetRenderMutex(), std::try_to_lock);
+
+  if (!renderLock.owns_lock())
+    return;
+
+  IRECTList rects;
+
+  if (mGraphics->IsDirty(rects))
+  {
+    mGraphics->SetAllControlsClean();
+
+    CGLContextObj cglContext = [[self openGLContext] CGLContextObj];
+    CGLLockContext(cglContext);
+    [[self openGLContext] makeCurrentContext];
+    mGraphics->Draw(rects);
+    [[self openGLContext] flushBuffer];
+    CGLUnlockContext(cglContext);
+  }
+}
+
+- (BOOL) lockOrDeferEvent: (NSEvent*) pEvent : (SEL) selector : (std::unique_lock<std::recursive_mutex>&) lock
+{
+  lock = std::unique_lock<std::recursive_mutex>(mGraphics->GetRenderMutex(), std::defer_lock);
+
+  // events are handled in order, so once one is queued the rest are too
+  const bool mustQueue = [mDeferredEvents count] > 0 && !mProcessingDeferredEvents;
+
+  if (mustQueue || !lock.try_lock())
+  {
+    [mDeferredEvents addObject: @[pEvent, NSStringFromSelector(selector)]];
+    return NO;
+  }
+
+  return YES;
+}
+
+- (void) processDeferredEvents
+{
+  if ([mDeferredEvents count] == 0 || !mGraphics)
+    return;
+
+  std::unique_lock<std::recursive_mutex> renderLock(mGraphics->GetRenderMutex(), std::try_to_lock);
+
+  if (!renderLock.owns_lock())
+    return;
+
+  NSArray* pEvents = [mDeferredEvents copy];
+  [mDeferredEvents removeAllObjects];
+  mProcessingDeferredEvents = YES;
+
+  for (NSArray* pItem in pEvents)
+    [self performSelector: NSSelectorFromString(pItem[1]) withObject: pItem[0]];
+
+  mProcessingDeferredEvents = NO;
+  [pEvents release];
+}
+#endif
+
 - (void) onTimer: (NSTimer*) pTimer
 {
   [self render];
 }
 
+- (void) windowOcclusionChanged: (NSNotification*) pNotification
+{
+  if (mGraphics)
+  {
+    IGRAPHICS_RENDER_LOCK(mGraphics);
+    mGraphics->SetOccluded(!([[self window] occlusionState] & NSWindowOcclusionStateVisible));
+  }
+
+  [self updateDisplayLink];
+}
+
+- (void) windowScreenChanged: (NSNotification*) pNotification
+{
+  [self updateDisplayLink];
+}
+
+// follows the window to the screen it is on, and only runs while it can be seen, so that an idle or hidden UI costs nothing
+- (void) updateDisplayLink
+{
+#ifdef IGRAPHICS_CVDISPLAYLINK
+  if (!mDisplayLink)
+    return;
+
+  NSWindow* pWindow = [self window];
+  NSScreen* pScreen = (pWindow && pWindow.screen) ? pWindow.screen : [NSScreen mainScreen];
+  const CGDirectDisplayID displayID = (CGDirectDisplayID) [pScreen.deviceDescription[@"NSScreenNumber"] unsignedIntegerValue];
+
+  if (displayID && displayID != CVDisplayLinkGetCurrentCGDisplay(mDisplayLink))
+    CVDisplayLinkSetCurrentCGDisplay(mDisplayLink, displayID);
+
+  const CVTime period = CVDisplayLinkGetNominalOutputVideoRefreshPeriod(mDisplayLink);
+  mRefreshPeriod = ((period.flags & kCVTimeIsIndefinite) || !period.timeScale) ? 1.0 / DEFAULT_FPS : (double) period.timeValue / period.timeScale;
+
+  const bool visible = pWindow && ([pWindow occlusionState] & NSWindowOcclusionStateVisible);
+
+  if (visible && !CVDisplayLinkIsRunning(mDisplayLink))
+    CVDisplayLinkStart(mDisplayLink);
+  else if (!visible && CVDisplayLinkIsRunning(mDisplayLink))
+    CVDisplayLinkStop(mDisplayLink);
+#endif
+}
+
+// with a display link, a frame rate below the display's is reached by skipping vblanks, e.g. 60 fps draws at every other vblank of a 120 Hz display
+- (BOOL) isFrameDue
+{
+  const int fps = mGraphics ? mGraphics->FPS() : DISPLAY_REFRESH_FPS;
+
+  if (fps == DISPLAY_REFRESH_FPS)
+    return YES;
+
+  const CFTimeInterval now = CACurrentMediaTime();
+
+  // half a refresh period early is on time, since the vblanks don't land exactly on the frame interval
+  if (now - mLastFrameTime < 1.0 / fps - 0.5 * mRefreshPeriod)
+    return NO;
+
+  mLastFrameTime = now;
+  return YES;
+}
+
 - (void) setTimer
 {
 #ifdef IGRAPHICS_CVDISPLAYLINK
   mDisplaySource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, dispatch_get_main_queue());
   dispatch_source_set_event_handler(mDisplaySource, ^(){
-    [self render];
+#ifdef IGRAPHICS_RENDER_THREAD
+    [self processDeferredEvents];
+#else
+    if ([self isFrameDue])
+      [self render];
+#endif
   });
   dispatch_resume(mDisplaySource);
 
@@ -476,7 +644,11 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
   
   assert(cvReturn == kCVReturnSuccess);
 
+#ifdef IGRAPHICS_RENDER_THREAD
+  cvReturn = CVDisplayLinkSetOutputCallback(mDisplayLink, &displayLinkCallback, (void*) self);
+#else
   cvReturn = CVDisplayLinkSetOutputCallback(mDisplayLink, &displayLinkCallback, (void*) mDisplaySource);
+#endif
   assert(cvReturn == kCVReturnSuccess);
 
   #ifdef IGRAPHICS_GL
@@ -485,16 +657,23 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
   CVDisplayLinkSetCurrentCGDisplayFromOpenGLContext(mDisplayLink, cglContext, cglPixelFormat);
   #endif
   
-  CGDirectDisplayID viewDisplayID =
-      (CGDirectDisplayID) [self.window.screen.deviceDescription[@"NSScreenNumber"] unsignedIntegerValue];;
+  mLastFrameTime = 0.;
+  [self updateDisplayLink]; // sets the screen, and starts it if the window can be seen
+#else
+  double fps = mGraphics->FPS();
 
-  cvReturn = CVDisplayLinkSetCurrentCGDisplay(mDisplayLink, viewDisplayID);
+  if (fps == DISPLAY_REFRESH_FPS)
+  {
+    fps = DEFAULT_FPS;
 
-  assert(cvReturn == kCVReturnSuccess);
-  
-  CVDisplayLinkStart(mDisplayLink);
-#else
-  double sec = 1.0 / (double) mGraphics->FPS();
+    if (@available(macOS 12.0, *))
+    {
+      NSScreen* pScreen = self.window.screen ? self.window.screen : [NSScreen mainScreen];
+      fps = std::max<NSInteger>([pScreen maximumFramesPerSecond], DEFAULT_FPS);
+    }
+  }
+
+  double sec = 1.0 / fps;
   mTimer = [NSTimer timerWithTimeInterval:sec target:self selector:@selector(onTimer:) userInfo:nil repeats:YES];
   [[NSRunLoop currentRunLoop] addTimer: mTimer forMode: (NSString*) kCFRunLoopCommonModes];
 #endif
@@ -519,6 +698,9 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
     [[NSColorPanel sharedColorPanel] close];
   
   mColorPickerFunc = nullptr;
+#ifdef IGRAPHICS_RENDER_THREAD
+  [mDeferredEvents release];
+#endif
   [mMoveCursor release];
   [mTrackingArea release];
   [[NSNotificationCenter defaultCenter] removeObserver:self];
@@ -557,7 +739,10 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 - (void) viewDidMoveToWindow
 {
   NSWindow* pWindow = [self window];
-  
+
+  [[NSNotificationCenter defaultCenter] removeObserver:self name:NSWindowDidChangeOcclusionStateNotification object:nil];
+  [[NSNotificationCenter defaultCenter] removeObserver:self name:NSWindowDidChangeScreenNotification object:nil];
+
   if (pWindow)
   {
     [pWindow makeFirstResponder: self];
@@ -567,6 +752,17 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
     if (mGraphics)
       mGraphics->SetScreenScale(newScale);
+
+    // stop drawing while the window is minimised, hidden or covered
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(windowOcclusionChanged:)
+                                                 name:NSWindowDidChangeOcclusionStateNotification
+                                               object:pWindow];
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(windowScreenChanged:)
+                                                 name:NSWindowDidChangeScreenNotification
+                                               object:pWindow];
+    [self windowOcclusionChanged:nil];
     
     #ifdef IGRAPHICS_METAL
     [[NSNotificationCenter defaultCenter] addObserver:self
@@ -587,6 +783,10 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 //                                             selector:@selector(windowFullscreened:) name:NSWindowDidExitFullScreenNotification
 //                                               object:pWindow];
   }
+  else
+  {
+    [self updateDisplayLink]; // stops it while the view isn't in a window
+  }
 }
 
 - (void) viewDidChangeBackingProperties:(NSNotification*) pNotification
@@ -596,6 +796,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
   if (!pWindow)
     return;
   
+  IGRAPHICS_RENDER_LOCK(mGraphics);
   CGFloat newScale = [pWindow backingScaleFactor];
   
   mGraphics->SetPlatformContext(nullptr);
@@ -718,6 +919,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseEntered: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   mMouseOutDuringDrag = false;
   
   if (mGraphics)
@@ -728,6 +930,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseExited: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   if (mGraphics)
   {
     if (!mGraphics->ControlIsCaptured())
@@ -743,6 +946,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseDown: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   IMouseInfo info = [self getMouseLeft:pEvent];
   if (mGraphics)
   {
@@ -760,6 +964,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseUp: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   IMouseInfo info = [self getMouseLeft:pEvent];
   if (mGraphics)
   {
@@ -776,6 +981,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseDragged: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   // Cache previous values before retrieving the new mouse position (which will update them)
   float prevX = mPrevX;
   float prevY = mPrevY;
@@ -791,6 +997,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) rightMouseDown: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   IMouseInfo info = [self getMouseRight:pEvent];
   if (mGraphics)
   {
@@ -808,6 +1015,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) rightMouseUp: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   IMouseInfo info = [self getMouseRight:pEvent];
   if (mGraphics)
   {
@@ -818,6 +1026,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) rightMouseDragged: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   // Cache previous values before retrieving the new mouse position (which will update them)
   float prevX = mPrevX;
   float prevY = mPrevY;
@@ -834,6 +1043,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) mouseMoved: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   IMouseInfo info = [self getMouseLeft:pEvent];
   if (mGraphics)
     mGraphics->OnMouseOver(info.x, info.y, info.ms);
@@ -841,6 +1051,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) keyDown: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   int flag = 0;
   int code = MacKeyEventToVK(pEvent, flag);
   NSString *s = [pEvent charactersIgnoringModifiers];
@@ -872,6 +1083,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) keyUp: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   int flag = 0;
   int code = MacKeyEventToVK(pEvent, flag);
   NSString *s = [pEvent charactersIgnoringModifiers];
@@ -903,6 +1115,7 @@ static CVReturn displayLinkCallback(CVDisplayLinkRef displayLink, const CVTimeSt
 
 - (void) scrollWheel: (NSEvent*) pEvent
 {
+  IGRAPHICS_LOCK_OR_DEFER_EVENT(pEvent);
   if (mTextFieldView) [self endUserInput ];
   IMouseInfo info = [self getMouseLeft:pEvent];
   float d = [pEvent deltaY];
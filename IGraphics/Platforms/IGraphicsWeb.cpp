@@ -8,6 +8,7 @@
  ==============================================================================
 */
 
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cstdint>
@@ -69,27 +70,12 @@ private:
 
 IFontDataPtr IGraphicsWeb::FileFont::GetFontData()
 {
-  IFontDataPtr fontData(new IFontData());
-  FILE* fp = fopen(mPath.Get(), "rb");
+  auto resource = std::make_shared<const IPlugMappedResource>(mPath.Get());
   
-  // Read in the font data.
-  if (!fp)
-    return fontData;
+  if (!resource->IsValid())
+    return IFontDataPtr(new IFontData());
   
-  fseek(fp,0,SEEK_END);
-  fontData = std::make_unique<IFontData>((int) ftell(fp));
-  
-  if (!fontData->GetSize())
-    return fontData;
-  
-  fseek(fp,0,SEEK_SET);
-  size_t readSize = fread(fontData->Get(), 1, fontData->GetSize(), fp);
-  fclose(fp);
-  
-  if (readSize && readSize == fontData->GetSize())
-    fontData->SetFaceIdx(0);
-  
-  return fontData;
+  return IFontDataPtr(new IFontData(std::move(resource), 0));
 }
 
 class IGraphicsWeb::MemoryFont : public Font
@@ -320,6 +306,8 @@ static EM_BOOL key_callback(int eventType, const EmscriptenKeyboardEvent* pEvent
                       static_cast<bool>(pEvent->ctrlKey || pEvent->metaKey),
                       static_cast<bool>(pEvent->altKey)};
   
+  pGraphicsWeb->FlushPendingMoves();
+
   switch (eventType)
   {
     case EMSCRIPTEN_EVENT_KEYDOWN:
@@ -357,6 +345,7 @@ static EM_BOOL outside_mouse_callback(int eventType, const EmscriptenMouseEvent*
       // Get button states based on what caused the mouse up (nothing in buttons)
       list[0].ms.L = pEvent->button == 0;
       list[0].ms.R = pEvent->button == 2;
+      pGraphics->FlushPendingMoves();
       pGraphics->OnMouseUp(list);
       emscripten_set_mousemove_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, pGraphics, 1, nullptr);
       emscripten_set_mouseup_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, pGraphics, 1, nullptr);
@@ -365,7 +354,7 @@ static EM_BOOL outside_mouse_callback(int eventType, const EmscriptenMouseEvent*
     case EMSCRIPTEN_EVENT_MOUSEMOVE:
     {
       if(pEvent->buttons != 0 && !pGraphics->IsInPlatformTextEntry())
-        pGraphics->OnMouseDrag(list);
+        pGraphics->QueueMouseMove(info, true);
       break;
     }
     default:
@@ -393,6 +382,9 @@ static EM_BOOL mouse_callback(int eventType, const EmscriptenMouseEvent* pEvent,
              static_cast<bool>(pEvent->ctrlKey),
              static_cast<bool>(pEvent->altKey)};
   
+  if (eventType != EMSCRIPTEN_EVENT_MOUSEMOVE)
+    pGraphics->FlushPendingMoves();
+
   std::vector<IMouseInfo> list {info};
   switch (eventType)
   {
@@ -429,11 +421,11 @@ static EM_BOOL mouse_callback(int eventType, const EmscriptenMouseEvent* pEvent,
       gFirstClick = false;
       
       if(pEvent->buttons == 0)
-        pGraphics->OnMouseOver(info.x, info.y, info.ms);
+        pGraphics->QueueMouseMove(info, false);
       else
       {
         if(!pGraphics->IsInPlatformTextEntry())
-          pGraphics->OnMouseDrag(list);
+          pGraphics->QueueMouseMove(info, true);
       }
       break;
     }
@@ -461,7 +453,8 @@ static EM_BOOL mouse_callback(int eventType, const EmscriptenMouseEvent* pEvent,
 
 static EM_BOOL wheel_callback(int eventType, const EmscriptenWheelEvent* pEvent, void* pUserData)
 {
-  IGraphics* pGraphics = (IGraphics*) pUserData;
+  IGraphicsWeb* pGraphics = (IGraphicsWeb*) pUserData;
+  pGraphics->FlushPendingMoves();
   
   IMouseMod modifiers(false, false, pEvent->mouse.shiftKey, pEvent->mouse.ctrlKey, pEvent->mouse.altKey);
   
@@ -482,7 +475,7 @@ static EM_BOOL wheel_callback(int eventType, const EmscriptenWheelEvent* pEvent,
 
 EM_BOOL touch_callback(int eventType, const EmscriptenTouchEvent* pEvent, void* pUserData)
 {
-  IGraphics* pGraphics = (IGraphics*) pUserData;
+  IGraphicsWeb* pGraphics = (IGraphicsWeb*) pUserData;
   const float drawScale = pGraphics->GetDrawScale();
 
   std::vector<IMouseInfo> points;
@@ -510,6 +503,9 @@ EM_BOOL touch_callback(int eventType, const EmscriptenTouchEvent* pEvent, void*
 
   memcpy(previousTouches, pEvent->touches, sizeof(previousTouches));
   
+  if (eventType != EMSCRIPTEN_EVENT_TOUCHMOVE)
+    pGraphics->FlushPendingMoves();
+
   switch (eventType)
   {
     case EMSCRIPTEN_EVENT_TOUCHSTART:
@@ -519,7 +515,7 @@ EM_BOOL touch_callback(int eventType, const EmscriptenTouchEvent* pEvent, void*
       pGraphics->OnMouseUp(points);
       return true;
     case EMSCRIPTEN_EVENT_TOUCHMOVE:
-      pGraphics->OnMouseDrag(points);
+      pGraphics->QueueTouchMoves(points);
       return true;
    case EMSCRIPTEN_EVENT_TOUCHCANCEL:
       pGraphics->OnTouchCancelled(points);
@@ -556,18 +552,24 @@ static EM_BOOL text_entry_keydown(int eventType, const EmscriptenKeyboardEvent*
   return false;
 }
 
-static EM_BOOL uievent_callback(int eventType, const EmscriptenUiEvent* pEvent, void* pUserData)
+// called by the observers that are installed by IGraphicsWeb::OpenWindow()
+
+static void igraphics_parent_resized(int width, int height)
 {
-  IGraphicsWeb* pGraphics = (IGraphicsWeb*) pUserData;
+  if (gGraphics)
+    gGraphics->GetDelegate()->OnParentWindowResize(width, height);
+}
 
-  if (eventType == EMSCRIPTEN_EVENT_RESIZE)
-  {
-    pGraphics->GetDelegate()->OnParentWindowResize(pEvent->windowInnerWidth, pEvent->windowInnerHeight);
+static void igraphics_visibility_changed(bool visible)
+{
+  if (gGraphics)
+    gGraphics->SetVisible(visible);
+}
 
-    return true;
-  }
-  
-  return false;
+static void igraphics_screen_scale_changed()
+{
+  if (gGraphics)
+    gGraphics->SetScreenScale(std::ceil(std::max(emscripten_get_device_pixel_ratio(), 1.)));
 }
 
 IColorPickerHandlerFunc gColorPickerHandlerFunc = nullptr;
@@ -597,6 +599,9 @@ static void file_dialog_callback(val e)
 EMSCRIPTEN_BINDINGS(events) {
   function("color_picker_callback", color_picker_callback);
   function("file_dialog_callback", file_dialog_callback);
+  function("igraphics_parent_resized", igraphics_parent_resized);
+  function("igraphics_visibility_changed", igraphics_visibility_changed);
+  function("igraphics_screen_scale_changed", igraphics_screen_scale_changed);
 }
 
 #pragma mark -
@@ -620,7 +625,6 @@ IGraphicsWeb::IGraphicsWeb(IGEditorDelegate& dlg, int w, int h, int fps, float s
   emscripten_set_touchend_callback("#canvas", this, 1, touch_callback);
   emscripten_set_touchmove_callback("#canvas", this, 1, touch_callback);
   emscripten_set_touchcancel_callback("#canvas", this, 1, touch_callback);
-  emscripten_set_resize_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, this, 1, uievent_callback);
 }
 
 IGraphicsWeb::~IGraphicsWeb()
@@ -634,9 +638,18 @@ void* IGraphicsWeb::OpenWindow(void* pHandle)
   emscripten_webgl_init_context_attributes(&attr);
   attr.stencil = true;
   attr.depth = true;
+#if defined IGRAPHICS_GLES3
+  // NanoVG's GLES3 backend needs a WebGL2 context, which also lets it use uniform buffers and blit the main frame buffer
+  attr.majorVersion = 2;
+  attr.minorVersion = 0;
+#endif
 //  attr.explicitSwapControl = 1;
   
   EMSCRIPTEN_WEBGL_CONTEXT_HANDLE ctx = emscripten_webgl_create_context("#canvas", &attr);
+  
+  if (ctx <= 0)
+    DBGMSG("Failed to create a WebGL%i context\n", attr.majorVersion);
+  
   emscripten_webgl_make_context_current(ctx);
 #endif
   
@@ -644,8 +657,52 @@ void* IGraphicsWeb::OpenWindow(void* pHandle)
 
   SetScreenScale(std::ceil(std::max(emscripten_get_device_pixel_ratio(), 1.)));
 
-  GetDelegate()->LayoutUI(this);
-  GetDelegate()->OnUIOpen();
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
+
+  // Rather than polling every frame, observe the page's visibility, whether the canvas is scrolled into view, the size of its container and the device pixel ratio.
+  // The canvas doesn't scroll the page, so the browser doesn't have to wait for the touch listeners before it scrolls
+  EM_ASM({
+    var canvas = document.getElementById('canvas');
+    canvas.style.touchAction = 'none';
+
+    var pageVisible = !document.hidden;
+    var canvasVisible = true;
+    var update = function() { Module.igraphics_visibility_changed(pageVisible && canvasVisible); };
+
+    document.addEventListener('visibilitychange', function() { pageVisible = !document.hidden; update(); }, { passive: true });
+
+    if (typeof IntersectionObserver !== 'undefined')
+      new IntersectionObserver(function(entries) { canvasVisible = entries[entries.length - 1].isIntersecting; update(); }).observe(canvas);
+
+    // the body is sized by the canvas, so the window is observed instead of it
+    var container = canvas.parentElement;
+
+    if (typeof ResizeObserver !== 'undefined' && container && container !== document.body && container !== document.documentElement)
+    {
+      new ResizeObserver(function(entries) {
+        var rect = entries[entries.length - 1].contentRect;
+        Module.igraphics_parent_resized(Math.round(rect.width), Math.round(rect.height));
+      }).observe(container);
+    }
+    else
+      window.addEventListener('resize', function() { Module.igraphics_parent_resized(window.innerWidth, window.innerHeight); }, { passive: true });
+
+    var watchPixelRatio = function() {
+      window.matchMedia('(resolution: ' + window.devicePixelRatio + 'dppx)').addEventListener('change', function() {
+        Module.igraphics_screen_scale_changed();
+        watchPixelRatio();
+      }, { once: true, passive: true });
+    };
+
+    watchPixelRatio();
+  });
   
   return nullptr;
 }
@@ -713,20 +770,79 @@ void IGraphicsWeb::GetMouseLocation(float& x, float&y) const
   y = mPrevY;
 }
 
+void IGraphicsWeb::QueueMouseMove(const IMouseInfo& info, bool drag)
+{
+  if (mHasPendingMouseMove && mPendingMouseMoveIsDrag != drag)
+    FlushPendingMoves();
+
+  if (mHasPendingMouseMove)
+  {
+    const float dX = mPendingMouseMove.dX + info.dX;
+    const float dY = mPendingMouseMove.dY + info.dY;
+    mPendingMouseMove = info;
+    mPendingMouseMove.dX = dX;
+    mPendingMouseMove.dY = dY;
+  }
+  else
+    mPendingMouseMove = info;
+
+  mHasPendingMouseMove = true;
+  mPendingMouseMoveIsDrag = drag;
+}
+
+void IGraphicsWeb::QueueTouchMoves(const std::vector<IMouseInfo>& points)
+{
+  for (const IMouseInfo& point : points)
+  {
+    auto it = std::find_if(mPendingTouchMoves.begin(), mPendingTouchMoves.end(), [&point](const IMouseInfo& pending) { return pending.ms.touchID == point.ms.touchID; });
+
+    if (it != mPendingTouchMoves.end())
+    {
+      const float dX = it->dX + point.dX;
+      const float dY = it->dY + point.dY;
+      *it = point;
+      it->dX = dX;
+      it->dY = dY;
+    }
+    else
+      mPendingTouchMoves.push_back(point);
+  }
+}
+
+void IGraphicsWeb::FlushPendingMoves()
+{
+  if (mHasPendingMouseMove)
+  {
+    mHasPendingMouseMove = false;
+
+    if (mPendingMouseMoveIsDrag)
+      OnMouseDrag({mPendingMouseMove});
+    else
+      OnMouseOver(mPendingMouseMove.x, mPendingMouseMove.y, mPendingMouseMove.ms);
+  }
+
+  if (!mPendingTouchMoves.empty())
+  {
+    std::vector<IMouseInfo> points;
+    points.swap(mPendingTouchMoves);
+    OnMouseDrag(points);
+  }
+}
+
 //static
 void IGraphicsWeb::OnMainLoopTimer()
 {
   IRECTList rects;
-  int screenScale = (int) std::ceil(std::max(emscripten_get_device_pixel_ratio(), 1.));
   
   // Don't draw if there are no graphics or if assets are still loading
   if (!gGraphics || !gGraphics->AssetsLoaded())
     return;
-  
-  if (screenScale != gGraphics->GetScreenScale())
-  {
-    gGraphics->SetScreenScale(screenScale);
-  }
+
+  gGraphics->FlushPendingMoves();
+
+  // Don't poll the controls while the page is hidden or the canvas is out of view
+  if (!gGraphics->mVisible)
+    return;
 
   if (gGraphics->IsDirty(rects))
   {
@@ -16,6 +16,7 @@
 #include <emscripten/html5.h>
 
 #include <utility>
+#include <vector>
 
 #include "IPlugPlatform.h"
 
@@ -77,6 +78,20 @@ public:
   
   //IGraphicsWeb
   static void OnMainLoopTimer();
+
+  /** Queue a mouse move, which is delivered with the others in the same animation frame as one OnMouseOver() or OnMouseDrag(), with the sum of their movements
+   * @param drag \c true if a button is down */
+  void QueueMouseMove(const IMouseInfo& info, bool drag);
+
+  /** Queue touch moves, which are delivered with the others in the same animation frame as one OnMouseDrag(), with the latest position of each touch */
+  void QueueTouchMoves(const std::vector<IMouseInfo>& points);
+
+  /** Deliver the queued moves, at the start of a frame and before any other mouse or touch event, so that events stay in order */
+  void FlushPendingMoves();
+
+  /** Called when the page is hidden or shown, or the canvas is scrolled out of or into view. Nothing is drawn while the UI is hidden */
+  void SetVisible(bool visible) { mVisible = visible; }
+
   double mPrevX = 0.;
   double mPrevY = 0.;
   
@@ -91,6 +106,11 @@ private:
   void CachePlatformFont(const char* fontID, const PlatformFontPtr& font) override {}
 
   WDL_String mClipboardText;
+  IMouseInfo mPendingMouseMove;
+  bool mHasPendingMouseMove = false;
+  bool mPendingMouseMoveIsDrag = false;
+  std::vector<IMouseInfo> mPendingTouchMoves;
+  bool mVisible = true;
 };
 
 END_IGRAPHICS_NAMESPACE
@@ -22,6 +22,11 @@
 #include <wininet.h>
 #include <VersionHelpers.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 #if defined __clang__
 #undef CCSIZEOF_STRUCT
 #define CCSIZEOF_STRUCT(structname, member) (__builtin_offsetof(structname, member) + sizeof(((structname*)0)->member))
@@ -200,6 +205,15 @@ void IGraphicsWin::DestroyEditWindow()
 
 void IGraphicsWin::OnDisplayTimer(int vBlankCount)
 {
+#ifdef IGRAPHICS_RENDER_THREAD
+  std::unique_lock<std::recursive_mutex> renderLock(GetRenderMutex(), std::try_to_lock);
+
+  if (!renderLock.owns_lock()) // drawing, try again at the next vblank
+    return;
+
+  ProcessDeferredInput();
+#endif
+
   // Check the message vblank with the current one to see if we are way behind. If so, then throw these away.
   DWORD msgCount = vBlankCount;
   DWORD curCount = mVBlankCount;
@@ -253,8 +267,24 @@ void IGraphicsWin::OnDisplayTimer(int vBlankCount)
     float scale = GetScaleForHWND(mPlugWnd);
     if (scale != GetScreenScale())
       SetScreenScale(scale);
+
+    // follow the window to the vblank thread of another monitor, once most of it is there
+    if (mVSYNCEnabled && MonitorFromWindow(mPlugWnd, MONITOR_DEFAULTTONEAREST) != mVBlankMonitor)
+    {
+      StopVBlankThread();
+      StartVBlankThread(mPlugWnd);
+    }
   }
 
+  // stop drawing while the window is minimised or hidden
+  SetOccluded(IsIconic(GetAncestor(mPlugWnd, GA_ROOT)) || !IsWindowVisible(mPlugWnd));
+
+#ifdef IGRAPHICS_RENDER_THREAD
+  // the render thread draws, apart from while the text entry is open, since it is drawn over by the main thread
+  if (mVSYNCEnabled && !mParamEditWnd)
+    return;
+#endif
+
   // TODO: this is far too aggressive for slow drawing animations and data changing.  We need to
   // gate the rate of updates to a certain percentage of the wall clock time.
   IRECTList rects;
@@ -314,12 +344,14 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 
     if(pGraphics->mVSYNCEnabled) // use VBLANK thread
     {
-      assert((pGraphics->FPS() == 60) && "If you want to run at frame rates other than 60FPS");
+      // the VBlank thread runs at the refresh rate of the display
+      assert((pGraphics->FPS() == 60 || pGraphics->FPS() == DISPLAY_REFRESH_FPS) && "If you want to run at frame rates other than 60FPS");
       pGraphics->StartVBlankThread(hWnd);
     }
     else // use WM_TIMER -- its best to get below 16ms because the windows time quanta is slightly above 15ms.
     {
-      int mSec = static_cast<int>(std::floorf(1000.0f / (pGraphics->FPS())));
+      const int fps = pGraphics->FPS() > 0 ? pGraphics->FPS() : DEFAULT_FPS;
+      int mSec = static_cast<int>(std::floorf(1000.0f / fps));
       if (mSec < 20) mSec = 15;
       SetTimer(hWnd, IPLUG_TIMER_ID, mSec, NULL);
     }
@@ -353,6 +385,27 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
     return ((extraInfo & c_SIGNATURE_MASK) == c_MOUSEEVENTF_FROMTOUCH);
   };
 
+#ifdef IGRAPHICS_RENDER_THREAD
+  // While a frame is being drawn, input is queued rather than waiting for the render thread, and handled in order by OnDisplayTimer()
+  std::unique_lock<std::recursive_mutex> renderLock(pGraphics->GetRenderMutex(), std::defer_lock);
+
+  if (msg != WM_VBLANK && msg != WM_TIMER)
+  {
+    if (IsInputMsg(msg))
+    {
+      const bool mustQueue = !pGraphics->mDeferredInput.empty() && !pGraphics->mProcessingDeferredInput;
+
+      if (mustQueue || !renderLock.try_lock())
+      {
+        pGraphics->mDeferredInput.push_back({hWnd, msg, wParam, lParam});
+        return 0;
+      }
+    }
+    else
+      renderLock.lock();
+  }
+#endif
+
   pGraphics->CheckTabletInput(msg);
 
   switch (msg)
@@ -1153,7 +1206,10 @@ void* IGraphicsWin::OpenWindow(void* pParent)
 
   SetScreenScale(screenScale); // resizes draw context
 
-  GetDelegate()->LayoutUI(this);
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kLayout);
+    GetDelegate()->LayoutUI(this);
+  }
 
   if (MultiTouchEnabled() && GetSystemMetrics(SM_DIGITIZER) & NID_MULTI_INPUT)
   {
@@ -1196,7 +1252,10 @@ void* IGraphicsWin::OpenWindow(void* pParent)
 #endif
   }
 
-  GetDelegate()->OnUIOpen();
+  {
+    IPlugStartupTimeline::ScopedPhase phase(GetDelegate()->GetStartupTimeline(), IPlugStartupTimeline::kUIOpen);
+    GetDelegate()->OnUIOpen();
+  }
   
   return mPlugWnd;
 }
@@ -1278,6 +1337,10 @@ void IGraphicsWin::CloseWindow()
     else
       KillTimer(mPlugWnd, IPLUG_TIMER_ID);
 
+#ifdef IGRAPHICS_RENDER_THREAD
+    mDeferredInput.clear();
+#endif
+
 #ifdef IGRAPHICS_GL
     ActivateGLContext();
 #endif
@@ -2059,31 +2122,6 @@ void IGraphicsWin::CachePlatformFont(const char* fontID, const PlatformFontPtr&
     hfontStorage.Add(new HFontHolder(hfont), fontID);
 }
 
-DWORD WINAPI VBlankRun(LPVOID lpParam)
-{
-  IGraphicsWin* pGraphics = (IGraphicsWin*)lpParam;
-  return pGraphics->OnVBlankRun();
-}
-
-void IGraphicsWin::StartVBlankThread(HWND hWnd)
-{
-  mVBlankWindow = hWnd;
-  mVBlankShutdown = false;
-  DWORD threadId = 0;
-  mVBlankThread = ::CreateThread(NULL, 0, VBlankRun, this, 0, &threadId);
-}
-
-void IGraphicsWin::StopVBlankThread()
-{
-  if (mVBlankThread != INVALID_HANDLE_VALUE)
-  {
-    mVBlankShutdown = true;
-    ::WaitForSingleObject(mVBlankThread, 10000);
-    mVBlankThread = INVALID_HANDLE_VALUE;
-    mVBlankWindow = 0;
-  }
-}
-
 // Nasty kernel level definitions for wait for vblank.  Including the
 // proper include file requires "d3dkmthk.h" from the driver development
 // kit.  Instead we define the minimum needed to call the three methods we need.
@@ -2117,132 +2155,314 @@ typedef NTSTATUS(WINAPI* D3DKMTOpenAdapterFromHdc)(D3DKMT_OPENADAPTERFROMHDC* Ar
 typedef NTSTATUS(WINAPI* D3DKMTCloseAdapter)(const D3DKMT_CLOSEADAPTER* Arg1);
 typedef NTSTATUS(WINAPI* D3DKMTWaitForVerticalBlankEvent)(const D3DKMT_WAITFORVERTICALBLANKEVENT* Arg1);
 
-DWORD IGraphicsWin::OnVBlankRun()
+/** Runs one vblank thread per monitor that has an IGraphicsWin window on it, shared by all the windows of the module on that monitor.
+ * Each thread waits for the vertical blank of its monitor and calls VBlankNotify() on every window that is registered with it, so many open editors don't mean as many threads.
+ * A thread starts when the first window on its monitor is registered and stops when the last one is removed.
+ * With IGRAPHICS_RENDER_THREAD the windows on a monitor are drawn one after the other on its thread. */
+class IGraphicsWin::VBlankDispatcher
 {
-  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+public:
+  static VBlankDispatcher& Get()
+  {
+    static VBlankDispatcher sDispatcher;
+    return sDispatcher;
+  }
 
-  // TODO: get expected vsync value.  For now we will use a fallback
-  // of 60Hz
-  float rateFallback = 60.0f;
-  int rateMS = (int)(1000.0f / rateFallback);
+  void Add(IGraphicsWin* pGraphics, HMONITOR hMonitor)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
 
-  // We need to try to load the module and entry points to wait on v blank.
-  // if anything fails, we try to gracefully fallback to sleeping for some
-  // number of milliseconds.
-  //
-  // TODO: handle low power modes
+    auto it = std::find_if(mMonitors.begin(), mMonitors.end(), [hMonitor](const std::unique_ptr<Monitor>& m) { return m->handle == hMonitor; });
 
-  D3DKMTOpenAdapterFromHdc pOpen = nullptr;
-  D3DKMTCloseAdapter pClose = nullptr;
-  D3DKMTWaitForVerticalBlankEvent pWait = nullptr;
-  HINSTANCE hInst = LoadLibrary("gdi32.dll");
-  if (hInst != nullptr)
-  {
-    pOpen  = (D3DKMTOpenAdapterFromHdc)GetProcAddress((HMODULE)hInst, "D3DKMTOpenAdapterFromHdc");
-    pClose = (D3DKMTCloseAdapter)GetProcAddress((HMODULE)hInst, "D3DKMTCloseAdapter");
-    pWait  = (D3DKMTWaitForVerticalBlankEvent)GetProcAddress((HMODULE)hInst, "D3DKMTWaitForVerticalBlankEvent");
+    if (it == mMonitors.end())
+    {
+      mMonitors.push_back(std::make_unique<Monitor>(hMonitor));
+      it = mMonitors.end() - 1;
+      DWORD threadId = 0;
+      (*it)->thread = ::CreateThread(NULL, 0, ThreadProc, it->get(), 0, &threadId);
+    }
+
+    (*it)->windows.push_back(pGraphics);
   }
 
-  // if we don't get bindings to the methods we will fallback
-  // to a crummy sleep loop for now.  This is really just a last
-  // resort and not expected on modern hardware and Windows OS
-  // installs.
-  if (!pOpen || !pClose || !pWait)
+  void Remove(IGraphicsWin* pGraphics)
   {
-    while (mVBlankShutdown == false)
+    std::unique_ptr<Monitor> pStopped;
+
     {
-      Sleep(rateMS);
-      VBlankNotify();
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      for (auto it = mMonitors.begin(); it != mMonitors.end(); ++it)
+      {
+        auto& windows = (*it)->windows;
+        auto windowIt = std::find(windows.begin(), windows.end(), pGraphics);
+
+        if (windowIt == windows.end())
+          continue;
+
+        windows.erase(windowIt);
+
+        if (windows.empty())
+        {
+          pStopped = std::move(*it);
+          mMonitors.erase(it);
+        }
+
+        break;
+      }
+    }
+
+    // the last window on the monitor has gone, stop its thread outside of the lock, since the thread takes it to notify the windows
+    if (pStopped)
+    {
+      pStopped->shutdown = true;
+
+      if (pStopped->thread)
+      {
+        if (::WaitForSingleObject(pStopped->thread, 10000) == WAIT_OBJECT_0)
+          ::CloseHandle(pStopped->thread);
+        else
+          pStopped.release(); // the thread is stuck in the driver, leak its state rather than free it under it
+      }
     }
   }
-  else
+
+private:
+  struct Monitor
+  {
+    Monitor(HMONITOR hMonitor) : handle(hMonitor) {}
+
+    HMONITOR handle;
+    HANDLE thread = nullptr;
+    std::atomic<bool> shutdown {false}; // Flag to indicate that the vsync thread should shutdown
+    std::vector<IGraphicsWin*> windows; // guarded by mMutex
+  };
+
+  static DWORD WINAPI ThreadProc(LPVOID lpParam)
+  {
+    return Get().Run(*static_cast<Monitor*>(lpParam));
+  }
+
+  /** @return The refresh rate of the monitor's current display mode, or 60Hz if it doesn't report one */
+  static int GetRefreshRate(HMONITOR hMonitor)
+  {
+    MONITORINFOEX info = {};
+    info.cbSize = sizeof(MONITORINFOEX);
+    DEVMODE mode = {};
+    mode.dmSize = sizeof(DEVMODE);
+
+    // 0 and 1 mean the hardware's default rate
+    if (GetMonitorInfo(hMonitor, &info) && EnumDisplaySettings(info.szDevice, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1)
+      return static_cast<int>(mode.dmDisplayFrequency);
+
+    return 60;
+  }
+
+  void Notify(Monitor& monitor)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto pGraphics : monitor.windows)
+      pGraphics->VBlankNotify();
+  }
+
+  DWORD Run(Monitor& monitor)
   {
-    // we have a good set of functions to call.  We need to keep
-    // track of the adapter and reask for it if the device is lost.
-    bool adapterIsOpen = false;
-    DWORD adapterLastFailTime = 0;
-    _D3DKMT_WAITFORVERTICALBLANKEVENT we = { 0 };
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+
+    // the sleep fallback runs at the rate of the monitor, which is detected again when the adapter has to be reopened, e.g. after a mode change
+    int rateMS = 1000 / GetRefreshRate(monitor.handle);
+
+    // We need to try to load the module and entry points to wait on v blank.
+    // if anything fails, we try to gracefully fallback to sleeping for some
+    // number of milliseconds.
+    //
+    // TODO: handle low power modes
 
-    while (mVBlankShutdown == false)
+    D3DKMTOpenAdapterFromHdc pOpen = nullptr;
+    D3DKMTCloseAdapter pClose = nullptr;
+    D3DKMTWaitForVerticalBlankEvent pWait = nullptr;
+    HINSTANCE hInst = LoadLibrary("gdi32.dll");
+    if (hInst != nullptr)
+    {
+      pOpen  = (D3DKMTOpenAdapterFromHdc)GetProcAddress((HMODULE)hInst, "D3DKMTOpenAdapterFromHdc");
+      pClose = (D3DKMTCloseAdapter)GetProcAddress((HMODULE)hInst, "D3DKMTCloseAdapter");
+      pWait  = (D3DKMTWaitForVerticalBlankEvent)GetProcAddress((HMODULE)hInst, "D3DKMTWaitForVerticalBlankEvent");
+    }
+
+    // if we don't get bindings to the methods we will fallback
+    // to a crummy sleep loop for now.  This is really just a last
+    // resort and not expected on modern hardware and Windows OS
+    // installs.
+    if (!pOpen || !pClose || !pWait)
+    {
+      while (monitor.shutdown == false)
+      {
+        Sleep(rateMS);
+        Notify(monitor);
+      }
+    }
+    else
     {
-      if (!adapterIsOpen)
+      // we have a good set of functions to call.  We need to keep
+      // track of the adapter and reask for it if the device is lost.
+      bool adapterIsOpen = false;
+      DWORD adapterLastFailTime = 0;
+      _D3DKMT_WAITFORVERTICALBLANKEVENT we = { 0 };
+
+      while (monitor.shutdown == false)
       {
-        // reacquire the adapter (at most once a second).
-        if (adapterLastFailTime < ::GetTickCount() - 1000)
+        if (!adapterIsOpen)
         {
-          // try to get adapter
-          D3DKMT_OPENADAPTERFROMHDC openAdapterData = { 0 };
-          HDC hDC = GetDC(mVBlankWindow);
-          openAdapterData.hDc = hDC;
-          NTSTATUS status = (*pOpen)(&openAdapterData);
-          if (status == S_OK)
+          // reacquire the adapter (at most once a second).
+          if (adapterLastFailTime < ::GetTickCount() - 1000)
           {
-            // success, setup wait request parameters.
-            adapterLastFailTime = 0;
-            adapterIsOpen = true;
-            we.hAdapter = openAdapterData.hAdapter;
-            we.hDevice = 0;
-            we.VidPnSourceId = openAdapterData.VidPnSourceId;
+            // try to get the adapter that drives this monitor
+            MONITORINFOEX info = {};
+            info.cbSize = sizeof(MONITORINFOEX);
+            HDC hDC = GetMonitorInfo(monitor.handle, &info) ? CreateDC(info.szDevice, NULL, NULL, NULL) : NULL;
+            D3DKMT_OPENADAPTERFROMHDC openAdapterData = { 0 };
+            openAdapterData.hDc = hDC;
+            NTSTATUS status = hDC ? (*pOpen)(&openAdapterData) : E_FAIL;
+            if (status == S_OK)
+            {
+              // success, setup wait request parameters.
+              adapterLastFailTime = 0;
+              adapterIsOpen = true;
+              we.hAdapter = openAdapterData.hAdapter;
+              we.hDevice = 0;
+              we.VidPnSourceId = openAdapterData.VidPnSourceId;
+              rateMS = 1000 / GetRefreshRate(monitor.handle);
+            }
+            else
+            {
+              // failed
+              adapterLastFailTime = ::GetTickCount();
+            }
+
+            if (hDC)
+              DeleteDC(hDC);
           }
-          else
+        }
+
+        if (adapterIsOpen)
+        {
+          // Finally we can wait on VBlank
+          NTSTATUS status = (*pWait)(&we);
+          if (status != S_OK)
           {
-            // failed
-            adapterLastFailTime = ::GetTickCount();
+            // failed, close now and try again on the next pass.
+            _D3DKMT_CLOSEADAPTER ca;
+            ca.hAdapter = we.hAdapter;
+            (*pClose)(&ca);
+            adapterIsOpen = false;
           }
-          DeleteDC(hDC);
         }
-      }
 
-      if (adapterIsOpen)
-      {
-        // Finally we can wait on VBlank
-        NTSTATUS status = (*pWait)(&we);
-        if (status != S_OK)
+        // Temporary fallback for lost adapter or failed call.
+        if (!adapterIsOpen)
         {
-          // failed, close now and try again on the next pass.
-          _D3DKMT_CLOSEADAPTER ca;
-          ca.hAdapter = we.hAdapter;
-          (*pClose)(&ca);
-          adapterIsOpen = false;
+          ::Sleep(rateMS);
         }
+
+        // notify logic
+        Notify(monitor);
       }
 
-      // Temporary fallback for lost adapter or failed call.
-      if (!adapterIsOpen)
+      // cleanup adapter before leaving
+      if (adapterIsOpen)
       {
-        ::Sleep(rateMS);
+        _D3DKMT_CLOSEADAPTER ca;
+        ca.hAdapter = we.hAdapter;
+        (*pClose)(&ca);
+        adapterIsOpen = false;
       }
-
-      // notify logic
-      VBlankNotify();
     }
 
-    // cleanup adapter before leaving
-    if (adapterIsOpen)
+    // release module resource
+    if (hInst != nullptr)
     {
-      _D3DKMT_CLOSEADAPTER ca;
-      ca.hAdapter = we.hAdapter;
-      (*pClose)(&ca);
-      adapterIsOpen = false;
+      FreeLibrary((HMODULE)hInst);
+      hInst = nullptr;
     }
+
+    return 0;
   }
 
-  // release module resource
-  if (hInst != nullptr)
+  std::mutex mMutex;
+  std::vector<std::unique_ptr<Monitor>> mMonitors;
+};
+
+void IGraphicsWin::StartVBlankThread(HWND hWnd)
+{
+  mVBlankWindow = hWnd;
+  mVBlankMonitor = MonitorFromWindow(hWnd, MONITOR_DEFAULTTONEAREST);
+  VBlankDispatcher::Get().Add(this, mVBlankMonitor);
+}
+
+void IGraphicsWin::StopVBlankThread()
+{
+  if (mVBlankWindow)
   {
-    FreeLibrary((HMODULE)hInst);
-    hInst = nullptr;
+    VBlankDispatcher::Get().Remove(this);
+    mVBlankWindow = 0;
+    mVBlankMonitor = nullptr;
   }
-
-  return 0;
 }
 
 void IGraphicsWin::VBlankNotify()
 {
   mVBlankCount++;
+#ifdef IGRAPHICS_RENDER_THREAD
+  RenderFrame();
+#endif
   ::PostMessage(mVBlankWindow, WM_VBLANK, mVBlankCount, 0);
 }
 
+#ifdef IGRAPHICS_RENDER_THREAD
+void IGraphicsWin::RenderFrame()
+{
+  // if the main thread is using the controls, skip this frame rather than holding up the VBlank thread
+  std::unique_lock<std::recursive_mutex> renderLock(GetRenderMutex(), std::try_to_lock);
+
+  if (!renderLock.owns_lock() || mParamEditWnd)
+    return;
+
+  IRECTList rects;
+
+  if (IsDirty(rects))
+  {
+    SetAllControlsClean();
+    ActivateGLContext();
+    Draw(rects);
+    SwapBuffers((HDC) GetPlatformContext());
+    DeactivateGLContext();
+  }
+}
+
+void IGraphicsWin::ProcessDeferredInput()
+{
+  if (mDeferredInput.empty())
+    return;
+
+  std::vector<MSG> msgs;
+  msgs.swap(mDeferredInput);
+  mProcessingDeferredInput = true;
+
+  for (const MSG& m : msgs)
+    WndProc(m.hwnd, m.message, m.wParam, m.lParam);
+
+  mProcessingDeferredInput = false;
+}
+
+// static
+bool IGraphicsWin::IsInputMsg(UINT msg)
+{
+  return (msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST) || (msg >= WM_KEYFIRST && msg <= WM_KEYLAST) ||
+         msg == WM_MOUSEHOVER || msg == WM_MOUSELEAVE || msg == WM_TOUCH;
+}
+#endif
+
 #ifndef NO_IGRAPHICS
 #if defined IGRAPHICS_SKIA
   #include "IGraphicsSkia.cpp"
@@ -26,6 +26,7 @@ class IGraphicsWin final : public IGRAPHICS_DRAW_CLASS
   class Font;
   class InstalledFont;
   struct HFontHolder;
+  class VBlankDispatcher;
 public:
   IGraphicsWin(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
   ~IGraphicsWin();
@@ -89,8 +90,6 @@ public:
   static LRESULT CALLBACK ParamEditProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
   static BOOL CALLBACK FindMainWindow(HWND hWnd, LPARAM lParam);
 
-  DWORD OnVBlankRun();
-
 protected:
   IPopupMenu* CreatePlatformPopupMenu(IPopupMenu& menu, const IRECT bounds, bool& isAsync) override;
   void CreatePlatformTextEntry(int paramIdx, const IText& text, const IRECT& bounds, int length, const char* str) override;
@@ -143,15 +142,27 @@ private:
   HFONT mEditFont = nullptr;
   DWORD mPID = 0;
 
+  /** Register the window with the VBlankDispatcher thread of the monitor it is on, which is shared with the other windows on that monitor */
   void StartVBlankThread(HWND hWnd);
+  /** Unregister the window, after this returns the vblank thread doesn't call it any more */
   void StopVBlankThread();
+  /** Called on the vblank thread of mVBlankMonitor for every vsync */
   void VBlankNotify();
   HWND mVBlankWindow = 0; // Window to post messages to for every vsync
-  volatile bool mVBlankShutdown = false; // Flag to indiciate that the vsync thread should shutdown
-  HANDLE mVBlankThread = INVALID_HANDLE_VALUE; //ID of thread.
+  HMONITOR mVBlankMonitor = nullptr; // the monitor whose vblank thread notifies the window, the one that has most of the window if it spans several
   volatile DWORD mVBlankCount = 0; // running count of vblank events since the start of the window.
   int mVBlankSkipUntil = 0; // support for skipping vblank notification if the last callback took  too long.  This helps keep the message pump clear in the case of overload.
   bool mVSYNCEnabled = false;
+
+#ifdef IGRAPHICS_RENDER_THREAD
+  /** Called on the VBlank thread to draw a frame, if the controls aren't in use on the main thread */
+  void RenderFrame();
+  /** Called on the main thread with the render mutex locked, to handle the input messages that arrived while a frame was being drawn, in order */
+  void ProcessDeferredInput();
+  static bool IsInputMsg(UINT msg);
+  std::vector<MSG> mDeferredInput; // main thread only
+  bool mProcessingDeferredInput = false;
+#endif
   
   const IParam* mEditParam = nullptr;
   IText mEditText;
@@ -10,6 +10,7 @@
 
 #include "IPlugAAX.h"
 #include "IPlugAAX_view_interface.h"
+#include "IPlugRealtimeCheck.h"
 #include "AAX_CBinaryTaperDelegate.h"
 #include "AAX_CBinaryDisplayDelegate.h"
 #include "AAX_CStringDisplayDelegate.h"
@@ -109,7 +110,7 @@ IPlugAAX::IPlugAAX(const InstanceInfo& info, const Config& config)
   if (MaxNChannels(ERoute::kInput)) 
   {
     mLatencyDelay = std::unique_ptr<NChanDelayLine<PLUG_SAMPLE_DST>>(new NChanDelayLine<PLUG_SAMPLE_DST>(MaxNChannels(ERoute::kInput), MaxNChannels(ERoute::kOutput)));
-    mLatencyDelay->SetDelayTime(config.latency);
+    mLatencyDelay->SetDelayTime(GetReportedLatency());
   }
   
   SetBlockSize(DEFAULT_BLOCK_SIZE);
@@ -216,9 +217,34 @@ AAX_Result IPlugAAX::EffectInit()
     mParameterManager.AddParameter(pAAXParam);
   }
   
+  mParamChangesFromHost.Resize(0);
+  mParamIsChangedFromHost.Resize(NParams());
+  memset(mParamIsChangedFromHost.Get(), 0, NParams() * sizeof(bool));
+  
+  // the stem formats are fixed for an instance, so the channel connections are only set up here, and when the side chain changes
+  AAX_EStemFormat inFormat, outFormat;
+  Controller()->GetInputStemFormat(&inFormat);
+  Controller()->GetOutputStemFormat(&outFormat);
+  mNumInChannels = AAX_STEM_FORMAT_CHANNEL_COUNT(inFormat);
+  mNumOutChannels = AAX_STEM_FORMAT_CHANNEL_COUNT(outFormat);
+  
+  if (!IsInstrument())
+  {
+    SetChannelConnections(ERoute::kInput, 0, mNumInChannels, true);
+    SetChannelConnections(ERoute::kInput, mNumInChannels, MaxNChannels(ERoute::kInput) - mNumInChannels, false);
+    mSideChainConnected = false;
+  }
+  
+  const int maxNOutChans = MaxNChannels(ERoute::kOutput);
+  SetChannelConnections(ERoute::kOutput, 0, maxNOutChans, true);
+  
+  if (MaxNBuses(kOutput) == 1) // single output bus, only connect available channels
+    SetChannelConnections(ERoute::kOutput, mNumOutChannels, maxNOutChans - mNumOutChannels, false);
+  
   AAX_CSampleRate sr;
   Controller()->GetSampleRate(&sr);
   SetSampleRate(sr);
+  InitParamBuffers(GetParams());
   OnReset();
   
   return AAX_SUCCESS;
@@ -245,8 +271,14 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID paramID, double
     ENTER_PARAMS_MUTEX
     GetParam(paramIdx)->SetNormalized(iValue);
     SendParameterValueFromAPI(paramIdx, iValue, true);
-    OnParamChange(paramIdx, kHost);
     LEAVE_PARAMS_MUTEX
+    
+    // OnParamChange() is called once per parameter for the whole batch of updates, see GenerateCoefficients()
+    if (!mParamIsChangedFromHost.Get()[paramIdx])
+    {
+      mParamIsChangedFromHost.Get()[paramIdx] = true;
+      mParamChangesFromHost.Add(paramIdx);
+    }
   }
   
   // Now the control has changed
@@ -257,17 +289,58 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID paramID, double
   return result;
 }
 
+AAX_Result IPlugAAX::GenerateCoefficients()
+{
+  // queue the parameters that changed in this batch of updates, so that they reach the render callback together
+  const int nChanges = mParamChangesFromHost.GetSize();
+  
+  for (auto i = 0; i < nChanges; i++)
+  {
+    const int paramIdx = mParamChangesFromHost.Get()[i];
+    mParamIsChangedFromHost.Get()[paramIdx] = false;
+    
+    if (!mParamChangeQueue.Push(ParamChange(paramIdx, GetParam(paramIdx)->GetNormalized())))
+    {
+      // the queue is full, so notify the plug-in here instead
+      ENTER_PARAMS_MUTEX
+      OnParamChange(paramIdx, kHost);
+      LEAVE_PARAMS_MUTEX
+    }
+  }
+  
+  mParamChangesFromHost.Resize(0, false);
+  
+  return AAX_CIPlugParameters::GenerateCoefficients();
+}
+
+void IPlugAAX::ApplyParamChange(const ParamChange& change)
+{
+  GetParam(change.idx)->SetNormalized(change.normalizedValue);
+  OnParamChange(change.idx, kHost, change.offset);
+}
+
 void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPair* inSynchronizedParamValues[], int32_t inNumSynchronizedParamValues)
 {
   TRACE
+  IPLUG_MARK_REALTIME_THREAD();
 
   // Get bypass parameter value
   bool bypass;
   mBypassParameter->GetValueAsBool(&bypass);
   
-  AAX_EStemFormat inFormat, outFormat;
-  Controller()->GetInputStemFormat(&inFormat);
-  Controller()->GetOutputStemFormat(&outFormat);
+  int32_t numSamples = *(pRenderInfo->mNumSamples);
+  
+  if (mParamChangeQueue.ElementsAvailable())
+  {
+    ParamChange change;
+    
+    ENTER_PARAMS_MUTEX
+    while (mParamChangeQueue.Pop(change))
+    {
+      ApplyParamChange(change);
+    }
+    LEAVE_PARAMS_MUTEX
+  }
   
   if (DoesMIDIIn()) 
   {
@@ -278,8 +351,10 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
     
     for (auto i = 0; i<packets_count; i++, pMidiPacket++)
     {
-      IMidiMsg msg(pMidiPacket->mTimestamp, pMidiPacket->mData[0], pMidiPacket->mData[1], pMidiPacket->mData[2]);
-      ProcessMidiMsg(msg);
+      // the timestamps are offsets in this buffer, so with sub-block processing HandleMidiMsg() splits the block at each message
+      const int offset = pMidiPacket->mIsImmediate ? 0 : Clip(static_cast<int>(pMidiPacket->mTimestamp), 0, std::max(numSamples - 1, 0));
+      IMidiMsg msg(offset, pMidiPacket->mData[0], pMidiPacket->mData[1], pMidiPacket->mData[2]);
+      HandleMidiMsg(msg);
       mMidiMsgsFromProcessor.Push(msg);
     }
   }
@@ -287,10 +362,6 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
   AAX_IMIDINode* pTransportNode = pRenderInfo->mTransportNode;
   mTransport = pTransportNode->GetTransport();
 
-  int32_t numSamples = *(pRenderInfo->mNumSamples);
-  int32_t numInChannels = AAX_STEM_FORMAT_CHANNEL_COUNT(inFormat);
-  int32_t numOutChannels = AAX_STEM_FORMAT_CHANNEL_COUNT(outFormat);
-
   if (numSamples > GetBlockSize())
   {
     SetBlockSize(numSamples);
@@ -299,34 +370,22 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
 
   if (!IsInstrument())
   {
-    SetChannelConnections(ERoute::kInput, 0, numInChannels, true);
-    SetChannelConnections(ERoute::kInput, numInChannels, MaxNChannels(ERoute::kInput) - numInChannels, false);
+    const int sideChainChannel = HasSidechainInput() ? *pRenderInfo->mSideChainP : 0;
+
+    if ((sideChainChannel != 0) != mSideChainConnected)
+    {
+      mSideChainConnected = (sideChainChannel != 0);
+      SetChannelConnections(ERoute::kInput, mMaxNChansForMainInputBus, 1, mSideChainConnected);
+    }
     
-    int sideChainChannel = HasSidechainInput() ? *pRenderInfo->mSideChainP : 0;
+    AttachBuffers(ERoute::kInput, 0, mNumInChannels, pRenderInfo->mAudioInputs, numSamples);
 
     if (sideChainChannel)
-    {
-      SetChannelConnections(ERoute::kInput, mMaxNChansForMainInputBus, 1, true);
-      AttachBuffers(ERoute::kInput, 0, numInChannels, pRenderInfo->mAudioInputs, numSamples);
       AttachBuffers(ERoute::kInput, mMaxNChansForMainInputBus, 1, pRenderInfo->mAudioInputs + sideChainChannel, numSamples);
-    }
-    else
-      AttachBuffers(ERoute::kInput, 0, numInChannels, pRenderInfo->mAudioInputs, numSamples);
   }
-    
-  int maxNOutChans = MaxNChannels(ERoute::kOutput);
   
-  SetChannelConnections(ERoute::kOutput, 0, maxNOutChans, true);
-  
-  if (MaxNBuses(kOutput) == 1) // single output bus, only connect available channels
-  {
-    SetChannelConnections(ERoute::kOutput, numOutChannels, maxNOutChans - numOutChannels, false);
-    AttachBuffers(ERoute::kOutput, 0, maxNOutChans, pRenderInfo->mAudioOutputs, numSamples);
-  }
-  else // multi output buses, connect all buffers including AOS
-  {
-    AttachBuffers(ERoute::kOutput, 0, maxNOutChans, pRenderInfo->mAudioOutputs, numSamples);
-  }
+  // with multiple output buses, all buffers are connected including AOS
+  AttachBuffers(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), pRenderInfo->mAudioOutputs, numSamples);
   
   if (bypass) 
     PassThroughBuffers(0.0f, numSamples);
@@ -359,12 +418,11 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
     SetTimeInfo(timeInfo);
     //timeInfo.mLastBar ??
     
-    IMidiMsg msg;
-    
-    while (mMidiMsgsFromEditor.Pop(msg))
-    {
-      ProcessMidiMsg(msg);
-    }
+    ApplyDeferredParamReset();
+
+    ProcessMidiMsgsFromEditor(numSamples, GetSampleRate(), [this](const IMidiMsg& msg) {
+      HandleMidiMsg(msg);
+    });
     
     ENTER_PARAMS_MUTEX
     ProcessBuffers(0.0f, numSamples);
@@ -383,7 +441,7 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
       {        
         while (!mMidiOutputQueue.Empty())
         {
-          IMidiMsg& msg = mMidiOutputQueue.Peek();
+          const IMidiMsg& msg = mMidiOutputQueue.Peek();
           
           AAX_CMidiPacket packet;
           
@@ -433,6 +491,8 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
         }
       }
     }
+    else
+      mMidiOutputQueue.Clear();
   }
 }
 
@@ -501,8 +561,7 @@ AAX_Result IPlugAAX::SetChunk(AAX_CTypeID chunkID, const AAX_SPlugInChunk* pChun
   
   if (chunkID == GetUniqueID())
   {    
-    IByteChunk chunk;
-    chunk.PutBytes(pChunk->fData, pChunk->fSize);
+    const IByteChunk chunk = IByteChunk::View(pChunk->fData, pChunk->fSize);
     int pos = 0;
     //IByteChunk::GetIPlugVerFromChunk(chunk, pos); // TODO: IPlugVer should be in chunk!
     pos = UnserializeState(chunk, pos);
@@ -608,13 +667,12 @@ bool IPlugAAX::EditorResize(int viewWidth, int viewHeight)
 
 void IPlugAAX::SetLatency(int latency)
 {
-  Controller()->SetSignalLatency(latency);
-  
   IPlugProcessor::SetLatency(latency); // will update delay time
+  
+  Controller()->SetSignalLatency(GetReportedLatency());
 }
 
 bool IPlugAAX::SendMidiMsg(const IMidiMsg& msg)
 {
-  mMidiOutputQueue.Add(msg);
-  return true;
+  return mMidiOutputQueue.Add(msg);
 }
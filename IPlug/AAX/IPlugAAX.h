@@ -99,6 +99,8 @@ public:
   bool SendMidiMsg(const IMidiMsg& msg) override;
   
   AAX_Result UpdateParameterNormalizedValue(AAX_CParamID iParameterID, double iValue, AAX_EUpdateSource iSource) override;
+  AAX_Result GenerateCoefficients() override;
+  void ApplyParamChange(const ParamChange& change) override;
   
   //AAX_CIPlugParameters Overrides
   static AAX_CEffectParameters *AAX_CALLBACK Create();
@@ -122,9 +124,14 @@ private:
   AAX_CParameter<bool>* mBypassParameter = nullptr;
   AAX_ITransport* mTransport = nullptr;
   WDL_PtrList<WDL_String> mParamIDs;
-  IMidiQueue mMidiOutputQueue;
   int mMaxNChansForMainInputBus = 0;
+  int mNumInChannels = 0; // from the stem formats, which don't change for an instance
+  int mNumOutChannels = 0;
+  bool mSideChainConnected = false;
   WDL_String mTrackName;
+  WDL_TypedBuf<int> mParamChangesFromHost; // the parameters changed since the last call to GenerateCoefficients()
+  WDL_TypedBuf<bool> mParamIsChangedFromHost;
+  IPlugQueue<ParamChange> mParamChangeQueue {PARAM_TRANSFER_SIZE}; // a batch of changes per call to GenerateCoefficients(), delivered in RenderAudio()
 };
 
 IPlugAAX* MakePlug(const InstanceInfo& info);
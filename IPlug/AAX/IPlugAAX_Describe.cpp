@@ -171,7 +171,11 @@ AAX_Result GetEffectDescriptions(AAX_ICollection* pC)
     setupInfo.mOutputMIDIChannelMask = 0x0001;
     
     setupInfo.mNeedsTransport = true;
+#ifdef PLUG_INTERNAL_BLOCK_SIZE
+    setupInfo.mLatency = PLUG_LATENCY + PLUG_INTERNAL_BLOCK_SIZE;
+#else
     setupInfo.mLatency = PLUG_LATENCY;
+#endif
   };
   
   if((PLUG_TYPE != 1) && (totalNInBuses > 1)) // Effect with sidechain input
@@ -10,6 +10,7 @@
 
 #include "IPlugAPP.h"
 #include "IPlugAPP_host.h"
+#include "IPlugRealtimeCheck.h"
 
 #if defined OS_MAC || defined OS_LINUX
 #include <IPlugSWELL.h>
@@ -119,8 +120,9 @@ void IPlugAPP::SendSysexMsgFromUI(const ISysEx& msg)
   SendSysEx(msg);
 }
 
-void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
+void IPlugAPP::AppProcess(float** inputs, float** outputs, int nFrames)
 {
+  IPLUG_MARK_REALTIME_THREAD();
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument()); //TODO: go elsewhere - enable inputs
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
   AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, GetBlockSize());
@@ -132,7 +134,7 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
     
     while (mMidiMsgsFromCallback.Pop(msg))
     {
-      ProcessMidiMsg(msg);
+      HandleMidiMsg(msg);
       mMidiMsgsFromProcessor.Push(msg); // queue incoming MIDI for UI
     }
   }
@@ -149,19 +151,15 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
     }
   }
   
-  if(mMidiMsgsFromEditor.ElementsAvailable())
-  {
-    IMidiMsg msg;
+  ApplyDeferredParamReset();
 
-    while (mMidiMsgsFromEditor.Pop(msg))
-    {
-      ProcessMidiMsg(msg);
-    }
-  }
+  ProcessMidiMsgsFromEditor(nFrames, GetSampleRate(), [this](const IMidiMsg& msg) {
+    HandleMidiMsg(msg);
+  });
 
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
   ENTER_PARAMS_MUTEX
-  ProcessBuffers(0.0, GetBlockSize());
+  ProcessBuffers(0.f, GetBlockSize());
   LEAVE_PARAMS_MUTEX
 }
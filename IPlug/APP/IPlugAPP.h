@@ -53,7 +53,7 @@ public:
   bool SendSysEx(const ISysEx& msg) override;
   
   //IPlugAPP
-  void AppProcess(double** inputs, double** outputs, int nFrames);
+  void AppProcess(float** inputs, float** outputs, int nFrames);
 
 private:
   IPlugAPPHost* mAppHost = nullptr;
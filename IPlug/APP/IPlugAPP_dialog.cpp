@@ -209,6 +209,81 @@ void IPlugAPPHost::PopulateAudioDialogs(HWND hwndDlg)
 
   LRESULT iovsidx = SendDlgItemMessage(hwndDlg, IDC_COMBO_AUDIO_BUF_SIZE, CB_FINDSTRINGEXACT, -1, (LPARAM) str.Get());
   SendDlgItemMessage(hwndDlg, IDC_COMBO_AUDIO_BUF_SIZE, CB_SETCURSEL, iovsidx, 0);
+  
+  PopulateLatencyInfo(hwndDlg);
+}
+
+// Shows the round trip latency of the running stream, if the dialog resource has a text control for it
+void IPlugAPPHost::PopulateLatencyInfo(HWND hwndDlg)
+{
+#ifdef IDC_TXT_AUDIO_LATENCY
+  WDL_String str;
+  const uint32_t latency = GetRoundTripLatency();
+
+  if (latency)
+    str.SetFormatted(64, "Round trip latency:\n%u samples (%.1f ms)", latency, 1000. * latency / mSampleRate);
+  else
+    str.Set("Round trip latency:\nn/a");
+
+  SetDlgItemText(hwndDlg, IDC_TXT_AUDIO_LATENCY, str.Get());
+#endif
+}
+
+// Shows the DSP load histogram and the last xruns of the running stream, if the dialog resource has a text control for it. Refreshed by a timer while the dialog is open
+void IPlugAPPHost::PopulatePerformanceInfo(HWND hwndDlg)
+{
+#ifdef IDC_TXT_AUDIO_PERFORMANCE
+  static const char* kBucketStrs[kNumLoadBuckets] = { "< 25%", "25-50%", "50-75%", "75-90%", "90-100%", "> 100%" };
+  static constexpr int kNumXrunsShown = 4;
+  static constexpr int kMaxBarLength = 30;
+
+  XrunRecord xrun;
+
+  while (mXrunQueue.Pop(xrun))
+  {
+    if (mXrunLog.size() == kXrunLogSize)
+      mXrunLog.erase(mXrunLog.begin());
+
+    mXrunLog.push_back(xrun);
+  }
+
+  uint32_t counts[kNumLoadBuckets];
+  uint32_t total = 0;
+
+  for (int i = 0; i < kNumLoadBuckets; i++)
+    total += counts[i] = mLoadHistogram[i].load(std::memory_order_relaxed);
+
+  WDL_String str;
+  str.SetFormatted(128, "DSP load, %u callbacks, peak %.0f%%\n", total, 100.f * mPeakLoad.load(std::memory_order_relaxed));
+
+  for (int i = 0; i < kNumLoadBuckets; i++)
+  {
+    const double proportion = total ? (double) counts[i] / total : 0.;
+    const int barLength = counts[i] ? std::max(1, (int) (proportion * kMaxBarLength)) : 0;
+    str.AppendFormatted(128, "%-8s %5.1f%% %.*s\n", kBucketStrs[i], 100. * proportion, barLength, "||||||||||||||||||||||||||||||");
+  }
+
+  str.AppendFormatted(64, "\nXruns: %u\n", mNumXruns.load(std::memory_order_relaxed));
+
+  // an xrun after a callback that used (nearly) all of its buffer is attributed to the DSP, otherwise the callback was late, e.g. because of the driver or scheduling
+  for (size_t i = mXrunLog.size() > kNumXrunsShown ? mXrunLog.size() - kNumXrunsShown : 0; i < mXrunLog.size(); i++)
+  {
+    const XrunRecord& record = mXrunLog[i];
+    const float lastLoad = record.precedingLoads[kNumXrunPrecedingLoads - 1];
+    float maxLoad = record.load;
+
+    for (float load : record.precedingLoads)
+      maxLoad = std::max(maxLoad, load);
+
+    const char* typeStr = record.status == (RTAUDIO_INPUT_OVERFLOW | RTAUDIO_OUTPUT_UNDERFLOW) ? "in+out" : record.status & RTAUDIO_INPUT_OVERFLOW ? "in" : "out";
+    const char* causeStr = std::max(lastLoad, record.load) >= 0.9f ? "likely DSP" : "likely system";
+
+    str.AppendFormatted(128, "%.2fs %s, load %.0f%% (prev %.0f%%, max %.0f%%): %s\n", record.streamTime, typeStr,
+                        100.f * record.load, 100.f * lastLoad, 100.f * maxLoad, causeStr);
+  }
+
+  SetDlgItemText(hwndDlg, IDC_TXT_AUDIO_PERFORMANCE, str.Get());
+#endif
 }
 
 bool IPlugAPPHost::PopulateMidiDialogs(HWND hwndDlg)
@@ -277,6 +352,9 @@ void IPlugAPPHost::PopulatePreferencesDialog(HWND hwndDlg)
 {
   SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"DirectSound");
   SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"ASIO");
+#ifdef __WINDOWS_WASAPI__
+  SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"WASAPI");
+#endif
   SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_SETCURSEL, mState.mAudioDriverType, 0);
 
   PopulateAudioDialogs(hwndDlg);
@@ -287,7 +365,9 @@ void IPlugAPPHost::PopulatePreferencesDialog(HWND hwndDlg)
 void IPlugAPPHost::PopulatePreferencesDialog(HWND hwndDlg)
 {
   SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"CoreAudio");
-  //SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"Jack");
+#ifdef __UNIX_JACK__
+  SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_ADDSTRING,0,(LPARAM)"Jack");
+#endif
   SendDlgItemMessage(hwndDlg,IDC_COMBO_AUDIO_DRIVER,CB_SETCURSEL, mState.mAudioDriverType, 0);
 
   PopulateAudioDialogs(hwndDlg);
@@ -318,9 +398,25 @@ WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
     case WM_INITDIALOG:
       _this->PopulatePreferencesDialog(hwndDlg);
       mTempState = mState;
+#ifdef IDC_TXT_AUDIO_PERFORMANCE
+      _this->PopulatePerformanceInfo(hwndDlg);
+      SetTimer(hwndDlg, IDC_TXT_AUDIO_PERFORMANCE, 500, NULL);
+#endif
       
       return TRUE;
 
+#ifdef IDC_TXT_AUDIO_PERFORMANCE
+    case WM_TIMER:
+      if (wParam == IDC_TXT_AUDIO_PERFORMANCE)
+        _this->PopulatePerformanceInfo(hwndDlg);
+
+      return TRUE;
+
+    case WM_DESTROY:
+      KillTimer(hwndDlg, IDC_TXT_AUDIO_PERFORMANCE);
+      return FALSE;
+#endif
+
     case WM_COMMAND:
       switch (LOWORD(wParam))
       {
@@ -332,6 +428,7 @@ WDL_DLGRET IPlugAPPHost::PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wPar
           break;
         case IDAPPLY:
           _this->TryToChangeAudio();
+          _this->PopulateLatencyInfo(hwndDlg);
           break;
         case IDCANCEL:
           EndDialog(hwndDlg, IDCANCEL);
@@ -30,6 +30,8 @@ UINT gSCROLLMSG;
 IPlugAPPHost::IPlugAPPHost()
 : mIPlug(MakePlug(InstanceInfo{this}))
 {
+  for (int i = 1; i < APP_NUM_INSTANCES; i++)
+    mChainedPlugs.push_back(std::unique_ptr<IPlugAPP>(MakePlug(InstanceInfo{this})));
 }
 
 IPlugAPPHost::~IPlugAPPHost()
@@ -54,7 +56,8 @@ IPlugAPPHost* IPlugAPPHost::Create()
 
 bool IPlugAPPHost::Init()
 {
-  mIPlug->SetHost("standalone", mIPlug->GetPluginVersion(false));
+  for (int i = 0; i < NInstances(); i++)
+    GetPlug(i)->SetHost("standalone", mIPlug->GetPluginVersion(false));
     
   if (!InitState())
     return false;
@@ -66,8 +69,11 @@ bool IPlugAPPHost::Init()
   SelectMIDIDevice(ERoute::kInput, mState.mMidiInDev.Get());
   SelectMIDIDevice(ERoute::kOutput, mState.mMidiOutDev.Get());
   
-  mIPlug->OnParamReset(kReset);
-  mIPlug->OnActivate(true);
+  for (int i = 0; i < NInstances(); i++)
+  {
+    GetPlug(i)->OnParamReset(kReset);
+    GetPlug(i)->OnActivate(true);
+  }
   
   return true;
 }
@@ -374,13 +380,19 @@ bool IPlugAPPHost::TryToChangeAudioDriverType()
 #if defined OS_WIN
   if(mState.mAudioDriverType == kDeviceASIO)
     mDAC = std::make_unique<RtAudio>(RtAudio::WINDOWS_ASIO);
+#ifdef __WINDOWS_WASAPI__
+  else if(mState.mAudioDriverType == kDeviceWASAPI)
+    mDAC = std::make_unique<RtAudio>(RtAudio::WINDOWS_WASAPI);
+#endif
   else
     mDAC = std::make_unique<RtAudio>(RtAudio::WINDOWS_DS);
 #elif defined OS_MAC
   if(mState.mAudioDriverType == kDeviceCoreAudio)
     mDAC = std::make_unique<RtAudio>(RtAudio::MACOSX_CORE);
-  //else
-  //mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK);
+#ifdef __UNIX_JACK__
+  else if(mState.mAudioDriverType == kDeviceJack)
+    mDAC = std::make_unique<RtAudio>(RtAudio::UNIX_JACK); // also PipeWire, via its JACK API
+#endif
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -592,27 +604,45 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
          sr, mBufferSize, inId, GetAudioDeviceName(inId).c_str(), outId, GetAudioDeviceName(outId).c_str(), iParams.nChannels, oParams.nChannels);
 
   RtAudio::StreamOptions options;
-  options.flags = RTAUDIO_NONINTERLEAVED;
-  // options.streamName = BUNDLE_NAME; // JACK stream name, not used on other streams
+  options.flags = RTAUDIO_NONINTERLEAVED | RTAUDIO_SCHEDULE_REALTIME; // run the callback thread at realtime priority, where the API creates it
+  options.priority = std::numeric_limits<int>::max(); // clamped to the maximum realtime priority by RtAudio
+#ifdef OS_WIN
+  if(mState.mAudioDriverType == kDeviceDS)
+    options.flags |= RTAUDIO_MINIMIZE_LATENCY; // use the fewest DirectSound buffers. Not on CoreAudio, where it overrides the buffer size
+#endif
+  options.streamName = BUNDLE_NAME; // JACK client name, not used on other streams
 
   mBufIndex = 0;
   mSamplesElapsed = 0;
   mSampleRate = (double) sr;
   mVecWait = 0;
+  mStreamLatency = 0;
   mAudioEnding = false;
   mAudioDone = false;
+  ResetPerformanceStats();
   
-  mIPlug->SetBlockSize(APP_SIGNAL_VECTOR_SIZE);
-  mIPlug->SetSampleRate(mSampleRate);
-  mIPlug->OnReset();
+  for (int i = 0; i < NInstances(); i++)
+  {
+    IPlugAPP* pPlug = GetPlug(i);
+    pPlug->SetBlockSize(APP_SIGNAL_VECTOR_SIZE);
+    pPlug->SetSampleRate(mSampleRate);
+    pPlug->InitParamBuffers(pPlug->GetParams());
+    pPlug->OnReset();
+  }
 
   try
   {
-    mDAC->openStream(&oParams, iParams.nChannels > 0 ? &iParams : nullptr, RTAUDIO_FLOAT64, sr, &mBufferSize, &AudioCallback, this, &options /*, &ErrorCallback */);
+    mDAC->openStream(&oParams, iParams.nChannels > 0 ? &iParams : nullptr, RTAUDIO_FLOAT32, sr, &mBufferSize, &AudioCallback, this, &options /*, &ErrorCallback */);
+    
+    mInputBufPtrs.Empty();
+    mOutputBufPtrs.Empty();
+    mChainInputBufPtrs.Empty();
+    mChainOutputBufPtrs.Empty();
     
     for (int i = 0; i < iParams.nChannels; i++)
     {
       mInputBufPtrs.Add(nullptr); //will be set in callback
+      mChainInputBufPtrs.Add(nullptr); //will be set in callback
     }
     
     for (int i = 0; i < oParams.nChannels; i++)
@@ -620,8 +650,20 @@ bool IPlugAPPHost::InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_
       mOutputBufPtrs.Add(nullptr); //will be set in callback
     }
     
+    if (NInstances() > 1)
+    {
+      mChainBuf.Resize((oParams.nChannels + 1) * APP_SIGNAL_VECTOR_SIZE);
+      memset(mChainBuf.Get(), 0, mChainBuf.GetSize() * sizeof(float));
+      
+      for (int i = 0; i < oParams.nChannels; i++)
+      {
+        mChainOutputBufPtrs.Add(mChainBuf.Get() + (i * APP_SIGNAL_VECTOR_SIZE));
+      }
+    }
+    
     mDAC->startStream();
 
+    mStreamLatency = static_cast<uint32_t>(std::max(mDAC->getStreamLatency(), 0L));
     mActiveState = mState;
   }
   catch (RtAudioError& e)
@@ -663,21 +705,93 @@ bool IPlugAPPHost::InitMidi()
   return true;
 }
 
-void ApplyFades(double *pBuffer, int nChans, int nFrames, bool down)
+uint32_t IPlugAPPHost::GetRoundTripLatency() const
+{
+  if (!mDAC || !mDAC->isStreamRunning())
+    return 0;
+  
+  const uint32_t nBuffers = mIPlug->MaxNChannels(ERoute::kInput) > 0 ? 2 : 1;
+  uint32_t plugLatency = 0;
+  
+  for (int i = 0; i < NInstances(); i++)
+  {
+#if APP_PARALLEL_INSTANCES
+    plugLatency = std::max(plugLatency, static_cast<uint32_t>(GetPlug(i)->GetReportedLatency()));
+#else
+    plugLatency += GetPlug(i)->GetReportedLatency();
+#endif
+  }
+  
+  return mStreamLatency + (nBuffers * mBufferSize) + plugLatency;
+}
+
+void IPlugAPPHost::ProcessInstances()
+{
+  float** ppInputs = mInputBufPtrs.GetList();
+  float** ppOutputs = mOutputBufPtrs.GetList();
+  const int nStages = NInstances();
+  
+  if (nStages == 1)
+  {
+    mIPlug->AppProcess(ppInputs, ppOutputs, APP_SIGNAL_VECTOR_SIZE);
+    return;
+  }
+  
+  const int nins = mChainInputBufPtrs.GetSize();
+  const int nouts = mOutputBufPtrs.GetSize();
+  float** ppChainOutputs = mChainOutputBufPtrs.GetList();
+  
+#if APP_PARALLEL_INSTANCES
+  // every instance processes the device input, the chained instances' outputs are summed into the first one's
+  mIPlug->AppProcess(ppInputs, ppOutputs, APP_SIGNAL_VECTOR_SIZE);
+  
+  for (auto& pPlug : mChainedPlugs)
+  {
+    pPlug->AppProcess(ppInputs, ppChainOutputs, APP_SIGNAL_VECTOR_SIZE);
+    
+    for (int c = 0; c < nouts; c++)
+    {
+      for (int s = 0; s < APP_SIGNAL_VECTOR_SIZE; s++)
+        ppOutputs[c][s] += ppChainOutputs[c][s];
+    }
+  }
+#else
+  // each instance processes the previous one's output. The stages alternate between the device output and the scratch buffers,
+  // so that no stage reads and writes the same buffer and the last one writes to the device, without copying
+  float* pSilence = mChainBuf.Get() + (nouts * APP_SIGNAL_VECTOR_SIZE);
+  float** ppStageInputs = ppInputs;
+  
+  for (int i = 0; i < nStages; i++)
+  {
+    float** ppStageOutputs = ((nStages - 1 - i) % 2 == 0) ? ppOutputs : ppChainOutputs;
+    
+    GetPlug(i)->AppProcess(ppStageInputs, ppStageOutputs, APP_SIGNAL_VECTOR_SIZE);
+    
+    for (int c = 0; c < nins; c++)
+    {
+      mChainInputBufPtrs.Set(c, c < nouts ? ppStageOutputs[c] : pSilence);
+    }
+    
+    ppStageInputs = mChainInputBufPtrs.GetList();
+  }
+#endif
+}
+
+void ApplyFades(float *pBuffer, int nChans, int nFrames, bool down)
 {
   for (int i = 0; i < nChans; i++)
   {
-    double *pIO = pBuffer + (i * nFrames);
+    float *pIO = pBuffer + (i * nFrames);
     
     if (down)
     {
       for (int j = 0; j < nFrames; j++)
-        pIO[j] *= ((double) (nFrames - (j + 1)) / (double) nFrames);
+        pIO[j] *= ((float) (nFrames - (j + 1)) / (float) nFrames);
     }
     else
     {
       for (int j = 0; j < nFrames; j++)
-        pIO[j] *= ((double) j / (double) nFrames);
+        pIO[j] *= ((float) j / (float) nFrames);
     }
   }
 }
@@ -686,12 +800,13 @@ void ApplyFades(double *pBuffer, int nChans, int nFrames, bool down)
 int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_t nFrames, double streamTime, RtAudioStreamStatus status, void* pUserData)
 {
   IPlugAPPHost* _this = (IPlugAPPHost*) pUserData;
+  const auto callbackStart = std::chrono::steady_clock::now();
 
   int nins = _this->GetPlug()->MaxNChannels(ERoute::kInput);
   int nouts = _this->GetPlug()->MaxNChannels(ERoute::kOutput);
   
-  double* pInputBufferD = static_cast<double*>(pInputBuffer);
-  double* pOutputBufferD = static_cast<double*>(pOutputBuffer);
+  float* pInputBufferF = static_cast<float*>(pInputBuffer);
+  float* pOutputBufferF = static_cast<float*>(pOutputBuffer);
 
   bool startWait = _this->mVecWait >= APP_N_VECTOR_WAIT; // wait APP_N_VECTOR_WAIT * iovs before processing audio, to avoid clicks
   bool doFade = _this->mVecWait == APP_N_VECTOR_WAIT || _this->mAudioEnding;
@@ -699,7 +814,7 @@ int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_
   if (startWait && !_this->mAudioDone)
   {
     if (doFade)
-      ApplyFades(pInputBufferD, nins, nFrames, _this->mAudioEnding);
+      ApplyFades(pInputBufferF, nins, nFrames, _this->mAudioEnding);
     
     for (int i = 0; i < nFrames; i++)
     {
@@ -709,43 +824,96 @@ int IPlugAPPHost::AudioCallback(void* pOutputBuffer, void* pInputBuffer, uint32_
       {
         for (int c = 0; c < nins; c++)
         {
-          _this->mInputBufPtrs.Set(c, (pInputBufferD + (c * nFrames)) + i);
+          _this->mInputBufPtrs.Set(c, (pInputBufferF + (c * nFrames)) + i);
         }
         
         for (int c = 0; c < nouts; c++)
         {
-          _this->mOutputBufPtrs.Set(c, (pOutputBufferD + (c * nFrames)) + i);
+          _this->mOutputBufPtrs.Set(c, (pOutputBufferF + (c * nFrames)) + i);
         }
         
-        _this->mIPlug->AppProcess(_this->mInputBufPtrs.GetList(), _this->mOutputBufPtrs.GetList(), APP_SIGNAL_VECTOR_SIZE);
+        _this->ProcessInstances();
 
         _this->mSamplesElapsed += APP_SIGNAL_VECTOR_SIZE;
       }
       
       for (int c = 0; c < nouts; c++)
       {
-        pOutputBufferD[c * nFrames + i] *= APP_MULT;
+        pOutputBufferF[c * nFrames + i] *= APP_MULT;
       }
 
       _this->mBufIndex++;
     }
     
     if (doFade)
-      ApplyFades(pOutputBufferD, nouts, nFrames, _this->mAudioEnding);
+      ApplyFades(pOutputBufferF, nouts, nFrames, _this->mAudioEnding);
     
     if (_this->mAudioEnding)
       _this->mAudioDone = true;
   }
   else
   {
-    memset(pOutputBufferD, 0, nFrames * nouts * sizeof(double));
+    memset(pOutputBufferF, 0, nFrames * nouts * sizeof(float));
   }
   
   _this->mVecWait = std::min(_this->mVecWait + 1, uint32_t(APP_N_VECTOR_WAIT + 1));
 
+  const double callbackSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - callbackStart).count();
+  _this->RecordCallback(static_cast<float>(callbackSecs * _this->mSampleRate / nFrames), streamTime, status);
+
   return 0;
 }
 
+void IPlugAPPHost::RecordCallback(float load, double streamTime, RtAudioStreamStatus status)
+{
+  if (status & (RTAUDIO_INPUT_OVERFLOW | RTAUDIO_OUTPUT_UNDERFLOW))
+  {
+    XrunRecord xrun;
+    xrun.streamTime = streamTime;
+    xrun.status = status;
+    xrun.load = load;
+
+    for (int i = 0; i < kNumXrunPrecedingLoads; i++)
+      xrun.precedingLoads[i] = mRecentLoads[(mRecentLoadsIdx + i) % kNumXrunPrecedingLoads];
+
+    mXrunQueue.Push(xrun); // dropped if the dialog hasn't drained the queue, but still counted
+    mNumXruns.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  mRecentLoads[mRecentLoadsIdx] = load;
+  mRecentLoadsIdx = (mRecentLoadsIdx + 1) % kNumXrunPrecedingLoads;
+
+  int bucket = 0;
+
+  while (bucket < kNumLoadBuckets - 1 && load >= kLoadBucketLimits[bucket])
+    bucket++;
+
+  mLoadHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  if (load > mPeakLoad.load(std::memory_order_relaxed))
+    mPeakLoad.store(load, std::memory_order_relaxed);
+}
+
+void IPlugAPPHost::ResetPerformanceStats()
+{
+  for (auto& count : mLoadHistogram)
+    count.store(0, std::memory_order_relaxed);
+
+  mNumXruns.store(0, std::memory_order_relaxed);
+  mPeakLoad.store(0.f, std::memory_order_relaxed);
+
+  for (auto& load : mRecentLoads)
+    load = 0.f;
+
+  mRecentLoadsIdx = 0;
+
+  XrunRecord xrun;
+
+  while (mXrunQueue.Pop(xrun)) {}
+
+  mXrunLog.clear();
+}
+
 // static
 void IPlugAPPHost::MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, void* pUserData)
 {
@@ -764,7 +932,8 @@ void IPlugAPPHost::MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, vo
     
     SysExData data { 0, static_cast<int>(pMsg->size()), pMsg->data() };
     
-    _this->mIPlug->mSysExMsgsFromCallback.Push(data);
+    for (int i = 0; i < _this->NInstances(); i++)
+      _this->GetPlug(i)->mSysExMsgsFromCallback.Push(data);
     return;
   }
   else if (pMsg->size())
@@ -774,7 +943,8 @@ void IPlugAPPHost::MIDICallback(double deltatime, std::vector<uint8_t>* pMsg, vo
     pMsg->size() > 1 ? msg.mData1 = pMsg->at(1) : msg.mData1 = 0;
     pMsg->size() > 2 ? msg.mData2 = pMsg->at(2) : msg.mData2 = 0;
 
-    _this->mIPlug->mMidiMsgsFromCallback.Push(msg);
+    for (int i = 0; i < _this->NInstances(); i++)
+      _this->GetPlug(i)->mMidiMsgsFromCallback.Push(msg);
   }
 }
 
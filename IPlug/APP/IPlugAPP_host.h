@@ -28,6 +28,8 @@
  
  */
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <string>
 #include <vector>
@@ -39,11 +41,22 @@
 
 #include "IPlugPlatform.h"
 #include "IPlugConstants.h"
+#include "IPlugQueue.h"
 
 #include "IPlugAPP.h"
 
 #include "config.h"
 
+#ifndef APP_NUM_INSTANCES
+  /** The number of instances of the plug-in that the app processes in its audio callback. Only the first one has an editor */
+  #define APP_NUM_INSTANCES 1
+#endif
+
+#ifndef APP_PARALLEL_INSTANCES
+  /** If 0 the instances are processed in series, each one processing the output of the previous one. If 1 they all process the audio input and their outputs are summed */
+  #define APP_PARALLEL_INSTANCES 0
+#endif
+
 #ifdef OS_WIN
   #include <WindowsX.h>
   #include <commctrl.h>
@@ -73,6 +86,7 @@ const int kNumBufferSizeOptions = 11;
 const std::string kBufferSizeOptions[kNumBufferSizeOptions] = {"32", "64", "96", "128", "192", "256", "512", "1024", "2048", "4096", "8192" };
 const int kDeviceDS = 0; const int kDeviceCoreAudio = 0; const int kDeviceAlsa = 0;
 const int kDeviceASIO = 1; const int kDeviceJack = 1;
+const int kDeviceWASAPI = 2;
 extern UINT gSCROLLMSG;
 
 class IPlugAPP;
@@ -164,6 +178,8 @@ public:
   void PopulateAudioInputList(HWND hwndDlg, RtAudio::DeviceInfo* pInfo);
   void PopulateAudioOutputList(HWND hwndDlg, RtAudio::DeviceInfo* pInfo);
   void PopulateDriverSpecificControls(HWND hwndDlg);
+  void PopulateLatencyInfo(HWND hwndDlg);
+  void PopulatePerformanceInfo(HWND hwndDlg);
   void PopulateAudioDialogs(HWND hwndDlg);
   bool PopulateMidiDialogs(HWND hwndDlg);
   void PopulatePreferencesDialog(HWND hwndDlg);
@@ -200,6 +216,10 @@ public:
   bool InitMidi();
   void CloseAudio();
   bool InitAudio(uint32_t inId, uint32_t outId, uint32_t sr, uint32_t iovs);
+  /** @return The round trip latency of the running audio stream in samples, i.e. the latency reported by the driver, plus the input and output buffers and the plug-in's own latency. 0 if no stream is running */
+  uint32_t GetRoundTripLatency() const;
+  /** Clears the DSP load histogram and the xrun log, called when a stream is started. The stream must not be running */
+  void ResetPerformanceStats();
   bool AudioSettingsInStateAreEqual(AppState& os, AppState& ns);
   bool MIDISettingsInStateAreEqual(AppState& os, AppState& ns);
 
@@ -214,9 +234,42 @@ public:
   static WDL_DLGRET PreferencesDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam);
   static WDL_DLGRET MainDlgProc(HWND hwndDlg, UINT uMsg, WPARAM wParam, LPARAM lParam);
 
-  IPlugAPP* GetPlug() { return mIPlug.get(); }
+  /** @param idx The index of the instance, 0 is the one with the editor
+   * @return The instance of the plug-in */
+  IPlugAPP* GetPlug(int idx = 0) { return idx == 0 ? mIPlug.get() : mChainedPlugs[idx - 1].get(); }
+  const IPlugAPP* GetPlug(int idx = 0) const { return idx == 0 ? mIPlug.get() : mChainedPlugs[idx - 1].get(); }
+  
+  /** @return The number of instances of the plug-in processed in the audio callback, see APP_NUM_INSTANCES */
+  int NInstances() const { return 1 + static_cast<int>(mChainedPlugs.size()); }
 private:
+  /** The number of buckets of the DSP load histogram */
+  static constexpr int kNumLoadBuckets = 6;
+  /** The upper limits of the buckets of the DSP load histogram except the last, which holds the callbacks that took longer than their buffer */
+  static constexpr float kLoadBucketLimits[kNumLoadBuckets - 1] = { 0.25f, 0.5f, 0.75f, 0.9f, 1.f };
+  /** The number of callbacks before an xrun whose DSP load is recorded with it */
+  static constexpr int kNumXrunPrecedingLoads = 8;
+  /** The number of xruns kept in the log shown by the preferences dialog */
+  static constexpr int kXrunLogSize = 32;
+
+  /** An overflow or underflow reported to the audio callback by RtAudio, with the DSP load of the callbacks leading up to it */
+  struct XrunRecord
+  {
+    double streamTime = 0.;
+    RtAudioStreamStatus status = 0;
+    float load = 0.f; // of the callback that reported it
+    float precedingLoads[kNumXrunPrecedingLoads] = {}; // oldest first
+  };
+
+  /** Process one signal vector through all the instances, using the pointers in mInputBufPtrs and mOutputBufPtrs */
+  void ProcessInstances();
+
+  /** Records the DSP load of a callback, and an xrun if status reports one. Called on the audio thread at the end of AudioCallback()
+   * @param load The time the callback took as a proportion of the duration of its buffer */
+  void RecordCallback(float load, double streamTime, RtAudioStreamStatus status);
+
   std::unique_ptr<IPlugAPP> mIPlug = nullptr;
+  /** The instances after the first one, see APP_NUM_INSTANCES */
+  std::vector<std::unique_ptr<IPlugAPP>> mChainedPlugs;
   std::unique_ptr<RtAudio> mDAC = nullptr;
   std::unique_ptr<RtMidiIn> mMidiIn = nullptr;
   std::unique_ptr<RtMidiOut> mMidiOut = nullptr;
@@ -235,10 +288,23 @@ private:
   uint32_t mVecWait = 0;
   uint32_t mBufferSize = 512;
   uint32_t mBufIndex = 0; // index for signal vector, loops from 0 to mSigVS
+  uint32_t mStreamLatency = 0; // the latency reported by the driver for the running stream, in samples
   bool mExiting = false;
   bool mAudioEnding = false;
   bool mAudioDone = false;
 
+  /** The number of callbacks in each bucket of the DSP load histogram, written by the audio thread */
+  std::atomic<uint32_t> mLoadHistogram[kNumLoadBuckets] = {};
+  std::atomic<uint32_t> mNumXruns {0};
+  std::atomic<float> mPeakLoad {0.f};
+  /** The DSP load of the last kNumXrunPrecedingLoads callbacks, only accessed by the audio thread */
+  float mRecentLoads[kNumXrunPrecedingLoads] = {};
+  int mRecentLoadsIdx = 0;
+  /** Xruns from the audio thread, drained into mXrunLog by the preferences dialog */
+  IPlugQueue<XrunRecord> mXrunQueue {kXrunLogSize};
+  /** The last kXrunLogSize xruns, oldest first, only accessed by the UI thread */
+  std::vector<XrunRecord> mXrunLog;
+
   /** The index of the operating systems default input device, -1 if not detected */
   int32_t mDefaultInputDev = -1;
   /** The index of the operating systems default output device, -1 if not detected */
@@ -252,8 +318,13 @@ private:
   std::vector<std::string> mMidiInputDevNames;
   std::vector<std::string> mMidiOutputDevNames;
   
-  WDL_PtrList<double> mInputBufPtrs;
-  WDL_PtrList<double> mOutputBufPtrs;
+  WDL_PtrList<float> mInputBufPtrs;
+  WDL_PtrList<float> mOutputBufPtrs;
+  
+  /** Scratch output channels for the chained instances, followed by one silent channel */
+  WDL_TypedBuf<float> mChainBuf;
+  WDL_PtrList<float> mChainInputBufPtrs;
+  WDL_PtrList<float> mChainOutputBufPtrs;
 
   friend class IPlugAPP;
 };
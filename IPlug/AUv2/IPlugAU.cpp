@@ -16,6 +16,7 @@
 #include "dfx-au-utilities.h"
 #include "IPlugAU.h"
 #include "IPlugAU_ioconfig.h"
+#include "IPlugRealtimeCheck.h"
 
 using namespace iplug;
 
@@ -117,9 +118,8 @@ inline bool IPlugAU::GetDataFromDict(CFDictionaryRef pDict, const char* key, IBy
   CFDataRef pData = (CFDataRef) CFDictionaryGetValue(pDict, cfKey.Get());
   if (pData)
   {
-    CFIndex n = CFDataGetLength(pData);
-    pChunk->Resize((int) n);
-    memcpy(pChunk->GetData(), CFDataGetBytePtr(pData), n);
+    // the data is read in place, so the dictionary must outlive the chunk
+    *pChunk = IByteChunk::View(CFDataGetBytePtr(pData), (int) CFDataGetLength(pData));
     return true;
   }
   return false;
@@ -539,6 +539,7 @@ OSStatus IPlugAU::GetProperty(AudioUnitPropertyID propID, AudioUnitScope scope,
         
         if (!pParam->GetCanAutomate())  pInfo->flags |= kAudioUnitParameterFlag_NonRealTime;
         if (pParam->GetMeta()) pInfo->flags |= kAudioUnitParameterFlag_IsElementMeta;
+        if (pParam->GetAudioRate()) pInfo->flags |= kAudioUnitParameterFlag_CanRamp;
         if (pParam->NDisplayTexts()) pInfo->flags |= kAudioUnitParameterFlag_ValuesHaveStrings;
 
         const char* paramName = pParam->GetName();
@@ -626,23 +627,12 @@ OSStatus IPlugAU::GetProperty(AudioUnitPropertyID propID, AudioUnitScope scope,
         pInfo->maxValue = pParam->GetMax();
         pInfo->defaultValue = pParam->GetDefault();
         
-        const char* paramGroupName = pParam->GetGroup();
+        const int paramGroupIdx = GetParamGroupIdxForParam(element);
 
-        if (CStringHasContents(paramGroupName))
+        if (paramGroupIdx > -1)
         {
-          int clumpID = 0;
-          
-          for(int i = 0; i< NParamGroups(); i++)
-          {
-            if(strcmp(paramGroupName, GetParamGroupName(i)) == 0)
-              clumpID = i+1;
-          }
-          
-          if (clumpID == 0) // new clump
-            clumpID = AddParamGroup(paramGroupName);
-          
           pInfo->flags = pInfo->flags | kAudioUnitParameterFlag_HasClump;
-          pInfo->clumpID = clumpID;
+          pInfo->clumpID = paramGroupIdx + 1;
         }
         LEAVE_PARAMS_MUTEX
       }
@@ -698,7 +688,7 @@ OSStatus IPlugAU::GetProperty(AudioUnitPropertyID propID, AudioUnitScope scope,
       *pDataSize = sizeof(Float64);
       if (pData)
       {
-        *((Float64*) pData) = (double) GetLatency() / GetSampleRate();
+        *((Float64*) pData) = (double) GetReportedLatency() / GetSampleRate();
       }
       return noErr;
     }
@@ -1611,15 +1601,21 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
     }
   }
 
-  int lastConnectedOutputBus = -1;
+  bool outputIsSilent;
 
-  if(!_this->IsMidiEffect())
+  if (_this->IsMidiEffect())
+  {
+    _this->RenderOutput(nFrames);
+    outputIsSilent = _this->GetOutputIsSilent();
+  }
+  else
   {
     double renderSampleTime = pTimestamp->mSampleTime;
 
     // Pull input buffers.
     if (renderSampleTime != _this->mLastRenderSampleTime)
     {
+      bool inputIsSilent = true;
       BufferList bufList;
       AudioBufferList* pInBufList = (AudioBufferList*) &bufList;
 
@@ -1677,6 +1673,9 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
           {
             return r;   // Something went wrong upstream.
           }
+          
+          if (!(flags & kAudioUnitRenderAction_OutputIsSilent))
+            inputIsSilent = false;
 
           for (int c = 0, chIdx = pInBus->mPlugChannelStartIdx; c < pInBus->mNHostChannels; ++c, ++chIdx)
           {
@@ -1684,6 +1683,7 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
           }
         }
       }
+      _this->SetHostInputIsSilent(inputIsSilent);
       _this->mLastRenderSampleTime = renderSampleTime;
     }
   
@@ -1702,61 +1702,72 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
       pOutBus->mConnected = true;
     }
 
-    for (int c = 0, chIdx = pOutBus->mPlugChannelStartIdx; c < pOutBufList->mNumberBuffers; ++c, ++chIdx)
-    {
-      if (!(pOutBufList->mBuffers[c].mData)) // Downstream unit didn't give us buffers.
-        pOutBufList->mBuffers[c].mData = _this->mOutScratchBuf.Get() + chIdx * nFrames;
+    int nActiveOutputBuses = 0;
 
-      _this->AttachBuffers(ERoute::kOutput, chIdx, 1, (AudioSampleType**) &(pOutBufList->mBuffers[c].mData), nFrames);
+    for (int i = 0; i < _this->mOutBuses.GetSize(); i++)
+    {
+      if (_this->IsOutputBusActive(i))
+        nActiveOutputBuses++;
     }
 
-    for(int i = 0; i < _this->mOutBuses.GetSize(); i++)
+    if (nActiveOutputBuses < 2)
     {
-      if(!_this->mOutBuses.Get(i)->mConnected)
-      {
-        break;
-      }
-      else
+      // a single output bus is rendered straight into the host's buffers
+      for (int i = 0; i < _this->mOutBuses.GetSize(); i++)
       {
-        lastConnectedOutputBus++;
+        if (i != static_cast<int>(outputBusIdx))
+          _this->SetChannelConnections(ERoute::kOutput, _this->mOutBuses.Get(i)->mPlugChannelStartIdx, _this->mOutBuses.Get(i)->mNPlugChannels, false);
       }
-    }
-  }
 
-  if (_this->IsMidiEffect() || outputBusIdx == lastConnectedOutputBus)
-  {
-    int busIdx1based = outputBusIdx+1;
+      for (int c = 0, chIdx = pOutBus->mPlugChannelStartIdx; c < pOutBufList->mNumberBuffers; ++c, ++chIdx)
+      {
+        if (!(pOutBufList->mBuffers[c].mData)) // Downstream unit didn't give us buffers.
+          pOutBufList->mBuffers[c].mData = _this->GetOutputBusCacheChannel(chIdx);
 
-    if (busIdx1based < _this->mOutBuses.GetSize() /*&& (_this->GetHost() != kHostAbletonLive)*/)
-    {
-      int totalNumChans = _this->mOutBuses.GetSize() * 2; // stereo only for the time being
-      int nConnected = busIdx1based * 2;
-      _this->SetChannelConnections(ERoute::kOutput, nConnected, totalNumChans - nConnected, false); // this will disconnect the channels that are on the unconnected buses
-    }
+        _this->AttachBuffers(ERoute::kOutput, chIdx, 1, (AudioSampleType**) &(pOutBufList->mBuffers[c].mData), nFrames);
+      }
 
-    if (_this->GetBypassed())
-    {
-      _this->PassThroughBuffers((AudioSampleType) 0, nFrames);
+      _this->RenderOutput(nFrames);
+      _this->mLastCachedRenderSampleTime = -1.0;
+      outputIsSilent = _this->GetOutputIsSilent();
     }
     else
     {
-      if(_this->mMidiMsgsFromEditor.ElementsAvailable())
+      // hosts such as Logic pull each output bus of a multi-output instrument separately, so all the buses are rendered into the cache
+      // on the first pull for a timestamp, and every pull is served from it
+      if (renderSampleTime != _this->mLastCachedRenderSampleTime)
       {
-        IMidiMsg msg;
-        
-        while (_this->mMidiMsgsFromEditor.Pop(msg))
+        _this->RenderOutputBusCache(nFrames);
+        _this->mLastCachedRenderSampleTime = renderSampleTime;
+      }
+
+      const int nCached = _this->NCachedOutputChannels(outputBusIdx);
+
+      for (int c = 0, chIdx = pOutBus->mPlugChannelStartIdx; c < pOutBufList->mNumberBuffers; ++c, ++chIdx)
+      {
+        if (c >= nCached)
         {
-          _this->ProcessMidiMsg(msg);
+          if (pOutBufList->mBuffers[c].mData)
+            memset(pOutBufList->mBuffers[c].mData, 0, nFrames * sizeof(AudioSampleType));
+
+          continue;
         }
+
+        AudioSampleType* pCached = _this->GetOutputBusCacheChannel(chIdx);
+
+        if (!(pOutBufList->mBuffers[c].mData)) // Downstream unit didn't give us buffers, so point it at the cache
+          pOutBufList->mBuffers[c].mData = pCached;
+        else if (pOutBufList->mBuffers[c].mData != pCached)
+          memcpy(pOutBufList->mBuffers[c].mData, pCached, nFrames * sizeof(AudioSampleType));
       }
-      
-      _this->PreProcess();
-      ENTER_PARAMS_MUTEX_STATIC
-      _this->ProcessBuffers((AudioSampleType) 0, nFrames);
-      LEAVE_PARAMS_MUTEX_STATIC
+
+      outputIsSilent = pOutBus->mIsSilent;
     }
   }
 
+  if (outputIsSilent)
+    *pFlags |= kAudioUnitRenderAction_OutputIsSilent;
+
   if (nRenderNotify)
   {
     for (int i = 0; i < nRenderNotify; ++i)
@@ -1772,6 +1783,79 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
   return noErr;
 }
 
+void IPlugAU::RenderOutput(int nFrames)
+{
+  if (GetBypassed())
+  {
+    PassThroughBuffers((AudioSampleType) 0, nFrames);
+  }
+  else
+  {
+    ApplyDeferredParamReset();
+
+    ProcessMidiMsgsFromEditor(nFrames, GetSampleRate(), [this](const IMidiMsg& msg) {
+      HandleMidiMsg(msg);
+    });
+
+    PreProcess();
+    ENTER_PARAMS_MUTEX
+    ProcessBuffers((AudioSampleType) 0, nFrames);
+    LEAVE_PARAMS_MUTEX
+  }
+
+  OutputMidiFromProcessor(nFrames);
+}
+
+void IPlugAU::RenderOutputBusCache(int nFrames)
+{
+  const int nOutBuses = mOutBuses.GetSize();
+
+  for (int i = 0; i < nOutBuses; i++)
+  {
+    BusChannels* pBus = mOutBuses.Get(i);
+    const int nConnected = NCachedOutputChannels(i);
+
+    if (pBus->mNHostChannels > 0)
+      pBus->mConnected = true;
+
+    SetChannelConnections(ERoute::kOutput, pBus->mPlugChannelStartIdx, nConnected, true);
+    SetChannelConnections(ERoute::kOutput, pBus->mPlugChannelStartIdx + nConnected, pBus->mNPlugChannels - nConnected, false);
+
+    for (int c = 0, chIdx = pBus->mPlugChannelStartIdx; c < nConnected; ++c, ++chIdx)
+    {
+      AudioSampleType* pCached = GetOutputBusCacheChannel(chIdx);
+      AttachBuffers(ERoute::kOutput, chIdx, 1, &pCached, nFrames);
+    }
+  }
+
+  RenderOutput(nFrames);
+
+  const bool outputIsSilent = GetOutputIsSilent();
+
+  for (int i = 0; i < nOutBuses; i++)
+  {
+    BusChannels* pBus = mOutBuses.Get(i);
+    pBus->mIsSilent = true;
+
+    if (outputIsSilent || !IsOutputBusActive(i))
+      continue;
+
+    for (int c = 0, chIdx = pBus->mPlugChannelStartIdx; c < NCachedOutputChannels(i) && pBus->mIsSilent; ++c, ++chIdx)
+    {
+      const AudioSampleType* pCached = GetOutputBusCacheChannel(chIdx);
+
+      for (int s = 0; s < nFrames; s++)
+      {
+        if (pCached[s] != 0.f)
+        {
+          pBus->mIsSilent = false;
+          break;
+        }
+      }
+    }
+  }
+}
+
 IPlugAU::BusChannels* IPlugAU::GetBus(AudioUnitScope scope, AudioUnitElement busIdx)
 {
   if (scope == kAudioUnitScope_Input && busIdx < mInBuses.GetSize())
@@ -1870,6 +1954,10 @@ IPlugAU::IPlugAU(const InstanceInfo& info, const Config& config)
   SetBlockSize(DEFAULT_BLOCK_SIZE);
   ResizeScratchBuffers();
   
+  // the worst case is one packet per message, each of which is 4-byte aligned on arm64
+  const size_t packetSize = (offsetof(MIDIPacket, data) + 3 + 3) & ~size_t(3);
+  mMidiPacketListBuf.Resize(static_cast<int>(sizeof(MIDIPacketList) + mMidiOutputQueue.GetCapacity() * packetSize));
+
   CreateTimer();
 }
 
@@ -2006,8 +2094,8 @@ void IPlugAU::InformListeners(AudioUnitPropertyID propID, AudioUnitScope scope)
 void IPlugAU::SetLatency(int samples)
 {
   TRACE
-  InformListeners(kAudioUnitProperty_Latency, kAudioUnitScope_Global);
   IPlugProcessor::SetLatency(samples);
+  InformListeners(kAudioUnitProperty_Latency, kAudioUnitScope_Global);
 }
 
 bool IPlugAU::SendMidiMsg(const IMidiMsg& msg)
@@ -2015,55 +2103,37 @@ bool IPlugAU::SendMidiMsg(const IMidiMsg& msg)
   if(mMidiCallback.midiOutputCallback == nullptr)
     return false;
   
-  MIDIPacketList packetList;
-  
-  packetList.packet[0].data[0] = msg.mStatus;
-  packetList.packet[0].data[1] = msg.mData1;
-  packetList.packet[0].data[2] = msg.mData2;
-  packetList.packet[0].length = 3;
-  packetList.packet[0].timeStamp = msg.mOffset;
-  packetList.numPackets = 1;
-  
-  if(mMidiCallback.midiOutputCallback)
-  {
-    OSStatus status = mMidiCallback.midiOutputCallback(mMidiCallback.userData, &mLastRenderTimeStamp, 0, &packetList);
-    
-    if (status == noErr)
-      return true;
-  }
-  
-  return false;
+  return mMidiOutputQueue.Add(msg); // sent after processing, see OutputMidiFromProcessor()
 }
 
-bool IPlugAU::SendMidiMsgs(WDL_TypedBuf<IMidiMsg>& msgs)
+void IPlugAU::OutputMidiFromProcessor(int nFrames)
 {
-  bool result = false;
-  
-  if(mMidiCallback.midiOutputCallback == nullptr)
-    return false;
-  
-  WDL_HeapBuf heapBuf;
-  MIDIPacketList* pPktlist = (MIDIPacketList*) heapBuf.ResizeOK(msgs.GetSize() * 3);
-  MIDIPacket* pPkt = MIDIPacketListInit(pPktlist);
-  ByteCount listSize = heapBuf.GetSize();
-    
-  IMidiMsg* pMsg = msgs.Get();
-  for (int i = 0; i < msgs.GetSize(); ++i, ++pMsg)
+  if (!mMidiOutputQueue.Empty() && mMidiCallback.midiOutputCallback)
   {
-    pPkt = MIDIPacketListAdd(pPktlist, listSize, pPkt, pMsg->mOffset /* TODO: is this correct? */, 1, &pMsg->mStatus);
-    pPkt = MIDIPacketListAdd(pPktlist, listSize, pPkt, pMsg->mOffset /* TODO: is this correct? */, 1, &pMsg->mData1);
-    pPkt = MIDIPacketListAdd(pPktlist, listSize, pPkt, pMsg->mOffset /* TODO: is this correct? */, 1, &pMsg->mData2);
-  }
-  
-  if(mMidiCallback.midiOutputCallback)
-  {
-    OSStatus status = mMidiCallback.midiOutputCallback(mMidiCallback.userData, &mLastRenderTimeStamp, 0, pPktlist);
-    
-    if (status == noErr)
-      result = true;
+    MIDIPacketList* pPktList = (MIDIPacketList*) mMidiPacketListBuf.Get();
+    const ByteCount listSize = mMidiPacketListBuf.GetSize();
+    MIDIPacket* pPkt = MIDIPacketListInit(pPktList);
+
+    while (!mMidiOutputQueue.Empty())
+    {
+      const IMidiMsg& msg = mMidiOutputQueue.Peek();
+      const Byte data[3] = { msg.mStatus, msg.mData1, msg.mData2 };
+      // a message kept from the previous block is sent at the start of this one
+      MIDIPacket* pNextPkt = MIDIPacketListAdd(pPktList, listSize, pPkt, std::max(msg.mOffset, 0), 3, data);
+
+      // if the list is full, the remaining messages stay queued for the next block
+      if (!pNextPkt)
+        break;
+
+      pPkt = pNextPkt;
+      mMidiOutputQueue.Remove();
+    }
+
+    if (pPktList->numPackets)
+      mMidiCallback.midiOutputCallback(mMidiCallback.userData, &mLastRenderTimeStamp, 0, pPktList);
   }
-  
-  return result;
+
+  mMidiOutputQueue.Flush(nFrames);
 }
 
 bool IPlugAU::SendSysEx(const ISysEx& sysEx)
@@ -2256,6 +2326,7 @@ OSStatus IPlugAU::DoInitialize(IPlugAU* _this)
     return badComponentSelector;
   }
 
+  _this->InitParamBuffers(_this->GetParams());
   _this->mActive = true;
   _this->OnParamReset(kReset);
   _this->OnActivate(true);
@@ -2428,6 +2499,29 @@ OSStatus IPlugAU::DoScheduleParameters(IPlugAU* _this, const AudioUnitParameterE
       {
         return r;
       }
+
+      if (_this->HasParamBuffer(pEvent->parameter))
+      {
+        const IParam* pParam = _this->GetParam(pEvent->parameter);
+        _this->AddParamRamp(ParamRamp(pEvent->parameter, pParam->GetNormalized(), pEvent->eventValues.immediate.bufferOffset));
+      }
+    }
+    else if (pEvent->eventType == kParameterEvent_Ramped)
+    {
+      // only sent for parameters flagged kAudioUnitParameterFlag_CanRamp, i.e. audio-rate parameters. The value is set to the end of the ramp, and the buffer follows the ramp
+      const auto& ramp = pEvent->eventValues.ramp;
+      OSStatus r = SetParamProc(_this, pEvent->parameter, pEvent->scope, pEvent->element, ramp.endValue, std::max(ramp.startBufferOffset, 0));
+      
+      if (r != noErr)
+      {
+        return r;
+      }
+
+      if (_this->HasParamBuffer(pEvent->parameter))
+      {
+        const IParam* pParam = _this->GetParam(pEvent->parameter);
+        _this->AddParamRamp(ParamRamp(pEvent->parameter, pParam->ToNormalized(ramp.endValue), ramp.startBufferOffset, (int) ramp.durationInFrames, pParam->ToNormalized(ramp.startValue)));
+      }
     }
   }
   return noErr;
@@ -2436,6 +2530,7 @@ OSStatus IPlugAU::DoScheduleParameters(IPlugAU* _this, const AudioUnitParameterE
 //static
 OSStatus IPlugAU::DoRender(IPlugAU* _this, AudioUnitRenderActionFlags* ioActionFlags, const AudioTimeStamp* inTimeStamp, UInt32 inOutputBusNumber, UInt32 inNumberFrames, AudioBufferList* ioData)
 {
+  IPLUG_MARK_REALTIME_THREAD();
   return RenderProc(_this, ioActionFlags, inTimeStamp, inOutputBusNumber, inNumberFrames, ioData);
 }
 
@@ -2456,7 +2551,7 @@ OSStatus IPlugAU::DoMIDIEvent(IPlugAU* _this, UInt32 inStatus, UInt32 inData1, U
     msg.mData1 = inData1;
     msg.mData2 = inData2;
     msg.mOffset = inOffsetSampleFrame;
-    _this->ProcessMidiMsg(msg);
+    _this->HandleMidiMsg(msg);
     _this->mMidiMsgsFromProcessor.Push(msg);
     return noErr;
   }
@@ -72,14 +72,22 @@ public:
 
 //IPlugProcessor
   bool SendMidiMsg(const IMidiMsg& msg) override;
-  bool SendMidiMsgs(WDL_TypedBuf<IMidiMsg>& msgs) override;
   bool SendSysEx(const ISysEx& msg) override;
   void SetLatency(int samples) override;
 
 //IPlugAU
   void OutputSysexFromEditor();
+  /** Send the MIDI messages queued during the block to the host in a single packet list */
+  void OutputMidiFromProcessor(int nFrames);
+  /** Process a block into the attached output buffers, and send any MIDI output */
+  void RenderOutput(int nFrames);
+  /** Render all the active output buses at once into the output scratch buffer, so that the host's pulls for each bus can be served from it */
+  void RenderOutputBusCache(int nFrames);
   void PreProcess();
   void ResizeScratchBuffers();
+  bool IsOutputBusActive(int busIdx) const { return mOutBuses.Get(busIdx)->mConnected || mOutBuses.Get(busIdx)->mNHostChannels > 0; }
+  int NCachedOutputChannels(int busIdx) const { return IsOutputBusActive(busIdx) ? std::min(std::max(mOutBuses.Get(busIdx)->mNHostChannels, 0), mOutBuses.Get(busIdx)->mNPlugChannels) : 0; }
+  AudioSampleType* GetOutputBusCacheChannel(int chIdx) { return mOutScratchBuf.Get() + chIdx * GetBlockSize(); }
   static const char* AUInputTypeStr(int type);
 #ifndef AU_NO_COMPONENT_ENTRY
   static OSStatus IPlugAUEntry(ComponentParameters* pParams, void* pPlug);
@@ -100,6 +108,7 @@ private:
     int mNHostChannels;
     int mNPlugChannels;
     int mPlugChannelStartIdx;
+    bool mIsSilent; // set for the cached output buses, see RenderOutputBusCache()
   };
   
   struct BufferList
@@ -205,6 +214,7 @@ private:
 
   bool mActive = false; // TODO: is this necessary? is it correct?
   double mLastRenderSampleTime = -1.0;
+  double mLastCachedRenderSampleTime = -1.0;
   WDL_String mCocoaViewFactoryClassName;
   AudioComponentInstance mCI = nullptr;
   HostCallbackInfo mHostCallbacks;
@@ -215,6 +225,7 @@ private:
   WDL_TypedBuf<AudioSampleType> mOutScratchBuf;
   WDL_PtrList<AURenderCallbackStruct> mRenderNotify;
   AUMIDIOutputCallbackStruct mMidiCallback;
+  WDL_HeapBuf mMidiPacketListBuf; // preallocated for OutputMidiFromProcessor()
   AudioTimeStamp mLastRenderTimeStamp;
   WDL_String mTrackName;
   template <class Plug, bool DoesMIDIIn>
@@ -76,6 +76,7 @@ struct BufferedOutputBus: BufferedAudioBus {
 
 #pragma mark - BufferedInputBus: BufferedAudioBus
 #pragma mark pullInput()
+#pragma mark pullInputInPlace()
 #pragma mark prepareInputBufferList()
 /*
  BufferedInputBus
@@ -113,6 +114,35 @@ struct BufferedInputBus : BufferedAudioBus {
 
         return pullInputBlock(actionFlags, timestamp, frameCount, inputBusNumber, mutableAudioBufferList);
     }
+
+    /*
+     Gets input data for this input directly into the buffers of an output buffer list, so that an
+     in-place render does not copy through this bus's own buffer. The output buffer list must have
+     valid mData pointers (see BufferedOutputBus::prepareOutputBufferList()) and the same number of
+     buffers as this bus.
+
+     The upstream audio unit may still replace the pointers in mutableAudioBufferList with its own,
+     in which case the input and output are simply in different buffers. The output buffer list is
+     never modified.
+     */
+    AUAudioUnitStatus pullInputInPlace(AudioUnitRenderActionFlags *actionFlags,
+                                       AudioTimeStamp const* timestamp,
+                                       AVAudioFrameCount frameCount,
+                                       NSInteger inputBusNumber,
+                                       AURenderPullInputBlock pullInputBlock,
+                                       AudioBufferList const* outBufferList) {
+        if (pullInputBlock == nullptr) {
+            return kAudioUnitErr_NoConnection;
+        }
+
+        prepareInputBufferList(frameCount);
+
+        for (UInt32 i = 0; i < mutableAudioBufferList->mNumberBuffers; ++i) {
+            mutableAudioBufferList->mBuffers[i].mData = outBufferList->mBuffers[i].mData;
+        }
+
+        return pullInputBlock(actionFlags, timestamp, frameCount, inputBusNumber, mutableAudioBufferList);
+    }
     
     /*
      prepareInputBufferList populates the mutableAudioBufferList with the data
@@ -33,6 +33,7 @@
 - (void) hostResized: (CGSize) newSize;
 - (PLATFORM_VIEW*) openWindow: (PLATFORM_VIEW*) pParent;
 - (void) closeWindow;
+- (void) memoryWarning;
 - (bool) sendMidiData:(int64_t) sampleTime : (NSInteger) length : (const uint8_t*) midiBytes;
 - (NSData*) getDataFromExternal;
 @end
@@ -48,6 +48,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   NSArray<AUAudioUnitPreset*>* mPresets;
   AUAudioUnitPreset* mCurrentPreset;
   NSInteger mCurrentFactoryPresetIndex;
+  bool mCanRenderInPlace;
 }
 
 @synthesize parameterTree = mParameterTree;
@@ -227,6 +228,9 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   
   [treeArray addObject:[[NSMutableArray<AUParameter*> alloc] init]]; // ROOT
 
+  for (auto groupIdx = 0; groupIdx < mPlug->NParamGroups(); groupIdx++)
+    [treeArray addObject:[[NSMutableArray<AUParameter*> alloc] init]];
+
   for (int paramIdx = 0; paramIdx < mPlug->NParams(); paramIdx++)
   {
     IParam* pParam = mPlug->GetParam(paramIdx);
@@ -243,6 +247,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
     
     if (!pParam->GetCanAutomate()) options |= kAudioUnitParameterFlag_NonRealTime;
     if (pParam->GetMeta()) options |= kAudioUnitParameterFlag_IsElementMeta;
+    if (pParam->GetAudioRate()) options |= kAudioUnitParameterFlag_CanRamp;
 
     switch (pParam->Type())
     {
@@ -325,27 +330,10 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
       }
     }
     
-    const char* paramGroupName = pParam->GetGroup();
-    auto clumpID = 0;
+    const auto clumpID = mPlug->GetParamGroupIdxForParam(paramIdx) + 1; // 0 is the root
 
-    if (CStringHasContents(paramGroupName))
-    {
+    if (clumpID > 0)
       options |= kAudioUnitParameterFlag_HasClump;
-      
-      for (auto groupIdx = 0; groupIdx< mPlug->NParamGroups(); groupIdx++)
-      {
-        if (strcmp(paramGroupName, mPlug->GetParamGroupName(groupIdx)) == 0)
-        {
-          clumpID = groupIdx+1;
-        }
-      }
-      
-      if (clumpID == 0) // a brand new clump
-      {
-        clumpID = mPlug->AddParamGroup(paramGroupName);
-        [treeArray addObject:[[NSMutableArray<AUParameter*> alloc] init]]; // ROOT
-      }
-    }
     
     AUParameterAddress address = AUParameterAddress(paramIdx);
 
@@ -522,6 +510,13 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
 
   double sr = mBufferedOutputBuses.Get(0)->bus.format.sampleRate;
   
+  // With a single input and output bus of the same layout, the input can be pulled straight into the output buffers.
+  // If IPlug passes the host's buffers to ProcessBlock() directly (::sample is float), this needs a plug-in that can process in-place, see IPlugProcessor::SetProcessInPlace()
+  mCanRenderInPlace = nInputBuses == 1 && nOutputBuses == 1
+                      && mBufferedInputBuses.Get(0)->bus.format.channelCount == mBufferedOutputBuses.Get(0)->bus.format.channelCount
+                      && !mBufferedOutputBuses.Get(0)->bus.format.interleaved
+                      && (mPlug->GetProcessInPlace() || !std::is_same<sample, float>::value);
+
   mPlug->Prepare(sr, maxBlockSize);
   mPlug->OnReset();
   
@@ -541,6 +536,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   }
   
   mMidiOutputEventBlock = nil;
+  mCanRenderInPlace = false;
   
   [super deallocateRenderResources];
 }
@@ -552,6 +548,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   __block IPlugAUv3* pPlug = mPlug;
   __block WDL_PtrList<BufferedInputBus>* inputBuses = &mBufferedInputBuses;
   __block WDL_PtrList<BufferedOutputBus>* outputBuses = &mBufferedOutputBuses;
+  __block bool* pCanRenderInPlace = &mCanRenderInPlace;
   __block AUHostMusicalContextBlock _musicalContextCapture = self.musicalContextBlock;
   __block AUHostTransportStateBlock _transportStateCapture = self.transportStateBlock;
   
@@ -572,24 +569,39 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
       return err;
     }
     
-    for (auto busIdx = 0; busIdx < inputBuses->GetSize(); busIdx++)
+    if (*pCanRenderInPlace && outputData->mNumberBuffers == inputBuses->Get(0)->originalAudioBufferList->mNumberBuffers)
     {
-      err = inputBuses->Get(busIdx)->pullInput(&pullFlags, timestamp, frameCount, busIdx, pullInputBlock);
+      // fast path: pull the input into the output buffers (the host's, or ours if it passed null pointers) and process in-place,
+      // so the audio is not copied through the input bus buffer, and the output buffers don't need clearing
+      outputBuses->Get(outputBusNumber)->prepareOutputBufferList(outputData, frameCount, false);
+      
+      err = inputBuses->Get(0)->pullInputInPlace(&pullFlags, timestamp, frameCount, 0, pullInputBlock, outputData);
+      
+      if (err != 0) { return err; }
+      
+      pPlug->AttachInputBuffers(inputBuses->Get(0)->mutableAudioBufferList);
     }
-
-    if (err != 0) { return err; }
-    
-    AudioBufferList* pInAudioBufferList = nil;
-    
-    if (inputBuses->GetSize())
+    else
     {
-      pInAudioBufferList = inputBuses->Get(0)->mutableAudioBufferList; // TODO: buses > 0
+      for (auto busIdx = 0; busIdx < inputBuses->GetSize(); busIdx++)
+      {
+        err = inputBuses->Get(busIdx)->pullInput(&pullFlags, timestamp, frameCount, busIdx, pullInputBlock);
+      }
+      
+      if (err != 0) { return err; }
+      
+      AudioBufferList* pInAudioBufferList = nil;
+      
+      if (inputBuses->GetSize())
+      {
+        pInAudioBufferList = inputBuses->Get(0)->mutableAudioBufferList; // TODO: buses > 0
+        
+        pPlug->AttachInputBuffers(pInAudioBufferList);
+      }
       
-      pPlug->AttachInputBuffers(pInAudioBufferList);
+      outputBuses->Get(outputBusNumber)->prepareOutputBufferList(outputData, frameCount, true);
     }
     
-    outputBuses->Get(outputBusNumber)->prepareOutputBufferList(outputData, frameCount, true);
-    
     int lastOutputBusConnected = outputBuses->GetSize() - 1; // Buffers are allways connected it seems (AUM, Cubasis)
     
     pPlug->AttachOutputBuffers(outputData, static_cast<uint32_t>(outputBusNumber));
@@ -714,7 +726,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
 
 - (NSTimeInterval) latency
 {
-  return (NSTimeInterval) mPlug->GetLatency() / mPlug->GetSampleRate();
+  return (NSTimeInterval) mPlug->GetReportedLatency() / mPlug->GetSampleRate();
 }
 
 - (NSTimeInterval) tailTime
@@ -757,8 +769,7 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   [modifiedState addEntriesFromDictionary:newFullState];
 #ifndef STEINBERG_AUWRAPPER_COMPATIBLE
   NSData* pData = [newFullState valueForKey:[NSString stringWithUTF8String: kAUPresetDataKey]];
-  IByteChunk chunk;
-  chunk.PutBytes([pData bytes], static_cast<int>([pData length]));
+  const IByteChunk chunk = IByteChunk::View([pData bytes], static_cast<int>([pData length]));
   int pos = 0;
 //  IByteChunk::GetIPlugVerFromChunk(chunk, pos);
   mPlug->UnserializeState(chunk, pos);
@@ -832,6 +843,11 @@ static AUAudioUnitPreset* NewAUPreset(NSInteger number, NSString* pName)
   mPlug->CloseWindow();
 }
 
+- (void) memoryWarning
+{
+  mPlug->OnMemoryWarning();
+}
+
 - (NSInteger) width
 {
   return mPlug->GetEditorWidth();
@@ -55,11 +55,22 @@
 {
   [super viewDidDisappear:animated];
   
+  // closing the window deletes the UI, so while hidden only the plug-in's own memory stays resident
   if (self.audioUnit)
   {
     [(IPLUG_AUAUDIOUNIT*) self.audioUnit closeWindow];
   }
 }
+
+- (void) didReceiveMemoryWarning
+{
+  [super didReceiveMemoryWarning];
+  
+  if (self.audioUnit)
+  {
+    [(IPLUG_AUAUDIOUNIT*) self.audioUnit memoryWarning];
+  }
+}
 #else
 - (void) viewDidLayout
 {
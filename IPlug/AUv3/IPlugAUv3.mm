@@ -12,6 +12,7 @@
 #include <CoreMIDI/CoreMIDI.h>
 
 #include "IPlugAUv3.h"
+#include "IPlugRealtimeCheck.h"
 #import "IPlugAUAudioUnit.h"
 
 #if !__has_feature(objc_arc)
@@ -118,15 +119,24 @@ bool IPlugAUv3::SendSysEx(const ISysEx& msg)
 //  } while (event && event->head.eventSampleTime <= now);
 //}
 
+void IPlugAUv3::ApplyParamChange(const ParamChange& change)
+{
+  ENTER_PARAMS_MUTEX
+  GetParam(change.idx)->SetNormalized(change.normalizedValue);
+  OnParamChange(change.idx, EParamSource::kHost, change.offset);
+  LEAVE_PARAMS_MUTEX
+}
+
 void IPlugAUv3::ProcessWithEvents(AudioTimeStamp const* pTimestamp, uint32_t frameCount, AURenderEvent const* pEvents, ITimeInfo& timeInfo)
 {
+  IPLUG_MARK_REALTIME_THREAD();
   SetTimeInfo(timeInfo);
   
-  IMidiMsg midiMsg;
-  while (mMidiMsgsFromEditor.Pop(midiMsg))
-  {
-    ProcessMidiMsg(midiMsg);
-  }
+  ApplyDeferredParamReset();
+
+  ProcessMidiMsgsFromEditor(frameCount, GetSampleRate(), [this](const IMidiMsg& midiMsg) {
+    HandleMidiMsg(midiMsg);
+  });
   
   mLastTimeStamp = *pTimestamp;
   AUEventSampleTime now = AUEventSampleTime(pTimestamp->mSampleTime);
@@ -141,7 +151,7 @@ void IPlugAUv3::ProcessWithEvents(AudioTimeStamp const* pTimestamp, uint32_t fra
         const AUMIDIEvent& midiEvent = pEvent->MIDI;
 
         midiMsg = {static_cast<int>(midiEvent.eventSampleTime - now), midiEvent.data[0], midiEvent.data[1], midiEvent.data[2] };
-        ProcessMidiMsg(midiMsg);
+        HandleMidiMsg(midiMsg);
         mMidiMsgsFromProcessor.Push(midiMsg);
       }
       break;
@@ -157,10 +167,26 @@ void IPlugAUv3::ProcessWithEvents(AudioTimeStamp const* pTimestamp, uint32_t fra
           
           const double value = (double) paramEvent.value;
           const int sampleOffset = (int) (paramEvent.eventSampleTime - now);
-          ENTER_PARAMS_MUTEX
-          GetParam(paramIdx)->Set(value);
-          LEAVE_PARAMS_MUTEX
-          OnParamChange(paramIdx, EParamSource::kHost, sampleOffset);
+
+          // with sample accurate automation the change is scheduled, so the block is split at its offset, see ApplyParamChange()
+          if (GetSampleAccurateAutomation())
+          {
+            AddParamChange(ParamChange(paramIdx, GetParam(paramIdx)->ToNormalized(value), sampleOffset));
+          }
+          else
+          {
+            ENTER_PARAMS_MUTEX
+            GetParam(paramIdx)->Set(value);
+            LEAVE_PARAMS_MUTEX
+            OnParamChange(paramIdx, EParamSource::kHost, sampleOffset);
+          }
+
+          // the value is set to the end of a ramp, and the buffer of an audio-rate parameter follows the ramp, see GetParamBuffer()
+          if (HasParamBuffer(paramIdx))
+          {
+            const int duration = pEvent->head.eventType == AURenderEventParameterRamp ? (int) paramEvent.rampDurationSampleFrames : 0;
+            AddParamRamp(ParamRamp(paramIdx, GetParam(paramIdx)->ToNormalized(value), sampleOffset, duration));
+          }
         }
 
         break;
@@ -315,4 +341,5 @@ void IPlugAUv3::Prepare(double sampleRate, uint32_t blockSize)
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), false);
   SetBlockSize(blockSize);
   SetSampleRate(sampleRate);
+  InitParamBuffers(GetParams());
 }
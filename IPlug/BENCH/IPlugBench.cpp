@@ -0,0 +1,99 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <cmath>
+
+#include "IPlugBench.h"
+#include "IPlugRealtimeCheck.h"
+
+using namespace iplug;
+
+IPlugBench::IPlugBench(const InstanceInfo& info, const Config& config)
+: IPlugAPIBase(config, kAPIBENCH)
+, IPlugProcessor(config, kAPIBENCH)
+{
+  Trace(TRACELOC, "%s%s", config.pluginName, config.channelIOStr);
+
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument());
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true);
+
+  SetBlockSize(DEFAULT_BLOCK_SIZE);
+}
+
+void IPlugBench::BenchActivate(double sampleRate, int blockSize)
+{
+  SetSampleRate(sampleRate);
+  SetBlockSize(blockSize);
+  InitParamBuffers(GetParams());
+  OnParamReset(kReset);
+  OnReset();
+  OnActivate(true);
+  mSamplePos = 0;
+}
+
+void IPlugBench::BenchProcess(sample** inputs, sample** outputs, int nFrames, const BenchEvent* pEvents, int nEvents)
+{
+  IPLUG_MARK_REALTIME_THREAD();
+  ITimeInfo timeInfo;
+  timeInfo.mSamplePos = static_cast<double>(mSamplePos);
+  timeInfo.mPPQPos = timeInfo.mSamplePos / GetSampleRate() * timeInfo.mTempo / 60.;
+  timeInfo.mLastBar = std::floor(timeInfo.mPPQPos / timeInfo.mNumerator) * timeInfo.mNumerator;
+  timeInfo.mTransportIsRunning = true;
+  SetTimeInfo(timeInfo);
+
+  for (int i = 0; i < nEvents; i++)
+  {
+    const BenchEvent& event = pEvents[i];
+    const int offset = Clip(static_cast<int>(event.mTime - mSamplePos), 0, nFrames - 1);
+
+    if (event.mParamIdx > kNoParameter)
+    {
+      if (event.mParamIdx >= NParams())
+        continue;
+
+      if (HasParamBuffer(event.mParamIdx))
+        AddParamRamp(ParamRamp(event.mParamIdx, event.mNormalizedValue, offset));
+
+      if (GetSampleAccurateAutomation())
+        AddParamChange(ParamChange(event.mParamIdx, event.mNormalizedValue, offset)); // applied by IPlugProcessor at offset
+      else
+        ApplyParamChange(ParamChange(event.mParamIdx, event.mNormalizedValue, offset));
+    }
+    else
+    {
+      IMidiMsg msg = event.mMsg;
+      msg.mOffset = offset;
+      HandleMidiMsg(msg);
+    }
+  }
+
+  AttachBuffers(ERoute::kInput, 0, NChannelsConnected(ERoute::kInput), inputs, nFrames);
+  AttachBuffers(ERoute::kOutput, 0, NChannelsConnected(ERoute::kOutput), outputs, nFrames);
+
+  ENTER_PARAMS_MUTEX
+  ProcessBuffers(static_cast<sample>(0), nFrames);
+  LEAVE_PARAMS_MUTEX
+
+  mSamplePos += nFrames;
+}
+
+void IPlugBench::BenchDeactivate()
+{
+  FlushScheduledEvents();
+  OnActivate(false);
+}
+
+void IPlugBench::ApplyParamChange(const ParamChange& change)
+{
+  ENTER_PARAMS_MUTEX
+  GetParam(change.idx)->SetNormalized(change.normalizedValue);
+  OnParamChange(change.idx, kHost, change.offset);
+  LEAVE_PARAMS_MUTEX
+}
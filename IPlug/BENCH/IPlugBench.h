@@ -0,0 +1,83 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugBench
+ */
+
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+#include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+struct InstanceInfo
+{
+};
+
+/** A parameter change or MIDI message for IPlugBench, at a sample time from the start of the run */
+struct BenchEvent
+{
+  int64_t mTime = 0;
+  int mParamIdx = kNoParameter; // kNoParameter for a MIDI message
+  double mNormalizedValue = 0.;
+  IMidiMsg mMsg;
+};
+
+/** Headless offline "host" for benchmarking an IPlug plug-in's DSP, without a UI or a device. IPlugBench_main.cpp drives it with test audio and recorded events,
+ * and reports the throughput, the time taken per block and the allocations made while processing. Build the plug-in with BENCH_API, IPLUG_DSP=1 and NO_IGRAPHICS, see common-bench.mk
+ * @ingroup APIClasses */
+class IPlugBench : public IPlugAPIBase
+                 , public IPlugProcessor
+{
+public:
+  IPlugBench(const InstanceInfo& info, const Config& config);
+
+  //IPlugAPIBase
+  void BeginInformHostOfParamChange(int idx) override {}
+  void InformHostOfParamChange(int idx, double normalizedValue) override {}
+  void EndInformHostOfParamChange(int idx) override {}
+  void InformHostOfPresetChange() override {}
+  bool EditorResize(int viewWidth, int viewHeight) override { return false; }
+
+  //IPlugProcessor
+  bool SendMidiMsg(const IMidiMsg& msg) override { return true; }
+  bool SendSysEx(const ISysEx& msg) override { return true; }
+
+  //IPlugBench
+  /** Prepare the plug-in to process, as a host does when it is switched on. This method is not realtime safe
+   * @param sampleRate The sample rate
+   * @param blockSize The size of every block passed to BenchProcess() */
+  void BenchActivate(double sampleRate, int blockSize);
+
+  /** Process one block, delivering the events that fall within it first, with the transport running at the default tempo
+   * @param inputs One buffer per input channel, see MaxNChannels()
+   * @param outputs One buffer per output channel
+   * @param nFrames The number of frames, at most the block size passed to BenchActivate()
+   * @param pEvents The events that fall within the block, sorted by time
+   * @param nEvents The number of events */
+  void BenchProcess(sample** inputs, sample** outputs, int nFrames, const BenchEvent* pEvents, int nEvents);
+
+  void BenchDeactivate();
+
+private:
+  void ApplyParamChange(const ParamChange& change) override;
+
+  int64_t mSamplePos = 0;
+};
+
+IPlugBench* MakePlug(const InstanceInfo& info);
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,549 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief The command line runner of the BENCH target, which benchmarks a plug-in's DSP offline
+ *
+ * For each sample rate and block size, a new instance of the plug-in processes the same audio and events, and the runner reports the throughput (times realtime),
+ * the 50th, 90th and 99th percentile and the worst time per block, the number of heap allocations made while processing and a checksum of the output.
+ * The plug-in runs on the main thread, so "allocations on the audio thread" are the calls to the global operator new during IPlugBench::BenchProcess().
+ * With IPLUG_REALTIME_CHECKS defined, IPlugProcessor.cpp replaces operator new instead, and the allocations are the ones it reports, see IPlugRealtimeCheck.h.
+ *
+ * usage: MyPlugin-bench [options]
+ *   --seconds <s>           the length of audio to process, default 10
+ *   --sample-rates <list>   comma separated sample rates, default 44100
+ *   --block-sizes <list>    comma separated block sizes, default 64,512
+ *   --input <source>        sine, noise, silence or the path of a WAV file, which is looped, default noise
+ *   --events <file>         parameter changes and MIDI messages to play, one per line:
+ *                             <seconds> param <index> <normalized value>
+ *                             <seconds> midi <status> <data1> <data2>
+ *                           lines starting with # are ignored, and numbers may be hexadecimal, e.g. 0x90
+ *   --fail-on-alloc         exit with an error if any run allocates while processing
+ *   --min-realtime <x>      exit with an error if any run is slower than x times realtime
+ *
+ * So a CI job can catch DSP regressions by running the same arguments before and after a change: the checksums should only change when the output is meant to.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugBench.h"
+#include "IPlugRealtimeCheck.h"
+
+#include "config.h"
+
+using namespace iplug;
+
+#pragma mark - Allocation tracking
+
+// counts the calls to the global operator new on a thread while it is processing
+static thread_local bool tTrackAllocations = false;
+
+#if defined IPLUG_REALTIME_CHECKS
+// BenchProcess() marks the thread as realtime, so the replacements in IPlugProcessor.cpp count the allocations
+static int64_t GetAllocationCount()
+{
+  return GetRealtimeViolationSummary().counts[static_cast<int>(ERealtimeViolation::kAllocation)];
+}
+#else
+static std::atomic<int64_t> gAllocationCount{0};
+
+static int64_t GetAllocationCount()
+{
+  return gAllocationCount.load();
+}
+
+void* operator new(std::size_t size)
+{
+  if (tTrackAllocations)
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+#endif
+
+#pragma mark - Input
+
+/** A small deterministic random number generator, so that the noise is the same on every platform */
+class Random
+{
+public:
+  explicit Random(uint32_t seed) : mState(seed) {}
+
+  double Next()
+  {
+    mState = mState * 1664525u + 1013904223u;
+    return static_cast<double>(mState >> 8) / static_cast<double>(1 << 24) * 2. - 1.;
+  }
+
+private:
+  uint32_t mState;
+};
+
+static uint32_t ReadLE(const uint8_t* pData, int nBytes)
+{
+  uint32_t value = 0;
+
+  for (int i = nBytes - 1; i >= 0; i--)
+    value = (value << 8) | pData[i];
+
+  return value;
+}
+
+/** Read a PCM (16, 24 or 32 bit) or IEEE float (32 or 64 bit) WAV file, one buffer per channel
+ * @return \c true on success */
+static bool ReadWAVFile(const char* path, std::vector<std::vector<sample>>& channels)
+{
+  FILE* fp = fopen(path, "rb");
+
+  if (!fp)
+    return false;
+
+  std::vector<uint8_t> file;
+  uint8_t buf[65536];
+  size_t nRead;
+
+  while ((nRead = fread(buf, 1, sizeof(buf), fp)) > 0)
+    file.insert(file.end(), buf, buf + nRead);
+
+  fclose(fp);
+
+  if (file.size() < 12 || memcmp(file.data(), "RIFF", 4) || memcmp(file.data() + 8, "WAVE", 4))
+    return false;
+
+  int format = 0, nChans = 0, bitsPerSample = 0;
+  size_t pos = 12;
+
+  while (pos + 8 <= file.size())
+  {
+    const uint8_t* pChunk = file.data() + pos;
+    const size_t chunkSize = std::min<size_t>(ReadLE(pChunk + 4, 4), file.size() - pos - 8);
+
+    if (!memcmp(pChunk, "fmt ", 4) && chunkSize >= 16)
+    {
+      format = ReadLE(pChunk + 8, 2);
+      nChans = ReadLE(pChunk + 10, 2);
+      bitsPerSample = ReadLE(pChunk + 22, 2);
+
+      if (format == 0xFFFE && chunkSize >= 26) // WAVE_FORMAT_EXTENSIBLE, the format is the start of the sub format GUID
+        format = ReadLE(pChunk + 32, 2);
+    }
+    else if (!memcmp(pChunk, "data", 4) && nChans > 0)
+    {
+      const int bytesPerSample = bitsPerSample / 8;
+
+      if (!((format == 1 && bytesPerSample >= 2 && bytesPerSample <= 4) || (format == 3 && (bytesPerSample == 4 || bytesPerSample == 8))))
+        return false;
+
+      const size_t nFrames = chunkSize / (bytesPerSample * nChans);
+      channels.assign(nChans, std::vector<sample>(nFrames));
+
+      for (size_t s = 0; s < nFrames; s++)
+      {
+        for (int c = 0; c < nChans; c++)
+        {
+          const uint8_t* pSample = pChunk + 8 + (s * nChans + c) * bytesPerSample;
+          double value;
+
+          if (format == 3 && bytesPerSample == 4)
+          {
+            float f;
+            memcpy(&f, pSample, 4);
+            value = f;
+          }
+          else if (format == 3)
+            memcpy(&value, pSample, 8);
+          else
+          {
+            // sign extend from the top of a 32 bit word
+            const int32_t i = static_cast<int32_t>(ReadLE(pSample, bytesPerSample) << (32 - bitsPerSample));
+            value = i / 2147483648.;
+          }
+
+          channels[c][s] = static_cast<sample>(value);
+        }
+      }
+
+      return nFrames > 0;
+    }
+
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+
+  return false;
+}
+
+/** Make the input for a run, nChans channels of nFrames */
+static bool MakeInput(const std::string& source, int nChans, int nFrames, double sampleRate, std::vector<std::vector<sample>>& input)
+{
+  input.assign(nChans, std::vector<sample>(nFrames, 0.));
+
+  if (source == "silence")
+    return true;
+
+  if (source == "sine")
+  {
+    for (int s = 0; s < nFrames; s++)
+    {
+      const sample value = static_cast<sample>(0.5 * std::sin(2. * PI * 440. * s / sampleRate));
+
+      for (int c = 0; c < nChans; c++)
+        input[c][s] = value;
+    }
+
+    return true;
+  }
+
+  if (source == "noise")
+  {
+    Random rand(1);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      for (int s = 0; s < nFrames; s++)
+        input[c][s] = static_cast<sample>(0.5 * rand.Next());
+    }
+
+    return true;
+  }
+
+  std::vector<std::vector<sample>> file;
+
+  if (!ReadWAVFile(source.c_str(), file))
+    return false;
+
+  // the file is looped, and its channels are repeated to fill the inputs
+  for (int c = 0; c < nChans; c++)
+  {
+    const std::vector<sample>& fileChan = file[c % file.size()];
+
+    for (int s = 0; s < nFrames; s++)
+      input[c][s] = fileChan[s % fileChan.size()];
+  }
+
+  return true;
+}
+
+#pragma mark - Events
+
+/** An event from the events file, at a time in seconds so that it can be played at any sample rate */
+struct TimedEvent
+{
+  double mSeconds;
+  BenchEvent mEvent;
+};
+
+static bool ReadEventsFile(const char* path, std::vector<TimedEvent>& events)
+{
+  FILE* fp = fopen(path, "r");
+
+  if (!fp)
+    return false;
+
+  char line[256];
+  int lineNum = 0;
+  bool ok = true;
+
+  while (ok && fgets(line, sizeof(line), fp))
+  {
+    lineNum++;
+    const char first = line[strspn(line, " \t")];
+
+    if (first == '#' || first == '\r' || first == '\n' || first == '\0')
+      continue;
+
+    char type[16];
+    double seconds = 0.;
+    char args[3][32];
+    const int n = sscanf(line, " %lf %15s %31s %31s %31s", &seconds, type, args[0], args[1], args[2]);
+
+    TimedEvent event{seconds, {}};
+
+    if (n == 4 && !strcmp(type, "param"))
+    {
+      event.mEvent.mParamIdx = static_cast<int>(strtol(args[0], nullptr, 0));
+      event.mEvent.mNormalizedValue = Clip(atof(args[1]), 0., 1.);
+    }
+    else if (n == 5 && !strcmp(type, "midi"))
+    {
+      event.mEvent.mMsg = IMidiMsg(0, static_cast<uint8_t>(strtol(args[0], nullptr, 0)), static_cast<uint8_t>(strtol(args[1], nullptr, 0)), static_cast<uint8_t>(strtol(args[2], nullptr, 0)));
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: expected \"<seconds> param <index> <value>\" or \"<seconds> midi <status> <data1> <data2>\"\n", path, lineNum);
+      ok = false;
+    }
+
+    events.push_back(event);
+  }
+
+  fclose(fp);
+
+  std::stable_sort(events.begin(), events.end(), [](const TimedEvent& a, const TimedEvent& b) { return a.mSeconds < b.mSeconds; });
+  return ok;
+}
+
+#pragma mark - Benchmark
+
+struct Result
+{
+  double mRealtime = 0.;
+  double mPercentiles[3] = {}; // 50th, 90th and 99th, in microseconds
+  double mMaxMicroseconds = 0.;
+  int64_t mAllocations = 0;
+  int mBlocksWithAllocations = 0;
+  uint64_t mChecksum = 0;
+};
+
+static Result Run(double sampleRate, int blockSize, const std::vector<std::vector<sample>>& input, int nFrames, const std::vector<TimedEvent>& timedEvents)
+{
+  std::unique_ptr<IPlugBench> pPlug(MakePlug(InstanceInfo()));
+  const int nInputs = pPlug->MaxNChannels(ERoute::kInput);
+  const int nOutputs = pPlug->MaxNChannels(ERoute::kOutput);
+
+  std::vector<BenchEvent> events;
+
+  for (const auto& timedEvent : timedEvents)
+  {
+    events.push_back(timedEvent.mEvent);
+    events.back().mTime = static_cast<int64_t>(std::llround(timedEvent.mSeconds * sampleRate));
+  }
+
+  // the inputs are copied to a block for each call, since a plug-in may process in place
+  std::vector<std::vector<sample>> inputBlock(nInputs, std::vector<sample>(blockSize));
+  std::vector<std::vector<sample>> output(nOutputs, std::vector<sample>(blockSize));
+  std::vector<sample*> inputPtrs(nInputs), outputPtrs(nOutputs);
+
+  for (int c = 0; c < nInputs; c++)
+    inputPtrs[c] = inputBlock[c].data();
+
+  for (int c = 0; c < nOutputs; c++)
+    outputPtrs[c] = output[c].data();
+
+  std::vector<double> blockMicroseconds;
+  blockMicroseconds.reserve(nFrames / blockSize + 1);
+
+  pPlug->BenchActivate(sampleRate, blockSize);
+
+  Result result;
+  double totalMicroseconds = 0.;
+  uint64_t checksum = 1469598103934665603ull;
+  size_t nextEvent = 0;
+
+  for (int blockStart = 0; blockStart < nFrames; blockStart += blockSize)
+  {
+    const int n = std::min(blockSize, nFrames - blockStart);
+
+    for (int c = 0; c < nInputs; c++)
+      std::copy(input[c].begin() + blockStart, input[c].begin() + blockStart + n, inputBlock[c].begin());
+
+    const size_t firstEvent = nextEvent;
+
+    while (nextEvent < events.size() && events[nextEvent].mTime < blockStart + n)
+      nextEvent++;
+
+    const int64_t allocationsBefore = GetAllocationCount();
+    tTrackAllocations = true;
+    const auto start = std::chrono::steady_clock::now();
+    pPlug->BenchProcess(inputPtrs.data(), outputPtrs.data(), n, events.data() + firstEvent, static_cast<int>(nextEvent - firstEvent));
+    const auto end = std::chrono::steady_clock::now();
+    tTrackAllocations = false;
+
+    const int64_t allocations = GetAllocationCount() - allocationsBefore;
+    result.mAllocations += allocations;
+    result.mBlocksWithAllocations += allocations > 0;
+
+    const double microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+    totalMicroseconds += microseconds;
+    blockMicroseconds.push_back(microseconds);
+
+    // FNV-1a over the output quantized to 16 bits, so that only audible changes alter it
+    for (int c = 0; c < nOutputs; c++)
+    {
+      for (int s = 0; s < n; s++)
+        checksum = (checksum ^ static_cast<uint64_t>(static_cast<int64_t>(std::round(output[c][s] * 32767.)))) * 1099511628211ull;
+    }
+  }
+
+  pPlug->BenchDeactivate();
+
+  std::sort(blockMicroseconds.begin(), blockMicroseconds.end());
+  const double percentiles[3] = {0.5, 0.9, 0.99};
+
+  for (int i = 0; i < 3; i++)
+    result.mPercentiles[i] = blockMicroseconds[static_cast<size_t>(percentiles[i] * (blockMicroseconds.size() - 1))];
+
+  result.mMaxMicroseconds = blockMicroseconds.back();
+  result.mRealtime = (nFrames / sampleRate * 1e6) / std::max(totalMicroseconds, 1e-3);
+  result.mChecksum = checksum;
+  return result;
+}
+
+static std::vector<double> ParseList(const char* str)
+{
+  std::vector<double> list;
+
+  for (const char* p = str; *p;)
+  {
+    char* pEnd;
+    const double value = strtod(p, &pEnd);
+
+    if (pEnd == p || value <= 0.)
+      return {};
+
+    list.push_back(value);
+    p = *pEnd == ',' ? pEnd + 1 : pEnd;
+  }
+
+  return list;
+}
+
+static int Usage()
+{
+  fprintf(stderr, "usage: %s-bench [--seconds s] [--sample-rates 44100,48000] [--block-sizes 64,512] [--input sine|noise|silence|file.wav] [--events file.txt] [--fail-on-alloc] [--min-realtime x]\n", BUNDLE_NAME);
+  return 2;
+}
+
+int main(int argc, char* argv[])
+{
+  double seconds = 10.;
+  std::vector<double> sampleRates = {44100.};
+  std::vector<double> blockSizes = {64., 512.};
+  std::string inputSource = "noise";
+  std::vector<TimedEvent> events;
+  bool failOnAlloc = false;
+  double minRealtime = 0.;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (!strcmp(arg, "--fail-on-alloc"))
+    {
+      failOnAlloc = true;
+      continue;
+    }
+
+    if (!value)
+      return Usage();
+
+    i++;
+
+    if (!strcmp(arg, "--seconds"))
+      seconds = atof(value);
+    else if (!strcmp(arg, "--sample-rates"))
+      sampleRates = ParseList(value);
+    else if (!strcmp(arg, "--block-sizes"))
+      blockSizes = ParseList(value);
+    else if (!strcmp(arg, "--input"))
+      inputSource = value;
+    else if (!strcmp(arg, "--events"))
+    {
+      if (!ReadEventsFile(value, events))
+      {
+        fprintf(stderr, "couldn't read the events from %s\n", value);
+        return 1;
+      }
+    }
+    else if (!strcmp(arg, "--min-realtime"))
+      minRealtime = atof(value);
+    else
+      return Usage();
+  }
+
+  if (seconds <= 0. || sampleRates.empty() || blockSizes.empty())
+    return Usage();
+
+  printf("%s %s, %.1f seconds of %s input, %d events\n", PLUG_NAME, PLUG_VERSION_STR, seconds, inputSource.c_str(), static_cast<int>(events.size()));
+  printf("%8s %6s %10s %10s %10s %10s %10s %8s %12s %18s\n", "rate", "block", "x realtime", "p50 us", "p90 us", "p99 us", "max us", "max %", "allocs", "checksum");
+
+  bool failed = false;
+
+  for (auto sampleRate : sampleRates)
+  {
+    const int nFrames = static_cast<int>(seconds * sampleRate);
+    std::vector<std::vector<sample>> input;
+
+    {
+      std::unique_ptr<IPlugBench> pPlug(MakePlug(InstanceInfo()));
+
+      if (!MakeInput(inputSource, pPlug->MaxNChannels(ERoute::kInput), nFrames, sampleRate, input))
+      {
+        fprintf(stderr, "couldn't read %s, expected sine, noise, silence or a PCM or float WAV file\n", inputSource.c_str());
+        return 1;
+      }
+    }
+
+    for (auto blockSizeValue : blockSizes)
+    {
+      const int blockSize = static_cast<int>(blockSizeValue);
+      const Result result = Run(sampleRate, blockSize, input, nFrames, events);
+      const double blockDuration = blockSize / sampleRate * 1e6;
+
+      printf("%8.0f %6d %10.1f %10.2f %10.2f %10.2f %10.2f %8.1f %12lld %18llx\n", sampleRate, blockSize, result.mRealtime,
+             result.mPercentiles[0], result.mPercentiles[1], result.mPercentiles[2], result.mMaxMicroseconds, 100. * result.mMaxMicroseconds / blockDuration,
+             static_cast<long long>(result.mAllocations), static_cast<unsigned long long>(result.mChecksum));
+
+      if (failOnAlloc && result.mAllocations)
+      {
+        fprintf(stderr, "FAIL: %lld allocations in %d blocks at %.0f Hz, %d frames per block\n", static_cast<long long>(result.mAllocations), result.mBlocksWithAllocations, sampleRate, blockSize);
+        failed = true;
+      }
+
+      if (result.mRealtime < minRealtime)
+      {
+        fprintf(stderr, "FAIL: %.1f x realtime at %.0f Hz, %d frames per block, below %.1f\n", result.mRealtime, sampleRate, blockSize, minRealtime);
+        failed = true;
+      }
+    }
+  }
+
+  return failed ? 1 : 0;
+}
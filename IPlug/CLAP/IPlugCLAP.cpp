@@ -0,0 +1,1058 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "IPlugCLAP.h"
+#include "IPlugPluginBase.h"
+#include "IPlugRealtimeCheck.h"
+
+using namespace iplug;
+
+static inline IPlugCLAP* GetPlug(const clap_plugin_t* pPlugin)
+{
+  return static_cast<IPlugCLAP*>(pPlugin->plugin_data);
+}
+
+IPlugCLAP::IPlugCLAP(const InstanceInfo& info, const Config& config)
+  : IPlugAPIBase(config, kAPICLAP)
+  , IPlugProcessor(config, kAPICLAP)
+  , mHost(info.mHost)
+{
+  Trace(TRACELOC, "%s", config.pluginName);
+
+  memset(&mPlugin, 0, sizeof(clap_plugin_t));
+  mPlugin.desc = info.mDesc;
+  mPlugin.plugin_data = this;
+  mPlugin.init = ClapInit;
+  mPlugin.destroy = ClapDestroy;
+  mPlugin.activate = ClapActivate;
+  mPlugin.deactivate = ClapDeactivate;
+  mPlugin.start_processing = ClapStartProcessing;
+  mPlugin.stop_processing = ClapStopProcessing;
+  mPlugin.reset = ClapReset;
+  mPlugin.process = ClapProcess;
+  mPlugin.get_extension = ClapGetExtension;
+  mPlugin.on_main_thread = ClapOnMainThread;
+
+  mSysExOutputData.Resize(SYSEX_TRANSFER_SIZE * MAX_SYSEX_SIZE);
+
+  // Default everything to connected, the host always provides every port's buffers
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), true);
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true);
+
+  SetBlockSize(DEFAULT_BLOCK_SIZE);
+
+  CreateTimer();
+}
+
+#pragma mark - IPlugAPIBase
+
+void IPlugCLAP::BeginInformHostOfParamChange(int idx)
+{
+  mParamsToHost.Push(ParamToHost(ParamToHost::kBegin, idx));
+
+  if (mHostParams)
+    mHostParams->request_flush(mHost);
+}
+
+void IPlugCLAP::InformHostOfParamChange(int idx, double normalizedValue)
+{
+  mParamsToHost.Push(ParamToHost(ParamToHost::kValue, idx, GetParam(idx)->FromNormalized(normalizedValue)));
+
+  if (mHostParams)
+    mHostParams->request_flush(mHost);
+}
+
+void IPlugCLAP::EndInformHostOfParamChange(int idx)
+{
+  mParamsToHost.Push(ParamToHost(ParamToHost::kEnd, idx));
+
+  if (mHostParams)
+    mHostParams->request_flush(mHost);
+}
+
+void IPlugCLAP::InformHostOfPresetChange()
+{
+  if (mHostParams)
+    mHostParams->rescan(mHost, CLAP_PARAM_RESCAN_VALUES);
+
+  if (mHostState)
+    mHostState->mark_dirty(mHost);
+}
+
+bool IPlugCLAP::EditorResize(int viewWidth, int viewHeight)
+{
+  bool resized = false;
+
+  if (HasUI())
+  {
+    if (viewWidth != GetEditorWidth() || viewHeight != GetEditorHeight())
+    {
+      SetEditorSize(viewWidth, viewHeight);
+
+      if (mHostGUI)
+        resized = mHostGUI->request_resize(mHost, viewWidth, viewHeight);
+    }
+  }
+
+  return resized;
+}
+
+#pragma mark - IPlugProcessor
+
+void IPlugCLAP::SetLatency(int samples)
+{
+  IPlugProcessor::SetLatency(samples);
+
+  // CLAP only allows the latency to change while activating, otherwise the plug-in has to be restarted
+  if (mActivating)
+  {
+    if (mHostLatency)
+      mHostLatency->changed(mHost);
+  }
+  else if (mActivated)
+  {
+    mHost->request_restart(mHost);
+  }
+}
+
+bool IPlugCLAP::SendMidiMsg(const IMidiMsg& msg)
+{
+  return mMidiOutputQueue.Add(msg); // sent after processing, see ProcessOutputEvents()
+}
+
+bool IPlugCLAP::SendSysEx(const ISysEx& msg)
+{
+  // SysEx can only be sent from process(), the data is copied because the host only needs it to be valid until process() returns
+  if (!mOutEvents || msg.mSize > MAX_SYSEX_SIZE || mSysExOutputPos + msg.mSize > mSysExOutputData.GetSize())
+    return false;
+
+  uint8_t* pData = mSysExOutputData.Get() + mSysExOutputPos;
+  memcpy(pData, msg.mData, msg.mSize);
+  mSysExOutputPos += msg.mSize;
+
+  clap_event_midi_sysex_t event;
+  event.header.size = sizeof(clap_event_midi_sysex_t);
+  event.header.time = std::max(msg.mOffset, 0);
+  event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+  event.header.type = CLAP_EVENT_MIDI_SYSEX;
+  event.header.flags = 0;
+  event.port_index = 0;
+  event.buffer = pData;
+  event.size = msg.mSize;
+
+  return mOutEvents->try_push(mOutEvents, &event.header);
+}
+
+void IPlugCLAP::ApplyParamChange(const ParamChange& change)
+{
+  ENTER_PARAMS_MUTEX
+  GetParam(change.idx)->SetNormalized(change.normalizedValue);
+  SendParameterValueFromAPI(change.idx, change.normalizedValue, true);
+  OnParamChange(change.idx, kHost, change.offset);
+  LEAVE_PARAMS_MUTEX
+}
+
+#pragma mark - Processing
+
+void IPlugCLAP::PrepareTimeInfo(const clap_process_t* pProcess)
+{
+  ITimeInfo timeInfo;
+  const clap_event_transport_t* pTransport = pProcess->transport;
+
+  if (pTransport)
+  {
+    if (pTransport->flags & CLAP_TRANSPORT_HAS_TEMPO)
+      timeInfo.mTempo = pTransport->tempo;
+
+    if (pTransport->flags & CLAP_TRANSPORT_HAS_SECONDS_TIMELINE)
+      timeInfo.mSamplePos = GetSampleRate() * static_cast<double>(pTransport->song_pos_seconds) / CLAP_SECTIME_FACTOR;
+
+    if (pTransport->flags & CLAP_TRANSPORT_HAS_BEATS_TIMELINE)
+    {
+      timeInfo.mPPQPos = static_cast<double>(pTransport->song_pos_beats) / CLAP_BEATTIME_FACTOR;
+      timeInfo.mLastBar = static_cast<double>(pTransport->bar_start) / CLAP_BEATTIME_FACTOR;
+      timeInfo.mCycleStart = static_cast<double>(pTransport->loop_start_beats) / CLAP_BEATTIME_FACTOR;
+      timeInfo.mCycleEnd = static_cast<double>(pTransport->loop_end_beats) / CLAP_BEATTIME_FACTOR;
+    }
+
+    if (pTransport->flags & CLAP_TRANSPORT_HAS_TIME_SIGNATURE)
+    {
+      timeInfo.mNumerator = pTransport->tsig_num;
+      timeInfo.mDenominator = pTransport->tsig_denom;
+    }
+
+    timeInfo.mTransportIsRunning = pTransport->flags & CLAP_TRANSPORT_IS_PLAYING;
+    timeInfo.mTransportLoopEnabled = pTransport->flags & CLAP_TRANSPORT_IS_LOOP_ACTIVE;
+  }
+
+  SetTimeInfo(timeInfo);
+}
+
+void IPlugCLAP::ProcessInputEvents(const clap_input_events_t* pInEvents, bool fromFlush)
+{
+  if (!pInEvents)
+    return;
+
+  const uint32_t nEvents = pInEvents->size(pInEvents);
+
+  // events are sorted by time, so MIDI and parameter changes arrive interleaved in the order they happen in the block
+  for (uint32_t e = 0; e < nEvents; e++)
+  {
+    const clap_event_header_t* pEvent = pInEvents->get(pInEvents, e);
+
+    if (!pEvent || pEvent->space_id != CLAP_CORE_EVENT_SPACE_ID)
+      continue;
+
+    const int offset = static_cast<int>(pEvent->time);
+
+    switch (pEvent->type)
+    {
+      case CLAP_EVENT_PARAM_VALUE:
+      {
+        const clap_event_param_value_t* pParamEvent = reinterpret_cast<const clap_event_param_value_t*>(pEvent);
+        const int idx = static_cast<int>(pParamEvent->param_id);
+
+        if (idx < 0 || idx >= NParams())
+          break;
+
+        const double value = GetParam(idx)->ToNormalized(pParamEvent->value);
+
+        if (fromFlush)
+        {
+          ApplyParamChange(ParamChange(idx, value, 0));
+          break;
+        }
+
+        if (HasParamBuffer(idx))
+          AddParamRamp(ParamRamp(idx, value, offset)); // CLAP parameter values are steps, which the ramp smooths
+
+        if (GetSampleAccurateAutomation())
+          AddParamChange(ParamChange(idx, value, offset)); // applied by IPlugProcessor at offset
+        else
+          ApplyParamChange(ParamChange(idx, value, offset));
+
+        break;
+      }
+      case CLAP_EVENT_NOTE_ON:
+      case CLAP_EVENT_NOTE_OFF:
+      case CLAP_EVENT_NOTE_CHOKE:
+      {
+        const clap_event_note_t* pNoteEvent = reinterpret_cast<const clap_event_note_t*>(pEvent);
+
+        if (fromFlush || pNoteEvent->key < 0) // key -1 is a wildcard, used to choke all notes, which IMidiMsg can't express
+          break;
+
+        const int channel = std::max<int>(pNoteEvent->channel, 0);
+        IMidiMsg msg;
+
+        if (pEvent->type == CLAP_EVENT_NOTE_ON)
+          msg.MakeNoteOnMsg(pNoteEvent->key, std::max(1, static_cast<int>(std::round(pNoteEvent->velocity * 127.))), offset, channel);
+        else
+          msg.MakeNoteOffMsg(pNoteEvent->key, offset, channel);
+
+        HandleMidiMsg(msg);
+        mMidiMsgsFromProcessor.Push(msg);
+        break;
+      }
+      case CLAP_EVENT_MIDI:
+      {
+        const clap_event_midi_t* pMidiEvent = reinterpret_cast<const clap_event_midi_t*>(pEvent);
+
+        if (fromFlush)
+          break;
+
+        IMidiMsg msg(offset, pMidiEvent->data[0], pMidiEvent->data[1], pMidiEvent->data[2]);
+        HandleMidiMsg(msg);
+        mMidiMsgsFromProcessor.Push(msg);
+        break;
+      }
+      case CLAP_EVENT_MIDI2:
+      {
+        const clap_event_midi2_t* pMidi2Event = reinterpret_cast<const clap_event_midi2_t*>(pEvent);
+
+        if (fromFlush)
+          break;
+
+        IMidiUMP msg(offset);
+        std::copy(pMidi2Event->data, pMidi2Event->data + 4, msg.mWords);
+        HandleUMP(msg);
+        break;
+      }
+      case CLAP_EVENT_NOTE_EXPRESSION:
+      {
+        const clap_event_note_expression_t* pExpressionEvent = reinterpret_cast<const clap_event_note_expression_t*>(pEvent);
+
+        if (fromFlush || pExpressionEvent->key < 0) // IMidiUMP addresses notes by key, so wildcards are ignored
+          break;
+
+        const int key = pExpressionEvent->key;
+        const int channel = std::max<int>(pExpressionEvent->channel, 0);
+        const double value = pExpressionEvent->value;
+        IMidiUMP msg;
+
+        switch (pExpressionEvent->expression_id)
+        {
+          case CLAP_NOTE_EXPRESSION_TUNING: msg.MakePerNotePitchMsg(key, key + value, offset, channel); break; // value in semitones
+          case CLAP_NOTE_EXPRESSION_PRESSURE: msg.MakePolyPressureMsg(key, value, offset, channel); break;
+          case CLAP_NOTE_EXPRESSION_BRIGHTNESS: msg.MakePerNoteControllerMsg(key, IMidiUMP::kPerNoteTimbre, value, offset, channel); break;
+          case CLAP_NOTE_EXPRESSION_PAN: msg.MakePerNoteControllerMsg(key, IMidiUMP::kPerNotePan, value, offset, channel); break;
+          case CLAP_NOTE_EXPRESSION_VOLUME: msg.MakePerNoteControllerMsg(key, IMidiUMP::kPerNoteVolume, value / 4., offset, channel); break; // value [0, 4] is a linear gain
+          case CLAP_NOTE_EXPRESSION_VIBRATO: msg.MakePerNoteControllerMsg(key, IMidiUMP::kPerNoteModulation, value, offset, channel); break;
+          case CLAP_NOTE_EXPRESSION_EXPRESSION: msg.MakePerNoteControllerMsg(key, IMidiUMP::kPerNoteExpression, value, offset, channel); break;
+          default: continue;
+        }
+
+        HandleUMP(msg);
+        break;
+      }
+      case CLAP_EVENT_MIDI_SYSEX:
+      {
+        const clap_event_midi_sysex_t* pSysExEvent = reinterpret_cast<const clap_event_midi_sysex_t*>(pEvent);
+
+        if (fromFlush)
+          break;
+
+        ISysEx sysex(offset, pSysExEvent->buffer, static_cast<int>(pSysExEvent->size));
+        ProcessSysEx(sysex);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+void IPlugCLAP::ProcessAudio(const clap_process_t* pProcess)
+{
+  const int nFrames = static_cast<int>(pProcess->frames_count);
+  bool useDouble = false;
+
+#ifdef SAMPLE_TYPE_DOUBLE
+  // the ports require a common sample size, so the first port tells us which one the host chose
+  if (pProcess->audio_outputs_count)
+    useDouble = pProcess->audio_outputs[0].data64 != nullptr;
+  else if (pProcess->audio_inputs_count)
+    useDouble = pProcess->audio_inputs[0].data64 != nullptr;
+#endif
+
+  bool inputIsSilent = true;
+
+  SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), false);
+
+  for (uint32_t port = 0, chanOffset = 0; port < pProcess->audio_inputs_count; port++)
+  {
+    const int bus = GetBusForAudioPort(ERoute::kInput, port);
+
+    if (bus < 0)
+      break;
+
+    const clap_audio_buffer_t& buffer = pProcess->audio_inputs[port];
+    const int nChans = std::min(static_cast<int>(buffer.channel_count), MaxNChannelsForBus(ERoute::kInput, bus));
+
+    SetChannelConnections(ERoute::kInput, chanOffset, nChans, true);
+
+    if (useDouble)
+      AttachBuffers(ERoute::kInput, chanOffset, nChans, buffer.data64, nFrames);
+    else
+      AttachBuffers(ERoute::kInput, chanOffset, nChans, buffer.data32, nFrames);
+
+    // a constant channel's first sample is its value for the whole block
+    for (auto c = 0; c < nChans && inputIsSilent; c++)
+    {
+      const bool constant = c < 64 && (buffer.constant_mask & (static_cast<uint64_t>(1) << c));
+      const bool zero = useDouble ? buffer.data64[c][0] == 0. : buffer.data32[c][0] == 0.f;
+
+      if (!constant || !zero)
+        inputIsSilent = false;
+    }
+
+    chanOffset += MaxNChannelsForBus(ERoute::kInput, bus);
+  }
+
+  SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), false);
+
+  for (uint32_t port = 0, chanOffset = 0; port < pProcess->audio_outputs_count; port++)
+  {
+    const int bus = GetBusForAudioPort(ERoute::kOutput, port);
+
+    if (bus < 0)
+      break;
+
+    clap_audio_buffer_t& buffer = pProcess->audio_outputs[port];
+    const int nChans = std::min(static_cast<int>(buffer.channel_count), MaxNChannelsForBus(ERoute::kOutput, bus));
+
+    SetChannelConnections(ERoute::kOutput, chanOffset, nChans, true);
+
+    if (useDouble)
+      AttachBuffers(ERoute::kOutput, chanOffset, nChans, buffer.data64, nFrames);
+    else
+      AttachBuffers(ERoute::kOutput, chanOffset, nChans, buffer.data32, nFrames);
+
+    chanOffset += MaxNChannelsForBus(ERoute::kOutput, bus);
+  }
+
+  if (GetSkipProcessingOnSilence())
+    SetHostInputIsSilent(pProcess->audio_inputs_count && inputIsSilent);
+
+  ENTER_PARAMS_MUTEX
+  if (useDouble)
+    ProcessBuffers(0.0, nFrames); // double precision
+  else
+    ProcessBuffers(0.f, nFrames); // single precision
+  LEAVE_PARAMS_MUTEX
+
+  for (uint32_t bus = 0; bus < pProcess->audio_outputs_count; bus++)
+  {
+    clap_audio_buffer_t& buffer = pProcess->audio_outputs[bus];
+    buffer.constant_mask = GetOutputIsSilent() ? ~static_cast<uint64_t>(0) : 0;
+  }
+}
+
+void IPlugCLAP::OutputParamChanges(const clap_output_events_t* pOutEvents)
+{
+  if (!pOutEvents)
+    return;
+
+  ParamToHost change;
+
+  while (mParamsToHost.Pop(change))
+  {
+    if (change.mType == ParamToHost::kValue)
+    {
+      clap_event_param_value_t event;
+      event.header.size = sizeof(clap_event_param_value_t);
+      event.header.time = 0;
+      event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+      event.header.type = CLAP_EVENT_PARAM_VALUE;
+      event.header.flags = 0;
+      event.param_id = change.mIdx;
+      event.cookie = nullptr;
+      event.note_id = -1;
+      event.port_index = -1;
+      event.channel = -1;
+      event.key = -1;
+      event.value = change.mValue;
+      pOutEvents->try_push(pOutEvents, &event.header);
+    }
+    else
+    {
+      clap_event_param_gesture_t event;
+      event.header.size = sizeof(clap_event_param_gesture_t);
+      event.header.time = 0;
+      event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+      event.header.type = change.mType == ParamToHost::kBegin ? CLAP_EVENT_PARAM_GESTURE_BEGIN : CLAP_EVENT_PARAM_GESTURE_END;
+      event.header.flags = 0;
+      event.param_id = change.mIdx;
+      pOutEvents->try_push(pOutEvents, &event.header);
+    }
+  }
+}
+
+void IPlugCLAP::ProcessOutputEvents(const clap_output_events_t* pOutEvents, int nFrames)
+{
+  if (!pOutEvents)
+    return;
+
+  OutputParamChanges(pOutEvents);
+
+  // the output queue is sorted, the host expects the events in time order
+  while (mMidiOutputQueue.ToDo())
+  {
+    const IMidiMsg& msg = mMidiOutputQueue.Peek();
+
+    if (msg.mOffset >= nFrames)
+      break;
+
+    clap_event_midi_t event;
+    event.header.size = sizeof(clap_event_midi_t);
+    event.header.time = std::max(msg.mOffset, 0);
+    event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+    event.header.type = CLAP_EVENT_MIDI;
+    event.header.flags = 0;
+    event.port_index = 0;
+    event.data[0] = msg.mStatus;
+    event.data[1] = msg.mData1;
+    event.data[2] = msg.mData2;
+    pOutEvents->try_push(pOutEvents, &event.header);
+    mMidiOutputQueue.Remove();
+  }
+
+  mMidiOutputQueue.Flush(nFrames);
+
+  //Output SYSEX from the editor, which has bypassed ProcessSysEx()
+  while (mSysExDataFromEditor.Pop(mSysexBuf))
+  {
+    ISysEx smsg {mSysexBuf.mOffset, mSysexBuf.mData, mSysexBuf.mSize};
+    SendSysEx(smsg);
+  }
+}
+
+#pragma mark - State
+
+bool IPlugCLAP::SaveState(const clap_ostream_t* pStream)
+{
+  IByteChunk chunk;
+  IByteChunk::InitChunkWithIPlugVer(chunk);
+
+  if (!SerializeState(chunk))
+    return false;
+
+  const uint8_t* pData = chunk.GetData();
+  int64_t remaining = chunk.Size();
+
+  // the stream may accept less than the whole buffer in each call
+  while (remaining > 0)
+  {
+    const int64_t written = pStream->write(pStream, pData, remaining);
+
+    if (written <= 0)
+      return false;
+
+    pData += written;
+    remaining -= written;
+  }
+
+  return true;
+}
+
+bool IPlugCLAP::LoadState(const clap_istream_t* pStream)
+{
+  IByteChunk chunk;
+  uint8_t buffer[4096];
+  int64_t bytesRead;
+
+  while ((bytesRead = pStream->read(pStream, buffer, sizeof(buffer))) > 0)
+    chunk.PutBytes(buffer, static_cast<int>(bytesRead));
+
+  if (bytesRead < 0)
+    return false;
+
+  int pos = 0;
+  IByteChunk::GetIPlugVerFromChunk(chunk, pos);
+  pos = UnserializeState(chunk, pos);
+
+  if (pos < 0)
+    return false;
+
+  ModifyCurrentPreset();
+  OnRestoreState();
+
+  if (mHostParams)
+    mHostParams->rescan(mHost, CLAP_PARAM_RESCAN_VALUES);
+
+  return true;
+}
+
+#pragma mark - clap_plugin
+
+bool IPlugCLAP::ClapInit(const clap_plugin_t* pPlugin)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+  const clap_host_t* pHost = _this->mHost;
+
+  if (_this->GetHost() == kHostUninit)
+  {
+    int ver = 0, rmaj = 0, rmin = 0;
+
+    if (pHost->version)
+      sscanf(pHost->version, "%d.%d.%d", &ver, &rmaj, &rmin);
+
+    _this->SetHost(pHost->name ? pHost->name : "", (ver << 16) + (rmaj << 8) + rmin);
+  }
+
+  _this->mHostParams = static_cast<const clap_host_params_t*>(pHost->get_extension(pHost, CLAP_EXT_PARAMS));
+  _this->mHostState = static_cast<const clap_host_state_t*>(pHost->get_extension(pHost, CLAP_EXT_STATE));
+  _this->mHostLatency = static_cast<const clap_host_latency_t*>(pHost->get_extension(pHost, CLAP_EXT_LATENCY));
+  _this->mHostGUI = static_cast<const clap_host_gui_t*>(pHost->get_extension(pHost, CLAP_EXT_GUI));
+  _this->mHostThreadPool = static_cast<const clap_host_thread_pool_t*>(pHost->get_extension(pHost, CLAP_EXT_THREAD_POOL));
+
+  _this->OnParamReset(kReset);
+  return true;
+}
+
+void IPlugCLAP::ClapDestroy(const clap_plugin_t* pPlugin)
+{
+  delete GetPlug(pPlugin);
+}
+
+bool IPlugCLAP::ClapActivate(const clap_plugin_t* pPlugin, double sampleRate, uint32_t minFrames, uint32_t maxFrames)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->mActivating = true;
+  _this->SetSampleRate(sampleRate);
+  _this->SetBlockSize(static_cast<int>(maxFrames));
+  _this->InitParamBuffers(_this->GetParams());
+  _this->OnReset();
+  _this->OnActivate(true);
+
+  if (IPlugWorkerPool* pPool = _this->GetWorkerPool())
+    pPool->SetHostExecutor(_this->mHostThreadPool ? HostThreadPoolExec : nullptr, _this);
+
+  _this->mActivating = false;
+  _this->mActivated = true;
+  return true;
+}
+
+void IPlugCLAP::ClapDeactivate(const clap_plugin_t* pPlugin)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->mActivated = false;
+  _this->OnActivate(false);
+}
+
+bool IPlugCLAP::ClapStartProcessing(const clap_plugin_t* pPlugin)
+{
+  return true;
+}
+
+void IPlugCLAP::ClapStopProcessing(const clap_plugin_t* pPlugin)
+{
+  GetPlug(pPlugin)->FlushScheduledEvents();
+}
+
+void IPlugCLAP::ClapReset(const clap_plugin_t* pPlugin)
+{
+  GetPlug(pPlugin)->OnReset();
+}
+
+clap_process_status IPlugCLAP::ClapProcess(const clap_plugin_t* pPlugin, const clap_process_t* pProcess)
+{
+  TRACE
+  IPLUG_MARK_REALTIME_THREAD();
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->PrepareTimeInfo(pProcess);
+
+  _this->ApplyDeferredParamReset();
+
+  _this->ProcessMidiMsgsFromEditor(pProcess->frames_count, _this->GetSampleRate(), [_this](const IMidiMsg& msg) {
+    _this->HandleMidiMsg(msg);
+  });
+
+  _this->ProcessInputEvents(pProcess->in_events, false);
+
+  _this->mOutEvents = pProcess->out_events;
+  _this->mSysExOutputPos = 0;
+
+  _this->ProcessAudio(pProcess);
+
+  // if no audio was processed, scheduled parameter changes and MIDI are delivered at the end of the block
+  _this->FlushScheduledEvents();
+
+  _this->ProcessOutputEvents(pProcess->out_events, static_cast<int>(pProcess->frames_count));
+  _this->mOutEvents = nullptr;
+
+  return CLAP_PROCESS_CONTINUE;
+}
+
+const void* IPlugCLAP::ClapGetExtension(const clap_plugin_t* pPlugin, const char* id)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  static const clap_plugin_params_t params = { ParamsCount, ParamsGetInfo, ParamsGetValue, ParamsValueToText, ParamsTextToValue, ParamsFlush };
+  static const clap_plugin_state_t state = { StateSave, StateLoad };
+  static const clap_plugin_state_context_t stateContext = { StateContextSave, StateContextLoad };
+  static const clap_plugin_audio_ports_t audioPorts = { AudioPortsCount, AudioPortsGet };
+  static const clap_plugin_note_ports_t notePorts = { NotePortsCount, NotePortsGet };
+  static const clap_plugin_latency_t latency = { LatencyGet };
+  static const clap_plugin_tail_t tail = { TailGet };
+  static const clap_plugin_thread_pool_t threadPool = { ThreadPoolExec };
+  static const clap_plugin_gui_t gui = { GUIIsAPISupported, GUIGetPreferredAPI, GUICreate, GUIDestroy, GUISetScale, GUIGetSize, GUICanResize, GUIGetResizeHints, GUIAdjustSize, GUISetSize, GUISetParent, GUISetTransient, GUISuggestTitle, GUIShow, GUIHide };
+
+  if (!strcmp(id, CLAP_EXT_PARAMS)) return &params;
+  if (!strcmp(id, CLAP_EXT_STATE)) return &state;
+  if (!strcmp(id, CLAP_EXT_STATE_CONTEXT)) return &stateContext;
+  if (!strcmp(id, CLAP_EXT_AUDIO_PORTS)) return &audioPorts;
+  if (!strcmp(id, CLAP_EXT_NOTE_PORTS) && (_this->DoesMIDIIn() || _this->DoesMIDIOut())) return &notePorts;
+  if (!strcmp(id, CLAP_EXT_LATENCY)) return &latency;
+  if (!strcmp(id, CLAP_EXT_TAIL)) return &tail;
+  if (!strcmp(id, CLAP_EXT_THREAD_POOL)) return &threadPool;
+  if (!strcmp(id, CLAP_EXT_GUI) && _this->HasUI()) return &gui;
+
+  return nullptr;
+}
+
+void IPlugCLAP::ClapOnMainThread(const clap_plugin_t* pPlugin)
+{
+}
+
+#pragma mark - clap_plugin_params
+
+uint32_t IPlugCLAP::ParamsCount(const clap_plugin_t* pPlugin)
+{
+  return GetPlug(pPlugin)->NParams();
+}
+
+bool IPlugCLAP::ParamsGetInfo(const clap_plugin_t* pPlugin, uint32_t paramIdx, clap_param_info_t* pInfo)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (paramIdx >= static_cast<uint32_t>(_this->NParams()))
+    return false;
+
+  ENTER_PARAMS_MUTEX_STATIC
+  IParam* pParam = _this->GetParam(paramIdx);
+
+  memset(pInfo, 0, sizeof(clap_param_info_t));
+  pInfo->id = paramIdx;
+  pInfo->cookie = nullptr;
+
+  if (pParam->GetCanAutomate())
+    pInfo->flags |= CLAP_PARAM_IS_AUTOMATABLE;
+
+  if (pParam->GetStepped())
+    pInfo->flags |= CLAP_PARAM_IS_STEPPED;
+
+  strncpy(pInfo->name, pParam->GetName(), CLAP_NAME_SIZE - 1);
+  strncpy(pInfo->module, pParam->GetGroup(), CLAP_PATH_SIZE - 1);
+  pInfo->min_value = pParam->GetMin();
+  pInfo->max_value = pParam->GetMax();
+  pInfo->default_value = pParam->GetDefault();
+  LEAVE_PARAMS_MUTEX_STATIC
+
+  return true;
+}
+
+bool IPlugCLAP::ParamsGetValue(const clap_plugin_t* pPlugin, clap_id paramId, double* pValue)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (paramId >= static_cast<clap_id>(_this->NParams()))
+    return false;
+
+  ENTER_PARAMS_MUTEX_STATIC
+  *pValue = _this->GetParam(paramId)->Value();
+  LEAVE_PARAMS_MUTEX_STATIC
+
+  return true;
+}
+
+bool IPlugCLAP::ParamsValueToText(const clap_plugin_t* pPlugin, clap_id paramId, double value, char* display, uint32_t size)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (paramId >= static_cast<clap_id>(_this->NParams()) || !size)
+    return false;
+
+  WDL_String str;
+  const IParam* pParam = _this->GetParam(paramId);
+  pParam->GetDisplay(value, false, str);
+
+  if (CStringHasContents(pParam->GetLabel()))
+  {
+    str.Append(" ");
+    str.Append(pParam->GetLabel());
+  }
+
+  strncpy(display, str.Get(), size - 1);
+  display[size - 1] = '\0';
+  return true;
+}
+
+bool IPlugCLAP::ParamsTextToValue(const clap_plugin_t* pPlugin, clap_id paramId, const char* display, double* pValue)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (paramId >= static_cast<clap_id>(_this->NParams()))
+    return false;
+
+  *pValue = _this->GetParam(paramId)->StringToValue(display);
+  return true;
+}
+
+void IPlugCLAP::ParamsFlush(const clap_plugin_t* pPlugin, const clap_input_events_t* pInEvents, const clap_output_events_t* pOutEvents)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->ProcessInputEvents(pInEvents, true);
+
+  // MIDI and SysEx are timed within a block, so they wait for the next process()
+  _this->OutputParamChanges(pOutEvents);
+}
+
+#pragma mark - clap_plugin_state
+
+bool IPlugCLAP::StateSave(const clap_plugin_t* pPlugin, const clap_ostream_t* pStream)
+{
+  return GetPlug(pPlugin)->SaveState(pStream);
+}
+
+bool IPlugCLAP::StateLoad(const clap_plugin_t* pPlugin, const clap_istream_t* pStream)
+{
+  return GetPlug(pPlugin)->LoadState(pStream);
+}
+
+bool IPlugCLAP::StateContextSave(const clap_plugin_t* pPlugin, const clap_ostream_t* pStream, uint32_t contextType)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->mStateContext = contextType;
+  const bool saved = _this->SaveState(pStream);
+  _this->mStateContext = 0;
+  return saved;
+}
+
+bool IPlugCLAP::StateContextLoad(const clap_plugin_t* pPlugin, const clap_istream_t* pStream, uint32_t contextType)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->mStateContext = contextType;
+  const bool loaded = _this->LoadState(pStream);
+  _this->mStateContext = 0;
+  return loaded;
+}
+
+#pragma mark - clap_plugin_audio_ports
+
+int IPlugCLAP::NAudioPorts(ERoute direction) const
+{
+  int nPorts = 0;
+
+  // buses with no channels in any I/O config (e.g. the input of an instrument) are not ports
+  for (auto bus = 0; bus < MaxNBuses(direction); bus++)
+  {
+    if (MaxNChannelsForBus(direction, bus) > 0)
+      nPorts++;
+  }
+
+  return nPorts;
+}
+
+int IPlugCLAP::GetBusForAudioPort(ERoute direction, int portIdx) const
+{
+  for (auto bus = 0; bus < MaxNBuses(direction); bus++)
+  {
+    if (MaxNChannelsForBus(direction, bus) > 0 && portIdx-- == 0)
+      return bus;
+  }
+
+  return -1;
+}
+
+uint32_t IPlugCLAP::AudioPortsCount(const clap_plugin_t* pPlugin, bool isInput)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+  return _this->NAudioPorts(isInput ? ERoute::kInput : ERoute::kOutput);
+}
+
+bool IPlugCLAP::AudioPortsGet(const clap_plugin_t* pPlugin, uint32_t idx, bool isInput, clap_audio_port_info_t* pInfo)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+  const ERoute direction = isInput ? ERoute::kInput : ERoute::kOutput;
+  const int nBuses = _this->MaxNBuses(direction);
+  const int bus = _this->GetBusForAudioPort(direction, static_cast<int>(idx));
+
+  if (bus < 0)
+    return false;
+
+  const int nChans = _this->MaxNChannelsForBus(direction, bus);
+  WDL_String busName;
+  _this->GetBusName(direction, bus, nBuses, busName);
+
+  memset(pInfo, 0, sizeof(clap_audio_port_info_t));
+  pInfo->id = idx;
+  strncpy(pInfo->name, busName.Get(), CLAP_NAME_SIZE - 1);
+  pInfo->flags = idx == 0 ? CLAP_AUDIO_PORT_IS_MAIN : 0;
+#ifdef SAMPLE_TYPE_DOUBLE
+  pInfo->flags |= CLAP_AUDIO_PORT_SUPPORTS_64BITS | CLAP_AUDIO_PORT_PREFERS_64BITS | CLAP_AUDIO_PORT_REQUIRES_COMMON_SAMPLE_SIZE;
+#endif
+  pInfo->channel_count = nChans;
+  pInfo->port_type = nChans == 1 ? CLAP_PORT_MONO : nChans == 2 ? CLAP_PORT_STEREO : nullptr;
+  pInfo->in_place_pair = CLAP_INVALID_ID;
+  return true;
+}
+
+#pragma mark - clap_plugin_note_ports
+
+uint32_t IPlugCLAP::NotePortsCount(const clap_plugin_t* pPlugin, bool isInput)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+  return (isInput ? _this->DoesMIDIIn() : _this->DoesMIDIOut()) ? 1 : 0;
+}
+
+bool IPlugCLAP::NotePortsGet(const clap_plugin_t* pPlugin, uint32_t idx, bool isInput, clap_note_port_info_t* pInfo)
+{
+  if (idx >= NotePortsCount(pPlugin, isInput))
+    return false;
+
+  memset(pInfo, 0, sizeof(clap_note_port_info_t));
+  pInfo->id = idx;
+
+  // note events are translated to MIDI, but we only send MIDI
+  pInfo->supported_dialects = isInput ? (CLAP_NOTE_DIALECT_CLAP | CLAP_NOTE_DIALECT_MIDI | CLAP_NOTE_DIALECT_MIDI2) : CLAP_NOTE_DIALECT_MIDI;
+  pInfo->preferred_dialect = CLAP_NOTE_DIALECT_MIDI;
+  strncpy(pInfo->name, isInput ? "MIDI Input" : "MIDI Output", CLAP_NAME_SIZE - 1);
+  return true;
+}
+
+#pragma mark - clap_plugin_latency and clap_plugin_tail
+
+uint32_t IPlugCLAP::LatencyGet(const clap_plugin_t* pPlugin)
+{
+  return GetPlug(pPlugin)->GetReportedLatency();
+}
+
+uint32_t IPlugCLAP::TailGet(const clap_plugin_t* pPlugin)
+{
+  return std::max(GetPlug(pPlugin)->GetTailSize(), 0);
+}
+
+#pragma mark - clap_plugin_gui
+
+bool IPlugCLAP::GUIIsAPISupported(const clap_plugin_t* pPlugin, const char* api, bool isFloating)
+{
+  if (isFloating)
+    return false;
+
+#if defined OS_WIN
+  return !strcmp(api, CLAP_WINDOW_API_WIN32);
+#elif defined OS_MAC
+  return !strcmp(api, CLAP_WINDOW_API_COCOA);
+#else
+  return false;
+#endif
+}
+
+bool IPlugCLAP::GUIGetPreferredAPI(const clap_plugin_t* pPlugin, const char** pAPI, bool* pIsFloating)
+{
+  *pIsFloating = false;
+
+#if defined OS_WIN
+  *pAPI = CLAP_WINDOW_API_WIN32;
+  return true;
+#elif defined OS_MAC
+  *pAPI = CLAP_WINDOW_API_COCOA;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool IPlugCLAP::GUICreate(const clap_plugin_t* pPlugin, const char* api, bool isFloating)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (!GUIIsAPISupported(pPlugin, api, isFloating))
+    return false;
+
+  _this->mGUICreated = true;
+  return true;
+}
+
+void IPlugCLAP::GUIDestroy(const clap_plugin_t* pPlugin)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (_this->mGUICreated)
+  {
+    _this->CloseWindow();
+    _this->mGUICreated = false;
+  }
+}
+
+bool IPlugCLAP::GUISetScale(const clap_plugin_t* pPlugin, double scale)
+{
+#ifdef OS_WIN
+  GetPlug(pPlugin)->SetScreenScale(static_cast<float>(scale));
+  return true;
+#else
+  return false; // macOS windows are sized in points, the backing scale is taken from the window
+#endif
+}
+
+bool IPlugCLAP::GUIGetSize(const clap_plugin_t* pPlugin, uint32_t* pWidth, uint32_t* pHeight)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  *pWidth = _this->GetEditorWidth();
+  *pHeight = _this->GetEditorHeight();
+  return true;
+}
+
+bool IPlugCLAP::GUICanResize(const clap_plugin_t* pPlugin)
+{
+  return GetPlug(pPlugin)->GetHostResizeEnabled();
+}
+
+bool IPlugCLAP::GUIGetResizeHints(const clap_plugin_t* pPlugin, clap_gui_resize_hints_t* pHints)
+{
+  return false;
+}
+
+bool IPlugCLAP::GUIAdjustSize(const clap_plugin_t* pPlugin, uint32_t* pWidth, uint32_t* pHeight)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+  int w = static_cast<int>(*pWidth);
+  int h = static_cast<int>(*pHeight);
+
+  _this->ConstrainEditorResize(w, h);
+  *pWidth = w;
+  *pHeight = h;
+  return true;
+}
+
+bool IPlugCLAP::GUISetSize(const clap_plugin_t* pPlugin, uint32_t width, uint32_t height)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  _this->OnParentWindowResize(static_cast<int>(width), static_cast<int>(height));
+  return true;
+}
+
+bool IPlugCLAP::GUISetParent(const clap_plugin_t* pPlugin, const clap_window_t* pWindow)
+{
+  IPlugCLAP* _this = GetPlug(pPlugin);
+
+  if (!_this->mGUICreated || !pWindow)
+    return false;
+
+  _this->OpenWindow(pWindow->ptr);
+  return true;
+}
+
+bool IPlugCLAP::GUISetTransient(const clap_plugin_t* pPlugin, const clap_window_t* pWindow)
+{
+  return false;
+}
+
+void IPlugCLAP::GUISuggestTitle(const clap_plugin_t* pPlugin, const char* title)
+{
+}
+
+bool IPlugCLAP::GUIShow(const clap_plugin_t* pPlugin)
+{
+  return true;
+}
+
+bool IPlugCLAP::GUIHide(const clap_plugin_t* pPlugin)
+{
+  return true;
+}
+
+#pragma mark - clap_plugin_thread_pool
+
+void IPlugCLAP::ThreadPoolExec(const clap_plugin_t* pPlugin, uint32_t taskIdx)
+{
+  if (IPlugWorkerPool* pPool = GetPlug(pPlugin)->GetWorkerPool())
+    pPool->RunHostJob(static_cast<int>(taskIdx));
+}
+
+bool IPlugCLAP::HostThreadPoolExec(void* pHostContext, int nJobs)
+{
+  IPlugCLAP* _this = static_cast<IPlugCLAP*>(pHostContext);
+  return _this->mHostThreadPool->request_exec(_this->mHost, static_cast<uint32_t>(nJobs));
+}
@@ -0,0 +1,179 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#ifndef _IPLUGAPI_
+#define _IPLUGAPI_
+// Only load one API class!
+
+/**
+ * @file
+ * @copydoc IPlugCLAP
+ */
+
+#include "clap/clap.h"
+
+#include "IPlugAPIBase.h"
+#include "IPlugProcessor.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Used to pass various instance info to the API class */
+struct InstanceInfo
+{
+  const clap_plugin_descriptor_t* mDesc;
+  const clap_host_t* mHost;
+};
+
+/**  CLAP API base class for an IPlug plug-in.
+ * Parameters are exposed to the host in their non-normalized range. Note and MIDI events, and parameter values, are delivered at their offsets in the block, sorted as the host provides them.
+ * If the plug-in has created a worker pool (see IPlugProcessor::SetWorkerPoolSize()), jobs passed to IPlugWorkerPool::Run() are executed on the host's thread pool when the host supports the thread-pool extension
+*   @ingroup APIClasses */
+class IPlugCLAP : public IPlugAPIBase
+                , public IPlugProcessor
+{
+public:
+  IPlugCLAP(const InstanceInfo& info, const Config& config);
+
+  //IPlugAPIBase
+  void BeginInformHostOfParamChange(int idx) override;
+  void InformHostOfParamChange(int idx, double normalizedValue) override;
+  void EndInformHostOfParamChange(int idx) override;
+  void InformHostOfPresetChange() override;
+  bool EditorResize(int viewWidth, int viewHeight) override;
+
+  //IPlugProcessor
+  void SetLatency(int samples) override;
+  bool SendMidiMsg(const IMidiMsg& msg) override;
+  bool SendSysEx(const ISysEx& msg) override;
+
+  //IPlugCLAP
+  /** @return The clap_plugin_t that is handed to the host */
+  const clap_plugin_t* GetClapPlugin() const { return &mPlugin; }
+
+  /** @return The CLAP_STATE_CONTEXT_* value for the current save or load, if the host uses the state-context extension, or 0. Only valid in SerializeState() and UnserializeState() */
+  uint32_t GetStateContext() const { return mStateContext; }
+
+private:
+  /** A parameter gesture or value change from the editor, queued to be sent to the host in the next process() or params flush() */
+  struct ParamToHost
+  {
+    enum EType { kBegin, kValue, kEnd };
+
+    EType mType;
+    int mIdx;
+    double mValue;
+
+    ParamToHost(EType type = kValue, int idx = kNoParameter, double value = 0.)
+    : mType(type), mIdx(idx), mValue(value)
+    {}
+  };
+
+  void ApplyParamChange(const ParamChange& change) override;
+
+  /** Convert the host's transport info into an ITimeInfo */
+  void PrepareTimeInfo(const clap_process_t* pProcess);
+  /** Deliver the host's input events, which are sorted by time, to the plug-in */
+  void ProcessInputEvents(const clap_input_events_t* pInEvents, bool fromFlush);
+  /** Attach the host's buffers, process the block and flag silent outputs */
+  void ProcessAudio(const clap_process_t* pProcess);
+  /** @return The number of audio ports, which are the buses that have channels in some I/O config (e.g. not the input of an instrument) */
+  int NAudioPorts(ERoute direction) const;
+  /** @return The bus of an audio port, see NAudioPorts(), or -1 if there is no such port */
+  int GetBusForAudioPort(ERoute direction, int portIdx) const;
+  /** Send the parameter gestures and values queued by the editor to the host */
+  void OutputParamChanges(const clap_output_events_t* pOutEvents);
+  /** Send the queued parameter changes, MIDI and SysEx to the host */
+  void ProcessOutputEvents(const clap_output_events_t* pOutEvents, int nFrames);
+
+  bool SaveState(const clap_ostream_t* pStream);
+  bool LoadState(const clap_istream_t* pStream);
+
+  // clap_plugin
+  static bool ClapInit(const clap_plugin_t* pPlugin);
+  static void ClapDestroy(const clap_plugin_t* pPlugin);
+  static bool ClapActivate(const clap_plugin_t* pPlugin, double sampleRate, uint32_t minFrames, uint32_t maxFrames);
+  static void ClapDeactivate(const clap_plugin_t* pPlugin);
+  static bool ClapStartProcessing(const clap_plugin_t* pPlugin);
+  static void ClapStopProcessing(const clap_plugin_t* pPlugin);
+  static void ClapReset(const clap_plugin_t* pPlugin);
+  static clap_process_status ClapProcess(const clap_plugin_t* pPlugin, const clap_process_t* pProcess);
+  static const void* ClapGetExtension(const clap_plugin_t* pPlugin, const char* id);
+  static void ClapOnMainThread(const clap_plugin_t* pPlugin);
+
+  // clap_plugin_params
+  static uint32_t ParamsCount(const clap_plugin_t* pPlugin);
+  static bool ParamsGetInfo(const clap_plugin_t* pPlugin, uint32_t paramIdx, clap_param_info_t* pInfo);
+  static bool ParamsGetValue(const clap_plugin_t* pPlugin, clap_id paramId, double* pValue);
+  static bool ParamsValueToText(const clap_plugin_t* pPlugin, clap_id paramId, double value, char* display, uint32_t size);
+  static bool ParamsTextToValue(const clap_plugin_t* pPlugin, clap_id paramId, const char* display, double* pValue);
+  static void ParamsFlush(const clap_plugin_t* pPlugin, const clap_input_events_t* pInEvents, const clap_output_events_t* pOutEvents);
+
+  // clap_plugin_state and clap_plugin_state_context
+  static bool StateSave(const clap_plugin_t* pPlugin, const clap_ostream_t* pStream);
+  static bool StateLoad(const clap_plugin_t* pPlugin, const clap_istream_t* pStream);
+  static bool StateContextSave(const clap_plugin_t* pPlugin, const clap_ostream_t* pStream, uint32_t contextType);
+  static bool StateContextLoad(const clap_plugin_t* pPlugin, const clap_istream_t* pStream, uint32_t contextType);
+
+  // clap_plugin_audio_ports and clap_plugin_note_ports
+  static uint32_t AudioPortsCount(const clap_plugin_t* pPlugin, bool isInput);
+  static bool AudioPortsGet(const clap_plugin_t* pPlugin, uint32_t idx, bool isInput, clap_audio_port_info_t* pInfo);
+  static uint32_t NotePortsCount(const clap_plugin_t* pPlugin, bool isInput);
+  static bool NotePortsGet(const clap_plugin_t* pPlugin, uint32_t idx, bool isInput, clap_note_port_info_t* pInfo);
+
+  // clap_plugin_latency and clap_plugin_tail
+  static uint32_t LatencyGet(const clap_plugin_t* pPlugin);
+  static uint32_t TailGet(const clap_plugin_t* pPlugin);
+
+  // clap_plugin_gui
+  static bool GUIIsAPISupported(const clap_plugin_t* pPlugin, const char* api, bool isFloating);
+  static bool GUIGetPreferredAPI(const clap_plugin_t* pPlugin, const char** pAPI, bool* pIsFloating);
+  static bool GUICreate(const clap_plugin_t* pPlugin, const char* api, bool isFloating);
+  static void GUIDestroy(const clap_plugin_t* pPlugin);
+  static bool GUISetScale(const clap_plugin_t* pPlugin, double scale);
+  static bool GUIGetSize(const clap_plugin_t* pPlugin, uint32_t* pWidth, uint32_t* pHeight);
+  static bool GUICanResize(const clap_plugin_t* pPlugin);
+  static bool GUIGetResizeHints(const clap_plugin_t* pPlugin, clap_gui_resize_hints_t* pHints);
+  static bool GUIAdjustSize(const clap_plugin_t* pPlugin, uint32_t* pWidth, uint32_t* pHeight);
+  static bool GUISetSize(const clap_plugin_t* pPlugin, uint32_t width, uint32_t height);
+  static bool GUISetParent(const clap_plugin_t* pPlugin, const clap_window_t* pWindow);
+  static bool GUISetTransient(const clap_plugin_t* pPlugin, const clap_window_t* pWindow);
+  static void GUISuggestTitle(const clap_plugin_t* pPlugin, const char* title);
+  static bool GUIShow(const clap_plugin_t* pPlugin);
+  static bool GUIHide(const clap_plugin_t* pPlugin);
+
+  // clap_plugin_thread_pool
+  static void ThreadPoolExec(const clap_plugin_t* pPlugin, uint32_t taskIdx);
+  /** Called by IPlugWorkerPool::Run() on the audio thread to execute the jobs on the host's thread pool */
+  static bool HostThreadPoolExec(void* pHostContext, int nJobs);
+
+  clap_plugin_t mPlugin;
+  const clap_host_t* mHost;
+  const clap_host_params_t* mHostParams = nullptr;
+  const clap_host_state_t* mHostState = nullptr;
+  const clap_host_latency_t* mHostLatency = nullptr;
+  const clap_host_gui_t* mHostGUI = nullptr;
+  const clap_host_thread_pool_t* mHostThreadPool = nullptr;
+
+  bool mActivated = false;
+  bool mActivating = false;
+  bool mGUICreated = false;
+  uint32_t mStateContext = 0;
+
+  IPlugQueue<ParamToHost> mParamsToHost {PARAM_TRANSFER_SIZE};
+  const clap_output_events_t* mOutEvents = nullptr; // only set during process(), for SendSysEx()
+  WDL_TypedBuf<uint8_t> mSysExOutputData; // storage for the SysEx sent in a block, it must stay valid until process() returns
+  int mSysExOutputPos = 0;
+};
+
+IPlugCLAP* MakePlug(const InstanceInfo& info);
+
+END_IPLUG_NAMESPACE
+
+#endif
@@ -15,6 +15,7 @@
 
 #include <functional>
 #include <cmath>
+#include <limits>
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -320,4 +321,425 @@ private:
   }
 };
 
+/** Advances N envelopes in lockstep, with the same stages and curves as ADSREnvelope, e.g. all the amplitude envelopes of a polyphonic synth.
+ * Each envelope's stage is a linear recurrence, so between stage changes all the envelopes are advanced by the same branch-free loop, which the compiler vectorizes.
+ * The number of samples until each envelope's next stage change is worked out when its stage starts, so the loop runs up to the nearest change without checking
+ * each sample. Rather than calling functions on the audio thread at the end of a release or on retrigger, the bank records them in a list that the caller reads
+ * after ProcessBlock(), see GetEvents()
+ * @tparam T The sample type
+ * @tparam N The number of envelopes */
+template <typename T, int N>
+class ADSREnvelopeBank
+{
+public:
+  using EStage = typename ADSREnvelope<T>::EStage;
+
+  enum class EEventType
+  {
+    kEndRelease, // the envelope has reached idle, at the end of its release or a soft kill
+    kReset // a retriggered envelope has faded to zero and restarts its attack
+  };
+
+  struct Event
+  {
+    int index; // the envelope
+    int offset; // the sample in the block
+    EEventType type;
+  };
+
+  ADSREnvelopeBank(bool sustainEnabled = true)
+  : mSustainEnabled(sustainEnabled)
+  {
+    for (int i = 0; i < N; i++)
+    {
+      mStage[i] = EStage::kIdle;
+      mScalar[i] = 1.;
+      mA[i] = 1.;
+      mG[i] = 1.;
+    }
+
+    SetSampleRate(44100.);
+  }
+
+  /** As ADSREnvelope::SetStageTime(), for all the envelopes */
+  void SetStageTime(int stage, T timeMS)
+  {
+    switch(stage)
+    {
+      case EStage::kAttack:
+        mAttackIncr = CalcIncrFromTimeLinear(Clip(timeMS, ADSREnvelope<T>::MIN_ENV_TIME_MS, ADSREnvelope<T>::MAX_ENV_TIME_MS), mSampleRate);
+        break;
+      case EStage::kDecay:
+        mDecayIncr = CalcIncrFromTimeExp(Clip(timeMS, ADSREnvelope<T>::MIN_ENV_TIME_MS, ADSREnvelope<T>::MAX_ENV_TIME_MS), mSampleRate);
+        break;
+      case EStage::kRelease:
+        mReleaseIncr = CalcIncrFromTimeExp(Clip(timeMS, ADSREnvelope<T>::MIN_ENV_TIME_MS, ADSREnvelope<T>::MAX_ENV_TIME_MS), mSampleRate);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void SetSampleRate(T sr)
+  {
+    mSampleRate = sr;
+    mEarlyReleaseIncr = CalcIncrFromTimeLinear(ADSREnvelope<T>::EARLY_RELEASE_TIME, sr);
+    mRetriggerReleaseIncr = CalcIncrFromTimeLinear(ADSREnvelope<T>::RETRIGGER_RELEASE_TIME, sr);
+  }
+
+  /** As ADSREnvelope::Start(), for envelope i */
+  void Start(int i, T level, T timeScalar = 1.)
+  {
+    mStage[i] = EStage::kAttack;
+    mEnvValue[i] = 0.;
+    mLevel[i] = level;
+    mScalar[i] = 1./timeScalar;
+    mReleased[i] = false;
+  }
+
+  /** As ADSREnvelope::Release(), for envelope i */
+  void Release(int i)
+  {
+    mStage[i] = EStage::kRelease;
+    mReleaseLevel[i] = mPrevResult[i];
+    mEnvValue[i] = 1.;
+    mReleased[i] = true;
+  }
+
+  /** As ADSREnvelope::Retrigger(), for envelope i */
+  void Retrigger(int i, T newStartLevel, T timeScalar = 1.)
+  {
+    mEnvValue[i] = 1.;
+    mNewStartLevel[i] = newStartLevel;
+    mScalar[i] = 1./timeScalar;
+    mReleaseLevel[i] = mPrevResult[i];
+    mStage[i] = EStage::kReleasedToRetrigger;
+    mReleased[i] = false;
+  }
+
+  /** As ADSREnvelope::Kill(), for envelope i */
+  void Kill(int i, bool hard)
+  {
+    if (mStage[i] == EStage::kIdle)
+      return;
+
+    if (hard)
+    {
+      mReleaseLevel[i] = 0.;
+      mStage[i] = EStage::kIdle;
+      mEnvValue[i] = 0.;
+    }
+    else
+    {
+      mReleaseLevel[i] = mPrevResult[i];
+      mStage[i] = EStage::kReleasedToEndEarly;
+      mEnvValue[i] = 1.;
+    }
+  }
+
+  bool GetBusy(int i) const { return mStage[i] != EStage::kIdle; }
+
+  bool GetReleased(int i) const { return mReleased[i]; }
+
+  T GetPrevOutput(int i) const { return mPrevResult[i] * mLevel[i]; }
+
+  /** Process a block of all the envelopes
+   * @param outputs N arrays of nFrames samples
+   * @param sustainLevel The sustain level for the block, smooth it between blocks if needed */
+  void ProcessBlock(T** outputs, int nFrames, T sustainLevel)
+  {
+    mNumEvents = 0;
+
+    for (int i = 0; i < N; i++)
+      SetupStage(i, sustainLevel);
+
+    int s = 0;
+
+    while (s < nFrames)
+    {
+      // the samples before the nearest stage change are the same recurrence for every envelope
+      int segment = nFrames - s;
+
+      for (int i = 0; i < N; i++)
+        segment = std::min(segment, mRemaining[i]);
+
+      if (segment > 0)
+        ProcessSegment(outputs, s, segment);
+
+      for (int i = 0; i < N; i++)
+        mRemaining[i] -= segment;
+
+      s += segment;
+
+      if (s == nFrames)
+        break;
+
+      // at least one envelope may change stage on this sample, those step as ADSREnvelope::Process() does
+      for (int i = 0; i < N; i++)
+      {
+        if (mRemaining[i] == 0)
+        {
+          mPrevResult[i] = mEnvValue[i] * mG[i] + mO[i];
+          outputs[i][s] = Step(i, sustainLevel, s) * mLevel[i];
+          SetupStage(i, sustainLevel);
+        }
+        else
+        {
+          mEnvValue[i] = mEnvValue[i] * mA[i] + mB[i];
+          outputs[i][s] = (mEnvValue[i] * mG[i] + mO[i]) * mLevel[i];
+          mRemaining[i]--;
+        }
+      }
+
+      s++;
+    }
+
+    for (int i = 0; i < N; i++)
+      mPrevResult[i] = mEnvValue[i] * mG[i] + mO[i];
+  }
+
+  /** @return The envelopes that ended or reset during the last ProcessBlock(), in the order they happened for each envelope */
+  const Event* GetEvents() const { return mEvents; }
+
+  /** @return The number of events in GetEvents() */
+  int NEvents() const { return mNumEvents; }
+
+private:
+  static constexpr int kNoChange = std::numeric_limits<int>::max();
+
+  /** Set the recurrence of envelope i's stage, value = value * a + b, result = value * g + o, and how many samples it runs for before the stage may change */
+  void SetupStage(int i, T sustainLevel)
+  {
+    const T v = mEnvValue[i];
+    T a = 1., b = 0., g = 1., o = 0.;
+    int remaining = kNoChange;
+
+    switch (mStage[i])
+    {
+      case EStage::kAttack:
+        b = mAttackIncr * mScalar[i];
+        remaining = b > 0. ? LinearSamples(ADSREnvelope<T>::ENV_VALUE_HIGH - v, b) : 0;
+        break;
+      case EStage::kDecay:
+        a = 1. - mDecayIncr * mScalar[i];
+        g = 1. - sustainLevel;
+        o = sustainLevel;
+        remaining = ExpSamples(v, a);
+        break;
+      case EStage::kSustain:
+        g = 0.;
+        o = sustainLevel;
+        break;
+      case EStage::kRelease:
+        a = mReleaseIncr == 0. ? 0. : 1. - mReleaseIncr * mScalar[i];
+        g = mReleaseLevel[i];
+        remaining = ExpSamples(v, a);
+        break;
+      case EStage::kReleasedToRetrigger:
+        b = -mRetriggerReleaseIncr;
+        g = mReleaseLevel[i];
+        remaining = LinearSamples(v - ADSREnvelope<T>::ENV_VALUE_LOW, mRetriggerReleaseIncr);
+        break;
+      case EStage::kReleasedToEndEarly:
+        b = -mEarlyReleaseIncr;
+        g = mReleaseLevel[i];
+        remaining = LinearSamples(v - ADSREnvelope<T>::ENV_VALUE_LOW, mEarlyReleaseIncr);
+        break;
+      default:
+        break;
+    }
+
+    mA[i] = a;
+    mB[i] = b;
+    mG[i] = g;
+    mO[i] = o;
+    mRemaining[i] = remaining;
+  }
+
+  /** Advance all the envelopes by their recurrences, kTileSize envelopes at a time, held in local arrays so that the compiler keeps them in vector registers */
+  void ProcessSegment(T** outputs, int start, int nFrames)
+  {
+    for (int i0 = 0; i0 < N; i0 += kTileSize)
+    {
+      const int nInTile = std::min(kTileSize, N - i0);
+      T v[kTileSize], a[kTileSize], b[kTileSize], g[kTileSize], o[kTileSize], r[kTileSize];
+
+      for (int j = 0; j < kTileSize; j++)
+      {
+        const int i = std::min(i0 + j, N - 1);
+        v[j] = mEnvValue[i];
+        a[j] = mA[i];
+        b[j] = mB[i];
+        g[j] = mG[i] * mLevel[i];
+        o[j] = mO[i] * mLevel[i];
+      }
+
+      for (int k = start; k < start + nFrames; k++)
+      {
+        for (int j = 0; j < kTileSize; j++)
+        {
+          v[j] = v[j] * a[j] + b[j];
+          r[j] = v[j] * g[j] + o[j];
+        }
+
+        for (int j = 0; j < nInTile; j++)
+          outputs[i0 + j][k] = r[j];
+      }
+
+      for (int j = 0; j < nInTile; j++)
+        mEnvValue[i0 + j] = v[j];
+    }
+  }
+
+  /** @return The samples a linear ramp of incr per sample surely runs for before covering distance, one fewer than exact to allow for rounding */
+  static int LinearSamples(T distance, T incr)
+  {
+    if (incr <= 0.)
+      return 0;
+
+    return static_cast<int>(Clip<T>(std::floor(distance / incr) - 1., 0., static_cast<T>(kNoChange / 2)));
+  }
+
+  /** @return The samples value surely stays above ENV_VALUE_LOW when multiplied by a each sample, one fewer than exact to allow for rounding. A stage with a time of 0 never falls */
+  static int ExpSamples(T value, T a)
+  {
+    if (a >= 1.)
+      return kNoChange;
+
+    if (!(a > 0.) || value <= ADSREnvelope<T>::ENV_VALUE_LOW)
+      return 0;
+
+    return static_cast<int>(Clip<T>(std::floor(std::log(ADSREnvelope<T>::ENV_VALUE_LOW / value) / std::log(a)) - 1., 0., static_cast<T>(kNoChange / 2)));
+  }
+
+  void AddEvent(int i, int offset, EEventType type)
+  {
+    if (mNumEvents < kMaxEvents)
+      mEvents[mNumEvents++] = { i, offset, type };
+  }
+
+  /** One sample of envelope i, exactly as ADSREnvelope::Process(), with the callbacks recorded as events
+   * @return The result before the level */
+  T Step(int i, T sustainLevel, int offset)
+  {
+    T result = 0.;
+    T& envValue = mEnvValue[i];
+
+    switch(mStage[i])
+    {
+      case EStage::kAttack:
+        envValue += (mAttackIncr * mScalar[i]);
+        if (envValue > ADSREnvelope<T>::ENV_VALUE_HIGH || mAttackIncr == 0.)
+        {
+          mStage[i] = EStage::kDecay;
+          envValue = 1.;
+        }
+        result = envValue;
+        break;
+      case EStage::kDecay:
+        envValue -= ((mDecayIncr*envValue) * mScalar[i]);
+        result = (envValue * (1.-sustainLevel)) + sustainLevel;
+        if (envValue < ADSREnvelope<T>::ENV_VALUE_LOW)
+        {
+          if(mSustainEnabled)
+          {
+            mStage[i] = EStage::kSustain;
+            envValue = 1.;
+            result = sustainLevel;
+          }
+          else
+            Release(i);
+        }
+        break;
+      case EStage::kSustain:
+        result = sustainLevel;
+        break;
+      case EStage::kRelease:
+        envValue -= ((mReleaseIncr*envValue) * mScalar[i]);
+        if(envValue < ADSREnvelope<T>::ENV_VALUE_LOW || mReleaseIncr == 0.)
+        {
+          mStage[i] = EStage::kIdle;
+          envValue = 0.;
+          AddEvent(i, offset, EEventType::kEndRelease);
+        }
+        result = envValue * mReleaseLevel[i];
+        break;
+      case EStage::kReleasedToRetrigger:
+        envValue -= mRetriggerReleaseIncr;
+        if(envValue < ADSREnvelope<T>::ENV_VALUE_LOW)
+        {
+          mStage[i] = EStage::kAttack;
+          mLevel[i] = mNewStartLevel[i];
+          envValue = 0.;
+          mReleaseLevel[i] = 0.;
+          AddEvent(i, offset, EEventType::kReset);
+        }
+        result = envValue * mReleaseLevel[i];
+        break;
+      case EStage::kReleasedToEndEarly:
+        envValue -= mEarlyReleaseIncr;
+        if(envValue < ADSREnvelope<T>::ENV_VALUE_LOW)
+        {
+          mStage[i] = EStage::kIdle;
+          mLevel[i] = 0.;
+          envValue = 0.;
+          mReleaseLevel[i] = 0.;
+          AddEvent(i, offset, EEventType::kEndRelease);
+        }
+        result = envValue * mReleaseLevel[i];
+        break;
+      default:
+        result = envValue;
+        break;
+    }
+
+    mPrevResult[i] = result;
+    return result;
+  }
+
+  static T CalcIncrFromTimeLinear(T timeMS, T sr)
+  {
+    if (timeMS <= 0.) return 0.;
+    else return (1./sr) / (timeMS/1000.);
+  }
+
+  static T CalcIncrFromTimeExp(T timeMS, T sr)
+  {
+    if (timeMS <= 0.0) return 0.;
+
+    T r = -std::expm1(1000.0 * std::log(0.001) / (sr * timeMS));
+    if (!(r < 1.0)) r = 1.0;
+
+    return r;
+  }
+
+  static constexpr int kMaxEvents = 2 * N; // an envelope can reset and then end in one block
+  static constexpr int kTileSize = 8;
+
+  T mSampleRate;
+  T mEarlyReleaseIncr = 0.;
+  T mRetriggerReleaseIncr = 0.;
+  T mAttackIncr = 0.;
+  T mDecayIncr = 0.;
+  T mReleaseIncr = 0.;
+  bool mSustainEnabled;
+
+  alignas(32) T mEnvValue[N] = {};
+  alignas(32) T mA[N];
+  alignas(32) T mB[N] = {};
+  alignas(32) T mG[N];
+  alignas(32) T mO[N] = {};
+  alignas(32) T mLevel[N] = {};
+  T mScalar[N];
+  T mReleaseLevel[N] = {};
+  T mNewStartLevel[N] = {};
+  T mPrevResult[N] = {};
+  int mRemaining[N] = {};
+  EStage mStage[N];
+  bool mReleased[N] = {};
+
+  Event mEvents[kMaxEvents];
+  int mNumEvents = 0;
+};
+
 END_IPLUG_NAMESPACE
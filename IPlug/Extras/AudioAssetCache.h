@@ -0,0 +1,360 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief A process-wide cache of decoded audio files, such as impulse responses and samples, shared by all plug-in instances
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sharedpool.h"
+#include "resample.h"
+
+#include "Synth/SampleStreamer.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A decoded audio file, one array of floats per channel. An AudioAsset is immutable once it has been loaded, so that it can be read by any number of instances and threads */
+class AudioAsset
+{
+public:
+  /** @param channels One array per channel, all the same length
+   * @param sampleRate The sample rate of the data */
+  AudioAsset(std::vector<std::vector<float>>&& channels, double sampleRate)
+  : mChannels(std::move(channels))
+  , mSampleRate(sampleRate)
+  {
+    for (auto& channel : mChannels)
+      mChannelPtrs.push_back(channel.data());
+  }
+
+  /** Decode a WAV file, see StreamedSample::FromWav(), and resample it with WDL_Resampler's windowed sinc if it isn't at the requested rate. resample.cpp must be compiled
+   * @param path The path of the file
+   * @param sampleRate The sample rate to resample to, or 0 to keep the file's rate
+   * @return The asset, or nullptr if the file can't be read */
+  static std::unique_ptr<AudioAsset> FromWav(const char* path, double sampleRate)
+  {
+    std::unique_ptr<StreamedSample> pSample = StreamedSample::FromWav(path, INT_MAX);
+
+    if (!pSample || pSample->NPreloadFrames() != pSample->NFrames())
+      return nullptr;
+
+    const int nChans = pSample->NChans();
+    const int nFrames = pSample->NPreloadFrames();
+    const double fileRate = pSample->GetSampleRate();
+    const float* pInterleaved = pSample->GetPreload();
+    std::vector<std::vector<float>> channels(nChans, std::vector<float>(nFrames));
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      for (auto s = 0; s < nFrames; s++)
+        channels[c][s] = pInterleaved[s * nChans + c];
+    }
+
+    pSample = nullptr; // the interleaved copy is freed before resampling
+
+    if (sampleRate > 0. && sampleRate != fileRate)
+    {
+      for (auto& channel : channels)
+        channel = Resample(channel, fileRate, sampleRate);
+    }
+
+    return std::make_unique<AudioAsset>(std::move(channels), sampleRate > 0. ? sampleRate : fileRate);
+  }
+
+  int NChans() const { return static_cast<int>(mChannels.size()); }
+  int NFrames() const { return mChannels.empty() ? 0 : static_cast<int>(mChannels[0].size()); }
+  double GetSampleRate() const { return mSampleRate; }
+
+  const float* GetChannel(int chan) const { return mChannelPtrs[chan]; }
+
+  /** @return One pointer per channel, e.g. for ConvolutionImpulseLoader::LoadImpulse() or ConvolutionEngine::SetImpulse() */
+  const float* const* GetChannels() const { return mChannelPtrs.data(); }
+
+  /** @return The memory used by the data, in bytes */
+  size_t GetSizeInBytes() const { return static_cast<size_t>(NChans()) * NFrames() * sizeof(float); }
+
+private:
+  /** Resample one channel, at the same level, with the input followed by silence until the filter's tail has been output */
+  static std::vector<float> Resample(const std::vector<float>& src, double srcRate, double dstRate)
+  {
+    static constexpr int kBlockSize = 256;
+
+    WDL_Resampler resampler;
+    resampler.SetMode(false, 0, true); // sinc, default size
+    resampler.SetFeedMode(false); // output driven, so each block fills buf
+    resampler.SetRates(srcRate, dstRate);
+
+    int dstLength = static_cast<int>(dstRate / srcRate * src.size() + 0.5);
+    std::vector<float> dst;
+    dst.reserve(dstLength);
+
+    size_t srcPos = 0;
+    WDL_ResampleSample buf[kBlockSize];
+
+    while (dstLength > 0)
+    {
+      WDL_ResampleSample* pIn;
+      const int nIn = resampler.ResamplePrepare(kBlockSize, 1, &pIn);
+      const int n = static_cast<int>(std::min<size_t>(nIn, src.size() - srcPos));
+
+      for (int i = 0; i < n; i++)
+        pIn[i] = src[srcPos++];
+
+      std::fill(pIn + n, pIn + nIn, 0.);
+
+      const int nOut = std::min(resampler.ResampleOut(buf, nIn, kBlockSize, 1), dstLength);
+      dst.insert(dst.end(), buf, buf + nOut);
+      dstLength -= nOut;
+    }
+
+    return dst;
+  }
+
+  std::vector<std::vector<float>> mChannels;
+  std::vector<const float*> mChannelPtrs;
+  double mSampleRate;
+};
+
+/** A process-wide cache of AudioAssets, keyed by path and sample rate, so that every instance of a plug-in that uses the same impulse response or sample shares one copy of it.
+ * The assets are kept in a WDL_SharedPool and reference counted by AudioAssetCache::Handle, the first request for an asset loads it on the cache's background thread,
+ * and it is deleted when the last handle to it is released. Loading an asset publishes it atomically, so the audio thread can poll a handle without locking.
+ * The cache is a function-local static, so it is shared by the instances in one plug-in binary
+ * @ingroup IPlugExtras */
+class AudioAssetCache
+{
+  struct Entry;
+
+public:
+  /** Decodes an asset on the loader thread, e.g. AudioAsset::FromWav()
+   * @return The asset, or nullptr if it can't be loaded */
+  using LoadFunc = std::function<std::unique_ptr<AudioAsset>(const char* path, double sampleRate)>;
+
+  /** A reference to a cached asset, which keeps it alive. Handles are created and released on the main thread, Get() and IsLoaded() can be called from any thread */
+  class Handle
+  {
+  public:
+    Handle() = default;
+
+    ~Handle() { Reset(); }
+
+    Handle(Handle&& other) noexcept
+    : mEntry(other.mEntry)
+    {
+      other.mEntry = nullptr;
+    }
+
+    Handle& operator=(Handle&& other) noexcept
+    {
+      if (this != &other)
+      {
+        Reset();
+        mEntry = other.mEntry;
+        other.mEntry = nullptr;
+      }
+
+      return *this;
+    }
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+    /** @return The asset, or nullptr while it is loading or if it couldn't be loaded. This is lock-free */
+    const AudioAsset* Get() const { return mEntry ? mEntry->asset.load(std::memory_order_acquire) : nullptr; }
+
+    /** @return \c true once loading has finished, whether or not it succeeded */
+    bool IsLoaded() const { return mEntry && mEntry->loaded.load(std::memory_order_acquire); }
+
+    /** Block until the asset has loaded, e.g. before rendering offline. Don't call this on the audio thread
+     * @return The asset, or nullptr if it couldn't be loaded */
+    const AudioAsset* WaitUntilLoaded() const
+    {
+      if (mEntry)
+        AudioAssetCache::Get().WaitUntilLoaded(*mEntry);
+
+      return Get();
+    }
+
+    /** Release the asset, which is deleted if no other handle refers to it. Make sure the audio thread no longer reads it */
+    void Reset()
+    {
+      if (mEntry)
+        AudioAssetCache::Get().Release(mEntry);
+
+      mEntry = nullptr;
+    }
+
+    explicit operator bool() const { return mEntry != nullptr; }
+
+  private:
+    friend class AudioAssetCache;
+
+    explicit Handle(Entry* pEntry)
+    : mEntry(pEntry)
+    {}
+
+    Entry* mEntry = nullptr;
+  };
+
+  /** @return The process-wide cache */
+  static AudioAssetCache& Get()
+  {
+    static AudioAssetCache sCache;
+    return sCache;
+  }
+
+  ~AudioAssetCache()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mRunning = false;
+    }
+
+    mCondition.notify_all();
+
+    if (mThread.joinable())
+      mThread.join();
+  }
+
+  AudioAssetCache(const AudioAssetCache&) = delete;
+  AudioAssetCache& operator=(const AudioAssetCache&) = delete;
+
+  /** Get a handle to a cached asset, loading it on the background thread if no instance has it yet. Call this on the main thread
+   * @param path The path of the file
+   * @param sampleRate The sample rate the asset is resampled to, or 0 to keep the file's rate
+   * @param loadFunc Decodes the asset, which must give the same result for the same path and sample rate
+   * @return The handle, of which Get() is nullptr until the asset has loaded */
+  Handle Load(const char* path, double sampleRate = 0., LoadFunc loadFunc = AudioAsset::FromWav)
+  {
+    const std::string key = MakeKey(path, sampleRate);
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (Entry* pEntry = mPool.Get(key.c_str())) // adds a reference
+      return Handle(pEntry);
+
+    Entry* pEntry = new Entry;
+    pEntry->path = path;
+    pEntry->sampleRate = sampleRate;
+    pEntry->loadFunc = std::move(loadFunc);
+    mPool.Add(pEntry, key.c_str()); // the handle's reference
+    mPool.AddRef(pEntry); // the loader thread's reference, released once it has loaded
+    mQueue.push_back(pEntry);
+    StartThread();
+    mCondition.notify_all();
+    return Handle(pEntry);
+  }
+
+  /** @return The memory used by all the loaded assets, in bytes */
+  size_t GetSizeInBytes()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t size = 0;
+
+    for (auto i = 0; Entry* pEntry = mPool.EnumItems(i); i++)
+    {
+      if (const AudioAsset* pAsset = pEntry->asset.load(std::memory_order_acquire))
+        size += pAsset->GetSizeInBytes();
+    }
+
+    return size;
+  }
+
+private:
+  struct Entry
+  {
+    ~Entry() { delete asset.load(); }
+
+    std::string path;
+    double sampleRate = 0.;
+    LoadFunc loadFunc;
+    std::atomic<const AudioAsset*> asset {nullptr};
+    std::atomic<bool> loaded {false};
+  };
+
+  AudioAssetCache() = default;
+
+  static std::string MakeKey(const char* path, double sampleRate)
+  {
+    char rate[32];
+    snprintf(rate, sizeof(rate), "|%.3f", sampleRate);
+    return std::string(path) + rate;
+  }
+
+  void Release(Entry* pEntry)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPool.Release(pEntry); // deletes the entry, and its asset, with the last reference
+  }
+
+  void WaitUntilLoaded(Entry& entry)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this, &entry]() { return entry.loaded.load() || !mRunning; });
+  }
+
+  /** Start the loader thread, which exits when the queue is empty, so that no thread is left running when the plug-in binary is unloaded. Call with mMutex locked */
+  void StartThread()
+  {
+    if (mThreadRunning)
+      return;
+
+    if (mThread.joinable())
+      mThread.join(); // it has finished with the queue, and only has to return
+
+    mThreadRunning = true;
+    mThread = std::thread(&AudioAssetCache::ThreadFunc, this);
+  }
+
+  void ThreadFunc()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (mRunning && !mQueue.empty())
+    {
+      Entry* pEntry = mQueue.front();
+      mQueue.pop_front();
+      lock.unlock();
+
+      std::unique_ptr<AudioAsset> pAsset = pEntry->loadFunc(pEntry->path.c_str(), pEntry->sampleRate);
+      pEntry->asset.store(pAsset.release(), std::memory_order_release);
+
+      lock.lock();
+      pEntry->loaded.store(true, std::memory_order_release);
+      mPool.Release(pEntry);
+      mCondition.notify_all();
+    }
+
+    mThreadRunning = false;
+  }
+
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  WDL_SharedPool<Entry> mPool; // guarded by mMutex, the assets themselves are read without it
+  std::deque<Entry*> mQueue;
+  std::thread mThread;
+  bool mThreadRunning = false;
+  bool mRunning = true;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,606 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Processing for buses with many channels, e.g. 7.1.4 or 9.1.6 beds and ambisonics, eight channels at a time
+ *
+ * The host's planar buffers are converted once per block into a ChannelBlockBuffer, where the channels are split into groups of eight (padded with silent channels)
+ * and the eight samples of a group are interleaved for each frame. Each frame of a group then fills one AVX vector, or two SSE2/NEON vectors, so the gains, filters
+ * and matrix mixers here process eight channels per instruction rather than looping over the channels. The kernels are selected at runtime like those of IPlugSIMD.h.
+ * @code
+ * mBlocks.Pack(inputs, nChans, nFrames);
+ * mFilters.ProcessBlock(mBlocks, nFrames);
+ * mGains.ProcessBlock(mBlocks, nFrames);
+ * mBlocks.Unpack(outputs, nChans, nFrames);
+ * @endcode
+ * Resize the buffers and processors in OnReset(), they allocate. The setters can be called on the audio thread.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "IPlugSIMD.h"
+#include "SVF.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The number of channels in a group of a ChannelBlockBuffer */
+static constexpr int kChannelBlockLanes = 8;
+
+namespace simd {
+
+#pragma mark - Scalar
+
+/** Multiply each frame of a group by a gain per lane that ramps linearly. pGain and pGainIncr have a value for each lane */
+static inline void ChannelBlockGainScalar(float* pData, int nFrames, const float* pGain, const float* pGainIncr)
+{
+  float gain[kChannelBlockLanes];
+  std::copy_n(pGain, kChannelBlockLanes, gain);
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    for (int l = 0; l < kChannelBlockLanes; l++)
+    {
+      pData[f * kChannelBlockLanes + l] *= gain[l];
+      gain[l] += pGainIncr[l];
+    }
+  }
+}
+
+/** Run the state variable filter of SVF on each lane of a group, in place. pCoeffs holds a1, a2, a3, m0, m1, m2 for each lane, pState ic1eq and ic2eq for each lane */
+static inline void ChannelBlockSVFScalar(float* pData, int nFrames, const float* pCoeffs, float* pState)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    for (int l = 0; l < L; l++)
+    {
+      const float v0 = pData[f * L + l];
+      const float v3 = v0 - pState[L + l];
+      const float v1 = pCoeffs[l] * pState[l] + pCoeffs[L + l] * v3;
+      const float v2 = pState[L + l] + pCoeffs[L + l] * pState[l] + pCoeffs[2 * L + l] * v3;
+      pState[l] = 2.f * v1 - pState[l];
+      pState[L + l] = 2.f * v2 - pState[L + l];
+      pData[f * L + l] = pCoeffs[3 * L + l] * v0 + pCoeffs[4 * L + l] * v1 + pCoeffs[5 * L + l] * v2;
+    }
+  }
+}
+
+/** Mix nIns channels into one output group. Input channel i is lane i % 8 of group i / 8, and the groups of pSrc are srcGroupStride floats apart. pGains has a gain for each lane for each input */
+static inline void ChannelBlockMixScalar(float* pDest, const float* pSrc, int srcGroupStride, const float* pGains, int nIns, int nFrames)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    float sum[kChannelBlockLanes] = {};
+
+    for (int i = 0; i < nIns; i++)
+    {
+      const float x = pSrc[(i / L) * srcGroupStride + f * L + (i % L)];
+
+      for (int l = 0; l < L; l++)
+        sum[l] += x * pGains[i * L + l];
+    }
+
+    std::copy_n(sum, L, pDest + f * L);
+  }
+}
+
+#if defined IPLUG_SIMD_X86
+#pragma mark - SSE2
+
+static inline void ChannelBlockGainSSE2(float* pData, int nFrames, const float* pGain, const float* pGainIncr)
+{
+  __m128 g0 = _mm_loadu_ps(pGain), g1 = _mm_loadu_ps(pGain + 4);
+  const __m128 i0 = _mm_loadu_ps(pGainIncr), i1 = _mm_loadu_ps(pGainIncr + 4);
+
+  for (int f = 0; f < nFrames; f++, pData += kChannelBlockLanes)
+  {
+    _mm_storeu_ps(pData, _mm_mul_ps(_mm_loadu_ps(pData), g0));
+    _mm_storeu_ps(pData + 4, _mm_mul_ps(_mm_loadu_ps(pData + 4), g1));
+    g0 = _mm_add_ps(g0, i0);
+    g1 = _mm_add_ps(g1, i1);
+  }
+}
+
+static inline void ChannelBlockSVFSSE2(float* pData, int nFrames, const float* pCoeffs, float* pState)
+{
+  const int L = kChannelBlockLanes;
+  const __m128 two = _mm_set1_ps(2.f);
+
+  // the two halves of the group are independent, so run them one after the other to keep the states in registers
+  for (int h = 0; h < L; h += 4)
+  {
+    const __m128 a1 = _mm_loadu_ps(pCoeffs + h), a2 = _mm_loadu_ps(pCoeffs + L + h), a3 = _mm_loadu_ps(pCoeffs + 2 * L + h);
+    const __m128 m0 = _mm_loadu_ps(pCoeffs + 3 * L + h), m1 = _mm_loadu_ps(pCoeffs + 4 * L + h), m2 = _mm_loadu_ps(pCoeffs + 5 * L + h);
+    __m128 ic1 = _mm_loadu_ps(pState + h), ic2 = _mm_loadu_ps(pState + L + h);
+
+    for (int f = 0; f < nFrames; f++)
+    {
+      float* pFrame = pData + f * L + h;
+      const __m128 v0 = _mm_loadu_ps(pFrame);
+      const __m128 v3 = _mm_sub_ps(v0, ic2);
+      const __m128 v1 = _mm_add_ps(_mm_mul_ps(a1, ic1), _mm_mul_ps(a2, v3));
+      const __m128 v2 = _mm_add_ps(ic2, _mm_add_ps(_mm_mul_ps(a2, ic1), _mm_mul_ps(a3, v3)));
+      ic1 = _mm_sub_ps(_mm_mul_ps(two, v1), ic1);
+      ic2 = _mm_sub_ps(_mm_mul_ps(two, v2), ic2);
+      _mm_storeu_ps(pFrame, _mm_add_ps(_mm_mul_ps(m0, v0), _mm_add_ps(_mm_mul_ps(m1, v1), _mm_mul_ps(m2, v2))));
+    }
+
+    _mm_storeu_ps(pState + h, ic1);
+    _mm_storeu_ps(pState + L + h, ic2);
+  }
+}
+
+static inline void ChannelBlockMixSSE2(float* pDest, const float* pSrc, int srcGroupStride, const float* pGains, int nIns, int nFrames)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+
+    for (int i = 0; i < nIns; i++)
+    {
+      const __m128 x = _mm_set1_ps(pSrc[(i / L) * srcGroupStride + f * L + (i % L)]);
+      sum0 = _mm_add_ps(sum0, _mm_mul_ps(x, _mm_loadu_ps(pGains + i * L)));
+      sum1 = _mm_add_ps(sum1, _mm_mul_ps(x, _mm_loadu_ps(pGains + i * L + 4)));
+    }
+
+    _mm_storeu_ps(pDest + f * L, sum0);
+    _mm_storeu_ps(pDest + f * L + 4, sum1);
+  }
+}
+
+#pragma mark - AVX
+
+IPLUG_TARGET_AVX static inline void ChannelBlockGainAVX(float* pData, int nFrames, const float* pGain, const float* pGainIncr)
+{
+  __m256 g = _mm256_loadu_ps(pGain);
+  const __m256 incr = _mm256_loadu_ps(pGainIncr);
+
+  for (int f = 0; f < nFrames; f++, pData += kChannelBlockLanes)
+  {
+    _mm256_storeu_ps(pData, _mm256_mul_ps(_mm256_loadu_ps(pData), g));
+    g = _mm256_add_ps(g, incr);
+  }
+}
+
+IPLUG_TARGET_AVX static inline void ChannelBlockSVFAVX(float* pData, int nFrames, const float* pCoeffs, float* pState)
+{
+  const int L = kChannelBlockLanes;
+  const __m256 two = _mm256_set1_ps(2.f);
+  const __m256 a1 = _mm256_loadu_ps(pCoeffs), a2 = _mm256_loadu_ps(pCoeffs + L), a3 = _mm256_loadu_ps(pCoeffs + 2 * L);
+  const __m256 m0 = _mm256_loadu_ps(pCoeffs + 3 * L), m1 = _mm256_loadu_ps(pCoeffs + 4 * L), m2 = _mm256_loadu_ps(pCoeffs + 5 * L);
+  __m256 ic1 = _mm256_loadu_ps(pState), ic2 = _mm256_loadu_ps(pState + L);
+
+  for (int f = 0; f < nFrames; f++, pData += L)
+  {
+    const __m256 v0 = _mm256_loadu_ps(pData);
+    const __m256 v3 = _mm256_sub_ps(v0, ic2);
+    const __m256 v1 = _mm256_add_ps(_mm256_mul_ps(a1, ic1), _mm256_mul_ps(a2, v3));
+    const __m256 v2 = _mm256_add_ps(ic2, _mm256_add_ps(_mm256_mul_ps(a2, ic1), _mm256_mul_ps(a3, v3)));
+    ic1 = _mm256_sub_ps(_mm256_mul_ps(two, v1), ic1);
+    ic2 = _mm256_sub_ps(_mm256_mul_ps(two, v2), ic2);
+    _mm256_storeu_ps(pData, _mm256_add_ps(_mm256_mul_ps(m0, v0), _mm256_add_ps(_mm256_mul_ps(m1, v1), _mm256_mul_ps(m2, v2))));
+  }
+
+  _mm256_storeu_ps(pState, ic1);
+  _mm256_storeu_ps(pState + L, ic2);
+}
+
+IPLUG_TARGET_AVX static inline void ChannelBlockMixAVX(float* pDest, const float* pSrc, int srcGroupStride, const float* pGains, int nIns, int nFrames)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    __m256 sum = _mm256_setzero_ps();
+
+    for (int i = 0; i < nIns; i++)
+    {
+      const __m256 x = _mm256_set1_ps(pSrc[(i / L) * srcGroupStride + f * L + (i % L)]);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(x, _mm256_loadu_ps(pGains + i * L)));
+    }
+
+    _mm256_storeu_ps(pDest + f * L, sum);
+  }
+}
+
+#elif defined IPLUG_SIMD_NEON
+#pragma mark - NEON
+
+static inline void ChannelBlockGainNEON(float* pData, int nFrames, const float* pGain, const float* pGainIncr)
+{
+  float32x4_t g0 = vld1q_f32(pGain), g1 = vld1q_f32(pGain + 4);
+  const float32x4_t i0 = vld1q_f32(pGainIncr), i1 = vld1q_f32(pGainIncr + 4);
+
+  for (int f = 0; f < nFrames; f++, pData += kChannelBlockLanes)
+  {
+    vst1q_f32(pData, vmulq_f32(vld1q_f32(pData), g0));
+    vst1q_f32(pData + 4, vmulq_f32(vld1q_f32(pData + 4), g1));
+    g0 = vaddq_f32(g0, i0);
+    g1 = vaddq_f32(g1, i1);
+  }
+}
+
+static inline void ChannelBlockSVFNEON(float* pData, int nFrames, const float* pCoeffs, float* pState)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int h = 0; h < L; h += 4)
+  {
+    const float32x4_t a1 = vld1q_f32(pCoeffs + h), a2 = vld1q_f32(pCoeffs + L + h), a3 = vld1q_f32(pCoeffs + 2 * L + h);
+    const float32x4_t m0 = vld1q_f32(pCoeffs + 3 * L + h), m1 = vld1q_f32(pCoeffs + 4 * L + h), m2 = vld1q_f32(pCoeffs + 5 * L + h);
+    float32x4_t ic1 = vld1q_f32(pState + h), ic2 = vld1q_f32(pState + L + h);
+
+    for (int f = 0; f < nFrames; f++)
+    {
+      float* pFrame = pData + f * L + h;
+      const float32x4_t v0 = vld1q_f32(pFrame);
+      const float32x4_t v3 = vsubq_f32(v0, ic2);
+      const float32x4_t v1 = vmlaq_f32(vmulq_f32(a1, ic1), a2, v3);
+      const float32x4_t v2 = vmlaq_f32(vmlaq_f32(ic2, a2, ic1), a3, v3);
+      ic1 = vsubq_f32(vaddq_f32(v1, v1), ic1);
+      ic2 = vsubq_f32(vaddq_f32(v2, v2), ic2);
+      vst1q_f32(pFrame, vmlaq_f32(vmlaq_f32(vmulq_f32(m0, v0), m1, v1), m2, v2));
+    }
+
+    vst1q_f32(pState + h, ic1);
+    vst1q_f32(pState + L + h, ic2);
+  }
+}
+
+static inline void ChannelBlockMixNEON(float* pDest, const float* pSrc, int srcGroupStride, const float* pGains, int nIns, int nFrames)
+{
+  const int L = kChannelBlockLanes;
+
+  for (int f = 0; f < nFrames; f++)
+  {
+    float32x4_t sum0 = vdupq_n_f32(0.f), sum1 = vdupq_n_f32(0.f);
+
+    for (int i = 0; i < nIns; i++)
+    {
+      const float x = pSrc[(i / L) * srcGroupStride + f * L + (i % L)];
+      sum0 = vmlaq_n_f32(sum0, vld1q_f32(pGains + i * L), x);
+      sum1 = vmlaq_n_f32(sum1, vld1q_f32(pGains + i * L + 4), x);
+    }
+
+    vst1q_f32(pDest + f * L, sum0);
+    vst1q_f32(pDest + f * L + 4, sum1);
+  }
+}
+#endif
+
+#pragma mark - Dispatch
+
+/** The channel block kernels selected for this CPU. Other targets, including WebAssembly, use the scalar loops, which the compiler can vectorize since their inner loops have a fixed length */
+struct ChannelBlockKernels
+{
+  void (*gain)(float* pData, int nFrames, const float* pGain, const float* pGainIncr) = ChannelBlockGainScalar;
+  void (*svf)(float* pData, int nFrames, const float* pCoeffs, float* pState) = ChannelBlockSVFScalar;
+  void (*mix)(float* pDest, const float* pSrc, int srcGroupStride, const float* pGains, int nIns, int nFrames) = ChannelBlockMixScalar;
+
+  ChannelBlockKernels()
+  {
+#if defined IPLUG_SIMD_X86
+    if (CPUSupportsAVX())
+    {
+      gain = ChannelBlockGainAVX;
+      svf = ChannelBlockSVFAVX;
+      mix = ChannelBlockMixAVX;
+    }
+    else
+    {
+      gain = ChannelBlockGainSSE2;
+      svf = ChannelBlockSVFSSE2;
+      mix = ChannelBlockMixSSE2;
+    }
+#elif defined IPLUG_SIMD_NEON
+    gain = ChannelBlockGainNEON;
+    svf = ChannelBlockSVFNEON;
+    mix = ChannelBlockMixNEON;
+#endif
+  }
+};
+
+/** @return The channel block kernels for this CPU, which are selected the first time this is called */
+static inline const ChannelBlockKernels& GetChannelBlockKernels()
+{
+  static const ChannelBlockKernels sKernels;
+  return sKernels;
+}
+
+} // namespace simd
+
+#pragma mark - ChannelBlockBuffer
+
+/** Holds the channels of a bus in groups of kChannelBlockLanes, with the samples of a group interleaved for each frame. The channels after the last one are padding and are kept silent by Pack() */
+class ChannelBlockBuffer
+{
+public:
+  /** Allocate the buffer, e.g. in OnReset()
+   * @param nChans The number of channels
+   * @param maxFrames The most frames that will be packed at once, e.g. GetBlockSize() */
+  void Resize(int nChans, int maxFrames)
+  {
+    mNChans = nChans;
+    mNGroups = (nChans + kChannelBlockLanes - 1) / kChannelBlockLanes;
+    mMaxFrames = maxFrames;
+    mData.assign(static_cast<size_t>(mNGroups) * maxFrames * kChannelBlockLanes, 0.f);
+  }
+
+  int NChans() const { return mNChans; }
+  int NGroups() const { return mNGroups; }
+  int MaxFrames() const { return mMaxFrames; }
+
+  /** @return The frames of a group, the kChannelBlockLanes samples of each frame one after the other */
+  float* GetGroup(int group) { return mData.data() + static_cast<size_t>(group) * GroupStride(); }
+  const float* GetGroup(int group) const { return mData.data() + static_cast<size_t>(group) * GroupStride(); }
+
+  /** @return The floats between the start of one group and the next */
+  int GroupStride() const { return mMaxFrames * kChannelBlockLanes; }
+
+  /** Copy planar channels into the buffer, e.g. the inputs of ProcessBlock(). The channels from nChans to NChans() are silenced */
+  template <typename T>
+  void Pack(const T* const* inputs, int nChans, int nFrames)
+  {
+    assert(nChans <= mNChans && nFrames <= mMaxFrames);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      float* pDest = GetGroup(c / kChannelBlockLanes) + (c % kChannelBlockLanes);
+      const T* pSrc = inputs[c];
+
+      for (int f = 0; f < nFrames; f++)
+        pDest[f * kChannelBlockLanes] = static_cast<float>(pSrc[f]);
+    }
+
+    for (int c = nChans; c < mNChans; c++)
+    {
+      float* pDest = GetGroup(c / kChannelBlockLanes) + (c % kChannelBlockLanes);
+
+      for (int f = 0; f < nFrames; f++)
+        pDest[f * kChannelBlockLanes] = 0.f;
+    }
+  }
+
+  /** Copy the channels out of the buffer into planar channels, e.g. the outputs of ProcessBlock() */
+  template <typename T>
+  void Unpack(T** outputs, int nChans, int nFrames) const
+  {
+    assert(nChans <= mNChans && nFrames <= mMaxFrames);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      const float* pSrc = GetGroup(c / kChannelBlockLanes) + (c % kChannelBlockLanes);
+      T* pDest = outputs[c];
+
+      for (int f = 0; f < nFrames; f++)
+        pDest[f] = static_cast<T>(pSrc[f * kChannelBlockLanes]);
+    }
+  }
+
+private:
+  std::vector<float> mData;
+  int mNChans = 0;
+  int mNGroups = 0;
+  int mMaxFrames = 0;
+};
+
+#pragma mark - ChannelBlockGain
+
+/** A gain for each channel of a ChannelBlockBuffer, smoothed like SmoothedGain: the one-pole smoothing is computed every kRampSize frames and the gain ramps linearly in between */
+class ChannelBlockGain
+{
+public:
+  ChannelBlockGain(double timeMs = 5.)
+  : mTimeMs(timeMs)
+  {
+    SetSampleRate(DEFAULT_SAMPLE_RATE);
+  }
+
+  /** Allocate the gains of each channel, which start at 1 */
+  void Resize(int nChans)
+  {
+    mNChans = nChans;
+    const size_t size = static_cast<size_t>((nChans + kChannelBlockLanes - 1) / kChannelBlockLanes) * kChannelBlockLanes;
+    mGains.assign(size, 1.f);
+    mTargets.assign(size, 1.f);
+  }
+
+  void SetSampleRate(double sampleRate)
+  {
+    static constexpr double TWO_PI = 6.283185307179586476925286766559;
+    const double a = std::exp(-TWO_PI / (mTimeMs * 0.001 * sampleRate));
+
+    for (int n = 0; n <= kRampSize; n++)
+      mDecay[n] = static_cast<float>(std::pow(a, n));
+  }
+
+  /** @param gain The linear gain that the channel moves to */
+  void SetGain(int chan, double gain)
+  {
+    assert(chan < mNChans);
+    mTargets[chan] = static_cast<float>(gain);
+  }
+
+  void SetAllGains(double gain)
+  {
+    std::fill(mTargets.begin(), mTargets.begin() + mNChans, static_cast<float>(gain));
+  }
+
+  /** Jump to the gains that were set, without smoothing */
+  void Reset()
+  {
+    mGains = mTargets;
+  }
+
+  void ProcessBlock(ChannelBlockBuffer& buffer, int nFrames)
+  {
+    assert(buffer.NGroups() * kChannelBlockLanes <= static_cast<int>(mGains.size()));
+    const auto& kernels = simd::GetChannelBlockKernels();
+
+    for (int g = 0; g < buffer.NGroups(); g++)
+    {
+      float* pGains = mGains.data() + g * kChannelBlockLanes;
+      const float* pTargets = mTargets.data() + g * kChannelBlockLanes;
+      float* pData = buffer.GetGroup(g);
+
+      for (int pos = 0; pos < nFrames; pos += kRampSize)
+      {
+        const int n = std::min(nFrames - pos, kRampSize);
+        float start[kChannelBlockLanes];
+        float incr[kChannelBlockLanes];
+
+        for (int l = 0; l < kChannelBlockLanes; l++)
+        {
+          float end = pTargets[l] + (pGains[l] - pTargets[l]) * mDecay[n];
+
+          if (std::abs(end - pTargets[l]) < 1e-6f)
+            end = pTargets[l];
+
+          incr[l] = (end - pGains[l]) / n;
+          start[l] = pGains[l] + incr[l];
+          pGains[l] = end;
+        }
+
+        kernels.gain(pData + pos * kChannelBlockLanes, n, start, incr);
+      }
+    }
+  }
+
+private:
+  static constexpr int kRampSize = 16;
+  double mTimeMs;
+  float mDecay[kRampSize + 1]; // the smoothing coefficient to the power of 0 to kRampSize
+  std::vector<float> mGains;
+  std::vector<float> mTargets;
+  int mNChans = 0;
+};
+
+#pragma mark - ChannelBlockSVF
+
+/** The state variable filter of SVF for each channel of a ChannelBlockBuffer, each channel with its own setting, e.g. to EQ the speakers of a bed.
+ * A new setting takes effect at the start of the next block */
+class ChannelBlockSVF
+{
+public:
+  using EMode = SVF<float>::EMode;
+
+  /** Allocate the filters, which pass nothing until they are set */
+  void Resize(int nChans)
+  {
+    mNChans = nChans;
+    const size_t nGroups = (nChans + kChannelBlockLanes - 1) / kChannelBlockLanes;
+    mCoeffs.assign(nGroups * kNumCoeffs * kChannelBlockLanes, 0.f);
+    mState.assign(nGroups * 2 * kChannelBlockLanes, 0.f);
+  }
+
+  /** Set the filter of one channel, see SVF for the settings */
+  void SetChannel(int chan, EMode mode, double freqCPS, double Q, double gainDB, double sampleRate)
+  {
+    assert(chan < mNChans);
+    const auto coeffs = SVF<float>::CalculateCoefficients(mode, Clip(freqCPS, 10., 20000.), Clip(Q, 0.1, 100.), Clip(gainDB, -36., 36.), sampleRate);
+    float* pCoeffs = mCoeffs.data() + (chan / kChannelBlockLanes) * kNumCoeffs * kChannelBlockLanes + (chan % kChannelBlockLanes);
+    const float values[kNumCoeffs] = { coeffs.a1, coeffs.a2, coeffs.a3, coeffs.m0, coeffs.m1, coeffs.m2 };
+
+    for (int k = 0; k < kNumCoeffs; k++)
+      pCoeffs[k * kChannelBlockLanes] = values[k];
+  }
+
+  /** Set the filters of all channels to the same setting */
+  void SetAllChannels(EMode mode, double freqCPS, double Q, double gainDB, double sampleRate)
+  {
+    for (int c = 0; c < mNChans; c++)
+      SetChannel(c, mode, freqCPS, Q, gainDB, sampleRate);
+  }
+
+  void Reset()
+  {
+    std::fill(mState.begin(), mState.end(), 0.f);
+  }
+
+  void ProcessBlock(ChannelBlockBuffer& buffer, int nFrames)
+  {
+    assert(buffer.NGroups() * 2 * kChannelBlockLanes <= static_cast<int>(mState.size()));
+    const auto& kernels = simd::GetChannelBlockKernels();
+
+    for (int g = 0; g < buffer.NGroups(); g++)
+      kernels.svf(buffer.GetGroup(g), nFrames, mCoeffs.data() + g * kNumCoeffs * kChannelBlockLanes, mState.data() + g * 2 * kChannelBlockLanes);
+  }
+
+private:
+  static constexpr int kNumCoeffs = 6;
+  std::vector<float> mCoeffs; // a1, a2, a3, m0, m1, m2 for each lane of each group
+  std::vector<float> mState; // ic1eq and ic2eq for each lane of each group
+  int mNChans = 0;
+};
+
+#pragma mark - ChannelBlockMatrix
+
+/** Mixes the channels of one ChannelBlockBuffer into another through a matrix of gains, e.g. an ambisonic decoder or a downmix.
+ * Each frame of an output group is the sum of the input samples times a vector of gains, so a 16 channel decoder to a 7.1.4 bed takes 32 multiply-adds per frame with AVX.
+ * Gains are not smoothed, crossfade between two matrices to change them while audio is running */
+class ChannelBlockMatrix
+{
+public:
+  /** Allocate the matrix, with all gains 0 */
+  void Resize(int nIns, int nOuts)
+  {
+    mNIns = nIns;
+    mNOuts = nOuts;
+    const size_t nOutGroups = (nOuts + kChannelBlockLanes - 1) / kChannelBlockLanes;
+    mGains.assign(nOutGroups * nIns * kChannelBlockLanes, 0.f);
+  }
+
+  int NIns() const { return mNIns; }
+  int NOuts() const { return mNOuts; }
+
+  void SetGain(int outChan, int inChan, double gain)
+  {
+    assert(outChan < mNOuts && inChan < mNIns);
+    mGains[((outChan / kChannelBlockLanes) * mNIns + inChan) * kChannelBlockLanes + (outChan % kChannelBlockLanes)] = static_cast<float>(gain);
+  }
+
+  double GetGain(int outChan, int inChan) const
+  {
+    return mGains[((outChan / kChannelBlockLanes) * mNIns + inChan) * kChannelBlockLanes + (outChan % kChannelBlockLanes)];
+  }
+
+  /** @param inputs Holds at least NIns() channels
+   * @param outputs Holds at least NOuts() channels, and is not the same buffer as inputs */
+  void ProcessBlock(const ChannelBlockBuffer& inputs, ChannelBlockBuffer& outputs, int nFrames) const
+  {
+    assert(&inputs != &outputs && inputs.NChans() >= mNIns && outputs.NChans() >= mNOuts);
+    const auto& kernels = simd::GetChannelBlockKernels();
+    const int nOutGroups = (mNOuts + kChannelBlockLanes - 1) / kChannelBlockLanes;
+
+    for (int g = 0; g < nOutGroups; g++)
+      kernels.mix(outputs.GetGroup(g), inputs.GetGroup(0), inputs.GroupStride(), mGains.data() + g * mNIns * kChannelBlockLanes, mNIns, nFrames);
+  }
+
+private:
+  std::vector<float> mGains; // for each output group, a gain for each lane for each input
+  int mNIns = 0;
+  int mNOuts = 0;
+};
+
+END_IPLUG_NAMESPACE
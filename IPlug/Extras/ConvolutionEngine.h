@@ -0,0 +1,646 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Non-uniform partitioned FFT convolution, for long impulse responses at low latency
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
+#include "IPlugSIMD.h"
+#include "fft.h"
+
+#if defined OS_MAC || defined OS_IOS
+#include <pthread.h>
+#include <pthread/qos.h>
+#elif defined OS_WIN
+#include <windows.h>
+#elif defined OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A multi-channel convolution engine for long impulse responses, e.g. 10 second reverbs, at the latency of a short block.
+ *
+ * The impulse response is split into segments of partitions that double in size: the head is convolved on the audio thread in partitions of the block size,
+ * and each later segment, which starts at least two of its partitions into the impulse response, is convolved on a background thread, so that it has a partition's
+ * worth of time to finish before its output is needed. Should it not have finished, e.g. because it runs at a low priority and has been starved of CPU, the audio thread
+ * convolves the segment's outstanding blocks itself rather than waiting for it. Each segment is a uniformly partitioned convolution
+ * with a frequency domain delay line, and the spectra are multiplied and accumulated with the SIMD kernels of IPlugSIMD.h.
+ *
+ * Call Init() to allocate everything for the longest impulse response, then SetImpulse() from any thread but the audio thread to load or swap one. The audio thread
+ * picks up a new impulse response at the start of a block and crossfades to it over SetCrossfadeTime(), so the swap does not click. Nothing is allocated on the audio thread.
+ * @ingroup IPlugExtras */
+class ConvolutionEngine
+{
+public:
+  using FFTReal = WDL_FFT_REAL;
+
+  static constexpr int kMaxPartitionSize = 16384; // half the largest WDL FFT
+
+  ConvolutionEngine()
+  {
+    WDL_fft_init();
+  }
+
+  ~ConvolutionEngine()
+  {
+    StopThread();
+    delete mKernel;
+    delete mPrevKernel;
+    delete mPendingKernel.load();
+    delete mRetiredKernel.load();
+  }
+
+  ConvolutionEngine(const ConvolutionEngine&) = delete;
+  ConvolutionEngine& operator=(const ConvolutionEngine&) = delete;
+
+  /** Allocate the engine, e.g. from OnReset(). This is not realtime safe, and drops the current impulse response
+   * @param nChans The number of channels to convolve
+   * @param blockSize The size of the head partitions, a power of two, which is the latency of the engine
+   * @param maxImpulseLength The longest impulse response that SetImpulse() will take, in samples, longer ones are truncated
+   * @param maxPartitionSize The largest partition, a power of two up to kMaxPartitionSize. Larger partitions are cheaper for long tails but need more memory
+   * @param useThread If false the tail is convolved on the audio thread, which is deterministic, e.g. for offline rendering, but has CPU spikes at the end of large partitions
+   * @param lowPriorityThread If true the background thread runs below the normal priority, so that it yields to the host's and the UI's threads. A late tail costs the audio thread the work rather than a dropout */
+  void Init(int nChans, int blockSize = 64, int maxImpulseLength = 480000, int maxPartitionSize = 8192, bool useThread = true, bool lowPriorityThread = true)
+  {
+    assert(blockSize >= 16 && (blockSize & (blockSize - 1)) == 0);
+    assert((maxPartitionSize & (maxPartitionSize - 1)) == 0);
+
+    StopThread();
+
+    delete mKernel;
+    delete mPrevKernel;
+    delete mPendingKernel.exchange(nullptr);
+    delete mRetiredKernel.exchange(nullptr);
+    mKernel = mPrevKernel = nullptr;
+
+    mNChans = nChans;
+    mBlockSize = blockSize;
+    mMaxImpulseLength = std::max(maxImpulseLength, 1);
+
+    const int maxP = Clip(maxPartitionSize, blockSize, kMaxPartitionSize);
+
+    // the head, then segments of two partitions that double in size, each starting two of its partitions into the impulse response, then the rest in the largest partitions
+    mSegments.clear();
+    mSegments.emplace_back(new Segment(0, blockSize, 0, (std::min(mMaxImpulseLength, 4 * blockSize) + blockSize - 1) / blockSize, false));
+
+    int partitionSize = blockSize;
+    int offset = 4 * blockSize;
+
+    while (offset < mMaxImpulseLength && maxP > blockSize)
+    {
+      partitionSize *= 2;
+      const bool last = partitionSize == maxP || offset + 2 * partitionSize >= mMaxImpulseLength;
+      const int nPartitions = last ? (mMaxImpulseLength - offset + partitionSize - 1) / partitionSize : 2;
+      mSegments.emplace_back(new Segment(static_cast<int>(mSegments.size()), partitionSize, offset, nPartitions, true));
+      offset += nPartitions * partitionSize;
+    }
+
+    if (maxP == blockSize && offset < mMaxImpulseLength)
+      mSegments[0]->nPartitions = (mMaxImpulseLength + blockSize - 1) / blockSize;
+
+    int inputRingSize = 1;
+    while (inputRingSize < 4 * maxP + 4 * blockSize)
+      inputRingSize *= 2;
+
+    mInputRing.assign(nChans * inputRingSize, 0.);
+    mInputRingMask = inputRingSize - 1;
+
+    for (auto& pSegment : mSegments)
+      pSegment->Allocate(nChans, pSegment->offset + 2 * blockSize);
+
+    mInputChunk.assign(nChans * blockSize, 0.);
+    mOutputChunk.assign(nChans * blockSize, 0.);
+    mAudioScratch.Allocate(maxP); // the audio thread can take over any segment's blocks
+    mLowPriorityThread = lowPriorityThread;
+    mWorkerScratch.Allocate(maxP);
+    mChunkPos = 0;
+    mTime = 0;
+
+    if (useThread && mSegments.size() > 1)
+    {
+      mRunning = true;
+      mThread = std::thread(&ConvolutionEngine::ThreadFunc, this);
+    }
+  }
+
+  /** Load an impulse response, which the audio thread crossfades to at the start of its next block. Call this from any thread but the audio thread, it allocates
+   * and does the FFTs of the impulse response
+   * @param impulses One array per channel of the impulse response. With fewer channels than the engine, the last is used for the rest
+   * @param nImpulseChans The number of channels of the impulse response
+   * @param length The length of the impulse response in samples */
+  template <typename T>
+  void SetImpulse(const T* const* impulses, int nImpulseChans, int length)
+  {
+    assert(!mSegments.empty());
+
+    // a kernel retired by the audio thread is freed here, off the audio thread
+    delete mRetiredKernel.exchange(nullptr);
+
+    Kernel* pKernel = new Kernel;
+    pKernel->nChans = std::max(nImpulseChans, 1);
+    length = std::min(length, mMaxImpulseLength);
+
+    std::vector<FFTReal> buf;
+
+    for (auto& pSegment : mSegments)
+    {
+      const int partitionSize = pSegment->partitionSize;
+      const int fftSize = 2 * partitionSize;
+      const int nPartitions = Clip((length - pSegment->offset + partitionSize - 1) / partitionSize, 0, pSegment->nPartitions);
+      const FFTReal scale = static_cast<FFTReal>(0.25 / fftSize); // the WDL FFTs are unnormalized, and scale the convolution by 4 * fftSize
+
+      pKernel->nPartitions.push_back(nPartitions);
+      pKernel->spectra.emplace_back(pKernel->nChans * nPartitions * fftSize, 0.);
+      buf.resize(fftSize);
+
+      for (int c = 0; c < nImpulseChans; c++)
+      {
+        for (int p = 0; p < nPartitions; p++)
+        {
+          const int start = pSegment->offset + p * partitionSize;
+          const int n = std::min(partitionSize, length - start);
+          std::fill(buf.begin(), buf.end(), 0.);
+
+          for (int i = 0; i < n; i++)
+            buf[i] = static_cast<FFTReal>(impulses[c][start + i]) * scale;
+
+          WDL_real_fft(buf.data(), fftSize, 0);
+          std::copy(buf.begin(), buf.end(), pKernel->spectra.back().begin() + (c * nPartitions + p) * fftSize);
+        }
+      }
+    }
+
+    // an impulse response the audio thread has not picked up yet is replaced
+    delete mPendingKernel.exchange(pKernel);
+  }
+
+  /** @param nSamples The length of the crossfade when the impulse response is swapped */
+  void SetCrossfadeTime(int nSamples) { mCrossfadeTime = std::max(nSamples, 1); }
+
+  /** @return The latency in samples, the block size passed to Init() */
+  int GetLatency() const { return mBlockSize; }
+
+  /** Clear the state of the convolution, e.g. when the transport starts. This finishes the queued work of the background thread */
+  void Reset()
+  {
+    for (auto& pSegment : mSegments)
+    {
+      WaitForBlocks(*pSegment, pSegment->blocksQueued.load(), mAudioScratch);
+      pSegment->Clear();
+    }
+
+    std::fill(mInputRing.begin(), mInputRing.end(), 0.);
+    std::fill(mInputChunk.begin(), mInputChunk.end(), 0.);
+    std::fill(mOutputChunk.begin(), mOutputChunk.end(), 0.);
+    mChunkPos = 0;
+    mTime = 0;
+  }
+
+  /** Convolve a block of audio, delayed by GetLatency(). Any number of frames can be processed
+   * @param inputs One array per channel of nFrames samples
+   * @param outputs One array per channel of nFrames samples, which can be the same as inputs */
+  template <typename T>
+  void ProcessBlock(const T* const* inputs, T** outputs, int nFrames)
+  {
+    int done = 0;
+
+    while (done < nFrames)
+    {
+      const int n = std::min(nFrames - done, mBlockSize - mChunkPos);
+
+      for (int c = 0; c < mNChans; c++)
+      {
+        FFTReal* pIn = mInputChunk.data() + c * mBlockSize + mChunkPos;
+        const FFTReal* pOut = mOutputChunk.data() + c * mBlockSize + mChunkPos;
+
+        for (int i = 0; i < n; i++)
+        {
+          pIn[i] = static_cast<FFTReal>(inputs[c][done + i]);
+          outputs[c][done + i] = static_cast<T>(pOut[i]);
+        }
+      }
+
+      mChunkPos += n;
+      done += n;
+
+      if (mChunkPos == mBlockSize)
+      {
+        ProcessChunk();
+        mChunkPos = 0;
+      }
+    }
+  }
+
+private:
+  /** An impulse response, as the spectra of the partitions of each segment */
+  struct Kernel
+  {
+    int nChans = 1;
+    std::vector<int> nPartitions; // for each segment, which may be fewer than the segment has for a short impulse response
+    std::vector<std::vector<FFTReal>> spectra; // for each segment, channel then partition
+  };
+
+  /** A block of input for a segment to convolve, with the kernels as they were when it was queued */
+  struct Job
+  {
+    const Kernel* pKernel = nullptr;
+    const Kernel* pPrevKernel = nullptr;
+    FFTReal crossfade = 1.; // the gain of pKernel, pPrevKernel has the rest
+  };
+
+  static constexpr int kMaxJobs = 16;
+
+  /** A uniformly partitioned convolution of part of the impulse response */
+  struct Segment
+  {
+    Segment(int index, int partitionSize, int offset, int nPartitions, bool background)
+    : index(index), partitionSize(partitionSize), offset(offset), nPartitions(nPartitions), background(background)
+    {
+    }
+
+    void Allocate(int nChans, int lookahead)
+    {
+      int ringSize = 1;
+      while (ringSize < lookahead + 4 * partitionSize)
+        ringSize *= 2;
+
+      this->nChans = nChans;
+      fdl.assign(nChans * nPartitions * 2 * partitionSize, 0.);
+      outputRing.assign(nChans * ringSize, 0.);
+      outputRingMask = ringSize - 1;
+      Clear();
+    }
+
+    void Clear()
+    {
+      std::fill(fdl.begin(), fdl.end(), 0.);
+      std::fill(outputRing.begin(), outputRing.end(), 0.);
+      blocksQueued = 0;
+      blocksStarted = 0;
+      blocksDone = 0;
+      lastPrevKernelBlock = -1;
+    }
+
+    int index;
+    int partitionSize;
+    int offset; // in the impulse response, of the first partition
+    int nPartitions;
+    bool background;
+    int nChans = 0;
+    std::vector<FFTReal> fdl; // the spectra of the last nPartitions blocks of input, for each channel
+    std::vector<FFTReal> outputRing; // the output, indexed by time, for each channel
+    int outputRingMask = 0;
+    Job jobs[kMaxJobs];
+    std::atomic<int64_t> blocksQueued {0};
+    std::atomic<int64_t> blocksStarted {0}; // claimed by the thread that convolves them, see TryConvolveNextBlock()
+    std::atomic<int64_t> blocksDone {0};
+    int64_t lastPrevKernelBlock = -1; // the last block queued that uses the previous kernel
+  };
+
+  /** Buffers for convolving one block */
+  struct Scratch
+  {
+    void Allocate(int maxPartitionSize)
+    {
+      fft.assign(2 * maxPartitionSize, 0.);
+      acc.assign(2 * maxPartitionSize, 0.);
+      prevAcc.assign(2 * maxPartitionSize, 0.);
+    }
+
+    std::vector<FFTReal> fft, acc, prevAcc;
+  };
+
+  void ProcessChunk()
+  {
+    const int64_t chunkStart = mTime;
+    const int64_t chunkEnd = mTime + mBlockSize;
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      FFTReal* pRing = mInputRing.data() + c * (mInputRingMask + 1);
+      const FFTReal* pIn = mInputChunk.data() + c * mBlockSize;
+
+      for (int i = 0; i < mBlockSize; i++)
+        pRing[(chunkStart + i) & mInputRingMask] = pIn[i];
+    }
+
+    UpdateKernels(chunkStart);
+
+    for (auto& pSegment : mSegments)
+    {
+      Segment& segment = *pSegment;
+
+      if (chunkEnd % segment.partitionSize)
+        continue;
+
+      const int64_t block = chunkEnd / segment.partitionSize - 1;
+      Job& job = segment.jobs[block % kMaxJobs];
+      job.pKernel = mKernel;
+      job.pPrevKernel = nullptr;
+      job.crossfade = 1.;
+
+      if (mPrevKernel)
+      {
+        const double mid = (block + 0.5) * segment.partitionSize;
+        job.crossfade = static_cast<FFTReal>(Clip((mid - mFadeStart) / mCrossfadeTime, 0., 1.));
+
+        if (job.crossfade < 1.)
+        {
+          job.pPrevKernel = mPrevKernel;
+          segment.lastPrevKernelBlock = block;
+        }
+      }
+
+      segment.blocksQueued.store(block + 1, std::memory_order_release);
+
+      if (!segment.background || !mRunning)
+      {
+        segment.blocksStarted.store(block + 1, std::memory_order_relaxed);
+        ConvolveBlock(segment, block, mAudioScratch);
+        segment.blocksDone.store(block + 1, std::memory_order_release);
+      }
+    }
+
+    if (mRunning)
+      mWakeCondition.notify_one();
+
+    // gather the output, waiting for any segment that has not finished the blocks it needs
+    std::fill(mOutputChunk.begin(), mOutputChunk.end(), 0.);
+
+    for (auto& pSegment : mSegments)
+    {
+      Segment& segment = *pSegment;
+      const int64_t blocksNeeded = std::max<int64_t>(0, (chunkEnd - segment.offset + segment.partitionSize - 1) / segment.partitionSize);
+      WaitForBlocks(segment, blocksNeeded, mAudioScratch);
+
+      const int ringSize = segment.outputRingMask + 1;
+
+      for (int c = 0; c < mNChans; c++)
+      {
+        FFTReal* pRing = segment.outputRing.data() + c * ringSize;
+        FFTReal* pOut = mOutputChunk.data() + c * mBlockSize;
+
+        for (int i = 0; i < mBlockSize; i++)
+        {
+          FFTReal& x = pRing[(chunkStart + i) & segment.outputRingMask];
+          pOut[i] += x;
+          x = 0.;
+        }
+      }
+    }
+
+    mTime = chunkEnd;
+  }
+
+  /** Start a crossfade to a pending kernel, or end one that no block uses any more */
+  void UpdateKernels(int64_t time)
+  {
+    if (mPrevKernel)
+    {
+      bool finished = true;
+
+      for (auto& pSegment : mSegments)
+      {
+        if (pSegment->lastPrevKernelBlock >= pSegment->blocksDone.load(std::memory_order_acquire) || time < mFadeStart + mCrossfadeTime + 2 * pSegment->partitionSize)
+          finished = false;
+      }
+
+      if (finished && !mRetiredKernel.load())
+      {
+        mRetiredKernel.store(mPrevKernel);
+        mPrevKernel = nullptr;
+      }
+    }
+
+    if (!mPrevKernel && mPendingKernel.load() && !mRetiredKernel.load())
+    {
+      Kernel* pKernel = mPendingKernel.exchange(nullptr);
+
+      if (mKernel)
+      {
+        mPrevKernel = mKernel;
+        mFadeStart = static_cast<double>(time);
+      }
+
+      mKernel = pKernel;
+    }
+  }
+
+  /** Make sure a segment's blocks are done, convolving those the background thread has not started. This should only happen when the thread has been starved of CPU.
+   * The audio thread only waits for the block that the background thread is in the middle of */
+  void WaitForBlocks(Segment& segment, int64_t nBlocks, Scratch& scratch)
+  {
+    while (segment.blocksDone.load(std::memory_order_acquire) < nBlocks)
+    {
+      if (!TryConvolveNextBlock(segment, scratch))
+        std::this_thread::yield();
+    }
+  }
+
+  /** Claim and convolve the next queued block of a segment. Each block adds its spectrum to the FDL for the next, so a block is only claimed once the previous one is done
+   * @return \c true if a block was convolved, \c false if there is none queued or another thread is convolving one */
+  bool TryConvolveNextBlock(Segment& segment, Scratch& scratch)
+  {
+    int64_t block = segment.blocksStarted.load(std::memory_order_relaxed);
+
+    if (block != segment.blocksDone.load(std::memory_order_acquire) || block >= segment.blocksQueued.load(std::memory_order_acquire))
+      return false;
+
+    if (!segment.blocksStarted.compare_exchange_strong(block, block + 1, std::memory_order_acquire))
+      return false;
+
+    ConvolveBlock(segment, block, scratch);
+    segment.blocksDone.store(block + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Convolve one block of input with a segment of the kernels, adding the result to the segment's output ring */
+  void ConvolveBlock(Segment& segment, int64_t block, Scratch& scratch)
+  {
+    const Job& job = segment.jobs[block % kMaxJobs];
+    const int partitionSize = segment.partitionSize;
+    const int fftSize = 2 * partitionSize;
+    const int segmentIdx = segment.index;
+    const int fdlSlot = static_cast<int>(block % segment.nPartitions);
+    const int ringSize = segment.outputRingMask + 1;
+
+    for (int c = 0; c < mNChans; c++)
+    {
+      // the spectrum of the block, zero padded
+      const FFTReal* pInputRing = mInputRing.data() + c * (mInputRingMask + 1);
+      FFTReal* pFFT = scratch.fft.data();
+      const int64_t blockStart = block * partitionSize;
+
+      for (int i = 0; i < partitionSize; i++)
+        pFFT[i] = pInputRing[(blockStart + i) & mInputRingMask];
+
+      std::fill(pFFT + partitionSize, pFFT + fftSize, 0.);
+      WDL_real_fft(pFFT, fftSize, 0);
+
+      FFTReal* pFDL = segment.fdl.data() + c * segment.nPartitions * fftSize;
+      memcpy(pFDL + fdlSlot * fftSize, pFFT, fftSize * sizeof(FFTReal));
+
+      const int64_t nBlocks = block + 1;
+      MultiplyAccumulate(job.pKernel, segmentIdx, c, pFDL, fdlSlot, segment.nPartitions, nBlocks, fftSize, scratch.acc.data());
+
+      if (job.pPrevKernel)
+      {
+        MultiplyAccumulate(job.pPrevKernel, segmentIdx, c, pFDL, fdlSlot, segment.nPartitions, nBlocks, fftSize, scratch.prevAcc.data());
+
+        FFTReal* pAcc = scratch.acc.data();
+        const FFTReal* pPrevAcc = scratch.prevAcc.data();
+
+        for (int i = 0; i < fftSize; i++)
+          pAcc[i] = pPrevAcc[i] + job.crossfade * (pAcc[i] - pPrevAcc[i]);
+      }
+
+      WDL_real_fft(scratch.acc.data(), fftSize, 1);
+
+      FFTReal* pRing = segment.outputRing.data() + c * ringSize;
+      const int64_t outStart = blockStart + segment.offset;
+
+      for (int i = 0; i < fftSize; i++)
+        pRing[(outStart + i) & segment.outputRingMask] += scratch.acc[i];
+    }
+  }
+
+  /** Sum the spectra of the last blocks of input multiplied by the spectra of the kernel's partitions */
+  static void MultiplyAccumulate(const Kernel* pKernel, int segmentIdx, int chan, const FFTReal* pFDL, int fdlSlot, int fdlSize, int64_t nBlocks, int fftSize, FFTReal* pAcc)
+  {
+    std::fill(pAcc, pAcc + fftSize, 0.);
+
+    if (!pKernel)
+      return;
+
+    const int nPartitions = static_cast<int>(std::min<int64_t>(pKernel->nPartitions[segmentIdx], nBlocks));
+    const int kernelChan = std::min(chan, pKernel->nChans - 1);
+    const FFTReal* pSpectra = pKernel->spectra[segmentIdx].data() + kernelChan * pKernel->nPartitions[segmentIdx] * fftSize;
+
+    for (int p = 0; p < nPartitions; p++)
+    {
+      const int slot = (fdlSlot - p + fdlSize) % fdlSize;
+      const FFTReal* pX = pFDL + slot * fftSize;
+      const FFTReal* pH = pSpectra + p * fftSize;
+
+      // the first pair holds the DC and Nyquist bins, which are real
+      pAcc[0] += pX[0] * pH[0];
+      pAcc[1] += pX[1] * pH[1];
+      ComplexMultiplyAccumulate(pAcc + 2, pX + 2, pH + 2, fftSize / 2 - 1);
+    }
+  }
+
+  static inline void ComplexMultiplyAccumulate(float* pDest, const float* pA, const float* pB, int nComplex)
+  {
+    simd::GetKernels().complexMACFloat(pDest, pA, pB, nComplex);
+  }
+
+  static inline void ComplexMultiplyAccumulate(double* pDest, const double* pA, const double* pB, int nComplex)
+  {
+    simd::GetKernels().complexMACDouble(pDest, pA, pB, nComplex);
+  }
+
+  /** Convolve the queued blocks of the background segments, the smallest partitions first as their deadlines are nearest */
+  void ThreadFunc()
+  {
+    if (mLowPriorityThread)
+      LowerThreadPriority();
+
+    while (mRunning)
+    {
+      bool didWork = false;
+
+      for (auto& pSegment : mSegments)
+      {
+        if (pSegment->background && TryConvolveNextBlock(*pSegment, mWorkerScratch))
+        {
+          didWork = true;
+          break;
+        }
+      }
+
+      if (!didWork)
+      {
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWakeCondition.wait_for(lock, std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  /** Run the calling thread below the normal priority */
+  static void LowerThreadPriority()
+  {
+#if defined OS_MAC || defined OS_IOS
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#elif defined OS_WIN
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined OS_LINUX
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10); // on Linux the nice value of a thread id applies to that thread only
+#endif
+  }
+
+  void StopThread()
+  {
+    if (mThread.joinable())
+    {
+      mRunning = false;
+      mWakeCondition.notify_one();
+      mThread.join();
+    }
+
+    mRunning = false;
+  }
+
+  int mNChans = 0;
+  int mBlockSize = 64;
+  int mMaxImpulseLength = 0;
+  int mCrossfadeTime = 4096;
+  std::vector<std::unique_ptr<Segment>> mSegments;
+  std::vector<FFTReal> mInputRing; // the input, indexed by time, for each channel
+  int mInputRingMask = 0;
+  std::vector<FFTReal> mInputChunk;
+  std::vector<FFTReal> mOutputChunk;
+  int mChunkPos = 0;
+  int64_t mTime = 0; // at the start of the current chunk
+  Scratch mAudioScratch;
+  Scratch mWorkerScratch;
+
+  Kernel* mKernel = nullptr; // owned by the audio thread
+  Kernel* mPrevKernel = nullptr; // the kernel being crossfaded from, owned by the audio thread
+  double mFadeStart = 0.;
+  std::atomic<Kernel*> mPendingKernel {nullptr}; // set by SetImpulse(), taken by the audio thread
+  std::atomic<Kernel*> mRetiredKernel {nullptr}; // set by the audio thread, freed by SetImpulse()
+
+  std::atomic<bool> mRunning {false};
+  bool mLowPriorityThread = true;
+  std::thread mThread;
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCondition;
+};
+
+END_IPLUG_NAMESPACE
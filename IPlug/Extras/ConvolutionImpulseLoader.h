@@ -0,0 +1,214 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Prepares impulse responses for a ConvolutionEngine on a worker thread
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConvolutionEngine.h"
+#include "resample.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Resamples an impulse response to the session's sample rate and prepares its partitions for a ConvolutionEngine on a worker thread, so that neither
+ * loading an impulse response nor a change of sample rate stalls the host. The engine keeps convolving with the impulse response it has until the new one is
+ * published to it with ConvolutionEngine::SetImpulse(), then crossfades. The resampling is WDL_Resampler's windowed sinc, so resample.cpp must be compiled.
+ * Don't call ConvolutionEngine::Init() while a request is being prepared, see WaitUntilReady()
+ * @ingroup IPlugExtras */
+class ConvolutionImpulseLoader
+{
+public:
+  /** @param engine The engine to publish the impulse responses to, which must outlive the loader */
+  ConvolutionImpulseLoader(ConvolutionEngine& engine)
+  : mEngine(engine)
+  {
+    mThread = std::thread(&ConvolutionImpulseLoader::ThreadFunc, this);
+  }
+
+  ~ConvolutionImpulseLoader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mRunning = false;
+    }
+
+    mCondition.notify_all();
+    mThread.join();
+  }
+
+  ConvolutionImpulseLoader(const ConvolutionImpulseLoader&) = delete;
+  ConvolutionImpulseLoader& operator=(const ConvolutionImpulseLoader&) = delete;
+
+  /** Load an impulse response, which is copied, to be resampled to the rate of the last call to SetSampleRate(). Don't call this on the audio thread
+   * @param impulses One array per channel of the impulse response
+   * @param nChans The number of channels of the impulse response
+   * @param length The length of the impulse response in samples
+   * @param sampleRate The sample rate the impulse response was recorded at */
+  template <typename T>
+  void LoadImpulse(const T* const* impulses, int nChans, int length, double sampleRate)
+  {
+    std::vector<std::vector<WDL_ResampleSample>> source(nChans);
+
+    for (int c = 0; c < nChans; c++)
+      source[c].assign(impulses[c], impulses[c] + length);
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mSource = std::move(source);
+      mSourceRate = sampleRate;
+      mRequest++;
+    }
+
+    mCondition.notify_all();
+  }
+
+  /** Resample the impulse response to a new rate, e.g. from OnReset(). This returns at once, the engine uses the previous impulse response until the new one is ready
+   * @param sampleRate The session's sample rate */
+  void SetSampleRate(double sampleRate)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (sampleRate == mTargetRate)
+        return;
+
+      mTargetRate = sampleRate;
+      mRequest++;
+    }
+
+    mCondition.notify_all();
+  }
+
+  /** @return \c true if the last impulse response or sample rate requested has been published to the engine */
+  bool IsReady() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mDone == mRequest;
+  }
+
+  /** Block until the last request has been published to the engine, e.g. before rendering offline. Don't call this on the audio thread */
+  void WaitUntilReady()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mDone == mRequest || !mRunning; });
+  }
+
+private:
+  void ThreadFunc()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (mRunning)
+    {
+      mCondition.wait(lock, [this]() { return mDone != mRequest || !mRunning; });
+
+      if (!mRunning)
+        break;
+
+      const int request = mRequest;
+      const std::vector<std::vector<WDL_ResampleSample>> source = mSource;
+      const double sourceRate = mSourceRate;
+      const double targetRate = mTargetRate;
+
+      lock.unlock();
+
+      if (!source.empty() && sourceRate > 0. && targetRate > 0.)
+        Prepare(source, sourceRate, targetRate);
+
+      lock.lock();
+      mDone = request;
+      mCondition.notify_all();
+    }
+  }
+
+  /** Resample each channel and publish the result to the engine, which does the FFTs of the partitions */
+  void Prepare(const std::vector<std::vector<WDL_ResampleSample>>& source, double sourceRate, double targetRate)
+  {
+    const int nChans = static_cast<int>(source.size());
+    const int srcLength = static_cast<int>(source[0].size());
+    const int dstLength = static_cast<int>(targetRate / sourceRate * srcLength + 0.5);
+
+    std::vector<std::vector<WDL_ResampleSample>> resampled(nChans, std::vector<WDL_ResampleSample>(dstLength, 0.));
+
+    for (int c = 0; c < nChans; c++)
+    {
+      if (dstLength == srcLength)
+        resampled[c] = source[c];
+      else
+        Resample(source[c].data(), srcLength, sourceRate, resampled[c].data(), dstLength, targetRate);
+    }
+
+    std::vector<const WDL_ResampleSample*> ptrs(nChans);
+
+    for (int c = 0; c < nChans; c++)
+      ptrs[c] = resampled[c].data();
+
+    mEngine.SetImpulse(ptrs.data(), nChans, dstLength);
+  }
+
+  /** Resample one channel, scaled so that the impulse response has the same gain at the new rate */
+  void Resample(const WDL_ResampleSample* pSrc, int srcLength, double srcRate, WDL_ResampleSample* pDst, int dstLength, double dstRate)
+  {
+    static constexpr int kBlockSize = 256;
+
+    mResampler.SetMode(false, 0, true); // sinc, default size
+    mResampler.SetFeedMode(false); // output driven, so each block fills buf
+    mResampler.SetRates(srcRate, dstRate);
+    mResampler.Reset();
+
+    const double scale = srcRate / dstRate;
+    WDL_ResampleSample buf[kBlockSize];
+
+    // the input is followed by silence until the filter's tail has been output
+    while (dstLength > 0)
+    {
+      WDL_ResampleSample* pIn;
+      const int nIn = mResampler.ResamplePrepare(kBlockSize, 1, &pIn);
+      const int n = std::min(nIn, srcLength);
+
+      for (int i = 0; i < n; i++)
+        pIn[i] = *pSrc++;
+
+      std::fill(pIn + n, pIn + nIn, 0.);
+      srcLength -= n;
+
+      const int nOut = std::min(mResampler.ResampleOut(buf, nIn, kBlockSize, 1), dstLength);
+
+      for (int i = 0; i < nOut; i++)
+        *pDst++ = scale * buf[i];
+
+      dstLength -= nOut;
+    }
+  }
+
+  ConvolutionEngine& mEngine;
+  WDL_Resampler mResampler;
+
+  mutable std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::vector<std::vector<WDL_ResampleSample>> mSource;
+  double mSourceRate = 0.;
+  double mTargetRate = 0.;
+  int mRequest = 0;
+  int mDone = 0;
+  bool mRunning = true;
+  std::thread mThread;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,576 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @copydoc IPlugEEL
+ */
+
+#include "IPlugEEL.h"
+
+#include <sys/stat.h>
+
+#include "fileread.h"
+#include "mutex.h"
+
+#ifndef IPLUG_EEL_NO_HOSTSTUBS
+// scripts that share the global gmem[] are run on the audio thread while a new script's @init runs on the compile thread
+static WDL_Mutex sEELHostMutex;
+
+void NSEEL_HOSTSTUB_EnterMutex() { sEELHostMutex.Enter(); }
+void NSEEL_HOSTSTUB_LeaveMutex() { sEELHostMutex.Leave(); }
+#endif
+
+using namespace iplug;
+
+std::mutex IPlugEEL::sCompileMutex;
+
+/** @return The modification time of a file, or 0 if it can't be read */
+static time_t GetModifiedTime(const char* path)
+{
+#ifdef OS_WIN
+  wchar_t utf16str[MAX_PATH];
+  UTF8ToUTF16(utf16str, path, MAX_PATH);
+  struct _stat64i32 buf;
+  return _wstat(utf16str, &buf) == 0 ? buf.st_mtime : 0;
+#else
+  struct stat buf;
+  return stat(path, &buf) == 0 ? buf.st_mtime : 0;
+#endif
+}
+
+IPlugEEL::Program::~Program()
+{
+  for (auto code : {init, slider, block, sample})
+  {
+    if (code)
+      NSEEL_code_free(code);
+  }
+
+  if (vm)
+    NSEEL_VM_free(vm);
+}
+
+IPlugEEL::IPlugEEL(const char* name, int nInChans, int nOutChans)
+: mNInChans(std::min(nInChans, MAX_BUS_CHANS))
+, mNOutChans(std::min(nOutChans, MAX_BUS_CHANS))
+{
+  mName.Set(name);
+
+  for (auto& value : mParamValues)
+    value = 0.;
+
+  mThread = std::thread(&IPlugEEL::ThreadFunc, this);
+  mTimer = std::unique_ptr<Timer>(Timer::Create(std::bind(&IPlugEEL::OnTimer, this, std::placeholders::_1), EEL_RECOMPILE_INTERVAL));
+}
+
+IPlugEEL::~IPlugEEL()
+{
+  mTimer = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRunning = false;
+  }
+
+  mCondition.notify_all();
+  mThread.join();
+
+  delete mProgram;
+  delete mPendingProgram.load();
+  delete mRetiredProgram.load();
+  mParams.Empty(true);
+}
+
+void IPlugEEL::SetSourceCode(const char* code)
+{
+  std::vector<ParamInfo> params;
+  std::string sections[4];
+  int sectionLines[4];
+  std::string error;
+
+  // the parameters are updated now, the compile thread reports any other errors
+  if (ParseScript(code, params, sections, sectionLines, error))
+  {
+    // the values are kept by variable name
+    std::vector<double> values(params.size());
+    const int nPrevParams = mNParams.load(std::memory_order_relaxed);
+
+    for (size_t p = 0; p < params.size(); p++)
+    {
+      values[p] = params[p].defaultVal;
+
+      for (int q = 0; q < nPrevParams; q++)
+      {
+        if (mParamInfos[q].varName == params[p].varName)
+          values[p] = mParamValues[q].load(std::memory_order_relaxed);
+      }
+    }
+
+    // the IParams are kept, as the plug-in may hold indices of them
+    const int nParams = static_cast<int>(params.size());
+
+    for (int p = 0; p < nParams; p++)
+    {
+      IParam* pParam = p < mParams.GetSize() ? mParams.Get(p) : mParams.Add(new IParam());
+      const ParamInfo& info = params[p];
+      pParam->InitDouble(info.label.c_str(), info.defaultVal, info.minVal, info.maxVal, info.step > 0. ? info.step : 0.001);
+      pParam->Set(values[p]);
+      mParamRanges[p].minVal.store(pParam->GetMin(), std::memory_order_relaxed);
+      mParamRanges[p].maxVal.store(pParam->GetMax(), std::memory_order_relaxed);
+      mParamValues[p].store(pParam->Value(), std::memory_order_relaxed);
+    }
+
+    mNParams.store(nParams, std::memory_order_release);
+
+    mParamInfos = params;
+    mParamValuesChanged.store(true, std::memory_order_release);
+
+    if (mIPlugParamStartIdx > -1 && mPlug != nullptr) // if we've already linked parameters
+    {
+      CreateIPlugParameters(mPlug, mIPlugParamStartIdx, -1, false);
+      mPlug->OnParamReset(EParamSource::kRecompile);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSourceCode = code;
+    mSourceCodeVersion++;
+  }
+
+  mCondition.notify_all();
+}
+
+bool IPlugEEL::LoadFile(const char* path)
+{
+  WDL_FileRead infile(path);
+
+  if (!infile.IsOpen())
+  {
+    DBGMSG("IPlugEEL-%s: Could not open %s\n", mName.Get(), path);
+    return false;
+  }
+
+  std::vector<char> buffer(static_cast<size_t>(infile.GetSize()) + 1); // +1 to have space for the terminating zero
+  infile.Read(buffer.data(), static_cast<int>(infile.GetSize()));
+  buffer[static_cast<size_t>(infile.GetSize())] = '\0';
+
+  mFilePath.Set(path);
+  mFileTime = GetModifiedTime(path);
+  SetSourceCode(buffer.data());
+  return true;
+}
+
+void IPlugEEL::SetAutoRecompile(bool enable)
+{
+  mAutoRecompile = enable;
+}
+
+void IPlugEEL::OnTimer(Timer& timer)
+{
+  FreeRetiredProgram();
+
+  if (!mAutoRecompile || !mFilePath.GetLength())
+    return;
+
+  const time_t fileTime = GetModifiedTime(mFilePath.Get());
+
+  if (fileTime != mFileTime)
+  {
+    DBGMSG("IPlugEEL-%s: File change detected\n", mName.Get());
+
+    // the current script keeps running until the new one has compiled
+    WDL_String path(mFilePath);
+    LoadFile(path.Get());
+  }
+}
+
+void IPlugEEL::WaitForCompile()
+{
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return mCompiledVersion == mSourceCodeVersion; });
+  }
+
+  // so that the next ProcessBlock() can retire the current program
+  FreeRetiredProgram();
+}
+
+void IPlugEEL::FreeRetiredProgram()
+{
+  delete mRetiredProgram.exchange(nullptr, std::memory_order_acquire);
+}
+
+void IPlugEEL::SetSampleRate(double sampleRate)
+{
+  mSampleRate = sampleRate;
+
+  if (mProgram)
+    InitProgram(*mProgram, sampleRate);
+}
+
+void IPlugEEL::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
+{
+  // pick up a new script, and hand the previous one to the main thread to be freed. If it hasn't freed the last one yet, the new script waits
+  Program* pPending = mRetiredProgram.load(std::memory_order_acquire) ? nullptr : mPendingProgram.exchange(nullptr, std::memory_order_acquire);
+
+  if (pPending)
+  {
+    mRetiredProgram.store(mProgram, std::memory_order_release);
+    mProgram = pPending;
+    mParamValuesChanged.store(true, std::memory_order_relaxed);
+
+    // the sample rate changed while it was compiling
+    if (mProgram->sampleRate != mSampleRate.load())
+      InitProgram(*mProgram, mSampleRate.load());
+  }
+
+  Program* pProgram = mProgram;
+
+  if (!pProgram || !pProgram->sample)
+  {
+    for (auto c = 0; c < std::min(mNInChans, mNOutChans); c++)
+    {
+      if (outputs[c] != inputs[c])
+        memcpy(outputs[c], inputs[c], nFrames * sizeof(sample));
+    }
+
+    for (auto c = mNInChans; c < mNOutChans; c++)
+      memset(outputs[c], 0, nFrames * sizeof(sample));
+
+    if (!pProgram)
+      return;
+  }
+
+  if (mParamValuesChanged.exchange(false, std::memory_order_acquire))
+    ApplyParameterValues(*pProgram);
+
+  *pProgram->samplesblock = nFrames;
+
+  if (pProgram->block)
+    NSEEL_code_execute(pProgram->block);
+
+  if (!pProgram->sample)
+    return;
+
+  const int nChans = std::max(mNInChans, mNOutChans);
+
+  for (auto s = 0; s < nFrames; s++)
+  {
+    for (auto c = 0; c < nChans; c++)
+      *pProgram->spl[c] = c < mNInChans ? inputs[c][s] : 0.;
+
+    NSEEL_code_execute(pProgram->sample);
+
+    for (auto c = 0; c < mNOutChans; c++)
+      outputs[c][s] = static_cast<sample>(*pProgram->spl[c]);
+  }
+}
+
+void IPlugEEL::SetParameterValue(int paramIdx, double nonNormalizedValue)
+{
+  if (paramIdx < 0 || paramIdx >= NParams())
+  {
+    DBGMSG("IPlugEEL-%s:: No parameter %i\n", mName.Get(), paramIdx);
+    return;
+  }
+
+  const ParamRange& range = mParamRanges[paramIdx];
+  mParamValues[paramIdx].store(Clip(nonNormalizedValue, range.minVal.load(std::memory_order_relaxed), range.maxVal.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+  mParamValuesChanged.store(true, std::memory_order_release);
+}
+
+void IPlugEEL::SetParameterValueNormalised(int paramIdx, double normalizedValue)
+{
+  if (paramIdx < 0 || paramIdx >= NParams())
+  {
+    DBGMSG("IPlugEEL-%s:: No parameter %i\n", mName.Get(), paramIdx);
+    return;
+  }
+
+  // the parameters are linear
+  const ParamRange& range = mParamRanges[paramIdx];
+  const double minVal = range.minVal.load(std::memory_order_relaxed);
+  SetParameterValue(paramIdx, minVal + Clip(normalizedValue, 0., 1.) * (range.maxVal.load(std::memory_order_relaxed) - minVal));
+}
+
+int IPlugEEL::CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx, int endIdx, bool setToDefault)
+{
+  assert(pPlug != nullptr);
+
+  mPlug = pPlug;
+  mIPlugParamStartIdx = startIdx;
+
+  if (NParams() == 0)
+    return -1;
+
+  if (endIdx == -1)
+    endIdx = std::min(NParams(), pPlug->NParams() - startIdx);
+
+  for (auto p = 0; p < endIdx; p++)
+  {
+    assert(startIdx + p < pPlug->NParams()); // plugin needs to have enough params!
+
+    IParam* pPlugParam = pPlug->GetParam(startIdx + p);
+    pPlugParam->Init(*mParams.Get(p));
+
+    if (setToDefault)
+      pPlugParam->SetToDefault();
+    else
+      pPlugParam->Set(mParamValues[p].load(std::memory_order_relaxed));
+  }
+
+  return startIdx;
+}
+
+//static
+bool IPlugEEL::ParseParamLine(const std::string& line, ParamInfo& param)
+{
+  // sliderN:[var=]default<min,max[,step]>label
+  const size_t colon = line.find(':');
+  const size_t open = line.find('<', colon);
+  const size_t close = line.find('>', open);
+
+  if (colon == std::string::npos || open == std::string::npos || close == std::string::npos)
+    return false;
+
+  std::string value = line.substr(colon + 1, open - colon - 1);
+  const size_t equals = value.find('=');
+
+  if (equals != std::string::npos)
+  {
+    param.varName = value.substr(0, equals);
+    value = value.substr(equals + 1);
+  }
+  else
+    param.varName = line.substr(0, colon);
+
+  double range[3] = {0., 1., 0.};
+  int nRange = 0;
+  const std::string rangeStr = line.substr(open + 1, close - open - 1);
+
+  for (size_t start = 0; start <= rangeStr.size() && nRange < 3; nRange++)
+  {
+    const size_t end = std::min(rangeStr.find(',', start), rangeStr.size());
+    range[nRange] = atof(rangeStr.substr(start, end - start).c_str());
+    start = end + 1;
+  }
+
+  if (nRange < 2)
+    return false;
+
+  param.defaultVal = atof(value.c_str());
+  param.minVal = range[0];
+  param.maxVal = range[1];
+  param.step = range[2];
+  param.label = line.substr(close + 1);
+
+  if (param.label.empty())
+    param.label = param.varName;
+
+  return param.varName.size() > 0;
+}
+
+//static
+bool IPlugEEL::ParseScript(const std::string& code, std::vector<ParamInfo>& params, std::string sections[4], int sectionLines[4], std::string& error)
+{
+  static const char* sectionNames[4] = {"@init", "@slider", "@block", "@sample"};
+
+  int section = -1;
+  int lineNumber = 0;
+
+  for (int s = 0; s < 4; s++)
+  {
+    sections[s].clear();
+    sectionLines[s] = 0;
+  }
+
+  for (size_t start = 0; start < code.size(); lineNumber++)
+  {
+    size_t end = code.find('\n', start);
+    if (end == std::string::npos)
+      end = code.size();
+
+    std::string line = code.substr(start, end - start);
+    start = end + 1;
+
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if (line.size() && line[0] == '@')
+    {
+      const std::string name = line.substr(0, line.find_first_of(" \t"));
+      section = -1;
+
+      for (int s = 0; s < 4; s++)
+      {
+        if (name == sectionNames[s])
+          section = s;
+      }
+
+      if (section == -1)
+      {
+        error = "line " + std::to_string(lineNumber + 1) + ": unknown section " + name;
+        return false;
+      }
+
+      sectionLines[section] = lineNumber + 1;
+    }
+    else if (section > -1)
+    {
+      sections[section] += line + "\n";
+    }
+    else if (line.compare(0, 6, "slider") == 0)
+    {
+      ParamInfo param;
+
+      if (!ParseParamLine(line, param))
+      {
+        error = "line " + std::to_string(lineNumber + 1) + ": could not parse " + line;
+        return false;
+      }
+
+      if (params.size() == EEL_MAX_PARAMS)
+      {
+        error = "too many parameters";
+        return false;
+      }
+
+      params.push_back(param);
+    }
+  }
+
+  return true;
+}
+
+IPlugEEL::Program* IPlugEEL::Compile(const std::string& code, std::string& error)
+{
+  std::vector<ParamInfo> params;
+  std::string sections[4];
+  int sectionLines[4];
+
+  if (!ParseScript(code, params, sections, sectionLines, error))
+    return nullptr;
+
+  std::unique_ptr<Program> program = std::make_unique<Program>();
+  std::lock_guard<std::mutex> lock(sCompileMutex);
+
+  program->vm = NSEEL_VM_alloc();
+
+  if (!program->vm)
+  {
+    error = "could not allocate an EEL2 VM";
+    return nullptr;
+  }
+
+  // the variables are registered before the code is compiled, so that they are found by name
+  char name[32];
+  for (auto c = 0; c < std::max(mNInChans, mNOutChans); c++)
+  {
+    snprintf(name, sizeof(name), "spl%i", c);
+    program->spl[c] = NSEEL_VM_regvar(program->vm, name);
+  }
+
+  program->srate = NSEEL_VM_regvar(program->vm, "srate");
+  program->samplesblock = NSEEL_VM_regvar(program->vm, "samplesblock");
+  program->numCh = NSEEL_VM_regvar(program->vm, "num_ch");
+  program->nParams = static_cast<int>(params.size());
+
+  for (auto p = 0; p < program->nParams; p++)
+    program->params[p] = NSEEL_VM_regvar(program->vm, params[p].varName.c_str());
+
+  NSEEL_CODEHANDLE* handles[4] = {&program->init, &program->slider, &program->block, &program->sample};
+
+  for (int s = 0; s < 4; s++)
+  {
+    if (sections[s].find_first_not_of(" \t\r\n") == std::string::npos)
+      continue;
+
+    // functions defined in @init can be called from the later sections
+    *handles[s] = NSEEL_code_compile_ex(program->vm, sections[s].c_str(), sectionLines[s], NSEEL_CODE_COMPILE_FLAG_COMMONFUNCS);
+
+    if (!*handles[s])
+    {
+      const char* codeError = NSEEL_code_getcodeerror(program->vm);
+      error = codeError ? codeError : "compile error";
+      return nullptr;
+    }
+  }
+
+  InitProgram(*program, mSampleRate.load());
+  return program.release();
+}
+
+void IPlugEEL::InitProgram(Program& program, double sampleRate)
+{
+  program.sampleRate = sampleRate;
+  *program.srate = sampleRate;
+  *program.numCh = std::max(mNInChans, mNOutChans);
+  *program.samplesblock = 0.;
+
+  for (auto c = 0; c < std::max(mNInChans, mNOutChans); c++)
+    *program.spl[c] = 0.;
+
+  // like JSFX, the parameters have their values when @init runs
+  for (auto p = 0; p < program.nParams; p++)
+    *program.params[p] = mParamValues[p].load(std::memory_order_relaxed);
+
+  if (program.init)
+    NSEEL_code_execute(program.init);
+
+  ApplyParameterValues(program);
+}
+
+void IPlugEEL::ApplyParameterValues(Program& program)
+{
+  for (auto p = 0; p < program.nParams; p++)
+    *program.params[p] = mParamValues[p].load(std::memory_order_relaxed);
+
+  if (program.slider)
+    NSEEL_code_execute(program.slider);
+}
+
+void IPlugEEL::ThreadFunc()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  while (true)
+  {
+    mCondition.wait(lock, [this]() { return !mRunning || mCompiledVersion != mSourceCodeVersion; });
+
+    if (!mRunning)
+      return;
+
+    // the latest source code is compiled, any versions in between are skipped
+    const std::string code = mSourceCode;
+    const uint64_t version = mSourceCodeVersion;
+    lock.unlock();
+
+    std::string error;
+    Program* pProgram = Compile(code, error);
+
+    if (pProgram)
+    {
+      DBGMSG("IPlugEEL-%s: Compiled\n", mName.Get());
+
+      delete mPendingProgram.exchange(pProgram, std::memory_order_acq_rel); // a program the audio thread never picked up
+    }
+    else
+      DBGMSG("IPlugEEL-%s: %s\n", mName.Get(), error.c_str());
+
+    if (mOnCompileFunc)
+      mOnCompileFunc(pProgram != nullptr, pProgram ? "" : error.c_str());
+
+    lock.lock();
+    mCompiledVersion = version;
+    mCondition.notify_all();
+  }
+}
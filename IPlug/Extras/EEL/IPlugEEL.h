@@ -0,0 +1,196 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugEEL
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IPlugAPIBase.h"
+#include "IPlugTimer.h"
+
+#include "eel2/ns-eel.h"
+
+#define EEL_RECOMPILE_INTERVAL 500 //ms, how often SetAutoRecompile() checks the script file for changes
+#define EEL_MAX_PARAMS 64
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Runs a user-programmable DSP script written in EEL2, the language of REAPER's JSFX, which is JIT compiled by WDL's ns-eel2, a much smaller compiler than FAUST's LLVM.
+ * The eel2 sources (nseel-*.c, and asm-nseel-x64-sse.asm on x86_64) must be compiled, and IPlugEEL.cpp implements NSEEL_HOSTSTUB_EnterMutex() and NSEEL_HOSTSTUB_LeaveMutex()
+ * unless IPLUG_EEL_NO_HOSTSTUBS is defined.
+ *
+ * A script is JSFX-like: parameter lines such as `slider1:gain_db=0<-60,12,0.1>Gain (dB)` come first, then the @init, @slider, @block and @sample sections.
+ * @init runs when the script has compiled and when the sample rate changes, @slider when parameters change, @block at the start of each block and @sample for each frame
+ * with the channels in spl0, spl1 etc. The variables srate, samplesblock and num_ch are set too.
+ *
+ * Scripts are compiled, and their @init run, on a background thread, while the current script keeps running. The audio thread picks up the new script at the start of a block,
+ * so recompiling doesn't interrupt the audio, see SetAutoRecompile(). Parameter values are kept by variable name when a script is recompiled
+ * @ingroup IPlugExtras */
+class IPlugEEL
+{
+public:
+  /** @param name A name for the block, used in debug messages
+   * @param nInChans The number of input channels, read into spl0 etc before each @sample
+   * @param nOutChans The number of output channels, written from spl0 etc after each @sample */
+  IPlugEEL(const char* name, int nInChans = 2, int nOutChans = 2);
+
+  ~IPlugEEL();
+
+  IPlugEEL(const IPlugEEL&) = delete;
+  IPlugEEL& operator=(const IPlugEEL&) = delete;
+
+  /** Compile a script on the background thread. Call this on the main thread, the parameters are updated at once
+   * @param code The EEL2 script */
+  void SetSourceCode(const char* code);
+
+  /** Read a script file and compile it, see SetSourceCode()
+   * @return \c true if the file could be read */
+  bool LoadFile(const char* path);
+
+  /** Check the file given to LoadFile() for changes every EEL_RECOMPILE_INTERVAL ms, and recompile it if it has changed. The check is made on the main thread's timer, which also frees the scripts that have been replaced */
+  void SetAutoRecompile(bool enable);
+
+  /** @param func Called on the background thread after each compile, with \c true on success or the error message of the compiler */
+  void SetCompileFunc(std::function<void(bool success, const char* error)> func) { mOnCompileFunc = func; }
+
+  /** Wait for the script being compiled, if there is one, e.g. before offline rendering. It is picked up by the next ProcessBlock() */
+  void WaitForCompile();
+
+  /** Set the sample rate and run @init again, e.g. from OnReset(). Don't call this at the same time as ProcessBlock() */
+  void SetSampleRate(double sampleRate);
+
+  /** Run the script on a block. Until a script has compiled, the inputs are copied to the outputs */
+  void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
+
+  /** Set a parameter value. This is lock-free and can be called from any thread, the script sees it at the start of the next block */
+  void SetParameterValue(int paramIdx, double nonNormalizedValue);
+
+  void SetParameterValueNormalised(int paramIdx, double normalizedValue);
+
+  /** Initialize the plug-in's parameters from the script's, and remember them so that they are initialized again when the script is recompiled
+   * @return The index of the first plug-in parameter, or -1 if the script has no parameters */
+  int CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx = 0, int endIdx = -1, bool setToDefault = true);
+
+  int NParams() const { return mNParams.load(std::memory_order_acquire); }
+
+private:
+  /** A parameter declared by a `sliderN:` line */
+  struct ParamInfo
+  {
+    std::string varName;
+    std::string label;
+    double defaultVal = 0.;
+    double minVal = 0.;
+    double maxVal = 1.;
+    double step = 0.;
+  };
+
+  /** A compiled script, with pointers to the variables of its VM */
+  struct Program
+  {
+    ~Program();
+
+    NSEEL_VMCTX vm = nullptr;
+    NSEEL_CODEHANDLE init = nullptr;
+    NSEEL_CODEHANDLE slider = nullptr;
+    NSEEL_CODEHANDLE block = nullptr;
+    NSEEL_CODEHANDLE sample = nullptr;
+    EEL_F* spl[MAX_BUS_CHANS] = {};
+    EEL_F* srate = nullptr;
+    EEL_F* samplesblock = nullptr;
+    EEL_F* numCh = nullptr;
+    EEL_F* params[EEL_MAX_PARAMS] = {};
+    int nParams = 0;
+    double sampleRate = 0.; // when @init was run
+  };
+
+  /** The range of a parameter, which SetParameterValue() reads to constrain the value, so that it doesn't touch the IParams that SetSourceCode() changes */
+  struct ParamRange
+  {
+    std::atomic<double> minVal {0.};
+    std::atomic<double> maxVal {1.};
+  };
+
+  /** Split a script into its parameter lines and sections
+   * @return \c false with an error message if the script can't be parsed */
+  static bool ParseScript(const std::string& code, std::vector<ParamInfo>& params, std::string sections[4], int sectionLines[4], std::string& error);
+
+  static bool ParseParamLine(const std::string& line, ParamInfo& param);
+
+  /** Compile a script and run its @init. Called on the background thread
+   * @return The program, or nullptr with an error message */
+  Program* Compile(const std::string& code, std::string& error);
+
+  /** Set the parameter variables of a program to the latest values and run @slider */
+  void ApplyParameterValues(Program& program);
+
+  void InitProgram(Program& program, double sampleRate);
+
+  void ThreadFunc();
+
+  void OnTimer(Timer& timer);
+
+  /** Free the program that the audio thread has replaced, if there is one. Called on the main thread */
+  void FreeRetiredProgram();
+
+  WDL_String mName;
+  int mNInChans;
+  int mNOutChans;
+  std::atomic<double> mSampleRate{44100.};
+
+  // parameters, changed by the main thread. mParams and mParamInfos are only used by the main thread, the ranges and values are preallocated,
+  // the values are written by any thread and read by the audio and compile threads
+  WDL_PtrList<IParam> mParams;
+  std::vector<ParamInfo> mParamInfos;
+  std::atomic<int> mNParams{0};
+  ParamRange mParamRanges[EEL_MAX_PARAMS];
+  std::atomic<double> mParamValues[EEL_MAX_PARAMS];
+  std::atomic<bool> mParamValuesChanged{true};
+  IPlugAPIBase* mPlug = nullptr;
+  int mIPlugParamStartIdx = -1;
+
+  // the programs, handed from the compile thread to the audio thread, and on to the main thread to be freed.
+  // The audio thread only picks up a pending program when the retired slot is empty, so it never has to free one
+  Program* mProgram = nullptr; // owned by the audio thread
+  std::atomic<Program*> mPendingProgram{nullptr};
+  std::atomic<Program*> mRetiredProgram{nullptr};
+
+  // the compile thread, which compiles the latest source code it has been given
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mCondition;
+  std::string mSourceCode;
+  uint64_t mSourceCodeVersion = 0;
+  uint64_t mCompiledVersion = 0;
+  bool mRunning = true;
+  std::function<void(bool success, const char* error)> mOnCompileFunc;
+
+  // auto recompile, and freeing the retired programs
+  WDL_String mFilePath;
+  time_t mFileTime = 0;
+  bool mAutoRecompile = false;
+  std::unique_ptr<Timer> mTimer;
+
+  static std::mutex sCompileMutex; // the compiler is not used by two threads at once
+};
+
+END_IPLUG_NAMESPACE
@@ -24,10 +24,8 @@ using namespace iplug;
 IPlugFaust::IPlugFaust(const char* name, int nVoices, int rate)
 : mNVoices(nVoices)
 {
-  if (rate > 1)
-  {
-    mOverSampler = std::make_unique<OverSampler<sample>>(OverSampler<sample>::RateToFactor(rate), true, 2 /* TODO: flexible channel count */);
-  }
+  // the over sampler is made by SetSampleRate(), once the channel counts of the DSP are known
+  mOverSamplingRate = rate;
 
   mName.Set(name);
 
@@ -43,16 +41,115 @@ void IPlugFaust::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
   {
     assert(mDSP->getSampleRate() != 0); // did you forget to call SetSampleRate?
 
-    if (mOverSampler)
-      mOverSampler->ProcessBlock(inputs, outputs, nFrames, 2, 2 /* TODO: flexible channel count */,
-        [&](sample** inputs, sample** outputs, int nFrames) //TODO:: badness capture = allocated
+    ApplyZoneValues();
+
+    if (!mNRampingZones)
+    {
+      ProcessFrames(inputs, outputs, nFrames);
+      return;
+    }
+
+    const int nInChans = mDSP->getNumInputs();
+    const int nOutChans = mDSP->getNumOutputs();
+    assert(nInChans <= MAX_BUS_CHANS && nOutChans <= MAX_BUS_CHANS);
+
+    // while zones are ramping, the block is processed in pieces with a step of the ramps before each
+    for (int s = 0; s < nFrames; s += FAUST_SMOOTHING_BLOCK)
+    {
+      sample* pInputs[MAX_BUS_CHANS];
+      sample* pOutputs[MAX_BUS_CHANS];
+
+      for (int c = 0; c < nInChans; c++)
+        pInputs[c] = inputs[c] + s;
+
+      for (int c = 0; c < nOutChans; c++)
+        pOutputs[c] = outputs[c] + s;
+
+      StepZoneRamps();
+      ProcessFrames(pInputs, pOutputs, std::min(FAUST_SMOOTHING_BLOCK, nFrames - s));
+    }
+  }
+  //    else silence?
+}
+
+void IPlugFaust::ProcessFrames(sample** inputs, sample** outputs, int nFrames)
+{
+  if (mVectorSize > 0)
+  {
+    assert(VectorBuffersMatch(*mDSP));
+    ProcessVectors(inputs, outputs, nFrames);
+  }
+  else
+    ProcessDSP(inputs, outputs, nFrames);
+}
+
+void IPlugFaust::ProcessDSP(sample** inputs, sample** outputs, int nFrames)
+{
+  if (mOverSampler)
+  {
+    const int nInChans = mDSP->getNumInputs();
+    const int nOutChans = mDSP->getNumOutputs();
+    const int blockSize = mOverSampler->GetBlockSize();
+    assert(OverSamplerMatches(*mDSP) && nInChans <= MAX_BUS_CHANS && nOutChans <= MAX_BUS_CHANS);
+
+    // the over sampler's buffers hold one block, so longer blocks are processed in pieces
+    for (int s = 0; s < nFrames; s += blockSize)
+    {
+      sample* pInputs[MAX_BUS_CHANS];
+      sample* pOutputs[MAX_BUS_CHANS];
+
+      for (int c = 0; c < nInChans; c++)
+        pInputs[c] = inputs[c] + s;
+
+      for (int c = 0; c < nOutChans; c++)
+        pOutputs[c] = outputs[c] + s;
+
+      mOverSampler->ProcessBlock(pInputs, pOutputs, std::min(blockSize, nFrames - s), nInChans, nOutChans,
+        [this](sample** inputs, sample** outputs, int nFrames)
         {
           mDSP->compute(nFrames, inputs, outputs);
         });
-    else
-      mDSP->compute(nFrames, inputs, outputs);
+    }
+  }
+  else
+    mDSP->compute(nFrames, inputs, outputs);
+}
+
+void IPlugFaust::ProcessVectors(sample** inputs, sample** outputs, int nFrames)
+{
+  const int nInChans = mDSP->getNumInputs();
+  const int nOutChans = mDSP->getNumOutputs();
+  assert(nInChans <= MAX_BUS_CHANS && nOutChans <= MAX_BUS_CHANS);
+
+  sample* pInputs[MAX_BUS_CHANS];
+  sample* pOutputs[MAX_BUS_CHANS];
+
+  for (int c = 0; c < nInChans; c++)
+    pInputs[c] = mVectorInputs.data() + c * mVectorSize;
+
+  for (int c = 0; c < nOutChans; c++)
+    pOutputs[c] = mVectorOutputs.data() + c * mVectorSize;
+
+  for (int s = 0; s < nFrames;)
+  {
+    const int n = std::min(nFrames - s, mVectorSize - mVectorPos);
+
+    // all the inputs are copied before any outputs are written, as the host may process in place
+    for (int c = 0; c < nInChans; c++)
+      memcpy(pInputs[c] + mVectorPos, inputs[c] + s, n * sizeof(sample));
+
+    for (int c = 0; c < nOutChans; c++)
+      memcpy(outputs[c] + s, pOutputs[c] + mVectorPos, n * sizeof(sample));
+
+    mVectorPos += n;
+    s += n;
+
+    if (mVectorPos == mVectorSize)
+    {
+      ProcessDSP(pInputs, pOutputs, mVectorSize);
+      mVectorPos = 0;
+    }
   }
-  //    else silence?
 }
 
 void IPlugFaust::SetParameterValueNormalised(int paramIdx, double normalizedValue)
@@ -66,7 +163,7 @@ void IPlugFaust::SetParameterValueNormalised(int paramIdx, double normalizedValu
     mParams.Get(paramIdx)->SetNormalized(normalizedValue);
 
     if (mZones.GetSize() == NParams())
-      *(mZones.Get(paramIdx)) = mParams.Get(paramIdx)->Value();
+      QueueZoneValue(paramIdx, mParams.Get(paramIdx)->Value());
     else
       DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetName());
   }
@@ -81,7 +178,7 @@ void IPlugFaust::SetParameterValue(int paramIdx, double nonNormalizedValue)
     mParams.Get(paramIdx)->Set(nonNormalizedValue);
 
     if (mZones.GetSize() == NParams())
-      *(mZones.Get(paramIdx)) = nonNormalizedValue;
+      QueueZoneValue(paramIdx, nonNormalizedValue);
     else
       DBGMSG("IPlugFaust-%s:: Missing zone for parameter %s\n", mName.Get(), mParams.Get(paramIdx)->GetName());
   }
@@ -96,11 +193,86 @@ void IPlugFaust::SetParameterValue(const char* labelToLookup, double nonNormaliz
   //    mParams.Get(paramIdx)->Set(nonNormalizedValue); // TODO: we are not updating the IPlug parameter
 
   if (dest)
-    *dest = nonNormalizedValue;
+    QueueZoneValue(mZones.Find(dest), nonNormalizedValue);
   else
     DBGMSG("IPlugFaust-%s:: No parameter named %s\n", mName.Get(), labelToLookup);
 }
 
+void IPlugFaust::QueueZoneValue(int paramIdx, double value)
+{
+  // a parameter added since BuildParameterMap() has no slot yet
+  if (paramIdx < 0 || paramIdx >= mNZoneValues)
+    return;
+
+  mZoneValues[paramIdx].value.store(value, std::memory_order_relaxed);
+  mZoneValues[paramIdx].pending.store(true, std::memory_order_release);
+  mZoneValuesPending.store(true, std::memory_order_release);
+}
+
+void IPlugFaust::ApplyZoneValues()
+{
+  if (!mZoneValuesPending.exchange(false, std::memory_order_acquire))
+    return;
+
+  // the ramps take whole steps of FAUST_SMOOTHING_BLOCK frames
+  const int nSteps = static_cast<int>(mSmoothingTimeMs * 0.001 * mSampleRate / FAUST_SMOOTHING_BLOCK);
+  const int nZones = std::min(mNZoneValues, mZones.GetSize());
+
+  for (auto p = 0; p < nZones; p++)
+  {
+    if (!mZoneValues[p].pending.exchange(false, std::memory_order_acquire))
+      continue;
+
+    const double value = mZoneValues[p].value.load(std::memory_order_relaxed);
+    ZoneRamp& ramp = mZoneRamps[p];
+
+    if (ramp.continuous && nSteps > 1)
+    {
+      if (!ramp.nSteps)
+      {
+        ramp.value = *mZones.Get(p);
+        mNRampingZones++;
+      }
+
+      ramp.target = value;
+      ramp.step = (value - ramp.value) / nSteps;
+      ramp.nSteps = nSteps;
+    }
+    else
+    {
+      if (ramp.nSteps)
+        mNRampingZones--;
+
+      ramp.nSteps = 0;
+      *mZones.Get(p) = static_cast<FAUSTFLOAT>(value);
+    }
+  }
+}
+
+void IPlugFaust::StepZoneRamps()
+{
+  const int nZones = std::min(static_cast<int>(mZoneRamps.size()), mZones.GetSize());
+
+  for (auto p = 0; p < nZones && mNRampingZones; p++)
+  {
+    ZoneRamp& ramp = mZoneRamps[p];
+
+    if (!ramp.nSteps)
+      continue;
+
+    // the last step lands on the target exactly
+    if (--ramp.nSteps)
+      ramp.value += ramp.step;
+    else
+    {
+      ramp.value = ramp.target;
+      mNRampingZones--;
+    }
+
+    *mZones.Get(p) = static_cast<FAUSTFLOAT>(ramp.value);
+  }
+}
+
 int IPlugFaust::CreateIPlugParameters(IPlugAPIBase* pPlug, int startIdx, int endIdx, bool setToDefault)
 {
   assert(pPlug != nullptr);
@@ -174,6 +346,21 @@ void IPlugFaust::BuildParameterMap()
     mMap.Insert(mParams.Get(p)->GetName(), mZones.Get(p)); // insert will overwrite keys with the same name
   }
 
+  // the slots for queued values, which only change size if the DSP has new parameters
+  if (mNZoneValues != NParams())
+  {
+    mZoneValues = std::make_unique<ZoneValue[]>(NParams());
+    mNZoneValues = NParams();
+  }
+
+  mZoneRamps.assign(NParams(), ZoneRamp());
+  mNRampingZones = 0;
+
+  for (auto p = 0; p < NParams(); p++)
+  {
+    mZoneRamps[p].continuous = mParams.Get(p)->Type() == IParam::kTypeDouble;
+  }
+
   if (mIPlugParamStartIdx > -1 && mPlug != nullptr) // if we've already linked parameters
   {
     CreateIPlugParameters(mPlug, mIPlugParamStartIdx);
@@ -204,4 +391,12 @@ void IPlugFaust::SyncFaustParams()
   {
     *mZones.Get(p) = mParams.Get(p)->Value();
   }
+
+  // the zones are at their values, so any ramps are finished
+  for (auto& ramp : mZoneRamps)
+  {
+    ramp.nSteps = 0;
+  }
+
+  mNRampingZones = 0;
 }
@@ -15,11 +15,14 @@
  * @copydoc IPlugFaust
  */
 
+#include <atomic>
 #include <memory>
+#include <vector>
 
 #define FAUSTCLASS_POLY mydsp_poly
 
 #define FAUST_UI_INTERVAL 100 //ms
+#define FAUST_SMOOTHING_BLOCK 16 // frames between the steps of smoothed zones, see IPlugFaust::SetSmoothingTime()
 
 #include "faust/dsp/poly-dsp.h"
 #include "faust/gui/UI.h"
@@ -68,6 +71,10 @@ public:
    * @param path The absolute path to process.svg for this instance. */
   virtual void GetDrawPath(WDL_String& path) {}
 
+  /** Create a new monophonic instance of the DSP, that is not the one this class processes, e.g. for FaustSynthVoice, which renders a DSP instance per voice of a MidiSynth
+   * @return The new DSP, which the caller takes ownership of, or \c nullptr if there is no DSP */
+  virtual ::dsp* CreateMonoDSP() { return nullptr; }
+
   /** Call this method from FaustGen in order to execute a shell command and compile the C++ code against the IPlugFaust_arch architecture file
    * There is a NO-OP implementation here so that when not using the JIT compiler, the same class can be used interchangeably
    * @return \c true on success */
@@ -85,31 +92,79 @@ public:
   
   void SetOverSamplingRate(int rate)
   {
+    mOverSamplingRate = rate;
+
     if(mOverSampler)
       mOverSampler->SetOverSampling(OverSampler<sample>::RateToFactor(rate));
   }
 
+  /** Process the DSP in fixed blocks of vectorSize frames, whatever size of blocks the host sends, so that DSP compiled in vector mode always runs on whole vectors.
+   * The input is buffered, which adds vectorSize frames of latency, see GetLatency(). This allocates, so call it on the main thread or in OnReset()
+   * @param vectorSize The number of frames in each block, see VectorSizeForBlockSize(), or 0 to process the host's blocks as they come */
+  virtual void SetVectorSize(int vectorSize)
+  {
+    mVectorSize = std::max(vectorSize, 0);
+
+    if (mDSP)
+      CreateVectorBuffers(*mDSP, mVectorInputs, mVectorOutputs);
+
+    mVectorPos = 0;
+  }
+
+  int GetVectorSize() const { return mVectorSize; }
+
+  /** @return The latency in frames added by SetVectorSize(), which the plug-in should include in the latency it reports with SetLatency() */
+  int GetLatency() const { return mVectorSize; }
+
+  /** @param blockSize The host's maximum block size
+   * @return The largest power of two vector size between 16 and 512 frames that is no longer than the block size, so that the added latency stays under one host block */
+  static int VectorSizeForBlockSize(int blockSize)
+  {
+    int vectorSize = 16;
+
+    while (vectorSize < 512 && vectorSize * 2 <= blockSize)
+      vectorSize *= 2;
+
+    return vectorSize;
+  }
+
   // Unique methods
+  /** Also makes the over sampler, when over sampling, and the buffers for SetVectorSize(), for the channel counts of the DSP, so call this after Init() */
   void SetSampleRate(double sampleRate)
   {
     int multiplier = 1;
     
-    if(mOverSampler)
-      multiplier = mOverSampler->GetRate();
-    
     if (mDSP) {
+      if (mOverSamplingRate > 1 && !OverSamplerMatches(*mDSP))
+        mOverSampler = CreateOverSampler(*mDSP);
+
+      CreateVectorBuffers(*mDSP, mVectorInputs, mVectorOutputs);
+      mVectorPos = 0;
+
+      if(mOverSampler)
+        multiplier = mOverSampler->GetRate();
+
       mDSP->init(((int) sampleRate) * multiplier);
       SyncFaustParams();
     }
+
+    mSampleRate = sampleRate;
   }
 
+  /** Smooth changes to continuous parameters (sliders) over a time, to avoid zipper noise when the DSP doesn't smooth them itself, e.g. with si.smoo.
+   * The zones are stepped every FAUST_SMOOTHING_BLOCK frames, so that the DSP still computes blocks of frames
+   * @param timeMs The smoothing time in milliseconds, or 0 to set the zones at the start of the next block */
+  void SetSmoothingTime(double timeMs) { mSmoothingTimeMs = timeMs; }
+
   void ProcessMidiMsg(const IMidiMsg& msg)
   {
     mMidiHandler->decodeMessage(msg);
   }
 
+  /** Process a block. The parameter values set since the last block are written to the FAUST zones first, see SetParameterValue() */
   virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
 
+  /** Set a parameter value. This is lock-free and can be called from any thread, including at the same time as ProcessBlock(), which writes the value to the FAUST zone at the start of the next block */
   void SetParameterValueNormalised(int paramIdx, double normalizedValue);
   
   void SetParameterValue(int paramIdx, double nonNormalizedValue);
@@ -180,8 +235,81 @@ protected:
   {
     GUI::updateAllGuis();
   }
+
+  /** @return \c true if there is an over sampler with the channel counts of the DSP */
+  bool OverSamplerMatches(::dsp& dsp) const
+  {
+    return mOverSampler && mOverSampler->GetNInChannels() == std::max(dsp.getNumInputs(), 1) && mOverSampler->GetNOutChannels() == std::max(dsp.getNumOutputs(), 1);
+  }
+
+  /** Make an over sampler at the over sampling rate for the channel counts of a DSP. This allocates, so it is called on the main thread */
+  std::unique_ptr<OverSampler<sample>> CreateOverSampler(::dsp& dsp) const
+  {
+    return std::make_unique<OverSampler<sample>>(OverSampler<sample>::RateToFactor(mOverSamplingRate), true, std::max(dsp.getNumInputs(), 1), std::max(dsp.getNumOutputs(), 1));
+  }
   
+  /** @return \c true if the buffers for SetVectorSize() hold a vector for each channel of a DSP */
+  bool VectorBuffersMatch(::dsp& dsp) const
+  {
+    return mVectorInputs.size() == static_cast<size_t>(dsp.getNumInputs() * mVectorSize) && mVectorOutputs.size() == static_cast<size_t>(dsp.getNumOutputs() * mVectorSize);
+  }
+
+  /** Size the buffers for SetVectorSize() for the channel counts of a DSP, and clear them. This allocates, so it is called on the main thread */
+  void CreateVectorBuffers(::dsp& dsp, std::vector<sample>& inputs, std::vector<sample>& outputs) const
+  {
+    inputs.assign(dsp.getNumInputs() * mVectorSize, 0.);
+    outputs.assign(dsp.getNumOutputs() * mVectorSize, 0.);
+  }
+
+  /** Queue a value for a zone, for ProcessBlock() to write */
+  void QueueZoneValue(int paramIdx, double value);
+
+  /** Write the values queued since the last block to the zones, or start ramping to them. Called at the start of ProcessBlock() */
+  void ApplyZoneValues();
+
+  /** Step the ramping zones once, see SetSmoothingTime() */
+  void StepZoneRamps();
+
+  /** Process a block in vectors, see SetVectorSize(), or else through ProcessDSP() */
+  void ProcessFrames(sample** inputs, sample** outputs, int nFrames);
+
+  /** Process a block with the over sampler, if there is one, or else straight through the DSP */
+  void ProcessDSP(sample** inputs, sample** outputs, int nFrames);
+
+  /** Process a block in vectors of mVectorSize frames, delaying the output by one vector */
+  void ProcessVectors(sample** inputs, sample** outputs, int nFrames);
+
   std::unique_ptr<OverSampler<sample>> mOverSampler;
+  int mOverSamplingRate = 1;
+  std::vector<sample> mVectorInputs; // the inputs collected for the next vector, see SetVectorSize()
+  std::vector<sample> mVectorOutputs; // the outputs of the previous vector
+  int mVectorSize = 0;
+  int mVectorPos = 0;
+
+  /** The latest value set for a zone. The value is written before the flag is raised, so a value is never applied without its flag */
+  struct ZoneValue
+  {
+    std::atomic<double> value{0.};
+    std::atomic<bool> pending{false};
+  };
+
+  /** A zone stepping towards a new value, see SetSmoothingTime() */
+  struct ZoneRamp
+  {
+    double value = 0.;
+    double target = 0.;
+    double step = 0.;
+    int nSteps = 0;
+    bool continuous = false;
+  };
+
+  std::unique_ptr<ZoneValue[]> mZoneValues; // one per parameter, sized by BuildParameterMap()
+  std::vector<ZoneRamp> mZoneRamps;
+  int mNZoneValues = 0;
+  std::atomic<bool> mZoneValuesPending{false};
+  int mNRampingZones = 0;
+  double mSmoothingTimeMs = 0.;
+  double mSampleRate = 0.;
   WDL_String mName;
   int mNVoices;
   std::unique_ptr<::dsp> mDSP;
@@ -12,6 +12,7 @@
 
 #include "IPlugFaustGen.h"
 #include "IPlugUtilities.h"
+#include "IPlugTraceZones.h"
 
 #include "faust/dsp/libfaust.h"
 #define LLVM_DSP
@@ -25,6 +26,35 @@ int FaustGen::Factory::sFactoryCounter = 0;
 bool FaustGen::sAutoRecompile = false;
 std::map<std::string, FaustGen::Factory *> FaustGen::Factory::sFactoryMap;
 Timer* FaustGen::sTimer = nullptr;
+int FaustGen::sTimerElapsed = 0;
+std::mutex FaustGen::sCompileCPPMutex;
+std::mutex FaustGen::Factory::sLibFaustMutex;
+std::string FaustGen::Factory::sMachineCodeCachePath;
+bool FaustGen::Factory::sMachineCodeCachePathSet = false;
+
+// creates each missing folder along the path
+static void CreateFolders(const char* path)
+{
+  WDL_String folder;
+
+  for (const char* p = path; ; p++)
+  {
+    if ((*p == '/' || *p == '\\' || *p == '\0') && p > path)
+    {
+      folder.Set(path, static_cast<int>(p - path));
+#ifdef OS_WIN
+      wchar_t utf16str[MAX_PATH];
+      UTF8ToUTF16(utf16str, folder.Get(), MAX_PATH);
+      CreateDirectoryW(utf16str, NULL);
+#else
+      mkdir(folder.Get(), S_IRWXU | S_IRWXG | S_IRWXO);
+#endif
+    }
+
+    if (*p == '\0')
+      break;
+  }
+}
 
 FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char* drawPath, const char* inputDSP)
 {
@@ -41,6 +71,15 @@ FaustGen::Factory::Factory(const char* name, const char* libraryPath, const char
 
 FaustGen::Factory::~Factory()
 {
+  if (mCompileThread.joinable())
+    mCompileThread.join();
+
+  if (mCompiledFactory)
+  {
+    std::lock_guard<std::mutex> lock(sLibFaustMutex);
+    deleteDSPFactory(mCompiledFactory);
+  }
+
   FreeDSPFactory();
   mSourceCodeStr.Set("");
   mBitCodeStr.Set("");
@@ -57,6 +96,7 @@ void FaustGen::Factory::FreeDSPFactory()
 
   if(mLLVMFactory)
   {
+    std::lock_guard<std::mutex> libFaustLock(sLibFaustMutex);
     deleteDSPFactory(mLLVMFactory); // this is commented in faustgen~
     mLLVMFactory = nullptr;
   }
@@ -87,17 +127,54 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
   SetDefaultCompileOptions();
   PrintCompileOptions();
 
-  // Prepare compile options
   std::string error;
+  llvm_dsp_factory* pFactory = CompileSourceCode(name.Get(), mSourceCodeStr.Get(), mCompileOptions, mOptimizationLevel, error);
+  
+  assert(pFactory != nullptr);
+
+  if (pFactory)
+  {
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->SetErrored(false);
+    }
+    
+    return pFactory;
+  }
+  else
+  {
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->SetErrored(true);
+    }
+
+    //WHAT IS THIS?
+//    if (mInstances.begin() != mInstances.end())
+//    {
+//      (*mInstances.begin())->hilight_error(error);
+//    }
+    DBGMSG("FaustGen-%s: Invalid Faust code or compile options : %s\n", mName.Get(), error.c_str());
+    return 0;
+  }
+}
+
+//static
+llvm_dsp_factory* FaustGen::Factory::CompileSourceCode(const std::string& name, const std::string& sourceCode, const std::vector<std::string>& options, int optimizationLevel, std::string& error)
+{
+  TRACE_ZONE("FaustGen compile");
+
+  // Prepare compile options
   const char* argv[64];
 
-  const int N = (int) mCompileOptions.size();
+  const int N = (int) options.size();
 
   assert(N < 64);
 
   for (auto i = 0; i< N; i++)
   {
-    argv[i] = mCompileOptions[i].c_str();
+    argv[i] = options[i].c_str();
   }
 
   // Generate SVG file // this shouldn't get called if we not making SVGs
@@ -108,38 +185,175 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
   argv[N] = 0; // NULL terminated argv
 
-  llvm_dsp_factory* pFactory = createDSPFactoryFromString(name.Get(), mSourceCodeStr.Get(), N, argv, GetLLVMArchStr(), error, mOptimizationLevel);
+  const std::string cacheFile = GetMachineCodeCacheFile(name, sourceCode, options, optimizationLevel);
+
+  std::lock_guard<std::mutex> lock(sLibFaustMutex);
+
+  if (cacheFile.length())
+  {
+    std::string cacheError;
+    llvm_dsp_factory* pCachedFactory = readDSPFactoryFromMachineFile(cacheFile, GetLLVMArchStr(), cacheError);
+
+    if (pCachedFactory)
+    {
+      DBGMSG("%s: Loaded machine code from %s\n", name.c_str(), cacheFile.c_str());
+      return pCachedFactory;
+    }
+  }
+
+  llvm_dsp_factory* pFactory = createDSPFactoryFromString(name, sourceCode, N, argv, GetLLVMArchStr(), error, optimizationLevel);
 
   if(error.length())
     DBGMSG("%s\n", error.c_str());
-  
-  assert(pFactory != nullptr);
+
+  if (pFactory && cacheFile.length())
+  {
+    if (!writeDSPFactoryToMachineFile(pFactory, cacheFile, GetLLVMArchStr()))
+      DBGMSG("%s: Could not write machine code to %s\n", name.c_str(), cacheFile.c_str());
+  }
+
+  return pFactory;
+}
+
+//static
+std::string FaustGen::Factory::GetMachineCodeCacheFile(const std::string& name, const std::string& sourceCode, const std::vector<std::string>& options, int optimizationLevel)
+{
+  if (!sMachineCodeCachePathSet)
+  {
+    WDL_String path;
+#if defined OS_MAC || defined OS_WIN
+    AppSupportPath(path);
+    path.Append(WDL_DIRCHAR_STR "iPlug2" WDL_DIRCHAR_STR "FaustGen");
+#else
+    const char* home = getenv("HOME");
+    if (home)
+      path.SetFormatted(MAX_WIN32_PATH_LEN, "%s/.cache/iPlug2/FaustGen", home);
+#endif
+    SetMachineCodeCachePath(path.Get());
+  }
+
+  if (sMachineCodeCachePath.empty())
+    return "";
+
+  // FNV-1a over every input to the compiler, each followed by a zero so that the boundaries count
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](const std::string& str) {
+    for (auto c : str)
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+
+    hash *= 1099511628211ull;
+  };
+
+  add(name);
+  add(sourceCode);
+  for (auto& option : options)
+    add(option);
+  add(std::to_string(optimizationLevel));
+  add(GetLLVMArchStr());
+  add(getDSPMachineTarget());
+  add(getCLibFaustVersion());
+  add(FAUSTGEN_VERSION);
+
+  char fileName[32];
+  snprintf(fileName, sizeof(fileName), "%016llx.fmc", static_cast<unsigned long long>(hash));
+
+  return sMachineCodeCachePath + WDL_DIRCHAR_STR + fileName;
+}
+
+//static
+void FaustGen::SetMachineCodeCachePath(const char* path)
+{
+  Factory::sMachineCodeCachePath = path ? path : "";
+  Factory::sMachineCodeCachePathSet = true;
+
+  if (Factory::sMachineCodeCachePath.length())
+    CreateFolders(path);
+}
+
+void FaustGen::Factory::CompileInBackground(bool compileCPP)
+{
+  // the previous result has to be swapped in first
+  if (mCompileThread.joinable())
+  {
+    mRecompilePending = true;
+    mRecompileCPPPending |= compileCPP;
+    return;
+  }
+
+  WDL_String name;
+  name.SetFormatted(64, "FaustGen-%d", mInstanceIdx);
+
+  SetDefaultCompileOptions();
+  PrintCompileOptions();
+
+  DBGMSG("FaustGen-%s: JIT compiling in the background\n", mName.Get());
+
+  // the thread gets copies of everything it needs, so that the main thread can carry on changing them
+  CPPBlockList blocks = compileCPP ? GetCPPBlocks() : CPPBlockList();
+
+  mCompileFinished = false;
+  mCompileThread = std::thread([this, factoryName = std::string(name.Get()), sourceCode = std::string(mSourceCodeStr.Get()), options = mCompileOptions, blocks]() {
+    TRACE_THREAD_NAME("FaustGen");
+    std::string error;
+    mCompiledFactory = CompileSourceCode(factoryName, sourceCode, options, mOptimizationLevel, error);
+
+    if (mCompiledFactory && blocks.size())
+    {
+      DBGMSG("FaustGen-%s: Statically compiling all FAUST blocks\n", mName.Get());
+      CompileCPP(blocks);
+    }
+
+    mCompileFinished = true;
+  });
+}
+
+void FaustGen::Factory::SwapCompiledDSP()
+{
+  if (!mCompileThread.joinable() || !mCompileFinished)
+    return;
+
+  mCompileThread.join();
+
+  llvm_dsp_factory* pFactory = mCompiledFactory;
+  mCompiledFactory = nullptr;
 
   if (pFactory)
   {
-    // Update all instances
-    for (auto inst : mInstances)
+    DBGMSG("FaustGen-%s: Background compilation succeeded, swapping DSP\n", mName.Get());
+
+    llvm_dsp_factory* pPreviousFactory = nullptr;
+
     {
-      inst->SetErrored(false);
+      WDL_MutexLock lock(&mDSPMutex);
+
+      pPreviousFactory = mLLVMFactory;
+      mLLVMFactory = pFactory;
+      mBitCodeStr.Set("");
+
+      for (auto inst : mInstances)
+      {
+        inst->SetErrored(false);
+        inst->SwapDSP();
+      }
+    }
+
+    // no instance uses the previous factory any more
+    if (pPreviousFactory)
+    {
+      std::lock_guard<std::mutex> lock(sLibFaustMutex);
+      deleteDSPFactory(pPreviousFactory);
     }
-    
-    return pFactory;
   }
   else
   {
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->SetErrored(true);
-    }
+    DBGMSG("FaustGen-%s: Invalid Faust code or compile options, keeping the previous DSP\n", mName.Get());
+  }
 
-    //WHAT IS THIS?
-//    if (mInstances.begin() != mInstances.end())
-//    {
-//      (*mInstances.begin())->hilight_error(error);
-//    }
-    DBGMSG("FaustGen-%s: Invalid Faust code or compile options : %s\n", mName.Get(), error.c_str());
-    return 0;
+  if (mRecompilePending)
+  {
+    const bool compileCPP = mRecompileCPPPending;
+    mRecompilePending = mRecompileCPPPending = false;
+    CompileInBackground(compileCPP);
   }
 }
 
@@ -205,7 +419,7 @@ llvm_dsp_factory *FaustGen::Factory::CreateFactoryFromSourceCode()
 
     // Otherwise creates default DSP keeping the same input/output number
   mSourceCodeStr.SetFormatted(256, maxInputs == 0 ? DEFAULT_SOURCE_CODE_FMT_STR_INSTRUMENT : DEFAULT_SOURCE_CODE_FMT_STR_FX, maxOutputs);
-  mLLVMFactory = createDSPFactoryFromString("default", mSourceCodeStr.Get(), 0, 0, GetLLVMArchStr(), error, 0);
+  mLLVMFactory = CompileSourceCode("default", mSourceCodeStr.Get(), {}, 0, error);
 
   pDSP = CreateDSPInstance(handler);
   DBGMSG("FaustGen-%s: Allocation of default DSP succeeded, %i input(s), %i output(s)\n", mName.Get(), pDSP->getNumInputs(), pDSP->getNumOutputs());
@@ -289,16 +503,13 @@ void FaustGen::Factory::SetDefaultCompileOptions()
     }
   }
 
-  // Vector mode by default
-  /*
-  AddCompileOption("-vec");
-  AddCompileOption("-lv");
-  AddCompileOption("1");
-  */
-  /*
-  Seems not necessary...
-  AddCompileOption("-vs", TOSTRING(GetBlockSize()));
-  */
+  // Vector mode, when the instances process fixed size vectors, see FaustGen::SetVectorSize()
+  if (mVectorSize > 0)
+  {
+    AddCompileOption("-vec");
+    AddCompileOption("-lv", "1");
+    AddCompileOption("-vs", std::to_string(mVectorSize).c_str());
+  }
 }
 
 void FaustGen::Factory::UpdateSourceCode(const char* str)
@@ -349,6 +560,24 @@ bool FaustGen::Factory::LoadFile(const char* file)
 {
   // Delete the existing Faust module
   //FreeDSPFactory();
+  if (ReadFile(file))
+  {
+    // Update all instances
+    for (auto inst : mInstances)
+    {
+      inst->Init();
+    }
+
+    return true;
+  }
+
+  assert(0 && "If you hit this assert it means the faust DSP file specificed in FAUST_BLOCK file was not found. This may be due to an invalid path or the macOS app sandbox.");
+
+  return false;
+}
+
+bool FaustGen::Factory::ReadFile(const char* file)
+{
   WDL_String fileStr(file);
 
   mBitCodeStr.Set("");
@@ -373,17 +602,9 @@ bool FaustGen::Factory::LoadFile(const char* file)
     
     mInputDSPFile.Set(file);
     
-    // Update all instances
-    for (auto inst : mInstances)
-    {
-      inst->Init();
-    }
-    
     return true;
   }
   
-  assert(0 && "If you hit this assert it means the faust DSP file specificed in FAUST_BLOCK file was not found. This may be due to an invalid path or the macOS app sandbox.");
-  
   return false;
 }
 
@@ -501,6 +722,92 @@ void FaustGen::Init()
     mMidiHandler->startMidi();
 }
 
+void FaustGen::SwapDSP()
+{
+  if (!mDSP)
+  {
+    Init();
+    return;
+  }
+
+  // the parameter values, to restore by name in the new DSP
+  std::map<std::string, double> values;
+  for (auto p = 0; p < NParams(); p++)
+  {
+    values[mParams.Get(p)->GetName()] = mParams.Get(p)->Value();
+  }
+
+  // build the new DSP while the old one keeps running
+  MidiHandlerPtr midiHandler = std::make_unique<iplug2_midi_handler>();
+  std::unique_ptr<MidiUI> midiUI = std::make_unique<MidiUI>(midiHandler.get());
+  std::unique_ptr<::dsp> dsp(mFactory->CreateDSPInstance(midiHandler));
+  assert(dsp);
+
+  dsp->buildUserInterface(midiUI.get());
+  dsp->init(mDSP->getSampleRate());
+
+  assert((dsp->getNumInputs() <= mMaxNInputs) && (dsp->getNumOutputs() <= mMaxNOutputs)); // don't have enough buffers to process the DSP
+  mFactory->mNInputs = dsp->getNumInputs();
+  mFactory->mNOutputs = dsp->getNumOutputs();
+
+  // a DSP with different channel counts needs a new over sampler
+  std::unique_ptr<OverSampler<sample>> overSampler;
+  if (mOverSampler && !OverSamplerMatches(*dsp))
+    overSampler = CreateOverSampler(*dsp);
+
+  std::vector<sample> vectorInputs, vectorOutputs;
+  const bool newVectorBuffers = !VectorBuffersMatch(*dsp);
+  if (newVectorBuffers)
+    CreateVectorBuffers(*dsp, vectorInputs, vectorOutputs);
+
+  {
+    WDL_MutexLock lock(&mMutex);
+
+    mDSP.swap(dsp);
+    mMidiHandler.swap(midiHandler);
+    mMidiUI.swap(midiUI);
+
+    if (overSampler)
+      mOverSampler.swap(overSampler);
+
+    if (newVectorBuffers)
+    {
+      mVectorInputs.swap(vectorInputs);
+      mVectorOutputs.swap(vectorOutputs);
+      mVectorPos = 0;
+    }
+
+    mZones.Empty(); // remove existing pointers to zones
+    mDSP->buildUserInterface(this);
+
+    for (auto p = 0; p < NParams(); p++)
+    {
+      auto it = values.find(mParams.Get(p)->GetName());
+      if (it != values.end())
+        mParams.Get(p)->Set(it->second);
+    }
+
+    SyncFaustParams();
+
+    mMap.DeleteAll(); // forget the zones of the previous DSP
+    BuildParameterMap(); // build a new map based on updated code
+  }
+
+  // the audio thread has let go of the previous DSP, so it can be deleted here
+  midiHandler->stopMidi();
+  midiUI = nullptr;
+  dsp = nullptr;
+  midiHandler = nullptr;
+
+  if(mPlug)
+    mPlug->OnParamReset(EParamSource::kRecompile);
+
+  if(mOnCompileFunc)
+    mOnCompileFunc();
+
+  mMidiHandler->startMidi();
+}
+
 void FaustGen::GetDrawPath(WDL_String& path)
 {
   assert(!CStringHasContents(mFactory->mDrawPath.Get()));
@@ -510,6 +817,28 @@ void FaustGen::GetDrawPath(WDL_String& path)
 
 bool FaustGen::CompileCPP()
 {
+  return CompileCPP(GetCPPBlocks());
+}
+
+//static
+FaustGen::CPPBlockList FaustGen::GetCPPBlocks()
+{
+  CPPBlockList blocks;
+
+  for (auto f : Factory::sFactoryMap)
+  {
+    blocks.emplace_back(f.second->mName.Get(), f.second->mInputDSPFile.Get());
+  }
+
+  return blocks;
+}
+
+//static
+bool FaustGen::CompileCPP(const CPPBlockList& blocks)
+{
+  // background compiles of different blocks write the same files
+  std::lock_guard<std::mutex> lock(sCompileCPPMutex);
+
 //#ifndef OS_WIN
   WDL_String archFile;
   archFile.Set(__FILE__);
@@ -520,14 +849,14 @@ bool FaustGen::CompileCPP()
   WDL_String inputFile;
   WDL_String outputFile;
 
-  for (auto f : Factory::sFactoryMap)
+  for (auto& block : blocks)
   {
-    inputFile = f.second->mInputDSPFile;
+    inputFile.Set(block.second.c_str());
     outputFile = inputFile;
     outputFile.remove_fileext();
     outputFile.AppendFormatted(1024, ".tmp");
     //-double
-    command.SetFormatted(1024, "%s -cn %s -i -a %s -o %s %s", FAUST_EXE, f.second->mName.Get(), archFile.Get(), outputFile.Get(), inputFile.Get());
+    command.SetFormatted(1024, "%s -cn %s -i -a %s -o %s %s", FAUST_EXE, block.first.c_str(), archFile.Get(), outputFile.Get(), inputFile.Get());
 
     DBGMSG("exec: %s\n", command.Get());
 
@@ -581,12 +910,22 @@ bool FaustGen::CompileCPP()
 
 void FaustGen::OnTimer(Timer& timer)
 {
-  WDL_String* pInputFile;
-  bool recompile = false;
+  // install the DSP of any background compile that has finished
+  for (auto f : Factory::sFactoryMap)
+  {
+    f.second->SwapCompiledDSP();
+  }
+
+  sTimerElapsed += FAUST_HOTSWAP_INTERVAL;
+
+  if (sTimerElapsed < FAUST_RECOMPILE_INTERVAL)
+    return;
+
+  sTimerElapsed = 0;
 
   for (auto f : Factory::sFactoryMap)
   {
-    pInputFile = &f.second->mInputDSPFile;
+    WDL_String* pInputFile = &f.second->mInputDSPFile;
     StatType buf;
     GetStat(pInputFile->Get(), &buf);
     StatTime oldTime = f.second->mPreviousTime;
@@ -594,35 +933,15 @@ void FaustGen::OnTimer(Timer& timer)
 
     if(!Equal(newTime, oldTime))
     {
-      WDL_MutexLock lock(&mMutex);
-
-      recompile = true;
-      f.second->FreeDSPFactory();
       DBGMSG("FaustGen-%s: File change detected ----------------------------------\n", mName.Get());
-      DBGMSG("FaustGen-%s: JIT compiling %s\n", mName.Get(), pInputFile->Get());
-      f.second->LoadFile(pInputFile->Get());
+
+      // the current DSP keeps running until the new one has compiled, then CPP is compiled for all blocks too
+      if (f.second->ReadFile(pInputFile->Get()))
+        f.second->CompileInBackground(true);
     }
       
     f.second->mPreviousTime = newTime;
   }
-
-  if(recompile)
-  {
-    // TODO: should check for successfull JIT
-    DBGMSG("FaustGen-%s: Statically compiling all FAUST blocks\n", mName.Get());
-    CompileCPP();
-    //WDL_String objFile;
-    //objFile.Set(pInputFile);
-    //objFile.remove_fileext();
-
-//#ifdef OS_WIN
-//    objFile.Append(".obj");
-//#else
-//    objFile.Append(".o");
-//#endif
-//
-//    CompileObjectFile(objFile.Get());
-  }
 }
 
 //static
@@ -631,7 +950,7 @@ void FaustGen::SetAutoRecompile(bool enable)
   if(enable)
   {
     if(sTimer == nullptr)
-      sTimer = Timer::Create(std::bind(&FaustGen::OnTimer, this, std::placeholders::_1), FAUST_RECOMPILE_INTERVAL);
+      sTimer = Timer::Create(std::bind(&FaustGen::OnTimer, this, std::placeholders::_1), FAUST_HOTSWAP_INTERVAL);
   }
   else
   {
@@ -645,6 +964,24 @@ void FaustGen::SetAutoRecompile(bool enable)
   sAutoRecompile = enable;
 }
 
+void FaustGen::SetVectorSize(int vectorSize)
+{
+  {
+    WDL_MutexLock lock(&mMutex);
+    IPlugFaust::SetVectorSize(vectorSize);
+  }
+
+  // the instances of a factory share its code, so the last vector size set is compiled
+  if (mFactory->mVectorSize != mVectorSize)
+  {
+    mFactory->mVectorSize = mVectorSize;
+
+    // without the timer the new code would never be swapped in, so it is compiled with the next change
+    if (mFactory->mLLVMFactory && sTimer)
+      mFactory->CompileInBackground(false);
+  }
+}
+
 void FaustGen::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
 {
   WDL_MutexLock lock(&mMutex);
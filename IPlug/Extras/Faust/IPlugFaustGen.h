@@ -21,9 +21,12 @@ using FaustGen = iplug::IPlugFaust; // not used, except for CompileCPP();
 
 #ifndef FAUST_COMPILED
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <set>
+#include <thread>
 #include <vector>
 #include <map>
 
@@ -82,6 +85,7 @@ static inline StatTime TimeZero() { return (StatTime) 0; }
 
 #define FAUST_CLASS_PREFIX "F"
 #define FAUST_RECOMPILE_INTERVAL 5000 //ms
+#define FAUST_HOTSWAP_INTERVAL 100 //ms, how often to check for background compiles that have finished
 
 #ifndef FAUST_EXE
   #if defined OS_MAC || defined OS_LINUX
@@ -138,6 +142,24 @@ class FaustGen : public IPlugFaust
       
     llvm_dsp_factory* CreateFactoryFromBitCode();
     llvm_dsp_factory* CreateFactoryFromSourceCode();
+
+    /** Compile source code with libfaust. This can be called on any thread
+     * @return The new factory, or nullptr if the code or options are invalid */
+    static llvm_dsp_factory* CompileSourceCode(const std::string& name, const std::string& sourceCode, const std::vector<std::string>& options, int optimizationLevel, std::string& error);
+
+    /** The machine code cache is content-addressed: the file name is a hash of everything that affects the compiled code, so a changed source or setting is a miss
+     * rather than a stale hit. Imported libraries are only covered through their paths and the libfaust version
+     * @return The path of the machine code cache file for this source code and these options, or an empty string if the cache is off, see FaustGen::SetMachineCodeCachePath() */
+    static std::string GetMachineCodeCacheFile(const std::string& name, const std::string& sourceCode, const std::vector<std::string>& options, int optimizationLevel);
+
+    /** Start JIT compiling the current source code on a background thread, while the instances keep running their current DSP. SwapCompiledDSP() installs the result.
+     * If a compile is already running, another one is started when it has been swapped in
+     * @param compileCPP \c true to also run CompileCPP() on the background thread once the JIT compile has succeeded */
+    void CompileInBackground(bool compileCPP);
+
+    /** Call this on the main thread. If a background compile has finished, hot-swap its DSP into each instance, see FaustGen::SwapDSP(), then free the previous LLVM factory.
+     * If it failed, the instances keep the DSP they have */
+    void SwapCompiledDSP();
     
     /** If DSP already exists will return it, otherwise create it
      * @return pointer to the DSP instance */
@@ -158,6 +180,11 @@ class FaustGen : public IPlugFaust
     void RemoveInstance(FaustGen* pDSP);
 
     bool LoadFile(const char* file);
+
+    /** Read the source code of a .dsp file without compiling it, see LoadFile()
+     * @return \c true on success */
+    bool ReadFile(const char* file);
+
     bool WriteToFile(const char* file);
     void SetCompileOptions(std::initializer_list<const char*> options);
 
@@ -204,11 +231,28 @@ class FaustGen : public IPlugFaust
     int mNInputs = 0;
     int mNOutputs = 0;
     int mOptimizationLevel = LLVM_OPTIMIZATION;
+    int mVectorSize = 0; // compiled with -vec -vs if this is not zero
     static int sFactoryCounter;
     static std::map<std::string, Factory*> sFactoryMap;
     WDL_String mInputDSPFile;
     StatTime mPreviousTime;
+
+    // background compilation, see CompileInBackground()
+    std::thread mCompileThread; // joinable from when a compile starts until its result is swapped in
+    std::atomic<bool> mCompileFinished{false};
+    llvm_dsp_factory* mCompiledFactory = nullptr; // written by the compile thread before it sets mCompileFinished
+    bool mRecompilePending = false;
+    bool mRecompileCPPPending = false;
+    static std::mutex sLibFaustMutex; // libfaust's factory table may not be used by two threads at once
+    static std::string sMachineCodeCachePath;
+    static bool sMachineCodeCachePathSet;
   };
+
+  /** The name and .dsp file of each FAUST block, for CompileCPP() */
+  using CPPBlockList = std::vector<std::pair<std::string, std::string>>;
+
+  static CPPBlockList GetCPPBlocks();
+  static bool CompileCPP(const CPPBlockList& blocks);
 public:
 
   FaustGen(const char* name, const char* inputDSPFile = 0, int nVoices = 1, int rate = 1,
@@ -234,6 +278,9 @@ public:
    * @param path The absolute path to process.svg for this instance. */
   void GetDrawPath(WDL_String& path) override;
 
+  /** Create a new monophonic instance of the JIT compiled DSP. Voices created this way are not hot-swapped when the FAUST file is recompiled, see FaustSynthVoice */
+  ::dsp* CreateMonoDSP() override { return mFactory && mFactory->mLLVMFactory ? mFactory->mLLVMFactory->createDSPInstance() : nullptr; }
+
   /** This is a static method that can be called to compile all .dsp files used to a single .hpp file, using the commandline FAUST compiler
    * @return \c true on success */
   static bool CompileCPP();
@@ -241,18 +288,35 @@ public:
   //bool CompileObjectFile(const char* fileName);
 
   void SetAutoRecompile(bool enable);
+
+  /** Set the folder where the machine code of compiled FAUST blocks is cached, so that the next session loads it in milliseconds instead of compiling again.
+   * By default it is an iPlug2/FaustGen folder in the user's application support folder (~/.cache on Linux). Call this before constructing any FaustGen
+   * @param path The folder, which is created if needed, or an empty string to turn the cache off */
+  static void SetMachineCodeCachePath(const char* path);
   
   void SetCompileFunc(std::function<void()> func) { mOnCompileFunc = func; }
   
   void OnTimer(Timer& timer);
   
+  /** As well as buffering fixed size vectors, see IPlugFaust::SetVectorSize(), compile the DSP in vector mode with -vec -lv 1 -vs vectorSize.
+   * If the DSP is already compiled it is compiled again in the background and hot-swapped, if auto recompile is on, otherwise the vector size is compiled with the next change.
+   * Each vector size is a different entry in the machine code cache, so hosts with different block sizes don't compile again */
+  void SetVectorSize(int vectorSize) override;
+
   void ProcessBlock(sample** inputs, sample** outputs, int nFrames) override;
   
   void SetErrored(bool errored) { mErrored = errored; }
+
+  /** Replace the DSP with a new instance from the factory's LLVM factory, keeping the values of the parameters whose names are unchanged.
+   * The new instance is built and initialised while the current one keeps running, the audio thread only waits for the pointers to be swapped,
+   * and the previous instance is deleted afterwards on the calling thread. Call this on the main thread */
+  void SwapDSP();
   
 private:
   Factory* mFactory = nullptr;
   static Timer* sTimer;
+  static int sTimerElapsed; // ms since the .dsp files were last checked for changes
+  static std::mutex sCompileCPPMutex;
   static int sFaustGenCounter;
   static bool sAutoRecompile;
   int mMaxNInputs = -1;
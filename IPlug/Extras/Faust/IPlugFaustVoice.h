@@ -0,0 +1,252 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc FaustSynthVoice
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "IPlugFaust.h"
+#include "MidiSynth.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A SynthVoice that renders a monophonic FAUST DSP, so that a MidiSynth's VoiceAllocator does the voice allocation and stealing instead of FAUST's own poly wrapper.
+ * Only busy voices are rendered, and as each voice has its own DSP instance and buffers they can be rendered on a worker pool, see MidiSynth::SetWorkerPool().
+ * As with FAUST's poly wrapper, the DSP is played through the controls labelled "freq", "gain" and "gate", and "key" and "vel" or "velocity" if it has them.
+ * The voice is busy from the trigger until it has been released and its output has fallen below kStopLevel.
+ * Use it with a FAUST block that has one voice, e.g. FAUST_BLOCK(Synth, mFaust, DSP_FILE, 1, 1), and AddVoices() */
+class FaustSynthVoice : public SynthVoice, public UI
+{
+public:
+  /** The peak level under which a released voice stops, about -66 dB, as in FAUST's poly wrapper */
+  static constexpr sample kStopLevel = 0.0005;
+
+  /** @param pDSP A monophonic DSP instance, which the voice takes ownership of, see IPlugFaust::CreateMonoDSP() */
+  FaustSynthVoice(::dsp* pDSP)
+  : mDSP(pDSP)
+  {
+    mDSP->buildUserInterface(this);
+  }
+
+  /** Add voices that each render a new instance of a FAUST block's DSP to a MidiSynth. Call this on the main thread after IPlugFaust::Init()
+   * @param synth The MidiSynth
+   * @param faust The FAUST block, e.g. a FaustGen
+   * @param nVoices The number of voices to add
+   * @param zone The zone of the voices, see MidiSynth::AddVoice() */
+  static void AddVoices(MidiSynth& synth, IPlugFaust& faust, int nVoices, uint8_t zone = 0)
+  {
+    for (auto v = 0; v < nVoices; v++)
+    {
+      ::dsp* pDSP = faust.CreateMonoDSP();
+      assert(pDSP);
+
+      if (pDSP)
+        synth.AddVoice(new FaustSynthVoice(pDSP), zone);
+    }
+  }
+
+  /** Set a FAUST parameter of all the FaustSynthVoices of a MidiSynth. This doesn't allocate, but the voices may be rendering, so call it between calls to MidiSynth::ProcessBlock()
+   * @param synth The MidiSynth
+   * @param label The label of the FAUST control
+   * @param value The non-normalized value */
+  static void SetParameterValue(MidiSynth& synth, const char* label, double value)
+  {
+    synth.ForEachVoice([label, value](SynthVoice& voice) {
+      if (auto* pVoice = dynamic_cast<FaustSynthVoice*>(&voice))
+        pVoice->SetParameterValue(label, value);
+    });
+  }
+
+  /** Set a FAUST parameter of this voice, and keep the value for when the sample rate changes
+   * @param label The label of the FAUST control
+   * @param value The non-normalized value */
+  void SetParameterValue(const char* label, double value)
+  {
+    auto it = mZones.find(label);
+
+    if (it != mZones.end())
+    {
+      *it->second.first = static_cast<FAUSTFLOAT>(value);
+      it->second.second = value;
+    }
+  }
+
+  bool GetBusy() const override { return mActive; }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    // a voice that is still sounding gets one frame with the gate closed, so that its envelopes start again
+    mGateEdgePending = mActive && !mReleased;
+
+    SetZone(mGainZone, level);
+    SetZone(mVelocityZone, level * 127.);
+    SetZone(mGateZone, 1.);
+    mActive = true;
+    mReleased = false;
+  }
+
+  void Release() override
+  {
+    SetZone(mGateZone, 0.);
+    mReleased = true;
+  }
+
+  double GetLevel() const override { return mPeak; }
+
+  void SetSampleRateAndBlockSize(double sampleRate, int blockSize) override
+  {
+    // init() resets the controls, so the parameters are set again
+    mDSP->init(static_cast<int>(sampleRate));
+
+    for (auto& zone : mZones)
+    {
+      *zone.second.first = static_cast<FAUSTFLOAT>(zone.second.second);
+    }
+
+    mBlockSize = std::max(blockSize, 1);
+    const int nChans = std::max(mDSP->getNumInputs(), mDSP->getNumOutputs());
+    mBuffers.assign((mDSP->getNumOutputs() + 1) * mBlockSize, 0.);
+    mInputPtrs.assign(nChans, nullptr);
+    mOutputPtrs.assign(nChans, nullptr);
+
+    for (auto c = 0; c < mDSP->getNumOutputs(); c++)
+    {
+      mOutputPtrs[c] = mBuffers.data() + (c + 1) * mBlockSize;
+    }
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    const int nDSPInputs = mDSP->getNumInputs();
+    const int nDSPOutputs = mDSP->getNumOutputs();
+
+    if (mBuffers.empty() || !nDSPOutputs)
+      return;
+
+    // convert from "1v/oct" pitch space to frequency in Hertz
+    SetZone(mFreqZone, 440. * std::pow(2., mInputs[kVoiceControlPitch].endValue + mInputs[kVoiceControlPitchBend].endValue));
+    SetZone(mKeyZone, mKey);
+
+    sample peak = 0.;
+
+    for (auto s = 0; s < nFrames;)
+    {
+      const bool gateEdge = mGateEdgePending;
+      const int n = gateEdge ? 1 : std::min(nFrames - s, mBlockSize);
+
+      if (gateEdge)
+        SetZone(mGateZone, 0.);
+
+      // DSP inputs that the synth has no input for read silence from the first buffer
+      for (auto c = 0; c < nDSPInputs; c++)
+      {
+        mInputPtrs[c] = c < nInputs ? inputs[c] + startIdx + s : mBuffers.data();
+      }
+
+      mDSP->compute(n, mInputPtrs.data(), mOutputPtrs.data());
+
+      if (gateEdge)
+      {
+        SetZone(mGateZone, 1.);
+        mGateEdgePending = false;
+      }
+
+      // a mono DSP is sent to all the outputs
+      for (auto c = 0; c < nOutputs; c++)
+      {
+        const sample* pVoiceOutput = mOutputPtrs[std::min(c, nDSPOutputs - 1)];
+        sample* pOutput = outputs[c] + startIdx + s;
+
+        for (auto i = 0; i < n; i++)
+        {
+          pOutput[i] += pVoiceOutput[i];
+          peak = std::max(peak, std::abs(pVoiceOutput[i]));
+        }
+      }
+
+      s += n;
+    }
+
+    mPeak = peak;
+
+    if (mReleased && peak < kStopLevel)
+      mActive = false;
+  }
+
+  // UI
+  void openTabBox(const char* label) override {}
+  void openHorizontalBox(const char* label) override {}
+  void openVerticalBox(const char* label) override {}
+  void closeBox() override {}
+
+  void addButton(const char* label, FAUSTFLOAT* zone) override { AddZone(label, zone, 0.); }
+  void addCheckButton(const char* label, FAUSTFLOAT* zone) override { AddZone(label, zone, 0.); }
+  void addVerticalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { AddZone(label, zone, init); }
+  void addHorizontalSlider(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { AddZone(label, zone, init); }
+  void addNumEntry(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init, FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) override { AddZone(label, zone, init); }
+
+  void addHorizontalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) override {}
+  void addVerticalBargraph(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT min, FAUSTFLOAT max) override {}
+  void addSoundfile(const char* label, const char* filename, Soundfile** sf_zone) override {}
+
+private:
+  void AddZone(const char* label, FAUSTFLOAT* zone, FAUSTFLOAT init)
+  {
+    const std::string name(label);
+
+    // the controls that the voice plays are not parameters
+    if (name == "freq")
+      mFreqZone = zone;
+    else if (name == "gain")
+      mGainZone = zone;
+    else if (name == "gate")
+      mGateZone = zone;
+    else if (name == "key")
+      mKeyZone = zone;
+    else if (name == "vel" || name == "velocity")
+      mVelocityZone = zone;
+    else
+      mZones[name] = {zone, init};
+  }
+
+  static void SetZone(FAUSTFLOAT* zone, double value)
+  {
+    if (zone)
+      *zone = static_cast<FAUSTFLOAT>(value);
+  }
+
+  std::unique_ptr<::dsp> mDSP;
+  std::map<std::string, std::pair<FAUSTFLOAT*, double>> mZones; // the zone and value of each parameter, by label
+  FAUSTFLOAT* mFreqZone = nullptr;
+  FAUSTFLOAT* mGainZone = nullptr;
+  FAUSTFLOAT* mGateZone = nullptr;
+  FAUSTFLOAT* mKeyZone = nullptr;
+  FAUSTFLOAT* mVelocityZone = nullptr;
+  std::vector<sample> mBuffers; // silence for missing inputs, then an output buffer for each DSP output
+  std::vector<sample*> mInputPtrs;
+  std::vector<sample*> mOutputPtrs;
+  int mBlockSize = 0;
+  sample mPeak = 0.;
+  bool mActive = false;
+  bool mReleased = true;
+  bool mGateEdgePending = false;
+};
+
+END_IPLUG_NAMESPACE
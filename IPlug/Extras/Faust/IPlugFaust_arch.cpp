@@ -53,6 +53,11 @@ public:
     
     mInitialized = true;
   }
+
+  ::dsp* CreateMonoDSP() override
+  {
+    return new FAUSTCLASS();
+  }
 };
 
 #undef FAUSTCLASS
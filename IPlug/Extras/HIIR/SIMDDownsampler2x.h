@@ -0,0 +1,112 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/*
+SIMDDownsampler2x.h
+
+Downsamples by a factor 2 several channels at once, with one lane of a SIMD vector per channel,
+see SIMDStageProc.h. The output is the same as that of a Downsampler2xFPU per channel.
+
+Template parameters:
+- NC: number of coefficients, > 0
+- T: float or double
+- NCHANS: the maximum number of channels, the width of the vector
+*/
+
+#pragma once
+
+#include <cassert>
+#include "SIMDStageProc.h"
+
+namespace hiir
+{
+
+template <int NC, typename T, int NCHANS = SIMDWidth <T>::VALUE>
+class Downsampler2xSIMD
+{
+public:
+
+  enum { NBR_COEFS = NC };
+  enum { NBR_CHANS = NCHANS };
+
+  Downsampler2xSIMD ()
+  {
+    _coef.fill (Vec::zero ());
+    clear_buffers ();
+  }
+
+  /*
+  Name: set_coefs
+  Description:
+    Sets the filter coefficients of all the channels, as Downsampler2xFPU::set_coefs()
+  */
+  void set_coefs (const double coef_arr [])
+  {
+    assert (coef_arr != 0);
+
+    for (int i = 0; i < NBR_COEFS; ++i)
+    {
+      _coef [i] = Vec::set1 (static_cast <T> (coef_arr [i]));
+    }
+  }
+
+  /*
+  Name: process_block
+  Description:
+    Downsamples (x2) a block of samples of each channel.
+  Input parameters:
+    - in_ptrs: Input arrays, one per channel, containing nbr_spl * 2 samples.
+    - nbr_spl: Number of samples to output, > 0
+    - nbr_chans: Number of channels, from 1 to NBR_CHANS
+  Output parameters:
+    - out_ptrs: Arrays for the output samples, one per channel, capacity: nbr_spl samples.
+  */
+  void process_block (T* const out_ptrs [], const T* const in_ptrs [], long nbr_spl, int nbr_chans)
+  {
+    assert (nbr_chans > 0 && nbr_chans <= NBR_CHANS);
+    assert (nbr_spl > 0);
+
+    const Vec half = Vec::set1 (static_cast <T> (0.5));
+
+    for (long pos = 0; pos < nbr_spl; ++pos)
+    {
+      Vec spl_0 = Stage::gather (in_ptrs, pos * 2 + 1, nbr_chans);
+      Vec spl_1 = Stage::gather (in_ptrs, pos * 2, nbr_chans);
+      Stage::process_sample_pos (spl_0, spl_1, &_coef [0], &_x [0], &_y [0]);
+      Stage::scatter (half * (spl_0 + spl_1), out_ptrs, pos, nbr_chans);
+    }
+  }
+
+  /*
+  Name: clear_buffers
+  Description:
+    Clears filter memory of all the channels.
+  */
+  void clear_buffers ()
+  {
+    _x.fill (Vec::zero ());
+    _y.fill (Vec::zero ());
+  }
+
+private:
+  using Vec = SIMDVector <T, NCHANS>;
+  using Stage = StageProcSIMD <NBR_COEFS, Vec>;
+
+  std::array <Vec, NBR_COEFS> _coef;
+  std::array <Vec, NBR_COEFS> _x;
+  std::array <Vec, NBR_COEFS> _y;
+
+private:
+  bool operator == (const Downsampler2xSIMD &other);
+  bool operator != (const Downsampler2xSIMD &other);
+
+};  // class Downsampler2xSIMD
+
+} // namespace hiir
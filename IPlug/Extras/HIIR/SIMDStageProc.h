@@ -0,0 +1,275 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/*
+SIMDStageProc.h
+
+The all-pass stages of the hiir polyphase filters, for several channels at once: each lane of a
+vector is the same stage of a different channel, so the stages are computed as in StageProcFPU,
+with one vector operation for all the channels.
+
+The widest vector the build targets is used: AVX (8 floats or 4 doubles), SSE2 (4 floats or
+2 doubles), NEON (4 floats, or 2 doubles on AArch64) or WebAssembly SIMD128 (4 floats or
+2 doubles). Without any of these, the vector is a plain array that the compiler may vectorize.
+*/
+
+#pragma once
+
+#include <array>
+
+#if defined(__AVX__)
+  #include <immintrin.h>
+  #define HIIR_SIMD_AVX 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define HIIR_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+  #include <arm_neon.h>
+  #define HIIR_SIMD_NEON 1
+  #if defined(__aarch64__) || defined(_M_ARM64)
+    #define HIIR_SIMD_NEON64 1
+  #endif
+#elif defined(__wasm_simd128__)
+  #include <wasm_simd128.h>
+  #define HIIR_SIMD_WASM 1
+#endif
+
+namespace hiir
+{
+
+/* A vector of N samples, one per channel. This generic version is a plain array */
+template <typename T, int N>
+struct SIMDVector
+{
+  enum { NBR_LANES = N };
+
+  static SIMDVector zero () { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = 0; return r; }
+  static SIMDVector set1 (T x) { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = x; return r; }
+  static SIMDVector load (const T* ptr) { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = ptr [i]; return r; }
+  void store (T* ptr) const { for (int i = 0; i < N; ++i) ptr [i] = v [i]; }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = a.v [i] + b.v [i]; return r; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = a.v [i] - b.v [i]; return r; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { SIMDVector r; for (int i = 0; i < N; ++i) r.v [i] = a.v [i] * b.v [i]; return r; }
+
+  T v [N];
+};
+
+#if defined(HIIR_SIMD_AVX)
+template <>
+struct SIMDVector <float, 8>
+{
+  enum { NBR_LANES = 8 };
+
+  static SIMDVector zero () { return { _mm256_setzero_ps () }; }
+  static SIMDVector set1 (float x) { return { _mm256_set1_ps (x) }; }
+  static SIMDVector load (const float* ptr) { return { _mm256_loadu_ps (ptr) }; }
+  void store (float* ptr) const { _mm256_storeu_ps (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { _mm256_add_ps (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { _mm256_sub_ps (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { _mm256_mul_ps (a.v, b.v) }; }
+
+  __m256 v;
+};
+
+template <>
+struct SIMDVector <double, 4>
+{
+  enum { NBR_LANES = 4 };
+
+  static SIMDVector zero () { return { _mm256_setzero_pd () }; }
+  static SIMDVector set1 (double x) { return { _mm256_set1_pd (x) }; }
+  static SIMDVector load (const double* ptr) { return { _mm256_loadu_pd (ptr) }; }
+  void store (double* ptr) const { _mm256_storeu_pd (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { _mm256_add_pd (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { _mm256_sub_pd (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { _mm256_mul_pd (a.v, b.v) }; }
+
+  __m256d v;
+};
+#endif
+
+#if defined(HIIR_SIMD_SSE2)
+template <>
+struct SIMDVector <float, 4>
+{
+  enum { NBR_LANES = 4 };
+
+  static SIMDVector zero () { return { _mm_setzero_ps () }; }
+  static SIMDVector set1 (float x) { return { _mm_set1_ps (x) }; }
+  static SIMDVector load (const float* ptr) { return { _mm_loadu_ps (ptr) }; }
+  void store (float* ptr) const { _mm_storeu_ps (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { _mm_add_ps (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { _mm_sub_ps (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { _mm_mul_ps (a.v, b.v) }; }
+
+  __m128 v;
+};
+
+template <>
+struct SIMDVector <double, 2>
+{
+  enum { NBR_LANES = 2 };
+
+  static SIMDVector zero () { return { _mm_setzero_pd () }; }
+  static SIMDVector set1 (double x) { return { _mm_set1_pd (x) }; }
+  static SIMDVector load (const double* ptr) { return { _mm_loadu_pd (ptr) }; }
+  void store (double* ptr) const { _mm_storeu_pd (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { _mm_add_pd (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { _mm_sub_pd (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { _mm_mul_pd (a.v, b.v) }; }
+
+  __m128d v;
+};
+#elif defined(HIIR_SIMD_NEON)
+template <>
+struct SIMDVector <float, 4>
+{
+  enum { NBR_LANES = 4 };
+
+  static SIMDVector zero () { return { vdupq_n_f32 (0.f) }; }
+  static SIMDVector set1 (float x) { return { vdupq_n_f32 (x) }; }
+  static SIMDVector load (const float* ptr) { return { vld1q_f32 (ptr) }; }
+  void store (float* ptr) const { vst1q_f32 (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { vaddq_f32 (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { vsubq_f32 (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { vmulq_f32 (a.v, b.v) }; }
+
+  float32x4_t v;
+};
+
+#if defined(HIIR_SIMD_NEON64)
+template <>
+struct SIMDVector <double, 2>
+{
+  enum { NBR_LANES = 2 };
+
+  static SIMDVector zero () { return { vdupq_n_f64 (0.) }; }
+  static SIMDVector set1 (double x) { return { vdupq_n_f64 (x) }; }
+  static SIMDVector load (const double* ptr) { return { vld1q_f64 (ptr) }; }
+  void store (double* ptr) const { vst1q_f64 (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { vaddq_f64 (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { vsubq_f64 (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { vmulq_f64 (a.v, b.v) }; }
+
+  float64x2_t v;
+};
+#endif
+#elif defined(HIIR_SIMD_WASM)
+template <>
+struct SIMDVector <float, 4>
+{
+  enum { NBR_LANES = 4 };
+
+  static SIMDVector zero () { return { wasm_f32x4_splat (0.f) }; }
+  static SIMDVector set1 (float x) { return { wasm_f32x4_splat (x) }; }
+  static SIMDVector load (const float* ptr) { return { wasm_v128_load (ptr) }; }
+  void store (float* ptr) const { wasm_v128_store (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { wasm_f32x4_add (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { wasm_f32x4_sub (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { wasm_f32x4_mul (a.v, b.v) }; }
+
+  v128_t v;
+};
+
+template <>
+struct SIMDVector <double, 2>
+{
+  enum { NBR_LANES = 2 };
+
+  static SIMDVector zero () { return { wasm_f64x2_splat (0.) }; }
+  static SIMDVector set1 (double x) { return { wasm_f64x2_splat (x) }; }
+  static SIMDVector load (const double* ptr) { return { wasm_v128_load (ptr) }; }
+  void store (double* ptr) const { wasm_v128_store (ptr, v); }
+
+  friend SIMDVector operator + (const SIMDVector& a, const SIMDVector& b) { return { wasm_f64x2_add (a.v, b.v) }; }
+  friend SIMDVector operator - (const SIMDVector& a, const SIMDVector& b) { return { wasm_f64x2_sub (a.v, b.v) }; }
+  friend SIMDVector operator * (const SIMDVector& a, const SIMDVector& b) { return { wasm_f64x2_mul (a.v, b.v) }; }
+
+  v128_t v;
+};
+#endif
+
+/* The number of channels in the widest vector of T that the build targets */
+template <typename T>
+struct SIMDWidth
+{
+#if defined(HIIR_SIMD_AVX)
+  enum { VALUE = 32 / sizeof (T) };
+#else
+  enum { VALUE = 16 / sizeof (T) };
+#endif
+};
+
+template <int NC, typename V>
+class StageProcSIMD
+{
+public:
+  /* As StageProcFPU::process_sample_pos(), for all the channels of the vectors */
+  static inline void process_sample_pos (V &spl_0, V &spl_1, const V coef [], V x [], V y [])
+  {
+    for (int i = 0; i < NC; i += 2)
+    {
+      const V temp_0 = (spl_0 - y [i]) * coef [i] + x [i];
+      x [i] = spl_0;
+      y [i] = temp_0;
+      spl_0 = temp_0;
+
+      if (i + 1 < NC)
+      {
+        const V temp_1 = (spl_1 - y [i + 1]) * coef [i + 1] + x [i + 1];
+        x [i + 1] = spl_1;
+        y [i + 1] = temp_1;
+        spl_1 = temp_1;
+      }
+    }
+  }
+
+  /* Gather sample pos of nbr_chans channels into a vector, the other lanes are zero */
+  template <typename T>
+  static inline V gather (const T* const ptrs [], long pos, int nbr_chans)
+  {
+    alignas (32) T tmp [V::NBR_LANES] = {};
+
+    for (int c = 0; c < nbr_chans; ++c)
+    {
+      tmp [c] = ptrs [c] [pos];
+    }
+
+    return V::load (tmp);
+  }
+
+  /* Scatter the first nbr_chans lanes of a vector to sample pos of the channels */
+  template <typename T>
+  static inline void scatter (const V& vec, T* const ptrs [], long pos, int nbr_chans)
+  {
+    alignas (32) T tmp [V::NBR_LANES];
+    vec.store (tmp);
+
+    for (int c = 0; c < nbr_chans; ++c)
+    {
+      ptrs [c] [pos] = tmp [c];
+    }
+  }
+
+private:
+  StageProcSIMD ();
+};
+
+} // namespace hiir
@@ -0,0 +1,368 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ISpectrumSender
+ */
+
+#include <atomic>
+#include <cmath>
+#include <initializer_list>
+#include <vector>
+
+#include "fft.h"
+
+#include "ISender.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** ISpectrumSender is a utility class which can be used to send the spectrum of the audio to the GUI, e.g. to an IVSpectrumControl.
+ * The audio thread only copies the samples into a lock-free queue. TransmitData(), called from the plug-in's idle timer like the other senders, does the windowed FFTs
+ * on the queued samples, bins the magnitudes on a logarithmic frequency scale and sends the binned spectra to the GUI. The values sent are in dB, relative to a full scale sine wave.
+ * Your project must compile WDL/fft.c
+ * @tparam MAXNC The maximum number of channels
+ * @tparam QUEUE_SIZE The number of spectra the queue to the GUI can hold
+ * @tparam MAXBINS The maximum number of logarithmically spaced frequency bins in each spectrum
+ * @tparam MAXFFTSIZE The maximum FFT size, a power of two */
+template <int MAXNC = 1, int QUEUE_SIZE = 64, int MAXBINS = 256, int MAXFFTSIZE = 8192>
+class ISpectrumSender : public ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBINS>>
+{
+  static_assert((MAXFFTSIZE & (MAXFFTSIZE - 1)) == 0 && MAXFFTSIZE >= 16 && MAXFFTSIZE <= 32768, "MAXFFTSIZE must be a power of two between 16 and 32768");
+
+  using TSender = ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBINS>>;
+
+public:
+  static constexpr float kMinDB = -200.f;
+
+  /** @param fftSize The FFT size, a power of two up to MAXFFTSIZE
+   * @param nBins The number of frequency bins to send, up to MAXBINS
+   * @param minFreq The centre frequency of the lowest bin in Hz
+   * @param maxFreq The centre frequency of the highest bin in Hz
+   * @param overlap The number of FFTs per FFT size of audio */
+  ISpectrumSender(int fftSize = 2048, int nBins = MAXBINS, float minFreq = 20.f, float maxFreq = 20000.f, int overlap = 2)
+  : mSampleQueue(4 * MAXFFTSIZE * MAXNC * sizeof(float))
+  {
+    mStaging.Resize(kMaxChunkSize);
+    mChunkBuffer.Resize(kMaxChunkSize);
+    WDL_fft_init();
+    SetFFTSize(fftSize);
+    SetNBins(nBins);
+    SetFrequencyRange(minFreq, maxFreq);
+    SetOverlap(overlap);
+  }
+
+  ISpectrumSender(const ISpectrumSender&) = delete;
+  ISpectrumSender& operator=(const ISpectrumSender&) = delete;
+
+  /** Call this in OnReset() */
+  void Reset(double sampleRate)
+  {
+    mSampleRate = sampleRate;
+    mConfigChanged = true;
+  }
+
+  /** @param fftSize The FFT size, a power of two up to MAXFFTSIZE. Larger sizes give more resolution at low frequencies, but respond more slowly */
+  void SetFFTSize(int fftSize)
+  {
+    assert(fftSize >= 16 && fftSize <= MAXFFTSIZE && (fftSize & (fftSize - 1)) == 0);
+    mFFTSize = Clip(fftSize, 16, MAXFFTSIZE);
+    mConfigChanged = true;
+  }
+
+  /** @param nBins The number of frequency bins to send, up to MAXBINS */
+  void SetNBins(int nBins)
+  {
+    assert(nBins > 1 && nBins <= MAXBINS);
+    mNBins = Clip(nBins, 2, MAXBINS);
+    mConfigChanged = true;
+  }
+
+  /** @param minFreq The centre frequency of the lowest bin in Hz
+   * @param maxFreq The centre frequency of the highest bin in Hz */
+  void SetFrequencyRange(float minFreq, float maxFreq)
+  {
+    assert(minFreq > 0.f && maxFreq > minFreq);
+    mMinFreq = minFreq;
+    mMaxFreq = maxFreq;
+    mConfigChanged = true;
+  }
+
+  /** @param overlap The number of FFTs per FFT size of audio, e.g. 2 for 50% overlap */
+  void SetOverlap(int overlap)
+  {
+    mOverlap = std::max(overlap, 1);
+    mConfigChanged = true;
+  }
+
+  int GetNBins() const { return mNBins; }
+
+  /** Analyses the queued samples and sends the spectra to controls.
+   *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
+  void TransmitData(IEditorDelegate& dlg)
+  {
+    AnalyseQueuedSamples();
+    TSender::TransmitData(dlg);
+  }
+
+  /** This variation can be used if you need to supply multiple controls with the same spectra, overriding the tags in the data packet
+   @param dlg The editor delegate
+   @param ctrlTags A list of control tags that should receive the updates from this sender */
+  void TransmitDataToControlsWithTags(IEditorDelegate& dlg, const std::initializer_list<int>& ctrlTags)
+  {
+    AnalyseQueuedSamples();
+    TSender::TransmitDataToControlsWithTags(dlg, ctrlTags);
+  }
+
+  /** Queue sample buffers to be analysed. This can be called on the realtime audio thread.
+   @param inputs the sample buffers to analyze
+   @param nFrames the number of sample frames in the input buffers
+   @param ctrlTag a control tag to indicate which control to send the spectra to. Note: if you don't supply the control tag here, you must use TransmitDataToControlsWithTags() and specify one or more tags there
+   @param nChans the number of channels of data that should be sent
+   @param chanOffset the starting channel */
+  void ProcessBlock(sample** inputs, int nFrames, int ctrlTag = kNoTag, int nChans = MAXNC, int chanOffset = 0)
+  {
+    assert(chanOffset >= 0 && chanOffset + nChans <= MAXNC);
+
+    // queued in chunks, so that a large block can't need more space than the queue has
+    for (auto s = 0; s < nFrames; s += kMaxChunkFrames)
+    {
+      const int chunkFrames = std::min(nFrames - s, kMaxChunkFrames);
+      const size_t chunkSize = sizeof(ChunkHeader) + nChans * chunkFrames * sizeof(float);
+
+      if (mSampleQueue.SpaceAvailable() < chunkSize) // TransmitData() isn't being called, drop the audio
+        return;
+
+      const ChunkHeader header {ctrlTag, nChans, chanOffset, chunkFrames};
+      memcpy(mStaging.Get(), &header, sizeof(ChunkHeader));
+      float* pSamples = reinterpret_cast<float*>(mStaging.Get() + sizeof(ChunkHeader));
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        const sample* pInput = inputs[chanOffset + c] + s;
+
+        for (auto i = 0; i < chunkFrames; i++)
+          pSamples[c * chunkFrames + i] = static_cast<float>(pInput[i]);
+      }
+
+      // pushed in one go, so that AnalyseQueuedSamples() never sees part of a chunk
+      mSampleQueue.PushN(mStaging.Get(), chunkSize);
+    }
+  }
+
+private:
+  static constexpr int kMaxChunkFrames = 512;
+
+  struct ChunkHeader
+  {
+    int ctrlTag;
+    int nChans;
+    int chanOffset;
+    int nFrames;
+  };
+
+  static constexpr int kMaxChunkSize = sizeof(ChunkHeader) + MAXNC * kMaxChunkFrames * sizeof(float);
+
+  /** Maps a logarithmically spaced output bin onto the FFT bins */
+  struct BinRange
+  {
+    int start; // first FFT bin
+    int end; // last FFT bin + 1
+    float pos; // the bin's centre frequency as a fractional FFT bin, used when the range has no FFT bins
+  };
+
+  /** Do the FFTs on the samples queued by ProcessBlock(), on the main thread */
+  void AnalyseQueuedSamples()
+  {
+    if (mConfigChanged.exchange(false))
+      Configure();
+
+    while (mSampleQueue.ElementsAvailable() >= sizeof(ChunkHeader))
+    {
+      ChunkHeader header;
+      mSampleQueue.PopN(reinterpret_cast<uint8_t*>(&header), sizeof(ChunkHeader));
+      mSampleQueue.PopN(mChunkBuffer.Get(), header.nChans * header.nFrames * sizeof(float));
+      AddSamples(header, reinterpret_cast<const float*>(mChunkBuffer.Get()));
+    }
+  }
+
+  /** Allocate the buffers and calculate the window and bin mapping for the current settings, on the main thread */
+  void Configure()
+  {
+    const int fftSize = mFFTSize;
+    const int nBins = mNBins;
+    const double sampleRate = mSampleRate;
+    const float nyquist = static_cast<float>(sampleRate * 0.5);
+    const float minFreq = std::min(mMinFreq.load(), nyquist);
+    const float maxFreq = std::min(mMaxFreq.load(), nyquist);
+
+    mConfiguredFFTSize = fftSize;
+    mConfiguredNBins = nBins;
+    mHopSize = std::max(fftSize / mOverlap, 1);
+    mFill.fill(0);
+
+    for (auto& input : mInputs)
+      input.assign(fftSize, 0.f);
+
+    mFFTBuffer.resize(fftSize);
+    mMagnitudes.resize(fftSize / 2 + 1);
+
+    // Hann window, scaled so that a full scale sine gives a magnitude of 1
+    mWindow.resize(fftSize);
+    double windowSum = 0.;
+
+    for (auto i = 0; i < fftSize; i++)
+    {
+      mWindow[i] = static_cast<float>(0.5 - 0.5 * std::cos(2. * PI * i / fftSize));
+      windowSum += mWindow[i];
+    }
+
+    // WDL_real_fft() returns twice the DFT
+    for (auto& w : mWindow)
+      w *= static_cast<float>(1. / windowSum);
+
+    // each output bin covers the FFT bins between the geometric midpoints to its neighbours
+    mBinRanges.resize(nBins);
+    const float binWidth = static_cast<float>(sampleRate / fftSize);
+    const float ratio = std::pow(maxFreq / minFreq, 1.f / (nBins - 1));
+    const float edgeRatio = std::sqrt(ratio);
+
+    for (auto b = 0; b < nBins; b++)
+    {
+      const float centre = minFreq * std::pow(ratio, static_cast<float>(b));
+      BinRange& range = mBinRanges[b];
+      range.pos = centre / binWidth;
+      range.start = Clip(static_cast<int>(std::ceil(centre / edgeRatio / binWidth)), 0, fftSize / 2);
+      range.end = Clip(static_cast<int>(std::ceil(centre * edgeRatio / binWidth)), 0, fftSize / 2 + 1);
+    }
+  }
+
+  /** Add a chunk of samples to the input buffers of its channels, sending the spectra of those channels each time a hop is complete.
+   * Each channel set is filled separately, its fill is the fill of its first channel */
+  void AddSamples(const ChunkHeader& header, const float* pSamples)
+  {
+    int pos = 0;
+    int fill = mFill[header.chanOffset];
+
+    while (pos < header.nFrames)
+    {
+      const int n = std::min(header.nFrames - pos, mConfiguredFFTSize - fill);
+
+      for (auto c = 0; c < header.nChans; c++)
+        memcpy(mInputs[header.chanOffset + c].data() + fill, pSamples + c * header.nFrames + pos, n * sizeof(float));
+
+      fill += n;
+      pos += n;
+
+      if (fill == mConfiguredFFTSize)
+      {
+        SendSpectra(header);
+
+        for (auto c = header.chanOffset; c < header.chanOffset + header.nChans; c++)
+          std::copy(mInputs[c].begin() + mHopSize, mInputs[c].end(), mInputs[c].begin());
+
+        fill -= mHopSize;
+      }
+    }
+
+    for (auto c = header.chanOffset; c < header.chanOffset + header.nChans; c++)
+      mFill[c] = fill;
+  }
+
+  void SendSpectra(const ChunkHeader& header)
+  {
+    const int chanSize = mConfiguredNBins * static_cast<int>(sizeof(float));
+    uint8_t* pVals = TSender::ReserveData(header.ctrlTag, header.nChans, header.chanOffset, chanSize);
+
+    if (!pVals) // the GUI isn't reading the spectra
+      return;
+
+    for (auto c = 0; c < header.nChans; c++)
+    {
+      CalculateSpectrum(mInputs[header.chanOffset + c]);
+      float* pBins = reinterpret_cast<float*>(pVals + c * chanSize);
+
+      for (auto b = 0; b < mConfiguredNBins; b++)
+      {
+        const BinRange& range = mBinRanges[b];
+        float mag = 0.f;
+
+        if (range.end > range.start)
+        {
+          for (auto k = range.start; k < range.end; k++)
+            mag = std::max(mag, mMagnitudes[k]);
+        }
+        else // more output bins than FFT bins at low frequencies, interpolate
+        {
+          const int k = std::min(static_cast<int>(range.pos), mConfiguredFFTSize / 2 - 1);
+          const float frac = Clip(range.pos - k, 0.f, 1.f);
+          mag = mMagnitudes[k] + frac * (mMagnitudes[k + 1] - mMagnitudes[k]);
+        }
+
+        pBins[b] = mag > 0.f ? std::max(static_cast<float>(AmpToDB(mag)), kMinDB) : kMinDB;
+      }
+    }
+
+    TSender::CommitData();
+  }
+
+  /** Window the input and calculate the magnitude of each FFT bin into mMagnitudes */
+  void CalculateSpectrum(const std::vector<float>& input)
+  {
+    const int fftSize = mConfiguredFFTSize;
+    const int halfSize = fftSize / 2;
+
+    for (auto i = 0; i < fftSize; i++)
+      mFFTBuffer[i] = input[i] * mWindow[i];
+
+    WDL_real_fft(mFFTBuffer.data(), fftSize, 0);
+
+    const WDL_FFT_COMPLEX* pBins = reinterpret_cast<const WDL_FFT_COMPLEX*>(mFFTBuffer.data());
+    const int* pPermute = WDL_fft_permute_tab(halfSize);
+
+    // DC and nyquist are packed into the first bin
+    mMagnitudes[0] = std::fabs(pBins[0].re) * 0.5f;
+    mMagnitudes[halfSize] = std::fabs(pBins[0].im) * 0.5f;
+
+    for (auto k = 1; k < halfSize; k++)
+    {
+      const WDL_FFT_COMPLEX& bin = pBins[pPermute[k]];
+      mMagnitudes[k] = std::sqrt(bin.re * bin.re + bin.im * bin.im);
+    }
+  }
+
+  // settings, Reset() may be called on the audio thread
+  std::atomic<int> mFFTSize {2048};
+  std::atomic<int> mNBins {MAXBINS};
+  std::atomic<int> mOverlap {2};
+  std::atomic<float> mMinFreq {20.f};
+  std::atomic<float> mMaxFreq {20000.f};
+  std::atomic<double> mSampleRate {DEFAULT_SAMPLE_RATE};
+  std::atomic<bool> mConfigChanged {true};
+
+  IPlugQueue<uint8_t> mSampleQueue;
+  WDL_TypedBuf<uint8_t> mStaging; // audio thread only, the chunk being queued
+
+  // main thread state, for the current settings
+  int mConfiguredFFTSize = 0;
+  int mConfiguredNBins = 0;
+  int mHopSize = 0;
+  std::array<int, MAXNC> mFill {}; // the number of samples in each channel's input buffer
+  WDL_TypedBuf<uint8_t> mChunkBuffer; // the samples of the chunk being analysed
+  std::array<std::vector<float>, MAXNC> mInputs;
+  std::vector<WDL_FFT_REAL> mFFTBuffer;
+  std::vector<float> mWindow;
+  std::vector<float> mMagnitudes;
+  std::vector<BinRange> mBinRanges;
+};
+
+END_IPLUG_NAMESPACE
@@ -23,6 +23,23 @@ BEGIN_IPLUG_NAMESPACE
 
 #define LFO_SHAPE_VALIST "Triangle", "Square", "Ramp Up", "Ramp Down", "Sine"
 
+/** The host transport for a block, computed once and shared by all the LFOs synced to it */
+struct LFOTransport
+{
+  LFOTransport(double sampleRate, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
+  : qnPos(qnPos)
+  , qnPerSample((tempo == 0.0 ? 1.0 : tempo) / (60.0 * sampleRate))
+  , tempo(tempo)
+  , transportIsRunning(transportIsRunning)
+  {
+  }
+
+  double qnPos; // at the first sample of the block
+  double qnPerSample;
+  double tempo;
+  bool transportIsRunning;
+};
+
 template<typename T = double>
 class LFO : public IOscillator<T>
 {
@@ -112,34 +129,47 @@ public:
   /* Block process function */
   void ProcessBlock(T* pOutput, int nFrames, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
   {
-    T oneOverQNScalar = 1./mQNScalar;
-    T phase = IOscillator<T>::mPhase;
-    
-    if(mRateMode == ERateMode::kBPM && !transportIsRunning)
-      IOscillator<T>::SetFreqCPS(tempo/60.);
-    
-    double samplesPerBeat = IOscillator<T>::mSampleRate * (60.0 / (tempo == 0.0 ? 1.0 : tempo)); // samples per beat
-    
-    T phaseIncr = IOscillator<T>::mPhaseIncr;
+    ProcessBlock(pOutput, nFrames, LFOTransport(IOscillator<T>::mSampleRate, qnPos, transportIsRunning, tempo));
+  }
 
-    for (int s=0; s<nFrames; s++)
-    {
-      double sampleAccurateQnPos = qnPos + ((double) s / samplesPerBeat);
+  /** Block process function, with the transport computed once per block for all the LFOs synced to it */
+  void ProcessBlock(T* pOutput, int nFrames, const LFOTransport& transport)
+  {
+    double phase = IOscillator<T>::mPhase;
+    double phaseIncr = IOscillator<T>::mPhaseIncr;
 
-      if(mRateMode == ERateMode::kBPM)
+    if (mRateMode == ERateMode::kBPM)
+    {
+      if (transport.transportIsRunning)
       {
-        if(transportIsRunning)
-          phase = std::fmod(sampleAccurateQnPos, oneOverQNScalar) / oneOverQNScalar;
-        else
-          phase = WrapPhase(phase + (phaseIncr * mQNScalar));
+        // the phase of the first sample, the others follow from the increment as the tempo is constant over the block
+        const double qnPhase = transport.qnPos * mQNScalar;
+        phaseIncr = transport.qnPerSample * mQNScalar;
+        phase = WrapPhase(qnPhase - std::floor(qnPhase) - phaseIncr);
       }
       else
-        phase = WrapPhase(phase + phaseIncr);
-      
-      pOutput[s] = DoProcess(phase);
+      {
+        IOscillator<T>::SetFreqCPS(transport.tempo / 60.);
+        phaseIncr = IOscillator<T>::mPhaseIncr * mQNScalar;
+      }
     }
-    
-    IOscillator<T>::mPhase = phase;
+
+    using RenderFunc = void (LFO::*)(T*, int, double, double);
+
+    static const RenderFunc renderFuncs[2][kNumShapes] = {
+      { &LFO::RenderBlock<kTriangle, false>, &LFO::RenderBlock<kSquare, false>, &LFO::RenderBlock<kRampUp, false>, &LFO::RenderBlock<kRampDown, false>, &LFO::RenderBlock<kSine, false> },
+      { &LFO::RenderBlock<kTriangle, true>, &LFO::RenderBlock<kSquare, true>, &LFO::RenderBlock<kRampUp, true>, &LFO::RenderBlock<kRampDown, true>, &LFO::RenderBlock<kSine, true> }
+    };
+
+    (this->*renderFuncs[mPolarity == EPolarity::kBipolar][mShape])(pOutput, nFrames, phase, phaseIncr);
+  }
+
+  /** Compute the shape once every few samples and interpolate linearly between, for modulation that does not need to be sample accurate. Square waves are smoothed over the interval
+   * @param nSamples The interval, 1 computes every sample */
+  void SetControlRateInterval(int nSamples)
+  {
+    mControlRateInterval = std::max(nSamples, 1);
+    mRampCount = 0;
   }
   
   void SetShape(int lfoShape)
@@ -178,7 +208,7 @@ public:
   }
   
 private:
-  static inline T WrapPhase (T x, T lo = 0., T hi = 1.)
+  static inline double WrapPhase (double x, double lo = 0., double hi = 1.)
   {
     while (x >= hi)
       x -= hi;
@@ -186,42 +216,76 @@ private:
       x += hi - lo;
     return x;
   };
-  
-  inline T DoProcess(T phase)
+
+  /** The shape at a phase, specialized at compile time so the block loops do not branch on the shape or polarity */
+  template <EShape shape, bool bipolar>
+  static inline T Shape(T x)
   {
-    auto triangle         = [](T x){ return (2. * (1. - std::abs((WrapPhase(x + 0.25) * 2.) -1.))) - 1.; };
-    auto triangleUnipolar = [](T x){ return 1. - std::abs((x * 2.) - 1. ); };
-    auto square           = [](T x){ return std::copysign(1., x - 0.5); };
-    auto squareUnipolar   = [](T x){ return std::copysign(0.5, x - 0.5) + 0.5; };
-    auto rampup           = [](T x){ return (x * 2.) - 1.; };
-    auto rampupUnipolar   = [](T x){ return x; };
-    auto rampdown         = [](T x){ return ((1. - x) * 2.) - 1.; };
-    auto rampdownUnipolar = [](T x){ return 1. - x; };
-    
-    T output = 0.;
-    
-    if(mPolarity == EPolarity::kUnipolar)
+    if constexpr (shape == kTriangle)
+      return bipolar ? (2. * (1. - std::abs((WrapPhase(x + 0.25) * 2.) -1.))) - 1. : 1. - std::abs((x * 2.) - 1. );
+    else if constexpr (shape == kSquare)
+      return bipolar ? std::copysign(1., x - 0.5) : std::copysign(0.5, x - 0.5) + 0.5;
+    else if constexpr (shape == kRampUp)
+      return bipolar ? (x * 2.) - 1. : x;
+    else if constexpr (shape == kRampDown)
+      return bipolar ? ((1. - x) * 2.) - 1. : 1. - x;
+    else
+      return bipolar ? std::sin(x * 6.283185307179586) : (std::sin(x * 6.283185307179586) * 0.5) + 0.5;
+  }
+
+  /** Render a block, each sample at the previous phase + phaseIncr */
+  template <EShape shape, bool bipolar>
+  void RenderBlock(T* pOutput, int nFrames, double phase, double phaseIncr)
+  {
+    const T levelScalar = mLevelScalar;
+
+    if (mControlRateInterval == 1)
     {
-      switch (mShape) {
-        case kTriangle: output = triangleUnipolar(phase); break;
-        case kSquare:   output = squareUnipolar(phase); break;
-        case kRampUp:   output = rampupUnipolar(phase); break;
-        case kRampDown: output = rampdownUnipolar(phase); break;
-        case kSine:     output = (std::sin(phase * 6.283185307179586) * 0.5) + 0.5; break;
-        default: break;
+      for (int s = 0; s < nFrames; s++)
+      {
+        phase = WrapPhase(phase + phaseIncr);
+        pOutput[s] = Shape<shape, bipolar>(phase) * levelScalar;
       }
     }
     else
     {
-      switch (mShape) {
-        case kTriangle: output = triangle(phase); break;
-        case kSquare:   output = square(phase); break;
-        case kRampUp:   output = rampup(phase); break;
-        case kRampDown: output = rampdown(phase); break;
-        case kSine:     output = std::sin(phase * 6.283185307179586); break;
-        default: break;
+      for (int s = 0; s < nFrames; s++)
+      {
+        phase = WrapPhase(phase + phaseIncr);
+
+        if (mRampCount == 0)
+        {
+          // ramp to the value at the end of the interval
+          const T target = Shape<shape, bipolar>(WrapPhase(phase + phaseIncr * (mControlRateInterval - 1)));
+          mRampIncr = (target - mRampValue) / mControlRateInterval;
+          mRampCount = mControlRateInterval;
+        }
+
+        mRampValue += mRampIncr;
+        mRampCount--;
+        pOutput[s] = mRampValue * levelScalar;
       }
     }
+
+    if (nFrames > 0)
+      mLastOutput = pOutput[nFrames - 1];
+
+    IOscillator<T>::mPhase = phase;
+  }
+  
+  inline T DoProcess(T phase)
+  {
+    T output = 0.;
+    const bool bipolar = mPolarity == EPolarity::kBipolar;
+
+    switch (mShape) {
+      case kTriangle: output = bipolar ? Shape<kTriangle, true>(phase) : Shape<kTriangle, false>(phase); break;
+      case kSquare:   output = bipolar ? Shape<kSquare, true>(phase) : Shape<kSquare, false>(phase); break;
+      case kRampUp:   output = bipolar ? Shape<kRampUp, true>(phase) : Shape<kRampUp, false>(phase); break;
+      case kRampDown: output = bipolar ? Shape<kRampDown, true>(phase) : Shape<kRampDown, false>(phase); break;
+      case kSine:     output = bipolar ? Shape<kSine, true>(phase) : Shape<kSine, false>(phase); break;
+      default: break;
+    }
     
     mLastOutput = output * mLevelScalar;
     
@@ -235,6 +299,10 @@ private:
   EShape mShape = EShape::kTriangle;
   EPolarity mPolarity = EPolarity::kUnipolar;
   ERateMode mRateMode = ERateMode::kHz;
+  int mControlRateInterval = 1;
+  int mRampCount = 0; // samples left in the current interval
+  T mRampValue = 0.; // the shape, before mLevelScalar
+  T mRampIncr = 0.;
 };
 
 END_IPLUG_NAMESPACE
@@ -0,0 +1,214 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc MetaParamGraph
+ */
+
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "heapbuf.h"
+
+#include "IPlugAPIBase.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A declared dependency graph between "meta" parameters and the parameters they drive.
+ * Each dependent parameter has a function that computes its value from its source parameters.
+ * The graph is sorted topologically once, in Finalize(). When a parameter changes, MarkDirty() just flags it,
+ * then Process() walks the sorted graph once, recomputing every affected dependent exactly once no matter how many of its sources changed,
+ * and informs the host of all the changed values in a single batch (see IPlugAPIBase::BeginParameterChangeBatch()), as edit gestures that the host records as automation and undo.
+ *
+ * Typical use: declare the dependencies in the plug-in's constructor and call Finalize(), call MarkDirty(paramIdx) in OnParamChange() (any thread),
+ * and call Process(*this) on the main thread in OnIdle(), e.g. once per timer tick */
+class MetaParamGraph
+{
+public:
+  /** A function returning the new normalized value of a dependent parameter, computed from the plug-in's current parameter values */
+  using ComputeFunc = std::function<double(const IPluginBase& plug)>;
+
+  /** Declare that a parameter's value depends on other parameters. Call this before Finalize()
+   * @param paramIdx The dependent parameter
+   * @param sourceParamIdxs The parameters it is computed from
+   * @param func The function that computes its normalized value */
+  void AddDependent(int paramIdx, std::initializer_list<int> sourceParamIdxs, ComputeFunc func)
+  {
+    assert(!mFinalized && "Dependencies must be added before Finalize()");
+
+    for (auto src : sourceParamIdxs)
+    {
+      mEdges.Add(src);
+      mEdges.Add(paramIdx);
+    }
+
+    mComputeFuncs.push_back({paramIdx, func});
+  }
+
+  /** Sort the graph. Call this once after the dependencies are declared. This method is not realtime safe
+   * @param nParams The number of parameters in the plug-in
+   * @return \c true on success, \c false if the dependencies contain a cycle */
+  bool Finalize(int nParams)
+  {
+    mNParams = nParams;
+    const int nEdges = mEdges.GetSize() / 2;
+    const int* pEdges = mEdges.Get();
+
+    // store each parameter's downstream parameters contiguously
+    mDownstreamStarts.Resize(nParams + 1);
+    int* pStarts = mDownstreamStarts.Get();
+    memset(pStarts, 0, (nParams + 1) * sizeof(int));
+
+    for (auto e = 0; e < nEdges; e++)
+      pStarts[pEdges[e * 2] + 1]++;
+
+    for (auto p = 0; p < nParams; p++)
+      pStarts[p + 1] += pStarts[p];
+
+    mDownstream.Resize(nEdges);
+    WDL_TypedBuf<int> fill;
+    fill.Resize(nParams);
+    memcpy(fill.Get(), pStarts, nParams * sizeof(int));
+
+    for (auto e = 0; e < nEdges; e++)
+      mDownstream.Get()[fill.Get()[pEdges[e * 2]]++] = pEdges[e * 2 + 1];
+
+    // Kahn's algorithm
+    WDL_TypedBuf<int> inDegree;
+    inDegree.Resize(nParams);
+    memset(inDegree.Get(), 0, nParams * sizeof(int));
+
+    for (auto e = 0; e < nEdges; e++)
+      inDegree.Get()[pEdges[e * 2 + 1]]++;
+
+    mOrder.Resize(nParams);
+    int* pOrder = mOrder.Get();
+    int head = 0, tail = 0;
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      if (inDegree.Get()[p] == 0)
+        pOrder[tail++] = p;
+    }
+
+    while (head < tail)
+    {
+      const int p = pOrder[head++];
+
+      for (auto i = pStarts[p]; i < pStarts[p + 1]; i++)
+      {
+        const int d = mDownstream.Get()[i];
+
+        if (--inDegree.Get()[d] == 0)
+          pOrder[tail++] = d;
+      }
+    }
+
+    if (tail != nParams)
+      return false;
+
+    mComputeFuncForParam.assign(nParams, nullptr);
+
+    for (auto& c : mComputeFuncs)
+      mComputeFuncForParam[c.first] = &c.second;
+
+    mDirty = std::vector<std::atomic<bool>>(nParams);
+    mNeedsUpdate.Resize(nParams);
+    memset(mNeedsUpdate.Get(), 0, nParams * sizeof(bool));
+    mFinalized = true;
+    return true;
+  }
+
+  /** Flag that a parameter has changed, so that its dependents are recomputed by the next call to Process().
+   * This method is lock-free and can be called on any thread, e.g. in OnParamChange()
+   * @param paramIdx The parameter that changed */
+  void MarkDirty(int paramIdx)
+  {
+    if (mFinalized && paramIdx >= 0 && paramIdx < mNParams)
+    {
+      mDirty[paramIdx].store(true, std::memory_order_relaxed);
+      mAnyDirty.store(true, std::memory_order_release);
+    }
+  }
+
+  /** Recompute the parameters affected by the changes since the last call, in dependency order, and inform the host and the UI of the ones that changed.
+   * Call this on the main thread, e.g. in OnIdle()
+   * @param plug The plug-in */
+  void Process(IPlugAPIBase& plug)
+  {
+    if (!mFinalized || !mAnyDirty.exchange(false, std::memory_order_acquire))
+      return;
+
+    bool* pNeedsUpdate = mNeedsUpdate.Get();
+    const int* pStarts = mDownstreamStarts.Get();
+    const int* pDownstream = mDownstream.Get();
+
+    for (auto p = 0; p < mNParams; p++)
+    {
+      if (mDirty[p].exchange(false, std::memory_order_relaxed))
+      {
+        for (auto i = pStarts[p]; i < pStarts[p + 1]; i++)
+          pNeedsUpdate[pDownstream[i]] = true;
+      }
+    }
+
+    plug.BeginParameterChangeBatch();
+
+    for (auto o = 0; o < mNParams; o++)
+    {
+      const int p = mOrder.Get()[o];
+
+      if (!pNeedsUpdate[p])
+        continue;
+
+      pNeedsUpdate[p] = false;
+      const ComputeFunc* pFunc = mComputeFuncForParam[p];
+
+      if (!pFunc)
+        continue;
+
+      const double value = Clip((*pFunc)(plug), 0., 1.);
+
+      if (value == plug.GetParam(p)->GetNormalized())
+        continue; // unchanged, so nothing downstream of it needs recomputing
+
+      plug.SetParameterValue(p, value);
+      plug.SendParameterValueFromDelegate(p, value, true);
+      mDirty[p].store(false, std::memory_order_relaxed); // in case OnParamChange() marked it
+
+      for (auto i = pStarts[p]; i < pStarts[p + 1]; i++)
+        pNeedsUpdate[pDownstream[i]] = true;
+    }
+
+    plug.EndParameterChangeBatch();
+  }
+
+private:
+  int mNParams = 0;
+  bool mFinalized = false;
+  WDL_TypedBuf<int> mEdges; // pairs of source, dependent
+  std::vector<std::pair<int, ComputeFunc>> mComputeFuncs;
+  std::vector<const ComputeFunc*> mComputeFuncForParam;
+  WDL_TypedBuf<int> mDownstreamStarts;
+  WDL_TypedBuf<int> mDownstream;
+  WDL_TypedBuf<int> mOrder;
+  WDL_TypedBuf<bool> mNeedsUpdate;
+  std::vector<std::atomic<bool>> mDirty;
+  std::atomic<bool> mAnyDirty {false};
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,475 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ModMatrix
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "wdlstring.h"
+#include "heapbuf.h"
+
+#include "IPlugParameter.h"
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A modulation matrix, connecting modulation sources (LFOs, envelopes, MIDI CCs, voice controls...) to destinations (parameters or voice controls) via a list of routes with a depth.
+ *
+ * Sources and destinations are either global, or per voice. Each source is computed once per block by the plug-in, e.g. by calling LFO::ProcessBlock() into the buffer returned by GetSourceBuffer(),
+ * or set to a block-constant value with SetSourceValue(). The routes are kept in a flat array sorted by destination, and each route adds depth * source to its destination's buffer,
+ * a loop the compiler vectorizes. Global routes are evaluated with ProcessBlock(), routes to voice destinations are evaluated for each voice with ProcessVoice(), using the voice's own sources and
+ * the shared global sources. A route from a voice source to a global destination is not allowed.
+ *
+ * A destination linked to an IParam is modulated in the normalized domain around the parameter's current value and clipped to 0-1. Other destinations start at 0 each block.
+ *
+ * Adding sources, destinations and routes is not realtime safe. Changing a route's depth is, but should be done on the audio thread. */
+template<typename T = sample>
+class ModMatrix
+{
+public:
+  /** Whether a source or destination is shared by the whole plug-in, or exists separately for each voice */
+  enum class EScope { kGlobal, kVoice };
+
+  /** The per-voice buffers of the matrix. A synth voice should own one of these, and pass it to ModMatrix::ProcessVoice() */
+  class Voice
+  {
+  public:
+    /** @param voiceSrcIdx The index of a voice source, as returned by ModMatrix::GetVoiceSourceIdx()
+     * @return The buffer to write the source's signal into for this voice */
+    T* GetSourceBuffer(int voiceSrcIdx) { mSourceIsConstant.Get()[voiceSrcIdx] = false; return mSourceBuffers.Get() + (voiceSrcIdx * mMaxBlockSize); }
+
+    /** @param voiceSrcIdx The index of a voice source, as returned by ModMatrix::GetVoiceSourceIdx()
+     * @param value A value that is constant for the whole block, which is cheaper to process than a buffer */
+    void SetSourceValue(int voiceSrcIdx, T value) { mSourceValues.Get()[voiceSrcIdx] = value; mSourceIsConstant.Get()[voiceSrcIdx] = true; }
+
+    /** @param voiceDestIdx The index of a voice destination, as returned by ModMatrix::GetVoiceDestIdx()
+     * @return The modulated value of the destination for each frame of the last call to ModMatrix::ProcessVoice() */
+    const T* GetModulation(int voiceDestIdx) const { return mDestBuffers.Get() + (voiceDestIdx * mMaxBlockSize); }
+
+    /** @param voiceDestIdx The index of a voice destination, as returned by ModMatrix::GetVoiceDestIdx()
+     * @return The modulated value of the destination at the start of the last block, for block-rate modulation */
+    T GetModulationValue(int voiceDestIdx) const { return GetModulation(voiceDestIdx)[0]; }
+
+  private:
+    friend class ModMatrix;
+
+    int mMaxBlockSize = 0;
+    WDL_TypedBuf<T> mSourceBuffers;
+    WDL_TypedBuf<T> mSourceValues;
+    WDL_TypedBuf<bool> mSourceIsConstant;
+    WDL_TypedBuf<T> mDestBuffers;
+  };
+
+  /** Add a modulation source
+   * @param name A name for the source, e.g. for display in a UI
+   * @param scope Whether the source is global or per voice
+   * @return The index of the new source */
+  int AddSource(const char* name, EScope scope = EScope::kGlobal)
+  {
+    Source src;
+    strncpy(src.mName, name, MAX_PARAM_NAME_LEN - 1);
+    src.mName[MAX_PARAM_NAME_LEN - 1] = '\0';
+    src.mScope = scope;
+    src.mScopeIdx = CountScope(mSources, scope);
+    mSources.Add(src);
+    Reallocate();
+    return mSources.GetSize() - 1;
+  }
+
+  /** Add a voice source for each of the VoiceAllocator's voice controls (gate, pitch, pitch bend, and the MPE pressure and timbre dimensions), in the order of voiceControlNames::eControlNames
+   * @return The index of the first source, the source for control c is the return value + c */
+  int AddVoiceControlSources()
+  {
+    static const char* names[kNumVoiceControlRamps] = { "Gate", "Pitch", "Pitch Bend", "Pressure", "Timbre" };
+
+    const int firstIdx = mSources.GetSize();
+
+    for (auto c = 0; c < kNumVoiceControlRamps; c++)
+      AddSource(names[c], EScope::kVoice);
+
+    return firstIdx;
+  }
+
+  /** Add a modulation destination
+   * @param name A name for the destination, e.g. for display in a UI
+   * @param scope Whether the destination is global or per voice
+   * @param pParam If not nullptr, the destination is modulated around the normalized value of this parameter
+   * @return The index of the new destination */
+  int AddDestination(const char* name, EScope scope = EScope::kGlobal, const IParam* pParam = nullptr)
+  {
+    Destination dest;
+    strncpy(dest.mName, name, MAX_PARAM_NAME_LEN - 1);
+    dest.mName[MAX_PARAM_NAME_LEN - 1] = '\0';
+    dest.mScope = scope;
+    dest.mScopeIdx = CountScope(mDestinations, scope);
+    dest.mParam = pParam;
+    mDestinations.Add(dest);
+    Reallocate();
+    return mDestinations.GetSize() - 1;
+  }
+
+  /** Add a destination for a parameter, named after it
+   * @param pParam The parameter
+   * @param scope Whether the parameter is modulated globally or per voice
+   * @return The index of the new destination */
+  int AddParamDestination(const IParam* pParam, EScope scope = EScope::kGlobal)
+  {
+    return AddDestination(pParam->GetName(), scope, pParam);
+  }
+
+  /** Connect a source to a destination
+   * @param srcIdx The index of the source
+   * @param destIdx The index of the destination
+   * @param depth The amount of the source to add to the destination
+   * @return \c true on success, \c false if the source is per voice and the destination is global */
+  bool AddRoute(int srcIdx, int destIdx, T depth)
+  {
+    assert(srcIdx >= 0 && srcIdx < NSources() && destIdx >= 0 && destIdx < NDestinations());
+
+    if (mSources.Get()[srcIdx].mScope == EScope::kVoice && mDestinations.Get()[destIdx].mScope == EScope::kGlobal)
+      return false;
+
+    // keep the routes sorted by destination, so that each destination buffer is finished before moving on to the next one
+    int insertIdx = mRoutes.GetSize();
+    while (insertIdx > 0 && mRoutes.Get()[insertIdx - 1].mDest > destIdx)
+      insertIdx--;
+
+    mRoutes.Insert(Route { srcIdx, destIdx, depth }, insertIdx);
+    return true;
+  }
+
+  /** Remove all the routes between a source and a destination
+   * @param srcIdx The index of the source
+   * @param destIdx The index of the destination */
+  void RemoveRoute(int srcIdx, int destIdx)
+  {
+    for (auto r = mRoutes.GetSize() - 1; r >= 0; r--)
+    {
+      if (mRoutes.Get()[r].mSource == srcIdx && mRoutes.Get()[r].mDest == destIdx)
+        mRoutes.Delete(r);
+    }
+  }
+
+  /** Set the depth of all the routes between a source and a destination. This method is realtime safe
+   * @param srcIdx The index of the source
+   * @param destIdx The index of the destination
+   * @param depth The new depth */
+  void SetRouteDepth(int srcIdx, int destIdx, T depth)
+  {
+    for (auto r = 0; r < mRoutes.GetSize(); r++)
+    {
+      if (mRoutes.Get()[r].mSource == srcIdx && mRoutes.Get()[r].mDest == destIdx)
+        mRoutes.Get()[r].mDepth = depth;
+    }
+  }
+
+  /** Remove all the routes */
+  void ClearRoutes() { mRoutes.Resize(0); }
+
+  /** Allocate the global buffers, call this in OnReset()
+   * @param maxBlockSize The largest number of frames that will be processed at once */
+  void Reset(int maxBlockSize)
+  {
+    mMaxBlockSize = maxBlockSize;
+    Reallocate();
+  }
+
+  /** Allocate a voice's buffers, call this for each voice in OnReset() after Reset()
+   * @param voice The voice */
+  void ResetVoice(Voice& voice) const
+  {
+    const int nSources = CountScope(mSources, EScope::kVoice);
+    voice.mMaxBlockSize = mMaxBlockSize;
+    voice.mSourceBuffers.Resize(nSources * mMaxBlockSize);
+    voice.mSourceValues.Resize(nSources);
+    voice.mSourceIsConstant.Resize(nSources);
+    voice.mDestBuffers.Resize(CountScope(mDestinations, EScope::kVoice) * mMaxBlockSize);
+    memset(voice.mSourceValues.Get(), 0, nSources * sizeof(T));
+    memset(voice.mSourceIsConstant.Get(), 0, nSources * sizeof(bool));
+  }
+
+  /** @param srcIdx The index of a global source
+   * @return The buffer to write the source's signal into for the current block */
+  T* GetSourceBuffer(int srcIdx)
+  {
+    assert(mSources.Get()[srcIdx].mScope == EScope::kGlobal);
+    mSourceIsConstant.Get()[mSources.Get()[srcIdx].mScopeIdx] = false;
+    return mSourceBuffers.Get() + (mSources.Get()[srcIdx].mScopeIdx * mMaxBlockSize);
+  }
+
+  /** Set a global source to a value that is constant for the whole block, e.g. a MIDI CC, which is cheaper to process than a buffer
+   * @param srcIdx The index of a global source
+   * @param value The value */
+  void SetSourceValue(int srcIdx, T value)
+  {
+    assert(mSources.Get()[srcIdx].mScope == EScope::kGlobal);
+    mSourceValues.Get()[mSources.Get()[srcIdx].mScopeIdx] = value;
+    mSourceIsConstant.Get()[mSources.Get()[srcIdx].mScopeIdx] = true;
+  }
+
+  /** Evaluate the routes to global destinations. Call this once per block after writing the global sources
+   * @param nFrames The number of frames, which must not exceed the maxBlockSize passed to Reset() */
+  void ProcessBlock(int nFrames)
+  {
+    assert(nFrames <= mMaxBlockSize);
+
+    for (auto d = 0; d < NDestinations(); d++)
+    {
+      const Destination& dest = mDestinations.Get()[d];
+
+      if (dest.mScope == EScope::kGlobal)
+        Fill(mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize), dest.mParam ? static_cast<T>(dest.mParam->GetNormalized()) : T(0), nFrames);
+    }
+
+    for (auto r = 0; r < mRoutes.GetSize(); r++)
+    {
+      const Route& route = mRoutes.Get()[r];
+      const Destination& dest = mDestinations.Get()[route.mDest];
+
+      if (dest.mScope != EScope::kGlobal)
+        continue;
+
+      const int srcScopeIdx = mSources.Get()[route.mSource].mScopeIdx;
+      T* pDest = mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize);
+
+      if (mSourceIsConstant.Get()[srcScopeIdx])
+        AddConstant(pDest, route.mDepth * mSourceValues.Get()[srcScopeIdx], nFrames);
+      else
+        AddScaled(pDest, mSourceBuffers.Get() + (srcScopeIdx * mMaxBlockSize), route.mDepth, nFrames);
+    }
+
+    for (auto d = 0; d < NDestinations(); d++)
+    {
+      const Destination& dest = mDestinations.Get()[d];
+
+      if (dest.mScope == EScope::kGlobal && dest.mParam)
+        ClipNormalized(mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize), nFrames);
+    }
+  }
+
+  /** Evaluate the routes to a voice's destinations. Call this in the voice's ProcessSamplesAccumulating() after writing its sources, and after ProcessBlock() has been called for the block
+   * @param voice The voice's buffers
+   * @param nFrames The number of frames, which must not exceed the maxBlockSize passed to Reset() */
+  void ProcessVoice(Voice& voice, int nFrames) const
+  {
+    assert(nFrames <= voice.mMaxBlockSize);
+
+    for (auto d = 0; d < NDestinations(); d++)
+    {
+      const Destination& dest = mDestinations.Get()[d];
+
+      if (dest.mScope == EScope::kVoice)
+        Fill(voice.mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize), dest.mParam ? static_cast<T>(dest.mParam->GetNormalized()) : T(0), nFrames);
+    }
+
+    for (auto r = 0; r < mRoutes.GetSize(); r++)
+    {
+      const Route& route = mRoutes.Get()[r];
+      const Destination& dest = mDestinations.Get()[route.mDest];
+
+      if (dest.mScope != EScope::kVoice)
+        continue;
+
+      const Source& src = mSources.Get()[route.mSource];
+      const bool voiceSrc = src.mScope == EScope::kVoice;
+      const bool isConstant = voiceSrc ? voice.mSourceIsConstant.Get()[src.mScopeIdx] : mSourceIsConstant.Get()[src.mScopeIdx];
+      T* pDest = voice.mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize);
+
+      if (isConstant)
+      {
+        const T value = voiceSrc ? voice.mSourceValues.Get()[src.mScopeIdx] : mSourceValues.Get()[src.mScopeIdx];
+        AddConstant(pDest, route.mDepth * value, nFrames);
+      }
+      else
+      {
+        const T* pSrc = (voiceSrc ? voice.mSourceBuffers.Get() : mSourceBuffers.Get()) + (src.mScopeIdx * mMaxBlockSize);
+        AddScaled(pDest, pSrc, route.mDepth, nFrames);
+      }
+    }
+
+    for (auto d = 0; d < NDestinations(); d++)
+    {
+      const Destination& dest = mDestinations.Get()[d];
+
+      if (dest.mScope == EScope::kVoice && dest.mParam)
+        ClipNormalized(voice.mDestBuffers.Get() + (dest.mScopeIdx * mMaxBlockSize), nFrames);
+    }
+  }
+
+  /** Write a SynthVoice's control ramps (SynthVoice::mInputs) into the voice's sources added with AddVoiceControlSources(), then evaluate the voice's routes
+   * @param voice The voice's buffers
+   * @param inputs The voice's control ramps
+   * @param firstControlSrcIdx The index returned by AddVoiceControlSources()
+   * @param nFrames The number of frames */
+  void ProcessVoice(Voice& voice, const VoiceInputs& inputs, int firstControlSrcIdx, int nFrames) const
+  {
+    for (auto c = 0; c < kNumVoiceControlRamps; c++)
+    {
+      const int scopeIdx = mSources.Get()[firstControlSrcIdx + c].mScopeIdx;
+      const ControlRamp& ramp = inputs[c];
+
+      if (ramp.startValue == ramp.endValue)
+        voice.SetSourceValue(scopeIdx, static_cast<T>(ramp.endValue));
+      else
+        WriteRamp(ramp, voice.GetSourceBuffer(scopeIdx), nFrames);
+    }
+
+    ProcessVoice(voice, nFrames);
+  }
+
+  /** @param destIdx The index of a global destination
+   * @return The modulated value of the destination for each frame of the last call to ProcessBlock(), normalized if the destination is linked to a parameter */
+  const T* GetModulation(int destIdx) const
+  {
+    assert(mDestinations.Get()[destIdx].mScope == EScope::kGlobal);
+    return mDestBuffers.Get() + (mDestinations.Get()[destIdx].mScopeIdx * mMaxBlockSize);
+  }
+
+  /** @param destIdx The index of a global destination that is linked to a parameter
+   * @return The modulated, non-normalized value of the parameter at the start of the last block, for block-rate modulation */
+  double GetModulatedParamValue(int destIdx) const
+  {
+    const Destination& dest = mDestinations.Get()[destIdx];
+    assert(dest.mParam);
+    return dest.mParam->FromNormalized(GetModulation(destIdx)[0]);
+  }
+
+  /** @param destIdx The index of a voice destination
+   * @return The index to use with Voice::GetModulation() */
+  int GetVoiceDestIdx(int destIdx) const { return mDestinations.Get()[destIdx].mScopeIdx; }
+
+  /** @param srcIdx The index of a voice source
+   * @return The index to use with Voice::GetSourceBuffer() and Voice::SetSourceValue() */
+  int GetVoiceSourceIdx(int srcIdx) const { return mSources.Get()[srcIdx].mScopeIdx; }
+
+  int NSources() const { return mSources.GetSize(); }
+  int NDestinations() const { return mDestinations.GetSize(); }
+  int NRoutes() const { return mRoutes.GetSize(); }
+  const char* GetSourceName(int srcIdx) const { return mSources.Get()[srcIdx].mName; }
+  const char* GetDestinationName(int destIdx) const { return mDestinations.Get()[destIdx].mName; }
+
+private:
+  struct Source
+  {
+    char mName[MAX_PARAM_NAME_LEN];
+    EScope mScope;
+    int mScopeIdx; // the index among the sources of the same scope, used to find its buffer
+  };
+
+  struct Destination
+  {
+    char mName[MAX_PARAM_NAME_LEN];
+    EScope mScope;
+    int mScopeIdx;
+    const IParam* mParam;
+  };
+
+  struct Route
+  {
+    int mSource;
+    int mDest;
+    T mDepth;
+  };
+
+  template <typename E>
+  static int CountScope(const WDL_TypedBuf<E>& elements, EScope scope)
+  {
+    int count = 0;
+
+    for (auto i = 0; i < elements.GetSize(); i++)
+    {
+      if (elements.Get()[i].mScope == scope)
+        count++;
+    }
+
+    return count;
+  }
+
+  void Reallocate()
+  {
+    const int nSources = CountScope(mSources, EScope::kGlobal);
+    const int prevSize = mSourceValues.GetSize();
+    mSourceBuffers.Resize(nSources * mMaxBlockSize);
+    mSourceValues.Resize(nSources);
+    mSourceIsConstant.Resize(nSources);
+    mDestBuffers.Resize(CountScope(mDestinations, EScope::kGlobal) * mMaxBlockSize);
+
+    // new sources are constant 0 until they are written
+    for (auto i = prevSize; i < nSources; i++)
+    {
+      mSourceValues.Get()[i] = T(0);
+      mSourceIsConstant.Get()[i] = true;
+    }
+  }
+
+  static void Fill(T* pDest, T value, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+      pDest[s] = value;
+  }
+
+  static void AddConstant(T* pDest, T value, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+      pDest[s] += value;
+  }
+
+  static void AddScaled(T* pDest, const T* pSrc, T depth, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+      pDest[s] += depth * pSrc[s];
+  }
+
+  static void ClipNormalized(T* pDest, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+      pDest[s] = pDest[s] < T(0) ? T(0) : (pDest[s] > T(1) ? T(1) : pDest[s]);
+  }
+
+  static void WriteRamp(const ControlRamp& ramp, T* pDest, int nFrames)
+  {
+    const int transitionStart = std::min(ramp.transitionStart, nFrames);
+    const int transitionEnd = std::min(ramp.transitionEnd, nFrames);
+    const T dv = static_cast<T>((ramp.endValue - ramp.startValue) / std::max(ramp.transitionEnd - ramp.transitionStart, 1));
+    T val = static_cast<T>(ramp.startValue);
+
+    for (auto s = 0; s < transitionStart; s++)
+      pDest[s] = val;
+
+    for (auto s = transitionStart; s < transitionEnd; s++)
+    {
+      val += dv;
+      pDest[s] = val;
+    }
+
+    for (auto s = transitionEnd; s < nFrames; s++)
+      pDest[s] = val;
+  }
+
+  int mMaxBlockSize = 0;
+  WDL_TypedBuf<Source> mSources;
+  WDL_TypedBuf<Destination> mDestinations;
+  WDL_TypedBuf<Route> mRoutes;
+
+  // global buffers, indexed by the scope index of the sources and destinations
+  WDL_TypedBuf<T> mSourceBuffers;
+  WDL_TypedBuf<T> mSourceValues;
+  WDL_TypedBuf<bool> mSourceIsConstant;
+  WDL_TypedBuf<T> mDestBuffers;
+};
+
+END_IPLUG_NAMESPACE
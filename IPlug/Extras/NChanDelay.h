@@ -1,69 +1,179 @@
 /*
  ==============================================================================
- 
- This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers. 
- 
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
  See LICENSE.txt for  more info.
- 
+
  ==============================================================================
 */
 
 #pragma once
+#include <cmath>
+#include <cstring>
 #include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
 
 BEGIN_IPLUG_NAMESPACE
 
-// A static delayline used to delay bypassed signals to match mLatency in AAX/VST3/AU
+/** A multi-channel delay line, used to delay bypassed signals to match mLatency in AAX/VST3/AU, and for modulated effects such as chorus and flanging.
+ * The buffer of each channel is a power of two long, so the read and write positions wrap with a mask. It is allocated by SetMaxDelayTime(), or by SetDelayTime()
+ * when the delay is longer than the buffer, so once it is long enough the delay can change on the audio thread without allocating */
 template<typename T>
 class NChanDelayLine
 {
 public:
+  /** How the samples between two in the buffer are read for a fractional delay */
+  enum class EInterpolation
+  {
+    Linear, // cheap, but low passes the signal when the delay is between samples
+    Lagrange, // third order, four samples, flatter response for a little more work
+    Allpass // first order, flat magnitude response, best for delays that change slowly as the filter has state
+  };
+
   NChanDelayLine(int nInputChans = 2, int nOutputChans = 2)
   : mNInChans(nInputChans)
   , mNOutChans(nOutputChans)
-  {}
+  {
+    mAllpassState.Resize(nInputChans);
+  }
+
+  /** Allocate the buffer for the longest delay, e.g. from OnReset(). Call this before the delay time changes on the audio thread
+   * @param maxDelayTimeSamples The longest delay, in samples */
+  void SetMaxDelayTime(int maxDelayTimeSamples)
+  {
+    // the interpolators read up to two samples past the delay
+    int size = 1;
 
+    while (size < maxDelayTimeSamples + 3)
+      size <<= 1;
+
+    if (size != mSize)
+    {
+      mSize = size;
+      mMask = size - 1;
+      mBuffer.Resize(mNInChans * size);
+      mWriteAddress = 0;
+    }
+
+    mMaxDelay = maxDelayTimeSamples;
+    ClearBuffer();
+  }
+
+  /** Set a delay of a whole number of samples, used by ProcessBlock() without delay times. This only allocates and clears the buffer if it is too short for the delay
+   * @param delayTimeSamples The delay, in samples */
   void SetDelayTime(int delayTimeSamples)
   {
+    if (delayTimeSamples > mMaxDelay)
+      SetMaxDelayTime(delayTimeSamples);
+
     mDTSamples = delayTimeSamples;
-    mBuffer.Resize(mNInChans * delayTimeSamples);
-    mWriteAddress = 0;
-    ClearBuffer();
   }
 
   void ClearBuffer()
   {
-    memset(mBuffer.Get(), 0, mNInChans * mDTSamples * sizeof(T));
+    memset(mBuffer.Get(), 0, mBuffer.GetSize() * sizeof(T));
+    memset(mAllpassState.Get(), 0, mAllpassState.GetSize() * sizeof(T));
   }
 
+  /** Delay the inputs by the delay set with SetDelayTime() */
   void ProcessBlock(T** inputs, T** outputs, int nFrames)
   {
-    T* buffer = mBuffer.Get();
+    const int nChans = std::min(mNInChans, mNOutChans);
 
-    for (auto s = 0 ; s < nFrames; ++s)
+    for (auto c = 0; c < nChans; c++)
     {
-      int32_t readAddress = mWriteAddress - mDTSamples;
-      readAddress %= mDTSamples;
+      T* buffer = mBuffer.Get() + c * mSize;
+      uint32_t writeAddress = mWriteAddress;
 
-      for (auto c = 0; c < mNInChans; c++)
+      for (auto s = 0; s < nFrames; s++)
       {
-        if (c < mNOutChans)
+        buffer[writeAddress] = inputs[c][s];
+        outputs[c][s] = buffer[(writeAddress - mDTSamples) & mMask];
+        writeAddress = (writeAddress + 1) & mMask;
+      }
+    }
+
+    mWriteAddress = (mWriteAddress + nFrames) & mMask;
+  }
+
+  /** Delay the inputs by a delay time for each sample, which may be fractional, e.g. for a chorus whose delay is modulated by an LFO. The delays are clipped to the maximum set with SetMaxDelayTime()
+   * @param delayTimes The delay of each sample, in samples
+   * @param interpolation How the samples are read between those in the buffer */
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, const T* delayTimes, EInterpolation interpolation = EInterpolation::Linear)
+  {
+    const int nChans = std::min(mNInChans, mNOutChans);
+    const T minDelay = interpolation == EInterpolation::Lagrange ? T(1) : T(0); // Lagrange reads a sample after the delay
+    const T maxDelay = static_cast<T>(mMaxDelay);
+
+    for (auto c = 0; c < nChans; c++)
+    {
+      T* buffer = mBuffer.Get() + c * mSize;
+      T& allpassState = mAllpassState.Get()[c];
+      uint32_t writeAddress = mWriteAddress;
+
+      for (auto s = 0; s < nFrames; s++)
+      {
+        buffer[writeAddress] = inputs[c][s];
+
+        const T delay = Clip(delayTimes[s], minDelay, maxDelay);
+        const T wholeDelay = std::floor(delay);
+        const T frac = delay - wholeDelay;
+        const uint32_t readAddress = writeAddress - static_cast<uint32_t>(wholeDelay);
+
+        const T x0 = buffer[readAddress & mMask];
+        const T x1 = buffer[(readAddress - 1) & mMask];
+
+        switch (interpolation)
         {
-          T input = inputs[c][s];
-          const int offset = c * mDTSamples;
-          outputs[c][s] = buffer[offset + readAddress];
-          buffer[offset + mWriteAddress] = input;
+          case EInterpolation::Linear:
+            outputs[c][s] = x0 + frac * (x1 - x0);
+            break;
+          case EInterpolation::Lagrange:
+          {
+            const T xm1 = buffer[(readAddress + 1) & mMask];
+            const T x2 = buffer[(readAddress - 2) & mMask];
+            const T d1 = frac - T(1);
+            const T d2 = frac - T(2);
+            const T d3 = frac + T(1);
+            const T c0 = -frac * d1 * d2 / T(6);
+            const T c1 = d3 * d1 * d2 / T(2);
+            const T c2 = -d3 * frac * d2 / T(2);
+            const T c3 = d3 * frac * d1 / T(6);
+            outputs[c][s] = c0 * xm1 + c1 * x0 + c2 * x1 + c3 * x2;
+            break;
+          }
+          case EInterpolation::Allpass:
+          {
+            // a fraction near 0 makes the coefficient near 1 and the filter ring, so the delay is a sample longer with a fraction near 1 instead
+            const bool shift = frac < T(0.1) && wholeDelay >= T(1);
+            const T f = shift ? frac + T(1) : frac;
+            const T a = (T(1) - f) / (T(1) + f);
+            const T xa = shift ? buffer[(readAddress + 1) & mMask] : x0;
+            const T xb = shift ? x0 : x1;
+            allpassState = a * (xa - allpassState) + xb;
+            outputs[c][s] = allpassState;
+            break;
+          }
         }
-      }
 
-      mWriteAddress++;
-      mWriteAddress %= mDTSamples;
+        writeAddress = (writeAddress + 1) & mMask;
+      }
     }
+
+    mWriteAddress = (mWriteAddress + nFrames) & mMask;
   }
 
+  /** @return The longest delay that the buffer holds, in samples */
+  int GetMaxDelayTime() const { return mMaxDelay; }
+
 private:
-  WDL_TypedBuf<T> mBuffer;
-  uint32_t mNInChans, mNOutChans;
+  WDL_TypedBuf<T> mBuffer; // mSize samples for each input channel
+  WDL_TypedBuf<T> mAllpassState; // the last output of each channel, for EInterpolation::Allpass
+  int mNInChans, mNOutChans;
+  int mSize = 0;
+  int mMaxDelay = -1;
+  uint32_t mMask = 0;
   uint32_t mWriteAddress = 0;
   uint32_t mDTSamples = 0;
 } WDL_FIXALIGN;
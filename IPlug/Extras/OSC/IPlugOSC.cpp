@@ -167,6 +167,7 @@ void OSCDevice::RunOutput()
   SET_SOCK_BLOCK(mSendSocket, false);
 
   mSendQueue.Clear();
+  mQueuedAddresses.clear();
 }
 
 void OSCDevice::AddInstance(void(*callback)(void* d1, int dev_idx, int msglen, void* msg), void* d1, int dev_idx)
@@ -183,11 +184,33 @@ void OSCDevice::OnMessage(char type, const unsigned char* msg, int len)
     if (r[x].callback) r[x].callback(r[x].data1, r[x].dev_idx, len, (void*)msg);
 }
 
-void OSCDevice::SendOSC(const char* src, int len)
+void OSCDevice::SendOSC(const char* src, int len, bool coalesce)
 {
   if (!mSendQueue.GetSize())
     mSendQueue.Add(nullptr, 16);
 
+  if (coalesce)
+  {
+    const std::string address(src, strnlen(src, len));
+    auto it = mQueuedAddresses.find(address);
+
+    // nothing is read from the queue until RunOutput(), so the offset is still valid
+    if (it != mQueuedAddresses.end())
+    {
+      char* pQueued = (char*) mSendQueue.Get() + it->second;
+      int queuedLen = *(int*) pQueued;
+      OSC_MAKEINTMEM4BE(&queuedLen);
+
+      if (queuedLen == len)
+      {
+        memcpy(pQueued + sizeof(int), src, len);
+        return;
+      }
+    }
+
+    mQueuedAddresses[address] = mSendQueue.GetSize();
+  }
+
   int tlen = len;
   OSC_MAKEINTMEM4BE(&tlen);
   mSendQueue.Add(&tlen, sizeof(tlen));
@@ -221,6 +244,44 @@ void OSCInterface::MessageCallback(void* d1, int dev_idx, int len, void* msg)
   }
 }
 
+void OSCInterface::ProcessPacket(char* buf, int len, OSCTimeTag timeTag, int depth)
+{
+  if (len >= 16 && !memcmp(buf, "#bundle", 8))
+  {
+    if (depth >= OSC_MAX_BUNDLE_DEPTH)
+      return;
+
+    // the timetag, then elements which are each an int size and a message or a bundle
+    OSCTimeTag bundleTimeTag = 0;
+    for (auto i = 0; i < 8; i++)
+      bundleTimeTag = (bundleTimeTag << 8) | (unsigned char) buf[8 + i];
+
+    int pos = 16;
+
+    while (pos + (int) sizeof(int) <= len)
+    {
+      int sz = *(int*)(buf + pos);
+      OSC_MAKEINTMEM4BE(&sz);
+      pos += sizeof(int);
+
+      if (sz < 1 || sz > len - pos)
+        break;
+
+      ProcessPacket(buf + pos, sz, bundleTimeTag, depth + 1);
+      pos += sz;
+    }
+  }
+  else
+  {
+    OscMessageRead rmsg(buf, len);
+    rmsg.SetTimeTag(timeTag);
+
+    const char* mstr = rmsg.GetMessage();
+    if (mstr && *mstr)
+      OnOSCMessage(rmsg);
+  }
+}
+
 void OSCInterface::OnTimer(Timer& timer)
 {
   const int nDevices = gDevices.GetSize();
@@ -252,30 +313,7 @@ void OSCInterface::OnTimer(Timer& timer)
       if (pos + this_sz > endpos) break;
       pos += this_sz;
 
-      int rd_pos = 0;
-      int rd_sz = evt->sz;
-      if (evt->sz > 20 && !strcmp((char*)evt->msg, "#bundle"))
-      {
-        rd_sz = *(int*)(evt->msg + 16);
-        OSC_MAKEINTMEM4BE(&rd_sz);
-        rd_pos += 20;
-      }
-      //        if (m_var_msgs[3]) m_var_msgs[3][0] = evt->dev_ptr ? *evt->dev_ptr : -1.0;
-
-      while (rd_pos + rd_sz <= evt->sz && rd_sz >= 0)
-      {
-        OscMessageRead rmsg((char*)evt->msg + rd_pos, rd_sz);
-
-        const char* mstr = rmsg.GetMessage();
-        if (mstr && *mstr)
-          OnOSCMessage(rmsg);
-
-        rd_pos += rd_sz + 4;
-        if (rd_pos >= evt->sz) break;
-
-        rd_sz = *(int*)(evt->msg + rd_pos - 4);
-        OSC_MAKEINTMEM4BE(&rd_sz);
-      }
+      ProcessPacket((char*)evt->msg, evt->sz, OSC_TIMETAG_IMMEDIATE);
     }
   }
 
@@ -439,11 +477,16 @@ void OSCSender::SetDestination(const char* ip, int port)
   }
 }
 
-void OSCSender::SendOSCMessage(OscMessageWrite& msg)
+void OSCSender::SendOSCMessage(OscMessageWrite& msg, bool coalesce)
 {
+  if (!mDevice)
+    return;
+
   int len;
   const char* msgStr = msg.GetBuffer(&len);
-  mDevice->SendOSC(msgStr, len);
+
+  if (len > 0)
+    mDevice->SendOSC(msgStr, len, coalesce);
 }
 
 OSCReceiver::OSCReceiver(int port, OSCLogFunc logFunc)
@@ -17,16 +17,22 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <ctime>
 #include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "jnetlib/jnetlib.h"
 
 #include "IPlugPlatform.h"
 #include "IPlugLogger.h"
 #include "IPlugOSC_msg.h"
+#include "IPlugQueue.h"
 #include "IPlugTimer.h"
 
 
@@ -36,6 +42,10 @@ BEGIN_IPLUG_NAMESPACE
 static constexpr int OSC_TIMER_RATE = 100;
 #endif
 
+#ifndef OSC_MAX_BUNDLE_DEPTH
+static constexpr int OSC_MAX_BUNDLE_DEPTH = 8; // how deeply bundles can be nested in a received packet
+#endif
+
 using OSCLogFunc = std::function<void(WDL_String& log)>;
 
 /** \todo */
@@ -66,10 +76,11 @@ public:
    * @param len */
   void OnMessage(char type, const unsigned char* msg, int len);
   
-  /** \todo
-   * @param src 
-   * @param len */
-  void SendOSC(const char* src, int len);
+  /** Queue a message, which is sent with the others queued in the same timer tick, in as few bundles as fit in the packet size
+   * @param src The message
+   * @param len The length of the message in bytes
+   * @param coalesce If \c true, and a message with the same address and length is queued, it is replaced by this one, so that only the latest value is sent */
+  void SendOSC(const char* src, int len, bool coalesce = false);
 
 private:
   struct rec
@@ -91,6 +102,7 @@ public:
   
   struct sockaddr_in mSendAddress, mReceiveAddress;
   WDL_Queue mSendQueue, mReceiveQueue;
+  std::unordered_map<std::string, int> mQueuedAddresses; // address -> offset of the latest message queued with it in mSendQueue
 };
 
 /** \todo */
@@ -137,6 +149,10 @@ public:
 private:
   static void MessageCallback(void *d1, int dev_idx, int msglen, void *msg);
 
+  /** Call OnOSCMessage() for a received message, or for each message in a bundle and the bundles nested in it
+   * @param timeTag The timetag of the enclosing bundle, given to messages */
+  void ProcessPacket(char* buf, int len, OSCTimeTag timeTag, int depth = 0);
+
   void OnTimer(Timer& timer);
   
   // these are non-owned refs
@@ -165,9 +181,10 @@ public:
    * @param port */
   void SetDestination(const char* ip, int port);
   
-  /**
-   * @param msg */
-  void SendOSCMessage(OscMessageWrite& msg);
+  /** Queue a message, to be sent in a bundle with the others sent in the same timer tick
+   * @param msg The message
+   * @param coalesce If \c true, a message queued earlier in the tick with the same address and arguments is replaced, e.g. for parameter values */
+  void SendOSCMessage(OscMessageWrite& msg, bool coalesce = false);
 private:
   int mPort = 0;
   WDL_String mDestIP;
@@ -186,7 +203,8 @@ public:
    * @param port */
   void SetReceivePort(int port);
   
-  /** \todo */
+  /** Called on the main thread for each message received. A message in a bundle has the bundle's timetag, see OscMessageRead::GetTimeTag(),
+   * and can be forwarded to the audio thread with an OSCScheduler so that it takes effect at that time */
   virtual void OnOSCMessage(OscMessageRead& msg) = 0;
   
 private:
@@ -195,5 +213,115 @@ private:
   char mReadBuf[MAX_OSC_MSG_LEN] = {};
 };
 
+/** Schedules items, such as parameter values, that were received in OSC bundles with timetags, so that they take effect on the audio thread at the sample their timetag refers to.
+ * Items are pushed on the main thread, typically from OSCReceiver::OnOSCMessage(), and ProcessBlock() calls a function for each item that is due in the block, with its frame offset.
+ * The time of each block is estimated from the system clock, smoothed so that the jitter of the audio callback doesn't move the items, so timetags are only
+ * sample-accurate if the sender's clock is synchronized with this machine's, e.g. by NTP. An item whose time has passed, or without a timetag, is given to the next block at offset 0
+ * @tparam T The item type, which is copied through a lock-free queue */
+template <typename T>
+class OSCScheduler
+{
+public:
+  /** @param size The maximum number of items that can be pending */
+  OSCScheduler(int size = 1024)
+  : mQueue(size)
+  {
+    mPending.reserve(size);
+  }
+
+  OSCScheduler(const OSCScheduler&) = delete;
+  OSCScheduler& operator=(const OSCScheduler&) = delete;
+
+  /** Schedule an item. Call this on the main thread
+   * @param timeTag When the item should take effect, e.g. OscMessageRead::GetTimeTag()
+   * @return \c false if the queue is full */
+  bool Push(OSCTimeTag timeTag, const T& item)
+  {
+    // timetags are compared with wrap around, which OSC_TIMETAG_IMMEDIATE doesn't work with
+    return mQueue.Push(Event {timeTag > OSC_TIMETAG_IMMEDIATE ? timeTag : OSCTimeTagNow(), item});
+  }
+
+  /** Call this at the start of each block on the audio thread
+   * @param func Called with the frame offset in the block and the item, in time order, for each item that is due in the block */
+  template <class F>
+  void ProcessBlock(int nFrames, double sampleRate, F&& func)
+  {
+    const OSCTimeTag blockStart = UpdateClock(nFrames, sampleRate);
+
+    Event event;
+    while (mQueue.Pop(event))
+    {
+      if (mPending.size() < mPending.capacity()) // doesn't allocate
+      {
+        auto it = std::upper_bound(mPending.begin(), mPending.end(), event, [](const Event& a, const Event& b) {
+          return static_cast<int64_t>(a.timeTag - b.timeTag) < 0;
+        });
+        mPending.insert(it, event);
+      }
+    }
+
+    size_t nDue = 0;
+
+    for (; nDue < mPending.size(); nDue++)
+    {
+      const double offset = OSCTimeTagDiff(blockStart, mPending[nDue].timeTag) * sampleRate;
+
+      if (offset >= nFrames)
+        break;
+
+      func(offset > 0. ? static_cast<int>(offset) : 0, static_cast<const T&>(mPending[nDue].item));
+    }
+
+    mPending.erase(mPending.begin(), mPending.begin() + nDue);
+  }
+
+  /** Discard the pending items, e.g. from OnReset(). Call this on the audio thread */
+  void Clear()
+  {
+    Event event;
+    while (mQueue.Pop(event)) {}
+    mPending.clear();
+    mBlockStart = 0;
+  }
+
+private:
+  struct Event
+  {
+    OSCTimeTag timeTag;
+    T item;
+  };
+
+  /** @return The time of the first sample of the block, which follows on from the last block unless it has drifted from the system clock by more than kMaxClockError */
+  OSCTimeTag UpdateClock(int nFrames, double sampleRate)
+  {
+    static constexpr double kMaxClockError = 0.05; // seconds
+    static constexpr double kClockSmoothing = 0.01;
+
+    const OSCTimeTag now = OSCTimeTagNow();
+
+    if (mBlockStart)
+    {
+      const OSCTimeTag predicted = mBlockStart + static_cast<OSCTimeTag>(mLastNFrames / mLastSampleRate * 4294967296.);
+      const double error = OSCTimeTagDiff(predicted, now);
+
+      if (std::fabs(error) < kMaxClockError)
+        mBlockStart = predicted + static_cast<OSCTimeTag>(static_cast<int64_t>(error * kClockSmoothing * 4294967296.));
+      else
+        mBlockStart = now;
+    }
+    else
+      mBlockStart = now;
+
+    mLastNFrames = nFrames;
+    mLastSampleRate = sampleRate;
+    return mBlockStart;
+  }
+
+  IPlugQueue<Event> mQueue;
+  std::vector<Event> mPending; // sorted by time, only used by the audio thread
+  OSCTimeTag mBlockStart = 0;
+  int mLastNFrames = 0;
+  double mLastSampleRate = 44100.;
+};
 
 END_IPLUG_NAMESPACE
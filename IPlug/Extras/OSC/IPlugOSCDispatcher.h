@@ -0,0 +1,401 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc OSCDispatcher
+ */
+
+#include <bitset>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IPlugConstants.h"
+#include "IPlugParameter.h"
+#include "IPlugOSC_msg.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Called on the main thread with a message whose address matched the one it was bound to */
+using OSCMessageFunc = std::function<void(OscMessageRead& msg)>;
+
+/** Called on the main thread to set a parameter bound with OSCDispatcher::BindParam(), e.g. with IPlugAPIBase::SetParameterValue() and SendParameterValueFromDelegate() */
+using OSCParamFunc = std::function<void(int paramIdx, double normalizedValue)>;
+
+/** An OSC pattern for one part of an address, between slashes, precompiled from the OSC wildcards:
+ * `?` matches any character, `*` any sequence of characters, `[abc]`, `[a-z]` and `[!abc]` a character in or not in a set, and `{foo,bar}` any of a list of strings */
+class OSCPattern
+{
+public:
+  /** @return \c true if a part of an address has any wildcards */
+  static bool IsPattern(const char* str, size_t len)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      if (strchr("?*[]{}", str[i]))
+        return true;
+    }
+
+    return false;
+  }
+
+  OSCPattern(const char* str, size_t len)
+  {
+    size_t i = 0;
+
+    while (i < len)
+    {
+      Token token;
+      const char c = str[i++];
+
+      if (c == '?')
+        token.type = Token::kAnyChar;
+      else if (c == '*')
+      {
+        token.type = Token::kAnySequence;
+
+        while (i < len && str[i] == '*') // ** is the same as *
+          i++;
+      }
+      else if (c == '[')
+      {
+        token.type = Token::kSet;
+        bool negate = false;
+
+        if (i < len && str[i] == '!')
+        {
+          negate = true;
+          i++;
+        }
+
+        while (i < len && str[i] != ']')
+        {
+          if (i + 2 < len && str[i + 1] == '-' && str[i + 2] != ']')
+          {
+            for (int ch = static_cast<unsigned char>(str[i]); ch <= static_cast<unsigned char>(str[i + 2]); ch++)
+              token.set.set(ch);
+
+            i += 3;
+          }
+          else
+            token.set.set(static_cast<unsigned char>(str[i++]));
+        }
+
+        i++; // ]
+
+        if (negate)
+          token.set.flip();
+      }
+      else if (c == '{')
+      {
+        token.type = Token::kAlternatives;
+        std::string alternative;
+
+        while (i < len && str[i] != '}')
+        {
+          if (str[i] == ',')
+          {
+            token.alternatives.push_back(alternative);
+            alternative.clear();
+          }
+          else
+            alternative += str[i];
+
+          i++;
+        }
+
+        i++; // }
+        token.alternatives.push_back(alternative);
+      }
+      else
+      {
+        if (!mTokens.empty() && mTokens.back().type == Token::kLiteral)
+        {
+          mTokens.back().literal += c;
+          continue;
+        }
+
+        token.type = Token::kLiteral;
+        token.literal = c;
+      }
+
+      mTokens.push_back(std::move(token));
+    }
+  }
+
+  /** @return \c true if the pattern matches a part of an address */
+  bool Matches(const char* str, size_t len) const
+  {
+    return Match(0, str, len);
+  }
+
+private:
+  struct Token
+  {
+    enum EType { kLiteral, kAnyChar, kAnySequence, kSet, kAlternatives };
+
+    EType type = kLiteral;
+    std::string literal;
+    std::bitset<256> set;
+    std::vector<std::string> alternatives;
+  };
+
+  bool Match(size_t tokenIdx, const char* str, size_t len) const
+  {
+    if (tokenIdx == mTokens.size())
+      return len == 0;
+
+    const Token& token = mTokens[tokenIdx];
+
+    switch (token.type)
+    {
+      case Token::kLiteral:
+        return len >= token.literal.size() && !token.literal.compare(0, token.literal.size(), str, token.literal.size())
+            && Match(tokenIdx + 1, str + token.literal.size(), len - token.literal.size());
+      case Token::kAnyChar:
+        return len > 0 && Match(tokenIdx + 1, str + 1, len - 1);
+      case Token::kSet:
+        return len > 0 && token.set.test(static_cast<unsigned char>(*str)) && Match(tokenIdx + 1, str + 1, len - 1);
+      case Token::kAnySequence:
+        for (size_t n = 0; n <= len; n++)
+        {
+          if (Match(tokenIdx + 1, str + n, len - n))
+            return true;
+        }
+        return false;
+      case Token::kAlternatives:
+        for (const std::string& alternative : token.alternatives)
+        {
+          if (len >= alternative.size() && !alternative.compare(0, alternative.size(), str, alternative.size())
+              && Match(tokenIdx + 1, str + alternative.size(), len - alternative.size()))
+            return true;
+        }
+        return false;
+    }
+
+    return false;
+  }
+
+  std::vector<Token> mTokens;
+};
+
+/** Routes received OSC messages to parameters and callbacks by their address, instead of comparing the address with each one in OnOSCMessage().
+ * The bound addresses are kept in a tree with a node per part of the address: parts without wildcards are found in a hash table, so routing a message costs
+ * in proportion to the length of its address, and parts with wildcards, e.g. `/track/[1-8]/volume`, are precompiled into an OSCPattern when they are bound.
+ * A message whose address has wildcards is dispatched to all the bound addresses without wildcards that it matches, as in the OSC specification.
+ *
+ * @code
+ * OSCDispatcher mDispatcher {[this](int paramIdx, double value) { SetParameterValue(paramIdx, value); SendParameterValueFromDelegate(paramIdx, value, true); }};
+ * mDispatcher.BindParam("/gain", kGain);
+ * mDispatcher.Bind("/transport/play", [this](OscMessageRead& msg) { ... });
+ *
+ * void OnOSCMessage(OscMessageRead& msg) override { mDispatcher.Dispatch(msg); }
+ * @endcode
+ * @ingroup IPlugExtras */
+class OSCDispatcher
+{
+public:
+  /** @param paramFunc Sets the parameters bound with BindParam() */
+  OSCDispatcher(OSCParamFunc paramFunc = nullptr)
+  : mParamFunc(paramFunc)
+  {}
+
+  OSCDispatcher(const OSCDispatcher&) = delete;
+  OSCDispatcher& operator=(const OSCDispatcher&) = delete;
+
+  void SetParamFunc(OSCParamFunc paramFunc) { mParamFunc = paramFunc; }
+
+  /** Call a function for the messages sent to an address
+   * @param address The address, which may have wildcards */
+  void Bind(const char* address, OSCMessageFunc func)
+  {
+    Binding binding;
+    binding.func = func;
+    GetNode(address).bindings.push_back(std::move(binding));
+  }
+
+  /** Set a parameter from the first argument, an int or a float, of the messages sent to an address
+   * @param address The address, which may have wildcards
+   * @param paramIdx The parameter, which is set with the OSCParamFunc
+   * @param pParam If given, the argument is a value of the parameter, which is normalized by it, otherwise the argument is a normalized value */
+  void BindParam(const char* address, int paramIdx, const IParam* pParam = nullptr)
+  {
+    Binding binding;
+    binding.paramIdx = paramIdx;
+    binding.pParam = pParam;
+    GetNode(address).bindings.push_back(std::move(binding));
+  }
+
+  /** Remove all the bindings */
+  void Clear()
+  {
+    mRoot = Node();
+  }
+
+  /** Route a message to everything bound to its address
+   * @return \c true if any binding matched */
+  bool Dispatch(OscMessageRead& msg)
+  {
+    const char* address = msg.GetMessage();
+
+    if (!address || *address != '/')
+      return false;
+
+    return Dispatch(mRoot, address + 1, msg);
+  }
+
+private:
+  struct Binding
+  {
+    OSCMessageFunc func;
+    int paramIdx = kNoParameter;
+    const IParam* pParam = nullptr;
+  };
+
+  struct Node
+  {
+    std::unordered_map<std::string, std::unique_ptr<Node>> children; // parts without wildcards
+    std::vector<std::pair<OSCPattern, std::unique_ptr<Node>>> patternChildren;
+    std::vector<std::string> patternStrings; // the sources of patternChildren, to find them again when binding
+    std::vector<Binding> bindings;
+  };
+
+  /** @return The node of an address, which is added if it isn't bound yet */
+  Node& GetNode(const char* address)
+  {
+    Node* pNode = &mRoot;
+
+    if (*address == '/')
+      address++;
+
+    while (*address)
+    {
+      const char* end = strchr(address, '/');
+      const size_t len = end ? end - address : strlen(address);
+      std::string part(address, len);
+
+      if (OSCPattern::IsPattern(address, len))
+      {
+        size_t i = 0;
+
+        while (i < pNode->patternStrings.size() && pNode->patternStrings[i] != part)
+          i++;
+
+        if (i == pNode->patternStrings.size())
+        {
+          pNode->patternChildren.emplace_back(OSCPattern(address, len), std::make_unique<Node>());
+          pNode->patternStrings.push_back(part);
+        }
+
+        pNode = pNode->patternChildren[i].second.get();
+      }
+      else
+      {
+        std::unique_ptr<Node>& pChild = pNode->children[part];
+
+        if (!pChild)
+          pChild = std::make_unique<Node>();
+
+        pNode = pChild.get();
+      }
+
+      address += len;
+
+      if (*address == '/')
+        address++;
+    }
+
+    return *pNode;
+  }
+
+  bool Dispatch(Node& node, const char* address, OscMessageRead& msg)
+  {
+    if (!*address)
+    {
+      for (Binding& binding : node.bindings)
+        CallBinding(binding, msg);
+
+      return !node.bindings.empty();
+    }
+
+    const char* end = strchr(address, '/');
+    const size_t len = end ? end - address : strlen(address);
+    const char* next = end ? end + 1 : address + len;
+    bool matched = false;
+
+    if (OSCPattern::IsPattern(address, len)) // the message's address has wildcards, which can match any of the children
+    {
+      const OSCPattern pattern(address, len);
+
+      for (auto& child : node.children)
+      {
+        if (pattern.Matches(child.first.c_str(), child.first.size()))
+          matched |= Dispatch(*child.second, next, msg);
+      }
+
+      for (size_t i = 0; i < node.patternStrings.size(); i++)
+      {
+        if (node.patternStrings[i].size() == len && !node.patternStrings[i].compare(0, len, address, len))
+          matched |= Dispatch(*node.patternChildren[i].second, next, msg);
+      }
+
+      return matched;
+    }
+
+    mPart.assign(address, len); // reuses the capacity of the string, so it doesn't allocate
+    auto it = node.children.find(mPart);
+
+    if (it != node.children.end())
+      matched |= Dispatch(*it->second, next, msg);
+
+    for (auto& child : node.patternChildren)
+    {
+      if (child.first.Matches(address, len))
+        matched |= Dispatch(*child.second, next, msg);
+    }
+
+    return matched;
+  }
+
+  void CallBinding(Binding& binding, OscMessageRead& msg)
+  {
+    if (binding.func)
+    {
+      binding.func(msg);
+      return;
+    }
+
+    if (!mParamFunc)
+      return;
+
+    double value;
+
+    if (const float* pFloat = msg.PopFloatArg(true))
+      value = *pFloat;
+    else if (const int* pInt = msg.PopIntArg(true))
+      value = *pInt;
+    else
+      return;
+
+    mParamFunc(binding.paramIdx, binding.pParam ? binding.pParam->ToNormalized(value) : Clip(value, 0., 1.));
+  }
+
+  Node mRoot;
+  OSCParamFunc mParamFunc;
+  std::string mPart;
+};
+
+END_IPLUG_NAMESPACE
@@ -17,6 +17,9 @@
  *
  */
 
+#include <chrono>
+#include <cstdint>
+
 #include "IPlugPlatform.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -24,6 +27,28 @@ BEGIN_IPLUG_NAMESPACE
 #define MAX_OSC_MSG_LEN 1024
 #undef GetMessage 
 
+/** An OSC timetag, which is an NTP timestamp: the seconds since 1900 in the top 32 bits, and the fraction of a second in the bottom 32 bits */
+using OSCTimeTag = uint64_t;
+
+/** The timetag of a message that should be handled as soon as it is received, which is the timetag of messages that aren't in a bundle */
+static constexpr OSCTimeTag OSC_TIMETAG_IMMEDIATE = 1;
+
+/** @return The current time of the system clock as an OSC timetag */
+static inline OSCTimeTag OSCTimeTagNow()
+{
+  static constexpr uint64_t kSecondsFrom1900To1970 = 2208988800ull;
+  const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+  const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+  const uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - seconds).count();
+  return ((seconds.count() + kSecondsFrom1900To1970) << 32) | ((nanoseconds << 32) / 1000000000ull);
+}
+
+/** @return The time from one timetag to another in seconds, which is negative if to is before from */
+static inline double OSCTimeTagDiff(OSCTimeTag from, OSCTimeTag to)
+{
+  return static_cast<double>(static_cast<int64_t>(to - from)) / 4294967296.;
+}
+
 static void OSC_BSWAPINTMEM(void *buf)
 {
   char *p=(char *)buf;
@@ -72,7 +97,12 @@ public:
   const float* PopFloatArg(bool peek);
   const char* PopStringArg(bool peek);
   void DebugDump(const char* label, char* dump, int dumplen);
+
+  // the timetag of the bundle the message was received in, or OSC_TIMETAG_IMMEDIATE
+  OSCTimeTag GetTimeTag() const { return m_timetag; }
+  void SetTimeTag(OSCTimeTag timetag) { m_timetag=timetag; }
 private:
+  OSCTimeTag m_timetag=OSC_TIMETAG_IMMEDIATE;
   char* m_msg_end;
   char* m_type_end;
   char* m_arg_end;
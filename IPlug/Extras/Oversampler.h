@@ -14,14 +14,21 @@
 
 #include <functional>
 #include <cmath>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
 
 #include "HIIR/FPUUpsampler2x.h"
 #include "HIIR/FPUDownsampler2x.h"
+#include "HIIR/SIMDUpsampler2x.h"
+#include "HIIR/SIMDDownsampler2x.h"
 
 #include "heapbuf.h"
 #include "ptrlist.h"
 
 #include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugMemoryAccounting.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -37,77 +44,96 @@ enum EFactor
   kNumFactors
 };
 
+/** The filters of the 2x stages of an OverSampler, which trade CPU use against alias rejection and phase */
+enum class EOverSamplingQuality
+{
+  Eco, // minimum phase polyphase IIR filters with fewer coefficients, with 55 to 75 dB of alias rejection for half the CPU use
+  Normal, // minimum phase polyphase IIR filters, with more than 100 dB of alias rejection
+  LinearPhase, // linear phase FIR halfband filters, which keep the phase of the signal but delay it, see OverSampler::GetLatency()
+  kNumQualities
+};
+
 template<typename T = double>
 class OverSampler
 {
 public:
   using BlockProcessFunc = std::function<void(T**, T**, int)>;
+  using LatencyFunc = std::function<void(int latency)>;
   
-  OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nInChannels = 1, int nOutChannels = 1)
+  OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nInChannels = 1, int nOutChannels = 1, EOverSamplingQuality quality = EOverSamplingQuality::Normal)
   : mBlockProcessing(blockProcessing)
   , mNInChannels(nInChannels)
   , mNOutChannels(nOutChannels)
   {
-    
     static constexpr double coeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
     static constexpr double coeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
     static constexpr double coeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
     static constexpr double coeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
 
+    // PolyphaseIIR2Designer::compute_coefs_spec_order_tbw() with wider transition bands: 74.5, 63.2, 54.7 and 72.9 dB of rejection
+    static constexpr double ecoCoeffs2x[6] = { 0.068204076045056364, 0.24027035797224575, 0.44867623592608163, 0.64112236714554882, 0.79999756368992903, 0.93448223553476439 };
+    static constexpr double ecoCoeffs4x[2] = { 0.13645686526777315, 0.58214799665627603 };
+    static constexpr double ecoCoeffs8x[1] = { 0.34611020894171052 };
+    static constexpr double ecoCoeffs16x[1] = { 0.33645041765606504 };
+
+    // the half lengths of the linear phase filters, the first stage has the narrowest transition band
+    static constexpr int firHalfLengths[4] = { 64, 8, 4, 3 };
+
+    auto createStages = [this](EOverSamplingQuality quality, int nChans, bool up) {
+      auto& stages = mStages[static_cast<int>(quality)][up ? 0 : 1];
+
+      if (quality == EOverSamplingQuality::Eco)
+      {
+        stages[0] = std::make_unique<IIRStage<6>>(nChans, up, ecoCoeffs2x);
+        stages[1] = std::make_unique<IIRStage<2>>(nChans, up, ecoCoeffs4x);
+        stages[2] = std::make_unique<IIRStage<1>>(nChans, up, ecoCoeffs8x);
+        stages[3] = std::make_unique<IIRStage<1>>(nChans, up, ecoCoeffs16x);
+      }
+      else if (quality == EOverSamplingQuality::Normal)
+      {
+        stages[0] = std::make_unique<IIRStage<12>>(nChans, up, coeffs2x);
+        stages[1] = std::make_unique<IIRStage<4>>(nChans, up, coeffs4x);
+        stages[2] = std::make_unique<IIRStage<3>>(nChans, up, coeffs8x);
+        stages[3] = std::make_unique<IIRStage<2>>(nChans, up, coeffs16x);
+      }
+      else
+      {
+        for (auto i = 0; i < 4; i++)
+          stages[i] = std::make_unique<FIRStage>(nChans, up, firHalfLengths[i]);
+      }
+    };
+
+    // the stages of every quality are made here, so that SetQuality() doesn't allocate
+    for (auto q = 0; q < static_cast<int>(EOverSamplingQuality::kNumQualities); q++)
+    {
+      createStages(static_cast<EOverSamplingQuality>(q), mNInChannels, true);
+      createStages(static_cast<EOverSamplingQuality>(q), mNOutChannels, false);
+    }
+
     for (auto c = 0; c < mNInChannels; c++)
     {
-      mUpsampler2x.Add(new Upsampler2xFPU<12, T>());
-      mUpsampler4x.Add(new Upsampler2xFPU<4, T>());
-      mUpsampler8x.Add(new Upsampler2xFPU<3, T>());
-      mUpsampler16x.Add(new Upsampler2xFPU<2, T>());
-      
-      mUpsampler2x.Get(c)->set_coefs(coeffs2x);
-      mUpsampler4x.Get(c)->set_coefs(coeffs4x);
-      mUpsampler8x.Get(c)->set_coefs(coeffs8x);
-      mUpsampler16x.Get(c)->set_coefs(coeffs16x);
-      
       // ptr location doesn't matter at this stage
       mNextInputPtrs.Add(mUp2x.Get());
     }
     
     for (auto c = 0; c < mNOutChannels; c++)
     {
-      mDownsampler2x.Add(new Downsampler2xFPU<12, T>());
-      mDownsampler4x.Add(new Downsampler2xFPU<4, T>());
-      mDownsampler8x.Add(new Downsampler2xFPU<3, T>());
-      mDownsampler16x.Add(new Downsampler2xFPU<2, T>());
-      
-      mDownsampler2x.Get(c)->set_coefs(coeffs2x);
-      mDownsampler4x.Get(c)->set_coefs(coeffs4x);
-      mDownsampler8x.Get(c)->set_coefs(coeffs8x);
-      mDownsampler16x.Get(c)->set_coefs(coeffs16x);
-      
       // ptr location doesn't matter at this stage
       mNextOutputPtrs.Add(mDown2x.Get());
     }
-        
+
+    mQuality = quality;
     SetOverSampling(factor);
     
     Reset();
   }
-  
-  ~OverSampler()
-  {
-    mUpsampler2x.Empty(true);
-    mDownsampler2x.Empty(true);
-    mUpsampler4x.Empty(true);
-    mDownsampler4x.Empty(true);
-    mUpsampler8x.Empty(true);
-    mDownsampler8x.Empty(true);
-    mUpsampler16x.Empty(true);
-    mDownsampler16x.Empty(true);
-  }
 
   OverSampler(const OverSampler&) = delete;
   OverSampler& operator=(const OverSampler&) = delete;
     
   void Reset(int blockSize = DEFAULT_BLOCK_SIZE)
   {
+    mBlockSize = blockSize;
     int numBufSamples = 1;
     
     if(mBlockProcessing)
@@ -118,7 +144,7 @@ public:
       blockSize = 1;
     }
     
-    numBufSamples *= mNInChannels;
+    numBufSamples *= std::max(mNInChannels, mNOutChannels);
     
     mUp2x.Resize(2 * numBufSamples);
     mUp4x.Resize(4 * numBufSamples);
@@ -129,6 +155,7 @@ public:
     mDown4x.Resize(4 * numBufSamples);
     mDown8x.Resize(8 * numBufSamples);
     mDown16x.Resize(16 * numBufSamples);
+    mMemoryCharge.Set(2 * (2 + 4 + 8 + 16) * numBufSamples * sizeof(T));
     
     mUp16BufferPtrs.Empty();
     mUp8BufferPtrs.Empty();
@@ -142,11 +169,6 @@ public:
     
     for (auto c = 0; c < mNInChannels; c++)
     {
-      mUpsampler2x.Get(c)->clear_buffers();
-      mUpsampler4x.Get(c)->clear_buffers();
-      mUpsampler8x.Get(c)->clear_buffers();
-      mUpsampler16x.Get(c)->clear_buffers();
-      
       mUp2BufferPtrs.Add(mUp2x.Get() + c * 2 * blockSize);
       mUp4BufferPtrs.Add(mUp4x.Get() + (c * 4 * blockSize));
       mUp8BufferPtrs.Add(mUp8x.Get() + (c * 8 * blockSize));
@@ -155,16 +177,20 @@ public:
     
     for (auto c = 0; c < mNOutChannels; c++)
     {
-      mDownsampler2x.Get(c)->clear_buffers();
-      mDownsampler4x.Get(c)->clear_buffers();
-      mDownsampler8x.Get(c)->clear_buffers();
-      mDownsampler16x.Get(c)->clear_buffers();
-      
       mDown2BufferPtrs.Add(mDown2x.Get() + c * 2 * blockSize);
       mDown4BufferPtrs.Add(mDown4x.Get() + (c * 4 * blockSize));
       mDown8BufferPtrs.Add(mDown8x.Get() + (c * 8 * blockSize));
       mDown16BufferPtrs.Add(mDown16x.Get() + (c * 16 * blockSize));
     }
+
+    for (auto& quality : mStages)
+    {
+      for (auto& direction : quality)
+      {
+        for (auto& stage : direction)
+          stage->Reset();
+      }
+    }
   }
 
   /** Over sample an input block with a per-block function (up sample input -> process with function -> down sample)
@@ -173,8 +199,10 @@ public:
    * @param nFrames The block size for this block: number of samples per channel.
    * @param nInChans The number of input channels to process. Must be less or equal to the number of channels passed to the constructor
    * @param nOutChans The number of output channels to process. Must be less or equal to the number of channels passed to the constructor
-   * @param func The function that processes the audio sample at the higher sampling rate. NOTE: std::function can call malloc if you pass in captures */
-  void ProcessBlock(T** inputs, T** outputs, int nFrames, int nInChans, int nOutChans, BlockProcessFunc func)
+   * @param func The function that processes the audio at the higher sampling rate, called as func(T** inputs, T** outputs, int nFrames). Any callable can be passed, e.g. a lambda with captures,
+   * and it is called directly rather than wrapped in a BlockProcessFunc, so this never allocates. nFrames must not be more than the block size passed to Reset() */
+  template <typename F>
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, int nInChans, int nOutChans, F&& func)
   {
     assert(nInChans <= mNInChannels);
     assert(nOutChans <= mNOutChannels);
@@ -205,20 +233,14 @@ public:
       mPrevRate = mRate;
     }
 
-    for(auto c = 0; c < nInChans; c++) {
-      if (mRate >= 2) {
-        mUpsampler2x.Get(c)->process_block(mUp2BufferPtrs.Get(c), inputs[c], nFrames);
-      }
-      if (mRate >= 4) {
-        mUpsampler4x.Get(c)->process_block(mUp4BufferPtrs.Get(c), mUp2BufferPtrs.Get(c), nFrames * 2);
-      }
-      if (mRate >= 8) {
-        mUpsampler8x.Get(c)->process_block(mUp8BufferPtrs.Get(c), mUp4BufferPtrs.Get(c), nFrames * 4);
-      }
-      if (mRate == 16) {
-        mUpsampler16x.Get(c)->process_block(mUp16BufferPtrs.Get(c), mUp8BufferPtrs.Get(c), nFrames * 8);
-      }
-    }
+    if (mRate >= 2)
+      UpStage(0).ProcessBlock(mUp2BufferPtrs.GetList(), inputs, nFrames, nInChans);
+    if (mRate >= 4)
+      UpStage(1).ProcessBlock(mUp4BufferPtrs.GetList(), mUp2BufferPtrs.GetList(), nFrames * 2, nInChans);
+    if (mRate >= 8)
+      UpStage(2).ProcessBlock(mUp8BufferPtrs.GetList(), mUp4BufferPtrs.GetList(), nFrames * 4, nInChans);
+    if (mRate == 16)
+      UpStage(3).ProcessBlock(mUp16BufferPtrs.GetList(), mUp8BufferPtrs.GetList(), nFrames * 8, nInChans);
     
     if (mRate == 1) {
       func(inputs, outputs, nFrames);
@@ -226,26 +248,22 @@ public:
       for (auto i = 0; i < mRate; i++) {
         for(auto c = 0; c < nInChans; c++) {
           mNextInputPtrs.Set(c, mInPtrLoopSrc->Get(c) + (i * nFrames));
+        }
+        for(auto c = 0; c < nOutChans; c++) {
           mNextOutputPtrs.Set(c, mOutPtrLoopSrc->Get(c) + (i * nFrames));
         }
         func(mNextInputPtrs.GetList(), mNextOutputPtrs.GetList(), nFrames);
       }
     }
     
-    for(auto c = 0; c < nOutChans; c++) {
-      if (mRate == 16) {
-        mDownsampler16x.Get(c)->process_block(mDown8BufferPtrs.Get(c), mDown16BufferPtrs.Get(c), nFrames * 8);
-      }
-      if (mRate >= 8) {
-        mDownsampler8x.Get(c)->process_block(mDown4BufferPtrs.Get(c), mDown8BufferPtrs.Get(c), nFrames * 4);
-      }
-      if (mRate >= 4) {
-        mDownsampler4x.Get(c)->process_block(mDown2BufferPtrs.Get(c), mDown4BufferPtrs.Get(c), nFrames * 2);
-      }
-      if (mRate >= 2) {
-        mDownsampler2x.Get(c)->process_block(outputs[c], mDown2BufferPtrs.Get(c), nFrames);
-      }
-    }
+    if (mRate == 16)
+      DownStage(3).ProcessBlock(mDown8BufferPtrs.GetList(), mDown16BufferPtrs.GetList(), nFrames * 8, nOutChans);
+    if (mRate >= 8)
+      DownStage(2).ProcessBlock(mDown4BufferPtrs.GetList(), mDown8BufferPtrs.GetList(), nFrames * 4, nOutChans);
+    if (mRate >= 4)
+      DownStage(1).ProcessBlock(mDown2BufferPtrs.GetList(), mDown4BufferPtrs.GetList(), nFrames * 2, nOutChans);
+    if (mRate >= 2)
+      DownStage(0).ProcessBlock(outputs, mDown2BufferPtrs.GetList(), nFrames, nOutChans);
   }
   
   /** Over sample an input sample with a per-sample function (up-sample input -> process with function -> down-sample)
@@ -256,63 +274,27 @@ public:
   {
     T output;
 
-    if(mRate == 16)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
-      mUpsampler16x.Get(0)->process_block(mUp16x.Get(), mUp8x.Get(), 8);
+    if (mRate == 1)
+      return func(input);
 
-      for (auto i = 0; i < 16; i++)
-      {
-        mDown16x.Get()[i] = func(mUp16x.Get()[i]);
-      }
+    T* pUp[4] = { mUp2x.Get(), mUp4x.Get(), mUp8x.Get(), mUp16x.Get() };
+    T* pDown[4] = { mDown2x.Get(), mDown4x.Get(), mDown8x.Get(), mDown16x.Get() };
+    const int nStages = static_cast<int>(mFactor);
 
-      mDownsampler16x.Get(0)->process_block(mDown8x.Get(), mDown16x.Get(), 8);
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else if (mRate == 8)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-      mUpsampler8x.Get(0)->process_block(mUp8x.Get(), mUp4x.Get(), 4);
+    ProcessSample(UpStage(0), pUp[0], &input, 1);
 
-      for (auto i = 0; i < 8; i++)
-      {
-        mDown8x.Get()[i] = func(mUp8x.Get()[i]);
-      }
+    for (auto s = 1; s < nStages; s++)
+      ProcessSample(UpStage(s), pUp[s], pUp[s - 1], 1 << s);
 
-      mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else if (mRate == 4)
+    for (auto i = 0; i < mRate; i++)
     {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
-      mUpsampler4x.Get(0)->process_block(mUp4x.Get(), mUp2x.Get(), 2);
-
-      for (auto i = 0; i < 4; i++)
-      {
-        mDown4x.Get()[i] = func(mUp4x.Get()[i]);
-      }
-
-      mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
+      pDown[nStages - 1][i] = func(pUp[nStages - 1][i]);
     }
-    else if (mRate == 2)
-    {
-      mUpsampler2x.Get(0)->process_sample(mUp2x.Get()[0], mUp2x.Get()[1], input);
 
-      mDown2x.Get()[0] = func(mUp2x.Get()[0]);
-      mDown2x.Get()[1] = func(mUp2x.Get()[1]);
-      output = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-    }
-    else
-    {
-      output = func(input);
-    }
+    for (auto s = nStages - 1; s > 0; s--)
+      ProcessSample(DownStage(s), pDown[s - 1], pDown[s], 1 << s);
+
+    ProcessSample(DownStage(0), &output, pDown[0], 1);
 
     return output;
   }
@@ -322,62 +304,8 @@ public:
    * @return The audio sample output */
   T ProcessGen(std::function<T()> genFunc)
   {
-    auto ProcessDown16x = [&](T input)
-    {
-      mDown16x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 15;
-
-      if(mWritePos == 0)
-      {
-        mDownsampler16x.Get(0)->process_block(mDown8x.Get(), mDown16x.Get(), 8);
-        mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown8x = [&](T input)
-    {
-      mDown8x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 7;
-
-      if(mWritePos == 0)
-      {
-        mDownsampler8x.Get(0)->process_block(mDown4x.Get(), mDown8x.Get(), 4);
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown4x = [&](T input)
-    {
-      mDown4x.Get()[mWritePos] = (T) input;
-
-      mWritePos++;
-      mWritePos &= 3;
-
-      if(mWritePos == 0)
-      {
-        mDownsampler4x.Get(0)->process_block(mDown2x.Get(), mDown4x.Get(), 2);
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
-
-    auto ProcessDown2x = [&](T input)
-    {
-      mDown2x.Get()[mWritePos] = (T) input;
-
-      mWritePos = !mWritePos;
-
-      if(mWritePos == 0)
-      {
-        mDownSamplerOutput = mDownsampler2x.Get(0)->process_sample(mDown2x.Get());
-      }
-    };
+    T* pDown[4] = { mDown2x.Get(), mDown4x.Get(), mDown8x.Get(), mDown16x.Get() };
+    const int nStages = static_cast<int>(mFactor);
 
     T output;
 
@@ -385,13 +313,20 @@ public:
     {
       output = genFunc();
 
-      switch(mRate)
+      if (mRate > 1)
       {
-        case 2: ProcessDown2x(output); break;
-        case 4: ProcessDown4x(output); break;
-        case 8: ProcessDown8x(output); break;
-        case 16: ProcessDown16x(output); break;
-        default: break;
+        pDown[nStages - 1][mWritePos] = output;
+
+        mWritePos++;
+        mWritePos &= mRate - 1;
+
+        if (mWritePos == 0)
+        {
+          for (auto s = nStages - 1; s > 0; s--)
+            ProcessSample(DownStage(s), pDown[s - 1], pDown[s], 1 << s);
+
+          ProcessSample(DownStage(0), &mDownSamplerOutput, pDown[0], 1);
+        }
       }
     }
 
@@ -401,6 +336,8 @@ public:
     return output;
   }
 
+  /** Change the oversampling factor. The buffers for all factors are allocated by Reset(), so once it has been called with the maximum block size this doesn't allocate and can be called on the audio thread, e.g. to raise the quality for offline rendering
+   * @param factor The new oversampling factor */
   void SetOverSampling(EFactor factor)
   {
     if(factor != mFactor)
@@ -408,8 +345,48 @@ public:
       mFactor = factor;
       mRate = std::pow(2, (int) factor);
       
-      Reset();
+      Reset(mBlockSize);
+      OnLatencyChanged();
+    }
+  }
+
+  /** Change the filters, e.g. to linear phase for mastering, or to eco for many instances. As with SetOverSampling(), the filters of all the qualities are made by the constructor, so this doesn't allocate
+   * @param quality The new quality */
+  void SetQuality(EOverSamplingQuality quality)
+  {
+    if (quality != mQuality)
+    {
+      mQuality = quality;
+
+      Reset(mBlockSize);
+      OnLatencyChanged();
+    }
+  }
+
+  EOverSamplingQuality GetQuality() const { return mQuality; }
+
+  /** @return The delay of the signal through the up and down sampling filters at the current factor and quality, in samples at the base rate, rounded to whole samples.
+   * For the linear phase filters this is the same at all frequencies, for the IIR filters it is the group delay at low frequencies, which rises towards the top of the band */
+  int GetLatency() const
+  {
+    double delay = 0.;
+
+    for (auto s = 0; s < static_cast<int>(mFactor); s++)
+    {
+      // the delay of each stage is in samples at its higher rate
+      const int stageRate = 2 << s;
+      delay += (mStages[static_cast<int>(mQuality)][0][s]->GetDelay() + mStages[static_cast<int>(mQuality)][1][s]->GetDelay()) / stageRate;
     }
+
+    return static_cast<int>(std::round(delay));
+  }
+
+  /** Set a function that is called with GetLatency() when the factor or quality changes, e.g. to report it to the host with IPlugProcessor::SetLatency()
+   * @param func The function, which is also called now */
+  void SetLatencyFunc(LatencyFunc func)
+  {
+    mLatencyFunc = func;
+    OnLatencyChanged();
   }
   
   static EFactor RateToFactor(int rate)
@@ -430,15 +407,311 @@ public:
     return mRate;
   }
 
+  /** @return The most frames ProcessBlock() can be called with, see Reset() */
+  int GetBlockSize() const { return mBlockProcessing ? mBlockSize : 1; }
+
+  int GetNInChannels() const { return mNInChannels; }
+  int GetNOutChannels() const { return mNOutChannels; }
+
 private:
+  /** A 2x up or down sampling stage of all the channels */
+  class Stage
+  {
+  public:
+    virtual ~Stage() {}
+
+    /** @param nFrames The number of samples in, for an up sampler, or out, for a down sampler */
+    virtual void ProcessBlock(T* const* outPtrs, const T* const* inPtrs, int nFrames, int nChans) = 0;
+
+    virtual void Reset() = 0;
+
+    /** @return The group delay at low frequencies, in samples at the higher rate */
+    virtual double GetDelay() const = 0;
+  };
+
+  /** A stage of HIIR minimum phase polyphase IIR filters, with a SIMD filter for each group of channels that share a vector, and an FPU filter for a channel on its own */
+  template <int NC>
+  class IIRStage : public Stage
+  {
+  public:
+    IIRStage(int nChans, bool up, const double* coeffs)
+    {
+      for (auto c = 0; c < nChans; c++)
+      {
+        if (up)
+          mFPUStages.Add(new FPUFilter(new Upsampler2xFPU<NC, T>()));
+        else
+          mFPUStages.Add(new FPUFilter(new Downsampler2xFPU<NC, T>()));
+      }
+
+      for (auto c = 0; c < nChans; c += kSIMDChannels)
+      {
+        const bool simd = nChans - c > 1;
+
+        if (simd && up)
+          mSIMDStages.Add(new SIMDFilter(new Upsampler2xSIMD<NC, T>()));
+        else if (simd)
+          mSIMDStages.Add(new SIMDFilter(new Downsampler2xSIMD<NC, T>()));
+        else
+          mSIMDStages.Add(nullptr);
+      }
+
+      ForAllFilters([coeffs](auto& filter) { filter.set_coefs(coeffs); });
+
+      // the group delay at DC of the first order all-pass sections, each of which is (a + z^-2) / (1 + a z^-2) at the higher rate, shared between the two branches
+      mDelay = 0.;
+
+      for (auto i = 0; i < NC; i++)
+        mDelay += (1. - coeffs[i]) / (1. + coeffs[i]);
+    }
+
+    ~IIRStage()
+    {
+      mFPUStages.Empty(true);
+      mSIMDStages.Empty(true);
+    }
+
+    void ProcessBlock(T* const* outPtrs, const T* const* inPtrs, int nFrames, int nChans) override
+    {
+      for (auto c = 0; c < nChans; c += kSIMDChannels)
+      {
+        const int nGroupChans = std::min(kSIMDChannels, nChans - c);
+
+        if (SIMDFilter* pSIMDStage = mSIMDStages.Get(c / kSIMDChannels))
+          pSIMDStage->Process(outPtrs + c, inPtrs + c, nFrames, nGroupChans);
+        else
+        {
+          for (auto i = c; i < c + nGroupChans; i++)
+            mFPUStages.Get(i)->Process(outPtrs[i], inPtrs[i], nFrames);
+        }
+      }
+    }
+
+    void Reset() override
+    {
+      ForAllFilters([](auto& filter) { filter.clear_buffers(); });
+    }
+
+    double GetDelay() const override { return mDelay; }
+
+  private:
+    /** The up or down sampler of a channel */
+    struct FPUFilter
+    {
+      FPUFilter(Upsampler2xFPU<NC, T>* pUp) : up(pUp) {}
+      FPUFilter(Downsampler2xFPU<NC, T>* pDown) : down(pDown) {}
+
+      void Process(T* pOut, const T* pIn, int nFrames)
+      {
+        if (up)
+          up->process_block(pOut, pIn, nFrames);
+        else
+          down->process_block(pOut, pIn, nFrames);
+      }
+
+      std::unique_ptr<Upsampler2xFPU<NC, T>> up;
+      std::unique_ptr<Downsampler2xFPU<NC, T>> down;
+    };
+
+    /** The up or down sampler of a group of channels */
+    struct SIMDFilter
+    {
+      SIMDFilter(Upsampler2xSIMD<NC, T>* pUp) : up(pUp) {}
+      SIMDFilter(Downsampler2xSIMD<NC, T>* pDown) : down(pDown) {}
+
+      void Process(T* const* outPtrs, const T* const* inPtrs, int nFrames, int nChans)
+      {
+        if (up)
+          up->process_block(outPtrs, inPtrs, nFrames, nChans);
+        else
+          down->process_block(outPtrs, inPtrs, nFrames, nChans);
+      }
+
+      std::unique_ptr<Upsampler2xSIMD<NC, T>> up;
+      std::unique_ptr<Downsampler2xSIMD<NC, T>> down;
+    };
+
+    template <class F>
+    void ForAllFilters(F func)
+    {
+      for (auto i = 0; i < mFPUStages.GetSize(); i++)
+      {
+        FPUFilter* pFilter = mFPUStages.Get(i);
+        if (pFilter->up) func(*pFilter->up); else func(*pFilter->down);
+      }
+
+      for (auto i = 0; i < mSIMDStages.GetSize(); i++)
+      {
+        if (SIMDFilter* pFilter = mSIMDStages.Get(i))
+        {
+          if (pFilter->up) func(*pFilter->up); else func(*pFilter->down);
+        }
+      }
+    }
+
+    WDL_PtrList<FPUFilter> mFPUStages;
+    WDL_PtrList<SIMDFilter> mSIMDStages; // null for a group of one channel
+    double mDelay;
+  };
+
+  /** A stage of linear phase halfband FIR filters, Kaiser windowed sincs of 4 * halfLength - 1 taps.
+   * Every other tap is zero except the middle one, so each output sample of an up sampler, or input pair of a down sampler, takes 2 * halfLength multiplies */
+  class FIRStage : public Stage
+  {
+  public:
+    FIRStage(int nChans, bool up, int halfLength)
+    : mUp(up)
+    , mHalfLength(halfLength)
+    , mNTaps(2 * halfLength)
+    {
+      static constexpr double kBeta = 10.; // about 100 dB of stop band rejection
+
+      auto besselI0 = [](double x) {
+        double sum = 1., term = 1.;
+        for (auto k = 1; k < 32; k++)
+        {
+          term *= (x / (2. * k)) * (x / (2. * k));
+          sum += term;
+        }
+        return sum;
+      };
+
+      // the taps at odd distances from the middle of the filter, whose middle tap is 0.5
+      const int middle = 2 * halfLength - 1;
+      double sum = 0.;
+      mTaps.Resize(mNTaps);
+
+      for (auto i = 0; i < mNTaps; i++)
+      {
+        const double n = 2 * i - middle;
+        const double window = besselI0(kBeta * std::sqrt(1. - (n / (middle + 1)) * (n / (middle + 1)))) / besselI0(kBeta);
+        const double tap = std::sin(PI * n / 2.) / (PI * n) * window;
+        mTaps.Get()[i] = static_cast<T>(tap);
+        sum += tap;
+      }
+
+      // the gain at DC of the branch is 1 for an up sampler, which makes up for the zeros between its input samples, and 0.5 for a down sampler
+      const double gain = up ? 1. : 0.5;
+
+      for (auto i = 0; i < mNTaps; i++)
+        mTaps.Get()[i] = static_cast<T>(mTaps.Get()[i] * gain / sum);
+
+      mDelay = middle;
+
+      // each history is a ring written twice, so that the newest mNTaps samples are contiguous from the write position
+      for (auto c = 0; c < nChans; c++)
+      {
+        mHistories.Add(new WDL_TypedBuf<T>);
+        mHistories.Get(c)->Resize(2 * mNTaps + 2 * (halfLength + 1));
+      }
+
+      Reset();
+    }
+
+    ~FIRStage()
+    {
+      mHistories.Empty(true);
+    }
+
+    void ProcessBlock(T* const* outPtrs, const T* const* inPtrs, int nFrames, int nChans) override
+    {
+      const int histPos = mPos;
+      const int oddPos = mOddPos;
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        T* pEven = mHistories.Get(c)->Get();
+        T* pOdd = pEven + 2 * mNTaps;
+        const T* pIn = inPtrs[c];
+        T* pOut = outPtrs[c];
+        int pos = histPos;
+        int odd = oddPos;
+
+        for (auto s = 0; s < nFrames; s++)
+        {
+          pos = pos == 0 ? mNTaps - 1 : pos - 1;
+          const T even = mUp ? pIn[s] : pIn[s * 2];
+          pEven[pos] = pEven[pos + mNTaps] = even;
+
+          T acc = 0;
+          const T* pHist = pEven + pos;
+
+          for (auto i = 0; i < mNTaps; i++)
+            acc += mTaps.Get()[i] * pHist[i];
+
+          if (mUp)
+          {
+            // the odd outputs are the input delayed to the middle of the filter
+            pOut[s * 2] = acc;
+            pOut[s * 2 + 1] = pHist[mHalfLength - 1];
+          }
+          else
+          {
+            // the odd inputs only meet the middle tap
+            odd = odd == 0 ? mHalfLength : odd - 1;
+            pOdd[odd] = pOdd[odd + mHalfLength + 1] = pIn[s * 2 + 1];
+            pOut[s] = acc + static_cast<T>(0.5) * pOdd[odd + mHalfLength];
+          }
+        }
+
+        if (c == nChans - 1)
+        {
+          mPos = pos;
+          mOddPos = odd;
+        }
+      }
+    }
+
+    void Reset() override
+    {
+      for (auto c = 0; c < mHistories.GetSize(); c++)
+        memset(mHistories.Get(c)->Get(), 0, mHistories.Get(c)->GetSize() * sizeof(T));
+
+      mPos = 0;
+      mOddPos = 0;
+    }
+
+    double GetDelay() const override { return mDelay; }
+
+  private:
+    bool mUp;
+    int mHalfLength;
+    int mNTaps;
+    int mPos = 0; // the write position of the histories, which is the same for every channel
+    int mOddPos = 0;
+    double mDelay;
+    WDL_TypedBuf<T> mTaps;
+    WDL_PtrList<WDL_TypedBuf<T>> mHistories; // for each channel the even samples, then for a down sampler the odd samples
+  };
+
+  static constexpr int kSIMDChannels = SIMDWidth<T>::VALUE; // the number of channels processed together by a SIMD stage
+
+  Stage& UpStage(int idx) { return *mStages[static_cast<int>(mQuality)][0][idx]; }
+  Stage& DownStage(int idx) { return *mStages[static_cast<int>(mQuality)][1][idx]; }
+
+  /** Run a stage on the first channel only, for Process() and ProcessGen() */
+  static void ProcessSample(Stage& stage, T* pOut, const T* pIn, int nFrames)
+  {
+    stage.ProcessBlock(&pOut, &pIn, nFrames, 1);
+  }
+
+  void OnLatencyChanged()
+  {
+    if (mLatencyFunc)
+      mLatencyFunc(GetLatency());
+  }
+
   EFactor mFactor = kNone;
+  EOverSamplingQuality mQuality = EOverSamplingQuality::Normal;
   int mPrevRate = 0;
   int mRate = 1;
   int mWritePos = 0;
+  int mBlockSize = DEFAULT_BLOCK_SIZE; // the block size passed to Reset()
   T mDownSamplerOutput = 0.;
   bool mBlockProcessing; // false
   int mNInChannels; // 1
   int mNOutChannels;
+  LatencyFunc mLatencyFunc = nullptr;
   
   // the actual data
   WDL_TypedBuf<T> mUp16x;
@@ -450,6 +723,7 @@ private:
   WDL_TypedBuf<T> mDown8x;
   WDL_TypedBuf<T> mDown4x;
   WDL_TypedBuf<T> mDown2x;
+  IPlugMemoryCharge mMemoryCharge {EMemorySubsystem::kOversampling};
   
   //Ptrs into buffer data
   WDL_PtrList<T> mUp16BufferPtrs;
@@ -469,16 +743,8 @@ private:
   WDL_PtrList<T>* mInPtrLoopSrc = nullptr;
   WDL_PtrList<T>* mOutPtrLoopSrc = nullptr;
   
-  //Ptrs to oversamplers for each channel
-  WDL_PtrList<Upsampler2xFPU<12, T>> mUpsampler2x; // for 1x to 2x SR
-  WDL_PtrList<Upsampler2xFPU<4, T>> mUpsampler4x;  // for 2x to 4x SR
-  WDL_PtrList<Upsampler2xFPU<3, T>> mUpsampler8x;  // for 4x to 8x SR
-  WDL_PtrList<Upsampler2xFPU<2, T>> mUpsampler16x; // for 8x to 16x SR
-
-  WDL_PtrList<Downsampler2xFPU<12, T>> mDownsampler2x; // decimator for 2x to 1x SR
-  WDL_PtrList<Downsampler2xFPU<4, T>> mDownsampler4x;  // decimator for 4x to 2x SR
-  WDL_PtrList<Downsampler2xFPU<3, T>> mDownsampler8x;  // decimator for 8x to 4x SR
-  WDL_PtrList<Downsampler2xFPU<2, T>> mDownsampler16x; // decimator for 16x to 8x SR
+  //The 2x stages for 1x to 2x, 2x to 4x, 4x to 8x and 8x to 16x SR, up and down, for each quality
+  std::unique_ptr<Stage> mStages[static_cast<int>(EOverSamplingQuality::kNumQualities)][2][4];
 };
 
 END_IPLUG_NAMESPACE
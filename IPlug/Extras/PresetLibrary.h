@@ -0,0 +1,362 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc PresetLibrary
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "wdlcstring.h"
+
+#include "IPlugAPIBase.h"
+#include "IPlugMappedResource.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A read only library of factory presets packed into one file by Scripts/build_preset_library.py, with an index of the presets' names, categories and tags.
+ * The file is memory mapped and the index is read in place, so opening a library of thousands of presets reads only the pages that are touched, and lookups
+ * and filtering are binary searches and intersections of sorted lists rather than scans of a folder. Open() shares one mapping between all the instances in the process.
+ *
+ * The file is little-endian, and every offset is from the start of the file:
+ * - header: char magic[4] "IPPL", uint32 version, nPresets, nCategories, nTags, presetsOffset, categoriesOffset, tagsOffset, postingsOffset, nPostings, stringsOffset, stringsSize
+ * - presets, sorted by name: uint32 name, category (or 0xFFFFFFFF), tagsStart, nTags, dataOffset, dataSize. name is an offset into the strings, and the tags of the preset
+ *   are nTags indices of tags in the postings, from tagsStart
+ * - categories and tags, each sorted by name: uint32 name, postingsStart, count. The presets in the category or with the tag are count ascending preset indices in the postings
+ * - postings: uint32 indices
+ * - strings: nul terminated UTF-8
+ * - data: the state of each preset, as written by IPluginBase::SerializeState()
+ * @ingroup IPlugExtras */
+class PresetLibrary
+{
+public:
+  static constexpr uint32_t kVersion = 1;
+  static constexpr uint32_t kNoCategory = 0xFFFFFFFF;
+
+  /** Open a library, or get the one that another instance has already opened. Call this on the main thread
+   * @param path The path of the library file
+   * @return The library, or nullptr if the file can't be mapped or isn't a valid library */
+  static std::shared_ptr<const PresetLibrary> Open(const char* path)
+  {
+    static std::mutex sMutex;
+    static std::map<std::string, std::weak_ptr<const PresetLibrary>> sLibraries;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::weak_ptr<const PresetLibrary>& entry = sLibraries[path];
+
+    if (auto pLibrary = entry.lock())
+      return pLibrary;
+
+    auto pLibrary = std::make_shared<const PresetLibrary>(IPlugMappedResource(path));
+
+    if (!pLibrary->IsValid())
+    {
+      sLibraries.erase(path);
+      return nullptr;
+    }
+
+    entry = pLibrary;
+    return pLibrary;
+  }
+
+  /** Read a library from a mapped file or from memory, e.g. one compiled into the binary. The whole index is checked, so a truncated or corrupt file is rejected here rather than read out of bounds later */
+  explicit PresetLibrary(IPlugMappedResource&& resource)
+  : mResource(std::move(resource))
+  {
+    mValid = Validate();
+  }
+
+  PresetLibrary(const PresetLibrary&) = delete;
+  PresetLibrary& operator=(const PresetLibrary&) = delete;
+
+  bool IsValid() const { return mValid; }
+
+#pragma mark - Presets
+
+  int NPresets() const { return mValid ? mNPresets : 0; }
+
+  const char* GetPresetName(int idx) const { return GetString(PresetField(idx, kName)); }
+
+  /** @return The index of the preset's category, or -1 if it has none */
+  int GetPresetCategory(int idx) const
+  {
+    const uint32_t category = PresetField(idx, kCategory);
+    return category == kNoCategory ? -1 : static_cast<int>(category);
+  }
+
+  int NPresetTags(int idx) const { return static_cast<int>(PresetField(idx, kTagsCount)); }
+
+  /** @return The index of the tagIdx-th tag of the preset */
+  int GetPresetTag(int idx, int tagIdx) const { return static_cast<int>(Posting(PresetField(idx, kTagsStart) + tagIdx)); }
+
+  /** @param size Set to the size of the preset's state in bytes
+   * @return The state, read in place from the mapped file */
+  const uint8_t* GetPresetData(int idx, int& size) const
+  {
+    size = static_cast<int>(PresetField(idx, kDataSize));
+    return mResource.Get() + PresetField(idx, kDataOffset);
+  }
+
+  /** Restore a preset's state to a plug-in, as IPluginBase::RestorePreset() does for the plug-in's own presets. Call this on the main thread
+   * @return \c true if the plug-in unserialized the state */
+  bool RestorePreset(IPlugAPIBase& plug, int idx) const
+  {
+    if (idx < 0 || idx >= NPresets())
+      return false;
+
+    int size;
+    const uint8_t* pData = GetPresetData(idx, size);
+    IByteChunk chunk; // UnserializeState() takes a chunk, so the state is copied, but only the one preset's
+    chunk.PutBytes(pData, size);
+
+    if (plug.UnserializeState(chunk, 0) < 0)
+      return false;
+
+    plug.OnRestoreState();
+    return true;
+  }
+
+  /** @return The index of the preset with the exact name, or -1 */
+  int FindPreset(const char* name) const { return Find(mPresetsOffset, NPresets(), kPresetFields, name); }
+
+#pragma mark - Categories and tags
+
+  int NCategories() const { return mValid ? mNCategories : 0; }
+  const char* GetCategoryName(int idx) const { return GetString(ListField(mCategoriesOffset, NCategories(), idx, kListName)); }
+  int FindCategory(const char* name) const { return Find(mCategoriesOffset, NCategories(), kListFields, name); }
+
+  int NTags() const { return mValid ? mNTags : 0; }
+  const char* GetTagName(int idx) const { return GetString(ListField(mTagsOffset, NTags(), idx, kListName)); }
+  int FindTag(const char* name) const { return Find(mTagsOffset, NTags(), kListFields, name); }
+
+  /** Find the presets that match all of the filters, e.g. for a preset browser
+   * @param results Set to the indices of the matching presets, in order of name
+   * @param category The index of a category, or -1 for any
+   * @param pTags The indices of tags the presets must all have, or nullptr
+   * @param nameContains Text the names must contain, ignoring case, or nullptr */
+  void Query(std::vector<int>& results, int category = -1, const int* pTags = nullptr, int nTags = 0, const char* nameContains = nullptr) const
+  {
+    results.clear();
+
+    // the posting lists to intersect, the shortest first so that the others are only searched for its entries
+    std::vector<std::pair<const uint8_t*, int>> lists;
+
+    if (category >= 0)
+    {
+      if (category >= NCategories())
+        return;
+
+      lists.push_back(PostingList(mCategoriesOffset, category));
+    }
+
+    for (int i = 0; i < nTags; i++)
+    {
+      if (pTags[i] < 0 || pTags[i] >= NTags())
+        return;
+
+      lists.push_back(PostingList(mTagsOffset, pTags[i]));
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+
+    const bool filterName = CStringHasContents(nameContains);
+    const int nCandidates = lists.empty() ? NPresets() : lists[0].second;
+
+    for (int c = 0; c < nCandidates; c++)
+    {
+      const uint32_t presetIdx = lists.empty() ? static_cast<uint32_t>(c) : ReadU32(lists[0].first + c * 4);
+      bool match = true;
+
+      for (size_t l = 1; l < lists.size() && match; l++)
+        match = Contains(lists[l].first, lists[l].second, presetIdx);
+
+      if (match && filterName)
+        match = WDL_stristr(GetPresetName(presetIdx), nameContains) != nullptr;
+
+      if (match)
+        results.push_back(static_cast<int>(presetIdx));
+    }
+  }
+
+private:
+  enum EPresetField { kName = 0, kCategory, kTagsStart, kTagsCount, kDataOffset, kDataSize, kPresetFields };
+  enum EListField { kListName = 0, kListStart, kListCount, kListFields };
+  static constexpr uint32_t kHeaderWords = 12;
+
+  // the file may not be aligned in memory, e.g. if it is compiled into the binary, so words are read with memcpy
+  static uint32_t ReadU32(const void* p)
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  uint32_t Word(uint32_t offset) const { return ReadU32(mResource.Get() + offset); }
+
+  uint32_t PresetField(int idx, int field) const
+  {
+    assert(idx >= 0 && idx < NPresets());
+    return Word(mPresetsOffset + (idx * kPresetFields + field) * 4);
+  }
+
+  uint32_t ListField(uint32_t listsOffset, int n, int idx, int field) const
+  {
+    assert(idx >= 0 && idx < n);
+    return Word(listsOffset + (idx * kListFields + field) * 4);
+  }
+
+  uint32_t Posting(uint32_t idx) const { return Word(mPostingsOffset + idx * 4); }
+
+  /** @return The first byte and the number of entries of a category's or tag's list of presets */
+  std::pair<const uint8_t*, int> PostingList(uint32_t listsOffset, int idx) const
+  {
+    const uint32_t start = Word(listsOffset + (idx * kListFields + kListStart) * 4);
+    const uint32_t count = Word(listsOffset + (idx * kListFields + kListCount) * 4);
+    return { mResource.Get() + mPostingsOffset + uint64_t(start) * 4, static_cast<int>(count) };
+  }
+
+  static bool Contains(const uint8_t* pList, int n, uint32_t value)
+  {
+    int lo = 0, hi = n;
+
+    while (lo < hi)
+    {
+      const int mid = (lo + hi) / 2;
+      const uint32_t v = ReadU32(pList + mid * 4);
+
+      if (v == value)
+        return true;
+      else if (v < value)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return false;
+  }
+
+  const char* GetString(uint32_t offset) const { return reinterpret_cast<const char*>(mResource.Get() + mStringsOffset + offset); }
+
+  /** Binary search records sorted by the name in their first field */
+  int Find(uint32_t recordsOffset, int n, int nFields, const char* name) const
+  {
+    if (!name)
+      return -1;
+
+    int lo = 0, hi = n;
+
+    while (lo < hi)
+    {
+      const int mid = (lo + hi) / 2;
+      const int cmp = strcmp(GetString(Word(recordsOffset + mid * nFields * 4)), name);
+
+      if (cmp == 0)
+        return mid;
+      else if (cmp < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return -1;
+  }
+
+  bool Validate()
+  {
+    const uint64_t size = mResource.GetSize();
+
+    if (!mResource.IsValid() || size < kHeaderWords * 4 || memcmp(mResource.Get(), "IPPL", 4) || Word(4) > kVersion)
+      return false;
+
+    mNPresets = static_cast<int>(Word(8));
+    mNCategories = static_cast<int>(Word(12));
+    mNTags = static_cast<int>(Word(16));
+    mPresetsOffset = Word(20);
+    mCategoriesOffset = Word(24);
+    mTagsOffset = Word(28);
+    mPostingsOffset = Word(32);
+    const uint64_t nPostings = Word(36);
+    mStringsOffset = Word(40);
+    const uint64_t stringsSize = Word(44);
+
+    auto inFile = [size](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+    if (mNPresets < 0 || mNCategories < 0 || mNTags < 0
+        || !inFile(mPresetsOffset, uint64_t(mNPresets) * kPresetFields * 4)
+        || !inFile(mCategoriesOffset, uint64_t(mNCategories) * kListFields * 4)
+        || !inFile(mTagsOffset, uint64_t(mNTags) * kListFields * 4)
+        || !inFile(mPostingsOffset, nPostings * 4)
+        || !inFile(mStringsOffset, stringsSize)
+        || !stringsSize || mResource.Get()[mStringsOffset + stringsSize - 1] != 0) // so every string in the table is terminated
+      return false;
+
+    mValid = true; // for the accessors below
+
+    for (int i = 0; i < mNPresets; i++)
+    {
+      const uint32_t category = PresetField(i, kCategory);
+
+      if (PresetField(i, kName) >= stringsSize
+          || (category != kNoCategory && category >= static_cast<uint32_t>(mNCategories))
+          || uint64_t(PresetField(i, kTagsStart)) + PresetField(i, kTagsCount) > nPostings
+          || !inFile(PresetField(i, kDataOffset), PresetField(i, kDataSize)))
+        return false;
+
+      for (int t = 0; t < NPresetTags(i); t++)
+      {
+        if (GetPresetTag(i, t) < 0 || GetPresetTag(i, t) >= mNTags)
+          return false;
+      }
+    }
+
+    auto validateLists = [&](uint32_t listsOffset, int n) {
+      for (int i = 0; i < n; i++)
+      {
+        const std::pair<const uint8_t*, int> list = PostingList(listsOffset, i);
+        const uint32_t start = ListField(listsOffset, n, i, kListStart);
+
+        if (ListField(listsOffset, n, i, kListName) >= stringsSize || uint64_t(start) + ListField(listsOffset, n, i, kListCount) > nPostings)
+          return false;
+
+        for (int p = 0; p < list.second; p++)
+        {
+          if (ReadU32(list.first + p * 4) >= static_cast<uint32_t>(mNPresets) || (p && ReadU32(list.first + p * 4) <= ReadU32(list.first + (p - 1) * 4)))
+            return false; // the lists must be sorted for Contains()
+        }
+      }
+
+      return true;
+    };
+
+    return validateLists(mCategoriesOffset, mNCategories) && validateLists(mTagsOffset, mNTags);
+  }
+
+  IPlugMappedResource mResource;
+  bool mValid = false;
+  int mNPresets = 0;
+  int mNCategories = 0;
+  int mNTags = 0;
+  uint32_t mPresetsOffset = 0;
+  uint32_t mCategoriesOffset = 0;
+  uint32_t mTagsOffset = 0;
+  uint32_t mPostingsOffset = 0;
+  uint32_t mStringsOffset = 0;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,243 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc PresetMorpher
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "heapbuf.h"
+
+#include "IPlugAPIBase.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Morphs between the parameter values of two or more presets in realtime.
+ * The presets' serialized parameter data is decoded once into arrays of normalized values when they are added, so morphing is a weighted sum over those arrays, with no unserialization or allocation.
+ * Stepped parameters (IParam::GetStepped()) are not interpolated, they take the value of the preset with the largest weight.
+ * This only works for presets whose chunks contain just the parameter values, i.e. plug-ins that don't override SerializeState() or that serialize the parameters first.
+ *
+ * Typical use: add the presets in the constructor (after the presets are made), call Morph() on the audio thread, e.g. from a "morph" parameter's OnParamChange(), then Apply() */
+class PresetMorpher
+{
+public:
+  /** Add a preset's parameter values. This method is not realtime safe
+   * @param plug The plug-in
+   * @param presetIdx The index of the preset
+   * @return The index of the preset in the morpher, or -1 if the preset's data could not be read */
+  int AddPreset(IPluginBase& plug, int presetIdx)
+  {
+    IPreset* pPreset = plug.GetPreset(presetIdx);
+
+    if (!pPreset || !pPreset->mInitialized)
+      return -1;
+
+    return AddPresetFromChunk(plug, pPreset->mChunk, 0);
+  }
+
+  /** Add parameter values serialized with IPluginBase::SerializeParams(). This method is not realtime safe
+   * @param plug The plug-in
+   * @param chunk The chunk holding the parameter values
+   * @param startPos The position in the chunk where the parameter values start
+   * @return The index of the preset in the morpher, or -1 if the chunk could not be read */
+  int AddPresetFromChunk(IPluginBase& plug, const IByteChunk& chunk, int startPos)
+  {
+    const int nParams = plug.NParams();
+
+    if (NPresets() && nParams != mNParams)
+      return -1;
+
+    WDL_TypedBuf<double> values;
+    values.Resize(nParams);
+
+    int pos = startPos;
+
+    for (auto p = 0; p < nParams && pos >= 0; p++)
+    {
+      double v = 0.;
+      pos = chunk.Get(&v, pos);
+      values.Get()[p] = plug.GetParam(p)->ToNormalized(v);
+    }
+
+    if (pos < 0)
+      return -1;
+
+    return AddPresetFromValues(plug, values.Get());
+  }
+
+  /** Add an array of normalized parameter values, e.g. from SnapshotSlots. This method is not realtime safe
+   * @param plug The plug-in
+   * @param pNormalized One normalized value per parameter
+   * @return The index of the preset in the morpher, or -1 if the number of parameters has changed */
+  int AddPresetFromValues(IPluginBase& plug, const double* pNormalized)
+  {
+    const int nParams = plug.NParams();
+
+    if (NPresets() && nParams != mNParams)
+      return -1;
+
+    mNParams = nParams;
+    const int presetIdx = NPresets();
+    mValues.Resize((presetIdx + 1) * nParams);
+    memcpy(mValues.Get() + (presetIdx * nParams), pNormalized, nParams * sizeof(double));
+
+    mStepped.Resize(nParams);
+    mOutput.Resize(nParams);
+    mApplied.Resize(nParams);
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      mStepped.Get()[p] = plug.GetParam(p)->GetStepped();
+      mApplied.Get()[p] = -1.; // so that the first Apply() sets every parameter
+    }
+
+    if (presetIdx == 0)
+      memcpy(mOutput.Get(), pNormalized, nParams * sizeof(double));
+
+    mNPresets++;
+    return presetIdx;
+  }
+
+  /** Remove all the presets. This method is not realtime safe */
+  void Clear()
+  {
+    mNPresets = 0;
+    mValues.Resize(0);
+  }
+
+  /** @return The number of presets that have been added */
+  int NPresets() const { return mNPresets; }
+
+  /** Compute a weighted mix of the presets. This method is realtime safe
+   * @param weights One weight per preset. The weights are normalized so they don't need to add up to 1
+   * @param nWeights The number of weights, which should be NPresets() */
+  void Morph(const double* weights, int nWeights)
+  {
+    assert(nWeights == NPresets());
+
+    double sum = 0.;
+    int dominantIdx = 0;
+
+    for (auto i = 0; i < nWeights; i++)
+    {
+      sum += std::fabs(weights[i]);
+
+      if (std::fabs(weights[i]) > std::fabs(weights[dominantIdx]))
+        dominantIdx = i;
+    }
+
+    if (sum <= 0.)
+      return;
+
+    double* pOutput = mOutput.Get();
+    const int nParams = mNParams;
+
+    for (auto p = 0; p < nParams; p++)
+      pOutput[p] = 0.;
+
+    // each preset is a contiguous array, so this is a vectorizable multiply-add over all the parameters
+    for (auto i = 0; i < nWeights; i++)
+    {
+      const double w = std::fabs(weights[i]) / sum;
+      const double* pValues = mValues.Get() + (i * nParams);
+
+      if (w == 0.)
+        continue;
+
+      for (auto p = 0; p < nParams; p++)
+        pOutput[p] += w * pValues[p];
+    }
+
+    const double* pDominant = mValues.Get() + (dominantIdx * nParams);
+    const bool* pStepped = mStepped.Get();
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      if (pStepped[p])
+        pOutput[p] = pDominant[p];
+    }
+  }
+
+  /** Morph along the list of presets, crossfading between neighbouring presets. This method is realtime safe
+   * @param position A value between 0 (the first preset) and 1 (the last preset) */
+  void Morph(double position)
+  {
+    const int nPresets = NPresets();
+
+    if (nPresets < 1)
+      return;
+
+    const double scaled = Clip(position, 0., 1.) * (nPresets - 1);
+    const int lo = std::min(static_cast<int>(scaled), std::max(nPresets - 2, 0));
+    const double frac = scaled - lo;
+
+    double weights[2] = { 1. - frac, frac };
+    MorphPair(lo, std::min(lo + 1, nPresets - 1), weights);
+  }
+
+  /** @return The normalized parameter values computed by the last call to Morph(), one per parameter */
+  const double* GetNormalizedValues() const { return mOutput.Get(); }
+
+  /** Set the plug-in's parameters that changed since the last call to the values computed by Morph(), call OnParamChange() for them with the sample offset, and queue the new values for the UI.
+   * This method is realtime safe, call it on the audio thread with the parameters mutex held (e.g. in ProcessBlock, or in OnParamChange())
+   * @param plug The plug-in
+   * @param sampleOffset The offset of the change in the current block, or -1 */
+  void Apply(IPlugAPIBase& plug, int sampleOffset = -1)
+  {
+    const double* pOutput = mOutput.Get();
+    double* pApplied = mApplied.Get();
+
+    for (auto p = 0; p < mNParams; p++)
+    {
+      if (pOutput[p] == pApplied[p])
+        continue;
+
+      pApplied[p] = pOutput[p];
+      plug.GetParam(p)->SetNormalized(pOutput[p]);
+      plug.OnParamChange(p, kPresetRecall, sampleOffset);
+      plug.SendParameterValueFromAPI(p, pOutput[p], true);
+    }
+  }
+
+private:
+  void MorphPair(int a, int b, const double* weights)
+  {
+    const int nParams = mNParams;
+    const double* pA = mValues.Get() + (a * nParams);
+    const double* pB = mValues.Get() + (b * nParams);
+    const double* pDominant = weights[0] >= weights[1] ? pA : pB;
+    const bool* pStepped = mStepped.Get();
+    double* pOutput = mOutput.Get();
+
+    for (auto p = 0; p < nParams; p++)
+      pOutput[p] = weights[0] * pA[p] + weights[1] * pB[p];
+
+    for (auto p = 0; p < nParams; p++)
+    {
+      if (pStepped[p])
+        pOutput[p] = pDominant[p];
+    }
+  }
+
+  int mNParams = 0;
+  int mNPresets = 0;
+  WDL_TypedBuf<double> mValues; // the normalized values of each preset, one contiguous array of mNParams per preset
+  WDL_TypedBuf<bool> mStepped;
+  WDL_TypedBuf<double> mOutput;
+  WDL_TypedBuf<double> mApplied;
+};
+
+END_IPLUG_NAMESPACE
@@ -85,6 +85,25 @@ public:
     return magnitude;
   }
 
+  /** The coefficients of the filter: a1 to a3 for the integrators, m0 to m2 to mix the input, band pass and low pass outputs for the mode */
+  struct Coefficients
+  {
+    T a1 = 0., a2 = 0., a3 = 0.;
+    T m0 = 0., m1 = 0., m2 = 0.;
+
+    static Coefficients Interpolate(const Coefficients& from, const Coefficients& to, T x)
+    {
+      Coefficients r;
+      r.a1 = from.a1 + (to.a1 - from.a1) * x;
+      r.a2 = from.a2 + (to.a2 - from.a2) * x;
+      r.a3 = from.a3 + (to.a3 - from.a3) * x;
+      r.m0 = from.m0 + (to.m0 - from.m0) * x;
+      r.m1 = from.m1 + (to.m1 - from.m1) * x;
+      r.m2 = from.m2 + (to.m2 - from.m2) * x;
+      return r;
+    }
+  };
+
   void SetFreqCPS(double freqCPS) { mNewState.freq = Clip(freqCPS, 10.0, 20000.); }
 
   void SetQ(double Q) { mNewState.Q = Clip(Q, 0.1, 100.0); }
@@ -95,167 +114,228 @@ public:
   
   void SetSampleRate(double sampleRate) { mNewState.sampleRate = sampleRate; }
 
+  /** @param interpolate Set \c true to move the coefficients linearly across a block after a change of the settings, rather than at the start of it, which avoids zipper noise on fast sweeps */
+  void SetInterpolateCoefficients(bool interpolate) { mInterpolate = interpolate; }
+
   void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames)
   {
     assert(nChans <= NC);
 
-    if(mState != mNewState)
+    if (mState != mNewState)
+    {
+      const Coefficients from = mCoeffs;
       UpdateCoefficients();
 
-    for (auto c = 0; c < nChans; c++)
-    {
-      for (auto s = 0; s < nFrames; s++)
+      if (mInterpolate && nFrames > 1)
       {
-        const double v0 = (double) inputs[c][s];
+        const Coefficients to = mCoeffs;
+        const T step = T(1) / nFrames;
 
-        mV3[c] = v0 - mIc2eq[c];
-        mV1[c] = m_a1 * mIc1eq[c] + m_a2*mV3[c];
-        mV2[c] = mIc2eq[c] + m_a2 * mIc1eq[c] + m_a3 * mV3[c];
-        mIc1eq[c] = 2. * mV1[c] - mIc1eq[c];
-        mIc2eq[c] = 2. * mV2[c] - mIc2eq[c];
+        ProcessFrames(inputs, outputs, nChans, nFrames, [&from, &to, step](int s) {
+          return Coefficients::Interpolate(from, to, (s + 1) * step);
+        });
 
-        outputs[c][s] = (T) m_m0 * v0 + m_m1 * mV1[c] + m_m2 * mV2[c];
+        return;
       }
     }
+
+    const Coefficients coeffs = mCoeffs;
+    ProcessFrames(inputs, outputs, nChans, nFrames, [&coeffs](int) { return coeffs; });
+  }
+
+  /** Process a block with the cutoff set for each sample, e.g. from an envelope. The other settings are taken at the start of the block
+   * @param freqCPS The cutoff frequency of each sample, in Hz */
+  void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames, const T* freqCPS)
+  {
+    assert(nChans <= NC);
+
+    if (mState != mNewState)
+      UpdateCoefficients();
+
+    Settings settings = mState;
+
+    ProcessFrames(inputs, outputs, nChans, nFrames, [&settings, freqCPS](int s) {
+      settings.freq = Clip(static_cast<double>(freqCPS[s]), 10.0, 20000.);
+      return CalculateCoefficients(settings);
+    });
+
+    mNewState.freq = mState.freq = settings.freq;
+    mCoeffs = CalculateCoefficients(mState);
   }
 
   void Reset()
   {
     for (auto c = 0; c < NC; c++)
     {
-      mV1[c] = 0.;
-      mV2[c] = 0.;
-      mV3[c] = 0.;
       mIc1eq[c] = 0.;
       mIc2eq[c] = 0.;
     }
   }
 
 private:
+  struct Settings;
+
+  /** Run the filter with the coefficients returned by getCoeffs for each sample.
+   * The channels are independent and their states are arrays, so the inner loop over the channels can be vectorized by the compiler */
+  template <class CoeffsFunc>
+  void ProcessFrames(T** inputs, T** outputs, int nChans, int nFrames, CoeffsFunc getCoeffs)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      const Coefficients k = getCoeffs(s);
+
+      for (auto c = 0; c < nChans; c++)
+      {
+        const T v0 = inputs[c][s];
+        const T v3 = v0 - mIc2eq[c];
+        const T v1 = k.a1 * mIc1eq[c] + k.a2 * v3;
+        const T v2 = mIc2eq[c] + k.a2 * mIc1eq[c] + k.a3 * v3;
+        mIc1eq[c] = T(2) * v1 - mIc1eq[c];
+        mIc2eq[c] = T(2) * v2 - mIc2eq[c];
+
+        outputs[c][s] = k.m0 * v0 + k.m1 * v1 + k.m2 * v2;
+      }
+    }
+  }
+
   void UpdateCoefficients()
   {
     mState = mNewState;
+    mCoeffs = CalculateCoefficients(mState);
+  }
+
+  static Coefficients CalculateCoefficients(const Settings& state)
+  {
+    return CalculateCoefficients(state.mode, state.freq, state.Q, state.gain, state.sampleRate);
+  }
 
-    const double w = std::tan(PI * mState.freq/mState.sampleRate);
+public:
+  /** Calculate the coefficients for a setting of the filter, e.g. for ChannelBlockSVF, which filters each channel with its own setting */
+  static Coefficients CalculateCoefficients(EMode mode, double freqCPS, double Q, double gainDB, double sampleRate)
+  {
+    const double w = std::tan(PI * freqCPS/sampleRate);
+    double a1 = 0., a2 = 0., a3 = 0., m0 = 0., m1 = 0., m2 = 0.;
 
-    switch(mState.mode)
+    switch(mode)
     {
       case kLowPass:
       {
         const double g = w;
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 0;
-        m_m1 = 0;
-        m_m2 = 1.;
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 0;
+        m1 = 0;
+        m2 = 1.;
         break;
       }
       case kHighPass:
       {
         const double g = w;
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 1.;
-        m_m1 = -k;
-        m_m2 = -1.;
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 1.;
+        m1 = -k;
+        m2 = -1.;
         break;
       }
       case kBandPass:
       {
         const double g = w;
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 0.;
-        m_m1 = 1.;
-        m_m2 = 0.;
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 0.;
+        m1 = 1.;
+        m2 = 0.;
         break;
       }
       case kNotch:
       {
         const double g = w;
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 1.;
-        m_m1 = -k;
-        m_m2 = 0.;
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 1.;
+        m1 = -k;
+        m2 = 0.;
         break;
       }
       case kPeak:
       {
         const double g = w;
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 1.;
-        m_m1 = -k;
-        m_m2 = -2.;
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 1.;
+        m1 = -k;
+        m2 = -2.;
         break;
       }
       case kBell:
       {
-        const double A = std::pow(10., mState.gain/40.);
+        const double A = std::pow(10., gainDB/40.);
         const double g = w;
-        const double k = 1 / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 1.;
-        m_m1 = k * (A * A - 1.);
-        m_m2 = 0.;
+        const double k = 1 / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 1.;
+        m1 = k * (A * A - 1.);
+        m2 = 0.;
         break;
       }
       case kLowPassShelf:
       {
-        const double A = std::pow(10., mState.gain/40.);
+        const double A = std::pow(10., gainDB/40.);
         const double g = w / std::sqrt(A);
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = 1.;
-        m_m1 = k * (A - 1.);
-        m_m2 = (A * A - 1.);
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = 1.;
+        m1 = k * (A - 1.);
+        m2 = (A * A - 1.);
         break;
       }
       case kHighPassShelf:
       {
-        const double A = std::pow(10., mState.gain/40.);
+        const double A = std::pow(10., gainDB/40.);
         const double g = w / std::sqrt(A);
-        const double k = 1. / mState.Q;
-        m_a1 = 1./(1. + g * (g + k));
-        m_a2 = g * m_a1;
-        m_a3 = g * m_a2;
-        m_m0 = A*A;
-        m_m1 = k*(1. - A)*A;
-        m_m2 = (1. - A*A);
+        const double k = 1. / Q;
+        a1 = 1./(1. + g * (g + k));
+        a2 = g * a1;
+        a3 = g * a2;
+        m0 = A*A;
+        m1 = k*(1. - A)*A;
+        m2 = (1. - A*A);
         break;
       }
       default:
         break;
     }
+
+    Coefficients coeffs;
+    coeffs.a1 = static_cast<T>(a1);
+    coeffs.a2 = static_cast<T>(a2);
+    coeffs.a3 = static_cast<T>(a3);
+    coeffs.m0 = static_cast<T>(m0);
+    coeffs.m1 = static_cast<T>(m1);
+    coeffs.m2 = static_cast<T>(m2);
+    return coeffs;
   }
 
 private:
-  double mV1[NC] = {};
-  double mV2[NC] = {};
-  double mV3[NC] = {};
-  double mIc1eq[NC] = {};
-  double mIc2eq[NC] = {};
-  double m_a1 = 0.;
-  double m_a2 = 0.;
-  double m_a3 = 0.;
-  double m_m0 = 0.;
-  double m_m1 = 0.;
-  double m_m2 = 0.;
+  T mIc1eq[NC] = {};
+  T mIc2eq[NC] = {};
+  Coefficients mCoeffs;
+  bool mInterpolate = false;
 
   struct Settings
   {
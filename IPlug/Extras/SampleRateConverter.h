@@ -0,0 +1,287 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc SampleRateConverter
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "resample.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Runs DSP at a fixed internal sample rate whatever the host's rate, e.g. a model that is only valid at 48kHz, by resampling each block from the host's rate to the internal rate and back.
+ * It works like OverSampler: ProcessBlock() takes a function that processes the block at the internal rate. The resampling is WDL_Resampler's windowed sinc, so resample.cpp must be compiled.
+ * The host's blocks become a varying number of frames at the internal rate, so the output is buffered at the internal rate. This adds a constant latency, see GetLatency().
+ * All buffers are allocated by Reset(), so that ProcessBlock() and SetInternalSampleRate() don't allocate
+ * @ingroup IPlugExtras */
+template<typename T = double>
+class SampleRateConverter
+{
+public:
+  /** @param nInChans The number of input channels
+   * @param nOutChans The number of output channels
+   * @param sincSize The length of the windowed sinc filter, longer is a steeper filter with more latency */
+  SampleRateConverter(int nInChans = 2, int nOutChans = 2, int sincSize = 64)
+  : mNInChans(nInChans)
+  , mNOutChans(nOutChans)
+  , mSincSize(sincSize)
+  {
+    for (auto* pResampler : {&mInResampler, &mOutResampler})
+      pResampler->SetMode(false, 0, true, sincSize);
+
+    mInResampler.SetFeedMode(true); // input driven, each host block makes however many internal frames it makes
+    mOutResampler.SetFeedMode(false); // output driven, so each host block is filled
+  }
+
+  SampleRateConverter(const SampleRateConverter&) = delete;
+  SampleRateConverter& operator=(const SampleRateConverter&) = delete;
+
+  /** Allocate the buffers and clear the state, e.g. from OnReset()
+   * @param hostSampleRate The host's sample rate
+   * @param internalSampleRate The sample rate the function given to ProcessBlock() runs at
+   * @param maxBlockSize The largest block the host sends. Longer blocks are processed in pieces
+   * @param maxInternalSampleRate The highest rate SetInternalSampleRate() will be given, or 0 for internalSampleRate */
+  void Reset(double hostSampleRate, double internalSampleRate, int maxBlockSize, double maxInternalSampleRate = 0.)
+  {
+    mHostSampleRate = hostSampleRate;
+    mMaxBlockSize = std::max(maxBlockSize, 1);
+    maxInternalSampleRate = std::max(maxInternalSampleRate, internalSampleRate);
+
+    // room for the internal frames of the longest block at the highest rate, and for the resamplers' rounding
+    const int maxInternalFrames = static_cast<int>(std::ceil(mMaxBlockSize * maxInternalSampleRate / hostSampleRate)) + kMargin;
+    mMaxInternalFrames = maxInternalFrames;
+
+    const int nChans = std::max(mNInChans, mNOutChans);
+    mInterleaved.assign(std::max(maxInternalFrames, mMaxBlockSize + kMargin) * nChans, 0.);
+    mInternalInputs.assign(maxInternalFrames * mNInChans, 0.);
+    mInternalOutputs.assign(maxInternalFrames * mNOutChans, 0.);
+    mInternalInputPtrs.resize(mNInChans);
+    mInternalOutputPtrs.resize(mNOutChans);
+
+    for (auto c = 0; c < mNInChans; c++)
+      mInternalInputPtrs[c] = mInternalInputs.data() + c * maxInternalFrames;
+
+    for (auto c = 0; c < mNOutChans; c++)
+      mInternalOutputPtrs[c] = mInternalOutputs.data() + c * maxInternalFrames;
+
+    // a longest block at the highest rate through both resamplers makes them allocate their own buffers now, rather than on the audio thread
+    SetRates(maxInternalSampleRate);
+    Warm();
+    ClearState();
+
+    // the output resampler takes more frames to fill its filter on the first block than the input resampler makes, so the output buffer starts with that many frames of silence.
+    // After that both resamplers keep time, so the latency is those frames
+    SetRates(internalSampleRate);
+    mPrimeFrames = Warm() + kMargin;
+    mLatency = static_cast<int>(std::round(mPrimeFrames * hostSampleRate / internalSampleRate));
+    mFIFO.assign((maxInternalFrames * 2 + mPrimeFrames) * mNOutChans, 0.);
+    ClearState();
+  }
+
+  /** Change the internal sample rate without clearing the state, e.g. to follow a varispeed control. It can be called on the audio thread, up to the maximum rate given to Reset().
+   * Changing the rate rebuilds the sinc filter table, so it should not change on every block. The latency is that of the rate given to Reset() */
+  void SetInternalSampleRate(double internalSampleRate)
+  {
+    assert(std::ceil(mMaxBlockSize * internalSampleRate / mHostSampleRate) + kMargin <= mMaxInternalFrames); // Reset() with a higher maxInternalSampleRate
+    SetRates(internalSampleRate);
+  }
+
+  double GetInternalSampleRate() const { return mInternalSampleRate; }
+
+  /** @return \c true if the internal rate is the host's rate, in which case ProcessBlock() calls the function with the host's buffers, with no latency */
+  bool IsBypassed() const { return mInternalSampleRate == mHostSampleRate; }
+
+  /** @return The latency in samples at the host's rate, which the plug-in should include in the latency it reports with SetLatency() */
+  int GetLatency() const { return IsBypassed() ? 0 : mLatency; }
+
+  /** @return The number of times the output buffer has run dry since Reset(), which only happens if the internal rate is changed by a lot at once */
+  int GetUnderrunCount() const { return mUnderrunCount; }
+
+  /** Resample a block to the internal rate, process it and resample it back
+   * @param inputs The input buffers at the host's rate, one per input channel
+   * @param outputs The output buffers at the host's rate, one per output channel, which may be the input buffers
+   * @param nFrames The number of frames in the block
+   * @param func The function that processes a block at the internal rate, with the signature void(T** inputs, T** outputs, int nFrames) */
+  template <typename F>
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, F&& func)
+  {
+    if (IsBypassed())
+    {
+      func(inputs, outputs, nFrames);
+      return;
+    }
+
+    T* pInputs[MAX_BUS_CHANS];
+    T* pOutputs[MAX_BUS_CHANS];
+    assert(mNInChans <= MAX_BUS_CHANS && mNOutChans <= MAX_BUS_CHANS);
+
+    for (int s = 0; s < nFrames; s += mMaxBlockSize)
+    {
+      for (auto c = 0; c < mNInChans; c++)
+        pInputs[c] = inputs[c] + s;
+
+      for (auto c = 0; c < mNOutChans; c++)
+        pOutputs[c] = outputs[c] + s;
+
+      ProcessPiece(pInputs, pOutputs, std::min(mMaxBlockSize, nFrames - s), func);
+    }
+  }
+
+private:
+  static constexpr int kMargin = 4; // frames of slack for the resamplers' rounding
+
+  template <typename F>
+  void ProcessPiece(T** inputs, T** outputs, int nFrames, F& func)
+  {
+    WDL_ResampleSample* pResamplerBuffer;
+
+    // host rate to internal rate
+    if (mNInChans)
+    {
+      const int nIn = mInResampler.ResamplePrepare(nFrames, mNInChans, &pResamplerBuffer);
+
+      for (auto i = 0; i < nIn; i++)
+      {
+        for (auto c = 0; c < mNInChans; c++)
+          *pResamplerBuffer++ = static_cast<WDL_ResampleSample>(i < nFrames ? inputs[c][i] : T(0));
+      }
+    }
+
+    const int nInternal = mNInChans ? mInResampler.ResampleOut(mInterleaved.data(), nFrames, mMaxInternalFrames, mNInChans)
+                                    : InternalFramesWithoutInputs(nFrames);
+
+    for (auto i = 0; i < nInternal; i++)
+    {
+      for (auto c = 0; c < mNInChans; c++)
+        mInternalInputPtrs[c][i] = static_cast<T>(mInterleaved[i * mNInChans + c]);
+    }
+
+    func(mInternalInputPtrs.data(), mInternalOutputPtrs.data(), nInternal);
+
+    // the processed frames join the ones left from the previous blocks
+    WDL_ResampleSample* pFIFO = mFIFO.data() + mFIFOFrames * mNOutChans;
+    const int nQueued = std::min(nInternal, static_cast<int>(mFIFO.size()) / mNOutChans - mFIFOFrames);
+
+    for (auto i = 0; i < nQueued; i++)
+    {
+      for (auto c = 0; c < mNOutChans; c++)
+        *pFIFO++ = static_cast<WDL_ResampleSample>(mInternalOutputPtrs[c][i]);
+    }
+
+    mFIFOFrames += nQueued;
+
+    // internal rate to host rate
+    const int nNeeded = mOutResampler.ResamplePrepare(nFrames, mNOutChans, &pResamplerBuffer);
+    const int nAvailable = std::min(nNeeded, mFIFOFrames);
+
+    if (nAvailable < nNeeded)
+    {
+      mUnderrunCount++;
+      std::fill(pResamplerBuffer + nAvailable * mNOutChans, pResamplerBuffer + nNeeded * mNOutChans, 0.);
+    }
+
+    memcpy(pResamplerBuffer, mFIFO.data(), nAvailable * mNOutChans * sizeof(WDL_ResampleSample));
+    mFIFOFrames -= nAvailable;
+    memmove(mFIFO.data(), mFIFO.data() + nAvailable * mNOutChans, mFIFOFrames * mNOutChans * sizeof(WDL_ResampleSample));
+
+    const int nOut = mOutResampler.ResampleOut(mInterleaved.data(), nNeeded, nFrames, mNOutChans);
+
+    for (auto c = 0; c < mNOutChans; c++)
+    {
+      for (auto i = 0; i < nOut; i++)
+        outputs[c][i] = static_cast<T>(mInterleaved[i * mNOutChans + c]);
+
+      std::fill(outputs[c] + nOut, outputs[c] + nFrames, T(0));
+    }
+  }
+
+  /** With no inputs there is nothing to resample in, so the internal frames are counted with the same fractional position that the resampler would keep */
+  int InternalFramesWithoutInputs(int nFrames)
+  {
+    mInternalPos += nFrames * mInternalSampleRate / mHostSampleRate;
+    const int nInternal = static_cast<int>(mInternalPos);
+    mInternalPos -= nInternal;
+    return std::min(nInternal, mMaxInternalFrames);
+  }
+
+  void SetRates(double internalSampleRate)
+  {
+    mInternalSampleRate = internalSampleRate;
+    mInResampler.SetRates(mHostSampleRate, internalSampleRate);
+    mOutResampler.SetRates(internalSampleRate, mHostSampleRate);
+  }
+
+  /** Push a longest block of silence through both resamplers
+   * @return The number of frames more that the output resampler took than the input resampler made */
+  int Warm()
+  {
+    WDL_ResampleSample* pResamplerBuffer;
+    int nInternal;
+
+    if (mNInChans)
+    {
+      const int nIn = mInResampler.ResamplePrepare(mMaxBlockSize, mNInChans, &pResamplerBuffer);
+      std::fill(pResamplerBuffer, pResamplerBuffer + nIn * mNInChans, 0.);
+      nInternal = mInResampler.ResampleOut(mInterleaved.data(), nIn, mMaxInternalFrames, mNInChans);
+    }
+    else
+      nInternal = InternalFramesWithoutInputs(mMaxBlockSize);
+
+    const int nNeeded = mOutResampler.ResamplePrepare(mMaxBlockSize, mNOutChans, &pResamplerBuffer);
+    std::fill(pResamplerBuffer, pResamplerBuffer + nNeeded * mNOutChans, 0.);
+    mOutResampler.ResampleOut(mInterleaved.data(), nNeeded, mMaxBlockSize, mNOutChans);
+
+    return std::max(nNeeded - nInternal, 0);
+  }
+
+  void ClearState()
+  {
+    mInResampler.Reset();
+    mOutResampler.Reset();
+
+    // the output buffer starts with enough silence that the output resampler never waits for the input resampler
+    std::fill(mFIFO.begin(), mFIFO.end(), 0.);
+    mFIFOFrames = mPrimeFrames;
+    mInternalPos = 0.;
+    mUnderrunCount = 0;
+  }
+
+  WDL_Resampler mInResampler;
+  WDL_Resampler mOutResampler;
+  std::vector<WDL_ResampleSample> mInterleaved; // the interleaved frames going into or out of a resampler
+  std::vector<WDL_ResampleSample> mFIFO; // processed interleaved frames at the internal rate, waiting for the output resampler
+  std::vector<T> mInternalInputs;
+  std::vector<T> mInternalOutputs;
+  std::vector<T*> mInternalInputPtrs;
+  std::vector<T*> mInternalOutputPtrs;
+  int mNInChans;
+  int mNOutChans;
+  int mSincSize;
+  int mMaxBlockSize = 0;
+  int mMaxInternalFrames = 0;
+  int mPrimeFrames = 0;
+  int mLatency = 0;
+  int mFIFOFrames = 0;
+  int mUnderrunCount = 0;
+  double mInternalPos = 0.;
+  double mHostSampleRate = 44100.;
+  double mInternalSampleRate = 44100.;
+};
+
+END_IPLUG_NAMESPACE
@@ -9,8 +9,16 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 #include "denormal.h"
+#include "heapbuf.h"
+#include "ptrlist.h"
 #include "IPlugConstants.h"
+#include "IPlugParameter.h"
+#include "IPlugSIMD.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -87,25 +95,221 @@ public:
 
 } WDL_FIXALIGN;
 
+/** Applies a smoothed gain to a block of samples. The smoother runs once per sample, but the gain is applied to every channel as a linear ramp over
+ * sub-blocks of kRampSize samples with the SIMD kernels in IPlugSIMD.h */
 template<typename T>
 class SmoothedGain
 {
 public:
   void ProcessBlock(T** inputs, T** outputs, int nChans, int nFrames, double gainValue)
   {
-    for (auto s = 0; s < nFrames; ++s)
+    for (auto pos = 0; pos < nFrames; pos += kRampSize)
     {
-      const double smoothedGain = mSmoother.Process(gainValue);
-      
+      const int n = std::min(nFrames - pos, kRampSize);
+      const double startGain = mGain;
+
+      for (auto s = 0; s < n; ++s)
+      {
+        mGain = mSmoother.Process(gainValue);
+      }
+
+      const double gainIncr = (mGain - startGain) / n;
+
       for (auto c = 0; c < nChans; c++)
       {
-        outputs[c][s] = inputs[c][s] * smoothedGain;
+        simd::ApplyGain(outputs[c] + pos, inputs[c] + pos, n, static_cast<T>(startGain + gainIncr), static_cast<T>(gainIncr));
       }
     }
   }
   
 private:
+  static constexpr int kRampSize = 16;
   LogParamSmooth<double, 1> mSmoother;
+  double mGain = 0.;
+};
+
+/** A bank of one-pole smoothers for parameters, e.g. those flagged with IParam::kFlagSmoothed, so that plug-ins don't need a LogParamSmooth for each parameter.
+ * All smoothers share the same smoothing time. Since a parameter's target value is constant for the duration of a block, each ramp is computed in closed form from a table of powers of the
+ * smoothing coefficient, which vectorizes well, and smoothers that have settled on their target are skipped.
+ * Call ProcessBlock() at the start of ProcessBlock() (or once per sub-block) and then read the per-sample ramps with GetRamp() or the value at the end of the block with GetValue() */
+template<typename T>
+class ParamSmootherBank
+{
+public:
+  ParamSmootherBank(double timeMs = 5.)
+  : mTimeMs(timeMs)
+  {
+  }
+
+  /** Add all of the parameters that are flagged with IParam::kFlagSmoothed. Call this in the plug-in constructor, after the parameters have been initialized
+   * @param params The plug-in's parameters, see IEditorDelegate::GetParams() */
+  void AddSmoothedParams(const WDL_PtrList<IParam>& params)
+  {
+    for (auto i = 0; i < params.GetSize(); i++)
+    {
+      if (params.Get(i)->GetSmoothed())
+        AddParam(i, params.Get(i));
+    }
+  }
+
+  /** Add a smoother for a parameter. This method is not realtime safe
+   * @param paramIdx The index of the parameter, used to look up its smoother
+   * @param pParam The parameter */
+  void AddParam(int paramIdx, const IParam* pParam)
+  {
+    const int prevSize = mSlotForParam.GetSize();
+
+    if (paramIdx >= prevSize)
+    {
+      mSlotForParam.Resize(paramIdx + 1);
+
+      for (auto i = prevSize; i <= paramIdx; i++)
+        mSlotForParam.Get()[i] = -1;
+    }
+
+    mSlotForParam.Get()[paramIdx] = NSmoothers();
+
+    const T value = static_cast<T>(pParam->Value());
+    mParams.Add(pParam);
+    mCurrent.Add(value);
+    mTolerance.Add(static_cast<T>(pParam->GetRange() * 1e-6));
+    mFilledFrames.Add(0);
+
+    if (mMaxBlockSize)
+      Reset(mSampleRate, mMaxBlockSize);
+  }
+
+  /** Set the smoothing time. This method is not realtime safe
+   * @param timeMs The time constant in milliseconds */
+  void SetSmoothTime(double timeMs)
+  {
+    mTimeMs = timeMs;
+
+    if (mMaxBlockSize)
+      Reset(mSampleRate, mMaxBlockSize);
+  }
+
+  /** Allocate the ramp buffers and jump to the parameters' current values. This method is not realtime safe, call it in OnReset()
+   * @param sampleRate The sample rate
+   * @param maxBlockSize The largest number of frames that will be passed to ProcessBlock() */
+  void Reset(double sampleRate, int maxBlockSize)
+  {
+    static constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+    mSampleRate = sampleRate;
+    mMaxBlockSize = maxBlockSize;
+
+    const double a = std::exp(-TWO_PI / (mTimeMs * 0.001 * sampleRate));
+    double pow = 1.;
+
+    mPowers.Resize(maxBlockSize);
+
+    for (auto s = 0; s < maxBlockSize; s++)
+    {
+      pow *= a;
+      mPowers.Get()[s] = static_cast<T>(pow);
+    }
+
+    mRamps.Resize(NSmoothers() * maxBlockSize);
+
+    for (auto k = 0; k < NSmoothers(); k++)
+    {
+      mCurrent.Get()[k] = static_cast<T>(mParams.Get()[k]->Value());
+      mFilledFrames.Get()[k] = 0;
+    }
+  }
+
+  /** Advance all the smoothers towards their parameters' current values. This method is realtime safe
+   * @param nFrames The number of frames, which must not be more than the maxBlockSize passed to Reset() */
+  void ProcessBlock(int nFrames)
+  {
+    assert(nFrames <= mMaxBlockSize);
+
+    const T* pPowers = mPowers.Get();
+
+    for (auto k = 0; k < NSmoothers(); k++)
+    {
+      T* pRamp = mRamps.Get() + (k * mMaxBlockSize);
+      const T target = static_cast<T>(mParams.Get()[k]->Value());
+      const T delta = mCurrent.Get()[k] - target;
+      int& filledFrames = mFilledFrames.Get()[k];
+
+      if (std::fabs(delta) <= mTolerance.Get()[k])
+      {
+        if (mCurrent.Get()[k] != target)
+        {
+          mCurrent.Get()[k] = target;
+          filledFrames = 0;
+        }
+
+        // the ramp buffer only needs writing until it holds a block's worth of the settled value
+        for (auto s = filledFrames; s < nFrames; s++)
+          pRamp[s] = target;
+
+        filledFrames = std::max(filledFrames, nFrames);
+      }
+      else
+      {
+        for (auto s = 0; s < nFrames; s++)
+          pRamp[s] = target + delta * pPowers[s];
+
+        mCurrent.Get()[k] = pRamp[nFrames - 1];
+        filledFrames = 0;
+      }
+    }
+  }
+
+  /** @param paramIdx The index of the parameter
+   * @return The smoothed value of the parameter for each frame of the last call to ProcessBlock() */
+  const T* GetRamp(int paramIdx) const
+  {
+    return mRamps.Get() + (GetSlot(paramIdx) * mMaxBlockSize);
+  }
+
+  /** @param paramIdx The index of the parameter
+   * @return The smoothed value of the parameter at the end of the last call to ProcessBlock(), which is useful when processing per sub-block rather than per sample */
+  T GetValue(int paramIdx) const
+  {
+    return mCurrent.Get()[GetSlot(paramIdx)];
+  }
+
+  /** @param paramIdx The index of the parameter
+   * @return \c true if the parameter's smoother has reached its target, and its ramp is constant */
+  bool GetSettled(int paramIdx) const
+  {
+    return mFilledFrames.Get()[GetSlot(paramIdx)] > 0;
+  }
+
+  /** @param paramIdx The index of the parameter
+   * @return \c true if a smoother was added for this parameter */
+  bool HasParam(int paramIdx) const
+  {
+    return paramIdx >= 0 && paramIdx < mSlotForParam.GetSize() && mSlotForParam.Get()[paramIdx] > -1;
+  }
+
+  /** @return The number of smoothers in the bank */
+  int NSmoothers() const { return mParams.GetSize(); }
+
+private:
+  int GetSlot(int paramIdx) const
+  {
+    assert(HasParam(paramIdx) && "Parameter is not smoothed");
+    return mSlotForParam.Get()[paramIdx];
+  }
+
+  double mTimeMs;
+  double mSampleRate = DEFAULT_SAMPLE_RATE;
+  int mMaxBlockSize = 0;
+
+  // per smoother state, stored as structure of arrays
+  WDL_TypedBuf<const IParam*> mParams;
+  WDL_TypedBuf<T> mCurrent;
+  WDL_TypedBuf<T> mTolerance;
+  WDL_TypedBuf<int> mFilledFrames;
+
+  WDL_TypedBuf<int> mSlotForParam;
+  WDL_TypedBuf<T> mPowers;
+  WDL_TypedBuf<T> mRamps;
 };
 
 END_IPLUG_NAMESPACE
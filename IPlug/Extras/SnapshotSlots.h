@@ -0,0 +1,234 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc SnapshotSlots
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+
+#include "heapbuf.h"
+
+#include "IPlugAPIBase.h"
+#include "PresetMorpher.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A/B (or A/B/C/D...) compare slots, each holding a snapshot of the normalized values of all the parameters.
+ * Switching slots sets only the parameters whose values differ, in one parameter change batch, so the host is informed of them all at once (see IPlugAPIBase::BeginParameterChangeBatch()),
+ * with no serialization or allocation. A switch can also crossfade to the new values over a time, using a PresetMorpher on the audio thread.
+ *
+ * Typical use: call Switch() on the main thread when a slot button is clicked. To crossfade, also call ProcessCrossfade() at the start of ProcessBlock(), and Idle() in OnIdle() */
+class SnapshotSlots
+{
+public:
+  /** @param nSlots The number of slots */
+  SnapshotSlots(int nSlots = 2)
+  : mNSlots(nSlots)
+  {
+    mStored.Resize(nSlots);
+    memset(mStored.Get(), 0, nSlots * sizeof(bool));
+  }
+
+  /** @return The number of slots */
+  int NSlots() const { return mNSlots; }
+
+  /** @return The slot last switched to, or -1 if there isn't one */
+  int GetCurrentSlot() const { return mCurrentSlot; }
+
+  /** @return \c true if the slot holds a snapshot */
+  bool IsStored(int slot) const { return slot >= 0 && slot < mNSlots && mStored.Get()[slot]; }
+
+  /** @return The normalized parameter values of a slot, one per parameter, or nullptr if it is empty */
+  const double* GetNormalizedValues(int slot) const { return IsStored(slot) ? mValues.Get() + (slot * mNParams) : nullptr; }
+
+  /** Store the current values of the plug-in's parameters in a slot. Call this on the main thread
+   * @param plug The plug-in
+   * @param slot The slot */
+  void Store(const IPluginBase& plug, int slot)
+  {
+    assert(slot >= 0 && slot < mNSlots);
+
+    if (mNParams != plug.NParams())
+    {
+      mNParams = plug.NParams();
+      mValues.Resize(mNSlots * mNParams);
+      memset(mStored.Get(), 0, mNSlots * sizeof(bool));
+    }
+
+    double* pValues = mValues.Get() + (slot * mNParams);
+
+    for (auto p = 0; p < mNParams; p++)
+      pValues[p] = plug.GetParam(p)->GetNormalized();
+
+    mStored.Get()[slot] = true;
+  }
+
+  /** Copy one slot to another, e.g. to compare a change with the original
+   * @return \c true if the source slot holds a snapshot */
+  bool Copy(int fromSlot, int toSlot)
+  {
+    if (!IsStored(fromSlot) || toSlot < 0 || toSlot >= mNSlots)
+      return false;
+
+    memmove(mValues.Get() + (toSlot * mNParams), GetNormalizedValues(fromSlot), mNParams * sizeof(double));
+    mStored.Get()[toSlot] = true;
+    return true;
+  }
+
+  /** Empty a slot */
+  void Clear(int slot)
+  {
+    if (slot >= 0 && slot < mNSlots)
+      mStored.Get()[slot] = false;
+  }
+
+  /** Set the plug-in's parameters to the values in a slot immediately, informing the host of the ones that change in one batch. Call this on the main thread
+   * @param plug The plug-in
+   * @param slot The slot
+   * @return \c true if the slot holds a snapshot */
+  bool Recall(IPlugAPIBase& plug, int slot)
+  {
+    if (!IsStored(slot) || mNParams != plug.NParams())
+      return false;
+
+    StopCrossfade();
+
+    const double* pValues = GetNormalizedValues(slot);
+
+    plug.BeginParameterChangeBatch();
+
+    for (auto p = 0; p < mNParams; p++)
+    {
+      if (pValues[p] == plug.GetParam(p)->GetNormalized())
+        continue;
+
+      plug.SetParameterValue(p, pValues[p]);
+      plug.SendParameterValueFromDelegate(p, pValues[p], true);
+    }
+
+    plug.EndParameterChangeBatch();
+    mCurrentSlot = slot;
+    return true;
+  }
+
+  /** Switch to a slot, as a compare button does: the current values are kept in the slot that is being left, and the slot switched to is recalled.
+   * A slot that is empty gets a copy of the current values, so after the first switch from A to B both hold the same sound. Call this on the main thread
+   * @param plug The plug-in
+   * @param slot The slot to switch to
+   * @param crossfadeMs If greater than 0, the parameters crossfade to the slot's values over this time in ProcessCrossfade(), instead of changing immediately */
+  void Switch(IPlugAPIBase& plug, int slot, double crossfadeMs = 0.)
+  {
+    assert(slot >= 0 && slot < mNSlots);
+
+    // during a crossfade the parameters are between two slots, and the current one still holds where it is going
+    if (mCurrentSlot >= 0 && !IsCrossfading())
+      Store(plug, mCurrentSlot);
+
+    if (!IsStored(slot))
+      Store(plug, slot);
+
+    if (crossfadeMs <= 0.)
+    {
+      Recall(plug, slot);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mFadeMutex);
+
+    // the host is told where an interrupted crossfade got to
+    if (mFading || mFadeFinished.exchange(false, std::memory_order_acquire))
+      plug.InformHostOfParamValueChanges(mFadeParams.Get(), mFadeParams.GetSize());
+
+    WDL_TypedBuf<double> liveValues;
+    liveValues.Resize(mNParams);
+    mFadeParams.Resize(0, false);
+    const double* pValues = GetNormalizedValues(slot);
+
+    for (auto p = 0; p < mNParams; p++)
+    {
+      liveValues.Get()[p] = plug.GetParam(p)->GetNormalized();
+
+      if (liveValues.Get()[p] != pValues[p])
+        mFadeParams.Add(p);
+    }
+
+    mMorpher.Clear();
+    mMorpher.AddPresetFromValues(plug, liveValues.Get());
+    mMorpher.AddPresetFromValues(plug, pValues);
+    mFadeMs = crossfadeMs;
+    mFadePos = 0.;
+    mFading = mFadeParams.GetSize() > 0;
+    mCurrentSlot = slot;
+  }
+
+  /** Advance a crossfade started by Switch(). This method is realtime safe, call it on the audio thread with the parameters mutex held, e.g. at the start of ProcessBlock()
+   * @param plug The plug-in
+   * @param nFrames The number of frames in the block
+   * @param sampleRate The sample rate */
+  void ProcessCrossfade(IPlugAPIBase& plug, int nFrames, double sampleRate)
+  {
+    // never wait for the main thread, the crossfade just carries on in the next block
+    std::unique_lock<std::mutex> lock(mFadeMutex, std::try_to_lock);
+
+    if (!lock.owns_lock() || !mFading)
+      return;
+
+    mFadePos += nFrames / (mFadeMs * 0.001 * sampleRate);
+    mMorpher.Morph(std::min(mFadePos, 1.));
+    mMorpher.Apply(plug);
+
+    if (mFadePos >= 1.)
+    {
+      mFading = false;
+      mFadeFinished.store(true, std::memory_order_release);
+    }
+  }
+
+  /** Inform the host of the parameters changed by a crossfade that has finished, in one batch. Call this on the main thread, e.g. in OnIdle()
+   * @param plug The plug-in */
+  void Idle(IPlugAPIBase& plug)
+  {
+    if (mFadeFinished.exchange(false, std::memory_order_acquire))
+      plug.InformHostOfParamValueChanges(mFadeParams.Get(), mFadeParams.GetSize());
+  }
+
+  /** @return \c true if a crossfade is in progress */
+  bool IsCrossfading() const { return mFading.load(std::memory_order_relaxed); }
+
+private:
+  void StopCrossfade()
+  {
+    std::lock_guard<std::mutex> lock(mFadeMutex);
+    mFading = false;
+  }
+
+  int mNSlots;
+  int mNParams = 0;
+  int mCurrentSlot = -1;
+  WDL_TypedBuf<double> mValues; // the normalized values of each slot, one contiguous array of mNParams per slot
+  WDL_TypedBuf<bool> mStored;
+
+  std::mutex mFadeMutex; // guards the crossfade, the audio thread only ever tries to lock it
+  PresetMorpher mMorpher;
+  WDL_TypedBuf<int> mFadeParams; // the parameters that differ between the two ends of the crossfade
+  double mFadeMs = 0.;
+  double mFadePos = 0.;
+  std::atomic<bool> mFading {false};
+  std::atomic<bool> mFadeFinished {false};
+};
+
+END_IPLUG_NAMESPACE
@@ -15,11 +15,14 @@
  * @copydoc ControlRamp
  */
 
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <iostream>
 #include <utility>
 
+#include "IPlugSIMD.h"
+
 BEGIN_IPLUG_NAMESPACE
 
 /** A ControlRamp describes one value changing over time. It can
@@ -47,28 +50,34 @@ struct ControlRamp
     return (startValue != 0.) || (endValue != 0.);
   }
 
-  /** Writes the ramp signal to an output buffer.
+  /** @return \c true if the ramp is constant for the block, so that endValue can be used instead of writing the ramp */
+  bool IsSettled() const
+  {
+    return startValue == endValue;
+  }
+
+  /** Writes the ramp signal to an output buffer, with the transition written by simd::Ramp().
    * @param buffer Pointer to the start of an output buffer.
    * @param startIdx Sample index of the start of the desired write within the buffer.
    * @param nFrames The number of samples to be written. */
-  void Write(float* buffer, int startIdx, int nFrames)
+  void Write(float* buffer, int startIdx, int nFrames) const
   {
-    float val = static_cast<float>(startValue);
-    float dv = static_cast<float>((endValue - startValue)/(transitionEnd - transitionStart));
+    float* pDest = buffer + startIdx;
+    const float start = static_cast<float>(startValue);
+    const int transStart = std::min(transitionStart, nFrames);
+    const int transEnd = std::max(std::min(transitionEnd, nFrames), transStart);
+    float end = start;
 
-    for(int i=startIdx; i<startIdx + transitionStart; ++i)
-    {
-      buffer[i] = val;
-    }
-    for(int i=startIdx + transitionStart; i<startIdx + transitionEnd; ++i)
-    {
-      val += dv;
-      buffer[i] = val;
-    }
-    for(int i=startIdx + transitionEnd; i<startIdx + nFrames; ++i)
+    std::fill(pDest, pDest + transStart, start);
+
+    if(transitionEnd > transitionStart)
     {
-      buffer[i] = val;
+      const float dv = static_cast<float>((endValue - startValue)/(transitionEnd - transitionStart));
+      simd::Ramp(pDest + transStart, transEnd - transStart, start + dv, dv);
+      end = start + (transitionEnd - transitionStart) * dv;
     }
+
+    std::fill(pDest + transEnd, pDest + nFrames, end);
   }
     
   template<size_t N>
@@ -138,47 +138,24 @@ VoiceInputEvent MidiSynth::MidiMessageToEventMPE(const IMidiMsg& msg)
   bool isTimbre = (status == IMidiMsg::kControlChange) && (msg.ControlChangeIdx() == IMidiMsg::kCutoffFrequency);
   if(isPitchBend || isChannelPressure || isTimbre)
   {
-    float* pChannelDestValue{};
-    float masterChannelStoredValue{};
     if(isPitchBend)
     {
       event.mAction = kPitchBendAction;
       float bendRange = mChannelStates[event.mAddress.mChannel].pitchBendRange;
       event.mValue = static_cast<float>(msg.PitchWheel()) * bendRange / 12.f;
-
-      pChannelDestValue = &(mChannelStates[event.mAddress.mChannel].pitchBend);
-      masterChannelStoredValue = mChannelStates[MasterChannelFor(event.mAddress.mChannel)].pitchBend;
+      SumWithMasterChannel(event, &ChannelState::pitchBend);
     }
     else if(isChannelPressure)
     {
       event.mAction = kPressureAction;
       event.mValue = mAfterTouchLUT[msg.ChannelAfterTouch()];
-      pChannelDestValue = &(mChannelStates[event.mAddress.mChannel].pressure);
-      masterChannelStoredValue = mChannelStates[MasterChannelFor(event.mAddress.mChannel)].pressure;
+      SumWithMasterChannel(event, &ChannelState::pressure);
     }
     else if(isTimbre)
     {
       event.mAction = kTimbreAction;
       event.mValue = static_cast<float>(msg.ControlChange(msg.ControlChangeIdx()));
-      pChannelDestValue = &(mChannelStates[event.mAddress.mChannel].timbre);
-      masterChannelStoredValue = mChannelStates[MasterChannelFor(event.mAddress.mChannel)].timbre;
-    }
-
-    if(IsMasterChannel(event.mAddress.mChannel))
-    {
-      // store value in master channel
-      *pChannelDestValue = event.mValue;
-
-      // no action needed
-      event.mAction = kNullAction;
-    }
-    else
-    {
-      // add stored master channel value to event value
-      event.mValue += masterChannelStoredValue;
-
-      // store sum in member channel
-      *pChannelDestValue = event.mValue;
+      SumWithMasterChannel(event, &ChannelState::timbre);
     }
     return event;
   }
@@ -256,6 +233,187 @@ VoiceInputEvent MidiSynth::MidiMessageToEvent(const IMidiMsg& msg)
   return (mMPEMode ? MidiMessageToEventMPE(msg) : MidiMessageToEventBasic(msg));
 }
 
+// MPE pitch bend, channel pressure and CC#74 values are the sum of the main and member channel values
+void MidiSynth::SumWithMasterChannel(VoiceInputEvent& event, float ChannelState::* pValue)
+{
+  const int channel = event.mAddress.mChannel;
+
+  if(IsMasterChannel(channel))
+  {
+    // store value in master channel
+    mChannelStates[channel].*pValue = event.mValue;
+
+    // no action needed
+    event.mAction = kNullAction;
+  }
+  else
+  {
+    // add stored master channel value to event value
+    event.mValue += mChannelStates[MasterChannelFor(channel)].*pValue;
+
+    // store sum in member channel
+    mChannelStates[channel].*pValue = event.mValue;
+  }
+}
+
+bool IsRPNMessage(IMidiMsg msg)
+{
+  if(msg.StatusMsg() != IMidiMsg::kControlChange) return false;
+  int cc = msg.mData1;
+  return(cc == 0x64)||(cc == 0x65)||(cc == 0x26)||(cc == 0x06);
+}
+
+// MIDI 2.0 channel voice messages are converted without the 7-bit lookup tables, so velocities and controllers keep their 16 and 32-bit resolution
+VoiceInputEvent MidiSynth::UMPToEvent(const IMidiUMP& msg)
+{
+  VoiceInputEvent event{};
+  event.mSampleOffset = msg.mOffset;
+
+  if(msg.MessageType() == IMidiUMP::kMidi1ChannelVoice)
+  {
+    // MIDI 1.0 messages in a packet take the MIDI 1.0 path
+    IMidiMsg midi1Msg;
+    msg.ToMidiMsg(midi1Msg);
+
+    if(IsRPNMessage(midi1Msg))
+    {
+      HandleRPN(midi1Msg);
+      return event;
+    }
+
+    return MidiMessageToEvent(midi1Msg);
+  }
+
+  if(msg.MessageType() != IMidiUMP::kMidi2ChannelVoice)
+    return event;
+
+  const int channel = msg.Channel();
+  event.mAddress.mChannel = channel;
+  event.mAddress.mKey = msg.IsPerNote() ? msg.NoteNumber() : kAllKeys;
+
+  if(mMPEMode)
+    event.mAddress.mZone = MasterZoneFor(channel);
+
+  switch(msg.StatusMsg())
+  {
+    case IMidiUMP::kNoteOn:
+    {
+      // unlike MIDI 1.0, a velocity of 0 is still a note on
+      event.mAction = kNoteOnAction;
+      event.mValue = static_cast<float>(msg.Velocity());
+      break;
+    }
+    case IMidiUMP::kNoteOff:
+    {
+      event.mAction = kNoteOffAction;
+      event.mValue = static_cast<float>(msg.Velocity());
+      break;
+    }
+    case IMidiUMP::kPolyPressure:
+    {
+      // poly key pressure is ignored in MPE
+      event.mAction = mMPEMode ? kNullAction : kPressureAction;
+      event.mValue = static_cast<float>(msg.Value());
+      break;
+    }
+    case IMidiUMP::kChannelPressure:
+    {
+      event.mAction = kPressureAction;
+      event.mValue = static_cast<float>(msg.Value());
+
+      if(mMPEMode)
+        SumWithMasterChannel(event, &ChannelState::pressure);
+      break;
+    }
+    case IMidiUMP::kPitchBend:
+    {
+      event.mAction = kPitchBendAction;
+      float bendRange = mChannelStates[channel].pitchBendRange;
+      event.mValue = static_cast<float>(msg.PitchBend()) * bendRange / 12.f;
+
+      if(mMPEMode)
+        SumWithMasterChannel(event, &ChannelState::pitchBend);
+      break;
+    }
+    case IMidiUMP::kPerNotePitchBend:
+    {
+      event.mAction = kNotePitchBendAction;
+      float bendRange = mChannelStates[channel].pitchBendRange;
+      event.mValue = static_cast<float>(msg.PitchBend()) * bendRange / 12.f;
+      break;
+    }
+    case IMidiUMP::kControlChange:
+    {
+      event.mControllerNumber = msg.ControllerIdx();
+      event.mValue = static_cast<float>(msg.Value());
+      switch(event.mControllerNumber)
+      {
+        case IMidiMsg::kCutoffFrequency:
+        {
+          event.mAction = kTimbreAction;
+
+          if(mMPEMode)
+            SumWithMasterChannel(event, &ChannelState::timbre);
+          break;
+        }
+        case IMidiMsg::kAllNotesOff:
+        {
+          event.mAddress.mFlags = kVoicesAll;
+          event.mAction = kNoteOffAction;
+          break;
+        }
+        default:
+        {
+          event.mAction = kControllerAction;
+          break;
+        }
+      }
+      break;
+    }
+    case IMidiUMP::kRegisteredPerNoteController:
+    case IMidiUMP::kAssignablePerNoteController:
+    {
+      event.mControllerNumber = msg.ControllerIdx();
+      event.mValue = static_cast<float>(msg.Value());
+      const bool isRegistered = msg.StatusMsg() == IMidiUMP::kRegisteredPerNoteController;
+
+      if(isRegistered && event.mControllerNumber == IMidiUMP::kPerNotePitch)
+      {
+        // the absolute pitch of the note becomes a bend from its key, in octaves
+        event.mAction = kNotePitchBendAction;
+        event.mValue = static_cast<float>(msg.NotePitch() - msg.NoteNumber()) / 12.f;
+      }
+      else if(isRegistered && event.mControllerNumber == IMidiUMP::kPerNoteTimbre)
+        event.mAction = kTimbreAction;
+      else
+        event.mAction = kControllerAction;
+      break;
+    }
+    case IMidiUMP::kProgramChange:
+    {
+      // as for MIDI 1.0, program changes to MPE member channels are ignored
+      if(!mMPEMode || IsMasterChannel(channel))
+      {
+        event.mAction = kProgramChangeAction;
+        event.mControllerNumber = msg.Program();
+      }
+      break;
+    }
+    case IMidiUMP::kRegisteredController:
+    {
+      // MIDI 2.0 sends an RPN in one message, the top 7 bits of its value are the MIDI 1.0 data entry MSB
+      ApplyRPN(channel, msg.ControllerIdx(), static_cast<int>(msg.Value32() >> 25));
+      break;
+    }
+    default:
+    {
+      break;
+    }
+  }
+
+  return event;
+}
+
 // sets the number of channels in the lo or hi MPE zones.
 void MidiSynth::SetMPEZones(int channel, int nChans)
 {
@@ -332,13 +490,6 @@ void MidiSynth::SetChannelPitchBendRange(int channelParam, int rangeParam)
   }
 }
 
-bool IsRPNMessage(IMidiMsg msg)
-{
-  if(msg.StatusMsg() != IMidiMsg::kControlChange) return false;
-  int cc = msg.mData1;
-  return(cc == 0x64)||(cc == 0x65)||(cc == 0x26)||(cc == 0x06);
-}
-
 void MidiSynth::HandleRPN(IMidiMsg msg)
 {
   int channel = msg.Channel();
@@ -372,23 +523,28 @@ void MidiSynth::HandleRPN(IMidiMsg msg)
       {
         value = state.valueMSB&0xFF;
       }
-      std::cout << "RPN received: channel " << channel << ", param " << param << ", value " << value << "\n";
-      switch(param)
+      ApplyRPN(channel, param, value);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void MidiSynth::ApplyRPN(int channel, int param, int value)
+{
+  std::cout << "RPN received: channel " << channel << ", param " << param << ", value " << value << "\n";
+  switch(param)
+  {
+    case 0: // RPN 0 : pitch bend range
+      SetChannelPitchBendRange(channel, value);
+      break;
+    case 6: // RPN 6 : MPE zone configuration. These messages may turn MPE mode on or off.
+      if(IsMasterChannel(channel))
       {
-        case 0: // RPN 0 : pitch bend range
-          SetChannelPitchBendRange(channel, value);
-          break;
-        case 6: // RPN 6 : MPE zone configuration. These messages may turn MPE mode on or off.
-          if(IsMasterChannel(channel))
-          {
-            SetMPEZones(channel, value);
-          }
-          break;
-        default:
-          break;
+        SetMPEZones(channel, value);
       }
       break;
-
     default:
       break;
   }
@@ -398,7 +554,7 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
 {
   assert(NVoices());
 
-  if (mVoicesAreActive | !mMidiQueue.Empty())
+  if (mVoicesAreActive | !mMidiQueue.Empty() | !mUMPQueue.Empty())
   {
     int blockSize = mBlockSize;
     int samplesRemaining = nFrames;
@@ -406,30 +562,63 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
 
     while(samplesRemaining > 0)
     {
-      if(samplesRemaining < blockSize)
-        blockSize = samplesRemaining;
+      int lastEventOffset;
 
-      while (!mMidiQueue.Empty())
+      if(mAdaptiveBlockSize)
+      {
+        // only the events at the start of the span are sent, the span is cut short at the next one below
+        blockSize = std::min(samplesRemaining, mMaxAdaptiveBlockSize);
+        lastEventOffset = startIndex;
+      }
+      else
       {
-        IMidiMsg msg = mMidiQueue.Peek();
+        if(samplesRemaining < blockSize)
+          blockSize = samplesRemaining;
+
+        lastEventOffset = startIndex + blockSize;
+      }
 
+      while (true)
+      {
         // we assume the messages are in chronological order. If we find one later than the current block we are done.
-        if (msg.mOffset > startIndex + blockSize) break;
+        // MIDI 1.0 and 2.0 messages are interleaved by offset, at the same offset MIDI 1.0 messages go first
+        const bool hasMidiMsg = !mMidiQueue.Empty() && mMidiQueue.Peek().mOffset <= lastEventOffset;
+        const bool hasUMP = !mUMPQueue.Empty() && mUMPQueue.Peek().mOffset <= lastEventOffset;
 
-        if(IsRPNMessage(msg))
+        if (hasMidiMsg && (!hasUMP || mMidiQueue.Peek().mOffset <= mUMPQueue.Peek().mOffset))
         {
-          HandleRPN(msg);
+          IMidiMsg msg = mMidiQueue.Peek();
+
+          if(IsRPNMessage(msg))
+          {
+            HandleRPN(msg);
+          }
+          else
+          {
+            // send performance messages to the voice allocator
+            // message offset is relative to the start of this processSamples() block
+            msg.mOffset -= startIndex;
+            mVoiceAllocator.AddEvent(MidiMessageToEvent(msg));
+          }
+          mMidiQueue.Remove();
         }
-        else
+        else if (hasUMP)
         {
-          // send performance messages to the voice allocator
-          // message offset is relative to the start of this processSamples() block
+          IMidiUMP msg = mUMPQueue.Peek();
           msg.mOffset -= startIndex;
-          mVoiceAllocator.AddEvent(MidiMessageToEvent(msg));
+          mVoiceAllocator.AddEvent(UMPToEvent(msg));
+          mUMPQueue.Remove();
         }
-        mMidiQueue.Remove();
+        else
+          break;
       }
 
+      if(mAdaptiveBlockSize && !mMidiQueue.Empty())
+        blockSize = std::min(blockSize, mMidiQueue.Peek().mOffset - startIndex);
+
+      if(mAdaptiveBlockSize && !mUMPQueue.Empty())
+        blockSize = std::min(blockSize, mUMPQueue.Peek().mOffset - startIndex);
+
       mVoiceAllocator.ProcessEvents(blockSize, mSampleTime);
       mVoiceAllocator.ProcessVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
 
@@ -460,6 +649,7 @@ bool MidiSynth::ProcessBlock(sample** inputs, sample** outputs, int nInputs, int
     mVoicesAreActive = voicesbusy;
 
     mMidiQueue.Flush(nFrames);
+    mUMPQueue.Flush(nFrames);
   }
   else // empty block
   {
@@ -475,6 +665,7 @@ void MidiSynth::SetSampleRateAndBlockSize(double sampleRate, int blockSize)
 
   mSampleRate = sampleRate;
   mMidiQueue.Resize(blockSize);
+  mUMPQueue.Resize(blockSize);
   mVoiceAllocator.SetSampleRateAndBlockSize(sampleRate, blockSize);
 
   for(int v = 0; v < NVoices(); v++)
@@ -15,6 +15,7 @@
  * @copydoc MidiSynth
  */
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <stdint.h>
@@ -39,6 +40,8 @@ class MidiSynth
 public:
   /** This defines the size in samples of a single block of processing that will be done by the synth. */
   static constexpr int kDefaultBlockSize = 32;
+  /** The longest span rendered in one go by default with SetAdaptiveBlockSize() */
+  static constexpr int kDefaultMaxAdaptiveBlockSize = 256;
   static constexpr int kDefaultPitchBendRange = 12;
 
 #pragma mark - MidiSynth class
@@ -94,6 +97,47 @@ public:
     mVoiceAllocator.mATMode = mode;
   }
 
+  /** Stack several detuned voices on each note, see VoiceAllocator::SetUnison()
+   * @param nVoices The number of voices per note
+   * @param detune The spread in semitones between the lowest and highest voice of a note */
+  void SetUnison(int nVoices, float detune)
+  {
+    mVoiceAllocator.SetUnison(nVoices, detune);
+  }
+
+  /** Choose which voice a new note takes when all voices are busy
+   * @param mode See VoiceAllocator::EStealMode */
+  void SetStealMode(VoiceAllocator::EStealMode mode)
+  {
+    mVoiceAllocator.mStealMode = mode;
+  }
+
+  /** Lower polyphony when the voices take too long to render, see VoiceAllocator::SetCPUBudget()
+   * @param budget The fraction of each block's duration that the voices may take, or 0 to turn the governor off */
+  void SetCPUBudget(double budget)
+  {
+    mVoiceAllocator.SetCPUBudget(budget);
+  }
+
+  /** @return The number of voices the CPU governor allows at the moment, see VoiceAllocator::GetGovernedPolyphony() */
+  int GetGovernedPolyphony() const
+  {
+    return mVoiceAllocator.GetGovernedPolyphony();
+  }
+
+  /** @return The number of busy voices that have been stolen for new notes, see VoiceAllocator::GetStealCount() */
+  int64_t GetStealCount() const
+  {
+    return mVoiceAllocator.GetStealCount();
+  }
+
+  /** Limit the number of voices used for new notes, see VoiceAllocator::SetPolyphony()
+   * @param nVoices The maximum number of voices, or 0 to use all of them */
+  void SetPolyphony(int nVoices)
+  {
+    mVoiceAllocator.SetPolyphony(nVoices);
+  }
+
   /** Set this function to something other than the default
    * if you need to implement a tuning table for microtonal support
    * @param fn A function taking an integer key value and returning a double-precision
@@ -145,6 +189,50 @@ public:
     mMidiQueue.Add(msg);
   }
 
+  /** Queue a MIDI 2.0 message, e.g. from IPlugProcessor::ProcessUMP(). The 16-bit velocities and 32-bit controller values reach the voices without being reduced to
+   * MIDI 1.0 resolution, per-note controllers and poly pressure go to the voices playing the note, and per-note pitch bend is added to the channel's pitch bend
+   * @param msg The message, which is dropped if more arrive in a block than the block size passed to SetSampleRateAndBlockSize() */
+  void AddUMPToQueue(const IMidiUMP& msg)
+  {
+    mUMPQueue.Add(msg);
+  }
+
+  /** Render the voices in parallel on a worker pool, see VoiceAllocator::SetWorkerPool(). Since the pool is woken for each block of the synth's block size, a larger
+   * block size than kDefaultBlockSize makes better use of it. This method is not realtime safe
+   * @param pPool The pool, e.g. IPlugProcessor::GetWorkerPool(), or nullptr to render the voices on the audio thread
+   * @param nInputs The largest number of inputs that will be passed to ProcessBlock()
+   * @param nOutputs The largest number of outputs that will be passed to ProcessBlock() */
+  void SetWorkerPool(IPlugWorkerPool* pPool, int nInputs, int nOutputs)
+  {
+    mVoiceAllocator.SetWorkerPool(pPool, GetMaxBlockSize(), nInputs, nOutputs);
+  }
+
+  /** Render the voices in spans that only end at the offsets of MIDI events, rather than in blocks of the fixed block size, so that blocks without events
+   * take one call to each voice. Glides that start or end within a span are still sample accurate, as each ControlRamp holds one transition. Call this before SetWorkerPool().
+   * This method is not realtime safe
+   * @param adaptive \c true to render between events, \c false to render in blocks of the size passed to the constructor
+   * @param maxBlockSize The longest span, which bounds the time between updates of the glides and of anything voices compute once per call */
+  void SetAdaptiveBlockSize(bool adaptive, int maxBlockSize = kDefaultMaxAdaptiveBlockSize)
+  {
+    mAdaptiveBlockSize = adaptive;
+    mMaxAdaptiveBlockSize = std::max(maxBlockSize, 1);
+
+    if (mControlRampBuffers)
+      SetControlRampBuffers(true);
+  }
+
+  /** Write the voices' control ramps into one buffer before they render, for voices that read them with SynthVoice::GetControlRamp(), see VoiceAllocator::SetControlRampBuffers().
+   * This method is not realtime safe
+   * @param enable \c true to write the buffers */
+  void SetControlRampBuffers(bool enable)
+  {
+    mControlRampBuffers = enable;
+    mVoiceAllocator.SetControlRampBuffers(enable ? GetMaxBlockSize() : 0);
+  }
+
+  /** @return The most frames that the voices are rendered for in one call */
+  int GetMaxBlockSize() const { return mAdaptiveBlockSize ? mMaxAdaptiveBlockSize : mBlockSize; }
+
   /** Processes a block of audio samples
    * @param inputs Pointer to input Arrays
    * @param outputs Pointer to output Arrays
@@ -190,16 +278,23 @@ private:
   VoiceInputEvent MidiMessageToEventBasic(const IMidiMsg& msg);
   VoiceInputEvent MidiMessageToEventMPE(const IMidiMsg& msg);
   VoiceInputEvent MidiMessageToEvent(const IMidiMsg& msg);
+  VoiceInputEvent UMPToEvent(const IMidiUMP& msg);
+  void SumWithMasterChannel(VoiceInputEvent& event, float ChannelState::* pValue);
   void HandleRPN(IMidiMsg msg);
+  void ApplyRPN(int channel, int param, int value);
 
   // basic MIDI data
   VoiceAllocator mVoiceAllocator;
   uint16_t mUnisonVoices{1};
   IMidiQueue mMidiQueue;
+  IMidiUMPQueue mUMPQueue;
   float mVelocityLUT[128];
   float mAfterTouchLUT[128];
   ChannelState mChannelStates[16]{};
   int mBlockSize;
+  bool mAdaptiveBlockSize = false;
+  int mMaxAdaptiveBlockSize = kDefaultMaxAdaptiveBlockSize;
+  bool mControlRampBuffers = false;
   int64_t mSampleTime{0};
   double mSampleRate = DEFAULT_SAMPLE_RATE;
   bool mVoicesAreActive = false;
@@ -0,0 +1,655 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Disk streaming sample playback for synth voices, for sample libraries too large to hold in memory
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fileread.h"
+#include "pcmfmtcvt.h"
+
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A sample in a WAV file, of which only the first frames, the preload head, are held in memory. The rest is read by a SampleStreamer while a voice plays it.
+ * A StreamedSample is immutable once loaded, so it can be shared by every voice, and must outlive any stream playing it */
+class StreamedSample
+{
+public:
+  static constexpr int kDefaultPreloadFrames = 16384;
+
+  /** Load the header and preload head of a WAV file, 16, 24 or 32 bit integer or 32 bit float. This reads from disk, so don't call it on the audio thread
+   * @param path The path of the file
+   * @param preloadFrames The number of frames to hold in memory, which must cover the time the streamer takes to start reading, at the fastest rate the sample is played
+   * @return The sample, or nullptr if the file can't be read */
+  static std::unique_ptr<StreamedSample> FromWav(const char* path, int preloadFrames = kDefaultPreloadFrames)
+  {
+    WDL_FileRead file(path);
+
+    if (!file.IsOpen())
+      return nullptr;
+
+    unsigned char header[12];
+
+    if (file.Read(header, 12) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+      return nullptr;
+
+    std::unique_ptr<StreamedSample> pSample(new StreamedSample);
+    pSample->mPath = path;
+    bool gotFormat = false;
+
+    // walk the chunks until the data, which must follow the format
+    for (;;)
+    {
+      unsigned char chunk[8];
+
+      if (file.Read(chunk, 8) != 8)
+        return nullptr;
+
+      const int64_t chunkSize = ReadLE(chunk + 4, 4);
+
+      if (!memcmp(chunk, "fmt ", 4))
+      {
+        unsigned char fmt[40] = {};
+        const int n = static_cast<int>(std::min<int64_t>(chunkSize, sizeof(fmt)));
+
+        if (n < 16 || file.Read(fmt, n) != n)
+          return nullptr;
+
+        int formatTag = static_cast<int>(ReadLE(fmt, 2));
+
+        if (formatTag == 0xFFFE && n >= 26) // WAVE_FORMAT_EXTENSIBLE, the sub format is at the start of the GUID
+          formatTag = static_cast<int>(ReadLE(fmt + 24, 2));
+
+        pSample->mNChans = static_cast<int>(ReadLE(fmt + 2, 2));
+        pSample->mSampleRate = static_cast<double>(ReadLE(fmt + 4, 4));
+        pSample->mBitsPerSample = static_cast<int>(ReadLE(fmt + 14, 2));
+        pSample->mIsFloat = formatTag == 3;
+
+        const bool validInt = formatTag == 1 && (pSample->mBitsPerSample == 16 || pSample->mBitsPerSample == 24 || pSample->mBitsPerSample == 32);
+        const bool validFloat = formatTag == 3 && pSample->mBitsPerSample == 32;
+
+        if (pSample->mNChans < 1 || !(validInt || validFloat))
+          return nullptr;
+
+        gotFormat = true;
+        file.SetPosition(file.GetPosition() + chunkSize - n + (chunkSize & 1));
+      }
+      else if (!memcmp(chunk, "data", 4))
+      {
+        if (!gotFormat)
+          return nullptr;
+
+        pSample->mDataOffset = file.GetPosition();
+        pSample->mNFrames = std::min<int64_t>(chunkSize, file.GetSize() - pSample->mDataOffset) / pSample->GetFrameBytes();
+        break;
+      }
+      else
+      {
+        file.SetPosition(file.GetPosition() + chunkSize + (chunkSize & 1));
+      }
+    }
+
+    const int nPreload = static_cast<int>(std::min<int64_t>(preloadFrames, pSample->mNFrames));
+    std::vector<unsigned char> bytes(static_cast<size_t>(nPreload) * pSample->GetFrameBytes());
+    pSample->mPreload.resize(static_cast<size_t>(nPreload) * pSample->mNChans);
+
+    if (file.Read(bytes.data(), static_cast<int>(bytes.size())) != static_cast<int>(bytes.size()))
+      return nullptr;
+
+    pSample->Decode(bytes.data(), pSample->mPreload.data(), nPreload);
+    pSample->mNPreloadFrames = nPreload;
+    return pSample;
+  }
+
+  const char* GetPath() const { return mPath.c_str(); }
+  int NChans() const { return mNChans; }
+  int64_t NFrames() const { return mNFrames; }
+  double GetSampleRate() const { return mSampleRate; }
+
+  /** @return The number of frames held in memory */
+  int NPreloadFrames() const { return mNPreloadFrames; }
+
+  /** @return The preload head, as interleaved frames */
+  const float* GetPreload() const { return mPreload.data(); }
+
+  /** @return The position of a frame in the file */
+  int64_t GetFrameOffset(int64_t frame) const { return mDataOffset + frame * GetFrameBytes(); }
+
+  /** @return The number of bytes of a frame in the file */
+  int GetFrameBytes() const { return mNChans * mBitsPerSample / 8; }
+
+  /** Convert frames read from the file to floats
+   * @param pSrc nFrames * GetFrameBytes() bytes from the file
+   * @param pDest nFrames * NChans() interleaved floats
+   * @param nFrames The number of frames */
+  void Decode(const unsigned char* pSrc, float* pDest, int nFrames) const
+  {
+    const int nSamples = nFrames * mNChans;
+
+    if (mIsFloat)
+      memcpy(pDest, pSrc, nSamples * sizeof(float));
+    else
+      pcmToDoubles(const_cast<unsigned char*>(pSrc), nSamples, mBitsPerSample, 1, pDest, 1);
+  }
+
+private:
+  StreamedSample() = default;
+
+  static int64_t ReadLE(const unsigned char* p, int nBytes)
+  {
+    int64_t v = 0;
+
+    for (int i = nBytes - 1; i >= 0; i--)
+      v = (v << 8) | p[i];
+
+    return v;
+  }
+
+  std::string mPath;
+  int mNChans = 0;
+  int mBitsPerSample = 16;
+  bool mIsFloat = false;
+  double mSampleRate = 44100.;
+  int64_t mDataOffset = 0;
+  int64_t mNFrames = 0;
+  int mNPreloadFrames = 0;
+  std::vector<float> mPreload;
+};
+
+/** Streams StreamedSamples from disk for synth voices. StartStream() claims one of a fixed number of streams on the audio thread, playback begins at once from the sample's
+ * preload head, and a background I/O thread opens the file and fills the stream's ring buffer with the frames that follow, the emptiest stream first. If a stream's ring buffer
+ * runs dry, Read() outputs silence for the missing frames, so that the voice stays in time, and counts them as underrun frames.
+ * Files are read with WDL_FileRead, which uses memory mapping or asynchronous reads where the platform supports them. StartStream(), StopStream() and Read() are realtime safe,
+ * and a stream must only be used by one voice on the audio thread at a time */
+class SampleStreamer
+{
+public:
+  static constexpr int kDefaultRingFrames = 32768;
+
+  /** This method is not realtime safe
+   * @param maxStreams The number of streams that can play at once, usually the number of voices
+   * @param maxChans The most channels of any sample that will be streamed
+   * @param ringFrames The frames of each stream's ring buffer, i.e. how far the I/O thread reads ahead */
+  SampleStreamer(int maxStreams, int maxChans = 2, int ringFrames = kDefaultRingFrames)
+  : mMaxChans(maxChans)
+  , mRingFrames(ringFrames)
+  , mStreams(maxStreams)
+  {
+    for (auto& stream : mStreams)
+      stream.ring.resize(static_cast<size_t>(ringFrames) * maxChans);
+
+    mThread = std::thread(&SampleStreamer::ThreadFunc, this);
+  }
+
+  ~SampleStreamer()
+  {
+    mRunning = false;
+    mWakeCondition.notify_one();
+    mThread.join();
+  }
+
+  SampleStreamer(const SampleStreamer&) = delete;
+  SampleStreamer& operator=(const SampleStreamer&) = delete;
+
+  /** Start streaming a sample, e.g. from SynthVoice::Trigger(), which also has the I/O thread prefetch the frames after the preload head
+   * @param pSample The sample, which must not have more than the maxChans given to the constructor
+   * @param startFrame The frame to start from
+   * @return The index of the stream, or -1 if all the streams are in use */
+  int StartStream(const StreamedSample* pSample, int64_t startFrame = 0)
+  {
+    for (int i = 0; i < NStreams(); i++)
+    {
+      Stream& stream = mStreams[i];
+
+      if (stream.state.load(std::memory_order_acquire) != kStateFree)
+        continue;
+
+      stream.pSample = pSample;
+      stream.readFrame.store(startFrame, std::memory_order_relaxed);
+      stream.writeFrame.store(std::max<int64_t>(startFrame, pSample->NPreloadFrames()), std::memory_order_relaxed);
+      stream.underrunFrames.store(0, std::memory_order_relaxed);
+      stream.state.store(kStateRequested, std::memory_order_release);
+      mWakeCondition.notify_one();
+      return i;
+    }
+
+    return -1;
+  }
+
+  /** Stop a stream, the I/O thread closes its file and frees it
+   * @param streamIdx The index returned by StartStream() */
+  void StopStream(int streamIdx)
+  {
+    mStreams[streamIdx].state.store(kStateStopping, std::memory_order_release);
+    mWakeCondition.notify_one();
+  }
+
+  /** Read the next frames of a stream
+   * @param streamIdx The index returned by StartStream()
+   * @param outputs nChans arrays of at least nFrames floats, which are overwritten. If the sample has fewer channels they are repeated
+   * @param nChans The number of outputs
+   * @param nFrames The number of frames to read
+   * @return The number of frames read before the end of the sample, the rest of the outputs are silent */
+  int Read(int streamIdx, float** outputs, int nChans, int nFrames)
+  {
+    Stream& stream = mStreams[streamIdx];
+    const StreamedSample& sample = *stream.pSample;
+    const int sampleChans = sample.NChans();
+    const int64_t start = stream.readFrame.load(std::memory_order_relaxed);
+    const int64_t end = std::min(start + nFrames, sample.NFrames());
+    const int64_t written = stream.writeFrame.load(std::memory_order_acquire);
+    int pos = 0;
+
+    // the preload head, then the ring buffer
+    for (int64_t f = start; f < std::min<int64_t>(end, sample.NPreloadFrames()); f++, pos++)
+    {
+      const float* pFrame = sample.GetPreload() + f * sampleChans;
+
+      for (int c = 0; c < nChans; c++)
+        outputs[c][pos] = pFrame[c % sampleChans];
+    }
+
+    for (int64_t f = start + pos; f < std::min(end, written); f++, pos++)
+    {
+      const float* pFrame = stream.ring.data() + (f % mRingFrames) * mMaxChans;
+
+      for (int c = 0; c < nChans; c++)
+        outputs[c][pos] = pFrame[c % sampleChans];
+    }
+
+    const int nRead = static_cast<int>(std::max<int64_t>(end - start, 0));
+
+    if (pos < nRead)
+    {
+      stream.underrunFrames.fetch_add(nRead - pos, std::memory_order_relaxed);
+      mUnderrunFrames.fetch_add(nRead - pos, std::memory_order_relaxed);
+    }
+
+    for (int c = 0; c < nChans; c++)
+      std::fill(outputs[c] + pos, outputs[c] + nFrames, 0.f);
+
+    stream.readFrame.store(start + nRead, std::memory_order_release);
+
+    if (stream.readFrame.load(std::memory_order_relaxed) + mRingFrames / 2 > written)
+      mWakeCondition.notify_one();
+
+    return nRead;
+  }
+
+  /** @return \c true if the stream has played to the end of its sample */
+  bool IsFinished(int streamIdx) const
+  {
+    const Stream& stream = mStreams[streamIdx];
+    return stream.readFrame.load(std::memory_order_relaxed) >= stream.pSample->NFrames();
+  }
+
+  /** @return The number of frames of a stream that were output as silence because the disk couldn't keep up */
+  int64_t GetUnderrunFrames(int streamIdx) const { return mStreams[streamIdx].underrunFrames.load(std::memory_order_relaxed); }
+
+  /** @return The number of frames of all streams that were output as silence because the disk couldn't keep up, since the last call to ResetUnderrunFrames() */
+  int64_t GetUnderrunFrames() const { return mUnderrunFrames.load(std::memory_order_relaxed); }
+
+  void ResetUnderrunFrames() { mUnderrunFrames.store(0, std::memory_order_relaxed); }
+
+  int NStreams() const { return static_cast<int>(mStreams.size()); }
+
+private:
+  static constexpr int kReadChunkFrames = 4096;
+
+  enum EStreamState
+  {
+    kStateFree = 0, // can be claimed by StartStream()
+    kStateRequested, // claimed, waiting for the I/O thread to open the file
+    kStateActive, // the I/O thread is filling the ring buffer
+    kStateStopping // waiting for the I/O thread to close the file
+  };
+
+  struct Stream
+  {
+    std::atomic<int> state {kStateFree};
+    const StreamedSample* pSample = nullptr;
+    std::atomic<int64_t> readFrame {0}; // the next frame Read() outputs, written by the audio thread
+    std::atomic<int64_t> writeFrame {0}; // the frame after the last in the ring buffer, written by the I/O thread
+    std::atomic<int64_t> underrunFrames {0};
+    std::vector<float> ring; // interleaved frames, with maxChans channels, frame f at f % ringFrames
+    std::unique_ptr<WDL_FileRead> pFile; // only used by the I/O thread
+  };
+
+  void ThreadFunc()
+  {
+    std::vector<unsigned char> bytes;
+    std::vector<float> decoded;
+
+    while (mRunning)
+    {
+      Stream* pMostUrgent = nullptr;
+      int64_t leastBuffered = mRingFrames;
+
+      for (auto& stream : mStreams)
+      {
+        switch (stream.state.load(std::memory_order_acquire))
+        {
+          case kStateRequested:
+          {
+            stream.pFile.reset(new WDL_FileRead(stream.pSample->GetPath()));
+            int expected = kStateRequested;
+            stream.state.compare_exchange_strong(expected, kStateActive, std::memory_order_acq_rel);
+            break;
+          }
+          case kStateStopping:
+          {
+            stream.pFile.reset();
+            stream.state.store(kStateFree, std::memory_order_release);
+            break;
+          }
+          default:
+            break;
+        }
+
+        if (stream.state.load(std::memory_order_acquire) != kStateActive || !stream.pFile || !stream.pFile->IsOpen())
+          continue;
+
+        // frames that Read() has skipped past in an underrun are not read
+        const int64_t readPos = std::max<int64_t>(stream.readFrame.load(std::memory_order_acquire), stream.pSample->NPreloadFrames());
+        const int64_t written = std::max(stream.writeFrame.load(std::memory_order_relaxed), readPos);
+        stream.writeFrame.store(written, std::memory_order_release);
+
+        const int64_t buffered = written - readPos;
+        const bool full = buffered + kReadChunkFrames > mRingFrames;
+
+        if (!full && written < stream.pSample->NFrames() && buffered < leastBuffered)
+        {
+          leastBuffered = buffered;
+          pMostUrgent = &stream;
+        }
+      }
+
+      if (!pMostUrgent)
+      {
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWakeCondition.wait_for(lock, std::chrono::milliseconds(1));
+        continue;
+      }
+
+      FillChunk(*pMostUrgent, bytes, decoded);
+    }
+  }
+
+  /** Read the next chunk of a stream's file into its ring buffer */
+  void FillChunk(Stream& stream, std::vector<unsigned char>& bytes, std::vector<float>& decoded)
+  {
+    const StreamedSample& sample = *stream.pSample;
+    const int sampleChans = sample.NChans();
+    const int64_t written = stream.writeFrame.load(std::memory_order_relaxed);
+    const int nFrames = static_cast<int>(std::min<int64_t>(kReadChunkFrames, sample.NFrames() - written));
+
+    bytes.resize(static_cast<size_t>(nFrames) * sample.GetFrameBytes());
+    decoded.resize(static_cast<size_t>(nFrames) * sampleChans);
+
+    stream.pFile->SetPosition(sample.GetFrameOffset(written));
+    const int nRead = stream.pFile->Read(bytes.data(), static_cast<int>(bytes.size())) / sample.GetFrameBytes();
+
+    if (nRead <= 0)
+    {
+      // a truncated file, stop reading rather than retrying, and the rest of the stream underruns
+      stream.pFile.reset();
+      return;
+    }
+
+    sample.Decode(bytes.data(), decoded.data(), nRead);
+
+    for (int i = 0; i < nRead; i++)
+    {
+      float* pFrame = stream.ring.data() + ((written + i) % mRingFrames) * mMaxChans;
+      std::copy_n(decoded.data() + i * sampleChans, sampleChans, pFrame);
+    }
+
+    stream.writeFrame.store(written + nRead, std::memory_order_release);
+  }
+
+  const int mMaxChans;
+  const int mRingFrames;
+  std::vector<Stream> mStreams;
+  std::atomic<int64_t> mUnderrunFrames {0};
+  std::atomic<bool> mRunning {true};
+  std::thread mThread;
+  std::mutex mWakeMutex;
+  std::condition_variable mWakeCondition;
+};
+
+/** A SynthVoice that plays StreamedSamples through a SampleStreamer. Each key plays the sample mapped to the nearest key at or below it, repitched from the sample's root key,
+ * see SetSample(). Add one voice per stream of the streamer to a MidiSynth; the stream is started by Trigger(), so the streamer prefetches from the note on.
+ * Voices that are stolen or killed fade out quickly before their stream is stopped */
+class SampleVoice : public SynthVoice
+{
+public:
+  static constexpr int kNumKeys = 128;
+
+  /** @param streamer The streamer, which must outlive the voice
+   * @param maxBlockSize The largest number of frames the voice renders at once */
+  SampleVoice(SampleStreamer& streamer, int maxBlockSize = 1024)
+  : mStreamer(streamer)
+  {
+    mSamples.fill(nullptr);
+    mRootKeys.fill(60);
+    SetSampleRateAndBlockSize(44100., maxBlockSize);
+  }
+
+  ~SampleVoice()
+  {
+    StopStream();
+  }
+
+  /** Map a sample to a range of keys. This method is not realtime safe, so set the map up before the voice plays, or share it between voices with a const copy
+   * @param pSample The sample, or nullptr for silence
+   * @param lowKey The lowest key that plays the sample, it plays up to the next key with a sample
+   * @param rootKey The key at which the sample plays at its recorded pitch */
+  void SetSample(const StreamedSample* pSample, int lowKey, int rootKey)
+  {
+    for (int k = lowKey; k < kNumKeys && (k == lowKey || !mIsLowKey[k]); k++)
+    {
+      mSamples[k] = pSample;
+      mRootKeys[k] = rootKey;
+    }
+
+    mIsLowKey[lowKey] = true;
+  }
+
+  /** @param timeMs The release time, which is also used as the fade when the voice is stolen or killed */
+  void SetReleaseTime(double timeMs)
+  {
+    mReleaseTimeMs = timeMs;
+    mReleaseIncr = 1. / std::max(timeMs * 0.001 * mSampleRate, 1.);
+  }
+
+  bool GetBusy() const override { return mStreamIdx >= 0 || mPendingStart; }
+
+  double GetLevel() const override { return mGain * mEnvelope; }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    if (mStreamIdx >= 0 && mEnvelope > 0.)
+    {
+      // fade out the current sample first, then start the new one
+      mReleasing = true;
+      mPendingStart = true;
+      mPendingLevel = level;
+      mPendingKey = mKey;
+      return;
+    }
+
+    Start(level, mKey);
+  }
+
+  void Release() override
+  {
+    mReleasing = true;
+    mPendingStart = false;
+  }
+
+  void Kill() override
+  {
+    Release();
+  }
+
+  void SetSampleRateAndBlockSize(double sampleRate, int blockSize) override
+  {
+    mSampleRate = sampleRate;
+    SetReleaseTime(mReleaseTimeMs);
+
+    const int maxFrames = static_cast<int>(blockSize * kMaxRate) + 4;
+
+    for (auto& buf : mReadBuffers)
+      buf.resize(maxFrames);
+
+    mBlockSize = blockSize;
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    for (int pos = 0; pos < nFrames; pos += mBlockSize)
+      Render(outputs, std::min(nOutputs, kMaxChans), startIdx + pos, std::min(nFrames - pos, mBlockSize));
+  }
+
+private:
+  static constexpr int kMaxChans = 2;
+  static constexpr double kMaxRate = 4.; // the fastest rate a sample is read, two octaves above its root key
+
+  void Start(double level, int key)
+  {
+    StopStream();
+
+    const StreamedSample* pSample = key < kNumKeys ? mSamples[key] : nullptr;
+    mPendingStart = false;
+
+    if (!pSample)
+      return;
+
+    mStreamIdx = mStreamer.StartStream(pSample);
+
+    if (mStreamIdx < 0)
+      return;
+
+    mSample = pSample;
+    mRate = std::min(std::pow(2., (key - mRootKeys[key]) / 12.) * pSample->GetSampleRate() / mSampleRate, kMaxRate);
+    mFrac = 0.;
+    mNBuffered = 0;
+    mNSampleFrames = 0;
+    mGain = level;
+    mEnvelope = 1.;
+    mReleasing = false;
+  }
+
+  void StopStream()
+  {
+    if (mStreamIdx >= 0)
+      mStreamer.StopStream(mStreamIdx);
+
+    mStreamIdx = -1;
+  }
+
+  /** Render up to the block size, reading the frames the interpolation needs from the stream */
+  void Render(sample** outputs, int nOutputs, int startIdx, int nFrames)
+  {
+    if (mStreamIdx < 0)
+      return;
+
+    // frames are kept in mReadBuffers from index 0, the frame at mFrac's integer part and the next
+    const int needed = static_cast<int>(mFrac + mRate * nFrames) + 2;
+
+    if (needed > mNBuffered)
+    {
+      float* ptrs[kMaxChans] = {mReadBuffers[0].data() + mNBuffered, mReadBuffers[1].data() + mNBuffered};
+      mNSampleFrames += mStreamer.Read(mStreamIdx, ptrs, kMaxChans, needed - mNBuffered);
+      mNBuffered = needed;
+    }
+
+    double frac = mFrac;
+
+    for (int s = 0; s < nFrames; s++)
+    {
+      const int i = static_cast<int>(frac);
+      const float t = static_cast<float>(frac - i);
+      const double gain = mGain * mEnvelope;
+
+      for (int c = 0; c < nOutputs; c++)
+      {
+        const float* pBuf = mReadBuffers[c].data();
+        outputs[c][startIdx + s] += static_cast<sample>((pBuf[i] + t * (pBuf[i + 1] - pBuf[i])) * gain);
+      }
+
+      frac += mRate;
+
+      if (mReleasing)
+        mEnvelope = std::max(mEnvelope - mReleaseIncr, 0.);
+    }
+
+    // keep the frames the next block starts from
+    const int consumed = static_cast<int>(frac);
+
+    for (auto& buf : mReadBuffers)
+      std::copy(buf.begin() + consumed, buf.begin() + mNBuffered, buf.begin());
+
+    mNBuffered -= consumed;
+    mNSampleFrames -= consumed;
+    mFrac = frac - consumed;
+
+    if (mEnvelope <= 0. || (mStreamer.IsFinished(mStreamIdx) && mNSampleFrames <= 0))
+    {
+      StopStream();
+
+      if (mPendingStart)
+        Start(mPendingLevel, mPendingKey);
+    }
+  }
+
+  SampleStreamer& mStreamer;
+  std::array<const StreamedSample*, kNumKeys> mSamples;
+  std::array<int, kNumKeys> mRootKeys;
+  std::array<bool, kNumKeys> mIsLowKey {};
+  std::vector<float> mReadBuffers[kMaxChans];
+
+  const StreamedSample* mSample = nullptr;
+  int mStreamIdx = -1;
+  int mBlockSize = 1024;
+  double mSampleRate = 44100.;
+  double mRate = 1.;
+  double mFrac = 0.;
+  int mNBuffered = 0;
+  int mNSampleFrames = 0; // the frames in mReadBuffers that are from the sample rather than silence after its end
+  double mGain = 0.;
+  double mEnvelope = 0.;
+  double mReleaseTimeMs = 10.;
+  double mReleaseIncr = 0.;
+  bool mReleasing = false;
+  bool mPendingStart = false;
+  double mPendingLevel = 0.;
+  int mPendingKey = 0;
+};
+
+END_IPLUG_NAMESPACE
@@ -49,6 +49,8 @@ using namespace voiceControlNames;
 
 using VoiceInputs = ControlRamp::RampArray<kNumVoiceControlRamps>;
 
+class SynthVoiceBatchRenderer;
+
 #pragma mark - Voice class
 
 class SynthVoice
@@ -68,6 +70,13 @@ public:
   /** As with Trigger, called to do optional tasks when a voice is released. */
   virtual void Release() {};
 
+  /** Called when the VoiceAllocator stops a voice to lower polyphony, see VoiceAllocator::SetCPUBudget(). The voice should fade out quickly, e.g. with ADSREnvelope::Kill(false). The default releases the voice */
+  virtual void Kill() { Release(); }
+
+  /** Implement this to let the VoiceAllocator steal the least audible voices first, see VoiceAllocator::kStealModeQuietest
+   * @return The level of the voice, e.g. the last output of its amplitude envelope */
+  virtual double GetLevel() const { return 1.; }
+
   /** Process a block of audio data for the voice
    @param inputs Pointer to input channel arrays. Sometimes synthesisers have audio inputs. Alternatively you can pass in modulation from global LFOs etc here.
    @param outputs Pointer to output channel arrays. You should add to the existing data in these arrays (so that all the voices get summed)
@@ -101,6 +110,49 @@ public:
    */
   virtual void SetControl(int controlNumber, float value) {};
 
+  /** Implement this to render the voice in batches with other voices, see SynthVoiceBatchRenderer. Busy voices that return the same renderer are
+   * passed to it up to VoiceBatch::kMaxVoices at a time, and ProcessSamplesAccumulating() is not called for them
+   * @return The renderer, usually shared by all of a synth's voices, or nullptr to render the voice with ProcessSamplesAccumulating() */
+  virtual SynthVoiceBatchRenderer* GetBatchRenderer() { return nullptr; }
+
+  /** @param ctlIdx The control, e.g. kVoiceControlPitch
+   * @return The control's value for each frame being rendered, starting at index 0 for startIdx, or nullptr if the VoiceAllocator isn't rendering control ramp buffers,
+   * see VoiceAllocator::SetControlRampBuffers(). The buffer of a settled control is not written, see IsControlSettled() */
+  const float* GetControlRamp(int ctlIdx) const { return mControlRampsValid ? mControlRamps + ctlIdx * mControlRampStride : nullptr; }
+
+  /** @return \c true if the control is constant for the frames being rendered, so read GetControlValue() rather than its ramp */
+  bool IsControlSettled(int ctlIdx) const { return (mSettledControls >> ctlIdx) & 1; }
+
+  /** @return The value of the control at the end of the frames being rendered */
+  float GetControlValue(int ctlIdx) const { return static_cast<float>(mInputs[ctlIdx].endValue); }
+
+  /** @return The index of the voice in the VoiceAllocator, e.g. to find its state in a SynthVoiceBatchRenderer */
+  int GetVoiceNumber() const { return mVoiceNumber; }
+
+  /** Implement this to compute the work that the voices of a unison group share, e.g. envelopes and LFOs, see VoiceAllocator::SetUnison(). It is called once per block for the leader
+   * of each busy group, before any voice of the group is rendered, and the other voices of the group read the results from GetUnisonLeader(). A voice that is not in a unison group is
+   * the leader of a group of one, so voices that implement this can always compute their shared work here
+   * @param inputs The inputs passed to ProcessSamplesAccumulating()
+   * @param nInputs The number of inputs
+   * @param startIdx The start index of the block of samples to process
+   * @param nFrames The number of samples to process in this block */
+  virtual void ProcessShared(sample** inputs, int nInputs, int startIdx, int nFrames) {};
+
+  /** @return The voice that computes the shared work of this voice's unison group, which is this voice if it is the leader or isn't in a group */
+  SynthVoice* GetUnisonLeader() const { return mUnisonLeader; }
+
+  /** @return \c true if this voice computes its unison group's shared work */
+  bool IsUnisonLeader() const { return mUnisonLeader == this; }
+
+  /** @return The index of this voice in its unison group, 0 for the leader */
+  int GetUnisonIndex() const { return mUnisonIndex; }
+
+  /** @return The number of voices in this voice's unison group when it was triggered */
+  int GetUnisonSize() const { return mUnisonSize; }
+
+  /** @return The position of this voice in its unison group's spread, from -1 to 1, which the VoiceAllocator detunes it by and which can also be used for panning */
+  float GetUnisonPosition() const { return mUnisonPosition; }
+
 protected:
   VoiceInputs mInputs;
   int64_t mLastTriggeredTime{-1};
@@ -110,9 +162,87 @@ protected:
   uint8_t mKey{0};
   double mBasePitch{0.};
   double mGain{0.}; // used by voice allocator to hard-kill voices.
+  SynthVoice* mUnisonLeader{this};
+  uint8_t mUnisonIndex{0};
+  uint8_t mUnisonSize{1};
+  float mUnisonPosition{0.f};
+  float* mControlRamps{nullptr}; // kNumVoiceControlRamps buffers in the VoiceAllocator's control ramp buffer
+  int mControlRampStride{0};
+  uint32_t mSettledControls{0};
+  bool mControlRampsValid{false};
 
   friend class MidiSynth;
   friend class VoiceAllocator;
+  friend struct VoiceBatch;
+};
+
+/** A batch of voices for a SynthVoiceBatchRenderer, with the voices' control ramps laid out as structure of arrays so that the same control of every voice in the batch
+ * can be read with one SIMD load. Lanes from nVoices to kMaxVoices are unused and their ramps are 0 */
+struct VoiceBatch
+{
+  static constexpr int kMaxVoices = 8;
+
+  SynthVoice* voices[kMaxVoices] = {};
+  int nVoices = 0;
+  alignas(32) double startValue[kNumVoiceControlRamps][kMaxVoices] = {};
+  alignas(32) double endValue[kNumVoiceControlRamps][kMaxVoices] = {};
+  int transitionStart[kNumVoiceControlRamps][kMaxVoices] = {};
+  int transitionEnd[kNumVoiceControlRamps][kMaxVoices] = {};
+
+  /** Add a voice's ramps to the next lane, called by the VoiceAllocator */
+  void Add(SynthVoice* pVoice)
+  {
+    const int lane = nVoices++;
+    voices[lane] = pVoice;
+
+    for (auto c = 0; c < kNumVoiceControlRamps; c++)
+    {
+      const ControlRamp& ramp = pVoice->mInputs[c];
+      startValue[c][lane] = ramp.startValue;
+      endValue[c][lane] = ramp.endValue;
+      transitionStart[c][lane] = ramp.transitionStart;
+      transitionEnd[c][lane] = ramp.transitionEnd;
+    }
+  }
+
+  /** Write the per-sample values of one control for every lane, interleaved so that buffer[s * kMaxVoices + lane] is the value of the lane's voice at frame s,
+   * the same values ControlRamp::Write() gives for each voice
+   * @param ctlIdx The control, e.g. kVoiceControlPitch
+   * @param buffer At least nFrames * kMaxVoices values
+   * @param nFrames The number of frames */
+  void WriteRamps(int ctlIdx, float* buffer, int nFrames) const
+  {
+    for (auto v = 0; v < kMaxVoices; v++)
+    {
+      const float start = static_cast<float>(startValue[ctlIdx][v]);
+      const int transStart = transitionStart[ctlIdx][v];
+      const int transEnd = transitionEnd[ctlIdx][v];
+      const float dv = transEnd > transStart ? static_cast<float>((endValue[ctlIdx][v] - startValue[ctlIdx][v]) / (transEnd - transStart)) : 0.f;
+      float val = start;
+
+      for (auto s = 0; s < nFrames; s++)
+      {
+        if (s >= transStart && s < transEnd)
+          val += dv;
+
+        buffer[s * kMaxVoices + v] = val;
+      }
+    }
+  }
+};
+
+/** Renders several voices with one call, e.g. a simple subtractive voice whose oscillators and filters are run for kMaxVoices voices at a time with the
+ * voices in the inner loop, so that they vectorize across voices. The renderer usually keeps its voices' state as arrays indexed by SynthVoice::GetVoiceNumber(), gathers the batch's
+ * lanes into local arrays at the start of the call and scatters them back at the end. Busy voices whose SynthVoice::GetBatchRenderer() returns the renderer are passed to it in batches
+ * by the VoiceAllocator, which also sorts them so that batches are the same from one block to the next while the same voices are busy */
+class SynthVoiceBatchRenderer
+{
+public:
+  virtual ~SynthVoiceBatchRenderer() {}
+
+  /** Render a batch of voices, accumulating into the outputs, see SynthVoice::ProcessSamplesAccumulating() for the other arguments
+   * @param batch The voices and their control ramps */
+  virtual void ProcessBatchAccumulating(const VoiceBatch& batch, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) = 0;
 };
 
 END_IPLUG_NAMESPACE
@@ -9,8 +9,11 @@
  */
 
 #include "VoiceAllocator.h"
+#include "IPlugSIMD.h"
 
 #include <algorithm>
+#include <chrono>
+#include <limits>
 #include <numeric>
 #include <iostream>
 
@@ -28,8 +31,8 @@ VoiceAllocator::VoiceAllocator()
   // setup default key->pitch fn
   mKeyToPitchFn = [](int k){return (k - 69.f)/12.f;};
 
-  mSustainedNotes.reserve(128);
-  mHeldKeys.reserve(128);
+  mFirstVoiceForKey.fill(-1);
+  mFirstVoiceForChannel.fill(-1);
 }
 
 VoiceAllocator::~VoiceAllocator()
@@ -38,8 +41,8 @@ VoiceAllocator::~VoiceAllocator()
 
 void VoiceAllocator::Clear()
 {
-  mHeldKeys.clear();
-  mSustainedNotes.clear();
+  mHeldKeys.Clear();
+  mSustainedNotes.Clear();
   HardKillAllVoices();
 }
 
@@ -56,8 +59,21 @@ void VoiceAllocator::AddVoice(SynthVoice* pVoice, uint8_t zone)
   if(mVoicePtrs.size() + 1 < UCHAR_MAX)
   {
     mVoicePtrs.push_back(pVoice);
+    mBusyVoices.resize(mVoicePtrs.size());
+    mRenderJobs.resize(mVoicePtrs.size());
+    mNextVoiceForKey.push_back(-1);
+    mPrevVoiceForKey.push_back(-1);
+    mNextVoiceForChannel.push_back(-1);
+    mPrevVoiceForChannel.push_back(-1);
+    mVoiceKilled.push_back(0);
+    mVoiceNotePitch.push_back(0.f);
+    pVoice->mVoiceNumber = static_cast<uint8_t>(mVoicePtrs.size() - 1);
     ClearVoiceInputs(pVoice);
-    pVoice->mKey = -1;
+    pVoice->mKey = -1; // not in any key's list yet
+    const int channel = pVoice->mChannel;
+    pVoice->mChannel = kAllChannels; // not in any channel's list yet
+    SetVoiceChannel(pVoice->mVoiceNumber, channel);
+    AssignControlRampBuffers();
     pVoice->mZone = zone;
 
     // make a glides structures for the control ramps of the new voice
@@ -69,133 +85,228 @@ void VoiceAllocator::AddVoice(SynthVoice* pVoice, uint8_t zone)
   }
 }
 
-VoiceAllocator::VoiceBitsArray VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
+VoiceAllocator::VoiceList VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
 {
-  const int n = static_cast<int>(mVoicePtrs.size());
-  VoiceBitsArray v;
+  VoiceList voices;
 
-  // set all bits to true
-  for(int i=0; i<n; ++i)
-  {
-    v[i] = true;
-  }
+  auto matches = [&](int i) {
+    const SynthVoice* pVoice = mVoicePtrs[i];
 
-  // for each criterion present in address, clear any voice bits not matching
+    if(addr.mZone != kAllZones && pVoice->mZone != addr.mZone) return false;
 
-  // zone
-  if(addr.mZone != kAllZones)
-  {
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = v[i] & (mVoicePtrs[i]->mZone == addr.mZone);
-    }
-  }
+    // setting the flag kVoicesAll returns all voices matching the zone of the address.
+    if(addr.mFlags & kVoicesAll) return true;
 
-  // setting the flag kVoicesAll returns all voices matching the zone of the address.
-  if(addr.mFlags & kVoicesAll) return v;
+    if(addr.mChannel != kAllChannels && pVoice->mChannel != addr.mChannel) return false;
+    if(addr.mKey != kAllKeys && pVoice->mKey != addr.mKey) return false;
+    if((addr.mFlags & kVoicesBusy) && !pVoice->GetBusy()) return false;
+    return true;
+  };
 
-  // channel
-  if(addr.mChannel != kAllChannels)
+  if(addr.mKey < KeyList::kNumKeys && !(addr.mFlags & kVoicesAll))
   {
-    for(int i=0; i<n; ++i)
+    // only the voices playing the key can match
+    for(int i = mFirstVoiceForKey[addr.mKey]; i >= 0; i = mNextVoiceForKey[i])
     {
-      v[i] = v[i] & (mVoicePtrs[i]->mChannel == addr.mChannel);
+      if(matches(i))
+        voices.Add(i);
     }
-  }
 
-  // Key
-  if(addr.mKey != kAllKeys)
+    // keep the voices in index order, as when all voices are searched
+    std::sort(voices.mVoices.begin(), voices.mVoices.begin() + voices.mSize);
+  }
+  else if(addr.mChannel < kNumChannels && !(addr.mFlags & kVoicesAll))
   {
-    for(int i=0; i<n; ++i)
+    // only the voices on the channel can match, e.g. for MPE per-note expression
+    for(int i = mFirstVoiceForChannel[addr.mChannel]; i >= 0; i = mNextVoiceForChannel[i])
     {
-      v[i] = v[i] & (mVoicePtrs[i]->mKey == addr.mKey);
+      if(matches(i))
+        voices.Add(i);
     }
-  }
 
-  // busy flag
-  if(addr.mFlags & kVoicesBusy)
+    std::sort(voices.mVoices.begin(), voices.mVoices.begin() + voices.mSize);
+  }
+  else
   {
-    for(int i=0; i<n; ++i)
+    for(int i = 0; i < static_cast<int>(mVoicePtrs.size()); ++i)
     {
-      v[i] = v[i] & mVoicePtrs[i]->GetBusy();
+      if(matches(i))
+        voices.Add(i);
     }
   }
 
   // most recent
-  if(addr.mFlags & kVoicesMostRecent)
+  if((addr.mFlags & kVoicesMostRecent) && !(addr.mFlags & kVoicesAll))
   {
     int64_t maxT = -1;
     int maxIdx = -1;
-    for(int i=0; i<n; ++i)
+
+    for(auto i : voices)
     {
-      if(v[i])
+      int64_t vt = mVoicePtrs[i]->mLastTriggeredTime;
+      if(vt > maxT)
       {
-        int64_t vt = mVoicePtrs[i]->mLastTriggeredTime;
-        if(vt > maxT)
-        {
-          maxT = vt;
-          maxIdx = i;
-        }
+        maxT = vt;
+        maxIdx = i;
       }
     }
 
-    // set all bits to false
-    //v.reset();
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = 0;
-    }
+    voices.mSize = 0;
 
     if(maxIdx >= 0)
     {
-      v[maxIdx] = true;
+      voices.Add(maxIdx);
     }
   }
-  return v;
+  return voices;
 }
 
-void VoiceAllocator::SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples)
+void VoiceAllocator::SetVoiceKey(int voiceIdx, int key)
 {
-  // send control change to all matched voices through glide generators
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  SynthVoice* pVoice = mVoicePtrs[voiceIdx];
+  const int prevKey = pVoice->mKey;
+
+  if(prevKey < KeyList::kNumKeys)
+  {
+    const int prev = mPrevVoiceForKey[voiceIdx];
+    const int next = mNextVoiceForKey[voiceIdx];
+
+    if(prev >= 0)
+      mNextVoiceForKey[prev] = next;
+    else
+      mFirstVoiceForKey[prevKey] = next;
+
+    if(next >= 0)
+      mPrevVoiceForKey[next] = prev;
+  }
+
+  pVoice->mKey = static_cast<uint8_t>(key);
+
+  if(key >= 0 && key < KeyList::kNumKeys)
   {
-    if(v[i])
+    const int first = mFirstVoiceForKey[key];
+    mPrevVoiceForKey[voiceIdx] = -1;
+    mNextVoiceForKey[voiceIdx] = first;
+
+    if(first >= 0)
+      mPrevVoiceForKey[first] = voiceIdx;
+
+    mFirstVoiceForKey[key] = voiceIdx;
+  }
+}
+
+void VoiceAllocator::SetVoiceChannel(int voiceIdx, int channel)
+{
+  SynthVoice* pVoice = mVoicePtrs[voiceIdx];
+  const int prevChannel = pVoice->mChannel;
+
+  if(prevChannel == channel)
+    return;
+
+  if(prevChannel < kNumChannels)
+  {
+    const int prev = mPrevVoiceForChannel[voiceIdx];
+    const int next = mNextVoiceForChannel[voiceIdx];
+
+    if(prev >= 0)
+      mNextVoiceForChannel[prev] = next;
+    else
+      mFirstVoiceForChannel[prevChannel] = next;
+
+    if(next >= 0)
+      mPrevVoiceForChannel[next] = prev;
+  }
+
+  pVoice->mChannel = static_cast<uint8_t>(channel);
+
+  if(channel >= 0 && channel < kNumChannels)
+  {
+    const int first = mFirstVoiceForChannel[channel];
+    mPrevVoiceForChannel[voiceIdx] = -1;
+    mNextVoiceForChannel[voiceIdx] = first;
+
+    if(first >= 0)
+      mPrevVoiceForChannel[first] = voiceIdx;
+
+    mFirstVoiceForChannel[channel] = voiceIdx;
+  }
+}
+
+void VoiceAllocator::CoalesceEvents()
+{
+  // the index in mEvents of the last event of each expression action to each channel since the last other event, the last slot is for kAllChannels
+  constexpr int kNumExpressionActions = kTimbreAction - kPitchBendAction + 1;
+  std::array<std::array<int16_t, kNumChannels + 1>, kNumExpressionActions> lastEvent;
+  for(auto& channels : lastEvent)
+    channels.fill(-1);
+
+  mNEvents = 0;
+
+  while(mInputQueue.ElementsAvailable() && mNEvents < kInputQueueSize)
+  {
+    VoiceInputEvent& event = mEvents[mNEvents];
+    mInputQueue.Pop(event);
+
+    const VoiceAddress& addr = event.mAddress;
+
+    if(event.mAction >= kPitchBendAction && event.mAction <= kTimbreAction && (addr.mChannel < kNumChannels || addr.mChannel == kAllChannels))
     {
-      mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
+      int16_t& last = lastEvent[event.mAction - kPitchBendAction][std::min<int>(addr.mChannel, kNumChannels)];
+
+      // controls are only updated once per block, so an earlier value to the same voices is never heard
+      if(last >= 0)
+      {
+        const VoiceAddress& lastAddr = mEvents[last].mAddress;
+        if(lastAddr.mZone == addr.mZone && lastAddr.mChannel == addr.mChannel && lastAddr.mKey == addr.mKey && lastAddr.mFlags == addr.mFlags)
+          mEvents[last].mAction = kNullAction;
+      }
+
+      last = mNEvents;
     }
+    else if(event.mAction != kNullAction)
+    {
+      // other events can change which voices an address matches
+      for(auto& channels : lastEvent)
+        channels.fill(-1);
+    }
+
+    mNEvents++;
+  }
+}
+
+void VoiceAllocator::SendControlToVoiceInputs(const VoiceList& voices, int ctlIdx, float val, int glideSamples)
+{
+  // send control change to all matched voices through glide generators
+  for(auto i : voices)
+  {
+    mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
   }
 }
 
-void VoiceAllocator::SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val)
+void VoiceAllocator::SendControlToVoicesDirect(const VoiceList& voices, int ctlIdx, float val)
 {
   // send generic control change directly to voice
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(auto i : voices)
   {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetControl(ctlIdx, val);
-    }
+    mVoicePtrs[i]->SetControl(ctlIdx, val);
   }
 }
 
-void VoiceAllocator::SendProgramChangeToVoices(VoiceBitsArray v, int pgm)
+void VoiceAllocator::SendProgramChangeToVoices(const VoiceList& voices, int pgm)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(auto i : voices)
   {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetProgramNumber(pgm);
-    }
+    mVoicePtrs[i]->SetProgramNumber(pgm);
   }
 }
 
 void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
 {
-  while(mInputQueue.ElementsAvailable())
+  CoalesceEvents();
+
+  for(int e = 0; e < mNEvents; e++)
   {
-    VoiceInputEvent event;
-    mInputQueue.Pop(event);
-    VoiceAllocator::VoiceBitsArray voices = VoicesMatchingAddress(event.mAddress);
+    const VoiceInputEvent& event = mEvents[e];
 
     switch(event.mAction)
     {
@@ -218,17 +329,17 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
       }
       case kPitchBendAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
         break;
       }
       case kPressureAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlPressure, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPressure, event.mValue, mControlGlideSamples);
         break;
       }
       case kTimbreAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlTimbre, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlTimbre, event.mValue, mControlGlideSamples);
         break;
       }
       case kSustainAction:
@@ -237,20 +348,17 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
         if (!mSustainPedalDown) // sustain pedal released
         {
           // if notes are sustaining, check that they're not still held and if not then stop voice
-          if (!mSustainedNotes.empty())
+          for (int key = mSustainedNotes.Front(); key >= 0;)
           {
-            for (auto susNotesItr = mSustainedNotes.begin(); susNotesItr != mSustainedNotes.end();)
+            const int nextKey = mSustainedNotes.Next(key);
+
+            if (!mHeldKeys.Contains(key))
             {
-              uint8_t key = *susNotesItr;
-              bool held = std::find(mHeldKeys.begin(), mHeldKeys.end(), key) != mHeldKeys.end();
-              if (!held)
-              {
-                StopVoices(VoicesMatchingAddress({event.mAddress.mZone, kAllChannels, key, 0}), event.mSampleOffset);
-                susNotesItr = mSustainedNotes.erase(susNotesItr);
-              }
-              else
-                susNotesItr++;
+              StopVoices(VoicesMatchingAddress({event.mAddress.mZone, kAllChannels, static_cast<uint8_t>(key), 0}), event.mSampleOffset);
+              mSustainedNotes.Remove(key);
             }
+
+            key = nextKey;
           }
         }
         break;
@@ -258,12 +366,20 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
       case kControllerAction:
       {
         // called for any continuous controller other than the special #74 specified in MPE
-        SendControlToVoicesDirect(voices, event.mControllerNumber, event.mValue);
+        SendControlToVoicesDirect(VoicesMatchingAddress(event.mAddress), event.mControllerNumber, event.mValue);
         break;
       }
       case kProgramChangeAction:
       {
-        SendProgramChangeToVoices(voices, event.mControllerNumber);
+        SendProgramChangeToVoices(VoicesMatchingAddress(event.mAddress), event.mControllerNumber);
+        break;
+      }
+      case kNotePitchBendAction:
+      {
+        for(auto i : VoicesMatchingAddress(event.mAddress))
+        {
+          mVoiceGlides[i]->at(kVoiceControlPitch).SetTarget(mVoiceNotePitch[i] + event.mValue, 0, mControlGlideSamples, mBlockSize);
+        }
         break;
       }
       case kNullAction:
@@ -284,20 +400,62 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
   }
 }
 
+void VoiceAllocator::SetControlRampBuffers(int maxBlockSize)
+{
+  mMaxControlRampFrames = std::max(maxBlockSize, 0);
+  AssignControlRampBuffers();
+}
+
+void VoiceAllocator::AssignControlRampBuffers()
+{
+  // each buffer starts on a 32 byte boundary relative to the first
+  const int stride = (mMaxControlRampFrames + 7) & ~7;
+  mControlRampBuffer.assign(mMaxControlRampFrames ? mVoicePtrs.size() * kNumVoiceControlRamps * stride : 0, 0.f);
+
+  for(int v = 0; v < mVoicePtrs.size(); v++)
+  {
+    SynthVoice* pVoice = mVoicePtrs[v];
+    pVoice->mControlRamps = mMaxControlRampFrames ? mControlRampBuffer.data() + v * kNumVoiceControlRamps * stride : nullptr;
+    pVoice->mControlRampStride = stride;
+    pVoice->mControlRampsValid = false;
+  }
+}
+
+void VoiceAllocator::WriteControlRamps(SynthVoice* pVoice, int blockSize)
+{
+  uint32_t settled = 0;
+
+  for(int c = 0; c < kNumVoiceControlRamps; c++)
+  {
+    const ControlRamp& ramp = pVoice->mInputs[c];
+
+    if(ramp.IsSettled())
+    {
+      settled |= 1u << c;
+      continue;
+    }
+
+    ramp.Write(pVoice->mControlRamps + c * pVoice->mControlRampStride, 0, blockSize);
+  }
+
+  pVoice->mSettledControls = settled;
+  pVoice->mControlRampsValid = true;
+}
+
 void VoiceAllocator::CalcGlideTimesInSamples()
 {
   mNoteGlideSamples = static_cast<int>(mNoteGlideTime * mSampleRate);
   mControlGlideSamples = static_cast<int>(mControlGlideTime * mSampleRate);
 }
 
-int VoiceAllocator::FindFreeVoiceIndex(int startIndex) const
+int VoiceAllocator::FindFreeVoiceIndex(int startIndex, const std::bitset<UCHAR_MAX>* pTaken) const
 {
-  size_t voices = mVoicePtrs.size();
+  int voices = GetPolyphony();
   for(int i=0; i<voices; ++i)
   {
     int j = (startIndex + i)%voices;
     SynthVoice* pv = mVoicePtrs[j];
-    if(!pv->GetBusy())
+    if(!pv->GetBusy() && !(pTaken && (*pTaken)[j]))
     {
       return j;
     }
@@ -305,16 +463,22 @@ int VoiceAllocator::FindFreeVoiceIndex(int startIndex) const
   return -1;
 }
 
-int VoiceAllocator::FindVoiceIndexToSteal(int64_t sampleTime) const
+int VoiceAllocator::FindVoiceIndexToSteal(int64_t sampleTime, const std::bitset<UCHAR_MAX>* pTaken) const
 {
-  size_t voices = mVoicePtrs.size();
+  int voices = GetPolyphony();
   int64_t earliestTime = sampleTime;
-  int longestPlayingVoiceIdx = 0;
+  double lowestLevel = std::numeric_limits<double>::max();
+  int longestPlayingVoiceIdx = -1;
   for(int i=0; i<voices; ++i)
   {
+    if(pTaken && (*pTaken)[i])
+      continue;
+
     SynthVoice* pv = mVoicePtrs[i];
-    if(pv->mLastTriggeredTime < earliestTime)
+    const double level = mStealMode == kStealModeQuietest ? pv->GetLevel() : 0.;
+    if(level < lowestLevel || (level == lowestLevel && pv->mLastTriggeredTime < earliestTime))
     {
+      lowestLevel = level;
       earliestTime = pv->mLastTriggeredTime;
       longestPlayingVoiceIdx = i;
     }
@@ -322,8 +486,87 @@ int VoiceAllocator::FindVoiceIndexToSteal(int64_t sampleTime) const
   return longestPlayingVoiceIdx;
 }
 
+int VoiceAllocator::CountActiveVoices() const
+{
+  int nActive = 0;
+  for(int i=0; i<mVoicePtrs.size(); ++i)
+  {
+    if(mVoicePtrs[i]->GetBusy() && !mVoiceKilled[i])
+      nActive++;
+  }
+  return nActive;
+}
+
+void VoiceAllocator::SetCPUBudget(double budget)
+{
+  mCPUBudget = std::max(budget, 0.);
+  mVoiceCost = 0.;
+  mGovernedPolyphony = 0;
+}
+
+void VoiceAllocator::UpdateCPUGovernor(int nBusyVoices, int nFrames, double seconds)
+{
+  if(nBusyVoices > 0 && nFrames > 0)
+  {
+    const double cost = seconds / (nBusyVoices * nFrames);
+    mVoiceCost = mVoiceCost > 0. ? mVoiceCost + kVoiceCostSmoothing * (cost - mVoiceCost) : cost;
+  }
+
+  if(mVoiceCost <= 0.)
+    return;
+
+  // the fraction of real time that n voices take
+  auto load = [this](int n) { return n * mVoiceCost * mSampleRate; };
+
+  const int nActive = CountActiveVoices();
+  const int current = GetGovernedPolyphony();
+
+  // lower the limit at once when the voices playing are over budget, raise it by one voice at a time when there is room to spare, so that it doesn't oscillate
+  if(load(nActive) > mCPUBudget)
+  {
+    mGovernedPolyphony = std::max(1, std::min(static_cast<int>(mCPUBudget / load(1)), current));
+  }
+  else if(current < GetPolyphony() && load(current + 1) < kCPUBudgetHeadroom * mCPUBudget)
+  {
+    mGovernedPolyphony = current + 1;
+  }
+  else
+  {
+    mGovernedPolyphony = current;
+  }
+
+  // stop the least audible voices over the limit
+  for(int nExcess = nActive - mGovernedPolyphony; nExcess > 0; nExcess--)
+  {
+    int quietestIdx = -1;
+    double lowestLevel = std::numeric_limits<double>::max();
+
+    for(int i=0; i<mVoicePtrs.size(); ++i)
+    {
+      SynthVoice* pv = mVoicePtrs[i];
+      if(!pv->GetBusy() || mVoiceKilled[i])
+        continue;
+
+      const double level = pv->GetLevel();
+      if(quietestIdx < 0 || level < lowestLevel || (level == lowestLevel && pv->mLastTriggeredTime < mVoicePtrs[quietestIdx]->mLastTriggeredTime))
+      {
+        lowestLevel = level;
+        quietestIdx = i;
+      }
+    }
+
+    if(quietestIdx < 0)
+      break;
+
+    mVoiceGlides[quietestIdx]->at(kVoiceControlGate).SetTarget(0.0, 0, 1, mBlockSize);
+    SetVoiceKey(quietestIdx, -1);
+    mVoiceKilled[quietestIdx] = 1;
+    mVoicePtrs[quietestIdx]->Kill();
+  }
+}
+
 // start a single voice and set its current channel and key.
-void VoiceAllocator::StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
+void VoiceAllocator::StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig, bool steal)
 {
   if(!retrig)
   {
@@ -333,53 +576,104 @@ void VoiceAllocator::StartVoice(int voiceIdx, int channel, int key, float pitch,
 
   // add glide for pitch
   mVoiceGlides[voiceIdx]->at(kVoiceControlPitch).SetTarget(pitch, sampleOffset, mNoteGlideSamples, mBlockSize);
+  mVoiceNotePitch[voiceIdx] = pitch;
 
   // set things directly in voice
   SynthVoice* pVoice = mVoicePtrs[voiceIdx];
   pVoice->mLastTriggeredTime = sampleTime;
-  pVoice->mChannel = channel;
-  pVoice->mKey = key;
+  SetVoiceChannel(voiceIdx, channel);
+  SetVoiceKey(voiceIdx, key);
   pVoice->mGain = 1.;
+  mVoiceKilled[voiceIdx] = 0;
+  mStealCount += steal;
 
   // call voice's Trigger method
-  pVoice->Trigger(velocity, retrig);
+  pVoice->Trigger(velocity, retrig || steal);
 }
 
-// start all of the voice indexes marked in the VoieBitsArray and set the current channel and key of each.
-void VoiceAllocator::StartVoices(VoiceBitsArray vbits, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
+// start all of the voices in the list and set the current channel and key of each, detuned by their unison position.
+void VoiceAllocator::StartVoices(const VoiceList& voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(auto i : voices)
   {
-    if(vbits[i])
+    const float detune = mVoicePtrs[i]->mUnisonPosition * 0.5f * mUnisonDetune / 12.f;
+    StartVoice(i, channel, key, pitch + detune, velocity, sampleOffset, sampleTime, retrig);
+  }
+}
+
+void VoiceAllocator::SetUnisonGroup(const VoiceList& voices, bool grouped, int sampleOffset)
+{
+  std::bitset<UCHAR_MAX> inList;
+  for(auto i : voices)
+  {
+    inList[i] = true;
+  }
+
+  for(auto i : voices)
+  {
+    SynthVoice* pVoice = mVoicePtrs[i];
+    if(pVoice->mUnisonSize < 2 || !pVoice->IsUnisonLeader())
+      continue;
+
+    for(int j=0; j<mVoicePtrs.size(); ++j)
     {
-      StartVoice(i, channel, key, pitch, velocity, sampleOffset, sampleTime, retrig);
+      SynthVoice* pOther = mVoicePtrs[j];
+      if(!inList[j] && pOther != pVoice && pOther->mUnisonLeader == pVoice)
+      {
+        StopVoice(j, sampleOffset);
+        pOther->mUnisonLeader = pOther;
+        pOther->mUnisonIndex = 0;
+        pOther->mUnisonSize = 1;
+        pOther->mUnisonPosition = 0.f;
+      }
     }
   }
+
+  const int n = grouped ? voices.mSize : 1;
+  int k = 0;
+  for(auto i : voices)
+  {
+    SynthVoice* pVoice = mVoicePtrs[i];
+    const int index = grouped ? k++ : 0;
+    pVoice->mUnisonLeader = grouped ? mVoicePtrs[voices.mVoices[0]] : pVoice;
+    pVoice->mUnisonIndex = static_cast<uint8_t>(index);
+    pVoice->mUnisonSize = static_cast<uint8_t>(n);
+    pVoice->mUnisonPosition = n > 1 ? 2.f * index / (n - 1) - 1.f : 0.f;
+  }
+}
+
+VoiceAllocator::VoiceList VoiceAllocator::MonoVoices(uint8_t zone)
+{
+  VoiceList voices = VoicesMatchingAddress({zone, kAllChannels, kAllKeys, 0});
+
+  if(mUnisonVoices > 1)
+  {
+    voices.mSize = std::min(voices.mSize, mUnisonVoices);
+  }
+
+  return voices;
 }
 
 void VoiceAllocator::StopVoice(int voiceIdx, int sampleOffset)
 {
   mVoiceGlides[voiceIdx]->at(kVoiceControlGate).SetTarget(0.0, sampleOffset, 1, mBlockSize);
-  mVoicePtrs[voiceIdx]->mKey = -1;
+  SetVoiceKey(voiceIdx, -1);
   mVoicePtrs[voiceIdx]->Release();
 }
 
-// stop all voices marked in the VoiceBitsArray.
-void VoiceAllocator::StopVoices(VoiceBitsArray vbits, int sampleOffset)
+// stop all voices in the list.
+void VoiceAllocator::StopVoices(const VoiceList& voices, int sampleOffset)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
+  for(auto i : voices)
   {
-    if(vbits[i])
-    {
-      StopVoice(i, sampleOffset);
-    }
+    StopVoice(i, sampleOffset);
   }
 }
 
 void VoiceAllocator::SoftKillAllVoices()
 {
-  mHeldKeys.clear();
-  mSustainedNotes.clear();
+  mHeldKeys.Clear();
+  mSustainedNotes.Clear();
   mSustainPedalDown = false;
 
   size_t voices = mVoicePtrs.size();
@@ -413,28 +707,66 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
       // TODO retrig / legato
       bool retrig = false;
 
-      // trigger all voices in zone
-      StartVoices(VoicesMatchingAddress({e.mAddress.mZone, kAllChannels, kAllKeys, 0}), channel, key, pitch, velocity, offset, sampleTime, retrig);
+      // trigger all voices in zone, or the unison group
+      VoiceList voices = MonoVoices(e.mAddress.mZone);
+      SetUnisonGroup(voices, mUnisonVoices > 1, offset);
+      StartVoices(voices, channel, key, pitch, velocity, offset, sampleTime, retrig);
 
       // in mono modes only ever 1 sustained note
-      mSustainedNotes.clear();
+      mSustainedNotes.Clear();
       break;
     }
     case kPolyModePoly:
     {
-      int i = FindFreeVoiceIndex(mVoiceRotateIndex);
-      if(i < 0)
-      {
-        i = FindVoiceIndexToSteal(sampleTime);
-      }
-      if(mRotateVoices)
+      // take a voice for each unison voice, stealing whole groups when none are free
+      const int nUnison = std::min(mUnisonVoices, GetGovernedPolyphony());
+      VoiceList voices;
+      std::bitset<UCHAR_MAX> taken;
+
+      while(voices.mSize < nUnison)
       {
-        mVoiceRotateIndex = i + 1;
+        int i = -1;
+        // with the CPU governor on, new notes steal voices once the governed number are playing
+        if(mGovernedPolyphony <= 0 || CountActiveVoices() + voices.mSize < GetGovernedPolyphony())
+        {
+          i = FindFreeVoiceIndex(mVoiceRotateIndex, &taken);
+        }
+        if(i < 0)
+        {
+          i = FindVoiceIndexToSteal(sampleTime, &taken);
+        }
+        if(i < 0)
+        {
+          break;
+        }
+        if(mRotateVoices)
+        {
+          mVoiceRotateIndex = i + 1;
+        }
+
+        taken[i] = true;
+        voices.Add(i);
+
+        // the rest of a stolen group go with it
+        SynthVoice* pLeader = mVoicePtrs[i]->mUnisonLeader;
+        for(int j=0; j<GetPolyphony() && voices.mSize < nUnison && mVoicePtrs[i]->GetBusy(); ++j)
+        {
+          if(!taken[j] && mVoicePtrs[j]->mUnisonLeader == pLeader && mVoicePtrs[j]->GetBusy())
+          {
+            taken[j] = true;
+            voices.Add(j);
+          }
+        }
       }
-      if(i >= 0)
+
+      SetUnisonGroup(voices, true, offset);
+
+      for(auto i : voices)
       {
         bool retrig = false;
-        StartVoice(i, channel, key, pitch, velocity, offset, sampleTime, retrig);
+        bool steal = mVoicePtrs[i]->GetBusy();
+        const float detune = mVoicePtrs[i]->mUnisonPosition * 0.5f * mUnisonDetune / 12.f;
+        StartVoice(i, channel, key, pitch + detune, velocity, offset, sampleTime, retrig, steal);
       }
       break;
     }
@@ -444,17 +776,14 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
   }
 
   // add to held keys
-  if(std::find(mHeldKeys.begin(), mHeldKeys.end(), key) == mHeldKeys.end())
+  if(!mHeldKeys.Contains(key))
   {
-    mHeldKeys.push_back(key);
+    mHeldKeys.PushBack(key);
     mMinHeldVelocity = std::min(velocity, mMinHeldVelocity);
   }
 
   // add to sustained notes
-  if(std::find(mSustainedNotes.begin(), mSustainedNotes.end(), key) == mSustainedNotes.end())
-  {
-    mSustainedNotes.push_back(key);
-  }
+  mSustainedNotes.PushBack(key);
 }
 
 void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
@@ -464,8 +793,8 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
   int offset = e.mSampleOffset;
 
   // remove from held keys
-  mHeldKeys.erase(std::remove(mHeldKeys.begin(), mHeldKeys.end(), key), mHeldKeys.end());
-  if(mHeldKeys.empty())
+  mHeldKeys.Remove(key);
+  if(mHeldKeys.Empty())
   {
     mMinHeldVelocity = 1.0f;
   }
@@ -476,25 +805,25 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
     int queuedKey = 0;
 
     // if there are still held keys...
-    if(!mHeldKeys.empty())
+    if(!mHeldKeys.Empty())
     {
-      queuedKey = mHeldKeys.back();
+      queuedKey = mHeldKeys.Back();
       if (queuedKey != mVoicePtrs[0]->mKey)
       {
         doPlayQueuedKey = true;
         if(mSustainPedalDown)
         {
           // in mono modes only ever 1 sustained note
-          mSustainedNotes.clear();
-          mSustainedNotes.push_back(queuedKey);
+          mSustainedNotes.Clear();
+          mSustainedNotes.PushBack(queuedKey);
         }
       }
     }
     else if(mSustainPedalDown)
     {
-      if(!mSustainedNotes.empty())
+      if(!mSustainedNotes.Empty())
       {
-        queuedKey = mSustainedNotes.back();
+        queuedKey = mSustainedNotes.Back();
         if (queuedKey != mVoicePtrs[0]->mKey)
         {
           doPlayQueuedKey = true;
@@ -514,7 +843,9 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
       float pitch = mKeyToPitchFn(queuedKey + static_cast<int>(mPitchOffset));
       bool retrig = false;
 
-      StartVoices(VoicesMatchingAddress({e.mAddress.mZone, kAllChannels, kAllKeys, 0}), channel, queuedKey, pitch, mMinHeldVelocity, offset, sampleTime, retrig);
+      VoiceList voices = MonoVoices(e.mAddress.mZone);
+      SetUnisonGroup(voices, mUnisonVoices > 1, offset);
+      StartVoices(voices, channel, queuedKey, pitch, mMinHeldVelocity, offset, sampleTime, retrig);
     }
   }
   else // poly
@@ -522,19 +853,194 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
     if (!mSustainPedalDown)
     {
       StopVoices(VoicesMatchingAddress(e.mAddress), e.mSampleOffset);
-      mSustainedNotes.erase(std::remove(mSustainedNotes.begin(), mSustainedNotes.end(), key), mSustainedNotes.end());
+      mSustainedNotes.Remove(key);
     }
   }
 }
 
 void VoiceAllocator::ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
 {
+  if(mCPUBudget <= 0.)
+  {
+    RenderBusyVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+    return;
+  }
+
+  using clock = std::chrono::steady_clock;
+  const clock::time_point start = clock::now();
+  RenderBusyVoices(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+  UpdateCPUGovernor(mNBusyVoices, blockSize, std::chrono::duration<double>(clock::now() - start).count());
+}
+
+void VoiceAllocator::RenderBusyVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
+{
+  mNBusyVoices = 0;
+  bool anyBatched = false;
+
   for(auto pVoice : mVoicePtrs)
   {
-    // TODO distribute voices across cores
     if(pVoice->GetBusy())
     {
-      pVoice->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+      pVoice->mControlRampsValid = false;
+      if(blockSize <= mMaxControlRampFrames)
+      {
+        WriteControlRamps(pVoice, blockSize);
+      }
+
+      // the shared work of each unison group is done before any of its voices render, serially, so that it is ready for the render jobs
+      if(pVoice->IsUnisonLeader())
+      {
+        pVoice->ProcessShared(inputs, nInputs, startIndex, blockSize);
+      }
+
+      SynthVoiceBatchRenderer* pRenderer = pVoice->GetBatchRenderer();
+      anyBatched |= pRenderer != nullptr;
+      mBusyVoices[mNBusyVoices++] = {pRenderer, pVoice};
+    }
+  }
+
+  // group the voices by renderer, in voice order so that the batches stay the same while the same voices are busy
+  if(anyBatched)
+  {
+    std::sort(mBusyVoices.begin(), mBusyVoices.begin() + mNBusyVoices, [](const BusyVoice& a, const BusyVoice& b) {
+      if(a.pRenderer != b.pRenderer)
+        return std::less<SynthVoiceBatchRenderer*>()(a.pRenderer, b.pRenderer);
+
+      return a.pVoice->mVoiceNumber < b.pVoice->mVoiceNumber;
+    });
+  }
+
+  mNRenderJobs = 0;
+
+  for(int v = 0; v < mNBusyVoices;)
+  {
+    SynthVoiceBatchRenderer* pRenderer = mBusyVoices[v].pRenderer;
+    int n = 1;
+
+    if(pRenderer)
+    {
+      while(n < VoiceBatch::kMaxVoices && v + n < mNBusyVoices && mBusyVoices[v + n].pRenderer == pRenderer)
+        n++;
+    }
+
+    mRenderJobs[mNRenderJobs++] = {pRenderer, v, n};
+    v += n;
+  }
+
+  int nThreads = 1;
+
+  if(mWorkerPool && blockSize <= mMaxRenderFrames && nInputs <= mMaxRenderInputs && nOutputs <= mMaxRenderOutputs)
+  {
+    nThreads = std::min({mMaxThreads, mWorkerPool->NThreads() + 1, mNBusyVoices / kMinVoicesPerThread, mNRenderJobs});
+  }
+
+  mRenderNInputs = nInputs;
+  mRenderNOutputs = nOutputs;
+  mRenderFrames = blockSize;
+
+  if(nThreads < 2)
+  {
+    for(int j = 0; j < mNRenderJobs; j++)
+    {
+      Render(mRenderJobs[j], inputs, outputs, startIndex);
+    }
+
+    return;
+  }
+
+  mRenderInputs = inputs;
+  mRenderOutputs = outputs;
+  mRenderStartIndex = startIndex;
+
+  for(int c = 0; c < nInputs; c++)
+  {
+    mScratchInputs[c] = inputs[c] + startIndex;
+  }
+
+  std::fill(mScratchUsed.begin(), mScratchUsed.end(), 0);
+  mNextRenderJob.store(0, std::memory_order_relaxed);
+
+  auto renderVoices = [this](int threadIdx) { RenderVoices(threadIdx); };
+  mWorkerPool->Run(nThreads, renderVoices);
+
+  for(int t = 1; t < nThreads; t++)
+  {
+    if(!mScratchUsed[t - 1])
+      continue;
+
+    sample** scratchBus = mScratchBuses.data() + (t - 1) * mMaxRenderOutputs;
+
+    for(int c = 0; c < nOutputs; c++)
+    {
+      simd::MultiplyAdd(outputs[c] + startIndex, scratchBus[c], blockSize, static_cast<sample>(1));
     }
   }
 }
+
+void VoiceAllocator::Render(const RenderJob& job, sample** inputs, sample** outputs, int startIndex)
+{
+  if(!job.pRenderer)
+  {
+    mBusyVoices[job.firstVoice].pVoice->ProcessSamplesAccumulating(inputs, outputs, mRenderNInputs, mRenderNOutputs, startIndex, mRenderFrames);
+    return;
+  }
+
+  VoiceBatch batch;
+
+  for(int v = job.firstVoice; v < job.firstVoice + job.nVoices; v++)
+  {
+    batch.Add(mBusyVoices[v].pVoice);
+  }
+
+  job.pRenderer->ProcessBatchAccumulating(batch, inputs, outputs, mRenderNInputs, mRenderNOutputs, startIndex, mRenderFrames);
+}
+
+void VoiceAllocator::RenderVoices(int threadIdx)
+{
+  int j;
+
+  while((j = mNextRenderJob.fetch_add(1, std::memory_order_relaxed)) < mNRenderJobs)
+  {
+    if(threadIdx == 0)
+    {
+      Render(mRenderJobs[j], mRenderInputs, mRenderOutputs, mRenderStartIndex);
+      continue;
+    }
+
+    sample** scratchBus = mScratchBuses.data() + (threadIdx - 1) * mMaxRenderOutputs;
+
+    // the bus is only cleared when the thread gets a job, and only then summed into the outputs
+    if(!mScratchUsed[threadIdx - 1])
+    {
+      for(int c = 0; c < mRenderNOutputs; c++)
+      {
+        std::fill(scratchBus[c], scratchBus[c] + mRenderFrames, static_cast<sample>(0));
+      }
+
+      mScratchUsed[threadIdx - 1] = 1;
+    }
+
+    Render(mRenderJobs[j], mScratchInputs.data(), scratchBus, 0);
+  }
+}
+
+void VoiceAllocator::SetWorkerPool(IPlugWorkerPool* pPool, int maxBlockSize, int maxInputs, int maxOutputs)
+{
+  mWorkerPool = pPool;
+  mMaxThreads = pPool ? pPool->NThreads() + 1 : 1;
+  mMaxRenderFrames = maxBlockSize;
+  mMaxRenderInputs = maxInputs;
+  mMaxRenderOutputs = maxOutputs;
+
+  const int nScratchBuses = mMaxThreads - 1;
+  mScratchBuffers.assign(static_cast<size_t>(nScratchBuses) * maxOutputs * maxBlockSize, 0);
+  mScratchBuses.resize(static_cast<size_t>(nScratchBuses) * maxOutputs);
+
+  for(size_t i = 0; i < mScratchBuses.size(); i++)
+  {
+    mScratchBuses[i] = mScratchBuffers.data() + i * maxBlockSize;
+  }
+
+  mScratchInputs.assign(maxInputs, nullptr);
+  mScratchUsed.assign(nScratchBuses, 0);
+}
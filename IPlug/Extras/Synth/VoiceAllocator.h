@@ -15,7 +15,10 @@
  * @copydoc VoiceAllocator
  */
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <climits>
 #include <vector>
 #include <stdint.h>
 #include <functional>
@@ -24,6 +27,7 @@
 
 #include "IPlugLogger.h"
 #include "IPlugQueue.h"
+#include "IPlugWorkerPool.h"
 
 #include "SynthVoice.h"
 
@@ -58,7 +62,8 @@ enum EVoiceAction
   kTimbreAction,
   kSustainAction,
   kControllerAction,
-  kProgramChangeAction
+  kProgramChangeAction,
+  kNotePitchBendAction // bends the pitch of the addressed voices' note in octaves, on top of the channel's kPitchBendAction, e.g. for MIDI 2.0 per-note pitch bend
 };
 
 /** A VoiceInputEvent describes a change in input to be applied to one more more voices.
@@ -96,7 +101,16 @@ public:
     kNumPolyModes
   };
 
+  /** Which voice a new note takes when all the voices are busy */
+  enum EStealMode
+  {
+    kStealModeOldest = 0, // the voice that was triggered first
+    kStealModeQuietest, // the voice with the lowest SynthVoice::GetLevel(), or the oldest of those that are equally quiet
+    kNumStealModes
+  };
+
   static constexpr int kVoiceMostRecent = 1 << 7;
+  static constexpr int kMaxUnisonVoices = 16;
 
   // one voice worth of ramp generators
   using VoiceControlRamps = ControlRampProcessor::ProcessorArray<kNumVoiceControlRamps>;
@@ -135,41 +149,254 @@ public:
   /** Send the event to the voices matching its address.*/
   void SendEventToVoices(VoiceInputEvent event);
 
+  /** Render the busy voices, accumulating into the outputs. Voices with a SynthVoiceBatchRenderer are rendered in batches of up to VoiceBatch::kMaxVoices.
+   * With a worker pool, see SetWorkerPool(), the voices and batches are shared between the pool's threads and the calling thread */
   void ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize);
 
+  /** Render voices in parallel on a worker pool, e.g. IPlugProcessor::GetWorkerPool(). Each thread takes the next unrendered voice until there are none left, so
+   * threads that get cheap voices render more of them, and accumulates into its own scratch bus, which are summed into the outputs at the end. Voices must not share state that
+   * ProcessSamplesAccumulating() writes to. The pool is only used when there are at least kMinVoicesPerThread busy voices for each thread, and blocks larger than maxBlockSize or with more
+   * channels than those given here are rendered on the calling thread. This method is not realtime safe
+   * @param pPool The pool, which must outlive its use here, or nullptr to render the voices on the calling thread
+   * @param maxBlockSize The largest blockSize that will be passed to ProcessVoices()
+   * @param maxInputs The largest number of inputs that will be passed to ProcessVoices()
+   * @param maxOutputs The largest number of outputs that will be passed to ProcessVoices() */
+  void SetWorkerPool(IPlugWorkerPool* pPool, int maxBlockSize, int maxInputs, int maxOutputs);
+
+  /** Have ProcessVoices() write the control ramps of each busy voice into one contiguous buffer before the voices render, with SIMD, so that voices can read them with
+   * SynthVoice::GetControlRamp() rather than each writing its own. Controls that are constant for the block are flagged as settled and not written, see SynthVoice::IsControlSettled().
+   * This method is not realtime safe
+   * @param maxBlockSize The largest blockSize that will be passed to ProcessVoices(), or 0 to stop writing the buffers. Larger blocks are rendered without them */
+  void SetControlRampBuffers(int maxBlockSize);
+
   size_t GetNVoices() const {return mVoicePtrs.size();}
+
+  /** Limit the number of voices that new notes can be allocated to, without adding or removing voices. This doesn't allocate, so it can be called on the audio thread, e.g. to use more voices when rendering offline.
+   * Voices above the limit that are already playing are not stopped, but they won't be retriggered
+   * @param nVoices The maximum number of voices to use, or 0 to use all the voices that have been added */
+  void SetPolyphony(int nVoices) { mPolyphony = nVoices; }
+
+  /** Stack several voices on each note, detuned across a spread. The voices of a note form a unison group whose leader computes the work they share once per block,
+   * see SynthVoice::ProcessShared(), so the other voices only need to run their own oscillators. In poly mode each note takes nVoices voices, stealing whole groups when none are free.
+   * In mono mode the first nVoices voices of the zone are the group, and with nVoices = 1 every voice of the zone plays the note, as before
+   * @param nVoices The number of voices per note, up to kMaxUnisonVoices
+   * @param detune The spread in semitones between the lowest and highest voice of a group */
+  void SetUnison(int nVoices, float detune)
+  {
+    mUnisonVoices = std::max(1, std::min(nVoices, kMaxUnisonVoices));
+    mUnisonDetune = detune;
+  }
+
+  /** @return The number of voices per note, see SetUnison() */
+  int GetUnisonVoices() const { return mUnisonVoices; }
+
+  /** @return The number of voices that new notes can be allocated to */
+  int GetPolyphony() const
+  {
+    const int nVoices = static_cast<int>(mVoicePtrs.size());
+    return (mPolyphony > 0 && mPolyphony < nVoices) ? mPolyphony : nVoices;
+  }
+
+  /** Limit polyphony by CPU load. ProcessVoices() measures how long the voices take to render, and when the average cost per voice means the busy voices would
+   * take more than the budget, the number of voices is lowered: new notes steal voices instead of taking free ones, and the least audible voices above the limit are
+   * stopped with SynthVoice::Kill(), quietest first. The limit rises again by one voice per ProcessVoices() call while there is time to spare, up to GetPolyphony().
+   * The time measured is wall clock time, so with a worker pool it is the time the voices add to the audio callback rather than their total CPU time
+   * @param budget The fraction of the real time duration of each block that rendering the voices may take, e.g. 0.5, or 0 to turn the governor off */
+  void SetCPUBudget(double budget);
+
+  /** @return The number of voices the CPU governor allows at the moment, see SetCPUBudget(), or GetPolyphony() if it is off */
+  int GetGovernedPolyphony() const { return mGovernedPolyphony > 0 ? std::min(mGovernedPolyphony, GetPolyphony()) : GetPolyphony(); }
+
+  /** @return The number of busy voices that have been taken for new notes since the VoiceAllocator was created, e.g. for benchmarks */
+  int64_t GetStealCount() const { return mStealCount; }
+
   SynthVoice* GetVoice(int voiceIndex) const {return mVoicePtrs[voiceIndex];}
   void SetPitchOffset(float offset) { mPitchOffset = offset; }
 
 private:
-  using VoiceBitsArray = std::bitset<UCHAR_MAX>;
+  /** The indices of the voices that match a VoiceAddress, a fixed capacity list so that lookups don't allocate */
+  struct VoiceList
+  {
+    std::array<uint8_t, UCHAR_MAX> mVoices;
+    int mSize = 0;
+
+    void Add(int voiceIdx) { mVoices[mSize++] = static_cast<uint8_t>(voiceIdx); }
+    const uint8_t* begin() const { return mVoices.data(); }
+    const uint8_t* end() const { return mVoices.data() + mSize; }
+  };
 
-  VoiceBitsArray VoicesMatchingAddress(VoiceAddress va);
+  /** An ordered set of MIDI keys, as a doubly linked list threaded through arrays indexed by key, so that adding, removing and finding a key take constant time and never allocate */
+  class KeyList
+  {
+  public:
+    static constexpr int kNumKeys = 128;
+
+    bool Contains(int key) const { return key >= 0 && key < kNumKeys && mContains[key]; }
+    bool Empty() const { return mFront < 0; }
+
+    /** @return The first key, or -1 if the list is empty */
+    int Front() const { return mFront; }
+
+    /** @return The last key added, or -1 if the list is empty */
+    int Back() const { return mBack; }
+
+    /** @return The key after this one, or -1 at the end of the list */
+    int Next(int key) const { return mNext[key]; }
+
+    /** Add a key at the back, if it is not in the list already */
+    void PushBack(int key)
+    {
+      if (key < 0 || key >= kNumKeys || mContains[key])
+        return;
+
+      mContains[key] = true;
+      mPrev[key] = static_cast<int8_t>(mBack);
+      mNext[key] = -1;
+
+      if (mBack >= 0)
+        mNext[mBack] = static_cast<int8_t>(key);
+      else
+        mFront = key;
+
+      mBack = key;
+    }
+
+    void Remove(int key)
+    {
+      if (!Contains(key))
+        return;
+
+      mContains[key] = false;
+
+      if (mPrev[key] >= 0)
+        mNext[mPrev[key]] = mNext[key];
+      else
+        mFront = mNext[key];
+
+      if (mNext[key] >= 0)
+        mPrev[mNext[key]] = mPrev[key];
+      else
+        mBack = mPrev[key];
+    }
+
+    void Clear()
+    {
+      mContains.reset();
+      mFront = mBack = -1;
+    }
+
+  private:
+    std::bitset<kNumKeys> mContains;
+    std::array<int8_t, kNumKeys> mPrev;
+    std::array<int8_t, kNumKeys> mNext;
+    int mFront = -1;
+    int mBack = -1;
+  };
 
-  void SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples);
-  void SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val);
-  void SendProgramChangeToVoices(VoiceBitsArray v, int pgm);
+  /** Find the voices matching an address. When the address has a key only the voices playing that key are checked, see SetVoiceKey(),
+   * otherwise when it has a channel only the voices on that channel are checked, see SetVoiceChannel() */
+  VoiceList VoicesMatchingAddress(VoiceAddress va);
 
-  void StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
-  void StartVoices(VoiceBitsArray voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
+  void SendControlToVoiceInputs(const VoiceList& voices, int ctlIdx, float val, int glideSamples);
+  void SendControlToVoicesDirect(const VoiceList& voices, int ctlIdx, float val);
+  void SendProgramChangeToVoices(const VoiceList& voices, int pgm);
+
+  /** Set the key a voice is playing, or -1 for none, and move it to that key's list of voices */
+  void SetVoiceKey(int voiceIdx, int key);
+
+  /** Set the MIDI channel of a voice and move it to that channel's list of voices */
+  void SetVoiceChannel(int voiceIdx, int channel);
+
+  /** Pop the queued events into mEvents, dropping pitch bend, pressure and timbre events that are overridden by a later one to the same address before any other event */
+  void CoalesceEvents();
+
+  /** @param steal \c true if the voice is busy and is being taken for a new note, in which case SynthVoice::Trigger() is told it is a retrigger so that the voice can fade out quickly first */
+  void StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig, bool steal = false);
+  void StartVoices(const VoiceList& voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
 
   void StopVoice(int voiceIdx, int sampleOffset);
-  void StopVoices(VoiceBitsArray voices, int sampleOffset);
+  void StopVoices(const VoiceList& voices, int sampleOffset);
 
   void CalcGlideTimesInSamples();
   void ClearVoiceInputs(SynthVoice* pVoice);
-  int FindFreeVoiceIndex(int startIndex) const;
-  int FindVoiceIndexToSteal(int64_t sampleTime) const;
+  /** @param pTaken Voices to skip, or nullptr */
+  int FindFreeVoiceIndex(int startIndex, const std::bitset<UCHAR_MAX>* pTaken = nullptr) const;
+
+  /** @param pTaken Voices to skip, or nullptr
+   * @return The voice to steal, or -1 if all the voices are taken */
+  int FindVoiceIndexToSteal(int64_t sampleTime, const std::bitset<UCHAR_MAX>* pTaken = nullptr) const;
+
+  /** Make the voices one unison group, led by the first, or each a group of its own. Voices left behind by the leader of their old group are stopped, as the leader no longer computes their shared work */
+  void SetUnisonGroup(const VoiceList& voices, bool grouped, int sampleOffset);
+
+  /** @return The voices of a zone that play in mono mode, see SetUnison() */
+  VoiceList MonoVoices(uint8_t zone);
+
+  /** @return The number of busy voices that have not been stopped by the CPU governor */
+  int CountActiveVoices() const;
+
+  /** Update the CPU governor's estimate of the cost of a voice and its voice limit, and stop the least audible voices over the limit
+   * @param nBusyVoices The number of voices rendered
+   * @param nFrames The number of frames rendered
+   * @param seconds The time rendering took */
+  void UpdateCPUGovernor(int nBusyVoices, int nFrames, double seconds);
+
+  /** Write the control ramps of a voice to its part of mControlRampBuffer and flag the settled controls */
+  void WriteControlRamps(SynthVoice* pVoice, int blockSize);
+
+  /** Point each voice at its part of mControlRampBuffer */
+  void AssignControlRampBuffers();
+
+  /** Render the busy voices for ProcessVoices(), serially or on the worker pool */
+  void RenderBusyVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize);
 
   void NoteOn(VoiceInputEvent e, int64_t sampleTime);
   void NoteOff(VoiceInputEvent e, int64_t sampleTime);
 
-  IPlugQueue<VoiceInputEvent> mInputQueue{1024};
+  /** A voice, or a batch of voices that share a SynthVoiceBatchRenderer, to be rendered by one call */
+  struct RenderJob
+  {
+    SynthVoiceBatchRenderer* pRenderer;
+    int firstVoice; // index into mBusyVoices
+    int nVoices;
+  };
+
+  struct BusyVoice
+  {
+    SynthVoiceBatchRenderer* pRenderer;
+    SynthVoice* pVoice;
+  };
+
+  void Render(const RenderJob& job, sample** inputs, sample** outputs, int startIndex);
+
+  /** Render jobs from mRenderJobs until there are none left, called once for each thread by ProcessVoices(). Thread 0 accumulates into the outputs, the others into their scratch bus */
+  void RenderVoices(int threadIdx);
+
+  static constexpr int kInputQueueSize = 1024;
+  static constexpr int kNumChannels = 16;
+
+  IPlugQueue<VoiceInputEvent> mInputQueue{kInputQueueSize};
+  std::array<VoiceInputEvent, kInputQueueSize> mEvents; // the events of the current ProcessEvents() call, see CoalesceEvents()
+  int mNEvents{0};
 
   std::vector<SynthVoice*> mVoicePtrs;
+  std::vector<BusyVoice> mBusyVoices; // the voices to render in the current ProcessVoices() call, grouped by renderer
+  std::vector<RenderJob> mRenderJobs;
+  int mNBusyVoices{0};
+  int mNRenderJobs{0};
   std::vector<std::unique_ptr<VoiceControlRamps>> mVoiceGlides;
-  std::vector<int> mHeldKeys; // The currently physically held keys on the keyboard
-  std::vector<int> mSustainedNotes; // Any notes that are sustained, including those that are physically held
+  KeyList mHeldKeys; // The currently physically held keys on the keyboard
+  KeyList mSustainedNotes; // Any notes that are sustained, including those that are physically held
+
+  // the voices playing each key, as lists threaded through the voice indices
+  std::array<int16_t, KeyList::kNumKeys> mFirstVoiceForKey;
+  std::vector<int16_t> mNextVoiceForKey;
+  std::vector<int16_t> mPrevVoiceForKey;
+
+  // the voices on each MIDI channel, so that MPE expression is routed without searching all voices
+  std::array<int16_t, kNumChannels> mFirstVoiceForChannel;
+  std::vector<int16_t> mNextVoiceForChannel;
+  std::vector<int16_t> mPrevVoiceForChannel;
 
   std::function<float(int)> mKeyToPitchFn;
   double mPitchOffset{0.};
@@ -181,15 +408,53 @@ private:
   double mSampleRate;
   int mBlockSize;
 
+  int mPolyphony{0}; // 0 = all voices
+  int mUnisonVoices{1};
+  float mUnisonDetune{0.f}; // semitones
   bool mRotateVoices{true};
   int mVoiceRotateIndex{0};
   bool mSustainPedalDown{false};
+
+  // control ramp buffers, see SetControlRampBuffers()
+  int mMaxControlRampFrames{0};
+  std::vector<float> mControlRampBuffer;
+
+  int64_t mStealCount{0};
+
+  // CPU governor, see SetCPUBudget()
+  static constexpr double kVoiceCostSmoothing = 0.1;
+  static constexpr double kCPUBudgetHeadroom = 0.9; // the limit is only raised if one more voice would stay this far within the budget
+  double mCPUBudget{0.}; // 0 = off
+  double mVoiceCost{0.}; // smoothed render time of one voice for one frame, in seconds
+  int mGovernedPolyphony{0}; // 0 = not limited
+  std::vector<uint8_t> mVoiceKilled; // voices stopped by the governor, which are fading out
+  std::vector<float> mVoiceNotePitch; // the pitch each voice was started with, which kNotePitchBendAction bends from
   float mModWheel{0.f};
   float mMinHeldVelocity{1.f};
 
+  // parallel rendering, see SetWorkerPool()
+  static constexpr int kMinVoicesPerThread = 4;
+  IPlugWorkerPool* mWorkerPool{nullptr};
+  int mMaxThreads{1};
+  int mMaxRenderFrames{0};
+  int mMaxRenderInputs{0};
+  int mMaxRenderOutputs{0};
+  std::vector<sample> mScratchBuffers; // maxOutputs channels of maxBlockSize samples for each thread but the first
+  std::vector<sample*> mScratchBuses;
+  std::vector<sample*> mScratchInputs; // the inputs offset to the start index, as the scratch buses start at 0
+  std::vector<uint8_t> mScratchUsed;
+  std::atomic<int> mNextRenderJob{0};
+  sample** mRenderInputs{nullptr};
+  sample** mRenderOutputs{nullptr};
+  int mRenderNInputs{0};
+  int mRenderNOutputs{0};
+  int mRenderStartIndex{0};
+  int mRenderFrames{0};
+
 public:
   EPolyMode mPolyMode {kPolyModePoly};
   EATMode mATMode {kATModeChannel};
+  EStealMode mStealMode {kStealModeOldest};
 };
 
 END_IPLUG_NAMESPACE
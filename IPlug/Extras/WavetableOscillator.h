@@ -0,0 +1,361 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Band-limited wavetable oscillators, with mipmapped tables shared between voices and instances
+ */
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "IPlugConstants.h"
+#include "Oscillator.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A single cycle waveform stored as a mipmap of band-limited tables, one per octave. Each table holds only the harmonics that stay below Nyquist for the
+ * range of frequencies it is played at, so the oscillators that read it do not alias. A Wavetable is immutable once built, so one can be shared by every voice
+ * of every instance via a std::shared_ptr<const Wavetable>, e.g. the shapes from Saw(), Square(), Triangle() and Sine() are built once per process */
+template <typename T>
+class Wavetable
+{
+public:
+  static constexpr int kTableSize = 2048;
+  static constexpr int kNumLevels = 10; // level k holds harmonics up to kTableSize / 2^(k+2), so the last holds only the fundamental
+
+  /** Build a wavetable from the amplitudes of its harmonics
+   * @param sinAmps The amplitude of the sine of each harmonic, starting from the fundamental
+   * @param cosAmps The amplitude of the cosine of each harmonic, starting from the fundamental, may be empty
+   * @param normalise If true the waveform is scaled to peak at +/-1 */
+  Wavetable(const std::vector<double>& sinAmps, const std::vector<double>& cosAmps = {}, bool normalise = true)
+  {
+    Build(sinAmps, cosAmps, normalise);
+  }
+
+  /** Build a wavetable from one cycle of a waveform, of any length. The harmonics are found with a DFT, which is slow, so do this off the audio thread
+   * @param cycle The samples of one cycle
+   * @param normalise If true the waveform is scaled to peak at +/-1 */
+  static std::shared_ptr<const Wavetable> FromSingleCycle(const std::vector<double>& cycle, bool normalise = true)
+  {
+    const int length = static_cast<int>(cycle.size());
+    const int nHarmonics = std::min(length / 2, kTableSize / 4);
+    std::vector<double> sinAmps(nHarmonics), cosAmps(nHarmonics);
+
+    for (int h = 1; h <= nHarmonics; h++)
+    {
+      double s = 0., c = 0.;
+
+      for (int n = 0; n < length; n++)
+      {
+        const double phase = 2. * PI * ((static_cast<long long>(h) * n) % length) / length;
+        s += cycle[n] * std::sin(phase);
+        c += cycle[n] * std::cos(phase);
+      }
+
+      sinAmps[h - 1] = 2. * s / length;
+      cosAmps[h - 1] = 2. * c / length;
+    }
+
+    return std::make_shared<const Wavetable>(sinAmps, cosAmps, normalise);
+  }
+
+  static std::shared_ptr<const Wavetable> Sine()
+  {
+    static const auto sTable = std::make_shared<const Wavetable>(std::vector<double>{1.});
+    return sTable;
+  }
+
+  static std::shared_ptr<const Wavetable> Saw()
+  {
+    static const auto sTable = std::make_shared<const Wavetable>(Harmonics([](int h) { return (h % 2 ? 1. : -1.) / h; }));
+    return sTable;
+  }
+
+  static std::shared_ptr<const Wavetable> Square()
+  {
+    static const auto sTable = std::make_shared<const Wavetable>(Harmonics([](int h) { return h % 2 ? 1. / h : 0.; }));
+    return sTable;
+  }
+
+  static std::shared_ptr<const Wavetable> Triangle()
+  {
+    static const auto sTable = std::make_shared<const Wavetable>(Harmonics([](int h) { return h % 2 ? ((h / 2) % 2 ? -1. : 1.) / (h * h) : 0.; }));
+    return sTable;
+  }
+
+  /** @param phaseIncr The phase increment in cycles per sample
+   * @return The level to play at this increment, with no harmonic above Nyquist */
+  static inline int GetLevel(double phaseIncr)
+  {
+    const double x = std::abs(phaseIncr) * kTableSize;
+
+    if (x < 1.)
+      return 0;
+
+    return std::min(std::ilogb(x), kNumLevels - 1);
+  }
+
+  /** @return The kTableSize + 1 samples of a level, the last a copy of the first so that reads can interpolate without wrapping */
+  inline const T* GetTable(int level) const { return mTables.data() + level * (kTableSize + 1); }
+
+  /** Read a level, interpolating linearly
+   * @param level The level from GetLevel()
+   * @param phase The phase, between 0 and 1 */
+  inline T Lookup(int level, double phase) const
+  {
+    const double pos = phase * kTableSize;
+    const int idx = static_cast<int>(pos);
+    const T frac = static_cast<T>(pos - idx);
+    const T* pTable = GetTable(level) + idx;
+    return pTable[0] + frac * (pTable[1] - pTable[0]);
+  }
+
+private:
+  template <typename F>
+  static std::vector<double> Harmonics(F func)
+  {
+    std::vector<double> amps(kTableSize / 4);
+
+    for (int h = 1; h <= static_cast<int>(amps.size()); h++)
+      amps[h - 1] = func(h);
+
+    return amps;
+  }
+
+  void Build(const std::vector<double>& sinAmps, const std::vector<double>& cosAmps, bool normalise)
+  {
+    std::vector<double> sinTable(kTableSize);
+
+    for (int n = 0; n < kTableSize; n++)
+      sinTable[n] = std::sin(2. * PI * n / kTableSize);
+
+    const int nHarmonics = static_cast<int>(std::max(sinAmps.size(), cosAmps.size()));
+    std::vector<std::vector<double>> levels(kNumLevels, std::vector<double>(kTableSize, 0.));
+
+    // sum the harmonics from the top down, so each level starts from the one above it that holds fewer
+    std::vector<double> sum(kTableSize, 0.);
+    int harmonic = std::min(nHarmonics, kTableSize / 4);
+
+    for (int level = kNumLevels - 1; level >= 0; level--)
+    {
+      const int maxHarmonic = std::min(harmonic, kTableSize >> (level + 2));
+
+      for (int h = static_cast<int>(level == kNumLevels - 1 ? 1 : (kTableSize >> (level + 3)) + 1); h <= maxHarmonic; h++)
+      {
+        const double s = h <= static_cast<int>(sinAmps.size()) ? sinAmps[h - 1] : 0.;
+        const double c = h <= static_cast<int>(cosAmps.size()) ? cosAmps[h - 1] : 0.;
+
+        if (s == 0. && c == 0.)
+          continue;
+
+        for (int n = 0; n < kTableSize; n++)
+        {
+          const int i = (h * n) & (kTableSize - 1);
+          sum[n] += s * sinTable[i] + c * sinTable[(i + kTableSize / 4) & (kTableSize - 1)];
+        }
+      }
+
+      levels[level] = sum;
+    }
+
+    double gain = 1.;
+
+    if (normalise)
+    {
+      double peak = 0.;
+
+      for (auto s : levels[0])
+        peak = std::max(peak, std::abs(s));
+
+      if (peak > 0.)
+        gain = 1. / peak;
+    }
+
+    mTables.resize(kNumLevels * (kTableSize + 1));
+
+    for (int level = 0; level < kNumLevels; level++)
+    {
+      T* pTable = mTables.data() + level * (kTableSize + 1);
+
+      for (int n = 0; n < kTableSize; n++)
+        pTable[n] = static_cast<T>(levels[level][n] * gain);
+
+      pTable[kTableSize] = pTable[0];
+    }
+  }
+
+  std::vector<T> mTables;
+};
+
+/** An oscillator that reads a band-limited Wavetable, choosing the level from the frequency */
+template <typename T>
+class WavetableOscillator : public IOscillator<T>
+{
+public:
+  WavetableOscillator(std::shared_ptr<const Wavetable<T>> wavetable = Wavetable<T>::Saw(), double startPhase = 0., double startFreq = 1.)
+  : IOscillator<T>(startPhase, startFreq)
+  , mWavetable(wavetable)
+  {
+  }
+
+  /** Swap the wavetable, only the shared pointer is copied */
+  void SetWavetable(std::shared_ptr<const Wavetable<T>> wavetable)
+  {
+    mWavetable = wavetable;
+  }
+
+  inline T Process(double freqHz) override
+  {
+    IOscillator<T>::SetFreqCPS(freqHz);
+    T output;
+    ProcessBlock(&output, 1);
+    return output;
+  }
+
+  /** Render at the frequency set with SetFreqCPS() */
+  void ProcessBlock(T* pOutput, int nFrames)
+  {
+    const Wavetable<T>& wavetable = *mWavetable;
+    const double phaseIncr = IOscillator<T>::mPhaseIncr;
+    const int level = Wavetable<T>::GetLevel(phaseIncr);
+    double phase = IOscillator<T>::mPhase;
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      phase -= std::floor(phase);
+      pOutput[s] = wavetable.Lookup(level, phase);
+      phase += phaseIncr;
+    }
+
+    IOscillator<T>::mPhase = phase - std::floor(phase);
+  }
+
+private:
+  std::shared_ptr<const Wavetable<T>> mWavetable;
+};
+
+/** Renders N wavetable oscillators at once, e.g. the unison voices or partials of a synth. The state is held as arrays of N, with the oscillators
+ * as the inner loop, so that the phase updates and interpolation compile to SIMD instructions, with the table reads as gathers where the target has them
+ * @tparam T The sample type
+ * @tparam N The number of oscillators, a multiple of the SIMD width is best */
+template <typename T, int N = 8>
+class WavetableOscillatorBank
+{
+public:
+  WavetableOscillatorBank(std::shared_ptr<const Wavetable<T>> wavetable = Wavetable<T>::Saw())
+  {
+    for (int i = 0; i < N; i++)
+    {
+      mWavetables[i] = wavetable;
+      mGain[i] = T(1);
+      UpdateTable(i);
+    }
+  }
+
+  void SetSampleRate(double sampleRate)
+  {
+    for (int i = 0; i < N; i++)
+      mPhaseIncr[i] *= mSampleRate / sampleRate;
+
+    mSampleRate = sampleRate;
+
+    for (int i = 0; i < N; i++)
+      UpdateTable(i);
+  }
+
+  void SetWavetable(int osc, std::shared_ptr<const Wavetable<T>> wavetable)
+  {
+    mWavetables[osc] = wavetable;
+    UpdateTable(osc);
+  }
+
+  void SetFreqCPS(int osc, double freqHz)
+  {
+    mPhaseIncr[osc] = freqHz / mSampleRate;
+    UpdateTable(osc);
+  }
+
+  /** @param gain The level of the oscillator in the mix written by ProcessBlock(T*, int) */
+  void SetGain(int osc, T gain) { mGain[osc] = gain; }
+
+  void SetPhase(int osc, double phase) { mPhase[osc] = phase - std::floor(phase); }
+
+  void Reset()
+  {
+    for (int i = 0; i < N; i++)
+      mPhase[i] = 0.;
+  }
+
+  /** Render the oscillators to one output each
+   * @param outputs N arrays of nFrames samples */
+  void ProcessBlock(T** outputs, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      T frame[N];
+      ProcessFrame(frame);
+
+      for (int i = 0; i < N; i++)
+        outputs[i][s] = frame[i];
+    }
+  }
+
+  /** Render the sum of the oscillators, each scaled by its gain
+   * @param output An array of nFrames samples, which is overwritten */
+  void ProcessBlock(T* output, int nFrames)
+  {
+    for (auto s = 0; s < nFrames; s++)
+    {
+      T frame[N];
+      ProcessFrame(frame);
+
+      T sum = 0.;
+
+      for (int i = 0; i < N; i++)
+        sum += frame[i] * mGain[i];
+
+      output[s] = sum;
+    }
+  }
+
+private:
+  inline void ProcessFrame(T* frame)
+  {
+    for (int i = 0; i < N; i++)
+    {
+      const double pos = mPhase[i] * Wavetable<T>::kTableSize;
+      const int idx = static_cast<int>(pos);
+      const T frac = static_cast<T>(pos - idx);
+      const T* pTable = mTables[i] + idx;
+      frame[i] = pTable[0] + frac * (pTable[1] - pTable[0]);
+
+      const double phase = mPhase[i] + mPhaseIncr[i];
+      mPhase[i] = phase - std::floor(phase);
+    }
+  }
+
+  void UpdateTable(int osc)
+  {
+    mTables[osc] = mWavetables[osc]->GetTable(Wavetable<T>::GetLevel(mPhaseIncr[osc]));
+  }
+
+  double mSampleRate = 44100.;
+  alignas(32) double mPhase[N] = {};
+  alignas(32) double mPhaseIncr[N] = {};
+  alignas(32) T mGain[N] = {};
+  const T* mTables[N] = {};
+  std::shared_ptr<const Wavetable<T>> mWavetables[N];
+};
+
+END_IPLUG_NAMESPACE
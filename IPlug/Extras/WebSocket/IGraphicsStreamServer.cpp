@@ -0,0 +1,182 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#include "IGraphicsStreamServer.h"
+
+using namespace iplug;
+using namespace igraphics;
+
+IGraphicsStreamServer::~IGraphicsStreamServer()
+{
+  Detach();
+}
+
+void IGraphicsStreamServer::Attach(IGraphicsHeadless* pGraphics, int tileSize, IGraphicsHeadless::ETileFormat format, int quality)
+{
+  Detach();
+  mGraphics = pGraphics;
+
+  mGraphics->SetFrameSizeFunc([this](int width, int height) {
+    mFrameGeneration++;
+    SendFrameSize(-1, width, height);
+  });
+
+  mGraphics->SetTileFunc([this](int tileIdx, int x, int y, int w, int h, const void* pData, int size) {
+    SendTile(-1, tileIdx, x, y, w, h, pData, size);
+  }, tileSize, format, quality);
+
+  mGraphics->SetTickFuncs([this]() { ProcessInput(); }, [this]() { FlushConnections(); });
+
+  // the tiles are encoded again in the new format, after the clients have been told about it
+  mFrameGeneration++;
+  SendFrameSize(-1, mGraphics->GetFrameWidth(), mGraphics->GetFrameHeight());
+}
+
+void IGraphicsStreamServer::Detach()
+{
+  if (!mGraphics)
+    return;
+
+  mGraphics->SetFrameSizeFunc(nullptr);
+  mGraphics->SetTileFunc(nullptr);
+  mGraphics->SetTickFuncs(nullptr, nullptr);
+  mGraphics = nullptr;
+}
+
+void IGraphicsStreamServer::OnWebsocketReady(int idx)
+{
+  mNewClients.Push(idx);
+}
+
+//this method gets called on server connection thread
+bool IGraphicsStreamServer::OnWebsocketData(int idx, void* pData, size_t dataSize)
+{
+  const uint8_t* pByteData = (const uint8_t*) pData;
+  InputEvent event;
+
+  // Mouse EVent From UI
+  if (dataSize >= 25 && memcmp(pData, "MEVFUI", 6) == 0)
+  {
+    event.type = pByteData[6];
+    memcpy(&event.x, pByteData + 7, sizeof(float));
+    memcpy(&event.y, pByteData + 11, sizeof(float));
+    memcpy(&event.dX, pByteData + 15, sizeof(float));
+    memcpy(&event.dY, pByteData + 19, sizeof(float));
+    event.buttons = pByteData[23];
+    event.modifiers = pByteData[24];
+    mInputFromClients.Push(event);
+  }
+  // Key EVent From UI
+  else if (dataSize >= 17 && memcmp(pData, "KEVFUI", 6) == 0)
+  {
+    event.key = true;
+    event.type = pByteData[6];
+    memcpy(&event.VK, pByteData + 7, sizeof(int));
+    event.modifiers = pByteData[11];
+    memcpy(event.utf8, pByteData + 12, 4);
+    mInputFromClients.Push(event);
+  }
+
+  return true; // return true to keep the connection open
+}
+
+void IGraphicsStreamServer::ProcessInput()
+{
+  int idx;
+
+  while (mNewClients.Pop(idx))
+  {
+    SendFrameSize(idx, mGraphics->GetFrameWidth(), mGraphics->GetFrameHeight());
+
+    mGraphics->ForEachTile([this, idx](int tileIdx, int x, int y, int w, int h, const void* pData, int size) {
+      SendTile(idx, tileIdx, x, y, w, h, pData, size);
+    });
+  }
+
+  InputEvent event;
+
+  while (mInputFromClients.Pop(event))
+    ApplyInput(event);
+}
+
+void IGraphicsStreamServer::ApplyInput(const InputEvent& event)
+{
+  const bool shift = event.modifiers & 1;
+  const bool ctrl = event.modifiers & 2;
+  const bool alt = event.modifiers & 4;
+
+  float x, y;
+
+  if (event.key)
+  {
+    IKeyPress keyPress {event.utf8, event.VK, shift, ctrl, alt};
+    mGraphics->GetMouseLocation(x, y);
+
+    if (event.type)
+      mGraphics->OnKeyUp(x, y, keyPress);
+    else
+      mGraphics->OnKeyDown(x, y, keyPress);
+
+    return;
+  }
+
+  // from pixels of the frame to the UI's coordinates
+  const float scale = mGraphics->GetDrawScale() * mGraphics->GetScreenScale();
+
+  IMouseInfo info;
+  info.x = x = event.x / scale;
+  info.y = y = event.y / scale;
+  info.dX = event.dX / scale;
+  info.dY = event.dY / scale;
+  info.ms = IMouseMod(event.buttons & 1, event.buttons & 2, shift, ctrl, alt);
+
+  mGraphics->SetMouseLocation(x, y);
+
+  switch (event.type)
+  {
+    case kMouseDown: mGraphics->OnMouseDown({info}); break;
+    case kMouseUp: mGraphics->OnMouseUp({info}); break;
+    case kMouseOver: mGraphics->OnMouseOver(x, y, info.ms); break;
+    case kMouseDrag: mGraphics->OnMouseDrag({info}); break;
+    case kMouseWheel: mGraphics->OnMouseWheel(x, y, info.ms, event.dY); break;
+    case kMouseDblClick:
+      if (!mGraphics->OnMouseDblClick(x, y, info.ms))
+        mGraphics->OnMouseDown({info});
+      break;
+    case kMouseOut: mGraphics->OnMouseOut(); break;
+    default: break;
+  }
+}
+
+void IGraphicsStreamServer::SendFrameSize(int idx, int width, int height)
+{
+  IByteChunk data;
+  data.PutStr("FRAME");
+  data.Put(&width);
+  data.Put(&height);
+  int format = static_cast<int>(mGraphics->GetTileFormat());
+  data.Put(&format);
+
+  QueueDataToConnection(idx, data.GetData(), data.Size());
+}
+
+void IGraphicsStreamServer::SendTile(int idx, int tileIdx, int x, int y, int w, int h, const void* pData, int size)
+{
+  IByteChunk data;
+  data.PutStr("TILE");
+  data.Put(&x);
+  data.Put(&y);
+  data.Put(&w);
+  data.Put(&h);
+  data.Put(&size);
+  data.PutBytes(pData, size);
+
+  QueueDataToConnection(idx, data.GetData(), data.Size(), -1, TileKey(tileIdx));
+}
@@ -0,0 +1,103 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+#include "IWebsocketServer.h"
+#include "IGraphicsHeadless.h"
+
+/**
+ * @file
+ * @copydoc IGraphicsStreamServer
+ */
+
+#define GRAPHICS_STREAM_INPUT_QUEUE_SIZE 1024 // the number of input events the clients can send between two ticks
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A websocket server that streams an IGraphicsHeadless UI to thin browser clients, e.g. RemoteUI/index.html, and applies the mouse and key events they send back.
+ *
+ * Only the tiles of the frame that have changed are sent, each as a compressed image, and a tile queued for a slow client is replaced by its next version,
+ * so a client that can't keep up skips frames rather than falling behind. A client that connects gets the last image of every tile, without anything being drawn again.
+ * All the clients see and control the same UI. Since the websocket server is shared by the instances in one binary, use this instead of IWebsocketEditorDelegate.
+ *
+ * Messages to the clients, each a string prefix (see IByteChunk::PutStr()) then little-endian values:
+ * - FRAME: int width, int height, int format. The size of the frame in pixels and the ETileFormat of its tiles. The client clears its canvas, the tiles follow
+ * - TILE: int x, int y, int width, int height, int dataSize, then the encoded image
+ *
+ * Messages from the clients, each a six character tag then little-endian values:
+ * - MEVFUI: uint8_t type (EMouseEvent), float x, float y, float dX, float dY, uint8_t buttons (1 left, 2 right), uint8_t modifiers (1 shift, 2 ctrl/cmd, 4 alt).
+ *   Positions are in pixels of the frame, and dY is the delta of a wheel event
+ * - KEVFUI: uint8_t isUp, int VK, uint8_t modifiers, char utf8[5]
+ * @ingroup IPlugExtras */
+class IGraphicsStreamServer : public IWebsocketServer
+{
+public:
+  /** The types of MEVFUI message */
+  enum EMouseEvent
+  {
+    kMouseDown = 0,
+    kMouseUp,
+    kMouseOver,
+    kMouseDrag,
+    kMouseWheel,
+    kMouseDblClick,
+    kMouseOut
+  };
+
+  IGraphicsStreamServer() = default;
+  ~IGraphicsStreamServer();
+
+  /** Start streaming a UI, which must stay open until Detach(). Call this on the main thread, e.g. after the delegate has opened it with OpenWindow(nullptr)
+   * @param tileSize, format, quality See IGraphicsHeadless::SetTileFunc() */
+  void Attach(igraphics::IGraphicsHeadless* pGraphics, int tileSize = 64, igraphics::IGraphicsHeadless::ETileFormat format = igraphics::IGraphicsHeadless::ETileFormat::kPNG, int quality = 90);
+
+  /** Stop streaming the UI. Call this on the main thread, before the UI is closed */
+  void Detach();
+
+  //IWebsocketServer
+  //THESE MESSAGES ARE ALL CALLED ON SERVER THREADS - 1 PER WEBSOCKET CONNECTION
+  void OnWebsocketReady(int idx) override;
+  bool OnWebsocketData(int idx, void* pData, size_t dataSize) override;
+
+private:
+  /** A MEVFUI or KEVFUI message, pushed from the connection threads */
+  struct InputEvent
+  {
+    bool key = false;
+    uint8_t type = 0; // EMouseEvent, or 1 for a key up
+    float x = 0.f, y = 0.f, dX = 0.f, dY = 0.f;
+    uint8_t buttons = 0;
+    uint8_t modifiers = 0;
+    int VK = 0;
+    char utf8[5] = {};
+  };
+
+  /** Send the whole frame to the new clients and apply the input of all of them. Called by the UI before it draws */
+  void ProcessInput();
+
+  void ApplyInput(const InputEvent& event);
+
+  void SendFrameSize(int idx, int width, int height);
+
+  void SendTile(int idx, int tileIdx, int x, int y, int w, int h, const void* pData, int size);
+
+  /** Tiles are coalesced by index, and after a resize the old tiles, which are still drawn before the FRAME message, don't replace the new ones */
+  int64_t TileKey(int tileIdx) const { return (static_cast<int64_t>(mFrameGeneration) << 32) | static_cast<uint32_t>(tileIdx); }
+
+  igraphics::IGraphicsHeadless* mGraphics = nullptr;
+  int mFrameGeneration = 0;
+
+  // pushed from the connection threads
+  IPlugMPSCQueue<InputEvent> mInputFromClients {GRAPHICS_STREAM_INPUT_QUEUE_SIZE};
+  IPlugMPSCQueue<int> mNewClients {64};
+};
+
+END_IPLUG_NAMESPACE
@@ -71,7 +71,7 @@ void IWebsocketEditorDelegate::SendMidiMsgFromUI(const IMidiMsg& msg)
   data.Put(&msg.mData2);
 
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendMidiMsgFromUI(msg);
 }
@@ -84,7 +84,7 @@ void IWebsocketEditorDelegate::SendSysexMsgFromUI(const ISysEx& msg)
   data.PutBytes(&msg.mData, msg.mSize);
   
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendSysexMsgFromUI(msg);
 }
@@ -99,7 +99,7 @@ void IWebsocketEditorDelegate::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, i
   data.PutBytes(pData, dataSize);
   
   // Server side UI edit, send to clients
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendArbitraryMsgFromUI(msgTag, ctrlTag, dataSize, pData);
 }
@@ -127,7 +127,7 @@ void IWebsocketEditorDelegate::SendControlValueFromDelegate(int ctrlTag, double
   data.Put(&ctrlTag);
   data.Put(&normalizedValue);
   
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size(), -1, CoalesceKey(kCoalesceControl, ctrlTag));
   
   IGEditorDelegate::SendControlValueFromDelegate(ctrlTag, normalizedValue);
 }
@@ -141,7 +141,7 @@ void IWebsocketEditorDelegate::SendControlMsgFromDelegate(int ctrlTag, int msgTa
   data.Put(&dataSize);
   data.PutBytes(pData, dataSize);
   
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendControlMsgFromDelegate(ctrlTag, msgTag, dataSize, pData);
 }
@@ -154,7 +154,7 @@ void IWebsocketEditorDelegate::SendArbitraryMsgFromDelegate(int msgTag, int data
   data.Put(&dataSize);
   data.PutBytes(pData, dataSize);
   
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendArbitraryMsgFromDelegate(msgTag, dataSize, pData);
 }
@@ -167,7 +167,7 @@ void IWebsocketEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
   data.Put(&msg.mData1);
   data.Put(&msg.mData2);
 
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendMidiMsgFromDelegate(msg);
 }
@@ -179,7 +179,7 @@ void IWebsocketEditorDelegate::SendSysexMsgFromDelegate(const ISysEx& msg)
   data.Put(&msg.mSize);
   data.PutBytes(msg.mData, msg.mSize);
   
-  SendDataToConnection(-1, data.GetData(), data.Size());
+  QueueDataToConnection(-1, data.GetData(), data.Size());
   
   IGEditorDelegate::SendSysexMsgFromDelegate(msg);
 }
@@ -212,6 +212,8 @@ void IWebsocketEditorDelegate::ProcessWebsocketQueue()
     IGEditorDelegate::SendMidiMsgFromDelegate(msg); // Call the superclass, since we don't want to send another MIDI message to the websocket
     DeferMidiMsg(msg); // can't just call SendMidiMsgFromUI here which would cause a feedback loop
   }
+
+  FlushConnections();
 }
 
 void IWebsocketEditorDelegate::DoSPVFDToClients(int paramIdx, double value, int excludeIdx)
@@ -220,5 +222,5 @@ void IWebsocketEditorDelegate::DoSPVFDToClients(int paramIdx, double value, int
   data.PutStr("SPVFD");
   data.Put(&paramIdx);
   data.Put(&value);
-  SendDataToConnection(-1, data.GetData(), data.Size(), excludeIdx);
+  QueueDataToConnection(-1, data.GetData(), data.Size(), excludeIdx, CoalesceKey(kCoalesceParam, paramIdx));
 }
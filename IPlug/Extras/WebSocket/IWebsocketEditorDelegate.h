@@ -3,7 +3,7 @@
 #include "IGraphicsEditorDelegate.h"
 #include "IWebsocketServer.h"
 #include "IPlugStructs.h"
-#include "IPlugQueue.h"
+#include "IPlugMPSCQueue.h"
 
 /**
  * @file
@@ -12,7 +12,9 @@
 
 BEGIN_IPLUG_NAMESPACE
 
-/** An IEditorDelegate base class that embeds a websocket server ... */
+/** An IEditorDelegate base class that embeds a websocket server ...
+ * Messages to the clients are queued per connection, parameter and control values are coalesced so only the latest one per tick is sent,
+ * and ProcessWebsocketQueue() sends each client's queue as one frame, see IWebsocketServer::QueueDataToConnection() */
 class IWebsocketEditorDelegate : public IGEditorDelegate, public IWebsocketServer
 {
 public:
@@ -42,10 +44,19 @@ public:
   void SendSysexMsgFromDelegate(const ISysEx& msg) override;
 //  void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override;
   
-  // Call this repeatedly in order to handle incoming data
+  // Call this repeatedly, e.g. from OnIdle(), in order to handle incoming data and send the queued messages to the clients
   void ProcessWebsocketQueue();
   
 private:
+  /** The kinds of message that are coalesced, the top half of a coalesce key */
+  enum ECoalesceKind
+  {
+    kCoalesceParam = 1,
+    kCoalesceControl
+  };
+
+  static int64_t CoalesceKey(ECoalesceKind kind, int idx) { return (static_cast<int64_t>(kind) << 32) | static_cast<uint32_t>(idx); }
+
   void DoSPVFDToClients(int paramIdx, double value, int excludeIdx);
   
   struct ParamTupleCX
@@ -61,8 +72,9 @@ private:
     {}
   };
 
-  IPlugQueue<ParamTupleCX> mParamChangeFromClients {PARAM_TRANSFER_SIZE};
-  IPlugQueue<IMidiMsg> mMIDIFromClients {MIDI_TRANSFER_SIZE};
+  // pushed from the connection threads, one per client
+  IPlugMPSCQueue<ParamTupleCX> mParamChangeFromClients {PARAM_TRANSFER_SIZE};
+  IPlugMPSCQueue<IMidiMsg> mMIDIFromClients {MIDI_TRANSFER_SIZE};
 };
 
 END_IPLUG_NAMESPACE
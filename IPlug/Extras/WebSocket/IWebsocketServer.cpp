@@ -19,6 +19,20 @@ IWebsocketServer::IWebsocketServer()
 IWebsocketServer::~IWebsocketServer()
 {
   DestroyServer();
+
+  WDL_PtrList<Connection> connections;
+
+  {
+    WDL_MutexLock lock(&mMutex);
+
+    for (auto i = 0; i < mConnections.GetSize(); i++)
+      connections.Add(mConnections.Get(i));
+
+    mConnections.Empty();
+  }
+
+  for (auto i = 0; i < connections.GetSize(); i++)
+    StopConnection(connections.Get(i));
 }
 
 bool IWebsocketServer::CreateServer(const char* DOCUMENT_ROOT, const char* PORT)
@@ -50,6 +64,12 @@ bool IWebsocketServer::CreateServer(const char* DOCUMENT_ROOT, const char* PORT)
   }
   
   sInstances++;
+
+  if (!mDispatchRunning)
+  {
+    mDispatchRunning = true;
+    mDispatchThread = std::thread(&IWebsocketServer::DispatchThread, this);
+  }
   
   return true;
 }
@@ -60,6 +80,17 @@ void IWebsocketServer::DestroyServer()
   {
     sServer = nullptr;
   }
+
+  if (mDispatchRunning)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mDispatchMutex);
+      mDispatchRunning = false;
+    }
+
+    mDispatchCondition.notify_one();
+    mDispatchThread.join();
+  }
 }
   
 void IWebsocketServer::GetURL(WDL_String& url)
@@ -71,21 +102,38 @@ void IWebsocketServer::GetURL(WDL_String& url)
   }
 }
 
-int IWebsocketServer::NClients()
+bool IWebsocketServer::SendTextToConnection(int idx, const char* str, int exclude)
 {
-  WDL_MutexLock lock(&mMutex);
+  Msg* pMsg = new Msg;
+  pMsg->data.assign(str, str + strlen(str));
+  pMsg->opcode = MG_WEBSOCKET_OPCODE_TEXT;
+  pMsg->batch = false;
+  return PushOutbound(pMsg, idx, exclude);
+}
 
-  return mConnections.GetSize();
+bool IWebsocketServer::SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude)
+{
+  Msg* pMsg = new Msg;
+  pMsg->data.assign(static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + sizeInBytes);
+  pMsg->batch = false;
+  return PushOutbound(pMsg, idx, exclude);
 }
 
-bool IWebsocketServer::SendTextToConnection(int idx, const char* str, int exclude)
+bool IWebsocketServer::QueueDataToConnection(int idx, const void* pData, int sizeInBytes, int exclude, int64_t coalesceKey)
 {
-  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_TEXT, str, strlen(str), exclude);
+  if (NClients() == 0)
+    return true;
+
+  Msg* pMsg = new Msg;
+  pMsg->data.assign(static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + sizeInBytes);
+  pMsg->key = coalesceKey;
+  return PushOutbound(pMsg, idx, exclude);
 }
 
-bool IWebsocketServer::SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude)
+void IWebsocketServer::FlushConnections()
 {
-  return DoSendToConnection(idx, MG_WEBSOCKET_OPCODE_BINARY, (const char*) pData, sizeInBytes, exclude);
+  if (NClients() > 0)
+    PushOutbound(nullptr, -1, -1);
 }
 
 void IWebsocketServer::OnWebsocketReady(int idx)
@@ -102,44 +150,191 @@ bool IWebsocketServer::OnWebsocketData(int idx, void* pData, size_t dataSize)
   return true; // return true to keep the connection open
 }
 
-bool IWebsocketServer::DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude)
+bool IWebsocketServer::PushOutbound(Msg* pMsg, int idx, int exclude)
 {
-  int nclients = NClients();
-  
-  std::function<bool(int)> sendFunc = [&](int connIdx) {
+  if (!mOutbound.Push(Outbound {pMsg, idx, exclude}))
+  {
+    DBGMSG("WS outbound queue is full, dropping a message\n");
+    delete pMsg;
+    return false;
+  }
+
+  mDispatchCondition.notify_one();
+  return true;
+}
+
+// The dispatch thread
+void IWebsocketServer::DispatchThread()
+{
+  // the condition is notified without locking mDispatchMutex, so that the main thread never blocks, and the timeout catches a notification that is missed
+  static constexpr auto kMaxWait = std::chrono::milliseconds(10);
+
+  while (mDispatchRunning)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mDispatchMutex);
+      mDispatchCondition.wait_for(lock, kMaxWait, [this]() { return !mOutbound.WasEmpty() || !mDispatchRunning; });
+    }
+
     WDL_MutexLock lock(&mMutex);
-    mg_connection* pConn = mConnections.Get(connIdx);
-    
-    if(pConn) {
-      if(mg_websocket_write(pConn, opcode, pData, sizeInBytes))
-        return true;
+    Outbound outbound;
+
+    while (mOutbound.Pop(outbound))
+    {
+      if (!outbound.pMsg)
+      {
+        for (auto i = 0; i < mConnections.GetSize(); i++)
+        {
+          Connection* pConnection = mConnections.Get(i);
+          std::lock_guard<std::mutex> connectionLock(pConnection->mutex);
+
+          if (!pConnection->pending.empty())
+          {
+            pConnection->flush = true;
+            pConnection->condition.notify_one();
+          }
+        }
+
+        continue;
+      }
+
+      std::shared_ptr<const Msg> msg(outbound.pMsg);
+
+      for (auto i = 0; i < mConnections.GetSize(); i++)
+      {
+        Connection* pConnection = mConnections.Get(i);
+
+        if ((outbound.idx == -1 || pConnection->id == outbound.idx) && pConnection->id != outbound.exclude) // TODO: sending to self?
+          QueueMsg(*pConnection, msg);
+      }
     }
-    
-    return false;
+  }
+
+  Outbound outbound;
+
+  while (mOutbound.Pop(outbound))
+    delete outbound.pMsg;
+}
+
+void IWebsocketServer::QueueMsg(Connection& connection, const std::shared_ptr<const Msg>& msg)
+{
+  std::lock_guard<std::mutex> lock(connection.mutex);
+
+  if (msg->key != -1)
+  {
+    auto it = connection.pendingKeys.find(msg->key);
+
+    if (it != connection.pendingKeys.end())
+    {
+      std::shared_ptr<const Msg>& pendingMsg = connection.pending[it->second];
+      connection.pendingBytes += msg->data.size() - pendingMsg->data.size();
+      pendingMsg = msg;
+      return;
+    }
+
+    connection.pendingKeys[msg->key] = connection.pending.size();
+  }
+  else if (connection.pendingBytes + msg->data.size() > WEBSOCKET_MAX_PENDING_BYTES)
+  {
+    DBGMSG("WS client isn't keeping up, dropping a message\n");
+    return;
+  }
+
+  connection.pending.push_back(msg);
+  connection.pendingBytes += msg->data.size();
+
+  if (!msg->batch)
+  {
+    connection.flush = true;
+    connection.condition.notify_one();
+  }
+}
+
+// The connection threads
+void IWebsocketServer::SenderThread(Connection* pConnection)
+{
+  Connection& connection = *pConnection;
+  std::vector<std::shared_ptr<const Msg>> msgs;
+  IByteChunk frame;
+  int nBatched = 0;
+  int countPos = 0;
+
+  // BATCH, int nMsgs, then int size and the bytes of each message
+  auto writeBatch = [&]() {
+    if (nBatched)
+    {
+      memcpy(frame.GetData() + countPos, &nBatched, sizeof(int));
+      // blocks while the client's socket buffer is full, and meanwhile its messages are coalesced
+      mg_websocket_write(connection.pConn, MG_WEBSOCKET_OPCODE_BINARY, (const char*) frame.GetData(), frame.Size());
+    }
+
+    frame.Clear();
+    nBatched = 0;
   };
-  
-  bool success = false;
-  
-  if(idx == -1)
+
+  std::unique_lock<std::mutex> lock(connection.mutex);
+
+  while (true)
   {
-    for(int i=0;i<nclients;i++) // TODO: sending to self?
+    connection.condition.wait(lock, [&connection]() { return !connection.running || (connection.flush && !connection.pending.empty()); });
+
+    if (!connection.running)
+      break;
+
+    msgs.swap(connection.pending);
+    connection.pendingKeys.clear();
+    connection.pendingBytes = 0;
+    connection.flush = false;
+    lock.unlock();
+
+    for (auto& msg : msgs)
     {
-      if(i != exclude)
-        success &= sendFunc(i);
+      if (msg->batch)
+      {
+        if (!nBatched)
+        {
+          frame.PutStr("BATCH");
+          countPos = frame.Size();
+          frame.Put(&nBatched);
+        }
+
+        int size = static_cast<int>(msg->data.size());
+        frame.Put(&size);
+        frame.PutBytes(msg->data.data(), size);
+        nBatched++;
+      }
+      else
+      {
+        writeBatch(); // keep the order
+        mg_websocket_write(connection.pConn, msg->opcode, (const char*) msg->data.data(), msg->data.size());
+      }
     }
+
+    writeBatch();
+    msgs.clear(); // releases the messages no other connection is still sending
+    lock.lock();
   }
-  else {
-    sendFunc(idx);
+}
+
+void IWebsocketServer::StopConnection(Connection* pConnection)
+{
+  {
+    std::lock_guard<std::mutex> lock(pConnection->mutex);
+    pConnection->running = false;
   }
-  
-  return success;
+
+  pConnection->condition.notify_one();
+
+  if (pConnection->thread.joinable())
+    pConnection->thread.join();
+
+  delete pConnection;
 }
 
 // CivetWebSocketHandler
-// These methods are called on the server thread
+// These methods are called on the server's connection threads
 bool IWebsocketServer::handleConnection(CivetServer* pServer, const struct mg_connection* pConn)
 {
-  WDL_MutexLock lock(&mMutex);
   DBGMSG("WS connected\n");
 
   return true;
@@ -147,38 +342,60 @@ bool IWebsocketServer::handleConnection(CivetServer* pServer, const struct mg_co
 
 void IWebsocketServer::handleReadyState(CivetServer* pServer, struct mg_connection* pConn)
 {
-  WDL_MutexLock lock(&mMutex);
-  
-  mConnections.Add(pConn);
-  
+  Connection* pConnection = new Connection;
+  pConnection->pConn = pConn;
+
+  {
+    WDL_MutexLock lock(&mMutex);
+    pConnection->id = mNextConnectionID++;
+    pConnection->thread = std::thread(&IWebsocketServer::SenderThread, this, pConnection);
+    mConnections.Add(pConnection);
+    mNClients = mConnections.GetSize();
+  }
+
+  mg_set_user_connection_data(pConn, pConnection);
+
   DBGMSG("WS ready NClients %i\n", NClients());
   
-  OnWebsocketReady(NClients()-1); // should defer to main thread
+  OnWebsocketReady(pConnection->id);
 }
 
 bool IWebsocketServer::handleData(CivetServer* pServer, struct mg_connection* pConn, int bits, char* pData, size_t dataSize)
 {
-  WDL_MutexLock lock(&mMutex);
+  Connection* pConnection = static_cast<Connection*>(mg_get_user_connection_data(pConn));
 
-  uint8_t* firstByte = (uint8_t*) &bits;
-  
-  if(*firstByte == 129) // TODO: check that
-  {
-    return OnWebsocketText(mConnections.Find(pConn), pData, dataSize);
-  }
-  else if(*firstByte == 130) // TODO: check that
+  if (!pConnection)
+    return true;
+
+  switch (bits & 0xf) // the opcode, without the FIN and RSV bits, of which RSV1 is set by permessage-deflate
   {
-    return OnWebsocketData(mConnections.Find(pConn), (void*) pData, dataSize);
+    case MG_WEBSOCKET_OPCODE_TEXT:
+      return OnWebsocketText(pConnection->id, pData, dataSize);
+    case MG_WEBSOCKET_OPCODE_BINARY:
+      return OnWebsocketData(pConnection->id, (void*) pData, dataSize);
+    default:
+      return true;
   }
-  
-  return true;
 }
 
 void IWebsocketServer::handleClose(CivetServer* pServer, const struct mg_connection* pConn)
 {
-  WDL_MutexLock lock(&mMutex);
+  Connection* pConnection = static_cast<Connection*>(mg_get_user_connection_data(pConn));
+
+  if (!pConnection)
+    return;
+
+  {
+    WDL_MutexLock lock(&mMutex);
+
+    if (mConnections.Find(pConnection) < 0) // already stopped by the destructor
+      return;
+
+    mConnections.DeletePtr(pConnection);
+    mNClients = mConnections.GetSize();
+  }
 
-  mConnections.DeletePtr(pConn);
+  StopConnection(pConnection); // a write in progress returns when the socket closes, or after civetweb's request_timeout_ms
   
   DBGMSG("WS closed NClients %i\n", NClients());
 }
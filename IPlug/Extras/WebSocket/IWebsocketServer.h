@@ -9,12 +9,21 @@
 */
 
 #include "CivetServer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "ptrlist.h"
 #include "IPlugLogger.h"
 #include "IPlugPlatform.h"
+#include "IPlugStructs.h"
+#include "IPlugMPSCQueue.h"
 
 #ifdef OS_WIN
 #include <windows.h>
@@ -22,8 +31,23 @@
 #include <unistd.h>
 #endif
 
+#define WEBSOCKET_MAX_PENDING_BYTES 1048576 // the most a connection can have queued, beyond which messages that aren't coalesced are dropped
+#define WEBSOCKET_OUTBOUND_QUEUE_SIZE 4096 // the number of messages the main thread can queue between two runs of the dispatch thread
+
 BEGIN_IPLUG_NAMESPACE
 
+/** A websocket server, shared by the instances in one binary.
+ *
+ * All the networking happens on the server's own threads, the main thread only serializes messages and pushes them to a lock-free queue:
+ * - civetweb's connection threads call handleData() etc, and so OnWebsocketReady(), OnWebsocketText() and OnWebsocketData(), which should push what they receive
+ *   to a lock-free queue for the main thread, as IWebsocketEditorDelegate does
+ * - the dispatch thread pops the outbound messages and adds them to the queues of the connections they are for. A message is serialized once,
+ *   and shared by reference by all the connections it is sent to
+ * - each connection has a thread that writes its frames, so at most one frame per client is in flight: while a slow client's write is blocked,
+ *   its messages keep being queued, and the ones with the same coalesce key replace each other, so it gets the latest values in fewer, larger frames
+ *
+ * The connection list is only used by the networking threads. Connections are identified by an ID that is unique for the lifetime of the server, not by their position.
+ * If civetweb is built with zlib (see build-civetweb-mac.sh) permessage-deflate is negotiated with the clients that support it */
 class IWebsocketServer : public CivetWebSocketHandler
 {
 public:
@@ -39,20 +63,80 @@ public:
   
   void GetURL(WDL_String& url);
 
-  int NClients();
+  /** @return The number of connected clients. This is lock-free */
+  int NClients() const { return mNClients.load(std::memory_order_relaxed); }
   
+  /** Send a text message on its own, as soon as the connection's thread is free
+   * @return \c false if the outbound queue is full */
   bool SendTextToConnection(int idx, const char* str, int exclude = -1);
   
+  /** Send a binary message on its own, as soon as the connection's thread is free
+   * @return \c false if the outbound queue is full */
   bool SendDataToConnection(int idx, void* pData, size_t sizeInBytes, int exclude = -1);
+
+  /** Queue a binary message, to be sent in the next batch. This is lock-free and can be called on any thread, normally the main thread
+   * @param idx The connection ID, or -1 for all connections
+   * @param exclude A connection ID not to send to, or -1
+   * @param coalesceKey A message queued with the same key replaces this one if it hasn't been sent yet, or -1 to always send it
+   * @return \c false if the outbound queue is full */
+  bool QueueDataToConnection(int idx, const void* pData, int sizeInBytes, int exclude = -1, int64_t coalesceKey = -1);
+
+  /** Send the queued messages of each connection that isn't still writing its last batch. Call this once per tick, e.g. from OnIdle() */
+  void FlushConnections();
   
+  /** Called on a connection thread when a client has connected */
   virtual void OnWebsocketReady(int idx);
   
+  /** Called on a connection thread for each text message
+   * @return \c true to keep the connection open */
   virtual bool OnWebsocketText(int idx, const char* str, size_t dataSize);
   
+  /** Called on a connection thread for each binary message
+   * @return \c true to keep the connection open */
   virtual bool OnWebsocketData(int idx, void* pData, size_t dataSize);
   
 private:
-  bool DoSendToConnection(int idx, int opcode, const char* pData, size_t sizeInBytes, int exclude);
+  /** A serialized message, shared by the connections it is sent to */
+  struct Msg
+  {
+    std::vector<uint8_t> data;
+    int opcode = MG_WEBSOCKET_OPCODE_BINARY;
+    int64_t key = -1;
+    bool batch = true; // sent in a BATCH frame, rather than on its own
+  };
+
+  /** An element of the outbound queue. The message is allocated by the sender and owned by the dispatch thread once popped */
+  struct Outbound
+  {
+    Msg* pMsg = nullptr; // nullptr to flush
+    int idx = -1;
+    int exclude = -1;
+  };
+
+  /** A client, with the messages queued for it and the thread that sends them */
+  struct Connection
+  {
+    mg_connection* pConn = nullptr;
+    int id = 0;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::shared_ptr<const Msg>> pending;
+    std::unordered_map<int64_t, size_t> pendingKeys; // coalesce key -> index in pending
+    size_t pendingBytes = 0;
+    bool flush = false;
+    bool running = true;
+  };
+
+  bool PushOutbound(Msg* pMsg, int idx, int exclude);
+
+  void DispatchThread();
+
+  void QueueMsg(Connection& connection, const std::shared_ptr<const Msg>& msg);
+
+  void SenderThread(Connection* pConnection);
+
+  void StopConnection(Connection* pConnection);
   
   // CivetWebSocketHandler
   bool handleConnection(CivetServer* pServer, const struct mg_connection* pConn) override;
@@ -63,7 +147,17 @@ private:
   
   void handleClose(CivetServer* pServer, const struct mg_connection* pConn) override;
   
-  WDL_PtrList<mg_connection> mConnections;
+  WDL_PtrList<Connection> mConnections; // guarded by mMutex, used by the networking threads only
+  std::atomic<int> mNClients {0};
+  int mNextConnectionID = 0;
+
+  // the outbound queue, from the main thread to the dispatch thread
+  IPlugMPSCQueue<Outbound> mOutbound {WEBSOCKET_OUTBOUND_QUEUE_SIZE};
+  std::thread mDispatchThread;
+  std::mutex mDispatchMutex;
+  std::condition_variable mDispatchCondition;
+  std::atomic<bool> mDispatchRunning {false};
+
   static std::unique_ptr<CivetServer> sServer;
   static int sInstances;
 
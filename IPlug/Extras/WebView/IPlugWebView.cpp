@@ -13,8 +13,11 @@ See LICENSE.txt for  more info.
 #include <string>
 #include <windows.h>
 #include <shlobj.h>
+#include <shlwapi.h>
 #include <cassert>
 
+#pragma comment(lib, "shlwapi.lib")
+
 using namespace iplug;
 using namespace Microsoft::WRL;
 
@@ -25,6 +28,7 @@ IWebView::IWebView(bool opaque)
 IWebView::~IWebView()
 {
   CloseWebView();
+  SetPoolKey(nullptr);
 }
 
 typedef HRESULT(*TCCWebView2EnvWithOptions)(
@@ -42,18 +46,43 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
   w *= scale;
   h *= scale;
 
+  if (TakeFromPool(pParent))
+  {
+    mWebViewCtrlr->put_Bounds({ (LONG)x, (LONG)y, (LONG)(x + w), (LONG)(y + h) });
+    OnWebViewReady();
+
+    if (mPageLoaded)
+      OnWebContentLoaded();
+
+    return nullptr;
+  }
+
   WDL_String cachePath;
   WebViewCachePath(cachePath);
   WCHAR cachePathWide[IPLUG_WIN_MAX_WIDE_PATH];
   UTF8ToUTF16(cachePathWide, cachePath.Get(), IPLUG_WIN_MAX_WIDE_PATH);
 
+  std::weak_ptr<bool> alive = mAlive; // the web view is created asynchronously, and this may be destroyed first, e.g. when the pool is cleared while preheating
+
   CreateCoreWebView2EnvironmentWithOptions(
     nullptr, cachePathWide, nullptr,
   Callback<ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler>(
-    [&, hWnd, x, y, w, h](HRESULT result, ICoreWebView2Environment* env) -> HRESULT {
+    [&, alive, hWnd, x, y, w, h](HRESULT result, ICoreWebView2Environment* env) -> HRESULT {
+      if (alive.expired())
+        return S_OK;
+
+      mWebViewEnv = env;
       env->CreateCoreWebView2Controller(hWnd,
         Callback<ICoreWebView2CreateCoreWebView2ControllerCompletedHandler>(
-          [&, hWnd, x, y, w, h](HRESULT result, ICoreWebView2Controller* controller) -> HRESULT {
+          [&, alive, hWnd, x, y, w, h](HRESULT result, ICoreWebView2Controller* controller) -> HRESULT {
+            if (alive.expired())
+            {
+              if (controller != nullptr)
+                controller->Close();
+
+              return S_OK;
+            }
+
             if (controller != nullptr) {
               mWebViewCtrlr = controller;
               mWebViewCtrlr->get_CoreWebView2(&mWebViewWnd);
@@ -72,30 +101,17 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
                   return S_OK;
                 }).Get());
 
-            mWebViewWnd->add_WebMessageReceived(
-              Callback<ICoreWebView2WebMessageReceivedEventHandler>(
-                [this](ICoreWebView2* sender, ICoreWebView2WebMessageReceivedEventArgs* args) {
-                  wil::unique_cotaskmem_string jsonString;
-                  args->get_WebMessageAsJson(&jsonString);
-                  std::wstring jsonWString = jsonString.get();
-                  WDL_String cStr;
-                  UTF16ToUTF8(cStr, jsonWString.c_str());
-                  OnMessageFromWebView(cStr.Get());
-                  return S_OK;
-                }).Get(), &mWebMessageReceivedToken);
-
-            mWebViewWnd->add_NavigationCompleted(
-              Callback<ICoreWebView2NavigationCompletedEventHandler>(
-                [this](ICoreWebView2* sender, ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
-                  BOOL success;
-                  args->get_IsSuccess(&success);
-                  if (success)
-                  {
-                    OnWebContentLoaded();
-                  }
-                  return S_OK;
-                })
-              .Get(), &mNavigationCompletedToken);
+            if (IsBinaryChannelEnabled())
+            {
+              WDL_String channelScript;
+              GetBinaryChannelScript(channelScript, "https://iplug.binary/frame");
+              std::vector<WCHAR> channelScriptWide(channelScript.GetLength() + 1);
+              UTF8ToUTF16(channelScriptWide.data(), channelScript.Get(), static_cast<int>(channelScriptWide.size()));
+              mWebViewWnd->AddScriptToExecuteOnDocumentCreated(channelScriptWide.data(), nullptr);
+              mWebViewWnd->AddWebResourceRequestedFilter(L"https://iplug.binary/*", COREWEBVIEW2_WEB_RESOURCE_CONTEXT_ALL);
+            }
+
+            AddEventHandlers();
 
             mWebViewCtrlr->put_Bounds({ (LONG)x, (LONG)y, (LONG)(x + w), (LONG)(y + h) });
             OnWebViewReady();
@@ -107,8 +123,104 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
   return nullptr;
 }
 
+void IWebView::AddEventHandlers()
+{
+  if (IsBinaryChannelEnabled())
+  {
+    // serves the frames of the binary channel, see IWebView::EnableBinaryChannel()
+    mWebViewWnd->add_WebResourceRequested(
+      Callback<ICoreWebView2WebResourceRequestedEventHandler>(
+        [this](ICoreWebView2* sender, ICoreWebView2WebResourceRequestedEventArgs* args) -> HRESULT {
+          std::vector<uint8_t> data;
+          GetBinaryFrame(data);
+          wil::com_ptr<IStream> stream;
+          stream.attach(SHCreateMemStream(data.data(), static_cast<UINT>(data.size())));
+          wil::com_ptr<ICoreWebView2WebResourceResponse> response;
+          mWebViewEnv->CreateWebResourceResponse(stream.get(), 200, L"OK",
+            L"Content-Type: application/octet-stream\r\nAccess-Control-Allow-Origin: *\r\nCache-Control: no-store", &response);
+          args->put_Response(response.get());
+          return S_OK;
+        }).Get(), &mWebResourceRequestedToken);
+  }
+
+  mWebViewWnd->add_WebMessageReceived(
+    Callback<ICoreWebView2WebMessageReceivedEventHandler>(
+      [this](ICoreWebView2* sender, ICoreWebView2WebMessageReceivedEventArgs* args) {
+        wil::unique_cotaskmem_string jsonString;
+        args->get_WebMessageAsJson(&jsonString);
+        std::wstring jsonWString = jsonString.get();
+        WDL_String cStr;
+        UTF16ToUTF8(cStr, jsonWString.c_str());
+        OnMessageFromWebView(cStr.Get());
+        return S_OK;
+      }).Get(), &mWebMessageReceivedToken);
+
+  mWebViewWnd->add_NavigationCompleted(
+    Callback<ICoreWebView2NavigationCompletedEventHandler>(
+      [this](ICoreWebView2* sender, ICoreWebView2NavigationCompletedEventArgs* args) -> HRESULT {
+        BOOL success;
+        args->get_IsSuccess(&success);
+        if (success)
+        {
+          WebContentLoaded();
+        }
+        return S_OK;
+      })
+    .Get(), &mNavigationCompletedToken);
+}
+
+void IWebView::RemoveEventHandlers()
+{
+  if (IsBinaryChannelEnabled())
+    mWebViewWnd->remove_WebResourceRequested(mWebResourceRequestedToken);
+
+  mWebViewWnd->remove_WebMessageReceived(mWebMessageReceivedToken);
+  mWebViewWnd->remove_NavigationCompleted(mNavigationCompletedToken);
+}
+
+bool IWebView::HasWebView() const
+{
+  return mWebViewWnd.get() != nullptr;
+}
+
+void IWebView::TakeWebView(IWebView& other, void* pParent)
+{
+  other.RemoveEventHandlers();
+
+  mWebViewEnv = std::move(other.mWebViewEnv);
+  mWebViewCtrlr = std::move(other.mWebViewCtrlr);
+  mWebViewWnd = std::move(other.mWebViewWnd);
+
+  mWebViewCtrlr->put_ParentWindow((HWND) pParent);
+  mWebViewCtrlr->put_IsVisible(pParent != GetPoolParentWindow());
+
+  AddEventHandlers();
+}
+
+static HWND sPoolParentWindow = nullptr;
+
+void* IWebView::GetPoolParentWindow()
+{
+  if (!sPoolParentWindow)
+    sPoolParentWindow = CreateWindowExW(WS_EX_TOOLWINDOW, L"STATIC", L"", WS_POPUP, 0, 0, 0, 0, nullptr, nullptr, nullptr, nullptr); // never shown
+
+  return sPoolParentWindow;
+}
+
+void IWebView::DestroyPoolParentWindow()
+{
+  if (sPoolParentWindow)
+  {
+    DestroyWindow(sPoolParentWindow);
+    sPoolParentWindow = nullptr;
+  }
+}
+
 void IWebView::CloseWebView()
 {
+  if (ReturnToPool())
+    return;
+
   if (mWebViewCtrlr.get() != nullptr)
   {
     mWebViewCtrlr->Close();
@@ -116,6 +228,8 @@ void IWebView::CloseWebView()
     mWebViewWnd = nullptr;
   }
 
+  mWebViewEnv = nullptr;
+
   if (mDLLHandle)
   {
     FreeLibrary(mDLLHandle);
@@ -125,7 +239,7 @@ void IWebView::CloseWebView()
 
 void IWebView::LoadHTML(const char* html)
 {
-  if (mWebViewWnd)
+  if (mWebViewWnd && BeginLoad(std::string("html:") + html))
   {
     WCHAR htmlWide[IPLUG_WIN_MAX_WIDE_PATH]; // TODO: error check/size
     UTF8ToUTF16(htmlWide, html, IPLUG_WIN_MAX_WIDE_PATH); // TODO: error check/size
@@ -136,7 +250,7 @@ void IWebView::LoadHTML(const char* html)
 void IWebView::LoadURL(const char* url)
 {
   //TODO: error check url?
-  if (mWebViewWnd)
+  if (mWebViewWnd && BeginLoad(std::string("url:") + url))
   {
     WCHAR urlWide[IPLUG_WIN_MAX_WIDE_PATH]; // TODO: error check/size
     UTF8ToUTF16(urlWide, url, IPLUG_WIN_MAX_WIDE_PATH); // TODO: error check/size
@@ -146,7 +260,7 @@ void IWebView::LoadURL(const char* url)
 
 void IWebView::LoadFile(const char* fileName, const char* bundleID)
 {
-  if (mWebViewWnd)
+  if (mWebViewWnd && BeginLoad(std::string("file:") + (bundleID ? bundleID : "") + "/" + fileName))
   {
     WDL_String fullStr;
     fullStr.SetFormatted(MAX_WIN32_PATH_LEN, "file://%s", fileName);
@@ -12,7 +12,12 @@
 
 #include "IPlugPlatform.h"
 #include "wdlstring.h"
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #if defined OS_MAC
   #define PLATFORM_VIEW NSView
@@ -32,6 +37,8 @@ BEGIN_IPLUG_NAMESPACE
 
 using completionHandlerFunc = std::function<void(const char* result)>;
 
+class IWebViewPool;
+
 /** IWebView is a base interface for hosting a platform web view inside an IPlug plug-in's UI */
 class IWebView
 {
@@ -72,20 +79,327 @@ public:
   
   /** When a script in the web view posts a message, it will arrive as a UTF8 json string here */
   virtual void OnMessageFromWebView(const char* json) {}
-  
+
+  /** Enable the binary channel from the plug-in to the page, which is faster than EvaluateJavaScript() for frequent or large data such as scopes.
+   * The page is told that data is waiting by IPlugBinaryFramePending(), and fetches it as an ArrayBuffer at its next animation frame, from a URL
+   * served by a WKURLSchemeHandler on macOS and iOS, or a WebResourceRequested handler on Windows. Call this before OpenWebView() */
+  void EnableBinaryChannel(bool enable) { mEnableBinaryChannel = enable; }
+
+  bool IsBinaryChannelEnabled() const { return mEnableBinaryChannel; }
+
+  /** Called on the main thread when the page fetches a frame from the binary channel, to fill it with the data queued since the last frame */
+  virtual void GetBinaryFrame(std::vector<uint8_t>& data) {}
+
+  /** Keep the platform web view in the IWebViewPool when it is closed, with its page loaded, so that the next IWebView that opens with the same key and options
+   * reuses it. OpenWebView() then calls OnWebViewReady() and, if the page has loaded, OnWebContentLoaded() straight away, and the first LoadHTML(), LoadURL()
+   * or LoadFile() is skipped if it would load the page that is already loaded, so the page is re-bound to this IWebView without reloading it.
+   * Call this before OpenWebView(), e.g. in the plug-in's constructor
+   * @param key Identifies the content of the web view, e.g. the plug-in's bundle ID, or nullptr or an empty string to destroy the web view when it is closed */
+  void SetPoolKey(const char* key);
+
+  /** @return \c true if OpenWebView() reused a web view from the IWebViewPool, until the first LoadHTML(), LoadURL() or LoadFile() */
+  bool IsReusedWebView() const { return mReused; }
+
+  /** Called by the platform web view when a page has loaded, calls OnWebContentLoaded() */
+  void WebContentLoaded()
+  {
+    mPageLoaded = true;
+    OnWebContentLoaded();
+  }
+
+protected:
+  /** Get the script that is injected into the page when the binary channel is enabled. It fetches a frame after IPlugBinaryFramePending() is called,
+   * and calls SPVFD(), SCVFD(), SCMFD(), SAMFD() and SMMFD() for the messages in it, which are each an int size, an int type (see EWebViewBinaryMsg) and the arguments.
+   * The data of SCMFD() and SAMFD() is a Uint8Array
+   * @param url The URL of the frames */
+  static void GetBinaryChannelScript(WDL_String& script, const char* url)
+  {
+    script.SetFormatted(128, "var IPlugBinaryChannel = { url: '%s', pending: false, busy: false };", url);
+    script.Append(
+      "IPlugBinaryChannel.onPending = function() {"
+      "  if (!this.pending) { this.pending = true; requestAnimationFrame(this.fetchFrame.bind(this)); }"
+      "};"
+      "IPlugBinaryChannel.fetchFrame = function() {"
+      "  if (this.busy) { requestAnimationFrame(this.fetchFrame.bind(this)); return; }"
+      "  this.pending = false; this.busy = true;"
+      "  var self = this;"
+      "  fetch(this.url, { cache: 'no-store' }).then(function(r) { return r.arrayBuffer(); })"
+      "    .then(function(buf) { self.busy = false; self.decode(buf); }, function() { self.busy = false; });"
+      "};"
+      "IPlugBinaryChannel.decode = function(buf) {"
+      "  var dv = new DataView(buf); var pos = 0;"
+      "  while (pos + 8 <= buf.byteLength) {"
+      "    var size = dv.getInt32(pos, true); var type = dv.getInt32(pos + 4, true); var p = pos + 8; var n;"
+      "    if (size < 8 || pos + size > buf.byteLength) break;"
+      "    switch (type) {"
+      "      case 0: SPVFD(dv.getInt32(p, true), dv.getFloat64(p + 4, true)); break;"
+      "      case 1: SCVFD(dv.getInt32(p, true), dv.getFloat64(p + 4, true)); break;"
+      "      case 2: n = dv.getInt32(p + 8, true); SCMFD(dv.getInt32(p, true), dv.getInt32(p + 4, true), n, new Uint8Array(buf, p + 12, n)); break;"
+      "      case 3: n = dv.getInt32(p + 4, true); SAMFD(dv.getInt32(p, true), n, new Uint8Array(buf, p + 8, n)); break;"
+      "      case 4: SMMFD(dv.getUint8(p), dv.getUint8(p + 1), dv.getUint8(p + 2)); break;"
+      "    }"
+      "    pos += size;"
+      "  }"
+      "};"
+      "function IPlugBinaryFramePending() { IPlugBinaryChannel.onPending(); }");
+  }
+
 private:
+  friend class IWebViewPool;
+
+  /** @return \c true if there is a platform web view */
+  bool HasWebView() const;
+
+  /** Move the platform web view of another IWebView to this one, which receives its callbacks from now on
+   * @param pParent The window the web view is moved to: on Windows its parent, which is the pool's hidden window while it is in the pool. On macOS and iOS the web view is removed from its superview, and added to the new one by the caller of OpenWebView() */
+  void TakeWebView(IWebView& other, void* pParent);
+
+  /** Move the platform web view to the pool, if this IWebView has a pool key and the pool has room for it
+   * @return \c true if it was moved, otherwise CloseWebView() destroys it */
+  bool ReturnToPool();
+
+  /** Take a web view with the same pool key and options from the pool, if there is one
+   * @return \c true if it was taken, otherwise OpenWebView() creates one */
+  bool TakeFromPool(void* pParent);
+
+  /** Called by LoadHTML(), LoadURL() and LoadFile() with a string that identifies the page
+   * @return \c false if the page is already loaded in a reused web view, and shouldn't be loaded again */
+  bool BeginLoad(const std::string& location)
+  {
+    const bool skip = mReused && mLocation == location;
+    mReused = false;
+
+    if (!skip)
+    {
+      mLocation = location;
+      mPageLoaded = false;
+    }
+
+    return !skip;
+  }
+
+  std::string GetPoolEntryKey() const;
+
+  /** @return The window that is the parent of the web views in the pool on Windows, which is created if it doesn't exist, or nullptr on macOS and iOS */
+  static void* GetPoolParentWindow();
+  static void DestroyPoolParentWindow();
+
   bool mOpaque = true;
+  bool mEnableBinaryChannel = false;
+  std::string mPoolKey; // not empty while this holds a reference to the pool
+  std::string mLocation; // the page that was last loaded
+  bool mPageLoaded = false;
+  bool mReused = false;
 #if defined OS_MAC || defined OS_IOS
   void* mWKWebView = nullptr;
   void* mWebConfig = nullptr;
   void* mScriptHandler = nullptr;
 #elif defined OS_WIN
+  wil::com_ptr<ICoreWebView2Environment> mWebViewEnv;
   wil::com_ptr<ICoreWebView2Controller> mWebViewCtrlr;
   wil::com_ptr<ICoreWebView2> mWebViewWnd;
   EventRegistrationToken mWebMessageReceivedToken;
+  EventRegistrationToken mWebResourceRequestedToken;
   EventRegistrationToken mNavigationCompletedToken;
   HMODULE mDLLHandle = nullptr;
+  std::shared_ptr<bool> mAlive = std::make_shared<bool>(true);
+
+  /** Add the event handlers of the web view, which call this IWebView */
+  void AddEventHandlers();
+  void RemoveEventHandlers();
 #endif
 };
 
+/** A process-wide pool of platform web views. When an IWebView that has a pool key is closed, its web view is kept here with its page loaded, instead of being destroyed,
+ * and the next IWebView that opens with the same key and options reuses it, which saves the hundreds of milliseconds that it takes to create a web view and load a page.
+ * A web view can also be preheated, so that even the first editor to open finds its page loaded. The web views are kept while any IWebViewPool::Ref exists,
+ * see IWebView::SetPoolKey(). The pool is a function-local static, so it is shared by the instances in one plug-in binary. Use it on the main thread
+ * @ingroup IPlugExtras */
+class IWebViewPool
+{
+public:
+  /** Keeps the web views in the pool alive while it exists. Each IWebView that has a pool key holds one, and a plug-in whose web views only exist while its editor is open,
+   * e.g. with IWebViewControl, should hold one as a member, so that the pool isn't emptied when the editor closes */
+  class Ref
+  {
+  public:
+    Ref() { IWebViewPool::Get().mNRefs++; }
+
+    ~Ref()
+    {
+      IWebViewPool& pool = IWebViewPool::Get();
+
+      if (--pool.mNRefs == 0)
+        pool.Clear();
+    }
+
+    Ref(const Ref&) = delete;
+    Ref& operator=(const Ref&) = delete;
+  };
+
+  /** @return The process-wide pool */
+  static IWebViewPool& Get()
+  {
+    static IWebViewPool sPool;
+    return sPool;
+  }
+
+  IWebViewPool(const IWebViewPool&) = delete;
+  IWebViewPool& operator=(const IWebViewPool&) = delete;
+
+  /** Create a web view and load a file into it, see IWebView::LoadFile(), if there isn't a web view with the same key and options in the pool already.
+   * Call this after a Ref has been created, e.g. in the plug-in's constructor after IWebView::SetPoolKey()
+   * @param key The pool key of the IWebViews that will reuse it
+   * @param opaque, enableBinaryChannel The options of the IWebViews that will reuse it, which must be the same */
+  void Preheat(const char* key, const char* fileName, const char* bundleID = "", bool opaque = true, bool enableBinaryChannel = false)
+  {
+    const std::string entryKey = MakeEntryKey(key, opaque, enableBinaryChannel);
+
+    if (!mNRefs || static_cast<int>(mEntries.size()) >= mMaxSize)
+      return;
+
+    for (auto& entry : mEntries)
+    {
+      if (entry.first == entryKey)
+        return;
+    }
+
+    std::unique_ptr<IWebView> pWebView = std::make_unique<PreheatedWebView>(opaque, fileName, bundleID);
+    pWebView->EnableBinaryChannel(enableBinaryChannel);
+    pWebView->OpenWebView(IWebView::GetPoolParentWindow(), 0.f, 0.f, 100.f, 100.f);
+    mEntries.emplace_back(entryKey, std::move(pWebView));
+  }
+
+  /** Destroy all the web views in the pool */
+  void Clear()
+  {
+    auto entries = std::move(mEntries); // destroying a web view may call back into the pool
+    mEntries.clear();
+    entries.clear();
+    IWebView::DestroyPoolParentWindow();
+  }
+
+  /** Set the number of web views that are kept, 1 by default. Web views that are closed when the pool is full are destroyed */
+  void SetMaxSize(int size)
+  {
+    mMaxSize = size;
+
+    while (static_cast<int>(mEntries.size()) > mMaxSize)
+      mEntries.erase(mEntries.begin());
+  }
+
+  /** @return The number of web views in the pool */
+  int NWebViews() const { return static_cast<int>(mEntries.size()); }
+
+private:
+  friend class IWebView;
+
+  /** A web view that loads a file as soon as it is ready, for Preheat() */
+  class PreheatedWebView : public IWebView
+  {
+  public:
+    PreheatedWebView(bool opaque, const char* fileName, const char* bundleID)
+    : IWebView(opaque)
+    , mFileName(fileName)
+    , mBundleID(bundleID ? bundleID : "")
+    {}
+
+    void OnWebViewReady() override { LoadFile(mFileName.c_str(), mBundleID.c_str()); }
+
+  private:
+    std::string mFileName;
+    std::string mBundleID;
+  };
+
+  IWebViewPool() = default;
+
+  static std::string MakeEntryKey(const char* key, bool opaque, bool enableBinaryChannel)
+  {
+    std::string entryKey(key);
+    entryKey += opaque ? "|opaque" : "|transparent";
+    entryKey += enableBinaryChannel ? "|binary" : "";
+    return entryKey;
+  }
+
+  bool CanAdd() const { return mNRefs > 0 && static_cast<int>(mEntries.size()) < mMaxSize; }
+
+  void Add(const std::string& entryKey, std::unique_ptr<IWebView> pWebView)
+  {
+    mEntries.emplace_back(entryKey, std::move(pWebView));
+  }
+
+  /** @return A web view with the key, or nullptr if there is none, or it is still being created */
+  std::unique_ptr<IWebView> Take(const std::string& entryKey)
+  {
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+    {
+      if (it->first == entryKey && it->second->HasWebView())
+      {
+        std::unique_ptr<IWebView> pWebView = std::move(it->second);
+        mEntries.erase(it);
+        return pWebView;
+      }
+    }
+
+    return nullptr;
+  }
+
+  std::vector<std::pair<std::string, std::unique_ptr<IWebView>>> mEntries;
+  int mNRefs = 0;
+  int mMaxSize = 1;
+};
+
+inline void IWebView::SetPoolKey(const char* key)
+{
+  IWebViewPool& pool = IWebViewPool::Get();
+  const bool enable = key && *key;
+
+  if (enable && mPoolKey.empty())
+    pool.mNRefs++; // the same as holding a Ref
+  else if (!enable && !mPoolKey.empty() && --pool.mNRefs == 0)
+    pool.Clear();
+
+  mPoolKey = enable ? key : "";
+}
+
+inline std::string IWebView::GetPoolEntryKey() const
+{
+  return IWebViewPool::MakeEntryKey(mPoolKey.c_str(), mOpaque, mEnableBinaryChannel);
+}
+
+inline bool IWebView::ReturnToPool()
+{
+  IWebViewPool& pool = IWebViewPool::Get();
+
+  if (mPoolKey.empty() || !HasWebView() || !pool.CanAdd())
+    return false;
+
+  std::unique_ptr<IWebView> pHolder = std::make_unique<IWebView>(mOpaque);
+  pHolder->mEnableBinaryChannel = mEnableBinaryChannel;
+  pHolder->TakeWebView(*this, GetPoolParentWindow());
+  pHolder->mLocation = std::move(mLocation);
+  pHolder->mPageLoaded = mPageLoaded;
+  mLocation.clear();
+  mPageLoaded = false;
+  pool.Add(GetPoolEntryKey(), std::move(pHolder));
+  return true;
+}
+
+inline bool IWebView::TakeFromPool(void* pParent)
+{
+  if (mPoolKey.empty())
+    return false;
+
+  std::unique_ptr<IWebView> pHolder = IWebViewPool::Get().Take(GetPoolEntryKey());
+
+  if (!pHolder)
+    return false;
+
+  TakeWebView(*pHolder, pParent);
+  mLocation = std::move(pHolder->mLocation);
+  mPageLoaded = pHolder->mPageLoaded;
+  mReused = true;
+  return true;
+}
+
 END_IPLUG_NAMESPACE
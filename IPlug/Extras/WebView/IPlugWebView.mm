@@ -23,7 +23,7 @@ extern bool GetResourcePathFromBundle(const char* fileName, const char* searchEx
 
 using namespace iplug;
 
-@interface ScriptHandler : NSObject <WKScriptMessageHandler, WKNavigationDelegate>
+@interface ScriptHandler : NSObject <WKScriptMessageHandler, WKNavigationDelegate, WKURLSchemeHandler>
 {
   IWebView* mWebView;
 }
@@ -41,6 +41,12 @@ using namespace iplug;
   return self;
 }
 
+// when a pooled web view moves to another IWebView
+-(void) setIWebView:(IWebView*) webView
+{
+  mWebView = webView;
+}
+
 - (void) userContentController:(nonnull WKUserContentController*) userContentController didReceiveScriptMessage:(nonnull WKScriptMessage*) message
 {
   if ([[message name] isEqualToString:@"callback"])
@@ -54,7 +60,24 @@ using namespace iplug;
 
 - (void) webView:(WKWebView*) webView didFinishNavigation:(WKNavigation*) navigation
 {
-  mWebView->OnWebContentLoaded();
+  mWebView->WebContentLoaded();
+}
+
+// serves the frames of the binary channel, see IWebView::EnableBinaryChannel()
+- (void) webView:(WKWebView*) webView startURLSchemeTask:(id<WKURLSchemeTask>) urlSchemeTask API_AVAILABLE(macos(10.13), ios(11.0))
+{
+  std::vector<uint8_t> data;
+  mWebView->GetBinaryFrame(data);
+
+  NSDictionary* headers = @{@"Content-Type" : @"application/octet-stream", @"Access-Control-Allow-Origin" : @"*", @"Cache-Control" : @"no-store"};
+  NSHTTPURLResponse* response = [[NSHTTPURLResponse alloc] initWithURL:urlSchemeTask.request.URL statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers];
+  [urlSchemeTask didReceiveResponse:response];
+  [urlSchemeTask didReceiveData:[NSData dataWithBytes:data.data() length:data.size()]];
+  [urlSchemeTask didFinish];
+}
+
+- (void) webView:(WKWebView*) webView stopURLSchemeTask:(id<WKURLSchemeTask>) urlSchemeTask API_AVAILABLE(macos(10.13), ios(11.0))
+{
 }
 
 @end
@@ -67,11 +90,29 @@ IWebView::IWebView(bool opaque)
 IWebView::~IWebView()
 {
   CloseWebView();
+  SetPoolKey(nullptr);
 }
 
 void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, float scale)
-{  
+{
+  if (TakeFromPool(pParent))
+  {
+    WKWebView* webView = (__bridge WKWebView*) mWKWebView;
+    [webView setFrame: MAKERECT(x, y, w, h)];
+
+    OnWebViewReady();
+
+    if (mPageLoaded)
+      OnWebContentLoaded();
+
+    return (__bridge void*) webView;
+  }
+
+  // all the web views of the plug-in share one web content process, so that the next one opens faster
+  static WKProcessPool* sProcessPool = [[WKProcessPool alloc] init];
+
   WKWebViewConfiguration* webConfig = [[WKWebViewConfiguration alloc] init];
+  webConfig.processPool = sProcessPool;
   WKPreferences* preferences = [[WKPreferences alloc] init];
   
   WKUserContentController* controller = [[WKUserContentController alloc] init];
@@ -90,6 +131,19 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
   WKUserScript* script2 = [[WKUserScript alloc] initWithSource:@"var meta = document.createElement('meta'); meta.name = 'viewport'; meta.content = 'width=device-width, initial-scale=1.0, maximum-scale=1.0, user-scalable=no, shrink-to-fit=YES'; var head = document.getElementsByTagName('head')[0]; head.appendChild(meta);"
                                                  injectionTime:WKUserScriptInjectionTimeAtDocumentEnd forMainFrameOnly:YES];
   [controller addUserScript:script2];
+
+  if (IsBinaryChannelEnabled())
+  {
+    if (@available(macOS 10.13, iOS 11.0, *))
+    {
+      [webConfig setURLSchemeHandler:scriptHandler forURLScheme:@"iplug"];
+
+      WDL_String channelScript;
+      GetBinaryChannelScript(channelScript, "iplug://frame");
+      WKUserScript* script3 = [[WKUserScript alloc] initWithSource:[NSString stringWithUTF8String:channelScript.Get()] injectionTime:WKUserScriptInjectionTimeAtDocumentStart forMainFrameOnly:YES];
+      [controller addUserScript:script3];
+    }
+  }
   
   
   WKWebView* webView = [[WKWebView alloc] initWithFrame: MAKERECT(x, y, w, h) configuration:webConfig];
@@ -122,7 +176,7 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
 //  [parentView setAutoresizesSubviews:YES];
   
   mWebConfig = (__bridge void*) webConfig;
-  mWKWebView = (__bridge void*) webView;
+  mWKWebView = (__bridge_retained void*) webView; // released by CloseWebView(), so that it can outlive its superview in the pool
   mScriptHandler = (__bridge void*) scriptHandler;
   
   OnWebViewReady();
@@ -132,7 +186,10 @@ void* IWebView::OpenWebView(void* pParent, float x, float y, float w, float h, f
 
 void IWebView::CloseWebView()
 {
-  WKWebView* webView = (__bridge WKWebView*) mWKWebView;
+  if (ReturnToPool())
+    return;
+
+  WKWebView* webView = (__bridge_transfer WKWebView*) mWKWebView;
   [webView removeFromSuperview];
   
   mWebConfig = nullptr;
@@ -140,14 +197,49 @@ void IWebView::CloseWebView()
   mScriptHandler = nullptr;
 }
 
+bool IWebView::HasWebView() const
+{
+  return mWKWebView != nullptr;
+}
+
+void IWebView::TakeWebView(IWebView& other, void* pParent)
+{
+  WKWebView* webView = (__bridge WKWebView*) other.mWKWebView;
+  [webView removeFromSuperview];
+
+  mWKWebView = other.mWKWebView; // with its reference
+  mWebConfig = other.mWebConfig;
+  mScriptHandler = other.mScriptHandler;
+  other.mWKWebView = nullptr;
+  other.mWebConfig = nullptr;
+  other.mScriptHandler = nullptr;
+
+  [(__bridge ScriptHandler*) mScriptHandler setIWebView: this];
+}
+
+void* IWebView::GetPoolParentWindow()
+{
+  return nullptr;
+}
+
+void IWebView::DestroyPoolParentWindow()
+{
+}
+
 void IWebView::LoadHTML(const char* html)
 {
+  if (!BeginLoad(std::string("html:") + html))
+    return;
+
   WKWebView* webView = (__bridge WKWebView*) mWKWebView;
   [webView loadHTMLString:[NSString stringWithUTF8String:html] baseURL:nil];
 }
 
 void IWebView::LoadURL(const char* url)
 {
+  if (!BeginLoad(std::string("url:") + url))
+    return;
+
   WKWebView* webView = (__bridge WKWebView*) mWKWebView;
   
   NSURL* nsurl = [NSURL URLWithString:[NSString stringWithUTF8String:url] relativeToURL:nil];
@@ -157,6 +249,9 @@ void IWebView::LoadURL(const char* url)
 
 void IWebView::LoadFile(const char* fileName, const char* bundleID)
 {
+  if (!BeginLoad(std::string("file:") + (bundleID ? bundleID : "") + "/" + fileName))
+    return;
+
   WKWebView* webView = (__bridge WKWebView*) mWKWebView;
 
   WDL_String fullPath;
@@ -15,10 +15,27 @@
 #include "wdl_base64.h"
 #include "json.hpp"
 #include <functional>
+#include <unordered_map>
 
 BEGIN_IPLUG_NAMESPACE
 
-/** This Editor Delegate allows using a platform native web view as the UI for an iPlug plugin */
+/** The type of a message in a frame of the binary channel, see IWebView::GetBinaryChannelScript() */
+enum EWebViewBinaryMsg
+{
+  kWebViewSPVFD = 0, // int paramIdx, double value
+  kWebViewSCVFD,     // int ctrlTag, double normalizedValue
+  kWebViewSCMFD,     // int ctrlTag, int msgTag, int dataSize, data
+  kWebViewSAMFD,     // int msgTag, int dataSize, data
+  kWebViewSMMFD      // uint8_t status, data1, data2
+};
+
+/** This Editor Delegate allows using a platform native web view as the UI for an iPlug plugin.
+ * By default messages are sent to the page by EvaluateJavaScript(), with data base64 encoded. If IWebView::EnableBinaryChannel() is called before the UI opens,
+ * they are queued in a binary frame instead, which the page fetches once per animation frame, and parameter and control values are coalesced so that only the latest
+ * value in each frame is sent.
+ * To open the editor without creating a web view and loading the page each time, call IWebView::SetPoolKey() in the plug-in's constructor, and optionally
+ * IWebViewPool::Preheat() with the page that mEditorInitFunc loads. The page is then kept loaded while the editor is closed, and OnUIOpen() sends it the current
+ * parameter values when it is re-bound to an editor, so it should get its state from the plug-in rather than keep its own */
 class WebViewEditorDelegate : public IEditorDelegate
                             , public IWebView
 {
@@ -34,10 +51,17 @@ public:
   void CloseWindow() override
   {
     CloseWebView();
+    OnEditorOpenChanged(false);
   }
 
   void SendControlValueFromDelegate(int ctrlTag, double normalizedValue) override
   {
+    if (IsBinaryChannelEnabled())
+    {
+      QueueBinaryValue(kWebViewSCVFD, ctrlTag, normalizedValue);
+      return;
+    }
+
     WDL_String str;
     str.SetFormatted(mMaxJSStringLength, "SCVFD(%i, %f)", ctrlTag, normalizedValue);
     EvaluateJavaScript(str.Get());
@@ -45,6 +69,17 @@ public:
 
   void SendControlMsgFromDelegate(int ctrlTag, int msgTag, int dataSize, const void* pData) override
   {
+    if (IsBinaryChannelEnabled())
+    {
+      const int start = BeginBinaryMsg(kWebViewSCMFD);
+      mBinaryFrame.Put(&ctrlTag);
+      mBinaryFrame.Put(&msgTag);
+      mBinaryFrame.Put(&dataSize);
+      mBinaryFrame.PutBytes(pData, dataSize);
+      EndBinaryMsg(start);
+      return;
+    }
+
     WDL_String str;
     std::vector<char> base64;
     base64.resize(GetBase64Length(dataSize) + 1);
@@ -55,6 +90,12 @@ public:
 
   void SendParameterValueFromDelegate(int paramIdx, double value, bool normalized) override
   {
+    if (IsBinaryChannelEnabled())
+    {
+      QueueBinaryValue(kWebViewSPVFD, paramIdx, value);
+      return;
+    }
+
     WDL_String str;
     str.SetFormatted(mMaxJSStringLength, "SPVFD(%i, %f)", paramIdx, value);
     EvaluateJavaScript(str.Get());
@@ -62,6 +103,16 @@ public:
 
   void SendArbitraryMsgFromDelegate(int msgTag, int dataSize, const void* pData) override
   {
+    if (IsBinaryChannelEnabled())
+    {
+      const int start = BeginBinaryMsg(kWebViewSAMFD);
+      mBinaryFrame.Put(&msgTag);
+      mBinaryFrame.Put(&dataSize);
+      mBinaryFrame.PutBytes(pData, dataSize);
+      EndBinaryMsg(start);
+      return;
+    }
+
     WDL_String str;
     std::vector<char> base64;
     if (dataSize)
@@ -75,6 +126,16 @@ public:
   
   void SendMidiMsgFromDelegate(const IMidiMsg& msg) override
   {
+    if (IsBinaryChannelEnabled())
+    {
+      const int start = BeginBinaryMsg(kWebViewSMMFD);
+      mBinaryFrame.Put(&msg.mStatus);
+      mBinaryFrame.Put(&msg.mData1);
+      mBinaryFrame.Put(&msg.mData2);
+      EndBinaryMsg(start);
+      return;
+    }
+
     WDL_String str;
     str.SetFormatted(mMaxJSStringLength, "SMMFD(%i, %i, %i)", msg.mStatus, msg.mData1, msg.mData2);
     EvaluateJavaScript(str.Get());
@@ -140,6 +201,18 @@ public:
   void OnWebContentLoaded() override
   {
     OnUIOpen();
+    OnEditorOpenChanged(true);
+
+    if (mBinaryFrame.Size()) // queued while the page was loading
+      EvaluateJavaScript("IPlugBinaryFramePending()");
+  }
+
+  void GetBinaryFrame(std::vector<uint8_t>& data) override
+  {
+    data.assign(mBinaryFrame.GetData(), mBinaryFrame.GetData() + mBinaryFrame.Size());
+    mBinaryFrame.Clear();
+    mBinaryFrameValues.clear();
+    mBinaryFramePending = false;
   }
   
   void SetMaxJSStringLength(int length)
@@ -148,6 +221,49 @@ public:
   }
   
 protected:
+  /** Start a message in the binary frame, and tell the page that there is a frame to fetch if it is the first one
+   * @return The position of the message, for EndBinaryMsg() */
+  int BeginBinaryMsg(EWebViewBinaryMsg type)
+  {
+    if (!mBinaryFramePending)
+    {
+      mBinaryFramePending = true;
+      EvaluateJavaScript("IPlugBinaryFramePending()");
+    }
+
+    const int start = mBinaryFrame.Size();
+    int size = 0;
+    int msgType = type;
+    mBinaryFrame.Put(&size);
+    mBinaryFrame.Put(&msgType);
+    return start;
+  }
+
+  void EndBinaryMsg(int start)
+  {
+    const int size = mBinaryFrame.Size() - start;
+    memcpy(mBinaryFrame.GetData() + start, &size, sizeof(int));
+  }
+
+  /** Queue a parameter or control value, replacing the last one for the same index if it hasn't been fetched yet */
+  void QueueBinaryValue(EWebViewBinaryMsg type, int idx, double value)
+  {
+    const int64_t key = (static_cast<int64_t>(type) << 32) | static_cast<uint32_t>(idx);
+    auto it = mBinaryFrameValues.find(key);
+
+    if (it != mBinaryFrameValues.end())
+    {
+      memcpy(mBinaryFrame.GetData() + it->second, &value, sizeof(double));
+      return;
+    }
+
+    const int start = BeginBinaryMsg(type);
+    mBinaryFrame.Put(&idx);
+    mBinaryFrameValues[key] = mBinaryFrame.Size();
+    mBinaryFrame.Put(&value);
+    EndBinaryMsg(start);
+  }
+
   int GetBase64Length(int dataSize)
   {
     return static_cast<int>(4. * std::ceil((static_cast<double>(dataSize) / 3.)));
@@ -156,6 +272,11 @@ protected:
   int mMaxJSStringLength = kDefaultMaxJSStringLength;
   std::function<void()> mEditorInitFunc = nullptr;
   void* mHelperView = nullptr;
+
+  // the binary channel, used on the main thread
+  IByteChunk mBinaryFrame;
+  std::unordered_map<int64_t, int> mBinaryFrameValues; // key -> position of the value of a queued SPVFD or SCVFD
+  bool mBinaryFramePending = false;
 };
 
 END_IPLUG_NAMESPACE
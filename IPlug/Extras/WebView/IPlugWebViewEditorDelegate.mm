@@ -83,9 +83,8 @@ void* WebViewEditorDelegate::OpenWindow(void* pParent)
   if (pParentView) {
     [pParentView addSubview: pHelperView];
   }
-  
-  if (mEditorInitFunc)
-    mEditorInitFunc();
+
+  // mEditorInitFunc has been called by OnWebViewReady(), which OpenWebView() calls before it returns
 
   return mHelperView;
 }
@@ -19,11 +19,14 @@
 #include <cassert>
 
 #include "IPlugAPIBase.h"
+#include "IPlugTraceZones.h"
 
 using namespace iplug;
 
 IPlugAPIBase::IPlugAPIBase(Config c, EAPI plugAPI)
   : IPluginBase(c.nParams, c.nPresets)
+  , mParamsChangedFromProcessor((c.nParams + 31) / 32)
+  , mParamValuesFromProcessor(c.nParams)
 {
   mUniqueID = c.uniqueID;
   mMfrID = c.mfrID;
@@ -65,7 +68,29 @@ void IPlugAPIBase::OnHostRequestingImportantParameters(int count, WDL_TypedBuf<i
 
 void IPlugAPIBase::CreateTimer()
 {
-  mTimer = std::unique_ptr<Timer>(Timer::Create(std::bind(&IPlugAPIBase::OnTimer, this, std::placeholders::_1), IDLE_TIMER_RATE));
+  mTimer = std::unique_ptr<Timer>(Timer::Create(std::bind(&IPlugAPIBase::OnTimer, this, std::placeholders::_1), GetTimerRate()));
+}
+
+void IPlugAPIBase::SetTimerRate(uint32_t uiOpenMs, uint32_t uiClosedMs)
+{
+  assert(uiOpenMs > 0 && uiClosedMs > 0);
+
+  mTimerRateUIOpen = uiOpenMs;
+  mTimerRateUIClosed = uiClosedMs;
+
+  if (mTimer)
+    mTimer->SetInterval(GetTimerRate());
+}
+
+void IPlugAPIBase::OnEditorOpenChanged(bool isOpen)
+{
+  if (isOpen == mEditorIsOpen)
+    return;
+
+  mEditorIsOpen = isOpen;
+
+  if (mTimer)
+    mTimer->SetInterval(GetTimerRate());
 }
 
 bool IPlugAPIBase::CompareState(const uint8_t* pIncomingState, int startPos) const
@@ -116,10 +141,162 @@ void IPlugAPIBase::SetParameterValue(int idx, double normalizedValue)
 {
   Trace(TRACELOC, "%d:%f", idx, normalizedValue);
   GetParam(idx)->SetNormalized(normalizedValue);
-  InformHostOfParamChange(idx, normalizedValue);
+
+  if (mParamChangeBatchDepth)
+  {
+    if (!mParamIsInChangeBatch.Get()[idx])
+    {
+      mParamIsInChangeBatch.Get()[idx] = true;
+      mParamChangeBatch.Add(idx);
+    }
+  }
+  else
+    InformHostOfParamChange(idx, normalizedValue);
+
   OnParamChange(idx, kUI);
 }
 
+void IPlugAPIBase::BeginParameterChangeBatch()
+{
+  if (mParamChangeBatchDepth++ == 0)
+  {
+    mParamChangeBatch.Resize(NParams()); // reserve
+    mParamChangeBatch.Resize(0, false);
+    mParamIsInChangeBatch.Resize(NParams());
+    memset(mParamIsInChangeBatch.Get(), 0, NParams() * sizeof(bool));
+  }
+}
+
+void IPlugAPIBase::EndParameterChangeBatch()
+{
+  assert(mParamChangeBatchDepth > 0);
+
+  if (--mParamChangeBatchDepth == 0)
+  {
+    if (mParamChangeBatch.GetSize())
+    {
+      InformHostOfParamValueChanges(mParamChangeBatch.Get(), mParamChangeBatch.GetSize());
+      mParamChangeBatch.Resize(0, false);
+    }
+
+    if (!mParamGestureDepth)
+      CloseUndoStep();
+  }
+}
+
+#pragma mark - Undo
+
+void IPlugAPIBase::SetUndoHistorySize(int maxEdits)
+{
+  mUndoEdits.Resize(std::max(maxEdits, 0));
+  mUndoParamEdit.Resize(maxEdits > 0 ? NParams() : 0);
+
+  for (int i = 0; i < mUndoParamEdit.GetSize(); i++)
+    mUndoParamEdit.Get()[i] = -1;
+
+  mUndoBegin = mUndoCursor = mUndoEnd = 0;
+  mUndoStepStart = -1;
+}
+
+void IPlugAPIBase::RecordUndoEdit(int paramIdx, double oldValue, double newValue)
+{
+  if (mUndoStepStart < 0)
+  {
+    mUndoEnd = mUndoCursor; // a new step replaces the steps that were undone
+    mUndoStepStart = mUndoEnd;
+  }
+  else
+  {
+    // during a drag only the value before the gesture and the latest value are kept
+    const int64_t lastIdx = mUndoParamEdit.Get()[paramIdx];
+
+    if (lastIdx >= mUndoStepStart && lastIdx >= mUndoBegin)
+    {
+      GetUndoEdit(lastIdx).newValue = newValue;
+      return;
+    }
+  }
+
+  if (mUndoEnd - mUndoBegin == mUndoEdits.GetSize())
+  {
+    // forget the oldest step
+    do
+    {
+      mUndoBegin++;
+    } while (mUndoBegin < mUndoEnd && !GetUndoEdit(mUndoBegin).stepStart);
+  }
+
+  GetUndoEdit(mUndoEnd) = { paramIdx, mUndoEnd == mUndoStepStart, oldValue, newValue };
+  mUndoParamEdit.Get()[paramIdx] = mUndoEnd++;
+  mUndoCursor = mUndoEnd;
+
+  if (!mParamGestureDepth && !mParamChangeBatchDepth)
+    CloseUndoStep();
+}
+
+void IPlugAPIBase::CloseUndoStep()
+{
+  if (mUndoStepStart < 0)
+    return;
+
+  const int64_t startIdx = std::max(mUndoStepStart, mUndoBegin);
+  bool changed = false;
+
+  for (int64_t i = startIdx; i < mUndoEnd && !changed; i++)
+    changed = GetUndoEdit(i).oldValue != GetUndoEdit(i).newValue;
+
+  if (!changed)
+    mUndoEnd = mUndoCursor = startIdx;
+
+  mUndoStepStart = -1;
+}
+
+bool IPlugAPIBase::Undo()
+{
+  if (!CanUndo())
+    return false;
+
+  int64_t startIdx = mUndoCursor - 1;
+
+  while (startIdx > mUndoBegin && !GetUndoEdit(startIdx).stepStart)
+    startIdx--;
+
+  ApplyUndoStep(startIdx, mUndoCursor, true);
+  mUndoCursor = startIdx;
+  return true;
+}
+
+bool IPlugAPIBase::Redo()
+{
+  if (!CanRedo())
+    return false;
+
+  int64_t endIdx = mUndoCursor + 1;
+
+  while (endIdx < mUndoEnd && !GetUndoEdit(endIdx).stepStart)
+    endIdx++;
+
+  ApplyUndoStep(mUndoCursor, endIdx, false);
+  mUndoCursor = endIdx;
+  return true;
+}
+
+void IPlugAPIBase::ApplyUndoStep(int64_t startIdx, int64_t endIdx, bool undo)
+{
+  BeginParameterChangeBatch();
+
+  // undone in reverse, in case a parameter's OnParamChange() changes another
+  for (int64_t i = 0; i < endIdx - startIdx; i++)
+  {
+    const UndoEdit& edit = GetUndoEdit(undo ? endIdx - 1 - i : startIdx + i);
+    const double value = undo ? edit.oldValue : edit.newValue;
+    SetParameterValue(edit.paramIdx, value);
+    SendParameterValueFromDelegate(edit.paramIdx, value, true);
+  }
+
+  EndParameterChangeBatch();
+}
+
 void IPlugAPIBase::DirtyParametersFromUI()
 {
   for (int p = 0; p < NParams(); p++)
@@ -129,66 +306,99 @@ void IPlugAPIBase::DirtyParametersFromUI()
   }
 }
 
+void IPlugAPIBase::InformHostOfParamValueChanges(const int* pParamIdxs, int nParams)
+{
+  // each change is a gesture, so that the host records automation and undo for it
+  for (int i = 0; i < nParams; i++)
+  {
+    const int paramIdx = pParamIdxs[i];
+    BeginInformHostOfParamChange(paramIdx);
+    InformHostOfParamChange(paramIdx, GetParam(paramIdx)->GetNormalized());
+    EndInformHostOfParamChange(paramIdx);
+  }
+}
+
 void IPlugAPIBase::SendParameterValueFromAPI(int paramIdx, double value, bool normalized)
 {
   if (normalized)
     value = GetParam(paramIdx)->FromNormalized(value);
   
-  mParamChangeFromProcessor.Push(ParamTuple { paramIdx, value } );
+  // the value is stored before the bit is set, so that the main thread never sees a bit without its value
+  mParamValuesFromProcessor[paramIdx].store(value, std::memory_order_relaxed);
+  mParamsChangedFromProcessor[paramIdx / 32].fetch_or(1u << (paramIdx % 32), std::memory_order_release);
+}
+
+void IPlugAPIBase::SendParameterValuesFromProcessorToEditor()
+{
+  const int nWords = static_cast<int>(mParamsChangedFromProcessor.size());
+
+  for (int w = 0; w < nWords; w++)
+  {
+    if (!mParamsChangedFromProcessor[w].load(std::memory_order_relaxed))
+      continue;
+
+    uint32_t bits = mParamsChangedFromProcessor[w].exchange(0, std::memory_order_acquire);
+
+    while (bits)
+    {
+      int bit = 0;
+      while (!(bits & (1u << bit)))
+        bit++;
+
+      bits &= ~(1u << bit);
+
+      const int paramIdx = w * 32 + bit;
+      SendParameterValueFromDelegate(paramIdx, mParamValuesFromProcessor[paramIdx].load(std::memory_order_relaxed), false);
+    }
+  }
 }
 
 void IPlugAPIBase::OnTimer(Timer& t)
 {
+  TRACE_THREAD_NAME("Main");
+  TRACE_ZONE("OnTimer");
+
+  ReceiveMessagesFromProcessor();
+
   if(HasUI())
   {
+    TRACE_ZONE("OnTimer queues");
+
 // VST3 ********************************************************************************
 #if defined VST3P_API || defined VST3_API
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
+    mMidiMsgsFromProcessor.ConsumeAll([this](const IMidiMsg& msg) {
 #ifdef VST3P_API // distributed
       TransmitMidiMsgFromProcessor(msg);
 #else
       SendMidiMsgFromDelegate(msg);
 #endif
-    }
+    });
 
-    while (mSysExDataFromProcessor.ElementsAvailable())
-    {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
+    mSysExDataFromProcessor.ConsumeAll([this](const SysExData& msg) {
 #ifdef VST3P_API // distributed
       TransmitSysExDataFromProcessor(msg);
 #else
       SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
 #endif
-    }
+    });
 // !VST3 ******************************************************************************
 #else
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      ParamTuple p;
-      mParamChangeFromProcessor.Pop(p);
-      SendParameterValueFromDelegate(p.idx, p.value, false);
-    }
+    SendParameterValuesFromProcessorToEditor();
     
-    while (mMidiMsgsFromProcessor.ElementsAvailable())
-    {
-      IMidiMsg msg;
-      mMidiMsgsFromProcessor.Pop(msg);
+    mMidiMsgsFromProcessor.ConsumeAll([this](const IMidiMsg& msg) {
       SendMidiMsgFromDelegate(msg);
-    }
+    });
     
-    while (mSysExDataFromProcessor.ElementsAvailable())
-    {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
+    mSysExDataFromProcessor.ConsumeAll([this](const SysExData& msg) {
       SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
-    }
+    });
 #endif
   }
   
+  GetPayloadPool().Collect(); // free the memory of payloads released elsewhere, e.g. on the audio thread
+  mGarbageCollector.Collect(); // delete objects retired by the audio thread, see IPlugRealtimePtr
+  PollBankLoad();
+
   OnIdle();
 }
 
@@ -204,6 +414,14 @@ void IPlugAPIBase::SendSysexMsgFromUI(const ISysEx& msg)
   EDITOR_DELEGATE_CLASS::SendSysexMsgFromUI(msg); // for remote editors
 }
 
+void IPlugAPIBase::SendPayloadFromUI(int msgTag, int ctrlTag, const IPlugPayload& payload)
+{
+  OnPayload(msgTag, ctrlTag, payload); // IPlugAPIBase implementation handles non distributed plug-ins - the payload is shared, not copied
+
+  // remote editors can't share the memory, so send them the data
+  EDITOR_DELEGATE_CLASS::SendArbitraryMsgFromUI(msgTag, ctrlTag, payload.GetSize(), payload.GetData());
+}
+
 void IPlugAPIBase::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, const void* pData)
 {
   OnMessage(msgTag, ctrlTag, dataSize, pData); // IPlugAPIBase implementation handles non distributed plug-ins - just call OnMessage() directly
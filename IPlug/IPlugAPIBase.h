@@ -10,9 +10,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "ptrlist.h"
 #include "mutex.h"
@@ -24,6 +26,8 @@
 #include "IPlugUtilities.h"
 #include "IPlugParameter.h"
 #include "IPlugQueue.h"
+#include "IPlugMPSCQueue.h"
+#include "IPlugDeferredDelete.h"
 #include "IPlugTimer.h"
 
 /**
@@ -116,6 +120,45 @@ public:
    * @param paramIdx The index of the parameter that changed
    * @param normalizedValue The new (normalised) value */
   void SetParameterValue(int paramIdx, double normalizedValue);
+
+  /** Start a batch of parameter changes from the UI, e.g. before randomising or loading many parameters.
+   * Until the matching EndParameterChangeBatch(), parameter change gestures and the values passed to SetParameterValue() are not sent to the host one at a time,
+   * instead the changed parameters are collected and the host is informed of them all at once via InformHostOfParamValueChanges(), as one group of edits where the plug-in format supports it.
+   * Batches can be nested, the host is informed when the outermost batch ends. Call this on the main thread */
+  void BeginParameterChangeBatch();
+
+  /** End a batch of parameter changes started with BeginParameterChangeBatch() */
+  void EndParameterChangeBatch();
+
+  /** Keep a history of the parameter changes made from the UI, which Undo() and Redo() step through. Each step is one parameter change gesture, or one batch
+   * (see BeginParameterChangeBatch()), with the changes to the same parameter in it merged. Only the parameter index and its old and new values are recorded for each change,
+   * in a ring buffer that forgets the oldest steps when it is full, so the memory used is bounded however long the session.
+   * Only the changes sent via SendParameterValueFromUI() are recorded, not those from the host or those the plug-in makes with SetParameterValue().
+   * Call this on the main thread, e.g. in the plug-in's constructor after the parameters have been initialized. This clears the history
+   * @param maxEdits The number of parameter changes to remember, or 0 to turn the history off, which is the default */
+  void SetUndoHistorySize(int maxEdits);
+
+  /** Restore the parameters changed in the last step of the history, informing the host of them in one batch. Call this on the main thread
+   * @return \c true if there was a step to undo. It is not undone during a gesture */
+  bool Undo();
+
+  /** Apply the last step undone again, see Undo()
+   * @return \c true if there was a step to redo */
+  bool Redo();
+
+  /** @return \c true if Undo() would undo a step */
+  bool CanUndo() const { return mUndoStepStart < 0 && mUndoCursor > mUndoBegin; }
+
+  /** @return \c true if Redo() would redo a step */
+  bool CanRedo() const { return mUndoStepStart < 0 && mUndoCursor < mUndoEnd; }
+
+  /** Forget all the steps in the history, e.g. after loading a preset */
+  void ClearUndoHistory() { mUndoBegin = mUndoCursor = mUndoEnd; }
+
+  /** Set the intervals of the timer that sends data from the processor to the editor and calls OnIdle(). The defaults are IDLE_TIMER_RATE and IDLE_TIMER_RATE_UI_CLOSED
+   * @param uiOpenMs The interval in milliseconds while the editor is open
+   * @param uiClosedMs The interval in milliseconds while the editor is closed, or if the plug-in has no editor */
+  void SetTimerRate(uint32_t uiOpenMs, uint32_t uiClosedMs);
   
   /** Get the color of the track that the plug-in is inserted on */
   virtual void GetTrackColor(int& r, int& g, int& b) { r = 0; g = 0; b = 0; }
@@ -136,10 +179,16 @@ public:
    * you can call this to update the parameters on the DSP side */
   virtual void DirtyParametersFromUI() override;
 
+  /** Informs the host of the current values of a number of parameters, after a bulk change such as DefaultParamValues() on a group.
+   * Each value is sent as a parameter change gesture, so that the host records automation and undo for it
+   * @param pParamIdxs Pointer to the indices of the parameters that changed
+   * @param nParams The number of parameters that changed */
+  void InformHostOfParamValueChanges(const int* pParamIdxs, int nParams) override;
+
 #pragma mark - Methods called by the API class - you do not call these methods in your plug-in class
 
   /** This is called from the plug-in API class in order to update UI controls linked to plug-in parameters, prior to calling OnParamChange()
-   * NOTE: It may be called on the high priority audio thread. Its purpose is to place parameter changes in a queue to defer to main thread for the UI
+   * NOTE: It may be called on the high priority audio thread. Its purpose is to mark the parameter as changed, so that the main thread can update the UI with its latest value
    * @param paramIdx The index of the parameter that changed
    * @param value The new value
    * @param normalized /true if value is normalised */
@@ -155,15 +204,33 @@ public:
   virtual void HostSpecificInit() {}
 
   //IEditorDelegate
-  void BeginInformHostOfParamChangeFromUI(int paramIdx) override { BeginInformHostOfParamChange(paramIdx); }
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override
+  {
+    mParamGestureDepth++;
+
+    if (!mParamChangeBatchDepth)
+      BeginInformHostOfParamChange(paramIdx);
+  }
   
-  void EndInformHostOfParamChangeFromUI(int paramIdx) override { EndInformHostOfParamChange(paramIdx); }
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override
+  {
+    if (!mParamChangeBatchDepth)
+      EndInformHostOfParamChange(paramIdx);
+
+    if (mParamGestureDepth > 0 && --mParamGestureDepth == 0 && !mParamChangeBatchDepth)
+      CloseUndoStep();
+  }
   
   bool EditorResizeFromUI(int viewWidth, int viewHeight, bool needsPlatformResize) override;
   
   void SendParameterValueFromUI(int paramIdx, double normalisedValue) override
   {
+    const double oldValue = GetParam(paramIdx)->GetNormalized();
     SetParameterValue(paramIdx, normalisedValue);
+
+    if (mUndoEdits.GetSize())
+      RecordUndoEdit(paramIdx, oldValue, GetParam(paramIdx)->GetNormalized());
+
     IPluginBase::SendParameterValueFromUI(paramIdx, normalisedValue);
   }
   
@@ -173,8 +240,12 @@ public:
   void SendSysexMsgFromUI(const ISysEx& msg) override;
   
   void SendArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) override;
+
+  void SendPayloadFromUI(int msgTag, int ctrlTag, const IPlugPayload& payload) override;
+
+  void OnEditorOpenChanged(bool isOpen) override;
   
-  void DeferMidiMsg(const IMidiMsg& msg) override { mMidiMsgsFromEditor.Push(msg); }
+  void DeferMidiMsg(const IMidiMsg& msg) override { mMidiMsgsFromEditor.Push({msg, IMidiClock::Now()}); }
   
   void DeferSysexMsg(const ISysEx& msg) override
   {
@@ -184,6 +255,9 @@ public:
 
   /** Called by the API class to create the timer that pumps the parameter/message queues */
   void CreateTimer();
+
+  /** @return The collector that objects no longer used on the audio thread are retired to, which is emptied on the timer, see IPlugRealtimePtr */
+  IPlugGarbageCollector& GetGarbageCollector() { return mGarbageCollector; }
   
 private:
   /** Implementations call into the APIs resize hooks
@@ -210,8 +284,56 @@ private:
   /** \todo */
   virtual void TransmitSysExDataFromProcessor(const SysExData& data) {}
 
+  /** Called on the timer, to receive any messages from the processor that didn't come via the host, see IPlugVST3MessageChannel */
+  virtual void ReceiveMessagesFromProcessor() {}
+
   void OnTimer(Timer& t);
 
+  /** Called by the API class on the audio thread at the start of each block, to pass the MIDI messages from the editor to func, with sample offsets in the block from their timestamps, see IMidiClock
+   * @param nFrames The number of frames in the block
+   * @param sampleRate The sample rate
+   * @param func A function taking a const IMidiMsg&, usually calling IPlugProcessor::HandleMidiMsg() */
+  template <class Func>
+  void ProcessMidiMsgsFromEditor(int nFrames, double sampleRate, Func&& func)
+  {
+    mMidiClockFromEditor.BeginBlock(nFrames, sampleRate);
+
+    mMidiMsgsFromEditor.ConsumeAll([&](const ITimedMidiMsg& timedMsg) {
+      IMidiMsg msg = timedMsg.msg;
+      msg.mOffset = mMidiClockFromEditor.GetOffset(timedMsg.time);
+      func(msg);
+    });
+  }
+
+  /** @return The interval of the timer, which depends on whether the editor is open */
+  uint32_t GetTimerRate() const { return mEditorIsOpen ? mTimerRateUIOpen : mTimerRateUIClosed; }
+
+  /** Called on the main thread to send the latest values of the parameters that were changed by the processor since the last call to the editor.
+   * Many changes to the same parameter are coalesced into a single update */
+  void SendParameterValuesFromProcessorToEditor();
+
+  /** A parameter change in the undo history, see SetUndoHistorySize() */
+  struct UndoEdit
+  {
+    int paramIdx;
+    bool stepStart; // the first change of a step
+    double oldValue; // normalized
+    double newValue; // normalized
+  };
+
+  /** @param idx The position of the change in the history, which only ever increases
+   * @return The change at that position in the ring buffer */
+  UndoEdit& GetUndoEdit(int64_t idx) { return mUndoEdits.Get()[idx % mUndoEdits.GetSize()]; }
+
+  /** Record a parameter change from the UI in the current step of the history, starting a step if there isn't one */
+  void RecordUndoEdit(int paramIdx, double oldValue, double newValue);
+
+  /** End the current step of the history, at the end of a gesture or batch. A step that left all its parameters as they were is removed */
+  void CloseUndoStep();
+
+  /** Set the values of the parameters of a step without recording them, updating the UI and informing the host in one batch */
+  void ApplyUndoStep(int64_t startIdx, int64_t endIdx, bool undo);
+
   friend class IPlugAPP;
   friend class IPlugAAX;
   friend class IPlugVST2;
@@ -222,17 +344,36 @@ private:
   friend class IPlugAUv3;
   friend class IPlugWEB;
   friend class IPlugWAM;
+  friend class IPlugCLAP;
 
 private:
   WDL_String mParamDisplayStr;
   std::unique_ptr<Timer> mTimer;
+  uint32_t mTimerRateUIOpen = IDLE_TIMER_RATE;
+  uint32_t mTimerRateUIClosed = IDLE_TIMER_RATE_UI_CLOSED;
+  bool mEditorIsOpen = false;
+
+  int mParamChangeBatchDepth = 0;
+  WDL_TypedBuf<int> mParamChangeBatch; // the parameters changed during the current batch, in the order they were first changed
+  WDL_TypedBuf<bool> mParamIsInChangeBatch;
+  int mParamGestureDepth = 0; // the number of parameter change gestures from the UI in progress
+
+  WDL_TypedBuf<UndoEdit> mUndoEdits; // the ring buffer of the undo history, empty if it is off
+  WDL_TypedBuf<int64_t> mUndoParamEdit; // the position of the last change of each parameter, to merge the changes of a step
+  int64_t mUndoBegin = 0; // the oldest change remembered
+  int64_t mUndoCursor = 0; // the end of the steps that are applied, the steps after it can be redone
+  int64_t mUndoEnd = 0;
+  int64_t mUndoStepStart = -1; // the start of the step being recorded, or -1
   
-  IPlugQueue<ParamTuple> mParamChangeFromProcessor {PARAM_TRANSFER_SIZE};
-  IPlugQueue<IMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of midi messages generated in the editor by clicking keyboard UI etc
+  std::vector<std::atomic<uint32_t>> mParamsChangedFromProcessor; // a bitset with one bit per parameter, set when the processor changes a parameter value
+  std::vector<std::atomic<double>> mParamValuesFromProcessor; // the latest value of each parameter changed by the processor, read when its bit is set
+  IPlugMPSCQueue<ITimedMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of timestamped midi messages generated in the editor by clicking keyboard UI etc, which may be pushed from several threads e.g. by remote editors
+  IMidiClock mMidiClockFromEditor; // audio thread only
   IPlugQueue<IMidiMsg> mMidiMsgsFromProcessor {MIDI_TRANSFER_SIZE}; // a queue of MIDI messages received (potentially on the high priority thread), by the processor to send to the editor
-  IPlugQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor
+  IPlugMPSCQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor, which may be pushed from several threads
   IPlugQueue<SysExData> mSysExDataFromProcessor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the editor
   SysExData mSysexBuf;
+  IPlugGarbageCollector mGarbageCollector;
 };
 
 END_IPLUG_NAMESPACE
@@ -23,6 +23,9 @@
 
 BEGIN_IPLUG_NAMESPACE
 
+/* The precision of the ::sample type used for ProcessBlock() and IPlug's internal buffers.
+ * Defaults to double precision. Define SAMPLE_TYPE_FLOAT at project level (e.g. in EXTRA_ALL_DEFS), not in config.h, in order to process in single precision.
+ * This must be consistent across all translation units. API classes will prefer the host's buffer format that matches this type, avoiding conversion where possible. */
 #if !defined(SAMPLE_TYPE_FLOAT) && !defined(SAMPLE_TYPE_DOUBLE)
 #define SAMPLE_TYPE_DOUBLE
 #endif
@@ -38,6 +41,7 @@ using PLUG_SAMPLE_SRC = double;
 using sample = PLUG_SAMPLE_DST;
 
 #define LOGFILE "IPlugLog.txt"
+#define TRACEFILE "IPlugTrace.json" // see IPlugTraceZones.h
 #define MAX_PROCESS_TRACE_COUNT 100
 #define MAX_IDLE_TRACE_COUNT 15
 
@@ -110,6 +114,10 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define IDLE_TIMER_RATE 20 // this controls the frequency of data going from processor to editor (and OnIdle calls)
 #endif
 
+#ifndef IDLE_TIMER_RATE_UI_CLOSED
+#define IDLE_TIMER_RATE_UI_CLOSED 100 // the slower timer rate used while the editor is closed, or if the plug-in has no editor
+#endif
+
 #ifndef MAX_SYSEX_SIZE
 #define MAX_SYSEX_SIZE 512
 #endif
@@ -117,6 +125,8 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define PARAM_TRANSFER_SIZE 512
 #define MIDI_TRANSFER_SIZE 32
 #define SYSEX_TRANSFER_SIZE 4
+#define PROCESSING_LOAD_TRANSFER_SIZE 512
+#define PROCESSING_LOAD_WINDOW 1024 // number of blocks that processing load statistics are calculated over
 
 // All version ints are stored as 0xVVVVRRMM: V = version, R = revision, M = minor revision.
 #define IPLUG_VERSION 0x010000
@@ -182,7 +192,9 @@ enum EAPI
   kAPIAAX = 4,
   kAPIAPP = 5,
   kAPIWAM = 6,
-  kAPIWEB = 7
+  kAPIWEB = 7,
+  kAPICLAP = 8,
+  kAPIBENCH = 9
 };
 
 /** @enum EHost
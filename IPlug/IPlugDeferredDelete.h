@@ -0,0 +1,147 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Utilities to swap large DSP resources (e.g. impulse responses or compiled DSP) while the audio thread is running, without allocating or deleting on the audio thread
+ */
+
+#include <atomic>
+#include <memory>
+
+#include "IPlugPlatform.h"
+#include "IPlugMPSCQueue.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A queue of objects that are no longer used on the audio thread, which are deleted later on a non-realtime thread.
+ * IPlugAPIBase owns one, see IPlugAPIBase::GetGarbageCollector(), and empties it on its timer */
+class IPlugGarbageCollector final
+{
+public:
+  /** @param size The number of objects that can be waiting to be deleted */
+  IPlugGarbageCollector(int size = 64)
+  : mRetired(size)
+  {
+  }
+
+  IPlugGarbageCollector(const IPlugGarbageCollector&) = delete;
+  IPlugGarbageCollector& operator=(const IPlugGarbageCollector&) = delete;
+
+  ~IPlugGarbageCollector()
+  {
+    Collect();
+  }
+
+  /** Queue an object to be deleted by the next call to Collect(). This is realtime safe and can be called on any thread
+   * @param pObject The object, which must have been allocated with new
+   * @return \c true on success, \c false if the queue is full, in which case the caller still owns the object */
+  template <class T>
+  bool Retire(T* pObject)
+  {
+    return mRetired.Push({pObject, [](void* p) { delete static_cast<T*>(p); }});
+  }
+
+  /** Delete the objects that have been retired. Call this periodically on a single non-realtime thread, e.g. on a timer */
+  void Collect()
+  {
+    mRetired.ConsumeAll([](const Retired& retired) {
+      retired.deleter(retired.pObject);
+    });
+  }
+
+private:
+  struct Retired
+  {
+    void* pObject = nullptr;
+    void (*deleter)(void*) = nullptr;
+  };
+
+  IPlugMPSCQueue<Retired> mRetired;
+};
+
+/** Holds an object used on the audio thread that can be replaced from another thread, e.g. an impulse response loaded on the UI thread.
+ * Set() publishes a new object with an atomic pointer swap. The audio thread picks it up the next time it calls Get(), and retires the
+ * object it was using to an IPlugGarbageCollector, so that it is deleted on the timer rather than in ProcessBlock(). An object that is
+ * replaced before the audio thread has picked it up is deleted by Set() straight away, since the audio thread has never seen it */
+template <class T>
+class IPlugRealtimePtr final
+{
+public:
+  /** @param garbageCollector The collector to retire old objects to, which must outlive this object
+   * @param pInitial An optional object to start with */
+  IPlugRealtimePtr(IPlugGarbageCollector& garbageCollector, std::unique_ptr<T> pInitial = nullptr)
+  : mGarbageCollector(garbageCollector)
+  , mCurrent(pInitial.release())
+  {
+  }
+
+  IPlugRealtimePtr(const IPlugRealtimePtr&) = delete;
+  IPlugRealtimePtr& operator=(const IPlugRealtimePtr&) = delete;
+
+  /** The audio thread must no longer be calling Get() */
+  ~IPlugRealtimePtr()
+  {
+    delete mCurrent;
+    DeletePending(mPending.load(std::memory_order_acquire));
+    delete mDeferredRetire;
+  }
+
+  /** Publish a new object to the audio thread. This is not realtime safe, call it on a single non-realtime thread e.g. the UI thread
+   * @param pObject The new object, which can be nullptr */
+  void Set(std::unique_ptr<T> pObject)
+  {
+    // never seen by the audio thread, so it is safe to delete here
+    DeletePending(mPending.exchange(pObject ? pObject.release() : Empty(), std::memory_order_acq_rel));
+  }
+
+  /** Get the current object, picking up the one published by Set() if there is one. Call this on the audio thread, e.g. at the start of ProcessBlock()
+   * @return The current object, which stays valid until the next call, or nullptr */
+  T* Get()
+  {
+    // if the collector was full last time, the previous object is still here
+    if (mDeferredRetire && mGarbageCollector.Retire(mDeferredRetire))
+      mDeferredRetire = nullptr;
+
+    if (!mDeferredRetire && mPending.load(std::memory_order_relaxed))
+    {
+      T* pNew = mPending.exchange(nullptr, std::memory_order_acq_rel);
+
+      if (pNew)
+      {
+        if (mCurrent && !mGarbageCollector.Retire(mCurrent))
+          mDeferredRetire = mCurrent;
+
+        mCurrent = pNew == Empty() ? nullptr : pNew;
+      }
+    }
+
+    return mCurrent;
+  }
+
+private:
+  /** @return A non null marker, published by Set(nullptr), to tell the audio thread to drop the current object */
+  static T* Empty() { return reinterpret_cast<T*>(alignof(T)); }
+
+  static void DeletePending(T* pPending)
+  {
+    if (pPending != Empty())
+      delete pPending;
+  }
+
+  IPlugGarbageCollector& mGarbageCollector;
+  std::atomic<T*> mPending {nullptr};
+  T* mCurrent = nullptr; // audio thread only
+  T* mDeferredRetire = nullptr; // audio thread only
+};
+
+END_IPLUG_NAMESPACE
@@ -16,6 +16,7 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <stdint.h>
 
@@ -24,6 +25,9 @@
 #include "IPlugParameter.h"
 #include "IPlugMidi.h"
 #include "IPlugStructs.h"
+#include "IPlugPayload.h"
+#include "IPlugStartupTimeline.h"
+#include "IPlugMemoryAccounting.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -56,6 +60,9 @@ public:
   virtual ~IEditorDelegate()
   {
     mParams.Empty(true);
+
+    if (IPlugMemoryAccount::GetCurrent() == mMemoryAccount)
+      IPlugMemoryAccount::SetCurrent(nullptr);
   }
   
   IEditorDelegate(const IEditorDelegate&) = delete;
@@ -64,12 +71,21 @@ public:
   /** Adds an IParam to the parameters ptr list
    * Note: This is only used in special circumstances, since most plug-in formats don't support dynamic parameters
    * @return Ptr to the newly created IParam object */
-  IParam* AddParam() { return mParams.Add(new IParam()); }
+  IParam* AddParam()
+  {
+    IParam* pParam = mParams.Add(new IParam());
+    mParamsMemoryCharge.Set(mParams.GetSize() * sizeof(IParam));
+    return pParam;
+  }
   
   /** Remove an IParam at a particular index
    * Note: This is only used in special circumstances, since most plug-in formats don't support dynamic parameters
    * @param idx The index of the parameter to remove */
-  void RemoveParam(int idx) { return mParams.Delete(idx); }
+  void RemoveParam(int idx)
+  {
+    mParams.Delete(idx);
+    mParamsMemoryCharge.Set(mParams.GetSize() * sizeof(IParam));
+  }
   
   /** Get a pointer to one of the delegate's IParam objects
    * @param paramIdx The index of the parameter object to be got
@@ -83,13 +99,52 @@ public:
 
   /** @return Returns the number of parameters that belong to the plug-in. */
   int NParams() const { return mParams.GetSize(); }
+
+  /** @return The delegate's IParam objects */
+  const WDL_PtrList<IParam>& GetParams() const { return mParams; }
   
   /** If you are not using IGraphics, you can implement this method to attach to the native parent view e.g. NSView, UIView, HWND.
    *  Defer calling OnUIOpen() if necessary. */
-  virtual void* OpenWindow(void* pParent) { OnUIOpen(); return nullptr; }
+  virtual void* OpenWindow(void* pParent)
+  {
+    mStartupTimeline.BeginEditorOpen();
+
+    {
+      IPlugStartupTimeline::ScopedPhase phase(mStartupTimeline, IPlugStartupTimeline::kUIOpen);
+      OnUIOpen();
+    }
+
+    OnEditorOpenChanged(true);
+    mStartupTimeline.EndEditorOpen(); // there is no first frame to wait for
+    return nullptr;
+  }
   
   /** If you are not using IGraphics you can if you need to free resources etc when the window closes. Call base implementation. */
-  virtual void CloseWindow() { OnUIClose(); }
+  virtual void CloseWindow() { OnUIClose(); OnEditorOpenChanged(false); }
+
+  /** On platforms where the OS doesn't deliver the editor's events itself, e.g. X11 on Linux, get the file descriptors that the host's run loop should watch while the editor is open
+   * @param pFDs An array that will be filled with the file descriptors
+   * @param maxFDs The size of the array
+   * @return The number of file descriptors */
+  virtual int GetEditorPollFDs(int* pFDs, int maxFDs) { return 0; }
+
+  /** Called by the API class on the main thread when a file descriptor from GetEditorPollFDs() is readable
+   * @param fd The file descriptor */
+  virtual void OnEditorPollFD(int fd) {}
+
+  /** Called by the delegate when the editor window has been opened or closed. IPlugAPIBase implements this to slow its timer down while the editor is closed.
+   * If you implement OpenWindow() yourself without calling the base implementation, call this with \c true once the window is open
+   * @param isOpen \c true if the editor window is open */
+  virtual void OnEditorOpenChanged(bool isOpen) {}
+
+  /** @return The timeline of instantiating the plug-in and opening its editor, e.g. to set budgets for them or get a summary, see IPlugStartupTimeline */
+  IPlugStartupTimeline& GetStartupTimeline() { return mStartupTimeline; }
+
+  /** @return The account that the memory of this instance is counted for, which can be made current with IPlugMemoryAccount::ScopedCurrent, see IPlugMemoryAccounting.h */
+  const std::shared_ptr<IPlugMemoryAccount>& GetMemoryAccount() const { return mMemoryAccount; }
+
+  /** @return The memory used by this instance for each subsystem, always 0 without IPLUG_MEMORY_ACCOUNTING. See GetProcessMemoryUsage() for all instances */
+  MemoryUsage GetMemoryUsage() const { return mMemoryAccount->GetUsage(); }
 
   /** Called by app wrappers when the OS window scaling buttons/resizers are used */
   virtual void OnParentWindowResize(int width, int height) { /* NO-OP*/ }
@@ -100,6 +155,10 @@ public:
   
   /** Override this method to do something before the UI is closed. */
   virtual void OnUIClose() {};
+
+  /** Called by the API class when the OS warns that memory is low, e.g. by the AUv3 view controller on iOS, where an extension that uses too much is killed.
+   * Override it to release memory that the DSP doesn't need and that can be created again, and call the base implementation. With IGraphics the base implementation releases the UI's layers and cached resources, see IGraphics::OnMemoryWarning() */
+  virtual void OnMemoryWarning() {}
   
   /** Override this method to do something to your DSP when a parameter changes.
    * WARNING: this method can in some cases be called on the realtime audio thread
@@ -144,6 +203,14 @@ public:
   
   /** This could be implemented in either DSP or EDITOR to receive a message from the other one */
   virtual bool OnMessage(int msgTag, int ctrlTag, int dataSize, const void* pData) { return false; }
+
+  /** Implement this in the DSP to receive a payload sent with SendPayloadFromUI(), without copying it. You can keep a reference to the payload, e.g. to hand it to the audio thread,
+   * which may release it since the memory is freed by the payload pool. The default implementation passes the payload's data to OnMessage()
+   * @param msgTag A unique tag to identify the message
+   * @param ctrlTag A unique tag to identify the control that sent the message
+   * @param payload The payload
+   * @return \c true if the message was handled */
+  virtual bool OnPayload(int msgTag, int ctrlTag, const IPlugPayload& payload) { return OnMessage(msgTag, ctrlTag, payload.GetSize(), payload.GetData()); }
   
   /** This is called by API classes after restoring state and by IPluginBase::RestorePreset(). Typically used to update user interface, where multiple parameter values have changed.
    * If you need to do something when state is restored you can override it
@@ -279,6 +346,23 @@ public:
   * @param dataSize The size in bytes of the data payload pointed to by pData. Note: if this is nonzero, pData must be valid.
   * @param pData Ptr to the opaque data payload for the message */
   virtual void SendArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) {};
+
+  /** SendPayloadFromUI
+   * Send a large message, such as a wavetable or an impulse response, from the user interface to the plug-in. When the editor is in the same process the payload is handed to OnPayload() without copying it,
+   * otherwise (e.g. a distributed VST3 plug-in) the data is sent with SendArbitraryMsgFromUI()
+   * @param msgTag A unique tag to identify the message
+   * @param ctrlTag A unique tag to identify the control that sent the message, if desired
+   * @param payload A payload created with CreatePayload() */
+  virtual void SendPayloadFromUI(int msgTag, int ctrlTag, const IPlugPayload& payload) { SendArbitraryMsgFromUI(msgTag, ctrlTag, payload.GetSize(), payload.GetData()); }
+
+  /** Create a reference counted payload to send with SendPayloadFromUI(). This is not realtime safe
+   * @param size The size of the data in bytes
+   * @param pData Optional data to copy into the payload, otherwise write to IPlugPayload::GetData()
+   * @return The payload, which is empty if the memory couldn't be allocated */
+  IPlugPayload CreatePayload(int size, const void* pData = nullptr) { return mPayloadPool.Create(size, pData); }
+
+  /** @return The pool that creates payloads and recycles their memory */
+  IPlugPayloadPool& GetPayloadPool() { return mPayloadPool; }
   
 #pragma mark -
   /** This method is needed, for remote editors to avoid a feedback loop */
@@ -361,6 +445,13 @@ public:
   friend class IPluginBase;
 
 private:
+  /** The pool for CreatePayload(), declared first so that it outlives the payloads held by the other members */
+  IPlugPayloadPool mPayloadPool;
+  /** Declared early, since instantiation is timed from its construction */
+  IPlugStartupTimeline mStartupTimeline;
+  /** Made current on the constructing thread until MakePlug() returns, so that the members of the plug-in are counted for it */
+  std::shared_ptr<IPlugMemoryAccount> mMemoryAccount = IPlugMemoryAccount::CreateCurrent();
+  IPlugMemoryCharge mParamsMemoryCharge {EMemorySubsystem::kParameters};
   /** A list of IParam objects. This list is populated in the delegate constructor depending on the number of parameters passed as an argument to MakeConfig() in the plug-in class implementation constructor */
   WDL_PtrList<IParam> mParams;
 
@@ -26,12 +26,23 @@
 #include <cstring>
 #include <ctime>
 #include <cassert>
+#include <atomic>
+
+#if defined TRACER_BUILD
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+#endif
 
 #include "wdlstring.h"
 #include "mutex.h"
 
 #include "IPlugConstants.h"
 #include "IPlugUtilities.h"
+#include "IPlugQueue.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -84,22 +95,29 @@ BEGIN_IPLUG_NAMESPACE
   #endif
 
   #define TRACELOC __FUNCTION__,__LINE__
-  static void Trace(const char* funcName, int line, const char* fmtStr, ...);
 
   #define APPEND_TIMESTAMP(str) AppendTimestamp(__DATE__, __TIME__, str)
 
+  /** @return A small number identifying the calling thread, in the order that threads first asked for one, which the log and the trace zones use */
+  inline intptr_t GetOrdinalThreadID()
+  {
+    static std::atomic<intptr_t> sNThreads {0};
+    thread_local const intptr_t tThreadID = sNThreads.fetch_add(1, std::memory_order_relaxed);
+    return tThreadID;
+  }
+
   struct LogFile
   {
     FILE* mFP;
     
-    LogFile()
+    LogFile(const char* fileName = LOGFILE)
     {
   #ifdef OS_WIN
       char logFilePath[MAX_WIN32_PATH_LEN];
-      snprintf(logFilePath, MAX_WIN32_PATH_LEN,"%s/%s", "C:\\", LOGFILE);
+      snprintf(logFilePath, MAX_WIN32_PATH_LEN,"%s/%s", "C:\\", fileName);
   #else
       char logFilePath[MAX_MACOS_PATH_LEN];
-      snprintf(logFilePath, MAX_MACOS_PATH_LEN, "%s/%s", getenv("HOME"), LOGFILE);
+      snprintf(logFilePath, MAX_MACOS_PATH_LEN, "%s/%s", getenv("HOME"), fileName);
   #endif
       mFP = fopen(logFilePath, "w");
       assert(mFP);
@@ -174,105 +192,280 @@ BEGIN_IPLUG_NAMESPACE
 
   const int TXTLEN = 1024;
 
-  // _vsnsprintf
-
-  #define VARARGS_TO_STR(str) { \
-  try { \
-  va_list argList;  \
-  va_start(argList, format);  \
-  int i = vsnprintf(str, TXTLEN-2, format, argList); \
-  if (i < 0 || i > TXTLEN-2) {  \
-  str[TXTLEN-1] = '\0';  \
-  } \
-  va_end(argList);  \
-  } \
-  catch(...) {  \
-  strcpy(str, "parse error"); \
-  } \
-  strcat(str, "\r\n"); \
+  #define MAX_LOG_LINES 16384
+
+  #ifndef TRACE_QUEUE_SIZE
+    #define TRACE_QUEUE_SIZE 512 // the number of records each thread can trace before the writer catches up
+  #endif
+
+  #ifndef TRACE_STR_LEN
+    #define TRACE_STR_LEN 64 // string arguments are truncated to this length, including the terminator
+  #endif
+
+  /** A string argument of Trace(), which is copied into the record since it may not outlive the call */
+  struct TraceStr
+  {
+    char str[TRACE_STR_LEN];
+
+    TraceStr(const char* s)
+    {
+      if (!s)
+        s = "(null)";
+
+      size_t i = 0;
+      for (; i < TRACE_STR_LEN - 1 && s[i]; i++)
+        str[i] = s[i];
+      str[i] = '\0';
+    }
+  };
+
+  /** The type an argument of Trace() is stored as in the record */
+  template <typename T> struct TraceArgType { using type = T; };
+  template <> struct TraceArgType<const char*> { using type = TraceStr; };
+  template <> struct TraceArgType<char*> { using type = TraceStr; };
+
+  static inline const char* FormatTraceArg(const TraceStr& arg) { return arg.str; }
+  template <typename T> static inline const T& FormatTraceArg(const T& arg) { return arg; }
+
+  template <typename... Args>
+  static int FormatTraceStr(char* str, int len, const char* format, Args... args)
+  {
+    if constexpr (sizeof...(Args) == 0)
+      return snprintf(str, len, "%s", format);
+    else
+      return snprintf(str, len, format, args...);
+  }
+
+  /** A call to Trace(), with its arguments stored in binary, to be formatted by the writer thread */
+  struct TraceRecord
+  {
+    static constexpr int kArgsSize = 256;
+
+    double time; // seconds since the first trace
+    const char* funcName;
+    int line;
+    const char* format;
+    int (*formatFunc)(char* str, int len, const char* format, const void* pArgs); // nullptr if args holds the formatted text
+    alignas(8) char args[kArgsSize];
+  };
+
+  template <typename Tuple>
+  static int FormatTraceArgs(char* str, int len, const char* format, const void* pArgs)
+  {
+    return std::apply([&](const auto&... args) { return FormatTraceStr(str, len, format, FormatTraceArg(args)...); }, *static_cast<const Tuple*>(pArgs));
   }
 
-  static intptr_t GetOrdinalThreadID(intptr_t sysThreadID)
+  /** The records traced by one thread, which only that thread pushes to */
+  struct TraceQueue
   {
-    static WDL_TypedBuf<intptr_t> sThreadIDs;
-    int i, n = sThreadIDs.GetSize();
-    intptr_t* pThreadID = sThreadIDs.Get();
-    for (i = 0; i < n; ++i, ++pThreadID)
+    TraceQueue() : mThreadID(GetOrdinalThreadID()) {}
+
+    IPlugQueue<TraceRecord> mRecords {TRACE_QUEUE_SIZE};
+    std::atomic<int> mDropped {0};
+    intptr_t mThreadID;
+  };
+
+  /** Trace() doesn't lock or do any I/O on the calling thread, so it can be left on in builds where it is called on the audio thread: the call is stored
+   * in a lock free queue for the thread, and a background thread formats the records and writes them to the log. The first trace on a thread allocates its queue.
+   * If a thread traces faster than the log is written, records are dropped, and the number dropped is logged */
+  class TraceWriter
+  {
+  public:
+    /** @return The writer, which is shared by the whole process since it is an inline member */
+    static TraceWriter& Get()
+    {
+      static TraceWriter sWriter;
+      return sWriter;
+    }
+
+    /** @return The queue of the calling thread, created on its first trace */
+    TraceQueue* GetThreadQueue()
     {
-      if (sysThreadID == *pThreadID)
+      thread_local TraceQueue* tQueue = nullptr;
+
+      if (!tQueue)
       {
-        return i;
+        std::lock_guard<std::mutex> lock(mQueuesMutex);
+        mQueues.push_back(std::unique_ptr<TraceQueue>(new TraceQueue()));
+        tQueue = mQueues.back().get();
+
+        if (!mThread.joinable())
+          mThread = std::thread([this]() { Run(); });
       }
+
+      return tQueue;
     }
-    sThreadIDs.Resize(n + 1);
-    *(sThreadIDs.Get() + n) = sysThreadID;
-    return n;
-  }
 
-  #define MAX_LOG_LINES 16384
-  void Trace(const char* funcName, int line, const char* format, ...)
-  {
-    static int sTrace = 0;
-    static int32_t sProcessCount = 0;
-    static int32_t sIdleCount = 0;
+    /** @return \c true if a trace should be recorded, until MAX_LOG_LINES have been */
+    bool CountTrace() { return mNTraces.fetch_add(1, std::memory_order_relaxed) < MAX_LOG_LINES; }
 
-    if (sTrace++ < MAX_LOG_LINES)
+    double GetTime() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count(); }
+
+    ~TraceWriter()
+    {
+      mRunning = false;
+
+      if (mThread.joinable())
+        mThread.join();
+
+      Drain();
+    }
+
+  private:
+    TraceWriter() = default;
+
+    void Run()
     {
+      while (mRunning)
+      {
+        Drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+
+    void Drain()
+    {
+      std::vector<TraceQueue*> queues;
+
+      {
+        std::lock_guard<std::mutex> lock(mQueuesMutex);
+        for (auto& pQueue : mQueues)
+          queues.push_back(pQueue.get());
+      }
+
+      for (auto* pQueue : queues)
+      {
+        TraceRecord record;
+
+        while (pQueue->mRecords.Pop(record))
+          Write(pQueue->mThreadID, record);
+
+        const int nDropped = pQueue->mDropped.exchange(0, std::memory_order_relaxed);
+
+        if (nDropped)
+        {
+          char str[TXTLEN];
+          snprintf(str, TXTLEN, "**************** %d TRACE RECORDS DROPPED ****************\r\n", nDropped);
+          WriteLine(pQueue->mThreadID, "", 0, 0., str);
+        }
+      }
+
   #ifndef TRACETOSTDOUT
-      static LogFile sLogFile;
-      assert(sLogFile.mFP);
+      fflush(mLogFile.mFP);
   #endif
-      static WDL_Mutex sLogMutex;
+    }
+
+    void Write(intptr_t threadID, const TraceRecord& record)
+    {
       char str[TXTLEN];
-      VARARGS_TO_STR(str);
-      
-  #ifdef TRACETOSTDOUT
-      DBGMSG("[%ld:%s:%d]%s", GetOrdinalThreadID(SYS_THREAD_ID), funcName, line, str);
-  #else
-      WDL_MutexLock lock(&sLogMutex);
-      intptr_t threadID = GetOrdinalThreadID(SYS_THREAD_ID);
-      
+
+      if (record.formatFunc)
+      {
+        const int i = record.formatFunc(str, TXTLEN - 2, record.format, record.args);
+
+        if (i < 0)
+          strcpy(str, "parse error");
+      }
+      else
+        snprintf(str, TXTLEN - 2, "%s", record.args);
+
+      strcat(str, "\r\n");
+
+      const char* funcName = record.funcName;
+
+  #ifndef TRACETOSTDOUT
       if(strstr(funcName, "rocess") || strstr(funcName, "ender")) // These are not typos! by excluding the first character, we can use TRACE in methods called ProcessXXX or process etc.
       {
-        if(++sProcessCount > MAX_PROCESS_TRACE_COUNT)
+        if(++mProcessCount > MAX_PROCESS_TRACE_COUNT)
         {
-          fflush(sLogFile.mFP);
           return;
         }
-        else if (sProcessCount == MAX_PROCESS_TRACE_COUNT)
+        else if (mProcessCount == MAX_PROCESS_TRACE_COUNT)
         {
-          fprintf(sLogFile.mFP, "**************** DISABLING PROCESS TRACING AFTER %d HITS ****************\n\n", sProcessCount);
-          fflush(sLogFile.mFP);
+          fprintf(mLogFile.mFP, "**************** DISABLING PROCESS TRACING AFTER %d HITS ****************\n\n", mProcessCount);
           return;
         }
       }
-      
+
 #ifdef VST2_API
       if(strstr(str, "effGetProgram") || strstr(str, "effEditGetRect") || strstr(funcName, "MouseOver"))
 #else
       if(strstr(funcName, "MouseOver") || strstr(funcName, "idle"))
 #endif
       {
-        if(++sIdleCount > MAX_IDLE_TRACE_COUNT)
+        if(++mIdleCount > MAX_IDLE_TRACE_COUNT)
         {
-          fflush(sLogFile.mFP);
           return;
         }
-        else if (sIdleCount == MAX_IDLE_TRACE_COUNT)
+        else if (mIdleCount == MAX_IDLE_TRACE_COUNT)
         {
-          fprintf(sLogFile.mFP, "**************** DISABLING IDLE/MOUSEOVER TRACING AFTER %d HITS ****************\n", sIdleCount);
-          fflush(sLogFile.mFP);
+          fprintf(mLogFile.mFP, "**************** DISABLING IDLE/MOUSEOVER TRACING AFTER %d HITS ****************\n", mIdleCount);
           return;
         }
       }
-      
+  #endif
+
+      WriteLine(threadID, funcName, record.line, record.time, str);
+    }
+
+    void WriteLine(intptr_t threadID, const char* funcName, int line, double time, const char* str)
+    {
+  #ifdef TRACETOSTDOUT
+      DBGMSG("[%ld:%s:%d:%.6f]%s", (long) threadID, funcName, line, time, str);
+  #else
       if (threadID > 0)
-        fprintf(sLogFile.mFP, "*** -");
-      
-      fprintf(sLogFile.mFP, "[%ld:%s:%d]%s", threadID, funcName, line, str);
-      fflush(sLogFile.mFP);
+        fprintf(mLogFile.mFP, "*** -");
+
+      fprintf(mLogFile.mFP, "[%ld:%s:%d:%.6f]%s", (long) threadID, funcName, line, time, str);
   #endif
     }
+
+  #ifndef TRACETOSTDOUT
+    LogFile mLogFile;
+  #endif
+    const std::chrono::steady_clock::time_point mStartTime = std::chrono::steady_clock::now();
+    std::atomic<int> mNTraces {0};
+    std::atomic<bool> mRunning {true};
+    std::mutex mQueuesMutex; // only taken by a thread's first trace, and to list the queues
+    std::vector<std::unique_ptr<TraceQueue>> mQueues;
+    std::thread mThread;
+    int32_t mProcessCount = 0; // writer thread only
+    int32_t mIdleCount = 0;
+  };
+
+  /** Record a trace, see TraceWriter. The format string must be a string literal, since it is read when the record is written */
+  template <typename... Args>
+  static void Trace(const char* funcName, int line, const char* format, Args... args)
+  {
+    TraceWriter& writer = TraceWriter::Get();
+
+    if (!writer.CountTrace())
+      return;
+
+    TraceRecord record;
+    record.time = writer.GetTime();
+    record.funcName = funcName;
+    record.line = line;
+    record.format = format;
+
+    using Tuple = std::tuple<typename TraceArgType<Args>::type...>;
+
+    if constexpr (sizeof(Tuple) <= TraceRecord::kArgsSize && alignof(Tuple) <= 8)
+    {
+      new (record.args) Tuple(args...);
+      record.formatFunc = &FormatTraceArgs<Tuple>;
+    }
+    else
+    {
+      // too many arguments to store, so they're formatted now, which is still lock free
+      FormatTraceStr(record.args, TraceRecord::kArgsSize, format, args...);
+      record.formatFunc = nullptr;
+    }
+
+    TraceQueue* pQueue = writer.GetThreadQueue();
+
+    if (!pQueue->mRecords.Push(record))
+      pQueue->mDropped.fetch_add(1, std::memory_order_relaxed);
   }
 
   #ifdef VST2_API
@@ -0,0 +1,184 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugMPSCQueue
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A lock-free bounded multiple producer, single consumer queue, used to transfer data to the audio thread from several threads
+ * e.g. the UI thread, web socket connection threads and OSC.
+ * It has the same interface as IPlugQueue for the consumer. Each slot holds a sequence number, so that producers claim slots by incrementing the write position
+ * and then publish them independently, without locks.
+ * based on the bounded MPMC queue by Dmitry Vyukov http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue */
+template<typename T>
+class IPlugMPSCQueue final
+{
+public:
+  /** @param size The minimum number of elements the queue can hold, it is rounded up to a power of two */
+  IPlugMPSCQueue(int size)
+  {
+    Resize(size);
+  }
+
+  IPlugMPSCQueue(const IPlugMPSCQueue&) = delete;
+  IPlugMPSCQueue& operator=(const IPlugMPSCQueue&) = delete;
+
+  /** Resize the queue, discarding its contents. This is not thread safe
+   * @param size The minimum number of elements the queue can hold, it is rounded up to a power of two */
+  void Resize(int size)
+  {
+    size_t capacity = 2;
+
+    while (capacity < static_cast<size_t>(size))
+      capacity <<= 1;
+
+    mCells.reset(new Cell[capacity]);
+    mMask = capacity - 1;
+
+    for (size_t i = 0; i < capacity; i++)
+      mCells[i].sequence.store(i, std::memory_order_relaxed);
+
+    mWritePos.store(0, std::memory_order_relaxed);
+    mReadPos.store(0, std::memory_order_relaxed);
+  }
+
+  /** Push an element, this can be called on any thread
+   * @return \c true on success, \c false if the queue is full */
+  bool Push(const T& item)
+  {
+    size_t pos = mWritePos.load(std::memory_order_relaxed);
+    Cell* pCell;
+
+    for (;;)
+    {
+      pCell = &mCells[pos & mMask];
+      const size_t seq = pCell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+      if (diff == 0) // the slot is free, try to claim it
+      {
+        if (mWritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) // the slot hasn't been read yet, the queue is full
+        return false;
+      else // another producer claimed the slot
+        pos = mWritePos.load(std::memory_order_relaxed);
+    }
+
+    pCell->data = item;
+    pCell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Pop an element, call this on the consumer thread
+   * @return \c true on success, \c false if there was no element available */
+  bool Pop(T& item)
+  {
+    Cell* pCell = GetReadCell();
+
+    if (!pCell)
+      return false;
+
+    item = pCell->data;
+    ReleaseReadCell();
+    return true;
+  }
+
+  /** Call a function for each element that is available, reading them in place, and remove them from the queue. Call this on the consumer thread
+   * @param func A function taking a const T&
+   * @return The number of elements that were handled */
+  template <class Func>
+  size_t ConsumeAll(Func&& func)
+  {
+    size_t n = 0;
+
+    // only handle the elements available on entry, so that fast producers can't keep the consumer here
+    for (size_t available = ElementsAvailable(); n < available; n++)
+    {
+      Cell* pCell = GetReadCell();
+
+      if (!pCell) // a producer that claimed an earlier slot hasn't finished writing it
+        break;
+
+      func(static_cast<const T&>(pCell->data));
+      ReleaseReadCell();
+    }
+
+    return n;
+  }
+
+  /** @return The number of elements claimed by producers and not yet popped, some may still be being written */
+  size_t ElementsAvailable() const
+  {
+    const size_t write = mWritePos.load(std::memory_order_acquire);
+    const size_t read = mReadPos.load(std::memory_order_relaxed);
+    return write - read;
+  }
+
+  /** @return \c true if the queue was empty when called */
+  bool WasEmpty() const
+  {
+    return ElementsAvailable() == 0;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  /** @return The next cell to read if it has been published, or nullptr */
+  Cell* GetReadCell()
+  {
+    const size_t pos = mReadPos.load(std::memory_order_relaxed);
+    Cell* pCell = &mCells[pos & mMask];
+    const size_t seq = pCell->sequence.load(std::memory_order_acquire);
+
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0)
+      return nullptr;
+
+    return pCell;
+  }
+
+  /** Give the cell returned by GetReadCell() back to the producers */
+  void ReleaseReadCell()
+  {
+    const size_t pos = mReadPos.load(std::memory_order_relaxed);
+    mCells[pos & mMask].sequence.store(pos + mMask + 1, std::memory_order_release);
+    mReadPos.store(pos + 1, std::memory_order_relaxed);
+  }
+
+  static constexpr size_t kCacheLineSize = 64;
+
+  std::unique_ptr<Cell[]> mCells;
+  size_t mMask = 0;
+  // padding keeps the positions, written by different threads, on their own cache lines
+  char mPadding0[kCacheLineSize];
+  std::atomic<size_t> mWritePos {0};
+  char mPadding1[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> mReadPos {0};
+  char mPadding2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+END_IPLUG_NAMESPACE
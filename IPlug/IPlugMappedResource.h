@@ -0,0 +1,194 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugMappedResource
+ */
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#include "IPlugPlatform.h"
+#include "IPlugPaths.h"
+#include "IPlugRealtimeCheck.h"
+
+#if !defined OS_WIN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A read only view of the bytes of a resource, which decoders can read in place rather than copying the resource into a buffer first.
+ * A file, e.g. in the bundle resources folder, is memory mapped, so its pages are only read from disk as they are touched and are shared with the file cache.
+ * Memory that outlives the view, e.g. a Windows resource returned by LoadWinResource() via LockResource(), or data compiled into the binary with bin2c
+ * (which is how web builds can avoid the Emscripten virtual file system), is wrapped without a copy.
+ * On web, files in the Emscripten virtual file system are already in memory, and mapping one copies it
+ * @ingroup IPlugUtilities */
+class IPlugMappedResource final
+{
+public:
+  IPlugMappedResource() = default;
+
+  /** Map a file read only
+   * @param path The absolute path to the file. Check IsValid() to see if it succeeded */
+  explicit IPlugMappedResource(const char* path)
+  {
+    Map(path);
+  }
+
+  /** Wrap memory without copying it
+   * @param pData The data, which must stay valid for the lifetime of this object
+   * @param size The size of the data in bytes */
+  IPlugMappedResource(const void* pData, size_t size)
+  : mData(static_cast<const uint8_t*>(pData))
+  , mSize(pData ? size : 0)
+  {
+  }
+
+  IPlugMappedResource(const IPlugMappedResource&) = delete;
+  IPlugMappedResource& operator=(const IPlugMappedResource&) = delete;
+
+  IPlugMappedResource(IPlugMappedResource&& other)
+  {
+    *this = std::move(other);
+  }
+
+  IPlugMappedResource& operator=(IPlugMappedResource&& other)
+  {
+    if (this != &other)
+    {
+      Unmap();
+      mData = other.mData;
+      mSize = other.mSize;
+      mMapped = other.mMapped;
+#ifdef OS_WIN
+      mMapping = other.mMapping;
+      other.mMapping = NULL;
+#endif
+      other.mData = nullptr;
+      other.mSize = 0;
+      other.mMapped = false;
+    }
+
+    return *this;
+  }
+
+  ~IPlugMappedResource()
+  {
+    Unmap();
+  }
+
+  /** @return A pointer to the data, or nullptr if the resource is not valid */
+  const uint8_t* Get() const { return mData; }
+
+  /** @return The size of the data in bytes */
+  size_t GetSize() const { return mSize; }
+
+  /** @return \c true if there is some data */
+  bool IsValid() const { return mData && mSize; }
+
+  /** @return \c true if the data is a memory mapped file, \c false if it is wrapped memory */
+  bool IsMapped() const { return mMapped; }
+
+private:
+  void Map(const char* path)
+  {
+    IPLUG_REALTIME_CHECK(kFileIO, "IPlugMappedResource::Map");
+#ifdef OS_WIN
+    wchar_t pathWide[MAX_PATH];
+    UTF8ToUTF16(pathWide, path, MAX_PATH);
+
+    HANDLE file = CreateFileW(pathWide, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+      return;
+
+    LARGE_INTEGER size;
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+      mMapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+      if (mMapping)
+      {
+        mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+
+        if (mData)
+        {
+          mSize = static_cast<size_t>(size.QuadPart);
+          mMapped = true;
+        }
+        else
+        {
+          CloseHandle(mMapping);
+          mMapping = NULL;
+        }
+      }
+    }
+
+    CloseHandle(file); // the mapping keeps the file open
+#else
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+      return;
+
+    struct stat info;
+
+    if (!fstat(fd, &info) && info.st_size > 0)
+    {
+      void* pData = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if (pData != MAP_FAILED)
+      {
+        mData = static_cast<const uint8_t*>(pData);
+        mSize = static_cast<size_t>(info.st_size);
+        mMapped = true;
+      }
+    }
+
+    close(fd); // the mapping keeps the file open
+#endif
+  }
+
+  void Unmap()
+  {
+    if (mMapped)
+    {
+#ifdef OS_WIN
+      UnmapViewOfFile(mData);
+      CloseHandle(mMapping);
+      mMapping = NULL;
+#else
+      munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mMapped = false;
+  }
+
+  const uint8_t* mData = nullptr;
+  size_t mSize = 0;
+  bool mMapped = false;
+#ifdef OS_WIN
+  HANDLE mMapping = NULL;
+#endif
+};
+
+END_IPLUG_NAMESPACE
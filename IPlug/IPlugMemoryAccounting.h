@@ -0,0 +1,252 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Accounting of the memory used by the framework's subsystems, per plug-in instance and for the whole process
+ *
+ * Define IPLUG_MEMORY_ACCOUNTING to enable it. The framework counts its larger allocations with an IPlugMemoryCharge, a member of the object that owns the memory:
+ * - kBitmaps: an APIBitmap, estimated at 4 bytes per pixel whether it is in memory or a texture. This includes the bitmaps in the static bitmap caches
+ * - kLayers: the APIBitmap of an ILayer
+ * - kStaticStorage: the other entries of a StaticStorage, e.g. the SVG and font caches, which are shared by all instances so are only counted for the process
+ * - kQueues: the buffers of IPlugQueue, e.g. the queues of IPlugAPIBase and ISender
+ * - kParameters: the IParam objects of a plug-in
+ * - kOversampling: the buffers of an OverSampler
+ *
+ * Every charge counts for the process. It also counts for the IPlugMemoryAccount that was current on the thread that created it, see IPlugMemoryAccount::ScopedCurrent.
+ * The account of a plug-in instance is current while it is constructed, so its members and parameters are counted for it, and while its editor opens and draws, so are the bitmaps and layers of its UI.
+ * Get the usage with IEditorDelegate::GetMemoryUsage() and GetProcessMemoryUsage(). With IPLUG_MEMORY_ACCOUNTING defined both are shown by the kProfile style of the IGraphics performance display.
+ * Without it, charges count nothing and the usage is always 0.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The subsystems whose memory is counted, see IPlugMemoryAccounting.h */
+enum class EMemorySubsystem
+{
+  kBitmaps,
+  kLayers,
+  kStaticStorage,
+  kQueues,
+  kParameters,
+  kOversampling,
+  kNumSubsystems
+};
+
+static inline const char* MemorySubsystemStr(EMemorySubsystem subsystem)
+{
+  static const char* sStrs[] = { "Bitmaps", "Layers", "Static storage", "Queues", "Parameters", "Oversampling" };
+  return sStrs[static_cast<int>(subsystem)];
+}
+
+/** The bytes counted for each subsystem by an IPlugMemoryAccount */
+struct MemoryUsage
+{
+  int64_t bytes[static_cast<int>(EMemorySubsystem::kNumSubsystems)] = {};
+
+  int64_t Get(EMemorySubsystem subsystem) const { return bytes[static_cast<int>(subsystem)]; }
+
+  int64_t Total() const
+  {
+    int64_t total = 0;
+
+    for (auto b : bytes)
+      total += b;
+
+    return total;
+  }
+};
+
+/** Counts the memory charged to it by IPlugMemoryCharge objects. Each plug-in instance has one, see IEditorDelegate::GetMemoryAccount(), and there is one for the whole process
+ * @ingroup IPlugUtilities */
+class IPlugMemoryAccount
+{
+public:
+  /** Makes an account current on the calling thread while it is in scope, so that the charges created in the scope are counted for it */
+  class ScopedCurrent
+  {
+  public:
+    ScopedCurrent(const std::shared_ptr<IPlugMemoryAccount>& account)
+#if defined IPLUG_MEMORY_ACCOUNTING
+    : mPrevious(GetCurrent())
+#endif
+    {
+      SetCurrent(account);
+    }
+
+    ~ScopedCurrent()
+    {
+#if defined IPLUG_MEMORY_ACCOUNTING
+      SetCurrent(mPrevious);
+#endif
+    }
+
+    ScopedCurrent(const ScopedCurrent&) = delete;
+    ScopedCurrent& operator=(const ScopedCurrent&) = delete;
+
+#if defined IPLUG_MEMORY_ACCOUNTING
+  private:
+    std::shared_ptr<IPlugMemoryAccount> mPrevious;
+#endif
+  };
+
+  IPlugMemoryAccount() {}
+
+  IPlugMemoryAccount(const IPlugMemoryAccount&) = delete;
+  IPlugMemoryAccount& operator=(const IPlugMemoryAccount&) = delete;
+
+  /** Called by IPlugMemoryCharge. Thread safe */
+  void Add(EMemorySubsystem subsystem, int64_t bytes)
+  {
+    mBytes[static_cast<int>(subsystem)].fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /** @return The bytes currently counted for each subsystem */
+  MemoryUsage GetUsage() const
+  {
+    MemoryUsage usage;
+
+    for (int i = 0; i < static_cast<int>(EMemorySubsystem::kNumSubsystems); i++)
+      usage.bytes[i] = mBytes[i].load(std::memory_order_relaxed);
+
+    return usage;
+  }
+
+  /** @return The account for the whole process. It is never destroyed, so that static caches can uncharge their memory at exit */
+  static IPlugMemoryAccount& GetProcessAccount()
+  {
+    static IPlugMemoryAccount* sAccount = new IPlugMemoryAccount();
+    return *sAccount;
+  }
+
+  /** @return The account that is current on the calling thread, or nullptr */
+  static std::shared_ptr<IPlugMemoryAccount> GetCurrent()
+  {
+#if defined IPLUG_MEMORY_ACCOUNTING
+    return CurrentAccount().lock();
+#else
+    return nullptr;
+#endif
+  }
+
+  /** Make an account current on the calling thread, see also ScopedCurrent
+   * @param account The account, or nullptr for none */
+#if defined IPLUG_MEMORY_ACCOUNTING
+  static void SetCurrent(const std::shared_ptr<IPlugMemoryAccount>& account)
+  {
+    CurrentAccount() = account;
+  }
+#else
+  static void SetCurrent(const std::shared_ptr<IPlugMemoryAccount>&) {}
+#endif
+
+  /** Create an account and make it current on the calling thread, used by IEditorDelegate so that everything created while a plug-in is constructed is counted for it
+   * @return The account */
+  static std::shared_ptr<IPlugMemoryAccount> CreateCurrent()
+  {
+    auto account = std::make_shared<IPlugMemoryAccount>();
+    SetCurrent(account);
+    return account;
+  }
+
+private:
+#if defined IPLUG_MEMORY_ACCOUNTING
+  /** A weak reference, so that a thread doesn't keep the account of a deleted instance alive */
+  static std::weak_ptr<IPlugMemoryAccount>& CurrentAccount()
+  {
+    thread_local std::weak_ptr<IPlugMemoryAccount> tCurrent;
+    return tCurrent;
+  }
+#endif
+
+  std::atomic<int64_t> mBytes[static_cast<int>(EMemorySubsystem::kNumSubsystems)] = {};
+};
+
+/** @return The memory counted for the whole process */
+inline MemoryUsage GetProcessMemoryUsage() { return IPlugMemoryAccount::GetProcessAccount().GetUsage(); }
+
+/** Counts an amount of memory for a subsystem, for the process and the account that was current when the charge was constructed, until the charge is destroyed.
+ * It keeps the account alive, so an object can outlive the instance that created it, e.g. in a static cache. Without IPLUG_MEMORY_ACCOUNTING it is empty and counts nothing */
+class IPlugMemoryCharge
+{
+public:
+  /** @param subsystem The subsystem to count the memory for
+   * @param perInstance If \c false the memory is only counted for the process, e.g. memory that is shared by all instances */
+#if defined IPLUG_MEMORY_ACCOUNTING
+  IPlugMemoryCharge(EMemorySubsystem subsystem, bool perInstance = true)
+  : mSubsystem(subsystem)
+  , mAccount(perInstance ? IPlugMemoryAccount::GetCurrent() : nullptr)
+  {
+  }
+#else
+  IPlugMemoryCharge(EMemorySubsystem, bool = true) {}
+#endif
+
+  ~IPlugMemoryCharge()
+  {
+    Set(0);
+  }
+
+  IPlugMemoryCharge(const IPlugMemoryCharge&) = delete;
+  IPlugMemoryCharge& operator=(const IPlugMemoryCharge&) = delete;
+
+  /** @param bytes The memory that is now used, replacing the amount set before */
+#if defined IPLUG_MEMORY_ACCOUNTING
+  void Set(size_t bytes)
+  {
+    const int64_t delta = static_cast<int64_t>(bytes) - mBytes;
+    mBytes = static_cast<int64_t>(bytes);
+    Add(delta);
+  }
+#else
+  void Set(size_t) {}
+#endif
+
+  /** Move the memory to another subsystem, e.g. an APIBitmap that becomes an ILayer */
+#if defined IPLUG_MEMORY_ACCOUNTING
+  void SetSubsystem(EMemorySubsystem subsystem)
+  {
+    Add(-mBytes);
+    mSubsystem = subsystem;
+    Add(mBytes);
+  }
+#else
+  void SetSubsystem(EMemorySubsystem) {}
+#endif
+
+#if defined IPLUG_MEMORY_ACCOUNTING
+private:
+  void Add(int64_t delta)
+  {
+    if (!delta)
+      return;
+
+    IPlugMemoryAccount::GetProcessAccount().Add(mSubsystem, delta);
+
+    if (mAccount)
+      mAccount->Add(mSubsystem, delta);
+  }
+
+  EMemorySubsystem mSubsystem;
+  std::shared_ptr<IPlugMemoryAccount> mAccount;
+  int64_t mBytes = 0;
+#endif
+};
+
+END_IPLUG_NAMESPACE
@@ -16,12 +16,17 @@
  * @ingroup IPlugStructs
  */
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
+
+#include "heapbuf.h"
 
 #include "IPlugLogger.h"
+#include "IPlugRealtimeCheck.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -594,6 +599,430 @@ struct ISysEx
 
 };
 
+/** Encapsulates a Universal MIDI Packet (UMP), which carries MIDI 2.0 channel voice messages with 16-bit velocities and 32-bit controller values,
+ * as well as per-note controllers and pitch bend. The packet is one to four 32-bit words, with the message type in the top nibble of the first word.
+ * Unlike IMidiMsg, the high resolution values are not reduced to 7 or 14 bits, so per-note expression from VST3, CLAP or a MIDI 2.0 host keeps its precision.
+ * @ingroup IPlugStructs */
+struct IMidiUMP
+{
+  int mOffset;
+  uint32_t mWords[4];
+
+  /** Constants for the message type of a packet, the top nibble of the first word */
+  enum EMessageType
+  {
+    kUtility = 0x0,
+    kSystem = 0x1,
+    kMidi1ChannelVoice = 0x2,
+    kData64 = 0x3,
+    kMidi2ChannelVoice = 0x4,
+    kData128 = 0x5
+  };
+
+  /** Constants for the status of a MIDI 2.0 channel voice message */
+  enum EStatusMsg
+  {
+    kRegisteredPerNoteController = 0x0,
+    kAssignablePerNoteController = 0x1,
+    kRegisteredController = 0x2,
+    kAssignableController = 0x3,
+    kPerNotePitchBend = 0x6,
+    kNoteOff = 0x8,
+    kNoteOn = 0x9,
+    kPolyPressure = 0xA,
+    kControlChange = 0xB,
+    kProgramChange = 0xC,
+    kChannelPressure = 0xD,
+    kPitchBend = 0xE,
+    kPerNoteManagement = 0xF
+  };
+
+  /** Indices of the registered per-note controllers that have a meaning in MIDI 2.0, other indices follow the MIDI 1.0 CC numbers */
+  enum EPerNoteController
+  {
+    kPerNoteModulation = 1,
+    kPerNoteBreath = 2,
+    kPerNotePitch = 3, // absolute pitch in 7.25 format
+    kPerNoteVolume = 7,
+    kPerNotePan = 10,
+    kPerNoteExpression = 11,
+    kPerNoteTimbre = 74
+  };
+
+  /** Create an IMidiUMP
+   * @param offset The sample offset in the block
+   * @param word0 The first word of the packet, the others are zero */
+  IMidiUMP(int offset = 0, uint32_t word0 = 0)
+  : mOffset(offset)
+  , mWords{word0, 0, 0, 0}
+  {}
+
+  /** Make a MIDI 2.0 Note On message
+   * @param noteNumber Note number
+   * @param velocity Range [0, 1], which is sent with 16-bit resolution. Unlike MIDI 1.0, a velocity of 0 is still a note on
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakeNoteOnMsg(int noteNumber, double velocity, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kNoteOn, channel, group, noteNumber, 0, offset);
+    mWords[1] = ToUInt32(velocity) & 0xFFFF0000;
+  }
+
+  /** Make a MIDI 2.0 Note Off message
+   * @param noteNumber Note number
+   * @param velocity Release velocity, range [0, 1]
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakeNoteOffMsg(int noteNumber, double velocity, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kNoteOff, channel, group, noteNumber, 0, offset);
+    mWords[1] = ToUInt32(velocity) & 0xFFFF0000;
+  }
+
+  /** Make a MIDI 2.0 Control Change message
+   * @param idx Controller index [0, 127]
+   * @param value Range [0, 1], sent with 32-bit resolution
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakeControlChangeMsg(int idx, double value, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kControlChange, channel, group, idx, 0, offset);
+    mWords[1] = ToUInt32(value);
+  }
+
+  /** Make a MIDI 2.0 Program Change message, without a bank
+   * @param program Program index [0, 127]
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakeProgramChangeMsg(int program, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kProgramChange, channel, group, 0, 0, offset);
+    mWords[1] = static_cast<uint32_t>(program & 0x7F) << 24;
+  }
+
+  /** Make a MIDI 2.0 Channel Pressure message
+   * @param pressure Range [0, 1]
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakeChannelPressureMsg(double pressure, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kChannelPressure, channel, group, 0, 0, offset);
+    mWords[1] = ToUInt32(pressure);
+  }
+
+  /** Make a MIDI 2.0 Poly Pressure message
+   * @param noteNumber Note number
+   * @param pressure Range [0, 1]
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakePolyPressureMsg(int noteNumber, double pressure, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kPolyPressure, channel, group, noteNumber, 0, offset);
+    mWords[1] = ToUInt32(pressure);
+  }
+
+  /** Make a MIDI 2.0 Pitch Bend message
+   * @param value Range [-1, 1], where 0 = no pitch change
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakePitchBendMsg(double value, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kPitchBend, channel, group, 0, 0, offset);
+    mWords[1] = ToUInt32((value + 1.) * 0.5);
+  }
+
+  /** Make a MIDI 2.0 Per-Note Pitch Bend message, which bends a single note by the channel's pitch bend range
+   * @param noteNumber Note number
+   * @param value Range [-1, 1], where 0 = no pitch change
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakePerNotePitchBendMsg(int noteNumber, double value, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kPerNotePitchBend, channel, group, noteNumber, 0, offset);
+    mWords[1] = ToUInt32((value + 1.) * 0.5);
+  }
+
+  /** Make a MIDI 2.0 Per-Note Controller message
+   * @param noteNumber Note number
+   * @param idx Controller index [0, 255], see EPerNoteController for the registered controllers
+   * @param value Range [0, 1], sent with 32-bit resolution
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param registered \c true for a registered controller, \c false for an assignable one
+   * @param group UMP group [0, 15] */
+  void MakePerNoteControllerMsg(int noteNumber, int idx, double value, int offset, int channel = 0, bool registered = true, int group = 0)
+  {
+    MakeMidi2Msg(registered ? kRegisteredPerNoteController : kAssignablePerNoteController, channel, group, noteNumber, idx, offset);
+    mWords[1] = ToUInt32(value);
+  }
+
+  /** Make a MIDI 2.0 registered Per-Note Controller message for kPerNotePitch, which sets the absolute pitch of a single note
+   * @param noteNumber Note number
+   * @param pitch The pitch in semitones [0, 128), where 60.0 is the pitch of note 60 in 12-TET
+   * @param offset Sample offset in block
+   * @param channel MIDI channel [0, 15]
+   * @param group UMP group [0, 15] */
+  void MakePerNotePitchMsg(int noteNumber, double pitch, int offset, int channel = 0, int group = 0)
+  {
+    MakeMidi2Msg(kRegisteredPerNoteController, channel, group, noteNumber, kPerNotePitch, offset);
+    mWords[1] = static_cast<uint32_t>(std::min(std::max(pitch, 0.), 127.999999) * 33554432.); // 7.25 fixed point
+  }
+
+  /** Convert a MIDI 1.0 message to the equivalent MIDI 2.0 channel voice message, scaling the values up as described in the MIDI 2.0 translation rules,
+   * so that the minimum, center and maximum values are preserved. A MIDI 1.0 Note On with a velocity of 0 becomes a Note Off
+   * @param msg The MIDI 1.0 message
+   * @param group UMP group [0, 15]
+   * @return \c true if the message has a MIDI 2.0 equivalent */
+  bool FromMidiMsg(const IMidiMsg& msg, int group = 0)
+  {
+    const int channel = msg.Channel();
+    const int status = msg.StatusMsg();
+
+    switch (status)
+    {
+      case IMidiMsg::kNoteOn:
+      case IMidiMsg::kNoteOff:
+      {
+        const bool noteOn = status == IMidiMsg::kNoteOn && msg.mData2 > 0;
+        MakeMidi2Msg(noteOn ? kNoteOn : kNoteOff, channel, group, msg.mData1, 0, msg.mOffset);
+        mWords[1] = ScaleUp(msg.mData2 & 0x7F, 7, 16) << 16;
+        return true;
+      }
+      case IMidiMsg::kPolyAftertouch:
+        MakeMidi2Msg(kPolyPressure, channel, group, msg.mData1, 0, msg.mOffset);
+        mWords[1] = ScaleUp(msg.mData2 & 0x7F, 7, 32);
+        return true;
+      case IMidiMsg::kControlChange:
+        MakeMidi2Msg(kControlChange, channel, group, msg.mData1, 0, msg.mOffset);
+        mWords[1] = ScaleUp(msg.mData2 & 0x7F, 7, 32);
+        return true;
+      case IMidiMsg::kProgramChange:
+        MakeProgramChangeMsg(msg.mData1, msg.mOffset, channel, group);
+        return true;
+      case IMidiMsg::kChannelAftertouch:
+        MakeMidi2Msg(kChannelPressure, channel, group, 0, 0, msg.mOffset);
+        mWords[1] = ScaleUp(msg.mData1 & 0x7F, 7, 32);
+        return true;
+      case IMidiMsg::kPitchWheel:
+        MakeMidi2Msg(kPitchBend, channel, group, 0, 0, msg.mOffset);
+        mWords[1] = ScaleUp(((msg.mData2 & 0x7F) << 7) | (msg.mData1 & 0x7F), 14, 32);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /** Convert the message to the equivalent MIDI 1.0 message, dropping the extra resolution.
+   * Per-note controllers, per-note pitch bend and the other messages that MIDI 1.0 can't express are not converted
+   * @param msg The MIDI 1.0 message
+   * @return \c true if the message has a MIDI 1.0 equivalent */
+  bool ToMidiMsg(IMidiMsg& msg) const
+  {
+    const EMessageType type = MessageType();
+
+    if (type == kMidi1ChannelVoice)
+    {
+      msg = IMidiMsg(mOffset, (mWords[0] >> 16) & 0xFF, (mWords[0] >> 8) & 0x7F, mWords[0] & 0x7F);
+      return true;
+    }
+
+    if (type != kMidi2ChannelVoice)
+      return false;
+
+    const uint8_t channel = static_cast<uint8_t>(Channel());
+
+    switch (StatusMsg())
+    {
+      case kNoteOn:
+      {
+        // a MIDI 1.0 Note On with velocity 0 would be a Note Off
+        const uint8_t velocity = static_cast<uint8_t>(std::max(Velocity16() >> 9, 1));
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kNoteOn << 4), static_cast<uint8_t>(NoteNumber()), velocity);
+        return true;
+      }
+      case kNoteOff:
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kNoteOff << 4), static_cast<uint8_t>(NoteNumber()), static_cast<uint8_t>(Velocity16() >> 9));
+        return true;
+      case kPolyPressure:
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kPolyAftertouch << 4), static_cast<uint8_t>(NoteNumber()), static_cast<uint8_t>(mWords[1] >> 25));
+        return true;
+      case kControlChange:
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kControlChange << 4), static_cast<uint8_t>(ControllerIdx()), static_cast<uint8_t>(mWords[1] >> 25));
+        return true;
+      case kProgramChange:
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kProgramChange << 4), static_cast<uint8_t>(Program()), 0);
+        return true;
+      case kChannelPressure:
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kChannelAftertouch << 4), static_cast<uint8_t>(mWords[1] >> 25), 0);
+        return true;
+      case kPitchBend:
+      {
+        const uint32_t value14 = mWords[1] >> 18;
+        msg = IMidiMsg(mOffset, channel | (IMidiMsg::kPitchWheel << 4), value14 & 0x7F, (value14 >> 7) & 0x7F);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  /** @return The message type of the packet */
+  EMessageType MessageType() const { return static_cast<EMessageType>(mWords[0] >> 28); }
+
+  /** @return The number of 32-bit words in the packet [1, 4], which depends on its message type */
+  int NumWords() const
+  {
+    static constexpr int kNumWords[16] = { 1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4 };
+    return kNumWords[mWords[0] >> 28];
+  }
+
+  /** @return The UMP group [0, 15] */
+  int Group() const { return (mWords[0] >> 24) & 0xF; }
+
+  /** @return The status of a MIDI 2.0 channel voice message, see EStatusMsg */
+  EStatusMsg StatusMsg() const { return static_cast<EStatusMsg>((mWords[0] >> 20) & 0xF); }
+
+  /** @return The MIDI channel [0, 15] of a channel voice message */
+  int Channel() const { return (mWords[0] >> 16) & 0xF; }
+
+  /** @return \c true if the message applies to a single note, i.e. note on/off, poly pressure, per-note controllers, per-note pitch bend and per-note management */
+  bool IsPerNote() const
+  {
+    if (MessageType() != kMidi2ChannelVoice)
+      return false;
+
+    switch (StatusMsg())
+    {
+      case kRegisteredPerNoteController:
+      case kAssignablePerNoteController:
+      case kPerNotePitchBend:
+      case kNoteOff:
+      case kNoteOn:
+      case kPolyPressure:
+      case kPerNoteManagement:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  /** @return The note number [0, 127] of a per-note message, see IsPerNote(), or -1 if NA */
+  int NoteNumber() const { return IsPerNote() ? (mWords[0] >> 8) & 0x7F : -1; }
+
+  /** @return The index of a control change [0, 127], of a per-note controller [0, 255], or the 14-bit parameter number of a registered (RPN) or assignable (NRPN) controller */
+  int ControllerIdx() const
+  {
+    switch (StatusMsg())
+    {
+      case kRegisteredPerNoteController:
+      case kAssignablePerNoteController:
+        return mWords[0] & 0xFF;
+      case kRegisteredController:
+      case kAssignableController:
+        return (((mWords[0] >> 8) & 0x7F) << 7) | (mWords[0] & 0x7F);
+      default:
+        return (mWords[0] >> 8) & 0x7F;
+    }
+  }
+
+  /** @return The program [0, 127] of a Program Change message */
+  int Program() const { return (mWords[1] >> 24) & 0x7F; }
+
+  /** @return The 16-bit velocity of a Note On or Note Off message */
+  int Velocity16() const { return static_cast<int>(mWords[1] >> 16); }
+
+  /** @return The velocity of a Note On or Note Off message, range [0, 1] */
+  double Velocity() const { return Velocity16() / 65535.; }
+
+  /** @return The raw 32-bit value of a controller, pressure or pitch bend message */
+  uint32_t Value32() const { return mWords[1]; }
+
+  /** @return The value of a controller or pressure message, range [0, 1] */
+  double Value() const { return FromUInt32(mWords[1]); }
+
+  /** @return The pitch in semitones of a registered Per-Note Controller message for kPerNotePitch, see MakePerNotePitchMsg() */
+  double NotePitch() const { return mWords[1] / 33554432.; }
+
+  /** @return The value of a pitch bend or per-note pitch bend message, range [-1, 1] where 0 = no pitch change */
+  double PitchBend() const { return (static_cast<double>(mWords[1]) - 2147483648.) / 2147483648.; }
+
+  /** Clear the message */
+  void Clear()
+  {
+    mOffset = 0;
+    mWords[0] = mWords[1] = mWords[2] = mWords[3] = 0;
+  }
+
+  /** Convert a normalized value to 32 bits
+   * @param value Range [0, 1]
+   * @return The value in the range [0, 0xFFFFFFFF] */
+  static uint32_t ToUInt32(double value)
+  {
+    return static_cast<uint32_t>(std::min(std::max(value, 0.), 1.) * 4294967295. + 0.5);
+  }
+
+  /** Convert a 32-bit value to a normalized value
+   * @param value The value in the range [0, 0xFFFFFFFF]
+   * @return Range [0, 1] */
+  static double FromUInt32(uint32_t value) { return value / 4294967295.; }
+
+  /** Scale a value up to a higher resolution with the MIDI 2.0 min-center-max algorithm, so that 0, the center and the maximum map to 0, the center and the maximum
+   * @param value The value to scale, with srcBits bits
+   * @param srcBits The resolution of value, e.g. 7 for a MIDI 1.0 CC
+   * @param dstBits The resolution of the result [srcBits, 32]
+   * @return The scaled value */
+  static uint32_t ScaleUp(uint32_t value, int srcBits, int dstBits)
+  {
+    const int scaleBits = dstBits - srcBits;
+    uint32_t result = value << scaleBits;
+
+    if (value <= (1u << (srcBits - 1)))
+      return result;
+
+    // fill the lower bits by repeating the bits below the top bit, so the maximum maps to the maximum
+    const int repeatBits = srcBits - 1;
+    uint32_t repeatValue = value & ((1u << repeatBits) - 1);
+    repeatValue = scaleBits > repeatBits ? repeatValue << (scaleBits - repeatBits) : repeatValue >> (repeatBits - scaleBits);
+
+    while (repeatValue)
+    {
+      result |= repeatValue;
+      repeatValue >>= repeatBits;
+    }
+
+    return result;
+  }
+
+  /** Log a message (TRACER BUILDS) */
+  void LogMsg()
+  {
+    Trace(TRACELOC, "ump:(%d:%d:%d:%08X:%08X)", MessageType(), StatusMsg(), Channel(), mWords[0], mWords[1]);
+  }
+
+  /** Print a message (DEBUG BUILDS) */
+  void PrintMsg() const
+  {
+    DBGMSG("ump: offset %i, (%d:%d:%d:%08X:%08X)\n", mOffset, MessageType(), StatusMsg(), Channel(), mWords[0], mWords[1]);
+  }
+
+private:
+  void MakeMidi2Msg(EStatusMsg status, int channel, int group, int byte3, int byte4, int offset)
+  {
+    Clear();
+    mWords[0] = (static_cast<uint32_t>(kMidi2ChannelVoice) << 28) | (static_cast<uint32_t>(group & 0xF) << 24) | (static_cast<uint32_t>(status) << 20)
+              | (static_cast<uint32_t>(channel & 0xF) << 16) | (static_cast<uint32_t>(byte3 & 0xFF) << 8) | static_cast<uint32_t>(byte4 & 0xFF);
+    mOffset = offset;
+  }
+};
+
 /*
 
 IMidiQueue
@@ -668,6 +1097,65 @@ void MyPlug::ProcessBlock(double** inputs, double** outputs, int nFrames)
 
 */
 
+/** A MIDI message sent from the UI, with the time it was sent, see IMidiClock */
+struct ITimedMidiMsg
+{
+  IMidiMsg msg;
+  double time;
+};
+
+/** Converts the times at which MIDI messages were sent from the UI to sample offsets in the block being processed, so that notes played on an
+ * on-screen keyboard keep their timing rather than all landing at the start of the next block.
+ * The messages sent during the interval between the starts of the previous and the current blocks are spread over the current block,
+ * which delays them by one block but removes the jitter
+ * @ingroup IPlugUtilities */
+class IMidiClock
+{
+public:
+  /** @return The time in seconds on a clock shared by all threads, used to timestamp messages */
+  static double Now()
+  {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** Call this on the audio thread at the start of each block, before GetOffset()
+   * @param nFrames The number of frames in the block
+   * @param sampleRate The sample rate */
+  void BeginBlock(int nFrames, double sampleRate)
+  {
+    const double now = Now();
+    const double blockLength = nFrames / sampleRate;
+
+    // after a gap in processing, or an irregular callback, only look back one block
+    if (mLastBlockTime <= 0. || now - mLastBlockTime <= 0. || now - mLastBlockTime > 2. * blockLength)
+      mWindowStart = now - blockLength;
+    else
+      mWindowStart = mLastBlockTime;
+
+    mWindowLength = now - mWindowStart;
+    mLastBlockTime = now;
+    mNFrames = nFrames;
+  }
+
+  /** @param time The time a message was sent, from Now()
+   * @return The sample offset of the message in the current block */
+  int GetOffset(double time) const
+  {
+    if (mNFrames <= 0 || mWindowLength <= 0.)
+      return 0;
+
+    const int offset = static_cast<int>((time - mWindowStart) / mWindowLength * mNFrames);
+    return std::min(std::max(offset, 0), mNFrames - 1);
+  }
+
+private:
+  double mLastBlockTime = 0.;
+  double mWindowStart = 0.;
+  double mWindowLength = 0.;
+  int mNFrames = 0;
+};
+
 #ifndef DEFAULT_BLOCK_SIZE
   #define DEFAULT_BLOCK_SIZE 512
 #endif
@@ -770,6 +1258,7 @@ protected:
   bool Expand()
   {
     if (!mGrow) return false;
+    IPLUG_REALTIME_CHECK(kAllocation, "IMidiQueue::Expand");
     int size = (mSize / mGrow + 1) * mGrow;
 
     void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
@@ -803,4 +1292,198 @@ protected:
   int mFront, mBack;
 };
 
+/** A fixed-capacity queue of MIDI messages sorted by sample offset, used by the API classes to collect the messages a plug-in sends from the audio thread, and by IPlugProcessor to hold incoming messages until their sub-block.
+ * Unlike IMidiQueue it never reallocates, so Add() is realtime safe: when the queue is full the message is dropped and counted, see GetNumDropped() */
+class IMidiOutputQueue
+{
+public:
+  IMidiOutputQueue(int capacity = DEFAULT_BLOCK_SIZE)
+  {
+    Resize(capacity);
+  }
+
+  /** Set the capacity of the queue, discarding any queued messages. This method is not realtime safe */
+  void Resize(int capacity)
+  {
+    mBuf.Resize(std::max(capacity, 0));
+    mFront = mBack = 0;
+  }
+
+  /** Add a message, keeping the queue sorted by offset. Messages with the same offset stay in the order they were added
+   * @return \c true if the message was added, \c false if the queue was full and the message was dropped */
+  bool Add(const IMidiMsg& msg)
+  {
+    if (mBack >= mBuf.GetSize())
+    {
+      if (mFront > 0)
+        Compact();
+      else
+      {
+        mNumDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+
+    IMidiMsg* pBuf = mBuf.Get();
+    int i = mBack;
+
+    while (i > mFront && msg.mOffset < pBuf[i - 1].mOffset)
+    {
+      pBuf[i] = pBuf[i - 1];
+      i--;
+    }
+
+    pBuf[i] = msg;
+    mBack++;
+    return true;
+  }
+
+  /** Remove the message at the front of the queue */
+  void Remove() { mFront++; }
+
+  /** @return \c true if there are no messages in the queue */
+  bool Empty() const { return mFront == mBack; }
+
+  /** @return The number of messages in the queue */
+  int ToDo() const { return mBack - mFront; }
+
+  /** @return The message at the front of the queue, i.e. the one with the lowest offset */
+  const IMidiMsg& Peek() const { return mBuf.Get()[mFront]; }
+
+  /** Move the remaining messages to the front of the queue and subtract nFrames from their offsets, at the end of a block */
+  void Flush(int nFrames)
+  {
+    Compact();
+
+    IMidiMsg* pBuf = mBuf.Get();
+
+    for (int i = 0; i < mBack; i++)
+      pBuf[i].mOffset -= nFrames;
+  }
+
+  /** Remove all the messages */
+  void Clear() { mFront = mBack = 0; }
+
+  /** @return The maximum number of messages that can be queued */
+  int GetCapacity() const { return mBuf.GetSize(); }
+
+  /** @return The number of messages that have been dropped because the queue was full. This method can be called on any thread */
+  int GetNumDropped() const { return mNumDropped.load(std::memory_order_relaxed); }
+
+  /** Reset the count of dropped messages */
+  void ResetNumDropped() { mNumDropped.store(0, std::memory_order_relaxed); }
+
+private:
+  void Compact()
+  {
+    mBack -= mFront;
+
+    if (mBack > 0 && mFront > 0)
+      memmove(mBuf.Get(), mBuf.Get() + mFront, mBack * sizeof(IMidiMsg));
+
+    mFront = 0;
+  }
+
+  WDL_TypedBuf<IMidiMsg> mBuf;
+  int mFront = 0;
+  int mBack = 0;
+  std::atomic<int> mNumDropped {0};
+};
+
+/** A fixed capacity queue of IMidiUMP packets, sorted by offset, for carrying MIDI 2.0 messages alongside IMidiQueue.
+ * Resize() allocates the storage up front, so that Add() never allocates on the audio thread, when the queue is full the packet is dropped instead
+ * @ingroup IPlugStructs */
+class IMidiUMPQueue
+{
+public:
+  IMidiUMPQueue(int capacity = DEFAULT_BLOCK_SIZE)
+  {
+    Resize(capacity);
+  }
+
+  /** Set the capacity of the queue, discarding any queued packets. This method is not realtime safe */
+  void Resize(int capacity)
+  {
+    mBuf.Resize(std::max(capacity, 0));
+    mFront = mBack = 0;
+  }
+
+  /** Add a packet, keeping the queue sorted by offset. Packets with the same offset stay in the order they were added
+   * @return \c true if the packet was added, \c false if the queue was full and the packet was dropped */
+  bool Add(const IMidiUMP& msg)
+  {
+    if (mBack >= mBuf.GetSize())
+    {
+      if (mFront > 0)
+        Compact();
+      else
+      {
+        mNumDropped++;
+        return false;
+      }
+    }
+
+    IMidiUMP* pBuf = mBuf.Get();
+    int i = mBack;
+
+    while (i > mFront && msg.mOffset < pBuf[i - 1].mOffset)
+    {
+      pBuf[i] = pBuf[i - 1];
+      i--;
+    }
+
+    pBuf[i] = msg;
+    mBack++;
+    return true;
+  }
+
+  /** Remove the packet at the front of the queue */
+  void Remove() { mFront++; }
+
+  /** @return \c true if there are no packets in the queue */
+  bool Empty() const { return mFront == mBack; }
+
+  /** @return The number of packets in the queue */
+  int ToDo() const { return mBack - mFront; }
+
+  /** @return The packet at the front of the queue, i.e. the one with the lowest offset */
+  const IMidiUMP& Peek() const { return mBuf.Get()[mFront]; }
+
+  /** Move the remaining packets to the front of the queue and subtract nFrames from their offsets, at the end of a block */
+  void Flush(int nFrames)
+  {
+    Compact();
+
+    IMidiUMP* pBuf = mBuf.Get();
+
+    for (int i = 0; i < mBack; i++)
+      pBuf[i].mOffset -= nFrames;
+  }
+
+  /** Remove all the packets */
+  void Clear() { mFront = mBack = 0; }
+
+  /** @return The maximum number of packets that can be queued */
+  int GetCapacity() const { return mBuf.GetSize(); }
+
+  /** @return The number of packets that have been dropped because the queue was full */
+  int GetNumDropped() const { return mNumDropped; }
+
+private:
+  void Compact()
+  {
+    mBack -= mFront;
+
+    if (mBack > 0 && mFront > 0)
+      memmove(mBuf.Get(), mBuf.Get() + mFront, mBack * sizeof(IMidiUMP));
+
+    mFront = 0;
+  }
+
+  WDL_TypedBuf<IMidiUMP> mBuf;
+  int mFront = 0;
+  int mBack = 0;
+  int mNumDropped = 0;
+};
+
 END_IPLUG_NAMESPACE
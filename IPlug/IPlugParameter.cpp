@@ -15,6 +15,8 @@
 
 #include <cstdio>
 #include <algorithm>
+#include <new>
+#include <typeinfo>
 
 #include "IPlugParameter.h"
 #include "IPlugLogger.h"
@@ -83,12 +85,47 @@ double IParam::ShapeExp::ValueToNormalized(double value, const IParam& param) co
 
 IParam::IParam()
 {
-  mShape = std::make_unique<ShapeLinear>();
+  mShape = new (mShapeStorage) ShapeLinear;
   memset(mName, 0, MAX_PARAM_NAME_LEN * sizeof(char));
   memset(mLabel, 0, MAX_PARAM_LABEL_LEN * sizeof(char));
   memset(mParamGroup, 0, MAX_PARAM_LABEL_LEN * sizeof(char));
 };
 
+IParam::~IParam()
+{
+  if (mShapeIsAllocated)
+    delete mShape;
+  else
+    mShape->~Shape();
+}
+
+void IParam::SetShape(const Shape& shape)
+{
+  if (&shape == mShape)
+    return;
+
+  if (mShapeIsAllocated)
+    delete mShape;
+  else
+    mShape->~Shape();
+
+  // a shape derived from one of the built-in ones may not fit, so the type must match exactly
+  const std::type_info& type = typeid(shape);
+  mShapeIsAllocated = false;
+
+  if (type == typeid(ShapeLinear))
+    mShape = new (mShapeStorage) ShapeLinear(static_cast<const ShapeLinear&>(shape));
+  else if (type == typeid(ShapePowCurve))
+    mShape = new (mShapeStorage) ShapePowCurve(static_cast<const ShapePowCurve&>(shape));
+  else if (type == typeid(ShapeExp))
+    mShape = new (mShapeStorage) ShapeExp(static_cast<const ShapeExp&>(shape));
+  else
+  {
+    mShape = shape.Clone();
+    mShapeIsAllocated = true;
+  }
+}
+
 void IParam::InitBool(const char* name, bool defaultVal, const char* label, int flags, const char* group, const char* offText, const char* onText)
 {
   if (mType == kTypeNone) mType = kTypeBool;
@@ -166,8 +203,10 @@ void IParam::InitDouble(const char* name, double defaultVal, double minVal, doub
     ;
   }
     
-  mShape = std::unique_ptr<Shape>(shape.Clone());
+  SetShape(shape);
   mShape->Init(*this);
+
+  InvalidateDisplayCache();
 }
 
 void IParam::InitFrequency(const char *name, double defaultVal, double minVal, double maxVal, double step, int flags, const char *group)
@@ -245,6 +284,40 @@ void IParam::Init(const IParam& p, const char* searchStr, const char* replaceStr
   }
 }
 
+void IParam::Init(const ParamDesc& desc)
+{
+  switch (desc.type)
+  {
+    case kTypeBool:
+      InitBool(desc.name, desc.defaultVal >= 0.5, desc.label, desc.flags, desc.group, desc.nDisplayTexts > 0 ? desc.displayTexts[0] : "off", desc.nDisplayTexts > 1 ? desc.displayTexts[1] : "on");
+      break;
+    case kTypeEnum:
+      InitEnum(desc.name, static_cast<int>(desc.defaultVal), static_cast<int>(desc.maxVal) + 1, desc.label, desc.flags, desc.group);
+      for (auto i = 0; i < desc.nDisplayTexts; i++)
+        SetDisplayText(i, desc.displayTexts[i]);
+      break;
+    case kTypeInt:
+      InitInt(desc.name, static_cast<int>(desc.defaultVal), static_cast<int>(desc.minVal), static_cast<int>(desc.maxVal), desc.label, desc.flags, desc.group);
+      break;
+    case kTypeDouble:
+    default:
+      switch (desc.shape)
+      {
+        case ParamDesc::EShape::kPowCurve:
+          InitDouble(desc.name, desc.defaultVal, desc.minVal, desc.maxVal, desc.step, desc.label, desc.flags, desc.group, ShapePowCurve(desc.shapeValue), desc.unit);
+          break;
+        case ParamDesc::EShape::kExp:
+          InitDouble(desc.name, desc.defaultVal, desc.minVal, desc.maxVal, desc.step, desc.label, desc.flags, desc.group, ShapeExp(), desc.unit);
+          break;
+        case ParamDesc::EShape::kLinear:
+        default:
+          InitDouble(desc.name, desc.defaultVal, desc.minVal, desc.maxVal, desc.step, desc.label, desc.flags, desc.group, ShapeLinear(), desc.unit);
+          break;
+      }
+      break;
+  }
+}
+
 void IParam::SetDisplayText(double value, const char* str)
 {
   int n = mDisplayTexts.GetSize();
@@ -252,56 +325,80 @@ void IParam::SetDisplayText(double value, const char* str)
   DisplayText* pDT = mDisplayTexts.Get() + n;
   pDT->mValue = value;
   strcpy(pDT->mText, str);
+  InvalidateDisplayCache();
 }
 
 void IParam::SetDisplayPrecision(int precision)
 {
   mDisplayPrecision = precision;
+  InvalidateDisplayCache();
+}
+
+void IParam::InvalidateDisplayCache()
+{
+  while (mDisplayCacheLock.test_and_set(std::memory_order_acquire)) {}
+  mDisplayCache.mValid = false;
+  mDisplayCacheLock.clear(std::memory_order_release);
 }
 
 void IParam::GetDisplay(double value, bool normalized, WDL_String& str, bool withDisplayText) const
 {
   if (normalized) value = FromNormalized(value);
 
+  // display functions may depend on state other than the value, so their results are never cached
   if (mDisplayFunction != nullptr)
   {
     mDisplayFunction(value, str);
     return;
   }
 
-  if (withDisplayText)
+  const bool cacheLocked = !mDisplayCacheLock.test_and_set(std::memory_order_acquire);
+
+  if (cacheLocked && mDisplayCache.mValid && mDisplayCache.mValue == value && mDisplayCache.mWithDisplayText == withDisplayText)
   {
-    const char* displayText = GetDisplayText(value);
+    str.Set(mDisplayCache.mText);
+    mDisplayCacheLock.clear(std::memory_order_release);
+    return;
+  }
 
-    if (CStringHasContents(displayText))
-    {
-      str.Set(displayText, MAX_PARAM_DISPLAY_LEN);
-      return;
-    }
+  const char* displayText = withDisplayText ? GetDisplayText(value) : nullptr;
+
+  if (CStringHasContents(displayText))
+  {
+    str.Set(displayText, MAX_PARAM_DISPLAY_LEN);
   }
+  else
+  {
+    double displayValue = value;
+
+    if (mFlags & kFlagNegateDisplay)
+      displayValue = -displayValue;
 
-  double displayValue = value;
+    // Squash all zeros to positive
+    if (!displayValue) displayValue = 0.0;
 
-  if (mFlags & kFlagNegateDisplay)
-    displayValue = -displayValue;
+    FormatDisplayValue(displayValue, str);
+  }
 
-  // Squash all zeros to positive
-  if (!displayValue) displayValue = 0.0;
+  if (cacheLocked)
+  {
+    mDisplayCache.mValue = value;
+    mDisplayCache.mWithDisplayText = withDisplayText;
+    mDisplayCache.mValid = true;
+    strncpy(mDisplayCache.mText, str.Get(), MAX_PARAM_DISPLAY_LEN - 1);
+    mDisplayCache.mText[MAX_PARAM_DISPLAY_LEN - 1] = '\0';
+    mDisplayCacheLock.clear(std::memory_order_release);
+  }
+}
 
+void IParam::FormatDisplayValue(double displayValue, WDL_String& str) const
+{
   if (mDisplayPrecision == 0)
-  {
     str.SetFormatted(MAX_PARAM_DISPLAY_LEN, "%d", static_cast<int>(round(displayValue)));
-  }
   else if ((mFlags & kFlagSignDisplay) && displayValue)
-  {
-    char fmt[16];
-    snprintf(fmt, 16, "%%+.%df", mDisplayPrecision);
-    str.SetFormatted(MAX_PARAM_DISPLAY_LEN, fmt, displayValue);
-  }
+    str.SetFormatted(MAX_PARAM_DISPLAY_LEN, "%+.*f", mDisplayPrecision, displayValue);
   else
-  {
     str.SetFormatted(MAX_PARAM_DISPLAY_LEN, "%.*f", mDisplayPrecision, displayValue);
-  }
 }
 
 const char* IParam::GetName() const
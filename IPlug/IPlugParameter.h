@@ -16,7 +16,9 @@
  */
 
 #include <atomic>
+#include <cstddef>
 #include <cstring>
+#include <algorithm>
 #include <functional>
 #include <memory>
 
@@ -26,6 +28,8 @@
 
 BEGIN_IPLUG_NAMESPACE
 
+struct ParamDesc;
+
 /** IPlug's parameter class */
 class IParam
 {
@@ -55,6 +59,10 @@ public:
     kFlagSignDisplay      = 0x8,
     /** Indicates that the parameter may influence the state of other parameters */
     kFlagMeta             = 0x10,
+    /** Indicates that the parameter's value should be smoothed by the processor, see ParamSmootherBank */
+    kFlagSmoothed         = 0x20,
+    /** Indicates that the processor should keep a buffer of the parameter's value for every sample of the block, see IPlugProcessor::GetParamBuffer() */
+    kFlagAudioRate        = 0x40,
   };
   
   /** DisplayFunc allows custom parameter display functions, defined by a lambda matching this signature */
@@ -130,6 +138,8 @@ public:
 
   IParam();
 
+  ~IParam();
+
   IParam(const IParam&) = delete;
   IParam& operator=(const IParam&) = delete;
 
@@ -258,6 +268,10 @@ public:
    * @param replaceStr Replace string for modifying the parameter name
    * @param newGroup Group for the new parameter */
   void Init(const IParam& p, const char* searchStr = "", const char* replaceStr = "", const char* newGroup = "");
+
+  /** Initialize the parameter from a descriptor, see ParamDesc
+   * @param desc The descriptor */
+  void Init(const ParamDesc& desc);
   
   /** Convert a textual representation of the parameter value to a double (real value)
    * @param str CString textual representation of the parameter value 
@@ -330,7 +344,7 @@ public:
   
   /** Set the function to translate display values
    * @param func A function conforming to DisplayFunc */
-  void SetDisplayFunc(DisplayFunc func) { mDisplayFunction = func; }
+  void SetDisplayFunc(DisplayFunc func) { mDisplayFunction = func; InvalidateDisplayCache(); }
 
   /** Gets a readable value of the parameter
    * @return double Current value of the parameter */
@@ -480,6 +494,12 @@ public:
 
   /** @return \c true If the parameter is flagged as a "meta" parameter, e.g. one that could modify other parameters */
   bool GetMeta() const { return mFlags & kFlagMeta; }
+
+  /** @return \c true If the parameter's value should be smoothed by the processor */
+  bool GetSmoothed() const { return mFlags & kFlagSmoothed; }
+
+  /** @return \c true If the processor keeps a buffer of the parameter's values, see IPlugProcessor::GetParamBuffer() */
+  bool GetAudioRate() const { return mFlags & kFlagAudioRate; }
  
   /** Get a JSON description of the parameter. 
    * @param json WDL_String to fill with the JSON
@@ -489,6 +509,18 @@ public:
   /** Helper to print the parameter details to debug console in debug builds */
   void PrintDetails() const;
 private:
+  /** Format a numeric display value with the parameter's precision and sign flags
+   * @param displayValue The value to format, after negation if kFlagNegateDisplay is set
+   * @param str WDL_String to fill with the result */
+  void FormatDisplayValue(double displayValue, WDL_String& str) const;
+
+  /** Copy a shape into the parameter. The built-in shapes are constructed in place, so only custom shapes are allocated
+   * @param shape The shape to copy */
+  void SetShape(const Shape& shape);
+
+  /** Called when anything that affects the display string changes, so that GetDisplay() does not return a stale string */
+  void InvalidateDisplayCache();
+
   /** A DisplayText is used to link a certain real value of the parameter with a CString. For example -70 on a decibel gain parameter could instead read "-inf" */
   struct DisplayText
   {
@@ -510,10 +542,93 @@ private:
   char mLabel[MAX_PARAM_LABEL_LEN];
   char mParamGroup[MAX_PARAM_GROUP_LEN];
   
-  std::unique_ptr<Shape> mShape;
+  static constexpr size_t kShapeStorageSize = std::max({sizeof(ShapeLinear), sizeof(ShapePowCurve), sizeof(ShapeExp)});
+
+  Shape* mShape = nullptr;
+  bool mShapeIsAllocated = false;
+  alignas(std::max_align_t) char mShapeStorage[kShapeStorageSize];
   DisplayFunc mDisplayFunction = nullptr;
 
   WDL_TypedBuf<DisplayText> mDisplayTexts;
+
+  /** The last string returned by GetDisplay(), GUI controls and hosts tend to ask for the same value over and over */
+  struct DisplayCache
+  {
+    double mValue = 0.0;
+    bool mWithDisplayText = false;
+    bool mValid = false;
+    char mText[MAX_PARAM_DISPLAY_LEN];
+  };
+
+  mutable DisplayCache mDisplayCache;
+  mutable std::atomic_flag mDisplayCacheLock = ATOMIC_FLAG_INIT; // GetDisplay() can be called from the UI and host threads at once, if the cache is busy it is bypassed
 } WDL_FIXALIGN;
 
+/** A description of a parameter that can be declared constexpr, so that a plug-in's parameters can be described in a static table and initialized in one go with IPluginBase::InitParams(),
+ * rather than with a long list of Init calls. Shapes are stored by value, and all strings must outlive the table, e.g. string literals
+ * @code
+ * static constexpr const char* kModeTexts[] = { "Clean", "Warm", "Hot" };
+ * static constexpr ParamDesc kParamDescs[kNumParams] = {
+ *   ParamDesc::Gain("Gain", 0., -70., 12.),
+ *   ParamDesc::Frequency("Cutoff", 1000., 20., 20000.),
+ *   ParamDesc::Enum("Mode", 0, kModeTexts),
+ * };
+ * @endcode */
+struct ParamDesc
+{
+  /** The shapes that can be used in a descriptor, see IParam::Shape */
+  enum class EShape { kLinear, kPowCurve, kExp };
+
+  IParam::EParamType type = IParam::kTypeDouble;
+  const char* name = "";
+  double defaultVal = 0.;
+  double minVal = 0.;
+  double maxVal = 1.;
+  double step = 0.001;
+  const char* label = "";
+  int flags = 0;
+  const char* group = "";
+  EShape shape = EShape::kLinear;
+  double shapeValue = 1.; // the exponent when shape is EShape::kPowCurve
+  IParam::EParamUnit unit = IParam::kUnitCustom;
+  const char* const* displayTexts = nullptr; // one per step for enum and bool parameters
+  int nDisplayTexts = 0;
+
+  static constexpr ParamDesc Double(const char* name, double defaultVal, double minVal, double maxVal, double step, const char* label = "", int flags = 0, const char* group = "", EShape shape = EShape::kLinear, double shapeValue = 1., IParam::EParamUnit unit = IParam::kUnitCustom)
+  {
+    return { IParam::kTypeDouble, name, defaultVal, minVal, maxVal, step, label, flags, group, shape, shapeValue, unit, nullptr, 0 };
+  }
+
+  static constexpr ParamDesc Int(const char* name, int defaultVal, int minVal, int maxVal, const char* label = "", int flags = 0, const char* group = "")
+  {
+    return { IParam::kTypeInt, name, (double) defaultVal, (double) minVal, (double) maxVal, 1., label, flags | IParam::kFlagStepped, group, EShape::kLinear, 1., IParam::kUnitCustom, nullptr, 0 };
+  }
+
+  static constexpr ParamDesc Bool(const char* name, bool defaultVal, int flags = 0, const char* group = "", const char* const* offOnTexts = nullptr)
+  {
+    return { IParam::kTypeBool, name, defaultVal ? 1. : 0., 0., 1., 1., "", flags | IParam::kFlagStepped, group, EShape::kLinear, 1., IParam::kUnitCustom, offOnTexts, offOnTexts ? 2 : 0 };
+  }
+
+  template <int N>
+  static constexpr ParamDesc Enum(const char* name, int defaultVal, const char* const (&texts)[N], int flags = 0, const char* group = "")
+  {
+    return { IParam::kTypeEnum, name, (double) defaultVal, 0., (double) (N - 1), 1., "", flags | IParam::kFlagStepped, group, EShape::kLinear, 1., IParam::kUnitCustom, texts, N };
+  }
+
+  static constexpr ParamDesc Frequency(const char* name, double defaultVal = 1000., double minVal = 0.1, double maxVal = 10000., double step = 0.1, int flags = 0, const char* group = "")
+  {
+    return Double(name, defaultVal, minVal, maxVal, step, "Hz", flags, group, EShape::kExp, 1., IParam::kUnitFrequency);
+  }
+
+  static constexpr ParamDesc Gain(const char* name, double defaultVal = 0., double minVal = -70., double maxVal = 24., double step = 0.5, int flags = 0, const char* group = "")
+  {
+    return Double(name, defaultVal, minVal, maxVal, step, "dB", flags, group, EShape::kLinear, 1., IParam::kUnitDB);
+  }
+
+  static constexpr ParamDesc Percentage(const char* name, double defaultVal = 0., double minVal = 0., double maxVal = 100., int flags = 0, const char* group = "")
+  {
+    return Double(name, defaultVal, minVal, maxVal, 1., "%", flags, group, EShape::kLinear, 1., IParam::kUnitPercentage);
+  }
+};
+
 END_IPLUG_NAMESPACE
@@ -23,6 +23,12 @@
 #include <windows.h>
 #include <Shlobj.h>
 #include <Shlwapi.h>
+#elif defined OS_LINUX
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 BEGIN_IPLUG_NAMESPACE
@@ -231,6 +237,169 @@ const void* LoadWinResource(const char* resid, const char* type, int& sizeInByte
   }
 }
 
+#elif defined OS_LINUX
+#pragma mark - OS_LINUX
+
+static bool FileExists(const char* path)
+{
+  struct stat st;
+  return stat(path, &st) == 0;
+}
+
+/** Get an XDG base directory, e.g. XDG_CONFIG_HOME, or its default under the user's home directory if the variable isn't set */
+static void GetXDGPath(WDL_String& path, const char* envVar, const char* defaultSubPath)
+{
+  const char* dir = getenv(envVar);
+
+  if (CStringHasContents(dir))
+  {
+    path.Set(dir);
+  }
+  else
+  {
+    UserHomePath(path);
+    path.Append(defaultSubPath);
+  }
+}
+
+void HostPath(WDL_String& path, const char* bundleID)
+{
+  char pathCStr[PATH_MAX];
+  const ssize_t len = readlink("/proc/self/exe", pathCStr, PATH_MAX - 1);
+
+  if (len > 0)
+  {
+    pathCStr[len] = '\0';
+    path.Set(pathCStr);
+    path.remove_filepart(true);
+  }
+  else
+  {
+    path.Set("");
+  }
+}
+
+void PluginPath(WDL_String& path, void* pExtra)
+{
+  // the shared object that contains this function is the plug-in
+  Dl_info info;
+
+  if (dladdr(reinterpret_cast<void*>(&PluginPath), &info) && info.dli_fname)
+  {
+    char pathCStr[PATH_MAX];
+    path.Set(realpath(info.dli_fname, pathCStr) ? pathCStr : info.dli_fname);
+    path.remove_filepart(true);
+  }
+  else
+  {
+    path.Set("");
+  }
+}
+
+void BundleResourcePath(WDL_String& path, void* pExtra)
+{
+  PluginPath(path, pExtra);
+#ifdef VST3_API
+  // Plugin.vst3/Contents/x86_64-linux/Plugin.so has its resources in Plugin.vst3/Contents/Resources
+  path.SetLen(path.GetLength() - 1);
+  path.remove_filepart(true);
+  path.Append("Resources/");
+#else
+  path.Append("resources/");
+#endif
+}
+
+void DesktopPath(WDL_String& path)
+{
+  UserHomePath(path);
+  path.Append("/Desktop");
+}
+
+void UserHomePath(WDL_String & path)
+{
+  const char* home = getenv("HOME");
+  path.Set(home ? home : "");
+}
+
+void AppSupportPath(WDL_String& path, bool isSystem)
+{
+  if (isSystem)
+    path.Set("/usr/share");
+  else
+    GetXDGPath(path, "XDG_DATA_HOME", "/.local/share");
+}
+
+void VST3PresetsPath(WDL_String& path, const char* mfrName, const char* pluginName, bool isSystem)
+{
+  // the locations from the VST3 SDK's documentation of preset files
+  if (isSystem)
+    path.Set("/usr/share/vst3/presets");
+  else
+  {
+    UserHomePath(path);
+    path.Append("/.vst3/presets");
+  }
+
+  path.AppendFormatted(PATH_MAX, "/%s/%s", mfrName, pluginName);
+}
+
+void INIPath(WDL_String& path, const char * pluginName)
+{
+  GetXDGPath(path, "XDG_CONFIG_HOME", "/.config");
+  path.AppendFormatted(PATH_MAX, "/%s", pluginName);
+}
+
+void WebViewCachePath(WDL_String& path)
+{
+  GetXDGPath(path, "XDG_CACHE_HOME", "/.cache");
+  path.Append("/iPlug2/WebViewCache");
+}
+
+EResourceLocation LocateResource(const char* name, const char* type, WDL_String& result, const char*, void* pHInstance, const char* sharedResourcesSubPath)
+{
+  if (CStringHasContents(name))
+  {
+    WDL_String fileName(name);
+    const char* ext = fileName.get_fileext();
+
+    if (!*ext && CStringHasContents(type))
+      fileName.AppendFormatted(64, ".%s", type);
+
+    // first check this bundle
+    BundleResourcePath(result, pHInstance);
+    result.Append(fileName.get_filepart());
+
+    if (FileExists(result.Get()))
+      return EResourceLocation::kAbsolutePath;
+
+    // then check the shared resources folder
+    if (CStringHasContents(sharedResourcesSubPath))
+    {
+      AppSupportPath(result);
+      result.AppendFormatted(PATH_MAX, "/%s/Resources/%s", sharedResourcesSubPath, fileName.get_filepart());
+
+      if (FileExists(result.Get()))
+        return EResourceLocation::kAbsolutePath;
+    }
+
+    // finally check name, which might be a full path - if the plug-in is trying to load a resource at runtime (e.g. skin-able UI)
+    if (FileExists(name))
+    {
+      result.Set(name);
+      return EResourceLocation::kAbsolutePath;
+    }
+  }
+
+  result.Set("");
+  return EResourceLocation::kNotFound;
+}
+
+const void* LoadWinResource(const char* resid, const char* type, int& sizeInBytes, void* pHInstance)
+{
+  sizeInBytes = 0;
+  return nullptr;
+}
+
 #elif defined OS_WEB
 #pragma mark - OS_WEB
 
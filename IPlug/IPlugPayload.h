@@ -0,0 +1,235 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugPayload
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "mutex.h"
+#include "ptrlist.h"
+
+#include "IPlugPlatform.h"
+#include "IPlugRealtimeCheck.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+class IPlugPayloadPool;
+
+/** A reference counted block of data, e.g. a wavetable or an impulse response, that can be passed between the UI, the processor and network layers without copying it.
+ * Payloads are created by an IPlugPayloadPool, see IEditorDelegate::CreatePayload(). Copying an IPlugPayload only adds a reference.
+ * When the last reference is released the memory goes back to the pool, which frees or reuses it on the thread that creates payloads, so a payload can be released on the audio thread */
+class IPlugPayload
+{
+public:
+  IPlugPayload() = default;
+
+  IPlugPayload(const IPlugPayload& other)
+  : mBlock(other.mBlock)
+  {
+    if (mBlock)
+      mBlock->refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  IPlugPayload(IPlugPayload&& other) noexcept
+  : mBlock(other.mBlock)
+  {
+    other.mBlock = nullptr;
+  }
+
+  IPlugPayload& operator=(const IPlugPayload& other)
+  {
+    IPlugPayload copy(other);
+    std::swap(mBlock, copy.mBlock);
+    return *this;
+  }
+
+  IPlugPayload& operator=(IPlugPayload&& other) noexcept
+  {
+    std::swap(mBlock, other.mBlock);
+    return *this;
+  }
+
+  ~IPlugPayload() { Reset(); }
+
+  /** Release this reference, leaving the payload empty. This is realtime safe */
+  inline void Reset();
+
+  /** @return A pointer to the data, or nullptr if the payload is empty */
+  uint8_t* GetData() const { return mBlock ? reinterpret_cast<uint8_t*>(mBlock + 1) : nullptr; }
+
+  /** @return The size of the data in bytes */
+  int GetSize() const { return mBlock ? mBlock->size : 0; }
+
+  /** @return \c true if the payload holds data */
+  explicit operator bool() const { return mBlock != nullptr; }
+
+  /** Give up this reference as a raw pointer, e.g. to pass the payload through an IPlugQueue, which can only hold plain data.
+   * The reference must be taken back with FromDetached() */
+  void* Detach()
+  {
+    Block* pBlock = mBlock;
+    mBlock = nullptr;
+    return pBlock;
+  }
+
+  /** Take back a reference given up with Detach() */
+  static IPlugPayload FromDetached(void* pDetached)
+  {
+    IPlugPayload payload;
+    payload.mBlock = static_cast<Block*>(pDetached);
+    return payload;
+  }
+
+private:
+  friend class IPlugPayloadPool;
+
+  /** The header of a payload's memory, which is followed by the data */
+  struct alignas(16) Block
+  {
+    std::atomic<int> refCount;
+    int size;
+    int capacity;
+    IPlugPayloadPool* pPool;
+    Block* pNextReturned; // link in the pool's list of released blocks
+  };
+
+  Block* mBlock = nullptr;
+};
+
+/** Creates IPlugPayloads and recycles their memory.
+ * Create() can be called on any non-realtime thread. Released payloads are returned to the pool with a lock-free push, and are reused or freed by the next call to Create() or Collect() */
+class IPlugPayloadPool
+{
+public:
+  IPlugPayloadPool() = default;
+  IPlugPayloadPool(const IPlugPayloadPool&) = delete;
+  IPlugPayloadPool& operator=(const IPlugPayloadPool&) = delete;
+
+  ~IPlugPayloadPool()
+  {
+    Collect();
+
+    for (auto i = 0; i < mCache.GetSize(); i++)
+      free(mCache.Get(i));
+  }
+
+  /** Create a payload, this is not realtime safe
+   * @param size The size of the data in bytes
+   * @param pData Optional data to copy into the payload
+   * @return The payload, with a reference count of 1 */
+  IPlugPayload Create(int size, const void* pData = nullptr)
+  {
+    IPLUG_REALTIME_CHECK(kLock, "IPlugPayloadPool::Create");
+    WDL_MutexLock lock(&mMutex);
+    CollectReturned();
+
+    using Block = IPlugPayload::Block;
+    Block* pBlock = nullptr;
+
+    // reuse the smallest cached block that is large enough
+    for (auto i = 0; i < mCache.GetSize(); i++)
+    {
+      Block* pCached = mCache.Get(i);
+
+      if (pCached->capacity >= size && (!pBlock || pCached->capacity < pBlock->capacity))
+        pBlock = pCached;
+    }
+
+    if (pBlock)
+      mCache.DeletePtr(pBlock);
+    else
+    {
+      pBlock = static_cast<Block*>(malloc(sizeof(Block) + size));
+
+      if (!pBlock)
+        return IPlugPayload();
+
+      new (&pBlock->refCount) std::atomic<int>(0);
+      pBlock->capacity = size;
+      pBlock->pPool = this;
+    }
+
+    pBlock->refCount.store(1, std::memory_order_relaxed);
+    pBlock->size = size;
+    pBlock->pNextReturned = nullptr;
+
+    if (pData)
+      memcpy(reinterpret_cast<uint8_t*>(pBlock + 1), pData, size);
+
+    IPlugPayload payload;
+    payload.mBlock = pBlock;
+    return payload;
+  }
+
+  /** Free the memory of released payloads, apart from a few small ones that are kept for reuse. Call this periodically on a non-realtime thread, e.g. on a timer */
+  void Collect()
+  {
+    WDL_MutexLock lock(&mMutex);
+    CollectReturned();
+  }
+
+private:
+  friend class IPlugPayload;
+
+  static constexpr int kMaxCachedBlocks = 4;
+  static constexpr int kMaxCachedSize = 1 << 20; // larger blocks, e.g. impulse responses, are always freed
+
+  /** Called by IPlugPayload::Reset() when the last reference is released, on any thread */
+  void Return(IPlugPayload::Block* pBlock)
+  {
+    pBlock->pNextReturned = mReturned.load(std::memory_order_relaxed);
+
+    while (!mReturned.compare_exchange_weak(pBlock->pNextReturned, pBlock, std::memory_order_release, std::memory_order_relaxed))
+    {}
+  }
+
+  /** Move the released blocks to the cache, freeing the ones that don't fit in it. mMutex must be locked */
+  void CollectReturned()
+  {
+    IPlugPayload::Block* pBlock = mReturned.exchange(nullptr, std::memory_order_acquire);
+
+    while (pBlock)
+    {
+      IPlugPayload::Block* pNext = pBlock->pNextReturned;
+
+      if (mCache.GetSize() < kMaxCachedBlocks && pBlock->capacity <= kMaxCachedSize)
+        mCache.Add(pBlock);
+      else
+        free(pBlock);
+
+      pBlock = pNext;
+    }
+  }
+
+  std::atomic<IPlugPayload::Block*> mReturned {nullptr};
+  WDL_PtrList<IPlugPayload::Block> mCache;
+  WDL_Mutex mMutex;
+};
+
+void IPlugPayload::Reset()
+{
+  if (mBlock && mBlock->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    mBlock->pPool->Return(mBlock);
+
+  mBlock = nullptr;
+}
+
+END_IPLUG_NAMESPACE
@@ -13,9 +13,17 @@
  * @brief IPluginBase implementation
  */
 
+#include <algorithm>
+
 #include "IPlugPluginBase.h"
 #include "wdlendian.h"
 #include "wdl_base64.h"
+#include "IPlugMappedResource.h"
+#include "IPlugRealtimeCheck.h"
+
+#ifdef IPLUG_STATE_ZLIB
+#include "zlib.h"
+#endif
 
 using namespace iplug;
 
@@ -28,9 +36,102 @@ IPluginBase::IPluginBase(int nParams, int nPresets)
 
 IPluginBase::~IPluginBase()
 {
+  if (mSnapshotThread.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mSnapshotMutex);
+      mSnapshotThreadRunning = false;
+    }
+
+    mSnapshotCondition.notify_all();
+    mSnapshotThread.join();
+  }
+
   mPresets.Empty(true);
 }
 
+int IPluginBase::AddParamGroup(const char* name)
+{
+  if (mParamGroupIdxForName.Get(name, -1) < 0)
+  {
+    // it is kept after the groups found in the parameters
+    mParamGroups.Add(name);
+    UpdateParamGroupIndex();
+  }
+
+  return mParamGroupIdxForName.Get(name, -1) + 1;
+}
+
+void IPluginBase::UpdateParamGroupIndex()
+{
+  const int nParams = NParams();
+
+  // groups that were added without any parameters are kept after those found in the parameters
+  WDL_PtrList<const char> prevGroups;
+  for (auto g = 0; g < mParamGroups.GetSize(); g++)
+    prevGroups.Add(mParamGroups.Get(g));
+
+  mParamGroups.Empty();
+  mParamGroupIdxForName.DeleteAll();
+  mParamGroupForParam.Resize(nParams);
+
+  for (auto p = 0; p < nParams; p++)
+  {
+    const char* paramGroupName = GetParam(p)->GetGroup();
+    int groupIdx = -1;
+
+    if (CStringHasContents(paramGroupName))
+    {
+      groupIdx = mParamGroupIdxForName.Get(paramGroupName, -1);
+
+      if (groupIdx < 0)
+      {
+        groupIdx = mParamGroups.GetSize();
+        mParamGroups.Add(paramGroupName);
+        mParamGroupIdxForName.Insert(paramGroupName, groupIdx);
+      }
+    }
+
+    mParamGroupForParam.Get()[p] = groupIdx;
+  }
+
+  for (auto g = 0; g < prevGroups.GetSize(); g++)
+  {
+    if (mParamGroupIdxForName.Get(prevGroups.Get(g), -1) < 0)
+    {
+      mParamGroupIdxForName.Insert(prevGroups.Get(g), mParamGroups.GetSize());
+      mParamGroups.Add(prevGroups.Get(g));
+    }
+  }
+
+  // count the parameters in each group, then lay them out contiguously
+  const int nGroups = mParamGroups.GetSize();
+  mParamGroupStarts.Resize(nGroups + 1);
+  memset(mParamGroupStarts.Get(), 0, (nGroups + 1) * sizeof(int));
+
+  for (auto p = 0; p < nParams; p++)
+  {
+    if (mParamGroupForParam.Get()[p] > -1)
+      mParamGroupStarts.Get()[mParamGroupForParam.Get()[p] + 1]++;
+  }
+
+  for (auto g = 0; g < nGroups; g++)
+    mParamGroupStarts.Get()[g + 1] += mParamGroupStarts.Get()[g];
+
+  WDL_TypedBuf<int> writePos;
+  writePos.Resize(nGroups);
+  memcpy(writePos.Get(), mParamGroupStarts.Get(), nGroups * sizeof(int));
+  mParamGroupParams.Resize(mParamGroupStarts.Get()[nGroups]);
+
+  for (auto p = 0; p < nParams; p++)
+  {
+    const int groupIdx = mParamGroupForParam.Get()[p];
+
+    if (groupIdx > -1)
+      mParamGroupParams.Get()[writePos.Get()[groupIdx]++] = p;
+  }
+}
+
 int IPluginBase::GetPluginVersion(bool decimal) const
 {
   if (decimal)
@@ -75,6 +176,8 @@ const char* IPluginBase::GetAPIStr() const
     case kAPIAPP: return "APP";
     case kAPIWAM: return "WAM";
     case kAPIWEB: return "WEB";
+    case kAPICLAP: return "CLAP";
+    case kAPIBENCH: return "BENCH";
     default: return "";
   }
 }
@@ -104,36 +207,392 @@ void IPluginBase::GetBuildInfoStr(WDL_String& str, const char* date, const char*
 bool IPluginBase::SerializeParams(IByteChunk& chunk) const
 {
   TRACE
-  bool savedOK = true;
-  int i, n = mParams.GetSize();
-  for (i = 0; i < n && savedOK; ++i)
+  const int n = mParams.GetSize();
+  uint8_t* pDst = chunk.PutSpace(n * sizeof(double)); // one resize for all the values
+
+  if (!pDst)
+    return false;
+
+  for (int i = 0; i < n; ++i)
   {
-    IParam* pParam = mParams.Get(i);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetName(), pParam->Value());
-    double v = pParam->Value();
-    savedOK &= (chunk.Put(&v) > 0);
+    const double v = mParams.Get(i)->Value();
+    memcpy(pDst + i * sizeof(double), &v, sizeof(double));
   }
-  return savedOK;
+
+#ifdef TRACER_BUILD
+  for (int i = 0; i < n; ++i)
+    Trace(TRACELOC, "%d %s %f", i, mParams.Get(i)->GetName(), mParams.Get(i)->Value());
+#endif
+
+  return true;
 }
 
 int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
 {
   TRACE
-  int i, n = mParams.GetSize(), pos = startPos;
-  ENTER_PARAMS_MUTEX
-  for (i = 0; i < n && pos >= 0; ++i)
+  const int n = mParams.GetSize();
+  // a chunk that ends early sets the parameters it has, and fails
+  const int nAvailable = startPos >= 0 ? std::min(n, (chunk.Size() - startPos) / static_cast<int>(sizeof(double))) : 0;
+  const uint8_t* pSrc = chunk.GetSpan(nAvailable * sizeof(double), startPos);
+  const int endPos = (pSrc && nAvailable == n) ? startPos + n * static_cast<int>(sizeof(double)) : -1;
+
+  BeginParamRestore();
+
+  for (int i = 0; pSrc && i < nAvailable; ++i)
   {
-    IParam* pParam = mParams.Get(i);
-    double v = 0.0;
-    pos = chunk.Get(&v, pos);
-    pParam->Set(v);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetName(), pParam->Value());
+    double v;
+    memcpy(&v, pSrc + i * sizeof(double), sizeof(double));
+    mParams.Get(i)->Set(v);
   }
 
-  OnParamReset(kPresetRecall);
-  LEAVE_PARAMS_MUTEX
+  EndParamRestore();
 
-  return pos;
+  return endPos;
+}
+
+void IPluginBase::BeginParamRestore()
+{
+  if (!mDeferParamReset)
+  {
+    ENTER_PARAMS_MUTEX
+  }
+}
+
+void IPluginBase::EndParamRestore()
+{
+#ifdef TRACER_BUILD
+  for (int i = 0; i < NParams(); ++i)
+    Trace(TRACELOC, "%d %s %f", i, mParams.Get(i)->GetName(), mParams.Get(i)->Value());
+#endif
+
+  if (mDeferParamReset)
+  {
+    // the values are atomic, so the mutex isn't needed to set them, and the DSP is updated on the audio thread by ApplyDeferredParamReset()
+    mParamResetPending.store(true, std::memory_order_release);
+
+    for (int i = 0; i < NParams(); ++i)
+      OnParamChangeUI(i, kPresetRecall);
+  }
+  else
+  {
+    OnParamReset(kPresetRecall);
+    LEAVE_PARAMS_MUTEX
+  }
+}
+
+#pragma mark - State snapshots
+
+static std::shared_ptr<const IByteChunk> SerializeSnapshot(const IStateSnapshot& snapshot)
+{
+  auto pData = std::make_shared<IByteChunk>();
+  pData->Reserve(snapshot.GetSizeHint());
+  return snapshot.Serialize(*pData) ? pData : nullptr;
+}
+
+void IPluginBase::SetStateSnapshot(std::shared_ptr<const IStateSnapshot> snapshot)
+{
+  IPLUG_REALTIME_CHECK(kLock, "IPluginBase::SetStateSnapshot");
+  {
+    std::lock_guard<std::mutex> lock(mSnapshotMutex);
+    mSnapshot = snapshot;
+    
+#ifndef OS_WEB // without threads the snapshot is serialized when the state is
+    if (mSnapshot && !mSnapshotThreadRunning)
+    {
+      mSnapshotThreadRunning = true;
+      mSnapshotThread = std::thread(&IPluginBase::SnapshotThreadFunc, this);
+    }
+#endif
+  }
+
+  mSnapshotCondition.notify_all();
+}
+
+void IPluginBase::SnapshotThreadFunc()
+{
+  std::unique_lock<std::mutex> lock(mSnapshotMutex);
+
+  while (true)
+  {
+    mSnapshotCondition.wait(lock, [this]() { return !mSnapshotThreadRunning || (mSnapshot && mSnapshot != mSnapshotEncoded); });
+
+    if (!mSnapshotThreadRunning)
+      break;
+
+    std::shared_ptr<const IStateSnapshot> snapshot = mSnapshot;
+    mSnapshotEncoding = snapshot;
+    lock.unlock();
+
+    std::shared_ptr<const IByteChunk> pData = SerializeSnapshot(*snapshot);
+
+    lock.lock();
+    mSnapshotEncoding = nullptr;
+    mSnapshotEncoded = snapshot; // even if it failed, so that it isn't tried again
+    mSnapshotData = pData;
+    mSnapshotCondition.notify_all();
+  }
+}
+
+bool IPluginBase::SerializeStateSnapshot(IByteChunk& chunk) const
+{
+  std::unique_lock<std::mutex> lock(mSnapshotMutex);
+
+  if (!mSnapshot)
+    return true;
+
+  // finishing the serialization that is in progress is quicker than starting again
+  mSnapshotCondition.wait(lock, [this]() { return mSnapshotEncoding != mSnapshot; });
+
+  std::shared_ptr<const IStateSnapshot> snapshot = mSnapshot;
+
+  if (mSnapshotEncoded == snapshot && mSnapshotData)
+  {
+    std::shared_ptr<const IByteChunk> pData = mSnapshotData;
+    lock.unlock();
+    return chunk.PutChunk(pData.get()) > 0 || !pData->Size();
+  }
+
+  lock.unlock();
+  chunk.Reserve(chunk.Size() + snapshot->GetSizeHint());
+  return snapshot->Serialize(chunk);
+}
+
+#pragma mark - Compact state
+
+namespace
+{
+  constexpr int kCompactParamsMagic = 'IPcp';
+  constexpr int kCompactParamsVersion = 1;
+  constexpr int kCompactParamsDeflated = 1; // flags
+  constexpr int kCompactParamsHeaderInts = 7; // the last is the size of the payload that follows
+
+  // the type of a value, in the low two bits of its record's first varint
+  enum ECompactValue { kCompactInt8 = 0, kCompactInt32, kCompactFloat, kCompactDouble };
+
+  void PutVarInt(WDL_TypedBuf<uint8_t>& buf, uint32_t v)
+  {
+    while (v >= 0x80)
+    {
+      buf.Add(static_cast<uint8_t>(v | 0x80));
+      v >>= 7;
+    }
+
+    buf.Add(static_cast<uint8_t>(v));
+  }
+
+  bool GetVarInt(const uint8_t*& p, const uint8_t* pEnd, uint32_t& v)
+  {
+    v = 0;
+
+    for (int shift = 0; p < pEnd && shift < 35; shift += 7)
+    {
+      const uint8_t b = *p++;
+      v |= static_cast<uint32_t>(b & 0x7f) << shift;
+
+      if (!(b & 0x80))
+        return true;
+    }
+
+    return false;
+  }
+
+  void PutCompactValue(WDL_TypedBuf<uint8_t>& buf, uint32_t idxDelta, double v)
+  {
+    const float f = static_cast<float>(v);
+    const int8_t i8 = static_cast<int8_t>(std::max(-128., std::min(127., v)));
+    const int32_t i32 = static_cast<int32_t>(std::max(-2147483648., std::min(2147483647., v)));
+    ECompactValue type;
+
+    if (static_cast<double>(i8) == v)
+      type = kCompactInt8;
+    else if (static_cast<double>(i32) == v)
+      type = kCompactInt32;
+    else if (static_cast<double>(f) == v)
+      type = kCompactFloat;
+    else
+      type = kCompactDouble;
+
+    PutVarInt(buf, (idxDelta << 2) | type);
+
+    switch (type)
+    {
+      case kCompactInt8: buf.Add(static_cast<uint8_t>(i8)); break;
+      case kCompactInt32: buf.Add(reinterpret_cast<const uint8_t*>(&i32), sizeof(i32)); break;
+      case kCompactFloat: buf.Add(reinterpret_cast<const uint8_t*>(&f), sizeof(f)); break;
+      case kCompactDouble: buf.Add(reinterpret_cast<const uint8_t*>(&v), sizeof(v)); break;
+    }
+  }
+
+  bool GetCompactValue(const uint8_t*& p, const uint8_t* pEnd, ECompactValue type, double& v)
+  {
+    static constexpr int kSizes[] = { 1, 4, 4, 8 };
+
+    if (pEnd - p < kSizes[type])
+      return false;
+
+    switch (type)
+    {
+      case kCompactInt8: v = static_cast<int8_t>(*p); break;
+      case kCompactInt32: { int32_t i32; memcpy(&i32, p, sizeof(i32)); v = i32; break; }
+      case kCompactFloat: { float f; memcpy(&f, p, sizeof(f)); v = f; break; }
+      case kCompactDouble: memcpy(&v, p, sizeof(v)); break;
+    }
+
+    p += kSizes[type];
+    return true;
+  }
+}
+
+bool IPluginBase::IsCompactParams(const IByteChunk& chunk, int startPos)
+{
+  int magic = 0;
+  return chunk.Get(&magic, startPos) > 0 && magic == kCompactParamsMagic;
+}
+
+int IPluginBase::GetSerializedParamsSize(const IByteChunk& chunk, int startPos) const
+{
+  int size = NParams() * static_cast<int>(sizeof(double));
+
+  if (IsCompactParams(chunk, startPos))
+  {
+    int payloadSize = -1;
+    const int headerSize = kCompactParamsHeaderInts * static_cast<int>(sizeof(int));
+
+    if (chunk.Get(&payloadSize, startPos + headerSize - static_cast<int>(sizeof(int))) < 0 || payloadSize < 0)
+      return -1;
+
+    size = headerSize + payloadSize;
+  }
+
+  return (startPos >= 0 && startPos + size <= chunk.Size()) ? size : -1;
+}
+
+bool IPluginBase::SerializeParamsCompact(IByteChunk& chunk, bool compress) const
+{
+  TRACE
+  WDL_TypedBuf<uint8_t> records;
+  int nStored = 0;
+  int prevIdx = -1;
+
+  for (int i = 0; i < NParams(); ++i)
+  {
+    const IParam* pParam = mParams.Get(i);
+    const double v = pParam->Value();
+
+    if (v == pParam->GetDefault())
+      continue;
+
+    PutCompactValue(records, static_cast<uint32_t>(i - prevIdx - 1), v);
+    prevIdx = i;
+    nStored++;
+  }
+
+  int flags = 0;
+  const int rawSize = records.GetSize();
+  const uint8_t* pPayload = records.Get();
+  int payloadSize = rawSize;
+
+#ifdef IPLUG_STATE_ZLIB
+  WDL_TypedBuf<uint8_t> deflated;
+
+  if (compress && rawSize)
+  {
+    uLongf deflatedSize = compressBound(rawSize);
+
+    // only keep the deflated records if they are smaller
+    if (deflated.ResizeOK(static_cast<int>(deflatedSize)) && compress2(deflated.Get(), &deflatedSize, records.Get(), rawSize, Z_DEFAULT_COMPRESSION) == Z_OK
+        && static_cast<int>(deflatedSize) < rawSize)
+    {
+      flags |= kCompactParamsDeflated;
+      pPayload = deflated.Get();
+      payloadSize = static_cast<int>(deflatedSize);
+    }
+  }
+#endif
+
+  // magic, version, flags, the number of parameters when saved, the number of records, the size of the records, the size of the payload, then the payload
+  const int header[kCompactParamsHeaderInts] = { kCompactParamsMagic, kCompactParamsVersion, flags, NParams(), nStored, rawSize, payloadSize };
+  uint8_t* pDst = chunk.PutSpace(static_cast<int>(sizeof(header)) + payloadSize);
+
+  if (!pDst)
+    return false;
+
+  memcpy(pDst, header, sizeof(header));
+
+  if (payloadSize)
+    memcpy(pDst + sizeof(header), pPayload, payloadSize);
+
+  return true;
+}
+
+int IPluginBase::UnserializeParamsCompact(const IByteChunk& chunk, int startPos)
+{
+  TRACE
+  int header[kCompactParamsHeaderInts];
+  const uint8_t* pHeader = chunk.GetSpan(static_cast<int>(sizeof(header)), startPos);
+
+  if (!pHeader)
+    return -1;
+
+  memcpy(header, pHeader, sizeof(header));
+  const int version = header[1], flags = header[2], nStored = header[4], rawSize = header[5], payloadSize = header[6];
+
+  if (header[0] != kCompactParamsMagic || version > kCompactParamsVersion || nStored < 0 || rawSize < 0 || payloadSize < 0)
+    return -1;
+
+  const int dataPos = startPos + static_cast<int>(sizeof(header));
+  const uint8_t* pPayload = payloadSize ? chunk.GetSpan(payloadSize, dataPos) : pHeader;
+
+  if (!pPayload)
+    return -1;
+
+  const uint8_t* pRecords = pPayload;
+
+#ifdef IPLUG_STATE_ZLIB
+  WDL_TypedBuf<uint8_t> inflated;
+
+  if (flags & kCompactParamsDeflated)
+  {
+    uLongf inflatedSize = rawSize;
+
+    if (!inflated.ResizeOK(rawSize) || uncompress(inflated.Get(), &inflatedSize, pPayload, payloadSize) != Z_OK || static_cast<int>(inflatedSize) != rawSize)
+      return -1;
+
+    pRecords = inflated.Get();
+  }
+#else
+  if (flags & kCompactParamsDeflated)
+    return -1;
+#endif
+
+  // parameters that aren't stored are at their defaults
+  BeginParamRestore();
+
+  for (int i = 0; i < NParams(); ++i)
+    mParams.Get(i)->SetToDefault();
+
+  const uint8_t* p = pRecords;
+  const uint8_t* pEnd = pRecords + rawSize;
+  int idx = -1;
+
+  for (int r = 0; r < nStored; ++r)
+  {
+    uint32_t key;
+    double v;
+
+    if (!GetVarInt(p, pEnd, key) || !GetCompactValue(p, pEnd, static_cast<ECompactValue>(key & 3), v))
+      break;
+
+    idx += static_cast<int>(key >> 2) + 1;
+
+    // parameters added to the end of the plug-in since the state was saved keep their defaults, and ones removed are ignored
+    if (idx < NParams())
+      mParams.Get(idx)->Set(v);
+  }
+
+  EndParamRestore();
+
+  return dataPos + payloadSize;
 }
 
 void IPluginBase::InitParamRange(int startIdx, int endIdx, int countStart, const char* nameFmtStr, double defaultVal, double minVal, double maxVal, double step, const char *label, int flags, const char *group, const IParam::Shape& shape, IParam::EParamUnit unit, IParam::DisplayFunc displayFunc)
@@ -144,6 +603,18 @@ void IPluginBase::InitParamRange(int startIdx, int endIdx, int countStart, const
     nameStr.SetFormatted(MAX_PARAM_NAME_LEN, nameFmtStr, countStart + (p-startIdx));
     GetParam(p)->InitDouble(nameStr.Get(), defaultVal, minVal, maxVal, step, label, flags, group, shape, unit, displayFunc);
   }
+
+  UpdateParamGroupIndex();
+}
+
+void IPluginBase::InitParams(const ParamDesc* pDescs, int nDescs, int startIdx)
+{
+  assert(startIdx + nDescs <= NParams());
+
+  for (auto i = 0; i < nDescs; i++)
+    GetParam(startIdx + i)->Init(pDescs[i]);
+
+  UpdateParamGroupIndex();
 }
 
 void IPluginBase::CloneParamRange(int cloneStartIdx, int cloneEndIdx, int startIdx, const char* searchStr, const char* replaceStr, const char* newGroup)
@@ -155,6 +626,8 @@ void IPluginBase::CloneParamRange(int cloneStartIdx, int cloneEndIdx, int startI
     GetParam(outIdx)->Init(*pParam, searchStr, replaceStr, newGroup);
     GetParam(outIdx)->Set(pParam->Value());
   }
+
+  UpdateParamGroupIndex();
 }
 
 void IPluginBase::CopyParamValues(int startIdx, int destIdx, int nParams)
@@ -169,29 +642,27 @@ void IPluginBase::CopyParamValues(int startIdx, int destIdx, int nParams)
   }
 }
 
-void IPluginBase::CopyParamValues(const char* inGroup, const char *outGroup)
+void IPluginBase::CopyParamValues(const char* inGroup, const char *outGroup, bool informHost)
 {
-  WDL_PtrList<IParam> inParams, outParams;
-  
-  for (auto p = 0; p < NParams(); p++)
-  {
-    IParam* pParam = GetParam(p);
-    if(strcmp(pParam->GetGroup(), inGroup) == 0)
-    {
-      inParams.Add(pParam);
-    }
-    else if(strcmp(pParam->GetGroup(), outGroup) == 0)
-    {
-      outParams.Add(pParam);
-    }
-  }
-  
-  assert(inParams.GetSize() == outParams.GetSize());
-  
-  for (auto p = 0; p < inParams.GetSize(); p++)
+  const int inGroupIdx = GetParamGroupIdx(inGroup);
+  const int outGroupIdx = GetParamGroupIdx(outGroup);
+
+  if (inGroupIdx < 0 || outGroupIdx < 0)
+    return;
+
+  const int nParams = NParamsInGroup(outGroupIdx);
+  const int* pInParams = GetParamsInGroup(inGroupIdx);
+  const int* pOutParams = GetParamsInGroup(outGroupIdx);
+
+  assert(NParamsInGroup(inGroupIdx) == nParams);
+
+  for (auto p = 0; p < nParams; p++)
   {
-    outParams.Get(p)->Set(inParams.Get(p)->Value());
+    GetParam(pOutParams[p])->Set(GetParam(pInParams[p])->Value());
   }
+
+  if (informHost)
+    InformHostOfParamValueChanges(pOutParams, nParams);
 }
 
 void IPluginBase::ForParamInRange(int startIdx, int endIdx, std::function<void(int paramIdx, IParam&)>func)
@@ -204,13 +675,16 @@ void IPluginBase::ForParamInRange(int startIdx, int endIdx, std::function<void(i
 
 void IPluginBase::ForParamInGroup(const char* paramGroup, std::function<void (int paramIdx, IParam&)> func)
 {
-  for (auto p = 0; p < NParams(); p++)
+  const int groupIdx = GetParamGroupIdx(paramGroup);
+
+  if (groupIdx < 0)
+    return;
+
+  const int* pParams = GetParamsInGroup(groupIdx);
+
+  for (auto p = 0; p < NParamsInGroup(groupIdx); p++)
   {
-    IParam* pParam = GetParam(p);
-    if(strcmp(pParam->GetGroup(), paramGroup) == 0)
-    {
-      func(p, *pParam);
-    }
+    func(pParams[p], *GetParam(pParams[p]));
   }
 }
 
@@ -226,11 +700,16 @@ void IPluginBase::DefaultParamValues(int startIdx, int endIdx)
                     });
 }
 
-void IPluginBase::DefaultParamValues(const char* paramGroup)
+void IPluginBase::DefaultParamValues(const char* paramGroup, bool informHost)
 {
   ForParamInGroup(paramGroup, [](int paramIdx, IParam& param) {
                       param.SetToDefault();
                     });
+
+  const int groupIdx = GetParamGroupIdx(paramGroup);
+
+  if (informHost && groupIdx > -1)
+    InformHostOfParamValueChanges(GetParamsInGroup(groupIdx), NParamsInGroup(groupIdx));
 }
 
 void IPluginBase::RandomiseParamValues()
@@ -243,9 +722,14 @@ void IPluginBase::RandomiseParamValues(int startIdx, int endIdx)
   ForParamInRange(startIdx, endIdx, [&](int paramIdx, IParam& param) { param.SetNormalized( static_cast<float>(std::rand()/(static_cast<float>(RAND_MAX)+1.f)) ); });
 }
 
-void IPluginBase::RandomiseParamValues(const char *paramGroup)
+void IPluginBase::RandomiseParamValues(const char *paramGroup, bool informHost)
 {
   ForParamInGroup(paramGroup, [&](int paramIdx, IParam& param) { param.SetNormalized( static_cast<float>(std::rand()/(static_cast<float>(RAND_MAX)+1.f)) ); });
+
+  const int groupIdx = GetParamGroupIdx(paramGroup);
+
+  if (informHost && groupIdx > -1)
+    InformHostOfParamValueChanges(GetParamsInGroup(groupIdx), NParamsInGroup(groupIdx));
 }
 
 void IPluginBase::PrintParamValues()
@@ -272,6 +756,9 @@ static IPreset* GetNextUninitializedPreset(WDL_PtrList<IPreset>* pPresets)
 
 void IPluginBase::MakeDefaultPreset(const char* name, int nPresets)
 {
+  IByteChunk state; // the presets are all the same, so the state is only serialized once
+  SerializeState(state);
+
   for (int i = 0; i < nPresets; ++i)
   {
     IPreset* pPreset = GetNextUninitializedPreset(&mPresets);
@@ -279,7 +766,7 @@ void IPluginBase::MakeDefaultPreset(const char* name, int nPresets)
     {
       pPreset->mInitialized = true;
       strcpy(pPreset->mName, (name ? name : "Empty"));
-      SerializeState(pPreset->mChunk);
+      pPreset->mChunk.PutChunk(&state);
     }
   }
 }
@@ -293,15 +780,17 @@ void IPluginBase::MakePreset(const char* name, ...)
     strcpy(pPreset->mName, name);
     
     int i, n = NParams();
+    uint8_t* pDst = pPreset->mChunk.PutSpace(n * sizeof(double)); // one resize for all the values
     
     double v = 0.0;
     va_list vp;
     va_start(vp, name);
-    for (i = 0; i < n; ++i)
+    for (i = 0; i < n && pDst; ++i)
     {
       GET_PARAM_FROM_VARARG(GetParam(i)->Type(), vp, v);
-      pPreset->mChunk.Put(&v);
+      memcpy(pDst + i * sizeof(double), &v, sizeof(double));
     }
+    va_end(vp);
   }
 }
 
@@ -343,8 +832,8 @@ void IPluginBase::MakePresetFromNamedParams(const char* name, int nParamsNamed,
       {
         *pV = GetParam(i)->Value();
       }
-      pPreset->mChunk.Put(pV);
     }
+    pPreset->mChunk.PutBytes(vals.Get(), n * sizeof(double));
   }
 }
 
@@ -424,6 +913,7 @@ bool IPluginBase::RestorePreset(int idx)
     }
     else
     {
+      pPreset->Resolve();
       restoredOK = (UnserializeState(pPreset->mChunk, 0) > 0);
     }
     
@@ -468,6 +958,7 @@ void IPluginBase::ModifyCurrentPreset(const char* name)
   if (mCurrentPresetIdx >= 0 && mCurrentPresetIdx < mPresets.GetSize())
   {
     IPreset* pPreset = mPresets.Get(mCurrentPresetIdx);
+    pPreset->mSource = nullptr;
     pPreset->mChunk.Clear();
     
     Trace(TRACELOC, "%d %s", mCurrentPresetIdx, pPreset->mName);
@@ -496,7 +987,10 @@ bool IPluginBase::SerializePresets(IByteChunk& chunk) const
     chunk.Put(&pPreset->mInitialized);
     if (pPreset->mInitialized)
     {
-      savedOK &= (chunk.PutChunk(&(pPreset->mChunk)) > 0);
+      if (pPreset->mSource)
+        savedOK &= (chunk.PutBytes(pPreset->mSource->GetData() + pPreset->mSourcePos, pPreset->mSourceSize) > 0);
+      else
+        savedOK &= (chunk.PutChunk(&(pPreset->mChunk)) > 0);
     }
   }
   return savedOK;
@@ -506,6 +1000,7 @@ int IPluginBase::UnserializePresets(const IByteChunk& chunk, int startPos)
 {
   TRACE
   WDL_String name;
+  std::shared_ptr<IByteChunk> pSource; // a copy of the bank, shared by the presets whose states are left in it
   int n = mPresets.GetSize(), pos = startPos;
   for (int i = 0; i < n && pos >= 0; ++i)
   {
@@ -515,9 +1010,28 @@ int IPluginBase::UnserializePresets(const IByteChunk& chunk, int startPos)
     
     Trace(TRACELOC, "%d %s", i, pPreset->mName);
     
+    pPreset->mSource = nullptr;
     pos = chunk.Get<bool>(&(pPreset->mInitialized), pos);
-    if (pPreset->mInitialized)
+    if (pPreset->mInitialized && pos >= 0)
     {
+      const int stateSize = GetStateSize(chunk, pos);
+
+      if (stateSize >= 0 && pos + stateSize <= chunk.Size())
+      {
+        if (!pSource)
+        {
+          pSource = std::make_shared<IByteChunk>();
+          pSource->PutChunk(&chunk);
+        }
+
+        pPreset->mSource = pSource;
+        pPreset->mSourcePos = pos;
+        pPreset->mSourceSize = stateSize;
+        pPreset->mChunk.Clear();
+        pos += stateSize;
+        continue;
+      }
+
       pos = UnserializeState(chunk, pos);
       if (pos > 0)
       {
@@ -628,6 +1142,7 @@ void IPluginBase::DumpPresetBlob(const char* filename) const
   
   char buf[MAX_BLOB_LENGTH];
   
+  mPresets.Get(mCurrentPresetIdx)->Resolve();
   IByteChunk* pPresetChunk = &mPresets.Get(mCurrentPresetIdx)->mChunk;
   uint8_t* byteStart = pPresetChunk->GetData();
   
@@ -637,273 +1152,288 @@ void IPluginBase::DumpPresetBlob(const char* filename) const
   fclose(fp);
 }
 
-// confusing... IByteChunk will force storage as little endian on big endian platforms,
-// so when we use it here, since vst fxp/fxb files are big endian, we need to swap the endianess
-// regardless of the endianness of the host, and on big endian hosts it will get swapped back to
-// big endian
+#pragma mark - FXP/FXB
+
+// VST2 fxp/fxb files are big endian. IByteChunk stores values in native byte order, so the 32 bit values of the headers and the parameter values are swapped
+// on little endian platforms, whole arrays at a time in loops that compilers vectorize to byte shuffles
+
+/** The 32 bit values at the start of an fxp file, or of each program of an 'FxBk' bank, followed by the 28 byte name */
+struct FXPHeader
+{
+  int32_t chunkMagic;
+  int32_t byteSize;
+  int32_t fxpMagic;
+  int32_t fxpVersion;
+  int32_t pluginID;
+  int32_t pluginVersion;
+  int32_t numParams;
+};
+
+/** The 32 bit values at the start of an fxb file, followed by 124 reserved bytes */
+struct FXBHeader
+{
+  int32_t chunkMagic;
+  int32_t byteSize;
+  int32_t fxbMagic;
+  int32_t fxbVersion;
+  int32_t pluginID;
+  int32_t pluginVersion;
+  int32_t numPgms;
+  int32_t currentPgm;
+};
+
+static constexpr int kFXPNameSize = 28;
+static constexpr int kFXBFutureSize = 124;
+
+static void SwapBytes32IfLE(uint8_t* pData, int n)
+{
+#ifdef WDL_LITTLE_ENDIAN
+  for (int i = 0; i < n; i++)
+  {
+    uint32_t v;
+    memcpy(&v, pData + i * 4, 4);
+    v = WDL_bswap32(v);
+    memcpy(pData + i * 4, &v, 4);
+  }
+#endif
+}
+
+/** Append an array of 32 bit values to a chunk as big endian */
+static void PutBigEndian32(IByteChunk& chunk, const void* pSrc, int n)
+{
+  uint8_t* pDst = chunk.PutSpace(n * 4);
+
+  if (pDst)
+  {
+    memcpy(pDst, pSrc, n * 4);
+    SwapBytes32IfLE(pDst, n);
+  }
+}
+
+/** Read an array of big endian 32 bit values from a chunk
+ * @return The position after the values, or -1 if the chunk is too short */
+static int GetBigEndian32(const IByteChunk& chunk, void* pDst, int n, int startPos)
+{
+  const uint8_t* pSrc = chunk.GetSpan(n * 4, startPos);
+
+  if (!pSrc)
+    return -1;
+
+  memcpy(pDst, pSrc, n * 4);
+  SwapBytes32IfLE(static_cast<uint8_t*>(pDst), n);
+  return startPos + n * 4;
+}
+
+/** Append a name padded with zeros to its fixed size in the file */
+static void PutFXName(IByteChunk& chunk, const char* name)
+{
+  char prgName[kFXPNameSize];
+  memset(prgName, 0, kFXPNameSize);
+  memcpy(prgName, name, std::min(strlen(name), static_cast<size_t>(kFXPNameSize - 1)));
+  chunk.PutBytes(prgName, kFXPNameSize); // not PutStr (we want all 28 bytes)
+}
+
+static bool WriteFXFile(const char* file, const IByteChunk& chunk)
+{
+  IPLUG_REALTIME_CHECK(kFileIO, "writing an FXP/FXB file");
+  FILE* fp = fopen(file, "wb");
+
+  if (!fp)
+    return false;
+
+  const bool writtenOK = fwrite(chunk.GetData(), chunk.Size(), 1, fp) == 1;
+  fclose(fp);
+  return writtenOK;
+}
+
 bool IPluginBase::SavePresetAsFXP(const char* file) const
 {
-  if (CStringHasContents(file))
+  if (!CStringHasContents(file))
+    return false;
+
+  IByteChunk pgm;
+  IByteChunk state;
+  const bool stateChunks = DoesStateChunks();
+
+  if (stateChunks)
   {
-    FILE* fp = fopen(file, "wb");
-    
-    IByteChunk pgm;
-    
-    int32_t chunkMagic = WDL_bswap32('CcnK');
-    int32_t byteSize = 0;
-    int32_t fxpMagic;
-    int32_t fxpVersion = WDL_bswap32(kFXPVersionNum);
-    int32_t pluginID = WDL_bswap32(GetUniqueID());
-    int32_t pluginVersion = WDL_bswap32(GetPluginVersion(true));
-    int32_t numParams = WDL_bswap32(NParams());
-    char prgName[28];
-    memset(prgName, 0, 28);
-    strcpy(prgName, GetPresetName(GetCurrentPresetIdx()));
-    
-    pgm.Put(&chunkMagic);
-    
-    if (DoesStateChunks())
-    {
-      IByteChunk state;
-      int32_t chunkSize;
-      
-      fxpMagic = WDL_bswap32('FPCh');
-      
-      IByteChunk::InitChunkWithIPlugVer(state);
-      SerializeState(state);
-      
-      chunkSize = WDL_bswap32(state.Size());
-      byteSize = WDL_bswap32(state.Size() + 60);
-      
-      pgm.Put(&byteSize);
-      pgm.Put(&fxpMagic);
-      pgm.Put(&fxpVersion);
-      pgm.Put(&pluginID);
-      pgm.Put(&pluginVersion);
-      pgm.Put(&numParams);
-      pgm.PutBytes(prgName, 28); // not PutStr (we want all 28 bytes)
-      pgm.Put(&chunkSize);
-      pgm.PutBytes(state.GetData(), state.Size());
-    }
-    else
-    {
-      fxpMagic = WDL_bswap32('FxCk');
-      //byteSize = WDL_bswap32(20 + 28 + (NParams() * 4) );
-      pgm.Put(&byteSize);
-      pgm.Put(&fxpMagic);
-      pgm.Put(&fxpVersion);
-      pgm.Put(&pluginID);
-      pgm.Put(&pluginVersion);
-      pgm.Put(&numParams);
-      pgm.PutBytes(prgName, 28); // not PutStr (we want all 28 bytes)
-      
-      for (int i = 0; i< NParams(); i++)
-      {
-        WDL_EndianFloat v32;
-        v32.f = (float) GetParam(i)->GetNormalized();
-        unsigned int swapped = WDL_bswap32(v32.int32);
-        pgm.Put(&swapped);
-      }
-    }
-    
-    fwrite(pgm.GetData(), pgm.Size(), 1, fp);
-    fclose(fp);
-    
-    return true;
+    IByteChunk::InitChunkWithIPlugVer(state);
+    SerializeState(state);
   }
-  return false;
+
+  pgm.Reserve(sizeof(FXPHeader) + kFXPNameSize + (stateChunks ? sizeof(int32_t) + state.Size() : NParams() * sizeof(float)));
+
+  const FXPHeader header = { 'CcnK', stateChunks ? state.Size() + 60 : 0, stateChunks ? 'FPCh' : 'FxCk', kFXPVersionNum, GetUniqueID(), GetPluginVersion(true), NParams() };
+  PutBigEndian32(pgm, &header, sizeof(FXPHeader) / 4);
+  PutFXName(pgm, GetPresetName(GetCurrentPresetIdx()));
+
+  if (stateChunks)
+  {
+    const int32_t chunkSize = state.Size();
+    PutBigEndian32(pgm, &chunkSize, 1);
+    pgm.PutChunk(&state);
+  }
+  else
+  {
+    WDL_TypedBuf<float> values;
+    values.Resize(NParams());
+
+    for (int i = 0; i < NParams(); i++)
+      values.Get()[i] = (float) GetParam(i)->GetNormalized();
+
+    PutBigEndian32(pgm, values.Get(), NParams());
+  }
+
+  return WriteFXFile(file, pgm);
 }
 
 bool IPluginBase::SaveBankAsFXB(const char* file) const
 {
-  if (CStringHasContents(file))
+  if (!CStringHasContents(file))
+    return false;
+
+  IByteChunk bnk;
+  const bool stateChunks = DoesStateChunks();
+  FXBHeader header = { 'CcnK', 0, stateChunks ? 'FBCh' : 'FxBk', kFXBVersionNum, GetUniqueID(), GetPluginVersion(true), NPresets(), GetCurrentPresetIdx() };
+  char future[kFXBFutureSize];
+  memset(future, 0, kFXBFutureSize);
+
+  if (stateChunks)
   {
-    FILE* fp = fopen(file, "wb");
-    
-    IByteChunk bnk;
-    
-    int32_t chunkMagic = WDL_bswap32('CcnK');
-    int32_t byteSize = 0;
-    int32_t fxbMagic;
-    int32_t fxbVersion = WDL_bswap32(kFXBVersionNum);
-    int32_t pluginID = WDL_bswap32(GetUniqueID());
-    int32_t pluginVersion = WDL_bswap32(GetPluginVersion(true));
-    int32_t numPgms =  WDL_bswap32(NPresets());
-    int32_t currentPgm = WDL_bswap32(GetCurrentPresetIdx());
-    char future[124];
-    memset(future, 0, 124);
-    
-    bnk.Put(&chunkMagic);
-    
-    if (DoesStateChunks())
-    {
-      IByteChunk state;
-      int32_t chunkSize;
-      
-      fxbMagic = WDL_bswap32('FBCh');
-      
-      IByteChunk::InitChunkWithIPlugVer(state);
-      SerializePresets(state);
-      
-      chunkSize = WDL_bswap32(state.Size());
-      byteSize = WDL_bswap32(160 + state.Size() );
-      
-      bnk.Put(&byteSize);
-      bnk.Put(&fxbMagic);
-      bnk.Put(&fxbVersion);
-      bnk.Put(&pluginID);
-      bnk.Put(&pluginVersion);
-      bnk.Put(&numPgms);
-      bnk.Put(&currentPgm);
-      bnk.PutBytes(&future, 124);
-      
-      bnk.Put(&chunkSize);
-      bnk.PutBytes(state.GetData(), state.Size());
-    }
-    else
+    IByteChunk state;
+    IByteChunk::InitChunkWithIPlugVer(state);
+    SerializePresets(state);
+
+    header.byteSize = 160 + state.Size();
+    const int32_t chunkSize = state.Size();
+
+    bnk.Reserve(sizeof(FXBHeader) + kFXBFutureSize + sizeof(int32_t) + state.Size());
+    PutBigEndian32(bnk, &header, sizeof(FXBHeader) / 4);
+    bnk.PutBytes(future, kFXBFutureSize);
+    PutBigEndian32(bnk, &chunkSize, 1);
+    bnk.PutChunk(&state);
+  }
+  else
+  {
+    const int nParams = NParams();
+    const FXPHeader pgmHeader = { 'CcnK', 0, 'FxCk', kFXPVersionNum, GetUniqueID(), GetPluginVersion(true), nParams };
+    WDL_TypedBuf<float> values;
+    values.Resize(nParams);
+
+    bnk.Reserve(sizeof(FXBHeader) + kFXBFutureSize + NPresets() * (sizeof(FXPHeader) + kFXPNameSize + nParams * sizeof(float)));
+    PutBigEndian32(bnk, &header, sizeof(FXBHeader) / 4);
+    bnk.PutBytes(future, kFXBFutureSize);
+
+    for (int p = 0; p < NPresets(); p++)
     {
-      fxbMagic = WDL_bswap32('FxBk');
-      
-      bnk.Put(&byteSize);
-      bnk.Put(&fxbMagic);
-      bnk.Put(&fxbVersion);
-      bnk.Put(&pluginID);
-      bnk.Put(&pluginVersion);
-      bnk.Put(&numPgms);
-      bnk.Put(&currentPgm);
-      bnk.PutBytes(&future, 124);
-      
-      int32_t fxpMagic = WDL_bswap32('FxCk');
-      int32_t fxpVersion = WDL_bswap32(kFXPVersionNum);
-      int32_t numParams = WDL_bswap32(NParams());
-      
-      for (int p = 0; p < NPresets(); p++)
+      IPreset* pPreset = mPresets.Get(p);
+      pPreset->Resolve();
+
+      PutBigEndian32(bnk, &pgmHeader, sizeof(FXPHeader) / 4);
+      PutFXName(bnk, pPreset->mName);
+
+      // the preset holds the serialized parameter values, which are checked for once rather than read one at a time
+      const uint8_t* pSerialized = pPreset->mChunk.GetSpan(nParams * sizeof(double), 0);
+
+      for (int i = 0; i < nParams; i++)
       {
-        IPreset* pPreset = mPresets.Get(p);
-        
-        char prgName[28];
-        memset(prgName, 0, 28);
-        strcpy(prgName, pPreset->mName);
-        
-        bnk.Put(&chunkMagic);
-        //byteSize = WDL_bswap32(20 + 28 + (NParams() * 4) );
-        bnk.Put(&byteSize);
-        bnk.Put(&fxpMagic);
-        bnk.Put(&fxpVersion);
-        bnk.Put(&pluginID);
-        bnk.Put(&pluginVersion);
-        bnk.Put(&numParams);
-        bnk.PutBytes(prgName, 28);
-        
-        int pos = 0;
-        
-        for (int i = 0; i< NParams(); i++)
-        {
-          double v = 0.0;
-          pos = pPreset->mChunk.Get(&v, pos);
-          
-          WDL_EndianFloat v32;
-          v32.f = (float) GetParam(i)->ToNormalized(v);
-          uint32_t swapped = WDL_bswap32(v32.int32);
-          bnk.Put(&swapped);
-        }
+        double v = 0.0;
+
+        if (pSerialized)
+          memcpy(&v, pSerialized + i * sizeof(double), sizeof(double));
+
+        values.Get()[i] = (float) GetParam(i)->ToNormalized(v);
       }
+
+      PutBigEndian32(bnk, values.Get(), nParams);
     }
-    
-    fwrite(bnk.GetData(), bnk.Size(), 1, fp);
-    fclose(fp);
-    
-    return true;
   }
-  else
-    return false;
+
+  return WriteFXFile(file, bnk);
 }
 
 bool IPluginBase::LoadPresetFromFXP(const char* file)
 {
+  if (!CStringHasContents(file))
+    return false;
+
+  // the file is read in place, and the pages that aren't needed are never read from disk
+  const IPlugMappedResource resource(file);
+
+  if (!resource.IsValid() || resource.GetSize() > 0x7FFFFFFF)
+    return false;
+
+  const IByteChunk pgm = IByteChunk::View(resource.Get(), static_cast<int>(resource.GetSize()));
+
+  FXPHeader header;
+  char prgName[kFXPNameSize + 1] = {};
+  int pos = GetBigEndian32(pgm, &header, sizeof(FXPHeader) / 4, 0);
+  pos = pgm.GetBytes(prgName, kFXPNameSize, pos);
+
+  if (pos < 0) return false;
+  if (header.chunkMagic != 'CcnK') return false;
+  if (header.fxpVersion != kFXPVersionNum) return false; // TODO: what if a host saves as a different version?
+  if (header.pluginID != GetUniqueID()) return false;
+  //if (header.pluginVersion != GetPluginVersion(true)) return false; // TODO: provide mechanism for loading earlier versions
+  //if (header.numParams != NParams()) return false; // TODO: provide mechanism for loading earlier versions with less params
+
+  if (DoesStateChunks() && header.fxpMagic == 'FPCh')
+  {
+    int32_t chunkSize;
+    pos = GetBigEndian32(pgm, &chunkSize, 1, pos);
+
+    IByteChunk::GetIPlugVerFromChunk(pgm, pos);
+    UnserializeState(pgm, pos);
+    ModifyCurrentPreset(prgName);
+    RestorePreset(GetCurrentPresetIdx());
+    InformHostOfPresetChange();
+
+    return true;
+  }
+  else if (header.fxpMagic == 'FxCk') // Due to the big Endian-ness of FXP/FXB format we cannot call SerializeParams()
+  {
+    WDL_TypedBuf<float> values;
+    values.Resize(NParams());
+
+    if (GetBigEndian32(pgm, values.Get(), NParams(), pos) < 0)
+      return false;
+
+    ENTER_PARAMS_MUTEX
+    for (int i = 0; i < NParams(); i++)
+      GetParam(i)->SetNormalized((double) values.Get()[i]);
+    LEAVE_PARAMS_MUTEX
+
+    ModifyCurrentPreset(prgName);
+    RestorePreset(GetCurrentPresetIdx());
+    InformHostOfPresetChange();
+
+    return true;
+  }
+
+  return false;
+}
+
+static bool ReadBankFile(const char* file, IByteChunk& bnk)
+{
+  IPLUG_REALTIME_CHECK(kFileIO, "reading an FXP/FXB file");
   if (CStringHasContents(file))
   {
     FILE* fp = fopen(file, "rb");
     
     if (fp)
     {
-      IByteChunk pgm;
       long fileSize;
       
       fseek(fp , 0 , SEEK_END);
       fileSize = ftell(fp);
       rewind(fp);
       
-      pgm.Resize((int) fileSize);
-      fread(pgm.GetData(), fileSize, 1, fp);
+      bnk.Resize((int) fileSize);
+      const bool readOK = fileSize > 0 && fread(bnk.GetData(), fileSize, 1, fp) == 1;
       
       fclose(fp);
       
-      int pos = 0;
-      
-      int32_t chunkMagic;
-      int32_t byteSize = 0;
-      int32_t fxpMagic;
-      int32_t fxpVersion;
-      int32_t pluginID;
-      int32_t pluginVersion;
-      int32_t numParams;
-      char prgName[28];
-      
-      pos = pgm.Get(&chunkMagic, pos);
-      chunkMagic = WDL_bswap_if_le(chunkMagic);
-      pos = pgm.Get(&byteSize, pos);
-      byteSize = WDL_bswap_if_le(byteSize);
-      pos = pgm.Get(&fxpMagic, pos);
-      fxpMagic = WDL_bswap_if_le(fxpMagic);
-      pos = pgm.Get(&fxpVersion, pos);
-      fxpVersion = WDL_bswap_if_le(fxpVersion);
-      pos = pgm.Get(&pluginID, pos);
-      pluginID = WDL_bswap_if_le(pluginID);
-      pos = pgm.Get(&pluginVersion, pos);
-      pluginVersion = WDL_bswap_if_le(pluginVersion);
-      pos = pgm.Get(&numParams, pos);
-      numParams = WDL_bswap_if_le(numParams);
-      pos = pgm.GetBytes(prgName, 28, pos);
-      
-      if (chunkMagic != 'CcnK') return false;
-      if (fxpVersion != kFXPVersionNum) return false; // TODO: what if a host saves as a different version?
-      if (pluginID != GetUniqueID()) return false;
-      //if (pluginVersion != GetPluginVersion(true)) return false; // TODO: provide mechanism for loading earlier versions
-      //if (numParams != NParams()) return false; // TODO: provide mechanism for loading earlier versions with less params
-      
-      if (DoesStateChunks() && fxpMagic == 'FPCh')
-      {
-        int32_t chunkSize;
-        pos = pgm.Get(&chunkSize, pos);
-        chunkSize = WDL_bswap_if_le(chunkSize);
-        
-        IByteChunk::GetIPlugVerFromChunk(pgm, pos);
-        UnserializeState(pgm, pos);
-        ModifyCurrentPreset(prgName);
-        RestorePreset(GetCurrentPresetIdx());
-        InformHostOfPresetChange();
-        
-        return true;
-      }
-      else if (fxpMagic == 'FxCk') // Due to the big Endian-ness of FXP/FXB format we cannot call SerializeParams()
-      {
-        ENTER_PARAMS_MUTEX
-        for (int i = 0; i< NParams(); i++)
-        {
-          WDL_EndianFloat v32;
-          pos = pgm.Get(&v32.int32, pos);
-          v32.int32 = WDL_bswap_if_le(v32.int32);
-          GetParam(i)->SetNormalized((double) v32.f);
-        }
-        LEAVE_PARAMS_MUTEX
-        
-        ModifyCurrentPreset(prgName);
-        RestorePreset(GetCurrentPresetIdx());
-        InformHostOfPresetChange();
-        
-        return true;
-      }
+      return readOK;
     }
   }
   
@@ -912,135 +1442,104 @@ bool IPluginBase::LoadPresetFromFXP(const char* file)
 
 bool IPluginBase::LoadBankFromFXB(const char* file)
 {
-  if (CStringHasContents(file))
+  if (!CStringHasContents(file))
+    return false;
+
+  // the bank is read in place, UnserializePresets() keeps its own copy of the presets' data if it needs one
+  const IPlugMappedResource resource(file);
+
+  if (!resource.IsValid() || resource.GetSize() > 0x7FFFFFFF)
+    return false;
+
+  return LoadBankFromFXBChunk(IByteChunk::View(resource.Get(), static_cast<int>(resource.GetSize())));
+}
+
+void IPluginBase::LoadBankFromFXBAsync(const char* file, std::function<void(bool)> completionHandler)
+{
+  WDL_String path(file);
+  
+  mBankLoadCompletion = completionHandler;
+  mBankLoad = std::async(std::launch::async, [path]() {
+    auto pBank = std::make_shared<IByteChunk>();
+    return ReadBankFile(path.Get(), *pBank) ? pBank : nullptr;
+  });
+}
+
+void IPluginBase::PollBankLoad()
+{
+  if (!mBankLoad.valid() || mBankLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return;
+  
+  std::shared_ptr<IByteChunk> pBank = mBankLoad.get();
+  const bool loadedOK = pBank && LoadBankFromFXBChunk(*pBank);
+  
+  if (mBankLoadCompletion)
+    mBankLoadCompletion(loadedOK);
+  
+  mBankLoadCompletion = nullptr;
+}
+
+bool IPluginBase::LoadBankFromFXBChunk(const IByteChunk& bnk)
+{
+  FXBHeader header;
+  char future[kFXBFutureSize];
+  int pos = GetBigEndian32(bnk, &header, sizeof(FXBHeader) / 4, 0);
+  pos = bnk.GetBytes(future, kFXBFutureSize, pos);
+  
+  if (pos < 0) return false;
+  if (header.chunkMagic != 'CcnK') return false;
+  //if (header.fxbVersion != kFXBVersionNum) return false; // TODO: what if a host saves as a different version?
+  if (header.pluginID != GetUniqueID()) return false;
+  //if (header.pluginVersion != GetPluginVersion(true)) return false; // TODO: provide mechanism for loading earlier versions
+  //if (header.numPgms != NPresets()) return false; // TODO: provide mechanism for loading earlier versions with less params
+  
+  if (DoesStateChunks() && header.fxbMagic == 'FBCh')
   {
-    FILE* fp = fopen(file, "rb");
+    int32_t chunkSize;
+    pos = GetBigEndian32(bnk, &chunkSize, 1, pos);
     
-    if (fp)
+    IByteChunk::GetIPlugVerFromChunk(bnk, pos);
+    UnserializePresets(bnk, pos);
+    //RestorePreset(header.currentPgm);
+    InformHostOfPresetChange();
+    return true;
+  }
+  else if (header.fxbMagic == 'FxBk') // Due to the big Endian-ness of FXP/FXB format we cannot call SerializeParams()
+  {
+    FXPHeader pgmHeader;
+    char prgName[kFXPNameSize + 1] = {};
+    WDL_TypedBuf<float> values;
+    values.Resize(NParams());
+    
+    for (int i = 0; i < header.numPgms; i++)
     {
-      IByteChunk bnk;
-      long fileSize;
-      
-      fseek(fp , 0 , SEEK_END);
-      fileSize = ftell(fp);
-      rewind(fp);
+      pos = GetBigEndian32(bnk, &pgmHeader, sizeof(FXPHeader) / 4, pos);
       
-      bnk.Resize((int) fileSize);
-      fread(bnk.GetData(), fileSize, 1, fp);
-      
-      fclose(fp);
+      if (pos < 0) return false;
+      if (pgmHeader.chunkMagic != 'CcnK') return false;
+      if (pgmHeader.fxpMagic != 'FxCk') return false;
+      if (pgmHeader.fxpVersion != kFXPVersionNum) return false;
+      if (pgmHeader.numParams != NParams()) return false;
       
-      int pos = 0;
+      pos = bnk.GetBytes(prgName, kFXPNameSize, pos);
+      pos = GetBigEndian32(bnk, values.Get(), NParams(), pos);
       
-      int32_t chunkMagic;
-      int32_t byteSize = 0;
-      int32_t fxbMagic;
-      int32_t fxbVersion;
-      int32_t pluginID;
-      int32_t pluginVersion;
-      int32_t numPgms;
-      int32_t currentPgm;
-      char future[124];
-      memset(future, 0, 124);
+      if (pos < 0) return false;
       
-      pos = bnk.Get(&chunkMagic, pos);
-      chunkMagic = WDL_bswap_if_le(chunkMagic);
-      pos = bnk.Get(&byteSize, pos);
-      byteSize = WDL_bswap_if_le(byteSize);
-      pos = bnk.Get(&fxbMagic, pos);
-      fxbMagic = WDL_bswap_if_le(fxbMagic);
-      pos = bnk.Get(&fxbVersion, pos);
-      fxbVersion = WDL_bswap_if_le(fxbVersion);
-      pos = bnk.Get(&pluginID, pos);
-      pluginID = WDL_bswap_if_le(pluginID);
-      pos = bnk.Get(&pluginVersion, pos);
-      pluginVersion = WDL_bswap_if_le(pluginVersion);
-      pos = bnk.Get(&numPgms, pos);
-      numPgms = WDL_bswap_if_le(numPgms);
-      pos = bnk.Get(&currentPgm, pos);
-      currentPgm = WDL_bswap_if_le(currentPgm);
-      pos = bnk.GetBytes(future, 124, pos);
+      RestorePreset(i);
       
-      if (chunkMagic != 'CcnK') return false;
-      //if (fxbVersion != kFXBVersionNum) return false; // TODO: what if a host saves as a different version?
-      if (pluginID != GetUniqueID()) return false;
-      //if (pluginVersion != GetPluginVersion(true)) return false; // TODO: provide mechanism for loading earlier versions
-      //if (numPgms != NPresets()) return false; // TODO: provide mechanism for loading earlier versions with less params
+      ENTER_PARAMS_MUTEX
+      for (int j = 0; j < NParams(); j++)
+        GetParam(j)->SetNormalized((double) values.Get()[j]);
+      LEAVE_PARAMS_MUTEX
       
-      if (DoesStateChunks() && fxbMagic == 'FBCh')
-      {
-        int32_t chunkSize;
-        pos = bnk.Get(&chunkSize, pos);
-        chunkSize = WDL_bswap_if_le(chunkSize);
-        
-        IByteChunk::GetIPlugVerFromChunk(bnk, pos);
-        UnserializePresets(bnk, pos);
-        //RestorePreset(currentPgm);
-        InformHostOfPresetChange();
-        return true;
-      }
-      else if (fxbMagic == 'FxBk') // Due to the big Endian-ness of FXP/FXB format we cannot call SerializeParams()
-      {
-        int32_t chunkMagic;
-        int32_t byteSize;
-        int32_t fxpMagic;
-        int32_t fxpVersion;
-        int32_t pluginID;
-        int32_t pluginVersion;
-        int32_t numParams;
-        char prgName[28];
-        
-        for(int i = 0; i<numPgms; i++)
-        {
-          pos = bnk.Get(&chunkMagic, pos);
-          chunkMagic = WDL_bswap_if_le(chunkMagic);
-          
-          pos = bnk.Get(&byteSize, pos);
-          byteSize = WDL_bswap_if_le(byteSize);
-          
-          pos = bnk.Get(&fxpMagic, pos);
-          fxpMagic = WDL_bswap_if_le(fxpMagic);
-          
-          pos = bnk.Get(&fxpVersion, pos);
-          fxpVersion = WDL_bswap_if_le(fxpVersion);
-          
-          pos = bnk.Get(&pluginID, pos);
-          pluginID = WDL_bswap_if_le(pluginID);
-          
-          pos = bnk.Get(&pluginVersion, pos);
-          pluginVersion = WDL_bswap_if_le(pluginVersion);
-          
-          pos = bnk.Get(&numParams, pos);
-          numParams = WDL_bswap_if_le(numParams);
-          
-          if (chunkMagic != 'CcnK') return false;
-          if (fxpMagic != 'FxCk') return false;
-          if (fxpVersion != kFXPVersionNum) return false;
-          if (numParams != NParams()) return false;
-          
-          pos = bnk.GetBytes(prgName, 28, pos);
-          
-          RestorePreset(i);
-          
-          ENTER_PARAMS_MUTEX
-          for (int j = 0; j< NParams(); j++)
-          {
-            WDL_EndianFloat v32;
-            pos = bnk.Get(&v32.int32, pos);
-            v32.int32 = WDL_bswap_if_le(v32.int32);
-            GetParam(j)->SetNormalized((double) v32.f);
-          }
-          LEAVE_PARAMS_MUTEX
-          
-          ModifyCurrentPreset(prgName);
-        }
-        
-        RestorePreset(currentPgm);
-        InformHostOfPresetChange();
-        
-        return true;
-      }
+      ModifyCurrentPreset(prgName);
     }
+    
+    RestorePreset(header.currentPgm);
+    InformHostOfPresetChange();
+    
+    return true;
   }
   
   return false;
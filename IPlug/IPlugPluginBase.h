@@ -15,6 +15,15 @@
  * @copydoc IPluginBase
  */
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "assocarray.h"
+
 #include "IPlugDelegate_select.h"
 #include "IPlugParameter.h"
 #include "IPlugStructs.h"
@@ -105,18 +114,44 @@ public:
   /** @return The number of unique parameter groups identified */
   int NParamGroups() const { return mParamGroups.GetSize(); }
   
-  /** Called to add a parameter group name, when a unique group name is discovered
+  /** Called to add a parameter group name, when a unique group name is discovered. Groups are discovered from the parameters automatically, so this is only needed for groups that have no parameters
    * @param name CString for the unique group name
-   * @return Number of parameter groups */
-  int AddParamGroup(const char* name) { mParamGroups.Add(name); return NParamGroups(); }
+   * @return The index of the group + 1, which is the number of parameter groups if the group is new */
+  int AddParamGroup(const char* name);
   
   /** Get the parameter group name as a particular index
    * @param idx The index to return
    * @return CString for the unique group name */
   const char* GetParamGroupName(int idx) const { return mParamGroups.Get(idx); }
+
+  /** @param name The name of a parameter group
+   * @return The index of the group, or -1 if there is no group with this name */
+  int GetParamGroupIdx(const char* name) const { return mParamGroupIdxForName.Get(name, -1); }
+
+  /** @param paramIdx The index of a parameter
+   * @return The index of the parameter's group, or -1 if the parameter doesn't have a group */
+  int GetParamGroupIdxForParam(int paramIdx) const { return paramIdx < mParamGroupForParam.GetSize() ? mParamGroupForParam.Get()[paramIdx] : -1; }
+
+  /** @param groupIdx The index of a parameter group
+   * @return The number of parameters in the group */
+  int NParamsInGroup(int groupIdx) const { return mParamGroupStarts.Get()[groupIdx + 1] - mParamGroupStarts.Get()[groupIdx]; }
+
+  /** @param groupIdx The index of a parameter group
+   * @return Pointer to the indices of the parameters in the group, in ascending order. There are NParamsInGroup() of them */
+  const int* GetParamsInGroup(int groupIdx) const { return mParamGroupParams.Get() + mParamGroupStarts.Get()[groupIdx]; }
+
+  /** Build the parameter group index, which the group methods above read, so that they can be called from any thread. It is built when the plug-in's constructor has returned,
+   * and by InitParamRange(), InitParams() and CloneParamRange(). Call this on the main thread if you change the groups of parameters in another way, e.g. with IParam::InitDouble() after the constructor,
+   * or before using the group methods in the constructor */
+  void UpdateParamGroupIndex();
   
   /** Implemented by the API class, call this if you update parameter labels and hopefully the host should update it's displays (not applicable to all APIs) */
   virtual void InformHostOfParameterDetailsChange() {};
+
+  /** Implemented by the API class, called after a bulk change to parameter values (e.g. DefaultParamValues() on a group), to inform the host of all the new values at once
+   * @param pParamIdxs Pointer to the indices of the parameters that changed
+   * @param nParams The number of parameters that changed */
+  virtual void InformHostOfParamValueChanges(const int* pParamIdxs, int nParams) {};
     
 #pragma mark - State Serialization
   /** @return \c true if the plug-in has been set up to do state chunks, via config.h */
@@ -133,17 +168,68 @@ public:
    * @return The new chunk position (endPos) */
   int UnserializeParams(const IByteChunk& chunk, int startPos);
     
+  /** Serializes the parameters compactly: a header with a version, then only the parameters that aren't at their default value, each as the difference from the previous index
+   * and the value in the smallest of a byte, an int, a float or a double that holds it exactly, so restoring it gives the same values as SerializeParams().
+   * If IPLUG_STATE_ZLIB is defined, and zlib is linked, the parameters can also be deflated.
+   * @param chunk The output chunk to serialize to. Will append data if the chunk has already been started.
+   * @param compress \c true to deflate the parameters, if IPLUG_STATE_ZLIB is defined
+   * @return \c true if the serialization was successful */
+  bool SerializeParamsCompact(IByteChunk& chunk, bool compress = false) const;
+
+  /** Unserializes parameters serialized with SerializeParamsCompact(). Parameters that aren't in the chunk are set to their default values
+   * @param chunk The incoming chunk where parameter values are stored to unserialize
+   * @param startPos The start position in the chunk where parameter values are stored
+   * @return The new chunk position (endPos), or -1 if the chunk isn't in the compact format, is of a later version, or is compressed and IPLUG_STATE_ZLIB isn't defined */
+  int UnserializeParamsCompact(const IByteChunk& chunk, int startPos);
+
+  /** @return \c true if the parameters at startPos were serialized with SerializeParamsCompact(), rather than SerializeParams() */
+  static bool IsCompactParams(const IByteChunk& chunk, int startPos);
+
+  /** Publish a snapshot of the plug-in's custom state, to be serialized on a background thread, so that when the host asks for the state SerializeStateSnapshot()
+   * only has to copy the bytes. Call this on the main thread when the data changes. If it changes again before the last snapshot has been serialized, only the latest is
+   * @param snapshot An immutable copy of the data, or nullptr if there is none */
+  void SetStateSnapshot(std::shared_ptr<const IStateSnapshot> snapshot);
+
+  /** Append the latest snapshot published with SetStateSnapshot() to a chunk, e.g. after the parameters in an override of SerializeState().
+   * If the background thread is still serializing it, this waits for it to finish, and if it hasn't started, the snapshot is serialized on this thread
+   * @param chunk The chunk to append the data to
+   * @return \c true on success, or if there is no snapshot */
+  bool SerializeStateSnapshot(IByteChunk& chunk) const;
+
+  /** Use SerializeParamsCompact() in the default SerializeState(). The default UnserializeState() reads either format, so states saved before still load
+   * @param compact \c true to save states in the compact format
+   * @param compress \c true to deflate them too, if IPLUG_STATE_ZLIB is defined */
+  void SetCompactStateFormat(bool compact, bool compress = false) { mCompactState = compact; mCompressState = compress; }
+
+  /** Restore the parameters without taking the parameters mutex, which the audio thread may hold while it processes, so that loading a state or preset never blocks it.
+   * The values are still set at once, so that the host and the editor see them, and OnParamChangeUI() is called for each parameter, but OnParamReset() is not called:
+   * instead OnParamChange() is called for each parameter on the audio thread at the start of the next block, see ApplyDeferredParamReset(), so that the DSP adopts the whole new state
+   * between two blocks. Only use this if OnParamReset() isn't overridden, and OnParamChange() is safe to call on the audio thread
+   * @param defer \c true to defer the DSP updates to the audio thread */
+  void SetDeferredParamReset(bool defer) { mDeferParamReset = defer; }
+
+  /** Called by the API classes on the audio thread at the start of each block, to call OnParamChange() for each parameter if a state has been restored since the last block,
+   * see SetDeferredParamReset(). This is wait-free */
+  void ApplyDeferredParamReset()
+  {
+    if (!mParamResetPending.load(std::memory_order_relaxed) || !mParamResetPending.exchange(false, std::memory_order_acquire))
+      return;
+
+    for (int i = 0; i < NParams(); ++i)
+      OnParamChange(i, kPresetRecall, 0);
+  }
+
   /** Override this method to serialize custom state data, if your plugin does state chunks.
    * @param chunk The output bytechunk where data can be serialized
    * @return \c true if serialization was successful*/
-  virtual bool SerializeState(IByteChunk& chunk) const { TRACE return SerializeParams(chunk); }
+  virtual bool SerializeState(IByteChunk& chunk) const { TRACE return mCompactState ? SerializeParamsCompact(chunk, mCompressState) : SerializeParams(chunk); }
   
   /** Override this method to unserialize custom state data, if your plugin does state chunks.
    * Implementations should call UnserializeParams() after custom data is unserialized
    * @param chunk The incoming chunk containing the state data.
    * @param startPos The position in the chunk where the data starts
    * @return The new chunk position (endPos)*/
-  virtual int UnserializeState(const IByteChunk& chunk, int startPos) { TRACE return UnserializeParams(chunk, startPos); }
+  virtual int UnserializeState(const IByteChunk& chunk, int startPos) { TRACE return IsCompactParams(chunk, startPos) ? UnserializeParamsCompact(chunk, startPos) : UnserializeParams(chunk, startPos); }
   
   /** VST3 ONLY! - THIS IS ONLY INCLUDED FOR COMPATIBILITY - NOONE ELSE SHOULD NEED IT!
    * @param chunk The output bytechunk where data can be serialized.
@@ -170,7 +256,7 @@ public:
   
   /** Get a ptr to a factory preset
    * @ param idx The index number of the preset you are referring to */
-  IPreset* GetPreset(int idx) { return mPresets.Get(idx); }
+  IPreset* GetPreset(int idx) { IPreset* pPreset = mPresets.Get(idx); if (pPreset) pPreset->Resolve(); return pPreset; }
   
   /** This method should update the current preset with current values
    * NOTE: This is only relevant for VST2 plug-ins, which is the only format to have the notion of banks?
@@ -203,6 +289,8 @@ public:
   {
     IPreset* pDst = mPresets.Get(destIdx);
 
+    pSrc->Resolve();
+    pDst->mSource = nullptr;
     pDst->mChunk.Clear();
     pDst->mChunk.PutChunk(&pSrc->mChunk);
     pDst->mInitialized = true;
@@ -260,11 +348,22 @@ public:
    * @return /c true on success */
   bool SerializePresets(IByteChunk& chunk) const;
 
-  /** [VST2 only] Called when the VST2 host calls effSetChunk for a bank *  
+  /** [VST2 only] Called when the VST2 host calls effSetChunk for a bank. If GetStateSize() knows the size of the presets' states, only the current preset
+   * is unserialized, and the others are unserialized from a copy of the bank when they are restored
    * @param chunk IByteChunk where the preset bank will be unserialized 
    * @param startPos The starting position in the chunk for the preset bank
    * @return int The new chunk position (endPos). */
   int UnserializePresets(const IByteChunk& chunk, int startPos); 
+
+  /** Override this to let UnserializePresets() skip the states of the presets it doesn't restore, rather than unserialize and serialize every one.
+   * If you don't override SerializeState(), return GetSerializedParamsSize(). This is called on the main thread, and must only read the chunk
+   * @param chunk The chunk the state was serialized to with SerializeState()
+   * @param startPos The position of the state in the chunk
+   * @return The size of the state in bytes, or -1 if it isn't known without unserializing it, the default */
+  virtual int GetStateSize(const IByteChunk& chunk, int startPos) const { return -1; }
+
+  /** @return The size of the parameters serialized at startPos with SerializeParams() or SerializeParamsCompact(), or -1 if the chunk is too short */
+  int GetSerializedParamsSize(const IByteChunk& chunk, int startPos) const;
   
   /** Writes a call to MakePreset() for the current preset to a new text file
    * @param file The full path of the file to write or overwrite. */
@@ -299,6 +398,12 @@ public:
    * @return /c true on success */
   bool LoadBankFromFXB(const char* file);
 
+  /** Load VST2 format bank, reading the file on a background thread so that a large bank doesn't block the UI. The presets are replaced on the main thread,
+   * by the idle timer, see UnserializePresets(). A load that is still reading when another starts is finished and discarded [VST2 only]
+   * @param file The full path of the file to load
+   * @param completionHandler Called on the main thread with \c true if the bank was loaded */
+  void LoadBankFromFXBAsync(const char* file, std::function<void(bool)> completionHandler = nullptr);
+
   
 #pragma mark - Parameter manipulation
     
@@ -319,6 +424,18 @@ public:
    * @param displayFunc An IParam::DisplayFunc lambda function to specify a custom display function */
   void InitParamRange(int startIdx, int endIdx, int countStart, const char* nameFmtStr, double defaultVal, double minVal, double maxVal, double step, const char* label = "", int flags = 0, const char* group = "", const IParam::Shape& shape = IParam::ShapeLinear(), IParam::EParamUnit unit = IParam::kUnitCustom, IParam::DisplayFunc displayFunc = nullptr);
   
+  /** Initialise parameters from a table of descriptors, see ParamDesc
+   * @param pDescs Pointer to the first descriptor
+   * @param nDescs The number of descriptors
+   * @param startIdx The index of the parameter to initialise with the first descriptor */
+  void InitParams(const ParamDesc* pDescs, int nDescs, int startIdx = 0);
+
+  /** Initialise parameters from a static array of descriptors, see ParamDesc
+   * @param descs The array of descriptors
+   * @param startIdx The index of the parameter to initialise with the first descriptor */
+  template <int N>
+  void InitParams(const ParamDesc (&descs)[N], int startIdx = 0) { InitParams(descs, N, startIdx); }
+
   /** Clone a range of parameters, optionally doing a string substitution on the parameter name.
    * @param cloneStartIdx The index of the first parameter to clone
    * @param cloneEndIdx The index of the last parameter to clone
@@ -347,8 +464,9 @@ public:
   
   /** Copy a range of parameter values for a parameter group
    * @param inGroup The name of the group to copy from
-   * @param outGroup The name of the group to copy to */
-  void CopyParamValues(const char* inGroup, const char* outGroup);
+   * @param outGroup The name of the group to copy to
+   * @param informHost If \c true the host is informed of all the new values once they have been copied */
+  void CopyParamValues(const char* inGroup, const char* outGroup, bool informHost = false);
   
   /** Randomise all parameters */
   void RandomiseParamValues();
@@ -359,8 +477,9 @@ public:
   void RandomiseParamValues(int startIdx, int endIdx);
   
   /** Randomise parameter values for a parameter group
-   * @param paramGroup The name of the group to modify */
-  void RandomiseParamValues(const char* paramGroup);
+   * @param paramGroup The name of the group to modify
+   * @param informHost If \c true the host is informed of all the new values once they have been set */
+  void RandomiseParamValues(const char* paramGroup, bool informHost = false);
   
   /** Set all parameters to their default values */
   void DefaultParamValues();
@@ -371,8 +490,9 @@ public:
   void DefaultParamValues(int startIdx, int endIdx);
   
   /** Default parameter values for a parameter group
-   * @param paramGroup The name of the group to modify */
-  void DefaultParamValues(const char* paramGroup);
+   * @param paramGroup The name of the group to modify
+   * @param informHost If \c true the host is informed of all the new values once they have been set */
+  void DefaultParamValues(const char* paramGroup, bool informHost = false);
   
   /** Default parameter values for a parameter group  */
   void PrintParamValues();
@@ -387,6 +507,7 @@ public:
   friend class IPlugAUv3;
   friend class IPlugWEB;
   friend class IPlugWAM;
+  friend class IPlugCLAP;
   friend class IPlugAPIBase;
   
 private:
@@ -422,6 +543,45 @@ private:
   /** "Baked in" Factory presets */
   WDL_PtrList<IPreset> mPresets;
 
+private:
+  // the parameter group index, see UpdateParamGroupIndex(): the parameters of group g are mParamGroupParams[mParamGroupStarts[g]] to mParamGroupParams[mParamGroupStarts[g + 1] - 1]
+  WDL_StringKeyedArray<int> mParamGroupIdxForName;
+  WDL_TypedBuf<int> mParamGroupForParam;
+  WDL_TypedBuf<int> mParamGroupStarts;
+  WDL_TypedBuf<int> mParamGroupParams;
+
+  /** Load a VST2 format bank that has been read to a chunk */
+  bool LoadBankFromFXBChunk(const IByteChunk& bnk);
+
+  /** Finish a LoadBankFromFXBAsync() once the file has been read. Called on the main thread by IPlugAPIBase::OnTimer() */
+  void PollBankLoad();
+
+  void SnapshotThreadFunc();
+
+  std::future<std::shared_ptr<IByteChunk>> mBankLoad;
+  std::function<void(bool)> mBankLoadCompletion;
+
+  /** Take the parameters mutex, unless the reset is deferred to the audio thread, before setting the values of all the parameters */
+  void BeginParamRestore();
+
+  /** Update the DSP and the UI after setting the values of all the parameters, see SetDeferredParamReset() */
+  void EndParamRestore();
+
+  // the state snapshot, see SetStateSnapshot(). The thread is started by the first snapshot
+  std::shared_ptr<const IStateSnapshot> mSnapshot; // the latest
+  std::shared_ptr<const IStateSnapshot> mSnapshotEncoding; // the one the thread is serializing
+  std::shared_ptr<const IStateSnapshot> mSnapshotEncoded; // the one mSnapshotData holds
+  std::shared_ptr<const IByteChunk> mSnapshotData;
+  bool mSnapshotThreadRunning = false;
+  std::thread mSnapshotThread;
+  mutable std::mutex mSnapshotMutex;
+  mutable std::condition_variable mSnapshotCondition;
+
+  bool mCompactState = false;
+  bool mCompressState = false;
+  bool mDeferParamReset = false;
+  std::atomic<bool> mParamResetPending {false}; // set by UnserializeParams(), cleared by ApplyDeferredParamReset() on the audio thread
+
 #ifdef PARAMS_MUTEX
   friend class IPlugVST3ProcessorBase;
 protected:
@@ -14,6 +14,20 @@
  */
 
 #include "IPlugProcessor.h"
+#include "IPlugParameter.h"
+#include "IPlugTraceZones.h"
+#include "IPlugRealtimeCheck.h"
+
+#ifndef WDL_DENORMAL_WANTS_SCOPED_FTZ
+  #define WDL_DENORMAL_WANTS_SCOPED_FTZ
+#endif
+#include "denormal.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <optional>
 
 #ifdef OS_WIN
 #define strtok_r strtok_s
@@ -21,12 +35,90 @@
 
 using namespace iplug;
 
+#if defined IPLUG_REALTIME_CHECKS
+// Replacements of the global operators, so that allocations on a thread marked with IPLUG_MARK_REALTIME_THREAD() are reported, see IPlugRealtimeCheck.h
+void* operator new(std::size_t size)
+{
+  IPLUG_REALTIME_CHECK(kAllocation, "operator new");
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  IPLUG_REALTIME_CHECK(kAllocation, "operator new[]");
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  IPLUG_REALTIME_CHECK(kAllocation, "operator new");
+  return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  IPLUG_REALTIME_CHECK(kAllocation, "operator new[]");
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+  if (p)
+    IPLUG_REALTIME_CHECK(kDeallocation, "operator delete");
+
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  if (p)
+    IPLUG_REALTIME_CHECK(kDeallocation, "operator delete[]");
+
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  operator delete[](p);
+}
+#endif
+
+/** Sets the FPU to flush denormals to zero for its lifetime if enabled, restoring the previous (host) FPU state on destruction */
+class ScopedFlushDenormals
+{
+public:
+  ScopedFlushDenormals(bool enable)
+  {
+    if (enable)
+      mScope.emplace();
+  }
+
+private:
+  std::optional<WDL_denormal_ftz_scope> mScope;
+};
+
 IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 : mPlugType((EIPlugPluginType) config.plugType)
 , mDoesMIDIIn(config.plugDoesMidiIn)
 , mDoesMIDIOut(config.plugDoesMidiOut)
 , mDoesMPE(config.plugDoesMPE)
 , mLatency(config.latency)
+, mFlushDenormals(config.plugFlushDenormals)
+, mInternalBlockSize(config.internalBlockSize)
+, mMidiOutputQueue(config.midiOutputQueueSize)
 {
   int totalNInBuses, totalNOutBuses;
   int totalNInChans, totalNOutChans;
@@ -35,6 +127,24 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 
   mScratchData[ERoute::kInput].Resize(totalNInChans);
   mScratchData[ERoute::kOutput].Resize(totalNOutChans);
+  mSegmentData[ERoute::kInput].Resize(totalNInChans);
+  mSegmentData[ERoute::kOutput].Resize(totalNOutChans);
+
+  if (mInternalBlockSize > 0)
+  {
+    const int nChans[2] = { totalNInChans, totalNOutChans };
+
+    // the output FIFO starts out silent, which is the latency of the internal block size
+    for (auto d = 0; d < 2; d++)
+    {
+      mFifoBuf[d].Resize(nChans[d] * mInternalBlockSize);
+      memset(mFifoBuf[d].Get(), 0, mFifoBuf[d].GetSize() * sizeof(sample));
+      mFifoData[d].Resize(nChans[d]);
+
+      for (auto i = 0; i < nChans[d]; i++)
+        mFifoData[d].Get()[i] = mFifoBuf[d].Get() + i * mInternalBlockSize;
+    }
+  }
 
   sample** ppInData = mScratchData[ERoute::kInput].Get();
 
@@ -56,6 +166,28 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
     pOutChannel->mIncomingData = nullptr;
     mChannelData[ERoute::kOutput].Add(pOutChannel);
   }
+
+  // the channels of each bus follow those of the previous bus, in the I/O config with the most buses
+  for (auto d = 0; d < 2; d++)
+  {
+    const ERoute direction = static_cast<ERoute>(d);
+    const int nBuses = MaxNBuses(direction);
+    const int nChans = MaxNChannels(direction);
+    int chanIdx = 0;
+
+    mBusChannelIdx[d].Resize(nBuses + 1);
+
+    for (auto bus = 0; bus < nBuses; bus++)
+    {
+      mBusChannelIdx[d].Get()[bus] = chanIdx;
+      const int nBusChans = MaxNChannelsForBus(direction, bus);
+      chanIdx = std::min(nBusChans < 0 ? nChans : chanIdx + nBusChans, nChans); // a wildcard bus takes all the channels
+    }
+
+    mBusChannelIdx[d].Get()[nBuses] = chanIdx;
+    mChannelWasConnected[d].Resize(nChans);
+    std::fill_n(mChannelWasConnected[d].Get(), nChans, false);
+  }
 }
 
 IPlugProcessor::~IPlugProcessor()
@@ -77,7 +209,8 @@ void IPlugProcessor::ProcessBlock(sample** inputs, sample** outputs, int nFrames
   {
     if (i < nIn)
     {
-      memcpy(outputs[i], inputs[i], nFrames * sizeof(sample));
+      if (outputs[i] != inputs[i]) // buffers may alias when processing in-place
+        memcpy(outputs[i], inputs[i], nFrames * sizeof(sample));
       j++;
     }
   }
@@ -93,6 +226,14 @@ void IPlugProcessor::ProcessMidiMsg(const IMidiMsg& msg)
   SendMidiMsg(msg);
 }
 
+void IPlugProcessor::ProcessUMP(const IMidiUMP& msg)
+{
+  IMidiMsg midi1Msg;
+
+  if (msg.ToMidiMsg(midi1Msg))
+    ProcessMidiMsg(midi1Msg);
+}
+
 bool IPlugProcessor::SendMidiMsgs(WDL_TypedBuf<IMidiMsg>& msgs)
 {
   bool rc = true;
@@ -240,6 +381,28 @@ int IPlugProcessor::NChannelsConnected(ERoute direction) const
   return count;
 }
 
+bool IPlugProcessor::IsBusConnected(ERoute direction, int busIdx) const
+{
+  if (busIdx < 0 || busIdx >= mBusChannelIdx[direction].GetSize() - 1)
+    return false;
+
+  const int* pChanIdx = mBusChannelIdx[direction].Get();
+
+  for (auto i = pChanIdx[busIdx]; i < pChanIdx[busIdx + 1]; i++)
+  {
+    if (mChannelData[direction].Get(i)->mConnected)
+      return true;
+  }
+
+  return false;
+}
+
+int IPlugProcessor::GetBusChannelIdx(ERoute direction, int busIdx) const
+{
+  assert(busIdx >= 0 && busIdx < mBusChannelIdx[direction].GetSize());
+  return mBusChannelIdx[direction].Get()[busIdx];
+}
+
 bool IPlugProcessor::LegalIO(int NInputChans, int NOutputChans) const
 {
   bool legal = false;
@@ -274,7 +437,73 @@ void IPlugProcessor::SetLatency(int samples)
   mLatency = samples;
 
   if (mLatencyDelay)
-    mLatencyDelay->SetDelayTime(mLatency);
+    mLatencyDelay->SetDelayTime(GetReportedLatency());
+}
+
+bool IPlugProcessor::GetProcessingLoad(ProcessingLoad& load)
+{
+  if (mProcessingTimeHistory.GetSize() != PROCESSING_LOAD_WINDOW)
+  {
+    mProcessingTimeHistory.Resize(PROCESSING_LOAD_WINDOW);
+    memset(mProcessingTimeHistory.Get(), 0, PROCESSING_LOAD_WINDOW * sizeof(ProcessingTime));
+    mProcessingTimeScratch.Resize(PROCESSING_LOAD_WINDOW);
+    mProcessingTimeHistoryPos = 0;
+  }
+
+  ProcessingTime* pHistory = mProcessingTimeHistory.Get();
+  ProcessingTime time;
+  int nNew = 0;
+
+  while (mProcessingTimes.Pop(time))
+  {
+    pHistory[mProcessingTimeHistoryPos] = time;
+    mProcessingTimeHistoryPos = (mProcessingTimeHistoryPos + 1) % PROCESSING_LOAD_WINDOW;
+    nNew++;
+  }
+
+  if (!nNew)
+    return false;
+
+  float* pDurations = mProcessingTimeScratch.Get();
+  double totalDuration = 0.;
+  double totalBudget = 0.;
+  int nBlocks = 0;
+
+  for (auto i = 0; i < PROCESSING_LOAD_WINDOW; i++)
+  {
+    if (pHistory[i].budgetUs > 0.f) // skip entries that haven't been written yet
+    {
+      pDurations[nBlocks++] = pHistory[i].durationUs;
+      totalDuration += pHistory[i].durationUs;
+      totalBudget += pHistory[i].budgetUs;
+    }
+  }
+
+  const int p99Idx = std::min(static_cast<int>(nBlocks * 0.99), nBlocks - 1);
+  std::nth_element(pDurations, pDurations + p99Idx, pDurations + nBlocks);
+
+  load.meanUs = totalDuration / nBlocks;
+  load.p99Us = pDurations[p99Idx];
+  load.maxUs = *std::max_element(pDurations + p99Idx, pDurations + nBlocks);
+  load.percent = 100. * totalDuration / totalBudget;
+  load.nBlocks = nBlocks;
+
+  return true;
+}
+
+void IPlugProcessor::SetWorkerPoolSize(int nThreads)
+{
+  if (nThreads == 0)
+  {
+    mWorkerPool = nullptr;
+    return;
+  }
+
+  if (!mWorkerPool)
+    mWorkerPool = std::unique_ptr<IPlugWorkerPool>(new IPlugWorkerPool());
+
+  const int blockSize = mBlockSize > 0 ? mBlockSize : DEFAULT_BLOCK_SIZE;
+  mWorkerPool->Start(nThreads, blockSize / GetSampleRate());
 }
 
 //static
@@ -474,7 +703,14 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
       }
       else // output
       {
-        *(pChannel->mData) = pChannel->mScratchBuf.Get();
+        IChannelData<>* pInChannel = mProcessInPlace ? mChannelData[ERoute::kInput].Get(i) : nullptr;
+        
+        // process in-place in the input channel's scratch buffer, which already contains the converted input
+        if (pInChannel && pInChannel->mConnected)
+          *(pChannel->mData) = pInChannel->mScratchBuf.Get();
+        else
+          *(pChannel->mData) = pChannel->mScratchBuf.Get();
+
         pChannel->mIncomingData = *(ppData++);
       }
     }
@@ -483,7 +719,12 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
 
 void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
-  if (mLatency && mLatencyDelay)
+  ScopedFlushDenormals flushDenormals(mFlushDenormals);
+
+  FlushScheduledEvents();
+  mOutputIsSilent = false;
+
+  if (GetReportedLatency() && mLatencyDelay)
     mLatencyDelay->ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   else
     IPlugProcessor::ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
@@ -493,28 +734,613 @@ void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 {
   // for PLUG_SAMPLE_SRC bit buffers, first run the delay (if mLatency) on the PLUG_SAMPLE_DST IPlug buffers
   PassThroughBuffers(PLUG_SAMPLE_DST(0.), nFrames);
+  CastCopyOutputs(nFrames);
+}
 
-  int i, n = MaxNChannels(ERoute::kOutput);
-  IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
+void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
+{
+  IPLUG_MARK_REALTIME_THREAD(); // the API classes mark their whole process callback too
+  TRACE_THREAD_NAME("Audio");
+  TRACE_ZONE("ProcessBlock");
+  ScopedFlushDenormals flushDenormals(mFlushDenormals);
 
-  for (i = 0; i < n; ++i, ++ppOutChannel)
+  if (mMeasureProcessingLoad)
   {
-    IChannelData<>* pOutChannel = *ppOutChannel;
-    if (pOutChannel->mConnected)
+    const auto start = std::chrono::steady_clock::now();
+    ProcessBuffersInternal(nFrames);
+    const std::chrono::duration<float, std::micro> duration = std::chrono::steady_clock::now() - start;
+
+    mProcessingTimes.Push({ duration.count(), static_cast<float>(nFrames * 1e6 / GetSampleRate()) }); // if the queue is full, the timing is dropped
+  }
+  else
+  {
+    ProcessBuffersInternal(nFrames);
+  }
+}
+
+void IPlugProcessor::UpdateRenderQuality()
+{
+  const bool offline = GetRenderingOffline();
+
+  if (offline == mRenderQualityIsOffline)
+    return;
+
+  mRenderQualityIsOffline = offline;
+
+  for (auto& func : mRenderQualitySettings)
+    func(offline);
+
+  OnRenderingOfflineChanged(offline);
+}
+
+void IPlugProcessor::UpdateBusConnections()
+{
+  for (auto d = 0; d < 2; d++)
+  {
+    const ERoute direction = static_cast<ERoute>(d);
+    const int* pChanIdx = mBusChannelIdx[d].Get();
+    bool* pWasConnected = mChannelWasConnected[d].Get();
+
+    for (auto bus = 0; bus < mBusChannelIdx[d].GetSize() - 1; bus++)
     {
-      CastCopy(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
+      bool wasConnected = false, connected = false;
+
+      for (auto i = pChanIdx[bus]; i < pChanIdx[bus + 1]; i++)
+      {
+        IChannelData<>* pChannel = mChannelData[d].Get(i);
+        wasConnected |= pWasConnected[i];
+        connected |= pChannel->mConnected;
+
+        // an input's scratch buffer may still hold the audio that was copied into it while it was connected
+        if (direction == ERoute::kInput && pWasConnected[i] && !pChannel->mConnected)
+          memset(pChannel->mScratchBuf.Get(), 0, pChannel->mScratchBuf.GetSize() * sizeof(PLUG_SAMPLE_DST));
+
+        pWasConnected[i] = pChannel->mConnected;
+      }
+
+      if (connected != wasConnected)
+        OnBusConnectionChanged(direction, bus, connected);
     }
   }
 }
 
-void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
+void IPlugProcessor::ProcessBuffersInternal(int nFrames)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  UpdateRenderQuality();
+  UpdateBusConnections();
+
+  if (mInternalBlockSize == 0)
+    RenderParamBuffers(nFrames, true); // with an internal block size they are rendered for each internal block
+
+  if (SkipSilentBlock(nFrames))
+  {
+    FlushScheduledEvents();
+    return;
+  }
+
+  sample** inputs = mScratchData[ERoute::kInput].Get();
+  sample** outputs = mScratchData[ERoute::kOutput].Get();
+
+  if (mInternalBlockSize > 0)
+  {
+    ProcessInternalBlocks(nFrames);
+  }
+  else if (HasScheduledEvents())
+  {
+    ProcessScheduledBlock(inputs, outputs, nFrames);
+    FlushScheduledEvents(); // anything left has an offset beyond the end of the block
+  }
+  else
+  {
+    ProcessSegment(inputs, outputs, 0, nFrames);
+  }
 }
 
 void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 {
   ProcessBuffers((PLUG_SAMPLE_DST) 0, nFrames);
+  CastCopyOutputs(nFrames);
+}
+
+void IPlugProcessor::ProcessScheduledBlock(sample** inputs, sample** outputs, int nFrames)
+{
+  const int minSubBlockSize = mSubBlockProcessing ? mMinSubBlockSize : 1;
+  int startFrame = 0;
+
+  while (startFrame < nFrames)
+  {
+    // events that fall within the minimum sub-block size are delivered at the start of the sub-block
+    DeliverScheduledEvents(startFrame + minSubBlockSize);
+
+    const int endFrame = std::min(NextScheduledEventOffset(), nFrames);
+    ProcessSegment(inputs, outputs, startFrame, endFrame - startFrame);
+    startFrame = endFrame;
+  }
+}
+
+void IPlugProcessor::ProcessInternalBlocks(int nFrames)
+{
+  const int blockSize = mInternalBlockSize;
+  const int nIn = mScratchData[ERoute::kInput].GetSize();
+  const int nOut = mScratchData[ERoute::kOutput].GetSize();
+  sample** ppInData = mScratchData[ERoute::kInput].Get();
+  sample** ppOutData = mScratchData[ERoute::kOutput].Get();
+  sample** ppFifoInData = mFifoData[ERoute::kInput].Get();
+  sample** ppFifoOutData = mFifoData[ERoute::kOutput].Get();
+  int s = 0;
+
+  while (s < nFrames)
+  {
+    const int n = std::min(blockSize - mFifoPos, nFrames - s);
+
+    // inputs are copied first, as the host's buffers may alias when processing in-place
+    for (auto c = 0; c < nIn; c++)
+      memcpy(ppFifoInData[c] + mFifoPos, ppInData[c] + s, n * sizeof(sample));
+
+    for (auto c = 0; c < nOut; c++)
+      memcpy(ppOutData[c] + s, ppFifoOutData[c] + mFifoPos, n * sizeof(sample));
+
+    mFifoPos += n;
+    s += n;
+
+    if (mFifoPos == blockSize)
+    {
+      // event offsets are relative to the start of the internal block, see HandleMidiMsg() and AddParamChange()
+      RenderParamBuffers(blockSize, false);
+
+      if (mSubBlockProcessing)
+      {
+        ProcessScheduledBlock(ppFifoInData, ppFifoOutData, blockSize);
+      }
+      else
+      {
+        DeliverScheduledEvents(blockSize);
+        ProcessBlock(ppFifoInData, ppFifoOutData, blockSize);
+      }
+
+      ShiftScheduledEvents(blockSize);
+      mFifoPos = 0;
+    }
+  }
+}
+
+void IPlugProcessor::ProcessSegment(sample** inputs, sample** outputs, int startFrame, int nFrames)
+{
+  if (startFrame > 0)
+  {
+    sample** ppSrc[2] = { inputs, outputs };
+
+    for (auto d = 0; d < 2; d++)
+    {
+      sample** ppDst = mSegmentData[d].Get();
+
+      for (auto i = 0; i < mSegmentData[d].GetSize(); i++)
+        ppDst[i] = ppSrc[d][i] + startFrame;
+    }
+
+    inputs = mSegmentData[ERoute::kInput].Get();
+    outputs = mSegmentData[ERoute::kOutput].Get();
+  }
+
+  if (mSubBlockProcessing)
+    ProcessSubBlock(inputs, outputs, startFrame, nFrames);
+  else
+    ProcessBlock(inputs, outputs, nFrames);
+}
+
+bool IPlugProcessor::SkipSilentBlock(int nFrames)
+{
+  mOutputIsSilent = false;
+
+  if (!mSkipProcessingOnSilence)
+    return false;
+
+  const bool inputIsSilent = !mMidiReceived && (mHostInputIsSilent || InputsAreSilent(nFrames));
+  mMidiReceived = false;
+  mHostInputIsSilent = false;
+
+  if (!inputIsSilent)
+  {
+    mSilentSamples = 0;
+    return false;
+  }
+
+  const int64_t tail = static_cast<int64_t>(mTailSize) + GetReportedLatency();
+  const bool tailElapsed = mTailSize >= 0 && mSilentSamples >= tail;
+
+  mSilentSamples += nFrames;
+
+  if (!tailElapsed)
+    return false;
+
+  const int nOut = mScratchData[ERoute::kOutput].GetSize();
+  sample** ppOutData = mScratchData[ERoute::kOutput].Get();
+
+  for (auto i = 0; i < nOut; i++)
+    memset(ppOutData[i], 0, nFrames * sizeof(sample));
+
+  mOutputIsSilent = true;
+  return true;
+}
+
+bool IPlugProcessor::InputsAreSilent(int nFrames) const
+{
+  const int nIn = mChannelData[ERoute::kInput].GetSize();
+
+  for (auto i = 0; i < nIn; i++)
+  {
+    const IChannelData<>* pInChannel = mChannelData[ERoute::kInput].Get(i);
+
+    if (pInChannel->mConnected)
+    {
+      const sample* pData = *(pInChannel->mData);
+
+      for (auto s = 0; s < nFrames; s++)
+      {
+        if (pData[s] != 0.)
+          return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void IPlugProcessor::HandleMidiMsg(const IMidiMsg& msg)
+{
+  mMidiReceived = true;
+
+  if (mInternalBlockSize > 0)
+  {
+    // held until the internal block containing the message is processed
+    IMidiMsg fifoMsg = msg;
+    fifoMsg.mOffset += mFifoPos;
+    mScheduledMidiMsgs.Add(fifoMsg);
+  }
+  else if (mSubBlockProcessing)
+    mScheduledMidiMsgs.Add(msg); // delivered in ProcessScheduledBlock()
+  else
+    ProcessMidiMsg(msg);
+}
+
+void IPlugProcessor::HandleUMP(const IMidiUMP& msg)
+{
+  mMidiReceived = true;
+
+  if (mInternalBlockSize > 0)
+  {
+    IMidiUMP fifoMsg = msg;
+    fifoMsg.mOffset += mFifoPos;
+    mScheduledUMPs.Add(fifoMsg);
+  }
+  else if (mSubBlockProcessing)
+    mScheduledUMPs.Add(msg);
+  else
+    ProcessUMP(msg);
+}
+
+void IPlugProcessor::AddParamChange(const ParamChange& change)
+{
+  // rather than allocating on the audio thread, a change that doesn't fit is applied now, so its value isn't lost
+  if (mScheduledParamChanges.GetSize() >= mScheduledParamChangeCapacity)
+  {
+    ApplyParamChange(change);
+    return;
+  }
+
+  mScheduledParamChanges.Add(change);
+
+  // keep the list sorted by offset, changes with the same offset stay in the order they were added
+  ParamChange* pChanges = mScheduledParamChanges.Get();
+  int i = mScheduledParamChanges.GetSize() - 1;
+
+  while (i > mNextParamChangeIdx && pChanges[i - 1].offset > change.offset + mFifoPos)
+  {
+    pChanges[i] = pChanges[i - 1];
+    i--;
+  }
+
+  pChanges[i] = change;
+  pChanges[i].offset += mFifoPos;
+}
+
+bool IPlugProcessor::HasScheduledEvents() const
+{
+  return mNextParamChangeIdx < mScheduledParamChanges.GetSize() || !mScheduledMidiMsgs.Empty() || !mScheduledUMPs.Empty();
+}
+
+int IPlugProcessor::NextScheduledEventOffset() const
+{
+  int offset = std::numeric_limits<int>::max();
+
+  if (mNextParamChangeIdx < mScheduledParamChanges.GetSize())
+    offset = mScheduledParamChanges.Get()[mNextParamChangeIdx].offset;
+
+  if (!mScheduledMidiMsgs.Empty())
+    offset = std::min(offset, mScheduledMidiMsgs.Peek().mOffset);
+
+  if (!mScheduledUMPs.Empty())
+    offset = std::min(offset, mScheduledUMPs.Peek().mOffset);
+
+  return offset;
+}
+
+void IPlugProcessor::DeliverScheduledEvents(int beforeOffset)
+{
+  const ParamChange* pChanges = mScheduledParamChanges.Get();
+  const int nChanges = mScheduledParamChanges.GetSize();
+
+  while (mNextParamChangeIdx < nChanges && pChanges[mNextParamChangeIdx].offset < beforeOffset)
+    ApplyParamChange(pChanges[mNextParamChangeIdx++]);
+
+  // MIDI 1.0 and 2.0 messages are interleaved by offset, at the same offset MIDI 1.0 messages go first
+  while (true)
+  {
+    const bool hasMidi = !mScheduledMidiMsgs.Empty() && mScheduledMidiMsgs.Peek().mOffset < beforeOffset;
+    const bool hasUMP = !mScheduledUMPs.Empty() && mScheduledUMPs.Peek().mOffset < beforeOffset;
+
+    if (hasMidi && (!hasUMP || mScheduledMidiMsgs.Peek().mOffset <= mScheduledUMPs.Peek().mOffset))
+    {
+      ProcessMidiMsg(mScheduledMidiMsgs.Peek());
+      mScheduledMidiMsgs.Remove();
+    }
+    else if (hasUMP)
+    {
+      ProcessUMP(mScheduledUMPs.Peek());
+      mScheduledUMPs.Remove();
+    }
+    else
+      break;
+  }
+}
+
+void IPlugProcessor::ShiftScheduledEvents(int nFrames)
+{
+  // drop the changes that have been applied, and make the remaining ones relative to the next block
+  ParamChange* pChanges = mScheduledParamChanges.Get();
+  const int nRemaining = mScheduledParamChanges.GetSize() - mNextParamChangeIdx;
+
+  for (auto i = 0; i < nRemaining; i++)
+  {
+    pChanges[i] = pChanges[i + mNextParamChangeIdx];
+    pChanges[i].offset -= nFrames;
+  }
+
+  mScheduledParamChanges.Resize(nRemaining, false);
+  mNextParamChangeIdx = 0;
+
+  mScheduledMidiMsgs.Flush(nFrames);
+  mScheduledUMPs.Flush(nFrames);
+
+  ParamRamp* pRamps = mParamRamps.Get();
+
+  for (auto i = 0; i < mParamRamps.GetSize(); i++)
+    pRamps[i].offset -= nFrames;
+}
+
+void IPlugProcessor::FlushScheduledEvents()
+{
+  DeliverScheduledEvents(std::numeric_limits<int>::max());
+
+  mScheduledParamChanges.Resize(0, false);
+  mNextParamChangeIdx = 0;
+  mScheduledMidiMsgs.Clear();
+  mScheduledUMPs.Clear();
+
+  if (mParamRamps.GetSize())
+    RenderParamBuffers(0, true); // starts the remaining ramps for the next block
+}
+
+#pragma mark - Audio-rate parameters
+
+void IPlugProcessor::InitParamBuffers(const WDL_PtrList<IParam>& params)
+{
+  const int nParams = params.GetSize();
+  mParamBufferIdxForParam.Resize(nParams);
+  mParamBufferStates.Resize(0);
+
+  for (auto p = 0; p < nParams; p++)
+  {
+    const IParam* pParam = params.Get(p);
+
+    if (pParam->GetAudioRate())
+    {
+      const double value = pParam->GetNormalized();
+      mParamBufferIdxForParam.Get()[p] = mParamBufferStates.GetSize();
+      mParamBufferStates.Add({p, pParam, value, value, 0., 0});
+    }
+    else
+      mParamBufferIdxForParam.Get()[p] = -1;
+  }
+
+  ResizeParamBuffers();
+}
+
+void IPlugProcessor::ResizeParamBuffers()
+{
+  const int nBuffers = mParamBufferStates.GetSize();
+  mParamBufferSize = std::max(mBlockSize, mInternalBlockSize);
+  mParamBufferData.Resize(nBuffers * mParamBufferSize);
+
+  // preallocate the ramps, AddParamRamp() drops any more than this rather than allocating on the audio thread
+  mParamRampCapacity = nBuffers ? mParamBufferSize : 0;
+  mParamRamps.Resize(mParamRampCapacity, false);
+  mParamRamps.Resize(0, false);
+
+  for (auto b = 0; b < nBuffers; b++)
+  {
+    const ParamBufferState& state = mParamBufferStates.Get()[b];
+    const sample value = static_cast<sample>(state.pParam->FromNormalized(state.value));
+    sample* pData = mParamBufferData.Get() + (b * mParamBufferSize);
+
+    for (auto s = 0; s < mParamBufferSize; s++)
+      pData[s] = value;
+  }
+}
+
+const sample* IPlugProcessor::GetParamBuffer(int paramIdx) const
+{
+  if (!HasParamBuffer(paramIdx))
+    return nullptr;
+
+  return mParamBufferData.Get() + (mParamBufferIdxForParam.Get()[paramIdx] * mParamBufferSize);
+}
+
+void IPlugProcessor::AddParamRamp(const ParamRamp& ramp)
+{
+  // the parameter's value is still set, so a dropped ramp is smoothed like a change without a ramp
+  if (!HasParamBuffer(ramp.idx) || mParamRamps.GetSize() >= mParamRampCapacity)
+    return;
+
+  ParamRamp fifoRamp = ramp;
+
+  // a ramp that started in an earlier block, which AudioUnit hosts can send, continues from where it would be now
+  if (fifoRamp.offset < 0)
+  {
+    if (fifoRamp.duration > 0 && fifoRamp.startNormalizedValue >= 0.)
+    {
+      const double elapsed = std::min(static_cast<double>(-fifoRamp.offset) / fifoRamp.duration, 1.);
+      fifoRamp.startNormalizedValue += (fifoRamp.normalizedValue - fifoRamp.startNormalizedValue) * elapsed;
+    }
+
+    fifoRamp.duration = std::max(fifoRamp.duration + fifoRamp.offset, 0);
+    fifoRamp.offset = 0;
+  }
+
+  fifoRamp.offset += mFifoPos;
+
+  // keep the list sorted by offset, as in AddParamChange()
+  mParamRamps.Add(fifoRamp);
+  ParamRamp* pRamps = mParamRamps.Get();
+  int i = mParamRamps.GetSize() - 1;
+
+  while (i > 0 && pRamps[i - 1].offset > fifoRamp.offset)
+  {
+    pRamps[i] = pRamps[i - 1];
+    i--;
+  }
+
+  pRamps[i] = fifoRamp;
+}
+
+void IPlugProcessor::RenderParamBuffers(int nFrames, bool startLateRamps)
+{
+  const int nBuffers = mParamBufferStates.GetSize();
+
+  if (!nBuffers)
+    return;
+
+  nFrames = std::min(nFrames, mParamBufferSize);
+  const int smoothingFrames = static_cast<int>(mParamBufferSmoothingTime * 0.001 * GetSampleRate());
+  const ParamRamp* pRamps = mParamRamps.Get();
+  const int nRamps = mParamRamps.GetSize();
+
+  auto startRamp = [smoothingFrames](ParamBufferState& state, const ParamRamp& ramp) {
+    if (ramp.startNormalizedValue >= 0.)
+      state.value = ramp.startNormalizedValue;
+
+    state.target = ramp.normalizedValue;
+    state.remaining = ramp.duration > 0 ? ramp.duration : smoothingFrames;
+
+    if (state.remaining > 0)
+      state.increment = (state.target - state.value) / state.remaining;
+    else
+      state.value = state.target;
+  };
+
+  auto render = [](ParamBufferState& state, sample* pData, int startFrame, int endFrame) {
+    int s = startFrame;
+
+    if (state.remaining > 0)
+    {
+      const int n = std::min(state.remaining, endFrame - startFrame);
+
+      for (auto i = 0; i < n; i++)
+      {
+        state.value += state.increment;
+        pData[s++] = static_cast<sample>(state.pParam->FromNormalized(state.value));
+      }
+
+      state.remaining -= n;
+
+      if (!state.remaining)
+        state.value = state.target;
+    }
+
+    if (s < endFrame)
+    {
+      const sample value = static_cast<sample>(state.pParam->FromNormalized(state.value));
+
+      for (; s < endFrame; s++)
+        pData[s] = value;
+    }
+  };
+
+  int nConsumed = 0;
+
+  while (nConsumed < nRamps && pRamps[nConsumed].offset < nFrames)
+    nConsumed++;
+
+  for (auto b = 0; b < nBuffers; b++)
+  {
+    ParamBufferState& state = mParamBufferStates.Get()[b];
+    sample* pData = mParamBufferData.Get() + (b * mParamBufferSize);
+    bool hasRamps = false;
+    int s = 0;
+
+    for (auto r = 0; r < nRamps; r++)
+    {
+      if (pRamps[r].idx != state.paramIdx)
+        continue;
+
+      hasRamps = true;
+
+      if (r < nConsumed)
+      {
+        render(state, pData, s, pRamps[r].offset);
+        s = pRamps[r].offset;
+        startRamp(state, pRamps[r]);
+      }
+    }
+
+    // a change that wasn't ramped by the host, e.g. from an API that sets parameter values directly, or from the UI
+    if (!hasRamps)
+    {
+      const double value = state.pParam->GetNormalized();
+
+      if (value != state.target)
+        startRamp(state, ParamRamp(state.paramIdx, value));
+    }
+
+    render(state, pData, s, nFrames);
+
+    if (startLateRamps)
+    {
+      for (auto r = nConsumed; r < nRamps; r++)
+      {
+        if (pRamps[r].idx == state.paramIdx)
+          startRamp(state, pRamps[r]);
+      }
+    }
+  }
+
+  if (startLateRamps)
+  {
+    mParamRamps.Resize(0, false);
+  }
+  else
+  {
+    ParamRamp* pRemaining = mParamRamps.Get();
+
+    for (auto i = nConsumed; i < nRamps; i++)
+      pRemaining[i - nConsumed] = pRemaining[i];
+
+    mParamRamps.Resize(nRamps - nConsumed, false);
+  }
+}
+
+void IPlugProcessor::CastCopyOutputs(int nFrames)
+{
   int i, n = MaxNChannels(ERoute::kOutput);
   IChannelData<>** ppOutChannel = mChannelData[ERoute::kOutput].GetList();
 
@@ -540,12 +1366,7 @@ void IPlugProcessor::ProcessBuffersAccumulating(int nFrames)
     IChannelData<>* pOutChannel = *ppOutChannel;
     if (pOutChannel->mConnected)
     {
-      PLUG_SAMPLE_SRC* pDest = pOutChannel->mIncomingData;
-      PLUG_SAMPLE_DST* pSrc = *(pOutChannel->mData); // TODO : check this: PLUG_SAMPLE_DST will allways be float, because this is only for VST2 accumulating
-      for (int j = 0; j < nFrames; ++j, ++pDest, ++pSrc)
-      {
-        *pDest += (PLUG_SAMPLE_SRC) *pSrc;
-      }
+      CastAccumulate(pOutChannel->mIncomingData, *(pOutChannel->mData), nFrames);
     }
   }
 }
@@ -554,16 +1375,21 @@ void IPlugProcessor::ZeroScratchBuffers()
 {
   int i, nIn = MaxNChannels(ERoute::kInput), nOut = MaxNChannels(ERoute::kOutput);
 
+  // the scratch buffers of connected channels are either unused or overwritten in AttachBuffers(), so only unconnected channels need zeroing
   for (i = 0; i < nIn; ++i)
   {
     IChannelData<>* pInChannel = mChannelData[ERoute::kInput].Get(i);
-    memset(pInChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(PLUG_SAMPLE_DST));
+    
+    if (!pInChannel->mConnected)
+      memset(pInChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(PLUG_SAMPLE_DST));
   }
 
   for (i = 0; i < nOut; ++i)
   {
     IChannelData<>* pOutChannel = mChannelData[ERoute::kOutput].Get(i);
-    memset(pOutChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(PLUG_SAMPLE_DST));
+    
+    if (!pOutChannel->mConnected)
+      memset(pOutChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(PLUG_SAMPLE_DST));
   }
 }
 
@@ -587,6 +1413,24 @@ void IPlugProcessor::SetBlockSize(int blockSize)
       memset(pOutChannel->mScratchBuf.Get(), 0, blockSize * sizeof(PLUG_SAMPLE_DST));
     }
 
+    // preallocate the event schedule, events are held for up to an internal block as well as the host block. The audio thread drops any more rather than allocating
+    const int scheduleCapacity = blockSize + mInternalBlockSize;
+    mScheduledMidiMsgs.Resize(scheduleCapacity);
+    mScheduledUMPs.Resize(scheduleCapacity);
+    mScheduledParamChangeCapacity = scheduleCapacity;
+    mScheduledParamChanges.Resize(mScheduledParamChangeCapacity, false);
+    mScheduledParamChanges.Resize(0, false);
+
     mBlockSize = blockSize;
+    ResizeParamBuffers();
   }
+
+  // restart the internal block size FIFO
+  for (auto d = 0; d < 2; d++)
+  {
+    if (mFifoBuf[d].GetSize())
+      memset(mFifoBuf[d].Get(), 0, mFifoBuf[d].GetSize() * sizeof(sample));
+  }
+
+  mFifoPos = 0;
 }
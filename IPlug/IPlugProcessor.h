@@ -16,6 +16,8 @@
 #include <cmath>
 #include <cstdio>
 #include <cassert>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -26,6 +28,8 @@
 #include "IPlugStructs.h"
 #include "IPlugUtilities.h"
 #include "NChanDelay.h"
+#include "IPlugWorkerPool.h"
+#include "IPlugQueue.h"
 
 /**
  * @file
@@ -35,6 +39,7 @@
 BEGIN_IPLUG_NAMESPACE
 
 struct Config;
+class IParam;
 
 /** The base class for IPlug Audio Processing. It knows nothing about presets or parameters or user interface.  */
 class IPlugProcessor
@@ -61,12 +66,30 @@ public:
    * @param nFrames The block size for this block: number of samples per channel.*/
   virtual void ProcessBlock(sample** inputs, sample** outputs, int nFrames);
 
+  /** Override this method to process a sub-block of audio, when sub-block processing has been enabled with SetSubBlockProcessing().
+   * The host's block is split at the sample offsets of incoming MIDI messages (and parameter changes, when using sample accurate automation),
+   * and each message is passed to ProcessMidiMsg() just before the sub-block that it applies to, so there is no need to queue messages yourself.
+   * The default implementation calls ProcessBlock(), so existing code can benefit from sub-block processing without changes.
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts
+   * @param inputs Two-dimensional array containing the non-interleaved input buffers of audio samples for all channels, offset to the start of the sub-block
+   * @param outputs Two-dimensional array for audio output (non-interleaved), offset to the start of the sub-block
+   * @param startFrame The offset of the sub-block from the start of the host's block, in samples
+   * @param nFrames The number of samples per channel in this sub-block */
+  virtual void ProcessSubBlock(sample** inputs, sample** outputs, int startFrame, int nFrames) { ProcessBlock(inputs, outputs, nFrames); }
+
   /** Override this method to handle incoming MIDI messages. The method is called prior to ProcessBlock().
    * You can use IMidiQueue in combination with this method in order to queue the message and process at the appropriate time in ProcessBlock()
    * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts
    * @param msg The incoming midi message (includes a timestamp to indicate the offset in the forthcoming block of audio to be processed in ProcessBlock()) */
   virtual void ProcessMidiMsg(const IMidiMsg& msg);
 
+  /** Override this method to handle incoming MIDI 2.0 messages, which the API classes send for events with more resolution than MIDI 1.0, such as per-note expression.
+   * It is called at the same point as ProcessMidiMsg(), in offset order with the MIDI 1.0 messages, including when sub-block processing.
+   * The default implementation converts the message to MIDI 1.0 with IMidiUMP::ToMidiMsg() and calls ProcessMidiMsg(), messages without a MIDI 1.0 equivalent are ignored.
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts
+   * @param msg The incoming UMP packet (includes a timestamp to indicate the offset in the forthcoming block of audio to be processed in ProcessBlock()) */
+  virtual void ProcessUMP(const IMidiUMP& msg);
+
   /** Override this method to handle incoming MIDI System Exclusive (SysEx) messages. The method is called prior to ProcessBlock().
    * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should be careful not to do any unbounded, blocking operations such as file I/O which could cause audio dropouts */
   virtual void ProcessSysEx(ISysEx& msg) {}
@@ -80,6 +103,21 @@ public:
    * @param active \c true if the host has activated the plug-in */
   virtual void OnActivate(bool active) { TRACE }
 
+  /** Override this method to switch your DSP between its realtime settings and higher quality settings for offline rendering (bounces), see also AddRenderQualitySetting().
+   * It is called before the first block that is processed after the host switches between realtime and offline rendering, after the functions added with AddRenderQualitySetting()
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should not allocate memory here, so any buffers that the offline settings need should be allocated beforehand e.g. in OnReset()
+   * @param offline \c true if the host is now rendering offline */
+  virtual void OnRenderingOfflineChanged(bool offline) {}
+
+  /** Override this method to react when the host connects or disconnects a bus, e.g. to reset a side-chain detector, or to tell the UI. It is called before the first block that is processed
+   * after the change, including the first block after the plug-in is created for the buses that are connected. A bus is connected if any of its channels is, see IsBusConnected()
+   * A disconnected input bus's buffers are silent, but processing that reads it can be skipped entirely, see GetBusBuffers()
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should not allocate memory or notify the UI directly here
+   * @param direction Whether the bus is an input or an output
+   * @param busIdx The index of the bus, e.g. 1 for a side-chain input
+   * @param connected \c true if the bus is now connected */
+  virtual void OnBusConnectionChanged(ERoute direction, int busIdx, bool connected) {}
+
 #pragma mark - Methods you can call - some of which have custom implementations in the API classes, some implemented in IPlugProcessor.cpp
 
   /** Send a single MIDI message // TODO: info about what thread should this be called on or not called on!
@@ -103,17 +141,26 @@ public:
   /** @return Maximum block size in samples, actual blocksize may vary each ProcessBlock() */
   int GetBlockSize() const { return mBlockSize; }
 
-  /** @return Plugin latency (in samples) */
+  /** @return Plugin latency (in samples), as set with SetLatency() or PLUG_LATENCY */
   int GetLatency() const { return mLatency; }
 
+  /** @return The latency (in samples) reported to the host, GetLatency() plus the latency of the internal block size, if set */
+  int GetReportedLatency() const { return mLatency + mInternalBlockSize; }
+
+  /** @return The fixed block size that ProcessBlock() is called with, or 0 if it is called with the host's block size. Set PLUG_INTERNAL_BLOCK_SIZE in config.h to enable */
+  int GetInternalBlockSize() const { return mInternalBlockSize; }
+
   /** @return The tail size in samples (useful for reverberation plug-ins, that may need to decay after the transport stops or an audio item ends) */
   int GetTailSize() { return mTailSize; }
 
   /** @return \c true if the plugin is currently bypassed */
   bool GetBypassed() const { return mBypassed; }
 
+  /** @return \c true if ProcessBlock() was skipped for the last block because the input was silent and the tail had elapsed, see SetSkipProcessingOnSilence() */
+  bool GetOutputIsSilent() const { return mOutputIsSilent; }
+
   /** @return \c true if the plugin is currently rendering off-line */
-  bool GetRenderingOffline() const { return mRenderingOffline; };
+  bool GetRenderingOffline() const { return mRenderingOffline.load(std::memory_order_relaxed); };
 
 #pragma mark -
   /** @return The number of samples elapsed since start of project timeline. */
@@ -179,6 +226,25 @@ public:
     * @return \c true if the host has connected this channel*/
   bool IsChannelConnected(ERoute direction, int chIdx) const { return (chIdx < mChannelData[direction].GetSize() && mChannelData[direction].Get(chIdx)->mConnected); }
 
+  /** @param direction Whether you want to test inputs or outputs
+   * @param busIdx The index of the bus, in the I/O config with the most buses
+   * @return \c true if the host has connected any channel of the bus */
+  bool IsBusConnected(ERoute direction, int busIdx) const;
+
+  /** @param direction Whether you want to test inputs or outputs
+   * @param busIdx The index of the bus, in the I/O config with the most buses
+   * @return The index of the first channel of the bus in the buffers of ProcessBlock() */
+  int GetBusChannelIdx(ERoute direction, int busIdx) const;
+
+  /** Get the buffers of a bus from those passed to ProcessBlock(), e.g. the side-chain inputs, so that a detector can skip its work when the bus isn't connected
+   * @code
+   * if (sample** sideChain = GetBusBuffers(ERoute::kInput, 1, inputs))
+   *   mDetector.ProcessBlock(sideChain, nFrames);
+   * @endcode
+   * @param buffers The inputs or outputs passed to ProcessBlock()
+   * @return The buffers of the first channel of the bus, or nullptr if no channel of the bus is connected */
+  sample** GetBusBuffers(ERoute direction, int busIdx, sample** buffers) const { return IsBusConnected(direction, busIdx) ? buffers + GetBusChannelIdx(direction, busIdx) : nullptr; }
+
   /** @param direction Whether you want to test inputs or outputs
    * @return The number of channels connected for input/output. WARNING: this assumes consecutive channel connections */
   int NChannelsConnected(ERoute direction) const;
@@ -217,6 +283,10 @@ public:
 
   /** @return \c true if the plug-in was configured to receive midi at compile time */
   bool DoesMIDIOut() const { return mDoesMIDIOut; }
+
+  /** @return The number of MIDI messages sent with SendMidiMsg() that were dropped because the MIDI output queue was full.
+   * If this isn't zero, increase PLUG_MIDI_OUTPUT_QUEUE_SIZE in config.h. This method can be called on any thread */
+  int GetNumDroppedMidiOutputMsgs() const { return mMidiOutputQueue.GetNumDropped(); }
   
   /** @return \c true if the plug-in was configured to support midi polyphonic expression at compile time */
   bool DoesMPE() const { return mDoesMPE; }
@@ -231,6 +301,7 @@ public:
 
   /** Call this if the latency of your plug-in changes after initialization (perhaps from OnReset() )
    * This may not be supported by the host. The method is virtual because it's overridden in API classes.
+   * If an internal block size is set, it is added to the latency reported to the host, see GetReportedLatency()
    @param latency Latency in samples */
   virtual void SetLatency(int latency);
 
@@ -240,6 +311,101 @@ public:
    * @param tailSize the new tailsize in samples*/
   void SetTailSize(int tailSize) { mTailSize = tailSize; }
 
+  /** Call this in your plug-in's constructor to opt-in to sample accurate automation.
+   * When enabled, API classes that support it (currently VST3) will queue every automation point the host sends, rather than only the last one,
+   * and split ProcessBlock() at the sample offsets of the changes, so that OnParamChange() is called just before the frames that the new value applies to.
+   * ProcessBlock() may therefore be called several times per host block, with pointers offset into the host's buffers and a smaller nFrames.
+   * MIDI message offsets are still relative to the start of the host's block. Enable SetSubBlockProcessing() as well, if you want messages to be delivered just before the sub-block they apply to.
+   * @param enable \c true to enable sample accurate automation */
+  void SetSampleAccurateAutomation(bool enable) { mSampleAccurateAutomation = enable; }
+
+  /** @return \c true if the plug-in has opted-in to sample accurate automation, see SetSampleAccurateAutomation() */
+  bool GetSampleAccurateAutomation() const { return mSampleAccurateAutomation; }
+
+  /** Call this in your plug-in's constructor to opt-in to sub-block processing. Instead of calling ProcessMidiMsg() for every message before ProcessBlock(),
+   * incoming MIDI messages are held and the host's block is split at their sample offsets, calling ProcessMidiMsg() and then ProcessSubBlock() for each segment.
+   * To bound the cost of very dense MIDI or automation, sub-blocks are never shorter than minSubBlockSize samples (except the last one in a host block),
+   * messages falling inside a sub-block are delivered at its start.
+   * @param enable \c true to enable sub-block processing
+   * @param minSubBlockSize The minimum sub-block size in samples */
+  void SetSubBlockProcessing(bool enable, int minSubBlockSize = 16) { mSubBlockProcessing = enable; mMinSubBlockSize = std::max(minSubBlockSize, 1); }
+
+  /** @return \c true if the plug-in has opted-in to sub-block processing, see SetSubBlockProcessing() */
+  bool GetSubBlockProcessing() const { return mSubBlockProcessing; }
+
+  /** @return The minimum sub-block size in samples, see SetSubBlockProcessing() */
+  int GetMinSubBlockSize() const { return mMinSubBlockSize; }
+
+  /** Get the values of a parameter flagged IParam::kFlagAudioRate, for every sample of the block being processed.
+   * Host automation ramps (VST3 parameter queue points, AudioUnit ramped parameter events) are followed exactly, other changes to the parameter are smoothed over the time set with SetParamBufferSmoothingTime().
+   * Read the buffer from index 0 in ProcessBlock(), or from startFrame in ProcessSubBlock(). Only call this on the audio thread.
+   * @param paramIdx The index of the parameter
+   * @return A pointer to the parameter's (non-normalized) values, or nullptr if the parameter isn't flagged as audio-rate */
+  const sample* GetParamBuffer(int paramIdx) const;
+
+  /** Set the time over which changes to audio-rate parameters that aren't ramped by the host are smoothed, see GetParamBuffer()
+   * @param timeMs The smoothing time in milliseconds, or 0 to apply changes immediately */
+  void SetParamBufferSmoothingTime(double timeMs) { mParamBufferSmoothingTime = std::max(timeMs, 0.); }
+
+  /** Call this in your plug-in's constructor if your ProcessBlock() can safely process in-place, i.e. it reads inputs[i] before writing outputs[i] for each frame.
+   * When enabled and the host buffers need converting to/from ::sample, each connected output channel shares the scratch buffer of the corresponding input channel,
+   * so the converted input is processed in-place instead of via a second scratch buffer. When the host supplies buffers that are already ::sample precision they are always passed directly,
+   * in which case the host itself may supply the same buffer for input and output channels.
+   * @param enable \c true if ProcessBlock() supports inputs[i] == outputs[i] */
+  void SetProcessInPlace(bool enable) { mProcessInPlace = enable; }
+
+  /** @return \c true if the plug-in has declared that it can process in-place, see SetProcessInPlace() */
+  bool GetProcessInPlace() const { return mProcessInPlace; }
+
+  /** Call this in your plug-in's constructor to allow the framework to skip ProcessBlock() when the plug-in is idle.
+   * Once all connected inputs have been silent (and no MIDI has been received) for longer than the tail size plus the latency, the outputs are zeroed without calling ProcessBlock(),
+   * and hosts that support it (VST3, AU) are told that the output is silent. Processing resumes with the first block of non-silent input or MIDI.
+   * Only enable this if your plug-in produces silence given silent input after its tail, so not for generators. Use SetTailSize() to declare the tail, a negative tail size is treated as infinite.
+   * For instruments the tail is counted from the last MIDI message, so it must be longer than any note can sound.
+   * @param enable \c true to skip processing silent input */
+  void SetSkipProcessingOnSilence(bool enable) { mSkipProcessingOnSilence = enable; }
+
+  /** @return \c true if the plug-in has opted-in to skipping processing on silent input, see SetSkipProcessingOnSilence() */
+  bool GetSkipProcessingOnSilence() const { return mSkipProcessingOnSilence; }
+
+  /** By default the FPU is set to flush denormals to zero (FTZ/DAZ) while the plug-in processes audio, and the host's FPU state is restored afterwards.
+   * Call this with \c false if your DSP depends on denormal numbers, or set PLUG_FLUSH_DENORMALS to 0 in config.h
+   * @param enable \c true to flush denormals to zero during processing */
+  void SetFlushDenormals(bool enable) { mFlushDenormals = enable; }
+
+  /** @return \c true if denormals are flushed to zero during processing, see SetFlushDenormals() */
+  bool GetFlushDenormals() const { return mFlushDenormals; }
+
+  /** Call this to enable measuring the time spent processing each block of audio. The timings are queued lock-free on the audio thread and collected by GetProcessingLoad()
+   * @param enable \c true to measure the processing load */
+  void SetMeasureProcessingLoad(bool enable) { mMeasureProcessingLoad = enable; }
+
+  /** @return \c true if the processing load is being measured, see SetMeasureProcessingLoad() */
+  bool GetMeasureProcessingLoad() const { return mMeasureProcessingLoad; }
+
+  /** Collect the block timings queued by the audio thread and calculate statistics over the last PROCESSING_LOAD_WINDOW blocks.
+   * This method is not realtime safe, call it on the main thread, for example in OnIdle(), and send the result to the editor e.g. with SendControlMsgFromDelegate() for an IFPSDisplayControl
+   * @param load The statistics will be stored here
+   * @return \c true if any new blocks have been measured since the last call */
+  bool GetProcessingLoad(ProcessingLoad& load);
+
+  /** Call this to create a pool of worker threads owned by the plug-in, that can be used in ProcessBlock() to process independent jobs (e.g. output buses or groups of voices) in parallel.
+   * This method is not realtime safe, call it from your plug-in's constructor or OnReset(). Calling it again restarts the pool, passing 0 destroys it. See IPlugWorkerPool
+   * @param nThreads The number of worker threads, in addition to the audio thread. Pass -1 to use one less than the number of hardware threads */
+  void SetWorkerPoolSize(int nThreads);
+
+  /** @return A pointer to the plug-in's worker pool, or nullptr if SetWorkerPoolSize() has not been called */
+  IPlugWorkerPool* GetWorkerPool() { return mWorkerPool.get(); }
+
+  /** A function that switches a DSP setting between its realtime (\c false) and offline rendering (\c true) values. It is called on the audio thread, so it must not allocate or lock */
+  using RenderQualityFunc = std::function<void(bool offline)>;
+
+  /** Register a setting that should use higher quality when the host renders offline, e.g. an OverSampler factor or the polyphony of a MidiSynth.
+   * The function is called on the audio thread before the first block processed after the host switches between realtime and offline rendering, so bounces use the high quality values and live playback keeps the cheap ones.
+   * The plug-in should start with its realtime settings. This method is not realtime safe, call it from your plug-in's constructor
+   * @param func The function that applies the setting */
+  void AddRenderQualitySetting(RenderQualityFunc func) { mRenderQualitySettings.push_back(func); }
+
   /** A static method to parse the config.h channel I/O string.
    * @param IOStr Space separated cstring list of I/O configurations for this plug-in in the format ninchans-noutchans.
    * A hypen character \c(-) deliminates input-output. Supports multiple buses, which are indicated using a period \c(.) character.
@@ -266,15 +432,71 @@ protected:
   void ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames);
   void ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames);
   void ProcessBuffersAccumulating(int nFrames); // only for VST2 deprecated method single precision
+  /** Called by the API classes for MIDI messages received on the audio thread. Calls ProcessMidiMsg() now, or holds the message until its sub-block see SetSubBlockProcessing() */
+  void HandleMidiMsg(const IMidiMsg& msg);
+  /** Called by the API classes for MIDI 2.0 messages received on the audio thread. Calls ProcessUMP() now, or holds the message until its sub-block, like HandleMidiMsg() */
+  void HandleUMP(const IMidiUMP& msg);
+  /** Called by the API classes to schedule a parameter change at a sample offset in the next block, changes are applied via ApplyParamChange().
+   * Up to one change per sample of the block can be scheduled, which is allocated by SetBlockSize(), any more are applied straight away */
+  void AddParamChange(const ParamChange& change);
+  /** Implemented by API classes that call AddParamChange(), to set the parameter value and notify the plug-in */
+  virtual void ApplyParamChange(const ParamChange& change) {}
+  /** Called by the API classes before processing starts, to allocate buffers for the parameters flagged IParam::kFlagAudioRate, see GetParamBuffer(). This method is not realtime safe
+   * @param params The plug-in's parameters, see IEditorDelegate::GetParams() */
+  void InitParamBuffers(const WDL_PtrList<IParam>& params);
+  /** @return \c true if the parameter has a buffer of values, see GetParamBuffer() */
+  bool HasParamBuffer(int paramIdx) const { return paramIdx >= 0 && paramIdx < mParamBufferIdxForParam.GetSize() && mParamBufferIdxForParam.Get()[paramIdx] > -1; }
+  /** Called by the API classes to ramp an audio-rate parameter in the next block, see GetParamBuffer(). The parameter's value itself must still be set as usual.
+   * Up to one ramp per sample of the block can be queued, which is allocated by SetBlockSize(), any more are dropped */
+  void AddParamRamp(const ParamRamp& ramp);
+  /** Deliver any MIDI messages and parameter changes that are still pending, e.g. if the block was not processed */
+  void FlushScheduledEvents();
+  /** Called by API classes whose host flags silent buffers, before ProcessBuffers(), so that the inputs don't need to be scanned for silence
+   * @param silent \c true if the host has flagged all connected input channels as silent for the next block */
+  void SetHostInputIsSilent(bool silent) { mHostInputIsSilent = silent; }
   void ZeroScratchBuffers();
   void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
   void SetBlockSize(int blockSize);
   void SetBypassed(bool bypassed) { mBypassed = bypassed; }
   void SetTimeInfo(const ITimeInfo& timeInfo) { mTimeInfo = timeInfo; }
-  void SetRenderingOffline(bool renderingOffline) { mRenderingOffline = renderingOffline; }
+  /** Called by the API classes when the host switches between realtime and offline rendering. It may be called on any thread, the switch is applied at the start of the next block */
+  void SetRenderingOffline(bool renderingOffline) { mRenderingOffline.store(renderingOffline, std::memory_order_relaxed); }
   const WDL_String& GetChannelLabel(ERoute direction, int idx) { return mChannelData[direction].Get(idx)->mLabel; }
 
 private:
+  /** Copy and cast the processed scratch buffers for connected outputs to the API's PLUG_SAMPLE_SRC output buffers */
+  void CastCopyOutputs(int nFrames);
+  /** Split the block at the offsets of scheduled MIDI messages and parameter changes */
+  void ProcessScheduledBlock(sample** inputs, sample** outputs, int nFrames);
+  /** Buffer the attached buffers through the internal block size FIFO, processing each time it fills */
+  void ProcessInternalBlocks(int nFrames);
+  /** Process a segment of the buffers, starting startFrame frames into the block */
+  void ProcessSegment(sample** inputs, sample** outputs, int startFrame, int nFrames);
+  /** @return \c true if there are MIDI messages or parameter changes waiting to be delivered */
+  bool HasScheduledEvents() const;
+  /** @return The offset of the next scheduled event, or INT_MAX if there are none */
+  int NextScheduledEventOffset() const;
+  /** Deliver the scheduled events with offsets before beforeOffset */
+  void DeliverScheduledEvents(int beforeOffset);
+  /** Remove the delivered events and subtract nFrames from the offsets of those remaining */
+  void ShiftScheduledEvents(int nFrames);
+  /** Process the attached buffers for this block */
+  void ProcessBuffersInternal(int nFrames);
+  /** Call OnBusConnectionChanged() for the buses that the host has connected or disconnected since the last block, and zero the buffers of input channels that were disconnected */
+  void UpdateBusConnections();
+  /** If the host has switched between realtime and offline rendering since the last block, apply the quality settings for the new mode */
+  void UpdateRenderQuality();
+  /** Resize the audio-rate parameter buffers for the current block size */
+  void ResizeParamBuffers();
+  /** Fill the audio-rate parameter buffers for the next nFrames, following the ramps that start within them
+   * @param startLateRamps If \c true, ramps that start after nFrames are started at the end of the block, otherwise they are kept for the next block */
+  void RenderParamBuffers(int nFrames, bool startLateRamps);
+  /** Update the silence count for this block and zero the outputs if processing can be skipped
+   * @return \c true if the block should not be processed */
+  bool SkipSilentBlock(int nFrames);
+  /** @return \c true if all connected input channels contain only zeros for nFrames */
+  bool InputsAreSilent(int nFrames) const;
+
   /** See EIPlugPluginTypes */
   EIPlugPluginType mPlugType;
   /** \c true if the plug-in accepts MIDI input */
@@ -294,18 +516,110 @@ private:
   /** \c true if the plug-in is bypassed */
   bool mBypassed = false;
   /** \c true if the plug-in is rendering off-line*/
-  bool mRenderingOffline = false;
+  std::atomic<bool> mRenderingOffline {false};
+  /** The rendering mode the quality settings were last applied for, audio thread only */
+  bool mRenderQualityIsOffline = false;
+  /** \c true if the plug-in has opted-in to sample accurate automation */
+  bool mSampleAccurateAutomation = false;
+  /** \c true if the plug-in's ProcessBlock() supports in-place processing */
+  bool mProcessInPlace = false;
+  /** \c true if the plug-in has opted-in to skipping processing on silent input */
+  bool mSkipProcessingOnSilence = false;
+  /** \c true if the host has flagged the current input as silent */
+  bool mHostInputIsSilent = false;
+  /** \c true if MIDI was received since the last block */
+  bool mMidiReceived = false;
+  /** \c true if the last block was skipped and the outputs zeroed */
+  bool mOutputIsSilent = false;
+  /** The number of consecutive samples of silent input */
+  int64_t mSilentSamples = 0;
+  /** \c true if denormals should be flushed to zero during processing */
+  bool mFlushDenormals;
+  /** \c true if the plug-in has opted-in to sub-block processing */
+  bool mSubBlockProcessing = false;
+  /** The minimum sub-block size (in samples) */
+  int mMinSubBlockSize = 16;
+  /** MIDI messages held until their sub-block when sub-block processing, preallocated in SetBlockSize(), any more are dropped */
+  IMidiOutputQueue mScheduledMidiMsgs;
+  /** MIDI 2.0 messages held until their sub-block, preallocated in SetBlockSize(), any more are dropped */
+  IMidiUMPQueue mScheduledUMPs;
+  /** Parameter changes for the next block, sorted by offset */
+  WDL_TypedBuf<ParamChange> mScheduledParamChanges;
+  /** The number of parameter changes allocated in mScheduledParamChanges */
+  int mScheduledParamChangeCapacity = 0;
+  /** Index of the next parameter change to apply in mScheduledParamChanges */
+  int mNextParamChangeIdx = 0;
+  /** The ramp an audio-rate parameter is following, see GetParamBuffer() */
+  struct ParamBufferState
+  {
+    int paramIdx;
+    const IParam* pParam;
+    double value; // the current normalized value
+    double target; // the normalized value at the end of the ramp
+    double increment; // per sample
+    int remaining; // samples until the end of the ramp
+  };
+  /** The ramp state of each audio-rate parameter */
+  WDL_TypedBuf<ParamBufferState> mParamBufferStates;
+  /** For each parameter, its index in mParamBufferStates, or -1 if it isn't audio-rate */
+  WDL_TypedBuf<int> mParamBufferIdxForParam;
+  /** The values of the audio-rate parameters, mParamBufferSize samples each */
+  WDL_TypedBuf<sample> mParamBufferData;
+  /** The size of each buffer in mParamBufferData (in samples) */
+  int mParamBufferSize = 0;
+  /** Ramps for audio-rate parameters in the next block, sorted by offset */
+  WDL_TypedBuf<ParamRamp> mParamRamps;
+  /** The number of ramps allocated in mParamRamps */
+  int mParamRampCapacity = 0;
+  /** The time over which changes that aren't ramped by the host are smoothed (in milliseconds) */
+  double mParamBufferSmoothingTime = 5.;
+  /** Fixed block size for ProcessBlock() (in samples), or 0 to use the host's block size */
+  int mInternalBlockSize;
+  /** Number of samples written to the internal block size FIFO */
+  int mFifoPos = 0;
+  /** Storage for the internal block size FIFO, for all input and output channels */
+  WDL_TypedBuf<sample> mFifoBuf[2];
+  /** Pointers to each channel in mFifoBuf */
+  WDL_TypedBuf<sample*> mFifoData[2];
   /** A list of IOConfig structures populated by ParseChannelIOStr in the IPlugProcessor constructor */
   WDL_PtrList<IOConfig> mIOConfigs;
   /* Manages pointers to the actual data for each channel */
   WDL_TypedBuf<sample*> mScratchData[2];
+  /* Pointers offset into mScratchData, used when processing a segment of a block */
+  WDL_TypedBuf<sample*> mSegmentData[2];
   /* A list of IChannelData structures corresponding to every input/output channel */
   WDL_PtrList<IChannelData<>> mChannelData[2];
+  /** The index of the first channel of each input/output bus, with one more entry for the end of the last bus */
+  WDL_TypedBuf<int> mBusChannelIdx[2];
+  /** Whether each input/output channel was connected for the last block, see UpdateBusConnections() */
+  WDL_TypedBuf<bool> mChannelWasConnected[2];
+  /** The duration of a processed block and its real-time budget, queued from the audio thread */
+  struct ProcessingTime
+  {
+    float durationUs;
+    float budgetUs;
+  };
+  /** \c true if the processing load should be measured */
+  bool mMeasureProcessingLoad = false;
+  /** Block timings from the audio thread, waiting to be collected by GetProcessingLoad() */
+  IPlugQueue<ProcessingTime> mProcessingTimes {PROCESSING_LOAD_TRANSFER_SIZE};
+  /** The last PROCESSING_LOAD_WINDOW block timings, used on the main thread only */
+  WDL_TypedBuf<ProcessingTime> mProcessingTimeHistory;
+  /** Write position in mProcessingTimeHistory */
+  int mProcessingTimeHistoryPos = 0;
+  /** Scratch space for calculating percentiles on the main thread */
+  WDL_TypedBuf<float> mProcessingTimeScratch;
+  /** Optional pool of worker threads, see SetWorkerPoolSize() */
+  std::unique_ptr<IPlugWorkerPool> mWorkerPool;
+  /** Functions that switch settings between realtime and offline quality, see AddRenderQualitySetting() */
+  std::vector<RenderQualityFunc> mRenderQualitySettings;
 protected: // these members are protected because they need to be access by the API classes, and don't want a setter/getter
   /** A multi-channel delay line used to delay the bypassed signal when a plug-in with latency is bypassed. */
   std::unique_ptr<NChanDelayLine<sample>> mLatencyDelay = nullptr;
   /** Contains detailed information about the transport state */
   ITimeInfo mTimeInfo;
+  /** MIDI messages sent by the plug-in during the current block, output by the API class after processing. The capacity is set with PLUG_MIDI_OUTPUT_QUEUE_SIZE in config.h */
+  IMidiOutputQueue mMidiOutputQueue;
 };
 
 END_IPLUG_NAMESPACE
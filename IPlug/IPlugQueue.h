@@ -15,16 +15,20 @@
  * @copydoc IPlugQueue
  */
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 
 #include "heapbuf.h"
 
 #include "IPlugPlatform.h"
+#include "IPlugMemoryAccounting.h"
 
 BEGIN_IPLUG_NAMESPACE
 
 /** A lock-free SPSC queue used to transfer data between threads
+ * The read and write indices are kept on separate cache lines, so that the producer and consumer threads don't contend for the same line.
+ * As well as single elements, elements can be pushed and popped in bulk with PushN() and PopN(), or read in place with PeekSpan() and Consume()
  * based on MLQueue.h by Randy Jones
  * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/ */
 template<typename T>
@@ -48,6 +52,7 @@ public:
   void Resize(int size)
   {
     mData.Resize(size + 1);
+    mMemoryCharge.Set(mData.GetSize() * sizeof(T));
   }
 
   /** \todo 
@@ -83,6 +88,100 @@ public:
     return true;
   }
 
+  /** Push several elements, publishing them to the consumer at once
+   * @param pItems Pointer to the elements to push
+   * @param n The number of elements
+   * @return The number of elements that were pushed, which is less than n if the queue is full */
+  size_t PushN(const T* pItems, size_t n)
+  {
+    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const auto readIndex = mReadIndex.load(std::memory_order_acquire);
+    const size_t size = mData.GetSize();
+    const size_t space = (readIndex > currentWriteIndex) ? readIndex - currentWriteIndex - 1 : size - (currentWriteIndex - readIndex) - 1;
+
+    if (n > space)
+      n = space;
+
+    // copy up to the end of the buffer, then from the start
+    const size_t first = std::min(n, size - currentWriteIndex);
+    std::copy(pItems, pItems + first, mData.Get() + currentWriteIndex);
+    std::copy(pItems + first, pItems + n, mData.Get());
+
+    mWriteIndex.store((currentWriteIndex + n) % size, std::memory_order_release);
+    return n;
+  }
+
+  /** Pop several elements
+   * @param pItems Pointer to space for at least maxN elements
+   * @param maxN The maximum number of elements to pop
+   * @return The number of elements that were popped */
+  size_t PopN(T* pItems, size_t maxN)
+  {
+    size_t n = 0;
+    const T* pSpan = nullptr;
+
+    // the available elements are in at most two contiguous spans
+    for (int i = 0; i < 2 && n < maxN; i++)
+    {
+      const size_t spanSize = std::min(PeekSpan(pSpan), maxN - n);
+
+      if (!spanSize)
+        break;
+
+      std::copy(pSpan, pSpan + spanSize, pItems + n);
+      Consume(spanSize);
+      n += spanSize;
+    }
+
+    return n;
+  }
+
+  /** Access the next elements in place, without copying or removing them. Call Consume() when they have been handled
+   * @param pItems Set to point to the next element
+   * @return The number of contiguous elements available from pItems, which may be fewer than ElementsAvailable() if the elements wrap around the end of the buffer */
+  size_t PeekSpan(const T*& pItems) const
+  {
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    const auto writeIndex = mWriteIndex.load(std::memory_order_acquire);
+    pItems = mData.Get() + currentReadIndex;
+    return (writeIndex >= currentReadIndex) ? writeIndex - currentReadIndex : mData.GetSize() - currentReadIndex;
+  }
+
+  /** Remove elements from the queue, after reading them with PeekSpan()
+   * @param n The number of elements to remove, at most the number returned by PeekSpan() */
+  void Consume(size_t n)
+  {
+    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
+    mReadIndex.store((currentReadIndex + n) % mData.GetSize(), std::memory_order_release);
+  }
+
+  /** Call a function for each element that is available, reading them in place, and remove them from the queue
+   * @param func A function taking a const T&
+   * @return The number of elements that were handled */
+  template <class Func>
+  size_t ConsumeAll(Func&& func)
+  {
+    size_t n = 0;
+    const T* pSpan = nullptr;
+
+    // the available elements are in at most two contiguous spans
+    for (int i = 0; i < 2; i++)
+    {
+      const size_t spanSize = PeekSpan(pSpan);
+
+      if (!spanSize)
+        break;
+
+      for (size_t j = 0; j < spanSize; j++)
+        func(pSpan[j]);
+
+      Consume(spanSize);
+      n += spanSize;
+    }
+
+    return n;
+  }
+
   /** \todo 
    * @return size_t \todo */
   size_t ElementsAvailable() const
@@ -93,6 +192,16 @@ public:
     return (read > write) ? mData.GetSize() - (read - write) : write - read;
   }
 
+  /** @return The number of elements that can be pushed, call this on the producer thread. The space can only grow until the next push,
+   * so a producer can check that a group of elements fits before pushing them with PushN(), which publishes them to the consumer at once */
+  size_t SpaceAvailable() const
+  {
+    const size_t write = mWriteIndex.load(std::memory_order_relaxed);
+    const size_t read = mReadIndex.load(std::memory_order_acquire);
+
+    return (read > write) ? read - write - 1 : mData.GetSize() - (write - read) - 1;
+  }
+
   /** \todo
    * useful for reading elements while a criterion is met. Can be used like
    * while IPlugQueue.ElementsAvailable() && q.peek().mTime < 100 { elem = q.pop() ... }
@@ -129,9 +238,16 @@ private:
     return (idx + 1) % (mData.GetSize());
   }
 
+  static constexpr size_t kCacheLineSize = 64;
+
   WDL_TypedBuf<T> mData;
+  IPlugMemoryCharge mMemoryCharge {EMemorySubsystem::kQueues};
+  // padding keeps the indices, written by different threads, on their own cache lines
+  char mPadding0[kCacheLineSize];
   std::atomic<size_t> mWriteIndex{0};
+  char mPadding1[kCacheLineSize - sizeof(std::atomic<size_t>)];
   std::atomic<size_t> mReadIndex{0};
+  char mPadding2[kCacheLineSize - sizeof(std::atomic<size_t>)];
 };
 
 END_IPLUG_NAMESPACE
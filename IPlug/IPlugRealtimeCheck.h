@@ -0,0 +1,232 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Detection of realtime violations on the audio thread, in debug builds
+ *
+ * Define IPLUG_REALTIME_CHECKS (e.g. in a debug configuration) to enable it. The API classes mark the thread that calls their process callback as realtime
+ * for the duration of the callback, with IPLUG_MARK_REALTIME_THREAD(). While a thread is marked:
+ * - calls to the global operator new and delete, e.g. std::vector growing, std::function capturing or a std::string being built, are caught by replacements of the operators in IPlugProcessor.cpp
+ * - framework code that allocates with malloc, takes a lock, or does file I/O reports it with IPLUG_REALTIME_CHECK(), e.g. IMidiQueue::Expand()
+ *
+ * Each violation is counted, and, depending on SetRealtimeViolationAction(), logged with a stack trace or asserted. The counts are shown by the IGraphics performance display, see IGraphics::ShowFPSDisplay().
+ * Plug-in code can report its own violations with IPLUG_REALTIME_CHECK(), and suspend the checks around code that is known to be safe with IPLUG_ALLOW_REALTIME_VIOLATIONS().
+ * malloc(), locks and file I/O from outside the framework, e.g. in the standard library or the OS, are not caught, since they can't be intercepted portably in a plug-in.
+ * Without IPLUG_REALTIME_CHECKS, the macros compile to nothing.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+#include "IPlugPlatform.h"
+
+#if defined IPLUG_REALTIME_CHECKS && (defined OS_MAC || defined OS_LINUX || defined OS_IOS)
+  #include <execinfo.h>
+  #include <unistd.h>
+#elif defined IPLUG_REALTIME_CHECKS && defined OS_WIN
+  #include <windows.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The kinds of realtime violation that are detected */
+enum class ERealtimeViolation
+{
+  kAllocation,
+  kDeallocation,
+  kLock,
+  kFileIO,
+  kNumViolations
+};
+
+/** What to do when a violation is detected, in addition to counting it */
+enum class ERealtimeViolationAction
+{
+  kCount, // only count it
+  kLog, // print it with a stack trace, for the first few violations of each kind
+  kAssert // print it with a stack trace and assert
+};
+
+/** The number of violations of each kind since the process started, see GetRealtimeViolationSummary() */
+struct RealtimeViolationSummary
+{
+  int64_t counts[static_cast<int>(ERealtimeViolation::kNumViolations)] = {};
+  const char* lastDescription = nullptr; // the description of the last violation
+
+  int64_t Total() const
+  {
+    int64_t total = 0;
+
+    for (auto count : counts)
+      total += count;
+
+    return total;
+  }
+};
+
+static inline const char* RealtimeViolationStr(ERealtimeViolation violation)
+{
+  static const char* sStrs[] = { "allocation", "deallocation", "lock", "file I/O" };
+  return sStrs[static_cast<int>(violation)];
+}
+
+#if defined IPLUG_REALTIME_CHECKS
+
+namespace RealtimeCheck
+{
+  /** The state of the checks, shared by the whole process since the functions are inline */
+  struct State
+  {
+    std::atomic<int64_t> counts[static_cast<int>(ERealtimeViolation::kNumViolations)] = {};
+    std::atomic<const char*> lastDescription {nullptr};
+    std::atomic<int> nLogged[static_cast<int>(ERealtimeViolation::kNumViolations)] = {};
+    std::atomic<ERealtimeViolationAction> action {ERealtimeViolationAction::kLog};
+  };
+
+  static constexpr int kMaxLoggedPerKind = 8;
+
+  inline State& GetState()
+  {
+    static State sState;
+    return sState;
+  }
+
+  /** @return The depth of the realtime scopes on the calling thread, or less than 1 if it isn't marked */
+  inline int& ThreadDepth()
+  {
+    thread_local int tDepth = 0;
+    return tDepth;
+  }
+
+  /** @return \c true while a violation is being reported on the calling thread, so that the report itself isn't reported */
+  inline bool& ThreadReporting()
+  {
+    thread_local bool tReporting = false;
+    return tReporting;
+  }
+
+  inline void PrintStackTrace()
+  {
+  #if defined OS_MAC || defined OS_LINUX || defined OS_IOS
+    void* frames[32];
+    const int nFrames = backtrace(frames, 32);
+    backtrace_symbols_fd(frames + 2, nFrames - 2, STDERR_FILENO); // skips the reporting functions
+  #elif defined OS_WIN
+    void* frames[32];
+    const int nFrames = CaptureStackBackTrace(2, 32, frames, nullptr);
+
+    for (int i = 0; i < nFrames; i++)
+    {
+      char str[64];
+      snprintf(str, 64, "  %2d %p\n", i, frames[i]);
+      OutputDebugStringA(str);
+      fputs(str, stderr);
+    }
+  #endif
+  }
+
+  /** Count and report a violation if the calling thread is marked as realtime. Called by IPLUG_REALTIME_CHECK() and the operator new and delete replacements
+   * @param violation The kind of violation
+   * @param description What caused it, which must be a string literal */
+  inline void Report(ERealtimeViolation violation, const char* description)
+  {
+    if (ThreadDepth() < 1 || ThreadReporting())
+      return;
+
+    ThreadReporting() = true;
+    State& state = GetState();
+    const int kind = static_cast<int>(violation);
+    state.counts[kind].fetch_add(1, std::memory_order_relaxed);
+    state.lastDescription.store(description, std::memory_order_relaxed);
+
+    const ERealtimeViolationAction action = state.action.load(std::memory_order_relaxed);
+
+    if (action == ERealtimeViolationAction::kAssert || (action == ERealtimeViolationAction::kLog && state.nLogged[kind].fetch_add(1, std::memory_order_relaxed) < kMaxLoggedPerKind))
+    {
+      fprintf(stderr, "IPlug realtime violation: %s (%s) on the audio thread\n", RealtimeViolationStr(violation), description);
+      PrintStackTrace();
+    }
+
+    ThreadReporting() = false;
+
+    if (action == ERealtimeViolationAction::kAssert)
+      assert(false && "realtime violation on the audio thread, see the stack trace above");
+  }
+} // namespace RealtimeCheck
+
+/** Marks the calling thread as realtime while it is in scope, see IPLUG_MARK_REALTIME_THREAD() */
+class ScopedRealtimeThread
+{
+public:
+  ScopedRealtimeThread() { RealtimeCheck::ThreadDepth()++; }
+  ~ScopedRealtimeThread() { RealtimeCheck::ThreadDepth()--; }
+
+  ScopedRealtimeThread(const ScopedRealtimeThread&) = delete;
+  ScopedRealtimeThread& operator=(const ScopedRealtimeThread&) = delete;
+};
+
+/** Suspends the checks on the calling thread while it is in scope, see IPLUG_ALLOW_REALTIME_VIOLATIONS() */
+class ScopedAllowRealtimeViolations
+{
+public:
+  ScopedAllowRealtimeViolations() : mDepth(RealtimeCheck::ThreadDepth()) { RealtimeCheck::ThreadDepth() = 0; }
+  ~ScopedAllowRealtimeViolations() { RealtimeCheck::ThreadDepth() = mDepth; }
+
+  ScopedAllowRealtimeViolations(const ScopedAllowRealtimeViolations&) = delete;
+  ScopedAllowRealtimeViolations& operator=(const ScopedAllowRealtimeViolations&) = delete;
+
+private:
+  int mDepth;
+};
+
+/** @return \c true if the calling thread is marked as realtime */
+inline bool IsRealtimeThread() { return RealtimeCheck::ThreadDepth() > 0; }
+
+/** Set what happens when a violation is detected, the default is ERealtimeViolationAction::kLog */
+inline void SetRealtimeViolationAction(ERealtimeViolationAction action) { RealtimeCheck::GetState().action.store(action, std::memory_order_relaxed); }
+
+/** @return The number of violations of each kind since the process started */
+inline RealtimeViolationSummary GetRealtimeViolationSummary()
+{
+  RealtimeViolationSummary summary;
+  RealtimeCheck::State& state = RealtimeCheck::GetState();
+
+  for (int i = 0; i < static_cast<int>(ERealtimeViolation::kNumViolations); i++)
+    summary.counts[i] = state.counts[i].load(std::memory_order_relaxed);
+
+  summary.lastDescription = state.lastDescription.load(std::memory_order_relaxed);
+  return summary;
+}
+
+#define IPLUG_REALTIME_CHECK_CONCAT_(a, b) a##b
+#define IPLUG_REALTIME_CHECK_CONCAT(a, b) IPLUG_REALTIME_CHECK_CONCAT_(a, b)
+
+#define IPLUG_MARK_REALTIME_THREAD() iplug::ScopedRealtimeThread IPLUG_REALTIME_CHECK_CONCAT(realtimeThread, __LINE__)
+#define IPLUG_ALLOW_REALTIME_VIOLATIONS() iplug::ScopedAllowRealtimeViolations IPLUG_REALTIME_CHECK_CONCAT(allowRealtimeViolations, __LINE__)
+#define IPLUG_REALTIME_CHECK(violation, description) iplug::RealtimeCheck::Report(iplug::ERealtimeViolation::violation, description)
+
+#else
+
+inline bool IsRealtimeThread() { return false; }
+inline void SetRealtimeViolationAction(ERealtimeViolationAction) {}
+inline RealtimeViolationSummary GetRealtimeViolationSummary() { return RealtimeViolationSummary(); }
+
+#define IPLUG_MARK_REALTIME_THREAD() do {} while(0)
+#define IPLUG_ALLOW_REALTIME_VIOLATIONS() do {} while(0)
+#define IPLUG_REALTIME_CHECK(violation, description) do {} while(0)
+
+#endif
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,1118 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Vectorized kernels for converting and accumulating sample buffers, used in the API classes' I/O paths, see CastCopy(), for the complex multiply-accumulate of FFT convolution,
+ * and for the gain, mix, pan, peak and RMS buffer operations used by the Extras and the ISender classes
+ * The widest instruction set available is selected at runtime on x86 (SSE2 or AVX), NEON is used on ARM64, and WebAssembly SIMD128 when the web modules are built
+ * with -msimd128, see common-web.mk. A WebAssembly module can't test for SIMD itself, so the web loader picks the SIMD or the scalar build. Other targets use scalar loops.
+ * @ingroup IPlugUtilities
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "IPlugPlatform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define IPLUG_SIMD_X86
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #define IPLUG_TARGET_AVX
+  #else
+    #define IPLUG_TARGET_AVX __attribute__((target("avx")))
+  #endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  #define IPLUG_SIMD_NEON
+  #include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+  #define IPLUG_SIMD_WASM
+  #include <wasm_simd128.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+namespace simd {
+
+#pragma mark - Scalar
+
+static inline void ConvertScalar(double* pDest, const float* pSrc, int n) { for (int i = 0; i < n; i++) pDest[i] = (double) pSrc[i]; }
+static inline void ConvertScalar(float* pDest, const double* pSrc, int n) { for (int i = 0; i < n; i++) pDest[i] = (float) pSrc[i]; }
+static inline void AccumulateScalar(float* pDest, const float* pSrc, int n) { for (int i = 0; i < n; i++) pDest[i] += pSrc[i]; }
+static inline void AccumulateScalar(float* pDest, const double* pSrc, int n) { for (int i = 0; i < n; i++) pDest[i] += (float) pSrc[i]; }
+
+/** pDest += pA * pB, for nComplex interleaved complex numbers */
+template <typename T>
+static inline void ComplexMultiplyAccumulateScalar(T* pDest, const T* pA, const T* pB, int nComplex)
+{
+  for (int i = 0; i < nComplex * 2; i += 2)
+  {
+    pDest[i] += pA[i] * pB[i] - pA[i + 1] * pB[i + 1];
+    pDest[i + 1] += pA[i] * pB[i + 1] + pA[i + 1] * pB[i];
+  }
+}
+
+/** pDest = pSrc * a gain that ramps linearly, starting at gain and increasing by gainIncr each sample. pDest and pSrc may be the same buffer */
+template <typename T>
+static inline void GainScalar(T* pDest, const T* pSrc, int n, T gain, T gainIncr)
+{
+  for (int i = 0; i < n; i++)
+    pDest[i] = pSrc[i] * (gain + i * gainIncr);
+}
+
+/** pDest = a linear ramp, starting at start and increasing by incr each sample */
+static inline void RampScalar(float* pDest, int n, float start, float incr)
+{
+  for (int i = 0; i < n; i++)
+    pDest[i] = start + i * incr;
+}
+
+/** pDest += pSrc * gain */
+template <typename T>
+static inline void MultiplyAddScalar(T* pDest, const T* pSrc, int n, T gain)
+{
+  for (int i = 0; i < n; i++)
+    pDest[i] += pSrc[i] * gain;
+}
+
+/** Widen the range *pMin to *pMax to include the samples */
+template <typename T>
+static inline void MinMaxScalar(const T* pSrc, int n, T* pMin, T* pMax)
+{
+  for (int i = 0; i < n; i++)
+  {
+    *pMin = std::min(*pMin, pSrc[i]);
+    *pMax = std::max(*pMax, pSrc[i]);
+  }
+}
+
+template <typename T>
+static inline T SumAbsScalar(const T* pSrc, int n)
+{
+  T sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += std::fabs(pSrc[i]);
+  return sum;
+}
+
+template <typename T>
+static inline T SumSquaresScalar(const T* pSrc, int n)
+{
+  T sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += pSrc[i] * pSrc[i];
+  return sum;
+}
+
+#if defined IPLUG_SIMD_X86
+#pragma mark - SSE2
+
+static inline void ConvertSSE2(double* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(pSrc + i);
+    _mm_storeu_pd(pDest + i, _mm_cvtps_pd(x));
+    _mm_storeu_pd(pDest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void ConvertSSE2(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i));
+    const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i + 2));
+    _mm_storeu_ps(pDest + i, _mm_movelh_ps(lo, hi));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateSSE2(float* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm_loadu_ps(pSrc + i)));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateSSE2(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i));
+    const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i + 2));
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm_movelh_ps(lo, hi)));
+  }
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void ComplexMultiplyAccumulateSSE2(float* pDest, const float* pA, const float* pB, int nComplex)
+{
+  const __m128 signs = _mm_set_ps(1.f, -1.f, 1.f, -1.f);
+  int i = 0;
+  for (; i + 2 <= nComplex; i += 2)
+  {
+    const __m128 a = _mm_loadu_ps(pA + i * 2);
+    const __m128 b = _mm_loadu_ps(pB + i * 2);
+    const __m128 bRe = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128 bIm = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+    const __m128 aSwapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+    const __m128 product = _mm_add_ps(_mm_mul_ps(a, bRe), _mm_mul_ps(_mm_mul_ps(aSwapped, bIm), signs));
+    _mm_storeu_ps(pDest + i * 2, _mm_add_ps(_mm_loadu_ps(pDest + i * 2), product));
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+
+static inline void ComplexMultiplyAccumulateSSE2(double* pDest, const double* pA, const double* pB, int nComplex)
+{
+  const __m128d signs = _mm_set_pd(1., -1.);
+  for (int i = 0; i < nComplex * 2; i += 2)
+  {
+    const __m128d a = _mm_loadu_pd(pA + i);
+    const __m128d b = _mm_loadu_pd(pB + i);
+    const __m128d product = _mm_add_pd(_mm_mul_pd(a, _mm_unpacklo_pd(b, b)), _mm_mul_pd(_mm_mul_pd(_mm_shuffle_pd(a, a, 1), _mm_unpackhi_pd(b, b)), signs));
+    _mm_storeu_pd(pDest + i, _mm_add_pd(_mm_loadu_pd(pDest + i), product));
+  }
+}
+
+static inline float HorizontalSumSSE2(__m128 x)
+{
+  x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  return _mm_cvtss_f32(_mm_add_ss(x, _mm_shuffle_ps(x, x, 1)));
+}
+
+static inline double HorizontalSumSSE2(__m128d x)
+{
+  return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+}
+
+static inline void GainSSE2(float* pDest, const float* pSrc, int n, float gain, float gainIncr)
+{
+  const __m128 ramp = _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(gainIncr));
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(pDest + i, _mm_mul_ps(_mm_loadu_ps(pSrc + i), _mm_add_ps(_mm_set1_ps(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void GainSSE2(double* pDest, const double* pSrc, int n, double gain, double gainIncr)
+{
+  const __m128d ramp = _mm_set_pd(gainIncr, 0.);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(pDest + i, _mm_mul_pd(_mm_loadu_pd(pSrc + i), _mm_add_pd(_mm_set1_pd(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void RampSSE2(float* pDest, int n, float start, float incr)
+{
+  const __m128 ramp = _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps(incr));
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_set1_ps(start + i * incr), ramp));
+  RampScalar(pDest + i, n - i, start + i * incr, incr);
+}
+
+static inline void MultiplyAddSSE2(float* pDest, const float* pSrc, int n, float gain)
+{
+  const __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm_mul_ps(_mm_loadu_ps(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MultiplyAddSSE2(double* pDest, const double* pSrc, int n, double gain)
+{
+  const __m128d g = _mm_set1_pd(gain);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(pDest + i, _mm_add_pd(_mm_loadu_pd(pDest + i), _mm_mul_pd(_mm_loadu_pd(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MinMaxSSE2(const float* pSrc, int n, float* pMin, float* pMax)
+{
+  __m128 lo = _mm_set1_ps(*pMin);
+  __m128 hi = _mm_set1_ps(*pMax);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(pSrc + i);
+    lo = _mm_min_ps(lo, x);
+    hi = _mm_max_ps(hi, x);
+  }
+  float los[4], his[4];
+  _mm_storeu_ps(los, lo);
+  _mm_storeu_ps(his, hi);
+  MinMaxScalar(los, 4, pMin, pMax);
+  MinMaxScalar(his, 4, pMin, pMax);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline void MinMaxSSE2(const double* pSrc, int n, double* pMin, double* pMax)
+{
+  __m128d lo = _mm_set1_pd(*pMin);
+  __m128d hi = _mm_set1_pd(*pMax);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const __m128d x = _mm_loadu_pd(pSrc + i);
+    lo = _mm_min_pd(lo, x);
+    hi = _mm_max_pd(hi, x);
+  }
+  double los[2], his[2];
+  _mm_storeu_pd(los, lo);
+  _mm_storeu_pd(his, hi);
+  MinMaxScalar(los, 2, pMin, pMax);
+  MinMaxScalar(his, 2, pMin, pMax);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline float SumAbsSSE2(const float* pSrc, int n)
+{
+  const __m128 sign = _mm_set1_ps(-0.f);
+  __m128 sum = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    sum = _mm_add_ps(sum, _mm_andnot_ps(sign, _mm_loadu_ps(pSrc + i)));
+  return HorizontalSumSSE2(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline double SumAbsSSE2(const double* pSrc, int n)
+{
+  const __m128d sign = _mm_set1_pd(-0.);
+  __m128d sum = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    sum = _mm_add_pd(sum, _mm_andnot_pd(sign, _mm_loadu_pd(pSrc + i)));
+  return HorizontalSumSSE2(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline float SumSquaresSSE2(const float* pSrc, int n)
+{
+  __m128 sum = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(pSrc + i);
+    sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+  }
+  return HorizontalSumSSE2(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+static inline double SumSquaresSSE2(const double* pSrc, int n)
+{
+  __m128d sum = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const __m128d x = _mm_loadu_pd(pSrc + i);
+    sum = _mm_add_pd(sum, _mm_mul_pd(x, x));
+  }
+  return HorizontalSumSSE2(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+#pragma mark - AVX
+
+IPLUG_TARGET_AVX static inline void ConvertAVX(double* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    _mm256_storeu_pd(pDest + i, _mm256_cvtps_pd(_mm_loadu_ps(pSrc + i)));
+    _mm256_storeu_pd(pDest + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(pSrc + i + 4)));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline void ConvertAVX(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    _mm_storeu_ps(pDest + i, _mm256_cvtpd_ps(_mm256_loadu_pd(pSrc + i)));
+    _mm_storeu_ps(pDest + i + 4, _mm256_cvtpd_ps(_mm256_loadu_pd(pSrc + i + 4)));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline void AccumulateAVX(float* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(pDest + i, _mm256_add_ps(_mm256_loadu_ps(pDest + i), _mm256_loadu_ps(pSrc + i)));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline void AccumulateAVX(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm256_cvtpd_ps(_mm256_loadu_pd(pSrc + i))));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline void ComplexMultiplyAccumulateAVX(float* pDest, const float* pA, const float* pB, int nComplex)
+{
+  int i = 0;
+  for (; i + 4 <= nComplex; i += 4)
+  {
+    const __m256 a = _mm256_loadu_ps(pA + i * 2);
+    const __m256 b = _mm256_loadu_ps(pB + i * 2);
+    const __m256 product = _mm256_addsub_ps(_mm256_mul_ps(a, _mm256_moveldup_ps(b)), _mm256_mul_ps(_mm256_permute_ps(a, 0xB1), _mm256_movehdup_ps(b)));
+    _mm256_storeu_ps(pDest + i * 2, _mm256_add_ps(_mm256_loadu_ps(pDest + i * 2), product));
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+
+IPLUG_TARGET_AVX static inline void ComplexMultiplyAccumulateAVX(double* pDest, const double* pA, const double* pB, int nComplex)
+{
+  int i = 0;
+  for (; i + 2 <= nComplex; i += 2)
+  {
+    const __m256d a = _mm256_loadu_pd(pA + i * 2);
+    const __m256d b = _mm256_loadu_pd(pB + i * 2);
+    const __m256d product = _mm256_addsub_pd(_mm256_mul_pd(a, _mm256_movedup_pd(b)), _mm256_mul_pd(_mm256_permute_pd(a, 0x5), _mm256_permute_pd(b, 0xF)));
+    _mm256_storeu_pd(pDest + i * 2, _mm256_add_pd(_mm256_loadu_pd(pDest + i * 2), product));
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+
+IPLUG_TARGET_AVX static inline float HorizontalSumAVX(__m256 x)
+{
+  return HorizontalSumSSE2(_mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1)));
+}
+
+IPLUG_TARGET_AVX static inline double HorizontalSumAVX(__m256d x)
+{
+  return HorizontalSumSSE2(_mm_add_pd(_mm256_castpd256_pd128(x), _mm256_extractf128_pd(x, 1)));
+}
+
+IPLUG_TARGET_AVX static inline void GainAVX(float* pDest, const float* pSrc, int n, float gain, float gainIncr)
+{
+  const __m256 ramp = _mm256_mul_ps(_mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f), _mm256_set1_ps(gainIncr));
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(pDest + i, _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), _mm256_add_ps(_mm256_set1_ps(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+IPLUG_TARGET_AVX static inline void GainAVX(double* pDest, const double* pSrc, int n, double gain, double gainIncr)
+{
+  const __m256d ramp = _mm256_mul_pd(_mm256_set_pd(3., 2., 1., 0.), _mm256_set1_pd(gainIncr));
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(pDest + i, _mm256_mul_pd(_mm256_loadu_pd(pSrc + i), _mm256_add_pd(_mm256_set1_pd(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+IPLUG_TARGET_AVX static inline void RampAVX(float* pDest, int n, float start, float incr)
+{
+  const __m256 ramp = _mm256_mul_ps(_mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f), _mm256_set1_ps(incr));
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(pDest + i, _mm256_add_ps(_mm256_set1_ps(start + i * incr), ramp));
+  RampScalar(pDest + i, n - i, start + i * incr, incr);
+}
+
+IPLUG_TARGET_AVX static inline void MultiplyAddAVX(float* pDest, const float* pSrc, int n, float gain)
+{
+  const __m256 g = _mm256_set1_ps(gain);
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(pDest + i, _mm256_add_ps(_mm256_loadu_ps(pDest + i), _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+IPLUG_TARGET_AVX static inline void MultiplyAddAVX(double* pDest, const double* pSrc, int n, double gain)
+{
+  const __m256d g = _mm256_set1_pd(gain);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(pDest + i, _mm256_add_pd(_mm256_loadu_pd(pDest + i), _mm256_mul_pd(_mm256_loadu_pd(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+IPLUG_TARGET_AVX static inline void MinMaxAVX(const float* pSrc, int n, float* pMin, float* pMax)
+{
+  __m256 lo = _mm256_set1_ps(*pMin);
+  __m256 hi = _mm256_set1_ps(*pMax);
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 x = _mm256_loadu_ps(pSrc + i);
+    lo = _mm256_min_ps(lo, x);
+    hi = _mm256_max_ps(hi, x);
+  }
+  float los[8], his[8];
+  _mm256_storeu_ps(los, lo);
+  _mm256_storeu_ps(his, hi);
+  MinMaxScalar(los, 8, pMin, pMax);
+  MinMaxScalar(his, 8, pMin, pMax);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+IPLUG_TARGET_AVX static inline void MinMaxAVX(const double* pSrc, int n, double* pMin, double* pMax)
+{
+  __m256d lo = _mm256_set1_pd(*pMin);
+  __m256d hi = _mm256_set1_pd(*pMax);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m256d x = _mm256_loadu_pd(pSrc + i);
+    lo = _mm256_min_pd(lo, x);
+    hi = _mm256_max_pd(hi, x);
+  }
+  double los[4], his[4];
+  _mm256_storeu_pd(los, lo);
+  _mm256_storeu_pd(his, hi);
+  MinMaxScalar(los, 4, pMin, pMax);
+  MinMaxScalar(his, 4, pMin, pMax);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+IPLUG_TARGET_AVX static inline float SumAbsAVX(const float* pSrc, int n)
+{
+  const __m256 sign = _mm256_set1_ps(-0.f);
+  __m256 sum = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    sum = _mm256_add_ps(sum, _mm256_andnot_ps(sign, _mm256_loadu_ps(pSrc + i)));
+  return HorizontalSumAVX(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline double SumAbsAVX(const double* pSrc, int n)
+{
+  const __m256d sign = _mm256_set1_pd(-0.);
+  __m256d sum = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    sum = _mm256_add_pd(sum, _mm256_andnot_pd(sign, _mm256_loadu_pd(pSrc + i)));
+  return HorizontalSumAVX(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline float SumSquaresAVX(const float* pSrc, int n)
+{
+  __m256 sum = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    const __m256 x = _mm256_loadu_ps(pSrc + i);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(x, x));
+  }
+  return HorizontalSumAVX(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+IPLUG_TARGET_AVX static inline double SumSquaresAVX(const double* pSrc, int n)
+{
+  __m256d sum = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const __m256d x = _mm256_loadu_pd(pSrc + i);
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(x, x));
+  }
+  return HorizontalSumAVX(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+/** @return \c true if the CPU and OS support AVX */
+static inline bool CPUSupportsAVX()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+  const bool cpuHasAVX = (info[2] & (1 << 28)) != 0;
+  return osUsesXSave && cpuHasAVX && (_xgetbv(0) & 0x6) == 0x6;
+#else
+  return __builtin_cpu_supports("avx");
+#endif
+}
+
+#elif defined IPLUG_SIMD_NEON
+#pragma mark - NEON
+
+static inline void ConvertNEON(double* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float32x4_t x = vld1q_f32(pSrc + i);
+    vst1q_f64(pDest + i, vcvt_f64_f32(vget_low_f32(x)));
+    vst1q_f64(pDest + i + 2, vcvt_high_f64_f32(x));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void ConvertNEON(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(pDest + i, vcvt_high_f32_f64(vcvt_f32_f64(vld1q_f64(pSrc + i)), vld1q_f64(pSrc + i + 2)));
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateNEON(float* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(pDest + i, vaddq_f32(vld1q_f32(pDest + i), vld1q_f32(pSrc + i)));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateNEON(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float32x4_t x = vcvt_high_f32_f64(vcvt_f32_f64(vld1q_f64(pSrc + i)), vld1q_f64(pSrc + i + 2));
+    vst1q_f32(pDest + i, vaddq_f32(vld1q_f32(pDest + i), x));
+  }
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void ComplexMultiplyAccumulateNEON(float* pDest, const float* pA, const float* pB, int nComplex)
+{
+  int i = 0;
+  for (; i + 4 <= nComplex; i += 4)
+  {
+    const float32x4x2_t a = vld2q_f32(pA + i * 2);
+    const float32x4x2_t b = vld2q_f32(pB + i * 2);
+    float32x4x2_t d = vld2q_f32(pDest + i * 2);
+    d.val[0] = vmlsq_f32(vmlaq_f32(d.val[0], a.val[0], b.val[0]), a.val[1], b.val[1]);
+    d.val[1] = vmlaq_f32(vmlaq_f32(d.val[1], a.val[0], b.val[1]), a.val[1], b.val[0]);
+    vst2q_f32(pDest + i * 2, d);
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+
+static inline void ComplexMultiplyAccumulateNEON(double* pDest, const double* pA, const double* pB, int nComplex)
+{
+  int i = 0;
+  for (; i + 2 <= nComplex; i += 2)
+  {
+    const float64x2x2_t a = vld2q_f64(pA + i * 2);
+    const float64x2x2_t b = vld2q_f64(pB + i * 2);
+    float64x2x2_t d = vld2q_f64(pDest + i * 2);
+    d.val[0] = vfmsq_f64(vfmaq_f64(d.val[0], a.val[0], b.val[0]), a.val[1], b.val[1]);
+    d.val[1] = vfmaq_f64(vfmaq_f64(d.val[1], a.val[0], b.val[1]), a.val[1], b.val[0]);
+    vst2q_f64(pDest + i * 2, d);
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+static inline void GainNEON(float* pDest, const float* pSrc, int n, float gain, float gainIncr)
+{
+  static const float kLanes[4] = {0.f, 1.f, 2.f, 3.f};
+  const float32x4_t ramp = vmulq_n_f32(vld1q_f32(kLanes), gainIncr);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(pDest + i, vmulq_f32(vld1q_f32(pSrc + i), vaddq_f32(vdupq_n_f32(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void GainNEON(double* pDest, const double* pSrc, int n, double gain, double gainIncr)
+{
+  static const double kLanes[2] = {0., 1.};
+  const float64x2_t ramp = vmulq_n_f64(vld1q_f64(kLanes), gainIncr);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    vst1q_f64(pDest + i, vmulq_f64(vld1q_f64(pSrc + i), vaddq_f64(vdupq_n_f64(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void RampNEON(float* pDest, int n, float start, float incr)
+{
+  static const float kLanes[4] = {0.f, 1.f, 2.f, 3.f};
+  const float32x4_t ramp = vmulq_n_f32(vld1q_f32(kLanes), incr);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(pDest + i, vaddq_f32(vdupq_n_f32(start + i * incr), ramp));
+  RampScalar(pDest + i, n - i, start + i * incr, incr);
+}
+
+static inline void MultiplyAddNEON(float* pDest, const float* pSrc, int n, float gain)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32(pDest + i, vmlaq_n_f32(vld1q_f32(pDest + i), vld1q_f32(pSrc + i), gain));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MultiplyAddNEON(double* pDest, const double* pSrc, int n, double gain)
+{
+  const float64x2_t g = vdupq_n_f64(gain);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    vst1q_f64(pDest + i, vfmaq_f64(vld1q_f64(pDest + i), vld1q_f64(pSrc + i), g));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MinMaxNEON(const float* pSrc, int n, float* pMin, float* pMax)
+{
+  float32x4_t lo = vdupq_n_f32(*pMin);
+  float32x4_t hi = vdupq_n_f32(*pMax);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float32x4_t x = vld1q_f32(pSrc + i);
+    lo = vminq_f32(lo, x);
+    hi = vmaxq_f32(hi, x);
+  }
+  *pMin = vminvq_f32(lo);
+  *pMax = vmaxvq_f32(hi);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline void MinMaxNEON(const double* pSrc, int n, double* pMin, double* pMax)
+{
+  float64x2_t lo = vdupq_n_f64(*pMin);
+  float64x2_t hi = vdupq_n_f64(*pMax);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const float64x2_t x = vld1q_f64(pSrc + i);
+    lo = vminq_f64(lo, x);
+    hi = vmaxq_f64(hi, x);
+  }
+  *pMin = vminvq_f64(lo);
+  *pMax = vmaxvq_f64(hi);
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline float SumAbsNEON(const float* pSrc, int n)
+{
+  float32x4_t sum = vdupq_n_f32(0.f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    sum = vaddq_f32(sum, vabsq_f32(vld1q_f32(pSrc + i)));
+  return vaddvq_f32(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline double SumAbsNEON(const double* pSrc, int n)
+{
+  float64x2_t sum = vdupq_n_f64(0.);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    sum = vaddq_f64(sum, vabsq_f64(vld1q_f64(pSrc + i)));
+  return vaddvq_f64(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline float SumSquaresNEON(const float* pSrc, int n)
+{
+  float32x4_t sum = vdupq_n_f32(0.f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const float32x4_t x = vld1q_f32(pSrc + i);
+    sum = vmlaq_f32(sum, x, x);
+  }
+  return vaddvq_f32(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+static inline double SumSquaresNEON(const double* pSrc, int n)
+{
+  float64x2_t sum = vdupq_n_f64(0.);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const float64x2_t x = vld1q_f64(pSrc + i);
+    sum = vfmaq_f64(sum, x, x);
+  }
+  return vaddvq_f64(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+#elif defined IPLUG_SIMD_WASM
+#pragma mark - WebAssembly SIMD128
+
+static inline void ConvertWASM(double* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const v128_t x = wasm_v128_load(pSrc + i);
+    wasm_v128_store(pDest + i, wasm_f64x2_promote_low_f32x4(x));
+    wasm_v128_store(pDest + i + 2, wasm_f64x2_promote_low_f32x4(wasm_i64x2_shuffle(x, x, 1, 1)));
+  }
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline v128_t DemoteWASM(const double* pSrc)
+{
+  const v128_t lo = wasm_f32x4_demote_f64x2_zero(wasm_v128_load(pSrc));
+  const v128_t hi = wasm_f32x4_demote_f64x2_zero(wasm_v128_load(pSrc + 2));
+  return wasm_i64x2_shuffle(lo, hi, 0, 2);
+}
+
+static inline void ConvertWASM(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, DemoteWASM(pSrc + i));
+  ConvertScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateWASM(float* pDest, const float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, wasm_f32x4_add(wasm_v128_load(pDest + i), wasm_v128_load(pSrc + i)));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void AccumulateWASM(float* pDest, const double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, wasm_f32x4_add(wasm_v128_load(pDest + i), DemoteWASM(pSrc + i)));
+  AccumulateScalar(pDest + i, pSrc + i, n - i);
+}
+
+static inline void ComplexMultiplyAccumulateWASM(float* pDest, const float* pA, const float* pB, int nComplex)
+{
+  int i = 0;
+  for (; i + 4 <= nComplex; i += 4)
+  {
+    // deinterleave four complex numbers into their real and imaginary parts
+    const v128_t a0 = wasm_v128_load(pA + i * 2), a1 = wasm_v128_load(pA + i * 2 + 4);
+    const v128_t b0 = wasm_v128_load(pB + i * 2), b1 = wasm_v128_load(pB + i * 2 + 4);
+    const v128_t aRe = wasm_i32x4_shuffle(a0, a1, 0, 2, 4, 6), aIm = wasm_i32x4_shuffle(a0, a1, 1, 3, 5, 7);
+    const v128_t bRe = wasm_i32x4_shuffle(b0, b1, 0, 2, 4, 6), bIm = wasm_i32x4_shuffle(b0, b1, 1, 3, 5, 7);
+    const v128_t re = wasm_f32x4_sub(wasm_f32x4_mul(aRe, bRe), wasm_f32x4_mul(aIm, bIm));
+    const v128_t im = wasm_f32x4_add(wasm_f32x4_mul(aRe, bIm), wasm_f32x4_mul(aIm, bRe));
+    wasm_v128_store(pDest + i * 2, wasm_f32x4_add(wasm_v128_load(pDest + i * 2), wasm_i32x4_shuffle(re, im, 0, 4, 1, 5)));
+    wasm_v128_store(pDest + i * 2 + 4, wasm_f32x4_add(wasm_v128_load(pDest + i * 2 + 4), wasm_i32x4_shuffle(re, im, 2, 6, 3, 7)));
+  }
+  ComplexMultiplyAccumulateScalar(pDest + i * 2, pA + i * 2, pB + i * 2, nComplex - i);
+}
+
+static inline void ComplexMultiplyAccumulateWASM(double* pDest, const double* pA, const double* pB, int nComplex)
+{
+  const v128_t signs = wasm_f64x2_make(-1., 1.);
+  for (int i = 0; i < nComplex; i++)
+  {
+    const v128_t a = wasm_v128_load(pA + i * 2);
+    const v128_t b = wasm_v128_load(pB + i * 2);
+    const v128_t aRe = wasm_i64x2_shuffle(a, a, 0, 0);
+    const v128_t aIm = wasm_i64x2_shuffle(a, a, 1, 1);
+    const v128_t bSwapped = wasm_i64x2_shuffle(b, b, 1, 0);
+    const v128_t prod = wasm_f64x2_add(wasm_f64x2_mul(aRe, b), wasm_f64x2_mul(wasm_f64x2_mul(aIm, bSwapped), signs));
+    wasm_v128_store(pDest + i * 2, wasm_f64x2_add(wasm_v128_load(pDest + i * 2), prod));
+  }
+}
+
+static inline void GainWASM(float* pDest, const float* pSrc, int n, float gain, float gainIncr)
+{
+  const v128_t ramp = wasm_f32x4_make(0.f, gainIncr, 2.f * gainIncr, 3.f * gainIncr);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, wasm_f32x4_mul(wasm_v128_load(pSrc + i), wasm_f32x4_add(wasm_f32x4_splat(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void GainWASM(double* pDest, const double* pSrc, int n, double gain, double gainIncr)
+{
+  const v128_t ramp = wasm_f64x2_make(0., gainIncr);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    wasm_v128_store(pDest + i, wasm_f64x2_mul(wasm_v128_load(pSrc + i), wasm_f64x2_add(wasm_f64x2_splat(gain + i * gainIncr), ramp)));
+  GainScalar(pDest + i, pSrc + i, n - i, gain + i * gainIncr, gainIncr);
+}
+
+static inline void RampWASM(float* pDest, int n, float start, float incr)
+{
+  const v128_t ramp = wasm_f32x4_make(0.f, incr, 2.f * incr, 3.f * incr);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, wasm_f32x4_add(wasm_f32x4_splat(start + i * incr), ramp));
+  RampScalar(pDest + i, n - i, start + i * incr, incr);
+}
+
+static inline void MultiplyAddWASM(float* pDest, const float* pSrc, int n, float gain)
+{
+  const v128_t g = wasm_f32x4_splat(gain);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    wasm_v128_store(pDest + i, wasm_f32x4_add(wasm_v128_load(pDest + i), wasm_f32x4_mul(wasm_v128_load(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MultiplyAddWASM(double* pDest, const double* pSrc, int n, double gain)
+{
+  const v128_t g = wasm_f64x2_splat(gain);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    wasm_v128_store(pDest + i, wasm_f64x2_add(wasm_v128_load(pDest + i), wasm_f64x2_mul(wasm_v128_load(pSrc + i), g)));
+  MultiplyAddScalar(pDest + i, pSrc + i, n - i, gain);
+}
+
+static inline void MinMaxWASM(const float* pSrc, int n, float* pMin, float* pMax)
+{
+  v128_t lo = wasm_f32x4_splat(*pMin);
+  v128_t hi = wasm_f32x4_splat(*pMax);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const v128_t x = wasm_v128_load(pSrc + i);
+    lo = wasm_f32x4_min(lo, x);
+    hi = wasm_f32x4_max(hi, x);
+  }
+  for (int l = 0; l < 4; l++)
+  {
+    *pMin = std::min(*pMin, wasm_f32x4_extract_lane(lo, 0));
+    *pMax = std::max(*pMax, wasm_f32x4_extract_lane(hi, 0));
+    lo = wasm_i32x4_shuffle(lo, lo, 1, 2, 3, 0);
+    hi = wasm_i32x4_shuffle(hi, hi, 1, 2, 3, 0);
+  }
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline void MinMaxWASM(const double* pSrc, int n, double* pMin, double* pMax)
+{
+  v128_t lo = wasm_f64x2_splat(*pMin);
+  v128_t hi = wasm_f64x2_splat(*pMax);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const v128_t x = wasm_v128_load(pSrc + i);
+    lo = wasm_f64x2_min(lo, x);
+    hi = wasm_f64x2_max(hi, x);
+  }
+  *pMin = std::min(wasm_f64x2_extract_lane(lo, 0), wasm_f64x2_extract_lane(lo, 1));
+  *pMax = std::max(wasm_f64x2_extract_lane(hi, 0), wasm_f64x2_extract_lane(hi, 1));
+  MinMaxScalar(pSrc + i, n - i, pMin, pMax);
+}
+
+static inline float HorizontalSumWASM(v128_t x)
+{
+  x = wasm_f32x4_add(x, wasm_i32x4_shuffle(x, x, 2, 3, 0, 1));
+  x = wasm_f32x4_add(x, wasm_i32x4_shuffle(x, x, 1, 0, 3, 2));
+  return wasm_f32x4_extract_lane(x, 0);
+}
+
+static inline float SumAbsWASM(const float* pSrc, int n)
+{
+  v128_t sum = wasm_f32x4_splat(0.f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    sum = wasm_f32x4_add(sum, wasm_f32x4_abs(wasm_v128_load(pSrc + i)));
+  return HorizontalSumWASM(sum) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline double SumAbsWASM(const double* pSrc, int n)
+{
+  v128_t sum = wasm_f64x2_splat(0.);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    sum = wasm_f64x2_add(sum, wasm_f64x2_abs(wasm_v128_load(pSrc + i)));
+  return wasm_f64x2_extract_lane(sum, 0) + wasm_f64x2_extract_lane(sum, 1) + SumAbsScalar(pSrc + i, n - i);
+}
+
+static inline float SumSquaresWASM(const float* pSrc, int n)
+{
+  v128_t sum = wasm_f32x4_splat(0.f);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    const v128_t x = wasm_v128_load(pSrc + i);
+    sum = wasm_f32x4_add(sum, wasm_f32x4_mul(x, x));
+  }
+  return HorizontalSumWASM(sum) + SumSquaresScalar(pSrc + i, n - i);
+}
+
+static inline double SumSquaresWASM(const double* pSrc, int n)
+{
+  v128_t sum = wasm_f64x2_splat(0.);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+  {
+    const v128_t x = wasm_v128_load(pSrc + i);
+    sum = wasm_f64x2_add(sum, wasm_f64x2_mul(x, x));
+  }
+  return wasm_f64x2_extract_lane(sum, 0) + wasm_f64x2_extract_lane(sum, 1) + SumSquaresScalar(pSrc + i, n - i);
+}
+#endif
+
+#pragma mark - Dispatch
+
+/** The kernels selected for this CPU */
+struct Kernels
+{
+  void (*floatToDouble)(double* pDest, const float* pSrc, int n) = ConvertScalar;
+  void (*doubleToFloat)(float* pDest, const double* pSrc, int n) = ConvertScalar;
+  void (*accumulateFloat)(float* pDest, const float* pSrc, int n) = AccumulateScalar;
+  void (*accumulateDouble)(float* pDest, const double* pSrc, int n) = AccumulateScalar;
+  void (*complexMACFloat)(float* pDest, const float* pA, const float* pB, int nComplex) = ComplexMultiplyAccumulateScalar<float>;
+  void (*complexMACDouble)(double* pDest, const double* pA, const double* pB, int nComplex) = ComplexMultiplyAccumulateScalar<double>;
+  void (*gainFloat)(float* pDest, const float* pSrc, int n, float gain, float gainIncr) = GainScalar<float>;
+  void (*gainDouble)(double* pDest, const double* pSrc, int n, double gain, double gainIncr) = GainScalar<double>;
+  void (*rampFloat)(float* pDest, int n, float start, float incr) = RampScalar;
+  void (*multiplyAddFloat)(float* pDest, const float* pSrc, int n, float gain) = MultiplyAddScalar<float>;
+  void (*multiplyAddDouble)(double* pDest, const double* pSrc, int n, double gain) = MultiplyAddScalar<double>;
+  void (*minMaxFloat)(const float* pSrc, int n, float* pMin, float* pMax) = MinMaxScalar<float>;
+  void (*minMaxDouble)(const double* pSrc, int n, double* pMin, double* pMax) = MinMaxScalar<double>;
+  float (*sumAbsFloat)(const float* pSrc, int n) = SumAbsScalar<float>;
+  double (*sumAbsDouble)(const double* pSrc, int n) = SumAbsScalar<double>;
+  float (*sumSquaresFloat)(const float* pSrc, int n) = SumSquaresScalar<float>;
+  double (*sumSquaresDouble)(const double* pSrc, int n) = SumSquaresScalar<double>;
+
+  Kernels()
+  {
+#if defined IPLUG_SIMD_X86
+    if (CPUSupportsAVX())
+    {
+      floatToDouble = ConvertAVX;
+      doubleToFloat = ConvertAVX;
+      accumulateFloat = AccumulateAVX;
+      accumulateDouble = AccumulateAVX;
+      complexMACFloat = ComplexMultiplyAccumulateAVX;
+      complexMACDouble = ComplexMultiplyAccumulateAVX;
+      gainFloat = GainAVX;
+      gainDouble = GainAVX;
+      rampFloat = RampAVX;
+      multiplyAddFloat = MultiplyAddAVX;
+      multiplyAddDouble = MultiplyAddAVX;
+      minMaxFloat = MinMaxAVX;
+      minMaxDouble = MinMaxAVX;
+      sumAbsFloat = SumAbsAVX;
+      sumAbsDouble = SumAbsAVX;
+      sumSquaresFloat = SumSquaresAVX;
+      sumSquaresDouble = SumSquaresAVX;
+    }
+    else
+    {
+      floatToDouble = ConvertSSE2;
+      doubleToFloat = ConvertSSE2;
+      accumulateFloat = AccumulateSSE2;
+      accumulateDouble = AccumulateSSE2;
+      complexMACFloat = ComplexMultiplyAccumulateSSE2;
+      complexMACDouble = ComplexMultiplyAccumulateSSE2;
+      gainFloat = GainSSE2;
+      gainDouble = GainSSE2;
+      rampFloat = RampSSE2;
+      multiplyAddFloat = MultiplyAddSSE2;
+      multiplyAddDouble = MultiplyAddSSE2;
+      minMaxFloat = MinMaxSSE2;
+      minMaxDouble = MinMaxSSE2;
+      sumAbsFloat = SumAbsSSE2;
+      sumAbsDouble = SumAbsSSE2;
+      sumSquaresFloat = SumSquaresSSE2;
+      sumSquaresDouble = SumSquaresSSE2;
+    }
+#elif defined IPLUG_SIMD_NEON
+    floatToDouble = ConvertNEON;
+    doubleToFloat = ConvertNEON;
+    accumulateFloat = AccumulateNEON;
+    accumulateDouble = AccumulateNEON;
+    complexMACFloat = ComplexMultiplyAccumulateNEON;
+    complexMACDouble = ComplexMultiplyAccumulateNEON;
+    gainFloat = GainNEON;
+    gainDouble = GainNEON;
+    rampFloat = RampNEON;
+    multiplyAddFloat = MultiplyAddNEON;
+    multiplyAddDouble = MultiplyAddNEON;
+    minMaxFloat = MinMaxNEON;
+    minMaxDouble = MinMaxNEON;
+    sumAbsFloat = SumAbsNEON;
+    sumAbsDouble = SumAbsNEON;
+    sumSquaresFloat = SumSquaresNEON;
+    sumSquaresDouble = SumSquaresNEON;
+#elif defined IPLUG_SIMD_WASM
+    floatToDouble = ConvertWASM;
+    doubleToFloat = ConvertWASM;
+    accumulateFloat = AccumulateWASM;
+    accumulateDouble = AccumulateWASM;
+    complexMACFloat = ComplexMultiplyAccumulateWASM;
+    complexMACDouble = ComplexMultiplyAccumulateWASM;
+    gainFloat = GainWASM;
+    gainDouble = GainWASM;
+    rampFloat = RampWASM;
+    multiplyAddFloat = MultiplyAddWASM;
+    multiplyAddDouble = MultiplyAddWASM;
+    minMaxFloat = MinMaxWASM;
+    minMaxDouble = MinMaxWASM;
+    sumAbsFloat = SumAbsWASM;
+    sumAbsDouble = SumAbsWASM;
+    sumSquaresFloat = SumSquaresWASM;
+    sumSquaresDouble = SumSquaresWASM;
+#endif
+  }
+};
+
+/** @return The kernels for this CPU, which are selected the first time this is called */
+static inline const Kernels& GetKernels()
+{
+  static const Kernels sKernels;
+  return sKernels;
+}
+
+#pragma mark - Buffer operations
+
+/** Apply a gain that ramps linearly, e.g. to smooth a change of gain over a block. pDest and pSrc may be the same buffer
+ * @param gain The gain of the first sample
+ * @param gainIncr The change of gain from one sample to the next, 0 for a constant gain */
+static inline void ApplyGain(float* pDest, const float* pSrc, int n, float gain, float gainIncr = 0.f) { GetKernels().gainFloat(pDest, pSrc, n, gain, gainIncr); }
+static inline void ApplyGain(double* pDest, const double* pSrc, int n, double gain, double gainIncr = 0.) { GetKernels().gainDouble(pDest, pSrc, n, gain, gainIncr); }
+
+/** Write a linear ramp, e.g. a control that glides over a block
+ * @param start The value of the first sample
+ * @param incr The change from one sample to the next */
+static inline void Ramp(float* pDest, int n, float start, float incr) { GetKernels().rampFloat(pDest, n, start, incr); }
+
+/** Mix a buffer into another, pDest += pSrc * gain */
+static inline void MultiplyAdd(float* pDest, const float* pSrc, int n, float gain) { GetKernels().multiplyAddFloat(pDest, pSrc, n, gain); }
+static inline void MultiplyAdd(double* pDest, const double* pSrc, int n, double gain) { GetKernels().multiplyAddDouble(pDest, pSrc, n, gain); }
+
+/** Pan a mono buffer to a stereo pair with the equal power law
+ * @param pan The position, from -1 (left) to 1 (right) */
+template <typename T>
+static inline void Pan(T* pLeft, T* pRight, const T* pSrc, int n, T pan)
+{
+  const double angle = (pan + 1.) * 0.25 * 3.14159265358979323846;
+  ApplyGain(pLeft, pSrc, n, static_cast<T>(std::cos(angle)));
+  ApplyGain(pRight, pSrc, n, static_cast<T>(std::sin(angle)));
+}
+
+/** Widen the range *pMin to *pMax to include the samples, so that it can be found over several buffers. Start with *pMin and *pMax set to the first sample */
+static inline void MinMax(const float* pSrc, int n, float* pMin, float* pMax) { GetKernels().minMaxFloat(pSrc, n, pMin, pMax); }
+static inline void MinMax(const double* pSrc, int n, double* pMin, double* pMax) { GetKernels().minMaxDouble(pSrc, n, pMin, pMax); }
+
+/** @return The largest absolute value of the samples */
+template <typename T>
+static inline T Peak(const T* pSrc, int n)
+{
+  T lo = 0, hi = 0;
+  MinMax(pSrc, n, &lo, &hi);
+  return std::max(-lo, hi);
+}
+
+static inline float SumAbs(const float* pSrc, int n) { return GetKernels().sumAbsFloat(pSrc, n); }
+static inline double SumAbs(const double* pSrc, int n) { return GetKernels().sumAbsDouble(pSrc, n); }
+static inline float SumSquares(const float* pSrc, int n) { return GetKernels().sumSquaresFloat(pSrc, n); }
+static inline double SumSquares(const double* pSrc, int n) { return GetKernels().sumSquaresDouble(pSrc, n); }
+
+/** @return The root mean square of the samples, or 0 if there are none */
+template <typename T>
+static inline T RMS(const T* pSrc, int n)
+{
+  return n > 0 ? std::sqrt(SumSquares(pSrc, n) / n) : T(0);
+}
+
+} // namespace simd
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,85 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugSnapshot
+ */
+
+#include <cstdint>
+
+#include "IPlugPlatform.h"
+#include "IPlugTripleBuffer.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A versioned snapshot of some structured state, e.g. step sequencer positions or voice activity, that the processor writes each block and the UI reads.
+ * It is built on an IPlugTripleBuffer, so the processor never waits and the UI always sees a complete, consistent version.
+ * Any number of readers, e.g. several controls, can share a snapshot as long as they are all on the same thread. Each keeps the version it last drew,
+ * and can skip repainting when it hasn't changed. Since IsDirty() is overridden, the control must call IControl::SetPollDirty(true), e.g. in its constructor:
+ * @code
+ * bool IsDirty() override { return mSnapshot.GetVersion() != mDrawnVersion || IControl::IsDirty(); }
+ * void Draw(IGraphics& g) override { const auto& state = mSnapshot.Get(); mDrawnVersion = mSnapshot.GetVersion(); ... }
+ * @endcode */
+template<typename T>
+class IPlugSnapshot final
+{
+public:
+  IPlugSnapshot() = default;
+  IPlugSnapshot(const IPlugSnapshot&) = delete;
+  IPlugSnapshot& operator=(const IPlugSnapshot&) = delete;
+
+  /** @return The state to write, call this on the producer thread. It holds an older version, so the whole state should be written before calling Publish() */
+  T& GetWriteBuffer() { return mBuffer.GetWriteBuffer().state; }
+
+  /** Publish the state in the write buffer as a new version, call this on the producer thread */
+  void Publish()
+  {
+    mBuffer.GetWriteBuffer().version = ++mWriteVersion;
+    mBuffer.Publish();
+  }
+
+  /** Get the latest version of the state, call this on the reader thread
+   * @return The state, which stays valid until the next call to Get() or GetVersion() by any reader */
+  const T& Get()
+  {
+    Update();
+    return mFront->state;
+  }
+
+  /** @return The latest version number, call this on the reader thread. It is 0 until something has been published */
+  uint32_t GetVersion()
+  {
+    Update();
+    return mFront->version;
+  }
+
+private:
+  struct Version
+  {
+    T state {};
+    uint32_t version = 0;
+  };
+
+  void Update()
+  {
+    if (const Version* pNewest = mBuffer.Read())
+      mFront = pNewest;
+  }
+
+  IPlugTripleBuffer<Version> mBuffer;
+  Version mInitial; // read until the first version is published
+  const Version* mFront = &mInitial; // reader only
+  uint32_t mWriteVersion = 0; // producer only
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,226 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugStartupTimeline
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "wdlstring.h"
+
+#include "IPlugPlatform.h"
+#include "IPlugLogger.h"
+#include "IPlugTraceZones.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Times the phases of instantiating a plug-in and opening its editor, so that slow loading can be tracked down, and kept within a budget.
+ * The phases are timestamped by the framework: instantiation from the start of the constructor until the API has the plug-in, and editor opening
+ * from IEditorDelegate::OpenWindow() until the first frame has been drawn. Each time one of them ends the timeline is printed with DBGMSG, and with
+ * IPLUG_TRACE_ZONES defined the phases are also written to the trace, see IPlugTraceZones.h.
+ * Get the timeline of a plug-in with IEditorDelegate::GetStartupTimeline()
+ * @ingroup IPlugUtilities */
+class IPlugStartupTimeline
+{
+  using Clock = std::chrono::steady_clock;
+
+public:
+  enum EPhase
+  {
+    kInstantiate, // from the start of the constructor until the API has the plug-in
+    kEditorOpen, // from OpenWindow() until the first frame has been drawn, which includes the phases below
+    kCreateGraphics, // creating the IGraphics context, e.g. mMakeGraphicsFunc
+    kLayout, // LayoutUI(), e.g. mLayoutFunc
+    kLoadResources, // loading bitmaps, SVGs and fonts while the editor opens, usually during kLayout
+    kUIOpen, // OnUIOpen()
+    kFirstFrame, // drawing the first frame
+    kNumPhases
+  };
+
+  /** Times a phase for the lifetime of the object, or until End() is called. Phases of the editor are only timed while it is opening, and are added up if they happen more than once.
+   * A phase nested in the same phase, e.g. one overload of IGraphics::LoadSVG() calling another, is only timed once. Use it on the UI thread */
+  class ScopedPhase
+  {
+  public:
+    ScopedPhase(IPlugStartupTimeline& timeline, EPhase phase)
+    : mTimeline(timeline)
+    , mPhase(phase)
+    , mStart(Clock::now())
+    , mOutermost(timeline.mPhaseDepth[phase]++ == 0)
+    {
+    }
+
+    ~ScopedPhase()
+    {
+      End();
+    }
+
+    void End()
+    {
+      if (mEnded)
+        return;
+
+      mEnded = true;
+      mTimeline.mPhaseDepth[mPhase]--;
+
+      if (mOutermost && mTimeline.IsEditorOpening())
+      {
+        const Clock::duration time = Clock::now() - mStart;
+        mTimeline.mPhaseTimes[mPhase] += time;
+        AddTraceZone(mPhase, time);
+      }
+    }
+
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+  private:
+    IPlugStartupTimeline& mTimeline;
+    EPhase mPhase;
+    Clock::time_point mStart;
+    bool mOutermost;
+    bool mEnded = false;
+  };
+
+  static const char* GetPhaseStr(EPhase phase)
+  {
+    static const char* sStrs[kNumPhases] = { "Instantiate", "Editor open", "Create graphics", "Layout", "Load resources", "OnUIOpen", "First frame" };
+    return sStrs[phase];
+  }
+
+  /** Called by MakePlug() when the constructor has returned. Instantiation starts when the timeline is constructed, as a member of IEditorDelegate, which is the first base of a plug-in */
+  void EndInstantiation()
+  {
+    mPhaseTimes[kInstantiate] = Clock::now() - mInstantiateStart;
+    AddTraceZone(kInstantiate, mPhaseTimes[kInstantiate]);
+    Report(kInstantiate, mInstantiateBudgetMs);
+  }
+
+  /** Called by OpenWindow(). The phases of the editor are reset, since it may be opened many times */
+  void BeginEditorOpen()
+  {
+    for (int i = kEditorOpen; i < kNumPhases; i++)
+      mPhaseTimes[i] = Clock::duration::zero();
+
+    mEditorOpenStart = Clock::now();
+    mEditorOpening = true;
+  }
+
+  /** Called when the first frame after BeginEditorOpen() has been drawn */
+  void EndEditorOpen()
+  {
+    if (!mEditorOpening)
+      return;
+
+    mPhaseTimes[kEditorOpen] = Clock::now() - mEditorOpenStart;
+    mEditorOpening = false;
+    mNumEditorOpens++;
+    AddTraceZone(kEditorOpen, mPhaseTimes[kEditorOpen]);
+    Report(kEditorOpen, mEditorOpenBudgetMs);
+  }
+
+  /** @return \c true between OpenWindow() and the first frame */
+  bool IsEditorOpening() const { return mEditorOpening; }
+
+  /** @return The number of times the editor has finished opening */
+  int GetNumEditorOpens() const { return mNumEditorOpens; }
+
+  /** @param phase The phase
+   * @return The time the phase took in milliseconds, for the editor phases the last time it was opened */
+  double GetPhaseMs(EPhase phase) const
+  {
+    return std::chrono::duration<double, std::milli>(mPhaseTimes[phase]).count();
+  }
+
+  /** Set budgets for instantiation and opening the editor. A phase that takes longer is reported as over budget, and optionally asserts
+   * @param instantiateMs The budget for kInstantiate in milliseconds, or 0 for none
+   * @param editorOpenMs The budget for kEditorOpen in milliseconds, or 0 for none
+   * @param assertOverBudget If \c true, assert when a budget is exceeded, e.g. in a debug build that is used to test load times */
+  void SetBudgets(double instantiateMs, double editorOpenMs, bool assertOverBudget = false)
+  {
+    mInstantiateBudgetMs = instantiateMs;
+    mEditorOpenBudgetMs = editorOpenMs;
+    mAssertOverBudget = assertOverBudget;
+  }
+
+  /** @return \c true if the last instantiation or editor opening took longer than its budget */
+  bool IsOverBudget() const
+  {
+    return IsOverBudget(kInstantiate, mInstantiateBudgetMs) || IsOverBudget(kEditorOpen, mEditorOpenBudgetMs);
+  }
+
+  /** Get a summary of the timeline, one phase per line
+   * @param str The string to write the summary to */
+  void GetSummary(WDL_String& str) const
+  {
+    str.Set("");
+
+    for (int i = 0; i < kNumPhases; i++)
+    {
+      const int indent = i > kEditorOpen ? 2 : 0; // the phases of opening the editor
+      str.AppendFormatted(128, "%*s%-*s %8.2f ms\n", indent, "", 18 - indent, GetPhaseStr(static_cast<EPhase>(i)), GetPhaseMs(static_cast<EPhase>(i)));
+    }
+  }
+
+private:
+  bool IsOverBudget(EPhase phase, double budgetMs) const
+  {
+    return budgetMs > 0. && GetPhaseMs(phase) > budgetMs;
+  }
+
+  /** With IPLUG_TRACE_ZONES defined, adds a phase that ends now to the trace */
+#if defined IPLUG_TRACE_ZONES
+  static void AddTraceZone(EPhase phase, Clock::duration time)
+  {
+    TraceZoneWriter& writer = TraceZoneWriter::Get();
+    const int64_t endUs = writer.GetTimeUs();
+    const int64_t startUs = endUs - std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+    writer.AddZone(GetPhaseStr(phase), std::max<int64_t>(startUs, 0), endUs); // instantiation can start before the writer
+  }
+#else
+  static void AddTraceZone(EPhase, Clock::duration) {}
+#endif
+
+  void Report(EPhase phase, double budgetMs)
+  {
+    const bool overBudget = IsOverBudget(phase, budgetMs);
+
+#ifndef NDEBUG
+    WDL_String summary;
+
+    // the editor phases are only worth printing once it has opened
+    if (phase == kEditorOpen)
+      GetSummary(summary);
+
+    DBGMSG("Startup timeline: %s %.2f ms%s\n%s", GetPhaseStr(phase), GetPhaseMs(phase), overBudget ? " OVER BUDGET" : "", summary.Get());
+#endif
+
+    if (overBudget && mAssertOverBudget)
+      assert(false && "startup phase over budget, see the startup timeline");
+  }
+
+  Clock::duration mPhaseTimes[kNumPhases] = {};
+  int mPhaseDepth[kNumPhases] = {};
+  Clock::time_point mInstantiateStart = Clock::now(); // see EndInstantiation()
+  Clock::time_point mEditorOpenStart;
+  bool mEditorOpening = false;
+  int mNumEditorOpens = 0;
+  double mInstantiateBudgetMs = 0.;
+  double mEditorOpenBudgetMs = 0.;
+  bool mAssertOverBudget = false;
+};
+
+END_IPLUG_NAMESPACE
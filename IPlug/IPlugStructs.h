@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <memory>
 #include "wdlstring.h"
 #include "ptrlist.h"
 
@@ -40,6 +41,48 @@ struct ParamTuple
   {}
 };
 
+/** Statistics about the time spent processing audio over recent blocks, see IPlugProcessor::GetProcessingLoad() */
+struct ProcessingLoad
+{
+  double meanUs = 0.; // mean processing time per block, in microseconds
+  double p99Us = 0.; // 99th percentile processing time per block, in microseconds
+  double maxUs = 0.; // maximum processing time per block, in microseconds
+  double percent = 0.; // processing time as a percentage of the real-time duration of the blocks
+  int nBlocks = 0; // the number of blocks the statistics were calculated from
+};
+
+/** A normalized parameter change with a sample offset into the current block, used to queue sample accurate automation */
+struct ParamChange
+{
+  int idx;
+  double normalizedValue;
+  int offset;
+
+  ParamChange(int idx = kNoParameter, double normalizedValue = 0., int offset = 0)
+  : idx(idx)
+  , normalizedValue(normalizedValue)
+  , offset(offset)
+  {}
+};
+
+/** A linear ramp of a normalized parameter value over a number of samples, starting at a sample offset into the current block, used to fill the buffers of audio-rate parameters, see IPlugProcessor::GetParamBuffer() */
+struct ParamRamp
+{
+  int idx;
+  double normalizedValue; // the value at the end of the ramp
+  int offset;
+  int duration; // the length of the ramp in samples, or 0 for an immediate change, which is smoothed
+  double startNormalizedValue; // the value at the start of the ramp, or -1 to ramp from the current value
+
+  ParamRamp(int idx = kNoParameter, double normalizedValue = 0., int offset = 0, int duration = 0, double startNormalizedValue = -1.)
+  : idx(idx)
+  , normalizedValue(normalizedValue)
+  , offset(offset)
+  , duration(duration)
+  , startNormalizedValue(startNormalizedValue)
+  {}
+};
+
 /** This structure is used when queueing Sysex messages. You may need to set MAX_SYSEX_SIZE to reflect the max sysex payload in bytes */
 struct SysExData
 {
@@ -107,13 +150,53 @@ struct IByteGetter
   }
 };
   
-/** Manages a block of memory, for plug-in settings store/recall */
+/** Manages a block of memory, for plug-in settings store/recall.
+ * A chunk normally owns its memory, but it can also read or write memory it doesn't own without copying it, see View(), Slice() and Wrap() */
 class IByteChunk : private IByteGetter
 {
 public:
   IByteChunk() {}
   ~IByteChunk() {}
   
+  /** Make a chunk that reads memory it doesn't own, without copying it, e.g. the state data a host passes in, so that it can be given to UnserializeState().
+   * The memory must stay valid while the chunk, or a copy of it, reads it. Writing to the chunk copies the data to the chunk's own memory first
+   * @param pData The data to read
+   * @param size The size of the data in bytes
+   * @return The chunk */
+  static IByteChunk View(const void* pData, int size)
+  {
+    IByteChunk chunk;
+    chunk.mExtData = static_cast<const uint8_t*>(pData);
+    chunk.mExtSize = pData ? std::max(size, 0) : 0;
+    return chunk;
+  }
+  
+  /** Make a chunk that reads a part of this chunk without copying it, see View(). This chunk must not be written to or destroyed while the slice is used
+   * @param startPos The starting position in bytes in this chunk
+   * @param size The size of the slice in bytes
+   * @return The slice, which is empty if this chunk does not have size bytes from startPos */
+  IByteChunk Slice(int startPos, int size) const
+  {
+    const uint8_t* pData = GetSpan(size, startPos);
+    return View(pData, pData ? size : 0);
+  }
+  
+  /** Make a chunk that writes to memory it doesn't own, e.g. a buffer provided by the host, so that SerializeState() writes the data in place.
+   * If the data outgrows the memory it is copied to the chunk's own memory, and IsExternal() returns \c false
+   * @param pData The memory to write to, which must stay valid while the chunk writes to it
+   * @param capacity The size of the memory in bytes
+   * @return The chunk, which is empty */
+  static IByteChunk Wrap(void* pData, int capacity)
+  {
+    IByteChunk chunk;
+    chunk.mExtData = chunk.mExtWritable = static_cast<uint8_t*>(pData);
+    chunk.mExtCapacity = pData ? std::max(capacity, 0) : 0;
+    return chunk;
+  }
+  
+  /** @return \c true if the data is in memory the chunk doesn't own, see View() and Wrap() */
+  bool IsExternal() const { return mExtData != nullptr; }
+  
   /** This method is used in order to place the IPlug version number in the chunk when serialising data. In theory this is for backwards compatibility.
    * @param chunk reference to the chunk where the version number will be placed */
   static void InitChunkWithIPlugVer(IByteChunk& chunk)
@@ -146,10 +229,32 @@ public:
    * @return int The size of the chunk after insertion  */
   inline int PutBytes(const void* pSrc, int nBytesToCopy)
   {
-    int n = mBytes.GetSize();
-    mBytes.Resize(n + nBytesToCopy);
-    memcpy(mBytes.Get() + n, pSrc, nBytesToCopy);
-    return mBytes.GetSize();
+    int n = Size();
+    uint8_t* pData = ResizeForWrite(n + nBytesToCopy);
+    if (pData)
+    {
+      memcpy(pData + n, pSrc, nBytesToCopy);
+    }
+    return Size();
+  }
+  
+  /** Adds uninitialized space to the end of the chunk, with one resize, so that many values can be written into it in place
+   * @param nBytes Number of bytes to add
+   * @return Ptr to the added bytes, which is valid until the chunk is next resized, or nullptr if the chunk could not be resized  */
+  inline uint8_t* PutSpace(int nBytes)
+  {
+    int n = Size();
+    uint8_t* pData = ResizeForWrite(n + nBytes);
+    return pData ? pData + n : nullptr;
+  }
+  
+  /** Gets a ptr to bytes in the chunk, checking once that they are all there, so that many values can be read in place
+   * @param nBytes Number of bytes that will be read
+   * @param startPos The starting position in bytes in the chunk
+   * @return Ptr to the bytes, or nullptr if the chunk does not have nBytes from startPos  */
+  inline const uint8_t* GetSpan(int nBytes, int startPos) const
+  {
+    return (startPos >= 0 && nBytes >= 0 && startPos + nBytes <= Size()) ? GetData() + startPos : nullptr;
   }
   
   /** Copy raw bytes from the IByteChunk, returning the new position for subsequent calls
@@ -159,7 +264,7 @@ public:
    * @return int The end position in the chunk (in bytes) after the copy, or -1 if the copy would have copied more data than in the chunk  */
   inline int GetBytes(void* pDst, int nBytesToCopy, int startPos) const
   {
-    return IByteGetter::GetBytes(mBytes.Get(), Size(), pDst, nBytesToCopy, startPos);
+    return IByteGetter::GetBytes(GetData(), Size(), pDst, nBytesToCopy, startPos);
   }
   
   /** Copies arbitary typed data into the IByteChunk
@@ -199,7 +304,7 @@ public:
    * @return int The end position in the chunk (in bytes) after the copy, or -1 if the copy would have copied  more data than in the chunk  */
   inline int GetStr(WDL_String& str, int startPos) const
   {
-    return IByteGetter::GetStr(mBytes.Get(), Size(), str, startPos);
+    return IByteGetter::GetStr(GetData(), Size(), str, startPos);
   }
   
   /** Put another IByteChunk into this one
@@ -210,17 +315,44 @@ public:
     return PutBytes(pRHS->GetData(), pRHS->Size());
   }
   
-  /** Clears the chunk (resizes to 0) */
+  /** Clears the chunk (resizes to 0). A chunk made with View() no longer reads the memory, one made with Wrap() goes on writing to it */
   inline void Clear()
   {
+    if (!mExtWritable)
+    {
+      mExtData = nullptr;
+      mExtCapacity = 0;
+    }
+    mExtSize = 0;
     mBytes.Resize(0);
+    mCapacity = 0;
+  }
+
+  /** Allocates memory for the chunk to grow to a size without reallocating, e.g. before serializing a large state whose size is known
+   * @param nBytes The size in bytes the chunk can grow to, which doesn't change its current size */
+  inline void Reserve(int nBytes)
+  {
+    const int n = Size();
+
+    if (IsExternal())
+    {
+      if (nBytes > mExtCapacity)
+        Detach(n, nBytes);
+    }
+    else if (nBytes > n && nBytes > mCapacity)
+    {
+      if (mBytes.ResizeOK(nBytes, false))
+        mCapacity = nBytes;
+
+      mBytes.Resize(n, false);
+    }
   }
   
   /** Returns the current size of the chunk
    * @return Current size (in bytes) */
   inline int Size() const
   {
-    return mBytes.GetSize();
+    return IsExternal() ? mExtSize : mBytes.GetSize();
   }
   
   /** Resizes the chunk
@@ -228,39 +360,104 @@ public:
    * @return Old size (in bytes) */
   inline int Resize(int newSize)
   {
-    int n = mBytes.GetSize();
-    mBytes.Resize(newSize);
-    if (newSize > n)
+    int n = Size();
+    if (!IsExternal() && newSize < n)
+    {
+      mBytes.Resize(newSize);
+      mCapacity = 0; // the buffer may have shrunk
+      return n;
+    }
+    uint8_t* pData = ResizeForWrite(newSize);
+    if (pData && newSize > n)
     {
-      memset(mBytes.Get() + n, 0, (newSize - n));
+      memset(pData + n, 0, (newSize - n));
     }
     return n;
   }
   
-  /** Gets a ptr to the chunk data
+  /** Gets a ptr to the chunk data. The data of a chunk made with View() is copied to the chunk's own memory first, since it may be written to
    * @return uint8_t* Ptr to the chunk data */
   inline uint8_t* GetData()
   {
-    return mBytes.Get();
+    if (mExtData && !mExtWritable)
+    {
+      Detach(mExtSize, mExtSize);
+    }
+    return IsExternal() ? (mExtSize ? mExtWritable : nullptr) : mBytes.Get();
   }
   
   /** Gets a const ptr to the chunk data
    * @return const uint8_t* const Ptr to the chunk data */
   inline const uint8_t* GetData() const
   {
-    return mBytes.Get();
+    return IsExternal() ? (mExtSize ? mExtData : nullptr) : mBytes.Get();
   }
   
   /** Compares the size & values of the data of another chunk with this one
    * @param otherChunk The chunk to compare with
    * @return \c true if the chunks are equal */
-  inline bool IsEqual(IByteChunk& otherChunk) const
+  inline bool IsEqual(const IByteChunk& otherChunk) const
   {
-    return (otherChunk.Size() == Size() && !memcmp(otherChunk.mBytes.Get(), mBytes.Get(), Size()));
+    return (otherChunk.Size() == Size() && (!Size() || !memcmp(otherChunk.GetData(), GetData(), Size())));
   }
   
 private:
+  /** Resize the chunk for writing, moving external data that is read only, or outgrows its memory, to the chunk's own memory
+   * @return Ptr to the data, or nullptr if the chunk could not be resized */
+  inline uint8_t* ResizeForWrite(int newSize)
+  {
+    if (IsExternal())
+    {
+      if (mExtWritable && newSize <= mExtCapacity)
+      {
+        mExtSize = newSize;
+        return mExtWritable;
+      }
+
+      // from View() data grows geometrically, so that it isn't copied again on every write
+      Detach(newSize, mExtWritable ? std::max(newSize, mExtCapacity * 2) : newSize);
+    }
+
+    Grow(newSize);
+    return mBytes.ResizeOK(newSize, false);
+  }
+
+  /** Copy the external data to the chunk's own memory
+   * @param newSize The size of the chunk afterwards, which must be at least its current size to keep all the data
+   * @param capacity The size to reserve */
+  inline void Detach(int newSize, int capacity)
+  {
+    const uint8_t* pSrc = mExtData;
+    const int n = std::min(mExtSize, newSize);
+    mExtData = mExtWritable = nullptr;
+    mExtSize = mExtCapacity = 0;
+    mBytes.Resize(0);
+    mCapacity = 0;
+    Reserve(capacity);
+    if (mBytes.ResizeOK(newSize, false) && n > 0)
+    {
+      memcpy(mBytes.Get(), pSrc, n);
+    }
+  }
+
+  /** WDL_HeapBuf grows a large buffer by at most 4MB at a time, so a large state written a value at a time would be copied many times over.
+   * Beyond that size the capacity is doubled instead */
+  inline void Grow(int newSize)
+  {
+    static constexpr int kGeometricGrowthSize = 4 * 1024 * 1024;
+
+    if (newSize > mCapacity && newSize > kGeometricGrowthSize)
+      Reserve(std::max(newSize, static_cast<int>(std::min<int64_t>(static_cast<int64_t>(mBytes.GetSize()) * 2, 0x7FFFFFFF))));
+  }
+
   WDL_TypedBuf<uint8_t> mBytes;
+  int mCapacity = 0; // the size reserved with Reserve(), which is 0 if it isn't known
+
+  // memory the chunk doesn't own, see View() and Wrap()
+  const uint8_t* mExtData = nullptr;
+  uint8_t* mExtWritable = nullptr; // nullptr if the memory is read only
+  int mExtSize = 0;
+  int mExtCapacity = 0;
 };
 
 /** Manages a non-owned block of memory, for receiving arbitrary message byte streams */
@@ -413,6 +610,9 @@ struct Config
   int plugMaxHeight;
   bool plugHostResize;
   const char* bundleID;
+  bool plugFlushDenormals;
+  int internalBlockSize;
+  int midiOutputQueueSize;
   
   Config(int nParams,
          int nPresets,
@@ -437,7 +637,10 @@ struct Config
          int plugMaxWidth,
          int plugMinHeight,
          int plugMaxHeight,
-         const char* bundleID)
+         const char* bundleID,
+         bool plugFlushDenormals = true,
+         int internalBlockSize = 0,
+         int midiOutputQueueSize = 1024)
               
   : nParams(nParams)
   , nPresets(nPresets)
@@ -463,6 +666,9 @@ struct Config
   , plugMaxHeight(plugMaxHeight)
   , plugHostResize(plugHostResize)
   , bundleID(bundleID)
+  , plugFlushDenormals(plugFlushDenormals)
+  , internalBlockSize(internalBlockSize)
+  , midiOutputQueueSize(midiOutputQueueSize)
   {};
 };
 
@@ -602,10 +808,43 @@ struct IPreset
 
   IByteChunk mChunk;
 
+  // the state of a preset unserialized from a bank is left in the bank until it's needed, see IPluginBase::UnserializePresets()
+  std::shared_ptr<const IByteChunk> mSource;
+  int mSourcePos = 0;
+  int mSourceSize = 0;
+
   IPreset()
   {
     snprintf(mName, MAX_PRESET_NAME_LEN, "%s", UNUSED_PRESET_NAME);
   }
+
+  /** Copy the state from the bank it was unserialized from to mChunk, if it hasn't been already. Call this before reading mChunk */
+  void Resolve()
+  {
+    if (!mSource)
+      return;
+
+    mChunk.Clear();
+    mChunk.PutBytes(mSource->GetData() + mSourcePos, mSourceSize);
+    mSource = nullptr;
+  }
+};
+
+/** An immutable copy of a plug-in's custom state, e.g. a sample map or wavetables, that can be serialized on another thread while the plug-in goes on changing its own data.
+ * Make it cheap to create by sharing data that doesn't change between snapshots, e.g. with std::shared_ptr<const T> members that are replaced rather than modified.
+ * See IPluginBase::SetStateSnapshot() */
+class IStateSnapshot
+{
+public:
+  virtual ~IStateSnapshot() {}
+
+  /** Serialize the snapshot. This is called on a background thread, or on the thread the host asks for the state on, so it must only read the snapshot
+   * @param chunk The chunk to append the data to
+   * @return \c true on success */
+  virtual bool Serialize(IByteChunk& chunk) const = 0;
+
+  /** @return The size of the serialized snapshot in bytes, or an estimate, which is reserved in the chunk before Serialize() is called. 0 if it isn't known */
+  virtual int GetSizeHint() const { return 0; }
 };
 
 /** Used for key press info, such as ASCII representation, virtual key (mapped to win32 codes) and modifiers */
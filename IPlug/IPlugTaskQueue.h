@@ -0,0 +1,150 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugTaskQueue
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugRealtimeCheck.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A queue of tasks that are run in the background on a few threads of normal priority, e.g. to decode bitmaps while the UI opens.
+ * Unlike IPlugWorkerPool, Push() returns straight away and the tasks run in their own time, so this is not for the audio thread.
+ * The threads are started by the first call to Push(). On platforms without threads (e.g. web) tasks are run by Push()
+ * @ingroup IPlugUtilities */
+class IPlugTaskQueue final
+{
+public:
+  using Task = std::function<void()>;
+
+  /** @param nThreads The number of threads to start, pass -1 to use one less than the number of hardware threads */
+  IPlugTaskQueue(int nThreads = -1)
+  : mNThreads(nThreads)
+  {
+  }
+
+  IPlugTaskQueue(const IPlugTaskQueue&) = delete;
+  IPlugTaskQueue& operator=(const IPlugTaskQueue&) = delete;
+
+  /** Tasks that haven't started are discarded, the ones that are running are finished */
+  ~IPlugTaskQueue()
+  {
+    Stop();
+  }
+
+  /** Add a task, call this from a single thread, e.g. the UI thread
+   * @param task The function to call on one of the threads */
+  void Push(Task task)
+  {
+    IPLUG_REALTIME_CHECK(kLock, "IPlugTaskQueue::Push");
+#ifdef OS_WEB
+    task();
+#else
+    if (mThreads.empty())
+      Start();
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mTasks.push_back(std::move(task));
+      mNPending++;
+    }
+
+    mTaskAdded.notify_one();
+#endif
+  }
+
+  /** Wait until all the tasks that have been pushed are complete */
+  void Wait()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this]() { return mNPending == 0; });
+  }
+
+  /** Stop and join the threads, discarding the tasks that haven't started */
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStopping = true;
+    }
+
+    mTaskAdded.notify_all();
+
+    for (auto& thread : mThreads)
+      thread.join();
+
+    mThreads.clear();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.clear();
+    mNPending = 0;
+    mStopping = false;
+    mIdle.notify_all();
+  }
+
+private:
+  void Start()
+  {
+    const int nThreads = mNThreads < 0 ? std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1) : std::max(mNThreads, 1);
+
+    for (auto i = 0; i < nThreads; i++)
+      mThreads.emplace_back(&IPlugTaskQueue::ThreadLoop, this);
+  }
+
+  void ThreadLoop()
+  {
+    for (;;)
+    {
+      Task task;
+
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mTaskAdded.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+        if (mStopping)
+          return;
+
+        task = std::move(mTasks.front());
+        mTasks.pop_front();
+      }
+
+      task();
+
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (--mNPending == 0)
+        mIdle.notify_all();
+    }
+  }
+
+  int mNThreads;
+  std::vector<std::thread> mThreads;
+  std::deque<Task> mTasks;
+  int mNPending = 0; // tasks that have been pushed and not completed
+  bool mStopping = false;
+  std::mutex mMutex;
+  std::condition_variable mTaskAdded;
+  std::condition_variable mIdle;
+};
+
+END_IPLUG_NAMESPACE
@@ -15,6 +15,13 @@
 
 #include "IPlugTimer.h"
 
+#if defined OS_LINUX
+  #include <algorithm>
+  #include <sys/timerfd.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
 using namespace iplug;
 
 #if defined OS_MAC || defined OS_IOS
@@ -27,6 +34,11 @@ Timer* Timer::Create(ITimerFunction func, uint32_t intervalMs)
 Timer_impl::Timer_impl(ITimerFunction func, uint32_t intervalMs)
 : mTimerFunc(func)
 , mIntervalMs(intervalMs)
+{
+  Start(CFAbsoluteTimeGetCurrent());
+}
+
+void Timer_impl::Start(CFAbsoluteTime firstFireTime)
 {
   CFRunLoopTimerContext context;
   context.version = 0;
@@ -34,9 +46,9 @@ Timer_impl::Timer_impl(ITimerFunction func, uint32_t intervalMs)
   context.retain = nullptr;
   context.release = nullptr;
   context.copyDescription = nullptr;
-  CFTimeInterval interval = intervalMs / 1000.0;
+  CFTimeInterval interval = mIntervalMs / 1000.0;
   CFRunLoopRef runLoop = CFRunLoopGetMain();
-  mOSTimer = CFRunLoopTimerCreate(kCFAllocatorDefault, CFAbsoluteTimeGetCurrent(), interval, 0, 0, TimerProc, &context);
+  mOSTimer = CFRunLoopTimerCreate(kCFAllocatorDefault, firstFireTime, interval, 0, 0, TimerProc, &context);
   CFRunLoopAddTimer(runLoop, mOSTimer, kCFRunLoopCommonModes);
 }
 
@@ -55,6 +67,17 @@ void Timer_impl::Stop()
   }
 }
 
+void Timer_impl::SetInterval(uint32_t intervalMs)
+{
+  if (intervalMs == mIntervalMs || !mOSTimer)
+    return;
+
+  // the interval of a CFRunLoopTimer can't be changed, but it can be invalidated from its own callback and replaced
+  Stop();
+  mIntervalMs = intervalMs;
+  Start(CFAbsoluteTimeGetCurrent() + intervalMs / 1000.0);
+}
+
 void Timer_impl::TimerProc(CFRunLoopTimerRef timer, void *info)
 {
   Timer_impl* itimer = (Timer_impl*) info;
@@ -101,6 +124,15 @@ void Timer_impl::Stop()
   }
 }
 
+void Timer_impl::SetInterval(uint32_t intervalMs)
+{
+  if (intervalMs == mIntervalMs || !ID)
+    return;
+
+  mIntervalMs = intervalMs;
+  SetTimer(0, ID, intervalMs, TimerProc); // replaces the existing timer, keeping its ID
+}
+
 void CALLBACK Timer_impl::TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
 {
   WDL_MutexLock lock(&sMutex);
@@ -138,9 +170,138 @@ void Timer_impl::Stop()
   emscripten_clear_interval(ID);
 }
 
+void Timer_impl::SetInterval(uint32_t intervalMs)
+{
+  emscripten_clear_interval(ID);
+  ID = emscripten_set_interval(TimerProc, intervalMs, this);
+}
+
 void Timer_impl::TimerProc(void* userData)
 {
   Timer_impl* itimer = (Timer_impl*) userData;
   itimer->mTimerFunc(*itimer);
 }
+#elif defined OS_LINUX
+
+static uint64_t NowNs()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+Timer* Timer::Create(ITimerFunction func, uint32_t intervalMs)
+{
+  return new Timer_impl(func, intervalMs);
+}
+
+WDL_Mutex Timer_impl::sMutex;
+WDL_PtrList<Timer_impl> Timer_impl::sTimers;
+int Timer_impl::sFD = -1;
+
+Timer_impl::Timer_impl(ITimerFunction func, uint32_t intervalMs)
+: mTimerFunc(func)
+, mIntervalMs(std::max(intervalMs, 1u))
+{
+  WDL_MutexLock lock(&sMutex);
+  mNextFireNs = NowNs() + mIntervalMs * 1000000ull;
+  sTimers.Add(this);
+  Rearm();
+}
+
+Timer_impl::~Timer_impl()
+{
+  Stop();
+}
+
+void Timer_impl::Stop()
+{
+  WDL_MutexLock lock(&sMutex);
+
+  if (sTimers.Find(this) >= 0)
+  {
+    sTimers.DeletePtr(this);
+    Rearm();
+  }
+}
+
+void Timer_impl::SetInterval(uint32_t intervalMs)
+{
+  WDL_MutexLock lock(&sMutex);
+
+  if (intervalMs == mIntervalMs || sTimers.Find(this) < 0)
+    return;
+
+  mIntervalMs = std::max(intervalMs, 1u);
+  mNextFireNs = NowNs() + mIntervalMs * 1000000ull;
+  Rearm();
+}
+
+int Timer_impl::GetPollFD()
+{
+  WDL_MutexLock lock(&sMutex);
+
+  if (sFD < 0)
+  {
+    sFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    Rearm();
+  }
+
+  return sFD;
+}
+
+void Timer_impl::OnPollFD()
+{
+  WDL_MutexLock lock(&sMutex);
+
+  uint64_t expirations;
+  while (read(sFD, &expirations, sizeof(expirations)) > 0) {}
+
+  const uint64_t now = NowNs();
+
+  // a timer function may stop or create timers, so look the list up again after each call
+  for (auto i = 0; i < sTimers.GetSize(); i++)
+  {
+    Timer_impl* pTimer = sTimers.Get(i);
+
+    if (pTimer->mNextFireNs > now)
+      continue;
+
+    // skip the ticks that were missed rather than calling the function for each of them
+    const uint64_t intervalNs = pTimer->mIntervalMs * 1000000ull;
+    pTimer->mNextFireNs += ((now - pTimer->mNextFireNs) / intervalNs + 1) * intervalNs;
+    pTimer->mTimerFunc(*pTimer);
+
+    if (sTimers.Get(i) != pTimer)
+      i = -1; // the list changed, start again, the timers that have fired are no longer due
+  }
+
+  Rearm();
+}
+
+void Timer_impl::Rearm()
+{
+  if (sFD < 0)
+    return;
+
+  uint64_t next = 0;
+
+  for (auto i = 0; i < sTimers.GetSize(); i++)
+  {
+    const uint64_t t = sTimers.Get(i)->mNextFireNs;
+    next = next ? std::min(next, t) : t;
+  }
+
+  // an absolute expiry of zero would disarm the timer, so a timer that is already due fires as soon as possible
+  itimerspec spec = {};
+
+  if (next)
+  {
+    next = std::max(next, static_cast<uint64_t>(1));
+    spec.it_value.tv_sec = static_cast<time_t>(next / 1000000000ull);
+    spec.it_value.tv_nsec = static_cast<long>(next % 1000000000ull);
+  }
+
+  timerfd_settime(sFD, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
 #endif
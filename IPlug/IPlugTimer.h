@@ -47,6 +47,10 @@ struct Timer
   static Timer* Create(ITimerFunction func, uint32_t intervalMs);
   virtual ~Timer() {};
   virtual void Stop() = 0;
+
+  /** Change the interval of the timer. This can be called from the timer function
+   * @param intervalMs The new interval in milliseconds */
+  virtual void SetInterval(uint32_t intervalMs) = 0;
 };
 
 #if defined OS_MAC || defined OS_IOS
@@ -59,9 +63,12 @@ public:
   ~Timer_impl();
   
   void Stop() override;
+  void SetInterval(uint32_t intervalMs) override;
   static void TimerProc(CFRunLoopTimerRef timer, void *info);
   
 private:
+  void Start(CFAbsoluteTime firstFireTime);
+
   CFRunLoopTimerRef mOSTimer;
   ITimerFunction mTimerFunc;
   uint32_t mIntervalMs;
@@ -73,6 +80,7 @@ public:
   Timer_impl(ITimerFunction func, uint32_t intervalMs);
   ~Timer_impl();
   void Stop() override;
+  void SetInterval(uint32_t intervalMs) override;
   static void CALLBACK TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
   
 private:
@@ -89,12 +97,42 @@ public:
   Timer_impl(ITimerFunction func, uint32_t intervalMs);
   ~Timer_impl();
   void Stop() override;
+  void SetInterval(uint32_t intervalMs) override;
   static void TimerProc(void *userData);
   
 private:
   long ID = 0;
   ITimerFunction mTimerFunc;
 };
+#elif defined OS_LINUX
+/** Linux has no run loop that a plug-in can add timers to by itself, so the timers share one timerfd that is readable when any of them is due.
+ * Whatever runs the main thread's event loop must watch GetPollFD() and call OnPollFD() when it is readable, e.g. the VST3 view registers it with the host's
+ * Linux::IRunLoop while the editor is open */
+class Timer_impl : public Timer
+{
+public:
+  Timer_impl(ITimerFunction func, uint32_t intervalMs);
+  ~Timer_impl();
+  void Stop() override;
+  void SetInterval(uint32_t intervalMs) override;
+
+  /** @return The file descriptor that is readable when a timer is due, or -1 if it could not be created */
+  static int GetPollFD();
+
+  /** Call the functions of the timers that are due, on the main thread when the file descriptor from GetPollFD() is readable */
+  static void OnPollFD();
+
+private:
+  /** Arm the timerfd for the earliest timer, call with sMutex locked */
+  static void Rearm();
+
+  static WDL_Mutex sMutex;
+  static WDL_PtrList<Timer_impl> sTimers;
+  static int sFD;
+  ITimerFunction mTimerFunc;
+  uint32_t mIntervalMs;
+  uint64_t mNextFireNs = 0; // CLOCK_MONOTONIC
+};
 #else
   #error NOT IMPLEMENTED
 #endif
@@ -0,0 +1,271 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Scoped trace zones, written as a Chrome trace event file that chrome://tracing and https://ui.perfetto.dev open
+ *
+ * To time a scope:                      TRACE_ZONE("MyZone");
+ * To name the calling thread's track:   TRACE_THREAD_NAME("MyThread");
+ * Both are no-ops unless IPLUG_TRACE_ZONES is defined. The zone and thread names must be string literals, since only the pointers are recorded.
+ * The file is TRACEFILE, in the same folder as the log (see IPlugLogger.h), and is finished when the process exits.
+ */
+
+#include "IPlugLogger.h"
+
+#if defined IPLUG_TRACE_ZONES
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IPlugQueue.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+#ifndef TRACE_ZONE_QUEUE_SIZE
+  #define TRACE_ZONE_QUEUE_SIZE 4096 // the number of zones each thread can end before the writer catches up
+#endif
+
+/** A zone that has ended, as it is passed from the thread that timed it to the writer */
+struct TraceZoneEvent
+{
+  const char* name;
+  int64_t startUs; // microseconds since the writer was created
+  int64_t durationUs;
+};
+
+/** The zones ended by one thread, which only that thread pushes to */
+struct TraceZoneQueue
+{
+  TraceZoneQueue() : mThreadID(GetOrdinalThreadID()) {}
+
+  IPlugQueue<TraceZoneEvent> mEvents {TRACE_ZONE_QUEUE_SIZE};
+  std::atomic<const char*> mThreadName {nullptr};
+  std::atomic<int> mDropped {0};
+  const char* mWrittenThreadName = nullptr; // the writer thread's copy of the name it last wrote
+  bool mNameWritten = false;
+  intptr_t mThreadID;
+};
+
+/** Writes the zones of all the threads to TRACEFILE. Like the lock free Trace(), ending a zone only pushes it to a queue for the calling thread,
+ * so zones can be left in code that runs on the audio thread; a background thread writes them. The first zone on a thread allocates its queue.
+ * Zones that end while a thread's queue is full are dropped, and counted in a "dropped" counter track */
+class TraceZoneWriter
+{
+public:
+  /** @return The writer, which is shared by the whole process since it is an inline member */
+  static TraceZoneWriter& Get()
+  {
+    static TraceZoneWriter sWriter;
+    return sWriter;
+  }
+
+  /** @return The queue of the calling thread, created on its first zone */
+  TraceZoneQueue* GetThreadQueue()
+  {
+    thread_local TraceZoneQueue* tQueue = nullptr;
+
+    if (!tQueue)
+    {
+      std::lock_guard<std::mutex> lock(mQueuesMutex);
+      mQueues.push_back(std::unique_ptr<TraceZoneQueue>(new TraceZoneQueue()));
+      tQueue = mQueues.back().get();
+
+      if (!mThread.joinable())
+        mThread = std::thread([this]() { Run(); });
+    }
+
+    return tQueue;
+  }
+
+  /** Name the calling thread's track. Cheap enough to call every time a thread enters a callback, it is only written when it changes */
+  void SetThreadName(const char* name)
+  {
+    GetThreadQueue()->mThreadName.store(name, std::memory_order_relaxed);
+  }
+
+  /** @return Microseconds since the writer was created */
+  int64_t GetTimeUs() const
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - mStartTime).count();
+  }
+
+  void AddZone(const char* name, int64_t startUs, int64_t endUs)
+  {
+    TraceZoneQueue* pQueue = GetThreadQueue();
+
+    if (!pQueue->mEvents.Push({name, startUs, endUs - startUs}))
+      pQueue->mDropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~TraceZoneWriter()
+  {
+    mRunning = false;
+
+    if (mThread.joinable())
+      mThread.join();
+
+    Drain();
+
+    if (mFile.mFP)
+      fprintf(mFile.mFP, "\n]\n");
+  }
+
+private:
+  TraceZoneWriter()
+  {
+    if (mFile.mFP)
+      fprintf(mFile.mFP, "[\n");
+  }
+
+  void Run()
+  {
+    while (mRunning)
+    {
+      Drain();
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+  }
+
+  void Drain()
+  {
+    if (!mFile.mFP)
+      return;
+
+    std::vector<TraceZoneQueue*> queues;
+
+    {
+      std::lock_guard<std::mutex> lock(mQueuesMutex);
+      for (auto& pQueue : mQueues)
+        queues.push_back(pQueue.get());
+    }
+
+    for (auto* pQueue : queues)
+    {
+      const char* threadName = pQueue->mThreadName.load(std::memory_order_relaxed);
+
+      if (!pQueue->mNameWritten || threadName != pQueue->mWrittenThreadName)
+      {
+        pQueue->mWrittenThreadName = threadName;
+        pQueue->mNameWritten = true;
+
+        char defaultName[32];
+
+        if (!threadName)
+        {
+          snprintf(defaultName, 32, "Thread %d", static_cast<int>(pQueue->mThreadID));
+          threadName = defaultName;
+        }
+
+        WriteSeparator();
+        fprintf(mFile.mFP, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", static_cast<int>(pQueue->mThreadID));
+        WriteString(threadName);
+        fprintf(mFile.mFP, "}}");
+      }
+
+      TraceZoneEvent event;
+
+      while (pQueue->mEvents.Pop(event))
+      {
+        WriteSeparator();
+        fprintf(mFile.mFP, "{\"name\":");
+        WriteString(event.name);
+        fprintf(mFile.mFP, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}",
+                static_cast<long long>(event.startUs), static_cast<long long>(event.durationUs), static_cast<int>(pQueue->mThreadID));
+      }
+
+      const int nDropped = pQueue->mDropped.exchange(0, std::memory_order_relaxed);
+
+      if (nDropped)
+      {
+        WriteSeparator();
+        fprintf(mFile.mFP, "{\"name\":\"dropped\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"tid\":%d,\"args\":{\"zones\":%d}}",
+                static_cast<long long>(GetTimeUs()), static_cast<int>(pQueue->mThreadID), nDropped);
+      }
+    }
+
+    fflush(mFile.mFP);
+  }
+
+  void WriteSeparator()
+  {
+    if (mNEvents++)
+      fputs(",\n", mFile.mFP);
+  }
+
+  void WriteString(const char* str)
+  {
+    fputc('"', mFile.mFP);
+
+    for (; *str; str++)
+    {
+      if (*str == '"' || *str == '\\')
+        fputc('\\', mFile.mFP);
+
+      if (static_cast<unsigned char>(*str) >= 0x20)
+        fputc(*str, mFile.mFP);
+    }
+
+    fputc('"', mFile.mFP);
+  }
+
+  LogFile mFile {TRACEFILE};
+  const std::chrono::steady_clock::time_point mStartTime = std::chrono::steady_clock::now();
+  std::mutex mQueuesMutex;
+  std::vector<std::unique_ptr<TraceZoneQueue>> mQueues;
+  std::thread mThread;
+  std::atomic<bool> mRunning {true};
+  int mNEvents = 0;
+};
+
+/** Times the scope it is declared in, see TRACE_ZONE() */
+class TraceZone
+{
+public:
+  TraceZone(const char* name)
+  : mName(name)
+  , mStartUs(TraceZoneWriter::Get().GetTimeUs())
+  {
+  }
+
+  ~TraceZone()
+  {
+    TraceZoneWriter& writer = TraceZoneWriter::Get();
+    writer.AddZone(mName, mStartUs, writer.GetTimeUs());
+  }
+
+  TraceZone(const TraceZone&) = delete;
+  TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+  const char* mName;
+  int64_t mStartUs;
+};
+
+END_IPLUG_NAMESPACE
+
+#define IPLUG_TRACE_ZONE_CONCAT_(a, b) a##b
+#define IPLUG_TRACE_ZONE_CONCAT(a, b) IPLUG_TRACE_ZONE_CONCAT_(a, b)
+
+#define TRACE_ZONE(name) iplug::TraceZone IPLUG_TRACE_ZONE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) iplug::TraceZoneWriter::Get().SetThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name) do {} while(0)
+#define TRACE_THREAD_NAME(name) do {} while(0)
+
+#endif
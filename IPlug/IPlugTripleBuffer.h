@@ -0,0 +1,71 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugTripleBuffer
+ */
+
+#include <array>
+#include <atomic>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A lock-free triple buffer used to pass the latest value of some data from one thread to another.
+ * Unlike a queue it can never overflow: the producer always has a buffer to write to, and the consumer only ever sees the newest value that has been published, older unread values are dropped */
+template<typename T>
+class IPlugTripleBuffer final
+{
+public:
+  IPlugTripleBuffer() = default;
+  IPlugTripleBuffer(const IPlugTripleBuffer&) = delete;
+  IPlugTripleBuffer& operator=(const IPlugTripleBuffer&) = delete;
+
+  /** @return The buffer to write the next value to, call this on the producer thread */
+  T& GetWriteBuffer() { return mBuffers[mBack]; }
+
+  /** Publish the value in the write buffer, call this on the producer thread */
+  void Publish()
+  {
+    mBack = mMiddle.exchange(mBack | kNewData, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  /** @return \c true if the last published value has been read, call this on the producer thread */
+  bool WasRead() const
+  {
+    return !(mMiddle.load(std::memory_order_acquire) & kNewData);
+  }
+
+  /** Get the newest value, call this on the consumer thread
+   * @return A pointer to the value, which stays valid until the next call, or nullptr if nothing has been published since the last call */
+  const T* Read()
+  {
+    if (!(mMiddle.load(std::memory_order_relaxed) & kNewData))
+      return nullptr;
+
+    mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndexMask;
+    return &mBuffers[mFront];
+  }
+
+private:
+  static constexpr int kIndexMask = 3;
+  static constexpr int kNewData = 4;
+
+  std::array<T, 3> mBuffers;
+  int mBack = 0; // producer only
+  int mFront = 1; // consumer only
+  std::atomic<int> mMiddle {2}; // the index of the buffer between them, and whether it holds unread data
+};
+
+END_IPLUG_NAMESPACE
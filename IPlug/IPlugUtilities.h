@@ -29,6 +29,7 @@
 
 #include "IPlugConstants.h"
 #include "IPlugPlatform.h"
+#include "IPlugSIMD.h"
 
 #ifdef OS_WIN
 #pragma warning(disable:4018 4267)	// size_t/signed/unsigned mismatch..
@@ -152,6 +153,58 @@ void CastCopy(DEST* pDest, SRC* pSrc, int n)
   }
 }
 
+/** CastCopy() specialization for float to double, using the vectorized kernels in IPlugSIMD.h */
+template <>
+inline void CastCopy<float, double>(double* pDest, float* pSrc, int n)
+{
+  simd::GetKernels().floatToDouble(pDest, pSrc, n);
+}
+
+/** CastCopy() specialization for double to float, using the vectorized kernels in IPlugSIMD.h */
+template <>
+inline void CastCopy<double, float>(float* pDest, double* pSrc, int n)
+{
+  simd::GetKernels().doubleToFloat(pDest, pSrc, n);
+}
+
+/** CastCopy() overload for buffers of the same type, which doesn't need to convert
+ * @tparam T The sample type */
+template <class T>
+void CastCopy(T* pDest, T* pSrc, int n)
+{
+  if (pDest != pSrc)
+    memcpy(pDest, pSrc, n * sizeof(T));
+}
+
+/** Helper function to loop through a buffer of samples casting and adding them to a destination buffer, e.g. from double to float
+ * @tparam SRC The source type
+ * @tparam DEST The destination type
+ * @param pDest Ptr to the destination buffer
+ * @param pSrc Ptr to the source buffer
+ * @param n The number of or elements in the buffer */
+template <class SRC, class DEST>
+void CastAccumulate(DEST* pDest, SRC* pSrc, int n)
+{
+  for (int i = 0; i < n; ++i, ++pDest, ++pSrc)
+  {
+    *pDest += (DEST) *pSrc;
+  }
+}
+
+/** CastAccumulate() specialization for float, using the vectorized kernels in IPlugSIMD.h */
+template <>
+inline void CastAccumulate<float, float>(float* pDest, float* pSrc, int n)
+{
+  simd::GetKernels().accumulateFloat(pDest, pSrc, n);
+}
+
+/** CastAccumulate() specialization for double to float, using the vectorized kernels in IPlugSIMD.h */
+template <>
+inline void CastAccumulate<double, float>(float* pDest, double* pSrc, int n)
+{
+  simd::GetKernels().accumulateDouble(pDest, pSrc, n);
+}
+
 /** \todo  
  * @param cDest \todo
  * @param cSrc \todo */
@@ -0,0 +1,279 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugWorkerPool
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+
+#if defined OS_MAC || defined OS_IOS
+#include <dispatch/dispatch.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#elif defined OS_WIN
+#include <windows.h>
+#elif defined OS_LINUX
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A pool of worker threads that can be used from the audio thread to process independent jobs in parallel, e.g. per-bus or per-voice-group processing.
+ * Dispatching and joining jobs does not allocate or take locks. The calling thread takes part in the work, and Run() returns when all the jobs are complete.
+ * Worker threads are given real-time priority where the OS supports it. Jobs should be of a similar, reasonable size (tens of microseconds or more), otherwise the cost of waking the workers will outweigh the benefit.
+ * On platforms without threads (e.g. web) all jobs are run on the calling thread.
+ * @ingroup IPlugUtilities */
+class IPlugWorkerPool
+{
+public:
+  /** A job function, called with the context pointer that was passed to Run() and the index of the job */
+  using JobFunc = void(*)(void* pContext, int jobIdx);
+
+  /** A function provided by an API class to run jobs on the host's threads, which must call RunHostJob() once for each job index and return \c true when they are all complete, or \c false if the host can't run them */
+  using HostExecFunc = bool(*)(void* pHostContext, int nJobs);
+
+  IPlugWorkerPool() = default;
+
+  ~IPlugWorkerPool()
+  {
+    Stop();
+  }
+
+  IPlugWorkerPool(const IPlugWorkerPool&) = delete;
+  IPlugWorkerPool& operator=(const IPlugWorkerPool&) = delete;
+
+  /** Start the worker threads. This method is not realtime safe, call it from the constructor or OnReset()
+   * @param nThreads The number of worker threads (in addition to the calling thread). Pass -1 to use one less than the number of hardware threads.
+   * @param periodSeconds The expected interval between calls to Run() e.g. the duration of a block, used to configure real-time scheduling on macOS
+   * @param realtimePriority Set \c false to keep the default thread priority, for pools that are not used from the audio thread */
+  void Start(int nThreads = -1, double periodSeconds = DEFAULT_BLOCK_SIZE / DEFAULT_SAMPLE_RATE, bool realtimePriority = true)
+  {
+    Stop();
+
+    mRealtimePriority = realtimePriority;
+
+#ifndef OS_WEB
+    if (nThreads < 0)
+      nThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+
+    mPeriodSeconds = periodSeconds;
+    mRunning = true;
+
+    for (auto i = 0; i < nThreads; i++)
+    {
+      Worker* pWorker = new Worker;
+      mWorkers.push_back(pWorker);
+      pWorker->mThread = std::thread(&IPlugWorkerPool::WorkerLoop, this, pWorker);
+    }
+#endif
+  }
+
+  /** Stop and join the worker threads. This method is not realtime safe */
+  void Stop()
+  {
+    mRunning = false;
+
+    for (auto* pWorker : mWorkers)
+      pWorker->mSemaphore.Signal();
+
+    for (auto* pWorker : mWorkers)
+    {
+      if (pWorker->mThread.joinable())
+        pWorker->mThread.join();
+
+      delete pWorker;
+    }
+
+    mWorkers.clear();
+  }
+
+  /** @return The number of worker threads, not including the calling thread */
+  int NThreads() const { return static_cast<int>(mWorkers.size()); }
+
+  /** Called by API classes whose host provides a thread pool (e.g. CLAP), so that Run() executes the jobs on the host's threads and the plug-in's threads are only used if the host declines.
+   * This method is not realtime safe
+   * @param func The function that asks the host to run the jobs, or nullptr to always use the pool's own threads
+   * @param pHostContext A pointer passed to func */
+  void SetHostExecutor(HostExecFunc func, void* pHostContext)
+  {
+    mHostExecFunc = func;
+    mHostContext = pHostContext;
+  }
+
+  /** Called by API classes from the host's threads to run one of the jobs of the current call to Run(), see SetHostExecutor()
+   * @param jobIdx The index of the job */
+  void RunHostJob(int jobIdx)
+  {
+    if (jobIdx >= 0 && jobIdx < mNJobs)
+      mFunc(mContext, jobIdx);
+  }
+
+  /** Run nJobs jobs in parallel and wait for them to complete. This method is realtime safe, but must not be called from more than one thread at the same time, or from within a job
+   * @param nJobs The number of jobs, func will be called once for each index 0 to nJobs - 1, in no particular order and on any thread
+   * @param func The job function
+   * @param pContext A pointer passed to each job */
+  void Run(int nJobs, JobFunc func, void* pContext)
+  {
+    if (mHostExecFunc && nJobs > 1)
+    {
+      mFunc = func;
+      mContext = pContext;
+      mNJobs = nJobs;
+
+      if (mHostExecFunc(mHostContext, nJobs))
+        return;
+    }
+
+    const int nWake = std::min(NThreads(), nJobs - 1);
+
+    if (nWake <= 0)
+    {
+      for (auto i = 0; i < nJobs; i++)
+        func(pContext, i);
+
+      return;
+    }
+
+    mFunc = func;
+    mContext = pContext;
+    mNJobs = nJobs;
+    mNextJob.store(0, std::memory_order_relaxed);
+    mNActiveWorkers.store(nWake, std::memory_order_release);
+
+    for (auto i = 0; i < nWake; i++)
+      mWorkers[i]->mSemaphore.Signal();
+
+    DoJobs();
+
+    // wait for the workers that were woken, so none of them can pick up a job from the next call to Run()
+    while (mNActiveWorkers.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+  }
+
+  /** Convenience overload for a lambda or functor taking the job index, which is not copied, so no allocation takes place
+   * @param nJobs The number of jobs
+   * @param func A callable with the signature void(int jobIdx) */
+  template <typename F>
+  void Run(int nJobs, F& func)
+  {
+    Run(nJobs, [](void* pContext, int jobIdx) { (*static_cast<F*>(pContext))(jobIdx); }, &func);
+  }
+
+private:
+  /** A minimal counting semaphore, signalling is realtime safe on all platforms */
+  class Semaphore
+  {
+  public:
+#if defined OS_MAC || defined OS_IOS
+    Semaphore() : mSem(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(mSem); }
+    void Signal() { dispatch_semaphore_signal(mSem); }
+    void Wait() { dispatch_semaphore_wait(mSem, DISPATCH_TIME_FOREVER); }
+  private:
+    dispatch_semaphore_t mSem;
+#elif defined OS_WIN
+    Semaphore() : mSem(CreateSemaphore(NULL, 0, LONG_MAX, NULL)) {}
+    ~Semaphore() { CloseHandle(mSem); }
+    void Signal() { ReleaseSemaphore(mSem, 1, NULL); }
+    void Wait() { WaitForSingleObject(mSem, INFINITE); }
+  private:
+    HANDLE mSem;
+#elif defined OS_LINUX
+    Semaphore() { sem_init(&mSem, 0, 0); }
+    ~Semaphore() { sem_destroy(&mSem); }
+    void Signal() { sem_post(&mSem); }
+    void Wait() { while (sem_wait(&mSem) != 0) {} }
+  private:
+    sem_t mSem;
+#else
+    void Signal() {}
+    void Wait() {}
+#endif
+  };
+
+  struct Worker
+  {
+    std::thread mThread;
+    Semaphore mSemaphore;
+  };
+
+  void DoJobs()
+  {
+    int jobIdx;
+
+    while ((jobIdx = mNextJob.fetch_add(1, std::memory_order_acq_rel)) < mNJobs)
+      mFunc(mContext, jobIdx);
+  }
+
+  void WorkerLoop(Worker* pWorker)
+  {
+    if (mRealtimePriority)
+      SetRealtimePriority();
+
+    while (true)
+    {
+      pWorker->mSemaphore.Wait();
+
+      if (!mRunning)
+        break;
+
+      DoJobs();
+      mNActiveWorkers.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void SetRealtimePriority()
+  {
+#if defined OS_MAC || defined OS_IOS
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const double ticksPerSecond = 1e9 * static_cast<double>(timebase.denom) / static_cast<double>(timebase.numer);
+
+    thread_time_constraint_policy_data_t policy;
+    policy.period = static_cast<uint32_t>(mPeriodSeconds * ticksPerSecond);
+    policy.computation = static_cast<uint32_t>(mPeriodSeconds * 0.5 * ticksPerSecond);
+    policy.constraint = policy.period;
+    policy.preemptible = true;
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY, (thread_policy_t) &policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+#elif defined OS_WIN
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#elif defined OS_LINUX
+    sched_param param;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); // fails without the required privileges, in which case the default priority is kept
+#endif
+  }
+
+  std::vector<Worker*> mWorkers;
+  std::atomic<bool> mRunning {false};
+  std::atomic<int> mNextJob {0};
+  std::atomic<int> mNActiveWorkers {0};
+  JobFunc mFunc = nullptr;
+  void* mContext = nullptr;
+  int mNJobs = 0;
+  double mPeriodSeconds = 0.;
+  bool mRealtimePriority = true;
+  HostExecFunc mHostExecFunc = nullptr;
+  void* mHostContext = nullptr;
+};
+
+END_IPLUG_NAMESPACE
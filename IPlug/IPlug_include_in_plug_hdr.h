@@ -86,6 +86,14 @@
   #include "IPlugVST3_Processor.h"
   #define PLUGIN_API_BASE IPlugVST3Processor
   #define API_EXT "vst3"
+#elif defined CLAP_API
+  #include "IPlugCLAP.h"
+  #define PLUGIN_API_BASE IPlugCLAP
+  #define API_EXT "clap"
+#elif defined BENCH_API
+  #include "IPlugBench.h"
+  #define PLUGIN_API_BASE IPlugBench
+  #define API_EXT "bench"
 #else
   #error "No API defined!"
 #endif
@@ -225,6 +233,18 @@ END_IPLUG_NAMESPACE
   #define PLUG_MAX_HEIGHT (PLUG_HEIGHT * 2)
 #endif
 
+#ifndef PLUG_FLUSH_DENORMALS
+  #define PLUG_FLUSH_DENORMALS 1
+#endif
+
+#ifndef PLUG_INTERNAL_BLOCK_SIZE
+  #define PLUG_INTERNAL_BLOCK_SIZE 0
+#endif
+
+#ifndef PLUG_MIDI_OUTPUT_QUEUE_SIZE
+  #define PLUG_MIDI_OUTPUT_QUEUE_SIZE 1024
+#endif
+
 #ifndef PLUG_FPS
   #pragma message WARN("PLUG_FPS not defined, setting to 60")
   #define PLUG_FPS 60
@@ -309,3 +329,40 @@ END_IPLUG_NAMESPACE
     #endif
   #endif
 #endif
+
+#ifdef CLAP_API
+  #ifndef PLUG_VERSION_STR
+    #error You need to define PLUG_VERSION_STR in config.h - A string to identify the version number
+  #endif
+
+  #ifndef PLUG_URL_STR
+    #pragma message WARN("PLUG_URL_STR not defined, setting to empty string")
+    #define PLUG_URL_STR ""
+  #endif
+
+  #ifndef CLAP_PLUG_ID
+    #define CLAP_PLUG_ID BUNDLE_DOMAIN "." BUNDLE_MFR "." BUNDLE_NAME
+  #endif
+
+  #ifndef CLAP_MANUAL_URL
+    #define CLAP_MANUAL_URL PLUG_URL_STR
+  #endif
+
+  #ifndef CLAP_SUPPORT_URL
+    #define CLAP_SUPPORT_URL PLUG_URL_STR
+  #endif
+
+  #ifndef CLAP_DESCRIPTION
+    #define CLAP_DESCRIPTION ""
+  #endif
+
+  #ifndef CLAP_FEATURES
+    #if PLUG_TYPE == 1
+      #define CLAP_FEATURES CLAP_PLUGIN_FEATURE_INSTRUMENT
+    #elif PLUG_TYPE == 2
+      #define CLAP_FEATURES CLAP_PLUGIN_FEATURE_NOTE_EFFECT
+    #else
+      #define CLAP_FEATURES CLAP_PLUGIN_FEATURE_AUDIO_EFFECT
+    #endif
+  #endif
+#endif
@@ -24,7 +24,7 @@
 
 #if defined OS_WIN && !defined VST3C_API
   HINSTANCE gHINSTANCE = 0;
-  #if defined(VST2_API) || defined(AAX_API)
+  #if defined(VST2_API) || defined(AAX_API) || defined(CLAP_API)
   #ifdef __MINGW32__
   extern "C"
   #endif
@@ -271,7 +271,72 @@
     
     return 0;
   }
-#elif defined AUv3_API || defined AAX_API || defined APP_API
+#pragma mark - CLAP
+#elif defined CLAP_API
+  static const char* sCLAPFeatures[] = { CLAP_FEATURES, nullptr };
+
+  static const clap_plugin_descriptor_t sCLAPDescriptor = {
+    CLAP_VERSION_INIT,
+    CLAP_PLUG_ID,
+    PLUG_NAME,
+    PLUG_MFR,
+    PLUG_URL_STR,
+    CLAP_MANUAL_URL,
+    CLAP_SUPPORT_URL,
+    PLUG_VERSION_STR,
+    CLAP_DESCRIPTION,
+    sCLAPFeatures
+  };
+
+  static uint32_t CLAPGetPluginCount(const clap_plugin_factory_t* pFactory)
+  {
+    return 1;
+  }
+
+  static const clap_plugin_descriptor_t* CLAPGetPluginDescriptor(const clap_plugin_factory_t* pFactory, uint32_t idx)
+  {
+    return idx == 0 ? &sCLAPDescriptor : nullptr;
+  }
+
+  static const clap_plugin_t* CLAPCreatePlugin(const clap_plugin_factory_t* pFactory, const clap_host_t* pHost, const char* pluginID)
+  {
+    if (!clap_version_is_compatible(pHost->clap_version) || strcmp(pluginID, sCLAPDescriptor.id))
+      return nullptr;
+
+    iplug::IPlugCLAP* pPlug = iplug::MakePlug(iplug::InstanceInfo{&sCLAPDescriptor, pHost});
+
+    if (pPlug)
+    {
+      pPlug->EnsureDefaultPreset();
+      return pPlug->GetClapPlugin();
+    }
+    return nullptr;
+  }
+
+  static const clap_plugin_factory_t sCLAPFactory = {
+    CLAPGetPluginCount,
+    CLAPGetPluginDescriptor,
+    CLAPCreatePlugin
+  };
+
+  static bool CLAPEntryInit(const char* pluginPath) { return true; }
+  static void CLAPEntryDeinit() {}
+
+  static const void* CLAPEntryGetFactory(const char* factoryID)
+  {
+    return !strcmp(factoryID, CLAP_PLUGIN_FACTORY_ID) ? &sCLAPFactory : nullptr;
+  }
+
+  extern "C"
+  {
+    CLAP_EXPORT const clap_plugin_entry_t clap_entry = {
+      CLAP_VERSION_INIT,
+      CLAPEntryInit,
+      CLAPEntryDeinit,
+      CLAPEntryGetFactory
+    };
+  }
+#elif defined AUv3_API || defined AAX_API || defined APP_API || defined BENCH_API
 // Nothing to do here
 #else
   #error "No API defined!"
@@ -282,9 +347,9 @@
 BEGIN_IPLUG_NAMESPACE
 
 #pragma mark -
-#pragma mark VST2, VST3, AAX, AUv3, APP, WAM, WEB
+#pragma mark VST2, VST3, AAX, AUv3, APP, WAM, WEB, CLAP, BENCH
 
-#if defined VST2_API || defined VST3_API || defined AAX_API || defined AUv3_API || defined APP_API  || defined WAM_API || defined WEB_API
+#if defined VST2_API || defined VST3_API || defined AAX_API || defined AUv3_API || defined APP_API  || defined WAM_API || defined WEB_API || defined CLAP_API || defined BENCH_API
 
 Plugin* MakePlug(const iplug::InstanceInfo& info)
 {
@@ -292,7 +357,11 @@ Plugin* MakePlug(const iplug::InstanceInfo& info)
   static WDL_Mutex sMutex;
   WDL_MutexLock lock(&sMutex);
   
-  return new PLUG_CLASS_NAME(info);
+  Plugin* pPlug = new PLUG_CLASS_NAME(info);
+  pPlug->UpdateParamGroupIndex();
+  pPlug->GetStartupTimeline().EndInstantiation();
+  iplug::IPlugMemoryAccount::SetCurrent(nullptr);
+  return pPlug;
 }
 
 #pragma mark - AUv2
@@ -303,10 +372,11 @@ Plugin* MakePlug(void* pMemory)
   iplug::InstanceInfo info;
   info.mCocoaViewFactoryClassName.Set(AUV2_VIEW_CLASS_STR);
     
-  if (pMemory)
-    return new(pMemory) PLUG_CLASS_NAME(info);
-  else
-    return new PLUG_CLASS_NAME(info);
+  Plugin* pPlug = pMemory ? new(pMemory) PLUG_CLASS_NAME(info) : new PLUG_CLASS_NAME(info);
+  pPlug->UpdateParamGroupIndex();
+  pPlug->GetStartupTimeline().EndInstantiation();
+  iplug::IPlugMemoryAccount::SetCurrent(nullptr);
+  return pPlug;
 }
 
 #pragma mark - VST3 Controller
@@ -321,7 +391,11 @@ Steinberg::FUnknown* MakeController()
   // If you are trying to build a distributed VST3 plug-in and you hit an error here like "no matching constructor..." or 
   // "error: unknown type name 'VST3Controller'", you need to replace all instances of the name of your plug-in class (e.g. IPlugEffect)
   // with the macro PLUG_CLASS_NAME, as defined in your plug-ins config.h, so IPlugEffect::IPlugEffect() {} becomes PLUG_CLASS_NAME::PLUG_CLASS_NAME().
-  return static_cast<Steinberg::Vst::IEditController*>(new PLUG_CLASS_NAME(info));
+  PLUG_CLASS_NAME* pPlug = new PLUG_CLASS_NAME(info);
+  pPlug->UpdateParamGroupIndex();
+  pPlug->GetStartupTimeline().EndInstantiation();
+  iplug::IPlugMemoryAccount::SetCurrent(nullptr);
+  return static_cast<Steinberg::Vst::IEditController*>(pPlug);
 }
 
 #pragma mark - VST3 Processor
@@ -333,7 +407,11 @@ Steinberg::FUnknown* MakeProcessor()
   WDL_MutexLock lock(&sMutex);
   iplug::IPlugVST3Processor::InstanceInfo info;
   info.mOtherGUID = Steinberg::FUID(VST3_CONTROLLER_UID);
-  return static_cast<Steinberg::Vst::IAudioProcessor*>(new PLUG_CLASS_NAME(info));
+  PLUG_CLASS_NAME* pPlug = new PLUG_CLASS_NAME(info);
+  pPlug->UpdateParamGroupIndex();
+  pPlug->GetStartupTimeline().EndInstantiation();
+  iplug::IPlugMemoryAccount::SetCurrent(nullptr);
+  return static_cast<Steinberg::Vst::IAudioProcessor*>(pPlug);
 }
 
 #else
@@ -344,7 +422,7 @@ Steinberg::FUnknown* MakeProcessor()
 
 static Config MakeConfig(int nParams, int nPresets)
 {
-  return Config(nParams, nPresets, PLUG_CHANNEL_IO, PLUG_NAME, PLUG_NAME, PLUG_MFR, PLUG_VERSION_HEX, PLUG_UNIQUE_ID, PLUG_MFR_ID, PLUG_LATENCY, PLUG_DOES_MIDI_IN, PLUG_DOES_MIDI_OUT, PLUG_DOES_MPE, PLUG_DOES_STATE_CHUNKS, PLUG_TYPE, PLUG_HAS_UI, PLUG_WIDTH, PLUG_HEIGHT, PLUG_HOST_RESIZE, PLUG_MIN_WIDTH, PLUG_MAX_WIDTH, PLUG_MIN_HEIGHT, PLUG_MAX_HEIGHT, BUNDLE_ID); // TODO: Product Name?
+  return Config(nParams, nPresets, PLUG_CHANNEL_IO, PLUG_NAME, PLUG_NAME, PLUG_MFR, PLUG_VERSION_HEX, PLUG_UNIQUE_ID, PLUG_MFR_ID, PLUG_LATENCY, PLUG_DOES_MIDI_IN, PLUG_DOES_MIDI_OUT, PLUG_DOES_MPE, PLUG_DOES_STATE_CHUNKS, PLUG_TYPE, PLUG_HAS_UI, PLUG_WIDTH, PLUG_HEIGHT, PLUG_HOST_RESIZE, PLUG_MIN_WIDTH, PLUG_MAX_WIDTH, PLUG_MIN_HEIGHT, PLUG_MAX_HEIGHT, BUNDLE_ID, PLUG_FLUSH_DENORMALS, PLUG_INTERNAL_BLOCK_SIZE, PLUG_MIDI_OUTPUT_QUEUE_SIZE); // TODO: Product Name?
 }
 
 END_IPLUG_NAMESPACE
@@ -19,12 +19,12 @@
 #include "denormal.h"
 
 #include "IPlugPlatform.h"
+#include "IPlugUtilities.h"
 #include "IPlugQueue.h"
+#include "IPlugTripleBuffer.h"
 #include <array>
-
-#if defined OS_IOS || defined OS_MAC
-#include <Accelerate/Accelerate.h>
-#endif
+#include <atomic>
+#include <memory>
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -59,29 +59,83 @@ struct ISenderData
   }
 };
 
-/** ISender is a utility class which can be used to defer data from the realtime audio processing and send it to the GUI for visualization */
+/** How an ISender passes its data to the GUI, see ISender::SetMode() */
+enum class ESenderMode
+{
+  Queue,      ///< Every packet is sent, in order. If the GUI stops reading, packets are dropped when the queue is full, and the backlog is sent when it resumes
+  LatestValue ///< Only the newest packet for each control tag is sent. Packets the GUI didn't read in time are merged into the newer ones with the same tag, and there is no backlog
+};
+
+/** ISender is a utility class which can be used to defer data from the realtime audio processing and send it to the GUI for visualization
+ * The data is passed through an IPlugQueue of bytes, only storing and copying the values for the channels that are sent, so the queue holds more packets when fewer channels are used.
+ * QUEUE_SIZE is the number of packets the queue can hold when they contain all MAXNC channels */
 template <int MAXNC = 1, int QUEUE_SIZE = 64, typename T = float>
 class ISender
 {
 public:
   static constexpr int kUpdateMessage = 0;
 
+  ISender()
+  : mQueue(QUEUE_SIZE * kMaxPacketSize)
+  {
+    mStaging.Resize(kMaxPacketSize);
+    mPopBuffer.Resize(kMaxPacketSize);
+  }
+
+  /** Choose how the data is passed to the GUI. This is not thread safe, call it before processing starts, e.g. in your plug-in's constructor.
+   * ESenderMode::LatestValue suits meter-like data: the GUI reads the newest packet in constant time however long TransmitData() wasn't called for, e.g. while the editor is minimized,
+   * and nothing can overflow. Senders such as IPeakSender merge the packets that are dropped, so peaks are held until the GUI has read them
+   * @param mode The mode to use
+   * @param maxCtrlTags In ESenderMode::LatestValue, the number of different control tags the sender is used with. Each tag keeps its own latest packet,
+   * so one tag can't hide the packets of another. Packets for further tags are dropped */
+  void SetMode(ESenderMode mode, int maxCtrlTags = 1)
+  {
+    assert(maxCtrlTags > 0);
+
+    mMode = mode;
+
+    if (mode == ESenderMode::LatestValue && mNLatest != maxCtrlTags)
+    {
+      mLatest = std::make_unique<LatestValue[]>(maxCtrlTags);
+      mNLatest = maxCtrlTags;
+      mPopSlot = 0;
+    }
+  }
+
+  ESenderMode GetMode() const { return mMode; }
+
   /** Pushes a data element onto the queue. This can be called on the realtime audio thread. */
   void PushData(const ISenderData<MAXNC, T>& d)
   {
-    mQueue.Push(d);
+    if (mMode == ESenderMode::LatestValue)
+    {
+      LatestValue* pSlot = GetLatestValueSlot(d.ctrlTag);
+
+      if (pSlot)
+      {
+        pSlot->buffer.GetWriteBuffer() = d;
+        PublishLatestValue(*pSlot);
+      }
+      return;
+    }
+
+    uint8_t* pVals = ReserveData(d.ctrlTag, d.nChans, d.chanOffset, sizeof(T));
+
+    if (pVals)
+    {
+      memcpy(pVals, static_cast<const void*>(d.vals.data() + d.chanOffset), d.nChans * sizeof(T));
+      CommitData();
+    }
   }
 
   /** Pops elements off the queue and sends messages to controls.
    *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
   void TransmitData(IEditorDelegate& dlg)
   {
-    while(mQueue.ElementsAvailable())
+    while(PopData())
     {
-      ISenderData<MAXNC, T> d;
-      mQueue.Pop(d);
-      assert(d.ctrlTag != kNoTag && "You must supply a control tag");
-      dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
+      assert(mData.ctrlTag != kNoTag && "You must supply a control tag");
+      dlg.SendControlMsgFromDelegate(mData.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &mData);
     }
   }
   
@@ -90,21 +144,176 @@ public:
    @param ctrlTags A list of control tags that should receive the updates from this sender */
   void TransmitDataToControlsWithTags(IEditorDelegate& dlg, const std::initializer_list<int>& ctrlTags)
   {
-    while(mQueue.ElementsAvailable())
+    while(PopData())
     {
-      ISenderData<MAXNC, T> d;
-      mQueue.Pop(d);
-      
       for (auto tag : ctrlTags)
       {
-        d.ctrlTag = tag;
-        dlg.SendControlMsgFromDelegate(tag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
+        mData.ctrlTag = tag;
+        dlg.SendControlMsgFromDelegate(tag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &mData);
       }
     }
   }
 
+protected:
+  /** A function that combines a packet's value for a channel with the value of an older packet that the GUI didn't read, in ESenderMode::LatestValue */
+  using MergeFunc = void(*)(T& newer, const T& older);
+
+  /** Set how values that the GUI didn't read are merged into newer ones in ESenderMode::LatestValue, e.g. keeping the maximum of peak values. By default the older values are discarded */
+  void SetMergeFunc(MergeFunc func) { mMergeFunc = func; }
+
+  /** Reserve a packet in the queue, so that a subclass can write its values without filling an ISenderData first. This can be called on the realtime audio thread.
+   * @param ctrlTag The control tag to send the packet to
+   * @param nChans The number of channels in the packet
+   * @param chanOffset The first channel in the packet
+   * @param chanSize The number of bytes of each channel's value, at most sizeof(T). A subclass can send part of each value, e.g. the used part of a buffer
+   * @return A pointer to nChans consecutive values of chanSize bytes, which should be filled in before calling CommitData(), or nullptr if the queue is full.
+   * In ESenderMode::LatestValue, nullptr if the sender is already used with SetMode()'s maxCtrlTags other tags */
+  uint8_t* ReserveData(int ctrlTag, int nChans, int chanOffset, int chanSize)
+  {
+    assert(chanOffset >= 0 && nChans >= 0 && chanOffset + nChans <= MAXNC);
+    assert(chanSize <= static_cast<int>(sizeof(T)));
+
+    mReservedHeader = {ctrlTag, nChans, chanOffset, chanSize};
+
+    if (mMode == ESenderMode::LatestValue)
+    {
+      mReservedSlot = GetLatestValueSlot(ctrlTag);
+      return mReservedSlot ? mStaging.Get() + sizeof(PacketHeader) : nullptr;
+    }
+
+    // the packet is written to mStaging and pushed in one go by CommitData(), so that the GUI never sees part of it
+    if (mQueue.SpaceAvailable() < sizeof(PacketHeader) + nChans * chanSize)
+      return nullptr;
+
+    memcpy(mStaging.Get(), &mReservedHeader, sizeof(PacketHeader));
+    return mStaging.Get() + sizeof(PacketHeader);
+  }
+
+  /** Publish the packet returned by ReserveData() */
+  void CommitData()
+  {
+    if (mMode == ESenderMode::LatestValue)
+    {
+      Unpack(mReservedHeader, mStaging.Get() + sizeof(PacketHeader), mReservedSlot->buffer.GetWriteBuffer());
+      PublishLatestValue(*mReservedSlot);
+    }
+    else
+      mQueue.PushN(mStaging.Get(), sizeof(PacketHeader) + mReservedHeader.nChans * mReservedHeader.chanSize);
+  }
+
 private:
-  IPlugQueue<ISenderData<MAXNC, T>> mQueue {QUEUE_SIZE};
+  struct PacketHeader
+  {
+    int ctrlTag;
+    int nChans;
+    int chanOffset;
+    int chanSize;
+  };
+
+  static constexpr int kMaxPacketSize = sizeof(PacketHeader) + MAXNC * sizeof(T);
+
+  /** The state for one control tag in ESenderMode::LatestValue, only allocated when it is used */
+  struct LatestValue
+  {
+    std::atomic<bool> claimed {false}; // set by the producer once ctrlTag is valid, slots are claimed in order
+    int ctrlTag = kNoTag;
+    IPlugTripleBuffer<ISenderData<MAXNC, T>> buffer;
+    ISenderData<MAXNC, T> lastPublished; // producer only, the last packet published, including any it was merged with
+  };
+
+  /** Find the slot for a control tag, claiming a free one the first time the tag is used. Call this on the producer thread
+   * @return The slot, or nullptr if all slots are used by other tags */
+  LatestValue* GetLatestValueSlot(int ctrlTag)
+  {
+    for (auto i = 0; i < mNLatest; i++)
+    {
+      LatestValue& slot = mLatest[i];
+
+      if (!slot.claimed.load(std::memory_order_relaxed))
+      {
+        slot.ctrlTag = ctrlTag;
+        slot.claimed.store(true, std::memory_order_release);
+        return &slot;
+      }
+
+      if (slot.ctrlTag == ctrlTag)
+        return &slot;
+    }
+
+    assert(false && "ISender is used with more control tags than SetMode()'s maxCtrlTags");
+    return nullptr;
+  }
+
+  /** Copy the values in a packet into an ISenderData */
+  static void Unpack(const PacketHeader& header, const uint8_t* pVals, ISenderData<MAXNC, T>& d)
+  {
+    d.ctrlTag = header.ctrlTag;
+    d.nChans = header.nChans;
+    d.chanOffset = header.chanOffset;
+
+    for (auto c = 0; c < header.nChans; c++)
+      memcpy(static_cast<void*>(&d.vals[header.chanOffset + c]), pVals + c * header.chanSize, header.chanSize);
+  }
+
+  /** Publish the packet in the triple buffer's write buffer, after merging the last packet into it if the GUI didn't read that */
+  void PublishLatestValue(LatestValue& slot)
+  {
+    ISenderData<MAXNC, T>& next = slot.buffer.GetWriteBuffer();
+    const ISenderData<MAXNC, T>& last = slot.lastPublished;
+
+    if (mMergeFunc && !slot.buffer.WasRead() && next.ctrlTag == last.ctrlTag && next.nChans == last.nChans && next.chanOffset == last.chanOffset)
+    {
+      for (auto c = next.chanOffset; c < (next.chanOffset + next.nChans); c++)
+        mMergeFunc(next.vals[c], last.vals[c]);
+    }
+
+    slot.lastPublished = next;
+    slot.buffer.Publish();
+  }
+
+  /** Read the next packet into mData. In ESenderMode::LatestValue, this visits each control tag's slot once, then returns false
+   * @return \c true if there was a packet */
+  bool PopData()
+  {
+    if (mMode == ESenderMode::LatestValue)
+    {
+      while (mPopSlot < mNLatest && mLatest[mPopSlot].claimed.load(std::memory_order_acquire))
+      {
+        const ISenderData<MAXNC, T>* pLatest = mLatest[mPopSlot++].buffer.Read();
+
+        if (pLatest)
+        {
+          mData = *pLatest;
+          return true;
+        }
+      }
+
+      mPopSlot = 0;
+      return false;
+    }
+
+    // packets are pushed whole, so if the header is there so are the values
+    if (mQueue.ElementsAvailable() < sizeof(PacketHeader))
+      return false;
+
+    PacketHeader header;
+    mQueue.PopN(reinterpret_cast<uint8_t*>(&header), sizeof(PacketHeader));
+    mQueue.PopN(mPopBuffer.Get(), header.nChans * header.chanSize);
+    Unpack(header, mPopBuffer.Get(), mData);
+    return true;
+  }
+
+  IPlugQueue<uint8_t> mQueue;
+  ISenderData<MAXNC, T> mData; // the packet being transmitted, main thread only
+  ESenderMode mMode = ESenderMode::Queue;
+  MergeFunc mMergeFunc = nullptr;
+  PacketHeader mReservedHeader {kNoTag, 0, 0, 0};
+  std::unique_ptr<LatestValue[]> mLatest;
+  int mNLatest = 0;
+  int mPopSlot = 0; // main thread only, the next slot PopData() reads
+  LatestValue* mReservedSlot = nullptr; // producer only, the slot for the packet returned by ReserveData()
+  WDL_TypedBuf<uint8_t> mStaging; // producer only, the packet returned by ReserveData()
+  WDL_TypedBuf<uint8_t> mPopBuffer; // main thread only, the values of the packet being popped
 };
 
 /** IPeakSender is a utility class which can be used to defer peak data from sample buffers for sending to the GUI
@@ -119,6 +328,8 @@ public:
   , mThreshold(static_cast<float>(DBToAmp(minThresholdDb)))
   {
     Reset(DEFAULT_SAMPLE_RATE);
+    // in ESenderMode::LatestValue, keep the highest peak until the GUI reads it
+    this->SetMergeFunc([](float& newer, const float& older) { newer = std::max(newer, older); });
   }
   
   void Reset(double sampleRate)
@@ -131,6 +342,7 @@ public:
   {
     mWindowSizeMs = static_cast<float>(timeMs);
     mWindowSize = static_cast<int>(timeMs * 0.001 * sampleRate);
+    mCount = 0;
   }
   
   /** Queue peaks from sample buffers into the sender This can be called on the realtime audio thread.
@@ -141,7 +353,7 @@ public:
    @param chanOffset the starting channel */
   void ProcessBlock(sample** inputs, int nFrames, int ctrlTag = kNoTag, int nChans = MAXNC, int chanOffset = 0)
   {
-    for (auto s = 0; s < nFrames; s++)
+    for (auto s = 0; s < nFrames;)
     {
       if (mCount == 0)
       {
@@ -162,13 +374,16 @@ public:
         mPreviousSum = sum;
       }
       
+      // accumulate up to the end of the window in one pass per channel
+      const int n = std::min(nFrames - s, mWindowSize - mCount);
+
       for (auto c = chanOffset; c < (chanOffset + nChans); c++)
       {
-        mPeaks[c] += std::fabs(static_cast<float>(inputs[c][s]));
+        mPeaks[c] += static_cast<float>(simd::SumAbs(inputs[c] + s, n));
       }
       
-      mCount++;
-      mCount %= mWindowSize;
+      mCount = (mCount + n) % mWindowSize;
+      s += n;
     }
   }
 private:
@@ -233,6 +448,8 @@ public:
   , mPeakHoldTimeMs(peakHoldTimeMs)
   {
     Reset(DEFAULT_SAMPLE_RATE);
+    // in ESenderMode::LatestValue, keep the highest peak until the GUI reads it, the average is already smoothed so the newest is used
+    this->SetMergeFunc([](std::pair<float, float>& newer, const std::pair<float, float>& older) { newer.first = std::max(newer.first, older.first); });
   }
   
   void Reset(double sampleRate)
@@ -260,6 +477,7 @@ public:
   {
     mWindowSizeMs = static_cast<float>(timeMs);
     mWindowSize = static_cast<int>(timeMs * 0.001 * sampleRate);
+    mCount = 0;
 
     for (auto i=0; i<MAXNC; i++)
     {
@@ -283,15 +501,8 @@ public:
    @param chanOffset the starting channel */
   void ProcessBlock(sample** inputs, int nFrames, int ctrlTag = kNoTag, int nChans = MAXNC, int chanOffset = 0)
   {
-    for (auto s = 0; s < nFrames; s++)
+    for (auto s = 0; s < nFrames;)
     {
-      int windowPos = s % mWindowSize;
-      
-      for (auto c = chanOffset; c < (chanOffset + nChans); c++)
-      {
-        mBuffers[c][windowPos] = static_cast<float>(inputs[c][s]);
-      }
-      
       if (mCount == 0)
       {
         ISenderData<MAXNC, std::pair<float, float>> d {ctrlTag, nChans, chanOffset};
@@ -300,45 +511,9 @@ public:
         
         for (auto c = chanOffset; c < (chanOffset + nChans); c++)
         {
-          auto peakVal = 0.0f;
-          auto avgVal = 0.0f;
-#if defined OS_IOS || defined OS_MAC
-          vDSP_vabs(mBuffers[c].data(), 1, mBuffers[c].data(), 1, mWindowSize);
-          vDSP_maxv(mBuffers[c].data(), 1, &peakVal, mWindowSize);
-          
-          if (mRMSMode)
-          {
-            vDSP_rmsqv(mBuffers[c].data(), 1, &avgVal, mWindowSize);
-          }
-          else
-          {
-            vDSP_meanv(mBuffers[c].data(), 1, &avgVal, mWindowSize);
-          }
-#else
-          for (auto i=0; i<mWindowSize; i++)
-          {
-            auto absVal = std::fabs(mBuffers[c][i]);
-            
-            if (absVal > peakVal)
-            {
-              peakVal = absVal;
-            }
-            
-            if (mRMSMode)
-            {
-              absVal = absVal * absVal;
-            }
-            
-            avgVal += absVal;
-          }
-          
-          avgVal /= static_cast<float>(mWindowSize);
-          
-          if (mRMSMode)
-          {
-            avgVal = std::sqrt(avgVal);
-          }
-#endif
+          const float* pBuffer = mBuffers[c].data();
+          const auto peakVal = simd::Peak(pBuffer, mWindowSize);
+          auto avgVal = mRMSMode ? simd::RMS(pBuffer, mWindowSize) : simd::SumAbs(pBuffer, mWindowSize) / static_cast<float>(mWindowSize);
       
           // set peak-hold value
           if (mPeakHoldCounters[c] <= 0)
@@ -394,8 +569,16 @@ public:
         mPreviousSum = avgSum;
       }
       
-      mCount++;
-      mCount %= mWindowSize;
+      // buffer up to the end of the window, which is analysed when the next sample arrives
+      const int n = std::min(nFrames - s, mWindowSize - mCount);
+
+      for (auto c = chanOffset; c < (chanOffset + nChans); c++)
+      {
+        CastCopy(mBuffers[c].data() + mCount, inputs[c] + s, n);
+      }
+      
+      mCount = (mCount + n) % mWindowSize;
+      s += n;
     }
   }
 private:
@@ -437,7 +620,7 @@ public:
    @param chanOffset the starting channel */
   void ProcessBlock(sample** inputs, int nFrames, int ctrlTag = kNoTag, int nChans = MAXNC, int chanOffset = 0)
   {
-    for (auto s = 0; s < nFrames; s++)
+    for (auto s = 0; s < nFrames;)
     {
       if (mBufCount == mBufferSize)
       {
@@ -450,24 +633,34 @@ public:
 
         if (sum > mThreshold || mPreviousSum > mThreshold)
         {
-          mBuffer.ctrlTag = ctrlTag;
-          mBuffer.nChans = nChans;
-          mBuffer.chanOffset = chanOffset;
-          ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>::PushData(mBuffer);
+          // only the used part of each channel's buffer is queued
+          const int chanSize = mBufferSize * static_cast<int>(sizeof(float));
+          uint8_t* pVals = ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>::ReserveData(ctrlTag, nChans, chanOffset, chanSize);
+
+          if (pVals)
+          {
+            for (auto c = 0; c < nChans; c++)
+              memcpy(pVals + c * chanSize, mBuffers[chanOffset + c].data(), chanSize);
+
+            ISender<MAXNC, QUEUE_SIZE, std::array<float, MAXBUF>>::CommitData();
+          }
         }
 
         mPreviousSum = sum;
         mBufCount = 0;
       }
       
+      const int n = std::min(nFrames - s, mBufferSize - mBufCount);
+
       for (auto c = chanOffset; c < (chanOffset + nChans); c++)
       {
-        const float inputSample = static_cast<float>(inputs[c][s]);
-        mBuffer.vals[c][mBufCount] = inputSample;
-        mRunningSum[c] += std::fabs(inputSample);
+        float* pBuffer = mBuffers[c].data() + mBufCount;
+        CastCopy(pBuffer, inputs[c] + s, n);
+        mRunningSum[c] += simd::SumAbs(pBuffer, n);
       }
 
-      mBufCount++;
+      mBufCount += n;
+      s += n;
     }
   }
   
@@ -483,7 +676,7 @@ public:
   int GetBufferSize() const { return mBufferSize; }
   
 private:
-  ISenderData<MAXNC, std::array<float, MAXBUF>> mBuffer;
+  std::array<std::array<float, MAXBUF>, MAXNC> mBuffers {};
   int mBufCount = 0;
   int mBufferSize = MAXBUF;
   std::array<float, MAXNC> mRunningSum {0.};
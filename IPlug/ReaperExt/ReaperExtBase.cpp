@@ -8,13 +8,146 @@ ReaperExtBase::ReaperExtBase(reaper_plugin_info_t* pRec)
 ReaperExtBase::~ReaperExtBase()
 {
   mTimer->Stop();
+  UnregisterAudioHook();
+
+  if (mBatchThread.joinable())
+  {
+    CancelBatch();
+    mBatchThread.join();
+    mBatchPool.Stop();
+
+    for (auto& item : mBatchItems)
+      delete item.pSource;
+  }
 }
 
 void ReaperExtBase::OnTimer(Timer& t)
 {
+  if (mBatchThread.joinable())
+  {
+    if (mBatchFinished)
+      FinishBatch();
+    else
+      OnBatchProgress(GetBatchProgress());
+  }
+
   OnIdle();
 }
 
+#pragma mark - Audio hook
+
+//static
+void ReaperExtBase::AudioHookProc(bool isPost, int len, double srate, audio_hook_register_t* pReg)
+{
+  ReaperExtBase* pExt = static_cast<ReaperExtBase*>(pReg->userdata1);
+  pExt->OnAudioHook(isPost, len, srate, AudioHookBuffers(pReg));
+}
+
+bool ReaperExtBase::RegisterAudioHook()
+{
+  if (!mAudioHookRegistered)
+  {
+    mAudioHook = {};
+    mAudioHook.OnAudioBuffer = AudioHookProc;
+    mAudioHook.userdata1 = this;
+    mAudioHookRegistered = Audio_RegHardwareHook(true, &mAudioHook) != 0;
+  }
+
+  return mAudioHookRegistered;
+}
+
+void ReaperExtBase::UnregisterAudioHook()
+{
+  if (mAudioHookRegistered)
+  {
+    Audio_RegHardwareHook(false, &mAudioHook); // REAPER won't call the hook once this returns
+    mAudioHookRegistered = false;
+  }
+}
+
+#pragma mark - Batch processing
+
+bool ReaperExtBase::RunBatchOnSelectedItems(BatchItemFunc func, BatchCompletionFunc completion, int nThreads)
+{
+  if (mBatchThread.joinable())
+    return false;
+
+  mBatchItems.clear();
+
+  const int nSelected = CountSelectedMediaItems(nullptr);
+
+  for (auto i = 0; i < nSelected; i++)
+  {
+    BatchItem item;
+    item.pItem = GetSelectedMediaItem(nullptr, i);
+    item.pTake = item.pItem ? GetActiveTake(item.pItem) : nullptr;
+    PCM_source* pSource = item.pTake ? GetMediaItemTake_Source(item.pTake) : nullptr;
+
+    // skip empty items and MIDI, whose sources have no sample rate
+    if (!pSource || pSource->GetSampleRate() < 1. || pSource->GetNumChannels() < 1)
+      continue;
+
+    // the worker threads read private copies, since the project's sources may be read or changed on the main and audio threads meanwhile
+    item.pSource = pSource->Duplicate();
+
+    if (!item.pSource)
+      continue;
+
+    item.position = GetMediaItemInfo_Value(item.pItem, "D_POSITION");
+    item.length = GetMediaItemInfo_Value(item.pItem, "D_LENGTH");
+    item.startOffset = GetMediaItemTakeInfo_Value(item.pTake, "D_STARTOFFS");
+    item.sampleRate = item.pSource->GetSampleRate();
+    item.nChans = item.pSource->GetNumChannels();
+    mBatchItems.push_back(item);
+  }
+
+  if (mBatchItems.empty())
+    return false;
+
+  mBatchFunc = func;
+  mBatchCompletion = completion;
+  mBatchNDone = 0;
+  mBatchFinished = false;
+  mBatchCancelled = false;
+  mBatchPool.Start(nThreads, 0., false);
+
+  mBatchThread = std::thread([this]() {
+    auto job = [this](int itemIdx) {
+      if (!mBatchCancelled)
+        mBatchFunc(itemIdx, mBatchItems[itemIdx]);
+
+      mBatchNDone++;
+    };
+
+    mBatchPool.Run(static_cast<int>(mBatchItems.size()), job);
+    mBatchFinished = true;
+  });
+
+  return true;
+}
+
+void ReaperExtBase::FinishBatch()
+{
+  mBatchThread.join();
+  mBatchPool.Stop();
+
+  OnBatchProgress(1.f);
+
+  // the completion function may start another batch
+  std::vector<BatchItem> items = std::move(mBatchItems);
+  BatchCompletionFunc completion = std::move(mBatchCompletion);
+  const bool cancelled = mBatchCancelled;
+  mBatchItems.clear();
+  mBatchFunc = nullptr;
+  mBatchCompletion = nullptr;
+
+  if (completion)
+    completion(items, cancelled);
+
+  for (auto& item : items)
+    delete item.pSource;
+}
+
 auto ClientResize = [](HWND hWnd, int nWidth, int nHeight) {
   RECT rcClient, rcWindow;
   POINT ptDiff;
@@ -16,10 +16,16 @@
  * Include this file in the main header for your reaper extension
 */
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include "IPlugTimer.h"
 #include "IPlugDelegate_select.h"
-
-struct reaper_plugin_info_t;
+#include "IPlugWorkerPool.h"
+#include "reaper_plugin.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -51,6 +57,101 @@ public:
   
   void ToggleDocking();
 
+#pragma mark - Audio hook
+  /** The buffers of REAPER's audio device, passed to OnAudioHook(). Only valid during that call */
+  class AudioHookBuffers
+  {
+  public:
+    AudioHookBuffers(audio_hook_register_t* pReg) : mReg(pReg) {}
+
+    int NInputs() const { return mReg->input_nch; }
+    int NOutputs() const { return mReg->output_nch; }
+
+    /** @return The buffer of an input channel of the device, or nullptr */
+    ReaSample* GetInput(int idx) const { return idx < mReg->input_nch ? mReg->GetBuffer(false, idx) : nullptr; }
+
+    /** @return The buffer of an output channel of the device, or nullptr */
+    ReaSample* GetOutput(int idx) const { return idx < mReg->output_nch ? mReg->GetBuffer(true, idx) : nullptr; }
+
+  private:
+    audio_hook_register_t* mReg;
+  };
+
+  /** Register with REAPER so that OnAudioHook() is called for each block of its audio device. Call this on the main thread
+   * @return \c true if the hook was registered */
+  bool RegisterAudioHook();
+
+  /** Stop calls to OnAudioHook(). Call this on the main thread, it is called by the destructor */
+  void UnregisterAudioHook();
+
+  /** Override this method to process or analyse the audio of REAPER's audio device, e.g. to meter the master output. Once RegisterAudioHook() has been called it is called twice per block,
+   * before REAPER processes the block, with the device's inputs, and after it, with the outputs that will be sent to the device, which can still be modified.
+   * THIS METHOD IS CALLED BY THE HIGH PRIORITY AUDIO THREAD - You should not allocate memory, take locks or call the REAPER API here. Send results to OnIdle() with an IPlugQueue
+   * @param isPost \c false before REAPER processes the block, \c true after
+   * @param nFrames The number of frames in each buffer
+   * @param sampleRate The sample rate of the device */
+  virtual void OnAudioHook(bool isPost, int nFrames, double sampleRate, const AudioHookBuffers& buffers) {}
+
+#pragma mark - Batch processing
+  /** A media item that is processed by RunBatchOnSelectedItems(), with a copy of the source of its active take, so that the audio can be read on a worker thread */
+  struct BatchItem
+  {
+    MediaItem* pItem = nullptr; // only use these with the REAPER API on the main thread, e.g. in the completion function
+    MediaItem_Take* pTake = nullptr;
+    PCM_source* pSource = nullptr; // a duplicate of the take's source, owned by the batch
+    double position = 0.; // the position of the item in the project, in seconds
+    double length = 0.; // the length of the item, in seconds
+    double startOffset = 0.; // where the take starts in the source, in seconds
+    double sampleRate = 0.;
+    int nChans = 0;
+
+    /** Read the audio of the take, ignoring its playback rate. Call this on the worker thread that is processing the item
+     * @param time The time from the start of the item, in seconds
+     * @param pDest Receives nFrames frames of nChans interleaved channels
+     * @return The number of frames read, less than nFrames at the end of the source */
+    int Read(double time, ReaSample* pDest, int nFrames) const
+    {
+      PCM_source_transfer_t transfer = {};
+      transfer.time_s = startOffset + time;
+      transfer.samplerate = sampleRate;
+      transfer.nch = nChans;
+      transfer.length = nFrames;
+      transfer.samples = pDest;
+      pSource->GetSamples(&transfer);
+      return transfer.samples_out;
+    }
+  };
+
+  /** Called on a worker thread for each item of a batch. It should return early if IsBatchCancelled() */
+  using BatchItemFunc = std::function<void(int itemIdx, const BatchItem& item)>;
+
+  /** Called on the main thread when all the items have been processed, or the batch was cancelled. The items' sources are deleted after it returns */
+  using BatchCompletionFunc = std::function<void(const std::vector<BatchItem>& items, bool cancelled)>;
+
+  /** Process the selected media items of the current project on worker threads, e.g. to analyse their audio offline. The items are collected on the calling thread, which must be the main thread,
+   * and OnBatchProgress() is called on the main thread as they are processed. Only one batch can run at a time
+   * @param func Called for each item on a worker thread. It must not call the REAPER API, other than to read the item with BatchItem::Read()
+   * @param completion Called on the main thread when the batch has finished
+   * @param nThreads The number of worker threads, -1 for one less than the number of hardware threads
+   * @return \c false if a batch is already running or no item with audio is selected */
+  bool RunBatchOnSelectedItems(BatchItemFunc func, BatchCompletionFunc completion, int nThreads = -1);
+
+  /** Ask the running batch to stop. The items that have started are finished, unless their function checks IsBatchCancelled() */
+  void CancelBatch() { mBatchCancelled = true; }
+
+  /** @return \c true if the running batch has been cancelled, call this from a BatchItemFunc to return early */
+  bool IsBatchCancelled() const { return mBatchCancelled; }
+
+  /** @return \c true if a batch is running, until it finishes and its completion function is called */
+  bool IsBatchRunning() const { return mBatchThread.joinable(); }
+
+  /** @return The fraction of the items of the running batch that have been processed, from 0 to 1 */
+  float GetBatchProgress() const { return mBatchItems.empty() ? 1.f : static_cast<float>(mBatchNDone) / mBatchItems.size(); }
+
+  /** Override this method to show the progress of a batch, it is called on the main thread at the idle rate while a batch is running
+   * @param progress The fraction of the items that have been processed */
+  virtual void OnBatchProgress(float progress) {}
+
 public:
   // Reaper calls back to this when it wants to execute an action registered by the extension plugin
   static bool HookCommandProc(int command, int flag);
@@ -63,9 +164,26 @@ private:
   
   void OnTimer(Timer& t);
 
+  static void AudioHookProc(bool isPost, int len, double srate, audio_hook_register_t* pReg);
+
+  /** Called by OnTimer() when the batch's worker threads have finished */
+  void FinishBatch();
+
   reaper_plugin_info_t* mRec = nullptr;
   std::unique_ptr<Timer> mTimer;
   bool mDocked = false;
+
+  audio_hook_register_t mAudioHook = {};
+  bool mAudioHookRegistered = false;
+
+  std::vector<BatchItem> mBatchItems;
+  BatchItemFunc mBatchFunc;
+  BatchCompletionFunc mBatchCompletion;
+  IPlugWorkerPool mBatchPool;
+  std::thread mBatchThread; // runs the items on mBatchPool, so that the main thread is not blocked
+  std::atomic<int> mBatchNDone {0};
+  std::atomic<bool> mBatchFinished {false};
+  std::atomic<bool> mBatchCancelled {false};
 };
 
 END_IPLUG_NAMESPACE
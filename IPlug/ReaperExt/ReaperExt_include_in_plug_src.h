@@ -58,6 +58,13 @@ extern "C"
       IMPAPI(ShowConsoleMsg);
       IMPAPI(DockWindowAdd);
       IMPAPI(DockWindowActivate);
+      IMPAPI(Audio_RegHardwareHook);
+      IMPAPI(CountSelectedMediaItems);
+      IMPAPI(GetSelectedMediaItem);
+      IMPAPI(GetActiveTake);
+      IMPAPI(GetMediaItemTake_Source);
+      IMPAPI(GetMediaItemInfo_Value);
+      IMPAPI(GetMediaItemTakeInfo_Value);
       
       if (gErrorCount > 0)
         return 0;
@@ -11,6 +11,7 @@
 #include <cstdio>
 #include "IPlugVST2.h"
 #include "IPlugPluginBase.h"
+#include "IPlugRealtimeCheck.h"
 
 using namespace iplug;
 
@@ -122,6 +123,7 @@ static int VSTKeyCodeToVK(int code, int ascii)
 IPlugVST2::IPlugVST2(const InstanceInfo& info, const Config& config)
   : IPlugAPIBase(config, kAPIVST2)
   , IPlugProcessor(config, kAPIVST2)
+  , mParamChangedByHost(config.nParams)
   , mHostCallback(info.mVSTHostCallback)
 {
   Trace(TRACELOC, "%s", config.pluginName);
@@ -146,8 +148,11 @@ IPlugVST2::IPlugVST2(const InstanceInfo& info, const Config& config)
   mAEffect.__processDeprecated = VSTProcess;
   mAEffect.processReplacing = VSTProcessReplacing;
   mAEffect.processDoubleReplacing = VSTProcessDoubleReplacing;
-  mAEffect.initialDelay = config.latency;
-  mAEffect.flags = effFlagsCanReplacing | effFlagsCanDoubleReplacing;
+  mAEffect.initialDelay = GetReportedLatency();
+  mAEffect.flags = effFlagsCanReplacing;
+#ifdef SAMPLE_TYPE_DOUBLE
+  mAEffect.flags |= effFlagsCanDoubleReplacing; // single precision builds don't advertise double replacing, to avoid conversion
+#endif
 
   if (config.plugDoesChunks) { mAEffect.flags |= effFlagsProgramChunks; }
   if (LegalIO(1, -1)) { mAEffect.flags |= __effFlagsCanMonoDeprecated; }
@@ -156,6 +161,9 @@ IPlugVST2::IPlugVST2(const InstanceInfo& info, const Config& config)
   memset(&mEditRect, 0, sizeof(ERect));
   memset(&mInputSpkrArr, 0, sizeof(VstSpeakerArrangement));
   memset(&mOutputSpkrArr, 0, sizeof(VstSpeakerArrangement));
+
+  mMidiOutputEvents.Resize(mMidiOutputQueue.GetCapacity());
+  mMidiOutputEventsList.Resize(sizeof(VstEvents) + mMidiOutputQueue.GetCapacity() * sizeof(VstEvent*));
   mInputSpkrArr.numChannels = nInputs;
   mOutputSpkrArr.numChannels = nOutputs;
   mInputSpkrArr.type = VSTSpkrArrType(nInputs);
@@ -223,8 +231,8 @@ void IPlugVST2::UpdateEditRect()
 
 void IPlugVST2::SetLatency(int samples)
 {
-  mAEffect.initialDelay = samples;
   IPlugProcessor::SetLatency(samples);
+  mAEffect.initialDelay = GetReportedLatency();
   mHostCallback(&mAEffect, audioMasterIOChanged, 0, 0, 0, 0.0f);
 }
 
@@ -242,17 +250,42 @@ bool IPlugVST2::SendVSTEvent(VstEvent& event)
 
 bool IPlugVST2::SendMidiMsg(const IMidiMsg& msg)
 {
-  VstMidiEvent midiEvent;
-  memset(&midiEvent, 0, sizeof(VstMidiEvent));
+  return mMidiOutputQueue.Add(msg); // sent after processing, see OutputMidiFromProcessor()
+}
+
+void IPlugVST2::OutputMidiFromProcessor(int nFrames)
+{
+  const int nMsgs = std::min(mMidiOutputQueue.ToDo(), mMidiOutputEvents.GetSize());
+
+  if (nMsgs)
+  {
+    VstEvents* pEvents = (VstEvents*) mMidiOutputEventsList.Get();
+    VstMidiEvent* pMidiEvents = mMidiOutputEvents.Get();
 
-  midiEvent.type = kVstMidiType;
-  midiEvent.byteSize = sizeof(VstMidiEvent);  // Should this be smaller?
-  midiEvent.deltaFrames = msg.mOffset;
-  midiEvent.midiData[0] = msg.mStatus;
-  midiEvent.midiData[1] = msg.mData1;
-  midiEvent.midiData[2] = msg.mData2;
+    memset(pEvents, 0, sizeof(VstEvents));
+    pEvents->numEvents = nMsgs;
 
-  return SendVSTEvent((VstEvent&) midiEvent);
+    for (int i = 0; i < nMsgs; i++)
+    {
+      const IMidiMsg& msg = mMidiOutputQueue.Peek();
+      VstMidiEvent& midiEvent = pMidiEvents[i];
+      memset(&midiEvent, 0, sizeof(VstMidiEvent));
+
+      midiEvent.type = kVstMidiType;
+      midiEvent.byteSize = sizeof(VstMidiEvent);  // Should this be smaller?
+      midiEvent.deltaFrames = msg.mOffset;
+      midiEvent.midiData[0] = msg.mStatus;
+      midiEvent.midiData[1] = msg.mData1;
+      midiEvent.midiData[2] = msg.mData2;
+
+      pEvents->events[i] = (VstEvent*) &midiEvent;
+      mMidiOutputQueue.Remove();
+    }
+
+    mHostCallback(&mAEffect, audioMasterProcessEvents, 0, 0, pEvents, 0.0f);
+  }
+
+  mMidiOutputQueue.Flush(nFrames);
 }
 
 bool IPlugVST2::SendSysEx(const ISysEx& msg)
@@ -440,12 +473,16 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
     {
       if (!value)
       {
+        _this->mResumed = false;
+        _this->ApplyParamChangesFromHost(); // processing has stopped, so any changes still pending are delivered now
         _this->OnActivate(false);
         _this->OnReset();
       }
       else
       {
+        _this->InitParamBuffers(_this->GetParams());
         _this->OnActivate(true);
+        _this->mResumed = true;
       }
       return 0;
     }
@@ -561,7 +598,7 @@ VstIntPtr VSTCALLBACK IPlugVST2::VSTDispatcher(AEffect *pEffect, VstInt32 opCode
             {
               VstMidiEvent* pME = (VstMidiEvent*) pEvent;
               IMidiMsg msg(pME->deltaFrames, pME->midiData[0], pME->midiData[1], pME->midiData[2]);
-              _this->ProcessMidiMsg(msg);
+              _this->HandleMidiMsg(msg);
               _this->mMidiMsgsFromProcessor.Push(msg);
 
               //#ifdef TRACER_BUILD
@@ -965,45 +1002,51 @@ void IPlugVST2::VSTPreProcess(SAMPLETYPE** inputs, SAMPLETYPE** outputs, VstInt3
   SetTimeInfo(timeInfo);
   SetRenderingOffline(renderingOffline);
 
-  IMidiMsg msg;
+  ApplyDeferredParamReset();
+  ApplyParamChangesFromHost();
 
-  while (mMidiMsgsFromEditor.Pop(msg))
-  {
-    ProcessMidiMsg(msg);
-  }
+  ProcessMidiMsgsFromEditor(nFrames, GetSampleRate(), [this](const IMidiMsg& msg) {
+    HandleMidiMsg(msg);
+  });
 }
 
 // Deprecated.
 void VSTCALLBACK IPlugVST2::VSTProcess(AEffect* pEffect, float** inputs, float** outputs, VstInt32 nFrames)
 {
   TRACE
+  IPLUG_MARK_REALTIME_THREAD();
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
   _this->VSTPreProcess(inputs, outputs, nFrames);
   ENTER_PARAMS_MUTEX_STATIC
   _this->ProcessBuffersAccumulating(nFrames);
   LEAVE_PARAMS_MUTEX_STATIC
+  _this->OutputMidiFromProcessor(nFrames);
   _this->OutputSysexFromEditor();
 }
 
 void VSTCALLBACK IPlugVST2::VSTProcessReplacing(AEffect* pEffect, float** inputs, float** outputs, VstInt32 nFrames)
 {
   TRACE
+  IPLUG_MARK_REALTIME_THREAD();
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
   _this->VSTPreProcess(inputs, outputs, nFrames);
   ENTER_PARAMS_MUTEX_STATIC
   _this->ProcessBuffers((float) 0.0f, nFrames);
   LEAVE_PARAMS_MUTEX_STATIC
+  _this->OutputMidiFromProcessor(nFrames);
   _this->OutputSysexFromEditor();
 }
 
 void VSTCALLBACK IPlugVST2::VSTProcessDoubleReplacing(AEffect* pEffect, double** inputs, double** outputs, VstInt32 nFrames)
 {
   TRACE
+  IPLUG_MARK_REALTIME_THREAD();
   IPlugVST2* _this = (IPlugVST2*) pEffect->object;
   _this->VSTPreProcess(inputs, outputs, nFrames);
   ENTER_PARAMS_MUTEX_STATIC
   _this->ProcessBuffers((double) 0.0, nFrames);
   LEAVE_PARAMS_MUTEX_STATIC
+  _this->OutputMidiFromProcessor(nFrames);
   _this->OutputSysexFromEditor();
 }
 
@@ -1031,11 +1074,40 @@ void VSTCALLBACK IPlugVST2::VSTSetParameter(AEffect *pEffect, VstInt32 idx, floa
     ENTER_PARAMS_MUTEX_STATIC
     _this->GetParam(idx)->SetNormalized(value);
     _this->SendParameterValueFromAPI(idx, value, true);
-    _this->OnParamChange(idx, kHost);
+
+    // setParameter() can be called from any thread, at any time during a block. While processing, the change is applied at the start of the next block, so automation is deterministic
+    if (_this->mResumed)
+    {
+      _this->mParamChangedByHost[idx].store(true, std::memory_order_relaxed);
+      _this->mAnyParamChangedByHost.store(true, std::memory_order_release);
+    }
+    else
+    {
+      _this->OnParamChange(idx, kHost);
+    }
     LEAVE_PARAMS_MUTEX_STATIC
   }
 }
 
+void IPlugVST2::ApplyParamChangesFromHost()
+{
+  if (!mAnyParamChangedByHost.exchange(false, std::memory_order_acquire))
+    return;
+
+  ENTER_PARAMS_MUTEX
+  for (int i = 0; i < NParams(); i++)
+  {
+    if (mParamChangedByHost[i].exchange(false, std::memory_order_relaxed))
+    {
+      if (HasParamBuffer(i))
+        AddParamRamp(ParamRamp(i, GetParam(i)->GetNormalized(), 0)); // VST2 changes are steps, which the ramp smooths
+
+      OnParamChange(i, kHost, 0);
+    }
+  }
+  LEAVE_PARAMS_MUTEX
+}
+
 void IPlugVST2::OutputSysexFromEditor()
 {
   //Output SYSEX from the editor, which has bypassed ProcessSysEx()
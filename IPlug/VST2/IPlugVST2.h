@@ -17,6 +17,9 @@
  * @copydoc IPlugVST
  */
 
+#include <atomic>
+#include <vector>
+
 #include "aeffectx.h"
 #include "IPlugAPIBase.h"
 #include "IPlugProcessor.h"
@@ -78,6 +81,10 @@ private:
   
   bool SendVSTEvent(VstEvent& event);
   bool SendVSTEvents(WDL_TypedBuf<VstEvent>* pEvents);
+  /** Send the MIDI messages queued during the block to the host in a single audioMasterProcessEvents call */
+  void OutputMidiFromProcessor(int nFrames);
+  /** Call OnParamChange() for the parameters the host has set via setParameter() since the last call */
+  void ApplyParamChangesFromHost();
   
   void UpdateEditRect();
     
@@ -89,6 +96,14 @@ private:
 
   IByteChunk mState;     // Persistent storage if the host asks for plugin state.
   IByteChunk mBankState; // Persistent storage if the host asks for bank state.
+
+  WDL_TypedBuf<VstMidiEvent> mMidiOutputEvents; // preallocated for OutputMidiFromProcessor()
+  WDL_HeapBuf mMidiOutputEventsList; // a VstEvents struct with room for a pointer to each of mMidiOutputEvents
+
+  // While the plug-in is resumed, setParameter() only sets the value and flags the parameter, OnParamChange() is called at the start of the next block on the audio thread
+  std::atomic<bool> mResumed {false};
+  std::vector<std::atomic<bool>> mParamChangedByHost;
+  std::atomic<bool> mAnyParamChangedByHost {false};
 protected:
   AEffect mAEffect;
   audioMasterCallback mHostCallback;
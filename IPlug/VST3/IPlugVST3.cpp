@@ -210,6 +210,22 @@ void IPlugVST3::InformHostOfParameterDetailsChange()
   handler->restartComponent(kParamTitlesChanged);
 }
 
+void IPlugVST3::InformHostOfParamValueChanges(const int* pParamIdxs, int nParams)
+{
+  // the values are sent as edits, so that the host records automation and undo for them, grouped so the host can treat them as one
+  startGroupEdit();
+  for (int i = 0; i < nParams; i++)
+  {
+    const int paramIdx = pParamIdxs[i];
+    const double value = GetParam(paramIdx)->GetNormalized();
+    IPlugVST3ControllerBase::SetVST3ParamNormalized(paramIdx, value);
+    beginEdit(paramIdx);
+    performEdit(paramIdx, value);
+    endEdit(paramIdx);
+  }
+  finishGroupEdit();
+}
+
 bool IPlugVST3::EditorResize(int viewWidth, int viewHeight)
 {
   if (HasUI())
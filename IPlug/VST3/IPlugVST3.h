@@ -61,6 +61,7 @@ public:
   void EndInformHostOfParamChange(int idx) override;
   void InformHostOfPresetChange() override {}
   void InformHostOfParameterDetailsChange() override;
+  void InformHostOfParamValueChanges(const int* pParamIdxs, int nParams) override;
   bool EditorResize(int viewWidth, int viewHeight) override;
 
   // IEditorDelegate
@@ -79,7 +80,7 @@ public:
   Steinberg::tresult PLUGIN_API setProcessing (Steinberg::TBool state) override;
   Steinberg::tresult PLUGIN_API process(Steinberg::Vst::ProcessData& data) override;
   Steinberg::tresult PLUGIN_API canProcessSampleSize(Steinberg::int32 symbolicSampleSize) override;
-  Steinberg::uint32 PLUGIN_API getLatencySamples() override { return GetLatency(); }
+  Steinberg::uint32 PLUGIN_API getLatencySamples() override { return GetReportedLatency(); }
   Steinberg::uint32 PLUGIN_API getTailSamples() override { return GetTailSize(); } //TODO - infinite tail
   Steinberg::tresult PLUGIN_API setState(Steinberg::IBStream* pState) override;
   Steinberg::tresult PLUGIN_API getState(Steinberg::IBStream* pState) override;
@@ -53,6 +53,18 @@ struct IPlugVST3State
     
     IByteChunk chunk;
     
+    // reserve the rest of the stream, if it can say how long it is, so that the chunk isn't reallocated as it's read
+    Steinberg::int64 startPos = 0, endPos = 0, restoredPos = -1;
+    
+    if (pState->tell(&startPos) == Steinberg::kResultOk
+        && pState->seek(0, Steinberg::IBStream::kIBSeekEnd, &endPos) == Steinberg::kResultOk
+        && pState->seek(startPos, Steinberg::IBStream::kIBSeekSet, &restoredPos) == Steinberg::kResultOk
+        && pState->tell(&restoredPos) == Steinberg::kResultOk && restoredPos == startPos)
+    {
+      if (endPos > startPos && endPos - startPos < 0x7FFFFFFF)
+        chunk.Reserve(static_cast<int>(endPos - startPos));
+    }
+    
     const int bytesPerBlock = 128;
     char buffer[bytesPerBlock];
     
@@ -155,14 +155,56 @@ void IPlugVST3Controller::DirtyParametersFromUI()
   finishGroupEdit();
 }
 
+void IPlugVST3Controller::InformHostOfParamValueChanges(const int* pParamIdxs, int nParams)
+{
+  // the values are sent as edits, so that the host records automation and undo for them, and passes them on to the processor. They are grouped so the host can treat them as one
+  startGroupEdit();
+  for (int i = 0; i < nParams; i++)
+  {
+    const int paramIdx = pParamIdxs[i];
+    const double value = GetParam(paramIdx)->GetNormalized();
+    IPlugVST3ControllerBase::SetVST3ParamNormalized(paramIdx, value);
+    beginEdit(paramIdx);
+    performEdit(paramIdx, value);
+    endEdit(paramIdx);
+  }
+  finishGroupEdit();
+}
+
 #pragma mark Message with Processor
 
+tresult PLUGIN_API IPlugVST3Controller::disconnect(IConnectionPoint* other)
+{
+  mMessageChannel = nullptr;
+  return EditControllerEx1::disconnect(other);
+}
+
 tresult PLUGIN_API IPlugVST3Controller::notify(IMessage* message)
 {
   if (!message)
     return kInvalidArgument;
   
-  if (!strcmp(message->getMessageID(), "SCVFD"))
+  if (!strcmp(message->getMessageID(), "SMRFP")) // shared message channel from processor
+  {
+    Steinberg::int64 processToken = 0, moduleToken = 0, id = 0;
+    
+    if (message->getAttributes()->getInt("PT", processToken) == kResultOk
+        && message->getAttributes()->getInt("MT", moduleToken) == kResultOk
+        && message->getAttributes()->getInt("ID", id) == kResultOk
+        && (mMessageChannel = IPlugVST3MessageChannel::Find(processToken, moduleToken, id)))
+    {
+      OPtr<IMessage> reply = allocateMessage();
+      
+      if (reply)
+      {
+        reply->setMessageID("SMRC");
+        sendMessage(reply);
+      }
+    }
+    
+    return kResultOk;
+  }
+  else if (!strcmp(message->getMessageID(), "SCVFD"))
   {
     Steinberg::int64 ctrlTag = kNoTag;
     double normalizedValue = 0.;
@@ -230,6 +272,42 @@ tresult PLUGIN_API IPlugVST3Controller::notify(IMessage* message)
   return ComponentBase::notify(message);
 }
 
+void IPlugVST3Controller::ReceiveMessagesFromProcessor()
+{
+  if (!mMessageChannel)
+    return;
+  
+  // read whatever the processor wrote before it was destroyed, then let go of the channel
+  const bool open = mMessageChannel->IsOpen();
+  
+  while (mMessageChannel->Pop([this](const IPlugVST3MessageChannel::MessageHeader& header, const void* pData) {
+    switch (header.type)
+    {
+      case IPlugVST3MessageChannel::kControlValue:
+        SendControlValueFromDelegate(header.ctrlTag, header.value);
+        break;
+      case IPlugVST3MessageChannel::kControlMsg:
+        SendControlMsgFromDelegate(header.ctrlTag, header.msgTag, header.size, pData);
+        break;
+      case IPlugVST3MessageChannel::kMidiMsg:
+      {
+        IMidiMsg msg;
+        memcpy(&msg, pData, sizeof(IMidiMsg));
+        SendMidiMsgFromDelegate(msg);
+        break;
+      }
+      case IPlugVST3MessageChannel::kSysEx:
+        SendSysexMsgFromDelegate({header.msgTag, static_cast<const uint8_t*>(pData), header.size});
+        break;
+      default:
+        break;
+    }
+  }));
+  
+  if (!open)
+    mMessageChannel = nullptr;
+}
+
 void IPlugVST3Controller::SendMidiMsgFromUI(const IMidiMsg& msg)
 {
   OPtr<IMessage> message = allocateMessage();
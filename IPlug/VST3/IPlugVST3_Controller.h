@@ -26,6 +26,9 @@
 #include "IPlugVST3_View.h"
 #include "IPlugVST3_ControllerBase.h"
 #include "IPlugVST3_Common.h"
+#include "IPlugVST3_MessageChannel.h"
+
+#include <memory>
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -58,6 +61,7 @@ public:
   Steinberg::Vst::ParamValue PLUGIN_API getParamNormalized (Steinberg::Vst::ParamID tag) override;
   Steinberg::tresult PLUGIN_API setParamNormalized(Steinberg::Vst::ParamID tag, Steinberg::Vst::ParamValue value) override;
   // ComponentBase
+  Steinberg::tresult PLUGIN_API disconnect(Steinberg::Vst::IConnectionPoint* other) override;
   Steinberg::tresult PLUGIN_API notify(Steinberg::Vst::IMessage* message) override;
 
   // IMidiMapping
@@ -112,6 +116,7 @@ public:
   void InformHostOfPresetChange() override  { /* TODO: */}
   bool EditorResize(int viewWidth, int viewHeight) override;
   void DirtyParametersFromUI() override;
+  void InformHostOfParamValueChanges(const int* pParamIdxs, int nParams) override;
   
   // IEditorDelegate
   void SendMidiMsgFromUI(const IMidiMsg& msg) override;
@@ -123,10 +128,13 @@ public:
   ViewType* GetView() const { return mView; }
 
 private:
+  void ReceiveMessagesFromProcessor() override;
+
   ViewType* mView = nullptr;
   bool mPlugIsInstrument;
   bool mDoesMidiIn;
   Steinberg::FUID mProcessorGUID;
+  std::shared_ptr<IPlugVST3MessageChannel> mMessageChannel; // shared with the processor, if it is in the same process
 };
 
 END_IPLUG_NAMESPACE
@@ -83,33 +83,19 @@ public:
     
     pEditController->addUnit(new Steinberg::Vst::Unit(unitInfo));
 
+    for (int g = 0; g < pPlug->NParamGroups(); g++) // add a unit for each parameter group
+    {
+      unitInfo.id = g + 1;
+      unitInfo.parentUnitId = Steinberg::Vst::kRootUnitId;
+      unitInfo.programListId = Steinberg::Vst::kNoProgramListId;
+      unitNameSetter.fromAscii(pPlug->GetParamGroupName(g));
+      pEditController->addUnit (new Steinberg::Vst::Unit (unitInfo));
+    }
+
     for (int i = 0; i < pPlug->NParams(); i++)
     {
       IParam* pParam = pPlug->GetParam(i);
-      unitID = Steinberg::Vst::kRootUnitId; // reset unitID
-    
-      const char* paramGroupName = pParam->GetGroup();
-      
-      if (CStringHasContents(paramGroupName)) // if the parameter has a group
-      {
-        for (int j = 0; j < pPlug->NParamGroups(); j++) // loop through previously added groups
-        {
-          if (strcmp(paramGroupName, pPlug->GetParamGroupName(j)) == 0) // if group name found in existing groups
-          {
-            unitID = j + 1; // increment unitID
-          }
-        }
-        
-        if (unitID == Steinberg::Vst::kRootUnitId) // if unitID was still kRootUnitId, we found a new group, so add it and add the unit
-        {
-          unitID = pPlug->AddParamGroup(paramGroupName); // updates unitID
-          unitInfo.id = unitID;
-          unitInfo.parentUnitId = Steinberg::Vst::kRootUnitId;
-          unitInfo.programListId = Steinberg::Vst::kNoProgramListId;
-          unitNameSetter.fromAscii(paramGroupName);
-          pEditController->addUnit (new Steinberg::Vst::Unit (unitInfo));
-        }
-      }
+      unitID = pPlug->GetParamGroupIdxForParam(i) + 1; // kRootUnitId if the parameter has no group
       
       Steinberg::Vst::Parameter* pVST3Parameter = new IPlugVST3Parameter(pParam, i, unitID);
       mParameters.addParameter(pVST3Parameter);
@@ -0,0 +1,201 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IPlugVST3MessageChannel
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifdef OS_WIN
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include "IPlugPlatform.h"
+#include "IPlugQueue.h"
+
+#ifndef VST3_MESSAGE_CHANNEL_SIZE
+  #define VST3_MESSAGE_CHANNEL_SIZE 65536
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Passes messages from a distributed VST3 processor to its controller without allocating an IMessage for each one, when the host has created both components in the same process.
+ * The processor creates a channel, which is registered with an id, and sends the id to the controller in an IMessage. The controller looks the channel up with Find(), which returns nothing
+ * if the processor has been destroyed by the time the IMessage is delivered, or if it comes from another process or binary, since the registry only holds weak references.
+ * The messages are written to an IPlugQueue of bytes as a MessageHeader followed by the data. A message that doesn't fit is dropped, so that the order of the others is kept */
+class IPlugVST3MessageChannel
+{
+public:
+  enum EMessageType
+  {
+    kControlValue,
+    kControlMsg,
+    kMidiMsg,
+    kSysEx
+  };
+
+  struct MessageHeader
+  {
+    int32_t type;
+    int32_t ctrlTag;
+    int32_t msgTag;
+    int32_t size;
+    double value;
+  };
+
+  /** @param capacity The size of the queue in bytes */
+  IPlugVST3MessageChannel(int capacity = VST3_MESSAGE_CHANNEL_SIZE)
+  : mQueue(capacity)
+  {
+    mStaging.Resize(capacity);
+    mPopBuffer.Resize(capacity);
+  }
+
+  ~IPlugVST3MessageChannel()
+  {
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    GetRegistry().erase(mID);
+  }
+
+  IPlugVST3MessageChannel(const IPlugVST3MessageChannel&) = delete;
+  IPlugVST3MessageChannel& operator=(const IPlugVST3MessageChannel&) = delete;
+
+  /** Create a channel and register it, so that the controller can find it with its id
+   * @return The new channel */
+  static std::shared_ptr<IPlugVST3MessageChannel> Create()
+  {
+    static std::atomic<int64_t> sNextID {1};
+
+    auto channel = std::make_shared<IPlugVST3MessageChannel>();
+    channel->mID = sNextID.fetch_add(1);
+
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    GetRegistry()[channel->mID] = channel;
+    return channel;
+  }
+
+  /** Find a channel that was created with Create()
+   * @param processToken The GetProcessToken() of the processor
+   * @param moduleToken The GetModuleToken() of the processor
+   * @param id The GetID() of the channel
+   * @return The channel, or nullptr if it has been destroyed or was created in another process or binary */
+  static std::shared_ptr<IPlugVST3MessageChannel> Find(int64_t processToken, int64_t moduleToken, int64_t id)
+  {
+    if (processToken != GetProcessToken() || moduleToken != GetModuleToken())
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(GetRegistryMutex());
+    auto it = GetRegistry().find(id);
+    return it != GetRegistry().end() ? it->second.lock() : nullptr;
+  }
+
+  /** @return The id that identifies the channel to Find() */
+  int64_t GetID() const { return mID; }
+
+  /** Called by the processor when it is destroyed, after which the controller should stop reading the channel */
+  void Close() { mOpen.store(false, std::memory_order_release); }
+
+  /** @return \c false if the processor has been destroyed */
+  bool IsOpen() const { return mOpen.load(std::memory_order_acquire); }
+
+  /** Write a message to the queue, call this on the producer thread
+   * @return \c true on success, \c false if there isn't enough space, in which case the message is dropped */
+  bool Push(int type, int ctrlTag, int msgTag, double value, const void* pData = nullptr, int dataSize = 0)
+  {
+    const size_t messageSize = sizeof(MessageHeader) + dataSize;
+
+    if (mQueue.SpaceAvailable() < messageSize)
+    {
+      mNumDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    const MessageHeader header {type, ctrlTag, msgTag, dataSize, value};
+    memcpy(mStaging.Get(), &header, sizeof(MessageHeader));
+
+    if (dataSize)
+      memcpy(mStaging.Get() + sizeof(MessageHeader), pData, dataSize);
+
+    // pushed in one go, so that the consumer never sees part of a message
+    mQueue.PushN(mStaging.Get(), messageSize);
+    return true;
+  }
+
+  /** Read the next message from the queue, call this on the consumer thread
+   * @param func A function taking (const MessageHeader& header, const void* pData), called with the message. The data is only valid during the call
+   * @return \c true if there was a message */
+  template <class Func>
+  bool Pop(Func&& func)
+  {
+    if (mQueue.ElementsAvailable() < sizeof(MessageHeader))
+      return false;
+
+    MessageHeader header;
+    mQueue.PopN(reinterpret_cast<uint8_t*>(&header), sizeof(MessageHeader));
+    mQueue.PopN(mPopBuffer.Get(), header.size);
+    func(static_cast<const MessageHeader&>(header), static_cast<const void*>(mPopBuffer.Get()));
+    return true;
+  }
+
+  /** @return The number of messages that have been dropped because the queue was full */
+  int GetNumDropped() const { return mNumDropped.load(std::memory_order_relaxed); }
+
+  /** @return A value identifying this process, used to check that the processor and controller are co-located */
+  static int64_t GetProcessToken()
+  {
+  #ifdef OS_WIN
+    return static_cast<int64_t>(GetCurrentProcessId());
+  #else
+    return static_cast<int64_t>(getpid());
+  #endif
+  }
+
+  /** @return A value identifying this binary in this process, used to check that the processor and controller are co-located */
+  static int64_t GetModuleToken()
+  {
+    static const char token = 0;
+    return static_cast<int64_t>(reinterpret_cast<intptr_t>(&token));
+  }
+
+private:
+  using Registry = std::map<int64_t, std::weak_ptr<IPlugVST3MessageChannel>>;
+
+  static Registry& GetRegistry()
+  {
+    static Registry sRegistry;
+    return sRegistry;
+  }
+
+  static std::mutex& GetRegistryMutex()
+  {
+    static std::mutex sMutex;
+    return sMutex;
+  }
+
+  IPlugQueue<uint8_t> mQueue;
+  WDL_TypedBuf<uint8_t> mStaging; // producer only, the message being pushed
+  WDL_TypedBuf<uint8_t> mPopBuffer; // consumer only, the data of the message being popped
+  int64_t mID = 0;
+  std::atomic<bool> mOpen {true};
+  std::atomic<int> mNumDropped {0};
+};
+
+END_IPLUG_NAMESPACE
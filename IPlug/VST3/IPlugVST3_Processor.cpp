@@ -24,7 +24,12 @@ IPlugVST3Processor::IPlugVST3Processor(const InstanceInfo& info, const Config& c
   CreateTimer();
 }
 
-IPlugVST3Processor::~IPlugVST3Processor() {}
+IPlugVST3Processor::~IPlugVST3Processor()
+{
+  // the controller may still hold the channel, this tells it to let go
+  if (mMessageChannel)
+    mMessageChannel->Close();
+}
 
 #pragma mark AudioEffect overrides
 
@@ -110,6 +115,9 @@ tresult PLUGIN_API IPlugVST3Processor::getState(IBStream* pState)
 
 void IPlugVST3Processor::SendControlValueFromDelegate(int ctrlTag, double normalizedValue)
 {
+  if (PushToMessageChannel(IPlugVST3MessageChannel::kControlValue, ctrlTag, kNoTag, normalizedValue))
+    return;
+  
   OPtr<IMessage> message = allocateMessage();
   
   if (!message)
@@ -124,6 +132,9 @@ void IPlugVST3Processor::SendControlValueFromDelegate(int ctrlTag, double normal
 
 void IPlugVST3Processor::SendControlMsgFromDelegate(int ctrlTag, int msgTag, int dataSize, const void* pData)
 {
+  if (PushToMessageChannel(IPlugVST3MessageChannel::kControlMsg, ctrlTag, msgTag, 0., pData, dataSize))
+    return;
+  
   OPtr<IMessage> message = allocateMessage();
   
   if (!message)
@@ -159,6 +170,37 @@ void IPlugVST3Processor::SendArbitraryMsgFromDelegate(int msgTag, int dataSize,
 
 #pragma mark IConnectionPoint override
 
+tresult PLUGIN_API IPlugVST3Processor::connect(IConnectionPoint* other)
+{
+  tresult result = AudioEffect::connect(other);
+  
+  if (result != kResultTrue)
+    return result;
+  
+  // offer the controller a shared channel for the messages to it. If it is in the same process it finds the channel by its id, replies with "SMRC" and the channel is used from then on
+  if (!mMessageChannel)
+    mMessageChannel = IPlugVST3MessageChannel::Create();
+  
+  OPtr<IMessage> message = allocateMessage();
+  
+  if (message)
+  {
+    message->setMessageID("SMRFP");
+    message->getAttributes()->setInt("PT", IPlugVST3MessageChannel::GetProcessToken());
+    message->getAttributes()->setInt("MT", IPlugVST3MessageChannel::GetModuleToken());
+    message->getAttributes()->setInt("ID", mMessageChannel->GetID());
+    sendMessage(message);
+  }
+  
+  return result;
+}
+
+tresult PLUGIN_API IPlugVST3Processor::disconnect(IConnectionPoint* other)
+{
+  mMessageChannelConnected.store(false, std::memory_order_release);
+  return AudioEffect::disconnect(other);
+}
+
 tresult PLUGIN_API IPlugVST3Processor::notify(IMessage* message)
 {
   if (!message)
@@ -167,6 +209,11 @@ tresult PLUGIN_API IPlugVST3Processor::notify(IMessage* message)
   const void* data = nullptr;
   uint32 size;
   
+  if (!strcmp(message->getMessageID(), "SMRC")) // the controller is using the shared channel
+  {
+    mMessageChannelConnected.store(true, std::memory_order_release);
+    return kResultOk;
+  }
   if (!strcmp(message->getMessageID(), "SMMFUI")) // midi message from UI
   {
     if (message->getAttributes()->getBinary("D", data, size) == kResultOk)
@@ -175,7 +222,7 @@ tresult PLUGIN_API IPlugVST3Processor::notify(IMessage* message)
       {
         IMidiMsg msg;
         memcpy(&msg, data, size);
-        mMidiMsgsFromEditor.Push(msg);
+        DeferMidiMsg(msg); // timestamped on arrival, the controller's clock may not be shared
         return kResultOk;
       }
       
@@ -220,6 +267,9 @@ tresult PLUGIN_API IPlugVST3Processor::notify(IMessage* message)
 
 void IPlugVST3Processor::TransmitMidiMsgFromProcessor(const IMidiMsg& msg)
 {
+  if (PushToMessageChannel(IPlugVST3MessageChannel::kMidiMsg, kNoTag, kNoTag, 0., &msg, sizeof(IMidiMsg)))
+    return;
+  
   OPtr<IMessage> message = allocateMessage();
   
   if (!message)
@@ -232,6 +282,9 @@ void IPlugVST3Processor::TransmitMidiMsgFromProcessor(const IMidiMsg& msg)
 
 void IPlugVST3Processor::TransmitSysExDataFromProcessor(const SysExData& data)
 {
+  if (PushToMessageChannel(IPlugVST3MessageChannel::kSysEx, kNoTag, data.mOffset, 0., data.mData, data.mSize))
+    return;
+  
   OPtr<IMessage> message = allocateMessage();
   
   if (!message)
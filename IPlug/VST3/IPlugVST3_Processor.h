@@ -21,6 +21,10 @@
 
 #include "IPlugVST3_ProcessorBase.h"
 #include "IPlugVST3_Common.h"
+#include "IPlugVST3_MessageChannel.h"
+
+#include <atomic>
+#include <memory>
 
 /**
  * @file
@@ -53,7 +57,7 @@ public:
   Steinberg::tresult PLUGIN_API setProcessing (Steinberg::TBool state) override;
   Steinberg::tresult PLUGIN_API process(Steinberg::Vst::ProcessData& data) override;
   Steinberg::tresult PLUGIN_API canProcessSampleSize(Steinberg::int32 symbolicSampleSize) override;
-  Steinberg::uint32 PLUGIN_API getLatencySamples() override { return GetLatency(); }
+  Steinberg::uint32 PLUGIN_API getLatencySamples() override { return GetReportedLatency(); }
   Steinberg::uint32 PLUGIN_API getTailSamples() override { return GetTailSize(); } //TODO - infinite tail
   Steinberg::tresult PLUGIN_API setState(Steinberg::IBStream* pState) override;
   Steinberg::tresult PLUGIN_API getState(Steinberg::IBStream* pState) override;
@@ -79,10 +83,26 @@ private:
   void TransmitSysExDataFromProcessor(const SysExData& data) override;
 
   // IConnectionPoint
+  Steinberg::tresult PLUGIN_API connect(Steinberg::Vst::IConnectionPoint* other) override;
+  Steinberg::tresult PLUGIN_API disconnect(Steinberg::Vst::IConnectionPoint* other) override;
   Steinberg::tresult PLUGIN_API notify(Steinberg::Vst::IMessage* message) override;
   
+  /** If the controller is in the same process, pass a message to it via the shared channel instead of an IMessage.
+   * Once the controller is using the channel, a message that doesn't fit is dropped rather than sent as an IMessage, which could overtake the queued ones
+   * @return \c true if the message was handled by the channel */
+  bool PushToMessageChannel(int type, int ctrlTag, int msgTag, double value, const void* pData = nullptr, int dataSize = 0)
+  {
+    if (!mMessageChannelConnected.load(std::memory_order_acquire))
+      return false;
+
+    mMessageChannel->Push(type, ctrlTag, msgTag, value, pData, dataSize);
+    return true;
+  }
+  
+  std::shared_ptr<IPlugVST3MessageChannel> mMessageChannel;
+  std::atomic<bool> mMessageChannelConnected {false};
+  
 //  Steinberg::Vst::ParameterChanges mOutputParamChanges;
-  IMidiQueue mMidiOutputQueue;
 };
 
 Steinberg::FUnknown* MakeProcessor();
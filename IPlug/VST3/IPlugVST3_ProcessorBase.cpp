@@ -13,6 +13,7 @@
 #include "pluginterfaces/vst/ivstmidicontrollers.h"
 #include "public.sdk/source/vst/vsteventshelper.h"
 #include "IPlugVST3_ProcessorBase.h"
+#include "IPlugRealtimeCheck.h"
 
 using namespace iplug;
 using namespace Steinberg;
@@ -60,17 +61,31 @@ IPlugVST3ProcessorBase::IPlugVST3ProcessorBase(Config c, IPlugAPIBase& plug)
   if (MaxNChannels(ERoute::kInput))
   {
     mLatencyDelay = std::unique_ptr<NChanDelayLine<PLUG_SAMPLE_DST>>(new NChanDelayLine<PLUG_SAMPLE_DST>(MaxNChannels(ERoute::kInput), MaxNChannels(ERoute::kOutput)));
-    mLatencyDelay->SetDelayTime(GetLatency());
+    mLatencyDelay->SetDelayTime(GetReportedLatency());
   }
   
   // Make sure the process context is predictably initialised in case it is used before process is called
   memset(&mProcessContext, 0, sizeof(ProcessContext));
 }
 
-void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* pEventList, IPlugQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue)
+void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* pEventList, IPlugMPSCQueue<ITimedMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue, int32 numSamples)
 {
   IMidiMsg msg;
-    
+  // messages for the UI are collected and pushed in batches, to publish them to the UI thread once rather than for each event
+  static constexpr int kMaxBatch = 64;
+  IMidiMsg toProcessorQueue[kMaxBatch];
+  int nToProcessorQueue = 0;
+
+  auto addToProcessorQueue = [&](const IMidiMsg& midiMsg) {
+    toProcessorQueue[nToProcessorQueue++] = midiMsg;
+
+    if (nToProcessorQueue == kMaxBatch)
+    {
+      processorQueue.PushN(toProcessorQueue, nToProcessorQueue);
+      nToProcessorQueue = 0;
+    }
+  };
+
   if (pEventList)
   {
     int32 numEvent = pEventList->getEventCount();
@@ -84,23 +99,23 @@ void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* pEventList, IPlugQueue<IM
           case Event::kNoteOnEvent:
           {
             msg.MakeNoteOnMsg(event.noteOn.pitch, event.noteOn.velocity * 127, event.sampleOffset, event.noteOn.channel);
-            ProcessMidiMsg(msg);
-            processorQueue.Push(msg);
+            HandleMidiMsg(msg);
+            addToProcessorQueue(msg);
             break;
           }
             
           case Event::kNoteOffEvent:
           {
             msg.MakeNoteOffMsg(event.noteOff.pitch, event.sampleOffset, event.noteOff.channel);
-            ProcessMidiMsg(msg);
-            processorQueue.Push(msg);
+            HandleMidiMsg(msg);
+            addToProcessorQueue(msg);
             break;
           }
           case Event::kPolyPressureEvent:
           {
             msg.MakePolyATMsg(event.polyPressure.pitch, event.polyPressure.pressure * 127., event.sampleOffset, event.polyPressure.channel);
-            ProcessMidiMsg(msg);
-            processorQueue.Push(msg);
+            HandleMidiMsg(msg);
+            addToProcessorQueue(msg);
             break;
           }
           case Event::kDataEvent:
@@ -114,13 +129,19 @@ void IPlugVST3ProcessorBase::ProcessMidiIn(IEventList* pEventList, IPlugQueue<IM
     }
   }
   
-  while (editorQueue.Pop(msg))
-  {
-    ProcessMidiMsg(msg);
-  }
+  if (nToProcessorQueue)
+    processorQueue.PushN(toProcessorQueue, nToProcessorQueue);
+
+  mMidiClockFromEditor.BeginBlock(numSamples, GetSampleRate());
+
+  editorQueue.ConsumeAll([this](const ITimedMidiMsg& timedMsg) {
+    IMidiMsg midiMsg = timedMsg.msg;
+    midiMsg.mOffset = mMidiClockFromEditor.GetOffset(timedMsg.time);
+    HandleMidiMsg(midiMsg);
+  });
 }
 
-void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, SysExData& sysExBuf, IEventList* pOutputEvents, int32 numSamples)
+void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugMPSCQueue<SysExData>& sysExQueue, SysExData& sysExBuf, IEventList* pOutputEvents, int32 numSamples)
 {
   if (!mMidiOutputQueue.Empty() && pOutputEvents)
   {
@@ -129,7 +150,7 @@ void IPlugVST3ProcessorBase::ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, S
     
     while (!mMidiOutputQueue.Empty())
     {
-      IMidiMsg& msg = mMidiOutputQueue.Peek();
+      const IMidiMsg& msg = mMidiOutputQueue.Peek();
 
       if (msg.StatusMsg() == IMidiMsg::kNoteOn)
       {
@@ -226,7 +247,7 @@ bool IPlugVST3ProcessorBase::SetupProcessing(const ProcessSetup& setup, ProcessS
   
   SetSampleRate(setup.sampleRate);
   IPlugProcessor::SetBlockSize(setup.maxSamplesPerBlock); // TODO: should IPlugVST3Processor call SetBlockSize in construct unlike other APIs?
-  mMidiOutputQueue.Resize(setup.maxSamplesPerBlock);
+  InitParamBuffers(mPlug.GetParams());
   OnReset();
     
   return true;
@@ -242,10 +263,13 @@ bool IPlugVST3ProcessorBase::SetProcessing(bool state)
 
 bool IPlugVST3ProcessorBase::CanProcessSampleSize(int32 symbolicSampleSize)
 {
+  // 32 bit is mandatory in VST3. Single precision builds decline 64 bit, so that the host doesn't request buffers that would need converting
   switch (symbolicSampleSize)
   {
-    case kSample32:   // fall through
+    case kSample32:   return true;
+#ifdef SAMPLE_TYPE_DOUBLE
     case kSample64:   return true;
+#endif
     default:          return false;
   }
 }
@@ -275,6 +299,8 @@ void IPlugVST3ProcessorBase::PrepareProcessContext(ProcessData& data, ProcessSet
 
 void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQueue<IMidiMsg>& fromProcessor)
 {
+  mPlug.ApplyDeferredParamReset(); // before the host's changes in this block, which are newer
+  
   IParameterChanges* paramChanges = data.inputParameterChanges;
   
   if (paramChanges)
@@ -289,10 +315,18 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
         int32 numPoints = paramQueue->getPointCount();
         int32 offsetSamples;
         double value;
+        int idx = paramQueue->getParameterId();
+        
+        // by default, or for bypass, only the last point in the queue is used. Audio-rate parameters follow every point, see IPlugProcessor::GetParamBuffer()
+        const bool sampleAccurate = GetSampleAccurateAutomation() && idx != kBypassParam;
+        const bool buffered = HasParamBuffer(idx);
+        const bool allPoints = sampleAccurate || buffered;
+        int32 prevOffsetSamples = 0;
         
-        if (paramQueue->getPoint(numPoints - 1,  offsetSamples, value) == kResultTrue)
+        for (int32 pointIdx = allPoints ? 0 : numPoints - 1; pointIdx < numPoints; pointIdx++)
         {
-          int idx = paramQueue->getParameterId();
+          if (paramQueue->getPoint(pointIdx, offsetSamples, value) != kResultTrue)
+            continue;
           
           switch (idx)
           {
@@ -309,16 +343,17 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
             {
               if (idx >= 0 && idx < mPlug.NParams())
               {
-#ifdef PARAMS_MUTEX
-                mPlug.mParams_mutex.Enter();
-#endif
-                mPlug.GetParam(idx)->SetNormalized(value);
-              
-                // In VST3 non distributed the same parameter value is also set via IPlugVST3Controller::setParamNormalized(ParamID tag, ParamValue value)
-                mPlug.OnParamChange(idx, kHost, offsetSamples);
-#ifdef PARAMS_MUTEX
-                mPlug.mParams_mutex.Leave();
-#endif
+                if (buffered)
+                {
+                  // VST3 automation is linear between points, starting from the value at the end of the previous block
+                  AddParamRamp(ParamRamp(idx, value, prevOffsetSamples, offsetSamples - prevOffsetSamples));
+                  prevOffsetSamples = offsetSamples;
+                }
+
+                if (sampleAccurate)
+                  AddParamChange(ParamChange(idx, value, offsetSamples)); // applied by IPlugProcessor at offsetSamples
+                else if (pointIdx == numPoints - 1)
+                  ApplyParamChange(ParamChange(idx, value, offsetSamples));
               }
               else if (idx >= kMIDICCParamStartIdx)
               {
@@ -336,7 +371,7 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
                   msg.MakeControlChangeMsg((IMidiMsg::EControlChangeMsg) ctrlr, value, channel, offsetSamples);
 
                 fromProcessor.Push(msg);
-                ProcessMidiMsg(msg);
+                HandleMidiMsg(msg);
               }
             }
               break;
@@ -347,6 +382,20 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
   }
 }
 
+void IPlugVST3ProcessorBase::ApplyParamChange(const ParamChange& change)
+{
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Enter();
+#endif
+  mPlug.GetParam(change.idx)->SetNormalized(change.normalizedValue);
+  
+  // In VST3 non distributed the same parameter value is also set via IPlugVST3Controller::setParamNormalized(ParamID tag, ParamValue value)
+  mPlug.OnParamChange(change.idx, kHost, change.offset);
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Leave();
+#endif
+}
+
 void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs)
 {
   int32 sampleSize = setup.symbolicSampleSize;
@@ -398,6 +447,24 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
       chanOffset += busChannels;
     }
     
+    auto AllChannelsMask = [](int nChans) { return nChans < 64 ? (((uint64) 1 << nChans) - 1) : ~((uint64) 0); };
+    
+    if (GetSkipProcessingOnSilence())
+    {
+      bool inputIsSilent = true;
+      
+      for (int inBus = 0; inBus < data.numInputs; inBus++)
+      {
+        const uint64 allChannels = AllChannelsMask(data.inputs[inBus].numChannels);
+        
+        // an inactive sidechain bus is not attached, so its flags don't matter
+        if ((inBus == 0 || mSidechainActive) && (data.inputs[inBus].silenceFlags & allChannels) != allChannels)
+          inputIsSilent = false;
+      }
+      
+      SetHostInputIsSilent(inputIsSilent);
+    }
+    
     if (GetBypassed())
     {
       if (sampleSize == kSample32)
@@ -418,17 +485,26 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
       mPlug.mParams_mutex.Leave();
 #endif
     }
+    
+    for (int outBus = 0; outBus < data.numOutputs; outBus++)
+    {
+      data.outputs[outBus].silenceFlags = GetOutputIsSilent() ? AllChannelsMask(data.outputs[outBus].numChannels) : 0;
+    }
   }
+  
+  // if no audio was processed, scheduled parameter changes and MIDI are delivered at the end of the block
+  FlushScheduledEvents();
 }
 
-void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf)
+void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugMPSCQueue<ITimedMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugMPSCQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf)
 {
+  IPLUG_MARK_REALTIME_THREAD();
   PrepareProcessContext(data, setup);
   ProcessParameterChanges(data, fromProcessor);
   
   if (DoesMIDIIn())
   {
-    ProcessMidiIn(data.inputEvents, fromEditor, fromProcessor);
+    ProcessMidiIn(data.inputEvents, fromEditor, fromProcessor, data.numSamples);
   }
   
   ProcessAudio(data, setup, ins, outs);
@@ -441,6 +517,5 @@ void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, con
 
 bool IPlugVST3ProcessorBase::SendMidiMsg(const IMidiMsg& msg)
 {
-  mMidiOutputQueue.Add(msg);
-  return true;
+  return mMidiOutputQueue.Add(msg);
 }
@@ -98,8 +98,8 @@ public:
   }
   
   // MIDI Processing
-  void ProcessMidiIn(Steinberg::Vst::IEventList* pEventList, IPlugQueue<IMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue);
-  void ProcessMidiOut(IPlugQueue<SysExData>& sysExQueue, SysExData& sysExBuf, Steinberg::Vst::IEventList* pOutputEvents, Steinberg::int32 numSamples);
+  void ProcessMidiIn(Steinberg::Vst::IEventList* pEventList, IPlugMPSCQueue<ITimedMidiMsg>& editorQueue, IPlugQueue<IMidiMsg>& processorQueue, Steinberg::int32 numSamples);
+  void ProcessMidiOut(IPlugMPSCQueue<SysExData>& sysExQueue, SysExData& sysExBuf, Steinberg::Vst::IEventList* pOutputEvents, Steinberg::int32 numSamples);
   
   // Audio Processing Setup
   template <class T>
@@ -186,17 +186,19 @@ public:
   void PrepareProcessContext(Steinberg::Vst::ProcessData& data, Steinberg::Vst::ProcessSetup& setup);
   void ProcessParameterChanges(Steinberg::Vst::ProcessData& data, IPlugQueue<IMidiMsg>& fromProcessor);
   void ProcessAudio(Steinberg::Vst::ProcessData& data, Steinberg::Vst::ProcessSetup& setup, const Steinberg::Vst::BusList& ins, const Steinberg::Vst::BusList& outs);
-  void Process(Steinberg::Vst::ProcessData& data, Steinberg::Vst::ProcessSetup& setup, const Steinberg::Vst::BusList& ins, const Steinberg::Vst::BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf);
+  void Process(Steinberg::Vst::ProcessData& data, Steinberg::Vst::ProcessSetup& setup, const Steinberg::Vst::BusList& ins, const Steinberg::Vst::BusList& outs, IPlugMPSCQueue<ITimedMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugMPSCQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf);
   
   // IPlugProcessor overrides
   bool SendMidiMsg(const IMidiMsg& msg) override;
 
 private:
+  void ApplyParamChange(const ParamChange& change) override;
+
   int mMaxNChansForMainInputBus = 0;
   IPlugAPIBase& mPlug;
   Steinberg::Vst::ProcessContext mProcessContext;
-  IMidiQueue mMidiOutputQueue;
   bool mSidechainActive = false;
+  IMidiClock mMidiClockFromEditor;
 };
 
 END_IPLUG_NAMESPACE
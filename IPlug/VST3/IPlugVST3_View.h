@@ -14,11 +14,15 @@
 #include "pluginterfaces/base/keycodes.h"
 
 #include "IPlugStructs.h"
+#include "IPlugTimer.h"
 
-/** IPlug VST3 View  */
+/** IPlug VST3 View. On Linux the view registers the editor's file descriptors with the host's IRunLoop, see IEditorDelegate::GetEditorPollFDs() */
 template <class T>
 class IPlugVST3View : public Steinberg::CPluginView
                     , public Steinberg::IPlugViewContentScaleSupport
+#ifdef OS_LINUX
+                    , public Steinberg::Linux::IEventHandler
+#endif
 {
 public:
   IPlugVST3View(T& owner)
@@ -46,6 +50,9 @@ public:
 #elif defined OS_MAC
       if (strcmp (type, Steinberg::kPlatformTypeNSView) == 0)
         return Steinberg::kResultTrue;
+#elif defined OS_LINUX
+      if (strcmp (type, Steinberg::kPlatformTypeX11EmbedWindowID) == 0)
+        return Steinberg::kResultTrue;
 #endif
     }
     
@@ -118,6 +125,14 @@ public:
         pView = mOwner.OpenWindow(pParent);
       else // Carbon
         return Steinberg::kResultFalse;
+#elif defined OS_LINUX
+      if (strcmp (type, Steinberg::kPlatformTypeX11EmbedWindowID) == 0)
+      {
+        pView = mOwner.OpenWindow(pParent);
+        RegisterEventHandlers();
+      }
+      else
+        return Steinberg::kResultFalse;
 #endif
       return Steinberg::kResultTrue;
     }
@@ -128,7 +143,12 @@ public:
   Steinberg::tresult PLUGIN_API removed() override
   {
     if (mOwner.HasUI())
+    {
+#ifdef OS_LINUX
+      UnregisterEventHandlers();
+#endif
       mOwner.CloseWindow();
+    }
     
     return CPluginView::removed();
   }
@@ -143,6 +163,9 @@ public:
   Steinberg::tresult PLUGIN_API queryInterface(const Steinberg::TUID _iid, void** obj) override
   {
     QUERY_INTERFACE(_iid, obj, IPlugViewContentScaleSupport::iid, IPlugViewContentScaleSupport)
+#ifdef OS_LINUX
+    QUERY_INTERFACE(_iid, obj, Steinberg::Linux::IEventHandler::iid, Steinberg::Linux::IEventHandler)
+#endif
     *obj = 0;
     return CPluginView::queryInterface(_iid, obj);
   }
@@ -286,6 +309,50 @@ public:
     return mOwner.OnKeyUp(translateKeyMessage(key, keyMsg, modifiers)) ? Steinberg::kResultTrue : Steinberg::kResultFalse;
   }
   
+#ifdef OS_LINUX
+  /** Called by the host's run loop on the main thread when one of the editor's file descriptors is readable */
+  void PLUGIN_API onFDIsSet(Steinberg::Linux::FileDescriptor fd) override
+  {
+    if (fd == iplug::Timer_impl::GetPollFD())
+      iplug::Timer_impl::OnPollFD();
+    else
+      mOwner.OnEditorPollFD(fd);
+  }
+
+  void RegisterEventHandlers()
+  {
+    Steinberg::FUnknownPtr<Steinberg::Linux::IRunLoop> runLoop(plugFrame);
+
+    if (!runLoop)
+      return;
+
+    int fds[4];
+    const int nFDs = mOwner.GetEditorPollFDs(fds, 4);
+
+    for (int i = 0; i < nFDs; i++)
+      runLoop->registerEventHandler(this, fds[i]);
+
+    // the IPlug timers, e.g. IPlugAPIBase's, are driven by the host's run loop while the editor is open
+    const int timerFD = iplug::Timer_impl::GetPollFD();
+
+    if (timerFD >= 0)
+      runLoop->registerEventHandler(this, timerFD);
+
+    mRunLoop = runLoop;
+  }
+
+  void UnregisterEventHandlers()
+  {
+    if (mRunLoop)
+    {
+      mRunLoop->unregisterEventHandler(this);
+      mRunLoop = nullptr;
+    }
+  }
+
+  Steinberg::IPtr<Steinberg::Linux::IRunLoop> mRunLoop;
+#endif
+
   DELEGATE_REFCOUNT(Steinberg::CPluginView)
 
   void Resize(int w, int h)
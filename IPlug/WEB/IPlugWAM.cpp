@@ -9,6 +9,7 @@
 */
 
 #include "IPlugWAM.h"
+#include "IPlugRealtimeCheck.h"
 
 using namespace iplug;
 
@@ -51,15 +52,50 @@ const char* IPlugWAM::init(uint32_t bufsize, uint32_t sr, void* pDesc)
 
   //TODO: correct place? - do we need a WAM reset message?
   OnParamReset(kReset);
+  InitParamBuffers(GetParams());
   OnReset();
   postMessage("StartIdleTimer", nullptr, nullptr);
 
+  if (!mSABRingID)
+  {
+    InstallSABRing();
+    mSABRxBuf.Resize(kSABRingSize);
+
+    // IPlugWAM-awp.js leaves the rings the controller made, if any, in a global for the processor being constructed
+    mSABRingID = EM_ASM_INT({
+      var sab = AudioWorkletGlobalScope.IPlugWAMSAB;
+      AudioWorkletGlobalScope.IPlugWAMSAB = undefined;
+      if (sab === undefined)
+        return 0;
+      var id = IPlugSABRing.nextID++;
+      IPlugSABRing.instances[id] = sab;
+      return id;
+    });
+
+    DBGMSG("%s\n", mSABRingID ? "using SharedArrayBuffer rings" : "using postMessage()");
+  }
+
   return json.Get();
 }
 
+void IPlugWAM::terminate()
+{
+  DBGMSG("terminate");
+
+  if (mSABRingID)
+  {
+    EM_ASM({ delete IPlugSABRing.instances[$0]; }, mSABRingID);
+    mSABRingID = 0;
+  }
+}
+
 void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
 {
+  IPLUG_MARK_REALTIME_THREAD();
   const int blockSize = GetBlockSize();
+
+  ApplyDeferredParamReset();
+  ProcessSABMsgs();
   
   SetChannelConnections(ERoute::kInput, 0, MaxNChannels(ERoute::kInput), !IsInstrument()); //TODO: go elsewhere
   SetChannelConnections(ERoute::kOutput, 0, MaxNChannels(ERoute::kOutput), true); //TODO: go elsewhere
@@ -71,14 +107,64 @@ void IPlugWAM::onProcess(WAM::AudioBus* pAudio, void* pData)
   LEAVE_PARAMS_MUTEX
 }
 
+bool IPlugWAM::SendSABMsg()
+{
+  if (!mSABRingID)
+    return false;
+
+  return EM_ASM_INT({
+    return IPlugSABRing.write(IPlugSABRing.instances[$0].dspToUI, HEAPU8, $1, $2);
+  }, mSABRingID, (int) mSABTxBuf.GetData(), mSABTxBuf.Size());
+}
+
+void IPlugWAM::ProcessSABMsgs()
+{
+  if (!mSABRingID)
+    return;
+
+  const int size = EM_ASM_INT({
+    return IPlugSABRing.read(IPlugSABRing.instances[$0].uiToDSP, HEAPU8, $1, $2);
+  }, mSABRingID, (int) mSABRxBuf.GetData(), kSABRingSize);
+
+  ForEachSABMsg(mSABRxBuf.GetData(), size, [this](ESABMsg type, IByteStream& stream, int pos) {
+    switch (type)
+    {
+      case kSABSPVFUI:
+      {
+        int paramIdx;
+        double value;
+        pos = stream.Get(&paramIdx, pos);
+        stream.Get(&value, pos);
+        SetParameterValue(paramIdx, value);
+        break;
+      }
+      case kSABSMMFUI:
+      {
+        IMidiMsg msg;
+        pos = stream.Get(&msg.mStatus, pos);
+        pos = stream.Get(&msg.mData1, pos);
+        stream.Get(&msg.mData2, pos);
+        ProcessMidiMsg(msg); // TODO: should queue to mMidiMsgsFromEditor?
+        break;
+      }
+      case kSABSAMFUI:
+      {
+        int msgTag, ctrlTag, dataSize;
+        pos = stream.Get(&msgTag, pos);
+        pos = stream.Get(&ctrlTag, pos);
+        pos = stream.Get(&dataSize, pos);
+        OnMessage(msgTag, ctrlTag, dataSize, stream.GetData() + pos);
+        break;
+      }
+      default:
+        break;
+    }
+  });
+}
+
 void IPlugWAM::OnEditorIdleTick()
 {
-  while(mParamChangeFromProcessor.ElementsAvailable())
-  {
-    ParamTuple p;
-    mParamChangeFromProcessor.Pop(p);
-    SendParameterValueFromDelegate(p.idx, p.value, false);
-  }
+  SendParameterValuesFromProcessorToEditor();
 
   while (mMidiMsgsFromProcessor.ElementsAvailable())
   {
@@ -162,10 +248,22 @@ void IPlugWAM::onMidi(byte status, byte data1, byte data2)
   ProcessMidiMsg(msg); // onMidi is not called on HPT. We could queue things up, but just process the message straightaway for now
   //mMidiMsgsFromProcessor.Push(msg);
   
+  if (mSABRingID)
+  {
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSMMFD);
+    mSABTxBuf.Put(&msg.mStatus);
+    mSABTxBuf.Put(&msg.mData1);
+    mSABTxBuf.Put(&msg.mData2);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String dataStr;
   dataStr.SetFormatted(16, "%i:%i:%i", msg.mStatus, msg.mData1, msg.mData2);
   
-  // TODO: in the future this will be done via shared array buffer
   // if onMidi ever gets called on HPT, should defer via queue
   postMessage("SMMFD", dataStr.Get(), "");
 }
@@ -181,52 +279,117 @@ void IPlugWAM::onSysex(byte* pData, uint32_t size)
   ISysEx sysex = {0 /* no offset */, pData, (int) size };
   ProcessSysEx(sysex);
   
+  if (mSABRingID)
+  {
+    const int dataSize = static_cast<int>(size);
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSSMFD);
+    mSABTxBuf.Put(&dataSize);
+    mSABTxBuf.PutBytes(pData, dataSize);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String dataStr;
   dataStr.SetFormatted(16, "%i", size);
   
-  // TODO: in the future this will be done via shared array buffer
   // if onSysex ever gets called on HPT, should defer via queue
   postMessage("SSMFD", dataStr.Get(), "");
 }
 
 void IPlugWAM::SendControlValueFromDelegate(int ctrlTag, double normalizedValue)
 {
+  if (mSABRingID)
+  {
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSCVFD);
+    mSABTxBuf.Put(&ctrlTag);
+    mSABTxBuf.Put(&normalizedValue);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String propStr;
   WDL_String dataStr;
 
   propStr.SetFormatted(16, "%i", ctrlTag);
   dataStr.SetFormatted(16, "%f", normalizedValue);
 
-  // TODO: in the future this will be done via shared array buffer
+  // without cross-origin isolation, or if the ring is full
   postMessage("SCVFD", propStr.Get(), dataStr.Get());
 }
 
 void IPlugWAM::SendControlMsgFromDelegate(int ctrlTag, int msgTag, int dataSize, const void* pData)
 {
+  if (mSABRingID)
+  {
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSCMFD);
+    mSABTxBuf.Put(&ctrlTag);
+    mSABTxBuf.Put(&msgTag);
+    mSABTxBuf.Put(&dataSize);
+    mSABTxBuf.PutBytes(pData, dataSize);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String propStr;
   propStr.SetFormatted(16, "%i:%i", ctrlTag, msgTag);
   
-  // TODO: in the future this will be done via shared array buffer
+  // without cross-origin isolation, or if the ring is full
   postMessage("SCMFD", propStr.Get(), pData, (uint32_t) dataSize);
 }
 
 void IPlugWAM::SendParameterValueFromDelegate(int paramIdx, double value, bool normalized)
 {
+  if (mSABRingID)
+  {
+    const int isNormalized = normalized;
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSPVFD);
+    mSABTxBuf.Put(&paramIdx);
+    mSABTxBuf.Put(&value);
+    mSABTxBuf.Put(&isNormalized);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String propStr;
   WDL_String dataStr;
   propStr.SetFormatted(16, "%i", paramIdx);
   dataStr.SetFormatted(16, "%f", value);
 
-  // TODO: in the future this will be done via shared array buffer
+  // without cross-origin isolation, or if the ring is full
   postMessage("SPVFD", propStr.Get(), dataStr.Get());
 }
 
 void IPlugWAM::SendArbitraryMsgFromDelegate(int msgTag, int dataSize, const void* pData)
 {
+  if (mSABRingID)
+  {
+    mSABTxBuf.Clear();
+    const int start = BeginSABMsg(mSABTxBuf, kSABSAMFD);
+    mSABTxBuf.Put(&msgTag);
+    mSABTxBuf.Put(&dataSize);
+    mSABTxBuf.PutBytes(pData, dataSize);
+    EndSABMsg(mSABTxBuf, start);
+
+    if (SendSABMsg())
+      return;
+  }
+
   WDL_String propStr;
   propStr.SetFormatted(16, "%i", msgTag);
   
-  // TODO: in the future this will be done via shared array buffer
+  // without cross-origin isolation, or if the ring is full
   postMessage("SAMFD", propStr.Get(), pData, (uint32_t) dataSize);
 }
 
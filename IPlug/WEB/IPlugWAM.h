@@ -14,6 +14,7 @@
 #include "IPlugAPIBase.h"
 #include "IPlugProcessor.h"
 #include "processor.h"
+#include "IPlugWebSABRing.h"
 
 using namespace WAM;
 
@@ -34,7 +35,7 @@ public:
 
   //WAM
   const char* init(uint32_t bufsize, uint32_t sr, void* pDesc) override;
-  void terminate() override { DBGMSG("terminate"); }
+  void terminate() override;
   void resize(uint32_t bufsize) override { DBGMSG("resize"); }
 
   void onProcess(WAM::AudioBus* pAudio, void* pData) override;
@@ -59,6 +60,17 @@ public:
 private:
   /** Called repeatedly to emulate IPlugAPIBase::OnTimer() */
   void OnEditorIdleTick();
+
+  /** Write the message in mSABTxBuf to the ring to the editor
+   * @return \c false if there is no ring, or not enough space in it, in which case the message should be sent with postMessage() */
+  bool SendSABMsg();
+
+  /** Read the messages from the editor's ring and handle them like the postMessage() ones */
+  void ProcessSABMsgs();
+
+  int mSABRingID = 0; // the rings' ID in IPlugSABRing.instances, or 0 if the page isn't cross-origin isolated
+  IByteChunk mSABTxBuf;
+  IByteChunk mSABRxBuf;
 };
 
 IPlugWAM* MakePlug(const InstanceInfo& info);
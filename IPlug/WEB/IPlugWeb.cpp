@@ -33,6 +33,12 @@ IPlugWeb::IPlugWeb(const InstanceInfo& info, const Config& config)
   mSAMFUIBuf.Resize(kNumSAMFUIBytes); memcpy(mSAMFUIBuf.GetData(), "SAMFUI", kNumMsgHeaderBytes);
 
   mWAMCtrlrJSObjectName.SetFormatted(32, "%s_WAM", GetPluginName());
+
+#if !WEBSOCKET_CLIENT
+  // the controller creates the rings with IPlugSABRing.create(), if the page is cross-origin isolated
+  InstallSABRing();
+  mSABRxBuf.Resize(kSABRingSize);
+#endif
 }
 
 void IPlugWeb::SendParameterValueFromUI(int paramIdx, double value)
@@ -48,7 +54,14 @@ void IPlugWeb::SendParameterValueFromUI(int paramIdx, double value)
   }, (int) mSPVFUIBuf.GetData(), kNumSPVFUIBytes);
 
 #else
-  val::global(mWAMCtrlrJSObjectName.Get()).call<void>("setParam", paramIdx, value);
+  mSABTxBuf.Clear();
+  const int start = BeginSABMsg(mSABTxBuf, kSABSPVFUI);
+  mSABTxBuf.Put(&paramIdx);
+  mSABTxBuf.Put(&value);
+  EndSABMsg(mSABTxBuf, start);
+
+  if (!SendSABMsg())
+    val::global(mWAMCtrlrJSObjectName.Get()).call<void>("setParam", paramIdx, value);
 #endif
   IPlugAPIBase::SendParameterValueFromUI(paramIdx, value); // call super class in order to make sure OnParamChangeUI() gets triggered
 };
@@ -67,6 +80,16 @@ void IPlugWeb::SendMidiMsgFromUI(const IMidiMsg& msg)
   }, (int) mSMMFUIBuf.GetData(), kNumSMMFUIBytes);
 
 #else
+  mSABTxBuf.Clear();
+  const int start = BeginSABMsg(mSABTxBuf, kSABSMMFUI);
+  mSABTxBuf.Put(&msg.mStatus);
+  mSABTxBuf.Put(&msg.mData1);
+  mSABTxBuf.Put(&msg.mData2);
+  EndSABMsg(mSABTxBuf, start);
+
+  if (SendSABMsg())
+    return;
+
   WDL_String dataStr;
   dataStr.SetFormatted(16, "%i:%i:%i", msg.mStatus, msg.mData1, msg.mData2);
   val::global(mWAMCtrlrJSObjectName.Get()).call<void>("sendMessage", std::string("SMMFUI"), std::string(dataStr.Get()));
@@ -117,6 +140,14 @@ void IPlugWeb::SendArbitraryMsgFromUI(int msgTag, int ctrlTag, int dataSize, con
     ws.send(jsbuff);
   }, (int) mSAMFUIBuf.GetData(), mSAMFUIBuf.Size());
 #else
+  mSABTxBuf.Clear();
+  const int start = BeginSABMsg(mSABTxBuf, kSABSAMFUI);
+  mSABTxBuf.PutBytes(mSAMFUIBuf.GetData() + kNumMsgHeaderBytes, mSAMFUIBuf.Size() - kNumMsgHeaderBytes); // msgTag, ctrlTag, dataSize, data
+  EndSABMsg(mSABTxBuf, start);
+
+  if (SendSABMsg())
+    return;
+
   EM_ASM({
     if(typeof window[Module.UTF8ToString($0)] === 'undefined' ) {
       console.log("warning - SAMFUI called before controller exists");
@@ -140,6 +171,89 @@ void IPlugWeb::SendDSPIdleTick()
   }, mWAMCtrlrJSObjectName.Get());
 }
 
+bool IPlugWeb::SendSABMsg()
+{
+  return EM_ASM_INT({
+    var ctrlr = window[Module.UTF8ToString($0)];
+    if (ctrlr === undefined || ctrlr.sab === undefined)
+      return 0;
+    return IPlugSABRing.write(ctrlr.sab.uiToDSP, Module.HEAPU8, $1, $2);
+  }, mWAMCtrlrJSObjectName.Get(), (int) mSABTxBuf.GetData(), mSABTxBuf.Size());
+}
+
+void IPlugWeb::ProcessSABMsgs()
+{
+#if !WEBSOCKET_CLIENT
+  const int size = EM_ASM_INT({
+    var ctrlr = window[Module.UTF8ToString($0)];
+    if (ctrlr === undefined || ctrlr.sab === undefined)
+      return 0;
+    return IPlugSABRing.read(ctrlr.sab.dspToUI, Module.HEAPU8, $1, $2);
+  }, mWAMCtrlrJSObjectName.Get(), (int) mSABRxBuf.GetData(), kSABRingSize);
+
+  ForEachSABMsg(mSABRxBuf.GetData(), size, [this](ESABMsg type, IByteStream& stream, int pos) {
+    switch (type)
+    {
+      case kSABSPVFD:
+      {
+        int paramIdx, normalized;
+        double value;
+        pos = stream.Get(&paramIdx, pos);
+        pos = stream.Get(&value, pos);
+        stream.Get(&normalized, pos);
+        SendParameterValueFromDelegate(paramIdx, value, normalized);
+        break;
+      }
+      case kSABSCVFD:
+      {
+        int ctrlTag;
+        double value;
+        pos = stream.Get(&ctrlTag, pos);
+        stream.Get(&value, pos);
+        SendControlValueFromDelegate(ctrlTag, value);
+        break;
+      }
+      case kSABSCMFD:
+      {
+        int ctrlTag, msgTag, dataSize;
+        pos = stream.Get(&ctrlTag, pos);
+        pos = stream.Get(&msgTag, pos);
+        pos = stream.Get(&dataSize, pos);
+        SendControlMsgFromDelegate(ctrlTag, msgTag, dataSize, stream.GetData() + pos);
+        break;
+      }
+      case kSABSAMFD:
+      {
+        int msgTag, dataSize;
+        pos = stream.Get(&msgTag, pos);
+        pos = stream.Get(&dataSize, pos);
+        SendArbitraryMsgFromDelegate(msgTag, dataSize, stream.GetData() + pos);
+        break;
+      }
+      case kSABSMMFD:
+      {
+        IMidiMsg msg;
+        pos = stream.Get(&msg.mStatus, pos);
+        pos = stream.Get(&msg.mData1, pos);
+        stream.Get(&msg.mData2, pos);
+        SendMidiMsgFromDelegate(msg);
+        break;
+      }
+      case kSABSSMFD:
+      {
+        int dataSize;
+        pos = stream.Get(&dataSize, pos);
+        ISysEx msg(0, stream.GetData() + pos, dataSize);
+        SendSysexMsgFromDelegate(msg);
+        break;
+      }
+      default:
+        break;
+    }
+  });
+#endif
+}
+
 extern std::unique_ptr<IPlugWeb> gPlug;
 
 // could probably do this without these extra functions
@@ -12,6 +12,7 @@
 #define _IPLUGAPI_
 
 #include "IPlugAPIBase.h"
+#include "IPlugWebSABRing.h"
 #include <emscripten/val.h>
 
 BEGIN_IPLUG_NAMESPACE
@@ -36,16 +37,25 @@ public:
   void SendArbitraryMsgFromUI(int msgTag, int ctrlTag = kNoTag, int dataSize = 0, const void* pData = nullptr) override;
 
   /** Plug-ins that override OnIdle() must call the base class! */
-  virtual void OnIdle() override { SendDSPIdleTick(); }
+  virtual void OnIdle() override { SendDSPIdleTick(); ProcessSABMsgs(); }
 private:
   /** Sends a message to audio worklet node, in order to emulate IPlugAPIBase::OnTimer() */
   void SendDSPIdleTick();
+
+  /** Write the message in mSABTxBuf to the ring to the processor
+   * @return \c false if the controller has no ring, or there is not enough space in it, in which case the message should be sent with postMessage() */
+  bool SendSABMsg();
+
+  /** Read the messages from the processor's ring and handle them like the postMessage() ones */
+  void ProcessSABMsgs();
   
   WDL_String mWAMCtrlrJSObjectName;
   IByteChunk mSPVFUIBuf;
   IByteChunk mSMMFUIBuf;
   IByteChunk mSSMFUIBuf;
   IByteChunk mSAMFUIBuf;
+  IByteChunk mSABTxBuf;
+  IByteChunk mSABRxBuf;
 };
 
 IPlugWeb* MakePlug(const InstanceInfo& info);
@@ -0,0 +1,134 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Lock-free rings in SharedArrayBuffers, that carry the messages between the WAM processor in the AudioWorklet and the IPlugWeb editor on the main thread
+ */
+
+#include <emscripten.h>
+
+#include "IPlugStructs.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** The size of each ring in bytes. A message that doesn't fit in the space left is sent with postMessage() */
+static constexpr int kSABRingSize = 65536;
+
+/** The type of a message in a ring. Each message is an int with its size in bytes, including the header, an int with its type, then the same arguments as
+ * the postMessage() or websocket message with the same name */
+enum ESABMsg
+{
+  kSABSPVFD = 0, // int paramIdx, double value, int normalized
+  kSABSCVFD,     // int ctrlTag, double normalizedValue
+  kSABSCMFD,     // int ctrlTag, int msgTag, int dataSize, data
+  kSABSAMFD,     // int msgTag, int dataSize, data
+  kSABSMMFD,     // uint8_t status, data1, data2
+  kSABSSMFD,     // int dataSize, data
+  kSABSPVFUI,    // int paramIdx, double normalizedValue
+  kSABSMMFUI,    // uint8_t status, data1, data2
+  kSABSAMFUI     // int msgTag, int ctrlTag, int dataSize, data
+};
+
+/** Define IPlugSABRing in the current JavaScript global scope, if it isn't already. A ring is a SharedArrayBuffer with the read and write positions in its first
+ * two Int32s, which are only changed with Atomics, so that one thread can write whole messages while another reads them, without locks or garbage.
+ * The editor's WAM controller creates the rings with IPlugSABRing.create() when the page is cross-origin isolated, and passes them to the processor in its processorOptions */
+static inline void InstallSABRing()
+{
+  EM_ASM({
+    if (globalThis.IPlugSABRing !== undefined)
+      return;
+
+    globalThis.IPlugSABRing = {
+      capacity: $0,
+      nextID: 1,
+      instances: {},
+      create: function() {
+        return new SharedArrayBuffer(8 + this.capacity);
+      },
+      views: function(sab) {
+        if (sab.iplugViews === undefined)
+          sab.iplugViews = { pos: new Int32Array(sab, 0, 2), data: new Uint8Array(sab, 8) };
+        return sab.iplugViews;
+      },
+      write: function(sab, heap, ptr, size) {
+        var v = this.views(sab);
+        var cap = v.data.length;
+        var r = Atomics.load(v.pos, 0);
+        var w = Atomics.load(v.pos, 1);
+        if (size > (r - w - 1 + cap) % cap)
+          return 0;
+        for (var i = 0; i < size; i++) {
+          v.data[w] = heap[ptr + i];
+          if (++w == cap) w = 0;
+        }
+        Atomics.store(v.pos, 1, w);
+        return 1;
+      },
+      read: function(sab, heap, ptr, maxSize) {
+        var v = this.views(sab);
+        var cap = v.data.length;
+        var r = Atomics.load(v.pos, 0);
+        var w = Atomics.load(v.pos, 1);
+        var n = Math.min((w - r + cap) % cap, maxSize);
+        for (var i = 0; i < n; i++) {
+          heap[ptr + i] = v.data[r];
+          if (++r == cap) r = 0;
+        }
+        Atomics.store(v.pos, 0, r);
+        return n;
+      }
+    };
+  }, kSABRingSize);
+}
+
+/** Start a message in a chunk
+ * @return The position of the message's size, for EndSABMsg() */
+static inline int BeginSABMsg(IByteChunk& chunk, ESABMsg type)
+{
+  const int start = chunk.Size();
+  int size = 0;
+  int msgType = type;
+  chunk.Put(&size);
+  chunk.Put(&msgType);
+  return start;
+}
+
+/** Write the size of a message once all its arguments have been put in the chunk */
+static inline void EndSABMsg(IByteChunk& chunk, int start)
+{
+  const int size = chunk.Size() - start;
+  memcpy(chunk.GetData() + start, &size, sizeof(int));
+}
+
+/** Call a function for each message read from a ring. A reader must read into a buffer of kSABRingSize bytes, so that it always reads whole messages
+ * @param func Called with the type of each message and a stream positioned at its arguments */
+template <typename F>
+static inline void ForEachSABMsg(const uint8_t* pData, int size, F func)
+{
+  IByteStream stream(pData, size);
+  int pos = 0;
+
+  while (pos < size)
+  {
+    int msgSize = 0;
+    int msgType = 0;
+
+    if (stream.Get(&msgSize, pos) < 0 || stream.Get(&msgType, pos + sizeof(int)) < 0 || msgSize < 2 * static_cast<int>(sizeof(int)) || pos + msgSize > size)
+      break;
+
+    func(static_cast<ESABMsg>(msgType), stream, pos + 2 * static_cast<int>(sizeof(int)));
+    pos += msgSize;
+  }
+}
+
+END_IPLUG_NAMESPACE
@@ -10,14 +10,31 @@ class NAME_PLACEHOLDERController extends WAMController
     if (options.processorOptions.inputChannelCount === undefined) options.processorOptions = {inputChannelCount:[]};
 
     options.buflenSPN = 1024;
+
+    // If the page is cross-origin isolated, parameters, MIDI and messages go through SharedArrayBuffer rings, see IPlugWebSABRing.h. Otherwise they are posted
+    if (typeof SharedArrayBuffer !== 'undefined' && self.crossOriginIsolated && typeof IPlugSABRing !== 'undefined') {
+      options.processorOptions.sab = { uiToDSP: IPlugSABRing.create(), dspToUI: IPlugSABRing.create() };
+    }
+
     super(actx, "NAME_PLACEHOLDER", options);
+    this.sab = options.processorOptions.sab;
+  }
+
+  // true if the browser supports WebAssembly SIMD128, tested by validating the smallest module that uses it
+  static supportsSIMD () {
+    return WebAssembly.validate(new Uint8Array([0,97,115,109,1,0,0,0,1,5,1,96,0,1,123,3,2,1,0,10,10,1,8,0,65,0,253,15,253,98,11]));
   }
 
   static importScripts (actx) {
     var origin = "ORIGIN_PLACEHOLDER";
 
+    // the processor built with WAM_SIMD=1 is loaded if the browser supports it, otherwise or if it wasn't built, the scalar one
+    var wamScript = origin + "scripts/NAME_PLACEHOLDER-wam.js";
+    var wamSIMDScript = origin + "scripts/NAME_PLACEHOLDER-wam-simd.js";
+
     return new Promise( (resolve) => {
-      actx.audioWorklet.addModule(origin + "scripts/NAME_PLACEHOLDER-wam.js").then(() => {
+      (NAME_PLACEHOLDERController.supportsSIMD() ? actx.audioWorklet.addModule(wamSIMDScript).catch(() => actx.audioWorklet.addModule(wamScript))
+                                                 : actx.audioWorklet.addModule(wamScript)).then(() => {
       actx.audioWorklet.addModule(origin + "scripts/wam-processor.js").then(() => {
       actx.audioWorklet.addModule(origin + "scripts/NAME_PLACEHOLDER-awp.js").then(() => {
         resolve();
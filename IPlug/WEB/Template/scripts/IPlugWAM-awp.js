@@ -5,6 +5,8 @@ class NAME_PLACEHOLDER_AWP extends AudioWorkletGlobalScope.WAMProcessor
   constructor(options) {
     options = options || {}
     options.mod = AudioWorkletGlobalScope.WAM.NAME_PLACEHOLDER;
+    // IPlugWAM::init() takes the controller's SharedArrayBuffer rings, if it made any
+    AudioWorkletGlobalScope.IPlugWAMSAB = options.processorOptions ? options.processorOptions.sab : undefined;
     super(options);
   }
 }
@@ -18,61 +18,20 @@ function setupWebSocket(onCompleted) {
         var buf = new Uint8Array(msg).buffer;
         var dv = new DataView(buf);
         var pos = 0;
-        var strlen = dv.getInt32(pos, true); pos += 4;
-        var prefix = new TextDecoder("utf-8").decode(new Uint8Array(buf, pos, strlen)); pos += strlen;
+        var prefix = readPrefix(buf, dv, pos); pos += 4 + prefix.length;
 
-        //Send Parameter Value From Delegate
-        if(prefix == "SPVFD") {
-          var paramIdx = dv.getInt32(pos, true); pos += 4;
-          var value = dv.getFloat64(pos, true); pos += 8;
-          Module.SPVFD(paramIdx, value);
-        }
-        //Send Control Message From Delegate
-        else if(prefix == "SCVDD") {
-          var ctrlTag = dv.getInt32(pos, true); pos += 4;
-          var value = dv.getFloat64(pos, true); pos += 8;
-          Module.SCVFD(ctrlTag, value);
-        }
-        //Send Control Message From Delegate
-        else if(prefix == "SCMFD") {
-          var ctrlTag = dv.getInt32(pos, true); pos += 4;
-          var msgTag = dv.getInt32(pos, true); pos += 4;
-          var dataSize = dv.getInt32(pos, true); pos += 4;
-          var data = new Uint8Array(buf, pos, dataSize);
+        // A batch of messages, int nMsgs, then int size and the bytes of each message
+        if(prefix == "BATCH") {
+          var nMsgs = dv.getInt32(pos, true); pos += 4;
 
-          const esbuf = Module._malloc(data.length);
-          Module.HEAPU8.set(data, esbuf);
-          Module.SCMFD(ctrlTag, msgTag, data.length, esbuf);
-          Module._free(esbuf);
+          for(var i = 0; i < nMsgs; i++) {
+            var size = dv.getInt32(pos, true); pos += 4;
+            processMessage(buf, pos);
+            pos += size;
+          }
         }
-        //Send Arbitrary Message From Delegate
-        else if(prefix == "SAMFD") {
-          var msgTag = dv.getInt32(pos, true); pos += 4;
-          var dataSize = dv.getInt32(pos, true); pos += 4;
-          var data = new Uint8Array(buf, pos, dataSize);
-
-          const esbuf = Module._malloc(data.length);
-          Module.HEAPU8.set(data, esbuf);
-          Module.SAMFD(msgTag, data.length, esbuf);
-          Module._free(esbuf);
-        }
-        //Send MIDI Message From Delegate
-        else if(prefix == "SMMFD") {
-          var status = dv.getUint8(pos, true); pos ++;
-          var data1 = dv.getUint8(pos, true); pos ++;
-          var data2 = dv.getUint8(pos, true); pos ++;
-          Module.SMMFD(status, data1, data2);
-        }
-        //Send Sysex Message From Delegate
-        else if(prefix == "SSMFD") {
-          var msgTag = dv.getInt32(pos, true); pos += 4;
-          var dataSize = dv.getInt32(pos, true); pos += 4;
-          var data = new Uint8Array(buf, pos, dataSize);
-
-          const esbuf = Module._malloc(data.length);
-          Module.HEAPU8.set(data, esbuf);
-          Module.SSMFD(msgTag, data.length, esbuf);
-          Module._free(esbuf);
+        else {
+          processMessage(buf, 0);
         }
     }
   }
@@ -83,4 +42,69 @@ function setupWebSocket(onCompleted) {
   }
 
   onCompleted();
-}
\ No newline at end of file
+}
+
+function readPrefix(buf, dv, pos) {
+  var strlen = dv.getInt32(pos, true);
+  return new TextDecoder("utf-8").decode(new Uint8Array(buf, pos + 4, strlen));
+}
+
+/* Handles one message from the server, which starts at pos in buf */
+function processMessage(buf, pos) {
+  var dv = new DataView(buf);
+  var prefix = readPrefix(buf, dv, pos); pos += 4 + prefix.length;
+
+  //Send Parameter Value From Delegate
+  if(prefix == "SPVFD") {
+    var paramIdx = dv.getInt32(pos, true); pos += 4;
+    var value = dv.getFloat64(pos, true); pos += 8;
+    Module.SPVFD(paramIdx, value);
+  }
+  //Send Control Message From Delegate
+  else if(prefix == "SCVFD") {
+    var ctrlTag = dv.getInt32(pos, true); pos += 4;
+    var value = dv.getFloat64(pos, true); pos += 8;
+    Module.SCVFD(ctrlTag, value);
+  }
+  //Send Control Message From Delegate
+  else if(prefix == "SCMFD") {
+    var ctrlTag = dv.getInt32(pos, true); pos += 4;
+    var msgTag = dv.getInt32(pos, true); pos += 4;
+    var dataSize = dv.getInt32(pos, true); pos += 4;
+    var data = new Uint8Array(buf, pos, dataSize);
+
+    const esbuf = Module._malloc(data.length);
+    Module.HEAPU8.set(data, esbuf);
+    Module.SCMFD(ctrlTag, msgTag, data.length, esbuf);
+    Module._free(esbuf);
+  }
+  //Send Arbitrary Message From Delegate
+  else if(prefix == "SAMFD") {
+    var msgTag = dv.getInt32(pos, true); pos += 4;
+    var dataSize = dv.getInt32(pos, true); pos += 4;
+    var data = new Uint8Array(buf, pos, dataSize);
+
+    const esbuf = Module._malloc(data.length);
+    Module.HEAPU8.set(data, esbuf);
+    Module.SAMFD(msgTag, data.length, esbuf);
+    Module._free(esbuf);
+  }
+  //Send MIDI Message From Delegate
+  else if(prefix == "SMMFD") {
+    var status = dv.getUint8(pos, true); pos ++;
+    var data1 = dv.getUint8(pos, true); pos ++;
+    var data2 = dv.getUint8(pos, true); pos ++;
+    Module.SMMFD(status, data1, data2);
+  }
+  //Send Sysex Message From Delegate
+  else if(prefix == "SSMFD") {
+    var msgTag = dv.getInt32(pos, true); pos += 4;
+    var dataSize = dv.getInt32(pos, true); pos += 4;
+    var data = new Uint8Array(buf, pos, dataSize);
+
+    const esbuf = Module._malloc(data.length);
+    Module.HEAPU8.set(data, esbuf);
+    Module.SSMFD(msgTag, data.length, esbuf);
+    Module._free(esbuf);
+  }
+}
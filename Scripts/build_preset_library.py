@@ -0,0 +1,125 @@
+#!/usr/bin/python3
+
+# this script packs factory presets into one file with an index of their names, categories and tags, which IPlug/Extras/PresetLibrary.h memory maps
+# usage: build_preset_library.py manifest.json library.ippl
+# the manifest is a list of presets, each {"name": ..., "category": ..., "tags": [...]} and one of:
+#   "file": a file holding the preset's state, as written by IPluginBase::SerializeState(), the name is the file's name without its extension if the entry has none
+#   "blob": a file written by IPluginBase::DumpPresetBlob(), the name is taken from it if the entry has none
+# paths are relative to the manifest
+
+import base64, json, os, re, struct, sys
+
+VERSION = 1
+NO_CATEGORY = 0xFFFFFFFF
+HEADER_WORDS = 12
+
+def read_state(entry, basedir):
+  if "file" in entry:
+    with open(os.path.join(basedir, entry["file"]), "rb") as f:
+      return entry.get("name", os.path.splitext(os.path.basename(entry["file"]))[0]), f.read()
+
+  with open(os.path.join(basedir, entry["blob"]), "r") as f:
+    match = re.search(r'MakePresetFromBlob\("((?:[^"\\]|\\.)*)",\s*"([^"]*)",\s*(\d+)\)', f.read())
+
+  if match == None:
+    raise ValueError("no MakePresetFromBlob() call in " + entry["blob"])
+
+  state = base64.b64decode(match.group(2))[:int(match.group(3))]
+  return entry.get("name", match.group(1)), state
+
+def build_preset_library(manifest_path, output_path):
+  with open(manifest_path, "r") as f:
+    manifest = json.load(f)
+
+  basedir = os.path.dirname(os.path.abspath(manifest_path))
+  presets = []
+
+  for entry in manifest:
+    name, state = read_state(entry, basedir)
+    presets.append({ "name": name, "category": entry.get("category", ""), "tags": sorted(set(entry.get("tags", []))), "state": state })
+
+  # sorted by the bytes of their UTF-8 names, which is the order strcmp() finds them in
+  key = lambda s: s.encode("utf-8")
+  presets.sort(key=lambda p: key(p["name"]))
+
+  for i in range(1, len(presets)):
+    if presets[i]["name"] == presets[i - 1]["name"]:
+      raise ValueError("duplicate preset name " + presets[i]["name"])
+
+  categories = sorted(set(p["category"] for p in presets if p["category"]), key=key)
+  tags = sorted(set(t for p in presets for t in p["tags"]), key=key)
+  category_idx = { c: i for i, c in enumerate(categories) }
+  tag_idx = { t: i for i, t in enumerate(tags) }
+
+  strings = bytearray()
+  string_offsets = {}
+
+  def add_string(s):
+    if s not in string_offsets:
+      string_offsets[s] = len(strings)
+      strings.extend(s.encode("utf-8") + b"\0")
+    return string_offsets[s]
+
+  postings = []
+
+  def add_postings(indices):
+    start = len(postings)
+    postings.extend(indices)
+    return start, len(indices)
+
+  presets_in_category = { c: [] for c in categories }
+  presets_with_tag = { t: [] for t in tags }
+
+  for i, p in enumerate(presets):
+    if p["category"]:
+      presets_in_category[p["category"]].append(i)
+    for t in p["tags"]:
+      presets_with_tag[t].append(i)
+
+  category_lists = [(add_string(c),) + add_postings(presets_in_category[c]) for c in categories]
+  tag_lists = [(add_string(t),) + add_postings(presets_with_tag[t]) for t in tags]
+  preset_tags = [add_postings(sorted(tag_idx[t] for t in p["tags"])) for p in presets]
+  preset_names = [add_string(p["name"]) for p in presets]
+
+  if len(strings) == 0:
+    strings.extend(b"\0")
+
+  presets_offset = HEADER_WORDS * 4
+  categories_offset = presets_offset + len(presets) * 6 * 4
+  tags_offset = categories_offset + len(categories) * 3 * 4
+  postings_offset = tags_offset + len(tags) * 3 * 4
+  strings_offset = postings_offset + len(postings) * 4
+  data_offset = (strings_offset + len(strings) + 7) & ~7
+
+  out = bytearray()
+  out += b"IPPL"
+  out += struct.pack("<11I", VERSION, len(presets), len(categories), len(tags), presets_offset, categories_offset, tags_offset, postings_offset, len(postings), strings_offset, len(strings))
+
+  data = bytearray()
+
+  for i, p in enumerate(presets):
+    category = category_idx[p["category"]] if p["category"] else NO_CATEGORY
+    tags_start, n_tags = preset_tags[i]
+    out += struct.pack("<6I", preset_names[i], category, tags_start, n_tags, data_offset + len(data), len(p["state"]))
+    data += p["state"]
+    data += b"\0" * (-len(data) % 8)
+
+  for name, start, count in category_lists + tag_lists:
+    out += struct.pack("<3I", name, start, count)
+
+  out += struct.pack("<%dI" % len(postings), *postings)
+  out += strings
+  out += b"\0" * (data_offset - len(out))
+  out += data
+
+  with open(output_path, "wb") as f:
+    f.write(out)
+
+  print("packed %d presets, %d categories and %d tags into %s" % (len(presets), len(categories), len(tags), output_path))
+
+if __name__ == "__main__":
+  if len(sys.argv) != 3:
+    print("usage: build_preset_library.py manifest.json library.ippl")
+    sys.exit(1)
+
+  build_preset_library(sys.argv[1], sys.argv[2])
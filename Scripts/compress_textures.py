@@ -0,0 +1,54 @@
+#!/usr/bin/python3
+
+# this script creates precompressed GPU textures for the bitmaps in a folder, which IGraphicsNanoVG loads in place of the bitmaps
+# each image.png gets an image.png.ktx next to it in the destination folder, BC7 for macOS/Windows and ASTC 4x4 for iOS
+# compression is lossy, so it is opt in: set the environment variable IPLUG2_COMPRESS_TEXTURES=1 when building
+# it needs compressonatorcli (https://github.com/GPUOpen-Tools/compressonator) for BC7 or astcenc (https://github.com/ARM-software/astc-encoder) for ASTC
+
+import os, shutil, subprocess, sys
+
+TOOLS = {
+  "bc7": (("compressonatorcli", "CompressonatorCLI"), lambda tool, src, dst: [tool, "-fd", "BC7", src, dst]),
+  "astc": (("astcenc", "astcenc-avx2", "astcenc-neon", "astcenc-sse4.1"), lambda tool, src, dst: [tool, "-cl", src, dst, "4x4", "-medium"])
+}
+
+def find_tool(names):
+  for name in names:
+    path = shutil.which(name)
+    if path:
+      return path
+  return None
+
+def compress_textures(srcdir, dstdir, format):
+  if os.environ.get("IPLUG2_COMPRESS_TEXTURES", "0") != "1" or not os.path.exists(srcdir):
+    return
+
+  names, command = TOOLS[format]
+  tool = find_tool(names)
+
+  if tool == None:
+    print("not compressing textures, " + names[0] + " was not found")
+    return
+
+  for img in os.listdir(srcdir):
+    if not img.lower().endswith(".png"):
+      continue
+
+    src = os.path.join(srcdir, img)
+    dst = os.path.join(dstdir, img + ".ktx")
+
+    if os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+      continue
+
+    print("compressing " + img + " to " + format)
+
+    if subprocess.call(command(tool, src, dst), stdout=subprocess.DEVNULL) != 0 and os.path.exists(dst):
+      os.remove(dst) # the bitmap is used instead
+
+if __name__ == '__main__':
+  if len(sys.argv) != 4 or sys.argv[3] not in TOOLS:
+    print("usage: compress_textures.py srcdir dstdir bc7|astc")
+    sys.exit(1)
+
+  os.environ["IPLUG2_COMPRESS_TEXTURES"] = "1"
+  compress_textures(sys.argv[1], sys.argv[2], sys.argv[3])
@@ -0,0 +1,466 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief Microbenchmarks of the DSP classes in IPlug/Extras
+ *
+ * Each benchmark processes blocks of noise with one class, for every combination of channel count, block size and sample type, and reports the time per sample
+ * of each channel, so that an optimization, e.g. a SIMD path, can be compared with the code it replaces, and with the scalar path at one channel.
+ * The benchmarks are registered and run in the manner of Google Benchmark, without depending on it. See README.md for how to build it.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+
+#include "SVF.h"
+#include "Oversampler.h"
+#include "LFO.h"
+#include "ADSREnvelope.h"
+#include "NChanDelay.h"
+#include "Oscillator.h"
+#include "Smoothers.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 48000.;
+static constexpr int kMaxChans = 8;
+static constexpr int kMaxBlockSize = 512;
+
+// the output of every block is added to this, so that the compiler can't remove the processing
+static volatile double gSink = 0.;
+
+#pragma mark - Harness
+
+/** The buffers of a benchmark, with the input filled with noise */
+template <typename T>
+struct Buffers
+{
+  Buffers(int nChans, int blockSize)
+  : mIn(nChans * blockSize)
+  , mOut(nChans * blockSize)
+  {
+    uint32_t state = 1;
+
+    for (auto& s : mIn)
+    {
+      state = state * 1664525u + 1013904223u;
+      s = static_cast<T>(static_cast<int>(state >> 8) % 2001 - 1000) * static_cast<T>(0.001);
+    }
+
+    for (int c = 0; c < nChans; c++)
+    {
+      mInPtrs[c] = mIn.data() + c * blockSize;
+      mOutPtrs[c] = mOut.data() + c * blockSize;
+    }
+  }
+
+  /** Called after each block, so that the output is used */
+  void Consume(int nChans, int blockSize) const
+  {
+    for (int c = 0; c < nChans; c++)
+      gSink = gSink + mOutPtrs[c][blockSize - 1];
+  }
+
+  std::vector<T> mIn, mOut;
+  T* mInPtrs[kMaxChans] = {};
+  T* mOutPtrs[kMaxChans] = {};
+};
+
+/** Processes one block each time it is called, made by a benchmark for a channel count and block size */
+using BlockFunc = std::function<void()>;
+
+/** A registered benchmark, as with BENCHMARK() in Google Benchmark */
+struct Benchmark
+{
+  std::string mName;
+  const char* mType;
+  int mNChans;
+  std::function<BlockFunc(int blockSize)> mMake;
+};
+
+static std::vector<Benchmark>& GetBenchmarks()
+{
+  static std::vector<Benchmark> sBenchmarks;
+  return sBenchmarks;
+}
+
+template <typename T>
+static const char* TypeStr() { return std::is_same<T, float>::value ? "float" : "double"; }
+
+/** Register a benchmark for a sample type and channel count
+ * @param make Called with a block size, returns the function that processes a block. It makes the object and its buffers, which are not timed */
+template <typename T>
+static void Register(const char* name, int nChans, std::function<BlockFunc(int blockSize)> make)
+{
+  GetBenchmarks().push_back({name, TypeStr<T>(), nChans, std::move(make)});
+}
+
+struct Result
+{
+  double mNsPerSample;
+  double mNsPerBlock;
+};
+
+/** Time a block function, as Google Benchmark does: the number of blocks is grown until a run takes long enough, and the fastest of a few runs is kept, which is the least disturbed by the system */
+static Result Run(const BlockFunc& process, int nChans, int blockSize, double minTimeMs)
+{
+  using Clock = std::chrono::steady_clock;
+  static constexpr int kNumRuns = 5;
+
+  // warm up the caches and the branch predictors
+  for (int i = 0; i < 64; i++)
+    process();
+
+  int64_t nBlocks = 1;
+  double best = 0.;
+
+  while (true)
+  {
+    const auto start = Clock::now();
+
+    for (int64_t i = 0; i < nBlocks; i++)
+      process();
+
+    const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    if (ms >= minTimeMs / kNumRuns || nBlocks >= (int64_t(1) << 30))
+    {
+      best = ms;
+      break;
+    }
+
+    nBlocks *= ms > 0.01 ? std::max<int64_t>(2, static_cast<int64_t>(1.2 * minTimeMs / kNumRuns / ms)) : 10;
+  }
+
+  for (int r = 1; r < kNumRuns; r++)
+  {
+    const auto start = Clock::now();
+
+    for (int64_t i = 0; i < nBlocks; i++)
+      process();
+
+    best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  const double nsPerBlock = best * 1e6 / nBlocks;
+  return {nsPerBlock / (blockSize * nChans), nsPerBlock};
+}
+
+#pragma mark - Benchmarks
+
+template <typename T, int NC>
+static void RegisterSVF()
+{
+  Register<T>("SVF", NC, [](int blockSize) -> BlockFunc {
+    auto pFilter = std::make_shared<SVF<T, NC>>(SVF<T, NC>::kLowPass, 1000.);
+    auto pBuffers = std::make_shared<Buffers<T>>(NC, blockSize);
+    pFilter->SetSampleRate(kSampleRate);
+    pFilter->SetQ(2.);
+    return [=]() {
+      pFilter->ProcessBlock(pBuffers->mInPtrs, pBuffers->mOutPtrs, NC, blockSize);
+      pBuffers->Consume(NC, blockSize);
+    };
+  });
+}
+
+template <typename T>
+static void RegisterOverSampler(EFactor factor, const char* name, int nChans)
+{
+  Register<T>(name, nChans, [factor, nChans](int blockSize) -> BlockFunc {
+    auto pOverSampler = std::make_shared<OverSampler<T>>(factor, true, nChans, nChans);
+    auto pBuffers = std::make_shared<Buffers<T>>(nChans, blockSize);
+    pOverSampler->Reset(blockSize);
+    return [=]() {
+      // only the up and down sampling is timed, the oversampled audio is copied through
+      pOverSampler->ProcessBlock(pBuffers->mInPtrs, pBuffers->mOutPtrs, blockSize, nChans, nChans, [nChans](T** inputs, T** outputs, int nFrames) {
+        for (int c = 0; c < nChans; c++)
+          std::copy(inputs[c], inputs[c] + nFrames, outputs[c]);
+      });
+      pBuffers->Consume(nChans, blockSize);
+    };
+  });
+}
+
+template <typename T>
+static void RegisterLFO(int nChans)
+{
+  Register<T>("LFO", nChans, [nChans](int blockSize) -> BlockFunc {
+    auto pLFOs = std::make_shared<std::vector<LFO<T>>>(nChans);
+    auto pBuffers = std::make_shared<Buffers<T>>(nChans, blockSize);
+
+    for (auto& lfo : *pLFOs)
+    {
+      lfo.SetSampleRate(kSampleRate);
+      lfo.SetShape(LFO<T>::kSine);
+      lfo.SetFreqCPS(3.);
+    }
+
+    return [=]() {
+      for (int c = 0; c < nChans; c++)
+        (*pLFOs)[c].ProcessBlock(pBuffers->mOutPtrs[c], blockSize);
+
+      pBuffers->Consume(nChans, blockSize);
+    };
+  });
+}
+
+// short stages, so that the envelopes keep changing stage rather than sitting in sustain
+static void SetEnvelopeTimes(std::function<void(int stage, double timeMS)> setStageTime)
+{
+  setStageTime(ADSREnvelope<double>::kAttack, 2.);
+  setStageTime(ADSREnvelope<double>::kDecay, 10.);
+  setStageTime(ADSREnvelope<double>::kRelease, 20.);
+}
+
+static constexpr int kEnvelopeHoldSamples = 2400;
+
+/** One ADSREnvelope per channel, processed a sample at a time, the scalar counterpart of ADSREnvelopeBank */
+template <typename T>
+static void RegisterADSREnvelope(int nChans)
+{
+  Register<T>("ADSREnvelope", nChans, [nChans](int blockSize) -> BlockFunc {
+    auto pEnvs = std::make_shared<std::vector<ADSREnvelope<T>>>(nChans);
+    auto pHeld = std::make_shared<std::vector<int>>(nChans, 0);
+    auto pBuffers = std::make_shared<Buffers<T>>(nChans, blockSize);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      auto& env = (*pEnvs)[c];
+      env.SetSampleRate(static_cast<T>(kSampleRate));
+      SetEnvelopeTimes([&env](int stage, double timeMS) { env.SetStageTime(stage, static_cast<T>(timeMS)); });
+      (*pHeld)[c] = -c * 300; // staggered, so that the channels change stage at different times
+    }
+
+    return [=]() {
+      for (int c = 0; c < nChans; c++)
+      {
+        auto& env = (*pEnvs)[c];
+        int& held = (*pHeld)[c];
+
+        if (!env.GetBusy() && held >= 0)
+        {
+          env.Start(1.);
+          held = 0;
+        }
+        else if ((held += blockSize) >= kEnvelopeHoldSamples && !env.GetReleased())
+          env.Release();
+
+        T* pOut = pBuffers->mOutPtrs[c];
+
+        for (int s = 0; s < blockSize; s++)
+          pOut[s] = env.Process(static_cast<T>(0.7));
+      }
+
+      pBuffers->Consume(nChans, blockSize);
+    };
+  });
+}
+
+template <typename T, int NC>
+static void RegisterADSREnvelopeBank()
+{
+  Register<T>("ADSREnvelopeBank", NC, [](int blockSize) -> BlockFunc {
+    auto pBank = std::make_shared<ADSREnvelopeBank<T, NC>>();
+    auto pHeld = std::make_shared<std::vector<int>>(NC, 0);
+    auto pBuffers = std::make_shared<Buffers<T>>(NC, blockSize);
+    pBank->SetSampleRate(static_cast<T>(kSampleRate));
+    SetEnvelopeTimes([pBank](int stage, double timeMS) { pBank->SetStageTime(stage, static_cast<T>(timeMS)); });
+
+    for (int i = 0; i < NC; i++)
+      (*pHeld)[i] = -i * 300;
+
+    return [=]() {
+      for (int i = 0; i < NC; i++)
+      {
+        int& held = (*pHeld)[i];
+
+        if (!pBank->GetBusy(i) && held >= 0)
+        {
+          pBank->Start(i, 1.);
+          held = 0;
+        }
+        else if ((held += blockSize) >= kEnvelopeHoldSamples && !pBank->GetReleased(i))
+          pBank->Release(i);
+      }
+
+      pBank->ProcessBlock(pBuffers->mOutPtrs, blockSize, static_cast<T>(0.7));
+      pBuffers->Consume(NC, blockSize);
+    };
+  });
+}
+
+template <typename T>
+static void RegisterNChanDelayLine(bool modulated, int nChans)
+{
+  Register<T>(modulated ? "NChanDelayLine modulated" : "NChanDelayLine", nChans, [modulated, nChans](int blockSize) -> BlockFunc {
+    auto pDelay = std::make_shared<NChanDelayLine<T>>(nChans, nChans);
+    auto pBuffers = std::make_shared<Buffers<T>>(nChans, blockSize);
+    auto pDelayTimes = std::make_shared<std::vector<T>>(blockSize);
+    pDelay->SetMaxDelayTime(4800);
+    pDelay->SetDelayTime(441);
+
+    // a chorus sweep between 10 and 20 ms
+    for (int s = 0; s < blockSize; s++)
+      (*pDelayTimes)[s] = static_cast<T>(720. + 240. * std::sin(2. * PI * s / blockSize));
+
+    return [=]() {
+      if (modulated)
+        pDelay->ProcessBlock(pBuffers->mInPtrs, pBuffers->mOutPtrs, blockSize, pDelayTimes->data());
+      else
+        pDelay->ProcessBlock(pBuffers->mInPtrs, pBuffers->mOutPtrs, blockSize);
+
+      pBuffers->Consume(nChans, blockSize);
+    };
+  });
+}
+
+template <typename T>
+static void RegisterFastSinOscillator(int nChans)
+{
+  Register<T>("FastSinOscillator", nChans, [nChans](int blockSize) -> BlockFunc {
+    auto pOscs = std::make_shared<std::vector<FastSinOscillator<T>>>(nChans);
+    auto pBuffers = std::make_shared<Buffers<T>>(nChans, blockSize);
+
+    for (int c = 0; c < nChans; c++)
+    {
+      (*pOscs)[c].SetSampleRate(kSampleRate);
+      (*pOscs)[c].SetFreqCPS(110. * (c + 1));
+    }
+
+    return [=]() {
+      for (int c = 0; c < nChans; c++)
+        (*pOscs)[c].ProcessBlock(pBuffers->mOutPtrs[c], blockSize);
+
+      pBuffers->Consume(nChans, blockSize);
+    };
+  });
+}
+
+template <typename T, int NC>
+static void RegisterLogParamSmooth()
+{
+  Register<T>("LogParamSmooth", NC, [](int blockSize) -> BlockFunc {
+    auto pSmoother = std::make_shared<LogParamSmooth<T, NC>>(5.);
+    auto pBuffers = std::make_shared<Buffers<T>>(NC, blockSize);
+    auto pBlock = std::make_shared<int>(0);
+    pSmoother->SetSmoothTime(5., kSampleRate);
+
+    return [=]() {
+      // the targets move every block, as a parameter being automated does
+      T inputs[NC];
+
+      for (int c = 0; c < NC; c++)
+        inputs[c] = static_cast<T>(((*pBlock + c) % 16) / 16.);
+
+      (*pBlock)++;
+      pSmoother->ProcessBlock(inputs, pBuffers->mOutPtrs, blockSize);
+      pBuffers->Consume(NC, blockSize);
+    };
+  });
+}
+
+template <typename T, int NC>
+static void RegisterForChannels()
+{
+  RegisterSVF<T, NC>();
+  RegisterOverSampler<T>(k2x, "OverSampler 2x", NC);
+  RegisterOverSampler<T>(k4x, "OverSampler 4x", NC);
+  RegisterLFO<T>(NC);
+  RegisterADSREnvelope<T>(NC);
+  RegisterADSREnvelopeBank<T, NC>();
+  RegisterNChanDelayLine<T>(false, NC);
+  RegisterNChanDelayLine<T>(true, NC);
+  RegisterFastSinOscillator<T>(NC);
+  RegisterLogParamSmooth<T, NC>();
+}
+
+template <typename T>
+static void RegisterForType()
+{
+  RegisterForChannels<T, 1>();
+  RegisterForChannels<T, 2>();
+  RegisterForChannels<T, 8>();
+}
+
+#pragma mark - Main
+
+static void PrintUsage()
+{
+  std::printf("usage: ExtrasBenchmark [--filter <text>] [--min-time <ms>] [--csv]\n"
+              "  --filter    only run the benchmarks whose name contains the text\n"
+              "  --min-time  the time each benchmark runs for, 500 ms by default\n"
+              "  --csv       print comma separated values, to compare runs in a spreadsheet\n");
+}
+
+int main(int argc, char* argv[])
+{
+  const char* filter = nullptr;
+  double minTimeMs = 500.;
+  bool csv = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+      filter = argv[++i];
+    else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc)
+      minTimeMs = std::max(1., std::atof(argv[++i]));
+    else if (!std::strcmp(argv[i], "--csv"))
+      csv = true;
+    else
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  RegisterForType<float>();
+  RegisterForType<double>();
+
+  const int blockSizes[] = {16, 64, kMaxBlockSize};
+
+  // ns/sample is per sample of each channel, so it is the same at every channel count for code that doesn't share work between channels
+  if (csv)
+    std::printf("benchmark,type,chans,block,ns/sample,ns/block\n");
+  else
+    std::printf("%-26s %-7s %5s %6s %10s %12s\n", "benchmark", "type", "chans", "block", "ns/sample", "ns/block");
+
+  for (const auto& benchmark : GetBenchmarks())
+  {
+    if (filter && benchmark.mName.find(filter) == std::string::npos)
+      continue;
+
+    for (auto blockSize : blockSizes)
+    {
+      const Result result = Run(benchmark.mMake(blockSize), benchmark.mNChans, blockSize, minTimeMs);
+
+      if (csv)
+        std::printf("%s,%s,%d,%d,%.3f,%.1f\n", benchmark.mName.c_str(), benchmark.mType, benchmark.mNChans, blockSize, result.mNsPerSample, result.mNsPerBlock);
+      else
+        std::printf("%-26s %-7s %5d %6d %10.3f %12.1f\n", benchmark.mName.c_str(), benchmark.mType, benchmark.mNChans, blockSize, result.mNsPerSample, result.mNsPerBlock);
+
+      std::fflush(stdout);
+    }
+  }
+
+  return 0;
+}
@@ -3,6 +3,27 @@
 
 #include "IControls.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if IPLUG_EDITOR
+static const char* kTestNames[kNumTests] = {"Start", "DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG", "DrawText"};
+
+// each test is run with each number of things, for kBenchmarkFrames frames after kBenchmarkWarmupFrames
+static const int kBenchmarkNumbersOfThings[] = {16, 256, 1024};
+static constexpr int kNumBenchmarkNumbersOfThings = sizeof(kBenchmarkNumbersOfThings) / sizeof(kBenchmarkNumbersOfThings[0]);
+static constexpr int kNumBenchmarkCases = (kNumTests - 1) * kNumBenchmarkNumbersOfThings;
+static constexpr int kBenchmarkWarmupFrames = 10;
+static constexpr int kBenchmarkFrames = 120;
+
+static double GetBenchmarkTimestamp()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
 IGraphicsStressTest::IGraphicsStressTest(const InstanceInfo& info)
 : Plugin(info, MakeConfig(kNumParams, 1))
 {
@@ -57,9 +78,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
         break;
     }
     
-    GetUI()->GetControlWithTag(kCtrlTagNumThings)->As<ITextControl>()->SetStrFmt(64, "Number of things = %i", mNumberOfThings);
-    GetUI()->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStrFmt(64, "Test %i/%i", this->mKindOfThing, 32);
-    GetUI()->SetAllControlsDirty();
+    UpdateLabels();
   };
   
   pGraphics->SetKeyHandlerFunc([DoFunc](const IKeyPress& key, bool isUp)
@@ -69,11 +88,21 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
         case kVK_UP: DoFunc(EFunc::More); return true;
         case kVK_DOWN: DoFunc(EFunc::Less); return true;
         case kVK_TAB: key.S ? DoFunc(EFunc::Prev) : DoFunc(EFunc::Next); return true;
+        case kVK_B:
+        {
+          WDL_String path;
+          DesktopPath(path);
+          path.Append("/IGraphicsStressTest-benchmark.json");
+          StartBenchmark(path.Get());
+          return true;
+        }
         default: return false;
       }
     }
     return false;
   });
+
+  pGraphics->SetDisplayTickFunc([this]() { OnBenchmarkTick(); });
   
   pGraphics->EnableMouseOver(false);
   pGraphics->LoadFont("Roboto-Regular", ROBOTO_FN);
@@ -88,11 +117,13 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     {
       g.DrawText(IText(30), "Press tab to go to next test", r);
       g.DrawText(IText(30), "up/down to change the # of things", r.GetVShifted(40.f));
+      g.DrawText(IText(30), "B to run every test and write a benchmark report to the desktop", r.GetVShifted(80.f));
     }
     else
     //      if (!g.CheckLayer(pCaller->mLayer))
     {
       //        g.StartLayer(r);
+      const auto drawStart = std::chrono::steady_clock::now();
       
       for (int i=0; i<this->mNumberOfThings; i++)
       {
@@ -119,12 +150,15 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
           case 10: g.DrawDottedLine(rc, dir == 0 ? rr.L : rr.R, rr.B, dir == 0 ? rr.R : rr.L, rr.T, &rb, thickness); break;
           case 11: g.DrawFittedBitmap(smiley, rr, &rb); break;
           case 12: g.DrawSVG(tiger, rr); break;
+          case 13: g.DrawText(IText(20.f, rc), "IGraphics", rr, &rb); break;
           default:
             break;
         }
         
         dir = !dir;
       }
+
+      mLastDrawTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - drawStart).count();
       //        pCaller->mLayer = g.EndLayer();
     }
     
@@ -144,7 +178,7 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
       switch (button){
         case 0:
         {
-          static IPopupMenu menu {"Test", {"Start", "DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG"},
+          static IPopupMenu menu {"Test", {"Start", "DrawRect", "FillRect", "DrawRoundRect", "FillRoundRect", "DrawEllipse", "FillEllipse", "DrawArc", "FillArc", "DrawLine", "DrawDottedLine", "DrawFittedBitmap", "DrawSVG", "DrawText"},
             [DoFunc](IPopupMenu* pMenu) {
               DoFunc(EFunc::Set, pMenu->GetChosenItemIdx());
             }};
@@ -170,5 +204,125 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
       pCaller->GetUI()->ShowFPSDisplay(pCaller->GetValue() > 0.5);
   });
 
+  UpdateLabels();
+
+  // e.g. IGRAPHICS_STRESS_TEST_BENCHMARK=report.json, to run the benchmark as soon as the app is opened
+  if (const char* reportPath = getenv("IGRAPHICS_STRESS_TEST_BENCHMARK"))
+    StartBenchmark(reportPath);
+}
+
+void IGraphicsStressTest::UpdateLabels()
+{
+  GetUI()->GetControlWithTag(kCtrlTagNumThings)->As<ITextControl>()->SetStrFmt(64, "Number of things = %i", mNumberOfThings);
+  GetUI()->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStrFmt(64, "Test %i/%i %s", mKindOfThing, kNumTests - 1, (mKindOfThing >= 0 && mKindOfThing < kNumTests) ? kTestNames[mKindOfThing] : "");
+  GetUI()->SetAllControlsDirty();
+}
+
+void IGraphicsStressTest::StartBenchmark(const char* reportPath)
+{
+  if (mBenchmarking)
+    return;
+
+  mBenchmarking = true;
+  mBenchmarkReportPath.Set(reportPath);
+  mBenchmarkResults.clear();
+  mBenchmarkResults.reserve(kNumBenchmarkCases);
+  mBenchmarkFrame = 0;
+  mPrevFrameTimestamp = GetBenchmarkTimestamp();
+  mLastDrawTime = -1.;
+}
+
+void IGraphicsStressTest::OnBenchmarkTick()
+{
+  if (!mBenchmarking)
+    return;
+
+  const double timestamp = GetBenchmarkTimestamp();
+
+  if (mBenchmarkResults.size())
+  {
+    BenchmarkResult& result = mBenchmarkResults.back();
+
+    // the first frames of a case are not measured, while bitmaps, SVGs and glyphs are loaded and cached
+    if (mBenchmarkFrame++ >= kBenchmarkWarmupFrames && mLastDrawTime >= 0.)
+    {
+      result.drawTimes.push_back(mLastDrawTime);
+      result.frameTimes.push_back(timestamp - mPrevFrameTimestamp);
+    }
+  }
+
+  mPrevFrameTimestamp = timestamp;
+  mLastDrawTime = -1.;
+
+  if (mBenchmarkResults.empty() || mBenchmarkResults.back().drawTimes.size() == kBenchmarkFrames)
+  {
+    const int benchmarkCase = static_cast<int>(mBenchmarkResults.size());
+
+    if (benchmarkCase == kNumBenchmarkCases)
+    {
+      mBenchmarking = false;
+      WriteBenchmarkReport();
+      mKindOfThing = kTestStart;
+      UpdateLabels();
+      return;
+    }
+
+    BenchmarkResult result;
+    result.test = kTestDrawRect + benchmarkCase / kNumBenchmarkNumbersOfThings;
+    result.numberOfThings = kBenchmarkNumbersOfThings[benchmarkCase % kNumBenchmarkNumbersOfThings];
+    result.drawTimes.reserve(kBenchmarkFrames);
+    result.frameTimes.reserve(kBenchmarkFrames);
+    mBenchmarkResults.push_back(std::move(result));
+
+    mKindOfThing = mBenchmarkResults.back().test;
+    mNumberOfThings = mBenchmarkResults.back().numberOfThings;
+    mBenchmarkFrame = 0;
+    srand(1); // the same things are drawn on every run
+    UpdateLabels();
+  }
+  else
+    GetUI()->GetControl(1)->SetDirty(false);
+}
+
+void IGraphicsStressTest::WriteBenchmarkReport()
+{
+  FILE* fp = fopen(mBenchmarkReportPath.Get(), "w");
+
+  if (!fp)
+  {
+    DBGMSG("IGraphicsStressTest: could not write the benchmark report to %s\n", mBenchmarkReportPath.Get());
+    return;
+  }
+
+  auto writeStats = [fp](const char* name, std::vector<double>& times) {
+    std::sort(times.begin(), times.end());
+    double total = 0.;
+
+    for (auto time : times)
+      total += time;
+
+    auto percentile = [&times](double p) { return times[std::min(times.size() - 1, static_cast<size_t>(p * times.size()))] * 1000.; };
+
+    fprintf(fp, "\"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"max\": %.4f}", name,
+            total * 1000. / times.size(), percentile(0.5), percentile(0.95), times.back() * 1000.);
+  };
+
+  IGraphics* pGraphics = GetUI();
+  fprintf(fp, "{\n  \"backend\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"scale\": %.2f,\n  \"fps\": %d,\n  \"frames\": %d,\n  \"results\": [\n",
+          pGraphics->GetDrawingAPIStr(), pGraphics->Width(), pGraphics->Height(), pGraphics->GetTotalScale(), pGraphics->FPS(), kBenchmarkFrames);
+
+  for (size_t i = 0; i < mBenchmarkResults.size(); i++)
+  {
+    BenchmarkResult& result = mBenchmarkResults[i];
+    fprintf(fp, "    {\"test\": \"%s\", \"things\": %d, ", kTestNames[result.test], result.numberOfThings);
+    writeStats("drawMs", result.drawTimes);
+    fputs(", ", fp);
+    writeStats("frameMs", result.frameTimes);
+    fputs(i + 1 < mBenchmarkResults.size() ? "},\n" : "}\n", fp);
+  }
+
+  fputs("  ]\n}\n", fp);
+  fclose(fp);
+  DBGMSG("IGraphicsStressTest: wrote the benchmark report to %s\n", mBenchmarkReportPath.Get());
 }
 #endif
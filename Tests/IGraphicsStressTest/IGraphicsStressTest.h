@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "IPlug_include_in_plug_hdr.h"
 
 enum EParam
@@ -20,6 +22,26 @@ enum EControlTags
   kCtrlTagButton6
 };
 
+/** The tests, 0 shows the instructions */
+enum ETest
+{
+  kTestStart = 0,
+  kTestDrawRect,
+  kTestFillRect,
+  kTestDrawRoundRect,
+  kTestFillRoundRect,
+  kTestDrawEllipse,
+  kTestFillEllipse,
+  kTestDrawArc,
+  kTestFillArc,
+  kTestDrawLine,
+  kTestDrawDottedLine,
+  kTestDrawFittedBitmap,
+  kTestDrawSVG,
+  kTestDrawText,
+  kNumTests
+};
+
 using namespace iplug;
 using namespace igraphics;
 
@@ -33,5 +55,29 @@ public:
 public:
   int mNumberOfThings = 16;
   int mKindOfThing = 0;
+
+private:
+  void UpdateLabels();
+
+  /** Runs every test with each number of things for a fixed number of frames, then writes a JSON report of the times to reportPath */
+  void StartBenchmark(const char* reportPath);
+  /** Called on every frame by the display tick function while the benchmark runs */
+  void OnBenchmarkTick();
+  void WriteBenchmarkReport();
+
+  struct BenchmarkResult
+  {
+    int test;
+    int numberOfThings;
+    std::vector<double> drawTimes; // the time spent in the test's drawing function, in seconds
+    std::vector<double> frameTimes; // the time between frames, in seconds
+  };
+
+  bool mBenchmarking = false;
+  int mBenchmarkFrame = 0;
+  double mPrevFrameTimestamp = 0.;
+  double mLastDrawTime = -1.; // set by the drawing function, -1 if it wasn't drawn since the last tick
+  WDL_String mBenchmarkReportPath;
+  std::vector<BenchmarkResult> mBenchmarkResults;
 #endif
 };
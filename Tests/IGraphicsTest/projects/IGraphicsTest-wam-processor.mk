@@ -1,6 +1,6 @@
 include ../config/IGraphicsTest-web.mk
 
-TARGET = ../build-web/scripts/IGraphicsTest-wam.js
+TARGET = ../build-web/scripts/IGraphicsTest-wam$(WAM_TARGET_SUFFIX).js
 
 SRC += $(WAM_SRC)
 CFLAGS += $(WAM_CFLAGS)
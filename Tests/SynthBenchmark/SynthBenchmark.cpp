@@ -0,0 +1,374 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+/**
+ * @file
+ * @brief A headless benchmark for MidiSynth and VoiceAllocator
+ *
+ * Plays the same MIDI streams through a MidiSynth with a reference voice at several block sizes, and for each reports the time per block, the number of voices
+ * stolen, the number of heap allocations made while processing and a checksum of the output, so that changes to the allocator can be compared for speed and output.
+ * See README.md for how to build it.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "IPlugLogger.h"
+
+#include "Synth/MidiSynth.h"
+#include "ADSREnvelope.h"
+
+using namespace iplug;
+
+#pragma mark - Allocation tracking
+
+// counts the calls to the global operator new while gTrackAllocations is set, i.e. during MidiSynth::ProcessBlock()
+static std::atomic<bool> gTrackAllocations{false};
+static std::atomic<int64_t> gAllocationCount{0};
+
+void* operator new(std::size_t size)
+{
+  if (gTrackAllocations.load(std::memory_order_relaxed))
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+#pragma mark - Reference voice
+
+/** A sine voice with an ADSR envelope that reads every control ramp, standing in for a typical plug-in voice */
+class BenchmarkVoice : public SynthVoice
+{
+public:
+  BenchmarkVoice()
+  {
+    mEnv.SetStageTime(ADSREnvelope<sample>::kAttack, 5.);
+    mEnv.SetStageTime(ADSREnvelope<sample>::kDecay, 200.);
+    mEnv.SetStageTime(ADSREnvelope<sample>::kRelease, 300.);
+  }
+
+  bool GetBusy() const override { return mEnv.GetBusy(); }
+
+  void Trigger(double level, bool isRetrigger) override
+  {
+    if (isRetrigger)
+      mEnv.Retrigger(level);
+    else
+      mEnv.Start(level);
+  }
+
+  void Release() override { mEnv.Release(); }
+
+  void Kill() override { mEnv.Kill(false); }
+
+  double GetLevel() const override { return mEnv.GetPrevOutput(); }
+
+  void SetSampleRateAndBlockSize(double sampleRate, int blockSize) override
+  {
+    mSampleRate = sampleRate;
+    mEnv.SetSampleRate(sampleRate);
+    mTimbre.resize(blockSize);
+  }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    if (static_cast<int>(mTimbre.size()) < nFrames)
+      return;
+
+    const double pitch = mInputs[kVoiceControlPitch].endValue + mInputs[kVoiceControlPitchBend].endValue;
+    const double pressure = 0.5 + 0.5 * mInputs[kVoiceControlPressure].endValue;
+    const double phaseIncr = 2. * PI * 440. * std::pow(2., pitch) / mSampleRate;
+    mInputs[kVoiceControlTimbre].Write(mTimbre.data(), 0, nFrames);
+
+    for (int s = 0; s < nFrames; s++)
+    {
+      const sample env = mEnv.Process(0.7);
+      const sample out = static_cast<sample>(std::sin(mPhase) * env * pressure * (1. + 0.1 * mTimbre[s]));
+      mPhase += phaseIncr;
+
+      for (int c = 0; c < nOutputs; c++)
+        outputs[c][startIdx + s] += out;
+    }
+
+    mPhase = std::fmod(mPhase, 2. * PI);
+  }
+
+private:
+  ADSREnvelope<sample> mEnv;
+  std::vector<float> mTimbre;
+  double mSampleRate = 44100.;
+  double mPhase = 0.;
+};
+
+#pragma mark - MIDI streams
+
+static constexpr double kSampleRate = 44100.;
+static constexpr int kStreamFrames = static_cast<int>(kSampleRate) * 20;
+static constexpr int kNumVoices = 32;
+
+/** A MIDI message at an absolute sample time */
+struct TimedMsg
+{
+  int64_t mTime;
+  IMidiMsg mMsg;
+};
+
+/** A named MIDI stream, made once and played at every block size */
+struct Scenario
+{
+  std::string mName;
+  bool mMPE;
+  std::vector<TimedMsg> mMsgs;
+};
+
+/** A small deterministic random number generator, so that the streams are the same on every platform */
+class Random
+{
+public:
+  explicit Random(uint32_t seed) : mState(seed) {}
+
+  int Next(int range)
+  {
+    mState = mState * 1664525u + 1013904223u;
+    return static_cast<int>((mState >> 8) % static_cast<uint32_t>(range));
+  }
+
+private:
+  uint32_t mState;
+};
+
+/** Chords of eight notes every 100ms, each held for 400ms, so that many voices are stolen */
+static Scenario MakeDenseChords()
+{
+  Scenario scenario{"dense chords", false, {}};
+  Random rand(1);
+
+  for (int64_t t = 0; t < kStreamFrames; t += 4410)
+  {
+    for (int n = 0; n < 8; n++)
+    {
+      const int key = 36 + rand.Next(60);
+      TimedMsg on{t + n, {}}, off{t + 4 * 4410 + n, {}};
+      on.mMsg.MakeNoteOnMsg(key, 40 + rand.Next(87), 0);
+      off.mMsg.MakeNoteOffMsg(key, 0);
+      scenario.mMsgs.push_back(on);
+      scenario.mMsgs.push_back(off);
+    }
+  }
+
+  return scenario;
+}
+
+/** Notes on 15 MPE member channels, each streaming pitch bend, pressure and timbre every millisecond */
+static Scenario MakeMPE()
+{
+  Scenario scenario{"MPE", true, {}};
+  Random rand(2);
+  const int interval = static_cast<int>(kSampleRate / 1000.);
+
+  for (int ch = 1; ch <= 15; ch++)
+  {
+    for (int64_t t = ch * 100; t < kStreamFrames; t += 22050)
+    {
+      const int key = 48 + rand.Next(36);
+      TimedMsg on{t, {}}, off{t + 20000, {}};
+      on.mMsg.MakeNoteOnMsg(key, 100, 0, ch);
+      off.mMsg.MakeNoteOffMsg(key, 0, ch);
+      scenario.mMsgs.push_back(on);
+      scenario.mMsgs.push_back(off);
+    }
+
+    for (int64_t t = ch; t < kStreamFrames; t += interval)
+    {
+      TimedMsg bend{t, {}}, pressure{t, {}}, timbre{t, {}};
+      bend.mMsg.MakePitchWheelMsg((rand.Next(201) - 100) / 1000., ch, 0);
+      pressure.mMsg.MakeChannelATMsg(rand.Next(128), 0, ch);
+      timbre.mMsg.MakeControlChangeMsg(IMidiMsg::kCutoffFrequency, rand.Next(128) / 127., ch, 0);
+      scenario.mMsgs.push_back(bend);
+      scenario.mMsgs.push_back(pressure);
+      scenario.mMsgs.push_back(timbre);
+    }
+  }
+
+  return scenario;
+}
+
+/** Fast runs of short notes under a sustain pedal that is pressed and released many times a second */
+static Scenario MakeSustainStorm()
+{
+  Scenario scenario{"sustain storm", false, {}};
+  Random rand(3);
+
+  for (int64_t t = 0; t < kStreamFrames; t += 441)
+  {
+    const int key = 40 + rand.Next(48);
+    TimedMsg on{t, {}}, off{t + 300, {}};
+    on.mMsg.MakeNoteOnMsg(key, 30 + rand.Next(97), 0);
+    off.mMsg.MakeNoteOffMsg(key, 0);
+    scenario.mMsgs.push_back(on);
+    scenario.mMsgs.push_back(off);
+  }
+
+  for (int64_t t = 0; t < kStreamFrames; t += 2205)
+  {
+    TimedMsg pedal{t, {}};
+    pedal.mMsg.MakeControlChangeMsg(IMidiMsg::kSustainOnOff, (t / 2205) % 2 ? 0. : 1., 0, 0);
+    scenario.mMsgs.push_back(pedal);
+  }
+
+  return scenario;
+}
+
+#pragma mark - Benchmark
+
+struct Result
+{
+  double mMeanMicroseconds = 0.;
+  double mMaxMicroseconds = 0.;
+  int64_t mSteals = 0;
+  double mAllocationsPerBlock = 0.;
+  uint64_t mChecksum = 0;
+};
+
+static Result Run(const Scenario& scenario, int blockSize)
+{
+  MidiSynth synth(VoiceAllocator::kPolyModePoly);
+
+  for (int v = 0; v < kNumVoices; v++)
+  {
+    synth.AddVoice(new BenchmarkVoice(), 0);
+  }
+
+  synth.SetSampleRateAndBlockSize(kSampleRate, blockSize);
+
+  if (scenario.mMPE)
+  {
+    // RPN 6 on the lower zone master channel: 15 member channels
+    const int rpn[][2] = {{101, 0}, {100, 6}, {6, 15}};
+    for (auto& cc : rpn)
+    {
+      IMidiMsg msg;
+      msg.MakeControlChangeMsg(static_cast<IMidiMsg::EControlChangeMsg>(cc[0]), cc[1] / 127., 0, 0);
+      synth.AddMidiMsgToQueue(msg);
+    }
+  }
+
+  std::vector<sample> left(blockSize), right(blockSize);
+  sample* outputs[2] = {left.data(), right.data()};
+
+  Result result;
+  double totalMicroseconds = 0.;
+  int64_t allocations = 0;
+  int nBlocks = 0;
+  uint64_t checksum = 1469598103934665603ull;
+  size_t nextMsg = 0;
+
+  for (int64_t blockStart = 0; blockStart < kStreamFrames; blockStart += blockSize)
+  {
+    while (nextMsg < scenario.mMsgs.size() && scenario.mMsgs[nextMsg].mTime < blockStart + blockSize)
+    {
+      IMidiMsg msg = scenario.mMsgs[nextMsg++].mMsg;
+      msg.mOffset = static_cast<int>(std::max<int64_t>(scenario.mMsgs[nextMsg - 1].mTime - blockStart, 0));
+      synth.AddMidiMsgToQueue(msg);
+    }
+
+    std::fill(left.begin(), left.end(), 0.);
+    std::fill(right.begin(), right.end(), 0.);
+
+    const int64_t allocationsBefore = gAllocationCount.load();
+    gTrackAllocations = true;
+    const auto start = std::chrono::steady_clock::now();
+    synth.ProcessBlock(nullptr, outputs, 0, 2, blockSize);
+    const auto end = std::chrono::steady_clock::now();
+    gTrackAllocations = false;
+    allocations += gAllocationCount.load() - allocationsBefore;
+
+    const double microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+    totalMicroseconds += microseconds;
+    result.mMaxMicroseconds = std::max(result.mMaxMicroseconds, microseconds);
+    nBlocks++;
+
+    // FNV-1a over the output quantized to 16 bits, so that only audible changes alter it
+    for (auto s : left)
+    {
+      checksum = (checksum ^ static_cast<uint64_t>(static_cast<int64_t>(std::round(s * 32767.)))) * 1099511628211ull;
+    }
+  }
+
+  result.mMeanMicroseconds = totalMicroseconds / nBlocks;
+  result.mSteals = synth.GetStealCount();
+  result.mAllocationsPerBlock = static_cast<double>(allocations) / nBlocks;
+  result.mChecksum = checksum;
+  return result;
+}
+
+int main()
+{
+  // the MIDI messages are timed within each block, so sort them stably by time
+  std::vector<Scenario> scenarios = {MakeDenseChords(), MakeMPE(), MakeSustainStorm()};
+  for (auto& scenario : scenarios)
+  {
+    std::stable_sort(scenario.mMsgs.begin(), scenario.mMsgs.end(), [](const TimedMsg& a, const TimedMsg& b) { return a.mTime < b.mTime; });
+  }
+
+  const int blockSizes[] = {32, 64, 128, 256, 512, 1024};
+
+  std::printf("%-14s %6s %12s %12s %8s %12s %18s\n", "scenario", "block", "us/block", "max us", "steals", "allocs/block", "checksum");
+
+  for (const auto& scenario : scenarios)
+  {
+    for (auto blockSize : blockSizes)
+    {
+      const Result result = Run(scenario, blockSize);
+      std::printf("%-14s %6d %12.2f %12.2f %8lld %12.3f %18llx\n", scenario.mName.c_str(), blockSize, result.mMeanMicroseconds, result.mMaxMicroseconds,
+                  static_cast<long long>(result.mSteals), result.mAllocationsPerBlock, static_cast<unsigned long long>(result.mChecksum));
+    }
+  }
+
+  return 0;
+}
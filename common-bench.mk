@@ -0,0 +1,59 @@
+# Builds a plug-in as the BENCH target, a command line program that benchmarks its DSP offline, without a UI or an audio device (see IPlug/BENCH/IPlugBench_main.cpp)
+# A project's makefile sets IPLUG2_ROOT, includes this file, adds its own source files to SRC and builds $(TARGET), see Examples/IPlugEffect/projects/IPlugEffect-bench.mk
+# The BENCH target builds on macOS and Windows (e.g. with MinGW), which have an IPlug Timer implementation
+
+PROJECT_ROOT = $(PWD)/..
+WDL_PATH = $(IPLUG2_ROOT)/WDL
+IPLUG_PATH = $(IPLUG2_ROOT)/IPlug
+IGRAPHICS_PATH = $(IPLUG2_ROOT)/IGraphics
+IPLUG_EXTRAS_PATH = $(IPLUG_PATH)/Extras
+IPLUG_BENCH_PATH = $(IPLUG_PATH)/BENCH
+DEPS_PATH = $(IPLUG2_ROOT)/Dependencies
+
+IPLUG_SRC = $(IPLUG_PATH)/IPlugAPIBase.cpp \
+	$(IPLUG_PATH)/IPlugParameter.cpp \
+	$(IPLUG_PATH)/IPlugPluginBase.cpp \
+	$(IPLUG_PATH)/IPlugProcessor.cpp \
+	$(IPLUG_PATH)/IPlugTimer.cpp
+
+BENCH_SRC = $(IPLUG_BENCH_PATH)/IPlugBench.cpp \
+	$(IPLUG_BENCH_PATH)/IPlugBench_main.cpp
+
+# the headers of IGraphics are on the include path, so that plug-ins that include them outside #if IPLUG_EDITOR still compile
+INCLUDE_PATHS = -I$(PROJECT_ROOT) \
+-I$(WDL_PATH) \
+-I$(IPLUG_PATH) \
+-I$(IPLUG_EXTRAS_PATH) \
+-I$(IPLUG_BENCH_PATH) \
+-I$(IGRAPHICS_PATH) \
+-I$(IGRAPHICS_PATH)/Controls \
+-I$(IGRAPHICS_PATH)/Drawing \
+-I$(IGRAPHICS_PATH)/Platforms \
+-I$(IGRAPHICS_PATH)/Extras \
+-I$(DEPS_PATH)/IGraphics/NanoSVG/src \
+-I$(DEPS_PATH)/IGraphics/NanoVG/src \
+-I$(DEPS_PATH)/IGraphics/STB
+
+SRC = $(IPLUG_SRC) $(BENCH_SRC)
+
+# optimized, with symbols so that a profiler can be pointed at the benchmark
+CFLAGS = $(INCLUDE_PATHS) \
+-std=c++17 \
+-O2 \
+-DNDEBUG \
+-g \
+-DBENCH_API \
+-DIPLUG_DSP=1 \
+-DIPLUG_EDITOR=0 \
+-DNO_IGRAPHICS
+
+LDFLAGS = -lpthread
+
+UNAME_S := $(shell uname -s)
+
+ifeq ($(UNAME_S), Darwin)
+SRC += $(IPLUG_PATH)/IPlugPaths.mm
+LDFLAGS += -framework CoreFoundation -framework Foundation
+else
+SRC += $(IPLUG_PATH)/IPlugPaths.cpp
+endif
@@ -63,6 +63,9 @@ $(IGRAPHICS_PATH)/IGraphicsEditorDelegate.cpp
 
 NANOVG_LDFLAGS = -s USE_WEBGL2=0 -s FULL_ES3=1
 
+# use these instead of NANOVG_LDFLAGS with -DIGRAPHICS_NANOVG -DIGRAPHICS_GLES3, to draw with WebGL2
+NANOVG_WEBGL2_LDFLAGS = -s USE_WEBGL2=1 -s MIN_WEBGL_VERSION=2 -s MAX_WEBGL_VERSION=2
+
 # CFLAGS for both WAM and WEB targets
 CFLAGS = $(INCLUDE_PATHS) \
 -std=c++17  \
@@ -78,6 +81,14 @@ WAM_CFLAGS = -DWAM_API \
 WEB_CFLAGS = -DWEB_API \
 -DIPLUG_EDITOR=1
 
+# WAM_SIMD=1 builds the WAM processor with WebAssembly SIMD128, as *-wam-simd.js. The vector kernels of IPlugSIMD.h and HIIR's
+# SIMDStageProc.h use wasm_simd128.h intrinsics, and the compiler auto-vectorizes loops such as the SVF's channel loop.
+# A module can't test for SIMD itself, so makedist-web.sh builds both and IPlugWAM-awn.js loads the SIMD build if the browser supports it
+ifeq ($(WAM_SIMD), 1)
+WAM_CFLAGS += -msimd128
+WAM_TARGET_SUFFIX = -simd
+endif
+
 WAM_EXPORTS = "[\
   '_malloc', '_free', '_createModule','_wam_init','_wam_terminate','_wam_resize', \
   '_wam_onprocess', '_wam_onmidi', '_wam_onsysex', '_wam_onparam', \